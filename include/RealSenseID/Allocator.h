@@ -0,0 +1,142 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+#include "Metrics.h"
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Allocator of the SDK internal allocations of the subsystems (see Metrics::Subsystem), e.g. the application's pool or
+ * arena allocator, or a checking allocator which fails the allocations of a loop that should be allocation free.
+ * Called concurrently from the SDK threads.
+ */
+struct RSID_API AllocatorHooks
+{
+    /**
+     * Allocate size bytes aligned to alignment (a power of 2), nullptr on failure.
+     */
+    void* (*allocate)(size_t size, size_t alignment, Metrics::Subsystem subsystem, void* ctx) = nullptr;
+
+    /**
+     * Free an allocation of allocate() with its size and alignment.
+     */
+    void (*deallocate)(void* ptr, size_t size, size_t alignment, Metrics::Subsystem subsystem, void* ctx) = nullptr;
+
+    void* ctx = nullptr;
+};
+
+/**
+ * Route the SDK allocations through the given hooks (nullptr restores the default allocator, malloc). The allocations
+ * are counted per subsystem either way (see Metrics::Snapshot::allocations).
+ * Memory is returned to the allocator it came from, so the allocator can only be replaced while no SDK allocation is
+ * live: set it at startup, before the SDK objects are created.
+ *
+ * @return False (and the allocator is not replaced) if SDK allocations are live or a hook is missing.
+ */
+RSID_API bool SetAllocator(const AllocatorHooks* hooks);
+
+/**
+ * Allocate with the SDK allocator, counted for the subsystem.
+ *
+ * @throws std::bad_alloc on failure.
+ */
+RSID_API void* SdkAllocate(Metrics::Subsystem subsystem, size_t size, size_t alignment);
+
+/**
+ * Free an allocation of SdkAllocate() with its subsystem, size and alignment.
+ */
+RSID_API void SdkFree(Metrics::Subsystem subsystem, void* ptr, size_t size, size_t alignment) noexcept;
+
+/**
+ * Standard allocator of the SDK allocator, e.g. for the vectors of a subsystem.
+ */
+template <typename T, Metrics::Subsystem S>
+class SdkAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = SdkAllocator<U, S>;
+    };
+
+    SdkAllocator() = default;
+
+    template <typename U>
+    SdkAllocator(const SdkAllocator<U, S>&) noexcept
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(SdkAllocate(S, n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        SdkFree(S, p, n * sizeof(T), alignof(T));
+    }
+
+    template <typename U>
+    bool operator==(const SdkAllocator<U, S>&) const noexcept
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const SdkAllocator<U, S>&) const noexcept
+    {
+        return false;
+    }
+};
+
+template <typename T, Metrics::Subsystem S>
+using SdkVector = std::vector<T, SdkAllocator<T, S>>;
+
+/**
+ * Deleter of the objects of SdkNew().
+ */
+template <typename T, Metrics::Subsystem S>
+struct SdkDelete
+{
+    void operator()(T* p) const noexcept
+    {
+        if (p != nullptr)
+        {
+            p->~T();
+            SdkFree(S, p, sizeof(T), alignof(T));
+        }
+    }
+};
+
+template <typename T, Metrics::Subsystem S>
+using SdkUniquePtr = std::unique_ptr<T, SdkDelete<T, S>>;
+
+/**
+ * Construct an object (brace initialized) with the SDK allocator, destroy it with SdkDelete<T, S>.
+ */
+template <typename T, Metrics::Subsystem S, typename... Args>
+T* SdkNew(Args&&... args)
+{
+    void* p = SdkAllocate(S, sizeof(T), alignof(T));
+    try
+    {
+        return new (p) T {std::forward<Args>(args)...};
+    }
+    catch (...)
+    {
+        SdkFree(S, p, sizeof(T), alignof(T));
+        throw;
+    }
+}
+} // namespace RealSenseID
@@ -15,5 +15,11 @@ struct RSID_API AndroidSerialConfig
     int fileDescriptor = -1;
     int readEndpoint = -1;
     int writeEndpoint = -1;
+    // size of the receive buffer filled by the usb reader thread. reading from the device pauses while it is full.
+#ifdef RSID_LOW_MEMORY
+    unsigned int readBufferSize = 16384;
+#else
+    unsigned int readBufferSize = 65536;
+#endif
 };
 } // namespace RealSenseID
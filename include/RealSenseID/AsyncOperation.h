@@ -0,0 +1,89 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/RealSenseIDExports.h"
+#include "RealSenseID/Status.h"
+#include <functional>
+
+namespace RealSenseID
+{
+class AsyncOperationImpl;
+
+/**
+ * Handle of an operation started by one of the FaceAuthenticator's *Async() methods.
+ * The operations of all the authenticators run on a process wide pool of executor threads, so a single application
+ * thread (or a few) can drive many devices. Operations of the same authenticator run one at a time, in the order
+ * they were started. Operations beyond the number of executor threads wait for a free thread.
+ * Copies of a handle refer to the same operation (reference counted). Dropping all handles does not cancel it.
+ * Handles can be used from any thread and may outlive the FaceAuthenticator.
+ */
+class RSID_API AsyncOperation
+{
+public:
+    /**
+     * Called once the operation is done (completed, failed or canceled), on the executor thread or, for an operation
+     * canceled before it started, on the thread which canceled it. Must not destroy the operation's FaceAuthenticator.
+     */
+    using Completion = std::function<void(Status status)>;
+
+    static constexpr unsigned int DefaultExecutorThreads = 4;
+
+    /**
+     * Set the max number of executor threads (at least 1, default DefaultExecutorThreads).
+     * Threads are started on demand and stopped when the last authenticator that used them is destroyed.
+     * Lowering the number stops the extra threads as their current operations complete.
+     */
+    static void SetExecutorThreads(unsigned int threads);
+
+    AsyncOperation() = default;
+    ~AsyncOperation();
+
+    AsyncOperation(const AsyncOperation& other);
+    AsyncOperation(AsyncOperation&& other) noexcept;
+    AsyncOperation& operator=(const AsyncOperation& other);
+    AsyncOperation& operator=(AsyncOperation&& other) noexcept;
+
+    /**
+     * @return True if the handle refers to an operation.
+     */
+    bool IsValid() const;
+
+    /**
+     * @return True once the operation is done.
+     */
+    bool IsDone() const;
+
+    /**
+     * Block until the operation is done. Must not be called from the callbacks of the operation's authenticator.
+     *
+     * @return Status of the operation (Status::Error if canceled before it started or the handle is not valid).
+     */
+    Status Wait() const;
+
+    /**
+     * Block until the operation is done or timeout_ms passed.
+     *
+     * @return True if the operation is done.
+     */
+    bool WaitFor(unsigned int timeout_ms) const;
+
+    /**
+     * @return Status of the operation, Status::Error if it is not done yet.
+     */
+    Status GetStatus() const;
+
+    /**
+     * Cancel the operation. An operation that has not started yet is done immediately with Status::Error.
+     * A running operation is canceled on the device (FaceAuthenticator::Cancel()) and is done once the device
+     * replies.
+     */
+    void Cancel();
+
+private:
+    friend class AsyncOperationImpl;
+    explicit AsyncOperation(AsyncOperationImpl* impl); // adopts a reference of impl
+    AsyncOperationImpl* _impl = nullptr;
+};
+} // namespace RealSenseID
@@ -5,12 +5,12 @@
 
 #include "AuthenticateStatus.h"
 #include "FaceRect.h"
+#include "Faceprints.h"
+#include <cstddef>
 #include <vector>
 
 namespace RealSenseID
 {
-class Faceprints;
-
 /**
  * User defined callback for faceprints extraction.
  * Callback will be used to provide feedback to the client.
@@ -28,6 +28,43 @@ public:
      */
     virtual void OnResult(const AuthenticateStatus status, const Faceprints* faceprints) = 0;
 
+    /**
+     * Compact version of OnResult(), called by the SDK instead of it.
+     * The default implementation copies the query to a Faceprints and calls OnResult(), override this one to pass the
+     * query as is (e.g. to HostFaceprintsGallery::Match()).
+     *
+     * @param[in] status Final authentication status.
+     * @param[in] query Pointer to the extracted query faceprints in case of success, nullptr otherwise.
+     */
+    virtual void OnQueryResult(const AuthenticateStatus status, const QueryFaceprints* query)
+    {
+        if (query == nullptr)
+        {
+            OnResult(status, nullptr);
+            return;
+        }
+        Faceprints faceprints;
+        ToFaceprints(*query, faceprints);
+        OnResult(status, &faceprints);
+    }
+
+    /**
+     * Called instead of OnQueryResult() by the multi-face extraction loop (see
+     * FaceAuthenticator::ExtractFaceprintsForAuthLoop()) with the faceprints of all the faces of a frame.
+     * The default implementation calls OnQueryResult() with the first face, the one the single face loop extracts.
+     *
+     * @param[in] status Final authentication status.
+     * @param[in] queries Extracted query faceprints of each face, valid during the call.
+     * @param[in] faces Rect of each face, valid during the call.
+     * @param[in] count Number of faces (0 if status is not Success).
+     */
+    virtual void OnQueryResults(const AuthenticateStatus status, const QueryFaceprints* queries, const FaceRect* faces,
+                                size_t count)
+    {
+        (void)faces;
+        OnQueryResult(status, count > 0 ? &queries[0] : nullptr);
+    }
+
     /**
      * Called to inform the client of problems encountered during the authentication operation.
      *
@@ -45,6 +82,19 @@ public:
     {
         // default empty impl for backward compatibilty
     }
+
+    /**
+     * Allocation free version of OnFaceDetected(), called by the SDK instead of it.
+     * The default implementation copies the faces to a vector and calls OnFaceDetected(), override this one to avoid
+     * the allocation per FaceDetected message (e.g. in long running loops).
+     *
+     * @param[in] faces Detected faces, valid during the call. First item is the selected one for the operation.
+     * @param[in] count Number of faces.
+     */
+    virtual void OnFacesDetected(const FaceRect* faces, size_t count)
+    {
+        OnFaceDetected(std::vector<FaceRect>(faces, faces + count));
+    }
 };
 
 } // namespace RealSenseID
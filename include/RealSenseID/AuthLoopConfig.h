@@ -0,0 +1,46 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+
+namespace RealSenseID
+{
+/**
+ * Reporting policy of the authentication loop (see FaceAuthenticator::AuthenticateLoop()).
+ * The device keeps streaming over the single loop request, the policy decides which of its results and hints reach
+ * the callback. Face rects are always reported.
+ */
+struct RSID_API AuthLoopConfig
+{
+    // successful results of a user within duplicateWindowMs of its last reported success are not reported.
+    // 0 reports every success
+    unsigned int duplicateWindowMs = 0;
+
+    // results within minResultIntervalMs of the last reported result are not reported. 0 reports every result
+    unsigned int minResultIntervalMs = 0;
+
+    // a hint identical to the last reported hint is not reported, until a different hint or a result is reported
+    bool suppressRepeatedHints = false;
+
+    // associate the face rects of consecutive detections to tracks. once the track of the largest face has a
+    // successful result, the track's further results are not reported (and not matched by the host mode loop) until
+    // the track is lost or trackReauthIntervalMs expired
+    bool trackFaces = false;
+
+    // reauthenticate a tracked user after this interval. 0 keeps the track authenticated until it is lost
+    unsigned int trackReauthIntervalMs = 0;
+
+    // host mode loop only (HostModeAuthenticator::AuthenticateLoop()): decide on the evidence of up to sequentialFrames
+    // consecutive frames of a face instead of each frame alone. The first frame searches the gallery, the next ones
+    // score only its sequentialCandidates best users, and the result is reported as soon as the running mean score
+    // of the best of them passes the match threshold (or as a failure after sequentialFrames frames). The evidence
+    // restarts when the face is lost (or, with trackFaces, when another track becomes the largest face).
+    // 0 or 1 decides each frame alone
+    unsigned int sequentialFrames = 0;
+
+    // candidates kept from the first frame of a sequential decision
+    unsigned int sequentialCandidates = 4;
+};
+} // namespace RealSenseID
@@ -0,0 +1,221 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+/**
+ * C++20 coroutine support for the FaceAuthenticator's async flows (header only, the SDK itself stays C++14).
+ * Available when the including code is compiled as C++20 (or later) with coroutines, e.g.
+ *
+ *   RealSenseID::DetachedFlow Run(RealSenseID::FaceAuthenticator& authenticator, MyAuthCallback& callback)
+ *   {
+ *       auto status = co_await RealSenseID::AwaitAuthenticate(authenticator, callback);
+ *       ...
+ *   }
+ *
+ * A suspended coroutine holds no thread: the flows run on the SDK's executor threads (see AsyncOperation), so a few
+ * threads can drive the flows of many devices. The coroutine is resumed on the executor thread which completed the
+ * flow (or on the thread which canceled it, if canceled before it started) and should not block there for long.
+ * After resuming it must not destroy the authenticator of the awaited flow in the same step (see
+ * AsyncOperation::Completion). AsyncOperation's ordering rules apply: one flow of an authenticator runs at a time and
+ * its other methods (except Cancel()) must not be called while flows are pending.
+ */
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define RSID_COROUTINES
+#endif
+#endif
+
+#ifdef RSID_COROUTINES
+
+#include "RealSenseID/AsyncOperation.h"
+#include "RealSenseID/FaceAuthenticator.h"
+#include "RealSenseID/Status.h"
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+namespace RealSenseID
+{
+/**
+ * Awaitable of an async operation, started when awaited. co_await returns the operation's status.
+ * Start is called with an AsyncOperation::Completion and must return the operation's handle, e.g.
+ *   co_await MakeAwaitable([&](auto completion) { return authenticator.EnrollAsync(callback, id, completion); });
+ */
+template <typename Start>
+class AwaitableOperation
+{
+public:
+    explicit AwaitableOperation(Start start) : _start {std::move(start)}
+    {
+    }
+
+    AwaitableOperation(const AwaitableOperation&) = delete;
+    AwaitableOperation& operator=(const AwaitableOperation&) = delete;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    // returns false (resume right away) if the operation was done before the coroutine got suspended
+    bool await_suspend(std::coroutine_handle<> coroutine)
+    {
+        _operation = _start([this, coroutine](Status status) {
+            _status = status;
+            if (_state.exchange(State::Done) == State::Suspended)
+                coroutine.resume();
+        });
+        if (!_operation.IsValid())
+        {
+            return false; // not started, status stays Status::Error
+        }
+        return _state.exchange(State::Suspended) != State::Done;
+    }
+
+    Status await_resume() const noexcept
+    {
+        return _status;
+    }
+
+private:
+    enum class State
+    {
+        Starting,
+        Suspended,
+        Done
+    };
+
+    Start _start;
+    AsyncOperation _operation;
+    Status _status = Status::Error;
+    std::atomic<State> _state {State::Starting};
+};
+
+template <typename Start>
+AwaitableOperation<Start> MakeAwaitable(Start start)
+{
+    return AwaitableOperation<Start> {std::move(start)};
+}
+
+/**
+ * Awaitable FaceAuthenticator::EnrollAsync().
+ */
+inline auto AwaitEnroll(FaceAuthenticator& authenticator, EnrollmentCallback& callback, const char* user_id)
+{
+    return MakeAwaitable([&authenticator, &callback, user_id](AsyncOperation::Completion completion) {
+        return authenticator.EnrollAsync(callback, user_id, std::move(completion));
+    });
+}
+
+/**
+ * Awaitable FaceAuthenticator::AuthenticateAsync().
+ */
+inline auto AwaitAuthenticate(FaceAuthenticator& authenticator, AuthenticationCallback& callback)
+{
+    return MakeAwaitable([&authenticator, &callback](AsyncOperation::Completion completion) {
+        return authenticator.AuthenticateAsync(callback, std::move(completion));
+    });
+}
+
+/**
+ * Awaitable FaceAuthenticator::AuthenticateLoopAsync(). Call FaceAuthenticator::Cancel() to stop the loop.
+ */
+inline auto AwaitAuthenticateLoop(FaceAuthenticator& authenticator, AuthenticationCallback& callback)
+{
+    return MakeAwaitable([&authenticator, &callback](AsyncOperation::Completion completion) {
+        return authenticator.AuthenticateLoopAsync(callback, std::move(completion));
+    });
+}
+
+/**
+ * Awaitable FaceAuthenticator::AuthenticateLoopAsync() with a reporting policy (copied).
+ */
+inline auto AwaitAuthenticateLoop(FaceAuthenticator& authenticator, AuthenticationCallback& callback,
+                                  const AuthLoopConfig& config)
+{
+    return MakeAwaitable([&authenticator, &callback, config](AsyncOperation::Completion completion) {
+        return authenticator.AuthenticateLoopAsync(callback, config, std::move(completion));
+    });
+}
+
+/**
+ * Awaitable FaceAuthenticator::DetectSpoofAsync().
+ */
+inline auto AwaitDetectSpoof(FaceAuthenticator& authenticator, AuthenticationCallback& callback)
+{
+    return MakeAwaitable([&authenticator, &callback](AsyncOperation::Completion completion) {
+        return authenticator.DetectSpoofAsync(callback, std::move(completion));
+    });
+}
+
+/**
+ * Awaitable FaceAuthenticator::ExtractFaceprintsForEnrollAsync().
+ */
+inline auto AwaitExtractFaceprintsForEnroll(FaceAuthenticator& authenticator,
+                                            EnrollFaceprintsExtractionCallback& callback)
+{
+    return MakeAwaitable([&authenticator, &callback](AsyncOperation::Completion completion) {
+        return authenticator.ExtractFaceprintsForEnrollAsync(callback, std::move(completion));
+    });
+}
+
+/**
+ * Awaitable FaceAuthenticator::ExtractFaceprintsForAuthAsync().
+ */
+inline auto AwaitExtractFaceprintsForAuth(FaceAuthenticator& authenticator, AuthFaceprintsExtractionCallback& callback)
+{
+    return MakeAwaitable([&authenticator, &callback](AsyncOperation::Completion completion) {
+        return authenticator.ExtractFaceprintsForAuthAsync(callback, std::move(completion));
+    });
+}
+
+/**
+ * Awaitable FaceAuthenticator::ExtractFaceprintsForAuthLoopAsync(). Call FaceAuthenticator::Cancel() to stop the loop.
+ */
+inline auto AwaitExtractFaceprintsForAuthLoop(FaceAuthenticator& authenticator,
+                                              AuthFaceprintsExtractionCallback& callback)
+{
+    return MakeAwaitable([&authenticator, &callback](AsyncOperation::Completion completion) {
+        return authenticator.ExtractFaceprintsForAuthLoopAsync(callback, std::move(completion));
+    });
+}
+
+/**
+ * Return type of fire and forget coroutines: runs on the calling thread until its first suspension and frees itself
+ * when it returns. Exceptions escaping the coroutine terminate the process.
+ */
+struct DetachedFlow
+{
+    struct promise_type
+    {
+        DetachedFlow get_return_object() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() noexcept
+        {
+        }
+
+        void unhandled_exception() noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+} // namespace RealSenseID
+
+#endif // RSID_COROUTINES
@@ -0,0 +1,28 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+
+namespace RealSenseID
+{
+/**
+ * Handling of the device flows' callback events while the callback is busy
+ */
+enum class CallbackQueuePolicy
+{
+    Inline = 0,     // no queue, callbacks on the flow's thread (the flow's receive waits for the callback)
+    DropOldest = 1, // queue up to queueSize events, drop the oldest queued hint, progress or faces event when full
+    Block = 2       // queue up to queueSize events, the flow's receive waits for room when full
+};
+
+/**
+ * Callback dispatch configuration (see FaceAuthenticator::SetCallbackDispatch())
+ */
+struct RSID_API CallbackDispatchConfig
+{
+    CallbackQueuePolicy queuePolicy = CallbackQueuePolicy::Inline;
+    unsigned int queueSize = 64; // max events waiting for the callback (DropOldest and Block policies)
+};
+} // namespace RealSenseID
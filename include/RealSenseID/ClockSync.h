@@ -0,0 +1,27 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+#include <cstdint>
+
+namespace RealSenseID
+{
+/**
+ * Estimate of the device clock against the host's steady clock (CLOCK_MONOTONIC on Linux), from the timestamped
+ * pings of FaceAuthenticator::SyncClock(). Times are in microseconds.
+ * device time = host time + offsetUs + driftPpm * (host time - referenceUs) / 1000000
+ * Exchanges are weighted NTP style: only those with a round trip close to the shortest one of the window are fitted,
+ * the drift is estimated once they span at least a second.
+ */
+struct RSID_API ClockSyncState
+{
+    bool synced = false;        // the device stamped at least one ping
+    uint64_t referenceUs = 0;   // host time of offsetUs
+    int64_t offsetUs = 0;       // device clock minus host clock at referenceUs
+    double driftPpm = 0;        // rate of the device clock against the host's, in parts per million
+    unsigned int rttUs = 0;     // shortest round trip of the window, the error of offsetUs is at most half of it
+    unsigned int exchanges = 0; // in the window (the last 64)
+};
+} // namespace RealSenseID
@@ -76,6 +76,18 @@ public:
      */
     Status Ping();
 
+    /**
+     * Find the fastest baud rate of the serial link.
+     * Reconnects at each supported rate (highest first), validates it with ping round trips and measures the link
+     * throughput. A rate the device does not answer on costs a receive timeout.
+     * Stays connected at the rate with the highest measured throughput, or at config.baudrate if none answered.
+     *
+     * @param config Serial config (port and fallback baud rate).
+     * @param selected_baudrate The selected baud rate, use it in the SerialConfig of other connections to the device.
+     * @return SerialStatus::Success if a working baud rate was found.
+     */
+    Status TuneBaudrate(const SerialConfig& config, unsigned int& selected_baudrate);
+
 private:
     RealSenseID::DeviceControllerImpl* _impl = nullptr;
 };
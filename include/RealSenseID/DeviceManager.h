@@ -0,0 +1,175 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/FaceAuthenticator.h"
+#include "RealSenseID/LinkMonitor.h"
+#include "RealSenseID/SerialConfig.h"
+#include "RealSenseID/Status.h"
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace RealSenseID
+{
+class DeviceManagerImpl;
+
+/**
+ * Device manager. Drives multiple devices from one process.
+ * Each device gets its own FaceAuthenticator, operations on the devices run on a fixed pool of worker threads.
+ * Operations on the same device run one at a time, highest priority first and in the order they were submitted within
+ * a priority. Operations on different devices run concurrently (up to the number of workers). No thread is created per
+ * device or per operation.
+ */
+class RSID_API DeviceManager
+{
+public:
+    static constexpr unsigned int DefaultWorkers = 4;
+
+    /**
+     * Operation to run on a device. device_index is the index of the device in the config list given to Connect().
+     * Callbacks of the FaceAuthenticator calls are invoked on the worker thread running the operation.
+     */
+    using Operation = std::function<void(FaceAuthenticator& authenticator, std::size_t device_index)>;
+
+    /**
+     * Step of a bulk job (see SubmitSteps()), a batch of its device transactions.
+     * Returns true if the job has more steps to run.
+     */
+    using Step = std::function<bool(FaceAuthenticator& authenticator, std::size_t device_index)>;
+
+    /**
+     * Priority of the queued operations of a device. A running operation is not interrupted (except by Cancel(), which
+     * does not queue), a higher priority one runs next.
+     */
+    enum class Priority
+    {
+        Low,    // admin and bulk operations (user queries, features import/export)
+        Normal, // enrollments
+        High    // interactive authentications
+    };
+
+#ifdef RSID_SECURE
+    /**
+     * @param[in] callback Signature callback used by all the devices' secure sessions.
+     * @param[in] workers Number of worker threads (at least 1).
+     */
+    DeviceManager(SignatureCallback* callback, unsigned int workers = DefaultWorkers);
+#else
+    /**
+     * @param[in] workers Number of worker threads (at least 1).
+     */
+    explicit DeviceManager(unsigned int workers = DefaultWorkers);
+#endif
+    ~DeviceManager();
+
+    DeviceManager(const DeviceManager&) = delete;
+    DeviceManager& operator=(const DeviceManager&) = delete;
+
+    /**
+     * Connect to the devices with the given serial configs, concurrently on the worker pool.
+     * Disconnects the previous devices first (waits for their operations to complete).
+     *
+     * @param[in] configs Serial config per device.
+     * @return Status::Ok if all the devices connected, or the status of the first failed device otherwise.
+     * Connect status of each device is available with DeviceStatus().
+     */
+    Status Connect(const std::vector<SerialConfig>& configs);
+
+    /**
+     * Connect to all the devices found by DiscoverDevices().
+     *
+     * @param[in] baudrate Baud rate of the devices' serial links.
+     * @return Status::Ok if devices were found and all of them connected.
+     */
+    Status ConnectDiscovered(unsigned int baudrate = SerialConfig().baudrate);
+
+    /**
+     * Wait for the pending operations and disconnect from all the devices.
+     */
+    void Disconnect();
+
+    /**
+     * @return number of devices (connected or not) given to the last Connect().
+     */
+    std::size_t DeviceCount() const;
+
+    /**
+     * @param[in] device_index Device index.
+     * @return connect status of the device (Status::Error for an invalid index).
+     */
+    Status DeviceStatus(std::size_t device_index) const;
+
+    /**
+     * Queue an operation on a device. Returns immediately, the operation runs on the worker pool.
+     *
+     * @param[in] device_index Device index.
+     * @param[in] operation Operation to run.
+     * @param[in] priority Priority of the operation among the device's queued operations.
+     * @return Status::Ok if queued, Status::Error if the device index is invalid or the device is not connected.
+     */
+    Status Submit(std::size_t device_index, Operation operation, Priority priority = Priority::Normal);
+
+    /**
+     * Queue a bulk job on a device, run as a sequence of steps. Each step is queued after the previous one returned,
+     * so operations of a higher priority submitted meanwhile run between the steps: a long transfer split in small
+     * steps delays an authentication by one step at most.
+     *
+     * @param[in] device_index Device index.
+     * @param[in] step Step of the job, called until it returns false.
+     * @param[in] priority Priority of the job's steps.
+     * @return Status::Ok if queued, Status::Error if the device index is invalid or the device is not connected.
+     */
+    Status SubmitSteps(std::size_t device_index, Step step, Priority priority = Priority::Low);
+
+    /**
+     * Queue an operation on every connected device.
+     *
+     * @param[in] operation Operation to run on each device.
+     * @param[in] priority Priority of the operation.
+     * @return number of devices the operation was queued on.
+     */
+    std::size_t SubmitAll(const Operation& operation, Priority priority = Priority::Normal);
+
+    /**
+     * Block until all the queued operations have completed.
+     * Must not be called from an operation (same for Connect() and Disconnect()).
+     */
+    void WaitIdle();
+
+    /**
+     * Cancel the running operation of a device (FaceAuthenticator::Cancel).
+     * Operations still queued are not affected.
+     *
+     * @param[in] device_index Device index.
+     * @return Status of the cancel, Status::Error if the device index is invalid or the device is not connected.
+     */
+    Status Cancel(std::size_t device_index);
+
+    /**
+     * Cancel the running operation of every device (FaceAuthenticator::Cancel).
+     * Operations still queued are not affected.
+     */
+    void CancelAll();
+
+    /**
+     * Monitor the links of the connected devices with pings in their idle time (see LinkMonitorConfig), reconnecting
+     * degraded links. The pings run as operations of the devices, so WaitIdle() waits for a running one as well.
+     * A device whose reconnect failed is not connected (see DeviceStatus()), the monitor keeps reconnecting it.
+     *
+     * @param[in] config Monitor config, maxIntervalMs 0 disables the monitor.
+     */
+    void SetLinkMonitor(const LinkMonitorConfig& config);
+
+    /**
+     * @param[in] device_index Device index.
+     * @param[out] quality Link quality of the device since it was connected.
+     * @return Status::Ok, Status::Error for an invalid index.
+     */
+    Status GetLinkQuality(std::size_t device_index, LinkQuality& quality) const;
+
+private:
+    RealSenseID::DeviceManagerImpl* _impl = nullptr;
+};
+} // namespace RealSenseID
@@ -15,9 +15,15 @@ struct RSID_API DeviceInfo
     static constexpr std::size_t MaxBufferSize = 256;
 
     char serialPort[MaxBufferSize];
-
+    int captureNumber;                   // camera number of the device (PreviewConfig::cameraNumber), -1 if not found
+    char firmwareVersion[MaxBufferSize]; // same as DeviceController::QueryFirmwareVersion(), empty if not answered
 };
 
+/**
+ * Find the connected devices.
+ * The devices' serial ports are probed in parallel for their firmware versions. The result is cached until a device
+ * is connected, disconnected or re-enumerated (e.g. rebooted after firmware update), where the platform can tell.
+ */
 std::vector<DeviceInfo> RSID_API DiscoverDevices();
 std::vector<int> RSID_API DiscoverCapture();
 
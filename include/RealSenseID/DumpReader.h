@@ -0,0 +1,65 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+#include "Preview.h"
+
+namespace RealSenseID
+{
+class DumpReaderImpl;
+
+/**
+ * Playback of dump recordings (Preview::StartRecording).
+ * Frames are read by index, in any order, using the file's index (rebuilt by scanning the file if the recording
+ * was not stopped).
+ */
+class RSID_API DumpReader
+{
+public:
+    DumpReader();
+    ~DumpReader();
+
+    DumpReader(const DumpReader&) = delete;
+    DumpReader& operator=(const DumpReader&) = delete;
+
+    /**
+     * Open a recording.
+     *
+     * @param path Recording file.
+     * @return True on success.
+     */
+    bool Open(const char* path);
+
+    /**
+     * Close the recording.
+     */
+    void Close();
+
+    /**
+     * @return Number of frames in the recording.
+     */
+    unsigned int GetFrameCount() const;
+
+    /**
+     * @return Max size of the frames, the buffer size needed by ReadFrame().
+     */
+    unsigned int GetFrameSize() const;
+
+    /**
+     * Read a frame.
+     *
+     * @param index Frame index in [0, GetFrameCount()).
+     * @param buffer Buffer of buffer_size bytes to read the RAW image to.
+     * @param buffer_size Size of buffer, at least the frame's size.
+     * @param image Image with its size, dimensions, number, metadata and timing (the capture timestamp and dequeue
+     * time of the recorded image). image.buffer is set to buffer.
+     * @return True on success.
+     */
+    bool ReadFrame(unsigned int index, unsigned char* buffer, unsigned int buffer_size, Image& image);
+
+private:
+    DumpReaderImpl* _impl = nullptr;
+};
+} // namespace RealSenseID
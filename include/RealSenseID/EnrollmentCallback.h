@@ -6,6 +6,7 @@
 #include "FacePose.h"
 #include "FaceRect.h"
 #include "EnrollStatus.h"
+#include <cstddef>
 #include <vector>
 
 namespace RealSenseID
@@ -49,5 +50,18 @@ public:
     {
         //default empty impl for backward compatibilty
     }
+
+    /**
+     * Allocation free version of OnFaceDetected(), called by the SDK instead of it.
+     * The default implementation copies the faces to a vector and calls OnFaceDetected(), override this one to avoid
+     * the allocation per FaceDetected message (e.g. in long running loops).
+     *
+     * @param[in] faces Detected faces, valid during the call. First item is the selected one for the operation.
+     * @param[in] count Number of faces.
+     */
+    virtual void OnFacesDetected(const FaceRect* faces, size_t count)
+    {
+        OnFaceDetected(std::vector<FaceRect>(faces, faces + count));
+    }
 };
 } // namespace RealSenseID
@@ -0,0 +1,20 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+
+namespace RealSenseID
+{
+/**
+ * Events of the device flows the host subscribes to (see FaceAuthenticator::SetEventSubscription()). The results,
+ * enroll progress and replies are always sent.
+ */
+struct RSID_API EventSubscription
+{
+    bool hints = true;                       // OnHint() events of the device
+    bool facesDetected = true;               // OnFaceDetected()/OnFacesDetected() events
+    unsigned int faceDetectedIntervalMs = 0; // min time between the face events, 0 for all of them (max 65535)
+};
+} // namespace RealSenseID
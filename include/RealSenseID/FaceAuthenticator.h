@@ -3,15 +3,24 @@
 
 #pragma once
 
+#include "RealSenseID/AsyncOperation.h"
 #include "RealSenseID/DeviceConfig.h"
 #include "RealSenseID/AuthenticationCallback.h"
+#include "RealSenseID/CallbackDispatch.h"
+#include "RealSenseID/EventSubscription.h"
+#include "RealSenseID/ClockSync.h"
+#include "RealSenseID/AuthLoopConfig.h"
 #include "RealSenseID/AuthFaceprintsExtractionCallback.h"
 #include "RealSenseID/EnrollFaceprintsExtractionCallback.h"
 #include "RealSenseID/EnrollmentCallback.h"
 #include "RealSenseID/Faceprints.h"
+#include "RealSenseID/FeaturesTransferCallback.h"
 #include "RealSenseID/SerialConfig.h"
 #include "RealSenseID/SignatureCallback.h"
 #include "RealSenseID/Status.h"
+#include "RealSenseID/TransferCoordinator.h"
+#include "RealSenseID/UserDigest.h"
+#include "RealSenseID/UserIdsCallback.h"
 #include "RealSenseID/MatchResultHost.h"
 #include <cstddef>
 
@@ -67,6 +76,57 @@ public:
      */
     void Disconnect();
 
+    /**
+     * Keep the device session open between operations.
+     * An operation started within timeout_ms of the last message exchanged with the device reuses the session
+     * instead of starting a new one (no StartSession round trip, no key exchange in secure mode).
+     * The session is restarted after any communication error, cancel or reconnect.
+     *
+     * @param[in] timeout_ms Max idle time of the session in milliseconds. 0 (default) starts a new session per
+     * operation.
+     */
+    void SetSessionReuseTimeout(unsigned int timeout_ms);
+
+    /**
+     * Reconnect automatically when the device drops off the serial port (e.g. unplugged or rebooted).
+     * When an operation finds the connection lost (or an earlier reconnect failed), the serial port of the last
+     * Connect(SerialConfig) is reopened, retried until timeout_ms, and a session is started before the operation
+     * proceeds. The host keys of the secure session are kept, so the key exchange doesn't regenerate them.
+     * Use a stable port name (e.g. /dev/serial/by-id/... on Linux) if the os may renumber the port.
+     *
+     * @param[in] timeout_ms Max time to wait for the device to come back. 0 (default) disables reconnect.
+     */
+    void SetAutoReconnect(unsigned int timeout_ms);
+
+    /**
+     * Deliver the callback events of Enroll, Authenticate, AuthenticateLoop and DetectSpoof on a dispatcher thread.
+     * The flow queues the events and goes on receiving the device's packets, so a slow callback doesn't hold up the
+     * flow. Overflow of the bounded queue is handled by the config's policy. Results are never dropped, and the flow
+     * returns after all of its events were delivered. Must not be called while a flow is running.
+     *
+     * @param[in] config Queue policy and size. CallbackQueuePolicy::Inline (default) calls back on the flow's thread.
+     */
+    void SetCallbackDispatch(const CallbackDispatchConfig& config);
+
+    /**
+     * Select the events the device sends during Enroll, Authenticate, AuthenticateLoop and DetectSpoof, e.g. no hints
+     * or fewer face detections for a host that doesn't show them. The unsubscribed callbacks are not called. Sent to
+     * the device with the next session start (a reused session is restarted). Devices that don't support it still
+     * send all the events, the host drops the unsubscribed ones. Must not be called while a flow is running.
+     *
+     * @param[in] subscription Events to receive. Default: all of them.
+     */
+    void SetEventSubscription(const EventSubscription& subscription);
+
+    /**
+     * Mark the bulk transfers (ExportAllFeatures(), ExportFeatures(), QueryUserDigests() and ImportFeatures()) on
+     * the coordinator, so a preview streaming over the same USB connection reduces its frame rate while they run.
+     * The coordinator must outlive the authenticator or be unset first. Must not be called while a flow is running.
+     *
+     * @param[in] coordinator Coordinator shared with the preview (PreviewConfig::transferCoordinator), nullptr to stop.
+     */
+    void SetTransferCoordinator(TransferCoordinator* coordinator);
+
 #ifdef RSID_SECURE
     /**
      * Send updated host ecdsa key to device, sign it with previous ecdsa key (at first pair can sign with dummy key)
@@ -86,6 +146,16 @@ public:
      * @return Status (Status::Ok on success).
      */
     Status Unpair();
+
+    /**
+     * Set the lifetime of the host's session key (ECDH key pair).
+     * Sessions started within the lifetime reuse the signed key, so the signature callback is not called and, if the
+     * device presents the same key, the shared secret is not recomputed. A new key pair is generated once the
+     * lifetime is over (forward secrecy), and after pairing.
+     *
+     * @param[in] lifetime_seconds Key lifetime in seconds (default 3600). 0 generates a new key for every session.
+     */
+    void SetSessionKeyLifetime(unsigned int lifetime_seconds);
 #endif // RSID_SECURE
 
     /**
@@ -93,6 +163,11 @@ public:
      */
     static constexpr size_t MAX_USERID_LENGTH = 31;
 
+    /**
+     * Max number of faces per frame of the multi-face extraction loop
+     */
+    static constexpr unsigned int MAX_LOOP_FACES = 10;
+
     /**
      * Enroll a user.
      * Starts the enrollment process, which starts the camera, captures frames and then extracts
@@ -129,6 +204,17 @@ public:
      */
     Status AuthenticateLoop(AuthenticationCallback& callback);
 
+    /**
+     * Start Authentication Loop with a reporting policy.
+     * Same as AuthenticateLoop(), but results and hints are filtered by the config (e.g. a user standing in front of
+     * the camera is reported once per config.duplicateWindowMs instead of on every frame).
+     *
+     * @param[in] callback User defined callback object to handle the process updates.
+     * @param[in] config Reporting policy.
+     * @return Status (Status::Ok on success).
+     */
+    Status AuthenticateLoop(AuthenticationCallback& callback, const AuthLoopConfig& config);
+
     /**
      * Detect a spoof attempt.
      * This is advanced mode feature, please check if FW supports it using QueryDeviceConfig API.
@@ -156,6 +242,17 @@ public:
      */
     Status RemoveUser(const char* user_id);
 
+    /**
+     * Attempt to remove the given users from the device.
+     * Faster than calling RemoveUser() for each user: the requests are sent over one session without waiting for the
+     * previous replies. Users that fail to be removed (e.g. not enrolled) do not stop the removal of the others.
+     *
+     * @param[in] user_ids Unique ids (null terminated ascii, 31 bytes max) of the users that should be removed.
+     * @param[in] number_of_users Number of ids in user_ids.
+     * @return Status (Status::Ok if all the users were removed, otherwise the status of the first user that failed).
+     */
+    Status RemoveUsers(const char* const* user_ids, unsigned int number_of_users);
+
     /**
      * Attempt to remove all users from the device.
      *
@@ -175,9 +272,10 @@ public:
      * Query FW authentication settings.
      *
      * @param[out] device_config config with settings.
+     * @param[in] force_refresh Query the device even if the config is cached on the host (see SetHostCache()).
      * @return Status (Status::Ok on success).
      */
-    Status QueryDeviceConfig(DeviceConfig& device_config);
+    Status QueryDeviceConfig(DeviceConfig& device_config, bool force_refresh = false);
 
     /**
      * Query the device about all enrolled users.
@@ -185,17 +283,40 @@ public:
      * @param[out] pre-allocated array of user ids. app is expected to allocated array of length = QueryNumberOfUsers(),
      * each entry in the array is string of size = MAX_USERID_LENGTH
      * @param[in/out] number of users to retrieve.
+     * @param[in] force_refresh Query the device even if the user ids are cached on the host (see SetHostCache()).
      * @return Status (Status::Ok on success).
      */
-    Status QueryUserIds(char** user_ids, unsigned int& number_of_users_in_out);
+    Status QueryUserIds(char** user_ids, unsigned int& number_of_users_in_out, bool force_refresh = false);
+
+    /**
+     * Query the device about all enrolled users, without knowing their number in advance.
+     * The user ids are passed to the callback as they arrive from the device.
+     *
+     * @param[in] callback User defined callback object to receive the user ids.
+     * @param[in] force_refresh Query the device even if the user ids are cached on the host (see SetHostCache()).
+     * @return Status (Status::Ok on success). On failure the callback may have received part of the user ids.
+     */
+    Status QueryUserIds(UserIdsCallback& callback, bool force_refresh = false);
 
     /**
      * Query the device about the number of enrolled users.
      *
      * @param[out] number of users.
+     * @param[in] force_refresh Query the device even if the user ids are cached on the host (see SetHostCache()).
      * @return Status (Status::Ok on success).
      */
-    Status QueryNumberOfUsers(unsigned int& number_of_users);
+    Status QueryNumberOfUsers(unsigned int& number_of_users, bool force_refresh = false);
+
+    /**
+     * Cache the device config and the enrolled user ids on the host.
+     * When enabled, QueryDeviceConfig(), QueryUserIds() and QueryNumberOfUsers() are answered from the cache instead
+     * of the device. The cache is populated on connect (and queried again after it was invalidated), updated by
+     * SetDeviceConfig(), RemoveUser(), RemoveUsers() and RemoveAll(), and invalidated by Enroll(),
+     * SetUserFeatures(), ImportFeatures() and reconnects. Changes made to the device by other hosts are not seen until force_refresh.
+     *
+     * @param[in] enable Enable the cache (default disabled).
+     */
+    void SetHostCache(bool enable);
 
     /**
      * Prepare device to standby - for now it's saving database of users to flash.
@@ -204,6 +325,54 @@ public:
      */
     Status Standby();
 
+    static constexpr unsigned int DefaultPrewarmHoldMs = 5000;
+
+    /**
+     * Bring the device out of standby and start the session ahead of the next request, e.g. when a person approaches
+     * (a proximity sensor, or a face in the preview, see Preview::SetPrewarm()), so that the next Authenticate() does
+     * not pay the wake up and the session setup. Pings the device until it answers, then starts the session (with the
+     * key exchange on secure sessions) and keeps it for the next request within hold_ms, even if session reuse is
+     * disabled (see SetSessionReuseTimeout()). The time until the session was ready is recorded in
+     * Metrics::Latency::Wake.
+     *
+     * @param[in] hold_ms Max time from the prewarm to the next request for it to take the session.
+     * @return Status (Status::Ok once the session is ready).
+     */
+    Status Prewarm(unsigned int hold_ms = DefaultPrewarmHoldMs);
+
+    /**
+     * Round trip of a small ping packet to the device, sent outside of the session (a reused session is kept).
+     * Used by the link monitor of DeviceManager. Late replies of earlier pings are skipped.
+     *
+     * @param[in] timeout_ms Max time to wait for the reply.
+     * @return Status (Status::Ok if the device echoed the ping).
+     */
+    Status Ping(unsigned int timeout_ms = 1000);
+
+    /**
+     * Estimate the device clock against the host's steady clock with timestamped pings (NTP style), sent outside of
+     * the session as Ping(). Each call adds its exchanges to the estimate of the last 64, so calling it again now and
+     * then tracks the drift. Once synced, device timestamps (e.g. ImageMetadata::timestamp) are converted to host time
+     * (ImageTiming::deviceCaptureTime) for the latency breakdowns of the metrics and traces.
+     *
+     * @param[in] exchanges Pings to send.
+     * @param[in] timeout_ms Max time to wait for each reply.
+     * @return Status (Status::VersionMismatch if the firmware doesn't stamp pings).
+     */
+    Status SyncClock(unsigned int exchanges = 8, unsigned int timeout_ms = 1000);
+
+    /**
+     * Current estimate of the device clock (see SyncClock()).
+     */
+    ClockSyncState GetClockSync() const;
+
+    /**
+     * Host steady clock time of a device clock time, in microseconds.
+     *
+     * @return False if the clock isn't synced (see SyncClock()).
+     */
+    bool DeviceTimeToHost(uint64_t device_us, uint64_t& host_us) const;
+
     /**************************************************************************/
     /*************************** Host Mode Methods ****************************/
     /**************************************************************************/
@@ -241,6 +410,17 @@ public:
      */
     Status ExtractFaceprintsForAuthLoop(AuthFaceprintsExtractionCallback& callback);
 
+    /**
+     * Faceprints extraction loop as above, extracting up to max_faces faces per frame (e.g. people queuing at a wide
+     * gate). The faceprints of all the faces of a frame are passed in one call to callback.OnQueryResults().
+     * Firmware without multi-face support extracts a single face per frame, passed as a result of one face.
+     *
+     * @param[in] callback User defined callback object to handle the process updates.
+     * @param[in] max_faces Max number of faces per frame, 1 to MAX_LOOP_FACES.
+     * @return Status (Status::Ok on success).
+     */
+    Status ExtractFaceprintsForAuthLoop(AuthFaceprintsExtractionCallback& callback, unsigned int max_faces);
+
     /**
      * Match two faceprints to each other.
      * Calculates a score for how similar the two faceprints are, and returns a prediction for whether the
@@ -255,6 +435,34 @@ public:
     MatchResultHost MatchFaceprints(Faceprints& new_faceprints, Faceprints& existing_faceprints,
                                     Faceprints& updated_faceprints);
 
+    /**
+     * Match faceprints against an array of faceprints (1:N) in a single call.
+     * Returns the best match whose score passed the match threshold.
+     *
+     * @param[in] new_faceprints faceprints which were extracted from a single image of a person.
+     * @param[in] existing_faceprints_array faceprints of the users to search.
+     * @param[in] count number of elements in existing_faceprints_array.
+     * @param[out] updated_faceprints the matched user's updated faceprints, if the 'should_update' field is set.
+     * @return MatchArrayResultHost match result, the 'index' field is the matched element of the array.
+     */
+    MatchArrayResultHost MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                const Faceprints* existing_faceprints_array, size_t count,
+                                                Faceprints& updated_faceprints);
+
+    /**
+     * Find the k faceprints of an array most similar to the given faceprints, in a single call.
+     * Candidates are sorted by descending score, regardless of the match threshold.
+     *
+     * @param[in] new_faceprints faceprints which were extracted from a single image of a person.
+     * @param[in] existing_faceprints_array faceprints of the users to search.
+     * @param[in] count number of elements in existing_faceprints_array.
+     * @param[in] k max number of candidates.
+     * @param[out] candidates array of at least k elements to write the candidates into.
+     * @return Number of candidates written (0 if the faceprints failed validation).
+     */
+    size_t MatchFaceprintsTopK(const Faceprints& new_faceprints, const Faceprints* existing_faceprints_array,
+                               size_t count, size_t k, MatchCandidateHost* candidates);
+
     /**
      * Get the features descriptor associated with the given user ID.
      * The user IDs passed to this function need to be discovered by previously calling QueryUserIds()
@@ -277,6 +485,124 @@ public:
      */
     Status SetUserFeatures(const char* user_id, Faceprints& user_faceprints);
 
+    /**
+     * Export the features descriptors of all users in the device's database.
+     * Several requests are kept in flight, so the export does not wait a full round trip per user.
+     *
+     * @param[in] callback Receives each user's features and the export progress.
+     * @return Status (Status::Ok on success).
+     */
+    Status ExportAllFeatures(FeaturesExportCallback& callback);
+
+    /**
+     * Export the features descriptors of the given users only (see ExportAllFeatures()), e.g. the users whose
+     * digests changed (see QueryUserDigests()).
+     *
+     * @param[in] user_ids Array of valid user IDs.
+     * @param[in] number_of_users Length of the array.
+     * @param[in] callback Receives each user's features, in the order of user_ids, and the export progress.
+     * @return Status (Status::Ok on success).
+     */
+    Status ExportFeatures(const char* const* user_ids, unsigned int number_of_users, FeaturesExportCallback& callback);
+
+    /**
+     * Query a compact digest (user id, FeaturesHash() of the features and update counter) of all enrolled users, so
+     * a host keeping a copy of the device's database transfers only the users that changed: users whose hash differs
+     * from the host's copy are pulled with ExportFeatures(), host users missing or different on the device are
+     * pushed with ImportFeatures().
+     * The device does not compute digests, the host keeps them for the users it transferred (GetUserFeatures(),
+     * SetUserFeatures(), ExportAllFeatures(), ExportFeatures(), ImportFeatures()) and for users authenticated by it.
+     * Only users without a known digest (new to this host, enrolled, or possibly updated by an authentication) have
+     * their features read from the device, the rest costs only the user ids query.
+     * Changes made to the device by other hosts are not seen until force_refresh.
+     *
+     * @param[in] callback User defined callback object to receive the digests.
+     * @param[in] force_refresh Read the features of all users from the device and recompute their digests.
+     * @return Status (Status::Ok on success). On failure the callback may have received part of the digests.
+     */
+    Status QueryUserDigests(UserDigestsCallback& callback, bool force_refresh = false);
+
+    /**
+     * Insert the given features descriptors into the device's database (see SetUserFeatures()).
+     * Several requests are kept in flight, so the import does not wait a full round trip per user.
+     * Stops on the first user which could not be inserted, the users before it are kept.
+     *
+     * @param[in] user_ids Array of valid user IDs.
+     * @param[in] user_faceprints Array of user FacePrints, one per user ID.
+     * @param[in] number_of_users Length of the arrays.
+     * @param[in] callback Optional progress callback.
+     * @return Status (Status::Ok on success).
+     */
+    Status ImportFeatures(const char* const* user_ids, const Faceprints* user_faceprints, unsigned int number_of_users,
+                          FeaturesTransferCallback* callback = nullptr);
+
+    /**************************************************************************/
+    /***************************** Async Methods ******************************/
+    /**************************************************************************/
+
+    /*
+     * Non blocking versions of the device flows. Each returns immediately with a handle of the operation, which runs
+     * on the SDK's executor threads (see AsyncOperation). The flow's callback is invoked on the executor thread and
+     * must stay valid until the operation is done. Operations of this authenticator run one at a time, in order.
+     * Other methods (except Cancel()) must not be called while async operations are pending.
+     * Destroying the authenticator cancels its pending operations and waits for the running one.
+     * The completion, if given, is called with the flow's status once the operation is done.
+     */
+
+    /**
+     * Async Enroll().
+     */
+    AsyncOperation EnrollAsync(EnrollmentCallback& callback, const char* user_id,
+                               AsyncOperation::Completion completion = nullptr);
+
+    /**
+     * Async Authenticate().
+     */
+    AsyncOperation AuthenticateAsync(AuthenticationCallback& callback, AsyncOperation::Completion completion = nullptr);
+
+    /**
+     * Async AuthenticateLoop(). Cancel the operation (or call Cancel()) to stop the loop.
+     */
+    AsyncOperation AuthenticateLoopAsync(AuthenticationCallback& callback,
+                                         AsyncOperation::Completion completion = nullptr);
+
+    /**
+     * Async AuthenticateLoop() with a reporting policy.
+     */
+    AsyncOperation AuthenticateLoopAsync(AuthenticationCallback& callback, const AuthLoopConfig& config,
+                                         AsyncOperation::Completion completion = nullptr);
+
+    /**
+     * Async Prewarm(), e.g. from the event handler of a proximity sensor. Operations started after it (e.g.
+     * AuthenticateAsync()) run once the session is ready. While a prewarm is pending its handle is returned instead of
+     * starting another one (and the completion is not called), so it can be requested on every event.
+     */
+    AsyncOperation PrewarmAsync(unsigned int hold_ms = DefaultPrewarmHoldMs,
+                                AsyncOperation::Completion completion = nullptr);
+
+    /**
+     * Async DetectSpoof().
+     */
+    AsyncOperation DetectSpoofAsync(AuthenticationCallback& callback, AsyncOperation::Completion completion = nullptr);
+
+    /**
+     * Async ExtractFaceprintsForEnroll().
+     */
+    AsyncOperation ExtractFaceprintsForEnrollAsync(EnrollFaceprintsExtractionCallback& callback,
+                                                   AsyncOperation::Completion completion = nullptr);
+
+    /**
+     * Async ExtractFaceprintsForAuth().
+     */
+    AsyncOperation ExtractFaceprintsForAuthAsync(AuthFaceprintsExtractionCallback& callback,
+                                                 AsyncOperation::Completion completion = nullptr);
+
+    /**
+     * Async ExtractFaceprintsForAuthLoop(). Cancel the operation (or call Cancel()) to stop the loop.
+     */
+    AsyncOperation ExtractFaceprintsForAuthLoopAsync(AuthFaceprintsExtractionCallback& callback,
+                                                     AsyncOperation::Completion completion = nullptr);
+
 private:
     FaceAuthenticatorImpl* _impl = nullptr;
 };
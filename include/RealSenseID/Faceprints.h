@@ -9,6 +9,7 @@ Copyright(c) 2011-2020 Intel Corporation. All Rights Reserved.
 
 #include <cstddef>
 #include <cstdint> 
+#include <cstring>
 
 namespace RealSenseID
 {
@@ -41,4 +42,36 @@ public:
     feature_t avgDescriptor[FEATURES_VECTOR_ALLOC_SIZE];
     feature_t origDescriptor[FEATURES_VECTOR_ALLOC_SIZE];
 };
+
+/**
+ * Faceprints of a single authentication scan (the avg descriptor of Faceprints only, as extracted for authentication,
+ * with the device's number of descriptors).
+ * Half the size of Faceprints and cache line aligned, passed on the auth extraction path (see
+ * AuthFaceprintsExtractionCallback::OnQueryResult()) and accepted by the gallery searches.
+ */
+struct alignas(64) QueryFaceprints
+{
+    feature_t descriptor[FEATURES_VECTOR_ALLOC_SIZE];
+    int version = FACE_FACEPRINTS_VERSION;
+    int numberOfDescriptors = 1;
+    FaceprintsTypeEnum featuresType = W10;
+};
+
+// query as Faceprints, with a zero orig descriptor
+inline void ToFaceprints(const QueryFaceprints& query, Faceprints& faceprints)
+{
+    faceprints.version = query.version;
+    faceprints.numberOfDescriptors = query.numberOfDescriptors;
+    faceprints.featuresType = query.featuresType;
+    ::memcpy(faceprints.avgDescriptor, query.descriptor, sizeof(faceprints.avgDescriptor));
+    ::memset(faceprints.origDescriptor, 0, sizeof(faceprints.origDescriptor));
+}
+
+inline void ToQueryFaceprints(const Faceprints& faceprints, QueryFaceprints& query)
+{
+    query.version = faceprints.version;
+    query.numberOfDescriptors = faceprints.numberOfDescriptors;
+    query.featuresType = faceprints.featuresType;
+    ::memcpy(query.descriptor, faceprints.avgDescriptor, sizeof(query.descriptor));
+}
 } // namespace RealSenseID
\ No newline at end of file
@@ -0,0 +1,46 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+namespace RealSenseID
+{
+class Faceprints;
+
+/**
+ * User defined callback for bulk features import.
+ * Callback will be used to provide progress feedback to the client.
+ */
+class FeaturesTransferCallback
+{
+public:
+    virtual ~FeaturesTransferCallback() = default;
+
+    /**
+     * Called to inform the client whenever the transfer of a user's features has completed.
+     *
+     * @param[in] transferred_users Number of users transferred so far.
+     * @param[in] total_users Total number of users to transfer.
+     */
+    virtual void OnProgress(unsigned int transferred_users, unsigned int total_users)
+    {
+        // default empty impl
+    }
+};
+
+/**
+ * User defined callback for bulk features export.
+ * Callback will be used to deliver the exported features to the client.
+ */
+class FeaturesExportCallback : public FeaturesTransferCallback
+{
+public:
+    /**
+     * Called for each exported user, in the device's database order.
+     *
+     * @param[in] user_id User ID.
+     * @param[in] faceprints User FacePrints (features and Version info).
+     */
+    virtual void OnUserFeatures(const char* user_id, const Faceprints& faceprints) = 0;
+};
+} // namespace RealSenseID
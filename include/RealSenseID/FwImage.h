@@ -0,0 +1,78 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+#include <cstddef>
+#include <memory>
+
+namespace RealSenseID
+{
+class FwImageImpl;
+
+/**
+ * Sequential reader of a firmware image, e.g. of its HTTP download (see FwImage::FromReader()).
+ */
+class RSID_API FwImageReader
+{
+public:
+    virtual ~FwImageReader() = default;
+
+    /**
+     * Read the next bytes of the image, waiting for at least one byte.
+     *
+     * @param[out] buffer Buffer of n_bytes.
+     * @param[in] n_bytes Max bytes to read.
+     * @return Number of bytes read, 0 at the end of the image or on error.
+     */
+    virtual size_t Read(void* buffer, size_t n_bytes) = 0;
+
+    /**
+     * Continue reading at the offset (from the start of the image).
+     *
+     * @return False if the reader can't seek (default), the image is then kept in memory as it is read.
+     */
+    virtual bool Seek(size_t offset)
+    {
+        return false;
+    }
+};
+
+/**
+ * Firmware image (the packaged firmware binary) to update from, without a file of the image on disk: a downloaded
+ * image in memory, shared by the updates of several devices, or a reader streaming it (e.g. from the network). The
+ * modules are parsed and their block crcs computed as the image is read, the module data is read again as the
+ * modules are sent (from memory for readers which can't seek).
+ * Copies share the image, and can be used by concurrent updates.
+ */
+class RSID_API FwImage
+{
+public:
+    /**
+     * Image of a file, memory mapped (as the FwUpdater methods taking a path).
+     */
+    static FwImage FromFile(const char* path);
+
+    /**
+     * Image in memory. The data is not copied and must stay valid while the image (or a copy) is used.
+     */
+    static FwImage FromBuffer(const void* data, size_t size);
+
+    /**
+     * Image read from the reader, which must stay valid while the image (or a copy) is used. Calls to the reader are
+     * serialized. A reader which can't seek is read once, the image read so far is kept in memory.
+     */
+    static FwImage FromReader(FwImageReader* reader);
+
+    /**
+     * Name of the image in the logs (the path of a file).
+     */
+    const char* Name() const;
+
+private:
+    friend class FwUpdater;
+    explicit FwImage(std::shared_ptr<FwImageImpl> impl);
+    std::shared_ptr<FwImageImpl> _impl;
+};
+} // namespace RealSenseID
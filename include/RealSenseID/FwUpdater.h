@@ -5,12 +5,19 @@
 
 #include "RealSenseID/RealSenseIDExports.h"
 #include "RealSenseID/Status.h"
+#include "RealSenseID/FwImage.h"
+#include "RealSenseID/TransferCoordinator.h"
 #include "RealSenseID/AndroidSerialConfig.h"
+#include "RealSenseID/AsyncOperation.h"
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
 namespace RealSenseID
 {
+class FwUpdaterImpl;
+
 /**
  * FwUpdater class.
  * Handles firmware update operations.
@@ -25,11 +32,45 @@ public:
     {
         const char* port = nullptr; // serial port to perform the update on
         bool force_full = false;    // if true update all modules and blocks regardless of crc checks
+        // transfer block size: power of 2 from 64 KB to 4 MB supported by the device firmware, 0 for the default
+        // (512 KB). larger blocks take fewer round trips, blocks written with another size are always updated.
+        unsigned int block_size = 0;
+        // send lz4 compressed blocks if the device bootloader supports it, raw blocks otherwise
+        bool compress = false;
+        // pre-stage the update: transfer, verify and validate all the modules but do not reboot into them. the
+        // device keeps running its current firmware until Activate() (e.g. in a maintenance window), so the downtime
+        // is the reboot. a staged update can be canceled and resumed like a normal one.
+        bool stage_only = false;
+        // marks the update's transfer on the coordinator, so a preview of the device reduces its frame rate while
+        // the blocks are sent (see TransferCoordinator). must outlive the update.
+        TransferCoordinator* coordinator = nullptr;
 #ifdef ANDROID
         AndroidSerialConfig android_config;
 #endif
     };
 
+    /**
+     * Detailed firmware update progress, reported at the start, after each block of the modules and at the end.
+     * Blocks already up to date on the device are skipped (done without being sent).
+     */
+    struct UpdateProgress
+    {
+        float progress = 0.0f;             // overall progress, range: 0.0f - 1.0f
+        const char* module = "";           // name of the module of the block ("" at the start)
+        std::size_t module_index = 0;      // of the modules to update
+        std::size_t module_count = 0;
+        std::size_t block_index = 0;       // of the module's blocks
+        std::size_t module_blocks = 0;
+        std::size_t blocks_done = 0;       // blocks of all the modules, sent or skipped
+        std::size_t blocks_total = 0;
+        std::size_t blocks_sent = 0;
+        unsigned long long bytes_sent = 0; // of the sent blocks (compressed size if compressed)
+        unsigned int elapsed_ms = 0;       // since the update started
+        unsigned int transfer_ms = 0;      // sending the blocks and waiting for the device to write them
+        unsigned int last_block_ms = 0;    // of the last sent block
+        float bytes_per_second = 0.0f;     // block throughput: bytes_sent per second of transfer_ms
+    };
+
     /**
      * User defined callback for firmware update events.
      * Callback will be used to provide feedback to the client.
@@ -44,10 +85,75 @@ public:
          * @param[in] progress Current firmware update progress, range: 0.0f - 1.0f.
          */
         virtual void OnProgress(float progress) = 0;
+
+        /**
+         * Called after OnProgress with the detailed progress.
+         *
+         * @param[in] progress Current firmware update progress. The module name is valid during the call.
+         */
+        virtual void OnUpdateProgress(const UpdateProgress& progress)
+        {
+        }
     };
 
-    FwUpdater() = default;
-    ~FwUpdater() = default;
+    /**
+     * Settings of a fleet update (UpdateFleet).
+     */
+    struct FleetSettings
+    {
+        static constexpr unsigned int DefaultMaxConcurrent = 4;
+
+        unsigned int max_concurrent = DefaultMaxConcurrent; // devices updated at the same time (at least 1)
+        unsigned int max_failures = 0; // stop starting updates after this many devices failed, 0 to update all
+    };
+
+    /**
+     * User defined callback for fleet update events.
+     * Calls are serialized (never concurrent), but made from the update threads.
+     */
+    struct FleetEventHandler
+    {
+        virtual ~FleetEventHandler() = default;
+
+        /**
+         * Called to inform the client of the firmware update progress of a device.
+         *
+         * @param[in] device_index Index of the device in the settings list.
+         * @param[in] progress Current firmware update progress of the device, range: 0.0f - 1.0f.
+         */
+        virtual void OnProgress(std::size_t device_index, float progress) = 0;
+
+        /**
+         * Called after OnProgress with the detailed progress of a device.
+         *
+         * @param[in] device_index Index of the device in the settings list.
+         * @param[in] progress Current firmware update progress of the device.
+         */
+        virtual void OnUpdateProgress(std::size_t device_index, const UpdateProgress& progress)
+        {
+        }
+
+        /**
+         * Called when the update of a device finished.
+         *
+         * @param[in] device_index Index of the device in the settings list.
+         * @param[in] status Update result of the device.
+         */
+        virtual void OnDone(std::size_t device_index, Status status)
+        {
+        }
+    };
+
+    FwUpdater();
+
+    /**
+     * Cancels the pending async updates (UpdateAsync) and waits for them to be done.
+     * Must not be called from their handlers or completions.
+     */
+    ~FwUpdater();
+
+    FwUpdater(const FwUpdater&) = delete;
+    FwUpdater& operator=(const FwUpdater&) = delete;
 
     /**
      * Extracts the firmware version from the firmware package.
@@ -58,6 +164,11 @@ public:
      */
     bool ExtractFwVersion(const char* binPath, std::string& outFwVersion, std::string& outRecognitionVersion) const;
 
+    /**
+     * Extracts the firmware version from a firmware image (see FwImage), e.g. a downloaded one in memory.
+     */
+    bool ExtractFwVersion(const FwImage& image, std::string& outFwVersion, std::string& outRecognitionVersion) const;
+
     /**
      * Performs a firmware update.
      *
@@ -68,5 +179,93 @@ public:
      * @return True if extraction succeeded and false otherwise.
      */
     Status Update(EventHandler* handler, Settings settings, const char* binPath, bool excludeRecognition) const;
+
+    /**
+     * Performs a firmware update from a firmware image (see FwImage), e.g. a downloaded one in memory or a reader
+     * streaming it, without a file of the image.
+     */
+    Status Update(EventHandler* handler, Settings settings, const FwImage& image, bool excludeRecognition) const;
+
+    /**
+     * Activates a firmware update pre-staged with Settings::stage_only and reboots the device into it. Only checks
+     * the modules on the device (state and block crcs, no transfer), so it takes about the reboot time.
+     *
+     * @param[in] settings Firmware update settings of the staged update (port and block size).
+     * @param[in] binPath Path to the staged firmware binary file.
+     * @param[in] excludeRecognition As given when staging.
+     * @return Status::Ok if activated, Status::Error if a module of the file is not staged (e.g. the stage was
+     * interrupted or was made with another file) or on communication errors. The device is not rebooted then.
+     */
+    Status Activate(Settings settings, const char* binPath, bool excludeRecognition) const;
+
+    /**
+     * Activates a firmware update pre-staged from the firmware image (see FwImage).
+     */
+    Status Activate(Settings settings, const FwImage& image, bool excludeRecognition) const;
+
+    /**
+     * Starts a firmware update (see Update()) on the SDK's executor threads and returns at once (see AsyncOperation).
+     * Updates run concurrently up to the number of executor threads (AsyncOperation::SetExecutorThreads()), the
+     * others wait for a free thread. The handler is called on the executor thread.
+     * Canceling the handle stops the update with Status::Error: at once while it waits for the device, after the
+     * current write otherwise. The device keeps the blocks written so far, updating it again with the same file
+     * resumes the interrupted module.
+     *
+     * @param[in] handler Responsible for handling events triggered during the update (can be null), must stay valid
+     * until the update is done.
+     * @param[in] settings Firmware update settings (the port name is copied).
+     * @param[in] binPath Path to the firmware binary file (copied).
+     * @param[in] excludeRecognition Skip recognition module update in case of database incompatibility.
+     * @param[in] completion Called once the update is done (see AsyncOperation::Completion).
+     * @return Handle of the update.
+     */
+    AsyncOperation UpdateAsync(EventHandler* handler, Settings settings, const char* binPath, bool excludeRecognition,
+                               AsyncOperation::Completion completion = nullptr) const;
+
+    /**
+     * Starts a firmware update from a firmware image (see FwImage), kept by the update until it is done.
+     */
+    AsyncOperation UpdateAsync(EventHandler* handler, Settings settings, const FwImage& image, bool excludeRecognition,
+                               AsyncOperation::Completion completion = nullptr) const;
+
+    /**
+     * Performs a firmware update of several devices concurrently.
+     * The firmware file is parsed and loaded once and shared by all the updates. Up to max_concurrent devices are
+     * updated at a time, the next device starts as soon as one finishes (rolling).
+     *
+     * @param[in] handler Responsible for handling events triggered during the updates (can be null).
+     * @param[in] devices Firmware update settings of each device.
+     * @param[in] binPath Path to the firmware binary file.
+     * @param[in] excludeRecognition Skip recognition module update in case of database incompatibility.
+     * @param[in] fleetSettings Concurrency and failure limits.
+     * @return Update status of each device (Status::Error for devices not started because of max_failures).
+     */
+    std::vector<Status> UpdateFleet(FleetEventHandler* handler, const std::vector<Settings>& devices,
+                                    const char* binPath, bool excludeRecognition,
+                                    const FleetSettings& fleetSettings) const;
+
+    /**
+     * Performs a firmware update of several devices concurrently with the default FleetSettings.
+     */
+    std::vector<Status> UpdateFleet(FleetEventHandler* handler, const std::vector<Settings>& devices,
+                                    const char* binPath, bool excludeRecognition) const;
+
+    /**
+     * Performs a firmware update of several devices concurrently from one firmware image (see FwImage), e.g. a
+     * downloaded one in memory. The image is read once for all the devices.
+     */
+    std::vector<Status> UpdateFleet(FleetEventHandler* handler, const std::vector<Settings>& devices,
+                                    const FwImage& image, bool excludeRecognition,
+                                    const FleetSettings& fleetSettings) const;
+
+    /**
+     * Performs a firmware update of several devices concurrently from one firmware image with the default
+     * FleetSettings.
+     */
+    std::vector<Status> UpdateFleet(FleetEventHandler* handler, const std::vector<Settings>& devices,
+                                    const FwImage& image, bool excludeRecognition) const;
+
+private:
+    FwUpdaterImpl* _impl;
 };
 } // namespace RealSenseID
@@ -0,0 +1,252 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/Faceprints.h"
+#include "RealSenseID/MatchResultHost.h"
+#include "RealSenseID/Metrics.h"
+#include "RealSenseID/RealSenseIDExports.h"
+#include <cstddef>
+
+namespace RealSenseID
+{
+class FaceprintsGallery;
+
+namespace Metrics
+{
+class MatchScoreHistogram;
+}
+
+/**
+ * Reason a record of a bulk import was rejected.
+ */
+enum class ImportRecordError
+{
+    InvalidRecord,     // the record could not be decoded
+    InvalidFaceprints, // no descriptor or features out of the valid range
+    DuplicateUserId    // id of a user already in the gallery or earlier in the import
+};
+
+/**
+ * Rejected record of a bulk import.
+ */
+struct ImportErrorHost
+{
+    size_t record = 0; // index of the record in the import
+    ImportRecordError error = ImportRecordError::InvalidRecord;
+};
+
+/**
+ * Receives the similar pairs of a gallery as they are found (see HostFaceprintsGallery::FindSimilarPairs()).
+ */
+class RSID_API SimilarPairsCallback
+{
+public:
+    virtual ~SimilarPairsCallback() = default;
+
+    /**
+     * Called with the next pairs found, in no particular order. Calls are serialized, but may come from the worker
+     * threads of the search.
+     *
+     * @return False to stop the search.
+     */
+    virtual bool OnPairs(const SimilarPairHost* pairs, size_t count) = 0;
+};
+
+/**
+ * Gallery of users' faceprints for host mode matching.
+ * The faceprints are kept packed in native memory (one row of FEATURES_VECTOR_ALLOC_SIZE features per user), so
+ * matching a scanned user against the gallery is a single call and never copies the users' faceprints.
+ * Not thread safe.
+ */
+class RSID_API HostFaceprintsGallery
+{
+public:
+    HostFaceprintsGallery();
+    ~HostFaceprintsGallery();
+
+    HostFaceprintsGallery(const HostFaceprintsGallery&) = delete;
+    HostFaceprintsGallery& operator=(const HostFaceprintsGallery&) = delete;
+
+    /**
+     * Add a user.
+     *
+     * @param[in] user_id Null terminated C string (truncated to FaceAuthenticator::MAX_USERID_LENGTH - 1 chars).
+     * @param[in] faceprints User's faceprints.
+     * @return Index of the user in the gallery.
+     */
+    size_t Add(const char* user_id, const Faceprints& faceprints);
+
+    /**
+     * Add count users from contiguous arrays.
+     *
+     * @param[in] user_ids count user ids (or nullptr to add the users without ids).
+     * @param[in] avg_descriptors count * FEATURES_VECTOR_ALLOC_SIZE features, the avg vectors of the users in order.
+     * @param[in] orig_descriptors count * FEATURES_VECTOR_ALLOC_SIZE features, the orig vectors of the users (or
+     * nullptr to use the avg vectors).
+     * @param[in] count Number of users.
+     * @param[in] version Faceprints version of all the users.
+     * @param[in] number_of_descriptors Number of descriptors of all the users.
+     * @return Index of the first added user in the gallery.
+     */
+    size_t AddBulk(const char* const* user_ids, const feature_t* avg_descriptors, const feature_t* orig_descriptors,
+                   size_t count, int version = FACE_FACEPRINTS_VERSION, int number_of_descriptors = 1);
+
+    /**
+     * Import users from a faceprints bulk buffer (as written by ExportFile()), in parallel on all the cores.
+     * The records are decoded, validated and their norms computed concurrently, then their ids are indexed. Records
+     * that can't be decoded, fail validation or repeat the id of another user are rejected and reported, the others are
+     * added after the existing users, in the order of the buffer.
+     *
+     * @param[in] buffer Bulk buffer.
+     * @param[in] size Size of the buffer in bytes.
+     * @param[out] errors Array for the first max_errors rejected records (may be nullptr).
+     * @param[in] max_errors Number of elements in errors.
+     * @param[out] num_errors Number of rejected records (may be nullptr).
+     * @return Number of imported users, 0 if the buffer is not a valid bulk buffer.
+     */
+    size_t Import(const unsigned char* buffer, size_t size, ImportErrorHost* errors = nullptr, size_t max_errors = 0,
+                  size_t* num_errors = nullptr);
+
+    /**
+     * Import users from a faceprints bulk file, as Import() above.
+     *
+     * @return Number of imported users, 0 if the file can't be read or is not a bulk file.
+     */
+    size_t ImportFile(const char* path, ImportErrorHost* errors = nullptr, size_t max_errors = 0,
+                      size_t* num_errors = nullptr);
+
+    /**
+     * Write all the users to a faceprints bulk file (about 700 bytes per user), for ImportFile().
+     *
+     * @return False on failure, or if the features of a user are out of the valid range.
+     */
+    bool ExportFile(const char* path) const;
+
+    /**
+     * Write all the users to an Arrow IPC file (the Arrow file format, "Feather V2"), for analytics tools which memory
+     * map it and read its columns without parsing: user_id (utf8), avg_descriptor and orig_descriptor
+     * (fixed_size_list<int16>[FEATURES_VECTOR_ALLOC_SIZE]), version, number_of_descriptors and features_type (int32).
+     * The descriptors are written straight from the packed gallery, in record batches of up to 65536 users.
+     *
+     * @return False on failure.
+     */
+    bool ExportArrowFile(const char* path) const;
+
+    /**
+     * Import users from an Arrow IPC file with the columns of ExportArrowFile() (in any order, other columns are
+     * ignored, the buffers must not be compressed), as Import() above. Null entries are rejected as invalid records.
+     *
+     * @return Number of imported users, 0 if the file can't be read or does not have the gallery columns.
+     */
+    size_t ImportArrowFile(const char* path, ImportErrorHost* errors = nullptr, size_t max_errors = 0,
+                           size_t* num_errors = nullptr);
+
+    /**
+     * Replace the faceprints of a user (e.g. with the updated faceprints of a match).
+     *
+     * @return False if index is out of range.
+     */
+    bool Update(size_t index, const Faceprints& faceprints);
+
+    /**
+     * Remove a user. The last user is moved to its index.
+     *
+     * @return False if index is out of range.
+     */
+    bool Remove(size_t index);
+
+    /**
+     * @return Index of the user, -1 if not found.
+     */
+    int Find(const char* user_id) const;
+
+    /**
+     * @return User id at the given index, nullptr if index is out of range.
+     */
+    const char* UserId(size_t index) const;
+
+    /**
+     * @return False if index is out of range.
+     */
+    bool GetFaceprints(size_t index, Faceprints& faceprints) const;
+
+    void Clear();
+    void Reserve(size_t capacity);
+    size_t Size() const;
+
+    /**
+     * Match faceprints against the gallery (1:N).
+     * The gallery is not changed, call Update(result.index, updated_faceprints) if 'should_update' is set.
+     *
+     * @param[in] new_faceprints faceprints which were extracted from a single image of a person.
+     * @param[out] updated_faceprints the matched user's updated faceprints, if the 'should_update' field is set.
+     * @return MatchArrayResultHost match result, the 'index' field is the matched user's index.
+     */
+    MatchArrayResultHost Match(const Faceprints& new_faceprints, Faceprints& updated_faceprints) const;
+
+    /**
+     * Match the query faceprints of an authentication against the gallery (1:N), as Match() above.
+     */
+    MatchArrayResultHost Match(const QueryFaceprints& query, Faceprints& updated_faceprints) const;
+
+    /**
+     * Verify faceprints against a claimed user (1:1), found by its id in constant time.
+     * Same decision and updated faceprints as Match() would return for the user, independent of the gallery size.
+     * The gallery is not changed, call Update(result.index, updated_faceprints) if 'should_update' is set.
+     *
+     * @param[in] new_faceprints faceprints which were extracted from a single image of a person.
+     * @param[in] user_id Claimed user id.
+     * @param[out] updated_faceprints the user's updated faceprints, if the 'should_update' field is set.
+     * @return MatchArrayResultHost match result, 'success' is false if the user is not found or does not match.
+     */
+    MatchArrayResultHost Verify(const Faceprints& new_faceprints, const char* user_id,
+                                Faceprints& updated_faceprints) const;
+
+    /**
+     * Verify the query faceprints of an authentication against a claimed user (1:1), as Verify() above.
+     */
+    MatchArrayResultHost Verify(const QueryFaceprints& query, const char* user_id,
+                                Faceprints& updated_faceprints) const;
+
+    /**
+     * Find the k users most similar to the given faceprints, sorted by descending score.
+     *
+     * @param[out] candidates array of at least k elements to write the candidates into.
+     * @return Number of candidates written (0 if the faceprints failed validation).
+     */
+    size_t MatchTopK(const Faceprints& new_faceprints, size_t k, MatchCandidateHost* candidates) const;
+
+    /**
+     * Find the k users most similar to the query faceprints of an authentication, as MatchTopK() above.
+     */
+    size_t MatchTopK(const QueryFaceprints& query, size_t k, MatchCandidateHost* candidates) const;
+
+    /**
+     * Find all the pairs of users whose faceprints score above the threshold against each other, e.g. duplicate or
+     * mislabelled enrollments. The gallery is compared with itself in cache sized tiles on a pool of threads, and only
+     * the pairs above the threshold are passed to the callback (the N x N scores are never stored), so it scales to
+     * large galleries.
+     *
+     * @param[in] callback Receives the pairs, returns false to stop the search.
+     * @param[in] threshold Min score of a pair, the identical person threshold of the matcher if negative.
+     * @param[in] num_threads Threads of the search, the number of cores if 0.
+     * @return False if the gallery failed validation or the search was stopped.
+     */
+    bool FindSimilarPairs(SimilarPairsCallback& callback, match_calc_t threshold = -1,
+                          unsigned int num_threads = 0) const;
+
+    /**
+     * Histograms of the best and runner-up scores, confidences and should_update rate of the Match() and Verify()
+     * results of this gallery, since its creation or the last ResetMatchScoreStats(). The results are also counted in
+     * the process wide Metrics::Snapshot.
+     */
+    Metrics::MatchScoreStats GetMatchScoreStats() const;
+    void ResetMatchScoreStats();
+
+private:
+    FaceprintsGallery* _impl = nullptr;
+    Metrics::MatchScoreHistogram* _match_scores = nullptr;
+};
+} // namespace RealSenseID
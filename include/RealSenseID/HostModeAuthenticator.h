@@ -0,0 +1,248 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/AuthenticationCallback.h"
+#include "RealSenseID/EnrollmentCallback.h"
+#include "RealSenseID/FaceAuthenticator.h"
+#include "RealSenseID/Metrics.h"
+#include "RealSenseID/Status.h"
+#include <cstddef>
+
+namespace RealSenseID
+{
+class HostModeAuthenticatorImpl;
+
+/**
+ * What Enroll() does when the enrolled person is already enrolled under another user id (see SetEnrollDedup()).
+ */
+enum class RSID_API EnrollDedupPolicy
+{
+    Off,    // no check, the person may be enrolled under several ids
+    Reject, // the enrollment fails
+    Merge   // the enrolled faceprints replace the existing user's ones, no new user is added
+};
+
+/**
+ * Host mode authenticator.
+ * Runs the host mode flows end to end: the device extracts the faceprints (FaceAuthenticator::ExtractFaceprints*),
+ * the users are matched on the host against a packed in-memory gallery, searched in parallel, and successful matches
+ * that improve a user's faceprints are written back to the gallery and to the database. The users are persisted in a
+ * memory mapped database file with a journal of the changes since the last compaction.
+ * Callbacks are the same as of FaceAuthenticator's device mode flows, with the matched user id in OnResult().
+ * Thread safe, the users can be changed while an authentication loop runs.
+ */
+class RSID_API HostModeAuthenticator
+{
+public:
+    /**
+     * @param[in] authenticator Connected authenticator extracting the faceprints. Must outlive this object.
+     * @param[in] match_threads Number of threads searching the gallery. 0 (default) uses all hardware threads.
+     */
+    explicit HostModeAuthenticator(FaceAuthenticator& authenticator, unsigned int match_threads = 0);
+    ~HostModeAuthenticator();
+
+    HostModeAuthenticator(const HostModeAuthenticator&) = delete;
+    HostModeAuthenticator& operator=(const HostModeAuthenticator&) = delete;
+
+    /**
+     * Open the users database and load its users. The database files are created if missing.
+     *
+     * @param[in] database_path Path of the database file (the journal is database_path + ".journal").
+     * @return True on success.
+     */
+    bool Open(const char* database_path);
+
+    /**
+     * Close the database. Users are unloaded.
+     */
+    void Close();
+
+    /**
+     * Enroll a user (ExtractFaceprintsForEnroll()). An enrolled user with the same id is replaced.
+     *
+     * @param[in] callback User defined callback to handle the process updates.
+     * @param[in] user_id Null terminated C string of ascii chars (max FaceAuthenticator::MAX_USERID_LENGTH bytes
+     * including the terminating zero byte).
+     * @return Status (Status::Ok on success, Status::Error if the faceprints could not be stored).
+     */
+    Status Enroll(EnrollmentCallback& callback, const char* user_id);
+
+    /**
+     * Enroll a user as above, reporting the enrolled user the person was found a duplicate of (see SetEnrollDedup()).
+     *
+     * @param[out] duplicate_user_id FaceAuthenticator::MAX_USERID_LENGTH bytes buffer, set to the id of the user the
+     * new faceprints matched, or to an empty string if none did. May be nullptr.
+     * @return Status (Status::Ok on success, Status::Error if the faceprints could not be stored or were rejected as
+     * a duplicate).
+     */
+    Status Enroll(EnrollmentCallback& callback, const char* user_id, char* duplicate_user_id);
+
+    /**
+     * Check at enroll whether the person is already enrolled under another user id: the new faceprints are searched
+     * in the gallery for a user above the identical person threshold. Large galleries are searched through an inverted
+     * file index (the users of the closest clusters only), so the check stays in the milliseconds at millions of
+     * users. Enrolling an existing user id again is a replacement, not a duplicate.
+     *
+     * @param[in] policy EnrollDedupPolicy::Off (default), Reject or Merge.
+     */
+    void SetEnrollDedup(EnrollDedupPolicy policy);
+
+    /**
+     * Keep the most recently matched users in a small cache resident set, searched before the gallery (e.g. the few
+     * hundred people passing a door many times a day). A match above the strong threshold in the set skips the
+     * search of the whole gallery, so it takes microseconds whatever the number of users. The least recently matched
+     * user is evicted when the set is full.
+     *
+     * @param[in] capacity Number of users in the set, 0 (default) disables it. A few hundred keep it in the cpu's
+     * cache.
+     */
+    void SetHotUsers(size_t capacity);
+
+    /**
+     * Bound the time of the gallery search of Authenticate and AuthenticateLoop, e.g. to keep a decision SLA under
+     * load spikes. After the hot users (see SetHotUsers()) the whole gallery is searched if its recent search time
+     * fits the budget. Otherwise the users of the inverted file index clusters closest to the faceprints are searched
+     * first (large galleries, see SetEnrollDedup()). Either way the search stops at the budget with the best user so
+     * far. Such a decision is counted in Metrics::Counter::InexactMatches. Searches scoped to groups are not bounded.
+     *
+     * @param[in] budget_ms Time from the start of the match to the decision, 0 (default) searches the whole gallery.
+     */
+    void SetSearchBudget(unsigned int budget_ms);
+
+    /**
+     * Authenticate (ExtractFaceprintsForAuth()) and match the user on the host.
+     * OnResult() is called with AuthenticateStatus::Success and the user id if matched, AuthenticateStatus::Forbidden
+     * if not, or with the extraction's error status.
+     *
+     * @param[in] callback User defined callback object to handle the process updates.
+     * @return Status (Status::Ok on success).
+     */
+    Status Authenticate(AuthenticationCallback& callback);
+
+    /**
+     * Authentication loop (ExtractFaceprintsForAuthLoop()), each extraction is matched as in Authenticate().
+     * Call FaceAuthenticator::Cancel() to stop it.
+     *
+     * @param[in] callback User defined callback object to handle the process updates.
+     * @return Status (Status::Ok on success).
+     */
+    Status AuthenticateLoop(AuthenticationCallback& callback);
+
+    /**
+     * Authentication loop as in AuthenticateLoop(), with the reporting policy of the config (see
+     * FaceAuthenticator::AuthenticateLoop()). With AuthLoopConfig::trackFaces the extractions of an authenticated
+     * face track are not matched at all, so the host's matching load follows the people in front of the device
+     * rather than the frames. With AuthLoopConfig::sequentialFrames the frames of a face are decided together, a
+     * full gallery search for the first frame and a few candidate scores for each next one, so a borderline face is
+     * decided on more evidence at little matching cost.
+     * Call FaceAuthenticator::Cancel() to stop it.
+     *
+     * @param[in] callback User defined callback object to handle the process updates.
+     * @param[in] config Reporting and tracking policy.
+     * @return Status (Status::Ok on success).
+     */
+    Status AuthenticateLoop(AuthenticationCallback& callback, const AuthLoopConfig& config);
+
+    /**
+     * Multi-face authentication loop (see FaceAuthenticator::ExtractFaceprintsForAuthLoop()), e.g. for people queuing
+     * at a wide gate. The faces of a frame are matched together in one batch search of the gallery and OnResult() is
+     * called once per face, in the order of the frame's faces.
+     * Call FaceAuthenticator::Cancel() to stop it.
+     *
+     * @param[in] callback User defined callback object to handle the process updates.
+     * @param[in] max_faces Max number of faces per frame, 1 to FaceAuthenticator::MAX_LOOP_FACES.
+     * @return Status (Status::Ok on success).
+     */
+    Status AuthenticateLoop(AuthenticationCallback& callback, unsigned int max_faces);
+
+    /**
+     * Authenticate as in Authenticate(), matching only the users of the given groups (see SetUserGroups()), e.g. the
+     * access list of the site the device is installed at. Only the members of the groups are searched.
+     *
+     * @param[in] callback User defined callback object to handle the process updates.
+     * @param[in] groups Allowed group ids.
+     * @param[in] count Number of groups. A user of none of them is not matched (AuthenticateStatus::Forbidden).
+     * @return Status (Status::Ok on success).
+     */
+    Status Authenticate(AuthenticationCallback& callback, const unsigned int* groups, size_t count);
+
+    /**
+     * Authentication loop as in AuthenticateLoop(), matching only the users of the given groups.
+     * Call FaceAuthenticator::Cancel() to stop it.
+     *
+     * @param[in] callback User defined callback object to handle the process updates.
+     * @param[in] groups Allowed group ids.
+     * @param[in] count Number of groups.
+     * @return Status (Status::Ok on success).
+     */
+    Status AuthenticateLoop(AuthenticationCallback& callback, const unsigned int* groups, size_t count);
+
+    /**
+     * Set the groups of an enrolled user (e.g. the sites or floors whose access lists have the user), replacing its
+     * current ones. Users have no groups when enrolled. Group membership is not stored in the database, set it again
+     * after Open().
+     *
+     * @param[in] user_id Id of the user.
+     * @param[in] groups Group ids. May be nullptr if count is 0.
+     * @param[in] count Number of groups, 0 to remove the user from all the groups.
+     * @return True on success, false if the user was not found.
+     */
+    bool SetUserGroups(const char* user_id, const unsigned int* groups, size_t count);
+
+    /**
+     * Remove a user.
+     *
+     * @param[in] user_id Id of the user.
+     * @return True if the user was removed, false if not found or on failure.
+     */
+    bool RemoveUser(const char* user_id);
+
+    /**
+     * @return Number of enrolled users.
+     */
+    size_t NumberOfUsers() const;
+
+    /**
+     * Histograms of the best and runner-up scores, confidences and should_update rate of the gallery searches of the
+     * authentications since Open(). They are also counted in the process wide Metrics::Snapshot.
+     *
+     * @return Match score statistics of this authenticator.
+     */
+    Metrics::MatchScoreStats GetMatchScoreStats() const;
+
+    /**
+     * Keep the most matched users of the host gallery in the device's own database too, for AuthenticateTiered().
+     * The device's users are queried once here; users of the device that are not in the host gallery are left alone.
+     * Call after Open(), and again after changing the device's database by other means.
+     *
+     * @param[in] capacity Max number of host users on the device, 0 disables the device tier.
+     * @return Status (Status::Ok on success).
+     */
+    Status SetDeviceTier(size_t capacity);
+
+    /**
+     * Authenticate on the device first, and only if the device did not match search the host gallery (with a second
+     * capture). The device result is final for its matches, which skips the faceprints transfer and the host search
+     * for the frequent users. Users matched on the host are promoted to the device when there is room or when they
+     * were matched more often than its least matched user, which is evicted.
+     * Host users removed or enrolled again are removed from or pushed to the device before the next authentication.
+     *
+     * @param[in] callback User defined callback, gets a single result from either tier.
+     * @return Status (Status::Ok on success). Status::Error if the device tier is not set (SetDeviceTier()).
+     */
+    Status AuthenticateTiered(AuthenticationCallback& callback);
+
+    /**
+     * Replace the host users of the device with the capacity most matched users since the last sync. The match
+     * counts are halved afterwards, so the device tier follows the recent frequencies.
+     *
+     * @return Status (Status::Ok on success, Status::Error if some device changes failed).
+     */
+    Status SyncDeviceTier();
+
+private:
+    HostModeAuthenticatorImpl* _impl = nullptr;
+};
+} // namespace RealSenseID
@@ -0,0 +1,19 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+
+namespace RealSenseID
+{
+/**
+ * Linux: serve the device file descriptors of all connections (serial ports and V4L2 preview nodes) from a single I/O
+ * thread (ThreadRole::Io) waiting in epoll, instead of each reading thread waiting on its own descriptor. The I/O
+ * thread reads the serial bytes and dequeues the camera frames as they arrive, the protocol and preview threads
+ * consume them. Worth it with many devices on one host, where most of those threads are idle waiting.
+ *
+ * Off by default. Applies to the connections and previews opened after the call. No effect on other platforms.
+ */
+RSID_API void SetIoReactor(bool enable);
+} // namespace RealSenseID
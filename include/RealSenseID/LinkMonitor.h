@@ -0,0 +1,49 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+
+namespace RealSenseID
+{
+/**
+ * Link quality monitor of the devices of a DeviceManager (see DeviceManager::SetLinkMonitor()).
+ * An idle device is pinged at an adaptive interval: it starts at minIntervalMs, doubles after each good ping up to
+ * maxIntervalMs, and goes back to minIntervalMs after a slow or failed ping. Operations of the device count as
+ * activity, so a busy device is not pinged.
+ * A degraded link (maxFailedPings failed pings in a row, or the p90 round trip of the last pings above slowRttMs) is
+ * reconnected before the next operation finds it broken. If it degrades again before it was healthy (at
+ * maxIntervalMs) since the reconnect, it is reconnected at the next lower baud rate.
+ */
+struct RSID_API LinkMonitorConfig
+{
+    // 0 disables the monitor (default)
+    unsigned int maxIntervalMs = 0;
+    unsigned int minIntervalMs = 1000;
+
+    unsigned int pingTimeoutMs = 1000;
+
+    // round trip of a slow ping
+    unsigned int slowRttMs = 100;
+
+    unsigned int maxFailedPings = 3;
+
+    // reconnect at the next lower baud rate if the link degrades again (serial ports only)
+    bool baudrateFallback = true;
+};
+
+/**
+ * Link quality of a device, as measured by the monitor's pings (see DeviceManager::GetLinkQuality()).
+ */
+struct RSID_API LinkQuality
+{
+    unsigned int pings = 0;       // sent by the monitor
+    unsigned int failedPings = 0; // of the pings
+    unsigned int rttP50Us = 0;    // round trip of the last good pings
+    unsigned int rttP90Us = 0;
+    unsigned int intervalMs = 0; // current ping interval
+    unsigned int reconnects = 0; // attempts of the degraded link, including the baud rate fallbacks
+    unsigned int baudrate = 0;   // current baud rate of the link
+};
+} // namespace RealSenseID
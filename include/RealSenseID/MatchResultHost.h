@@ -17,4 +17,36 @@ struct MatchResultHost
     match_calc_t confidence = 0;
     match_calc_t score = 0;
 };
+
+/**
+ * Result of matching faceprints against an array of faceprints.
+ */
+struct MatchArrayResultHost
+{
+    bool success = false;
+    bool should_update = false;
+    int index = -1; // index of the matched faceprints in the array, -1 if none
+    match_calc_t confidence = 0;
+    match_calc_t score = 0;
+};
+
+/**
+ * Top-K match candidate.
+ */
+struct MatchCandidateHost
+{
+    int index = -1; // index of the candidate's faceprints in the array
+    match_calc_t score = 0;
+    match_calc_t confidence = 0;
+};
+
+/**
+ * Pair of similar users in a gallery (see HostFaceprintsGallery::FindSimilarPairs()).
+ */
+struct SimilarPairHost
+{
+    int first = -1;  // index of the first user in the gallery
+    int second = -1; // index of the second user, greater than first
+    match_calc_t score = 0;
+};
 } // namespace RealSenseID
\ No newline at end of file
@@ -0,0 +1,184 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ *  Process wide performance counters and latency histograms of the library (serial link, sessions, device flows,
+ *  host matcher and preview), always collected. Take a snapshot periodically and export it, e.g. counters as
+ *  Prometheus counters and latencies as summaries.
+ *  The allocations of the subsystems made with the SDK allocator (see RealSenseID/Allocator.h) are counted too, so
+ *  the allocations per authentication or preview frame can be verified from the deltas of two snapshots.
+ */
+namespace RealSenseID
+{
+namespace Metrics
+{
+/**
+ * Event counters, all monotonic until Reset()
+ */
+enum class Counter
+{
+    PacketsSent,            // serial packets sent
+    PacketsReceived,        // valid serial packets received
+    BytesSent,              // bytes of the sent packets
+    BytesReceived,          // bytes of the received packets
+    RecvTimeouts,           // packet receives timed out
+    CrcErrors,              // packets received with a bad crc
+    RecvErrors,             // other packet receive failures (bad protocol version or size, connection errors)
+    PacketRetries,          // packet timeouts retried by the loop flows
+    SessionsStarted,        // device sessions started
+    SessionsReused,         // idle sessions reused (FaceAuthenticator::SetSessionReuseTimeout)
+    SessionFailures,        // session starts failed
+    Reconnects,             // connections lost and reopened (FaceAuthenticator::SetAutoReconnect)
+    Matches,                // host matcher queries (each query of a batch)
+    PreviewFramesCaptured,  // preview images captured
+    PreviewFramesDelivered, // preview images given to the callbacks
+    PreviewFramesDropped,   // preview images dropped by the queue policy or for lack of free frames
+    CallbackEventsDropped,  // callback hints, progress and faces events dropped (CallbackQueuePolicy::DropOldest)
+    PacketRetransmits,      // packets resent and asked again after crc errors (RetransmitProtocolVer)
+    LinkPingFailures,       // failed pings of the link monitor (DeviceManager::SetLinkMonitor)
+    LinkReconnects,         // reconnect attempts of degraded links by the link monitor, including baud rate fallbacks
+    Prewarms,               // device woken up and session started ahead of a request (FaceAuthenticator::Prewarm)
+    PrewarmsUsed,           // prewarmed sessions taken by the next request within their hold time
+    DeviceTierMatches,      // tiered authentications matched on the device (HostModeAuthenticator::AuthenticateTiered)
+    HostTierFallbacks,      // tiered authentications not matched on the device and searched in the host gallery
+    CoalescedMessages,      // messages received packed with others in one packet (CoalesceProtocolVer)
+    InexactMatches,         // host matches decided at the search budget, not all users scored (SetSearchBudget)
+    Count
+};
+
+/**
+ * Latency histograms
+ */
+enum class Latency
+{
+    PacketTransfer,    // serial packet receive, from its sync bytes to its crc (wire time)
+    RequestReply,      // sent packet to the next received packet (serial round trip and device processing)
+    SessionSetup,      // session start (and key exchange on secure sessions)
+    Enroll,            // FaceAuthenticator enroll flows
+    Authenticate,      // FaceAuthenticator authenticate and spoof detection flows
+    ExtractFaceprints, // FaceAuthenticator faceprints extraction flows (host mode)
+    Match,             // host matcher query (a whole batch for batch queries)
+    PreviewDelivery,   // preview image capture (or dequeue) to delivery
+    DeviceWait,        // packet receive including the wait for it (device processing, timeouts), all device messages
+    LinkPing,          // successful ping round trips of the link monitor
+    ClockSync,         // clock sync ping round trips less the device processing (FaceAuthenticator::SyncClock)
+    Wake,              // FaceAuthenticator::Prewarm until the device answered and the session was ready
+    Count
+};
+
+/**
+ * Subsystems of the SDK allocator's allocations (see RealSenseID/Allocator.h)
+ */
+enum class Subsystem
+{
+    Protocol, // serial packets of the sessions (pooled, allocated while a pool grows)
+    Matcher,  // host gallery arrays (huge page backed arrays are counted, but not allocated with the SDK allocator)
+    Preview,  // preview frames and their image buffers (pooled, allocated when a preview starts)
+    Wrappers, // C wrapper per call objects: delivered preview frames, async operations and their callbacks
+    Count
+};
+
+static constexpr size_t CounterCount = static_cast<size_t>(Counter::Count);
+static constexpr size_t LatencyCount = static_cast<size_t>(Latency::Count);
+static constexpr size_t SubsystemCount = static_cast<size_t>(Subsystem::Count);
+
+/**
+ * Summary of a latency histogram, in microseconds.
+ * The histogram keeps 8 buckets per power of 2, so the percentiles are within 12.5% of the exact ones.
+ */
+struct RSID_API LatencyStats
+{
+    uint64_t count = 0;
+    uint64_t sumUs = 0;
+    uint64_t minUs = 0;
+    uint64_t maxUs = 0;
+    uint64_t p50Us = 0;
+    uint64_t p90Us = 0;
+    uint64_t p99Us = 0;
+};
+
+/**
+ * Histograms of the host match results (HostFaceprintsGallery matches and verifications, HostModeAuthenticator
+ * matches), to tune the match thresholds on live traffic instead of logging every result.
+ * Scores are counted in ScoreBinWidth wide bins (the last bin also holds the maximal score 4096), confidences per
+ * unit. The runner-up is the second best score seen by the search, counted when it scored more than one user: the
+ * searches stop at the first user above the strong threshold, so for accepted results it is the best score of the users
+ * scanned before the match (searches of the dedup, pivot and quantized indexes and batches report none).
+ */
+struct RSID_API MatchScoreStats
+{
+    static constexpr size_t ScoreBins = 64;
+    static constexpr int ScoreBinWidth = 64;
+    static constexpr size_t ConfidenceBins = 101;
+
+    uint64_t matches = 0;      // results counted
+    uint64_t accepted = 0;     // results above the strong threshold
+    uint64_t shouldUpdate = 0; // accepted results with should_update set
+    uint64_t bestScores[ScoreBins] = {};
+    uint64_t runnerUpScores[ScoreBins] = {};
+    uint64_t confidences[ConfidenceBins] = {};
+};
+
+/**
+ * Allocations and frees of a subsystem, all monotonic until Reset(). The bytes still allocated are
+ * bytesAllocated - bytesFreed, if no allocation was live at the last Reset().
+ */
+struct RSID_API AllocationStats
+{
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytesAllocated = 0;
+    uint64_t bytesFreed = 0;
+};
+
+/**
+ * Values of all counters and latency histograms at one point in time.
+ * Each value is read atomically, but the snapshot as a whole is not (concurrent updates may be partially included).
+ */
+struct RSID_API Snapshot
+{
+    uint64_t counters[CounterCount] = {};
+    LatencyStats latencies[LatencyCount];
+    MatchScoreStats matchScores; // of all the galleries and authenticators of the process
+    AllocationStats allocations[SubsystemCount];
+
+    uint64_t Get(Counter counter) const
+    {
+        return counters[static_cast<size_t>(counter)];
+    }
+
+    const LatencyStats& Get(Latency latency) const
+    {
+        return latencies[static_cast<size_t>(latency)];
+    }
+
+    const AllocationStats& Get(Subsystem subsystem) const
+    {
+        return allocations[static_cast<size_t>(subsystem)];
+    }
+};
+
+/**
+ * Take a snapshot of all metrics.
+ */
+RSID_API Snapshot GetSnapshot();
+
+/**
+ * Zero all counters, latency and match score histograms and allocation counters.
+ */
+RSID_API void Reset();
+
+/**
+ * Metric names for exporters, in snake case (e.g. "packets_sent", "request_reply_us", "protocol").
+ */
+RSID_API const char* Name(Counter counter);
+RSID_API const char* Name(Latency latency);
+RSID_API const char* Name(Subsystem subsystem);
+} // namespace Metrics
+} // namespace RealSenseID
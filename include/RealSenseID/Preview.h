@@ -4,9 +4,12 @@
 #pragma once
 
 #include "RealSenseIDExports.h"
+#include "TransferCoordinator.h"
+#include <cstdint>
 
 namespace RealSenseID
 {
+class FaceAuthenticator;
 class PreviewImpl;
 
 /**
@@ -19,6 +22,43 @@ enum class PreviewMode
     Dump = 2      // dump all frames
 };
 
+/**
+ * Preview image formats (VGA preview mode only)
+ * YUYV and NV12 images are delivered without conversion when the camera streams them, pointing directly at the
+ * capture buffer (no copy).
+ */
+enum class PreviewFormat
+{
+    Default = 0, // RGB (RGBA on Android)
+    RGB = 1,     // 3 bytes per pixel
+    RGBA = 2,    // 4 bytes per pixel, alpha 255
+    BGRA = 3,    // 4 bytes per pixel, alpha 255
+    YUYV = 4,    // camera native format, 2 bytes per pixel
+    NV12 = 5     // Y plane, then interleaved UV plane of half height (converted if the camera can't stream it)
+};
+
+/**
+ * Handling of captured images while the callback is busy
+ */
+enum class PreviewQueuePolicy
+{
+    DropOldest = 0, // queue up to queueSize images, drop the oldest queued image when full
+    Block = 1,      // queue up to queueSize images, capture waits for room when full (the camera may drop frames)
+    LatestOnly = 2, // deliver only the latest image, newer images replace the undelivered one
+    Inline = 3      // no queue, callback on the capture thread (capture waits for the callback)
+};
+
+/**
+ * Region of the camera image (VGA preview mode)
+ */
+struct RSID_API PreviewRoi
+{
+    unsigned int x = 0;
+    unsigned int y = 0;
+    unsigned int width = 0; // 0 for the whole image
+    unsigned int height = 0;
+};
+
 /**
  * Preview configuration
  */
@@ -26,6 +66,74 @@ struct RSID_API PreviewConfig
 {
     int cameraNumber = -1; // attempt to auto detect by default
     PreviewMode previewMode = PreviewMode::VGA; // requires custom fw support
+    PreviewFormat previewFormat = PreviewFormat::Default; // VGA preview mode only
+    PreviewQueuePolicy queuePolicy = PreviewQueuePolicy::DropOldest;
+    unsigned int queueSize = 2; // max images waiting for the callback (DropOldest and Block policies)
+
+    // VGA preview mode only: images are cropped to roi (clipped to the camera image) and downscaled by keeping every
+    // downscale-th pixel and row. If targetWidth and targetHeight are set, the downscale is the largest one keeping the
+    // image at least that size instead. Only the resulting pixels are converted.
+    PreviewRoi roi;
+    unsigned int downscale = 1;
+    unsigned int targetWidth = 0;
+    unsigned int targetHeight = 0;
+
+    // FHD_Rect preview mode only: deliver only the face crop, the metadata's face rect with faceCropMargin percent of
+    // the face size on each side (clipped to the image). Only the crop is converted, the image's size and dimensions
+    // are of the crop and its metadata.face_rect is relative to the crop. Images without a valid face rect are not
+    // delivered (as in FHD_Rect mode).
+    bool faceCrop = false;
+    unsigned int faceCropMargin = 25;
+
+    // FHD_Rect and Dump preview modes only: deliver only the metadata of the images. The image's pixels are not read
+    // or converted, its buffer is null and its size 0 (dimensions and metadata are set). The camera buffer is
+    // returned to the driver as soon as the metadata is parsed, so a metadata feed costs little more than the capture.
+    bool metadataOnly = false;
+
+    unsigned int captureBuffers = 4; // Linux: number of camera buffers, Android: frame slots (at least 2), more buffers
+                                     // absorb cpu bursts
+    bool exportDmaBuf = false;       // Linux: export the camera buffers as dma-buf (see Image::dmaBufFd)
+
+    unsigned int latencyWindow = 0; // number of recent frames in Preview::GetLatency(), 0 to disable
+
+    // Adaptive frame rate: while idle, at most idleFps images per second are converted and delivered, the other ones
+    // are received and released unconverted. Preview::NotifyActivity() (e.g. on a detected face) switches to the full
+    // frame rate for activeHoldMs. 0 to always deliver the full frame rate.
+    unsigned int idleFps = 0;
+    unsigned int activeHoldMs = 3000;
+
+    // Dump preview mode, and VGA mode with YUYV images of the whole camera image: max images waiting to be written by
+    // the recorder (Preview::StartRecording). The preview keeps that many more frames for the recorder, 0 to disable
+    // recording.
+    unsigned int recordQueueSize = 4;
+
+    // Play a recording (Preview::StartRecording) instead of capturing from the camera, e.g. to benchmark the preview
+    // pipeline without a device. RAW10 recordings (Dump mode) play in the FHD_Rect and Dump modes, YUYV ones (VGA
+    // mode) in VGA mode, with their recorded metadata. The file is memory mapped and played in a loop, at the recorded
+    // pace if playbackRealtime is set, as fast as the pipeline takes the images otherwise. The path must stay valid
+    // while the preview runs.
+    const char* playbackPath = nullptr;
+    bool playbackRealtime = true;
+
+    // Coordinated USB bandwidth: while a bulk transfer of the coordinator is active (e.g. a features export of the
+    // authenticator given the same coordinator), the camera streams at transferFps (the nearest rate the camera
+    // supports), or not at all if 0, and at its full frame rate again after the transfer. The camera stream is
+    // reopened at each change, which takes a few frames. The coordinator must outlive the preview.
+    TransferCoordinator* transferCoordinator = nullptr;
+    unsigned int transferFps = 5;
+};
+
+/**
+ * Preview counters since the preview was started
+ */
+struct RSID_API PreviewStatistics
+{
+    unsigned int captured = 0;  // images captured
+    unsigned int delivered = 0; // images given to the callback
+    unsigned int dropped = 0;   // images dropped by the queue policy or for lack of free frames
+    unsigned int skipped = 0;   // images not converted while idle (PreviewConfig::idleFps)
+    unsigned int recorded = 0;      // images written by the recorder (Preview::StartRecording)
+    unsigned int recordDropped = 0; // images not recorded, the recorder's queue was full
 };
 
 /**
@@ -52,6 +160,22 @@ struct RSID_API ImageMetadata
     bool projector = false;
 };
 
+/**
+ * Timing of a preview image, in microseconds.
+ * Host times are of the host's steady clock (CLOCK_MONOTONIC on Linux).
+ */
+struct RSID_API ImageTiming
+{
+    uint64_t captureTimestamp = 0;   // capture timestamp of the camera driver (Android: arrival), 0 if not available
+    bool captureOnHostClock = false; // captureTimestamp is a host time (Linux monotonic timestamps, Android)
+    uint64_t dequeueTime = 0;        // host time the image was received from the driver
+    uint64_t convertedTime = 0;      // host time the image was converted
+    uint64_t deliveredTime = 0;      // host time the image was given to the callback
+    // host time of the device's capture timestamp (ImageMetadata::timestamp), 0 if the image has none or the device
+    // clock is not synced (FaceAuthenticator::SyncClock())
+    uint64_t deviceCaptureTime = 0;
+};
+
 /**
  * Image data for preview
  */
@@ -64,11 +188,34 @@ struct RSID_API Image
     unsigned int stride = 0;
     unsigned int number = 0;
     ImageMetadata metadata;
+    ImageTiming timing;
+    // Linux with PreviewConfig::exportDmaBuf: dma-buf fd of the camera buffer holding the image, for images
+    // delivered without conversion (YUYV/NV12 passthrough with PreviewQueuePolicy::Inline), -1 otherwise.
+    // Owned by the preview, valid during the callback (like buffer).
+    int dmaBufFd = -1;
+};
+
+/**
+ * Capture to callback latency of the recent preview images (PreviewConfig::latencyWindow).
+ * Measured from the device's capture timestamp when the device clock is synced (ImageTiming::deviceCaptureTime), else
+ * from the capture timestamp when it is a host time, from the dequeue time otherwise.
+ */
+struct RSID_API PreviewLatency
+{
+    static constexpr unsigned int Buckets = 12;
+
+    unsigned int frames = 0; // images in the window
+    // images per latency range: bucket 0 below 1 ms, bucket i in [2^(i-1), 2^i) ms, the last one all above
+    unsigned int histogram[Buckets] = {};
+    unsigned int medianUs = 0;
+    unsigned int p99Us = 0;
+    unsigned int maxUs = 0;
 };
 
 /**
  * User defined callback for preview.
  * Callback will be used to provide preview image.
+ * The image buffer is valid only during the callback.
  */
 class RSID_API PreviewImageReadyCallback
 {
@@ -77,12 +224,110 @@ public:
     virtual void OnPreviewImageReady(const Image image) = 0;
 };
 
+/**
+ * Codecs of the encoded preview (Preview::StartEncodedPreview)
+ */
+enum class PreviewCodec
+{
+    H264 = 0,
+    MJPEG = 1
+};
+
+/**
+ * Encoded preview configuration
+ */
+struct RSID_API PreviewEncoderConfig
+{
+    PreviewCodec codec = PreviewCodec::H264;
+    unsigned int bitrate = 2000000; // H264: bits per second
+    unsigned int gopSize = 30;      // H264: images per key frame interval
+    unsigned int quality = 80;      // MJPEG: jpeg quality [1, 100]
+    int encoderNumber = -1;         // Linux: number of the V4L2 memory to memory encoder (/dev/videoN), -1 to find one
+};
+
+/**
+ * Encoded preview image
+ */
+struct RSID_API PreviewPacket
+{
+    const unsigned char* data = nullptr; // valid only during the callback
+    unsigned int size = 0;
+    bool keyFrame = false;
+    unsigned int number = 0; // of the encoded image
+    ImageTiming timing;      // of the encoded image, deliveredTime is the packet's delivery time
+};
+
+/**
+ * User defined callback for the encoded preview.
+ */
+class RSID_API PreviewPacketCallback
+{
+public:
+    virtual ~PreviewPacketCallback() = default;
+    virtual void OnPreviewPacket(const PreviewPacket& packet) = 0;
+};
+
+class PreviewFrameImpl;
+
+/**
+ * Lease on a preview frame taken from the preview's frame pool.
+ * Copies of a lease share the frame (reference counted). The frame goes back to the pool when the last copy is
+ * released or destroyed, so the image can be handed to other threads without copying it.
+ * Leases can be copied, moved and released on any thread, and may outlive the Preview.
+ */
+class RSID_API PreviewFrame
+{
+public:
+    PreviewFrame() = default;
+    ~PreviewFrame();
+
+    PreviewFrame(const PreviewFrame& other);
+    PreviewFrame(PreviewFrame&& other) noexcept;
+    PreviewFrame& operator=(const PreviewFrame& other);
+    PreviewFrame& operator=(PreviewFrame&& other) noexcept;
+
+    /**
+     * @return True if the lease holds a frame (was not released).
+     */
+    bool IsValid() const;
+
+    /**
+     * @return The frame's image (empty image if not valid). Its buffer is valid as long as the lease is held.
+     */
+    const Image& GetImage() const;
+
+    /**
+     * Release the lease. The frame goes back to the pool once all its leases are released.
+     */
+    void Release();
+
+private:
+    friend class PreviewFrameImpl;
+    explicit PreviewFrame(PreviewFrameImpl* impl); // adopts a reference of impl
+    PreviewFrameImpl* _impl = nullptr;
+};
+
+/**
+ * User defined callback for preview with leased frames.
+ * The callback may keep copies of the frame after returning.
+ */
+class RSID_API PreviewFrameReadyCallback
+{
+public:
+    virtual ~PreviewFrameReadyCallback() = default;
+    virtual void OnPreviewFrameReady(const PreviewFrame& frame) = 0;
+};
+
 /**
  * Preview Support. Use StartPreview to get callbacks for image frames
+ * Images are captured on a capture thread and delivered to the callback on a delivery thread, through a queue as set by
+ * PreviewConfig::queuePolicy.
  */
 class RSID_API Preview
 {
 public:
+    static constexpr unsigned int DefaultFramePoolSize = 4;
+
     explicit Preview(const PreviewConfig&);
     ~Preview();
 
@@ -97,8 +342,34 @@ public:
      */
     bool StartPreview(PreviewImageReadyCallback& callback);
 
+    /**
+     * Start preview with leased frames.
+     * Images are captured directly into a pool of pool_size frames. A captured image is dropped if all the frames
+     * are leased at the time. Queued images take frames of the pool too.
+     *
+     * @param callback reference to callback object
+     * @param pool_size number of frames in the pool (at least 1)
+     * @return True on success.
+     */
+    bool StartPreview(PreviewFrameReadyCallback& callback, unsigned int pool_size = DefaultFramePoolSize);
+
+    /**
+     * Start preview encoded by the platform's hardware encoder, for streaming.
+     * Requires the VGA preview mode. The camera's YUYV images (or NV12 images, if the camera streams them) are given
+     * to the encoder as NV12, cropped and downscaled as set by the config, without rgb conversion. The packets are
+     * delivered in encoding order, the queue policy applies to the images waiting for the encoder. StopPreview()
+     * delivers the packets of the images still in the encoder.
+     * Supported on Linux with a V4L2 memory to memory encoder (e.g. the SoC's video encoder).
+     *
+     * @param callback reference to callback object
+     * @param config codec and encoder settings
+     * @return True on success.
+     */
+    bool StartEncodedPreview(PreviewPacketCallback& callback, const PreviewEncoderConfig& config);
+
     /**
      * Pause preview.
+     * The camera stops streaming until the preview is resumed.
      *
      * @return True on success.
      */
@@ -111,6 +382,25 @@ public:
      */
     bool ResumePreview();
 
+    /**
+     * Switch to the full frame rate for PreviewConfig::activeHoldMs (no effect unless PreviewConfig::idleFps is set).
+     * Typically called from FaceAuthenticationCallback::OnFaceDetected(). Can be called from any thread.
+     */
+    void NotifyActivity();
+
+    /**
+     * Prewarm the authenticator when a face appears in the preview (FHD_Rect and Dump preview modes, whose images carry
+     * the device's face rect): an image with a face calls authenticator->PrewarmAsync(hold_ms), at most once per
+     * hold_ms, so the device is out of standby and the session ready by the time the face is authenticated. Requests
+     * of the authenticator should be async (e.g. FaceAuthenticator::AuthenticateAsync()) while the preview may
+     * prewarm it, so that they run after the prewarm. The authenticator must outlive the preview or be unset first.
+     * Can be called from any thread.
+     *
+     * @param authenticator Authenticator to prewarm, nullptr to stop.
+     * @param hold_ms See FaceAuthenticator::Prewarm().
+     */
+    void SetPrewarm(FaceAuthenticator* authenticator, unsigned int hold_ms = 5000);
+
     /**
      * Stop preview.
      *
@@ -118,6 +408,40 @@ public:
      */
     bool StopPreview();
 
+    /**
+     * Record the images of the Dump preview mode (or the YUYV images of the VGA mode, without a preview region) to a
+     * file, from the frames they were captured to (no copy), on a writer thread. The images and their metadata are
+     * written unbuffered, with an index of the frames when the recording is stopped. Images are dropped from the
+     * recording (not from the preview) while PreviewConfig::recordQueueSize images are waiting to be written. Play
+     * recordings back with DumpReader, or through the preview pipeline (PreviewConfig::playbackPath).
+     * Can be called before or during the preview, stopping the preview stops the recording.
+     *
+     * @param path File to record to (overwritten).
+     * @return True on success.
+     */
+    bool StartRecording(const char* path);
+
+    /**
+     * Stop recording. Writes the queued images and the index.
+     *
+     * @return True if the recording was written successfully.
+     */
+    bool StopRecording();
+
+    /**
+     * Get the counters of the current (or last) preview.
+     *
+     * @return Preview counters.
+     */
+    PreviewStatistics GetStatistics() const;
+
+    /**
+     * Get the latency of the recent images (empty unless PreviewConfig::latencyWindow is set).
+     *
+     * @return Latency histogram and percentiles.
+     */
+    PreviewLatency GetLatency() const;
+
 private:
     RealSenseID::PreviewImpl* _impl = nullptr;
 };
@@ -0,0 +1,121 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+#include "Preview.h"
+#include <cstdint>
+
+namespace RealSenseID
+{
+class PreviewBrokerImpl;
+class PreviewSubscriberImpl;
+
+/**
+ * Preview broker. Owns the camera's preview and publishes its images to a named shared memory ring, for any number
+ * of PreviewSubscriber processes (or threads) to read without copying.
+ * Each image goes to a free slot of the ring with the next sequence number. Slots being read by subscribers are not
+ * overwritten, an image is dropped if all the slots are being read. Supported on Linux (POSIX shared memory) and
+ * Windows (file mapping).
+ * The slots held by subscribers that exited without closing the ring are reused. A ring is replaced only if its
+ * broker exited without stopping.
+ */
+class RSID_API PreviewBroker
+{
+public:
+    static constexpr unsigned int DefaultSlots = 4;
+
+    /**
+     * @param config Preview configuration of the camera.
+     * @param name Name of the shared ring, for the subscribers to open.
+     * @param slots Number of images in the ring (at least 2).
+     * @param groupAccess Let the processes of the user's group subscribe too (on Linux), only the user's otherwise.
+     */
+    PreviewBroker(const PreviewConfig& config, const char* name, unsigned int slots = DefaultSlots,
+                  bool groupAccess = false);
+    ~PreviewBroker();
+
+    PreviewBroker(const PreviewBroker&) = delete;
+    PreviewBroker& operator=(const PreviewBroker&) = delete;
+
+    /**
+     * Create the shared ring and start the preview.
+     *
+     * @return True on success, false also if a running broker publishes to the ring's name.
+     */
+    bool Start();
+
+    /**
+     * Stop the preview and remove the ring's name. Open subscribers stop getting images.
+     *
+     * @return True on success.
+     */
+    bool Stop();
+
+    /**
+     * @return Counters of the preview.
+     */
+    PreviewStatistics GetStatistics() const;
+
+    /**
+     * @return Images not published because all the slots were being read.
+     */
+    unsigned int GetDropped() const;
+
+private:
+    PreviewBrokerImpl* _impl = nullptr;
+};
+
+/**
+ * Reader of the images published by a PreviewBroker.
+ * Images are read in sequence order, each subscriber with its own cursor. Images overwritten before they were read
+ * are skipped (and counted). A read image points into the shared ring and holds its slot until released.
+ */
+class RSID_API PreviewSubscriber
+{
+public:
+    PreviewSubscriber();
+    ~PreviewSubscriber();
+
+    PreviewSubscriber(const PreviewSubscriber&) = delete;
+    PreviewSubscriber& operator=(const PreviewSubscriber&) = delete;
+
+    /**
+     * Open the ring of a started broker. The first read image is the latest one published.
+     * Up to 64 subscribers can have the ring open at once.
+     *
+     * @param name Name of the broker's ring.
+     * @return True on success.
+     */
+    bool Open(const char* name);
+
+    /**
+     * Release the read image and close the ring.
+     */
+    void Close();
+
+    /**
+     * Read the next image. Releases the previously read image.
+     *
+     * @param image Image pointing into the shared ring, valid until Release(), the next Read() or Close().
+     * @param timeout_ms Max time to wait for an image.
+     * @param sequence Optional, the image's sequence number.
+     * @return True if an image was read, false on timeout or once the broker was stopped and its images were read.
+     */
+    bool Read(Image& image, unsigned int timeout_ms, uint64_t* sequence = nullptr);
+
+    /**
+     * Release the read image, so its slot can be reused by the broker.
+     */
+    void Release();
+
+    /**
+     * @return Images skipped since they were overwritten before this subscriber read them.
+     */
+    uint64_t GetMissed() const;
+
+private:
+    PreviewSubscriberImpl* _impl = nullptr;
+};
+} // namespace RealSenseID
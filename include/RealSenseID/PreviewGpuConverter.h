@@ -0,0 +1,87 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+#include "Preview.h"
+
+namespace RealSenseID
+{
+class PreviewGpuConverterImpl;
+
+/**
+ * Conversion of raw preview images on the GPU, for displays that draw the preview with OpenGL ES: the raw image is
+ * uploaded as is and converted by a compute shader into an RGBA8 texture, instead of being converted on the cpu and
+ * uploaded as rgb.
+ *   - YUYV images (PreviewFormat::YUYV) are converted to rgb like the cpu conversion of the preview.
+ *   - RAW10 images (PreviewMode::Dump, FHD_Rect or 5MP Bayer dump of width x height pixels) are unpacked,
+ *     demosaiced and rotated to portrait like the RAW10 preview (the texture is height x width).
+ * The textures are bit-exact to the cpu conversions, with alpha 255.
+ *
+ * Requires a build with RSID_PREVIEW_GPU (Linux and Android, OpenGL ES 3.1) and a current OpenGL ES 3.1 context on
+ * the calling thread, the one the texture is drawn with (or one sharing its objects). All the methods must be called
+ * on a thread with that context current. Init() fails on other builds.
+ */
+class RSID_API PreviewGpuConverter
+{
+public:
+    PreviewGpuConverter();
+    ~PreviewGpuConverter();
+
+    PreviewGpuConverter(const PreviewGpuConverter&) = delete;
+    PreviewGpuConverter& operator=(const PreviewGpuConverter&) = delete;
+
+    /**
+     * Compile the conversion shaders on the current context.
+     *
+     * @return True on success, false if the build has no GPU conversion or the context is not OpenGL ES 3.1.
+     */
+    bool Init();
+
+    /**
+     * Convert a YUYV image (2 bytes per pixel, even width) into the texture.
+     *
+     * @param image Image of the preview callback, buffer valid for the duration of the call.
+     * @return True on success.
+     */
+    bool ConvertYuyv(const Image& image);
+
+    /**
+     * Convert a RAW10 image (5 bytes per 4 pixels, as dumped by PreviewMode::Dump) into the texture, rotated to
+     * portrait.
+     *
+     * @param image Image of the preview callback, buffer valid for the duration of the call.
+     * @return True on success.
+     */
+    bool ConvertRaw10(const Image& image);
+
+    /**
+     * @return Name of the RGBA8 texture of the last conversion (GLuint), 0 before the first one. The texture is
+     * owned by the converter and reallocated if the dimensions change.
+     */
+    unsigned int Texture() const;
+
+    /**
+     * @return Dimensions of the texture.
+     */
+    unsigned int Width() const;
+    unsigned int Height() const;
+
+    /**
+     * Read the texture back, Width() * Height() * 4 bytes (RGBA).
+     *
+     * @return True on success.
+     */
+    bool ReadPixels(unsigned char* rgba) const;
+
+    /**
+     * Delete the shaders, buffers and texture while the context is still current. Called by the destructor if not
+     * called before (the context must be current then).
+     */
+    void Release();
+
+private:
+    PreviewGpuConverterImpl* _impl = nullptr;
+};
+} // namespace RealSenseID
@@ -12,6 +12,10 @@ namespace RealSenseID
  */
 struct RSID_API SerialConfig
 {
+    // serial port, "tcp://<host>:<port>" of a device behind rsid-proxy, "record://<file>@<port>" to record the
+    // connection to the port, "replay://<file>" ("replay-fast://<file>") to replay a recording without a device, or
+    // "emulator://<name>[?<options>]" for a device emulated in the process (non-secure sessions only)
     const char* port = nullptr;
+    unsigned int baudrate = 115200; // see DeviceController::TuneBaudrate(). ignored over tcp (the proxy's)
 };
 } // namespace RealSenseID
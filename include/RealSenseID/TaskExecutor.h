@@ -0,0 +1,48 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+#include <functional>
+#include <memory>
+
+namespace RealSenseID
+{
+/**
+ * The library's parallel work (matcher searches, RAW preview conversion, firmware block compression and the
+ * callback delivery of CallbackDispatch) runs as short tasks on a process wide work stealing scheduler, with a
+ * thread per cpu by default (ThreadRole::Tasks). Blocking loops (serial readers, preview capture) keep their own
+ * threads.
+ *
+ * An application with its own thread pool can run the tasks there instead by setting a TaskExecutor.
+ */
+class RSID_API TaskExecutor
+{
+public:
+    virtual ~TaskExecutor() = default;
+
+    /**
+     * Run the task once, on any thread. Called from the library's threads and the application's threads calling the
+     * library, must not wait for the task. Every task must eventually run, the library waits for the callback
+     * deliveries, but its parallel loops do not depend on the tasks running concurrently (the submitting thread runs
+     * the parts not started yet itself).
+     *
+     * @param task The task, may be run on the thread calling Execute() after it returns.
+     */
+    virtual void Execute(std::function<void()> task) = 0;
+};
+
+/**
+ * Set the number of threads of the library's scheduler, 0 (default) for one per cpu. Applies once the scheduler is
+ * restarted: its threads start with the first task and stop when the last object using them (e.g. the
+ * authenticators, previews and galleries) is destroyed.
+ */
+RSID_API void SetTaskThreads(unsigned int threads);
+
+/**
+ * Run the library's tasks on the executor instead of the library's scheduler threads, nullptr to restore them.
+ * Applies to the tasks submitted after the call. Tasks already queued on the scheduler's threads still run there.
+ */
+RSID_API void SetTaskExecutor(std::shared_ptr<TaskExecutor> executor);
+} // namespace RealSenseID
@@ -0,0 +1,70 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+
+namespace RealSenseID
+{
+/**
+ * Kinds of threads started by the library. Each has its own ThreadConfig.
+ * The serial connections (except Android's usb reader) are read on the thread of the device flow or, for async
+ * operations, on the Async threads.
+ */
+enum class ThreadRole
+{
+    Serial,    // Android usb reader and urb reaper
+    Preview,   // preview capture and delivery, dump recorder (RSID_PREVIEW)
+    Callbacks, // unused, the callback dispatch of the device flows (CallbackDispatch) runs on the Tasks threads
+    Async,     // executor of the async operations (AsyncOperation) and the DeviceManager workers
+    FwUpdate,  // firmware update reader
+    Matcher,   // match pipeline and gallery maintenance
+    Logging,   // async log writer (RSID_ASYNC_LOG), serial capture writer (RSID_SERIAL_CAPTURE)
+    Tasks,     // task scheduler (TaskExecutor.h): matcher searches, raw preview conversion, callback dispatch
+    Io         // I/O reactor of the serial ports and camera nodes (SetIoReactor, Linux)
+};
+
+/**
+ * Scheduling of the threads of a role. Default: any cpu, default scheduling.
+ * Failures to apply a setting (e.g. realtime priority without the privilege) are logged as warnings and the thread
+ * runs with the rest of the settings.
+ */
+struct RSID_API ThreadConfig
+{
+    /**
+     * Cpus the threads may run on, bit i for cpu i (first 64 cpus). 0 - any cpu.
+     * Matcher threads pinned to a NUMA node (FaceprintsGallery NUMA sharding) keep the node's cpus.
+     */
+    unsigned long long affinityMask = 0;
+
+    /**
+     * 1-99: realtime scheduling, SCHED_FIFO with this priority on Linux and Android (requires CAP_SYS_NICE or an
+     * RLIMIT_RTPRIO limit), THREAD_PRIORITY_TIME_CRITICAL on Windows. 0 - normal scheduling with niceness.
+     */
+    int realtimePriority = 0;
+
+    /**
+     * Normal scheduling priority, -20 (highest) to 19 (lowest), the thread's nice value on Linux and Android
+     * (negative values require CAP_SYS_NICE). On Windows mapped to the thread priority levels
+     * (<= -10 highest, < 0 above normal, > 0 below normal, >= 10 lowest).
+     */
+    int niceness = 0;
+
+    /**
+     * Set the os thread names ("rsid-<thread>", e.g. "rsid-preview"), shown by debuggers and profilers.
+     */
+    bool setNames = true;
+};
+
+/**
+ * Set the scheduling of the threads of the role. Applies to the threads started after the call, so set it before
+ * connecting, starting the preview or the first async operation.
+ */
+RSID_API void SetThreadConfig(ThreadRole role, const ThreadConfig& config);
+
+/**
+ * @return The scheduling of the threads of the role.
+ */
+RSID_API ThreadConfig GetThreadConfig(ThreadRole role);
+} // namespace RealSenseID
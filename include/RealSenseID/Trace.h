@@ -0,0 +1,171 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ *  Timeline of the library operations for debugging latencies: session starts, packet sends and receives (and the
+ *  wait for their sync bytes), device results, matcher queries and preview image capture, conversion and delivery.
+ *  Events are kept in a ring buffer while recording and can be dumped in the Chrome Trace Event format, viewable in
+ *  chrome://tracing or https://ui.perfetto.dev.
+ *  Recording is off by default and costs a single flag check per event when off.
+ *  The same events can be forwarded to an external profiler (e.g. VTune through ITT, or Tracy) with SetHooks(), in
+ *  builds with the RSID_TRACE_HOOKS option (compiled out by default).
+ *  Distributed tracing (e.g. OpenTelemetry): the operations run under a caller's trace context (SetContext(),
+ *  ContextScope) are exported as child spans of it to the span exporter (SetSpanExporter()), independent of the
+ *  recording.
+ */
+namespace RealSenseID
+{
+namespace Trace
+{
+static constexpr size_t DefaultCapacity = 64 * 1024;
+
+/**
+ * Start recording (previous events are cleared). Once capacity events are recorded, the oldest ones are overwritten.
+ */
+RSID_API void Start(size_t capacity = DefaultCapacity);
+
+/**
+ * Stop recording. The recorded events are kept until the next Start().
+ */
+RSID_API void Stop();
+
+/**
+ * True while recording.
+ */
+RSID_API bool IsRecording();
+
+/**
+ * The recorded events (oldest first) as Chrome Trace Event JSON.
+ */
+RSID_API std::string ToChromeJson();
+
+/**
+ * Write the recorded events as Chrome Trace Event JSON to the given file.
+ * @return true on success.
+ */
+RSID_API bool WriteChromeJson(const char* path);
+
+/**
+ * Profiler hooks: zones (e.g. serial send/recv, session encryption, matcher scoring, preview conversion, firmware
+ * block transfers), frame marks (delivered preview images) and counters. Names and categories are static strings.
+ * The hooks are called from the library threads, concurrently, independent of the recording. Unset hooks are skipped.
+ */
+struct RSID_API Hooks
+{
+    void (*beginZone)(void* context, const char* name, const char* category) = nullptr;
+    void (*endZone)(void* context, const char* name, const char* category) = nullptr;
+    void (*frameMark)(void* context, const char* name) = nullptr;
+    void (*counter)(void* context, const char* name, int64_t value) = nullptr;
+    void* context = nullptr;
+};
+
+/**
+ * Install the profiler hooks (copied), or remove them with nullptr. Zones in flight end with the hooks they began
+ * with, so the context must stay valid after the hooks are replaced.
+ * @return false if the library was built without RSID_TRACE_HOOKS.
+ */
+RSID_API bool SetHooks(const Hooks* hooks);
+
+/**
+ * W3C trace context (https://www.w3.org/TR/trace-context/) of a span, e.g. the caller's OpenTelemetry span.
+ */
+struct RSID_API Context
+{
+    static constexpr size_t TraceparentSize = 56; // "00-<trace id>-<span id>-<flags>" and the terminating zero
+
+    uint8_t traceId[16] = {};
+    uint8_t spanId[8] = {};
+    uint8_t flags = 0; // trace flags, spans are exported only if sampled (bit 0)
+};
+
+/**
+ * Parse a traceparent header ("00-<32 hex trace id>-<16 hex span id>-<2 hex flags>").
+ * @return false if it is not a valid version 00 traceparent (context is left unchanged).
+ */
+RSID_API bool ParseTraceparent(const char* traceparent, Context& context);
+
+/**
+ * Format the context as a traceparent header into buffer (at least Context::TraceparentSize bytes).
+ */
+RSID_API void FormatTraceparent(const Context& context, char* buffer);
+
+/**
+ * Set the trace context of the calling thread (copied), or clear it with nullptr. The library operations called on
+ * this thread are children of it: flows, session starts, packet sends and receives, the waits for the device and
+ * matcher queries, nested as they run. Async operations (FaceAuthenticator::*Async()) take the context of the thread
+ * that started them.
+ */
+RSID_API void SetContext(const Context* context);
+
+/**
+ * The trace context of the calling thread: the caller's context, or within a library operation its span.
+ * @return false if the thread has no context.
+ */
+RSID_API bool GetContext(Context& context);
+
+/**
+ * Sets the thread's trace context for its lifetime and restores the previous one.
+ */
+class ContextScope
+{
+public:
+    explicit ContextScope(const Context& context)
+    {
+        _had_previous = GetContext(_previous);
+        SetContext(&context);
+    }
+
+    ~ContextScope()
+    {
+        SetContext(_had_previous ? &_previous : nullptr);
+    }
+
+    ContextScope(const ContextScope&) = delete;
+    ContextScope& operator=(const ContextScope&) = delete;
+
+private:
+    Context _previous;
+    bool _had_previous = false;
+};
+
+/**
+ * A finished span of a library operation run under a trace context. Times are nanoseconds since the unix epoch. The
+ * strings are static, the ids are valid during the export call only.
+ */
+struct RSID_API Span
+{
+    const char* name = nullptr;
+    const char* category = nullptr;
+    uint8_t traceId[16] = {};
+    uint8_t spanId[8] = {};
+    uint8_t parentSpanId[8] = {};
+    uint64_t startUnixNs = 0;
+    uint64_t endUnixNs = 0; // same as start for point in time events (e.g. a device result)
+    int64_t value = 0;      // e.g. the status of a device result
+    bool hasValue = false;
+};
+
+/**
+ * Span exporter, e.g. adding the spans to an OpenTelemetry exporter. Called from the library threads, concurrently,
+ * as each span ends.
+ */
+struct RSID_API SpanExporter
+{
+    void (*exportSpan)(void* context, const Span* span) = nullptr;
+    void* context = nullptr;
+};
+
+/**
+ * Install the span exporter (copied), or remove it with nullptr. Spans in flight are exported with the exporter they
+ * began with, so the context must stay valid after it is replaced.
+ */
+RSID_API void SetSpanExporter(const SpanExporter* exporter);
+} // namespace Trace
+} // namespace RealSenseID
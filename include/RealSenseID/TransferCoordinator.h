@@ -0,0 +1,72 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseIDExports.h"
+
+namespace RealSenseID
+{
+class TransferCoordinatorImpl;
+class PreviewImpl;
+
+/**
+ * Coordinates the USB bandwidth of a device's preview and its bulk protocol transfers (features export and import,
+ * firmware update) when both share one USB connection. While a transfer is active, the previews given the
+ * coordinator (PreviewConfig::transferCoordinator) stream at PreviewConfig::transferFps (or stop streaming) and
+ * restore the full frame rate when the last transfer ends, so the transfers complete in a predictable time without
+ * stopping the preview.
+ * The transfers of an authenticator (FaceAuthenticator::SetTransferCoordinator()) and of a firmware update
+ * (FwUpdater::Settings::coordinator) are marked automatically, other ones with BeginTransfer() and EndTransfer().
+ * Thread safe. Must outlive the previews and authenticators it was given to.
+ */
+class RSID_API TransferCoordinator
+{
+public:
+    /**
+     * @param settle_ms Max time a transfer waits for the previews to reduce their frame rate before it starts.
+     */
+    explicit TransferCoordinator(unsigned int settle_ms = 500);
+    ~TransferCoordinator();
+
+    TransferCoordinator(const TransferCoordinator&) = delete;
+    TransferCoordinator& operator=(const TransferCoordinator&) = delete;
+
+    /**
+     * Mark the start of a bulk transfer. The first of overlapping transfers waits (up to settle_ms) until the previews
+     * streaming at their full frame rate have reduced it.
+     */
+    void BeginTransfer();
+
+    /**
+     * Mark the end of a transfer started with BeginTransfer(). The previews restore their full frame rate after the
+     * last one.
+     */
+    void EndTransfer();
+
+    /**
+     * @return True while a transfer is active.
+     */
+    bool IsTransferActive() const;
+
+    /**
+     * Transfer for the lifetime of the scope (no effect with a null coordinator).
+     */
+    class RSID_API Scope
+    {
+    public:
+        explicit Scope(TransferCoordinator* coordinator);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        TransferCoordinator* _coordinator;
+    };
+
+private:
+    friend class PreviewImpl;
+    TransferCoordinatorImpl* _impl = nullptr;
+};
+} // namespace RealSenseID
@@ -0,0 +1,52 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/RealSenseIDExports.h"
+#include <cstdint>
+
+namespace RealSenseID
+{
+class Faceprints;
+
+/**
+ * Compact summary of a user in the device's database, for differential host/device sync.
+ */
+struct UserDigest
+{
+    static constexpr unsigned int USER_ID_SIZE = 31; // FaceAuthenticator::MAX_USERID_LENGTH
+
+    char user_id[USER_ID_SIZE] = {0};
+    // FeaturesHash() of the user's faceprints
+    uint64_t features_hash = 0;
+    // number of features changes of the user seen by this host since the user was first seen
+    uint32_t update_counter = 0;
+};
+
+/**
+ * Hash of the faceprints' version, type and descriptors (64 bit FNV-1a), the same on all hosts and platforms.
+ * Equal hashes of the host's copy and of a device digest mean the user does not need to be transferred.
+ *
+ * @param[in] faceprints User's faceprints.
+ * @return The hash.
+ */
+RSID_API uint64_t FeaturesHash(const Faceprints& faceprints);
+
+/**
+ * User defined callback for user digests query.
+ */
+class UserDigestsCallback
+{
+public:
+    virtual ~UserDigestsCallback() = default;
+
+    /**
+     * Called for each enrolled user, in the device's database order.
+     * Must not call back into the FaceAuthenticator.
+     *
+     * @param[in] digest User's digest, valid only during the call.
+     */
+    virtual void OnUserDigest(const UserDigest& digest) = 0;
+};
+} // namespace RealSenseID
@@ -0,0 +1,25 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+namespace RealSenseID
+{
+/**
+ * User defined callback for streaming user ids query.
+ * Callback will be used to deliver the user ids as they arrive from the device.
+ */
+class UserIdsCallback
+{
+public:
+    virtual ~UserIdsCallback() = default;
+
+    /**
+     * Called for each enrolled user, in the device's database order.
+     * Must not call back into the FaceAuthenticator.
+     *
+     * @param[in] user_id User ID, valid only during the call.
+     */
+    virtual void OnUserId(const char* user_id) = 0;
+};
+} // namespace RealSenseID
@@ -22,6 +22,7 @@ int main()
     rsid_preview* preview;
     config.camera_number = -1;  // auto detect
     config.preview_mode = RSID_VGA;
+    config.preview_format = RSID_PREVIEW_DEFAULT;
 
     preview = rsid_create_preview(&config);
     rsid_start_preview(preview,render,NULL);
@@ -0,0 +1,354 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "AsyncExecutor.h"
+#include "ThreadConfigImpl.h"
+#include "Logger.h"
+#include <algorithm>
+#include <exception>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "AsyncExecutor";
+
+void AsyncOperation::SetExecutorThreads(unsigned int threads)
+{
+    AsyncExecutor::SetThreads(threads);
+}
+
+AsyncOperation::AsyncOperation(AsyncOperationImpl* impl) : _impl {impl}
+{
+}
+
+AsyncOperation::~AsyncOperation()
+{
+    if (_impl)
+        _impl->Release();
+}
+
+AsyncOperation::AsyncOperation(const AsyncOperation& other) : _impl {other._impl}
+{
+    if (_impl)
+        _impl->AddRef();
+}
+
+AsyncOperation::AsyncOperation(AsyncOperation&& other) noexcept : _impl {other._impl}
+{
+    other._impl = nullptr;
+}
+
+AsyncOperation& AsyncOperation::operator=(const AsyncOperation& other)
+{
+    if (other._impl)
+        other._impl->AddRef();
+    if (_impl)
+        _impl->Release();
+    _impl = other._impl;
+    return *this;
+}
+
+AsyncOperation& AsyncOperation::operator=(AsyncOperation&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (_impl)
+            _impl->Release();
+        _impl = other._impl;
+        other._impl = nullptr;
+    }
+    return *this;
+}
+
+bool AsyncOperation::IsValid() const
+{
+    return _impl != nullptr;
+}
+
+bool AsyncOperation::IsDone() const
+{
+    return _impl != nullptr && _impl->IsDone();
+}
+
+Status AsyncOperation::Wait() const
+{
+    return _impl ? _impl->Wait() : Status::Error;
+}
+
+bool AsyncOperation::WaitFor(unsigned int timeout_ms) const
+{
+    return _impl != nullptr && _impl->WaitFor(std::chrono::milliseconds {timeout_ms});
+}
+
+Status AsyncOperation::GetStatus() const
+{
+    return _impl ? _impl->GetStatus() : Status::Error;
+}
+
+void AsyncOperation::Cancel()
+{
+    if (_impl)
+        _impl->Cancel();
+}
+
+AsyncOperationImpl::AsyncOperationImpl(Work work, Canceller canceller, AsyncOperation::Completion completion) :
+    _work {std::move(work)}, _canceller {std::move(canceller)}, _completion {std::move(completion)}
+{
+}
+
+AsyncOperation AsyncOperationImpl::Handle(AsyncOperationImpl* operation)
+{
+    operation->AddRef();
+    return AsyncOperation {operation};
+}
+
+void AsyncOperationImpl::AddRef()
+{
+    _refs.fetch_add(1);
+}
+
+void AsyncOperationImpl::Release()
+{
+    if (_refs.fetch_sub(1) == 1)
+        delete this;
+}
+
+void AsyncOperationImpl::Run()
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (_state != State::Queued)
+        {
+            return; // canceled while queued
+        }
+        _state = State::Running;
+    }
+
+    auto status = Status::Error;
+    try
+    {
+        status = _work();
+    }
+    catch (const std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Unknown exception in async operation");
+    }
+
+    std::unique_lock<std::mutex> lock {_mutex};
+    Complete(lock, status);
+}
+
+void AsyncOperationImpl::Cancel()
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    if (_state == State::Queued)
+    {
+        LOG_DEBUG(LOG_TAG, "Canceled queued operation");
+        Complete(lock, Status::Error);
+    }
+    else if (_state == State::Running && _canceller)
+    {
+        // the lock keeps the operation running (and its authenticator alive) until the cancel is sent
+        _canceller();
+    }
+}
+
+bool AsyncOperationImpl::IsDone() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _state == State::Done;
+}
+
+Status AsyncOperationImpl::Wait() const
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    _done_cv.wait(lock, [this] { return _state == State::Done; });
+    return _status;
+}
+
+bool AsyncOperationImpl::WaitFor(std::chrono::milliseconds timeout) const
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    return _done_cv.wait_for(lock, timeout, [this] { return _state == State::Done; });
+}
+
+Status AsyncOperationImpl::GetStatus() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _state == State::Done ? _status : Status::Error;
+}
+
+void AsyncOperationImpl::Complete(std::unique_lock<std::mutex>& lock, Status status)
+{
+    _state = State::Done;
+    _status = status;
+    // drop the work's references to the user callbacks, they may be gone once the operation is done
+    auto work = std::move(_work);
+    auto canceller = std::move(_canceller);
+    auto completion = std::move(_completion);
+    lock.unlock();
+    _done_cv.notify_all();
+
+    if (completion)
+    {
+        try
+        {
+            completion(status);
+        }
+        catch (const std::exception& ex)
+        {
+            LOG_EXCEPTION(LOG_TAG, ex);
+        }
+        catch (...)
+        {
+            LOG_ERROR(LOG_TAG, "Unknown exception in completion callback");
+        }
+    }
+}
+
+std::atomic<unsigned int> AsyncExecutor::_max_threads {AsyncOperation::DefaultExecutorThreads};
+
+std::shared_ptr<AsyncExecutor> AsyncExecutor::Acquire()
+{
+    static std::mutex instance_mutex;
+    static std::weak_ptr<AsyncExecutor> instance;
+
+    std::lock_guard<std::mutex> lock {instance_mutex};
+    auto executor = instance.lock();
+    if (!executor)
+    {
+        executor = std::make_shared<AsyncExecutor>();
+        instance = executor;
+    }
+    return executor;
+}
+
+void AsyncExecutor::SetThreads(unsigned int threads)
+{
+    _max_threads.store(std::max(threads, 1u));
+}
+
+AsyncExecutor::~AsyncExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _stop = true;
+    }
+    _work_cv.notify_all();
+    for (auto& thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void AsyncExecutor::Post(Strand& strand, AsyncOperationImpl* operation)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    PostLocked(strand, operation);
+}
+
+void AsyncExecutor::Post(AsyncOperationImpl* operation)
+{
+    auto* strand = new Strand;
+    strand->detached = true;
+    std::lock_guard<std::mutex> lock {_mutex};
+    PostLocked(*strand, operation);
+}
+
+void AsyncExecutor::PostLocked(Strand& strand, AsyncOperationImpl* operation)
+{
+    operation->AddRef();
+    strand.operations.push_back(operation);
+    if (strand.scheduled)
+    {
+        return; // runs after the strand's current operation
+    }
+
+    strand.scheduled = true;
+    _ready.push_back(&strand);
+    if (_waiting < _ready.size() && _running < _max_threads.load())
+    {
+        _threads.emplace_back(&AsyncExecutor::ThreadLoop, this);
+        _running++;
+    }
+    else
+    {
+        _work_cv.notify_one();
+    }
+}
+
+void AsyncExecutor::Drain(Strand& strand)
+{
+    std::vector<AsyncOperationImpl*> operations;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        for (auto* operation : strand.operations)
+        {
+            operation->AddRef();
+            operations.push_back(operation);
+        }
+    }
+    for (auto* operation : operations)
+    {
+        operation->Cancel();
+        operation->Release();
+    }
+
+    std::unique_lock<std::mutex> lock {_mutex};
+    _idle_cv.wait(lock, [&strand] { return !strand.scheduled; });
+}
+
+void AsyncExecutor::ThreadLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Async, "executor");
+    std::unique_lock<std::mutex> lock {_mutex};
+    while (true)
+    {
+        _waiting++;
+        _work_cv.wait(lock, [this] { return _stop || !_ready.empty(); });
+        _waiting--;
+        if (_ready.empty())
+        {
+            break; // stopped
+        }
+
+        // run one operation of the strand, then requeue it behind the other ready strands
+        Strand* strand = _ready.front();
+        _ready.pop_front();
+        auto* operation = strand->operations.front();
+
+        lock.unlock();
+        operation->Run();
+        lock.lock();
+
+        strand->operations.pop_front();
+        if (strand->operations.empty() && strand->detached)
+        {
+            delete strand;
+        }
+        else if (strand->operations.empty())
+        {
+            strand->scheduled = false;
+            _idle_cv.notify_all();
+        }
+        else
+        {
+            _ready.push_back(strand);
+        }
+
+        lock.unlock();
+        operation->Release();
+        lock.lock();
+
+        if (_running > _max_threads.load())
+        {
+            _work_cv.notify_one(); // in case a strand was requeued
+            break;                 // threads were lowered
+        }
+    }
+    _running--;
+}
+} // namespace RealSenseID
@@ -0,0 +1,115 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/AsyncOperation.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RealSenseID
+{
+// State of an async operation, shared by its handles and the executor
+class AsyncOperationImpl
+{
+public:
+    using Work = std::function<Status()>;
+    using Canceller = std::function<void()>;
+
+    // canceller is called (with the operation's lock held) to cancel the work while it runs
+    AsyncOperationImpl(Work work, Canceller canceller, AsyncOperation::Completion completion);
+
+    AsyncOperationImpl(const AsyncOperationImpl&) = delete;
+    AsyncOperationImpl& operator=(const AsyncOperationImpl&) = delete;
+
+    // new handle of the operation
+    static AsyncOperation Handle(AsyncOperationImpl* operation);
+
+    void AddRef();
+    void Release();
+
+    // run the work on the calling thread, unless already canceled
+    void Run();
+    void Cancel();
+
+    bool IsDone() const;
+    Status Wait() const;
+    bool WaitFor(std::chrono::milliseconds timeout) const;
+    Status GetStatus() const;
+
+private:
+    enum class State
+    {
+        Queued,
+        Running,
+        Done
+    };
+
+    Work _work;
+    Canceller _canceller;
+    AsyncOperation::Completion _completion;
+    std::atomic<int> _refs {1};
+
+    mutable std::mutex _mutex;
+    mutable std::condition_variable _done_cv;
+    State _state = State::Queued;
+    Status _status = Status::Error;
+
+    void Complete(std::unique_lock<std::mutex>& lock, Status status); // unlocks before calling the completion
+};
+
+// Process wide pool of threads running the async operations.
+// Shared by the authenticators that use it, the threads stop when the last one releases it.
+class AsyncExecutor
+{
+public:
+    // operations of a strand run one at a time, in order
+    struct Strand
+    {
+        std::deque<AsyncOperationImpl*> operations; // front one is running if scheduled
+        bool scheduled = false;                     // in the ready queue or running on a thread
+        bool detached = false;                      // owned by the executor, deleted once its operation ran
+    };
+
+    static std::shared_ptr<AsyncExecutor> Acquire();
+    static void SetThreads(unsigned int threads);
+
+    AsyncExecutor() = default;
+    ~AsyncExecutor();
+
+    AsyncExecutor(const AsyncExecutor&) = delete;
+    AsyncExecutor& operator=(const AsyncExecutor&) = delete;
+
+    // queue the operation (takes a reference) on the strand
+    void Post(Strand& strand, AsyncOperationImpl* operation);
+
+    // queue an operation not ordered with any other (takes a reference), e.g. the update of a device
+    void Post(AsyncOperationImpl* operation);
+
+    // cancel the strand's operations and wait for the running one to complete
+    void Drain(Strand& strand);
+
+private:
+    static std::atomic<unsigned int> _max_threads;
+
+    std::mutex _mutex; // guards the strands, the ready queue and the threads
+    std::condition_variable _work_cv;
+    std::condition_variable _idle_cv;
+    std::deque<Strand*> _ready; // strands with queued operations and no running one
+    std::vector<std::thread> _threads;
+    unsigned int _waiting = 0; // threads waiting for work
+    unsigned int _running = 0; // threads started and not exited
+    bool _stop = false;
+
+    void PostLocked(Strand& strand, AsyncOperationImpl* operation);
+    void ThreadLoop();
+};
+} // namespace RealSenseID
@@ -0,0 +1,93 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "AuthLoopFilter.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "AuthLoopFilter";
+
+AuthLoopFilter::AuthLoopFilter(AuthenticationCallback& callback, const AuthLoopConfig& config) :
+    _callback {callback}, _duplicate_window {config.duplicateWindowMs},
+    _min_result_interval {config.minResultIntervalMs}, _suppress_repeated_hints {config.suppressRepeatedHints},
+    _track_faces {config.trackFaces}, _tracker {std::chrono::milliseconds {config.trackReauthIntervalMs}}
+{
+}
+
+void AuthLoopFilter::OnResult(const AuthenticateStatus status, const char* userId)
+{
+    auto now = clock::now();
+    std::string tracked_user;
+    // only the match outcomes are redundant for an authenticated track, errors and spoof results are reported
+    const bool is_match_result = status == AuthenticateStatus::Success || status == AuthenticateStatus::Forbidden;
+    if (_track_faces && is_match_result && _tracker.IsAuthenticated(tracked_user, now))
+    {
+        LOG_DEBUG(LOG_TAG, "Result %s of an authenticated track, not reported", Description(status));
+        return;
+    }
+    if (_track_faces && status == AuthenticateStatus::Success)
+    {
+        _tracker.SetAuthenticated(userId, now);
+    }
+    if (_has_result && now - _last_result < _min_result_interval)
+    {
+        LOG_DEBUG(LOG_TAG, "Result %s within the min result interval, not reported", Description(status));
+        return;
+    }
+    if (status == AuthenticateStatus::Success && userId != nullptr && IsDuplicate(userId, now))
+    {
+        LOG_DEBUG(LOG_TAG, "User already reported within the duplicate window");
+        return;
+    }
+
+    _has_result = true;
+    _last_result = now;
+    _has_hint = false;
+    _callback.OnResult(status, userId);
+}
+
+void AuthLoopFilter::OnHint(const AuthenticateStatus hint)
+{
+    if (_suppress_repeated_hints && _has_hint && hint == _last_hint)
+    {
+        return;
+    }
+    _has_hint = true;
+    _last_hint = hint;
+    _callback.OnHint(hint);
+}
+
+void AuthLoopFilter::OnFacesDetected(const FaceRect* faces, size_t count)
+{
+    if (_track_faces)
+    {
+        _tracker.Update(faces, count);
+    }
+    _callback.OnFacesDetected(faces, count);
+}
+
+// check if the user's success was reported within the window, remember it otherwise
+bool AuthLoopFilter::IsDuplicate(const char* user_id, clock::time_point now)
+{
+    if (_duplicate_window.count() == 0)
+    {
+        return false;
+    }
+
+    auto window = _duplicate_window;
+    _reported_users.erase(std::remove_if(_reported_users.begin(), _reported_users.end(),
+                                         [now, window](const ReportedUser& user) { return now - user.time >= window; }),
+                          _reported_users.end());
+
+    auto it = std::find_if(_reported_users.begin(), _reported_users.end(),
+                           [user_id](const ReportedUser& user) { return user.user_id == user_id; });
+    if (it != _reported_users.end())
+    {
+        return true;
+    }
+    _reported_users.push_back({user_id, now});
+    return false;
+}
+} // namespace RealSenseID
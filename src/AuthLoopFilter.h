@@ -0,0 +1,49 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceTracker.h"
+#include "RealSenseID/AuthenticationCallback.h"
+#include "RealSenseID/AuthLoopConfig.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+// Authentication callback applying an AuthLoopConfig to the events it forwards
+class AuthLoopFilter : public AuthenticationCallback
+{
+public:
+    AuthLoopFilter(AuthenticationCallback& callback, const AuthLoopConfig& config);
+
+    void OnResult(const AuthenticateStatus status, const char* userId) override;
+    void OnHint(const AuthenticateStatus hint) override;
+    void OnFacesDetected(const FaceRect* faces, size_t count) override;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct ReportedUser
+    {
+        std::string user_id;
+        clock::time_point time;
+    };
+
+    AuthenticationCallback& _callback;
+    std::chrono::milliseconds _duplicate_window;
+    std::chrono::milliseconds _min_result_interval;
+    bool _suppress_repeated_hints;
+
+    bool _has_result = false;
+    clock::time_point _last_result;
+    bool _has_hint = false;
+    AuthenticateStatus _last_hint = AuthenticateStatus::Success;
+    std::vector<ReportedUser> _reported_users; // successes within the duplicate window
+    bool _track_faces;
+    FaceTracker _tracker;
+
+    bool IsDuplicate(const char* user_id, clock::time_point now);
+};
+} // namespace RealSenseID
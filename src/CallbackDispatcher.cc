@@ -0,0 +1,284 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "CallbackDispatcher.h"
+#include "TaskScheduler.h"
+#include "Logger.h"
+#include "MetricsRecorder.h"
+#include <algorithm>
+#include <cstring>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "CallbackDispatcher";
+
+CallbackDispatcher::CallbackDispatcher(const CallbackDispatchConfig& config) :
+    _policy {config.queuePolicy}, _events(std::max(config.queueSize, 1u)), _scheduler {TaskScheduler::Acquire()}
+{
+}
+
+CallbackDispatcher::~CallbackDispatcher()
+{
+    try
+    {
+        Flush();
+    }
+    catch (...)
+    {
+    }
+}
+
+void CallbackDispatcher::Flush()
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    _queue_cv.wait(lock, [this] { return !_scheduled; });
+}
+
+unsigned int CallbackDispatcher::Dropped() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _dropped;
+}
+
+bool CallbackDispatcher::IsDroppable(EventType type)
+{
+    return type != EventType::AuthResult && type != EventType::EnrollResult;
+}
+
+bool CallbackDispatcher::DropOldest()
+{
+    for (size_t i = 0; i < _count; i++)
+    {
+        if (!IsDroppable(_events[(_head + i) % _events.size()].type))
+        {
+            continue;
+        }
+        // close the gap, keeping the order of the rest
+        for (size_t j = i; j > 0; j--)
+        {
+            _events[(_head + j) % _events.size()] = _events[(_head + j - 1) % _events.size()];
+        }
+        _head = (_head + 1) % _events.size();
+        _count--;
+        _dropped++;
+        Metrics::Add(Metrics::Counter::CallbackEventsDropped);
+        return true;
+    }
+    return false;
+}
+
+void CallbackDispatcher::Post(const Event& event)
+{
+    {
+        std::unique_lock<std::mutex> lock {_mutex};
+        if (_count == _events.size())
+        {
+            if (_policy == CallbackQueuePolicy::DropOldest && IsDroppable(event.type) && !DropOldest())
+            {
+                // only results queued, drop the new event instead
+                _dropped++;
+                Metrics::Add(Metrics::Counter::CallbackEventsDropped);
+                return;
+            }
+            // Block policy, or a result which must wait for room
+            _queue_cv.wait(lock, [this] { return _count < _events.size(); });
+        }
+        _events[(_head + _count) % _events.size()] = event;
+        _count++;
+        if (_scheduled)
+        {
+            return; // delivered by the running task
+        }
+        _scheduled = true;
+    }
+    _scheduler->Submit([this]() { DeliverQueued(); });
+}
+
+void CallbackDispatcher::Deliver(const Event& event)
+{
+    const char* user_id = event.has_user_id ? event.user_id : nullptr;
+    switch (event.type)
+    {
+    case EventType::AuthResult:
+        event.auth_callback->OnResult(static_cast<AuthenticateStatus>(event.status), user_id);
+        break;
+    case EventType::AuthHint:
+        event.auth_callback->OnHint(static_cast<AuthenticateStatus>(event.status));
+        break;
+    case EventType::AuthFaces:
+        event.auth_callback->OnFacesDetected(event.faces, event.face_count);
+        break;
+    case EventType::EnrollResult:
+        event.enroll_callback->OnResult(static_cast<EnrollStatus>(event.status));
+        break;
+    case EventType::EnrollProgress:
+        event.enroll_callback->OnProgress(static_cast<FacePose>(event.status));
+        break;
+    case EventType::EnrollHint:
+        event.enroll_callback->OnHint(static_cast<EnrollStatus>(event.status));
+        break;
+    case EventType::EnrollFaces:
+        event.enroll_callback->OnFacesDetected(event.faces, event.face_count);
+        break;
+    }
+}
+
+void CallbackDispatcher::DeliverQueued()
+{
+    // up to a queue of events per task, then the task is submitted again so a busy flow does not hold a thread of
+    // the scheduler
+    Event event;
+    for (size_t delivered = 0;; delivered++)
+    {
+        {
+            std::lock_guard<std::mutex> lock {_mutex};
+            if (_count == 0 || delivered == _events.size())
+            {
+                _scheduled = _count > 0;
+                // notified under the lock, the dispatcher may be destroyed once it is released
+                _queue_cv.notify_all();
+                if (!_scheduled)
+                {
+                    return;
+                }
+                break;
+            }
+            event = _events[_head];
+            _head = (_head + 1) % _events.size();
+            _count--;
+        }
+        _queue_cv.notify_all(); // room in the queue
+
+        try
+        {
+            Deliver(event);
+        }
+        catch (const std::exception& ex)
+        {
+            LOG_EXCEPTION(LOG_TAG, ex);
+        }
+        catch (...)
+        {
+            LOG_ERROR(LOG_TAG, "Unknown exception in callback");
+        }
+    }
+    _scheduler->Submit([this]() { DeliverQueued(); });
+}
+
+// Proxies
+
+static void CopyFaces(const FaceRect* faces, size_t count, FaceRect* target, size_t max_faces, size_t& target_count)
+{
+    target_count = std::min(count, max_faces);
+    std::copy(faces, faces + target_count, target);
+}
+
+static void CopyUserId(const char* user_id, char* target, size_t target_size, bool& has_user_id)
+{
+    has_user_id = user_id != nullptr;
+    if (has_user_id)
+    {
+        auto length = ::strnlen(user_id, target_size - 1);
+        ::memcpy(target, user_id, length);
+        target[length] = '\0';
+    }
+}
+
+CallbackDispatcher::AuthenticationProxy::AuthenticationProxy(CallbackDispatcher& dispatcher,
+                                                             AuthenticationCallback& callback) :
+    _dispatcher {dispatcher},
+    _callback {callback}
+{
+}
+
+CallbackDispatcher::AuthenticationProxy::~AuthenticationProxy()
+{
+    try
+    {
+        _dispatcher.Flush();
+    }
+    catch (...)
+    {
+    }
+}
+
+void CallbackDispatcher::AuthenticationProxy::OnResult(const AuthenticateStatus status, const char* userId)
+{
+    Event event;
+    event.type = EventType::AuthResult;
+    event.auth_callback = &_callback;
+    event.status = static_cast<int>(status);
+    CopyUserId(userId, event.user_id, sizeof(event.user_id), event.has_user_id);
+    _dispatcher.Post(event);
+}
+
+void CallbackDispatcher::AuthenticationProxy::OnHint(const AuthenticateStatus hint)
+{
+    Event event;
+    event.type = EventType::AuthHint;
+    event.auth_callback = &_callback;
+    event.status = static_cast<int>(hint);
+    _dispatcher.Post(event);
+}
+
+void CallbackDispatcher::AuthenticationProxy::OnFacesDetected(const FaceRect* faces, size_t count)
+{
+    Event event;
+    event.type = EventType::AuthFaces;
+    event.auth_callback = &_callback;
+    CopyFaces(faces, count, event.faces, MaxFaces, event.face_count);
+    _dispatcher.Post(event);
+}
+
+CallbackDispatcher::EnrollmentProxy::EnrollmentProxy(CallbackDispatcher& dispatcher, EnrollmentCallback& callback) :
+    _dispatcher {dispatcher}, _callback {callback}
+{
+}
+
+CallbackDispatcher::EnrollmentProxy::~EnrollmentProxy()
+{
+    try
+    {
+        _dispatcher.Flush();
+    }
+    catch (...)
+    {
+    }
+}
+
+void CallbackDispatcher::EnrollmentProxy::OnResult(const EnrollStatus status)
+{
+    Event event;
+    event.type = EventType::EnrollResult;
+    event.enroll_callback = &_callback;
+    event.status = static_cast<int>(status);
+    _dispatcher.Post(event);
+}
+
+void CallbackDispatcher::EnrollmentProxy::OnProgress(const FacePose pose)
+{
+    Event event;
+    event.type = EventType::EnrollProgress;
+    event.enroll_callback = &_callback;
+    event.status = static_cast<int>(pose);
+    _dispatcher.Post(event);
+}
+
+void CallbackDispatcher::EnrollmentProxy::OnHint(const EnrollStatus hint)
+{
+    Event event;
+    event.type = EventType::EnrollHint;
+    event.enroll_callback = &_callback;
+    event.status = static_cast<int>(hint);
+    _dispatcher.Post(event);
+}
+
+void CallbackDispatcher::EnrollmentProxy::OnFacesDetected(const FaceRect* faces, size_t count)
+{
+    Event event;
+    event.type = EventType::EnrollFaces;
+    event.enroll_callback = &_callback;
+    CopyFaces(faces, count, event.faces, MaxFaces, event.face_count);
+    _dispatcher.Post(event);
+}
+} // namespace RealSenseID
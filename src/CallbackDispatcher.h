@@ -0,0 +1,113 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/AuthenticationCallback.h"
+#include "RealSenseID/CallbackDispatch.h"
+#include "RealSenseID/EnrollmentCallback.h"
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace RealSenseID
+{
+class TaskScheduler;
+
+// Delivers the events of the device flows' callbacks on the task scheduler, so a slow callback does not hold up the
+// flow's packet receive (and the device's serial output). The events are copied to a bounded queue of preallocated
+// events, overflow is handled by the config's policy. Results are never dropped. One delivery task at a time, so the
+// events are delivered in order.
+class CallbackDispatcher
+{
+public:
+    explicit CallbackDispatcher(const CallbackDispatchConfig& config);
+    ~CallbackDispatcher(); // delivers the queued events
+
+    CallbackDispatcher(const CallbackDispatcher&) = delete;
+    CallbackDispatcher& operator=(const CallbackDispatcher&) = delete;
+
+    // the flow's callback. queues the events of the user's callback, and waits for their delivery on destruction
+    class AuthenticationProxy : public AuthenticationCallback
+    {
+    public:
+        AuthenticationProxy(CallbackDispatcher& dispatcher, AuthenticationCallback& callback);
+        ~AuthenticationProxy();
+
+        void OnResult(const AuthenticateStatus status, const char* userId) override;
+        void OnHint(const AuthenticateStatus hint) override;
+        void OnFacesDetected(const FaceRect* faces, size_t count) override;
+
+    private:
+        CallbackDispatcher& _dispatcher;
+        AuthenticationCallback& _callback;
+    };
+
+    class EnrollmentProxy : public EnrollmentCallback
+    {
+    public:
+        EnrollmentProxy(CallbackDispatcher& dispatcher, EnrollmentCallback& callback);
+        ~EnrollmentProxy();
+
+        void OnResult(const EnrollStatus status) override;
+        void OnProgress(const FacePose pose) override;
+        void OnHint(const EnrollStatus hint) override;
+        void OnFacesDetected(const FaceRect* faces, size_t count) override;
+
+    private:
+        CallbackDispatcher& _dispatcher;
+        EnrollmentCallback& _callback;
+    };
+
+    // wait until the queued events are delivered
+    void Flush();
+
+    // events dropped by the queue policy so far
+    unsigned int Dropped() const;
+
+private:
+    static constexpr size_t MaxFaces = 10;
+
+    enum class EventType
+    {
+        AuthResult,
+        AuthHint,
+        AuthFaces,
+        EnrollResult,
+        EnrollProgress,
+        EnrollHint,
+        EnrollFaces
+    };
+
+    struct Event
+    {
+        EventType type = EventType::AuthResult;
+        AuthenticationCallback* auth_callback = nullptr;
+        EnrollmentCallback* enroll_callback = nullptr;
+        int status = 0; // AuthenticateStatus, EnrollStatus or FacePose
+        bool has_user_id = false;
+        char user_id[32] = {0}; // up to FaceAuthenticator::MAX_USERID_LENGTH bytes
+        size_t face_count = 0;
+        FaceRect faces[MaxFaces];
+    };
+
+    CallbackQueuePolicy _policy;
+    std::vector<Event> _events; // ring of _count events from _head
+    size_t _head = 0;
+    size_t _count = 0;
+    bool _scheduled = false; // a delivery task is queued or running
+    unsigned int _dropped = 0;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _queue_cv; // room in the queue, or queue drained
+    std::shared_ptr<TaskScheduler> _scheduler;
+
+    void Post(const Event& event); // waits or drops as set by the policy if the queue is full
+    bool DropOldest();             // with _mutex held. false if all queued events are results
+    static bool IsDroppable(EventType type);
+    static void Deliver(const Event& event);
+    void DeliverQueued(); // the delivery task
+};
+} // namespace RealSenseID
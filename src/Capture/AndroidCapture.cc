@@ -6,6 +6,9 @@
 #include <stdexcept>
 #include <android/api-level.h>
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <sstream>
 
 static const char* LOG_TAG = "AndroidCapture";
@@ -22,7 +25,36 @@ static void ThrowIfFailed(const char *what, uvc_error_t uvc_err)
     throw std::runtime_error(err_stream.str());
 }
 
-CaptureHandle::CaptureHandle(const PreviewConfig& config) : _config(config)
+// highest frame rate the camera streams width x height at, 0 (the default rate) if not described
+static int MaxFrameRate(uvc_device_handle_t* devh, int width, int height)
+{
+    // frame intervals are in 100ns units
+    uint32_t min_interval = 0;
+    for (const uvc_format_desc_t* format = uvc_get_format_descs(devh); format; format = format->next)
+    {
+        for (const uvc_frame_desc_t* frame = format->frame_descs; frame; frame = frame->next)
+        {
+            if (frame->wWidth != width || frame->wHeight != height)
+                continue;
+            // discrete intervals are a zero terminated list, otherwise a continuous range from dwMinFrameInterval
+            if (frame->bFrameIntervalType != 0 && frame->intervals)
+            {
+                for (const uint32_t* interval = frame->intervals; *interval; interval++)
+                {
+                    if (min_interval == 0 || *interval < min_interval)
+                        min_interval = *interval;
+                }
+            }
+            else if (frame->dwMinFrameInterval != 0 && (min_interval == 0 || frame->dwMinFrameInterval < min_interval))
+            {
+                min_interval = frame->dwMinFrameInterval;
+            }
+        }
+    }
+    return min_interval != 0 ? static_cast<int>(10000000 / min_interval) : 0;
+}
+
+CaptureHandle::CaptureHandle(const PreviewConfig& config, unsigned int max_fps) : _config(config)
 {
     int sys_dev = _config.cameraNumber;
     libusb_context *usb_context = NULL;
@@ -47,39 +79,169 @@ CaptureHandle::CaptureHandle(const PreviewConfig& config) : _config(config)
     res = uvc_wrap(sys_dev, ctx, &devh);
     ThrowIfFailed("uvc_wrap", res);
 
-     /* find stream by width, height. use default fps */
-    res = uvc_get_stream_ctrl_format_size(devh, &ctrl, UVC_FRAME_FORMAT_ANY, VGA_WIDTH, VGA_HEIGHT, 0);
+    // find stream by width, height at the camera's highest frame rate (at most max_fps), or its default rate if that
+    // is refused
+    int fps = MaxFrameRate(devh, VGA_WIDTH, VGA_HEIGHT);
+    if (max_fps > 0 && (fps == 0 || static_cast<unsigned int>(fps) > max_fps))
+        fps = static_cast<int>(max_fps);
+    res = uvc_get_stream_ctrl_format_size(devh, &ctrl, UVC_FRAME_FORMAT_ANY, VGA_WIDTH, VGA_HEIGHT, fps);
+    if (res != UVC_SUCCESS && fps != 0)
+    {
+        LOG_DEBUG(LOG_TAG, "%d fps not negotiated, using the default frame rate", fps);
+        res = uvc_get_stream_ctrl_format_size(devh, &ctrl, UVC_FRAME_FORMAT_ANY, VGA_WIDTH, VGA_HEIGHT, 0);
+    }
     ThrowIfFailed("uvc_get_stream_ctrl_format_size", res);
 
+    _stream_converter.InitStream(VGA_WIDTH, VGA_HEIGHT, _config, PreviewFormat::YUYV);
+
+    // slots are allocated once, the callback copies into them without allocations
+    _frames.resize(std::max(_config.captureBuffers, 2u));
+    for (auto& raw_frame : _frames)
+    {
+        raw_frame.data.resize(VGA_WIDTH * VGA_HEIGHT * YUV_PIXEL_SIZE);
+    }
+
     res = uvc_stream_open_ctrl(devh, &stream, &ctrl);
     ThrowIfFailed("uvc_stream_open_ctrl", res);
-    res = uvc_stream_start(stream, NULL, (void*)this, 0);
+    res = uvc_stream_start(stream, &CaptureHandle::OnFrame, (void*)this, 0);
     ThrowIfFailed("uvc_stream_start", res);
-
-    _stream_converter.InitStream(VGA_WIDTH,VGA_HEIGHT,_config.previewMode);
 };
 
 CaptureHandle::~CaptureHandle()
 {
+    // no callbacks once stopped
     uvc_stop_streaming(devh);
     LOG_DEBUG(LOG_TAG, "release camera");
     uvc_close(devh);
     uvc_exit(ctx);
 }
 
-bool CaptureHandle::Read(RealSenseID::Image* res)
+unsigned int CaptureHandle::ImageSize() const
+{
+    return _stream_converter.ImageSize();
+}
+
+// called on libuvc's callback thread, the frame is valid during the call only
+void CaptureHandle::OnFrame(uvc_frame_t* frame, void* user_ptr)
+{
+    if (frame && frame->data && user_ptr)
+    {
+        static_cast<CaptureHandle*>(user_ptr)->PushFrame(frame);
+    }
+}
+
+void CaptureHandle::PushFrame(const uvc_frame_t* frame)
+{
+    const uint64_t arrival_time = HostTimeUs();
+    std::lock_guard<std::mutex> lock {_frames_mutex};
+
+    // a free slot, or the oldest ready frame which is dropped
+    RawFrame* slot = nullptr;
+    for (auto& raw_frame : _frames)
+    {
+        if (raw_frame.state == RawFrame::State::Free)
+        {
+            slot = &raw_frame;
+            break;
+        }
+        if (raw_frame.state == RawFrame::State::Ready && (!slot || raw_frame.sequence < slot->sequence))
+        {
+            slot = &raw_frame;
+        }
+    }
+    if (!slot)
+    {
+        return; // all slots held by the reader
+    }
+    if (frame->data_bytes > slot->data.size())
+    {
+        LOG_ERROR_LIMITED(LOG_TAG, "Frame of %zu bytes larger than the capture buffers", frame->data_bytes);
+        return;
+    }
+    ::memcpy(slot->data.data(), frame->data, frame->data_bytes);
+    slot->size = frame->data_bytes;
+    slot->sequence = _next_sequence++;
+    slot->arrival_time = arrival_time;
+    slot->state = RawFrame::State::Ready;
+    _frame_ready.notify_one();
+}
+
+int CaptureHandle::PopFrame(unsigned int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock {_frames_mutex};
+    int oldest = -1;
+    auto find_oldest = [this, &oldest] {
+        for (size_t i = 0; i < _frames.size(); i++)
+        {
+            if (_frames[i].state == RawFrame::State::Ready &&
+                (oldest < 0 || _frames[i].sequence < _frames[oldest].sequence))
+            {
+                oldest = static_cast<int>(i);
+            }
+        }
+        return oldest >= 0;
+    };
+    if (!_frame_ready.wait_for(lock, std::chrono::milliseconds {timeout_ms}, find_oldest))
+    {
+        return -1;
+    }
+    _frames[oldest].state = RawFrame::State::Reading;
+    return oldest;
+}
+
+void CaptureHandle::ReleaseFrame(int index)
+{
+    std::lock_guard<std::mutex> lock {_frames_mutex};
+    _frames[index].state = RawFrame::State::Free;
+}
+
+bool CaptureHandle::Skip()
+{
+    if (!stream)
+    {
+        return false;
+    }
+    int index = PopFrame(10000);
+    if (index < 0)
+    {
+        return false;
+    }
+    ReleaseFrame(index);
+    return true;
+}
+
+bool CaptureHandle::Read(RealSenseID::Image* res, unsigned char* target)
 {
     if (!stream){
         return false;
     }
-    uvc_error_t err;
-    err = uvc_stream_get_frame(stream, &frame, 10000);
-    if (err != UVC_SUCCESS || frame == NULL)
+    if (_held_frame >= 0)
+    {
+        ReleaseFrame(_held_frame);
+        _held_frame = -1;
+    }
+    int index = PopFrame(10000);
+    if (index < 0)
     {
         return false;
     }
 
-    return _stream_converter.Buffer2Image(res,(unsigned char*)frame->data,frame->data_bytes);
+    // the slot is not written by the callback until released
+    RawFrame& raw_frame = _frames[index];
+    res->timing.dequeueTime = HostTimeUs();
+    res->timing.captureTimestamp = raw_frame.arrival_time;
+    res->timing.captureOnHostClock = true;
+    bool valid_read = _stream_converter.Buffer2Image(res, raw_frame.data.data(),
+                                                     static_cast<unsigned int>(raw_frame.size), target);
+
+    // passthrough image points into the slot, keep it until the next read
+    if (valid_read && !target && _stream_converter.IsPassthrough())
+    {
+        _held_frame = index;
+        return true;
+    }
+    ReleaseFrame(index);
+    return valid_read;
 }
 } // namespace Capture
 } // namespace RealSenseID
\ No newline at end of file
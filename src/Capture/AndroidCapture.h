@@ -3,21 +3,30 @@
 
 #pragma once
 #include "RealSenseID/Preview.h"
+#include "CaptureSource.h"
 #include "StreamConverter.h"
 #include <libusb.h>
 #include <libuvc.h>
-
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
 
 namespace RealSenseID
 {
 namespace Capture
 {
-class CaptureHandle
+class CaptureHandle : public CaptureSource
 {
 public:
-    explicit CaptureHandle(const PreviewConfig& config);
-    ~CaptureHandle();
-    bool Read(RealSenseID::Image* container);
+    // max_fps: stream at most that many images per second (the nearest rate the camera supports), 0 for its full rate
+    explicit CaptureHandle(const PreviewConfig& config, unsigned int max_fps = 0);
+    ~CaptureHandle() override;
+    // target (optional) is a buffer of at least ImageSize() bytes to read the image into
+    bool Read(RealSenseID::Image* container, unsigned char* target = nullptr) override;
+    unsigned int ImageSize() const override;
+    // receive the next image without converting it
+    bool Skip() override;
 
     // prevent copy or assignment
     // only single connection is allowed to a captre device.
@@ -30,9 +39,36 @@ private:
     uvc_device_handle_t* devh = nullptr;
     uvc_stream_handle_t* stream = nullptr;
     uvc_stream_ctrl_t ctrl;
-    uvc_frame_t* frame = nullptr;
     StreamConverter _stream_converter;
     PreviewConfig _config;
+
+    // frames copied by the libuvc callback, converted by Read(). ring of PreviewConfig::captureBuffers slots, the
+    // oldest ready frame is dropped if the reader falls behind.
+    struct RawFrame
+    {
+        enum class State
+        {
+            Free,
+            Ready,
+            Reading, // converted by Read(), or held until the next Read() for passthrough images
+        };
+        State state = State::Free;
+        std::vector<unsigned char> data;
+        size_t size = 0;
+        uint64_t sequence = 0;
+        uint64_t arrival_time = 0;
+    };
+    std::mutex _frames_mutex;
+    std::condition_variable _frame_ready;
+    std::vector<RawFrame> _frames;
+    uint64_t _next_sequence = 0;
+    int _held_frame = -1;
+
+    static void OnFrame(uvc_frame_t* frame, void* user_ptr);
+    void PushFrame(const uvc_frame_t* frame);
+    // the oldest ready frame, waiting up to timeout_ms for one. -1 on timeout
+    int PopFrame(unsigned int timeout_ms);
+    void ReleaseFrame(int index);
 };
 } // namespace Capture
 } // namespace RealSenseID
\ No newline at end of file
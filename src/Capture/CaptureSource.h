@@ -0,0 +1,28 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+#include "RealSenseID/Preview.h"
+#include <memory>
+
+namespace RealSenseID
+{
+namespace Capture
+{
+// Source of the preview images: the camera (the platform's CaptureHandle) or a recording (PlaybackCapture).
+class CaptureSource
+{
+public:
+    virtual ~CaptureSource() = default;
+    // target (optional) is a buffer of at least ImageSize() bytes to read the image into
+    virtual bool Read(RealSenseID::Image* res, unsigned char* target = nullptr) = 0;
+    virtual unsigned int ImageSize() const = 0;
+    // receive the next image without converting it
+    virtual bool Skip() = 0;
+};
+
+// the recording of config.playbackPath if set (at its own pace), the camera otherwise (at most max_fps images per
+// second if not 0). throws if it could not be opened
+std::unique_ptr<CaptureSource> OpenCaptureSource(const PreviewConfig& config, unsigned int max_fps = 0);
+} // namespace Capture
+} // namespace RealSenseID
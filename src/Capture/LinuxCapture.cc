@@ -1,6 +1,6 @@
 #include "LinuxCapture.h"
 #include "Logger.h"
-#include <linux/videodev2.h>
+#include "TraceRecorder.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
@@ -10,6 +10,8 @@
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <algorithm>
+#include <chrono>
 
 namespace RealSenseID
 {
@@ -29,7 +31,7 @@ static void ThrowIfFailed(const char* what, int res)
     throw std::runtime_error(err_stream.str());
 }
 
-v4l2_format GetDefaultFormat(bool is_debug)
+v4l2_format GetDefaultFormat(bool is_debug, bool nv12 = false)
 { 
     v4l2_format format = {0};
     format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -40,7 +42,7 @@ v4l2_format GetDefaultFormat(bool is_debug)
     }
     else
     {
-        format.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+        format.fmt.pix.pixelformat = nv12 ? V4L2_PIX_FMT_NV12 : V4L2_PIX_FMT_YUYV;
         format.fmt.pix.width = VGA_WIDTH;
         format.fmt.pix.height = VGA_HEIGHT;
     }
@@ -58,25 +60,59 @@ void CleanMMAPBuffers(std::vector<buffer>& buffer_list)
             if (ret == FAILED_V4L)
                 LOG_ERROR(LOG_TAG, " unmapping buffer %d failed", i);
         }
+        if (buffer_list[i].dmabuf_fd >= 0)
+        {
+            close(buffer_list[i].dmabuf_fd);
+            buffer_list[i].dmabuf_fd = -1;
+        }
     }
 }
 
-CaptureHandle::CaptureHandle(const PreviewConfig& config): _config(config)
+CaptureHandle::CaptureHandle(const PreviewConfig& config, unsigned int max_fps): _config(config)
 {
     v4l2_format format;
+    PreviewFormat native_format = PreviewFormat::YUYV;
     std::string dev = VIDEO_DEV + std::to_string(_config.cameraNumber);
     _fd = open(dev.c_str(), O_RDWR | O_NONBLOCK, 0);
     ThrowIfFailed("fd", _fd);
 
     try
     {
-        // set format
-        format = GetDefaultFormat(_config.previewMode != PreviewMode::VGA);
+        // set format. the driver changes the pixel format to a supported one if NV12 can't be streamed.
+        const bool is_debug = _config.previewMode != PreviewMode::VGA;
+        // regions are cropped from YUYV
+        const bool want_nv12 = !is_debug && ResolvePreviewFormat(_config.previewFormat) == PreviewFormat::NV12 &&
+                               !HasPreviewRegion(_config);
+        format = GetDefaultFormat(is_debug, want_nv12);
         ThrowIfFailed("set format", ioctl(_fd, VIDIOC_S_FMT, &format));
+        if (want_nv12 && format.fmt.pix.pixelformat != V4L2_PIX_FMT_NV12)
+        {
+            LOG_DEBUG(LOG_TAG, " NV12 not supported by the camera, converting from YUYV");
+            format = GetDefaultFormat(is_debug);
+            ThrowIfFailed("set format", ioctl(_fd, VIDIOC_S_FMT, &format));
+        }
+        if (!is_debug && format.fmt.pix.pixelformat == V4L2_PIX_FMT_NV12)
+        {
+            native_format = PreviewFormat::NV12;
+        }
+
+        // reduced frame rate, the driver picks the nearest supported frame interval
+        if (max_fps > 0)
+        {
+            v4l2_streamparm parm = {};
+            parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            parm.parm.capture.timeperframe.numerator = 1;
+            parm.parm.capture.timeperframe.denominator = max_fps;
+            if (ioctl(_fd, VIDIOC_S_PARM, &parm) == FAILED_V4L)
+                LOG_DEBUG(LOG_TAG, " frame rate %u not supported by the camera", max_fps);
+            else
+                LOG_DEBUG(LOG_TAG, " streaming at %u/%u fps", parm.parm.capture.timeperframe.denominator,
+                          parm.parm.capture.timeperframe.numerator);
+        }
 
         // set memory mode
         v4l2_requestbuffers req = {0};
-        req.count = 4;
+        req.count = std::max(_config.captureBuffers, 2u);
         req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         req.memory = V4L2_MEMORY_MMAP;
         ThrowIfFailed("set memory mode", ioctl(_fd, VIDIOC_REQBUFS, &req));
@@ -95,6 +131,16 @@ CaptureHandle::CaptureHandle(const PreviewConfig& config): _config(config)
                 mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, buf.m.offset));
             ThrowIfFailed("mmap", (_buffers[i].data == MAP_FAILED) - 2);
             _buffers[i].size = buf.length;
+
+            if (_config.exportDmaBuf)
+            {
+                v4l2_exportbuffer expbuf = {0};
+                expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+                expbuf.index = i;
+                expbuf.flags = O_RDONLY | O_CLOEXEC;
+                ThrowIfFailed("export buffer", ioctl(_fd, VIDIOC_EXPBUF, &expbuf));
+                _buffers[i].dmabuf_fd = expbuf.fd;
+            }
         }
 
         // start stream
@@ -108,7 +154,7 @@ CaptureHandle::CaptureHandle(const PreviewConfig& config): _config(config)
             buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
             buf.memory = V4L2_MEMORY_MMAP;
             buf.index = i;
-            ThrowIfFailed("req buffer", ioctl(_fd, VIDIOC_QBUF, &buf));
+            Queue(buf);
         }
     }
     catch (const std::exception& ex)
@@ -119,11 +165,28 @@ CaptureHandle::CaptureHandle(const PreviewConfig& config): _config(config)
         throw ex;
     }
     // set stream attr and init buffer
-    _stream_converter.InitStream(format.fmt.pix.width, format.fmt.pix.height, _config.previewMode);
+    _stream_converter.InitStream(format.fmt.pix.width, format.fmt.pix.height, _config, native_format);
+
+    _reactor = PacketManager::IoReactor::Acquire();
+    if (_reactor)
+    {
+        if (_reactor->Add(_fd, [this](uint32_t events) { OnReadable(events); }))
+        {
+            LOG_DEBUG(LOG_TAG, " frames dequeued by the I/O reactor");
+        }
+        else
+        {
+            _reactor.reset();
+        }
+    }
 }
 
 CaptureHandle ::~CaptureHandle()
 {
+    if (_reactor)
+    {
+        _reactor->Remove(_fd);
+    }
     int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     ioctl(_fd, VIDIOC_STREAMOFF, &type); // shutdown stream
     CleanMMAPBuffers(_buffers);
@@ -131,13 +194,42 @@ CaptureHandle ::~CaptureHandle()
         close(_fd);
 }
 
-bool CaptureHandle::Read(RealSenseID::Image* res)
+unsigned int CaptureHandle::ImageSize() const
 {
-    bool valid_read = false;
-    struct v4l2_buffer buf = {0};
-    struct timeval tv = {0}; 
+    return _stream_converter.ImageSize();
+}
+
+bool CaptureHandle::Dequeue(v4l2_buffer& buf)
+{
+    Trace::Scope dequeue_trace {"Dequeue", "preview"};
+    struct timeval tv = {0};
     tv.tv_sec = 1; // max time to wait for next frame
 
+    // the previous passthrough image was consumed
+    if (_held_buffer >= 0)
+    {
+        v4l2_buffer held = {0};
+        held.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        held.memory = V4L2_MEMORY_MMAP;
+        held.index = _held_buffer;
+        _held_buffer = -1;
+        Queue(held);
+    }
+
+    if (_reactor)
+    {
+        std::unique_lock<std::mutex> lock {_ready_mutex};
+        auto frame_ready = [this] { return !_ready.empty() || _failed; };
+        if (!_ready_cv.wait_for(lock, std::chrono::seconds {tv.tv_sec}, frame_ready) || _ready.empty())
+        {
+            return false;
+        }
+        buf = _ready.front();
+        _ready.pop_front();
+        return true;
+    }
+
+    buf = {0};
     buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     buf.memory = V4L2_MEMORY_MMAP;
     buf.index = 0;
@@ -145,18 +237,97 @@ bool CaptureHandle::Read(RealSenseID::Image* res)
     fd_set fds;
     FD_ZERO(&fds);
     FD_SET(_fd, &fds);
-    ThrowIfFailed("wait for frame", select(_fd + 1, &fds, NULL, NULL, &tv)); //wait for frame 
-    if (ioctl(_fd, VIDIOC_DQBUF, &buf) == FAILED_V4L){ // dequeue frame from buffer. 
+    ThrowIfFailed("wait for frame", select(_fd + 1, &fds, NULL, NULL, &tv)); //wait for frame
+    if (ioctl(_fd, VIDIOC_DQBUF, &buf) == FAILED_V4L) // dequeue frame from buffer.
+        return false;
+    std::lock_guard<std::mutex> lock {_ready_mutex};
+    _queued--;
+    return true;
+}
+
+void CaptureHandle::Queue(v4l2_buffer& buf)
+{
+    // serialized with the reactor's dequeue, so _queued matches the driver's queue
+    std::lock_guard<std::mutex> lock {_ready_mutex};
+    ThrowIfFailed("qbuffer", ioctl(_fd, VIDIOC_QBUF, &buf));
+    _queued++;
+    if (_reactor && !_armed && !_failed)
+    {
+        _armed = true;
+        _reactor->Arm(_fd, true);
+    }
+}
+
+void CaptureHandle::OnReadable(uint32_t events)
+{
+    std::lock_guard<std::mutex> lock {_ready_mutex};
+    bool dequeued = false;
+    while (_queued > 0)
+    {
+        v4l2_buffer buf = {0};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        if (ioctl(_fd, VIDIOC_DQBUF, &buf) == FAILED_V4L)
+        {
+            if (errno != EAGAIN)
+            {
+                LOG_ERROR(LOG_TAG, " dequeue failed. errno %d events %u", errno, events);
+                _failed = true;
+            }
+            break;
+        }
+        _queued--;
+        _ready.push_back(buf);
+        dequeued = true;
+    }
+    // all buffers are with the reader, resumed by Queue()
+    if (_queued == 0 || _failed)
+    {
+        _armed = false;
+        _reactor->Arm(_fd, false);
+    }
+    if (dequeued || _failed)
+    {
+        _ready_cv.notify_one();
+    }
+}
+
+bool CaptureHandle::Skip()
+{
+    v4l2_buffer buf;
+    if (!Dequeue(buf))
+        return false;
+    Queue(buf); // queue next frame
+    return true;
+}
+
+bool CaptureHandle::Read(RealSenseID::Image* res, unsigned char* target)
+{
+    bool valid_read = false;
+    v4l2_buffer buf;
+    if (!Dequeue(buf))
+    {
         return false;
     }
 
     //now buf.index is the index of the latest buffer filled
+    res->timing.dequeueTime = HostTimeUs();
+    res->timing.captureTimestamp =
+        static_cast<uint64_t>(buf.timestamp.tv_sec) * 1000000 + static_cast<uint64_t>(buf.timestamp.tv_usec);
+    res->timing.captureOnHostClock =
+        (buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
 
-    valid_read = _stream_converter.Buffer2Image(res, _buffers[buf.index].data, _buffers[buf.index].size);
+    valid_read = _stream_converter.Buffer2Image(res, _buffers[buf.index].data, _buffers[buf.index].size, target);
 
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE; 
-    buf.memory = V4L2_MEMORY_MMAP;
-    ThrowIfFailed("qbuffer", ioctl(_fd, VIDIOC_QBUF, &buf)); // queue next frame
+    // passthrough image points into the buffer, keep it until the next read
+    if (valid_read && !target && _stream_converter.IsPassthrough())
+    {
+        res->dmaBufFd = _buffers[buf.index].dmabuf_fd;
+        _held_buffer = static_cast<int>(buf.index);
+        return true;
+    }
+
+    Queue(buf); // queue next frame
 
     return valid_read;
 }
@@ -1,8 +1,16 @@
 #pragma once
 
 #include "RealSenseID/Preview.h"
+#include "CaptureSource.h"
 #include "StreamConverter.h"
+#include "PacketManager/IoReactor.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <vector>
+#include <linux/videodev2.h>
 
 namespace RealSenseID
 {
@@ -11,14 +19,20 @@ namespace Capture
 struct buffer{
     unsigned char* data = nullptr;
     unsigned int size = 0;
+    int dmabuf_fd = -1; // exported with PreviewConfig::exportDmaBuf
 };
 
-class CaptureHandle
+class CaptureHandle : public CaptureSource
 {
 public:
-    explicit CaptureHandle(const PreviewConfig& config);
-    ~CaptureHandle();
-    bool Read(RealSenseID::Image* res);
+    // max_fps: stream at most that many images per second (the nearest rate the camera supports), 0 for its full rate
+    explicit CaptureHandle(const PreviewConfig& config, unsigned int max_fps = 0);
+    ~CaptureHandle() override;
+    // target (optional) is a buffer of at least ImageSize() bytes to read the image into
+    bool Read(RealSenseID::Image* res, unsigned char* target = nullptr) override;
+    unsigned int ImageSize() const override;
+    // receive the next image without converting it
+    bool Skip() override;
 
     // prevent copy or assignment
     // only single connection is allowed to a capture device.
@@ -28,8 +42,23 @@ public:
 private:
     int _fd = 0;
     std::vector<buffer> _buffers;
+    int _held_buffer = -1; // buffer of the last passthrough image, queued back on the next Read()
     StreamConverter _stream_converter;
     PreviewConfig _config;
+
+    // with SetIoReactor(): the reactor thread dequeues the filled buffers to _ready, and stops while the driver has
+    // none queued (v4l2 reports an error instead of blocking then)
+    std::shared_ptr<PacketManager::IoReactor> _reactor;
+    std::mutex _ready_mutex;
+    std::condition_variable _ready_cv;
+    std::deque<v4l2_buffer> _ready;
+    unsigned int _queued = 0; // buffers queued to the driver
+    bool _armed = true;
+    bool _failed = false;
+
+    bool Dequeue(v4l2_buffer& buf);
+    void Queue(v4l2_buffer& buf); // back to the driver
+    void OnReadable(uint32_t events); // on the reactor thread
 };
 } // namespace Capture
 } // namespace RealSenseID
@@ -0,0 +1,419 @@
+#include "LinuxEncoder.h"
+#include "StreamConverter.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <linux/videodev2.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace RealSenseID
+{
+namespace Capture
+{
+static const char* LOG_TAG = "LinuxEncoder";
+
+static const std::string VIDEO_DEV = "/dev/video";
+static const int FAILED_V4L = -1;
+static const int MAX_VIDEO_DEVICES = 64;
+static const unsigned int ENCODER_BUFFERS = 4;
+static const int ENCODER_TIMEOUT_MS = 1000;
+
+static void ThrowIfFailed(const char* what, int res)
+{
+    if (res != FAILED_V4L)
+        return;
+    throw std::runtime_error(std::string(what) + " v4l failed with error " + std::to_string(errno));
+}
+
+static uint32_t DeviceCaps(int fd)
+{
+    v4l2_capability cap = {};
+    if (ioctl(fd, VIDIOC_QUERYCAP, &cap) == FAILED_V4L)
+        return 0;
+    return (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+}
+
+static bool SupportsFormat(int fd, unsigned int type, uint32_t pixel_format)
+{
+    v4l2_fmtdesc desc = {};
+    desc.type = type;
+    for (desc.index = 0; ioctl(fd, VIDIOC_ENUM_FMT, &desc) != FAILED_V4L; desc.index++)
+    {
+        if (desc.pixelformat == pixel_format)
+            return true;
+    }
+    return false;
+}
+
+// coded format of the device for the codec, 0 if not supported
+static uint32_t CodedFormat(int fd, unsigned int capture_type, PreviewCodec codec)
+{
+    if (codec == PreviewCodec::H264)
+        return SupportsFormat(fd, capture_type, V4L2_PIX_FMT_H264) ? V4L2_PIX_FMT_H264 : 0;
+    if (SupportsFormat(fd, capture_type, V4L2_PIX_FMT_MJPEG))
+        return V4L2_PIX_FMT_MJPEG;
+    return SupportsFormat(fd, capture_type, V4L2_PIX_FMT_JPEG) ? V4L2_PIX_FMT_JPEG : 0;
+}
+
+static bool IsMemoryToMemory(uint32_t caps, bool& mplane)
+{
+    mplane = (caps & V4L2_CAP_VIDEO_M2M_MPLANE) != 0;
+    return mplane || (caps & V4L2_CAP_VIDEO_M2M) != 0;
+}
+
+static unsigned int CaptureType(bool mplane)
+{
+    return mplane ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+}
+
+int LinuxEncoder::FindEncoder(PreviewCodec codec)
+{
+    for (int number = 0; number < MAX_VIDEO_DEVICES; number++)
+    {
+        int fd = open((VIDEO_DEV + std::to_string(number)).c_str(), O_RDWR | O_NONBLOCK, 0);
+        if (fd == FAILED_V4L)
+            continue;
+        bool mplane = false;
+        const bool found = IsMemoryToMemory(DeviceCaps(fd), mplane) &&
+                           CodedFormat(fd, CaptureType(mplane), codec) != 0;
+        close(fd);
+        if (found)
+            return number;
+    }
+    return -1;
+}
+
+LinuxEncoder::LinuxEncoder(const PreviewEncoderConfig& config, unsigned int width, unsigned int height,
+                           PacketSink sink) :
+    _width {width},
+    _height {height}, _sink {std::move(sink)}
+{
+    const int number = config.encoderNumber >= 0 ? config.encoderNumber : FindEncoder(config.codec);
+    if (number < 0)
+        throw std::runtime_error("no V4L2 encoder found for the codec");
+    const std::string dev = VIDEO_DEV + std::to_string(number);
+    _fd = open(dev.c_str(), O_RDWR | O_NONBLOCK, 0);
+    ThrowIfFailed("encoder fd", _fd);
+
+    try
+    {
+        if (!IsMemoryToMemory(DeviceCaps(_fd), _mplane))
+            throw std::runtime_error(dev + " is not a memory to memory device");
+        _capture_type = CaptureType(_mplane);
+        _output_type = _mplane ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        const uint32_t coded_format = CodedFormat(_fd, _capture_type, config.codec);
+        if (coded_format == 0)
+            throw std::runtime_error(dev + " doesn't support the codec");
+
+        // coded format first, then the raw format (stateful encoder interface)
+        v4l2_format format = {};
+        format.type = _capture_type;
+        if (_mplane)
+        {
+            format.fmt.pix_mp.width = width;
+            format.fmt.pix_mp.height = height;
+            format.fmt.pix_mp.pixelformat = coded_format;
+            format.fmt.pix_mp.num_planes = 1;
+            format.fmt.pix_mp.plane_fmt[0].sizeimage = width * height * 3 / 2;
+        }
+        else
+        {
+            format.fmt.pix.width = width;
+            format.fmt.pix.height = height;
+            format.fmt.pix.pixelformat = coded_format;
+            format.fmt.pix.sizeimage = width * height * 3 / 2;
+        }
+        ThrowIfFailed("set coded format", ioctl(_fd, VIDIOC_S_FMT, &format));
+
+        format = {};
+        format.type = _output_type;
+        if (_mplane)
+        {
+            format.fmt.pix_mp.width = width;
+            format.fmt.pix_mp.height = height;
+            format.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_NV12;
+            format.fmt.pix_mp.num_planes = 1;
+        }
+        else
+        {
+            format.fmt.pix.width = width;
+            format.fmt.pix.height = height;
+            format.fmt.pix.pixelformat = V4L2_PIX_FMT_NV12;
+        }
+        ThrowIfFailed("set raw format", ioctl(_fd, VIDIOC_S_FMT, &format));
+        const uint32_t raw_format = _mplane ? format.fmt.pix_mp.pixelformat : format.fmt.pix.pixelformat;
+        if (raw_format != V4L2_PIX_FMT_NV12)
+            throw std::runtime_error(dev + " doesn't encode NV12 images");
+        _bytes_per_line = _mplane ? format.fmt.pix_mp.plane_fmt[0].bytesperline : format.fmt.pix.bytesperline;
+        _plane_height = _mplane ? format.fmt.pix_mp.height : format.fmt.pix.height;
+        _bytes_per_line = std::max(_bytes_per_line, width);
+        _plane_height = std::max(_plane_height, height);
+
+        if (config.codec == PreviewCodec::H264)
+        {
+            SetControl(V4L2_CID_MPEG_VIDEO_BITRATE, static_cast<int>(config.bitrate), "bitrate");
+            SetControl(V4L2_CID_MPEG_VIDEO_GOP_SIZE, static_cast<int>(config.gopSize), "gop size");
+            // streams can be joined at any key frame
+            SetControl(V4L2_CID_MPEG_VIDEO_REPEAT_SEQ_HEADER, 1, "repeat sequence header");
+        }
+        else
+        {
+            SetControl(V4L2_CID_JPEG_COMPRESSION_QUALITY, static_cast<int>(std::min(config.quality, 100u)),
+                       "jpeg quality");
+        }
+
+        MapBuffers(_output_type, ENCODER_BUFFERS, _output_buffers);
+        MapBuffers(_capture_type, ENCODER_BUFFERS, _capture_buffers);
+        for (unsigned int i = 0; i < _output_buffers.size(); i++)
+            _free_outputs.push_back(i);
+        _pending.resize(_output_buffers.size() * 2);
+        for (unsigned int i = 0; i < _capture_buffers.size(); i++)
+            QueueCapture(i);
+
+        unsigned int type = _output_type;
+        ThrowIfFailed("start output stream", ioctl(_fd, VIDIOC_STREAMON, &type));
+        type = _capture_type;
+        ThrowIfFailed("start capture stream", ioctl(_fd, VIDIOC_STREAMON, &type));
+        _streaming = true;
+        LOG_DEBUG(LOG_TAG, "Encoding %ux%u on %s (%s)", width, height, dev.c_str(), _mplane ? "mplane" : "splane");
+    }
+    catch (...)
+    {
+        Close();
+        throw;
+    }
+}
+
+LinuxEncoder::~LinuxEncoder()
+{
+    Close();
+}
+
+void LinuxEncoder::SetControl(uint32_t id, int value, const char* name)
+{
+    v4l2_control control = {};
+    control.id = id;
+    control.value = value;
+    if (ioctl(_fd, VIDIOC_S_CTRL, &control) == FAILED_V4L)
+        LOG_DEBUG(LOG_TAG, "Encoder doesn't support setting the %s", name);
+}
+
+void LinuxEncoder::InitBuffer(v4l2_buffer& buf, unsigned int type, void* planes)
+{
+    memset(&buf, 0, sizeof(buf));
+    buf.type = type;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (_mplane)
+    {
+        memset(planes, 0, sizeof(v4l2_plane));
+        buf.m.planes = static_cast<v4l2_plane*>(planes);
+        buf.length = 1;
+    }
+}
+
+void LinuxEncoder::MapBuffers(unsigned int type, unsigned int count, std::vector<MappedBuffer>& buffers)
+{
+    v4l2_requestbuffers req = {};
+    req.count = count;
+    req.type = type;
+    req.memory = V4L2_MEMORY_MMAP;
+    ThrowIfFailed("request encoder buffers", ioctl(_fd, VIDIOC_REQBUFS, &req));
+    if (req.count == 0)
+        throw std::runtime_error("no encoder buffers");
+
+    buffers.resize(req.count);
+    for (unsigned int i = 0; i < req.count; i++)
+    {
+        v4l2_buffer buf;
+        v4l2_plane plane;
+        InitBuffer(buf, type, &plane);
+        buf.index = i;
+        ThrowIfFailed("query encoder buffer", ioctl(_fd, VIDIOC_QUERYBUF, &buf));
+        const unsigned int length = _mplane ? plane.length : buf.length;
+        const unsigned int offset = _mplane ? plane.m.mem_offset : buf.m.offset;
+        void* data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, offset);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("mmap encoder buffer failed");
+        buffers[i].data = static_cast<unsigned char*>(data);
+        buffers[i].size = length;
+    }
+}
+
+void LinuxEncoder::QueueCapture(unsigned int index)
+{
+    v4l2_buffer buf;
+    v4l2_plane plane;
+    InitBuffer(buf, _capture_type, &plane);
+    buf.index = index;
+    if (_mplane)
+        plane.length = _capture_buffers[index].size;
+    else
+        buf.length = _capture_buffers[index].size;
+    ThrowIfFailed("queue encoder capture buffer", ioctl(_fd, VIDIOC_QBUF, &buf));
+}
+
+bool LinuxEncoder::Wait(short events, int timeout_ms)
+{
+    pollfd fds = {_fd, events, 0};
+    return poll(&fds, 1, timeout_ms) > 0;
+}
+
+bool LinuxEncoder::Encode(const Image& image)
+{
+    Trace::Scope encode_trace {"Encode", "preview"};
+    if (image.width != _width || image.height != _height || image.size < _width * _height * 3 / 2)
+    {
+        LOG_ERROR_LIMITED(LOG_TAG, "Unexpected image %ux%u, encoding %ux%u", image.width, image.height, _width,
+                          _height);
+        return false;
+    }
+    if (!Drain())
+        return false;
+    while (_free_outputs.empty())
+    {
+        // a packet or an encoded image's buffer
+        if (!Wait(POLLIN | POLLOUT, ENCODER_TIMEOUT_MS))
+        {
+            LOG_ERROR(LOG_TAG, "Encoder timeout");
+            return false;
+        }
+        if (!Drain())
+            return false;
+    }
+    const unsigned int index = _free_outputs.back();
+    _free_outputs.pop_back();
+
+    // Y plane then UV plane, at the encoder's line and plane alignment
+    unsigned char* dst = _output_buffers[index].data;
+    const unsigned char* src = image.buffer;
+    for (unsigned int row = 0; row < _height; row++)
+        memcpy(dst + static_cast<size_t>(row) * _bytes_per_line, src + static_cast<size_t>(row) * _width, _width);
+    dst += static_cast<size_t>(_bytes_per_line) * _plane_height;
+    src += static_cast<size_t>(_width) * _height;
+    for (unsigned int row = 0; row < _height / 2; row++)
+        memcpy(dst + static_cast<size_t>(row) * _bytes_per_line, src + static_cast<size_t>(row) * _width, _width);
+
+    // the image number goes with the packet as its timestamp
+    _pending[_pending_next] = PendingImage {image.number, image.timing};
+    _pending_next = (_pending_next + 1) % _pending.size();
+    v4l2_buffer buf;
+    v4l2_plane plane;
+    InitBuffer(buf, _output_type, &plane);
+    buf.index = index;
+    buf.timestamp.tv_sec = image.number;
+    const unsigned int bytes_used = _bytes_per_line * _plane_height * 3 / 2;
+    if (_mplane)
+    {
+        plane.bytesused = bytes_used;
+        plane.length = _output_buffers[index].size;
+    }
+    else
+    {
+        buf.bytesused = bytes_used;
+    }
+    if (ioctl(_fd, VIDIOC_QBUF, &buf) == FAILED_V4L)
+    {
+        LOG_ERROR_LIMITED(LOG_TAG, "Failed to queue image, error %d", errno);
+        _free_outputs.push_back(index);
+        return false;
+    }
+    return Drain();
+}
+
+bool LinuxEncoder::Drain()
+{
+    v4l2_buffer buf;
+    v4l2_plane plane;
+    // encoded images' buffers
+    while (true)
+    {
+        InitBuffer(buf, _output_type, &plane);
+        if (ioctl(_fd, VIDIOC_DQBUF, &buf) == FAILED_V4L)
+            break;
+        _free_outputs.push_back(buf.index);
+    }
+
+    while (true)
+    {
+        InitBuffer(buf, _capture_type, &plane);
+        if (ioctl(_fd, VIDIOC_DQBUF, &buf) == FAILED_V4L)
+            return errno != EPIPE; // EPIPE: stopped, no more packets
+        PreviewPacket packet;
+        packet.data = _capture_buffers[buf.index].data;
+        packet.size = _mplane ? plane.bytesused : buf.bytesused;
+        packet.keyFrame = (buf.flags & V4L2_BUF_FLAG_KEYFRAME) != 0;
+        packet.number = static_cast<unsigned int>(buf.timestamp.tv_sec);
+        for (const auto& pending : _pending)
+        {
+            if (pending.number == packet.number)
+            {
+                packet.timing = pending.timing;
+                break;
+            }
+        }
+        const bool last = (buf.flags & V4L2_BUF_FLAG_LAST) != 0;
+        if (packet.size > 0)
+        {
+            packet.timing.deliveredTime = HostTimeUs();
+            _sink(packet);
+        }
+        QueueCapture(buf.index);
+        if (last)
+            return false;
+    }
+}
+
+void LinuxEncoder::Flush()
+{
+    if (!_streaming)
+        return;
+    v4l2_encoder_cmd cmd = {};
+    cmd.cmd = V4L2_ENC_CMD_STOP;
+    if (ioctl(_fd, VIDIOC_ENCODER_CMD, &cmd) == FAILED_V4L)
+    {
+        // old drivers: the packets ready so far
+        Drain();
+        return;
+    }
+    // packets until the last one
+    const uint64_t deadline = HostTimeUs() + ENCODER_TIMEOUT_MS * 1000;
+    while (HostTimeUs() < deadline && Wait(POLLIN, ENCODER_TIMEOUT_MS / 10) && Drain())
+    {
+    }
+}
+
+void LinuxEncoder::Close()
+{
+    if (_streaming)
+    {
+        unsigned int type = _output_type;
+        ioctl(_fd, VIDIOC_STREAMOFF, &type);
+        type = _capture_type;
+        ioctl(_fd, VIDIOC_STREAMOFF, &type);
+        _streaming = false;
+    }
+    for (auto* buffers : {&_output_buffers, &_capture_buffers})
+    {
+        for (auto& buffer : *buffers)
+        {
+            if (buffer.data)
+                munmap(buffer.data, buffer.size);
+        }
+        buffers->clear();
+    }
+    if (_fd != FAILED_V4L)
+    {
+        close(_fd);
+        _fd = FAILED_V4L;
+    }
+}
+} // namespace Capture
+} // namespace RealSenseID
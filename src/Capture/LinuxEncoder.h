@@ -0,0 +1,68 @@
+#pragma once
+
+#include "PreviewEncoder.h"
+#include <cstdint>
+#include <vector>
+
+struct v4l2_buffer;
+
+namespace RealSenseID
+{
+namespace Capture
+{
+// Stateful V4L2 memory to memory encoder: NV12 images are queued to its output queue, the encoded packets are
+// dequeued from its capture queue. Both single and multi planar drivers are supported.
+class LinuxEncoder : public PreviewEncoder
+{
+public:
+    LinuxEncoder(const PreviewEncoderConfig& config, unsigned int width, unsigned int height, PacketSink sink);
+    ~LinuxEncoder();
+
+    LinuxEncoder(const LinuxEncoder&) = delete;
+    LinuxEncoder& operator=(const LinuxEncoder&) = delete;
+
+    bool Encode(const Image& image) override;
+    void Flush() override;
+
+private:
+    struct MappedBuffer
+    {
+        unsigned char* data = nullptr;
+        unsigned int size = 0;
+    };
+
+    // timing of the images being encoded, by image number
+    struct PendingImage
+    {
+        unsigned int number = 0;
+        ImageTiming timing;
+    };
+
+    int _fd = -1;
+    bool _mplane = false;
+    unsigned int _output_type = 0;  // raw images
+    unsigned int _capture_type = 0; // encoded packets
+    unsigned int _width = 0;
+    unsigned int _height = 0;
+    unsigned int _bytes_per_line = 0; // of the output queue's NV12 images
+    unsigned int _plane_height = 0;   // rows of the Y plane in the output buffers
+    std::vector<MappedBuffer> _output_buffers;
+    std::vector<MappedBuffer> _capture_buffers;
+    std::vector<unsigned int> _free_outputs;
+    std::vector<PendingImage> _pending; // ring of the output buffers' images
+    size_t _pending_next = 0;
+    PacketSink _sink;
+    bool _streaming = false;
+
+    static int FindEncoder(PreviewCodec codec);
+    void SetControl(uint32_t id, int value, const char* name);
+    void MapBuffers(unsigned int type, unsigned int count, std::vector<MappedBuffer>& buffers);
+    void InitBuffer(v4l2_buffer& buf, unsigned int type, void* planes);
+    void QueueCapture(unsigned int index);
+    bool Wait(short events, int timeout_ms); // poll events of the device
+    // deliver the encoded packets, reclaim the encoded images' buffers. false if the encoder stopped (flush)
+    bool Drain();
+    void Close();
+};
+} // namespace Capture
+} // namespace RealSenseID
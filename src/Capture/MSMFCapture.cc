@@ -6,6 +6,12 @@
 #include <mfreadwrite.h>
 #include <stdexcept>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
 #include <sstream>
 
@@ -65,6 +71,157 @@ static void ThrowIfFailed(const char* what, HRESULT hr)
     throw std::runtime_error(err_stream.str());
 }
 
+// Callback of the asynchronous source reader. Samples arrive on media foundation's threads, the next sample is
+// requested right away so the camera keeps streaming while the preview thread converts. Keeps up to max_pending of
+// the latest samples (older ones are dropped) until popped by CaptureHandle::Read().
+class SampleQueue : public IMFSourceReaderCallback
+{
+public:
+    explicit SampleQueue(size_t max_pending) : _max_pending {std::max<size_t>(max_pending, 1)}
+    {
+    }
+
+    STDMETHODIMP QueryInterface(REFIID iid, void** object) override
+    {
+        if (!object)
+            return E_POINTER;
+        if (iid == __uuidof(IUnknown) || iid == __uuidof(IMFSourceReaderCallback))
+        {
+            *object = static_cast<IMFSourceReaderCallback*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    STDMETHODIMP_(ULONG) AddRef() override
+    {
+        return ++_refs;
+    }
+
+    STDMETHODIMP_(ULONG) Release() override
+    {
+        ULONG refs = --_refs;
+        if (refs == 0)
+            delete this;
+        return refs;
+    }
+
+    STDMETHODIMP OnReadSample(HRESULT status, DWORD, DWORD, LONGLONG timestamp, IMFSample* sample) override
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (FAILED(status))
+        {
+            _error = status;
+            _cv.notify_all();
+            return S_OK;
+        }
+        if (sample) // null on stream ticks
+        {
+            sample->AddRef();
+            _pending.push_back({sample, timestamp, HostTimeUs()});
+            if (_pending.size() > _max_pending)
+            {
+                _pending.front().sample->Release();
+                _pending.pop_front();
+            }
+            _cv.notify_all();
+        }
+        if (!_stopping)
+            RequestSample();
+        return S_OK;
+    }
+
+    STDMETHODIMP OnFlush(DWORD) override
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _flushed = true;
+        _cv.notify_all();
+        return S_OK;
+    }
+
+    STDMETHODIMP OnEvent(DWORD, IMFMediaEvent*) override
+    {
+        return S_OK;
+    }
+
+    // request the first sample. the reader is not referenced (it references this callback).
+    void Start(IMFSourceReader* reader)
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _reader = reader;
+        RequestSample();
+    }
+
+    // oldest pending sample (owned by the caller), waiting up to timeout. nullptr on timeout.
+    IMFSample* Pop(std::chrono::milliseconds timeout, LONGLONG& timestamp, uint64_t& received_time)
+    {
+        std::unique_lock<std::mutex> lock {_mutex};
+        _cv.wait_for(lock, timeout, [this] { return !_pending.empty() || FAILED(_error); });
+        ThrowIfFailed("read sample ", _error);
+        if (_pending.empty())
+            return nullptr;
+        auto pending = _pending.front();
+        _pending.pop_front();
+        timestamp = pending.timestamp;
+        received_time = pending.received_time;
+        return pending.sample;
+    }
+
+    // stop requesting samples and flush the reader, no callbacks after this returns
+    void Stop()
+    {
+        std::unique_lock<std::mutex> lock {_mutex};
+        _stopping = true;
+        if (_reader)
+        {
+            lock.unlock();
+            bool flushing = SUCCEEDED(_reader->Flush(STREAM_NUMBER));
+            lock.lock();
+            if (flushing)
+                _cv.wait_for(lock, std::chrono::seconds {5}, [this] { return _flushed; });
+        }
+        for (auto& pending : _pending)
+            pending.sample->Release();
+        _pending.clear();
+    }
+
+private:
+    struct PendingSample
+    {
+        IMFSample* sample;
+        LONGLONG timestamp;
+        uint64_t received_time;
+    };
+
+    ~SampleQueue()
+    {
+        for (auto& pending : _pending)
+            pending.sample->Release();
+    }
+
+    void RequestSample() // caller holds _mutex
+    {
+        HRESULT hr = _reader->ReadSample(STREAM_NUMBER, 0, nullptr, nullptr, nullptr, nullptr);
+        if (FAILED(hr))
+        {
+            _error = hr;
+            _cv.notify_all();
+        }
+    }
+
+    std::atomic<ULONG> _refs {1};
+    const size_t _max_pending;
+    IMFSourceReader* _reader = nullptr;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<PendingSample> _pending;
+    HRESULT _error = S_OK;
+    bool _stopping = false;
+    bool _flushed = false;
+};
+
 bool CreateMediaSource(IMFMediaSource** media_device, IMFAttributes** cap_config, int capture_number)
 {
     const char* stage_tag = "init MSMF backend";
@@ -92,7 +249,7 @@ bool CreateMediaSource(IMFMediaSource** media_device, IMFAttributes** cap_config
     return true;
 }
 
-CaptureHandle::CaptureHandle(const PreviewConfig& config) : _config(config)
+CaptureHandle::CaptureHandle(const PreviewConfig& config, unsigned int max_fps) : _config(config)
 {
     IMFMediaSource* media_device = nullptr;
     IMFAttributes* cap_config = nullptr;
@@ -103,24 +260,53 @@ CaptureHandle::CaptureHandle(const PreviewConfig& config) : _config(config)
     {
         ThrowIfFailed("create media source",
                       HRESULT(CreateMediaSource(&media_device, &cap_config, _config.cameraNumber)));
+        // asynchronous reader, see SampleQueue
+        _samples = new SampleQueue(_config.captureBuffers);
+        ThrowIfFailed("set reader callback", cap_config->SetUnknown(MF_SOURCE_READER_ASYNC_CALLBACK, _samples));
         ThrowIfFailed("create source reader",
                       MFCreateSourceReaderFromMediaSource(media_device, cap_config, &_video_src));
 
         GUID stream_format = _config.previewMode == PreviewMode::VGA ? MFVideoFormat_YUY2 : W10_FORMAT;
+        PreviewFormat native_format = PreviewFormat::YUYV;
 
         ThrowIfFailed("create mediatype ", MFCreateMediaType(&mediaType));
         ThrowIfFailed("set mediaType guid", mediaType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video));
-        ThrowIfFailed("set mediaType minor type", mediaType->SetGUID(MF_MT_SUBTYPE, stream_format));
         if (_config.previewMode == PreviewMode::VGA)
             ThrowIfFailed("set size", MFSetAttributeSize(mediaType, MF_MT_FRAME_SIZE, VGA_WIDTH, VGA_HEIGHT));
-        ThrowIfFailed("set stream ", _video_src->SetCurrentMediaType(0, NULL, mediaType));
+        // reduced frame rate, dropped below if the camera refuses it
+        if (max_fps > 0)
+            ThrowIfFailed("set frame rate", MFSetAttributeRatio(mediaType, MF_MT_FRAME_RATE, max_fps, 1));
+
+        // stream NV12 if requested and the camera supports it, convert from YUY2 otherwise (and for regions)
+        if (_config.previewMode == PreviewMode::VGA &&
+            ResolvePreviewFormat(_config.previewFormat) == PreviewFormat::NV12 && !HasPreviewRegion(_config))
+        {
+            ThrowIfFailed("set mediaType minor type", mediaType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12));
+            if (SUCCEEDED(_video_src->SetCurrentMediaType(0, NULL, mediaType)))
+                native_format = PreviewFormat::NV12;
+            else
+                LOG_DEBUG(LOG_TAG, "NV12 not supported by the camera, converting from YUY2");
+        }
+        if (native_format != PreviewFormat::NV12)
+        {
+            ThrowIfFailed("set mediaType minor type", mediaType->SetGUID(MF_MT_SUBTYPE, stream_format));
+            HRESULT hr = _video_src->SetCurrentMediaType(0, NULL, mediaType);
+            if (FAILED(hr) && max_fps > 0)
+            {
+                LOG_DEBUG(LOG_TAG, "Frame rate %u not supported by the camera", max_fps);
+                mediaType->DeleteItem(MF_MT_FRAME_RATE);
+                hr = _video_src->SetCurrentMediaType(0, NULL, mediaType);
+            }
+            ThrowIfFailed("set stream ", hr);
+        }
 
         // save stream attributes
         UINT64 width_height;
         ThrowIfFailed(" get stream attributes ", _video_src->GetCurrentMediaType(STREAM_NUMBER, &mediaType));
         mediaType->GetUINT64(MF_MT_FRAME_SIZE, &width_height);
 
-        _stream_converter.InitStream((UINT32)(width_height >> 32), (UINT32)(width_height), _config.previewMode);
+        _stream_converter.InitStream((UINT32)(width_height >> 32), (UINT32)(width_height), _config, native_format);
+        _samples->Start(_video_src);
     }
     catch (const std::exception& ex)
     {
@@ -130,8 +316,12 @@ CaptureHandle::CaptureHandle(const PreviewConfig& config) : _config(config)
             cap_config->Release();
         if (media_device)
             media_device->Release();
+        if (_samples)
+            _samples->Stop();
         if (_video_src)
             _video_src->Release();
+        if (_samples)
+            _samples->Release();
         throw ex;
     }
 
@@ -145,38 +335,132 @@ CaptureHandle::CaptureHandle(const PreviewConfig& config) : _config(config)
 
 CaptureHandle::~CaptureHandle()
 {
+    ReleaseHeldSample();
+    if (_samples)
+        _samples->Stop();
     if (_video_src)
-    {
-        _video_src->Flush(STREAM_NUMBER);
         _video_src->Release();
-    }
+    if (_samples)
+        _samples->Release();
 }
 
-bool CaptureHandle::Read(RealSenseID::Image* res)
+// data of the sample. single 2D buffers in contiguous layout are used in place, other samples are copied to a
+// contiguous buffer. Unlocked by UnlockSample().
+unsigned char* CaptureHandle::LockSample(IMFSample* sample, DWORD& size)
 {
-    bool valid_read = false;
-    IMFSample* sample = NULL;
-    DWORD streamIndex, flags;
-    LONGLONG timestamp;
-    DWORD maxsize = 0, cursize = 0;
-    unsigned char* tmpBuffer = NULL;
+    DWORD buffer_count = 0;
+    IMFMediaBuffer* buffer = nullptr;
+    if (SUCCEEDED(sample->GetBufferCount(&buffer_count)) && buffer_count == 1 &&
+        SUCCEEDED(sample->GetBufferByIndex(0, &buffer)))
+    {
+        IMF2DBuffer* buffer2d = nullptr;
+        BOOL contiguous = FALSE;
+        BYTE* scanline0 = nullptr;
+        LONG pitch = 0;
+        if (SUCCEEDED(buffer->QueryInterface(IID_PPV_ARGS(&buffer2d))) &&
+            SUCCEEDED(buffer2d->IsContiguousFormat(&contiguous)) && contiguous &&
+            SUCCEEDED(buffer2d->GetContiguousLength(&size)) && SUCCEEDED(buffer2d->Lock2D(&scanline0, &pitch)))
+        {
+            if (pitch > 0)
+            {
+                buffer->Release();
+                _buf2d = buffer2d;
+                return scanline0;
+            }
+            buffer2d->Unlock2D(); // bottom-up image
+        }
+        if (buffer2d)
+            buffer2d->Release();
+        buffer->Release();
+    }
 
-    _video_src->ReadSample(STREAM_NUMBER, 0, &streamIndex, &flags, &timestamp, &sample);
+    unsigned char* data = nullptr;
+    DWORD max_size = 0;
+    ThrowIfFailed("ConvertToContiguousBuffer", sample->ConvertToContiguousBuffer(&_buf));
+    ThrowIfFailed("lock buffer", _buf->Lock(&data, &max_size, &size));
+    return data;
+}
 
-    if (sample)
+void CaptureHandle::UnlockSample()
+{
+    if (_buf2d)
+    {
+        _buf2d->Unlock2D();
+        _buf2d->Release();
+        _buf2d = nullptr;
+    }
+    if (_buf)
     {
-        ThrowIfFailed("ConvertToContiguousBuffer", sample->ConvertToContiguousBuffer(&_buf));
-        _buf->Lock(&tmpBuffer, &maxsize, &cursize);
+        _buf->Unlock();
+        _buf->Release();
+        _buf = nullptr;
+    }
+}
 
-        valid_read = _stream_converter.Buffer2Image(res, tmpBuffer, cursize);
+void CaptureHandle::ReleaseHeldSample()
+{
+    if (!_held_sample)
+        return;
+    UnlockSample();
+    _held_sample->Release();
+    _held_sample = nullptr;
+}
 
-        if (_buf)
-        {
-            _buf->Unlock();
-            _buf->Release();
-        }
+unsigned int CaptureHandle::ImageSize() const
+{
+    return _stream_converter.ImageSize();
+}
+
+bool CaptureHandle::Skip()
+{
+    ReleaseHeldSample();
+    LONGLONG timestamp = 0;
+    uint64_t received_time = 0;
+    IMFSample* sample = _samples->Pop(std::chrono::seconds {1}, timestamp, received_time);
+    if (!sample)
+        return false;
+    sample->Release();
+    return true;
+}
+
+bool CaptureHandle::Read(RealSenseID::Image* res, unsigned char* target)
+{
+    // the previous passthrough image was consumed
+    ReleaseHeldSample();
+
+    LONGLONG timestamp = 0;
+    uint64_t received_time = 0;
+    IMFSample* sample = _samples->Pop(std::chrono::seconds {1}, timestamp, received_time); // max time to wait
+    if (!sample)
+        return false;
+
+    // sample time in 100 ns units, of the media source's clock
+    res->timing.dequeueTime = received_time;
+    res->timing.captureTimestamp = static_cast<uint64_t>(timestamp) / 10;
+
+    bool valid_read = false;
+    try
+    {
+        DWORD size = 0;
+        unsigned char* data = LockSample(sample, size);
+        valid_read = _stream_converter.Buffer2Image(res, data, size, target);
+    }
+    catch (...)
+    {
+        UnlockSample();
         sample->Release();
+        throw;
+    }
+
+    // passthrough image points into the locked buffer, keep it until the next read
+    if (valid_read && !target && _stream_converter.IsPassthrough())
+    {
+        _held_sample = sample;
+        return true;
     }
+
+    UnlockSample();
+    sample->Release();
     return valid_read;
 }
 } // namespace Capture
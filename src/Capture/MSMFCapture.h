@@ -1,9 +1,12 @@
 #pragma once
 #include "RealSenseID/Preview.h"
+#include "CaptureSource.h"
 #include "StreamConverter.h"
 
 struct IMFSourceReader;
 struct IMFMediaBuffer;
+struct IMF2DBuffer;
+struct IMFSample;
 
 
 namespace RealSenseID
@@ -17,12 +20,19 @@ public:
     ~MsmfInitializer();
 };
 
-class CaptureHandle
+class SampleQueue;
+
+class CaptureHandle : public CaptureSource
 {
 public:
-    explicit CaptureHandle(const PreviewConfig& config);
-    ~CaptureHandle();
-    bool Read(RealSenseID::Image* res);
+    // max_fps: stream at most that many images per second (the nearest rate the camera supports), 0 for its full rate
+    explicit CaptureHandle(const PreviewConfig& config, unsigned int max_fps = 0);
+    ~CaptureHandle() override;
+    // target (optional) is a buffer of at least ImageSize() bytes to read the image into
+    bool Read(RealSenseID::Image* res, unsigned char* target = nullptr) override;
+    unsigned int ImageSize() const override;
+    // receive the next image without converting it
+    bool Skip() override;
 
     // prevent copy or assignment
     // only single connection is allowed to a capture device.
@@ -32,9 +42,17 @@ public:
 private:
     MsmfInitializer _mf;
     IMFSourceReader* _video_src = nullptr;
+    SampleQueue* _samples = nullptr; // async reader callback
+    // locked buffer of the current sample, either 2D (no copy) or contiguous
+    IMF2DBuffer* _buf2d = nullptr;
     IMFMediaBuffer* _buf = nullptr;
+    IMFSample* _held_sample = nullptr; // sample of the last passthrough image (its buffer kept locked until next Read)
     StreamConverter _stream_converter;
     PreviewConfig _config;
+
+    unsigned char* LockSample(IMFSample* sample, DWORD& size);
+    void UnlockSample();
+    void ReleaseHeldSample();
 };
 } // namespace Capture
 } // namespace RealSenseID
\ No newline at end of file
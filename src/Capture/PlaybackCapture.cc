@@ -0,0 +1,279 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "PlaybackCapture.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef ANDROID
+#include "AndroidCapture.h"
+#elif LINUX
+#include "LinuxCapture.h"
+#elif _WIN32
+#include "MSMFCapture.h"
+#endif
+
+static const char* LOG_TAG = "PlaybackCapture";
+
+namespace RealSenseID
+{
+namespace Capture
+{
+// longest wait between two frames, for recordings that were paused
+static constexpr std::chrono::microseconds max_frame_gap {1000000};
+
+std::unique_ptr<CaptureSource> OpenCaptureSource(const PreviewConfig& config, unsigned int max_fps)
+{
+    if (config.playbackPath != nullptr)
+    {
+        return std::make_unique<PlaybackCapture>(config);
+    }
+    return std::make_unique<CaptureHandle>(config, max_fps);
+}
+
+PlaybackCapture::PlaybackCapture(const PreviewConfig& config) : _realtime {config.playbackRealtime}, _config {config}
+{
+    Map(config.playbackPath);
+    try
+    {
+        if (_size < sizeof(_header))
+        {
+            throw std::runtime_error("Not a dump recording");
+        }
+        ::memcpy(&_header, _data, sizeof(_header));
+        if (::memcmp(_header.magic, Dump::FILE_MAGIC, sizeof(_header.magic)) != 0 || _header.version != Dump::VERSION)
+        {
+            throw std::runtime_error("Not a dump recording");
+        }
+
+        // YUYV images of the VGA mode, RAW10 images (with their metadata header) of the Dump mode
+        const uint64_t pixels = uint64_t {_header.width} * _header.height;
+        const bool yuyv = _header.frame_size == pixels * YUV_PIXEL_SIZE;
+        const bool raw10 = _header.frame_size == pixels / 4 * 5;
+        if ((config.previewMode == PreviewMode::VGA && !yuyv) || (config.previewMode != PreviewMode::VGA && !raw10))
+        {
+            throw std::runtime_error("Recording of " + std::to_string(_header.width) + "x" +
+                                     std::to_string(_header.height) + " images does not fit the preview mode");
+        }
+
+        IndexFrames();
+        if (_frames.empty())
+        {
+            throw std::runtime_error("Recording has no frames");
+        }
+    }
+    catch (...)
+    {
+        Unmap();
+        throw;
+    }
+
+    _stream_converter.InitStream(_header.width, _header.height, _config, PreviewFormat::YUYV);
+    LOG_DEBUG(LOG_TAG, "Playing %s: %zu frames %ux%u%s", config.playbackPath, _frames.size(), _header.width,
+              _header.height, _realtime ? "" : ", as fast as possible");
+}
+
+PlaybackCapture::~PlaybackCapture()
+{
+    Unmap();
+}
+
+void PlaybackCapture::Map(const char* path)
+{
+    // copy-on-write: the images point into the mapping (passthrough) and must be writable
+#ifdef _WIN32
+    HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error(std::string("Failed to open recording ") + path);
+    }
+    LARGE_INTEGER file_size;
+    HANDLE mapping = nullptr;
+    void* data = nullptr;
+    if (::GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+        mapping = ::CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    }
+    if (mapping != nullptr)
+    {
+        data = ::MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    }
+    if (data == nullptr)
+    {
+        if (mapping != nullptr)
+        {
+            ::CloseHandle(mapping);
+        }
+        ::CloseHandle(file);
+        throw std::runtime_error(std::string("Failed to map recording ") + path);
+    }
+    _file = file;
+    _mapping = mapping;
+    _data = static_cast<unsigned char*>(data);
+    _size = static_cast<size_t>(file_size.QuadPart);
+#else
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error(std::string("Failed to open recording ") + path);
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        throw std::runtime_error(std::string("Failed to map recording ") + path);
+    }
+    // played front to back
+    ::madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    _data = static_cast<unsigned char*>(data);
+    _size = static_cast<size_t>(st.st_size);
+#endif // _WIN32
+}
+
+void PlaybackCapture::Unmap()
+{
+    if (_data == nullptr)
+    {
+        return;
+    }
+#ifdef _WIN32
+    ::UnmapViewOfFile(_data);
+    ::CloseHandle(_mapping);
+    ::CloseHandle(_file);
+    _mapping = nullptr;
+    _file = nullptr;
+#else
+    ::munmap(_data, _size);
+#endif
+    _data = nullptr;
+    _size = 0;
+}
+
+void PlaybackCapture::IndexFrames()
+{
+    // the recording's index if it was stopped cleanly (as DumpReader), otherwise scan the complete frames
+    Dump::Trailer trailer;
+    if (_size >= sizeof(Dump::FileHeader) + sizeof(trailer))
+    {
+        ::memcpy(&trailer, _data + _size - sizeof(trailer), sizeof(trailer));
+        if (::memcmp(trailer.magic, Dump::INDEX_MAGIC, sizeof(trailer.magic)) == 0 &&
+            trailer.index_offset + uint64_t {trailer.frame_count} * sizeof(Dump::IndexEntry) + sizeof(trailer) ==
+                _size)
+        {
+            for (uint32_t i = 0; i < trailer.frame_count; i++)
+            {
+                Dump::IndexEntry entry;
+                ::memcpy(&entry, _data + trailer.index_offset + i * sizeof(entry), sizeof(entry));
+                if (entry.offset + sizeof(Dump::FrameHeader) + _header.frame_size <= _size)
+                {
+                    _frames.push_back(entry.offset);
+                }
+            }
+            return;
+        }
+    }
+
+    uint64_t offset = sizeof(Dump::FileHeader);
+    Dump::FrameHeader header;
+    while (offset + sizeof(header) <= _size)
+    {
+        ::memcpy(&header, _data + offset, sizeof(header));
+        const uint64_t next = offset + sizeof(header) + header.size;
+        // the last frame may be truncated
+        if (header.magic != Dump::FRAME_MAGIC || next > _size)
+        {
+            break;
+        }
+        _frames.push_back(offset);
+        offset = next;
+    }
+}
+
+const Dump::FrameHeader& PlaybackCapture::NextFrame()
+{
+    if (_next == _frames.size())
+    {
+        _next = 0;
+    }
+    const auto& header = *reinterpret_cast<const Dump::FrameHeader*>(_data + _frames[_next]);
+    if (_next == 0)
+    {
+        _loop_start = clock::now();
+        _loop_first_time = header.dequeue_time;
+    }
+    _next++;
+
+    if (_realtime && header.dequeue_time > _loop_first_time)
+    {
+        // recorded offset from the loop's first frame, each gap limited to max_frame_gap
+        auto due = _loop_start +
+                   std::chrono::microseconds {static_cast<int64_t>(header.dequeue_time - _loop_first_time)};
+        auto now = clock::now();
+        if (due - now > max_frame_gap)
+        {
+            _loop_start -= (due - now) - max_frame_gap;
+            due = now + max_frame_gap;
+        }
+        std::this_thread::sleep_until(due);
+    }
+    return header;
+}
+
+bool PlaybackCapture::Read(RealSenseID::Image* res, unsigned char* target)
+{
+    const auto& header = NextFrame();
+    res->timing = ImageTiming {};
+    res->timing.dequeueTime = HostTimeUs();
+    unsigned char* frame_data = _data + _frames[_next - 1] + sizeof(header);
+    if (!_stream_converter.Buffer2Image(res, frame_data, std::min(header.size, _header.frame_size), target))
+    {
+        return false;
+    }
+    if (_config.previewMode == PreviewMode::VGA)
+    {
+        // raw images carry their metadata, the VGA images have the recorded one
+        res->metadata.timestamp = header.timestamp;
+        res->metadata.status = header.status;
+        res->metadata.sensor_id = header.sensor_id;
+        res->metadata.led = (header.flags & Dump::FrameLed) != 0;
+        res->metadata.projector = (header.flags & Dump::FrameProjector) != 0;
+        res->metadata.face_rect.x = header.face_x;
+        res->metadata.face_rect.y = header.face_y;
+        res->metadata.face_rect.width = header.face_width;
+        res->metadata.face_rect.height = header.face_height;
+    }
+    return true;
+}
+
+unsigned int PlaybackCapture::ImageSize() const
+{
+    return _stream_converter.ImageSize();
+}
+
+bool PlaybackCapture::Skip()
+{
+    NextFrame();
+    return true;
+}
+} // namespace Capture
+} // namespace RealSenseID
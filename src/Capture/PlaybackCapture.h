@@ -0,0 +1,60 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+#include "CaptureSource.h"
+#include "StreamConverter.h"
+#include "DumpFormat.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace RealSenseID
+{
+namespace Capture
+{
+// Plays a dump recording (DumpRecorder, see DumpFormat.h) through the stream converter as the camera would deliver
+// it (PreviewConfig::playbackPath). The file is memory mapped copy-on-write, so the frames are converted (or passed
+// through) straight from the mapping. Frames play in a loop, paced by their recorded dequeue times if
+// PreviewConfig::playbackRealtime is set.
+class PlaybackCapture : public CaptureSource
+{
+public:
+    // throws if the file is not a recording or its images do not fit the config's preview mode
+    explicit PlaybackCapture(const PreviewConfig& config);
+    ~PlaybackCapture() override;
+
+    bool Read(RealSenseID::Image* res, unsigned char* target = nullptr) override;
+    unsigned int ImageSize() const override;
+    bool Skip() override;
+
+    PlaybackCapture(const PlaybackCapture&) = delete;
+    void operator=(const PlaybackCapture&) = delete;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    unsigned char* _data = nullptr; // the mapped file
+    size_t _size = 0;
+#ifdef _WIN32
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#endif
+    Dump::FileHeader _header {};
+    std::vector<uint64_t> _frames; // offsets of the frame headers, in recording order
+    size_t _next = 0;
+    bool _realtime = true;
+    clock::time_point _loop_start;
+    uint64_t _loop_first_time = 0; // recorded dequeue time of the loop's first frame
+    StreamConverter _stream_converter;
+    PreviewConfig _config;
+
+    void Map(const char* path);
+    void Unmap();
+    void IndexFrames();
+    // header of the next frame, once it is due
+    const Dump::FrameHeader& NextFrame();
+};
+} // namespace Capture
+} // namespace RealSenseID
@@ -0,0 +1,26 @@
+#include "PreviewEncoder.h"
+#include <stdexcept>
+
+#ifdef LINUX
+#include "LinuxEncoder.h"
+#endif
+
+namespace RealSenseID
+{
+namespace Capture
+{
+std::unique_ptr<PreviewEncoder> PreviewEncoder::Create(const PreviewEncoderConfig& config, unsigned int width,
+                                                       unsigned int height, PacketSink sink)
+{
+#ifdef LINUX
+    return std::make_unique<LinuxEncoder>(config, width, height, std::move(sink));
+#else
+    (void)config;
+    (void)width;
+    (void)height;
+    (void)sink;
+    throw std::runtime_error("no hardware preview encoder on this platform");
+#endif
+}
+} // namespace Capture
+} // namespace RealSenseID
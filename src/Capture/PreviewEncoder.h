@@ -0,0 +1,30 @@
+#pragma once
+#include "RealSenseID/Preview.h"
+#include <functional>
+#include <memory>
+
+namespace RealSenseID
+{
+namespace Capture
+{
+// Hardware encoder of the preview images (Preview::StartEncodedPreview). Images are NV12.
+class PreviewEncoder
+{
+public:
+    // called with each encoded packet, on the thread calling Encode() or Flush()
+    using PacketSink = std::function<void(const PreviewPacket&)>;
+
+    virtual ~PreviewEncoder() = default;
+
+    // queue the image for encoding and deliver the packets encoded so far. false on encoder errors
+    virtual bool Encode(const Image& image) = 0;
+
+    // encode the queued images and deliver their packets
+    virtual void Flush() = 0;
+
+    // encoder of the platform for width x height NV12 images. throws if there's none
+    static std::unique_ptr<PreviewEncoder> Create(const PreviewEncoderConfig& config, unsigned int width,
+                                                  unsigned int height, PacketSink sink);
+};
+} // namespace Capture
+} // namespace RealSenseID
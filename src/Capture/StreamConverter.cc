@@ -1,7 +1,12 @@
 #include "StreamConverter.h"
+#include "YuvKernels.h"
+#include "ClockSync.h"
 #include "Logger.h"
+#include "TraceRecorder.h"
 #include <cstring>
 #include <algorithm>
+#include <chrono>
+#include <vector>
 
 namespace RealSenseID
 {
@@ -9,50 +14,71 @@ namespace Capture
 {
 static const char* LOG_TAG = "StreamConverter";
 
-static void Clamp(double* num)
+// fixed-point simd conversion, see YuvKernels.h
+void Yuv2Rgb(Image* res, unsigned char* yuyv_image, unsigned int buffer_size, YuvKernels::RgbLayout layout)
 {
-    if (*num < 0)
-        *num = 0;
-    else if (*num > 255)
-        *num = 255;
+    const size_t n_pixels =
+        std::min(res->size / YuvKernels::PixelSize(layout), buffer_size / YUV_PIXEL_SIZE) & ~size_t(1);
+    YuvKernels::GetYuyvToRgb()(yuyv_image, res->buffer, n_pixels, layout);
 }
 
-static void SetRgb(int y, int cb, int cr, double* r, double* g, double* b)
+static YuvKernels::RgbLayout ToRgbLayout(PreviewFormat format)
 {
-    *r = y + (1.4065 * (cr - 128));
-    *g = y - (0.3455 * (cb - 128)) - (0.7169 * (cr - 128));
-    *b = y + (1.7790 * (cb - 128));
+    switch (format)
+    {
+    case PreviewFormat::RGBA:
+        return YuvKernels::RgbLayout::Rgba;
+    case PreviewFormat::BGRA:
+        return YuvKernels::RgbLayout::Bgra;
+    default:
+        return YuvKernels::RgbLayout::Rgb;
+    }
+}
 
-    Clamp(r);
-    Clamp(g);
-    Clamp(b);
+PreviewFormat ResolvePreviewFormat(PreviewFormat format)
+{
+    if (format != PreviewFormat::Default)
+        return format;
+    return (VGA_PIXEL_SIZE == RGBA_PIXEL_SIZE) ? PreviewFormat::RGBA : PreviewFormat::RGB;
 }
 
-void Yuv2Rgb(Image* res, unsigned char* yuyv_image, unsigned int buffer_size)
+uint64_t HostTimeUs()
 {
-    unsigned char* rgb_image = res->buffer;
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
 
-    double r;
-    double g;
-    double b;
+bool HasPreviewRegion(const PreviewConfig& config)
+{
+    return config.previewMode == PreviewMode::VGA &&
+           (config.roi.x > 0 || config.roi.y > 0 || config.roi.width > 0 || config.roi.height > 0 ||
+            config.downscale > 1 || (config.targetWidth > 0 && config.targetHeight > 0));
+}
 
-    for (unsigned int i = 0, j = 0; i < res->size; j += 4)
+// Copy the region of a YUYV image, keeping every downscale-th pixel and row. Each output pixel pair takes the chroma
+// of the source pair holding its first pixel.
+static void CopyYuyvRegion(const unsigned char* src, unsigned int src_width, const PreviewRoi& roi,
+                           unsigned int downscale, unsigned int width, unsigned int height, unsigned char* dst)
+{
+    for (unsigned int row = 0; row < height; row++, dst += width * YUV_PIXEL_SIZE)
     {
-        SetRgb(yuyv_image[j], yuyv_image[j + 1], yuyv_image[j + 3], &r, &g, &b);
-
-        rgb_image[i++] = static_cast<unsigned char>(r);
-        rgb_image[i++] = static_cast<unsigned char>(g);
-        rgb_image[i++] = static_cast<unsigned char>(b);
-        if (VGA_PIXEL_SIZE == RGBA_PIXEL_SIZE)
-            rgb_image[i++] = 255;
-        
-        SetRgb(yuyv_image[j + 2], yuyv_image[j + 1], yuyv_image[j + 3], &r, &g, &b);
-
-        rgb_image[i++] = static_cast<unsigned char>(r);
-        rgb_image[i++] = static_cast<unsigned char>(g);
-        rgb_image[i++] = static_cast<unsigned char>(b);
-        if (VGA_PIXEL_SIZE == RGBA_PIXEL_SIZE)
-            rgb_image[i++] = 255;
+        const unsigned char* src_row =
+            src + (static_cast<size_t>(roi.y) + row * downscale) * src_width * YUV_PIXEL_SIZE;
+        if (downscale == 1)
+        {
+            memcpy(dst, src_row + roi.x * YUV_PIXEL_SIZE, width * YUV_PIXEL_SIZE);
+            continue;
+        }
+        for (unsigned int col = 0; col < width; col += 2)
+        {
+            const unsigned int x0 = roi.x + col * downscale, x1 = x0 + downscale;
+            const unsigned char* pair = src_row + (x0 & ~1u) * YUV_PIXEL_SIZE;
+            unsigned char* out = dst + col * YUV_PIXEL_SIZE;
+            out[0] = src_row[x0 * YUV_PIXEL_SIZE];
+            out[1] = pair[1];
+            out[2] = src_row[x1 * YUV_PIXEL_SIZE];
+            out[3] = pair[3];
+        }
     }
 }
 
@@ -99,174 +125,279 @@ ImageMetadata ExtractMetadata(const unsigned char* buffer,unsigned int size)
     return md;
 }
 
-static uint8_t Raw8Value(const uint8_t* src, int baseoff, int mod5)
+// host time of the device's capture timestamp, if the device clock is synced
+static void StampDeviceCapture(Image* res)
 {
-    if (mod5 >= 4)
-    {
-        LOG_ERROR(LOG_TAG,"%s(): Invalid index %d!", __FUNCTION__, mod5);
-        return 0;
-    }
-
-    return *(src + baseoff);
+    uint64_t host_time = 0;
+    if (res->metadata.timestamp != 0 && ClockSync::Shared().DeviceToHost32(res->metadata.timestamp, host_time))
+        res->timing.deviceCaptureTime = host_time;
 }
 
-void RotatedRaw2Rgb(Image* res, unsigned char* buffer, unsigned int buffer_size)
+// RAW10 bayer to rgb (bilinear demosaic) rotated to portrait: source pixel (x, y) goes to
+// (height - 1 - y, width - 1 - x). Neighbours are mirrored at the image borders. The image is processed in tiles of
+// RAW_TILE_ROWS source rows, in parallel: each tile is unpacked to 8 bit rows, demosaiced into a small rgb tile, then
+// written out with the rotation. A region of the image (face crop) is converted the same way, unpacking only its
+// columns and their neighbours.
+static const unsigned int RAW_TILE_ROWS = 16;
+
+// source columns [x0, x1) and rows [y0, y1). x0 and x1 are multiples of 4 (raw10 groups), which keeps the bayer phase
+struct RawRegion
 {
-    unsigned int src_height = res->height, src_width = res->width;
-    unsigned int dst_height = src_width, dst_width = src_height; // rotating image 
+    unsigned int x0;
+    unsigned int x1;
+    unsigned int y0;
+    unsigned int y1;
+};
 
-    if (((src_height * src_width / 4) * 5) != buffer_size) // check for valid w10 image 10bpp
+struct RawTileContext
+{
+    const unsigned char* src;
+    unsigned int src_width;
+    unsigned int src_height;
+    unsigned int line; // source bytes per row
+    RawRegion region;
+    unsigned char* dst;
+    unsigned int dst_width; // region rows
+};
+
+// rgb of one source row, from the 8 bit rows above (u), at (c) and below (d) it. the rows are padded with one mirrored
+// pixel on each side: pixel x of the row is at index x + 1.
+static void DemosaicRow(const unsigned char* u, const unsigned char* c, const unsigned char* d, unsigned int width,
+                        unsigned int y, unsigned char* rgb)
+{
+    for (unsigned int x = 0; x < width; x++, rgb += 3)
     {
-        return;
+        const unsigned int hn = (c[x] + c[x + 2]) >> 1;
+        const unsigned int vn = (u[x + 1] + d[x + 1]) >> 1;
+        const unsigned int value = c[x + 1];
+        const bool green = ((x + y) & 1) != 0;
+        if (green)
+        {
+            rgb[0] = static_cast<unsigned char>((y & 1) ? hn : vn);
+            rgb[1] = static_cast<unsigned char>(value);
+            rgb[2] = static_cast<unsigned char>((y & 1) ? vn : hn);
+        }
+        else
+        {
+            const unsigned int di = (u[x] + u[x + 2] + d[x] + d[x + 2]) >> 2;
+            rgb[0] = static_cast<unsigned char>((y & 1) ? value : di);
+            rgb[1] = static_cast<unsigned char>((vn + hn) >> 1);
+            rgb[2] = static_cast<unsigned char>((y & 1) ? di : value);
+        }
     }
+}
 
-    unsigned int line = buffer_size / src_height;
-
-    const unsigned char* src = buffer;
-    unsigned char* dst = res->buffer;
-
-    const int palette = 128;
+static void RotatedRaw2RgbTile(const RawTileContext& ctx, unsigned int first_row)
+{
+    const unsigned int width = ctx.src_width, height = ctx.src_height;
+    const RawRegion& region = ctx.region;
+    const unsigned int rows = std::min(RAW_TILE_ROWS, region.y1 - first_row);
+    const unsigned int columns = region.x1 - region.x0;
+    // unpacked columns [ux0, ux1): the region and a raw10 group on each side for the neighbours
+    const unsigned int ux0 = region.x0 > 0 ? region.x0 - 4 : 0;
+    const unsigned int ux1 = region.x1 < width ? region.x1 + 4 : width;
+    // +16 for the simd unpack overwrite
+    const size_t padded_width = ux1 - ux0 + 2;
+    std::vector<unsigned char> raw8((rows + 2) * padded_width + 16);
+    std::vector<unsigned char> rgb(static_cast<size_t>(rows) * columns * 3);
+
+    // 8 bit rows first_row - 1 .. first_row + rows, mirrored at the top and bottom
+    auto unpack = YuvKernels::GetRaw10ToRaw8();
+    for (unsigned int k = 0; k < rows + 2; k++)
+    {
+        int row = static_cast<int>(first_row + k) - 1;
+        if (row < 0)
+            row = 1;
+        else if (row >= static_cast<int>(height))
+            row = height - 2;
+        unsigned char* padded_row = &raw8[k * padded_width];
+        unpack(ctx.src + static_cast<size_t>(row) * ctx.line + ux0 / 4 * 5, padded_row + 1, ux1 - ux0);
+        if (ux0 == 0)
+            padded_row[0] = padded_row[2];
+        if (ux1 == width)
+            padded_row[ux1 - ux0 + 1] = padded_row[ux1 - ux0 - 1];
+    }
 
-    unsigned int src_x = 0, src_y = 0;
-    unsigned int dst_x = dst_width -1 , dst_y = dst_height -1; 
-    unsigned int i;
+    // region column x is at index x0 - ux0 + x + 1 of the padded rows
+    for (unsigned int k = 0; k < rows; k++)
+    {
+        const unsigned char* u = &raw8[k * padded_width + (region.x0 - ux0)];
+        DemosaicRow(u, u + padded_width, u + 2 * padded_width, columns, first_row + k, &rgb[k * columns * 3]);
+    }
 
-    for (i = 0; i < buffer_size; i++)
+    // region column x is destination row columns - 1 - x, the tile's rows are a contiguous run of it
+    for (unsigned int x = 0; x < columns; x++)
     {
-        int p[8];
-        uint8_t hn, vn, di;
-        uint8_t br0, br1, g;
-        int mode;
-        int hnext = 1, hprev = 1;
-
-        /* skip every 5th byte */
-        switch (i % 5)
+        unsigned char* dst = ctx.dst + VGA_PIXEL_SIZE * (static_cast<size_t>(columns - 1 - x) * ctx.dst_width +
+                                                         (region.y1 - 1 - first_row));
+        const unsigned char* src = &rgb[x * 3];
+        for (unsigned int k = 0; k < rows; k++, dst -= VGA_PIXEL_SIZE, src += columns * 3)
         {
-        case 0:
-            hprev = 2;
-            break;
-        case 3:
-            hnext = 2;
-            break;
-        case 4:
-            continue;
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            if (VGA_PIXEL_SIZE == RGBA_PIXEL_SIZE)
+                dst[3] = 255;
         }
+    }
+}
 
-        /* Setup offsets to this pixel's neighbours. */
-        p[0] = i - line - hprev;
-        p[1] = i - line;
-        p[2] = i - line + hnext;
-        p[3] = i - hprev;
-        p[4] = i + hnext;
-        p[5] = i + line - hprev;
-        p[6] = i + line;
-        p[7] = i + line + hnext;
-
-        /* Swap offsets if they are out of bounds. */
-        if (!src_y)
-        {
-            p[0] = p[5];
-            p[1] = p[6];
-            p[2] = p[7];
-        }
-        else if (src_y == src_height - 1)
-        {
-            p[5] = p[0];
-            p[6] = p[1];
-            p[7] = p[2];
-        }
+// converts the region of the source image (res->width x res->height) to res->buffer, and sets res to the rotated
+// region's dimensions
+static void RotatedRaw2RgbRegion(Image* res, const unsigned char* buffer, unsigned int buffer_size,
+                                 const RawRegion& region, MatcherThreadPool* pool)
+{
+    const unsigned int src_height = res->height, src_width = res->width;
+    if (((src_height * src_width / 4) * 5) != buffer_size) // check for valid w10 image 10bpp
+    {
+        return;
+    }
+    if (src_width < 4 || src_width % 4 != 0 || src_height < 2)
+    {
+        return;
+    }
 
-        if (!src_x)
-        {
-            p[0] = p[2];
-            p[3] = p[4];
-            p[5] = p[7];
-        }
-        else if (src_x == src_width - 1)
-        {
-            p[2] = p[0];
-            p[4] = p[3];
-            p[7] = p[5];
-        }
+    const unsigned int dst_width = region.y1 - region.y0, dst_height = region.x1 - region.x0; // rotating image
+    const RawTileContext ctx {buffer, src_width, src_height, buffer_size / src_height, region, res->buffer, dst_width};
+    const size_t tiles = (dst_width + RAW_TILE_ROWS - 1) / RAW_TILE_ROWS;
+    auto tile_task = [&ctx](size_t tile) {
+        RotatedRaw2RgbTile(ctx, ctx.region.y0 + static_cast<unsigned int>(tile) * RAW_TILE_ROWS);
+    };
+    if (pool && tiles > 1)
+    {
+        pool->Run(tiles, tile_task);
+    }
+    else
+    {
+        for (size_t tile = 0; tile < tiles; tile++)
+            tile_task(tile);
+    }
+
+    // change image attr to match the convertion
+    res->height = dst_height;
+    res->width = dst_width;
+    res->size = dst_width * dst_height * VGA_PIXEL_SIZE;
+    res->stride = dst_width * VGA_PIXEL_SIZE;
+}
 
-        /* Average matching neighbours. */
-        hn = ((Raw8Value(src, p[3], p[3] % 5) + Raw8Value(src, p[4], p[4] % 5)) / 2);
-        vn = ((Raw8Value(src, p[1], p[1] % 5) + Raw8Value(src, p[6], p[6] % 5)) / 2);
-        di = ((Raw8Value(src, p[0], p[0] % 5) + Raw8Value(src, p[2], p[2] % 5) + Raw8Value(src, p[5], p[5] % 5) +
-               Raw8Value(src, p[7], p[7] % 5)) /
-              4);
+void RotatedRaw2Rgb(Image* res, unsigned char* buffer, unsigned int buffer_size, MatcherThreadPool* pool)
+{
+    RotatedRaw2RgbRegion(res, buffer, buffer_size, RawRegion {0, res->width, 0, res->height}, pool);
+}
 
-        /* Calculate RGB */
-        if (palette == 128)
-            mode = (src_x + src_y) & 0x01;
-        else
-            mode = ~(src_x + src_y) & 0x01;
+// source region of the face rect (in the rotated image) with margin percent of the face size on each side, clipped
+// to the image. false if empty
+static bool FaceCropRegion(const ImageMetadata& metadata, unsigned int src_width, unsigned int src_height,
+                           unsigned int margin, RawRegion& region)
+{
+    const FaceRectangle& face = metadata.face_rect;
+    const unsigned int margin_x = face.width * margin / 100, margin_y = face.height * margin / 100;
+    // rotated x (destination columns) are source rows from the bottom, rotated y are source columns from the right
+    const unsigned int dx0 = face.x > margin_x ? face.x - margin_x : 0;
+    const unsigned int dx1 = std::min(face.x + face.width + margin_x, src_height);
+    const unsigned int dy0 = face.y > margin_y ? face.y - margin_y : 0;
+    const unsigned int dy1 = std::min(face.y + face.height + margin_y, src_width);
+    if (dx0 >= dx1 || dy0 >= dy1)
+    {
+        return false;
+    }
+    region.y0 = src_height - dx1;
+    region.y1 = src_height - dx0;
+    region.x0 = (src_width - dy1) & ~3u;
+    region.x1 = std::min((src_width - dy0 + 3) & ~3u, src_width);
+    return true;
+}
 
-        if (mode)
+void StreamConverter::InitStream(unsigned int width, unsigned int height, const PreviewConfig& config,
+                                 PreviewFormat native_format)
+{
+    _mode = config.previewMode;
+    _face_crop = (_mode == PreviewMode::FHD_Rect) && config.faceCrop;
+    _face_crop_margin = config.faceCropMargin;
+    _metadata_only = (_mode != PreviewMode::VGA) && config.metadataOnly;
+    if (_mode == PreviewMode::FHD_Rect && !_metadata_only && !_raw_pool)
+    {
+        _raw_pool = std::make_unique<MatcherThreadPool>();
+    }
+    _attr.width = width;
+    _attr.height = height;
+    _attr.size = (_mode != PreviewMode::Dump) ? _attr.width * _attr.height * VGA_PIXEL_SIZE
+                                              : (_attr.width * _attr.height / 4) * 5;
+    _attr.stride = _attr.size / _attr.height;
+
+    if (_mode == PreviewMode::VGA)
+    {
+        _format = ResolvePreviewFormat(config.previewFormat);
+        _has_region = HasPreviewRegion(config);
+        if (_has_region)
         {
-            g = Raw8Value(src, i, i % 5);
-            if (src_y & 0x01)
+            // clip the roi to the image, on pixel pair boundaries
+            _src_width = width;
+            _src_height = height;
+            _roi.x = std::min(config.roi.x, width) & ~1u;
+            _roi.y = std::min(config.roi.y, height);
+            _roi.width = config.roi.width ? std::min(config.roi.width, width - _roi.x) : width - _roi.x;
+            _roi.height = config.roi.height ? std::min(config.roi.height, height - _roi.y) : height - _roi.y;
+
+            _downscale = std::max(config.downscale, 1u);
+            if (config.targetWidth > 0 && config.targetHeight > 0)
             {
-                br1 = hn;
-                br0 = vn;
+                _downscale = std::max(std::min(_roi.width / config.targetWidth, _roi.height / config.targetHeight), 1u);
             }
-            else
+            _attr.width = std::max((_roi.width / _downscale) & ~1u, 2u);
+            _attr.height = std::max(_roi.height / _downscale, 2u);
+            if (_attr.width * _downscale > _roi.width || _attr.height * _downscale > _roi.height)
             {
-                br1 = vn;
-                br0 = hn;
+                LOG_ERROR(LOG_TAG, "Preview region too small, using the whole image");
+                _roi.x = _roi.y = 0;
+                _roi.width = width;
+                _roi.height = height;
+                _downscale = 1;
+                _attr.width = width;
+                _attr.height = height;
             }
-        }
-        else if (src_y & 0x01)
-        {
-            br1 = Raw8Value(src, i, i % 5);
-            g = (vn + hn) / 2;
-            br0 = di;
-        }
-        else
-        {
-            br0 = Raw8Value(src, i, i % 5);
-            g = (vn + hn) / 2;
-            br1 = di;
+            if (_format == PreviewFormat::NV12)
+            {
+                _attr.height &= ~1u;
+            }
+            _region_yuyv.resize(static_cast<size_t>(_attr.width) * _attr.height * YUV_PIXEL_SIZE);
+            LOG_DEBUG(LOG_TAG, "Preview region %u,%u %ux%u downscale %u: %ux%u", _roi.x, _roi.y, _roi.width,
+                      _roi.height, _downscale, _attr.width, _attr.height);
         }
 
-        unsigned int cur_rgb_pixel_offset = VGA_PIXEL_SIZE * (dst_y * dst_width + dst_x);
-        *(dst + cur_rgb_pixel_offset) = br1;
-        *(dst + cur_rgb_pixel_offset + 1) = g;
-        *(dst + cur_rgb_pixel_offset + 2) = br0;
-        
-        if (VGA_PIXEL_SIZE == RGBA_PIXEL_SIZE)
+        switch (_format)
         {
-            *(dst + 3) = 255;
+        case PreviewFormat::YUYV:
+            _attr.size = _attr.width * _attr.height * YUV_PIXEL_SIZE;
+            _attr.stride = _attr.width * YUV_PIXEL_SIZE;
+            _passthrough = !_has_region;
+            break;
+        case PreviewFormat::NV12:
+            _attr.size = _attr.width * _attr.height * 3 / 2;
+            _attr.stride = _attr.width; // of both planes
+            _passthrough = !_has_region && (native_format == PreviewFormat::NV12);
+            break;
+        default:
+            _attr.size = _attr.width * _attr.height * YuvKernels::PixelSize(ToRgbLayout(_format));
+            _attr.stride = _attr.size / _attr.height;
+            break;
         }
-        
-        dst_y--;
-        src_x++;
+    }
 
-        /* Move to the next line*/
-        if (src_x == src_width)
-        {
-            src_x = 0;
-            src_y++;
-            dst_y = dst_height - 1;
-            dst_x--;
-        }
+    if (_metadata_only)
+    {
+        // images without pixels
+        _attr.size = 0;
+        _attr.stride = 0;
     }
 
-    // change image attr to match the convertion
-    res->height = dst_height;
-    res->width = dst_width;
-    res->stride = res->size / res->height;
+    // passthrough images point into the source buffers
+    _attr.buffer = (_passthrough || _metadata_only) ? nullptr : new unsigned char[_attr.size];
 }
 
-void StreamConverter::InitStream(unsigned int width, unsigned int height, PreviewMode mode)
+bool StreamConverter::IsPassthrough() const
 {
-    _mode = mode;
-    _attr.width = width;
-    _attr.height = height;
-    _attr.size = (_mode != PreviewMode::Dump) ? _attr.width * _attr.height * VGA_PIXEL_SIZE
-                                              : (_attr.width * _attr.height / 4) * 5;
-    _attr.stride = _attr.size / _attr.height;
-    _attr.buffer = new unsigned char[_attr.size];
+    return _passthrough;
 }
 
 StreamConverter::~StreamConverter()
@@ -279,19 +410,87 @@ StreamConverter::~StreamConverter()
     
 }
 
-bool StreamConverter::Buffer2Image(Image* res, unsigned char* src_buffer, unsigned int src_buffer_size)
+unsigned int StreamConverter::ImageSize() const
 {
+    return _attr.size;
+}
+
+bool StreamConverter::Buffer2Image(Image* res, unsigned char* src_buffer, unsigned int src_buffer_size,
+                                   unsigned char* target)
+{
+    Trace::Scope convert_trace {"Convert", "preview"};
+    const auto timing = res->timing; // set by the capture
     *res = _attr;
+    res->timing = timing;
+    if (_metadata_only)
+    {
+        // the pixels are not touched, only the metadata header of the raw image is read
+        if (src_buffer_size < 23)
+            return false;
+        res->metadata = ExtractMetadata(src_buffer, src_buffer_size);
+        if (!IsValidDumpedImage(src_buffer) ||
+            (_mode == PreviewMode::FHD_Rect && !IsValidFaceRect(res->metadata, res->width, res->height)))
+            return false;
+        StampDeviceCapture(res);
+        res->timing.convertedTime = HostTimeUs();
+        return true;
+    }
+    if (target)
+        res->buffer = target;
     switch (_mode) // process image by mode
     {
     case PreviewMode::VGA:
-        Yuv2Rgb(res, src_buffer, src_buffer_size);
+        if (_has_region)
+        {
+            // only the region is converted
+            if (src_buffer_size < _src_width * _src_height * YUV_PIXEL_SIZE)
+                return false;
+            unsigned char* region = (_format == PreviewFormat::YUYV) ? res->buffer : _region_yuyv.data();
+            CopyYuyvRegion(src_buffer, _src_width, _roi, _downscale, res->width, res->height, region);
+            if (_format == PreviewFormat::YUYV)
+                break;
+            src_buffer = region;
+            src_buffer_size = static_cast<unsigned int>(_region_yuyv.size());
+        }
+
+        if (_passthrough)
+        {
+            if (src_buffer_size < res->size)
+                return false;
+            if (target)
+                memcpy(target, src_buffer, res->size);
+            else
+                res->buffer = src_buffer;
+        }
+        else if (_format == PreviewFormat::NV12)
+        {
+            if (src_buffer_size < res->width * res->height * YUV_PIXEL_SIZE)
+                return false;
+            YuvKernels::YuyvToNv12(src_buffer, res->buffer, res->width, res->height);
+        }
+        else
+        {
+            Yuv2Rgb(res, src_buffer, src_buffer_size, ToRgbLayout(_format));
+        }
         break;
     case PreviewMode::FHD_Rect:
         res->metadata = ExtractMetadata(src_buffer, src_buffer_size);
         if (!IsValidFaceRect(res->metadata, res->width, res->height))
             return false;
-        RotatedRaw2Rgb(res, src_buffer, src_buffer_size);
+        if (_face_crop)
+        {
+            RawRegion region;
+            if (!FaceCropRegion(res->metadata, res->width, res->height, _face_crop_margin, region))
+                return false;
+            // the face rect of the crop, from the crop's origin in the rotated image
+            res->metadata.face_rect.x -= res->height - region.y1;
+            res->metadata.face_rect.y -= res->width - region.x1;
+            RotatedRaw2RgbRegion(res, src_buffer, src_buffer_size, region, _raw_pool.get());
+        }
+        else
+        {
+            RotatedRaw2Rgb(res, src_buffer, src_buffer_size, _raw_pool.get());
+        }
         break;
     case PreviewMode::Dump:
         if (!IsValidDumpedImage(src_buffer))
@@ -300,6 +499,8 @@ bool StreamConverter::Buffer2Image(Image* res, unsigned char* src_buffer, unsign
         memcpy((void*)res->buffer, (void*)src_buffer, src_buffer_size);
         break;
     }
+    StampDeviceCapture(res);
+    res->timing.convertedTime = HostTimeUs();
     return true;
 }
 
@@ -1,5 +1,9 @@
 #pragma once
 #include "RealSenseID/Preview.h"
+#include "Matcher/MatcherThreadPool.h"
+#include "YuvKernels.h"
+#include <memory>
+#include <vector>
 
 namespace RealSenseID
 {
@@ -18,16 +22,62 @@ static const int VGA_PIXEL_SIZE = RGBA_PIXEL_SIZE;
 static const int VGA_PIXEL_SIZE = RGB_PIXEL_SIZE;
 #endif
 
+// PreviewFormat::Default as the platform's rgb format
+PreviewFormat ResolvePreviewFormat(PreviewFormat format);
+
+// host steady clock in microseconds (ImageTiming)
+uint64_t HostTimeUs();
+
+// true if the config crops or downscales the VGA preview images
+bool HasPreviewRegion(const PreviewConfig& config);
+
+// conversions of Buffer2Image(), also used by the preview benchmarks and rsid-preview-check.
+// YUYV to the rgb layout, min(res->size / pixel size, buffer_size / YUV_PIXEL_SIZE) pixels (even) to res->buffer
+void Yuv2Rgb(Image* res, unsigned char* yuyv_image, unsigned int buffer_size, YuvKernels::RgbLayout layout);
+
+// RAW10 res->width x res->height image to VGA_PIXEL_SIZE rgb rotated to portrait, in tiles on the pool if given.
+// res is set to the rotated dimensions, nothing is converted if buffer_size is not the RAW10 image size
+void RotatedRaw2Rgb(Image* res, unsigned char* buffer, unsigned int buffer_size, MatcherThreadPool* pool);
+
+// metadata header at the start of a raw (FHD_Rect / Dump) image
+ImageMetadata ExtractMetadata(const unsigned char* buffer, unsigned int size);
+
 class StreamConverter
 {
     public:    
         ~StreamConverter();
-        void InitStream(unsigned int width, unsigned int height, PreviewMode mode);
-        bool Buffer2Image(Image* res, unsigned char* src_buffer, unsigned int src_buffer_size);
+        // native_format is the format the camera streams in VGA mode (YUYV, or NV12 if requested and supported,
+        // which is never the case with a preview region)
+        void InitStream(unsigned int width, unsigned int height, const PreviewConfig& config,
+                        PreviewFormat native_format);
+        // target (optional) is a buffer of at least ImageSize() bytes to write the image to instead of the
+        // converter's own buffer. passthrough images are copied to it.
+        bool Buffer2Image(Image* res, unsigned char* src_buffer, unsigned int src_buffer_size,
+                          unsigned char* target = nullptr);
+
+        // max size of the images
+        unsigned int ImageSize() const;
+
+        // true if Buffer2Image() returns images pointing into the source buffer, which must then be kept until the
+        // image is consumed
+        bool IsPassthrough() const;
 
     private:
         PreviewMode _mode;
+        PreviewFormat _format = PreviewFormat::Default;
+        bool _passthrough = false;
+        // preview region (VGA mode) of the camera image, of _src_width pixels per row
+        bool _has_region = false;
+        unsigned int _src_width = 0;
+        unsigned int _src_height = 0;
+        PreviewRoi _roi;
+        unsigned int _downscale = 1;
+        std::vector<unsigned char> _region_yuyv; // region of the camera image, before conversion
         Image _attr; // including _attr->buffer
+        std::unique_ptr<MatcherThreadPool> _raw_pool; // parallel raw conversion (FHD_Rect mode)
+        bool _face_crop = false; // FHD_Rect mode: convert only the face rect and margin
+        unsigned int _face_crop_margin = 0;
+        bool _metadata_only = false; // FHD_Rect and Dump modes: deliver only the metadata
 };
 }// namespace Capture
 } // namespace RealSenseID
\ No newline at end of file
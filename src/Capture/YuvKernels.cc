@@ -0,0 +1,480 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "YuvKernels.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef RSID_CAPTURE_X86_KERNELS
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+#endif // RSID_CAPTURE_X86_KERNELS
+
+#ifdef RSID_CAPTURE_NEON_KERNELS
+#include <arm_neon.h>
+#endif // RSID_CAPTURE_NEON_KERNELS
+
+// gcc/clang need the instruction set enabled per function, msvc allows intrinsics everywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define RSID_TARGET(isa) __attribute__((target(isa)))
+#else
+#define RSID_TARGET(isa)
+#endif
+
+namespace RealSenseID
+{
+namespace Capture
+{
+namespace YuvKernels
+{
+static const char* LOG_TAG = "YuvKernels";
+
+// BT.601 coefficients as 16 bit multipliers of the high half of the product (x * k >> 16), each below 2^15:
+// 1.4065 = 1 + R_V / 2^16, 0.3455 = G_U / 2^16, 0.7169 = 1 - G_V / 2^16, 1.7790 = 2 - B_U / 2^16
+static const int16_t R_V = 26640;
+static const int16_t G_U = 22643;
+static const int16_t G_V = 18553;
+static const int16_t B_U = 14484;
+
+// values are in 1/128 units (y, u - 128 and v - 128 shifted left by 7)
+static const int FRACTION_BITS = 7;
+
+static inline int MulHi(int x, int k)
+{
+    return (x * k) >> 16;
+}
+
+static inline int SaturateInt16(int x)
+{
+    return std::min(std::max(x, -32768), 32767);
+}
+
+static inline unsigned char ToByte(int x)
+{
+    return static_cast<unsigned char>(std::min(std::max(x >> FRACTION_BITS, 0), 255));
+}
+
+void YuyvToRgbScalar(const unsigned char* yuyv, unsigned char* rgb, size_t n_pixels, RgbLayout layout)
+{
+    const unsigned int pixel_size = PixelSize(layout);
+    const int r_pos = layout == RgbLayout::Bgra ? 2 : 0;
+    for (size_t i = 0; i < n_pixels; i += 2, yuyv += 4)
+    {
+        const int du = (yuyv[1] - 128) * (1 << FRACTION_BITS);
+        const int dv = (yuyv[3] - 128) * (1 << FRACTION_BITS);
+        const int r_term = dv + MulHi(dv, R_V);
+        const int g_term = MulHi(du, G_U) + dv - MulHi(dv, G_V);
+        const int b_term = 2 * du - MulHi(du, B_U);
+
+        for (int j = 0; j < 2; j++)
+        {
+            const int y = yuyv[2 * j] * (1 << FRACTION_BITS);
+            rgb[r_pos] = ToByte(SaturateInt16(y + r_term));
+            rgb[1] = ToByte(SaturateInt16(y - g_term));
+            rgb[2 - r_pos] = ToByte(SaturateInt16(y + b_term));
+            if (pixel_size == 4)
+            {
+                rgb[3] = 255;
+            }
+            rgb += pixel_size;
+        }
+    }
+}
+
+// pixels converted by the simd loops. at least one pixel pair is left to the scalar tail, since the 3 byte pixels are
+// stored 4 bytes at a time.
+static size_t SimdPixels(size_t n_pixels, size_t block_pixels)
+{
+    return n_pixels >= 2 ? ((n_pixels - 2) / block_pixels) * block_pixels : 0;
+}
+
+#ifdef RSID_CAPTURE_X86_KERNELS
+
+// r, g, b (16 bit, 1/128 units) of 8 yuyv pixels
+RSID_TARGET("sse2")
+static inline void ConvertSse2(__m128i yuyv, __m128i& r, __m128i& g, __m128i& b)
+{
+    const __m128i y = _mm_slli_epi16(_mm_and_si128(yuyv, _mm_set1_epi16(0x00ff)), FRACTION_BITS);
+    const __m128i uv = _mm_slli_epi16(_mm_sub_epi16(_mm_srli_epi16(yuyv, 8), _mm_set1_epi16(128)), FRACTION_BITS);
+    // broadcast the chroma of each pixel pair to both of its pixels
+    const __m128i du = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    const __m128i dv = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+    const __m128i r_term = _mm_add_epi16(dv, _mm_mulhi_epi16(dv, _mm_set1_epi16(R_V)));
+    const __m128i g_term = _mm_sub_epi16(_mm_add_epi16(_mm_mulhi_epi16(du, _mm_set1_epi16(G_U)), dv),
+                                         _mm_mulhi_epi16(dv, _mm_set1_epi16(G_V)));
+    const __m128i b_term = _mm_sub_epi16(_mm_add_epi16(du, du), _mm_mulhi_epi16(du, _mm_set1_epi16(B_U)));
+
+    r = _mm_srai_epi16(_mm_adds_epi16(y, r_term), FRACTION_BITS);
+    g = _mm_srai_epi16(_mm_subs_epi16(y, g_term), FRACTION_BITS);
+    b = _mm_srai_epi16(_mm_adds_epi16(y, b_term), FRACTION_BITS);
+}
+
+// store 8 pixels of 16 bit r, g, b (clamped to [0, 255] by the pack). 3 byte pixels write one byte past the last one.
+RSID_TARGET("sse2")
+static inline void StorePixelsSse2(__m128i r, __m128i g, __m128i b, unsigned char* rgb, RgbLayout layout)
+{
+    if (layout == RgbLayout::Bgra)
+    {
+        std::swap(r, b);
+    }
+    const __m128i r8 = _mm_packus_epi16(r, r);
+    const __m128i g8 = _mm_packus_epi16(g, g);
+    const __m128i b8 = _mm_packus_epi16(b, b);
+    const __m128i rg = _mm_unpacklo_epi8(r8, g8);
+    const __m128i ba = _mm_unpacklo_epi8(b8, _mm_set1_epi8(-1));
+    __m128i rgba[2] = {_mm_unpacklo_epi16(rg, ba), _mm_unpackhi_epi16(rg, ba)};
+
+    if (layout != RgbLayout::Rgb)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb), rgba[0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb + 16), rgba[1]);
+        return;
+    }
+
+    for (int half = 0; half < 2; half++)
+    {
+        for (int i = 0; i < 4; i++, rgb += 3)
+        {
+            const int pixel = _mm_cvtsi128_si32(rgba[half]);
+            ::memcpy(rgb, &pixel, sizeof(pixel));
+            rgba[half] = _mm_srli_si128(rgba[half], 4);
+        }
+    }
+}
+
+RSID_TARGET("sse2")
+void YuyvToRgbSse2(const unsigned char* yuyv, unsigned char* rgb, size_t n_pixels, RgbLayout layout)
+{
+    const unsigned int pixel_size = PixelSize(layout);
+    const size_t simd_pixels = SimdPixels(n_pixels, 8);
+    for (size_t i = 0; i < simd_pixels; i += 8)
+    {
+        __m128i r, g, b;
+        ConvertSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(yuyv + 2 * i)), r, g, b);
+        StorePixelsSse2(r, g, b, rgb + pixel_size * i, layout);
+    }
+
+    YuyvToRgbScalar(yuyv + 2 * simd_pixels, rgb + pixel_size * simd_pixels, n_pixels - simd_pixels, layout);
+}
+
+// same as the sse2 kernel on 16 pixels. the shuffles work within each 128 bit lane, so the lanes hold pixels 0-7 and
+// 8-15 in order and are stored by the sse2 code.
+RSID_TARGET("avx2")
+void YuyvToRgbAvx2(const unsigned char* yuyv, unsigned char* rgb, size_t n_pixels, RgbLayout layout)
+{
+    const unsigned int pixel_size = PixelSize(layout);
+    const __m256i low_byte = _mm256_set1_epi16(0x00ff);
+    const __m256i chroma_offset = _mm256_set1_epi16(128);
+    const __m256i r_v = _mm256_set1_epi16(R_V);
+    const __m256i g_u = _mm256_set1_epi16(G_U);
+    const __m256i g_v = _mm256_set1_epi16(G_V);
+    const __m256i b_u = _mm256_set1_epi16(B_U);
+
+    const size_t simd_pixels = SimdPixels(n_pixels, 16);
+    for (size_t i = 0; i < simd_pixels; i += 16)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(yuyv + 2 * i));
+        const __m256i y = _mm256_slli_epi16(_mm256_and_si256(pixels, low_byte), FRACTION_BITS);
+        const __m256i uv = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_srli_epi16(pixels, 8), chroma_offset),
+                                             FRACTION_BITS);
+        const __m256i du =
+            _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+        const __m256i dv =
+            _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+        const __m256i r_term = _mm256_add_epi16(dv, _mm256_mulhi_epi16(dv, r_v));
+        const __m256i g_term =
+            _mm256_sub_epi16(_mm256_add_epi16(_mm256_mulhi_epi16(du, g_u), dv), _mm256_mulhi_epi16(dv, g_v));
+        const __m256i b_term = _mm256_sub_epi16(_mm256_add_epi16(du, du), _mm256_mulhi_epi16(du, b_u));
+
+        const __m256i r = _mm256_srai_epi16(_mm256_adds_epi16(y, r_term), FRACTION_BITS);
+        const __m256i g = _mm256_srai_epi16(_mm256_subs_epi16(y, g_term), FRACTION_BITS);
+        const __m256i b = _mm256_srai_epi16(_mm256_adds_epi16(y, b_term), FRACTION_BITS);
+
+        StorePixelsSse2(_mm256_castsi256_si128(r), _mm256_castsi256_si128(g), _mm256_castsi256_si128(b),
+                        rgb + pixel_size * i, layout);
+        StorePixelsSse2(_mm256_extracti128_si256(r, 1), _mm256_extracti128_si256(g, 1),
+                        _mm256_extracti128_si256(b, 1), rgb + pixel_size * (i + 8), layout);
+    }
+
+    YuyvToRgbScalar(yuyv + 2 * simd_pixels, rgb + pixel_size * simd_pixels, n_pixels - simd_pixels, layout);
+}
+
+static bool CpuSupportsSse2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool CpuSupportsSsse3()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+static bool CpuSupportsAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool os_xsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!os_xsave || !avx)
+    {
+        return false;
+    }
+    // make sure the os saves the ymm registers
+    if ((_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // RSID_CAPTURE_X86_KERNELS
+
+#ifdef RSID_CAPTURE_NEON_KERNELS
+
+static inline int16x8_t MulHiNeon(int16x8_t x, int16_t k)
+{
+    const int32x4_t low = vmull_s16(vget_low_s16(x), vdup_n_s16(k));
+    const int32x4_t high = vmull_s16(vget_high_s16(x), vdup_n_s16(k));
+    return vcombine_s16(vshrn_n_s32(low, 16), vshrn_n_s32(high, 16));
+}
+
+static inline int16x8_t Widen(uint8x8_t x)
+{
+    return vreinterpretq_s16_u16(vmovl_u8(x));
+}
+
+// 16 pixels per iteration. vld4 splits them into even y, u, odd y and v, so the chroma terms are computed once per
+// pixel pair. vst3/vst4 interleave the output.
+void YuyvToRgbNeon(const unsigned char* yuyv, unsigned char* rgb, size_t n_pixels, RgbLayout layout)
+{
+    const unsigned int pixel_size = PixelSize(layout);
+    const int16x8_t chroma_offset = vdupq_n_s16(128);
+    const size_t simd_pixels = (n_pixels / 16) * 16;
+    for (size_t i = 0; i < simd_pixels; i += 16)
+    {
+        const uint8x8x4_t pixels = vld4_u8(yuyv + 2 * i);
+        const int16x8_t du = vshlq_n_s16(vsubq_s16(Widen(pixels.val[1]), chroma_offset), FRACTION_BITS);
+        const int16x8_t dv = vshlq_n_s16(vsubq_s16(Widen(pixels.val[3]), chroma_offset), FRACTION_BITS);
+
+        const int16x8_t r_term = vaddq_s16(dv, MulHiNeon(dv, R_V));
+        const int16x8_t g_term = vsubq_s16(vaddq_s16(MulHiNeon(du, G_U), dv), MulHiNeon(dv, G_V));
+        const int16x8_t b_term = vsubq_s16(vaddq_s16(du, du), MulHiNeon(du, B_U));
+
+        uint8x8_t r[2], g[2], b[2];
+        for (int j = 0; j < 2; j++)
+        {
+            const int16x8_t y = vshlq_n_s16(Widen(pixels.val[2 * j]), FRACTION_BITS);
+            r[j] = vqmovun_s16(vshrq_n_s16(vqaddq_s16(y, r_term), FRACTION_BITS));
+            g[j] = vqmovun_s16(vshrq_n_s16(vqsubq_s16(y, g_term), FRACTION_BITS));
+            b[j] = vqmovun_s16(vshrq_n_s16(vqaddq_s16(y, b_term), FRACTION_BITS));
+        }
+
+        // even and odd pixels back in order
+        const uint8x8x2_t r_zip = vzip_u8(r[0], r[1]);
+        const uint8x8x2_t g_zip = vzip_u8(g[0], g[1]);
+        const uint8x8x2_t b_zip = vzip_u8(b[0], b[1]);
+        const int r_pos = layout == RgbLayout::Bgra ? 2 : 0;
+        if (pixel_size == 4)
+        {
+            uint8x16x4_t out;
+            out.val[r_pos] = vcombine_u8(r_zip.val[0], r_zip.val[1]);
+            out.val[1] = vcombine_u8(g_zip.val[0], g_zip.val[1]);
+            out.val[2 - r_pos] = vcombine_u8(b_zip.val[0], b_zip.val[1]);
+            out.val[3] = vdupq_n_u8(255);
+            vst4q_u8(rgb + pixel_size * i, out);
+        }
+        else
+        {
+            uint8x16x3_t out;
+            out.val[0] = vcombine_u8(r_zip.val[0], r_zip.val[1]);
+            out.val[1] = vcombine_u8(g_zip.val[0], g_zip.val[1]);
+            out.val[2] = vcombine_u8(b_zip.val[0], b_zip.val[1]);
+            vst3q_u8(rgb + pixel_size * i, out);
+        }
+    }
+
+    YuyvToRgbScalar(yuyv + 2 * simd_pixels, rgb + pixel_size * simd_pixels, n_pixels - simd_pixels, layout);
+}
+
+#endif // RSID_CAPTURE_NEON_KERNELS
+
+struct SelectedKernel
+{
+    yuyv_to_rgb_func convert_func;
+    const char* name;
+};
+
+static SelectedKernel SelectKernel()
+{
+#ifdef RSID_CAPTURE_X86_KERNELS
+    if (CpuSupportsAvx2())
+    {
+        return {YuyvToRgbAvx2, "avx2"};
+    }
+    if (CpuSupportsSse2())
+    {
+        return {YuyvToRgbSse2, "sse2"};
+    }
+#endif // RSID_CAPTURE_X86_KERNELS
+
+#ifdef RSID_CAPTURE_NEON_KERNELS
+    return {YuyvToRgbNeon, "neon"};
+#else
+    return {YuyvToRgbScalar, "scalar"};
+#endif // RSID_CAPTURE_NEON_KERNELS
+}
+
+void YuyvToNv12(const unsigned char* yuyv, unsigned char* nv12, unsigned int width, unsigned int height)
+{
+    const size_t row_size = 2 * static_cast<size_t>(width);
+    unsigned char* y_plane = nv12;
+    unsigned char* uv_plane = nv12 + static_cast<size_t>(width) * height;
+    for (unsigned int row = 0; row < height; row += 2)
+    {
+        const unsigned char* src0 = yuyv + row * row_size;
+        const unsigned char* src1 = src0 + row_size;
+        for (size_t i = 0; i < row_size; i += 2)
+        {
+            y_plane[i / 2] = src0[i];
+            y_plane[width + i / 2] = src1[i];
+            uv_plane[i / 2] = static_cast<unsigned char>((src0[i + 1] + src1[i + 1] + 1) >> 1);
+        }
+        y_plane += 2 * static_cast<size_t>(width);
+        uv_plane += width;
+    }
+}
+
+void Raw10ToRaw8Scalar(const unsigned char* raw10, unsigned char* raw8, size_t n_pixels)
+{
+    for (size_t i = 0; i < n_pixels; i += 4, raw10 += 5)
+    {
+        raw8[i] = raw10[0];
+        raw8[i + 1] = raw10[1];
+        raw8[i + 2] = raw10[2];
+        raw8[i + 3] = raw10[3];
+    }
+}
+
+// simd kernels unpack 3 groups (15 bytes) to 12 pixels per step, reading 16 bytes and writing 16 (the 4 extra are
+// overwritten by the next step). the last 16 pixels or less are left to the scalar tail to stay within the buffers.
+#ifdef RSID_CAPTURE_X86_KERNELS
+RSID_TARGET("ssse3")
+void Raw10ToRaw8Ssse3(const unsigned char* raw10, unsigned char* raw8, size_t n_pixels)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 3, 5, 6, 7, 8, 10, 11, 12, 13, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 16 <= n_pixels; i += 12)
+    {
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw10 + i / 4 * 5));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(raw8 + i), _mm_shuffle_epi8(packed, shuffle));
+    }
+    Raw10ToRaw8Scalar(raw10 + i / 4 * 5, raw8 + i, n_pixels - i);
+}
+#endif // RSID_CAPTURE_X86_KERNELS
+
+#if defined(RSID_CAPTURE_NEON_KERNELS) && defined(__aarch64__)
+void Raw10ToRaw8Neon(const unsigned char* raw10, unsigned char* raw8, size_t n_pixels)
+{
+    static const uint8_t shuffle_bytes[16] = {0, 1, 2, 3, 5, 6, 7, 8, 10, 11, 12, 13, 255, 255, 255, 255};
+    const uint8x16_t shuffle = vld1q_u8(shuffle_bytes);
+    size_t i = 0;
+    for (; i + 16 <= n_pixels; i += 12)
+    {
+        vst1q_u8(raw8 + i, vqtbl1q_u8(vld1q_u8(raw10 + i / 4 * 5), shuffle));
+    }
+    Raw10ToRaw8Scalar(raw10 + i / 4 * 5, raw8 + i, n_pixels - i);
+}
+#endif
+
+raw10_to_raw8_func GetRaw10ToRaw8()
+{
+    static const raw10_to_raw8_func selected = [] {
+#ifdef RSID_CAPTURE_X86_KERNELS
+        if (CpuSupportsSsse3())
+        {
+            LOG_DEBUG(LOG_TAG, "Using ssse3 raw10 unpack kernel");
+            return Raw10ToRaw8Ssse3;
+        }
+#elif defined(RSID_CAPTURE_NEON_KERNELS) && defined(__aarch64__)
+        LOG_DEBUG(LOG_TAG, "Using neon raw10 unpack kernel");
+        return Raw10ToRaw8Neon;
+#endif
+        LOG_DEBUG(LOG_TAG, "Using scalar raw10 unpack kernel");
+        return Raw10ToRaw8Scalar;
+    }();
+    return selected;
+}
+
+yuyv_to_rgb_func GetYuyvToRgb()
+{
+    static const SelectedKernel selected = [] {
+        auto kernel = SelectKernel();
+        LOG_DEBUG(LOG_TAG, "Using %s yuyv conversion kernel", kernel.name);
+        return kernel;
+    }();
+    return selected.convert_func;
+}
+
+std::vector<NamedKernel<yuyv_to_rgb_func>> SupportedYuyvToRgbKernels()
+{
+    std::vector<NamedKernel<yuyv_to_rgb_func>> kernels {{"scalar", YuyvToRgbScalar}};
+#ifdef RSID_CAPTURE_X86_KERNELS
+    if (CpuSupportsSse2())
+    {
+        kernels.push_back({"sse2", YuyvToRgbSse2});
+    }
+    if (CpuSupportsAvx2())
+    {
+        kernels.push_back({"avx2", YuyvToRgbAvx2});
+    }
+#endif // RSID_CAPTURE_X86_KERNELS
+#ifdef RSID_CAPTURE_NEON_KERNELS
+    kernels.push_back({"neon", YuyvToRgbNeon});
+#endif // RSID_CAPTURE_NEON_KERNELS
+    return kernels;
+}
+
+std::vector<NamedKernel<raw10_to_raw8_func>> SupportedRaw10ToRaw8Kernels()
+{
+    std::vector<NamedKernel<raw10_to_raw8_func>> kernels {{"scalar", Raw10ToRaw8Scalar}};
+#ifdef RSID_CAPTURE_X86_KERNELS
+    if (CpuSupportsSsse3())
+    {
+        kernels.push_back({"ssse3", Raw10ToRaw8Ssse3});
+    }
+#elif defined(RSID_CAPTURE_NEON_KERNELS) && defined(__aarch64__)
+    kernels.push_back({"neon", Raw10ToRaw8Neon});
+#endif
+    return kernels;
+}
+} // namespace YuvKernels
+} // namespace Capture
+} // namespace RealSenseID
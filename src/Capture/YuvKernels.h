@@ -0,0 +1,91 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Select which SIMD kernels can be compiled on this target (same rules as the matcher kernels).
+// x86 kernels are compiled with per-function target attributes (gcc/clang) or unconditionally (msvc) and are only
+// called if the cpu supports them. NEON kernels are compiled only if NEON is enabled for the target.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RSID_CAPTURE_X86_KERNELS
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RSID_CAPTURE_NEON_KERNELS
+#endif
+
+namespace RealSenseID
+{
+namespace Capture
+{
+namespace YuvKernels
+{
+// Output pixel layouts of the rgb conversion (alpha is 255)
+enum class RgbLayout
+{
+    Rgb,
+    Rgba,
+    Bgra
+};
+
+inline unsigned int PixelSize(RgbLayout layout)
+{
+    return layout == RgbLayout::Rgb ? 3 : 4;
+}
+
+// Convert n_pixels (even) YUYV pixels to the given rgb layout.
+// Fixed-point BT.601 as previously done in double precision:
+//   r = y + 1.4065 * (v - 128), g = y - 0.3455 * (u - 128) - 0.7169 * (v - 128), b = y + 1.7790 * (u - 128)
+// computed in 16 bit with 7 fraction bits and saturating adds, truncated and clamped to [0, 255]. The result is
+// within 1 of the double precision one. All kernels must produce bit-identical results to YuyvToRgbScalar().
+using yuyv_to_rgb_func = void (*)(const unsigned char* yuyv, unsigned char* rgb, size_t n_pixels, RgbLayout layout);
+
+// Reference implementation
+void YuyvToRgbScalar(const unsigned char* yuyv, unsigned char* rgb, size_t n_pixels, RgbLayout layout);
+
+#ifdef RSID_CAPTURE_X86_KERNELS
+void YuyvToRgbSse2(const unsigned char* yuyv, unsigned char* rgb, size_t n_pixels, RgbLayout layout);
+void YuyvToRgbAvx2(const unsigned char* yuyv, unsigned char* rgb, size_t n_pixels, RgbLayout layout);
+#endif // RSID_CAPTURE_X86_KERNELS
+
+#ifdef RSID_CAPTURE_NEON_KERNELS
+void YuyvToRgbNeon(const unsigned char* yuyv, unsigned char* rgb, size_t n_pixels, RgbLayout layout);
+#endif // RSID_CAPTURE_NEON_KERNELS
+
+// Best kernel for the running cpu (selected once).
+yuyv_to_rgb_func GetYuyvToRgb();
+
+// Convert a width x height (both even) YUYV image to NV12: the Y plane followed by the interleaved UV plane of half the
+// height, chroma of each two rows averaged (rounded).
+void YuyvToNv12(const unsigned char* yuyv, unsigned char* nv12, unsigned int width, unsigned int height);
+
+// Unpack n_pixels (multiple of 4) RAW10 pixels to their 8 msbs. RAW10 packs 4 pixels in 5 bytes: the 8 msbs of each
+// pixel followed by a byte of their 2 lsbs.
+using raw10_to_raw8_func = void (*)(const unsigned char* raw10, unsigned char* raw8, size_t n_pixels);
+
+void Raw10ToRaw8Scalar(const unsigned char* raw10, unsigned char* raw8, size_t n_pixels);
+
+#ifdef RSID_CAPTURE_X86_KERNELS
+void Raw10ToRaw8Ssse3(const unsigned char* raw10, unsigned char* raw8, size_t n_pixels);
+#endif // RSID_CAPTURE_X86_KERNELS
+
+#if defined(RSID_CAPTURE_NEON_KERNELS) && defined(__aarch64__)
+void Raw10ToRaw8Neon(const unsigned char* raw10, unsigned char* raw8, size_t n_pixels);
+#endif
+
+// Best kernel for the running cpu (selected once).
+raw10_to_raw8_func GetRaw10ToRaw8();
+
+// Kernels of this build the running cpu supports, the scalar reference first (for checks and benchmarks of all ISAs)
+template <typename Func>
+struct NamedKernel
+{
+    const char* isa;
+    Func func;
+};
+std::vector<NamedKernel<yuyv_to_rgb_func>> SupportedYuyvToRgbKernels();
+std::vector<NamedKernel<raw10_to_raw8_func>> SupportedRaw10ToRaw8Kernels();
+} // namespace YuvKernels
+} // namespace Capture
+} // namespace RealSenseID
@@ -0,0 +1,160 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "ClockSync.h"
+#include <algorithm>
+#include <chrono>
+
+namespace RealSenseID
+{
+// exchanges with a round trip up to the shortest one plus the larger of these are fitted
+static const uint64_t RTT_SLACK_US = 100;
+static const uint64_t RTT_SLACK_RATIO = 2; // of the shortest round trip (half of it)
+
+// the drift is estimated once the fitted exchanges span this long
+static const uint64_t MIN_DRIFT_SPAN_US = 1000000;
+
+void ClockSync::AddExchange(uint64_t host_send, uint64_t device_receive, uint64_t device_send, uint64_t host_receive)
+{
+    if (host_receive < host_send || device_send < device_receive)
+    {
+        return;
+    }
+    Exchange exchange;
+    auto device_time = device_send - device_receive;
+    auto round_trip = host_receive - host_send;
+    exchange.rtt = round_trip > device_time ? round_trip - device_time : 0;
+    exchange.host_mid = host_send + round_trip / 2;
+    auto device_mid = device_receive + device_time / 2;
+    exchange.offset = static_cast<int64_t>(device_mid - exchange.host_mid);
+
+    std::lock_guard<std::mutex> lock {_mutex};
+    _exchanges.push_back(exchange);
+    if (_exchanges.size() > Window)
+    {
+        _exchanges.pop_front();
+    }
+    Estimate();
+}
+
+void ClockSync::Reset()
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    _exchanges.clear();
+    _state = ClockSyncState {};
+}
+
+ClockSyncState ClockSync::State() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _state;
+}
+
+void ClockSync::Estimate()
+{
+    uint64_t min_rtt = _exchanges.front().rtt;
+    for (const auto& exchange : _exchanges)
+    {
+        min_rtt = std::min(min_rtt, exchange.rtt);
+    }
+    const uint64_t max_rtt = min_rtt + std::max(RTT_SLACK_US, min_rtt / RTT_SLACK_RATIO);
+
+    // least squares line of the offsets over the host times, relative to the first exchange (for the precision)
+    const uint64_t origin = _exchanges.front().host_mid;
+    const int64_t offset_origin = _exchanges.front().offset;
+    double sum_x = 0, sum_y = 0;
+    size_t n = 0;
+    uint64_t first = UINT64_MAX, last = 0;
+    for (const auto& exchange : _exchanges)
+    {
+        if (exchange.rtt > max_rtt)
+        {
+            continue;
+        }
+        sum_x += static_cast<double>(exchange.host_mid - origin);
+        sum_y += static_cast<double>(exchange.offset - offset_origin);
+        first = std::min(first, exchange.host_mid);
+        last = std::max(last, exchange.host_mid);
+        n++;
+    }
+    const double mean_x = sum_x / n, mean_y = sum_y / n;
+    double slope = 0;
+    if (last - first >= MIN_DRIFT_SPAN_US)
+    {
+        double sum_xy = 0, sum_xx = 0;
+        for (const auto& exchange : _exchanges)
+        {
+            if (exchange.rtt > max_rtt)
+            {
+                continue;
+            }
+            auto dx = static_cast<double>(exchange.host_mid - origin) - mean_x;
+            auto dy = static_cast<double>(exchange.offset - offset_origin) - mean_y;
+            sum_xy += dx * dy;
+            sum_xx += dx * dx;
+        }
+        slope = sum_xx > 0 ? sum_xy / sum_xx : 0;
+    }
+
+    _state.synced = true;
+    _state.referenceUs = origin + static_cast<uint64_t>(mean_x);
+    _state.offsetUs = offset_origin + static_cast<int64_t>(mean_y);
+    _state.driftPpm = slope * 1e6;
+    _state.rttUs = static_cast<unsigned int>(std::min<uint64_t>(min_rtt, UINT32_MAX));
+    _state.exchanges = static_cast<unsigned int>(_exchanges.size());
+}
+
+int64_t ClockSync::OffsetAt(uint64_t host_us) const
+{
+    auto elapsed = static_cast<double>(static_cast<int64_t>(host_us - _state.referenceUs));
+    return _state.offsetUs + static_cast<int64_t>(_state.driftPpm * elapsed / 1e6);
+}
+
+bool ClockSync::DeviceToHost(uint64_t device_us, uint64_t& host_us) const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (!_state.synced)
+    {
+        return false;
+    }
+    // the offset at the host time of the device time, from the one at its first estimate (the drift is tiny)
+    auto estimate = device_us - _state.offsetUs;
+    host_us = device_us - OffsetAt(estimate);
+    return true;
+}
+
+bool ClockSync::HostToDevice(uint64_t host_us, uint64_t& device_us) const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (!_state.synced)
+    {
+        return false;
+    }
+    device_us = host_us + OffsetAt(host_us);
+    return true;
+}
+
+bool ClockSync::DeviceToHost32(uint32_t device_us, uint64_t& host_us) const
+{
+    uint64_t device_now = 0;
+    if (!HostToDevice(HostNowUs(), device_now))
+    {
+        return false;
+    }
+    auto behind = static_cast<uint32_t>(static_cast<uint32_t>(device_now) - device_us);
+    auto device_full = device_now >= behind ? device_now - behind : device_us;
+    return DeviceToHost(device_full, host_us);
+}
+
+ClockSync& ClockSync::Shared()
+{
+    static ClockSync shared;
+    return shared;
+}
+
+uint64_t ClockSync::HostNowUs()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+} // namespace RealSenseID
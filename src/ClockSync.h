@@ -0,0 +1,55 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/ClockSync.h"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace RealSenseID
+{
+// Host/device clock offset and drift estimate (see ClockSyncState), from ping exchanges stamped on both sides.
+// Each exchange gives the offset at the host time of its midpoint, within half its round trip less the device's
+// processing. The exchanges of the window with a round trip close to the shortest one (the least queued) are fitted
+// with a line, whose slope is the drift.
+class ClockSync
+{
+public:
+    static constexpr size_t Window = 64;
+
+    // host times are of the steady clock, device times of the device clock (microseconds)
+    void AddExchange(uint64_t host_send, uint64_t device_receive, uint64_t device_send, uint64_t host_receive);
+    void Reset();
+    ClockSyncState State() const;
+
+    // false if not synced
+    bool DeviceToHost(uint64_t device_us, uint64_t& host_us) const;
+    bool HostToDevice(uint64_t host_us, uint64_t& device_us) const;
+    // host time of a device timestamp truncated to 32 bits (e.g. ImageMetadata::timestamp), taken as the latest one
+    // at or before the device's current time (wraps every ~71 minutes)
+    bool DeviceToHost32(uint32_t device_us, uint64_t& host_us) const;
+
+    // estimate of the device synced last (FaceAuthenticator::SyncClock()), for the timestamps of the preview images
+    static ClockSync& Shared();
+
+    // microseconds of the host's steady clock
+    static uint64_t HostNowUs();
+
+private:
+    struct Exchange
+    {
+        uint64_t host_mid;
+        int64_t offset;
+        uint64_t rtt;
+    };
+
+    mutable std::mutex _mutex;
+    std::deque<Exchange> _exchanges;
+    ClockSyncState _state;
+
+    void Estimate(); // with _mutex held
+    int64_t OffsetAt(uint64_t host_us) const;
+};
+} // namespace RealSenseID
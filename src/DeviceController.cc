@@ -57,4 +57,9 @@ Status DeviceController::Ping()
 {
     return _impl->Ping();
 }
+
+Status DeviceController::TuneBaudrate(const SerialConfig& config, unsigned int& selected_baudrate)
+{
+    return _impl->TuneBaudrate(config, selected_baudrate);
+}
 } // namespace RealSenseID
\ No newline at end of file
@@ -4,11 +4,17 @@
 #include "DeviceControllerImpl.h"
 #include "StatusHelper.h"
 #include "PacketManager/SerialPacket.h"
+#include "PacketManager/SerialFactory.h"
+#include "PacketManager/TcpSerial.h"
 #include "PacketManager/PacketSender.h"
 #include "PacketManager/Randomizer.h"
+#include "PacketManager/Timer.h"
 #include "Logger.h"
 #include <sstream>
 #include <regex>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
 
 #ifdef _WIN32
 #include "PacketManager/WindowsSerial.h"
@@ -22,8 +28,61 @@
 
 static const char* LOG_TAG = "DeviceControllerImpl";
 
+static const int TUNE_PINGS = 3;
+
 namespace RealSenseID
 {
+// console replies (bspver) are at most this long, and end if the device is idle for this long without the end line
+static const size_t CONSOLE_REPLY_MAX_SIZE = 512;
+static const PacketManager::timeout_t CONSOLE_IDLE_TIMEOUT {200};
+
+// receive the reply of a console command to the reply string, reading whatever arrives in chunks.
+// the device ends the reply with the "<command> end" line. the reply is also complete once a line with done_line
+// arrived (if not null), or the device was idle for CONSOLE_IDLE_TIMEOUT (firmware without the end line).
+// bytes received after the end stay buffered, packet readers skip them when looking for the sync bytes.
+static PacketManager::SerialStatus RecvConsoleReply(PacketManager::SerialConnection& serial, const char* command,
+                                                    const char* done_line, std::string& reply)
+{
+    using namespace PacketManager;
+    const std::string end_line = std::string {command} + " end";
+    auto& recv_buffer = serial.GetReceiveBuffer();
+    reply.clear();
+
+    // complete lines are scanned once, from the start of the first unscanned line
+    size_t line_begin = 0;
+    while (reply.size() < CONSOLE_REPLY_MAX_SIZE)
+    {
+        Timer idle_timer {CONSOLE_IDLE_TIMEOUT};
+        auto status = recv_buffer.Fill(1, idle_timer);
+        if (status == SerialStatus::RecvTimeout)
+        {
+            LOG_DEBUG(LOG_TAG, "No \"%s\" in console reply, ended on idle timeout", end_line.c_str());
+            return SerialStatus::Ok;
+        }
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+
+        const size_t n_bytes = std::min(recv_buffer.Size(), CONSOLE_REPLY_MAX_SIZE - reply.size());
+        reply.append(recv_buffer.Data(), n_bytes);
+        recv_buffer.Consume(n_bytes);
+
+        size_t line_end;
+        while ((line_end = reply.find('\n', line_begin)) != std::string::npos)
+        {
+            const std::string line = reply.substr(line_begin, line_end - line_begin);
+            if (line.find(end_line) != std::string::npos ||
+                (done_line != nullptr && line.find(done_line) != std::string::npos))
+            {
+                return SerialStatus::Ok;
+            }
+            line_begin = line_end + 1;
+        }
+    }
+    return SerialStatus::Ok;
+}
+
 Status DeviceControllerImpl::Connect(const SerialConfig& config)
 {
     try
@@ -32,15 +91,9 @@ Status DeviceControllerImpl::Connect(const SerialConfig& config)
         _serial.reset();
         PacketManager::SerialConfig serial_config;
         serial_config.port = config.port;
+        serial_config.baudrate = config.baudrate;
 
-#ifdef _WIN32
-        _serial = std::make_unique<PacketManager::WindowsSerial>(serial_config);
-#elif LINUX
-        _serial = std::make_unique<PacketManager::LinuxSerial>(serial_config);
-#else
-        LOG_ERROR(LOG_TAG, "Serial connection method not supported for OS");
-        return Status::Error;
-#endif //_WIN32
+        _serial = PacketManager::OpenSerialConnection(serial_config);
         return Status::Ok;
     }
     catch (const std::exception& ex)
@@ -117,26 +170,15 @@ Status DeviceControllerImpl::QueryFirmwareVersion(std::string& version)
             }
         }
 
-        // receive data until no more is available
-        constexpr size_t max_buffer_size = 512;
-        char buffer[max_buffer_size] = {0};
-        for (int i = 0; i < max_buffer_size - 1; ++i)
+        std::string reply;
+        auto status = RecvConsoleReply(*_serial, "bspver", nullptr, reply);
+        if (status != PacketManager::SerialStatus::Ok)
         {
-            auto status = _serial->RecvBytes(&buffer[i], 1);
-
-            // timeout is legal for the final byte, because we do not know the expected data size
-            if (status == PacketManager::SerialStatus::RecvTimeout)
-                break;
-
-            // other error are still not accepted
-            if (status != PacketManager::SerialStatus::Ok)
-            {
-                LOG_ERROR(LOG_TAG, "Failed reading version data");
-                return ToStatus(status);
-            }
+            LOG_ERROR(LOG_TAG, "Failed reading version data");
+            return ToStatus(status);
         }
 
-        std::stringstream ss(buffer);
+        std::stringstream ss(reply);
         std::string line;
         while (std::getline(ss, line, '\n'))
         {
@@ -193,26 +235,15 @@ Status DeviceControllerImpl::QuerySerialNumber(std::string& serial)
             return ToStatus(status);
         }
 
-        // receive data until no more is available
-        constexpr size_t max_buffer_size = 512;
-        char buffer[max_buffer_size] = {0};
-        for (int i = 0; i < max_buffer_size - 1; ++i)
+        std::string reply;
+        status = RecvConsoleReply(*_serial, "bspver", "SN : [", reply);
+        if (status != PacketManager::SerialStatus::Ok)
         {
-            auto status = _serial->RecvBytes(&buffer[i], 1);
-
-            // timeout is legal for the final byte, because we do not know the expected data size
-            if (status == PacketManager::SerialStatus::RecvTimeout)
-                break;
-
-            // other error are still not accepted
-            if (status != PacketManager::SerialStatus::Ok)
-            {
-                LOG_ERROR(LOG_TAG, "Failed reading serial number data");
-                return ToStatus(status);
-            }
+            LOG_ERROR(LOG_TAG, "Failed reading serial number data");
+            return ToStatus(status);
         }
 
-        std::stringstream ss(buffer);
+        std::stringstream ss(reply);
         std::string line;
         while (std::getline(ss, line, '\n'))
         {
@@ -293,4 +324,71 @@ Status DeviceControllerImpl::Ping()
     }
     return Status::Ok;
 }
+
+Status DeviceControllerImpl::TuneBaudrate(const SerialConfig& config, unsigned int& selected_baudrate)
+{
+    using clock = std::chrono::steady_clock;
+    selected_baudrate = 0;
+    double best_throughput = 0;
+
+    if (PacketManager::TcpSerial::IsTcpPort(config.port))
+    {
+        // the baud rate is the proxy's
+        selected_baudrate = config.baudrate;
+        return Connect(config);
+    }
+
+    for (auto baudrate : PacketManager::SupportedBaudrates)
+    {
+        SerialConfig candidate_config = config;
+        candidate_config.baudrate = baudrate;
+        if (Connect(candidate_config) != Status::Ok)
+        {
+            LOG_DEBUG(LOG_TAG, "Baudrate %u not supported", baudrate);
+            continue;
+        }
+
+        // each ping sends and receives a full size packet
+        auto start_time = clock::now();
+        bool is_ok = true;
+        for (int i = 0; i < TUNE_PINGS && is_ok; i++)
+        {
+            is_ok = Ping() == Status::Ok;
+        }
+        if (!is_ok)
+        {
+            LOG_DEBUG(LOG_TAG, "Baudrate %u: no valid ping reply", baudrate);
+            continue;
+        }
+        std::chrono::duration<double> elapsed = clock::now() - start_time;
+        double throughput = TUNE_PINGS * 2.0 * sizeof(PacketManager::SerialPacket) / elapsed.count();
+        LOG_DEBUG(LOG_TAG, "Baudrate %u: %.0f bytes/sec", baudrate, throughput);
+
+        if (throughput > best_throughput)
+        {
+            best_throughput = throughput;
+            selected_baudrate = baudrate;
+        }
+        else
+        {
+            // slower than a higher rate, the link is not bound by the baud rate (e.g. usb-cdc)
+            break;
+        }
+    }
+
+    SerialConfig selected_config = config;
+    if (selected_baudrate != 0)
+    {
+        selected_config.baudrate = selected_baudrate;
+    }
+    auto status = Connect(selected_config);
+    if (selected_baudrate == 0)
+    {
+        LOG_ERROR(LOG_TAG, "No working baudrate found, fallback to %u", config.baudrate);
+        selected_baudrate = config.baudrate;
+        return Status::Error;
+    }
+    LOG_INFO(LOG_TAG, "Selected baudrate %u (%.0f bytes/sec)", selected_baudrate, best_throughput);
+    return status;
+}
 } // namespace RealSenseID
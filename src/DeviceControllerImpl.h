@@ -30,6 +30,7 @@ public:
     Status QueryFirmwareVersion(std::string& version);
     Status QuerySerialNumber(std::string& serial);
     Status Ping();
+    Status TuneBaudrate(const SerialConfig& config, unsigned int& selected_baudrate);
 
 private:
     std::unique_ptr<PacketManager::SerialConnection> _serial;
@@ -0,0 +1,95 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/DeviceManager.h"
+#include "DeviceManagerImpl.h"
+
+namespace RealSenseID
+{
+#ifdef RSID_SECURE
+DeviceManager::DeviceManager(SignatureCallback* callback, unsigned int workers) :
+    _impl {new DeviceManagerImpl(callback, workers)}
+{
+}
+#else
+DeviceManager::DeviceManager(unsigned int workers) : _impl {new DeviceManagerImpl(nullptr, workers)}
+{
+}
+#endif
+
+DeviceManager::~DeviceManager()
+{
+    try
+    {
+        delete _impl;
+    }
+    catch (...)
+    {
+    }
+}
+
+Status DeviceManager::Connect(const std::vector<SerialConfig>& configs)
+{
+    return _impl->Connect(configs);
+}
+
+Status DeviceManager::ConnectDiscovered(unsigned int baudrate)
+{
+    return _impl->ConnectDiscovered(baudrate);
+}
+
+void DeviceManager::Disconnect()
+{
+    _impl->Disconnect();
+}
+
+std::size_t DeviceManager::DeviceCount() const
+{
+    return _impl->DeviceCount();
+}
+
+Status DeviceManager::DeviceStatus(std::size_t device_index) const
+{
+    return _impl->DeviceStatus(device_index);
+}
+
+Status DeviceManager::Submit(std::size_t device_index, Operation operation, Priority priority)
+{
+    return _impl->Submit(device_index, std::move(operation), priority);
+}
+
+Status DeviceManager::SubmitSteps(std::size_t device_index, Step step, Priority priority)
+{
+    return _impl->SubmitSteps(device_index, std::move(step), priority);
+}
+
+std::size_t DeviceManager::SubmitAll(const Operation& operation, Priority priority)
+{
+    return _impl->SubmitAll(operation, priority);
+}
+
+void DeviceManager::WaitIdle()
+{
+    _impl->WaitIdle();
+}
+
+Status DeviceManager::Cancel(std::size_t device_index)
+{
+    return _impl->Cancel(device_index);
+}
+
+void DeviceManager::CancelAll()
+{
+    _impl->CancelAll();
+}
+
+void DeviceManager::SetLinkMonitor(const LinkMonitorConfig& config)
+{
+    _impl->SetLinkMonitor(config);
+}
+
+Status DeviceManager::GetLinkQuality(std::size_t device_index, LinkQuality& quality) const
+{
+    return _impl->GetLinkQuality(device_index, quality);
+}
+} // namespace RealSenseID
@@ -0,0 +1,562 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "DeviceManagerImpl.h"
+#include "ThreadConfigImpl.h"
+#include "MetricsRecorder.h"
+#include "PacketManager/CommonTypes.h"
+#include "RealSenseID/DiscoverDevices.h"
+#include "Logger.h"
+#include <algorithm>
+#include <exception>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "DeviceManager";
+
+static std::chrono::milliseconds MinInterval(const LinkMonitorConfig& config)
+{
+    return std::chrono::milliseconds {std::max(config.minIntervalMs, 1u)};
+}
+
+// tcp:// and emulator:// ports have no baud rate
+static bool IsSerialPort(const std::string& port)
+{
+    return port.find("://") == std::string::npos;
+}
+
+// next supported baud rate below the given one, 0 if none
+static unsigned int LowerBaudrate(unsigned int baudrate)
+{
+    for (auto supported : PacketManager::SupportedBaudrates)
+    {
+        if (supported < baudrate)
+        {
+            return supported;
+        }
+    }
+    return 0;
+}
+
+DeviceManagerImpl::DeviceManagerImpl(SignatureCallback* callback, unsigned int workers) :
+    _signature_callback {callback}
+{
+    workers = std::max(workers, 1u);
+    for (unsigned int i = 0; i < workers; i++)
+    {
+        _workers.emplace_back(&DeviceManagerImpl::WorkerLoop, this);
+    }
+}
+
+DeviceManagerImpl::~DeviceManagerImpl()
+{
+    try
+    {
+        DisconnectAll();
+    }
+    catch (...)
+    {
+    }
+
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _stop = true;
+    }
+    _monitor_cv.notify_all();
+    if (_monitor.joinable())
+    {
+        _monitor.join();
+    }
+    _work_cv.notify_all();
+    for (auto& worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+Status DeviceManagerImpl::Connect(const std::vector<SerialConfig>& configs)
+{
+    DisconnectAll();
+
+    for (std::size_t i = 0; i < configs.size(); i++)
+    {
+        std::unique_ptr<Device> device {new Device()};
+        device->index = i;
+        device->port = configs[i].port != nullptr ? configs[i].port : "";
+        device->config = configs[i];
+        device->config.port = device->port.c_str();
+#ifdef RSID_SECURE
+        device->authenticator.reset(new FaceAuthenticator(_signature_callback));
+#else
+        device->authenticator.reset(new FaceAuthenticator());
+#endif
+        std::lock_guard<std::mutex> lock {_mutex};
+        _devices.push_back(std::move(device));
+    }
+
+    // connect concurrently on the workers
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        for (auto& device : _devices)
+        {
+            Device* target = device.get();
+            Enqueue(*target, [this, target](FaceAuthenticator& authenticator, std::size_t) {
+                auto status = authenticator.Connect(target->config);
+                std::lock_guard<std::mutex> status_lock {_mutex};
+                target->status = status;
+            });
+        }
+    }
+    WaitIdle();
+
+    // the statuses are read before the link monitor starts, it reconnects the devices on the workers
+    auto result = Status::Ok;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        for (auto& device : _devices)
+        {
+            device->last_activity = clock::now();
+            device->link.interval = MinInterval(_link_config);
+            device->link.quality.baudrate = device->config.baudrate;
+            if (device->status != Status::Ok)
+            {
+                LOG_ERROR(LOG_TAG, "Failed connecting to device %zu on port %s (status %d)", device->index,
+                          device->port.c_str(), (int)device->status);
+                if (result == Status::Ok)
+                {
+                    result = device->status;
+                }
+            }
+        }
+        LOG_DEBUG(LOG_TAG, "Connected to %zu devices", _devices.size());
+        _connected = true;
+    }
+    _monitor_cv.notify_all();
+    return result;
+}
+
+Status DeviceManagerImpl::ConnectDiscovered(unsigned int baudrate)
+{
+    auto found = DiscoverDevices();
+    if (found.empty())
+    {
+        LOG_ERROR(LOG_TAG, "No devices found");
+        DisconnectAll();
+        return Status::Error;
+    }
+
+    std::vector<SerialConfig> configs(found.size());
+    for (std::size_t i = 0; i < found.size(); i++)
+    {
+        configs[i].port = found[i].serialPort;
+        configs[i].baudrate = baudrate;
+    }
+    return Connect(configs);
+}
+
+void DeviceManagerImpl::Disconnect()
+{
+    DisconnectAll();
+}
+
+std::size_t DeviceManagerImpl::DeviceCount() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _devices.size();
+}
+
+Status DeviceManagerImpl::DeviceStatus(std::size_t device_index) const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return device_index < _devices.size() ? _devices[device_index]->status : Status::Error;
+}
+
+Status DeviceManagerImpl::Submit(std::size_t device_index, DeviceManager::Operation operation, Priority priority)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (device_index >= _devices.size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid device index %zu", device_index);
+        return Status::Error;
+    }
+    auto& device = *_devices[device_index];
+    if (device.status != Status::Ok)
+    {
+        LOG_ERROR(LOG_TAG, "Device %zu is not connected", device_index);
+        return Status::Error;
+    }
+    Enqueue(device, std::move(operation), priority);
+    return Status::Ok;
+}
+
+Status DeviceManagerImpl::SubmitSteps(std::size_t device_index, DeviceManager::Step step, Priority priority)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (device_index >= _devices.size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid device index %zu", device_index);
+        return Status::Error;
+    }
+    auto& device = *_devices[device_index];
+    if (device.status != Status::Ok)
+    {
+        LOG_ERROR(LOG_TAG, "Device %zu is not connected", device_index);
+        return Status::Error;
+    }
+    EnqueueStep(device, std::make_shared<DeviceManager::Step>(std::move(step)), priority);
+    return Status::Ok;
+}
+
+std::size_t DeviceManagerImpl::SubmitAll(const DeviceManager::Operation& operation, Priority priority)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    std::size_t submitted = 0;
+    for (auto& device : _devices)
+    {
+        if (device->status == Status::Ok)
+        {
+            Enqueue(*device, operation, priority);
+            submitted++;
+        }
+    }
+    return submitted;
+}
+
+void DeviceManagerImpl::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    _idle_cv.wait(lock, [this] { return _queued == 0; });
+}
+
+Status DeviceManagerImpl::Cancel(std::size_t device_index)
+{
+    FaceAuthenticator* authenticator = nullptr;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (device_index >= _devices.size() || _devices[device_index]->status != Status::Ok)
+        {
+            return Status::Error;
+        }
+        authenticator = _devices[device_index]->authenticator.get();
+    }
+    return authenticator->Cancel();
+}
+
+void DeviceManagerImpl::CancelAll()
+{
+    std::vector<FaceAuthenticator*> connected;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        for (auto& device : _devices)
+        {
+            if (device->status == Status::Ok)
+            {
+                connected.push_back(device->authenticator.get());
+            }
+        }
+    }
+    for (auto* authenticator : connected)
+    {
+        authenticator->Cancel();
+    }
+}
+
+bool DeviceManagerImpl::Device::HasOperations() const
+{
+    for (const auto& queue : operations)
+    {
+        if (!queue.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+DeviceManager::Operation DeviceManagerImpl::Device::PopOperation()
+{
+    for (std::size_t i = PriorityCount; i-- > 0;)
+    {
+        auto& queue = operations[i];
+        if (!queue.empty())
+        {
+            auto operation = std::move(queue.front());
+            queue.pop_front();
+            return operation;
+        }
+    }
+    return nullptr;
+}
+
+void DeviceManagerImpl::Enqueue(Device& device, DeviceManager::Operation operation, Priority priority)
+{
+    device.operations[static_cast<std::size_t>(priority)].push_back(std::move(operation));
+    _queued++;
+    if (!device.scheduled)
+    {
+        device.scheduled = true;
+        _ready.push_back(&device);
+        _work_cv.notify_one();
+    }
+}
+
+// the next step is queued behind the operations submitted while the step ran
+void DeviceManagerImpl::EnqueueStep(Device& device, std::shared_ptr<DeviceManager::Step> step, Priority priority)
+{
+    Device* target = &device;
+    Enqueue(device,
+            [this, target, step, priority](FaceAuthenticator& authenticator, std::size_t device_index) {
+                if ((*step)(authenticator, device_index))
+                {
+                    std::lock_guard<std::mutex> lock {_mutex};
+                    EnqueueStep(*target, step, priority);
+                }
+            },
+            priority);
+}
+
+void DeviceManagerImpl::WorkerLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Async, "device-mgr");
+    std::unique_lock<std::mutex> lock {_mutex};
+    while (true)
+    {
+        _work_cv.wait(lock, [this] { return _stop || !_ready.empty(); });
+        if (_ready.empty())
+        {
+            return; // stopped
+        }
+
+        // run one operation of the device, then requeue it behind the other ready devices
+        Device* device = _ready.front();
+        _ready.pop_front();
+        auto operation = device->PopOperation();
+
+        lock.unlock();
+        try
+        {
+            operation(*device->authenticator, device->index);
+        }
+        catch (const std::exception& ex)
+        {
+            LOG_EXCEPTION(LOG_TAG, ex);
+        }
+        catch (...)
+        {
+            LOG_ERROR(LOG_TAG, "Unknown exception in operation of device %zu", device->index);
+        }
+        lock.lock();
+
+        device->last_activity = clock::now();
+        if (!device->HasOperations())
+        {
+            device->scheduled = false;
+        }
+        else
+        {
+            _ready.push_back(device);
+        }
+        if (--_queued == 0)
+        {
+            _idle_cv.notify_all();
+        }
+    }
+}
+
+void DeviceManagerImpl::DisconnectAll()
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _connected = false; // no more pings
+    }
+    WaitIdle();
+    std::vector<FaceAuthenticator*> connected;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        for (auto& device : _devices)
+        {
+            if (device->status == Status::Ok)
+            {
+                connected.push_back(device->authenticator.get());
+            }
+        }
+    }
+    for (auto* authenticator : connected)
+    {
+        authenticator->Disconnect();
+    }
+    std::lock_guard<std::mutex> lock {_mutex};
+    _devices.clear();
+}
+
+void DeviceManagerImpl::SetLinkMonitor(const LinkMonitorConfig& config)
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _link_config = config;
+        for (auto& device : _devices)
+        {
+            device->link.interval = MinInterval(config);
+        }
+        if (config.maxIntervalMs > 0 && !_monitor.joinable())
+        {
+            _monitor = std::thread {&DeviceManagerImpl::MonitorLoop, this};
+        }
+    }
+    _monitor_cv.notify_all();
+}
+
+Status DeviceManagerImpl::GetLinkQuality(std::size_t device_index, LinkQuality& quality) const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (device_index >= _devices.size())
+    {
+        return Status::Error;
+    }
+    const auto& link = _devices[device_index]->link;
+    quality = link.quality;
+    quality.rttP50Us = RttPercentile(link, 50);
+    quality.rttP90Us = RttPercentile(link, 90);
+    quality.intervalMs = static_cast<unsigned int>(link.interval.count());
+    return Status::Ok;
+}
+
+void DeviceManagerImpl::MonitorLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Async, "link-monitor");
+    std::unique_lock<std::mutex> lock {_mutex};
+    while (!_stop)
+    {
+        if (_link_config.maxIntervalMs == 0 || !_connected)
+        {
+            _monitor_cv.wait(lock);
+            continue;
+        }
+
+        // ping the idle devices that were inactive for their interval. the busy ones are looked at again after
+        // the min interval at the latest
+        const auto now = clock::now();
+        auto next_check = now + MinInterval(_link_config);
+        for (auto& device : _devices)
+        {
+            if (device->scheduled || (device->status != Status::Ok && !device->link.lost))
+            {
+                continue;
+            }
+            const auto due = device->last_activity + device->link.interval;
+            if (due > now)
+            {
+                next_check = std::min(next_check, due);
+                continue;
+            }
+            Device* target = device.get();
+            Enqueue(
+                *target,
+                [this, target](FaceAuthenticator& authenticator, std::size_t) { CheckLink(*target, authenticator); },
+                Priority::Low);
+        }
+        _monitor_cv.wait_until(lock, next_check);
+    }
+}
+
+void DeviceManagerImpl::CheckLink(Device& device, FaceAuthenticator& authenticator)
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    const auto config = _link_config;
+    auto& link = device.link;
+    if (link.lost)
+    {
+        const auto baudrate = device.config.baudrate;
+        lock.unlock();
+        ReconnectLink(device, authenticator, baudrate);
+        return;
+    }
+    lock.unlock();
+
+    const auto start = clock::now();
+    const auto status = authenticator.Ping(config.pingTimeoutMs);
+    const auto rtt = clock::now() - start;
+    const auto rtt_us = static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::microseconds>(rtt).count());
+    const auto slow_rtt_us = config.slowRttMs * 1000u;
+
+    lock.lock();
+    link.quality.pings++;
+    bool good = false;
+    if (status == Status::Ok)
+    {
+        Metrics::Record(Metrics::Latency::LinkPing, rtt);
+        link.rtt_us[link.next_rtt] = rtt_us;
+        link.next_rtt = (link.next_rtt + 1) % RttWindow;
+        link.rtt_count = std::min(link.rtt_count + 1, RttWindow);
+        link.failed_in_row = 0;
+        good = rtt_us <= slow_rtt_us;
+    }
+    else
+    {
+        Metrics::Add(Metrics::Counter::LinkPingFailures);
+        link.quality.failedPings++;
+        link.failed_in_row++;
+    }
+
+    const auto min_interval = MinInterval(config);
+    const auto max_interval = std::max(std::chrono::milliseconds {config.maxIntervalMs}, min_interval);
+    link.interval = good ? std::min(std::max(link.interval * 2, min_interval), max_interval) : min_interval;
+    if (link.interval == max_interval)
+    {
+        link.recovering = false; // healthy
+    }
+
+    const bool degraded = link.failed_in_row >= std::max(config.maxFailedPings, 1u) ||
+                          (link.rtt_count == RttWindow && RttPercentile(link, 90) > slow_rtt_us);
+    if (!degraded)
+    {
+        return;
+    }
+    // degraded again since the last reconnect: a lower baud rate may have fewer errors
+    auto baudrate = device.config.baudrate;
+    if (link.recovering && config.baudrateFallback && IsSerialPort(device.port) && LowerBaudrate(baudrate) != 0)
+    {
+        baudrate = LowerBaudrate(baudrate);
+    }
+    link.recovering = true;
+    link.failed_in_row = 0;
+    link.rtt_count = 0;
+    link.next_rtt = 0;
+    lock.unlock();
+    ReconnectLink(device, authenticator, baudrate);
+}
+
+void DeviceManagerImpl::ReconnectLink(Device& device, FaceAuthenticator& authenticator, unsigned int baudrate)
+{
+    LOG_WARNING(LOG_TAG, "Link of device %zu degraded, reconnecting at %u baud", device.index, baudrate);
+    Metrics::Add(Metrics::Counter::LinkReconnects);
+    authenticator.Disconnect();
+    SerialConfig config = device.config;
+    config.baudrate = baudrate;
+    auto status = authenticator.Connect(config);
+
+    std::lock_guard<std::mutex> lock {_mutex};
+    device.status = status;
+    device.link.lost = status != Status::Ok;
+    device.link.quality.reconnects++;
+    if (status != Status::Ok)
+    {
+        LOG_ERROR(LOG_TAG, "Failed reconnecting device %zu (status %d)", device.index, (int)status);
+        return;
+    }
+    device.config.baudrate = baudrate;
+    device.link.quality.baudrate = baudrate;
+}
+
+unsigned int DeviceManagerImpl::RttPercentile(const Link& link, unsigned int percent)
+{
+    if (link.rtt_count == 0)
+    {
+        return 0;
+    }
+    unsigned int sorted[RttWindow];
+    std::copy(link.rtt_us, link.rtt_us + link.rtt_count, sorted);
+    std::sort(sorted, sorted + link.rtt_count);
+    return sorted[(link.rtt_count - 1) * percent / 100];
+}
+} // namespace RealSenseID
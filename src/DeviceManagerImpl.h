@@ -0,0 +1,111 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/DeviceManager.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace RealSenseID
+{
+class DeviceManagerImpl
+{
+public:
+    DeviceManagerImpl(SignatureCallback* callback, unsigned int workers);
+    ~DeviceManagerImpl();
+
+    DeviceManagerImpl(const DeviceManagerImpl&) = delete;
+    DeviceManagerImpl& operator=(const DeviceManagerImpl&) = delete;
+
+    Status Connect(const std::vector<SerialConfig>& configs);
+    Status ConnectDiscovered(unsigned int baudrate);
+    void Disconnect();
+
+    std::size_t DeviceCount() const;
+    Status DeviceStatus(std::size_t device_index) const;
+
+    Status Submit(std::size_t device_index, DeviceManager::Operation operation, DeviceManager::Priority priority);
+    Status SubmitSteps(std::size_t device_index, DeviceManager::Step step, DeviceManager::Priority priority);
+    std::size_t SubmitAll(const DeviceManager::Operation& operation, DeviceManager::Priority priority);
+    void WaitIdle();
+    Status Cancel(std::size_t device_index);
+    void CancelAll();
+    void SetLinkMonitor(const LinkMonitorConfig& config);
+    Status GetLinkQuality(std::size_t device_index, LinkQuality& quality) const;
+
+private:
+    using clock = std::chrono::steady_clock;
+    using Priority = DeviceManager::Priority;
+
+    static constexpr std::size_t PriorityCount = static_cast<std::size_t>(Priority::High) + 1;
+
+    // round trips of the last good pings, for the percentiles
+    static constexpr std::size_t RttWindow = 16;
+
+    // link monitor state of a device
+    struct Link
+    {
+        LinkQuality quality;
+        std::chrono::milliseconds interval {0};
+        unsigned int failed_in_row = 0;
+        unsigned int rtt_us[RttWindow] = {};
+        std::size_t rtt_count = 0; // up to RttWindow
+        std::size_t next_rtt = 0;
+        bool recovering = false; // reconnected and not healthy since
+        bool lost = false;       // the reconnect failed, retried by the monitor
+    };
+
+    struct Device
+    {
+        std::size_t index = 0;
+        std::unique_ptr<FaceAuthenticator> authenticator;
+        std::string port; // owns the port string of config
+        SerialConfig config;
+        Status status = Status::Error;
+        std::deque<DeviceManager::Operation> operations[PriorityCount]; // queued per priority, not yet running
+        bool scheduled = false;          // in the ready queue or running on a worker
+        clock::time_point last_activity; // end of the last operation
+        Link link;
+
+        bool HasOperations() const;
+        DeviceManager::Operation PopOperation(); // of the highest priority
+    };
+
+    SignatureCallback* _signature_callback;
+    std::vector<std::unique_ptr<Device>> _devices;
+    std::vector<std::thread> _workers;
+
+    // guards the devices' queues, the ready queue and the counters
+    mutable std::mutex _mutex;
+    std::condition_variable _work_cv;
+    std::condition_variable _idle_cv;
+    std::deque<Device*> _ready; // devices with queued operations and no running one
+    std::size_t _queued = 0;    // operations queued or running
+    bool _stop = false;
+
+    // link monitor, started by the first SetLinkMonitor(). pings only while connected (not during Connect/Disconnect)
+    LinkMonitorConfig _link_config;
+    bool _connected = false;
+    std::thread _monitor;
+    std::condition_variable _monitor_cv;
+
+    // caller holds _mutex
+    void Enqueue(Device& device, DeviceManager::Operation operation, Priority priority = Priority::Normal);
+    void EnqueueStep(Device& device, std::shared_ptr<DeviceManager::Step> step, Priority priority);
+    void WorkerLoop();
+    void DisconnectAll();
+
+    void MonitorLoop();
+    void CheckLink(Device& device, FaceAuthenticator& authenticator); // operation of the monitor
+    void ReconnectLink(Device& device, FaceAuthenticator& authenticator, unsigned int baudrate);
+    static unsigned int RttPercentile(const Link& link, unsigned int percent);
+};
+} // namespace RealSenseID
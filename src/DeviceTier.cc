@@ -0,0 +1,149 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "DeviceTier.h"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+namespace RealSenseID
+{
+void DeviceTier::SetCapacity(size_t capacity)
+{
+    _capacity = capacity;
+}
+
+void DeviceTier::Clear()
+{
+    _counts.clear();
+    ClearDevice();
+}
+
+void DeviceTier::ClearDevice()
+{
+    _device_users.clear();
+    _removals.clear();
+    _updates.clear();
+}
+
+void DeviceTier::RecordMatch(const std::string& user_id)
+{
+    _counts[user_id]++;
+}
+
+uint64_t DeviceTier::Count(const std::string& user_id) const
+{
+    auto it = _counts.find(user_id);
+    return it != _counts.end() ? it->second : 0;
+}
+
+bool DeviceTier::ShouldPromote(const std::string& user_id, std::string& evicted) const
+{
+    evicted.clear();
+    if (!Enabled() || OnDevice(user_id))
+    {
+        return false;
+    }
+    if (_device_users.size() < _capacity)
+    {
+        return true;
+    }
+    // the least matched user of the device, replaced by a more frequent one
+    const std::string* least = nullptr;
+    uint64_t least_count = 0;
+    for (const auto& device_user : _device_users)
+    {
+        auto count = Count(device_user);
+        if (least == nullptr || count < least_count)
+        {
+            least = &device_user;
+            least_count = count;
+        }
+    }
+    if (least == nullptr || Count(user_id) <= least_count)
+    {
+        return false;
+    }
+    evicted = *least;
+    return true;
+}
+
+void DeviceTier::Added(const std::string& user_id)
+{
+    _device_users.insert(user_id);
+    _updates.erase(user_id);
+}
+
+void DeviceTier::Removed(const std::string& user_id)
+{
+    _device_users.erase(user_id);
+    _removals.erase(user_id);
+    _updates.erase(user_id);
+}
+
+void DeviceTier::Forget(const std::string& user_id)
+{
+    _counts.erase(user_id);
+    _updates.erase(user_id);
+    if (OnDevice(user_id))
+    {
+        _removals.insert(user_id);
+    }
+}
+
+void DeviceTier::Changed(const std::string& user_id)
+{
+    _removals.erase(user_id);
+    if (OnDevice(user_id))
+    {
+        _updates.insert(user_id);
+    }
+}
+
+std::vector<std::string> DeviceTier::TakeRemovals()
+{
+    std::vector<std::string> removals {_removals.begin(), _removals.end()};
+    _removals.clear();
+    return removals;
+}
+
+std::vector<std::string> DeviceTier::TakeUpdates()
+{
+    std::vector<std::string> updates {_updates.begin(), _updates.end()};
+    _updates.clear();
+    return updates;
+}
+
+std::vector<std::string> DeviceTier::Plan()
+{
+    std::vector<std::pair<uint64_t, const std::string*>> ranked;
+    ranked.reserve(_counts.size());
+    for (const auto& entry : _counts)
+    {
+        if (entry.second > 0)
+        {
+            ranked.emplace_back(entry.second, &entry.first);
+        }
+    }
+    const size_t size = std::min(_capacity, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(size), ranked.end(),
+                      [](const std::pair<uint64_t, const std::string*>& a,
+                         const std::pair<uint64_t, const std::string*>& b) {
+                          return a.first != b.first ? a.first > b.first : *a.second < *b.second;
+                      });
+    std::vector<std::string> plan;
+    plan.reserve(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        plan.push_back(*ranked[i].second);
+    }
+
+    for (auto it = _counts.begin(); it != _counts.end();)
+    {
+        it->second /= 2;
+        it = it->second == 0 && !OnDevice(it->first) ? _counts.erase(it) : std::next(it);
+    }
+    return plan;
+}
+} // namespace RealSenseID
@@ -0,0 +1,86 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace RealSenseID
+{
+// Bookkeeping of the device tier of the tiered authentication (HostModeAuthenticator::AuthenticateTiered()): how often
+// each host user was matched, on the device or on the host, and which host users are on the device. The device's
+// database is changed by the caller, which reports the changes back (Added(), Removed()).
+// Users removed or enrolled again on the host while on the device are kept as pending changes of the device until
+// taken. Not thread safe.
+class DeviceTier
+{
+public:
+    // max host users on the device, 0 disables the tier
+    void SetCapacity(size_t capacity);
+
+    size_t Capacity() const
+    {
+        return _capacity;
+    }
+
+    bool Enabled() const
+    {
+        return _capacity > 0;
+    }
+
+    // forget the counts, the device's users and the pending changes
+    void Clear();
+
+    // forget the device's users and the pending changes (the device's users are about to be queried again)
+    void ClearDevice();
+
+    void RecordMatch(const std::string& user_id);
+
+    uint64_t Count(const std::string& user_id) const;
+
+    bool OnDevice(const std::string& user_id) const
+    {
+        return _device_users.count(user_id) > 0;
+    }
+
+    size_t DeviceSize() const
+    {
+        return _device_users.size();
+    }
+
+    // the user was matched on the host: whether it should be pushed to the device, because there is room or it was
+    // matched more often than the least matched user of the device, which is evicted for it (empty if none)
+    bool ShouldPromote(const std::string& user_id, std::string& evicted) const;
+
+    void Added(const std::string& user_id);
+    void Removed(const std::string& user_id);
+
+    // the user was removed from the host (removed from the device too once taken), or enrolled again (pushed again)
+    void Forget(const std::string& user_id);
+    void Changed(const std::string& user_id);
+
+    bool PendingRemoval(const std::string& user_id) const
+    {
+        return _removals.count(user_id) > 0;
+    }
+
+    std::vector<std::string> TakeRemovals();
+    std::vector<std::string> TakeUpdates();
+
+    // the capacity most matched users (matched at least once), most matched first. the counts are halved afterwards,
+    // so the tier follows the recent frequencies from one plan to the next
+    std::vector<std::string> Plan();
+
+private:
+    size_t _capacity = 0;
+    std::unordered_map<std::string, uint64_t> _counts;
+    std::unordered_set<std::string> _device_users;
+    std::unordered_set<std::string> _removals;
+    std::unordered_set<std::string> _updates;
+};
+} // namespace RealSenseID
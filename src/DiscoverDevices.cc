@@ -1,13 +1,18 @@
 // License: Apache 2.0. See LICENSE file in root directory.
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 #include "RealSenseID/DiscoverDevices.h"
+#include "DeviceControllerImpl.h"
 #include "Logger.h"
 
 static const char* LOG_TAG = "Utilities";
 
 
 #include <algorithm>
+#include <array>
 #include <cctype>
+#include <cstring>
+#include <future>
+#include <mutex>
 #include <utility>
 #include <string>
 #include <regex>
@@ -59,6 +64,93 @@ static std::string ExtractStringUsingRegex(const std::string& input, const std::
 
     return output;
 }
+
+// Serial port of a matching device, as found by the platform's enumeration.
+struct PortCandidate
+{
+    std::string port;
+    int capture_number = -1;
+    // Identifies the device's current enumeration. Changes when the device is plugged or re-enumerated, empty if the
+    // platform can't tell (the result is not cached then).
+    std::string signature;
+};
+
+static std::vector<PortCandidate> EnumeratePorts();
+
+static std::string QueryFirmwareVersion(const std::string& port)
+{
+    DeviceControllerImpl device_controller;
+    SerialConfig config;
+    config.port = port.c_str();
+    std::string version;
+    if (device_controller.Connect(config) == Status::Ok)
+    {
+        device_controller.QueryFirmwareVersion(version);
+    }
+    return version;
+}
+
+static void CopyString(const std::string& source, char* destination)
+{
+    ::strncpy(destination, source.c_str(), DeviceInfo::MaxBufferSize - 1);
+    destination[DeviceInfo::MaxBufferSize - 1] = '\0';
+}
+
+std::vector<DeviceInfo> DiscoverDevices()
+{
+    static std::mutex cache_mutex;
+    static bool cache_valid = false;
+    static std::string cached_signature;
+    static std::vector<DeviceInfo> cached_devices;
+
+    auto candidates = EnumeratePorts();
+
+    std::string signature;
+    bool cacheable = true;
+    for (const auto& candidate : candidates)
+    {
+        cacheable = cacheable && !candidate.signature.empty();
+        signature += candidate.port + '=' + candidate.signature + ';';
+    }
+
+    std::lock_guard<std::mutex> lock {cache_mutex};
+    if (cacheable && cache_valid && signature == cached_signature)
+    {
+        LOG_DEBUG(LOG_TAG, "Discovered %zu devices (cached)", cached_devices.size());
+        return cached_devices;
+    }
+
+    // probe all the ports in parallel, each query costs a receive timeout if the device doesn't answer
+    std::vector<std::future<std::string>> versions;
+    for (const auto& candidate : candidates)
+    {
+        versions.push_back(std::async(std::launch::async, QueryFirmwareVersion, candidate.port));
+    }
+
+    std::vector<DeviceInfo> devices;
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        DeviceInfo device;
+        ::memset(&device, 0, sizeof(device));
+        CopyString(candidates[i].port, device.serialPort);
+        device.captureNumber = candidates[i].capture_number;
+        try
+        {
+            CopyString(versions[i].get(), device.firmwareVersion);
+        }
+        catch (const std::exception& ex)
+        {
+            LOG_EXCEPTION(LOG_TAG, ex);
+        }
+        devices.push_back(device);
+    }
+
+    cache_valid = cacheable;
+    cached_signature = signature;
+    cached_devices = devices;
+    LOG_DEBUG(LOG_TAG, "Discovered %zu devices", devices.size());
+    return devices;
+}
 }
 
 #if _WIN32
@@ -81,6 +173,7 @@ static std::string ExtractStringUsingRegex(const std::string& input, const std::
 #pragma comment(lib, "Strmiids")
 #pragma comment(lib, "Mfreadwrite")
 
+
 namespace RealSenseID
 {
 static void ThrowIfFailedMSMF(char* what, HRESULT hr)
@@ -92,65 +185,39 @@ static void ThrowIfFailedMSMF(char* what, HRESULT hr)
     throw std::runtime_error(err_stream.str());
 }
 
-std::vector<std::string> DiscoverSerial()
+// Id of the composite usb device from the id of one of its interfaces, in lower case. Used to pair the serial port
+// and the capture device of the same device, e.g.
+// serial instance id "USB\VID_2AAD&PID_6373&MI_00\7&1A2B3C4D&0&0000" (separator '\\') and
+// capture symbolic link "\\?\usb#vid_2aad&pid_6373&mi_03#7&1a2b3c4d&0&0003#{...}" (separator '#') -> "7&1a2b3c4d&0"
+static std::string ParentInstanceId(const std::string& id, char separator)
 {
-    std::vector<std::string> port_names;
-    // Fetch device information set for needed GUID.
-    const GUID guid = GUID_DEVCLASS_PORTS;
-    HDEVINFO device_info_set = SetupDiGetClassDevs(&guid, 0, nullptr, DIGCF_PRESENT);
-    if (device_info_set == INVALID_HANDLE_VALUE)
-        return port_names;
-
-    // Iterate over relevant devices.
-    SP_DEVINFO_DATA device_info_data = {0};
-    device_info_data.cbSize = sizeof(device_info_data);
-    for (int device_index = 0; SetupDiEnumDeviceInfo(device_info_set, device_index, &device_info_data) != 0;
-         ++device_index)
-    {
-        constexpr size_t max_buffer_size = 4096;
-
-        TCHAR device_id_buffer[max_buffer_size];
-        DWORD device_id_size = 0;
-        SetupDiGetDeviceInstanceId(device_info_set, &device_info_data, device_id_buffer, sizeof(device_id_buffer),
-                                   &device_id_size);
-        device_id_buffer[device_id_size] = '\0';
-
-        // Assuming project uses multibyte charset, so TCHAR isn't unicode.
-        std::string device_id_string(reinterpret_cast<const char*>(device_id_buffer));
-        std::string vid = ExtractStringUsingRegex(device_id_string, VID_REGEX);
-        std::string pid = ExtractStringUsingRegex(device_id_string, PID_REGEX);
-
-        if (pid.empty() || vid.empty())
-            continue;
-
-        if (!MatchToExpectedVidPidPairs(vid, pid))
-            continue;
-
-        BYTE friendly_name_buffer[max_buffer_size];
-        DWORD friendly_name_size;
-        SetupDiGetDeviceRegistryProperty(device_info_set, &device_info_data, SPDRP_FRIENDLYNAME, nullptr,
-                                         friendly_name_buffer, sizeof(friendly_name_buffer), &friendly_name_size);
-        friendly_name_buffer[friendly_name_size] = '\0';
-
-        // Assuming project uses multibyte charset, so TCHAR isn't unicode.
-        std::string friendly_name(reinterpret_cast<const char*>(friendly_name_buffer));
-        std::string com_port_string = ExtractStringUsingRegex(friendly_name, COM_PORT_REGEX);
-
-        std::ostringstream oss;
-        oss << "\\\\.\\" << com_port_string;
-        auto com_port_handle_string = oss.str();
-
-        port_names.push_back(com_port_handle_string);
-    }
-
-    SetupDiDestroyDeviceInfoList(device_info_set);
-    return port_names;
+    std::vector<std::string> parts;
+    std::stringstream id_stream(id);
+    std::string part;
+    while (std::getline(id_stream, part, separator))
+        parts.push_back(part);
+
+    if (parts.size() < 3)
+        return {};
+    std::string parent_id = parts[2];
+    auto interface_pos = parent_id.rfind('&');
+    if (interface_pos != std::string::npos)
+        parent_id.erase(interface_pos);
+    std::transform(parent_id.begin(), parent_id.end(), parent_id.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return parent_id;
 }
 
-std::vector<int> DiscoverCapture()
+struct CaptureDevice
+{
+    int number;
+    std::string parent_id;
+};
+
+static std::vector<CaptureDevice> DiscoverCaptureDevices()
 {
     IMFAttributes* cap_config;
-    std::vector<int> capture_numbers;
+    std::vector<CaptureDevice> capture_devices;
 
     static char* stage_tag = "Discover Capture";
     IMFActivate** ppDevices = NULL;
@@ -166,7 +233,7 @@ std::vector<int> DiscoverCapture()
     if (count < 1)
     {
         LOG_ERROR(LOG_TAG, "no video devices detected");
-        return capture_numbers;
+        return capture_devices;
     }
 
     constexpr size_t max_buffer_size = 4096;
@@ -189,112 +256,231 @@ std::vector<int> DiscoverCapture()
             std::string pid = ExtractStringUsingRegex(device_id_string, PID_REGEX);
 
 
-            if (pid.empty() || vid.empty())
-                continue;
-
-            auto matchResult = MatchToExpectedVidPidPairs(vid, pid);
-            if (matchResult)
+            if (!pid.empty() && !vid.empty() && MatchToExpectedVidPidPairs(vid, pid))
             {
-                capture_numbers.push_back(device_index);
+                capture_devices.push_back({static_cast<int>(device_index), ParentInstanceId(device_id_string, '#')});
                 found = true;
                 LOG_DEBUG(LOG_TAG, "detected capture device.");
             }
         }
-         ppDevices[device_index]->Release();
+        ppDevices[device_index]->Release();
     }
     CoTaskMemFree(ppDevices);
     if (!found)
     {
         LOG_ERROR(LOG_TAG, "Failed to auto detect capture device.");
     }
+    return capture_devices;
+}
+
+std::vector<int> DiscoverCapture()
+{
+    std::vector<int> capture_numbers;
+    for (const auto& capture_device : DiscoverCaptureDevices())
+        capture_numbers.push_back(capture_device.number);
     return capture_numbers;
 }
 
-std::vector<DeviceInfo> DiscoverDevices()
+static std::vector<PortCandidate> EnumeratePorts()
 {
-    std::vector<DeviceInfo> devices;
-    std::vector<std::string> port_names;
+    std::vector<PortCandidate> candidates;
+
+    std::vector<CaptureDevice> capture_devices;
+    try
+    {
+        capture_devices = DiscoverCaptureDevices();
+    }
+    catch (const std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+    }
 
-    port_names = DiscoverSerial();
+    // Fetch device information set for needed GUID.
+    const GUID guid = GUID_DEVCLASS_PORTS;
+    HDEVINFO device_info_set = SetupDiGetClassDevs(&guid, 0, nullptr, DIGCF_PRESENT);
+    if (device_info_set == INVALID_HANDLE_VALUE)
+        return candidates;
 
-    for (unsigned int i = 0; i < port_names.size() ; ++i)
+    // Iterate over relevant devices.
+    SP_DEVINFO_DATA device_info_data = {0};
+    device_info_data.cbSize = sizeof(device_info_data);
+    for (int device_index = 0; SetupDiEnumDeviceInfo(device_info_set, device_index, &device_info_data) != 0;
+         ++device_index)
     {
-        DeviceInfo device = {0};
-        ::strncpy(device.serialPort, port_names[i].c_str(), sizeof(device.serialPort) - 1);
-        device.serialPort[sizeof(device.serialPort) - 1] = '\0';
-        devices.push_back(device);
+        constexpr size_t max_buffer_size = 4096;
+
+        TCHAR device_id_buffer[max_buffer_size];
+        DWORD device_id_size = 0;
+        SetupDiGetDeviceInstanceId(device_info_set, &device_info_data, device_id_buffer, sizeof(device_id_buffer),
+                                   &device_id_size);
+        device_id_buffer[device_id_size] = '\0';
+
+        // Assuming project uses multibyte charset, so TCHAR isn't unicode.
+        std::string device_id_string(reinterpret_cast<const char*>(device_id_buffer));
+        std::string vid = ExtractStringUsingRegex(device_id_string, VID_REGEX);
+        std::string pid = ExtractStringUsingRegex(device_id_string, PID_REGEX);
+
+        if (pid.empty() || vid.empty())
+            continue;
+
+        if (!MatchToExpectedVidPidPairs(vid, pid))
+            continue;
+
+        BYTE friendly_name_buffer[max_buffer_size];
+        DWORD friendly_name_size;
+        SetupDiGetDeviceRegistryProperty(device_info_set, &device_info_data, SPDRP_FRIENDLYNAME, nullptr,
+                                         friendly_name_buffer, sizeof(friendly_name_buffer), &friendly_name_size);
+        friendly_name_buffer[friendly_name_size] = '\0';
+
+        // Assuming project uses multibyte charset, so TCHAR isn't unicode.
+        std::string friendly_name(reinterpret_cast<const char*>(friendly_name_buffer));
+        std::string com_port_string = ExtractStringUsingRegex(friendly_name, COM_PORT_REGEX);
+
+        std::ostringstream oss;
+        oss << "\\\\.\\" << com_port_string;
+
+        PortCandidate candidate;
+        candidate.port = oss.str();
+        auto parent_id = ParentInstanceId(device_id_string, '\\');
+        for (const auto& capture_device : capture_devices)
+        {
+            if (!parent_id.empty() && capture_device.parent_id == parent_id)
+            {
+                candidate.capture_number = capture_device.number;
+                break;
+            }
+        }
+        // instance ids survive re-plugging, so no signature (not cached)
+        candidates.push_back(candidate);
     }
-    
-    return devices;
+
+    SetupDiDestroyDeviceInfoList(device_info_set);
+    return candidates;
 }
 } // namespace RealSenseID
 
 
 #elif LINUX
+#include <dirent.h>
+#include <fstream>
+#include <climits>
+#include <cstdlib>
+#include <unistd.h>
+
 namespace RealSenseID
 {
-static const std::string V4L_PATH = "/sys/class/video4linux/";
-static const std::string V4L_CAM_ID_PATH = "/device/*/*/id/";
-static const int FAILED_V4L = -1;
+static const std::string SYSFS_TTY_PATH = "/sys/class/tty/";
+static const std::string SYSFS_V4L_PATH = "/sys/class/video4linux/";
 
-static void ThrowIfFailed(char* what, int res)
+static std::string ReadSysfsAttribute(const std::string& path)
 {
-    if (res != FAILED_V4L)
-        return;
-    std::stringstream err_stream;
-    err_stream << what << "v4l failed with error.";
-    throw std::runtime_error(err_stream.str());
+    std::ifstream attribute_file(path);
+    std::string value;
+    std::getline(attribute_file, value);
+    return value;
 }
 
-static std::string ExecuteCmd(const std::string cmd)
+static std::vector<std::string> ListDirectory(const std::string& path)
 {
-    std::array<char, 128> buffer;
-    std::string result;
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd.c_str(), "r"), pclose);
-    if (!pipe)
+    std::vector<std::string> names;
+    DIR* dir = ::opendir(path.c_str());
+    if (dir == nullptr)
+        return names;
+    while (auto* entry = ::readdir(dir))
     {
-        throw std::runtime_error("popen() failed!");
+        if (entry->d_name[0] != '.')
+            names.emplace_back(entry->d_name);
     }
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr)
+    ::closedir(dir);
+    return names;
+}
+
+// sysfs directory of the usb device (the one with idVendor/idProduct) a class device belongs to, empty if none
+static std::string FindUsbDevice(const std::string& class_device_path)
+{
+    char resolved[PATH_MAX];
+    if (::realpath((class_device_path + "/device").c_str(), resolved) == nullptr)
+        return {};
+
+    std::string path = resolved;
+    while (path.size() > 1)
     {
-        result += buffer.data();
+        if (::access((path + "/idVendor").c_str(), R_OK) == 0)
+            return path;
+        path.erase(path.rfind('/'));
     }
-    result.pop_back();
-    return result;
+    return {};
 }
 
-std::vector<int> DiscoverCapture()
+// number in a class device name, e.g. 3 for "video3"
+static int DeviceNumber(const std::string& name)
 {
-    std::vector<int> capture_numbers;
-
-    static const std::string id_req = "less " + V4L_PATH + "video";
-    static const std::string v4l_num_req = "ls " + V4L_PATH + " | wc - l";
+    auto digits_pos = name.find_first_of("0123456789");
+    return digits_pos == std::string::npos ? -1 : std::atoi(name.c_str() + digits_pos);
+}
 
-    int res = FAILED_V4L;
-    std::string result;
+struct ClassDevice
+{
+    std::string name;
+    std::string usb_device;
+};
 
-    int number_of_dev = std::stoi(ExecuteCmd(v4l_num_req));
-    for (int cur = 0; cur < number_of_dev; cur++)
+// class devices (e.g. ttyACM0, video0) of the matching usb devices, in device number order
+static std::vector<ClassDevice> FindClassDevices(const std::string& class_path)
+{
+    std::vector<ClassDevice> devices;
+    for (const auto& name : ListDirectory(class_path))
     {
-        std::string vid = ExecuteCmd(id_req + std::to_string(cur) + V4L_CAM_ID_PATH + "vendor");
-        std::string pid = ExecuteCmd(id_req + std::to_string(cur) + V4L_CAM_ID_PATH + "product");
-        
-        if (vid.empty() || pid.empty())
-                continue;
+        auto usb_device = FindUsbDevice(class_path + name);
+        if (usb_device.empty())
+            continue;
 
-        if (MatchToExpectedVidPidPairs(vid, pid))
-        {
-            capture_numbers.push_back(cur);
-        }
+        auto vid = ReadSysfsAttribute(usb_device + "/idVendor");
+        auto pid = ReadSysfsAttribute(usb_device + "/idProduct");
+        if (vid.empty() || pid.empty() || !MatchToExpectedVidPidPairs(vid, pid))
+            continue;
+
+        devices.push_back({name, usb_device});
     }
-    LOG_DEBUG(LOG_TAG, " capture devices %d",capture_numbers.size());
+    std::sort(devices.begin(), devices.end(), [](const ClassDevice& lhs, const ClassDevice& rhs) {
+        return DeviceNumber(lhs.name) < DeviceNumber(rhs.name);
+    });
+    return devices;
+}
+
+std::vector<int> DiscoverCapture()
+{
+    std::vector<int> capture_numbers;
+    for (const auto& device : FindClassDevices(SYSFS_V4L_PATH))
+    {
+        capture_numbers.push_back(DeviceNumber(device.name));
+    }
+    LOG_DEBUG(LOG_TAG, " capture devices %zu", capture_numbers.size());
     return capture_numbers;
 }
 
-std::vector<DeviceInfo> DiscoverDevices()
+static std::vector<PortCandidate> EnumeratePorts()
 {
-    LOG_DEBUG(LOG_TAG, "DiscoverDevices is not implemented on this platform!");
-    return {};
+    std::vector<PortCandidate> candidates;
+    auto capture_devices = FindClassDevices(SYSFS_V4L_PATH);
+    for (const auto& tty : FindClassDevices(SYSFS_TTY_PATH))
+    {
+        PortCandidate candidate;
+        candidate.port = "/dev/" + tty.name;
+        // first video node of the same usb device is its capture node
+        for (const auto& capture_device : capture_devices)
+        {
+            if (capture_device.usb_device == tty.usb_device)
+            {
+                candidate.capture_number = DeviceNumber(capture_device.name);
+                break;
+            }
+        }
+        // the usb device number is assigned anew on every enumeration
+        candidate.signature = tty.usb_device + '#' + ReadSysfsAttribute(tty.usb_device + "/devnum");
+        candidates.push_back(candidate);
+    }
+    return candidates;
 }
 } // namespace RealSenseID
 #else
@@ -306,10 +492,10 @@ std::vector<int> DiscoverCapture()
     return {};
 }
 
-std::vector<DeviceInfo> DiscoverDevices()
+static std::vector<PortCandidate> EnumeratePorts()
 {
     LOG_DEBUG(LOG_TAG, "DiscoverDevices is not implemented on this platform!");
     return {};
 }
 } // namespace RealSenseID
-#endif
\ No newline at end of file
+#endif
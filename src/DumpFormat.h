@@ -0,0 +1,78 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+
+// Dump recording file (Preview::StartRecording, DumpReader), host byte order:
+//   FileHeader
+//   FrameHeader, frame data (FrameHeader::size bytes)   for each recorded image
+//   IndexEntry                                         for each recorded image
+//   Trailer
+// The index and trailer are written when the recording is stopped. A file without them (e.g. the process was killed)
+// is indexed by scanning its frames.
+namespace RealSenseID
+{
+namespace Dump
+{
+static const char FILE_MAGIC[8] = {'R', 'S', 'I', 'D', 'D', 'U', 'M', 'P'};
+static const char INDEX_MAGIC[8] = {'R', 'S', 'I', 'D', 'I', 'N', 'D', 'X'};
+static const uint32_t FRAME_MAGIC = 0x46524452; // "RDRF"
+static const uint32_t VERSION = 1;
+
+// FrameHeader::flags
+static const uint32_t FrameLed = 1;
+static const uint32_t FrameProjector = 2;
+
+#pragma pack(push, 1)
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame_size; // max size of the frames' data
+    uint32_t reserved[2];
+};
+
+struct FrameHeader
+{
+    uint32_t magic;
+    uint32_t size;
+    uint32_t number;
+    uint32_t timestamp; // ImageMetadata
+    uint32_t status;
+    uint32_t sensor_id;
+    uint32_t flags;
+    uint32_t face_x;
+    uint32_t face_y;
+    uint32_t face_width;
+    uint32_t face_height;
+    uint32_t reserved;
+    uint64_t capture_timestamp; // ImageTiming
+    uint64_t dequeue_time;
+};
+
+struct IndexEntry
+{
+    uint64_t offset; // of the frame's header
+    uint32_t number;
+    uint32_t timestamp;
+};
+
+struct Trailer
+{
+    uint64_t index_offset;
+    uint32_t frame_count;
+    uint32_t reserved;
+    char magic[8];
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FileHeader) == 32, "FileHeader size");
+static_assert(sizeof(FrameHeader) == 64, "FrameHeader size");
+static_assert(sizeof(IndexEntry) == 16, "IndexEntry size");
+static_assert(sizeof(Trailer) == 24, "Trailer size");
+} // namespace Dump
+} // namespace RealSenseID
@@ -0,0 +1,229 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/DumpReader.h"
+#include "DumpFormat.h"
+#include "Logger.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char* LOG_TAG = "DumpReader";
+
+namespace RealSenseID
+{
+static bool Seek(std::FILE* file, uint64_t offset, int origin = SEEK_SET)
+{
+#ifdef _WIN32
+    return ::_fseeki64(file, static_cast<__int64>(offset), origin) == 0;
+#else
+    return ::fseeko(file, static_cast<off_t>(offset), origin) == 0;
+#endif
+}
+
+static uint64_t Tell(std::FILE* file)
+{
+#ifdef _WIN32
+    return static_cast<uint64_t>(::_ftelli64(file));
+#else
+    return static_cast<uint64_t>(::ftello(file));
+#endif
+}
+
+static bool Read(std::FILE* file, void* data, size_t size)
+{
+    return std::fread(data, 1, size, file) == size;
+}
+
+class DumpReaderImpl
+{
+public:
+    ~DumpReaderImpl()
+    {
+        Close();
+    }
+
+    bool Open(const char* path)
+    {
+        Close();
+        _file = std::fopen(path, "rb");
+        if (_file == nullptr)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to open %s", path);
+            return false;
+        }
+        if (!Read(_file, &_header, sizeof(_header)) ||
+            ::memcmp(_header.magic, Dump::FILE_MAGIC, sizeof(_header.magic)) != 0 || _header.version != Dump::VERSION)
+        {
+            LOG_ERROR(LOG_TAG, "%s is not a dump recording", path);
+            Close();
+            return false;
+        }
+        if (!ReadIndex())
+        {
+            LOG_DEBUG(LOG_TAG, "No index in %s, scanning the frames", path);
+            ScanFrames();
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (_file != nullptr)
+        {
+            std::fclose(_file);
+            _file = nullptr;
+        }
+        _header = {};
+        _index.clear();
+    }
+
+    unsigned int FrameCount() const
+    {
+        return static_cast<unsigned int>(_index.size());
+    }
+
+    unsigned int FrameSize() const
+    {
+        return _header.frame_size;
+    }
+
+    bool ReadFrame(unsigned int index, unsigned char* buffer, unsigned int buffer_size, Image& image)
+    {
+        if (_file == nullptr || index >= _index.size() || buffer == nullptr)
+        {
+            return false;
+        }
+        Dump::FrameHeader header;
+        if (!Seek(_file, _index[index].offset) || !Read(_file, &header, sizeof(header)) ||
+            header.magic != Dump::FRAME_MAGIC)
+        {
+            LOG_ERROR(LOG_TAG, "Bad frame %u", index);
+            return false;
+        }
+        if (header.size > buffer_size)
+        {
+            LOG_ERROR(LOG_TAG, "Buffer too small for frame %u (%u bytes)", index, header.size);
+            return false;
+        }
+        if (!Read(_file, buffer, header.size))
+        {
+            LOG_ERROR(LOG_TAG, "Failed to read frame %u", index);
+            return false;
+        }
+
+        image = Image {};
+        image.buffer = buffer;
+        image.size = header.size;
+        image.width = _header.width;
+        image.height = _header.height;
+        image.stride = image.height ? image.size / image.height : 0;
+        image.number = header.number;
+        image.metadata.timestamp = header.timestamp;
+        image.metadata.status = header.status;
+        image.metadata.sensor_id = header.sensor_id;
+        image.metadata.led = (header.flags & Dump::FrameLed) != 0;
+        image.metadata.projector = (header.flags & Dump::FrameProjector) != 0;
+        image.metadata.face_rect.x = header.face_x;
+        image.metadata.face_rect.y = header.face_y;
+        image.metadata.face_rect.width = header.face_width;
+        image.metadata.face_rect.height = header.face_height;
+        image.timing.captureTimestamp = header.capture_timestamp;
+        image.timing.dequeueTime = header.dequeue_time;
+        return true;
+    }
+
+private:
+    std::FILE* _file = nullptr;
+    Dump::FileHeader _header {};
+    std::vector<Dump::IndexEntry> _index;
+
+    bool ReadIndex()
+    {
+        Dump::Trailer trailer;
+        if (!Seek(_file, 0, SEEK_END))
+        {
+            return false;
+        }
+        const uint64_t file_size = Tell(_file);
+        if (file_size < sizeof(Dump::FileHeader) + sizeof(trailer) ||
+            !Seek(_file, file_size - sizeof(trailer)) || !Read(_file, &trailer, sizeof(trailer)) ||
+            ::memcmp(trailer.magic, Dump::INDEX_MAGIC, sizeof(trailer.magic)) != 0 ||
+            trailer.index_offset + uint64_t {trailer.frame_count} * sizeof(Dump::IndexEntry) + sizeof(trailer) !=
+                file_size)
+        {
+            return false;
+        }
+        _index.resize(trailer.frame_count);
+        if (!Seek(_file, trailer.index_offset) ||
+            !Read(_file, _index.data(), _index.size() * sizeof(Dump::IndexEntry)))
+        {
+            _index.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // index the complete frames, from the file header on
+    void ScanFrames()
+    {
+        uint64_t offset = sizeof(Dump::FileHeader);
+        Dump::FrameHeader header;
+        while (Seek(_file, offset) && Read(_file, &header, sizeof(header)) && header.magic == Dump::FRAME_MAGIC)
+        {
+            const uint64_t next = offset + sizeof(header) + header.size;
+            // the last frame may be truncated
+            if (!Seek(_file, next - 1) || std::fgetc(_file) == EOF)
+            {
+                break;
+            }
+            _index.push_back(Dump::IndexEntry {offset, header.number, header.timestamp});
+            offset = next;
+        }
+    }
+};
+
+DumpReader::DumpReader() : _impl {new DumpReaderImpl}
+{
+}
+
+DumpReader::~DumpReader()
+{
+    try
+    {
+        delete _impl;
+    }
+    catch (...)
+    {
+    }
+}
+
+bool DumpReader::Open(const char* path)
+{
+    if (path == nullptr)
+    {
+        return false;
+    }
+    return _impl->Open(path);
+}
+
+void DumpReader::Close()
+{
+    _impl->Close();
+}
+
+unsigned int DumpReader::GetFrameCount() const
+{
+    return _impl->FrameCount();
+}
+
+unsigned int DumpReader::GetFrameSize() const
+{
+    return _impl->FrameSize();
+}
+
+bool DumpReader::ReadFrame(unsigned int index, unsigned char* buffer, unsigned int buffer_size, Image& image)
+{
+    return _impl->ReadFrame(index, buffer, buffer_size, image);
+}
+} // namespace RealSenseID
@@ -0,0 +1,215 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "DumpRecorder.h"
+#include "ThreadConfigImpl.h"
+#include "FramePool.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <cstring>
+
+static const char* LOG_TAG = "DumpRecorder";
+
+namespace RealSenseID
+{
+DumpRecorder::DumpRecorder(unsigned int queue_size) : _queue_size {queue_size}
+{
+}
+
+DumpRecorder::~DumpRecorder()
+{
+    try
+    {
+        Stop();
+    }
+    catch (...)
+    {
+    }
+}
+
+bool DumpRecorder::Start(const char* path)
+{
+    if (_writer_thread.joinable() || path == nullptr || _queue_size == 0)
+    {
+        return false;
+    }
+    _file = std::fopen(path, "wb");
+    if (_file == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to create %s", path);
+        return false;
+    }
+    // unbuffered: each write goes from the frame straight to the os
+    std::setvbuf(_file, nullptr, _IONBF, 0);
+    _header_written = false;
+    _offset = 0;
+    _index.clear();
+    _queue.clear();
+    _stop = false;
+    _failed = false;
+    _recorded = 0;
+    _dropped = 0;
+    _writer_thread = std::thread([this]() { WriterLoop(); });
+    _recording = true;
+    LOG_DEBUG(LOG_TAG, "Recording to %s", path);
+    return true;
+}
+
+bool DumpRecorder::Stop()
+{
+    if (!_writer_thread.joinable())
+    {
+        return false;
+    }
+    _recording = false;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _stop = true;
+    }
+    _queue_cv.notify_all();
+    _writer_thread.join();
+
+    bool ok = !_failed && WriteIndex();
+    if (std::fclose(_file) != 0)
+    {
+        ok = false;
+    }
+    _file = nullptr;
+    if (!ok)
+    {
+        LOG_ERROR(LOG_TAG, "Recording failed");
+    }
+    LOG_DEBUG(LOG_TAG, "Recorded %u images, %u dropped", _recorded.load(), _dropped.load());
+    return ok;
+}
+
+bool DumpRecorder::IsRecording() const
+{
+    return _recording;
+}
+
+bool DumpRecorder::Push(const PreviewFrame& frame)
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (!_recording || _stop || _failed || _queue.size() >= _queue_size)
+        {
+            _dropped++;
+            return false;
+        }
+        _queue.push_back(frame);
+    }
+    _queue_cv.notify_all();
+    return true;
+}
+
+unsigned int DumpRecorder::Recorded() const
+{
+    return _recorded;
+}
+
+unsigned int DumpRecorder::Dropped() const
+{
+    return _dropped;
+}
+
+void DumpRecorder::WriterLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Preview, "dump-writer");
+    while (true)
+    {
+        PreviewFrame frame;
+        {
+            std::unique_lock<std::mutex> lock {_mutex};
+            _queue_cv.wait(lock, [this] { return _stop || !_queue.empty(); });
+            if (_queue.empty())
+            {
+                break; // stopped and drained
+            }
+            frame = std::move(_queue.front());
+            _queue.pop_front();
+        }
+
+        bool ok;
+        {
+            Trace::Scope write_trace {"Record", "preview"};
+            ok = WriteFrame(frame.GetImage());
+        }
+        frame.Release(); // back to the pool
+        if (!ok)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to write image, recording stopped");
+            std::lock_guard<std::mutex> lock {_mutex};
+            _failed = true;
+            _dropped += static_cast<unsigned int>(_queue.size() + 1);
+            _queue.clear();
+            break;
+        }
+        _recorded++;
+    }
+}
+
+bool DumpRecorder::WriteFrame(const Image& image)
+{
+    if (!_header_written)
+    {
+        Dump::FileHeader header {};
+        ::memcpy(header.magic, Dump::FILE_MAGIC, sizeof(header.magic));
+        header.version = Dump::VERSION;
+        header.width = image.width;
+        header.height = image.height;
+        header.frame_size = image.size;
+        if (!Write(&header, sizeof(header)))
+        {
+            return false;
+        }
+        _header_written = true;
+    }
+
+    Dump::FrameHeader header {};
+    header.magic = Dump::FRAME_MAGIC;
+    header.size = image.size;
+    header.number = image.number;
+    header.timestamp = image.metadata.timestamp;
+    header.status = image.metadata.status;
+    header.sensor_id = image.metadata.sensor_id;
+    header.flags = (image.metadata.led ? Dump::FrameLed : 0) | (image.metadata.projector ? Dump::FrameProjector : 0);
+    header.face_x = image.metadata.face_rect.x;
+    header.face_y = image.metadata.face_rect.y;
+    header.face_width = image.metadata.face_rect.width;
+    header.face_height = image.metadata.face_rect.height;
+    header.capture_timestamp = image.timing.captureTimestamp;
+    header.dequeue_time = image.timing.dequeueTime;
+
+    Dump::IndexEntry entry {_offset, image.number, image.metadata.timestamp};
+    if (!Write(&header, sizeof(header)) || !Write(image.buffer, image.size))
+    {
+        return false;
+    }
+    _index.push_back(entry);
+    return true;
+}
+
+bool DumpRecorder::WriteIndex()
+{
+    if (!_header_written)
+    {
+        return true; // no images, empty file
+    }
+    Dump::Trailer trailer {};
+    trailer.index_offset = _offset;
+    trailer.frame_count = static_cast<uint32_t>(_index.size());
+    ::memcpy(trailer.magic, Dump::INDEX_MAGIC, sizeof(trailer.magic));
+    return Write(_index.data(), _index.size() * sizeof(Dump::IndexEntry)) && Write(&trailer, sizeof(trailer));
+}
+
+bool DumpRecorder::Write(const void* data, size_t size)
+{
+    if (size > 0 && std::fwrite(data, 1, size, _file) != size)
+    {
+        return false;
+    }
+    _offset += size;
+    return true;
+}
+} // namespace RealSenseID
@@ -0,0 +1,64 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/Preview.h"
+#include "DumpFormat.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RealSenseID
+{
+// Writes dumped images (PreviewMode::Dump) to a dump file (see DumpFormat.h) on a writer thread.
+// The recorder holds a lease on each queued frame and writes the image straight from the frame it was captured to,
+// unbuffered, then releases it. Images are dropped if queue_size of them are waiting to be written.
+class DumpRecorder
+{
+public:
+    explicit DumpRecorder(unsigned int queue_size);
+    ~DumpRecorder(); // stops the recording
+
+    DumpRecorder(const DumpRecorder&) = delete;
+    DumpRecorder& operator=(const DumpRecorder&) = delete;
+
+    bool Start(const char* path);
+    // writes the queued images and the index. false if the recording failed
+    bool Stop();
+    bool IsRecording() const;
+
+    // queue the image for writing (any thread). false if dropped
+    bool Push(const PreviewFrame& frame);
+
+    unsigned int Recorded() const;
+    unsigned int Dropped() const;
+
+private:
+    const unsigned int _queue_size;
+    std::FILE* _file = nullptr;
+    bool _header_written = false;
+    uint64_t _offset = 0;
+    std::vector<Dump::IndexEntry> _index;
+    std::thread _writer_thread;
+
+    std::mutex _mutex; // _queue, _stop, _failed, and Start/Stop
+    std::condition_variable _queue_cv;
+    std::deque<PreviewFrame> _queue;
+    bool _stop = false;
+    bool _failed = false;
+    std::atomic_bool _recording {false};
+    std::atomic<unsigned int> _recorded {0};
+    std::atomic<unsigned int> _dropped {0};
+
+    void WriterLoop();
+    bool WriteFrame(const Image& image);
+    bool WriteIndex();
+    bool Write(const void* data, size_t size);
+};
+} // namespace RealSenseID
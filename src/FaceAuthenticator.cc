@@ -5,9 +5,12 @@
 #include "RealSenseID/DeviceConfig.h"
 #include "Logger.h"
 #include "FaceAuthenticatorImpl.h"
+#include <string>
 
 namespace RealSenseID
 {
+static_assert(UserDigest::USER_ID_SIZE == FaceAuthenticator::MAX_USERID_LENGTH, "user digest id size mismatch");
+
 #ifdef RSID_SECURE
 FaceAuthenticator::FaceAuthenticator(SignatureCallback* callback) : _impl {new FaceAuthenticatorImpl(callback)}
 {
@@ -46,6 +49,31 @@ void FaceAuthenticator::Disconnect()
     _impl->Disconnect();
 }
 
+void FaceAuthenticator::SetSessionReuseTimeout(unsigned int timeout_ms)
+{
+    _impl->SetSessionReuseTimeout(timeout_ms);
+}
+
+void FaceAuthenticator::SetAutoReconnect(unsigned int timeout_ms)
+{
+    _impl->SetAutoReconnect(timeout_ms);
+}
+
+void FaceAuthenticator::SetCallbackDispatch(const CallbackDispatchConfig& config)
+{
+    _impl->SetCallbackDispatch(config);
+}
+
+void FaceAuthenticator::SetEventSubscription(const EventSubscription& subscription)
+{
+    _impl->SetEventSubscription(subscription);
+}
+
+void FaceAuthenticator::SetTransferCoordinator(TransferCoordinator* coordinator)
+{
+    _impl->SetTransferCoordinator(coordinator);
+}
+
 #ifdef RSID_SECURE
 Status FaceAuthenticator::Pair(const char* ecdsa_host_pubKey, const char* ecdsa_host_pubkey_sig,
                                char* ecdsa_device_pubkey)
@@ -57,6 +85,11 @@ Status FaceAuthenticator::Unpair()
 {
     return _impl->Unpair();
 }
+
+void FaceAuthenticator::SetSessionKeyLifetime(unsigned int lifetime_seconds)
+{
+    _impl->SetSessionKeyLifetime(lifetime_seconds);
+}
 #endif // RSID_SECURE
 
 Status FaceAuthenticator::Enroll(EnrollmentCallback& callback, const char* user_id)
@@ -74,6 +107,11 @@ Status FaceAuthenticator::AuthenticateLoop(AuthenticationCallback& callback)
     return _impl->AuthenticateLoop(callback);
 }
 
+Status FaceAuthenticator::AuthenticateLoop(AuthenticationCallback& callback, const AuthLoopConfig& config)
+{
+    return _impl->AuthenticateLoop(callback, config);
+}
+
 Status FaceAuthenticator::DetectSpoof(AuthenticationCallback& callback)
 {
     return _impl->DetectSpoof(callback);
@@ -89,6 +127,11 @@ Status FaceAuthenticator::RemoveUser(const char* user_id)
     return _impl->RemoveUser(user_id);
 }
 
+Status FaceAuthenticator::RemoveUsers(const char* const* user_ids, unsigned int number_of_users)
+{
+    return _impl->RemoveUsers(user_ids, number_of_users);
+}
+
 Status FaceAuthenticator::RemoveAll()
 {
     return _impl->RemoveAll();
@@ -99,19 +142,29 @@ Status FaceAuthenticator::SetDeviceConfig(const DeviceConfig& deviceConfig)
     return _impl->SetDeviceConfig(deviceConfig);
 }
 
-Status FaceAuthenticator::QueryDeviceConfig(DeviceConfig& deviceConfig)
+Status FaceAuthenticator::QueryDeviceConfig(DeviceConfig& deviceConfig, bool force_refresh)
+{
+    return _impl->QueryDeviceConfig(deviceConfig, force_refresh);
+}
+
+Status FaceAuthenticator::QueryUserIds(char** user_ids, unsigned int& number_of_users, bool force_refresh)
+{
+    return _impl->QueryUserIds(user_ids, number_of_users, force_refresh);
+}
+
+Status FaceAuthenticator::QueryUserIds(UserIdsCallback& callback, bool force_refresh)
 {
-    return _impl->QueryDeviceConfig(deviceConfig);
+    return _impl->QueryUserIds(callback, force_refresh);
 }
 
-Status FaceAuthenticator::QueryUserIds(char** user_ids, unsigned int& number_of_users)
+Status FaceAuthenticator::QueryNumberOfUsers(unsigned int& number_of_users, bool force_refresh)
 {
-    return _impl->QueryUserIds(user_ids, number_of_users);
+    return _impl->QueryNumberOfUsers(number_of_users, force_refresh);
 }
 
-Status FaceAuthenticator::QueryNumberOfUsers(unsigned int& number_of_users)
+void FaceAuthenticator::SetHostCache(bool enable)
 {
-    return _impl->QueryNumberOfUsers(number_of_users);
+    _impl->SetHostCache(enable);
 }
 
 Status FaceAuthenticator::Standby()
@@ -119,6 +172,31 @@ Status FaceAuthenticator::Standby()
     return _impl->Standby();
 }
 
+Status FaceAuthenticator::Prewarm(unsigned int hold_ms)
+{
+    return _impl->Prewarm(hold_ms);
+}
+
+Status FaceAuthenticator::Ping(unsigned int timeout_ms)
+{
+    return _impl->Ping(timeout_ms);
+}
+
+Status FaceAuthenticator::SyncClock(unsigned int exchanges, unsigned int timeout_ms)
+{
+    return _impl->SyncClock(exchanges, timeout_ms);
+}
+
+ClockSyncState FaceAuthenticator::GetClockSync() const
+{
+    return _impl->GetClockSync();
+}
+
+bool FaceAuthenticator::DeviceTimeToHost(uint64_t device_us, uint64_t& host_us) const
+{
+    return _impl->DeviceTimeToHost(device_us, host_us);
+}
+
 Status FaceAuthenticator::ExtractFaceprintsForEnroll(EnrollFaceprintsExtractionCallback& callback)
 {
     return _impl->ExtractFaceprintsForEnroll(callback);
@@ -134,11 +212,31 @@ Status FaceAuthenticator::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtractionC
     return _impl->ExtractFaceprintsForAuthLoop(callback);
 }
 
+Status FaceAuthenticator::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtractionCallback& callback,
+                                                       unsigned int max_faces)
+{
+    return _impl->ExtractFaceprintsForAuthLoop(callback, max_faces);
+}
+
 MatchResultHost FaceAuthenticator::MatchFaceprints(Faceprints& new_faceprints, Faceprints& existing_faceprints, Faceprints& updated_faceprints)
 {
     return _impl->MatchFaceprints(new_faceprints, existing_faceprints, updated_faceprints);
 }
 
+MatchArrayResultHost FaceAuthenticator::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                               const Faceprints* existing_faceprints_array,
+                                                               size_t count, Faceprints& updated_faceprints)
+{
+    return _impl->MatchFaceprintsToArray(new_faceprints, existing_faceprints_array, count, updated_faceprints);
+}
+
+size_t FaceAuthenticator::MatchFaceprintsTopK(const Faceprints& new_faceprints,
+                                              const Faceprints* existing_faceprints_array, size_t count, size_t k,
+                                              MatchCandidateHost* candidates)
+{
+    return _impl->MatchFaceprintsTopK(new_faceprints, existing_faceprints_array, count, k, candidates);
+}
+
 Status FaceAuthenticator::GetUserFeatures(const char * user_id, Faceprints& user_faceprints)
 {
     return _impl->GetUserFeatures(user_id, user_faceprints);
@@ -149,4 +247,96 @@ Status FaceAuthenticator::SetUserFeatures(const char* user_id, Faceprints& user_
     return _impl->SetUserFeatures(user_id, user_faceprints);
 }
 
+Status FaceAuthenticator::ExportAllFeatures(FeaturesExportCallback& callback)
+{
+    return _impl->ExportAllFeatures(callback);
+}
+
+Status FaceAuthenticator::ExportFeatures(const char* const* user_ids, unsigned int number_of_users,
+                                         FeaturesExportCallback& callback)
+{
+    return _impl->ExportFeatures(user_ids, number_of_users, callback);
+}
+
+Status FaceAuthenticator::QueryUserDigests(UserDigestsCallback& callback, bool force_refresh)
+{
+    return _impl->QueryUserDigests(callback, force_refresh);
+}
+
+Status FaceAuthenticator::ImportFeatures(const char* const* user_ids, const Faceprints* user_faceprints,
+                                         unsigned int number_of_users, FeaturesTransferCallback* callback)
+{
+    return _impl->ImportFeatures(user_ids, user_faceprints, number_of_users, callback);
+}
+
+
+AsyncOperation FaceAuthenticator::EnrollAsync(EnrollmentCallback& callback, const char* user_id,
+                                              AsyncOperation::Completion completion)
+{
+    auto* impl = _impl;
+    const bool has_user_id = user_id != nullptr;
+    return _impl->RunAsync(
+        [impl, &callback, has_user_id, id = std::string {has_user_id ? user_id : ""}] {
+            return impl->Enroll(callback, has_user_id ? id.c_str() : nullptr);
+        },
+        std::move(completion));
+}
+
+AsyncOperation FaceAuthenticator::PrewarmAsync(unsigned int hold_ms, AsyncOperation::Completion completion)
+{
+    return _impl->PrewarmAsync(hold_ms, std::move(completion));
+}
+
+AsyncOperation FaceAuthenticator::AuthenticateAsync(AuthenticationCallback& callback,
+                                                    AsyncOperation::Completion completion)
+{
+    auto* impl = _impl;
+    return _impl->RunAsync([impl, &callback] { return impl->Authenticate(callback); }, std::move(completion));
+}
+
+AsyncOperation FaceAuthenticator::AuthenticateLoopAsync(AuthenticationCallback& callback,
+                                                        AsyncOperation::Completion completion)
+{
+    auto* impl = _impl;
+    return _impl->RunAsync([impl, &callback] { return impl->AuthenticateLoop(callback); }, std::move(completion));
+}
+
+AsyncOperation FaceAuthenticator::AuthenticateLoopAsync(AuthenticationCallback& callback, const AuthLoopConfig& config,
+                                                        AsyncOperation::Completion completion)
+{
+    auto* impl = _impl;
+    return _impl->RunAsync([impl, &callback, config] { return impl->AuthenticateLoop(callback, config); },
+                           std::move(completion));
+}
+
+AsyncOperation FaceAuthenticator::DetectSpoofAsync(AuthenticationCallback& callback,
+                                                   AsyncOperation::Completion completion)
+{
+    auto* impl = _impl;
+    return _impl->RunAsync([impl, &callback] { return impl->DetectSpoof(callback); }, std::move(completion));
+}
+
+AsyncOperation FaceAuthenticator::ExtractFaceprintsForEnrollAsync(EnrollFaceprintsExtractionCallback& callback,
+                                                                  AsyncOperation::Completion completion)
+{
+    auto* impl = _impl;
+    return _impl->RunAsync([impl, &callback] { return impl->ExtractFaceprintsForEnroll(callback); },
+                           std::move(completion));
+}
+
+AsyncOperation FaceAuthenticator::ExtractFaceprintsForAuthAsync(AuthFaceprintsExtractionCallback& callback,
+                                                                AsyncOperation::Completion completion)
+{
+    auto* impl = _impl;
+    return _impl->RunAsync([impl, &callback] { return impl->ExtractFaceprintsForAuth(callback); },
+                           std::move(completion));
+}
+
+AsyncOperation FaceAuthenticator::ExtractFaceprintsForAuthLoopAsync(AuthFaceprintsExtractionCallback& callback,
+                                                                    AsyncOperation::Completion completion)
+{
+    auto* impl = _impl;
+    return _impl->RunAsync([impl, &callback] { return impl->ExtractFaceprintsForAuthLoop(callback); },
+                           std::move(completion));
+}
 } // namespace RealSenseID
@@ -2,19 +2,30 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 
 #include "FaceAuthenticatorImpl.h"
+#include "AuthLoopFilter.h"
 #include "Logger.h"
+#include "MetricsRecorder.h"
+#include "TraceRecorder.h"
 #include "PacketManager/Timer.h"
+#include "PacketManager/ClockSyncPing.h"
+#include "PacketManager/MultiFace.h"
 #include "PacketManager/PacketSender.h"
 #include "PacketManager/SerialPacket.h"
+#include "PacketManager/SerialFactory.h"
 #include "StatusHelper.h"
 #include "RealSenseID/MatchResultHost.h"
+#include "RealSenseID/HostFaceprintsGallery.h"
 #include "RealSenseID/Faceprints.h"
 #include "Matcher/Matcher.h"
 #include "CommonValues.h"
 #include "string.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <limits>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 #ifdef _WIN32
 #include "PacketManager/WindowsSerial.h"
@@ -43,6 +54,24 @@ struct SecureVersionDescriptor
 
 static const unsigned int MAX_FACES = 10;
 
+// data requests kept outstanding by the bulk operations, so they don't wait a round trip per packet
+static const size_t MAX_PENDING_REQUESTS = 4;
+static_assert(MAX_PENDING_REQUESTS <= Session::MaxPendingRequests, "MAX_PENDING_REQUESTS exceeds the session limit");
+
+// time the device gets to end a flow after it was cancelled on session timeout
+static const PacketManager::timeout_t CANCEL_REPLY_TIMEOUT {5000};
+
+// interval between attempts to reopen the port on auto reconnect
+static const PacketManager::timeout_t RECONNECT_RETRY_INTERVAL {100};
+
+// data of the pings (the data size of the smallest packet), the device echoes it
+static const size_t PING_DATA_SIZE = 28;
+
+// a device in standby answers the first ping once awake. pings lost while it wakes up are repeated until then, the
+// late replies of the earlier ones are skipped
+static const unsigned int WAKE_PING_TIMEOUT_MS = 1000;
+static const PacketManager::timeout_t WAKE_TIMEOUT {3000};
+
 // save callback functions to use in the secure session later
 FaceAuthenticatorImpl::FaceAuthenticatorImpl(SignatureCallback* callback) :
 #ifdef RSID_SECURE
@@ -64,33 +93,57 @@ FaceAuthenticatorImpl::FaceAuthenticatorImpl(SignatureCallback* callback) :
 }
 #endif // RSID_SECURE
 
+FaceAuthenticatorImpl::~FaceAuthenticatorImpl()
+{
+    // pending async operations use the session, cancel them and wait for the running one
+    if (_executor)
+    {
+        _executor->Drain(_strand);
+    }
+}
+
 Status FaceAuthenticatorImpl::Connect(const SerialConfig& config)
+{
+    _port = config.port != nullptr ? config.port : "";
+    _baudrate = config.baudrate;
+    _host_cache.Invalidate();
+    _user_digests.clear(); // may be another device
+    auto status = OpenSerial(true);
+    if (status == Status::Ok)
+    {
+        PopulateHostCache();
+    }
+    return status;
+}
+
+Status FaceAuthenticatorImpl::OpenSerial(bool log_errors)
 {
     try
     {
         // disconnect if already connected
+        _session.Close();
         _serial.reset();
         PacketManager::SerialConfig serial_config;
-        serial_config.port = config.port;
+        serial_config.port = _port.c_str();
+        serial_config.baudrate = _baudrate;
 
-#ifdef _WIN32
-        _serial = std::make_unique<PacketManager::WindowsSerial>(serial_config);
-#elif LINUX
-        _serial = std::make_unique<PacketManager::LinuxSerial>(serial_config);
-#else
-        LOG_ERROR(LOG_TAG, "Serial connection method not supported for OS");
-        return Status::Error;
-#endif // WIN32
+        _serial = PacketManager::OpenSerialConnection(serial_config);
         return Status::Ok;
     }
     catch (const std::exception& ex)
     {
-        LOG_EXCEPTION(LOG_TAG, ex);
+        if (log_errors)
+        {
+            LOG_EXCEPTION(LOG_TAG, ex);
+        }
         return Status::Error;
     }
     catch (...)
     {
-        LOG_ERROR(LOG_TAG, "Unknown exception during serial connect");
+        if (log_errors)
+        {
+            LOG_ERROR(LOG_TAG, "Unknown exception during serial connect");
+        }
         return Status::Error;
     }
 }
@@ -101,10 +154,15 @@ Status FaceAuthenticatorImpl::Connect(const AndroidSerialConfig& config)
     try
     {
         // disconnect if already connected
+        _session.Close();
         _serial.reset();
+        _port.clear(); // the usb file descriptor can't be reopened
 
+        _host_cache.Invalidate();
+        _user_digests.clear(); // may be another device
         _serial = std::make_unique<PacketManager::AndroidSerial>(config.fileDescriptor, config.readEndpoint,
-                                                                 config.writeEndpoint);
+                                                                 config.writeEndpoint, config.readBufferSize);
+        PopulateHostCache();
         return Status::Ok;
     }
     catch (const std::exception& ex)
@@ -122,7 +180,139 @@ Status FaceAuthenticatorImpl::Connect(const AndroidSerialConfig& config)
 
 void FaceAuthenticatorImpl::Disconnect()
 {
+    _session.Close();
+    _serial.reset();
+    _host_cache.Invalidate();
+    _clock_sync.Reset(); // the next device may run another clock
+}
+
+void FaceAuthenticatorImpl::SetSessionReuseTimeout(unsigned int timeout_ms)
+{
+    _session.SetReuseTimeout(PacketManager::timeout_t {timeout_ms});
+}
+
+void FaceAuthenticatorImpl::SetAutoReconnect(unsigned int timeout_ms)
+{
+    _reconnect_timeout = PacketManager::timeout_t {timeout_ms};
+}
+
+void FaceAuthenticatorImpl::SetEventSubscription(const EventSubscription& subscription)
+{
+    uint8_t mask = 0;
+    if (subscription.hints)
+    {
+        mask |= PacketManager::EventHints;
+    }
+    if (subscription.facesDetected)
+    {
+        mask |= PacketManager::EventFaceDetected;
+    }
+    const auto interval_ms = std::min<unsigned int>(subscription.faceDetectedIntervalMs, UINT16_MAX);
+    _session.SetEventSubscription(mask, static_cast<uint16_t>(interval_ms));
+}
+
+void FaceAuthenticatorImpl::SetTransferCoordinator(TransferCoordinator* coordinator)
+{
+    _transfer_coordinator = coordinator;
+}
+
+void FaceAuthenticatorImpl::SetCallbackDispatch(const CallbackDispatchConfig& config)
+{
+    _callback_dispatcher.reset(); // delivers the events still queued
+    if (config.queuePolicy != CallbackQueuePolicy::Inline)
+    {
+        _callback_dispatcher.reset(new CallbackDispatcher {config});
+    }
+}
+
+Status FaceAuthenticatorImpl::Enroll(EnrollmentCallback& callback, const char* user_id)
+{
+    if (_callback_dispatcher)
+    {
+        CallbackDispatcher::EnrollmentProxy proxy {*_callback_dispatcher, callback};
+        return EnrollFlow(proxy, user_id);
+    }
+    return EnrollFlow(callback, user_id);
+}
+
+Status FaceAuthenticatorImpl::Authenticate(AuthenticationCallback& callback)
+{
+    if (_callback_dispatcher)
+    {
+        CallbackDispatcher::AuthenticationProxy proxy {*_callback_dispatcher, callback};
+        return AuthenticateFlow(proxy);
+    }
+    return AuthenticateFlow(callback);
+}
+
+Status FaceAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback)
+{
+    if (_callback_dispatcher)
+    {
+        CallbackDispatcher::AuthenticationProxy proxy {*_callback_dispatcher, callback};
+        return AuthenticateLoopFlow(proxy);
+    }
+    return AuthenticateLoopFlow(callback);
+}
+
+Status FaceAuthenticatorImpl::DetectSpoof(AuthenticationCallback& callback)
+{
+    if (_callback_dispatcher)
+    {
+        CallbackDispatcher::AuthenticationProxy proxy {*_callback_dispatcher, callback};
+        return DetectSpoofFlow(proxy);
+    }
+    return DetectSpoofFlow(callback);
+}
+
+// send/recv errors other than timeout mean the port is gone (e.g. device unplugged)
+static bool IsConnectionLost(PacketManager::SerialStatus status)
+{
+    return status == PacketManager::SerialStatus::SendFailed || status == PacketManager::SerialStatus::RecvFailed;
+}
+
+PacketManager::SerialStatus FaceAuthenticatorImpl::ResumeSession()
+{
+    bool can_reconnect = _reconnect_timeout.count() > 0 && !_port.empty();
+    auto status = PacketManager::SerialStatus::SendFailed; // no connection after a failed reconnect
+    if (_serial || !can_reconnect)
+    {
+        status = _session.Resume(_serial.get());
+        if (!can_reconnect || !IsConnectionLost(status))
+        {
+            return status;
+        }
+    }
+
+    LOG_WARNING(LOG_TAG, "Connection to %s lost (status %d), reconnecting", _port.c_str(), static_cast<int>(status));
+    PacketManager::Timer reconnect_timer {_reconnect_timeout};
+    while (true)
+    {
+        // the device may still be booting after it reappeared, retry the session start as well
+        if (OpenSerial(false) == Status::Ok)
+        {
+            status = _session.Resume(_serial.get());
+            if (status == PacketManager::SerialStatus::Ok)
+            {
+                // the device may have been reset or changed while away
+                _host_cache.Invalidate();
+                Metrics::Add(Metrics::Counter::Reconnects);
+                LOG_INFO(LOG_TAG, "Reconnected to %s after %zu ms", _port.c_str(),
+                         static_cast<size_t>(reconnect_timer.Elapsed().count()));
+                return status;
+            }
+        }
+        if (reconnect_timer.ReachedTimeout())
+        {
+            break;
+        }
+        std::this_thread::sleep_for(RECONNECT_RETRY_INTERVAL);
+    }
+
+    LOG_ERROR(LOG_TAG, "Failed reconnecting to %s", _port.c_str());
+    _session.Close();
     _serial.reset();
+    return status;
 }
 
 #ifdef RSID_SECURE
@@ -143,6 +333,9 @@ Status FaceAuthenticatorImpl::Pair(const char* ecdsaHostPubKey, const char* ecds
     PacketManager::DataPacket packet {PacketManager::MsgId::HostEcdsaKey, (char*)ecdsaSignedHostPubKey,
                                       sizeof(ecdsaSignedHostPubKey)};
 
+    // pairing bypasses the session, start a new one (with new keys) afterwards
+    _session.Close();
+    _session.ClearKeyCache();
     PacketManager::PacketSender sender {_serial.get()};
     auto status = sender.SendBinary(packet);
     if (status != PacketManager::SerialStatus::Ok)
@@ -172,6 +365,11 @@ Status FaceAuthenticatorImpl::Pair(const char* ecdsaHostPubKey, const char* ecds
     return Status::Ok;
 }
 
+void FaceAuthenticatorImpl::SetSessionKeyLifetime(unsigned int lifetime_seconds)
+{
+    _session.SetKeyLifetime(std::chrono::seconds {lifetime_seconds});
+}
+
 Status FaceAuthenticatorImpl::Unpair()
 {
     if (!_serial)
@@ -189,7 +387,9 @@ Status FaceAuthenticatorImpl::Unpair()
 // serialization format:
 //   First byte: face count
 //   N FaceRect structs (little endian, packed)
-static std::vector<FaceRect> GetDetectedFaces(const PacketManager::SerialPacket& packet)
+// copy the faces of a FaceDetected packet to faces (MAX_FACES entries) and return their number.
+// fixed size array on the caller's stack, so the loop flows don't allocate per packet
+static unsigned int GetDetectedFaces(const PacketManager::SerialPacket& packet, FaceRect* faces)
 {
     assert(packet.header.id == PacketManager::MsgId::FaceDetected);
 
@@ -205,17 +405,44 @@ static std::vector<FaceRect> GetDetectedFaces(const PacketManager::SerialPacket&
         throw std::runtime_error("Got unexpected faces count in response: " + std::to_string(n_faces));
     }
 
-    std::vector<FaceRect> rv;
-    rv.reserve(n_faces);
     for (unsigned int i = 0; i < n_faces; i++)
     {
-        FaceRect face;
-        ::memcpy(&face, data, sizeof(face));
-        data += sizeof(face);
-        rv.push_back(face);
-        LOG_DEBUG(LOG_TAG, "Detected face %u,%u %ux%u", face.x, face.y, face.w, face.h);
+        ::memcpy(&faces[i], data, sizeof(FaceRect));
+        data += sizeof(FaceRect);
+        LOG_DEBUG(LOG_TAG, "Detected face %u,%u %ux%u", faces[i].x, faces[i].y, faces[i].w, faces[i].h);
+    }
+    return n_faces;
+}
+
+// copy the faces of a MultiFaceprints message to queries and faces (MaxMultiFaces entries each) and return their
+// number (see MultiFace.h).
+static unsigned int GetMultiFaceprints(const std::vector<char>& message, QueryFaceprints* queries, FaceRect* faces)
+{
+    PacketManager::MultiFaceHeader header;
+    if (message.size() < sizeof(header))
+    {
+        throw std::runtime_error("Got truncated multi-face faceprints");
+    }
+    ::memcpy(&header, message.data(), sizeof(header));
+    if (header.count > PacketManager::MaxMultiFaces ||
+        message.size() != sizeof(header) + header.count * sizeof(PacketManager::MultiFaceRecord))
+    {
+        throw std::runtime_error("Got unexpected multi-face faceprints count: " + std::to_string(header.count));
     }
-    return rv;
+
+    const char* data = message.data() + sizeof(header);
+    for (unsigned int i = 0; i < header.count; i++)
+    {
+        PacketManager::MultiFaceRecord record;
+        ::memcpy(&record, data, sizeof(record));
+        data += sizeof(record);
+        static_assert(sizeof(queries[i].descriptor) == sizeof(record.descriptor), "faceprints sizes does not match");
+        ::memcpy(queries[i].descriptor, record.descriptor, sizeof(queries[i].descriptor));
+        queries[i].version = record.version;
+        queries[i].featuresType = static_cast<FaceprintsTypeEnum>(record.features_type);
+        faces[i] = record.face;
+    }
+    return header.count;
 }
 
 // Do enroll session with the device. Call user's enroll callbacks in the process.
@@ -223,15 +450,19 @@ static std::vector<FaceRect> GetDetectedFaces(const PacketManager::SerialPacket&
 //      We get 'reply' from device ('Y').
 //      Any non ok status from the session object(i.e. serial comm failed, or session timeout).
 //      Unexpected msg_id in the fa response.
-Status FaceAuthenticatorImpl::Enroll(EnrollmentCallback& callback, const char* user_id)
+Status FaceAuthenticatorImpl::EnrollFlow(EnrollmentCallback& callback, const char* user_id)
 {
+    Trace::Scope flow_trace {"Enroll", "flow"};
+    Metrics::ScopedLatency flow_latency {Metrics::Latency::Enroll};
     try
     {
         if (!ValidateUserId(user_id))
         {
             return Status::Error;
         }
-        auto status = _session.Start(_serial.get());
+        _host_cache.users_valid = false; // the device's user list may change from here on
+        ForgetDigest(user_id); // enrolling over an existing user replaces its features
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
@@ -249,16 +480,29 @@ Status FaceAuthenticatorImpl::Enroll(EnrollmentCallback& callback, const char* u
         }
 
         PacketManager::Timer session_timer {CommonValues::enroll_max_timeout};
+        bool session_cancelled = false;
         while (true)
         {
             if (session_timer.ReachedTimeout())
             {
+                if (session_cancelled)
+                {
+                    LOG_ERROR(LOG_TAG, "no reply to cancel after session timeout");
+                    return Status::Error;
+                }
                 LOG_ERROR(LOG_TAG, "session timeout");
                 callback.OnResult(EnrollStatus::Failure);
                 Cancel();
+                // give the device time to reply to the cancel
+                session_timer = PacketManager::Timer {CANCEL_REPLY_TIMEOUT};
+                session_cancelled = true;
             }
 
-            status = _session.RecvPacket(fa_packet);
+            status = _session.RecvPacket(fa_packet, &session_timer);
+            if (status == PacketManager::SerialStatus::RecvTimeout && session_timer.ReachedTimeout())
+            {
+                continue; // handle the session timeout
+            }
             if (status != PacketManager::SerialStatus::Ok)
             {
                 LOG_ERROR(LOG_TAG, "Failed receiving fa packet (status %d)", (int)status);
@@ -271,9 +515,10 @@ Status FaceAuthenticatorImpl::Enroll(EnrollmentCallback& callback, const char* u
             // handle face detected as data packet
             if (msg_id == PacketManager::MsgId::FaceDetected)
             {
-                auto faces = GetDetectedFaces(fa_packet);
-                LOG_INFO("Enroll", "OnFaceDetected %u faces", static_cast<unsigned>(faces.size()));
-                callback.OnFaceDetected(faces);
+                FaceRect faces[MAX_FACES];
+                auto n_faces = GetDetectedFaces(fa_packet, faces);
+                LOG_INFO("Enroll", "OnFaceDetected %u faces", n_faces);
+                callback.OnFacesDetected(faces, n_faces);
                 continue; // continue to recv next messages
             }
 
@@ -286,6 +531,7 @@ Status FaceAuthenticatorImpl::Enroll(EnrollmentCallback& callback, const char* u
                 return Status::Ok;
 
             case (PacketManager::MsgId::Result):
+                Trace::Instant("DeviceResult", "device", fa_status);
                 callback.OnResult(EnrollStatus(fa_status));
                 break;
 
@@ -324,18 +570,21 @@ Status FaceAuthenticatorImpl::Enroll(EnrollmentCallback& callback, const char* u
 //      We get 'reply' from device ('Y').
 //      Any non ok status from the session object(i.e. serial comm failed, or session timeout).
 //      Unexpected msg_id in the fa response.
-Status FaceAuthenticatorImpl::Authenticate(AuthenticationCallback& callback)
+Status FaceAuthenticatorImpl::AuthenticateFlow(AuthenticationCallback& callback)
 {
+    Trace::Scope flow_trace {"Authenticate", "flow"};
+    Metrics::ScopedLatency flow_latency {Metrics::Latency::Authenticate};
     try
     {
-        auto status = _session.Start(_serial.get());
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
             callback.OnResult(ToAuthStatus(status), nullptr);
             return ToStatus(status);
         }
-        PacketManager::FaPacket fa_packet {PacketManager::MsgId::Authenticate};
+        auto fa_packet_lease = _session.Packets().AcquireFa(PacketManager::MsgId::Authenticate);
+        auto& fa_packet = *fa_packet_lease;
         status = _session.SendPacket(fa_packet);
         if (status != PacketManager::SerialStatus::Ok)
         {
@@ -345,16 +594,29 @@ Status FaceAuthenticatorImpl::Authenticate(AuthenticationCallback& callback)
         }
 
         PacketManager::Timer session_timer {CommonValues::auth_max_timeout};
+        bool session_cancelled = false;
         while (true)
         {
             if (session_timer.ReachedTimeout())
             {
+                if (session_cancelled)
+                {
+                    LOG_ERROR(LOG_TAG, "no reply to cancel after session timeout");
+                    return Status::Error;
+                }
                 LOG_ERROR(LOG_TAG, "session timeout");
                 callback.OnResult(AuthenticateStatus::Forbidden, nullptr);
                 Cancel();
+                // give the device time to reply to the cancel
+                session_timer = PacketManager::Timer {CANCEL_REPLY_TIMEOUT};
+                session_cancelled = true;
             }
 
-            status = _session.RecvPacket(fa_packet);
+            status = _session.RecvPacket(fa_packet, &session_timer);
+            if (status == PacketManager::SerialStatus::RecvTimeout && session_timer.ReachedTimeout())
+            {
+                continue; // handle the session timeout
+            }
             if (status != PacketManager::SerialStatus::Ok)
             {
                 LOG_ERROR(LOG_TAG, "Failed receiving fa packet (status %d)", (int)status);
@@ -367,9 +629,10 @@ Status FaceAuthenticatorImpl::Authenticate(AuthenticationCallback& callback)
             // handle face detected as data packet
             if (msg_id == PacketManager::MsgId::FaceDetected)
             {
-                auto faces = GetDetectedFaces(fa_packet);
-                LOG_INFO("Autenticate", "OnFaceDetected %u faces", static_cast<unsigned>(faces.size()));
-                callback.OnFaceDetected(faces);
+                FaceRect faces[MAX_FACES];
+                auto n_faces = GetDetectedFaces(fa_packet, faces);
+                LOG_INFO("Autenticate", "OnFaceDetected %u faces", n_faces);
+                callback.OnFacesDetected(faces, n_faces);
                 continue; // continue to recv next messages
             }
 
@@ -386,7 +649,12 @@ Status FaceAuthenticatorImpl::Authenticate(AuthenticationCallback& callback)
                 return Status::Ok;
 
             case (PacketManager::MsgId::Result): {
+                Trace::Instant("DeviceResult", "device", fa_status);
                 LOG_INFO("Autenticate", "OnResult status=%s(%d), user_id=\"%s\"", log_auth_status, fa_status, user_id);
+                if (auth_status == AuthenticateStatus::Success)
+                {
+                    ForgetDigest(user_id); // the device may have updated the user's features
+                }
                 callback.OnResult(auth_status, user_id);
                 break;
             }
@@ -422,18 +690,20 @@ Status FaceAuthenticatorImpl::Authenticate(AuthenticationCallback& callback)
 //      We get 'reply' from device ('Y' , would happen if "cancel" command was sent by a different thread to this
 //      device). Any non ok status from the session object(i.e. serial comm failed, or session timeout). Unexpected
 //      msg_id in the fa response.
-Status FaceAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback)
+Status FaceAuthenticatorImpl::AuthenticateLoopFlow(AuthenticationCallback& callback)
 {
+    Trace::Scope flow_trace {"AuthenticateLoop", "flow"};
     try
     {
-        auto status = _session.Start(_serial.get());
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
             callback.OnResult(ToAuthStatus(status), nullptr);
             return ToStatus(status);
         }
-        PacketManager::FaPacket fa_packet {PacketManager::MsgId::AuthenticateLoop};
+        auto fa_packet_lease = _session.Packets().AcquireFa(PacketManager::MsgId::AuthenticateLoop);
+        auto& fa_packet = *fa_packet_lease;
         status = _session.SendPacket(fa_packet);
         if (status != PacketManager::SerialStatus::Ok)
         {
@@ -454,6 +724,7 @@ Status FaceAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback)
                 callback.OnHint(ToAuthStatus(status));
                 if (++retry_counter <= max_retries)
                 {
+                    Metrics::Add(Metrics::Counter::PacketRetries);
                     LOG_WARNING(LOG_TAG, "Timeout waiting for packet (try #%d)", retry_counter);
                     continue;
                 }
@@ -466,9 +737,10 @@ Status FaceAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback)
             // handle face detected as data packet
             if (msg_id == PacketManager::MsgId::FaceDetected)
             {
-                auto faces = GetDetectedFaces(fa_packet);
-                LOG_INFO("DetectSpoof", "OnFaceDetected %u faces", static_cast<unsigned>(faces.size()));
-                callback.OnFaceDetected(faces);
+                FaceRect faces[MAX_FACES];
+                auto n_faces = GetDetectedFaces(fa_packet, faces);
+                LOG_INFO("DetectSpoof", "OnFaceDetected %u faces", n_faces);
+                callback.OnFacesDetected(faces, n_faces);
                 continue; // continue to recv next messages
             }
 
@@ -486,7 +758,12 @@ Status FaceAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback)
                 return Status::Ok;
 
             case (PacketManager::MsgId::Result): {
+                Trace::Instant("DeviceResult", "device", fa_status);
                 LOG_INFO("Autenticate", "OnResult status=%s(%d), user_id=\"%s\"", log_auth_status, fa_status, user_id);
+                if (auth_status == AuthenticateStatus::Success)
+                {
+                    ForgetDigest(user_id); // the device may have updated the user's features
+                }
                 callback.OnResult(auth_status, user_id);
                 break;
             }
@@ -517,15 +794,31 @@ Status FaceAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback)
     }
 }
 
+// Authenticate loop with the config's reporting policy applied to the user's callback
+Status FaceAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback, const AuthLoopConfig& config)
+{
+    if (_callback_dispatcher)
+    {
+        // filter on the flow's thread, so the filtered events don't take room in the queue
+        CallbackDispatcher::AuthenticationProxy proxy {*_callback_dispatcher, callback};
+        AuthLoopFilter filter {proxy, config};
+        return AuthenticateLoopFlow(filter);
+    }
+    AuthLoopFilter filter {callback, config};
+    return AuthenticateLoopFlow(filter);
+}
+
 // Perform a spoof detection session on the device. Use the user's callbacks in the process.
 // Wait for one of the following to happen:
 //      We get 'reply' from device ('Y').
 //      Any non ok status from the session object(i.e. serial comm failed, or session timeout).
 //      Unexpected msg_id in the fa response.
-Status FaceAuthenticatorImpl::DetectSpoof(AuthenticationCallback& callback)
+Status FaceAuthenticatorImpl::DetectSpoofFlow(AuthenticationCallback& callback)
 {
+    Trace::Scope flow_trace {"DetectSpoof", "flow"};
+    Metrics::ScopedLatency flow_latency {Metrics::Latency::Authenticate};
     DeviceConfig device_config;
-    auto query_status = QueryDeviceConfig(device_config);
+    auto query_status = QueryDeviceConfig(device_config, false);
     if (query_status != Status::Ok)
     {
         LOG_ERROR(LOG_TAG, "QueryDeviceConfig failed");
@@ -538,14 +831,15 @@ Status FaceAuthenticatorImpl::DetectSpoof(AuthenticationCallback& callback)
     }
     try
     {
-        auto status = _session.Start(_serial.get());
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
             callback.OnResult(ToAuthStatus(status), nullptr);
             return ToStatus(status);
         }
-        PacketManager::FaPacket fa_packet {PacketManager::MsgId::DetectSpoof};
+        auto fa_packet_lease = _session.Packets().AcquireFa(PacketManager::MsgId::DetectSpoof);
+        auto& fa_packet = *fa_packet_lease;
         status = _session.SendPacket(fa_packet);
         if (status != PacketManager::SerialStatus::Ok)
         {
@@ -555,16 +849,29 @@ Status FaceAuthenticatorImpl::DetectSpoof(AuthenticationCallback& callback)
         }
 
         PacketManager::Timer session_timer {CommonValues::auth_max_timeout};
+        bool session_cancelled = false;
         while (true)
         {
             if (session_timer.ReachedTimeout())
             {
+                if (session_cancelled)
+                {
+                    LOG_ERROR(LOG_TAG, "no reply to cancel after session timeout");
+                    return Status::Error;
+                }
                 LOG_ERROR(LOG_TAG, "session timeout");
                 callback.OnResult(AuthenticateStatus::Forbidden, nullptr);
                 Cancel();
+                // give the device time to reply to the cancel
+                session_timer = PacketManager::Timer {CANCEL_REPLY_TIMEOUT};
+                session_cancelled = true;
             }
 
-            status = _session.RecvPacket(fa_packet);
+            status = _session.RecvPacket(fa_packet, &session_timer);
+            if (status == PacketManager::SerialStatus::RecvTimeout && session_timer.ReachedTimeout())
+            {
+                continue; // handle the session timeout
+            }
             if (status != PacketManager::SerialStatus::Ok)
             {
                 LOG_ERROR(LOG_TAG, "Failed receiving fa packet (status %d)", (int)status);
@@ -577,9 +884,10 @@ Status FaceAuthenticatorImpl::DetectSpoof(AuthenticationCallback& callback)
             // handle face detected as data packet
             if (msg_id == PacketManager::MsgId::FaceDetected)
             {
-                auto faces = GetDetectedFaces(fa_packet);
-                LOG_INFO("DetectSpoof", "OnFaceDetected %u faces", static_cast<unsigned>(faces.size()));
-                callback.OnFaceDetected(faces);
+                FaceRect faces[MAX_FACES];
+                auto n_faces = GetDetectedFaces(fa_packet, faces);
+                LOG_INFO("DetectSpoof", "OnFaceDetected %u faces", n_faces);
+                callback.OnFacesDetected(faces, n_faces);
                 continue; // continue to recv next messages
             }
 
@@ -592,6 +900,7 @@ Status FaceAuthenticatorImpl::DetectSpoof(AuthenticationCallback& callback)
                 return Status::Ok;
 
             case (PacketManager::MsgId::Result): {
+                Trace::Instant("DeviceResult", "device", fa_status);
                 callback.OnResult(AuthenticateStatus(fa_status), nullptr);
                 break;
             }
@@ -649,7 +958,7 @@ Status FaceAuthenticatorImpl::RemoveUser(const char* user_id)
         {
             return Status::Error;
         }
-        auto status = _session.Start(_serial.get());
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
@@ -671,7 +980,14 @@ Status FaceAuthenticatorImpl::RemoveUser(const char* user_id)
             return ToStatus(status);
         }
 
-        return Status(fa_packet.GetStatusCode());
+        auto remove_status = Status(fa_packet.GetStatusCode());
+        if (remove_status == Status::Ok)
+        {
+            auto& cached_ids = _host_cache.user_ids;
+            cached_ids.erase(std::remove(cached_ids.begin(), cached_ids.end(), user_id), cached_ids.end());
+            _user_digests.erase(user_id);
+        }
+        return remove_status;
     }
     catch (std::exception& ex)
     {
@@ -685,11 +1001,107 @@ Status FaceAuthenticatorImpl::RemoveUser(const char* user_id)
     }
 }
 
+// Pipeline the RemoveUser requests over one session. The device has no multi user remove request, so each user is
+// still a request, but without waiting for the previous reply.
+// Users the device fails to remove (e.g. not enrolled) do not stop the others, the first such status is returned.
+Status FaceAuthenticatorImpl::RemoveUsers(const char* const* user_ids, unsigned int number_of_users)
+{
+    if (user_ids == nullptr && number_of_users > 0)
+    {
+        LOG_ERROR(LOG_TAG, "RemoveUsers: Got invalid params (nullptr)");
+        return Status::Error;
+    }
+    for (unsigned int i = 0; i < number_of_users; i++)
+    {
+        if (!ValidateUserId(user_ids[i]))
+        {
+            return Status::Error;
+        }
+    }
+    if (number_of_users == 0)
+    {
+        return Status::Ok;
+    }
+
+    try
+    {
+        auto status = ResumeSession();
+        if (status != PacketManager::SerialStatus::Ok)
+        {
+            LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
+            return ToStatus(status);
+        }
+
+        unsigned int requested_users = 0;
+        unsigned int replied_users = 0;
+        unsigned int removed_users = 0;
+        auto result = Status::Ok;
+        auto& cached_ids = _host_cache.user_ids;
+        while (replied_users < number_of_users)
+        {
+            while (requested_users < number_of_users && _session.PendingRequests() < MAX_PENDING_REQUESTS)
+            {
+                auto fa_packet_lease =
+                    _session.Packets().AcquireFa(PacketManager::MsgId::RemoveUser, user_ids[requested_users], 0);
+                status = _session.SendRequest(*fa_packet_lease);
+                if (status != PacketManager::SerialStatus::Ok)
+                {
+                    LOG_ERROR(LOG_TAG, "Failed sending fa packet (status %d)", (int)status);
+                    DrainPendingReplies();
+                    return ToStatus(status);
+                }
+                requested_users++;
+            }
+
+            auto reply_packet_lease = _session.Packets().AcquireFa(PacketManager::MsgId::None);
+            auto& reply_packet = *reply_packet_lease;
+            uint32_t request_seq = 0;
+            status = _session.RecvReply(reply_packet, request_seq);
+            if (status != PacketManager::SerialStatus::Ok)
+            {
+                LOG_ERROR(LOG_TAG, "Failed receiving fa packet (status %d)", (int)status);
+                DrainPendingReplies();
+                return ToStatus(status);
+            }
+
+            const char* user_id = user_ids[replied_users];
+            auto remove_status = Status(reply_packet.GetStatusCode());
+            if (remove_status == Status::Ok)
+            {
+                cached_ids.erase(std::remove(cached_ids.begin(), cached_ids.end(), user_id), cached_ids.end());
+                _user_digests.erase(user_id);
+                removed_users++;
+            }
+            else
+            {
+                LOG_ERROR(LOG_TAG, "Failed removing user %s (status %d)", user_id, (int)remove_status);
+                if (result == Status::Ok)
+                {
+                    result = remove_status;
+                }
+            }
+            replied_users++;
+        }
+
+        LOG_DEBUG(LOG_TAG, "Removed %u of %u users", removed_users, number_of_users);
+        return result;
+    }
+    catch (std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Unknown exception");
+    }
+    return Status::Error;
+}
+
 Status FaceAuthenticatorImpl::RemoveAll()
 {
     try
     {
-        auto status = _session.Start(_serial.get());
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
@@ -711,7 +1123,14 @@ Status FaceAuthenticatorImpl::RemoveAll()
             return ToStatus(status);
         }
 
-        return Status(fa_packet.GetStatusCode());
+        auto remove_status = Status(fa_packet.GetStatusCode());
+        if (remove_status == Status::Ok)
+        {
+            _host_cache.user_ids.clear();
+            _host_cache.users_valid = true;
+            _user_digests.clear();
+        }
+        return remove_status;
     }
     catch (std::exception& ex)
     {
@@ -728,7 +1147,7 @@ Status FaceAuthenticatorImpl::RemoveAll()
 Status FaceAuthenticatorImpl::SetDeviceConfig(const DeviceConfig& device_config)
 {
     DeviceConfig prev_device_config;
-    auto query_status = QueryDeviceConfig(prev_device_config);
+    auto query_status = QueryDeviceConfig(prev_device_config, false);
     if (query_status != Status::Ok)
     {
         LOG_ERROR(LOG_TAG, "QueryDeviceConfig failed");
@@ -740,7 +1159,7 @@ Status FaceAuthenticatorImpl::SetDeviceConfig(const DeviceConfig& device_config)
         LOG_ERROR(LOG_TAG, "PreviewMode feature not supported in non advanced mode");
         return Status::Error;
     }
-    auto status = _session.Start(_serial.get());
+    auto status = ResumeSession();
     if (status != PacketManager::SerialStatus::Ok)
     {
         LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
@@ -754,6 +1173,7 @@ Status FaceAuthenticatorImpl::SetDeviceConfig(const DeviceConfig& device_config)
     settings[3] = static_cast<char>(device_config.advanced_mode);
     PacketManager::DataPacket data_packet {PacketManager::MsgId::SetDeviceConfig, settings, sizeof(settings)};
 
+    _host_cache.config_valid = false;
     status = _session.SendPacket(data_packet);
     if (status != PacketManager::SerialStatus::Ok)
     {
@@ -782,13 +1202,15 @@ Status FaceAuthenticatorImpl::SetDeviceConfig(const DeviceConfig& device_config)
         LOG_ERROR(LOG_TAG, "Settings at device were not applied");
         return Status::Error;
     }
+    _host_cache.config = device_config;
+    _host_cache.config_valid = true;
     // convert internal status to api's serial status and return
     return ToStatus(status);
 }
 
-Status FaceAuthenticatorImpl::QueryDeviceConfig(DeviceConfig& device_config)
+Status FaceAuthenticatorImpl::QueryDeviceConfigFromDevice(DeviceConfig& device_config)
 {
-    auto status = _session.Start(_serial.get());
+    auto status = ResumeSession();
     if (status != PacketManager::SerialStatus::Ok)
     {
         LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
@@ -829,11 +1251,8 @@ Status FaceAuthenticatorImpl::QueryDeviceConfig(DeviceConfig& device_config)
     return ToStatus(status);
 }
 
-Status FaceAuthenticatorImpl::QueryUserIds(char** user_ids, unsigned int& number_of_users)
+Status FaceAuthenticatorImpl::QueryUserIdsFromDevice(char** user_ids, unsigned int& number_of_users)
 {
-    unsigned int retrieved_user_count = 0;
-    constexpr unsigned int chunk_size = 5;
-
     if (user_ids == nullptr || number_of_users == 0)
     {
         LOG_ERROR(LOG_TAG, "QueryUserIds: Got invalid params (nullptr or zero)");
@@ -841,98 +1260,178 @@ Status FaceAuthenticatorImpl::QueryUserIds(char** user_ids, unsigned int& number
         return Status::Error;
     }
 
+    unsigned int retrieved_user_count = 0;
+    auto status = StreamUserIdsFromDevice(
+        [&](const char* user_id) {
+            char* target = user_ids[retrieved_user_count++];
+            ::strncpy(target, user_id, PacketManager::MaxUserIdSize);
+            target[PacketManager::MaxUserIdSize] = '\0';
+        },
+        number_of_users);
+    assert(retrieved_user_count <= number_of_users);
+    number_of_users = (status == Status::Ok) ? retrieved_user_count : 0;
+    return status;
+}
+
+Status FaceAuthenticatorImpl::StreamUserIdsFromDevice(const std::function<void(const char*)>& on_user_id,
+                                                      unsigned int max_users)
+{
+    unsigned int retrieved_user_count = 0;
+    constexpr unsigned int chunk_size = 5;
+
     try
     {
-        unsigned int arrived_users = 0;
+        auto status = ResumeSession();
+        if (status != PacketManager::SerialStatus::Ok)
+        {
+            LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
+            return ToStatus(status);
+        }
 
-        for (unsigned int i = 0; i < number_of_users && retrieved_user_count < number_of_users; i += arrived_users)
+        if (_session.SupportsMultiFrame())
         {
-            LOG_DEBUG(LOG_TAG, "Get userids.  So far:%u", i);
-            auto status = _session.Start(_serial.get());
-            if (status != PacketManager::SerialStatus::Ok)
+            return RecvUserIdsMessage(on_user_id, max_users);
+        }
+
+        // chunks are requested at the offsets they would have if all previous chunks are full. a short chunk is the
+        // last one, the replies of the requests after it are drained and ignored.
+        unsigned int requested_user_count = 0;
+        bool reached_end = false;
+        while (true)
+        {
+            while (!reached_end && _session.PendingRequests() < MAX_PENDING_REQUESTS &&
+                   requested_user_count < max_users)
             {
-                LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
-                number_of_users = 0;
-                return ToStatus(status);
+                // retrieve next chunk_size users
+                unsigned int settings[2];
+                settings[0] = requested_user_count;
+                settings[1] = chunk_size;
+
+                auto query_users_packet_lease = _session.Packets().AcquireData(
+                    PacketManager::MsgId::GetUserIds, reinterpret_cast<const char*>(settings), sizeof(settings));
+                auto& query_users_packet = *query_users_packet_lease;
+                status = _session.SendRequest(query_users_packet);
+                if (status != PacketManager::SerialStatus::Ok)
+                {
+                    LOG_ERROR(LOG_TAG, "Failed sending data packet (status %d)", static_cast<int>(status));
+                    return ToStatus(status);
+                }
+                requested_user_count += std::min(chunk_size, max_users - requested_user_count);
             }
-            // retrieve next NUMBER_OF_USERS_TO_QUERY users
-            unsigned int settings[2];
-            settings[0] = retrieved_user_count;
-            settings[1] = chunk_size;
-
-            PacketManager::DataPacket query_users_packet {PacketManager::MsgId::GetUserIds, (char*)settings,
-                                                          sizeof(settings)};
-            status = _session.SendPacket(query_users_packet);
-            if (status != PacketManager::SerialStatus::Ok)
+
+            if (_session.PendingRequests() == 0)
             {
-                LOG_ERROR(LOG_TAG, "Failed sending data packet (status %d)", static_cast<int>(status));
-                number_of_users = 0;
-                return ToStatus(status);
+                break;
             }
 
-            PacketManager::DataPacket reply_packet {PacketManager::MsgId::GetUserIds};
-            status = _session.RecvDataPacket(reply_packet);
+            LOG_DEBUG(LOG_TAG, "Get userids.  So far:%u", retrieved_user_count);
+            auto reply_packet_lease = _session.Packets().AcquireData(PacketManager::MsgId::GetUserIds);
+            auto& reply_packet = *reply_packet_lease;
+            uint32_t request_seq = 0;
+            status = _session.RecvReply(reply_packet, request_seq);
             if (status != PacketManager::SerialStatus::Ok)
             {
                 LOG_ERROR(LOG_TAG, "Failed receiving data packet (status %d)", static_cast<int>(status));
-                number_of_users = 0;
                 return ToStatus(status);
             }
 
-            if (reply_packet.header.id != PacketManager::MsgId::GetUserIds)
+            if (reached_end)
             {
-                LOG_ERROR(LOG_TAG, "Unexpected msg id in reply (%c)", reply_packet.header.id);
-                number_of_users = 0;
-                return Status::Error;
+                continue;
             }
 
             // get number of users from the response
+            unsigned int arrived_users = 0;
             const char* data = reply_packet.Data().data;
             ::memcpy(&arrived_users, data, sizeof(unsigned int));
-            if (arrived_users == 0)
+            if (arrived_users < chunk_size)
             {
-                break;
+                reached_end = true;
             }
 
             // extract user ids from the returned chunk. each user id is zero delimited c string.
+            char user_id[PacketManager::MaxUserIdSize + 1];
             for (size_t j = 0, cur_pos = sizeof(unsigned int); j < arrived_users; j++)
             {
-                if (retrieved_user_count >= number_of_users)
+                if (retrieved_user_count >= max_users)
                 {
+                    reached_end = true;
                     break;
                 }
-                char* target = user_ids[retrieved_user_count];
-                ::strncpy(target, &data[cur_pos], PacketManager::MaxUserIdSize);
-                target[PacketManager::MaxUserIdSize] = '\0';
-                cur_pos += ::strlen(target) + 1;
+                ::strncpy(user_id, &data[cur_pos], PacketManager::MaxUserIdSize);
+                user_id[PacketManager::MaxUserIdSize] = '\0';
+                cur_pos += ::strlen(user_id) + 1;
                 retrieved_user_count++;
+                on_user_id(user_id);
             }
         }
 
-        assert(retrieved_user_count <= number_of_users);
-        number_of_users = retrieved_user_count;
-
         return Status::Ok;
     }
     catch (std::exception& ex)
     {
         LOG_EXCEPTION(LOG_TAG, ex);
-        number_of_users = 0;
         return Status::Error;
     }
     catch (...)
     {
         LOG_ERROR(LOG_TAG, "Unknown exception");
-        number_of_users = 0;
         return Status::Error;
     }
 }
 
-Status FaceAuthenticatorImpl::QueryNumberOfUsers(unsigned int& number_of_users)
+// all the user ids in one multi-frame reply: number of users (uint32), followed by the zero delimited user ids
+Status FaceAuthenticatorImpl::RecvUserIdsMessage(const std::function<void(const char*)>& on_user_id,
+                                                 unsigned int max_users)
+{
+    unsigned int settings[2] = {0, max_users};
+    PacketManager::DataPacket query_users_packet {PacketManager::MsgId::GetUserIds, (char*)settings, sizeof(settings)};
+    auto status = _session.SendPacket(query_users_packet);
+    if (status != PacketManager::SerialStatus::Ok)
+    {
+        LOG_ERROR(LOG_TAG, "Failed sending data packet (status %d)", static_cast<int>(status));
+        return ToStatus(status);
+    }
+
+    std::vector<char> message;
+    status = _session.RecvMessage(PacketManager::MsgId::GetUserIds, message);
+    if (status != PacketManager::SerialStatus::Ok)
+    {
+        LOG_ERROR(LOG_TAG, "Failed receiving user ids message (status %d)", static_cast<int>(status));
+        return ToStatus(status);
+    }
+
+    unsigned int arrived_users = 0;
+    if (message.size() < sizeof(arrived_users))
+    {
+        LOG_ERROR(LOG_TAG, "User ids message too short (%zu bytes)", message.size());
+        return Status::Error;
+    }
+    ::memcpy(&arrived_users, message.data(), sizeof(arrived_users));
+    LOG_DEBUG(LOG_TAG, "Get userids. Arrived:%u", arrived_users);
+
+    char user_id[PacketManager::MaxUserIdSize + 1];
+    for (size_t i = 0, cur_pos = sizeof(arrived_users); i < arrived_users && i < max_users; i++)
+    {
+        if (cur_pos >= message.size())
+        {
+            LOG_ERROR(LOG_TAG, "User ids message truncated after %zu users", i);
+            return Status::Error;
+        }
+        auto id_size = std::min(message.size() - cur_pos, PacketManager::MaxUserIdSize);
+        ::strncpy(user_id, &message[cur_pos], id_size);
+        user_id[id_size] = '\0';
+        cur_pos += ::strlen(user_id) + 1;
+        on_user_id(user_id);
+    }
+    return Status::Ok;
+}
+
+Status FaceAuthenticatorImpl::QueryNumberOfUsersFromDevice(unsigned int& number_of_users)
 {
     try
     {
-        auto status = _session.Start(_serial.get());
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
@@ -983,15 +1482,145 @@ Status FaceAuthenticatorImpl::QueryNumberOfUsers(unsigned int& number_of_users)
     }
 }
 
-Status FaceAuthenticatorImpl::Standby()
+Status FaceAuthenticatorImpl::QueryDeviceConfig(DeviceConfig& device_config, bool force_refresh)
 {
-    try
+    if (_host_cache.enabled && _host_cache.config_valid && !force_refresh)
     {
-        auto status = _session.Start(_serial.get());
-        if (status != PacketManager::SerialStatus::Ok)
-        {
-            LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
-            return ToStatus(status);
+        device_config = _host_cache.config;
+        return Status::Ok;
+    }
+    auto status = QueryDeviceConfigFromDevice(device_config);
+    if (status == Status::Ok)
+    {
+        _host_cache.config = device_config;
+        _host_cache.config_valid = true;
+    }
+    return status;
+}
+
+Status FaceAuthenticatorImpl::QueryUserIds(char** user_ids, unsigned int& number_of_users, bool force_refresh)
+{
+    if (!_host_cache.enabled)
+    {
+        return QueryUserIdsFromDevice(user_ids, number_of_users);
+    }
+
+    if (user_ids == nullptr || number_of_users == 0)
+    {
+        LOG_ERROR(LOG_TAG, "QueryUserIds: Got invalid params (nullptr or zero)");
+        number_of_users = 0;
+        return Status::Error;
+    }
+    if (force_refresh)
+    {
+        _host_cache.users_valid = false;
+    }
+    auto status = RefreshCachedUserIds();
+    if (status != Status::Ok)
+    {
+        number_of_users = 0;
+        return status;
+    }
+
+    const auto& cached_ids = _host_cache.user_ids;
+    number_of_users = std::min(number_of_users, static_cast<unsigned int>(cached_ids.size()));
+    for (unsigned int i = 0; i < number_of_users; i++)
+    {
+        ::strncpy(user_ids[i], cached_ids[i].c_str(), PacketManager::MaxUserIdSize);
+        user_ids[i][PacketManager::MaxUserIdSize] = '\0';
+    }
+    return Status::Ok;
+}
+
+Status FaceAuthenticatorImpl::QueryUserIds(UserIdsCallback& callback, bool force_refresh)
+{
+    if (!_host_cache.enabled)
+    {
+        return StreamUserIdsFromDevice([&callback](const char* user_id) { callback.OnUserId(user_id); },
+                                       std::numeric_limits<unsigned int>::max());
+    }
+
+    if (force_refresh)
+    {
+        _host_cache.users_valid = false;
+    }
+    auto status = RefreshCachedUserIds();
+    if (status != Status::Ok)
+    {
+        return status;
+    }
+    for (const auto& user_id : _host_cache.user_ids)
+    {
+        callback.OnUserId(user_id.c_str());
+    }
+    return Status::Ok;
+}
+
+Status FaceAuthenticatorImpl::QueryNumberOfUsers(unsigned int& number_of_users, bool force_refresh)
+{
+    if (!_host_cache.enabled)
+    {
+        return QueryNumberOfUsersFromDevice(number_of_users);
+    }
+
+    if (force_refresh)
+    {
+        _host_cache.users_valid = false;
+    }
+    auto status = RefreshCachedUserIds();
+    number_of_users = (status == Status::Ok) ? static_cast<unsigned int>(_host_cache.user_ids.size()) : 0;
+    return status;
+}
+
+void FaceAuthenticatorImpl::SetHostCache(bool enable)
+{
+    _host_cache.enabled = enable;
+    _host_cache.Invalidate();
+}
+
+// query the user ids from the device if not cached
+Status FaceAuthenticatorImpl::RefreshCachedUserIds()
+{
+    if (_host_cache.users_valid)
+    {
+        return Status::Ok;
+    }
+
+    std::vector<std::string> user_ids;
+    auto status = StreamUserIdsFromDevice([&user_ids](const char* user_id) { user_ids.emplace_back(user_id); },
+                                          std::numeric_limits<unsigned int>::max());
+    if (status != Status::Ok)
+    {
+        return status;
+    }
+
+    _host_cache.user_ids = std::move(user_ids);
+    _host_cache.users_valid = true;
+    return Status::Ok;
+}
+
+void FaceAuthenticatorImpl::PopulateHostCache()
+{
+    if (!_host_cache.enabled)
+    {
+        return;
+    }
+    DeviceConfig device_config;
+    if (QueryDeviceConfig(device_config, true) != Status::Ok || RefreshCachedUserIds() != Status::Ok)
+    {
+        LOG_WARNING(LOG_TAG, "Failed populating the host cache, will retry on query");
+    }
+}
+
+Status FaceAuthenticatorImpl::Standby()
+{
+    try
+    {
+        auto status = ResumeSession();
+        if (status != PacketManager::SerialStatus::Ok)
+        {
+            LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
+            return ToStatus(status);
         }
 
         PacketManager::DataPacket packet {PacketManager::MsgId::StandBy};
@@ -1025,6 +1654,179 @@ Status FaceAuthenticatorImpl::Standby()
     }
 }
 
+Status FaceAuthenticatorImpl::Prewarm(unsigned int hold_ms)
+{
+    Trace::Scope trace {"Prewarm", "link"};
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        // wake the device up (a lost connection is reopened by the session start below)
+        if (_serial)
+        {
+            PacketManager::Timer wake_timer {WAKE_TIMEOUT};
+            auto status = Ping(WAKE_PING_TIMEOUT_MS);
+            while (status != Status::Ok && !wake_timer.ReachedTimeout())
+            {
+                status = Ping(WAKE_PING_TIMEOUT_MS);
+            }
+            if (status != Status::Ok)
+            {
+                LOG_WARNING(LOG_TAG, "Device did not answer the wake up pings (status %d)", static_cast<int>(status));
+            }
+        }
+
+        auto status = ResumeSession();
+        if (status != PacketManager::SerialStatus::Ok)
+        {
+            LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
+            return ToStatus(status);
+        }
+        _session.HoldForNextResume(PacketManager::timeout_t {hold_ms});
+    }
+    catch (std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+        return Status::Error;
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Unknown exception");
+        return Status::Error;
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    Metrics::Record(Metrics::Latency::Wake, elapsed);
+    Metrics::Add(Metrics::Counter::Prewarms);
+    LOG_DEBUG(LOG_TAG, "Prewarmed in %lld ms",
+              static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()));
+    return Status::Ok;
+}
+
+Status FaceAuthenticatorImpl::ExchangePing(char* ping_data, char* reply_data, unsigned int timeout_ms)
+{
+    using namespace PacketManager;
+    if (!_serial)
+    {
+        LOG_ERROR(LOG_TAG, "Not connected to a serial port");
+        return Status::Error;
+    }
+    try
+    {
+        uint32_t ping_number = 0;
+        ::memcpy(&ping_number, ping_data, sizeof(ping_number));
+        DataPacket packet {MsgId::Ping, ping_data, PING_DATA_SIZE};
+
+        PacketSender sender {_serial.get()};
+        auto status = sender.SendBinary(packet);
+        if (status != SerialStatus::Ok)
+        {
+            LOG_ERROR(LOG_TAG, "Failed sending ping packet (status %d)", static_cast<int>(status));
+            return ToStatus(status);
+        }
+        Timer deadline {timeout_t {timeout_ms}};
+        uint32_t reply_number = 0;
+        do
+        {
+            status = sender.Recv(packet, &deadline);
+            if (status != SerialStatus::Ok)
+            {
+                LOG_ERROR(LOG_TAG, "Failed receiving ping reply (status %d)", static_cast<int>(status));
+                return ToStatus(status);
+            }
+            ::memcpy(&reply_number, packet.Data().data, sizeof(reply_number));
+        } while (packet.header.id == MsgId::Ping && reply_number < ping_number);
+        if (packet.header.id != MsgId::Ping || reply_number != ping_number)
+        {
+            LOG_ERROR(LOG_TAG, "Got unexpected ping reply '%c'", static_cast<char>(packet.header.id));
+            return Status::Error;
+        }
+        ::memcpy(reply_data, packet.Data().data, PING_DATA_SIZE);
+        return Status::Ok;
+    }
+    catch (std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+        return Status::Error;
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Unknown exception");
+        return Status::Error;
+    }
+}
+
+Status FaceAuthenticatorImpl::Ping(unsigned int timeout_ms)
+{
+    // a numbered ping, the late replies of earlier ones are skipped
+    char ping_data[PING_DATA_SIZE] = {0};
+    auto ping_number = ++_ping_number;
+    ::memcpy(ping_data, &ping_number, sizeof(ping_number));
+    char reply_data[PING_DATA_SIZE];
+    auto status = ExchangePing(ping_data, reply_data, timeout_ms);
+    if (status != Status::Ok)
+    {
+        return status;
+    }
+    if (::memcmp(reply_data, ping_data, sizeof(ping_data)) != 0)
+    {
+        LOG_ERROR(LOG_TAG, "Got a ping reply that is not an echo");
+        return Status::Error;
+    }
+    return Status::Ok;
+}
+
+Status FaceAuthenticatorImpl::SyncClock(unsigned int exchanges, unsigned int timeout_ms)
+{
+    using namespace PacketManager;
+    static_assert(sizeof(ClockSyncPing) <= PING_DATA_SIZE, "clock sync ping doesn't fit a ping");
+    Trace::Scope trace {"SyncClock", "link"};
+    for (unsigned int i = 0; i < exchanges; i++)
+    {
+        ClockSyncPing ping {++_ping_number, ClockSyncMagic, 0, 0};
+        char ping_data[PING_DATA_SIZE] = {0};
+        ::memcpy(ping_data, &ping, sizeof(ping));
+        char reply_data[PING_DATA_SIZE];
+
+        auto host_send = ClockSync::HostNowUs();
+        auto status = ExchangePing(ping_data, reply_data, timeout_ms);
+        auto host_receive = ClockSync::HostNowUs();
+        if (status != Status::Ok)
+        {
+            return status;
+        }
+        ClockSyncPing reply;
+        ::memcpy(&reply, reply_data, sizeof(reply));
+        if (reply.magic != ClockSyncMagic || (reply.device_receive_us == 0 && reply.device_send_us == 0))
+        {
+            LOG_ERROR(LOG_TAG, "Device doesn't stamp the clock sync pings");
+            return Status::VersionMismatch;
+        }
+        _clock_sync.AddExchange(host_send, reply.device_receive_us, reply.device_send_us, host_receive);
+        ClockSync::Shared().AddExchange(host_send, reply.device_receive_us, reply.device_send_us, host_receive);
+        auto device_time = reply.device_send_us >= reply.device_receive_us
+                               ? reply.device_send_us - reply.device_receive_us
+                               : 0;
+        auto round_trip = host_receive - host_send;
+        Metrics::RecordUs(Metrics::Latency::ClockSync, round_trip > device_time ? round_trip - device_time : 0);
+    }
+    auto state = _clock_sync.State();
+    trace.SetValue(state.offsetUs);
+    Trace::Counter("clock_offset_us", state.offsetUs);
+    LOG_DEBUG(LOG_TAG, "Clock offset %lld us (rtt %u us, drift %.2f ppm, %u exchanges)",
+              static_cast<long long>(state.offsetUs), state.rttUs, state.driftPpm, state.exchanges);
+    return Status::Ok;
+}
+
+ClockSyncState FaceAuthenticatorImpl::GetClockSync() const
+{
+    return _clock_sync.State();
+}
+
+bool FaceAuthenticatorImpl::DeviceTimeToHost(uint64_t device_us, uint64_t& host_us) const
+{
+    return _clock_sync.DeviceToHost(device_us, host_us);
+}
+
 // Do faceprints extraction using enrollment flow, on the device.
 // If faceprints extraction was successful, the device will send a MsgId::Result with a Success value,
 // then the host listens for a DataPacket which contains Faceprints from the device, and finally a MsgId::Reply to
@@ -1034,9 +1836,11 @@ Status FaceAuthenticatorImpl::Standby()
 //      Unexpected msg_id in the fa response.
 Status FaceAuthenticatorImpl::ExtractFaceprintsForEnroll(EnrollFaceprintsExtractionCallback& callback)
 {
+    Trace::Scope flow_trace {"ExtractFaceprintsForEnroll", "flow"};
+    Metrics::ScopedLatency flow_latency {Metrics::Latency::ExtractFaceprints};
     try
     {
-        auto status = _session.Start(_serial.get());
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
@@ -1045,7 +1849,9 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForEnroll(EnrollFaceprintsExtract
             return ToStatus(status);
         }
 
-        PacketManager::FaPacket fa_packet {PacketManager::MsgId::EnrollFaceprintsExtraction, nullptr, '0'};
+        auto fa_packet_lease =
+            _session.Packets().AcquireFa(PacketManager::MsgId::EnrollFaceprintsExtraction, nullptr, '0');
+        auto& fa_packet = *fa_packet_lease;
         status = _session.SendPacket(fa_packet);
         if (status != PacketManager::SerialStatus::Ok)
         {
@@ -1056,21 +1862,35 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForEnroll(EnrollFaceprintsExtract
         }
 
         PacketManager::Timer session_timer {CommonValues::enroll_max_timeout};
+        bool session_cancelled = false;
 
         bool faceprints_extraction_completed_on_device = false, received_faceprints_in_host = false;
         while (true)
         {
             if (session_timer.ReachedTimeout())
             {
+                if (session_cancelled)
+                {
+                    LOG_ERROR(LOG_TAG, "no reply to cancel after session timeout");
+                    return Status::Error;
+                }
                 LOG_ERROR(LOG_TAG, "session timeout");
                 callback.OnResult(EnrollStatus::Failure, nullptr);
                 Cancel();
+                // give the device time to reply to the cancel
+                session_timer = PacketManager::Timer {CANCEL_REPLY_TIMEOUT};
+                session_cancelled = true;
             }
 
             if (faceprints_extraction_completed_on_device && !received_faceprints_in_host)
             {
-                PacketManager::DataPacket data_packet(PacketManager::MsgId::Faceprints);
-                status = _session.RecvDataPacket(data_packet);
+                auto data_packet_lease = _session.Packets().AcquireData(PacketManager::MsgId::Faceprints);
+                auto& data_packet = *data_packet_lease;
+                status = _session.RecvDataPacket(data_packet, &session_timer);
+                if (status == PacketManager::SerialStatus::RecvTimeout && session_timer.ReachedTimeout())
+                {
+                    continue; // handle the session timeout
+                }
                 if (status != PacketManager::SerialStatus::Ok)
                 {
                     LOG_ERROR(LOG_TAG, "Failed receiving data packet (status %d)", (int)status);
@@ -1113,7 +1933,11 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForEnroll(EnrollFaceprintsExtract
                 }
             }
 
-            status = _session.RecvPacket(fa_packet);
+            status = _session.RecvPacket(fa_packet, &session_timer);
+            if (status == PacketManager::SerialStatus::RecvTimeout && session_timer.ReachedTimeout())
+            {
+                continue; // handle the session timeout
+            }
             if (status != PacketManager::SerialStatus::Ok)
             {
                 LOG_ERROR(LOG_TAG, "Failed receiving fa packet (status %d)", (int)status);
@@ -1127,9 +1951,10 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForEnroll(EnrollFaceprintsExtract
             // handle face detected as data packet
             if (msg_id == PacketManager::MsgId::FaceDetected)
             {
-                auto faces = GetDetectedFaces(fa_packet);
-                LOG_INFO("ExtractFaceprintsForAuth", "OnFaceDetected %u faces", static_cast<unsigned>(faces.size()));
-                callback.OnFaceDetected(faces);
+                FaceRect faces[MAX_FACES];
+                auto n_faces = GetDetectedFaces(fa_packet, faces);
+                LOG_INFO("ExtractFaceprintsForAuth", "OnFaceDetected %u faces", n_faces);
+                callback.OnFacesDetected(faces, n_faces);
                 continue; // continue to recv next messages
             }
 
@@ -1141,6 +1966,7 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForEnroll(EnrollFaceprintsExtract
                 return Status::Ok;
 
             case (PacketManager::MsgId::Result):
+                Trace::Instant("DeviceResult", "device", fa_status);
                 if (EnrollStatus(fa_status) == EnrollStatus::Success)
                 {
                     LOG_DEBUG(LOG_TAG,
@@ -1186,45 +2012,62 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForEnroll(EnrollFaceprintsExtract
 //      Unexpected msg_id in the fa response.
 Status FaceAuthenticatorImpl::ExtractFaceprintsForAuth(AuthFaceprintsExtractionCallback& callback)
 {
+    Trace::Scope flow_trace {"ExtractFaceprintsForAuth", "flow"};
+    Metrics::ScopedLatency flow_latency {Metrics::Latency::ExtractFaceprints};
     try
     {
-        auto status = _session.Start(_serial.get());
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
             auto auth_status = ToAuthStatus(status);
-            callback.OnResult(auth_status, nullptr);
+            callback.OnQueryResult(auth_status, nullptr);
             return ToStatus(status);
         }
-        PacketManager::FaPacket fa_packet {PacketManager::MsgId::AuthenticateFaceprintsExtraction};
+        auto fa_packet_lease = _session.Packets().AcquireFa(PacketManager::MsgId::AuthenticateFaceprintsExtraction);
+        auto& fa_packet = *fa_packet_lease;
         status = _session.SendPacket(fa_packet);
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Failed sending fa packet (status %d)", (int)status);
             auto auth_status = ToAuthStatus(status);
-            callback.OnResult(auth_status, nullptr);
+            callback.OnQueryResult(auth_status, nullptr);
             return ToStatus(status);
         }
         PacketManager::Timer session_timer {CommonValues::auth_max_timeout};
+        bool session_cancelled = false;
         bool faceprints_extraction_completed_on_device = false, received_faceprints_in_host = false;
         while (true)
         {
             if (session_timer.ReachedTimeout())
             {
+                if (session_cancelled)
+                {
+                    LOG_ERROR(LOG_TAG, "no reply to cancel after session timeout");
+                    return Status::Error;
+                }
                 LOG_ERROR(LOG_TAG, "session timeout");
-                callback.OnResult(AuthenticateStatus::Failure, nullptr);
+                callback.OnQueryResult(AuthenticateStatus::Failure, nullptr);
                 Cancel();
+                // give the device time to reply to the cancel
+                session_timer = PacketManager::Timer {CANCEL_REPLY_TIMEOUT};
+                session_cancelled = true;
             }
 
             if (faceprints_extraction_completed_on_device && !received_faceprints_in_host)
             {
-                PacketManager::DataPacket data_packet(PacketManager::MsgId::Faceprints);
-                status = _session.RecvDataPacket(data_packet);
+                auto data_packet_lease = _session.Packets().AcquireData(PacketManager::MsgId::Faceprints);
+                auto& data_packet = *data_packet_lease;
+                status = _session.RecvDataPacket(data_packet, &session_timer);
+                if (status == PacketManager::SerialStatus::RecvTimeout && session_timer.ReachedTimeout())
+                {
+                    continue; // handle the session timeout
+                }
                 if (status != PacketManager::SerialStatus::Ok)
                 {
                     LOG_ERROR(LOG_TAG, "Failed receiving data packet (status %d)", (int)status);
                     auto auth_status = ToAuthStatus(status);
-                    callback.OnResult(auth_status, nullptr);
+                    callback.OnQueryResult(auth_status, nullptr);
                     return ToStatus(status);
                 }
 
@@ -1237,15 +2080,15 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuth(AuthFaceprintsExtractionC
 
                     received_faceprints_in_host = true;
 
-                    Faceprints faceprints;
+                    QueryFaceprints query;
 
-                    faceprints.numberOfDescriptors = received_desc->numberOfDescriptors;
-                    faceprints.version = received_desc->version;
-                    static_assert(sizeof(faceprints.avgDescriptor) == sizeof(received_desc->avgDescriptor),
+                    query.version = received_desc->version;
+                    query.numberOfDescriptors = received_desc->numberOfDescriptors;
+                    static_assert(sizeof(query.descriptor) == sizeof(received_desc->avgDescriptor),
                                   "faceprints sizes does not match");
-                    ::memcpy(faceprints.avgDescriptor, received_desc->avgDescriptor, sizeof(faceprints.avgDescriptor));
+                    ::memcpy(query.descriptor, received_desc->avgDescriptor, sizeof(query.descriptor));
 
-                    callback.OnResult(AuthenticateStatus::Success, &faceprints);
+                    callback.OnQueryResult(AuthenticateStatus::Success, &query);
                     continue;
                 }
                 else
@@ -1256,7 +2099,11 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuth(AuthFaceprintsExtractionC
                 }
             }
 
-            status = _session.RecvPacket(fa_packet);
+            status = _session.RecvPacket(fa_packet, &session_timer);
+            if (status == PacketManager::SerialStatus::RecvTimeout && session_timer.ReachedTimeout())
+            {
+                continue; // handle the session timeout
+            }
             if (status != PacketManager::SerialStatus::Ok)
             {
                 LOG_ERROR(LOG_TAG, "Failed receiving fa packet (status %d)", (int)status);
@@ -1270,9 +2117,10 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuth(AuthFaceprintsExtractionC
             // handle face detected as data packet
             if (msg_id == PacketManager::MsgId::FaceDetected)
             {
-                auto faces = GetDetectedFaces(fa_packet);
-                LOG_INFO("ExtractFaceprintsForAuth", "OnFaceDetected %u faces", static_cast<unsigned>(faces.size()));
-                callback.OnFaceDetected(faces);
+                FaceRect faces[MAX_FACES];
+                auto n_faces = GetDetectedFaces(fa_packet, faces);
+                LOG_INFO("ExtractFaceprintsForAuth", "OnFaceDetected %u faces", n_faces);
+                callback.OnFacesDetected(faces, n_faces);
                 continue; // continue to recv next messages
             }
 
@@ -1284,6 +2132,7 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuth(AuthFaceprintsExtractionC
                 return Status::Ok;
 
             case (PacketManager::MsgId::Result): {
+                Trace::Instant("DeviceResult", "device", fa_status);
                 if (AuthenticateStatus(fa_status) == AuthenticateStatus::Success)
                 {
                     LOG_DEBUG(LOG_TAG,
@@ -1291,7 +2140,7 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuth(AuthFaceprintsExtractionC
                     faceprints_extraction_completed_on_device = true;
                 }
                 else
-                    callback.OnResult(AuthenticateStatus(fa_status), nullptr);
+                    callback.OnQueryResult(AuthenticateStatus(fa_status), nullptr);
                 break;
             }
 
@@ -1314,7 +2163,7 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuth(AuthFaceprintsExtractionC
     catch (...)
     {
         LOG_ERROR(LOG_TAG, "Unknown exception");
-        callback.OnResult(AuthenticateStatus::Failure, nullptr);
+        callback.OnQueryResult(AuthenticateStatus::Failure, nullptr);
         return Status::Error;
     }
 }
@@ -1324,23 +2173,38 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuth(AuthFaceprintsExtractionC
 //      We get 'reply' from device ('Y' , would happen if "cancel" command was sent by a different thread to this
 //      device). Any non ok status from the session object(i.e. serial comm failed, or session timeout). Unexpected
 //      msg_id in the fa response.
-Status FaceAuthenticatorImpl::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtractionCallback& callback)
+Status FaceAuthenticatorImpl::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtractionCallback& callback,
+                                                           unsigned int max_faces)
 {
+    Trace::Scope flow_trace {"ExtractFaceprintsForAuthLoop", "flow"};
+    if (max_faces < 1 || max_faces > PacketManager::MaxMultiFaces)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid max faces %u", max_faces);
+        return Status::Error;
+    }
     try
     {
-        auto status = _session.Start(_serial.get());
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
-            callback.OnResult(ToAuthStatus(status), nullptr);
+            callback.OnQueryResult(ToAuthStatus(status), nullptr);
             return ToStatus(status);
         }
-        PacketManager::FaPacket fa_packet {PacketManager::MsgId::AuthenticateLoopFaceprintsExtraction};
+        // the firmware extracts several faces per frame if it answered the session start with MultiFaceProtocolVer
+        const bool multi_face = max_faces > 1 && _session.SupportsMultiFace();
+        if (max_faces > 1 && !multi_face)
+        {
+            LOG_WARNING(LOG_TAG, "Firmware extracts a single face per frame");
+        }
+        auto fa_packet_lease = _session.Packets().AcquireFa(PacketManager::MsgId::AuthenticateLoopFaceprintsExtraction,
+                                                            nullptr, multi_face ? static_cast<char>(max_faces) : 0);
+        auto& fa_packet = *fa_packet_lease;
         status = _session.SendPacket(fa_packet);
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Failed sending fa packet (status %d)", (int)status);
-            callback.OnResult(ToAuthStatus(status), nullptr);
+            callback.OnQueryResult(ToAuthStatus(status), nullptr);
             return ToStatus(status);
         }
 
@@ -1348,11 +2212,31 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtract
         const int max_retries = 3;
         int retry_counter = 0;
         bool faceprints_extraction_completed_on_device = false, received_faceprints_in_host = false;
+        std::vector<char> multi_face_message; // reused by the frames of the loop
         while (true)
         {
+            if (faceprints_extraction_completed_on_device && multi_face)
+            {
+                faceprints_extraction_completed_on_device = false;
+                status = _session.RecvMessage(PacketManager::MsgId::MultiFaceprints, multi_face_message);
+                if (status != PacketManager::SerialStatus::Ok)
+                {
+                    LOG_ERROR(LOG_TAG, "Failed receiving multi-face faceprints (status %d)", (int)status);
+                    callback.OnHint(ToAuthStatus(status));
+                    return ToStatus(status);
+                }
+                QueryFaceprints queries[PacketManager::MaxMultiFaces];
+                FaceRect faces[PacketManager::MaxMultiFaces];
+                auto n_faces = GetMultiFaceprints(multi_face_message, queries, faces);
+                LOG_DEBUG(LOG_TAG, "Got faceprints of %u faces from device!", n_faces);
+                callback.OnQueryResults(AuthenticateStatus::Success, queries, faces, n_faces);
+                continue;
+            }
+
             if (faceprints_extraction_completed_on_device && !received_faceprints_in_host)
             {
-                PacketManager::DataPacket data_packet(PacketManager::MsgId::Faceprints);
+                auto data_packet_lease = _session.Packets().AcquireData(PacketManager::MsgId::Faceprints);
+                auto& data_packet = *data_packet_lease;
                 status = _session.RecvDataPacket(data_packet);
                 if (status != PacketManager::SerialStatus::Ok)
                 {
@@ -1360,6 +2244,7 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtract
                     callback.OnHint(ToAuthStatus(status));
                     if (++retry_counter <= max_retries)
                     {
+                        Metrics::Add(Metrics::Counter::PacketRetries);
                         LOG_WARNING(LOG_TAG, "Timeout waiting for packet (try #%d)", retry_counter);
                         continue;
                     }
@@ -1375,15 +2260,15 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtract
                     SecureVersionDescriptor* received_desc =
                         (SecureVersionDescriptor*)(data_packet.payload.message.data_msg.data);
 
-                    Faceprints faceprints;
+                    QueryFaceprints query;
 
-                    faceprints.numberOfDescriptors = received_desc->numberOfDescriptors;
-                    faceprints.version = received_desc->version;
-                    static_assert(sizeof(faceprints.avgDescriptor) == sizeof(received_desc->avgDescriptor),
+                    query.version = received_desc->version;
+                    query.numberOfDescriptors = received_desc->numberOfDescriptors;
+                    static_assert(sizeof(query.descriptor) == sizeof(received_desc->avgDescriptor),
                                   "faceprints sizes does not match");
-                    ::memcpy(faceprints.avgDescriptor, received_desc->avgDescriptor, sizeof(faceprints.avgDescriptor));
+                    ::memcpy(query.descriptor, received_desc->avgDescriptor, sizeof(query.descriptor));
 
-                    callback.OnResult(AuthenticateStatus(AuthenticateStatus::Success), &faceprints);
+                    callback.OnQueryResult(AuthenticateStatus(AuthenticateStatus::Success), &query);
                     continue;
                 }
                 else
@@ -1401,6 +2286,7 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtract
                 callback.OnHint(ToAuthStatus(status));
                 if (++retry_counter <= max_retries)
                 {
+                    Metrics::Add(Metrics::Counter::PacketRetries);
                     LOG_WARNING(LOG_TAG, "Timeout waiting for packet (try #%d)", retry_counter);
                     continue;
                 }
@@ -1413,9 +2299,10 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtract
              // handle face detected as data packet
             if (msg_id == PacketManager::MsgId::FaceDetected)
             {
-                auto faces = GetDetectedFaces(fa_packet);
-                LOG_INFO("ExtractFaceprintsForAuth", "OnFaceDetected %u faces", static_cast<unsigned>(faces.size()));
-                callback.OnFaceDetected(faces);
+                FaceRect faces[MAX_FACES];
+                auto n_faces = GetDetectedFaces(fa_packet, faces);
+                LOG_INFO("ExtractFaceprintsForAuth", "OnFaceDetected %u faces", n_faces);
+                callback.OnFacesDetected(faces, n_faces);
                 continue; // continue to recv next messages
             }
 
@@ -1428,14 +2315,17 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtract
                 return Status::Ok;
 
             case (PacketManager::MsgId::Result): {
+                Trace::Instant("DeviceResult", "device", fa_status);
                 if (AuthenticateStatus(fa_status) == AuthenticateStatus::Success)
                 {
                     LOG_DEBUG(LOG_TAG,
                               "Faceprints extraction succeeded on device, ready to receive faceprints in host ...");
                     faceprints_extraction_completed_on_device = true;
                 }
+                else if (multi_face)
+                    callback.OnQueryResults(AuthenticateStatus(fa_status), nullptr, nullptr, 0);
                 else
-                    callback.OnResult(AuthenticateStatus(fa_status), nullptr);
+                    callback.OnQueryResult(AuthenticateStatus(fa_status), nullptr);
                 break;
             }
 
@@ -1445,7 +2335,7 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtract
 
             default:
                 LOG_ERROR(LOG_TAG, "Got unexpected msg id in response: %d", (int)msg_id);
-                callback.OnResult(AuthenticateStatus::Failure, nullptr);
+                callback.OnQueryResult(AuthenticateStatus::Failure, nullptr);
                 return Status::Error;
             }
         }
@@ -1453,13 +2343,13 @@ Status FaceAuthenticatorImpl::ExtractFaceprintsForAuthLoop(AuthFaceprintsExtract
     catch (std::exception& ex)
     {
         LOG_EXCEPTION(LOG_TAG, ex);
-        callback.OnResult(AuthenticateStatus::Failure, nullptr);
+        callback.OnQueryResult(AuthenticateStatus::Failure, nullptr);
         return Status::Error;
     }
     catch (...)
     {
         LOG_ERROR(LOG_TAG, "Unknown exception");
-        callback.OnResult(AuthenticateStatus::Failure, nullptr);
+        callback.OnQueryResult(AuthenticateStatus::Failure, nullptr);
         return Status::Error;
     }
 }
@@ -1478,6 +2368,46 @@ MatchResultHost FaceAuthenticatorImpl::MatchFaceprints(Faceprints& new_faceprint
     return finalResult;
 }
 
+// pack the array into a gallery, so the 1:N search is a single streaming pass over it
+static bool PackGallery(const Faceprints* existing_faceprints_array, size_t count, HostFaceprintsGallery& gallery)
+{
+    if (existing_faceprints_array == nullptr && count > 0)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid faceprints array: nullptr");
+        return false;
+    }
+    gallery.Reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        gallery.Add(nullptr, existing_faceprints_array[i]);
+    }
+    return true;
+}
+
+MatchArrayResultHost FaceAuthenticatorImpl::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                                   const Faceprints* existing_faceprints_array,
+                                                                   size_t count, Faceprints& updated_faceprints)
+{
+    HostFaceprintsGallery gallery;
+    if (!PackGallery(existing_faceprints_array, count, gallery))
+    {
+        return MatchArrayResultHost {};
+    }
+    return gallery.Match(new_faceprints, updated_faceprints);
+}
+
+size_t FaceAuthenticatorImpl::MatchFaceprintsTopK(const Faceprints& new_faceprints,
+                                                  const Faceprints* existing_faceprints_array, size_t count, size_t k,
+                                                  MatchCandidateHost* candidates)
+{
+    HostFaceprintsGallery gallery;
+    if (!PackGallery(existing_faceprints_array, count, gallery))
+    {
+        return 0;
+    }
+    return gallery.MatchTopK(new_faceprints, k, candidates);
+}
+
 // Validate given user id.
 // Return true if valid, false otherwise.
 bool FaceAuthenticatorImpl::ValidateUserId(const char* user_id)
@@ -1507,7 +2437,7 @@ Status FaceAuthenticatorImpl::GetUserFeatures(const char* user_id, Faceprints& u
             return Status::Error;
         }
 
-        auto status = _session.Start(_serial.get());
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
@@ -1518,7 +2448,7 @@ Status FaceAuthenticatorImpl::GetUserFeatures(const char* user_id, Faceprints& u
         writable.push_back('\0');
 
         PacketManager::DataPacket get_features_packet {PacketManager::MsgId::GetUserFeatures, writable.data(),
-                                                       sizeof(user_id)};
+                                                       writable.size()};
         status = _session.SendPacket(get_features_packet);
         if (status != PacketManager::SerialStatus::Ok)
         {
@@ -1526,7 +2456,8 @@ Status FaceAuthenticatorImpl::GetUserFeatures(const char* user_id, Faceprints& u
             return ToStatus(status);
         }
 
-        PacketManager::DataPacket get_features_return_packet {PacketManager::MsgId::GetUserFeatures};
+        auto get_features_return_packet_lease = _session.Packets().AcquireData(PacketManager::MsgId::GetUserFeatures);
+        auto& get_features_return_packet = *get_features_return_packet_lease;
         status = _session.RecvDataPacket(get_features_return_packet);
         if (status != PacketManager::SerialStatus::Ok)
         {
@@ -1549,6 +2480,7 @@ Status FaceAuthenticatorImpl::GetUserFeatures(const char* user_id, Faceprints& u
             
             ::memcpy(user_faceprints.avgDescriptor, desc->avgDescriptor, sizeof(desc->avgDescriptor));
             ::memcpy(user_faceprints.origDescriptor, desc->origDescriptor, sizeof(desc->origDescriptor));
+            RecordDigest(user_id, user_faceprints);
         }
         else
         {
@@ -1579,7 +2511,8 @@ Status FaceAuthenticatorImpl::SetUserFeatures(const char* user_id, Faceprints& u
         {
             return Status::Error;
         }
-        auto status = _session.Start(_serial.get());
+        _host_cache.users_valid = false; // the device's user list may change from here on
+        auto status = ResumeSession();
         if (status != PacketManager::SerialStatus::Ok)
         {
             LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
@@ -1618,6 +2551,7 @@ Status FaceAuthenticatorImpl::SetUserFeatures(const char* user_id, Faceprints& u
             return ToStatus(status);
         }
 
+        RecordDigest(user_id, user_faceprints);
         return ToStatus(status);
     }
     catch (std::exception& ex)
@@ -1631,5 +2565,398 @@ Status FaceAuthenticatorImpl::SetUserFeatures(const char* user_id, Faceprints& u
     return Status::Error;
 }
 
+// the features of a user as sent in a SetUserFeatures packet: zero padded user id followed by the descriptor
+static size_t SerializeUserFeatures(const char* user_id, const Faceprints& user_faceprints, char* buffer)
+{
+    ::memset(buffer, '\0', PacketManager::MaxUserIdSize + 1);
+    ::strncpy(buffer, user_id, PacketManager::MaxUserIdSize);
+    size_t offset = PacketManager::MaxUserIdSize + 1;
+    static_assert(sizeof(SecureVersionDescriptor) <= sizeof(Faceprints), "descriptor does not fit faceprints");
+    ::memcpy(buffer + offset, &user_faceprints, sizeof(SecureVersionDescriptor));
+    return offset + sizeof(SecureVersionDescriptor);
+}
+
+static void DeserializeUserFeatures(const PacketManager::DataPacket& packet, Faceprints& user_faceprints)
+{
+    const SecureVersionDescriptor* desc = (const SecureVersionDescriptor*)(packet.payload.message.data_msg.data);
+    user_faceprints.version = desc->version;
+    user_faceprints.numberOfDescriptors = desc->numberOfDescriptors;
+    user_faceprints.featuresType = (FaceprintsTypeEnum)desc->faceprintsType;
+    static_assert(sizeof(user_faceprints.avgDescriptor) == sizeof(desc->avgDescriptor),
+                  "faceprints sizes does not match");
+    ::memcpy(user_faceprints.avgDescriptor, desc->avgDescriptor, sizeof(desc->avgDescriptor));
+    ::memcpy(user_faceprints.origDescriptor, desc->origDescriptor, sizeof(desc->origDescriptor));
+}
+
+void FaceAuthenticatorImpl::DrainPendingReplies()
+{
+    while (_session.PendingRequests() > 0)
+    {
+        auto reply_packet_lease = _session.Packets().AcquireData(PacketManager::MsgId::None);
+        auto& reply_packet = *reply_packet_lease;
+        uint32_t request_seq = 0;
+        auto status = _session.RecvReply(reply_packet, request_seq);
+        // stop if the device stopped replying
+        if (status != PacketManager::SerialStatus::Ok && status != PacketManager::SerialStatus::RecvUnexpectedPacket)
+        {
+            LOG_DEBUG(LOG_TAG, "Stopped draining replies (status %d)", static_cast<int>(status));
+            return;
+        }
+    }
+}
+
+Status FaceAuthenticatorImpl::ExportAllFeatures(FeaturesExportCallback& callback)
+{
+    try
+    {
+        unsigned int number_of_users = 0;
+        auto rv = QueryNumberOfUsers(number_of_users, false);
+        if (rv != Status::Ok)
+        {
+            return rv;
+        }
+        if (number_of_users == 0)
+        {
+            return Status::Ok;
+        }
+
+        std::vector<char> user_ids_buffer(number_of_users * (PacketManager::MaxUserIdSize + 1), '\0');
+        std::vector<char*> user_ids(number_of_users);
+        for (unsigned int i = 0; i < number_of_users; i++)
+        {
+            user_ids[i] = &user_ids_buffer[i * (PacketManager::MaxUserIdSize + 1)];
+        }
+        rv = QueryUserIds(user_ids.data(), number_of_users, false);
+        if (rv != Status::Ok)
+        {
+            return rv;
+        }
+        return ExportFeatures(user_ids.data(), number_of_users, callback);
+    }
+    catch (std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Unknown exception");
+    }
+    return Status::Error;
+}
+
+Status FaceAuthenticatorImpl::ExportFeatures(const char* const* user_ids, unsigned int number_of_users,
+                                             FeaturesExportCallback& callback)
+{
+    if (user_ids == nullptr && number_of_users > 0)
+    {
+        LOG_ERROR(LOG_TAG, "ExportFeatures: Got invalid params (nullptr)");
+        return Status::Error;
+    }
+    for (unsigned int i = 0; i < number_of_users; i++)
+    {
+        if (!ValidateUserId(user_ids[i]))
+        {
+            return Status::Error;
+        }
+    }
+    if (number_of_users == 0)
+    {
+        return Status::Ok;
+    }
+
+    try
+    {
+        TransferCoordinator::Scope transfer {_transfer_coordinator};
+        auto status = ResumeSession();
+        if (status != PacketManager::SerialStatus::Ok)
+        {
+            LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
+            return ToStatus(status);
+        }
+
+        unsigned int requested_users = 0;
+        unsigned int exported_users = 0;
+        Faceprints user_faceprints;
+        while (exported_users < number_of_users)
+        {
+            while (requested_users < number_of_users && _session.PendingRequests() < MAX_PENDING_REQUESTS)
+            {
+                const char* user_id = user_ids[requested_users];
+                auto get_features_packet_lease = _session.Packets().AcquireData(
+                    PacketManager::MsgId::GetUserFeatures, user_id, ::strlen(user_id) + 1);
+                auto& get_features_packet = *get_features_packet_lease;
+                status = _session.SendRequest(get_features_packet);
+                if (status != PacketManager::SerialStatus::Ok)
+                {
+                    LOG_ERROR(LOG_TAG, "Failed sending data packet (status %d)", (int)status);
+                    DrainPendingReplies();
+                    return ToStatus(status);
+                }
+                requested_users++;
+            }
+
+            auto reply_packet_lease = _session.Packets().AcquireData(PacketManager::MsgId::GetUserFeatures);
+            auto& reply_packet = *reply_packet_lease;
+            uint32_t request_seq = 0;
+            status = _session.RecvReply(reply_packet, request_seq);
+            if (status != PacketManager::SerialStatus::Ok)
+            {
+                LOG_ERROR(LOG_TAG, "Failed receiving features of user %u (status %d)", exported_users, (int)status);
+                DrainPendingReplies();
+                return ToStatus(status);
+            }
+
+            DeserializeUserFeatures(reply_packet, user_faceprints);
+            RecordDigest(user_ids[exported_users], user_faceprints);
+            callback.OnUserFeatures(user_ids[exported_users], user_faceprints);
+            exported_users++;
+            callback.OnProgress(exported_users, number_of_users);
+        }
+
+        LOG_DEBUG(LOG_TAG, "Exported features of %u users", exported_users);
+        return Status::Ok;
+    }
+    catch (std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Unknown exception");
+    }
+    return Status::Error;
+}
+
+void FaceAuthenticatorImpl::RecordDigest(const char* user_id, const Faceprints& faceprints)
+{
+    const auto hash = FeaturesHash(faceprints);
+    auto it = _user_digests.find(user_id);
+    if (it == _user_digests.end())
+    {
+        DigestEntry entry;
+        entry.known = true;
+        entry.features_hash = hash;
+        _user_digests.emplace(user_id, entry);
+        return;
+    }
+    auto& entry = it->second;
+    if (entry.features_hash != hash)
+    {
+        entry.features_hash = hash;
+        entry.update_counter++;
+    }
+    entry.known = true;
+}
 
+void FaceAuthenticatorImpl::ForgetDigest(const char* user_id)
+{
+    auto it = _user_digests.find(user_id);
+    if (it != _user_digests.end())
+    {
+        it->second.known = false; // keep the hash and counter, to count the change once it is read again
+    }
+}
+
+Status FaceAuthenticatorImpl::QueryUserDigests(UserDigestsCallback& callback, bool force_refresh)
+{
+    struct UserIdsCollector : UserIdsCallback
+    {
+        std::vector<std::string> user_ids;
+        void OnUserId(const char* user_id) override
+        {
+            user_ids.emplace_back(user_id);
+        }
+    };
+    // the features are only read to update the digests
+    struct DigestsUpdater : FeaturesExportCallback
+    {
+        void OnUserFeatures(const char*, const Faceprints&) override
+        {
+        }
+    };
+
+    try
+    {
+        UserIdsCollector collector;
+        auto rv = QueryUserIds(collector, force_refresh);
+        if (rv != Status::Ok)
+        {
+            return rv;
+        }
+
+        // forget the users removed from the device, list the ones to read
+        std::unordered_map<std::string, DigestEntry> device_digests;
+        std::vector<const char*> unknown_ids;
+        for (const auto& user_id : collector.user_ids)
+        {
+            auto it = _user_digests.find(user_id);
+            auto& entry = device_digests[user_id];
+            if (it != _user_digests.end())
+            {
+                entry = it->second;
+            }
+            if (force_refresh || !entry.known)
+            {
+                entry.known = false;
+                unknown_ids.push_back(user_id.c_str());
+            }
+        }
+        _user_digests = std::move(device_digests);
+
+        LOG_DEBUG(LOG_TAG, "Reading features of %zu of %zu users", unknown_ids.size(), collector.user_ids.size());
+        DigestsUpdater updater;
+        rv = ExportFeatures(unknown_ids.data(), static_cast<unsigned int>(unknown_ids.size()), updater);
+        if (rv != Status::Ok)
+        {
+            return rv;
+        }
+
+        UserDigest digest;
+        for (const auto& user_id : collector.user_ids)
+        {
+            const auto& entry = _user_digests[user_id];
+            ::strncpy(digest.user_id, user_id.c_str(), sizeof(digest.user_id) - 1);
+            digest.user_id[sizeof(digest.user_id) - 1] = '\0';
+            digest.features_hash = entry.features_hash;
+            digest.update_counter = entry.update_counter;
+            callback.OnUserDigest(digest);
+        }
+        return Status::Ok;
+    }
+    catch (std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Unknown exception");
+    }
+    return Status::Error;
+}
+
+Status FaceAuthenticatorImpl::ImportFeatures(const char* const* user_ids, const Faceprints* user_faceprints,
+                                             unsigned int number_of_users, FeaturesTransferCallback* callback)
+{
+    if ((user_ids == nullptr || user_faceprints == nullptr) && number_of_users > 0)
+    {
+        LOG_ERROR(LOG_TAG, "ImportFeatures: Got invalid params (nullptr)");
+        return Status::Error;
+    }
+    for (unsigned int i = 0; i < number_of_users; i++)
+    {
+        if (!ValidateUserId(user_ids[i]))
+        {
+            return Status::Error;
+        }
+    }
+    if (number_of_users == 0)
+    {
+        return Status::Ok;
+    }
+
+    try
+    {
+        _host_cache.users_valid = false; // the device's user list may change from here on
+        TransferCoordinator::Scope transfer {_transfer_coordinator};
+        auto status = ResumeSession();
+        if (status != PacketManager::SerialStatus::Ok)
+        {
+            LOG_ERROR(LOG_TAG, "Session start failed with status %d", static_cast<int>(status));
+            return ToStatus(status);
+        }
+
+        unsigned int requested_users = 0;
+        unsigned int imported_users = 0;
+        char buffer[PacketManager::MaxUserIdSize + 1 + sizeof(SecureVersionDescriptor)];
+        while (imported_users < number_of_users)
+        {
+            while (requested_users < number_of_users && _session.PendingRequests() < MAX_PENDING_REQUESTS)
+            {
+                auto size = SerializeUserFeatures(user_ids[requested_users], user_faceprints[requested_users], buffer);
+                auto data_packet_lease =
+                    _session.Packets().AcquireData(PacketManager::MsgId::SetUserFeatures, buffer, size);
+                auto& data_packet = *data_packet_lease;
+                status = _session.SendRequest(data_packet);
+                if (status != PacketManager::SerialStatus::Ok)
+                {
+                    LOG_ERROR(LOG_TAG, "Failed sending data packet (status %d)", (int)status);
+                    DrainPendingReplies();
+                    return ToStatus(status);
+                }
+                requested_users++;
+            }
+
+            auto reply_packet_lease = _session.Packets().AcquireData(PacketManager::MsgId::SetUserFeatures);
+            auto& reply_packet = *reply_packet_lease;
+            uint32_t request_seq = 0;
+            status = _session.RecvReply(reply_packet, request_seq);
+            if (status != PacketManager::SerialStatus::Ok)
+            {
+                LOG_ERROR(LOG_TAG, "Error updating/adding user %s to DB (status %d)", user_ids[imported_users],
+                          (int)status);
+                DrainPendingReplies();
+                return status == PacketManager::SerialStatus::RecvUnexpectedPacket ? Status::Error : ToStatus(status);
+            }
+
+            RecordDigest(user_ids[imported_users], user_faceprints[imported_users]);
+            imported_users++;
+            if (callback != nullptr)
+            {
+                callback->OnProgress(imported_users, number_of_users);
+            }
+        }
+
+        LOG_DEBUG(LOG_TAG, "Imported features of %u users", imported_users);
+        return Status::Ok;
+    }
+    catch (std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Unknown exception");
+    }
+    return Status::Error;
+}
+
+AsyncOperation FaceAuthenticatorImpl::RunAsync(AsyncOperationImpl::Work work, AsyncOperation::Completion completion)
+{
+    {
+        std::lock_guard<std::mutex> lock {_async_mutex};
+        if (!_executor)
+        {
+            _executor = AsyncExecutor::Acquire();
+        }
+    }
+    // the operation runs under the trace context of the thread starting it
+    Trace::Context trace_context;
+    if (Trace::GetContext(trace_context))
+    {
+        work = [trace_context, work] {
+            Trace::ContextScope trace_scope {trace_context};
+            return work();
+        };
+    }
+    auto* operation = new AsyncOperationImpl(std::move(work), [this] { Cancel(); }, std::move(completion));
+    auto handle = AsyncOperationImpl::Handle(operation);
+    _executor->Post(_strand, operation);
+    operation->Release();
+    return handle;
+}
+
+AsyncOperation FaceAuthenticatorImpl::PrewarmAsync(unsigned int hold_ms, AsyncOperation::Completion completion)
+{
+    {
+        std::lock_guard<std::mutex> lock {_async_mutex};
+        if (_prewarm.IsValid() && !_prewarm.IsDone())
+        {
+            return _prewarm;
+        }
+    }
+    auto operation = RunAsync([this, hold_ms] { return Prewarm(hold_ms); }, std::move(completion));
+    std::lock_guard<std::mutex> lock {_async_mutex};
+    _prewarm = operation;
+    return operation;
+}
 } // namespace RealSenseID
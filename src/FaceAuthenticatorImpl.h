@@ -5,13 +5,20 @@
 
 #include "RealSenseID/DeviceConfig.h"
 #include "RealSenseID/AuthenticationCallback.h"
+#include "RealSenseID/AuthLoopConfig.h"
 #include "RealSenseID/AuthFaceprintsExtractionCallback.h"
+#include "RealSenseID/CallbackDispatch.h"
+#include "RealSenseID/EventSubscription.h"
 #include "RealSenseID/EnrollFaceprintsExtractionCallback.h"
 #include "RealSenseID/EnrollmentCallback.h"
 #include "RealSenseID/Faceprints.h"
+#include "RealSenseID/FeaturesTransferCallback.h"
 #include "RealSenseID/SerialConfig.h"
 #include "RealSenseID/SignatureCallback.h"
 #include "RealSenseID/Status.h"
+#include "RealSenseID/TransferCoordinator.h"
+#include "RealSenseID/UserDigest.h"
+#include "RealSenseID/UserIdsCallback.h"
 #include "RealSenseID/MatchResultHost.h"
 
 #ifdef ANDROID
@@ -25,7 +32,15 @@ using Session = RealSenseID::PacketManager::SecureSession;
 using Session = RealSenseID::PacketManager::NonSecureSession;
 #endif // RSID_SECURE
 
+#include "AsyncExecutor.h"
+#include "CallbackDispatcher.h"
+#include "ClockSync.h"
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace RealSenseID
 {
@@ -36,7 +51,7 @@ class FaceAuthenticatorImpl
 public:
     explicit FaceAuthenticatorImpl(SignatureCallback* callback);
 
-    ~FaceAuthenticatorImpl() = default;
+    ~FaceAuthenticatorImpl();
 
     FaceAuthenticatorImpl(const FaceAuthenticatorImpl&) = delete;
     FaceAuthenticatorImpl& operator=(const FaceAuthenticatorImpl&) = delete;
@@ -47,37 +62,144 @@ public:
 #endif
 
     void Disconnect();
+    void SetSessionReuseTimeout(unsigned int timeout_ms);
+    void SetAutoReconnect(unsigned int timeout_ms);
+    void SetCallbackDispatch(const CallbackDispatchConfig& config);
+    void SetEventSubscription(const EventSubscription& subscription);
+    void SetTransferCoordinator(TransferCoordinator* coordinator);
 #ifdef RSID_SECURE
     Status Pair(const char* ecdsaHostPubKey, const char* ecdsaHostPubKeySig, char* ecdsaDevicePubKey);
     Status Unpair();
+    void SetSessionKeyLifetime(unsigned int lifetime_seconds);
 #endif // RSID_SECURE
 
     Status Enroll(EnrollmentCallback& callback, const char* user_id);
     Status Authenticate(AuthenticationCallback& callback);
     Status AuthenticateLoop(AuthenticationCallback& callback);
+    Status AuthenticateLoop(AuthenticationCallback& callback, const AuthLoopConfig& config);
     Status DetectSpoof(AuthenticationCallback& callback);
     Status Cancel();
     Status RemoveUser(const char* user_id);
+    Status RemoveUsers(const char* const* user_ids, unsigned int number_of_users);
     Status RemoveAll();
 
     Status SetDeviceConfig(const DeviceConfig& device_config);
-    Status QueryDeviceConfig(DeviceConfig& device_config);
-    Status QueryUserIds(char** user_ids, unsigned int& number_of_users);
-    Status QueryNumberOfUsers(unsigned int& number_of_users);
+    Status QueryDeviceConfig(DeviceConfig& device_config, bool force_refresh);
+    Status QueryUserIds(char** user_ids, unsigned int& number_of_users, bool force_refresh);
+    Status QueryUserIds(UserIdsCallback& callback, bool force_refresh);
+    Status QueryNumberOfUsers(unsigned int& number_of_users, bool force_refresh);
+    void SetHostCache(bool enable);
     Status Standby();
+    Status Prewarm(unsigned int hold_ms);
+    Status Ping(unsigned int timeout_ms);
+    Status SyncClock(unsigned int exchanges, unsigned int timeout_ms);
+    ClockSyncState GetClockSync() const;
+    bool DeviceTimeToHost(uint64_t device_us, uint64_t& host_us) const;
 
     Status ExtractFaceprintsForEnroll(EnrollFaceprintsExtractionCallback& callback);
     Status ExtractFaceprintsForAuth(AuthFaceprintsExtractionCallback& callback);
-    Status ExtractFaceprintsForAuthLoop(AuthFaceprintsExtractionCallback& callback);
+    Status ExtractFaceprintsForAuthLoop(AuthFaceprintsExtractionCallback& callback, unsigned int max_faces = 1);
     MatchResultHost MatchFaceprints(Faceprints& new_faceprints, Faceprints& existing_faceprints, Faceprints& updated_faceprints);
+    MatchArrayResultHost MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                const Faceprints* existing_faceprints_array, size_t count,
+                                                Faceprints& updated_faceprints);
+    size_t MatchFaceprintsTopK(const Faceprints& new_faceprints, const Faceprints* existing_faceprints_array,
+                               size_t count, size_t k, MatchCandidateHost* candidates);
 
     Status GetUserFeatures(const char* user_id, Faceprints& user_faceprints);
     Status SetUserFeatures(const char* user_id, Faceprints& user_faceprints);
+    Status ExportAllFeatures(FeaturesExportCallback& callback);
+    Status ExportFeatures(const char* const* user_ids, unsigned int number_of_users, FeaturesExportCallback& callback);
+    Status QueryUserDigests(UserDigestsCallback& callback, bool force_refresh);
+    Status ImportFeatures(const char* const* user_ids, const Faceprints* user_faceprints, unsigned int number_of_users,
+                          FeaturesTransferCallback* callback);
+
+    // run work on the async executor, after the previous async operations of this authenticator
+    AsyncOperation RunAsync(AsyncOperationImpl::Work work, AsyncOperation::Completion completion);
+
+    // run Prewarm() async, or return the pending prewarm
+    AsyncOperation PrewarmAsync(unsigned int hold_ms, AsyncOperation::Completion completion);
 
 private:
     std::unique_ptr<PacketManager::SerialConnection> _serial;
     Session _session;
 
+    // serial config of the last Connect(SerialConfig), to reconnect with. empty port if can't reconnect
+    std::string _port;
+    unsigned int _baudrate = 0;
+    PacketManager::timeout_t _reconnect_timeout {0};
+    uint32_t _ping_number = 0; // data of the next ping
+    ClockSync _clock_sync;
+    TransferCoordinator* _transfer_coordinator = nullptr; // marks the bulk transfers (SetTransferCoordinator)
+
+    // send a ping (numbered by its first bytes) outside of the session and receive its reply, skipping the late
+    // replies of earlier pings
+    Status ExchangePing(char* ping_data, char* reply_data, unsigned int timeout_ms);
+
+    Status OpenSerial(bool log_errors);
+
+    // start or resume the session. if the connection is lost and auto reconnect is enabled, reopen the port and
+    // start a session on it
+    PacketManager::SerialStatus ResumeSession();
+
+    // host side copy of the device config and user ids (SetHostCache)
+    struct HostCache
+    {
+        bool enabled = false;
+        bool config_valid = false;
+        DeviceConfig config;
+        bool users_valid = false;
+        std::vector<std::string> user_ids;
+
+        void Invalidate()
+        {
+            config_valid = false;
+            users_valid = false;
+            user_ids.clear();
+        }
+    };
+    HostCache _host_cache;
+
+    Status QueryDeviceConfigFromDevice(DeviceConfig& device_config);
+    Status QueryUserIdsFromDevice(char** user_ids, unsigned int& number_of_users);
+    // pipelined user ids query, on_user_id is called for each of the first max_users ids as they arrive
+    Status StreamUserIdsFromDevice(const std::function<void(const char*)>& on_user_id, unsigned int max_users);
+    Status RecvUserIdsMessage(const std::function<void(const char*)>& on_user_id, unsigned int max_users);
+    Status QueryNumberOfUsersFromDevice(unsigned int& number_of_users);
+    Status RefreshCachedUserIds();
+    void PopulateHostCache(); // on connect, if enabled
+
+    // host side digests of the device's users (QueryUserDigests). kept regardless of SetHostCache, a user without a
+    // known digest has its features read from the device on the next query
+    struct DigestEntry
+    {
+        bool known = false;
+        uint64_t features_hash = 0;
+        uint32_t update_counter = 0;
+    };
+    std::unordered_map<std::string, DigestEntry> _user_digests;
+
+    void RecordDigest(const char* user_id, const Faceprints& faceprints);
+    void ForgetDigest(const char* user_id);
+
+    // callback events of the device flows are delivered on the dispatcher's thread if set (SetCallbackDispatch).
+    // the public flows wrap the user's callback in the dispatcher's proxy and run the *Flow methods with it
+    std::unique_ptr<CallbackDispatcher> _callback_dispatcher;
+
+    Status EnrollFlow(EnrollmentCallback& callback, const char* user_id);
+    Status AuthenticateFlow(AuthenticationCallback& callback);
+    Status AuthenticateLoopFlow(AuthenticationCallback& callback);
+    Status DetectSpoofFlow(AuthenticationCallback& callback);
+
     static bool ValidateUserId(const char* user_id);
+
+    // receive and ignore the replies of the session's pending requests (after a failed pipelined operation)
+    void DrainPendingReplies();
+
+    // async operations, the executor is acquired on first use
+    std::mutex _async_mutex;
+    std::shared_ptr<AsyncExecutor> _executor;
+    AsyncExecutor::Strand _strand;
+    AsyncOperation _prewarm; // last PrewarmAsync(), guarded by _async_mutex
 };
 } // namespace RealSenseID
@@ -0,0 +1,187 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceTracker.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FaceTracker";
+
+// a detection continues a track if their rects overlap at least this much (intersection over union)
+static const float s_minOverlap = 0.3f;
+
+// a track is lost after this many detections without it, or if not detected for s_lostTimeout (the device may
+// stop sending rects once no face is in view)
+static const size_t s_maxMissedDetections = 3;
+static const std::chrono::milliseconds s_lostTimeout {2000};
+
+static uint64_t Area(const FaceRect& rect)
+{
+    return static_cast<uint64_t>(rect.w) * rect.h;
+}
+
+static float Overlap(const FaceRect& a, const FaceRect& b)
+{
+    const uint64_t left = std::max(a.x, b.x);
+    const uint64_t top = std::max(a.y, b.y);
+    const uint64_t right = std::min<uint64_t>(static_cast<uint64_t>(a.x) + a.w, static_cast<uint64_t>(b.x) + b.w);
+    const uint64_t bottom = std::min<uint64_t>(static_cast<uint64_t>(a.y) + a.h, static_cast<uint64_t>(b.y) + b.h);
+    if (right <= left || bottom <= top)
+    {
+        return 0.0f;
+    }
+    const uint64_t intersection = (right - left) * (bottom - top);
+    return static_cast<float>(intersection) / static_cast<float>(Area(a) + Area(b) - intersection);
+}
+
+FaceTracker::FaceTracker(std::chrono::milliseconds reauth_interval) : _reauth_interval {reauth_interval}
+{
+}
+
+void FaceTracker::Update(const FaceRect* faces, size_t count, clock::time_point now)
+{
+    if (faces == nullptr)
+    {
+        count = 0;
+    }
+
+    // greedy association, best overlapping (track, face) pairs first
+    struct Candidate
+    {
+        float overlap;
+        size_t track;
+        size_t face;
+    };
+    std::vector<Candidate> candidates;
+    for (size_t t = 0; t < _tracks.size(); t++)
+    {
+        for (size_t f = 0; f < count; f++)
+        {
+            float overlap = Overlap(_tracks[t].rect, faces[f]);
+            if (overlap >= s_minOverlap)
+            {
+                candidates.push_back({overlap, t, f});
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) { return a.overlap > b.overlap; });
+
+    std::vector<int> face_track(count, -1);
+    std::vector<char> track_matched(_tracks.size(), 0);
+    for (auto& candidate : candidates)
+    {
+        if (face_track[candidate.face] < 0 && !track_matched[candidate.track])
+        {
+            face_track[candidate.face] = static_cast<int>(candidate.track);
+            track_matched[candidate.track] = 1;
+        }
+    }
+
+    for (size_t t = 0; t < _tracks.size(); t++)
+    {
+        if (!track_matched[t])
+        {
+            _tracks[t].missed++;
+        }
+    }
+    for (size_t f = 0; f < count; f++)
+    {
+        if (face_track[f] < 0)
+        {
+            face_track[f] = static_cast<int>(_tracks.size());
+            _tracks.push_back(Track {});
+            _tracks.back().id = _next_id++;
+        }
+        auto& track = _tracks[face_track[f]];
+        track.rect = faces[f];
+        track.last_seen = now;
+        track.missed = 0;
+    }
+
+    // the primary track is the largest face of this detection
+    int primary = -1;
+    for (size_t f = 0; f < count; f++)
+    {
+        if (primary < 0 || Area(faces[f]) > Area(_tracks[primary].rect))
+        {
+            primary = face_track[f];
+        }
+    }
+
+    // drop the lost tracks, keeping the primary index valid
+    size_t kept = 0;
+    for (size_t t = 0; t < _tracks.size(); t++)
+    {
+        if (_tracks[t].missed >= s_maxMissedDetections)
+        {
+            if (_tracks[t].authenticated)
+            {
+                LOG_DEBUG(LOG_TAG, "Lost the track of an authenticated user");
+            }
+            continue;
+        }
+        if (static_cast<int>(t) == primary)
+        {
+            primary = static_cast<int>(kept);
+        }
+        if (kept != t)
+        {
+            _tracks[kept] = std::move(_tracks[t]);
+        }
+        kept++;
+    }
+    _tracks.resize(kept);
+    _primary = primary;
+}
+
+bool FaceTracker::IsAuthenticated(std::string& user_id, clock::time_point now) const
+{
+    const Track* track = Primary(now);
+    if (track == nullptr || !track->authenticated)
+    {
+        return false;
+    }
+    if (_reauth_interval.count() > 0 && now - track->authenticated_at >= _reauth_interval)
+    {
+        return false;
+    }
+    user_id = track->user_id;
+    return true;
+}
+
+void FaceTracker::SetAuthenticated(const char* user_id, clock::time_point now)
+{
+    if (Primary(now) == nullptr)
+    {
+        return;
+    }
+    auto& track = _tracks[_primary];
+    track.authenticated = true;
+    track.authenticated_at = now;
+    track.user_id = user_id != nullptr ? user_id : "";
+}
+
+uint64_t FaceTracker::PrimaryTrackId(clock::time_point now) const
+{
+    const Track* track = Primary(now);
+    return track != nullptr ? track->id : 0;
+}
+
+void FaceTracker::Clear()
+{
+    _tracks.clear();
+    _primary = -1;
+}
+
+const FaceTracker::Track* FaceTracker::Primary(clock::time_point now) const
+{
+    if (_primary < 0 || now - _tracks[_primary].last_seen >= s_lostTimeout)
+    {
+        return nullptr;
+    }
+    return &_tracks[_primary];
+}
+} // namespace RealSenseID
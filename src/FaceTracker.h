@@ -0,0 +1,64 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/FaceRect.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+// Associates the face rects of consecutive detections (OnFacesDetected()) to tracks by their overlap, so a person
+// that stays in front of the device is recognized as the same track. The result of an authentication applies to the
+// primary track (the largest face of the last detection) - once it authenticated, further authentications of the
+// track are redundant until it is lost (not detected for a few detections) or the reauthentication interval expired.
+class FaceTracker
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // reauth_interval of 0 keeps a track authenticated until it is lost
+    explicit FaceTracker(std::chrono::milliseconds reauth_interval);
+
+    void Update(const FaceRect* faces, size_t count, clock::time_point now = clock::now());
+
+    // the primary track authenticated within the reauthentication interval, its user id is copied to user_id
+    bool IsAuthenticated(std::string& user_id, clock::time_point now = clock::now()) const;
+
+    // mark the primary track as authenticated by the user (no-op without a face)
+    void SetAuthenticated(const char* user_id, clock::time_point now = clock::now());
+
+    // id of the primary track, unique while the tracker lives. 0 without a face
+    uint64_t PrimaryTrackId(clock::time_point now = clock::now()) const;
+
+    void Clear();
+
+    size_t NumTracks() const
+    {
+        return _tracks.size();
+    }
+
+private:
+    struct Track
+    {
+        uint64_t id = 0;
+        FaceRect rect;
+        clock::time_point last_seen;
+        size_t missed = 0; // consecutive detections without the track
+        bool authenticated = false;
+        clock::time_point authenticated_at;
+        std::string user_id;
+    };
+
+    std::chrono::milliseconds _reauth_interval;
+    std::vector<Track> _tracks;
+    int _primary = -1; // track of the largest face of the last detection
+    uint64_t _next_id = 1;
+
+    const Track* Primary(clock::time_point now) const;
+};
+} // namespace RealSenseID
@@ -0,0 +1,125 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FramePool.h"
+
+#include <algorithm>
+
+namespace RealSenseID
+{
+PreviewFrame::PreviewFrame(PreviewFrameImpl* impl) : _impl {impl}
+{
+}
+
+PreviewFrame::~PreviewFrame()
+{
+    Release();
+}
+
+PreviewFrame::PreviewFrame(const PreviewFrame& other) : _impl {other._impl}
+{
+    if (_impl)
+        _impl->AddRef();
+}
+
+PreviewFrame::PreviewFrame(PreviewFrame&& other) noexcept : _impl {other._impl}
+{
+    other._impl = nullptr;
+}
+
+PreviewFrame& PreviewFrame::operator=(const PreviewFrame& other)
+{
+    if (other._impl)
+        other._impl->AddRef();
+    Release();
+    _impl = other._impl;
+    return *this;
+}
+
+PreviewFrame& PreviewFrame::operator=(PreviewFrame&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        _impl = other._impl;
+        other._impl = nullptr;
+    }
+    return *this;
+}
+
+bool PreviewFrame::IsValid() const
+{
+    return _impl != nullptr;
+}
+
+const Image& PreviewFrame::GetImage() const
+{
+    static const Image empty_image;
+    return _impl ? _impl->image : empty_image;
+}
+
+void PreviewFrame::Release()
+{
+    if (_impl)
+    {
+        _impl->Release();
+        _impl = nullptr;
+    }
+}
+
+PreviewFrame PreviewFrameImpl::Adopt(PreviewFrameImpl* frame)
+{
+    return PreviewFrame {frame};
+}
+
+Image* PreviewFrameImpl::ImageOf(const PreviewFrame& frame)
+{
+    return frame._impl ? &frame._impl->image : nullptr;
+}
+
+void PreviewFrameImpl::AddRef()
+{
+    _refs.fetch_add(1);
+}
+
+void PreviewFrameImpl::Release()
+{
+    if (_refs.fetch_sub(1) != 1)
+        return;
+    // last reference, the pool may be released along with the frame's reference to it
+    auto pool = std::move(_pool);
+    pool->Return(this);
+}
+
+std::shared_ptr<FramePool> FramePool::Create(unsigned int frame_count, unsigned int frame_size)
+{
+    auto pool = std::make_shared<FramePool>();
+    frame_count = std::max(frame_count, 1u);
+    for (unsigned int i = 0; i < frame_count; i++)
+    {
+        pool->_frames.emplace_back(SdkNew<PreviewFrameImpl, Metrics::Subsystem::Preview>());
+        pool->_frames.back()->buffer.resize(frame_size);
+        pool->_free.push_back(pool->_frames.back().get());
+    }
+    return pool;
+}
+
+PreviewFrameImpl* FramePool::Acquire()
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (_free.empty())
+        return nullptr;
+    auto* frame = _free.back();
+    _free.pop_back();
+    frame->_refs = 1;
+    frame->_pool = shared_from_this();
+    return frame;
+}
+
+void FramePool::Return(PreviewFrameImpl* frame)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    frame->image = Image();
+    _free.push_back(frame);
+}
+} // namespace RealSenseID
@@ -0,0 +1,57 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/Preview.h"
+#include "RealSenseID/Allocator.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace RealSenseID
+{
+class FramePool;
+
+// Pooled preview frame, leased to the user with PreviewFrame.
+class PreviewFrameImpl
+{
+public:
+    SdkVector<unsigned char, Metrics::Subsystem::Preview> buffer;
+    Image image; // image.buffer points into buffer
+
+    // lease holding the reference taken by FramePool::Acquire()
+    static PreviewFrame Adopt(PreviewFrameImpl* frame);
+
+    // image of a lease (nullptr if not valid), for the preview to update before delivery
+    static Image* ImageOf(const PreviewFrame& frame);
+
+    void AddRef();
+    void Release(); // back to the pool with the last reference
+
+private:
+    friend class FramePool;
+    std::atomic<unsigned int> _refs {0};
+    std::shared_ptr<FramePool> _pool; // set while leased, keeps the pool alive
+};
+
+// Fixed pool of equally sized frames, allocated with the SDK allocator (counted as the preview's allocations)
+class FramePool : public std::enable_shared_from_this<FramePool>
+{
+public:
+    static std::shared_ptr<FramePool> Create(unsigned int frame_count, unsigned int frame_size);
+
+    // free frame with one reference, or nullptr if all the frames are leased
+    PreviewFrameImpl* Acquire();
+
+private:
+    friend class PreviewFrameImpl;
+    void Return(PreviewFrameImpl* frame);
+
+    std::mutex _mutex;
+    std::vector<SdkUniquePtr<PreviewFrameImpl, Metrics::Subsystem::Preview>> _frames;
+    std::vector<PreviewFrameImpl*> _free;
+};
+} // namespace RealSenseID
@@ -0,0 +1,284 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#include "RealSenseID/FwImage.h"
+#include "FwUpdate/FwImageImpl.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // std::min below
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FwImage";
+
+// bytes requested from a reader at a time
+static constexpr size_t reader_chunk_size = 64 * 1024;
+
+static void ThrowIfPastEnd(size_t offset, size_t n_bytes, size_t size)
+{
+    if (offset > size || n_bytes > size - offset)
+    {
+        throw std::runtime_error("Read past the end of the firmware image");
+    }
+}
+
+// Read only mapping of a whole file, mapped on first use
+class FileImage : public FwImageImpl
+{
+public:
+    explicit FileImage(const char* path) : FwImageImpl {path != nullptr ? path : ""}
+    {
+    }
+
+    ~FileImage() override
+    {
+        Close();
+    }
+
+    const unsigned char* Data(size_t offset, size_t n_bytes) override
+    {
+        Map();
+        ThrowIfPastEnd(offset, n_bytes, _size);
+        return _data + offset;
+    }
+
+    void Read(size_t offset, size_t n_bytes, unsigned char* out) override
+    {
+        ::memcpy(out, Data(offset, n_bytes), n_bytes);
+    }
+
+private:
+    std::mutex _mutex;
+    bool _mapped = false;
+    const unsigned char* _data = nullptr;
+    size_t _size = 0;
+#ifdef _WIN32
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mapping = nullptr;
+#else
+    int _fd = -1;
+#endif
+
+    void Map()
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (_mapped)
+        {
+            return;
+        }
+        const std::string& path = Name();
+#ifdef _WIN32
+        _file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER file_size;
+        if (_file == INVALID_HANDLE_VALUE || !::GetFileSizeEx(_file, &file_size))
+        {
+            Close();
+            throw std::runtime_error("Error while trying to read project header");
+        }
+        _size = static_cast<size_t>(file_size.QuadPart);
+        if (_size > 0)
+        {
+            _mapping = ::CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            _data = _mapping ? static_cast<const unsigned char*>(::MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)) :
+                               nullptr;
+        }
+#else
+        _fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat file_stat;
+        if (_fd < 0 || ::fstat(_fd, &file_stat) != 0)
+        {
+            Close();
+            throw std::runtime_error("Error while trying to read project header");
+        }
+        _size = static_cast<size_t>(file_stat.st_size);
+        if (_size > 0)
+        {
+            void* data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+            _data = data != MAP_FAILED ? static_cast<const unsigned char*>(data) : nullptr;
+            if (_data)
+            {
+                ::madvise(data, _size, MADV_SEQUENTIAL);
+            }
+        }
+#endif
+        if (_size > 0 && !_data)
+        {
+            Close();
+            throw std::runtime_error("Failed mapping firmware file");
+        }
+        _mapped = true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (_data)
+            ::UnmapViewOfFile(_data);
+        if (_mapping)
+            ::CloseHandle(_mapping);
+        if (_file != INVALID_HANDLE_VALUE)
+            ::CloseHandle(_file);
+        _mapping = nullptr;
+        _file = INVALID_HANDLE_VALUE;
+#else
+        if (_data)
+            ::munmap(const_cast<unsigned char*>(_data), _size);
+        if (_fd >= 0)
+            ::close(_fd);
+        _fd = -1;
+#endif
+        _data = nullptr;
+        _size = 0;
+    }
+};
+
+// The caller's buffer
+class BufferImage : public FwImageImpl
+{
+public:
+    BufferImage(const void* data, size_t size) :
+        FwImageImpl {"<memory>"}, _data {static_cast<const unsigned char*>(data)}, _size {data != nullptr ? size : 0}
+    {
+    }
+
+    const unsigned char* Data(size_t offset, size_t n_bytes) override
+    {
+        ThrowIfPastEnd(offset, n_bytes, _size);
+        return _data + offset;
+    }
+
+    void Read(size_t offset, size_t n_bytes, unsigned char* out) override
+    {
+        ::memcpy(out, Data(offset, n_bytes), n_bytes);
+    }
+
+private:
+    const unsigned char* _data;
+    size_t _size;
+};
+
+// The caller's reader: seeks to the offsets read, or keeps what it read if it can't seek (reads are then served
+// from memory, reading further as needed)
+class ReaderImage : public FwImageImpl
+{
+public:
+    explicit ReaderImage(FwImageReader* reader) : FwImageImpl {"<reader>"}, _reader {reader}
+    {
+        if (_reader == nullptr)
+        {
+            LOG_ERROR(LOG_TAG, "No firmware image reader");
+            return;
+        }
+        _seekable = _reader->Seek(0);
+        LOG_DEBUG(LOG_TAG, "Reading the firmware image from a %s reader", _seekable ? "seekable" : "sequential");
+    }
+
+    const unsigned char* Data(size_t, size_t) override
+    {
+        return nullptr;
+    }
+
+    void Read(size_t offset, size_t n_bytes, unsigned char* out) override
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (_reader == nullptr)
+        {
+            throw std::runtime_error("No firmware image reader");
+        }
+        if (_seekable)
+        {
+            if (offset != _position && !_reader->Seek(offset))
+            {
+                _position = SIZE_MAX;
+                throw std::runtime_error("Failed seeking the firmware image");
+            }
+            _position = offset;
+            ReadFully(out, n_bytes);
+            _position += n_bytes;
+            return;
+        }
+
+        if (offset + n_bytes < offset)
+        {
+            throw std::runtime_error("Read past the end of the firmware image");
+        }
+        while (_received.size() < offset + n_bytes)
+        {
+            const size_t received = _received.size();
+            const size_t wanted = std::max(offset + n_bytes - received, reader_chunk_size);
+            _received.resize(received + wanted);
+            const size_t n_read = _reader->Read(_received.data() + received, wanted);
+            _received.resize(received + n_read);
+            if (n_read == 0)
+            {
+                throw std::runtime_error("Firmware image ended after " + std::to_string(received) + " bytes");
+            }
+        }
+        ::memcpy(out, _received.data() + offset, n_bytes);
+    }
+
+private:
+    std::mutex _mutex;
+    FwImageReader* _reader;
+    bool _seekable = false;
+    size_t _position = 0;                // of a seekable reader
+    std::vector<unsigned char> _received; // of a sequential reader
+
+    void ReadFully(unsigned char* out, size_t n_bytes)
+    {
+        size_t done = 0;
+        while (done < n_bytes)
+        {
+            const size_t n_read = _reader->Read(out + done, n_bytes - done);
+            if (n_read == 0)
+            {
+                const size_t end = _position + done;
+                _position = SIZE_MAX; // seek before the next read
+                throw std::runtime_error("Firmware image ended at offset " + std::to_string(end));
+            }
+            done += n_read;
+        }
+    }
+};
+
+FwImage::FwImage(std::shared_ptr<FwImageImpl> impl) : _impl {std::move(impl)}
+{
+}
+
+FwImage FwImage::FromFile(const char* path)
+{
+    return FwImage {std::make_shared<FileImage>(path)};
+}
+
+FwImage FwImage::FromBuffer(const void* data, size_t size)
+{
+    return FwImage {std::make_shared<BufferImage>(data, size)};
+}
+
+FwImage FwImage::FromReader(FwImageReader* reader)
+{
+    return FwImage {std::make_shared<ReaderImage>(reader)};
+}
+
+const char* FwImage::Name() const
+{
+    return _impl->Name().c_str();
+}
+} // namespace RealSenseID
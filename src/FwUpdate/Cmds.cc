@@ -27,7 +27,7 @@ std::string Cmds::dlinfo(const std::string& module_name)
 }
 
 std::string Cmds::dlinit(const std::string& name, const std::string& version, size_t size,
-                                          bool start_session, uint32_t crc, uint32_t block_size)
+                                          bool start_session, uint32_t crc, uint32_t block_size, bool lz4)
 {
     std::ostringstream oss;
     oss << "\ndlinit " << name << " ver=" << version << " sz=" << size << " blksz=" << block_size << " crc=" << std::hex
@@ -36,14 +36,20 @@ std::string Cmds::dlinit(const std::string& name, const std::string& version, si
     if (start_session)
         oss << " session";
 
+    if (lz4)
+        oss << " lz4";
+
     return oss.str();
 }
 
-std::string Cmds::dl(size_t n)
+std::string Cmds::dl(size_t n, size_t compressed_size)
 {
     std::ostringstream oss;
     oss << "\ndl " << n;
 
+    if (compressed_size > 0)
+        oss << " csz=" << compressed_size;
+
     return oss.str();
 }
 
@@ -24,15 +24,17 @@ namespace Cmds
 
     /****************** dlinit cmd ******************/
     // dlinit initialize uisp header to prepare to update specified module
-    // dlinit FW ver=d.e.f.g sz=24340250 blksz=512KB crc=aabbccdd
+    // dlinit FW ver=d.e.f.g sz=24340250 blksz=512KB crc=aabbccdd [session] [lz4]
+    // lz4: offer lz4 compressed blocks. bootloaders supporting it reply "dlinit ack lz4", older ones "dlinit ack".
     std::string dlinit(const std::string& name, const std::string& version, size_t size, bool start_session,
-                              uint32_t crc, uint32_t block_size);
+                              uint32_t crc, uint32_t block_size, bool lz4 = false);
 
     
     /****************** dl cmd ******************/
     // dl update specified block of inited module (specified with dlinit)
-    // dl $blk#
-    std::string dl(size_t n);
+    // dl $blk# [csz=$compressed_size]
+    // csz: the block is sent as a single lz4 block of compressed_size bytes (only if accepted in dlinit)
+    std::string dl(size_t n, size_t compressed_size = 0);
   
     /****************** dlact cmd ******************/
     //std::string dlact(bool end_session, bool reboot);
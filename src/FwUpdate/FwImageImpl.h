@@ -0,0 +1,37 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace RealSenseID
+{
+// Firmware image of a FwImage (a mapped file, a buffer or a reader), read by offset. Thread safe.
+class FwImageImpl
+{
+public:
+    explicit FwImageImpl(std::string name) : _name {std::move(name)}
+    {
+    }
+    virtual ~FwImageImpl() = default;
+
+    FwImageImpl(const FwImageImpl&) = delete;
+    FwImageImpl& operator=(const FwImageImpl&) = delete;
+
+    const std::string& Name() const
+    {
+        return _name;
+    }
+
+    // n_bytes at offset if the image is in memory (mapped file or buffer), null for readers. throws past the end
+    virtual const unsigned char* Data(size_t offset, size_t n_bytes) = 0;
+
+    // copy n_bytes at offset to out. throws past the end of the image or if the reader failed
+    virtual void Read(size_t offset, size_t n_bytes, unsigned char* out) = 0;
+
+private:
+    std::string _name;
+};
+} // namespace RealSenseID
@@ -2,9 +2,12 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 #include "FwUpdateEngine.h"
 #include "Utilities.h"
+#include "FwImageImpl.h"
 #include "Logger.h"
 #include "Cmds.h"
-#include <thread>
+#include "Lz4.h"
+#include "TaskScheduler.h"
+#include "TraceRecorder.h"
 #include <chrono>
 #include <regex>
 #include <sstream>
@@ -13,6 +16,8 @@
 #include <algorithm>
 #include <stdexcept>
 #include <memory>
+#include <cstring>
+#include <thread>
 
 namespace RealSenseID
 {
@@ -20,6 +25,9 @@ namespace FwUpdate
 {
 static const char* LOG_TAG = "FwUpdater";
 
+// time for the device to switch to reading the crc table after 'dlinit', if its bootloader doesn't ack it
+static const std::chrono::milliseconds DlInitFallbackDelay {50};
+
 static const std::set<std::string> AllowedModules {"OPFW", "NNLED", "NNLAS", "DNET", "RECOG", "YOLO", "AS2DLR"};
 
 struct FwUpdateEngine::ModuleVersionInfo
@@ -86,6 +94,14 @@ bool FwUpdateEngine::ParseDlVer(const char* input, const std::string& module_nam
 
 bool FwUpdateEngine::ConsumeDlVerResponse(const std::string& module_name, ModuleVersionInfo& module_info)
 {
+    // wait for the line of the module, e.g. "OPFW : [OPFW] [0.0.0.1] (active)"
+    auto module_line = module_name + " : [" + module_name + "]";
+    if (!_comm->WaitForLine(module_line.c_str(), std::chrono::milliseconds {1000}))
+    {
+        LOG_ERROR(LOG_TAG, "Timeout waiting for the dlver line of module %s", module_name.c_str());
+        _comm->ConsumeScanned();
+        return false;
+    }
     char* logBuf = _comm->GetScanPtr();
 
      LOG_DEBUG(LOG_TAG, "**************** ParseDlVer ********************");
@@ -147,6 +163,7 @@ std::vector<bool> FwUpdateEngine::GetBlockUpdateList(const ModuleInfo& module, b
     // all blocks should be updated until proven otherwise ("Ok" status and CRCs match: HDR==Real==Host)
     std::vector<bool> rv(module.blocks.size(), true);
     char* logBuf = _comm->GetScanPtr();
+    const char* p = nullptr;
 
      LOG_DEBUG(LOG_TAG, "**************** dlinfo response ********************");
      LOG_DEBUG(LOG_TAG, "%s", logBuf);
@@ -161,12 +178,23 @@ std::vector<bool> FwUpdateEngine::GetBlockUpdateList(const ModuleInfo& module, b
     }
     const char* cur_input = logBuf;
     // jump to SCRAP info section if exists
-    const char* p = strstr(cur_input, "SCRAP info");
+    p = strstr(cur_input, "SCRAP info");
     if (p)
     {
         cur_input = p;
     }
 
+    // block crcs of the device are comparable only if it has the same block size
+    unsigned int device_block_size = 0;
+    p = strstr(cur_input, "blkSz");
+    if (p == nullptr || sscanf(p, "blkSz %u", &device_block_size) != 1 || device_block_size != module.block_size)
+    {
+        LOG_DEBUG(LOG_TAG, "Device block size %u differs from %u. Update all blocks", device_block_size,
+                  module.block_size);
+        _comm->ConsumeScanned();
+        return rv;
+    }
+
     while (true)
     {
         char state_str[16] = {0};
@@ -214,10 +242,9 @@ std::vector<bool> FwUpdateEngine::GetBlockUpdateList(const ModuleInfo& module, b
 // parse 'dl' ack
 bool FwUpdateEngine::ParseDlResponse(const std::string& name, size_t blkNo, size_t sz)
 {
-    char* logBuf = _comm->GetScanPtr();
     char str[64];
     ::snprintf(str, sizeof(str), "%s : blk %zu sz=%zu", name.c_str(), blkNo, sz);
-    bool ack = strstr(logBuf, str) != NULL;
+    bool ack = _comm->WaitForLine(str, std::chrono::milliseconds {1000});
 
     if (!ack)
         LOG_DEBUG(LOG_TAG, "cannot find %s", str);
@@ -248,12 +275,61 @@ bool FwUpdateEngine::ParseDlBlockResult()
     return rv;
 }
 
-void FwUpdateEngine::BurnModule(ProgressTick tick, const ModuleInfo& module, const Buffer& buffer, bool is_first,
-                                bool is_last, bool force_full)
+// parse 'dlinit' ack - return false if none came. lz4 is set if the bootloader accepted lz4 compressed blocks
+// ("dlinit ack lz4")
+bool FwUpdateEngine::ParseDlInitAck(bool& lz4)
+{
+    lz4 = false;
+    const char* ackStr = "dlinit ack";
+    if (!_comm->WaitForLine(ackStr, std::chrono::milliseconds {1000}))
+    {
+        return false;
+    }
+    const char* p = strstr(_comm->GetScanPtr(), ackStr) + strlen(ackStr);
+    const char* line_end = strpbrk(p, "\r\n");
+    const char* lz4_option = strstr(p, "lz4");
+    lz4 = lz4_option != nullptr && lz4_option < line_end;
+    return true;
+}
+
+void FwUpdateEngine::Tick(size_t block_index, size_t sent_bytes, std::chrono::steady_clock::duration block_time)
+{
+    _progress.block_index = block_index;
+    _progress.blocks_done++;
+    _progress.progress = static_cast<float>(_progress.blocks_done) / _progress.n_blocks;
+    if (sent_bytes > 0)
+    {
+        _progress.blocks_sent++;
+        _progress.bytes_sent += sent_bytes;
+        _progress.transfer_time += block_time;
+        _progress.block_time = block_time;
+    }
+    _on_progress(_progress);
+}
+
+void FwUpdateEngine::ThrowIfCanceled() const
+{
+    if (_canceled)
+    {
+        throw std::runtime_error("Firmware update canceled");
+    }
+}
+
+void FwUpdateEngine::Cancel()
+{
+    _canceled = true;
+    std::lock_guard<std::mutex> lock {_comm_mutex};
+    if (_comm)
+    {
+        _comm->Cancel();
+    }
+}
+
+void FwUpdateEngine::BurnModule(const ModuleInfo& module, const Buffer& buffer, bool is_first, bool is_last,
+                                bool force_full)
 {
     // send dlver command to get the module's state
     _comm->WriteCmd(Cmds::dlver());
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
     ModuleVersionInfo version_info;
     bool success = ConsumeDlVerResponse(module.name, version_info);
     if (!success)
@@ -280,10 +356,10 @@ void FwUpdateEngine::BurnModule(ProgressTick tick, const ModuleInfo& module, con
 
         for (uint32_t i = 0; i < module.blocks.size(); ++i)
         {
-            tick();
+            Tick(i, 0, {});
         }
 
-        if (is_last)
+        if (is_last && !_stage_only)
         {
             // if this is the last module, we stop the reader thread
             _comm->StopReaderThread();
@@ -303,8 +379,21 @@ void FwUpdateEngine::BurnModule(ProgressTick tick, const ModuleInfo& module, con
     }
 
     // send dlinit - if we're starting a session, open it
-    _comm->WriteCmd(Cmds::dlinit(module.name, module.version, module.size, is_first, module.crc, BlockSize));
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    _comm->WriteCmd(
+        Cmds::dlinit(module.name, module.version, module.size, is_first, module.crc, module.block_size, _compress));
+    // the crc table is sent once the device acked dlinit, so it reads it as binary and not as a command
+    bool accepted_lz4 = false;
+    if (!ParseDlInitAck(accepted_lz4))
+    {
+        LOG_DEBUG(LOG_TAG, "Module %s: no dlinit ack, waiting %lld ms", module.name.c_str(),
+                  static_cast<long long>(DlInitFallbackDelay.count()));
+        std::this_thread::sleep_for(DlInitFallbackDelay);
+    }
+    bool compressed_blocks = _compress && accepted_lz4;
+    if (_compress)
+    {
+        LOG_INFO(LOG_TAG, "Module %s: %s transfer", module.name.c_str(), compressed_blocks ? "lz4" : "raw");
+    }
 
     // send CRCs of all blocks to fw as binary array of [n x uin32_t] bytes (little endian)
     std::vector<uint32_t> blkCrc;
@@ -316,24 +405,74 @@ void FwUpdateEngine::BurnModule(ProgressTick tick, const ModuleInfo& module, con
     _comm->ConsumeScanned();
 
     LOG_DEBUG(LOG_TAG, "Starting module %s update", module.name.c_str());
+    int64_t blocks_left = std::count(block_update_list.begin(), block_update_list.end(), true);
+
+    // the next block to update is compressed on the task scheduler while the current one is sent
+    std::vector<unsigned char> compressed, next_compressed;
+    int next_compressed_block = -1;
+    std::unique_ptr<TaskGroup> compression;
+    if (compressed_blocks)
+    {
+        compression.reset(new TaskGroup {TaskScheduler::Acquire()});
+    }
+    auto compress_ahead = [&](size_t from) {
+        auto next = std::find(block_update_list.begin() + std::min(from, block_update_list.size()),
+                              block_update_list.end(), true);
+        if (!compression || next == block_update_list.end())
+        {
+            return;
+        }
+        next_compressed_block = static_cast<int>(next - block_update_list.begin());
+        const auto& block = module.blocks[next_compressed_block];
+        const unsigned char* data = buffer.data() + block.offset;
+        const size_t size = block.size;
+        compression->Run([&next_compressed, data, size]() { next_compressed = Lz4CompressBlock(data, size); });
+    };
+
     for (auto i = 0; i < module.blocks.size(); ++i)
     {
         bool should_update_block = block_update_list[i];
         if (!should_update_block)
         {
             LOG_DEBUG(LOG_TAG, "Module %s, block #%d already up-to-date, skipping...", module.name.c_str(), i);
+            Tick(i, 0, {});
             continue;
         }
+        ThrowIfCanceled();
 
         LOG_DEBUG(LOG_TAG, "Module %s, block #%d, updating...", module.name.c_str(), i);
+        Trace::Scope block_trace {"Block", "fwupdate"};
+        block_trace.SetValue(i);
 
+        const auto block_start = std::chrono::steady_clock::now();
         auto sz = module.blocks[i].size;
         const unsigned char* sendBuf = buffer.data() + module.blocks[i].offset;
 
         size_t sendSz = sz;
 
-        _comm->WriteCmd(Cmds::dl(i));
-        _comm->WaitForIdle();
+        // compressed only if smaller
+        if (compressed_blocks)
+        {
+            if (next_compressed_block == i)
+            {
+                compression->Wait();
+                compressed.swap(next_compressed);
+            }
+            else
+            {
+                compressed = Lz4CompressBlock(sendBuf, sz);
+            }
+            compress_ahead(i + 1);
+            if (compressed.size() < sz)
+            {
+                LOG_DEBUG(LOG_TAG, "Module %s, block #%d compressed %zu -> %zu", module.name.c_str(), i, sz,
+                          compressed.size());
+                sendBuf = compressed.data();
+                sendSz = compressed.size();
+            }
+        }
+
+        _comm->WriteCmd(Cmds::dl(i, sendSz < sz ? sendSz : 0));
         bool dlAck = ParseDlResponse(module.name, i, sz);
         if (!dlAck)
         {
@@ -342,15 +481,19 @@ void FwUpdateEngine::BurnModule(ProgressTick tick, const ModuleInfo& module, con
 
         _comm->WriteBinary((char*)sendBuf, sendSz);
 
-        auto timeoutMs = 2000 * BlockSize / (64 * 1024);
-        _comm->WaitForStr("dl ret=", std::chrono::milliseconds {timeoutMs});
+        auto timeoutMs = 2000 * (module.block_size / (64 * 1024));
+        if (!_comm->WaitForLine("dl ret=", std::chrono::milliseconds {timeoutMs}))
+        {
+            throw std::runtime_error("Did not receive 'dl ret'");
+        }
         auto dlErr = ParseDlBlockResult();
         if (!dlErr)
         {
             throw std::runtime_error("Error while parsing block");
         }
 
-        tick();
+        Trace::Counter("FwBlocksLeft", --blocks_left);
+        Tick(i, sendSz, std::chrono::steady_clock::now() - block_start);
     }
 
     // update finished - send dlver, receive response and check crcs
@@ -363,7 +506,7 @@ void FwUpdateEngine::BurnModule(ProgressTick tick, const ModuleInfo& module, con
         throw std::runtime_error("Update failed");
     }
 
-    if (is_last)
+    if (is_last && !_stage_only)
     {
         // if this is the last module, we stop the reader thread
         _comm->StopReaderThread();
@@ -373,7 +516,7 @@ void FwUpdateEngine::BurnModule(ProgressTick tick, const ModuleInfo& module, con
     }
     else
     {
-        // activate the module
+        // activate the module (staged: the last one too, the reboot is left to ActivateModules())
         _comm->WriteCmd(Cmds::dlact(false));
 
         // wait for validation string if not last module
@@ -383,30 +526,61 @@ void FwUpdateEngine::BurnModule(ProgressTick tick, const ModuleInfo& module, con
     LOG_DEBUG(LOG_TAG, "update finished");
 }
 
-void FwUpdateEngine::Session(const ModuleVector& modules, ProgressTick tick, bool force_full)
+FwUpdateEngine::BufferVector FwUpdateEngine::LoadModules(const ModuleVector& modules)
+{
+    BufferVector buffers;
+    for (const auto& module : modules)
+    {
+        buffers.push_back(LoadModuleBuffer(module));
+        if (buffers.back().empty())
+        {
+            throw std::runtime_error("Failed loading firwmare file");
+        }
+    }
+    return buffers;
+}
+
+void FwUpdateEngine::Session(const ModuleVector& modules, const BufferVector* buffers, bool force_full)
 {
     for (int i = 0; i < modules.size(); ++i)
     {
+        ThrowIfCanceled();
         const auto& module = modules.at(i);
+        _progress.module = &module;
+        _progress.module_index = i;
 
-        auto buffer = LoadFileToBuffer(module.filename, module.aligned_size, module.size, module.file_offset);
-        if (buffer.empty())
+        Buffer loaded_buffer;
+        if (!buffers)
         {
-            throw std::runtime_error("Failed loading firwmare file");
+            loaded_buffer = LoadModuleBuffer(module);
+            if (loaded_buffer.empty())
+            {
+                throw std::runtime_error("Failed loading firwmare file");
+            }
         }
+        const auto& buffer = buffers ? buffers->at(i) : loaded_buffer;
 
         auto is_first_module = i == 0;
         auto is_last_module = i == modules.size() - 1;
-        BurnModule(tick, module, buffer, is_first_module, is_last_module, force_full);
+        BurnModule(module, buffer, is_first_module, is_last_module, force_full);
 
         LOG_INFO(LOG_TAG, "Module %s done", module.name.c_str());
     }
 }
 
-ModuleVector FwUpdateEngine::ModulesFromFile(const std::string& path)
+bool FwUpdateEngine::IsValidBlockSize(uint32_t block_size)
 {
-    LOG_INFO(LOG_TAG, "Extract modules from \"%s\"", path.c_str());
-    auto modules = ParseUfifToModules(path, BlockSize);
+    return block_size >= MinBlockSize && block_size <= MaxBlockSize && (block_size & (block_size - 1)) == 0;
+}
+
+ModuleVector FwUpdateEngine::ModulesFromImage(const std::shared_ptr<FwImageImpl>& image, uint32_t block_size)
+{
+    if (!IsValidBlockSize(block_size))
+    {
+        throw std::runtime_error("Invalid block size " + std::to_string(block_size));
+    }
+    LOG_INFO(LOG_TAG, "Extract modules from \"%s\" (block size %u)", image->Name().c_str(), block_size);
+    auto modules = ParseUfifToModules(image, block_size);
     // validate that we get known module names
     for (const auto& module : modules)
     {
@@ -419,7 +593,37 @@ ModuleVector FwUpdateEngine::ModulesFromFile(const std::string& path)
     return modules;
 }
 
+void FwUpdateEngine::Connect(const Settings& settings)
+{
+    std::lock_guard<std::mutex> lock {_comm_mutex};
+#ifdef ANDROID
+    _comm = std::make_unique<FwUpdaterComm>(settings.android_config);
+#else
+    _comm = std::make_unique<FwUpdaterComm>(settings.port);
+#endif
+    if (_canceled)
+    {
+        _comm->Cancel();
+    }
+}
+
 void FwUpdateEngine::BurnModules(const Settings& settings, const ModuleVector& modules, ProgressCallback on_progress)
+{
+    BurnModules(settings, modules, nullptr, on_progress);
+}
+
+void FwUpdateEngine::BurnModules(const Settings& settings, const ModuleVector& modules, const BufferVector& buffers,
+                                 ProgressCallback on_progress)
+{
+    if (buffers.size() != modules.size())
+    {
+        throw std::runtime_error("Module data does not match the modules");
+    }
+    BurnModules(settings, modules, &buffers, on_progress);
+}
+
+void FwUpdateEngine::BurnModules(const Settings& settings, const ModuleVector& modules, const BufferVector* buffers,
+                                 ProgressCallback on_progress)
 {
 	if (modules.empty())
 	{
@@ -428,40 +632,85 @@ void FwUpdateEngine::BurnModules(const Settings& settings, const ModuleVector& m
 	}
 
     // progress pre-processing
-    size_t total_number_of_blocks = 0;
-
+    _progress = Progress {};
+    _progress.n_modules = modules.size();
     for (const auto& module : modules)
-        total_number_of_blocks += module.blocks.size();
-
-    // calculate the effect each block has on the overall progress
-    float progress_delta = (100.0f / total_number_of_blocks) / 100;
-
-    float overall_progress = 0.0f;
-    // wrap external progress callback with a "tick progress" lambda, called every time a block is sent.
-    auto progress_tick = [progress_delta, on_progress, &overall_progress]() {
-        overall_progress += progress_delta;
-        on_progress(overall_progress);
-    };
+        _progress.n_blocks += module.blocks.size();
+    _on_progress = std::move(on_progress);
 
-#ifdef ANDROID
-    _comm = std::make_unique<FwUpdaterComm>(settings.android_config);
-#else
-    _comm = std::make_unique<FwUpdaterComm>(settings.port);
-#endif
+    Connect(settings);
+    _compress = settings.compress;
+    _stage_only = settings.stage_only;
     try
     {
         _comm->WaitForIdle();
         _comm->WriteCmd(Cmds::dlspd(settings.baud_rate), true);
         _comm->WriteCmd(Cmds::dlver(), true);
 
-        on_progress(0.0f);
+        _on_progress(_progress);
 
-        Session(modules, progress_tick, settings.force_full);
-        on_progress(1.0f);
+        Session(modules, buffers, settings.force_full);
+        _progress.progress = 1.0f;
+        _on_progress(_progress);
     }
     catch (const std::exception&)
     {
         // close connection if exists and rethrow
+        std::lock_guard<std::mutex> lock {_comm_mutex};
+        _comm.reset();
+        throw;
+    }
+}
+
+void FwUpdateEngine::ActivateModules(const Settings& settings, const ModuleVector& modules)
+{
+    if (modules.empty())
+    {
+        throw std::runtime_error("No modules to activate");
+    }
+
+    Connect(settings);
+    try
+    {
+        _comm->WaitForIdle();
+        _comm->WriteCmd(Cmds::dlspd(settings.baud_rate), true);
+
+        // every module must be completely written with the blocks of the image (as checked after an update)
+        for (const auto& module : modules)
+        {
+            ThrowIfCanceled();
+            _comm->WriteCmd(Cmds::dlver());
+            ModuleVersionInfo version_info;
+            if (!ConsumeDlVerResponse(module.name, version_info))
+            {
+                throw std::runtime_error("Failed parsing verinfo response");
+            }
+            if (version_info.state == ModuleVersionInfo::State::Empty ||
+                version_info.state == ModuleVersionInfo::State::ActiveUpdating)
+            {
+                throw std::runtime_error("Module " + module.name + " is not staged");
+            }
+
+            _comm->WriteCmd(Cmds::dlinfo(module.name));
+            _comm->WaitForStr("dlinfo end", std::chrono::milliseconds {1000});
+            auto block_update_list = GetBlockUpdateList(module, false /* no force_full */);
+            if (std::find(block_update_list.begin(), block_update_list.end(), true) != block_update_list.end())
+            {
+                throw std::runtime_error("Module " + module.name + " differs from the staged image");
+            }
+            LOG_INFO(LOG_TAG, "Module %s staged (%s)", module.name.c_str(),
+                     version_info.state == ModuleVersionInfo::State::Pending ? "pending" : "active");
+        }
+        ThrowIfCanceled();
+
+        // end the session and reboot into the staged modules
+        _comm->StopReaderThread();
+        _comm->WriteCmd(Cmds::dlact(true), false);
+        LOG_INFO(LOG_TAG, "Activated %zu modules, rebooting", modules.size());
+    }
+    catch (const std::exception&)
+    {
+        std::lock_guard<std::mutex> lock {_comm_mutex};
         _comm.reset();
         throw;
     }
@@ -4,8 +4,13 @@
 
 #include "FwUpdaterComm.h"
 #include "ModuleInfo.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include "RealSenseID/AndroidSerialConfig.h"
 
@@ -16,18 +21,43 @@ namespace FwUpdate
 class FwUpdateEngine
 {
 public:
-    using ProgressCallback = std::function<void(float)>;
-    using ProgressTick = std::function<void()>;
+    // progress of BurnModules(), reported at the start, after each block of the modules (sent, or skipped as up to
+    // date on the device) and at the end
+    struct Progress
+    {
+        float progress = 0.0f;              // overall, range 0.0f - 1.0f
+        const ModuleInfo* module = nullptr; // module of the block (null at the start)
+        size_t module_index = 0;
+        size_t n_modules = 0;
+        size_t block_index = 0; // of the module's blocks
+        size_t blocks_done = 0; // of all the modules, sent or skipped
+        size_t n_blocks = 0;
+        size_t blocks_sent = 0;
+        uint64_t bytes_sent = 0;                               // of the sent blocks (compressed size if compressed)
+        std::chrono::steady_clock::duration transfer_time {0}; // of the sent blocks, from 'dl' to 'dl ret'
+        std::chrono::steady_clock::duration block_time {0};    // of the last sent block
+    };
+    using ProgressCallback = std::function<void(const Progress&)>;
     using Buffer = std::vector<unsigned char>;
+    using BufferVector = std::vector<Buffer>; // data of each module, in module order
+
+    // device block (flash write unit). larger blocks need fewer 'dl' round trips.
+    static constexpr uint32_t DefaultBlockSize = 512 * 1024;
+    static constexpr uint32_t MinBlockSize = 64 * 1024;
+    static constexpr uint32_t MaxBlockSize = 4 * 1024 * 1024;
+
+    // block_size is valid if a power of 2 in [MinBlockSize, MaxBlockSize]
+    static bool IsValidBlockSize(uint32_t block_size);
 
     struct Settings
     {
         static const long DefaultBaudRate = 115200;
 
-        std::string fw_filename;
         const char* port = nullptr;
         long baud_rate = DefaultBaudRate;
         bool force_full = false; // if true update all modules and blocks regardless of crc checks
+        bool compress = false;   // send lz4 compressed blocks if the bootloader supports it (raw otherwise)
+        bool stage_only = false; // transfer, verify and validate all the modules without the final reboot
 #ifdef ANDROID
         AndroidSerialConfig android_config;
 #endif
@@ -36,21 +66,42 @@ public:
     FwUpdateEngine() = default;
     ~FwUpdateEngine() = default;
 
-    ModuleVector ModulesFromFile(const std::string& filename);
+    // split to blocks of block_size (the modules can only be burnt with the same block size)
+    ModuleVector ModulesFromImage(const std::shared_ptr<FwImageImpl>& image, uint32_t block_size = DefaultBlockSize);
+    // load the data of the modules, e.g. once for updating several devices
+    static BufferVector LoadModules(const ModuleVector& modules);
     void BurnModules(const Settings& settings, const ModuleVector& modules, ProgressCallback on_progress);
+    // update with already loaded module data (not modified, can be shared by concurrent engines)
+    void BurnModules(const Settings& settings, const ModuleVector& modules, const BufferVector& buffers,
+                     ProgressCallback on_progress);
 
+    // activate modules staged by BurnModules() with Settings::stage_only and reboot the device. throws if one of the
+    // modules is not completely transferred (e.g. an interrupted stage) or its blocks differ from the image.
+    void ActivateModules(const Settings& settings, const ModuleVector& modules);
 
-private:
-    static constexpr const uint32_t BlockSize = 512 * 1024;
+    // make a running (or the next) BurnModules() throw: at once while it waits for the device, after the current
+    // write otherwise. the device keeps the blocks written so far, a later update of the same image resumes the
+    // interrupted module. thread safe.
+    void Cancel();
 
+private:
     struct ModuleVersionInfo;
 
+    void BurnModules(const Settings& settings, const ModuleVector& modules, const BufferVector* buffers,
+                     ProgressCallback on_progress);
+
+    // open the connection (canceled at once if already canceled)
+    void Connect(const Settings& settings);
+
     // do complete fw update session
-    void Session(const ModuleVector& modules, ProgressTick progress_tick, bool force_full);
+    void Session(const ModuleVector& modules, const BufferVector* buffers, bool force_full);
 
     // update single module
-    void BurnModule(ProgressTick tick, const ModuleInfo& module, const Buffer& buffer, bool is_first, bool is_last,
-                    bool force_full);
+    void BurnModule(const ModuleInfo& module, const Buffer& buffer, bool is_first, bool is_last, bool force_full);
+
+    // a block of the current module is done, sent_bytes is 0 if it was skipped
+    void Tick(size_t block_index, size_t sent_bytes, std::chrono::steady_clock::duration block_time);
+    void ThrowIfCanceled() const;
 
     std::vector<bool> GetBlockUpdateList(const ModuleInfo& module, bool force_full);
 
@@ -58,8 +109,15 @@ private:
     bool ParseDlResponse(const std::string& name, size_t blkNo, size_t sz);
     bool ParseDlVer(const char* input, const std::string& module_name, ModuleVersionInfo& result);
     bool ParseDlBlockResult();
+    bool ParseDlInitAck(bool& lz4);
 
     std::unique_ptr<FwUpdaterComm> _comm;
+    std::mutex _comm_mutex; // guards replacing _comm against Cancel()
+    std::atomic<bool> _canceled {false};
+    bool _compress = false;   // offer compressed blocks (Settings::compress)
+    bool _stage_only = false; // no reboot after the last module (Settings::stage_only)
+    Progress _progress;
+    ProgressCallback _on_progress;
 };
 } // namespace FwUpdate
 } // namespace RealSenseID
@@ -1,9 +1,12 @@
 // License: Apache 2.0. See LICENSE file in root directory.
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 #include "FwUpdaterComm.h"
+#include "ThreadConfigImpl.h"
 #include "Logger.h"
 #include "PacketManager/Timer.h"
+#include "PacketManager/SerialFactory.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cassert>
 #include <cmath>
@@ -33,13 +36,7 @@ FwUpdaterComm::FwUpdaterComm(const char* port_name)
     PacketManager::SerialConfig serial_config;
     serial_config.port = port_name;
 
-#ifdef _WIN32
-    _serial = std::make_unique<PacketManager::WindowsSerial>(serial_config);
-#elif LINUX
-    _serial = std::make_unique<PacketManager::LinuxSerial>(serial_config);
-#else
-    throw std::runtime_error("FwUpdaterComm not supported for this OS yet");
-#endif // WIN32
+    _serial = PacketManager::OpenSerialConnection(serial_config);
 
     // create thread thread
     _reader_thread = std::thread([this] { this->ReaderThreadLoop(); });
@@ -67,40 +64,89 @@ FwUpdaterComm::~FwUpdaterComm()
     
     try
     {        
-        delete (_read_buffer);
+        delete[] _read_buffer;
     }
     catch (...)
     {
     }
 }
 
+// Read whatever arrived (in chunks of up to ReceiveBuffer::BufferSize) and wake the waiters.
+// Waits for input at most 100 ms at a time to check the stop flag.
 void FwUpdaterComm::ReaderThreadLoop()
 {
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::FwUpdate, "fw-reader");
+    auto& receive_buffer = _serial->GetReceiveBuffer();
     while (!_should_stop_thread)
     {
-        if (_read_index >= ReadBufferSize - 2)
-        {
-            // should never happen on normal execution, since 128kb should be enough for the entire session
-            assert(false);
-            _read_index = 0;
-            _scan_index = 0;
-        }
-        auto status = this->_serial->RecvBytes(&_read_buffer[_read_index], 1);
-        if (status == PacketManager::SerialStatus::Ok)
+        PacketManager::Timer timer {std::chrono::milliseconds {100}};
+        auto status = receive_buffer.Fill(1, timer);
+        if (status == PacketManager::SerialStatus::RecvTimeout)
         {
-            // putchar((int)_read_buffer[_read_index]);
-            _read_buffer[++_read_index] = '\0'; // always null terminate
             continue;
         }
-        if (status != PacketManager::SerialStatus::RecvTimeout)
+        if (status != PacketManager::SerialStatus::Ok)
         {
             break; // fail reading from the serial
         }
+
+        {
+            std::lock_guard<std::mutex> lock {_read_mutex};
+            auto n_bytes = receive_buffer.Size();
+            if (_read_index + n_bytes >= ReadBufferSize - 1 &&
+                _read_index - _scan_index + n_bytes < ReadBufferSize - 1)
+            {
+                // full of scanned (consumed) input, keep only the unscanned part at the front
+                auto unscanned = _read_index - _scan_index;
+                ::memmove(_read_buffer, &_read_buffer[_scan_index.load()], unscanned);
+                _scan_index = 0;
+                _read_index = unscanned;
+            }
+            if (_read_index + n_bytes >= ReadBufferSize - 1)
+            {
+                // should never happen on normal execution, unscanned input is consumed long before the buffer is full
+                assert(false);
+                _read_index = 0;
+                _scan_index = 0;
+                n_bytes = std::min(n_bytes, ReadBufferSize - 1);
+            }
+            ::memcpy(&_read_buffer[_read_index], receive_buffer.Data(), n_bytes);
+            _read_index += n_bytes;
+            _read_buffer[_read_index] = '\0'; // always null terminate
+            receive_buffer.Consume(receive_buffer.Size());
+        }
+        _read_cv.notify_all();
+    }
+    // wake the waiters, nothing more will arrive
+    _read_cv.notify_all();
+}
+
+template <typename Predicate>
+bool FwUpdaterComm::WaitForInput(Predicate found, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock {_read_mutex};
+    bool is_found =
+        _read_cv.wait_for(lock, timeout, [&] { return _canceled || found(&_read_buffer[_scan_index.load()]); });
+    if (_canceled)
+    {
+        throw std::runtime_error("FwUpdaterComm: canceled");
+    }
+    return is_found;
+}
+
+void FwUpdaterComm::Cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock {_read_mutex};
+        _canceled = true;
     }
+    _read_cv.notify_all();
 }
 
 void FwUpdaterComm::ConsumeScanned()
 {
+    // locked, the reader thread may be moving the unscanned input
+    std::lock_guard<std::mutex> lock {_read_mutex};
     _scan_index = _read_index.load();
 }
 
@@ -119,19 +165,27 @@ char* FwUpdaterComm::ReadBuffer() const
 // wait until no more input (100 ms without any new bytes)
 size_t FwUpdaterComm::WaitForIdle()
 {
+    std::unique_lock<std::mutex> lock {_read_mutex};
     while (true)
     {
-        auto prevIndex = _read_index.load();
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        if (prevIndex == _read_index.load())
+        auto prev_index = _read_index.load();
+        if (!_read_cv.wait_for(lock, std::chrono::milliseconds {100},
+                               [&] { return _read_index != prev_index || _should_stop_thread || _canceled; }) ||
+            _should_stop_thread)
         {
             return _read_index.load();
         }
+        if (_canceled)
+        {
+            throw std::runtime_error("FwUpdaterComm: canceled");
+        }
     }
 }
 
 // 1. Break binary data into chunks of 16kb.
 // 2. Send all chunks, one by one.
+// No delays between the chunks: the usb serial link is flow controlled (writes block while the device is not ready
+// to receive) and each block is acknowledged by the device ('dl' ack before and 'dl ret=' after it).
 void FwUpdaterComm::WriteBinary(const char* buf, size_t n_bytes)
 {
 #ifdef _WIN32
@@ -155,18 +209,16 @@ void FwUpdaterComm::WriteBinary(const char* buf, size_t n_bytes)
         {            
             throw std::runtime_error("FwUpdaterComm::WriteBinary failed");
         }
-        // Give the device time to process the chunk
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }    
 }
 
-// 1. Wait until input drained
+// 1. Skip the input received so far (scan from here)
 // 2. Send the command
 // 3. Wait for cmd "ack" upto 1 second, if wait_response is true
 void FwUpdaterComm::WriteCmd(const std::string& cmd, bool wait_response)
 {
     LOG_DEBUG(LOG_TAG, "WriteCmd \"%s\"", cmd.c_str());
-    WaitForIdle();
+    ConsumeScanned();
     auto serial_status = _serial->SendBytes(cmd.c_str(), cmd.length());
     if (serial_status != PacketManager::SerialStatus::Ok)
     {
@@ -206,25 +258,34 @@ void FwUpdaterComm::WaitForStr(const char* wait_str, std::chrono::milliseconds t
     }
 
     LOG_DEBUG(LOG_TAG, "waiting [%s] for %zu millis..", wait_str, timeout.count());    
-    auto scan_idx = _scan_index.load();
-
-    while (!timer.ReachedTimeout())
+    auto found = WaitForInput([wait_str](const char* input) { return strstr(input, wait_str) != nullptr; }, timeout);
+    if (!found)
     {
-        WaitForIdle();
+        ConsumeScanned();
+        throw std::runtime_error("FwUpdaterComm::WaitForStr failed");
+    }
+    LOG_DEBUG(LOG_TAG, "Got the expected str \"%s\" after %zu millis", wait_str, timer.Elapsed().count());
+}
 
-        auto found = strstr(&_read_buffer[scan_idx], wait_str) != nullptr;
-        if (found)
-        {
-            LOG_DEBUG(LOG_TAG, "Got the expected str \"%s\" after %zu millis", wait_str, timer.Elapsed().count());            
-            return;
-        }
+bool FwUpdaterComm::WaitForLine(const char* wait_str, std::chrono::milliseconds timeout)
+{
+    using PacketManager::Timer;
 
-        if (timer.ReachedTimeout())
-        {                        
-            ConsumeScanned();
-            throw std::runtime_error("FwUpdaterComm::WaitForStr failed");            
-        }
-    }    
+    Timer timer {timeout};
+    LOG_DEBUG(LOG_TAG, "waiting line [%s] for %zu millis..", wait_str, timeout.count());
+    auto found = WaitForInput(
+        [wait_str](const char* input) {
+            const char* p = strstr(input, wait_str);
+            return p != nullptr && strpbrk(p + strlen(wait_str), "\r\n") != nullptr;
+        },
+        timeout);
+    if (!found)
+    {
+        LOG_DEBUG(LOG_TAG, "Timeout waiting line [%s]", wait_str);
+        return false;
+    }
+    LOG_DEBUG(LOG_TAG, "Got the expected line \"%s\" after %zu millis", wait_str, timer.Elapsed().count());
+    return true;
 }
 
 void FwUpdaterComm::StopReaderThread()
@@ -7,6 +7,8 @@
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #ifdef ANDROID
 #include "RealSenseID/AndroidSerialConfig.h"
@@ -19,7 +21,11 @@ namespace FwUpdate
 class FwUpdaterComm
 {
 public:
+#ifdef RSID_LOW_MEMORY
+    static const size_t ReadBufferSize = 32 * 1024;
+#else
     static const size_t ReadBufferSize = 128 * 1024;
+#endif
     explicit FwUpdaterComm(const char* port_name);
 #ifdef ANDROID
     FwUpdaterComm(const AndroidSerialConfig& config);
@@ -37,23 +43,31 @@ public:
     char* ReadBuffer() const;
 
     // wait until no more input (100 ms without any new bytes). return index to current data
-    // throw std::runtime_error if failed
+    // used only to drain the device output on connect, responses are waited for with WaitForStr()/WaitForLine()
     size_t WaitForIdle();
 
     // write bytes to the serial port
     // throw std::runtime_error if failed
     void WriteBinary(const char* buf, size_t n_bytes);
 
-    // 1. Wait until input drained
-    // 2. Send the comman
-    // 3 Waif for cmd "ack" upto 1 second, if wait_response is true
+    // 1. Skip the input received so far (scan from here)
+    // 2. Send the command
+    // 3. Wait for cmd "ack" upto 1 second, if wait_response is true
     // throw std::runtime_error if failed
     void WriteCmd(const std::string& cmd, bool wait_response = true);
     
-    // Wait until str appears in the serial input
+    // Wait until str appears in the serial input (from the scan pointer). Returns as soon as it arrives.
     // throw std::runtime_error if failed
     void WaitForStr(const char* str, std::chrono::milliseconds timeout);
 
+    // Wait until str and the rest of its line appear in the serial input (from the scan pointer).
+    // return false on timeout
+    bool WaitForLine(const char* str, std::chrono::milliseconds timeout);
+
+    // Make the current and the later waits for input throw std::runtime_error, e.g. to cancel the update.
+    // Writes in progress are not interrupted. Thread safe.
+    void Cancel();
+
     // Stop and join the reading thread. 
     // Needed to avoid errors while connection is about to be closed befor reboot device
     void StopReaderThread();
@@ -63,11 +77,20 @@ private:
     std::unique_ptr<PacketManager::SerialConnection> _serial;
     std::thread _reader_thread;
     std::atomic<bool> _should_stop_thread {false};
+    std::atomic<bool> _canceled {false};
     std::atomic<size_t> _read_index {0};
     std::atomic<size_t> _scan_index {0};
     char* _read_buffer;
+
+    // guards appending to the read buffer, signaled on every received chunk
+    std::mutex _read_mutex;
+    std::condition_variable _read_cv;
     
     void ReaderThreadLoop();
+    // wait until found(scan pointer) is true or timeout, evaluated on every received chunk. return found's result.
+    // throws if canceled
+    template <typename Predicate>
+    bool WaitForInput(Predicate found, std::chrono::milliseconds timeout);
 };
 } // namespace FwUpdate
 } // namespace RealSenseID
@@ -0,0 +1,113 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#include "Lz4.h"
+#include <cstdint>
+#include <cstring>
+
+namespace RealSenseID
+{
+namespace FwUpdate
+{
+// lz4 block format limits
+static constexpr size_t MIN_MATCH = 4;
+static constexpr size_t LAST_LITERALS = 5; // the last 5 bytes are always literals
+static constexpr size_t MF_LIMIT = 12;     // a match must start at least 12 bytes before the end
+static constexpr size_t MAX_OFFSET = 65535;
+static constexpr unsigned int HASH_BITS = 12;
+
+static uint32_t Read32(const unsigned char* p)
+{
+    uint32_t value;
+    ::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t Hash(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+// length of a literal run or match above the 4 bits of the token: 255 per byte, then the rest
+static void WriteLength(std::vector<unsigned char>& out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        out.push_back(255);
+    }
+    out.push_back(static_cast<unsigned char>(length));
+}
+
+static void WriteSequence(std::vector<unsigned char>& out, const unsigned char* literals, size_t n_literals,
+                          size_t offset, size_t match_length)
+{
+    size_t match_code = match_length >= MIN_MATCH ? match_length - MIN_MATCH : 0;
+    unsigned char token = static_cast<unsigned char>((n_literals >= 15 ? 15 : n_literals) << 4);
+    if (match_length >= MIN_MATCH)
+    {
+        token |= static_cast<unsigned char>(match_code >= 15 ? 15 : match_code);
+    }
+    out.push_back(token);
+    if (n_literals >= 15)
+    {
+        WriteLength(out, n_literals - 15);
+    }
+    out.insert(out.end(), literals, literals + n_literals);
+
+    // the last sequence has literals only
+    if (match_length < MIN_MATCH)
+    {
+        return;
+    }
+    out.push_back(static_cast<unsigned char>(offset & 0xff));
+    out.push_back(static_cast<unsigned char>(offset >> 8));
+    if (match_code >= 15)
+    {
+        WriteLength(out, match_code - 15);
+    }
+}
+
+std::vector<unsigned char> Lz4CompressBlock(const unsigned char* data, size_t n_bytes)
+{
+    std::vector<unsigned char> out;
+    out.reserve(n_bytes + n_bytes / 255 + 16);
+
+    const unsigned char* anchor = data; // start of the pending literals
+    if (n_bytes > MF_LIMIT)
+    {
+        // positions (+1, 0 is empty) of the last occurrence of each hashed 4 byte sequence
+        std::vector<uint32_t> table(size_t {1} << HASH_BITS, 0);
+        const unsigned char* match_limit = data + n_bytes - LAST_LITERALS;
+        const unsigned char* last_match_start = data + n_bytes - MF_LIMIT;
+
+        const unsigned char* p = data;
+        while (p <= last_match_start)
+        {
+            auto sequence = Read32(p);
+            auto& slot = table[Hash(sequence)];
+            const unsigned char* candidate = slot ? data + slot - 1 : nullptr;
+            slot = static_cast<uint32_t>(p - data + 1);
+
+            if (!candidate || static_cast<size_t>(p - candidate) > MAX_OFFSET || Read32(candidate) != sequence)
+            {
+                p++;
+                continue;
+            }
+
+            // extend the match forward, up to the last literals
+            size_t match_length = MIN_MATCH;
+            while (p + match_length < match_limit && p[match_length] == candidate[match_length])
+            {
+                match_length++;
+            }
+            WriteSequence(out, anchor, static_cast<size_t>(p - anchor), static_cast<size_t>(p - candidate),
+                          match_length);
+            p += match_length;
+            anchor = p;
+        }
+    }
+
+    WriteSequence(out, anchor, static_cast<size_t>(data + n_bytes - anchor), 0, 0);
+    return out;
+}
+} // namespace FwUpdate
+} // namespace RealSenseID
@@ -0,0 +1,17 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace RealSenseID
+{
+namespace FwUpdate
+{
+// Compress n_bytes to a single LZ4 block (lz4 block format, no frame header), decompressable by any LZ4 block
+// decoder (e.g. LZ4_decompress_safe). Greedy single pass matcher with a 4K entries hash table.
+// The result may be larger than the input for incompressible data (callers should send those raw).
+std::vector<unsigned char> Lz4CompressBlock(const unsigned char* data, size_t n_bytes);
+} // namespace FwUpdate
+} // namespace RealSenseID
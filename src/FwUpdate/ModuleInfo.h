@@ -2,12 +2,15 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <cinttypes>
 
 namespace RealSenseID
 {
+class FwImageImpl;
+
 namespace FwUpdate
 {
 // each module consists of n blocks, each with offset, size and crc
@@ -20,14 +23,15 @@ struct BlockInfo
 
 struct ModuleInfo
 {
-    std::string filename;          // path to module file
-    size_t file_offset = 0;        // module start offset in file
-    size_t size = 0;               // actual data size
-    size_t aligned_size = 0;       // aligned data size
-    std::string name;              // module name
-    std::string version;           // module version
-    uint32_t crc = 0;              // crc of entire module
-    std::vector<BlockInfo> blocks; // block specific data
+    std::shared_ptr<FwImageImpl> image; // image of the module
+    size_t file_offset = 0;             // module start offset in the image
+    size_t size = 0;                    // actual data size
+    size_t aligned_size = 0;            // aligned data size
+    std::string name;                   // module name
+    std::string version;                // module version
+    uint32_t crc = 0;                   // crc of entire module
+    uint32_t block_size = 0;            // size of the blocks the module was split to
+    std::vector<BlockInfo> blocks;      // block specific data
 };
 
 using ModuleVector = std::vector<ModuleInfo>;
@@ -1,14 +1,20 @@
 // License: Apache 2.0. See LICENSE file in root directory.
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 #include "Utilities.h"
+#include "FwImageImpl.h"
 #include "Logger.h"
-#include <fstream>
+#include "TaskScheduler.h"
 #include <stdexcept>
 #include <vector>
 #include <cstring>
 #include <cassert>
 #include <algorithm>
 
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define RSID_FW_ARM_CRC32
+#endif
+
 namespace RealSenseID
 {
 namespace FwUpdate
@@ -108,13 +114,9 @@ static bool UfifCheckHeader(const UfifFile& header)
     return true;
 }
 
-static std::vector<UfifEntry> UfifReadHeader(std::ifstream& file, UfifFile& header)
+static std::vector<UfifEntry> UfifReadHeader(FwImageImpl& image, UfifFile& header)
 {
-    if (!file.read((char*)&header, sizeof(UfifFile)))
-    {
-        throw std::runtime_error("Error while reading ufifFile_t");
-    }
-
+    image.Read(0, sizeof(UfifFile), reinterpret_cast<unsigned char*>(&header));
 
     if (!UfifCheckHeader(header))
     {
@@ -123,74 +125,109 @@ static std::vector<UfifEntry> UfifReadHeader(std::ifstream& file, UfifFile& head
 
     // read headers entries from file
     std::vector<UfifEntry> rv(header.entryN);
-    if (!file.read((char*)rv.data(), rv.size() * sizeof(UfifEntry)))
+    auto entries_size = rv.size() * sizeof(UfifEntry);
+    if (entries_size > 0)
     {
-        throw std::runtime_error("Error while reading ufifEntries");
+        image.Read(sizeof(UfifFile), entries_size, reinterpret_cast<unsigned char*>(rv.data()));
     }
     return rv;
 }
 
-uint32_t CalculateCRC(uint32_t crc, const void* buffer, uint32_t buffer_size)
+// CRC_LUT extended to the tables of slice-by-8: table k is the crc of a byte followed by k zero bytes
+struct CrcTables
 {
-    auto current = static_cast<const uint32_t*>(buffer);
-    auto end = static_cast<const uint32_t*>(current + (buffer_size / sizeof(buffer_size)));
+    uint32_t table[8][256];
 
-    crc = crc ^ ~0U;
-
-    if (buffer_size != 0)
+    CrcTables()
     {
-        do
+        for (int i = 0; i < 256; i++)
+        {
+            table[0][i] = CRC_LUT[i];
+        }
+        for (int k = 1; k < 8; k++)
         {
-            uint32_t value = *current++;
-            crc = CRC_LUT[(crc ^ (value >> 0)) & 0xff] ^ (crc >> 8);
-            crc = CRC_LUT[(crc ^ (value >> 8)) & 0xff] ^ (crc >> 8);
-            crc = CRC_LUT[(crc ^ (value >> 16)) & 0xff] ^ (crc >> 8);
-            crc = CRC_LUT[(crc ^ (value >> 24)) & 0xff] ^ (crc >> 8);
-        } while (current != end);
+            for (int i = 0; i < 256; i++)
+            {
+                table[k][i] = (table[k - 1][i] >> 8) ^ CRC_LUT[table[k - 1][i] & 0xff];
+            }
+        }
     }
-    return crc ^ ~0U;
+};
+
+static uint32_t Load32(const unsigned char* p)
+{
+    uint32_t value;
+    ::memcpy(&value, p, sizeof(value));
+    return value;
 }
 
-ModuleVector ParseUfifToModules(const std::string& path, const uint32_t block_size)
-{     
-    std::ifstream ifile(path, std::ios::binary);
-    if (!ifile)
+// update a (pre inverted) crc with n_bytes. bytes are in little endian word order, as the device computes it.
+static uint32_t UpdateCRC(uint32_t crc, const unsigned char* data, size_t n_bytes)
+{
+#ifdef RSID_FW_ARM_CRC32
+    for (; n_bytes >= 8; data += 8, n_bytes -= 8)
+    {
+        uint64_t value;
+        ::memcpy(&value, data, sizeof(value));
+        crc = __crc32d(crc, value);
+    }
+    for (; n_bytes > 0; data++, n_bytes--)
     {
-        throw std::runtime_error("Error while trying to read project header");
+        crc = __crc32b(crc, *data);
     }
-    ifile.unsetf(std::ios::skipws);
+    return crc;
+#else
+    static const CrcTables tables;
+    const auto& t = tables.table;
+    for (; n_bytes >= 8; data += 8, n_bytes -= 8)
+    {
+        uint32_t one = Load32(data) ^ crc;
+        uint32_t two = Load32(data + 4);
+        crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^ t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+              t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^ t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+    }
+    for (; n_bytes > 0; data++, n_bytes--)
+    {
+        crc = t[0][(crc ^ *data) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+#endif
+}
+
+uint32_t CalculateCRC(uint32_t crc, const void* buffer, uint32_t buffer_size)
+{
+    // whole words only
+    return UpdateCRC(crc ^ ~0U, static_cast<const unsigned char*>(buffer), buffer_size & ~3U) ^ ~0U;
+}
+
+// crc of n_bytes of data followed by zeroes up to crc_size bytes (the zero alignment of the module buffer)
+static uint32_t CalculatePaddedCRC(uint32_t crc, const unsigned char* data, size_t n_bytes, size_t crc_size)
+{
+    static const unsigned char zeroes[4] = {0};
+    crc = UpdateCRC(crc ^ ~0U, data, n_bytes);
+    return UpdateCRC(crc, zeroes, crc_size - n_bytes) ^ ~0U;
+}
 
+// Images in memory (mapped files, buffers) are not copied: the module and block crcs are computed on the image's data,
+// the crc of the whole module concurrently with the block crcs. Images of readers are read block by block, each
+// block's crc (and the module's) computed as it arrives.
+ModuleVector ParseUfifToModules(const std::shared_ptr<FwImageImpl>& image, const uint32_t block_size)
+{
     UfifFile header;
-    auto entries = UfifReadHeader(ifile, header);
+    auto entries = UfifReadHeader(*image, header);
 
     ModuleVector result;
+    size_t ofs = sizeof(UfifFile) + entries.size() * sizeof(UfifEntry);
+    std::vector<unsigned char> block_buffer; // block read from a reader
     for (const auto& entry : entries)
     {
         DigestHeader hdr = {0};
-        auto ofs = ifile.tellg();
-        if (ofs == -1)
-        {
-            throw std::runtime_error("tellg failed");
-        }
-
         if (ofs % UFIF_ALIGN)
         {
             ofs += UFIF_ALIGN - ofs % UFIF_ALIGN;
-            if (!ifile.seekg(ofs))
-            {
-                throw std::runtime_error("seekg failed");
-            }
-        }
-
-        if (!ifile.read((char*)&hdr, sizeof(hdr)))
-        {
-            throw std::runtime_error("read failed");
         }
 
-        if (!ifile.seekg(ofs))
-        {
-            throw std::runtime_error("seekg failed while reading digest header");
-        }
+        image->Read(ofs, sizeof(hdr), reinterpret_cast<unsigned char*>(&hdr));
 
         if ((hdr.ver >> 16) != (DIGEST_HEADER_VERSION >> 16))
         {
@@ -222,30 +259,36 @@ ModuleVector ParseUfifToModules(const std::string& path, const uint32_t block_si
         }
         LOG_DEBUG(LOG_TAG, "[%8s] %0.2f MB,  %u blocks", module_name.c_str(), entry.size / 1048576.0, n_blocks);
 
-        // buffer to store module data,
-        // init with zeroes so alignment bytes(aligned_buffer_size-entry.size) are all zeroes
-        std::vector<unsigned char> module_buffer(aligned_buffer_size, 0);
-        if (!ifile.read((char*)&module_buffer[0], entry.size))
-        {
-            throw std::runtime_error("Failed reading module from file");
-        }
+        // module data if the image is in memory, bytes past entry.size count as zeroes (alignment of the module
+        // buffer)
+        const unsigned char* module_data = image->Data(ofs, entry.size);
 
         // crc sz must be 4-aligned
         uint32_t crc_aligned_data_size = (entry.size + 3) & ~3;
-        auto whole_module_crc = CalculateCRC(0, module_buffer.data(), crc_aligned_data_size);
-        if (whole_module_crc != entry.crc32)
+        const uint32_t module_crc_size = crc_aligned_data_size;
+        // the whole module's crc on the task scheduler, while the block crcs are calculated here
+        uint32_t whole_module_crc = 0;
+        TaskGroup whole_module_crc_task {TaskScheduler::Acquire()};
+        if (module_data)
         {
-            throw std::runtime_error("Invalid crc field in module " + module_name);
+            whole_module_crc_task.Run([&whole_module_crc, module_data, entry, crc_aligned_data_size] {
+                whole_module_crc = CalculatePaddedCRC(0, module_data, entry.size, crc_aligned_data_size);
+            });
+        }
+        else
+        {
+            block_buffer.resize(block_size);
         }
+        uint32_t streamed_module_crc = ~0U; // pre inverted, of the blocks read so far
 
         ModuleInfo module_info;
-        module_info.crc = whole_module_crc;
         module_info.name = module_name;
         module_info.version = (char*)hdr.binVer;
-        module_info.filename = path;
+        module_info.image = image;
         module_info.file_offset = ofs;
         module_info.size = entry.size;
         module_info.aligned_size = aligned_buffer_size;
+        module_info.block_size = block_size;
 
         uint32_t block_crc_size;
         for (unsigned i = 0; i < n_blocks; i++)
@@ -254,33 +297,46 @@ ModuleVector ParseUfifToModules(const std::string& path, const uint32_t block_si
             block.offset = i * static_cast<size_t>(block_size);
             block_crc_size = std::min(crc_aligned_data_size, block_size);
             block.size = block_crc_size;
-            block.crc = CalculateCRC(i, &module_buffer[block.offset], block_crc_size);
+            size_t data_size = block.offset < entry.size ? std::min<size_t>(entry.size - block.offset, block_crc_size)
+                                                         : 0;
+            const unsigned char* block_data = module_data ? module_data + block.offset : block_buffer.data();
+            if (!module_data && data_size > 0)
+            {
+                image->Read(ofs + block.offset, data_size, block_buffer.data());
+                streamed_module_crc = UpdateCRC(streamed_module_crc, block_buffer.data(), data_size);
+            }
+            block.crc = CalculatePaddedCRC(i, block_data, data_size, block_crc_size);
             crc_aligned_data_size -= block_crc_size;
             module_info.blocks.push_back(block);
         }
+
+        if (module_data)
+        {
+            whole_module_crc_task.Wait();
+        }
+        else
+        {
+            static const unsigned char zeroes[4] = {0};
+            whole_module_crc = UpdateCRC(streamed_module_crc, zeroes, module_crc_size - entry.size) ^ ~0U;
+        }
+        if (whole_module_crc != entry.crc32)
+        {
+            throw std::runtime_error("Invalid crc field in module " + module_name);
+        }
+        module_info.crc = whole_module_crc;
         result.push_back(module_info);
-    }    
+        ofs += entry.size;
+    }
     return result;
 }
 
-std::vector<unsigned char> LoadFileToBuffer(const std::string& path, size_t aligned_size, size_t size, size_t offset)
+std::vector<unsigned char> LoadModuleBuffer(const ModuleInfo& module)
 {
-    if (aligned_size < size)
+    if (module.aligned_size < module.size)
         throw std::runtime_error("Requested buffer size is smaller than actual data size");
 
-    std::ifstream file(path, std::ios::binary);
-    if (!file)
-        throw std::runtime_error("Failed open file for binary read");
-
-    file.unsetf(std::ios::skipws);
-    file.seekg(offset, std::ios::beg);
-
-    std::vector<unsigned char> buffer(aligned_size, 0);
-    if (!file.read(reinterpret_cast<char*>(buffer.data()), size))
-    {
-        throw std::runtime_error("Failed reading all bytes from file");
-    }
-
+    std::vector<unsigned char> buffer(module.aligned_size, 0);
+    module.image->Read(module.file_offset, module.size, buffer.data());
     return buffer;
 }
 } // namespace FwUpdate
@@ -4,6 +4,7 @@
 
 #include "ModuleInfo.h"
 #include <cstdint>
+#include <memory>
 #include <string>
 
 namespace RealSenseID
@@ -13,10 +14,10 @@ namespace FwUpdate
 // calculates crc on a data buffer
 uint32_t CalculateCRC(uint32_t crc, const void* buffer, uint32_t buffer_size);
 
-// parses a packaged binary firmware file and returns a list of modules with their metadata
-ModuleVector ParseUfifToModules(const std::string& path, const uint32_t block_size);
+// parses a packaged binary firmware image and returns a list of modules with their metadata
+ModuleVector ParseUfifToModules(const std::shared_ptr<FwImageImpl>& image, const uint32_t block_size);
 
-// Load data of specified size and from specified offset into a buffer of an aligned size
-std::vector<unsigned char> LoadFileToBuffer(const std::string& path, size_t aligned_size, size_t size, size_t offset);
+// Load the data of the module from its image into a buffer of its aligned size
+std::vector<unsigned char> LoadModuleBuffer(const ModuleInfo& module);
 } // namespace FwUpdate
 } // namespace RealSenseID
\ No newline at end of file
@@ -2,12 +2,20 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 #include "RealSenseID/FwUpdater.h"
 #include "FwUpdate/FwUpdateEngine.h"
+#include "FwUpdate/FwImageImpl.h"
 #include "PacketManager/Timer.h"
+#include "AsyncExecutor.h"
 #include "Logger.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 namespace RealSenseID
 {
@@ -28,21 +36,182 @@ static bool DoesFileExist(const char* path)
     return f.good();
 }
 
+static FwUpdateEngine::Settings InternalSettings(const FwUpdater::Settings& settings)
+{
+    FwUpdateEngine::Settings internal_settings;
+    internal_settings.baud_rate = NORMAL_BAUD_RATE;
+    internal_settings.port = settings.port;
+    internal_settings.force_full = settings.force_full;
+    internal_settings.compress = settings.compress;
+    internal_settings.stage_only = settings.stage_only;
+#ifdef ANDROID
+    internal_settings.android_config = settings.android_config;
+#endif
+    return internal_settings;
+}
+
+static uint32_t BlockSize(const FwUpdater::Settings& settings)
+{
+    return settings.block_size != 0 ? settings.block_size : FwUpdateEngine::DefaultBlockSize;
+}
+
+static ModuleVector ModulesToUpdate(FwUpdateEngine& update_engine, const std::shared_ptr<FwImageImpl>& image,
+                                    bool excludeRecognition, uint32_t block_size)
+{
+    auto modules = update_engine.ModulesFromImage(image, block_size);
+    if (excludeRecognition)
+    {
+        modules.erase(std::remove_if(modules.begin(), modules.end(),
+                                     [](const ModuleInfo& mod_info) { return mod_info.name == MODULE_RECOG; }),
+                      modules.end());
+    }
+    return modules;
+}
+
+static FwUpdater::UpdateProgress ToUpdateProgress(const FwUpdateEngine::Progress& progress,
+                                                  std::chrono::steady_clock::time_point start)
+{
+    using namespace std::chrono;
+    FwUpdater::UpdateProgress result;
+    result.progress = progress.progress;
+    if (progress.module != nullptr)
+    {
+        result.module = progress.module->name.c_str();
+        result.module_blocks = progress.module->blocks.size();
+    }
+    result.module_index = progress.module_index;
+    result.module_count = progress.n_modules;
+    result.block_index = progress.block_index;
+    result.blocks_done = progress.blocks_done;
+    result.blocks_total = progress.n_blocks;
+    result.blocks_sent = progress.blocks_sent;
+    result.bytes_sent = progress.bytes_sent;
+    result.elapsed_ms = static_cast<unsigned int>(duration_cast<milliseconds>(steady_clock::now() - start).count());
+    result.transfer_ms = static_cast<unsigned int>(duration_cast<milliseconds>(progress.transfer_time).count());
+    result.last_block_ms = static_cast<unsigned int>(duration_cast<milliseconds>(progress.block_time).count());
+    const double transfer_seconds = duration<double>(progress.transfer_time).count();
+    if (transfer_seconds > 0)
+    {
+        result.bytes_per_second = static_cast<float>(progress.bytes_sent / transfer_seconds);
+    }
+    return result;
+}
+
+// Update() on the given engine, canceled by FwUpdateEngine::Cancel()
+static Status UpdateDevice(FwUpdateEngine& update_engine, FwUpdater::EventHandler* handler,
+                           const FwUpdater::Settings& settings, const std::shared_ptr<FwImageImpl>& image,
+                           bool excludeRecognition)
+{
+    try
+    {
+        const auto start = std::chrono::steady_clock::now();
+        auto callback_wrapper = [&handler, start](const FwUpdateEngine::Progress& progress) {
+            LOG_INFO(LOG_TAG, "Progress: %d%%", static_cast<int>(progress.progress * 100));
+            if (handler != nullptr)
+            {
+                handler->OnProgress(progress.progress);
+                handler->OnUpdateProgress(ToUpdateProgress(progress, start));
+            }
+        };
+
+        auto internal_settings = InternalSettings(settings);
+
+        auto modules = ModulesToUpdate(update_engine, image, excludeRecognition, BlockSize(settings));
+
+        PacketManager::Timer timer;
+        TransferCoordinator::Scope transfer {settings.coordinator};
+        update_engine.BurnModules(internal_settings, modules, callback_wrapper);
+        auto elapsed_seconds = timer.Elapsed() / 1000;
+        LOG_INFO(LOG_TAG, "Firmware update success (duration %lldm:%llds)", elapsed_seconds / 60, elapsed_seconds % 60);
+        return Status::Ok;
+    }
+    catch (const std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+        return Status::Error;
+    }
+}
+
+// executor of the async updates of a FwUpdater, and its updates not known to be done
+class FwUpdaterImpl
+{
+public:
+    FwUpdaterImpl() = default;
+
+    ~FwUpdaterImpl()
+    {
+        std::vector<AsyncOperation> updates;
+        {
+            std::lock_guard<std::mutex> lock {_mutex};
+            updates.swap(_updates);
+        }
+        for (auto& update : updates)
+        {
+            update.Cancel();
+            update.Wait();
+        }
+    }
+
+    FwUpdaterImpl(const FwUpdaterImpl&) = delete;
+    FwUpdaterImpl& operator=(const FwUpdaterImpl&) = delete;
+
+    AsyncOperation Run(AsyncOperationImpl::Work work, AsyncOperationImpl::Canceller canceller,
+                       AsyncOperation::Completion completion)
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (!_executor)
+        {
+            _executor = AsyncExecutor::Acquire();
+        }
+        _updates.erase(std::remove_if(_updates.begin(), _updates.end(),
+                                      [](const AsyncOperation& update) { return update.IsDone(); }),
+                       _updates.end());
+
+        auto* operation = new AsyncOperationImpl(std::move(work), std::move(canceller), std::move(completion));
+        auto handle = AsyncOperationImpl::Handle(operation);
+        _executor->Post(operation);
+        operation->Release();
+        _updates.push_back(handle);
+        return handle;
+    }
+
+private:
+    std::mutex _mutex;
+    std::shared_ptr<AsyncExecutor> _executor; // released once the updates are done
+    std::vector<AsyncOperation> _updates;
+};
+
+FwUpdater::FwUpdater() : _impl {new FwUpdaterImpl}
+{
+}
+
+FwUpdater::~FwUpdater()
+{
+    delete _impl;
+}
+
 bool FwUpdater::ExtractFwVersion(const char* binPath, std::string& outFwVersion,
                                  std::string& outRecognitionVersion) const
+{
+    outFwVersion.clear();
+    outRecognitionVersion.clear();
+    if (!DoesFileExist(binPath))
+    {
+        return false;
+    }
+    return ExtractFwVersion(FwImage::FromFile(binPath), outFwVersion, outRecognitionVersion);
+}
+
+bool FwUpdater::ExtractFwVersion(const FwImage& image, std::string& outFwVersion,
+                                 std::string& outRecognitionVersion) const
 {
     try
     {
         outFwVersion.clear();
         outRecognitionVersion.clear();
 
-        if (!DoesFileExist(binPath))
-        {
-            return false;
-        }
-
         FwUpdateEngine update_engine;
-        auto modules = update_engine.ModulesFromFile(binPath);
+        auto modules = update_engine.ModulesFromImage(image._impl);
 
         for (const auto& module : modules)
         {
@@ -73,51 +242,213 @@ bool FwUpdater::ExtractFwVersion(const char* binPath, std::string& outFwVersion,
 Status FwUpdater::Update(FwUpdater::EventHandler* handler, Settings settings, const char* binPath,
                          bool excludeRecognition) const
 {
+    // Check firmware upgrade file exists.
+    if (!DoesFileExist(binPath))
+    {
+        LOG_ERROR(LOG_TAG, "file does not exist: :%s", binPath);
+        return Status::Error;
+    }
+    return Update(handler, settings, FwImage::FromFile(binPath), excludeRecognition);
+}
+
+Status FwUpdater::Update(FwUpdater::EventHandler* handler, Settings settings, const FwImage& image,
+                         bool excludeRecognition) const
+{
+    FwUpdateEngine update_engine;
+    return UpdateDevice(update_engine, handler, settings, image._impl, excludeRecognition);
+}
+
+Status FwUpdater::Activate(Settings settings, const char* binPath, bool excludeRecognition) const
+{
+    if (!DoesFileExist(binPath))
+    {
+        LOG_ERROR(LOG_TAG, "file does not exist: :%s", binPath);
+        return Status::Error;
+    }
+    return Activate(settings, FwImage::FromFile(binPath), excludeRecognition);
+}
+
+Status FwUpdater::Activate(Settings settings, const FwImage& image, bool excludeRecognition) const
+{
+    try
+    {
+        FwUpdateEngine update_engine;
+        auto modules = ModulesToUpdate(update_engine, image._impl, excludeRecognition, BlockSize(settings));
+
+        PacketManager::Timer timer;
+        update_engine.ActivateModules(InternalSettings(settings), modules);
+        LOG_INFO(LOG_TAG, "Firmware activated (%lld ms)", timer.Elapsed());
+        return Status::Ok;
+    }
+    catch (const std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+        return Status::Error;
+    }
+}
+
+AsyncOperation FwUpdater::UpdateAsync(EventHandler* handler, Settings settings, const char* binPath,
+                                      bool excludeRecognition, AsyncOperation::Completion completion) const
+{
+    return UpdateAsync(handler, settings, FwImage::FromFile(binPath), excludeRecognition, std::move(completion));
+}
+
+AsyncOperation FwUpdater::UpdateAsync(EventHandler* handler, Settings settings, const FwImage& image,
+                                      bool excludeRecognition, AsyncOperation::Completion completion) const
+{
+    auto update_engine = std::make_shared<FwUpdateEngine>();
+    // the caller's strings may be gone before the update starts
+    const bool has_port = settings.port != nullptr;
+    std::string port = has_port ? settings.port : "";
+    auto image_impl = image._impl;
+    auto work = [update_engine, handler, settings, has_port, port, image_impl, excludeRecognition]() mutable {
+        settings.port = has_port ? port.c_str() : nullptr;
+        return UpdateDevice(*update_engine, handler, settings, image_impl, excludeRecognition);
+    };
+    auto canceller = [update_engine] {
+        LOG_INFO(LOG_TAG, "Canceling firmware update");
+        update_engine->Cancel();
+    };
+    return _impl->Run(std::move(work), std::move(canceller), std::move(completion));
+}
+
+std::vector<Status> FwUpdater::UpdateFleet(FleetEventHandler* handler, const std::vector<Settings>& devices,
+                                           const char* binPath, bool excludeRecognition) const
+{
+    return UpdateFleet(handler, devices, binPath, excludeRecognition, FleetSettings());
+}
+
+std::vector<Status> FwUpdater::UpdateFleet(FleetEventHandler* handler, const std::vector<Settings>& devices,
+                                           const char* binPath, bool excludeRecognition,
+                                           const FleetSettings& fleetSettings) const
+{
+    if (!devices.empty() && !DoesFileExist(binPath))
+    {
+        LOG_ERROR(LOG_TAG, "file does not exist: :%s", binPath);
+        return std::vector<Status>(devices.size(), Status::Error);
+    }
+    return UpdateFleet(handler, devices, FwImage::FromFile(binPath), excludeRecognition, fleetSettings);
+}
+
+std::vector<Status> FwUpdater::UpdateFleet(FleetEventHandler* handler, const std::vector<Settings>& devices,
+                                           const FwImage& image, bool excludeRecognition) const
+{
+    return UpdateFleet(handler, devices, image, excludeRecognition, FleetSettings());
+}
+
+std::vector<Status> FwUpdater::UpdateFleet(FleetEventHandler* handler, const std::vector<Settings>& devices,
+                                           const FwImage& image, bool excludeRecognition,
+                                           const FleetSettings& fleetSettings) const
+{
+    std::vector<Status> statuses(devices.size(), Status::Error);
+    if (devices.empty())
+    {
+        return statuses;
+    }
+
+    // parse, verify and load the image once for all the devices (split once per block size in use)
+    std::map<uint32_t, ModuleVector> modules;
+    FwUpdateEngine::BufferVector buffers;
     try
     {
-        // Check firmware upgrade file exists.
-        if (!DoesFileExist(binPath))
+        FwUpdateEngine parse_engine;
+        for (const auto& settings : devices)
         {
-            LOG_ERROR(LOG_TAG, "file does not exist: :%s", binPath);
-            return Status::Error;
+            auto block_size = BlockSize(settings);
+            if (modules.find(block_size) == modules.end())
+            {
+                modules[block_size] = ModulesToUpdate(parse_engine, image._impl, excludeRecognition, block_size);
+            }
         }
+        buffers = FwUpdateEngine::LoadModules(modules.begin()->second);
+    }
+    catch (const std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+        return statuses;
+    }
+
+    std::mutex handler_mutex; // serializes the handler calls
+    std::atomic<std::size_t> next_device {0};
+    std::atomic<unsigned int> n_failed {0};
 
-        auto callback_wrapper = [&handler](float progress) {
-            LOG_INFO(LOG_TAG, "Progress: %d%%", static_cast<int>(progress * 100));
+    auto update_device = [&](std::size_t device_index) {
+        const auto& settings = devices[device_index];
+        const auto start = std::chrono::steady_clock::now();
+        auto on_progress = [&, device_index, start](const FwUpdateEngine::Progress& progress) {
+            LOG_INFO(LOG_TAG, "Device %zu progress: %d%%", device_index, static_cast<int>(progress.progress * 100));
             if (handler != nullptr)
             {
-                handler->OnProgress(progress);
+                std::lock_guard<std::mutex> lock {handler_mutex};
+                handler->OnProgress(device_index, progress.progress);
+                handler->OnUpdateProgress(device_index, ToUpdateProgress(progress, start));
             }
         };
 
-        FwUpdateEngine::Settings internal_settings;
-        internal_settings.fw_filename = binPath;
-        internal_settings.baud_rate = NORMAL_BAUD_RATE;
-        internal_settings.port = settings.port;
-        internal_settings.force_full = settings.force_full;
-#ifdef ANDROID
-        internal_settings.android_config = settings.android_config;
-#endif
-
-        FwUpdateEngine update_engine;
-        auto modules = update_engine.ModulesFromFile(binPath);
+        Status status = Status::Error;
+        try
+        {
+            PacketManager::Timer timer;
+            FwUpdateEngine update_engine;
+            TransferCoordinator::Scope transfer {settings.coordinator};
+            update_engine.BurnModules(InternalSettings(settings), modules.at(BlockSize(settings)), buffers,
+                                      on_progress);
+            auto elapsed_seconds = timer.Elapsed() / 1000;
+            LOG_INFO(LOG_TAG, "Device %zu firmware update success (duration %lldm:%llds)", device_index,
+                     elapsed_seconds / 60, elapsed_seconds % 60);
+            status = Status::Ok;
+        }
+        catch (const std::exception& ex)
+        {
+            LOG_ERROR(LOG_TAG, "Device %zu firmware update failed", device_index);
+            LOG_EXCEPTION(LOG_TAG, ex);
+        }
+        statuses[device_index] = status;
+        if (status != Status::Ok)
+        {
+            n_failed++;
+        }
+        if (handler != nullptr)
+        {
+            std::lock_guard<std::mutex> lock {handler_mutex};
+            handler->OnDone(device_index, status);
+        }
+    };
 
-        if (excludeRecognition)
+    // each worker takes the next device when done with its current one
+    auto worker = [&]() {
+        while (true)
         {
-            modules.erase(std::remove_if(modules.begin(), modules.end(),
-                                         [](const ModuleInfo& mod_info) { return mod_info.name == MODULE_RECOG; }));
+            if (fleetSettings.max_failures > 0 && n_failed >= fleetSettings.max_failures)
+            {
+                return;
+            }
+            auto device_index = next_device++;
+            if (device_index >= devices.size())
+            {
+                return;
+            }
+            update_device(device_index);
         }
+    };
 
-        PacketManager::Timer timer;
-        update_engine.BurnModules(internal_settings, modules, callback_wrapper);
-        auto elapsed_seconds = timer.Elapsed() / 1000;
-        LOG_INFO(LOG_TAG, "Firmware update success (duration %lldm:%llds)", elapsed_seconds / 60, elapsed_seconds % 60);
-        return Status::Ok;
+    auto n_workers = std::min<std::size_t>(std::max(fleetSettings.max_concurrent, 1u), devices.size());
+    LOG_INFO(LOG_TAG, "Updating %zu devices, %zu at a time", devices.size(), n_workers);
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < n_workers; i++)
+    {
+        workers.emplace_back(worker);
     }
-    catch (const std::exception& ex)
+    worker();
+    for (auto& t : workers)
     {
-        LOG_EXCEPTION(LOG_TAG, ex);
-        return Status::Error;
+        t.join();
+    }
+
+    if (next_device < devices.size())
+    {
+        LOG_ERROR(LOG_TAG, "Stopped after %u failed devices", n_failed.load());
     }
+    return statuses;
 }
 } // namespace RealSenseID
@@ -0,0 +1,378 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/HostFaceprintsGallery.h"
+#include "Matcher/FaceprintsCodec.h"
+#include "Matcher/FaceprintsGallery.h"
+#include "Matcher/GalleryArrowFile.h"
+#include "Matcher/Matcher.h"
+#include "Matcher/MatcherConfig.h"
+#include "Matcher/MatcherThreadPool.h"
+#include "Logger.h"
+#include "MetricsRecorder.h"
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "HostFaceprintsGallery";
+
+// records of AddBulk()'s arrays
+class ArrayImportSource : public BulkImportSource
+{
+public:
+    ArrayImportSource(const char* const* user_ids, const feature_t* avg_descriptors, const feature_t* orig_descriptors,
+                      size_t count, int version, int number_of_descriptors) :
+        _user_ids {user_ids}, _avg_descriptors {avg_descriptors}, _orig_descriptors {orig_descriptors}, _count {count},
+        _version {version}, _number_of_descriptors {number_of_descriptors}
+    {
+    }
+
+    size_t Size() const override
+    {
+        return _count;
+    }
+
+    bool Read(size_t record, ExtendedFaceprints& user) const override
+    {
+        const feature_t* avg = _avg_descriptors + record * FEATURES_VECTOR_ALLOC_SIZE;
+        const feature_t* orig =
+            _orig_descriptors != nullptr ? _orig_descriptors + record * FEATURES_VECTOR_ALLOC_SIZE : avg;
+        ::memset(user.user_id, 0, sizeof(user.user_id));
+        if (_user_ids != nullptr && _user_ids[record] != nullptr)
+        {
+            ::strncpy(user.user_id, _user_ids[record], sizeof(user.user_id) - 1);
+        }
+        user.faceprints.version = _version;
+        user.faceprints.numberOfDescriptors = _number_of_descriptors;
+        ::memcpy(user.faceprints.avgDescriptor, avg, sizeof(user.faceprints.avgDescriptor));
+        ::memcpy(user.faceprints.origDescriptor, orig, sizeof(user.faceprints.origDescriptor));
+        return true;
+    }
+
+private:
+    const char* const* _user_ids;
+    const feature_t* _avg_descriptors;
+    const feature_t* _orig_descriptors;
+    size_t _count;
+    int _version;
+    int _number_of_descriptors;
+};
+
+// strict import of the source's records, the rejected ones are reported in errors
+static size_t ImportStrict(FaceprintsGallery& gallery, const BulkImportSource& source, ImportErrorHost* errors,
+                           size_t max_errors, size_t* num_errors)
+{
+    MatcherThreadPool pool;
+    std::vector<BulkImportError> rejected;
+    size_t imported = gallery.AddBulk(source, pool, true, &rejected);
+    for (size_t i = 0; i < rejected.size() && i < max_errors && errors != nullptr; i++)
+    {
+        errors[i].record = rejected[i].record;
+        errors[i].error = static_cast<ImportRecordError>(rejected[i].reason); // same order
+    }
+    if (num_errors != nullptr)
+    {
+        *num_errors = rejected.size();
+    }
+    LOG_DEBUG(LOG_TAG, "Imported %zu users, rejected %zu", imported, rejected.size());
+    return imported;
+}
+
+static bool ReadFile(const char* path, std::vector<unsigned char>& buffer)
+{
+    std::ifstream file(path != nullptr ? path : "", std::ios::binary);
+    if (!file)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to open file %s", path != nullptr ? path : "(null)");
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0, std::ios::beg);
+    if (!file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size())))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to read file %s", path);
+        return false;
+    }
+    return true;
+}
+
+HostFaceprintsGallery::HostFaceprintsGallery() :
+    _impl {new FaceprintsGallery()}, _match_scores {new Metrics::MatchScoreHistogram()}
+{
+}
+
+HostFaceprintsGallery::~HostFaceprintsGallery()
+{
+    try
+    {
+        delete _impl;
+        delete _match_scores;
+    }
+    catch (...)
+    {
+    }
+}
+
+size_t HostFaceprintsGallery::Add(const char* user_id, const Faceprints& faceprints)
+{
+    return _impl->Add(user_id, faceprints);
+}
+
+size_t HostFaceprintsGallery::AddBulk(const char* const* user_ids, const feature_t* avg_descriptors,
+                                      const feature_t* orig_descriptors, size_t count, int version,
+                                      int number_of_descriptors)
+{
+    size_t first_index = _impl->Size();
+    if (avg_descriptors == nullptr)
+    {
+        if (count > 0)
+        {
+            LOG_ERROR(LOG_TAG, "Invalid avg descriptors: nullptr");
+        }
+        return first_index;
+    }
+
+    // not strict - every user is added, as with Add()
+    MatcherThreadPool pool;
+    ArrayImportSource source {user_ids, avg_descriptors, orig_descriptors, count, version, number_of_descriptors};
+    _impl->AddBulk(source, pool, false);
+    return first_index;
+}
+
+size_t HostFaceprintsGallery::Import(const unsigned char* buffer, size_t size, ImportErrorHost* errors,
+                                     size_t max_errors, size_t* num_errors)
+{
+    if (num_errors != nullptr)
+    {
+        *num_errors = 0;
+    }
+    CodecBulkImportSource source {buffer, size};
+    if (!source.IsValid())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid bulk buffer");
+        return 0;
+    }
+    return ImportStrict(*_impl, source, errors, max_errors, num_errors);
+}
+
+size_t HostFaceprintsGallery::ImportFile(const char* path, ImportErrorHost* errors, size_t max_errors,
+                                         size_t* num_errors)
+{
+    if (num_errors != nullptr)
+    {
+        *num_errors = 0;
+    }
+    std::vector<unsigned char> buffer;
+    if (!ReadFile(path, buffer))
+    {
+        return 0;
+    }
+    return Import(buffer.data(), buffer.size(), errors, max_errors, num_errors);
+}
+
+bool HostFaceprintsGallery::ExportFile(const char* path) const
+{
+    std::vector<uint8_t> buffer;
+    if (path == nullptr || !FaceprintsCodec::EncodeUsers(*_impl, buffer))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to export the gallery");
+        return false;
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size())))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to write bulk file %s", path);
+        return false;
+    }
+    return true;
+}
+
+bool HostFaceprintsGallery::ExportArrowFile(const char* path) const
+{
+    return path != nullptr && GalleryArrowFile::Save(*_impl, path);
+}
+
+size_t HostFaceprintsGallery::ImportArrowFile(const char* path, ImportErrorHost* errors, size_t max_errors,
+                                              size_t* num_errors)
+{
+    if (num_errors != nullptr)
+    {
+        *num_errors = 0;
+    }
+    std::vector<unsigned char> buffer;
+    if (!ReadFile(path, buffer))
+    {
+        return 0;
+    }
+    ArrowBulkImportSource source {buffer.data(), buffer.size()};
+    if (!source.IsValid())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid Arrow file %s", path);
+        return 0;
+    }
+    return ImportStrict(*_impl, source, errors, max_errors, num_errors);
+}
+
+bool HostFaceprintsGallery::Update(size_t index, const Faceprints& faceprints)
+{
+    return _impl->Update(index, faceprints);
+}
+
+bool HostFaceprintsGallery::Remove(size_t index)
+{
+    return _impl->Remove(index);
+}
+
+int HostFaceprintsGallery::Find(const char* user_id) const
+{
+    return user_id != nullptr ? _impl->Find(user_id) : -1;
+}
+
+const char* HostFaceprintsGallery::UserId(size_t index) const
+{
+    return index < _impl->Size() ? _impl->UserId(index) : nullptr;
+}
+
+bool HostFaceprintsGallery::GetFaceprints(size_t index, Faceprints& faceprints) const
+{
+    return _impl->GetFaceprints(index, faceprints);
+}
+
+void HostFaceprintsGallery::Clear()
+{
+    _impl->Clear();
+}
+
+void HostFaceprintsGallery::Reserve(size_t capacity)
+{
+    _impl->Reserve(capacity);
+}
+
+size_t HostFaceprintsGallery::Size() const
+{
+    return _impl->Size();
+}
+
+MatchArrayResultHost HostFaceprintsGallery::Match(const Faceprints& new_faceprints,
+                                                  Faceprints& updated_faceprints) const
+{
+    MatchArrayResultHost finalResult;
+
+    auto result = Matcher::MatchFaceprintsToArray(new_faceprints, *_impl, updated_faceprints);
+    Matcher::RecordScores(result, _match_scores);
+    finalResult.success = result.isSame && result.userId >= 0;
+    finalResult.should_update = finalResult.success && result.should_update;
+    finalResult.index = finalResult.success ? result.userId : -1;
+    finalResult.score = result.maxScore;
+    finalResult.confidence = result.confidence;
+
+    return finalResult;
+}
+
+MatchArrayResultHost HostFaceprintsGallery::Match(const QueryFaceprints& query, Faceprints& updated_faceprints) const
+{
+    Faceprints new_faceprints;
+    ToFaceprints(query, new_faceprints);
+    return Match(new_faceprints, updated_faceprints);
+}
+
+MatchArrayResultHost HostFaceprintsGallery::Verify(const Faceprints& new_faceprints, const char* user_id,
+                                                   Faceprints& updated_faceprints) const
+{
+    MatchArrayResultHost finalResult;
+
+    int index = Find(user_id);
+    if (index < 0)
+    {
+        LOG_DEBUG(LOG_TAG, "Claimed user not found");
+        return finalResult;
+    }
+    auto result = Matcher::VerifyFaceprints(new_faceprints, *_impl, static_cast<size_t>(index), updated_faceprints);
+    Matcher::RecordScores(result, _match_scores);
+    finalResult.success = result.isSame && result.userId == index;
+    finalResult.should_update = finalResult.success && result.should_update;
+    finalResult.index = finalResult.success ? index : -1;
+    finalResult.score = result.maxScore;
+    finalResult.confidence = result.confidence;
+
+    return finalResult;
+}
+
+MatchArrayResultHost HostFaceprintsGallery::Verify(const QueryFaceprints& query, const char* user_id,
+                                                   Faceprints& updated_faceprints) const
+{
+    Faceprints new_faceprints;
+    ToFaceprints(query, new_faceprints);
+    return Verify(new_faceprints, user_id, updated_faceprints);
+}
+
+size_t HostFaceprintsGallery::MatchTopK(const Faceprints& new_faceprints, size_t k,
+                                        MatchCandidateHost* candidates) const
+{
+    if (candidates == nullptr && k > 0)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid candidates array: nullptr");
+        return 0;
+    }
+
+    std::vector<MatchCandidate> top_k;
+    if (!Matcher::MatchFaceprintsTopK(new_faceprints, *_impl, k, true, top_k))
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < top_k.size(); i++)
+    {
+        candidates[i].index = top_k[i].userId;
+        candidates[i].score = top_k[i].score;
+        candidates[i].confidence = top_k[i].confidence;
+    }
+    return top_k.size();
+}
+
+size_t HostFaceprintsGallery::MatchTopK(const QueryFaceprints& query, size_t k, MatchCandidateHost* candidates) const
+{
+    Faceprints new_faceprints;
+    ToFaceprints(query, new_faceprints);
+    return MatchTopK(new_faceprints, k, candidates);
+}
+
+bool HostFaceprintsGallery::FindSimilarPairs(SimilarPairsCallback& callback, match_calc_t threshold,
+                                             unsigned int num_threads) const
+{
+    if (threshold < 0)
+    {
+        threshold = MatcherConfig::Default().GetThresholds().identicalPersonThreshold;
+    }
+
+    MatcherThreadPool pool {num_threads};
+    size_t num_pairs = 0;
+    std::vector<SimilarPairHost> host_pairs;
+    bool completed = Matcher::FindSimilarPairs(*_impl, threshold, pool, [&](const SimilarPair* pairs, size_t count) {
+        host_pairs.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            host_pairs[i].first = static_cast<int>(pairs[i].first);
+            host_pairs[i].second = static_cast<int>(pairs[i].second);
+            host_pairs[i].score = pairs[i].score;
+        }
+        num_pairs += count;
+        return callback.OnPairs(host_pairs.data(), count);
+    });
+    LOG_DEBUG(LOG_TAG, "Found %zu similar pairs of %zu users%s", num_pairs, _impl->Size(),
+              completed ? "" : ", not completed");
+    return completed;
+}
+
+Metrics::MatchScoreStats HostFaceprintsGallery::GetMatchScoreStats() const
+{
+    return _match_scores->Stats();
+}
+
+void HostFaceprintsGallery::ResetMatchScoreStats()
+{
+    _match_scores->Reset();
+}
+} // namespace RealSenseID
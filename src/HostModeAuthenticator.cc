@@ -0,0 +1,125 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/HostModeAuthenticator.h"
+#include "HostModeAuthenticatorImpl.h"
+
+namespace RealSenseID
+{
+HostModeAuthenticator::HostModeAuthenticator(FaceAuthenticator& authenticator, unsigned int match_threads) :
+    _impl {new HostModeAuthenticatorImpl(authenticator, match_threads)}
+{
+}
+
+HostModeAuthenticator::~HostModeAuthenticator()
+{
+    try
+    {
+        delete _impl;
+    }
+    catch (...)
+    {
+    }
+}
+
+bool HostModeAuthenticator::Open(const char* database_path)
+{
+    return _impl->Open(database_path);
+}
+
+void HostModeAuthenticator::Close()
+{
+    _impl->Close();
+}
+
+Status HostModeAuthenticator::Enroll(EnrollmentCallback& callback, const char* user_id)
+{
+    return _impl->Enroll(callback, user_id, nullptr);
+}
+
+Status HostModeAuthenticator::Enroll(EnrollmentCallback& callback, const char* user_id, char* duplicate_user_id)
+{
+    return _impl->Enroll(callback, user_id, duplicate_user_id);
+}
+
+void HostModeAuthenticator::SetEnrollDedup(EnrollDedupPolicy policy)
+{
+    _impl->SetEnrollDedup(policy);
+}
+
+void HostModeAuthenticator::SetHotUsers(size_t capacity)
+{
+    _impl->SetHotUsers(capacity);
+}
+
+void HostModeAuthenticator::SetSearchBudget(unsigned int budget_ms)
+{
+    _impl->SetSearchBudget(budget_ms);
+}
+
+Status HostModeAuthenticator::Authenticate(AuthenticationCallback& callback)
+{
+    return _impl->Authenticate(callback);
+}
+
+Status HostModeAuthenticator::AuthenticateLoop(AuthenticationCallback& callback)
+{
+    return _impl->AuthenticateLoop(callback);
+}
+
+Status HostModeAuthenticator::AuthenticateLoop(AuthenticationCallback& callback, const AuthLoopConfig& config)
+{
+    return _impl->AuthenticateLoop(callback, config);
+}
+
+Status HostModeAuthenticator::AuthenticateLoop(AuthenticationCallback& callback, unsigned int max_faces)
+{
+    return _impl->AuthenticateLoop(callback, max_faces);
+}
+
+Status HostModeAuthenticator::Authenticate(AuthenticationCallback& callback, const unsigned int* groups, size_t count)
+{
+    return _impl->Authenticate(callback, groups, count);
+}
+
+Status HostModeAuthenticator::AuthenticateLoop(AuthenticationCallback& callback, const unsigned int* groups,
+                                               size_t count)
+{
+    return _impl->AuthenticateLoop(callback, groups, count);
+}
+
+bool HostModeAuthenticator::SetUserGroups(const char* user_id, const unsigned int* groups, size_t count)
+{
+    return _impl->SetUserGroups(user_id, groups, count);
+}
+
+bool HostModeAuthenticator::RemoveUser(const char* user_id)
+{
+    return _impl->RemoveUser(user_id);
+}
+
+size_t HostModeAuthenticator::NumberOfUsers() const
+{
+    return _impl->NumberOfUsers();
+}
+
+Metrics::MatchScoreStats HostModeAuthenticator::GetMatchScoreStats() const
+{
+    return _impl->GetMatchScoreStats();
+}
+
+Status HostModeAuthenticator::SetDeviceTier(size_t capacity)
+{
+    return _impl->SetDeviceTier(capacity);
+}
+
+Status HostModeAuthenticator::AuthenticateTiered(AuthenticationCallback& callback)
+{
+    return _impl->AuthenticateTiered(callback);
+}
+
+Status HostModeAuthenticator::SyncDeviceTier()
+{
+    return _impl->SyncDeviceTier();
+}
+} // namespace RealSenseID
@@ -0,0 +1,1014 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "HostModeAuthenticatorImpl.h"
+#include "AuthLoopFilter.h"
+#include "FaceTracker.h"
+#include "Matcher/Matcher.h"
+#include "Matcher/MatcherConfig.h"
+#include "Logger.h"
+#include "MetricsRecorder.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "HostModeAuthenticator";
+
+// enroll dedup search: galleries below DEDUP_INDEX_MIN_USERS are scanned exactly, larger ones through the ivf index
+// with a list per DEDUP_USERS_PER_LIST users, of which the DEDUP_PROBES closest lists are searched. the duplicates
+// score far above the match threshold, so they are nearly always in the closest list.
+static const size_t DEDUP_INDEX_MIN_USERS = 16 * 1024;
+static const size_t DEDUP_USERS_PER_LIST = 4 * 1024;
+static const size_t DEDUP_PROBES = 8;
+
+namespace
+{
+// stores the extracted faceprints of the enrolled user, forwards the rest to the user's callback
+class EnrollBridge : public EnrollFaceprintsExtractionCallback
+{
+public:
+    EnrollBridge(HostModeAuthenticatorImpl& impl, EnrollmentCallback& callback, const char* user_id,
+                 char* duplicate_user_id) :
+        _impl {impl}, _callback {callback}, _user_id {user_id}, _duplicate_user_id {duplicate_user_id}
+    {
+    }
+
+    void OnResult(const EnrollStatus status, const Faceprints* faceprints) override
+    {
+        if (status == EnrollStatus::Success && faceprints != nullptr)
+        {
+            _stored = _impl.Store(_user_id, *faceprints, _duplicate_user_id);
+            _callback.OnResult(_stored ? EnrollStatus::Success : EnrollStatus::Failure);
+            return;
+        }
+        _callback.OnResult(status);
+    }
+
+    void OnProgress(const FacePose pose) override
+    {
+        _callback.OnProgress(pose);
+    }
+
+    void OnHint(const EnrollStatus hint) override
+    {
+        _callback.OnHint(hint);
+    }
+
+    void OnFacesDetected(const FaceRect* faces, size_t count) override
+    {
+        _callback.OnFacesDetected(faces, count);
+    }
+
+    bool Stored() const
+    {
+        return _stored;
+    }
+
+private:
+    HostModeAuthenticatorImpl& _impl;
+    EnrollmentCallback& _callback;
+    const char* _user_id;
+    char* _duplicate_user_id;
+    bool _stored = false;
+};
+
+// matches the extracted faceprints, forwards the rest to the user's callback.
+// with a tracker, the successful extractions of an authenticated face track are dropped before matching. with a
+// sequential config, the frames of a face are matched as one sequential decision and only the decision is reported
+class AuthBridge : public AuthFaceprintsExtractionCallback
+{
+public:
+    AuthBridge(HostModeAuthenticatorImpl& impl, AuthenticationCallback& callback,
+               const std::vector<uint32_t>* groups = nullptr, FaceTracker* tracker = nullptr,
+               const AuthLoopConfig* sequential = nullptr) :
+        _impl {impl}, _callback {callback}, _groups {groups}, _tracker {tracker}, _sequential {sequential}
+    {
+    }
+
+    void OnResult(const AuthenticateStatus status, const Faceprints* faceprints) override
+    {
+        if (faceprints == nullptr)
+        {
+            OnQueryResult(status, nullptr);
+            return;
+        }
+        QueryFaceprints query;
+        ToQueryFaceprints(*faceprints, query);
+        OnQueryResult(status, &query);
+    }
+
+    void OnQueryResult(const AuthenticateStatus status, const QueryFaceprints* query) override
+    {
+        if (status == AuthenticateStatus::Success && query != nullptr)
+        {
+            std::string tracked_user;
+            if (_tracker != nullptr && _tracker->IsAuthenticated(tracked_user))
+            {
+                LOG_DEBUG(LOG_TAG, "Extraction of an authenticated track, not matched");
+                return;
+            }
+            char user_id[FaceAuthenticator::MAX_USERID_LENGTH];
+            bool matched = false;
+            if (_sequential != nullptr)
+            {
+                // another face restarts the evidence
+                const uint64_t track = _tracker != nullptr ? _tracker->PrimaryTrackId() : 0;
+                if (track != _evidence_track)
+                {
+                    _evidence = HostModeAuthenticatorImpl::SequentialEvidence {};
+                    _evidence_track = track;
+                }
+                if (!_impl.MatchSequential(*query, *_sequential, _evidence, user_id, matched))
+                {
+                    return;
+                }
+            }
+            else
+            {
+                matched = _impl.Match(*query, user_id, _groups);
+            }
+            if (matched)
+            {
+                if (_tracker != nullptr)
+                {
+                    _tracker->SetAuthenticated(user_id);
+                }
+                _callback.OnResult(AuthenticateStatus::Success, user_id);
+            }
+            else
+            {
+                _callback.OnResult(AuthenticateStatus::Forbidden, nullptr);
+            }
+            return;
+        }
+        // no usable face in this frame, a sequential decision restarts
+        _evidence = HostModeAuthenticatorImpl::SequentialEvidence {};
+        _callback.OnResult(status, nullptr);
+    }
+
+    // the faces of a frame of the multi-face loop, matched in one batch
+    void OnQueryResults(const AuthenticateStatus status, const QueryFaceprints* queries, const FaceRect* faces,
+                        size_t count) override
+    {
+        if (status != AuthenticateStatus::Success || count == 0 || _tracker != nullptr || _groups != nullptr)
+        {
+            AuthFaceprintsExtractionCallback::OnQueryResults(status, queries, faces, count);
+            return;
+        }
+        char user_ids[FaceAuthenticator::MAX_LOOP_FACES][FaceAuthenticator::MAX_USERID_LENGTH];
+        bool matched[FaceAuthenticator::MAX_LOOP_FACES];
+        count = std::min(count, static_cast<size_t>(FaceAuthenticator::MAX_LOOP_FACES));
+        _impl.MatchBatch(queries, count, user_ids, matched);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (matched[i])
+            {
+                _callback.OnResult(AuthenticateStatus::Success, user_ids[i]);
+            }
+            else
+            {
+                _callback.OnResult(AuthenticateStatus::Forbidden, nullptr);
+            }
+        }
+    }
+
+    void OnHint(const AuthenticateStatus hint) override
+    {
+        _callback.OnHint(hint);
+    }
+
+    void OnFacesDetected(const FaceRect* faces, size_t count) override
+    {
+        if (_tracker != nullptr)
+        {
+            _tracker->Update(faces, count);
+        }
+        _callback.OnFacesDetected(faces, count);
+    }
+
+private:
+    HostModeAuthenticatorImpl& _impl;
+    AuthenticationCallback& _callback;
+    const std::vector<uint32_t>* _groups;
+    FaceTracker* _tracker;
+    const AuthLoopConfig* _sequential;
+    HostModeAuthenticatorImpl::SequentialEvidence _evidence;
+    uint64_t _evidence_track = 0; // primary track of the evidence, 0 without a tracker
+};
+
+// keeps the result of a flow, forwards the hints and faces to the user's callback (and the result too if forward)
+class ResultRecorder : public AuthenticationCallback
+{
+public:
+    ResultRecorder(AuthenticationCallback& callback, bool forward) : _callback {callback}, _forward {forward}
+    {
+    }
+
+    void OnResult(const AuthenticateStatus status, const char* user_id) override
+    {
+        _has_result = true;
+        _status = status;
+        _user_id = user_id != nullptr ? user_id : "";
+        if (_forward)
+        {
+            _callback.OnResult(status, user_id);
+        }
+    }
+
+    void OnHint(const AuthenticateStatus hint) override
+    {
+        _callback.OnHint(hint);
+    }
+
+    void OnFacesDetected(const FaceRect* faces, size_t count) override
+    {
+        _callback.OnFacesDetected(faces, count);
+    }
+
+    bool HasResult() const
+    {
+        return _has_result;
+    }
+
+    AuthenticateStatus Result() const
+    {
+        return _status;
+    }
+
+    const std::string& UserId() const
+    {
+        return _user_id;
+    }
+
+private:
+    AuthenticationCallback& _callback;
+    bool _forward;
+    bool _has_result = false;
+    AuthenticateStatus _status = AuthenticateStatus::Failure;
+    std::string _user_id;
+};
+
+// collects the user ids of the device
+class UserIdsCollector : public UserIdsCallback
+{
+public:
+    void OnUserId(const char* user_id) override
+    {
+        user_ids.emplace_back(user_id);
+    }
+
+    std::vector<std::string> user_ids;
+};
+} // namespace
+
+HostModeAuthenticatorImpl::HostModeAuthenticatorImpl(FaceAuthenticator& authenticator, unsigned int match_threads) :
+    _authenticator {authenticator}, _pool {match_threads}
+{
+}
+
+bool HostModeAuthenticatorImpl::Open(const char* database_path)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    SaveIndex();
+    _database.Close();
+    _index.Clear();
+    _groups.Clear();
+    _hot_users.Clear();
+    _match_scores.Reset();
+    _tier.Clear();
+    _trained_size = 0;
+    if (database_path == nullptr || !_database.Open(database_path))
+    {
+        LOG_ERROR(LOG_TAG, "Failed opening the database");
+        return false;
+    }
+    _index_path = std::string(database_path) + ".ivf";
+
+    _index.Reserve(_database.Size());
+    _groups.Reserve(_database.Size());
+    Faceprints faceprints;
+    for (size_t index = 0; index < _database.IndexSize(); index++)
+    {
+        if (_database.GetFaceprints(index, faceprints))
+        {
+            _index.Add(_database.UserId(index), faceprints);
+            _groups.Add();
+        }
+    }
+    LOG_DEBUG(LOG_TAG, "Loaded %zu users", _index.Gallery().Size());
+    TrainIndex();
+    return true;
+}
+
+void HostModeAuthenticatorImpl::Close()
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    SaveIndex();
+    _database.Close();
+    _index.Clear();
+    _groups.Clear();
+    _hot_users.Clear();
+    _trained_size = 0;
+}
+
+bool HostModeAuthenticatorImpl::IsOpen() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (!_database.IsOpen())
+    {
+        LOG_ERROR(LOG_TAG, "Database is not open");
+        return false;
+    }
+    return true;
+}
+
+Status HostModeAuthenticatorImpl::Enroll(EnrollmentCallback& callback, const char* user_id, char* duplicate_user_id)
+{
+    if (duplicate_user_id != nullptr)
+    {
+        duplicate_user_id[0] = '\0';
+    }
+    if (!IsOpen())
+    {
+        return Status::Error;
+    }
+    if (user_id == nullptr || ::strlen(user_id) == 0 || ::strlen(user_id) >= FaceAuthenticator::MAX_USERID_LENGTH)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user id");
+        return Status::Error;
+    }
+
+    EnrollBridge bridge {*this, callback, user_id, duplicate_user_id};
+    auto status = _authenticator.ExtractFaceprintsForEnroll(bridge);
+    if (status == Status::Ok && !bridge.Stored())
+    {
+        return Status::Error;
+    }
+    return status;
+}
+
+Status HostModeAuthenticatorImpl::Authenticate(AuthenticationCallback& callback)
+{
+    if (!IsOpen())
+    {
+        return Status::Error;
+    }
+    AuthBridge bridge {*this, callback};
+    return _authenticator.ExtractFaceprintsForAuth(bridge);
+}
+
+Status HostModeAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback)
+{
+    if (!IsOpen())
+    {
+        return Status::Error;
+    }
+    AuthBridge bridge {*this, callback};
+    return _authenticator.ExtractFaceprintsForAuthLoop(bridge);
+}
+
+Status HostModeAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback, const AuthLoopConfig& config)
+{
+    if (!IsOpen())
+    {
+        return Status::Error;
+    }
+    // the bridge tracks before matching, the filter applies the rest of the policy to the results
+    AuthLoopConfig filter_config = config;
+    filter_config.trackFaces = false;
+    AuthLoopFilter filter {callback, filter_config};
+    FaceTracker tracker {std::chrono::milliseconds {config.trackReauthIntervalMs}};
+    AuthBridge bridge {*this, filter, nullptr, config.trackFaces ? &tracker : nullptr,
+                       config.sequentialFrames > 1 ? &config : nullptr};
+    return _authenticator.ExtractFaceprintsForAuthLoop(bridge);
+}
+
+Status HostModeAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback, unsigned int max_faces)
+{
+    if (!IsOpen())
+    {
+        return Status::Error;
+    }
+    AuthBridge bridge {*this, callback};
+    return _authenticator.ExtractFaceprintsForAuthLoop(bridge, max_faces);
+}
+
+Status HostModeAuthenticatorImpl::Authenticate(AuthenticationCallback& callback, const unsigned int* groups,
+                                               size_t count)
+{
+    if (!IsOpen())
+    {
+        return Status::Error;
+    }
+    if (groups == nullptr && count > 0)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid groups");
+        return Status::Error;
+    }
+    std::vector<uint32_t> allowed_groups {groups, groups + count};
+    AuthBridge bridge {*this, callback, &allowed_groups};
+    return _authenticator.ExtractFaceprintsForAuth(bridge);
+}
+
+Status HostModeAuthenticatorImpl::AuthenticateLoop(AuthenticationCallback& callback, const unsigned int* groups,
+                                                   size_t count)
+{
+    if (!IsOpen())
+    {
+        return Status::Error;
+    }
+    if (groups == nullptr && count > 0)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid groups");
+        return Status::Error;
+    }
+    std::vector<uint32_t> allowed_groups {groups, groups + count};
+    AuthBridge bridge {*this, callback, &allowed_groups};
+    return _authenticator.ExtractFaceprintsForAuthLoop(bridge);
+}
+
+bool HostModeAuthenticatorImpl::SetUserGroups(const char* user_id, const unsigned int* groups, size_t count)
+{
+    if (user_id == nullptr || (groups == nullptr && count > 0))
+    {
+        return false;
+    }
+    std::vector<uint32_t> user_groups {groups, groups + count};
+    std::lock_guard<std::mutex> lock {_mutex};
+    int index = _index.Gallery().Find(user_id);
+    if (index < 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed setting the groups, user not found");
+        return false;
+    }
+    return _groups.SetGroups(static_cast<size_t>(index), user_groups.data(), user_groups.size());
+}
+
+bool HostModeAuthenticatorImpl::RemoveUser(const char* user_id)
+{
+    if (user_id == nullptr)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock {_mutex};
+    int index = _index.Gallery().Find(user_id);
+    if (index < 0 || !_database.Remove(user_id))
+    {
+        LOG_ERROR(LOG_TAG, "Failed removing user");
+        return false;
+    }
+    _hot_users.Remove(static_cast<size_t>(index), _index.Gallery().Size() - 1);
+    _index.Remove(static_cast<size_t>(index));
+    _groups.Remove(static_cast<size_t>(index));
+    _tier.Forget(user_id);
+    return true;
+}
+
+size_t HostModeAuthenticatorImpl::NumberOfUsers() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _index.Gallery().Size();
+}
+
+Metrics::MatchScoreStats HostModeAuthenticatorImpl::GetMatchScoreStats() const
+{
+    return _match_scores.Stats();
+}
+
+Status HostModeAuthenticatorImpl::SetDeviceTier(size_t capacity)
+{
+    if (!IsOpen())
+    {
+        return Status::Error;
+    }
+    UserIdsCollector device_users;
+    if (capacity > 0)
+    {
+        auto status = _authenticator.QueryUserIds(device_users, true);
+        if (status != Status::Ok)
+        {
+            LOG_ERROR(LOG_TAG, "Failed querying the users of the device (status %d)", static_cast<int>(status));
+            return status;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock {_mutex};
+    _tier.SetCapacity(capacity);
+    _tier.ClearDevice();
+    // users of the device that are not users of the host are left alone
+    for (const auto& user_id : device_users.user_ids)
+    {
+        if (_index.Gallery().Find(user_id.c_str()) >= 0)
+        {
+            _tier.Added(user_id);
+        }
+    }
+    LOG_DEBUG(LOG_TAG, "Device tier of %zu users, %zu on the device", capacity, _tier.DeviceSize());
+    return Status::Ok;
+}
+
+Status HostModeAuthenticatorImpl::AuthenticateTiered(AuthenticationCallback& callback)
+{
+    if (!IsOpen())
+    {
+        return Status::Error;
+    }
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (!_tier.Enabled())
+        {
+            LOG_ERROR(LOG_TAG, "Device tier is not set");
+            return Status::Error;
+        }
+    }
+    ApplyDeviceTierChanges();
+
+    // device first
+    ResultRecorder device_result {callback, false};
+    auto status = _authenticator.Authenticate(device_result);
+    if (!device_result.HasResult())
+    {
+        return status;
+    }
+    if (device_result.Result() == AuthenticateStatus::Success)
+    {
+        bool removed = false;
+        {
+            std::lock_guard<std::mutex> lock {_mutex};
+            removed = _tier.PendingRemoval(device_result.UserId());
+            if (!removed && _tier.OnDevice(device_result.UserId()))
+            {
+                _tier.RecordMatch(device_result.UserId());
+            }
+        }
+        if (removed)
+        {
+            // removed on the host, but the device could not be updated yet
+            LOG_WARNING(LOG_TAG, "Device matched a removed user");
+            callback.OnResult(AuthenticateStatus::Forbidden, nullptr);
+            return status;
+        }
+        Metrics::Add(Metrics::Counter::DeviceTierMatches);
+        callback.OnResult(AuthenticateStatus::Success, device_result.UserId().c_str());
+        return status;
+    }
+    if (device_result.Result() != AuthenticateStatus::Forbidden)
+    {
+        callback.OnResult(device_result.Result(), nullptr);
+        return status;
+    }
+
+    // not a user of the device: extract the faceprints and search the host gallery
+    Metrics::Add(Metrics::Counter::HostTierFallbacks);
+    ResultRecorder host_result {callback, true};
+    AuthBridge bridge {*this, host_result};
+    status = _authenticator.ExtractFaceprintsForAuth(bridge);
+    if (!host_result.HasResult() || host_result.Result() != AuthenticateStatus::Success)
+    {
+        return status;
+    }
+
+    // promote the user if it is now one of the most matched
+    const auto& user_id = host_result.UserId();
+    std::string evicted;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (!_tier.ShouldPromote(user_id, evicted))
+        {
+            return status;
+        }
+    }
+    if (!evicted.empty() && !RemoveFromDevice(evicted))
+    {
+        return status;
+    }
+    PushToDevice(user_id);
+    return status;
+}
+
+Status HostModeAuthenticatorImpl::SyncDeviceTier()
+{
+    if (!IsOpen())
+    {
+        return Status::Error;
+    }
+    ApplyDeviceTierChanges();
+
+    std::vector<std::string> plan;
+    std::vector<std::string> removals;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (!_tier.Enabled())
+        {
+            LOG_ERROR(LOG_TAG, "Device tier is not set");
+            return Status::Error;
+        }
+        plan = _tier.Plan();
+        std::unordered_set<std::string> planned {plan.begin(), plan.end()};
+        for (size_t index = 0; index < _index.Gallery().Size(); index++)
+        {
+            std::string user_id = _index.Gallery().UserId(index);
+            if (_tier.OnDevice(user_id) && planned.count(user_id) == 0)
+            {
+                removals.push_back(std::move(user_id));
+            }
+        }
+    }
+
+    // make room first, then push the planned users missing on the device
+    bool ok = true;
+    for (const auto& user_id : removals)
+    {
+        ok = RemoveFromDevice(user_id) && ok;
+    }
+    size_t pushed = 0;
+    for (const auto& user_id : plan)
+    {
+        bool on_device;
+        {
+            std::lock_guard<std::mutex> lock {_mutex};
+            on_device = _tier.OnDevice(user_id);
+        }
+        if (!on_device)
+        {
+            ok = PushToDevice(user_id) && ok;
+            pushed++;
+        }
+    }
+    LOG_DEBUG(LOG_TAG, "Device tier synced, %zu removed and %zu pushed", removals.size(), pushed);
+    return ok ? Status::Ok : Status::Error;
+}
+
+bool HostModeAuthenticatorImpl::PushToDevice(const std::string& user_id)
+{
+    Faceprints faceprints;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        int index = _index.Gallery().Find(user_id.c_str());
+        if (index < 0)
+        {
+            return false;
+        }
+        _index.Gallery().GetFaceprints(static_cast<size_t>(index), faceprints);
+    }
+    auto status = _authenticator.SetUserFeatures(user_id.c_str(), faceprints);
+    if (status != Status::Ok)
+    {
+        LOG_ERROR(LOG_TAG, "Failed pushing a user to the device (status %d)", static_cast<int>(status));
+        return false;
+    }
+    std::lock_guard<std::mutex> lock {_mutex};
+    _tier.Added(user_id);
+    return true;
+}
+
+bool HostModeAuthenticatorImpl::RemoveFromDevice(const std::string& user_id)
+{
+    auto status = _authenticator.RemoveUser(user_id.c_str());
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (status != Status::Ok)
+    {
+        LOG_ERROR(LOG_TAG, "Failed removing a user from the device (status %d)", static_cast<int>(status));
+        // retried with the next tiered operation if the user was removed from the host
+        if (_index.Gallery().Find(user_id.c_str()) < 0)
+        {
+            _tier.Forget(user_id);
+        }
+        return false;
+    }
+    _tier.Removed(user_id);
+    return true;
+}
+
+void HostModeAuthenticatorImpl::ApplyDeviceTierChanges()
+{
+    std::vector<std::string> removals;
+    std::vector<std::string> updates;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        removals = _tier.TakeRemovals();
+        updates = _tier.TakeUpdates();
+    }
+    for (const auto& user_id : removals)
+    {
+        RemoveFromDevice(user_id);
+    }
+    for (const auto& user_id : updates)
+    {
+        PushToDevice(user_id);
+    }
+}
+
+void HostModeAuthenticatorImpl::SetEnrollDedup(EnrollDedupPolicy policy)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    _dedup = policy;
+    TrainIndex();
+}
+
+void HostModeAuthenticatorImpl::SetHotUsers(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    _hot_users.SetCapacity(capacity);
+}
+
+void HostModeAuthenticatorImpl::SetSearchBudget(unsigned int budget_ms)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    _search_budget = std::chrono::milliseconds {budget_ms};
+    TrainIndex();
+}
+
+bool HostModeAuthenticatorImpl::Store(const char* user_id, const Faceprints& faceprints, char* duplicate_user_id)
+{
+    // the enrolled avg vector is also the user's original vector (the avg one gets updated over time)
+    Faceprints enrolled;
+    enrolled.version = faceprints.version;
+    enrolled.numberOfDescriptors = faceprints.numberOfDescriptors;
+    enrolled.featuresType = faceprints.featuresType;
+    static_assert(sizeof(enrolled.origDescriptor) == sizeof(faceprints.avgDescriptor),
+                  "faceprints sizes do not match");
+    ::memcpy(enrolled.avgDescriptor, faceprints.avgDescriptor, sizeof(enrolled.avgDescriptor));
+    ::memcpy(enrolled.origDescriptor, faceprints.avgDescriptor, sizeof(enrolled.origDescriptor));
+
+    std::lock_guard<std::mutex> lock {_mutex};
+    int index = _index.Gallery().Find(user_id);
+    if (index < 0)
+    {
+        int duplicate = FindDuplicate(user_id, enrolled);
+        if (duplicate >= 0)
+        {
+            const char* duplicate_id = _index.Gallery().UserId(static_cast<size_t>(duplicate));
+            if (duplicate_user_id != nullptr)
+            {
+                ::strncpy(duplicate_user_id, duplicate_id, FaceAuthenticator::MAX_USERID_LENGTH - 1);
+                duplicate_user_id[FaceAuthenticator::MAX_USERID_LENGTH - 1] = '\0';
+            }
+            if (_dedup == EnrollDedupPolicy::Reject)
+            {
+                LOG_INFO(LOG_TAG, "Enrollment rejected, the person is enrolled as another user");
+                return false;
+            }
+            LOG_INFO(LOG_TAG, "Enrollment merged into the existing user of the person");
+            user_id = duplicate_id;
+            index = duplicate;
+        }
+    }
+
+    if (index >= 0)
+    {
+        if (!_database.Update(user_id, enrolled))
+        {
+            LOG_ERROR(LOG_TAG, "Failed storing the enrolled user");
+            return false;
+        }
+        _index.Update(static_cast<size_t>(index), enrolled);
+        _hot_users.Update(static_cast<size_t>(index), enrolled);
+        _tier.Changed(user_id);
+        return true;
+    }
+
+    if (!_database.Enroll(user_id, enrolled))
+    {
+        LOG_ERROR(LOG_TAG, "Failed storing the enrolled user");
+        return false;
+    }
+    _index.Add(user_id, enrolled);
+    _groups.Add();
+    TrainIndex();
+    return true;
+}
+
+int HostModeAuthenticatorImpl::FindDuplicate(const char* user_id, const Faceprints& faceprints) const
+{
+    if (_dedup == EnrollDedupPolicy::Off)
+    {
+        return -1;
+    }
+
+    // the same person scores above the identical person threshold, the first such user found is the duplicate
+    Thresholds thresholds;
+    thresholds.identicalPersonThreshold = static_cast<match_calc_t>(RSID_IDENTICAL_PERSON_THRESHOLD);
+    thresholds.strongThreshold = thresholds.identicalPersonThreshold;
+    thresholds.updateThreshold = static_cast<match_calc_t>(RSID_UPDATE_THRESHOLD);
+    Faceprints updated;
+    auto result = Matcher::MatchFaceprintsToArray(faceprints, _index, updated, DEDUP_PROBES, thresholds);
+    if (!result.isSame || result.userId < 0 ||
+        ::strcmp(_index.Gallery().UserId(static_cast<size_t>(result.userId)), user_id) == 0)
+    {
+        return -1;
+    }
+    return result.userId;
+}
+
+bool HostModeAuthenticatorImpl::IsMember(size_t index, const std::vector<uint32_t>& groups) const
+{
+    std::vector<uint32_t> user_groups;
+    _groups.GetGroups(index, user_groups);
+    for (auto group : user_groups)
+    {
+        if (std::find(groups.begin(), groups.end(), group) != groups.end())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HostModeAuthenticatorImpl::TrainIndex()
+{
+    // the dedup search and the searches bounded by the budget use the index, the others scan the whole gallery
+    size_t size = _index.Gallery().Size();
+    if ((_dedup == EnrollDedupPolicy::Off && _search_budget.count() == 0) || size < DEDUP_INDEX_MIN_USERS ||
+        size < 2 * _trained_size)
+    {
+        return;
+    }
+
+    size_t repaired = 0;
+    if (!_index.IsTrained() && _index.Load(_index_path, &repaired) && size < 2 * _index.TrainedSize())
+    {
+        _trained_size = _index.TrainedSize();
+        LOG_DEBUG(LOG_TAG, "Loaded the dedup index, %zu lists over %zu users (%zu repaired)", _index.NumLists(), size,
+                  repaired);
+        return;
+    }
+    _index.Train(size / DEDUP_USERS_PER_LIST);
+    _trained_size = size;
+    LOG_DEBUG(LOG_TAG, "Trained the dedup index, %zu lists over %zu users", _index.NumLists(), size);
+    SaveIndex();
+}
+
+void HostModeAuthenticatorImpl::SaveIndex()
+{
+    // entries repaired or added since the training are saved as well, so the next Open() repairs fewer
+    if (_database.IsOpen() && _index.IsTrained() && !_index.Save(_index_path, _database.Generation()))
+    {
+        LOG_ERROR(LOG_TAG, "Failed saving the dedup index");
+    }
+}
+
+bool HostModeAuthenticatorImpl::Match(const QueryFaceprints& query, char* user_id,
+                                      const std::vector<uint32_t>* groups)
+{
+    const auto start = std::chrono::steady_clock::now();
+    Faceprints scanned;
+    ToFaceprints(query, scanned);
+
+    Faceprints updated;
+    std::lock_guard<std::mutex> lock {_mutex};
+    // the recently matched users first, a hit (of a member of the groups if given) skips the full search
+    auto result = _hot_users.Match(scanned, updated);
+    bool hot_hit = result.isSame && (groups == nullptr || IsMember(static_cast<size_t>(result.userId), *groups));
+    if (!hot_hit && groups != nullptr)
+    {
+        // a scoped search touches the members of the groups only, too few to split over the pool
+        result = Matcher::MatchFaceprintsToArray(scanned, _index.Gallery(), _groups, groups->data(), groups->size(),
+                                                 updated);
+    }
+    else if (!hot_hit && _search_budget.count() > 0)
+    {
+        // the budget includes the wait for the lock
+        _deadline_search.deadline = start + _search_budget;
+        result = Matcher::MatchFaceprintsToArray(scanned, _index, updated, _deadline_search, _pool);
+        if (!_deadline_search.exact)
+        {
+            Metrics::Add(Metrics::Counter::InexactMatches);
+        }
+    }
+    else if (!hot_hit)
+    {
+        result = Matcher::MatchFaceprintsToArray(scanned, _index.Gallery(), updated, _pool);
+    }
+    return Accept(result, updated, hot_hit, user_id);
+}
+
+void HostModeAuthenticatorImpl::MatchBatch(const QueryFaceprints* queries, size_t count,
+                                           char (*user_ids)[FaceAuthenticator::MAX_USERID_LENGTH], bool* matched)
+{
+    std::vector<Faceprints> scanned(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        ToFaceprints(queries[i], scanned[i]);
+    }
+
+    std::vector<Faceprints> updated;
+    std::lock_guard<std::mutex> lock {_mutex};
+    // one scan of the gallery for all the faces
+    auto results = Matcher::MatchFaceprintsBatch(scanned, _index.Gallery(), updated);
+    for (size_t i = 0; i < count; i++)
+    {
+        matched[i] = Accept(results[i], updated[i], false, user_ids[i]);
+    }
+}
+
+bool HostModeAuthenticatorImpl::MatchSequential(const QueryFaceprints& query, const AuthLoopConfig& config,
+                                                SequentialEvidence& evidence, char* user_id, bool& matched)
+{
+    matched = false;
+    Faceprints scanned;
+    ToFaceprints(query, scanned);
+    const Thresholds& thresholds = MatcherConfig::Default().GetThresholds();
+
+    Faceprints updated;
+    std::lock_guard<std::mutex> lock {_mutex};
+    const auto& gallery = _index.Gallery();
+    if (evidence.frames == 0)
+    {
+        auto hot = _hot_users.Match(scanned, updated);
+        if (hot.isSame)
+        {
+            matched = Accept(hot, updated, true, user_id);
+            return true;
+        }
+        std::vector<MatchCandidate> candidates;
+        const size_t k = std::max(config.sequentialCandidates, 1u);
+        if (gallery.Empty() || !Matcher::MatchFaceprintsTopK(scanned, gallery, k, false, candidates, thresholds))
+        {
+            return true;
+        }
+        for (const auto& candidate : candidates)
+        {
+            evidence.candidates.push_back({gallery.UserId(static_cast<size_t>(candidate.userId)), 0});
+        }
+    }
+    evidence.frames++;
+
+    // the candidates' scores of this frame, the best running mean decides
+    ExtendedMatchResult best;
+    Faceprints best_updated;
+    double best_mean = 0;
+    for (auto it = evidence.candidates.begin(); it != evidence.candidates.end();)
+    {
+        int index = gallery.Find(it->user_id.c_str());
+        if (index < 0)
+        {
+            // removed since the first frame
+            it = evidence.candidates.erase(it);
+            continue;
+        }
+        auto result = Matcher::VerifyFaceprints(scanned, gallery, static_cast<size_t>(index), updated, thresholds);
+        it->score_sum += static_cast<double>(result.maxScore);
+        const double mean = it->score_sum / evidence.frames;
+        if (best.userId < 0 || mean > best_mean)
+        {
+            best = result;
+            best_updated = updated;
+            best_mean = mean;
+        }
+        ++it;
+    }
+
+    const bool passed = best.userId >= 0 && best_mean > static_cast<double>(thresholds.strongThreshold);
+    if (!passed && best.userId >= 0 && evidence.frames < config.sequentialFrames)
+    {
+        return false;
+    }
+    LOG_DEBUG(LOG_TAG, "Sequential decision after %u frames of %zu candidates", evidence.frames,
+              evidence.candidates.size());
+    // the frame's faceprints update the user only if the frame passes too (should_update)
+    best.isSame = passed;
+    matched = Accept(best, best_updated, false, user_id);
+    evidence = SequentialEvidence {};
+    return true;
+}
+
+bool HostModeAuthenticatorImpl::Accept(const ExtendedMatchResult& result, const Faceprints& updated, bool hot_hit,
+                                       char* user_id)
+{
+    Matcher::RecordScores(result, &_match_scores);
+    if (!result.isSame || result.userId < 0)
+    {
+        return false;
+    }
+
+    auto index = static_cast<size_t>(result.userId);
+    if (!hot_hit)
+    {
+        _hot_users.Insert(_index.Gallery(), index);
+    }
+    ::strncpy(user_id, _index.Gallery().UserId(index), FaceAuthenticator::MAX_USERID_LENGTH - 1);
+    user_id[FaceAuthenticator::MAX_USERID_LENGTH - 1] = '\0';
+    if (_tier.Enabled())
+    {
+        _tier.RecordMatch(user_id);
+    }
+
+    // write back the improved faceprints, the gallery only if the database accepted them
+    if (result.should_update)
+    {
+        if (_database.Update(user_id, updated))
+        {
+            _index.Update(index, updated);
+            _hot_users.Update(index, updated);
+        }
+        else
+        {
+            LOG_ERROR(LOG_TAG, "Failed writing back the updated faceprints");
+        }
+    }
+    return true;
+}
+} // namespace RealSenseID
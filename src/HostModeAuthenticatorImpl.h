@@ -0,0 +1,131 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/HostModeAuthenticator.h"
+#include "DeviceTier.h"
+#include "Matcher/FaceprintsDatabase.h"
+#include "Matcher/FaceprintsIvfIndex.h"
+#include "Matcher/GalleryGroups.h"
+#include "Matcher/HotUserCache.h"
+#include "Matcher/Matcher.h"
+#include "Matcher/MatcherThreadPool.h"
+#include "MetricsRecorder.h"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+class HostModeAuthenticatorImpl
+{
+public:
+    HostModeAuthenticatorImpl(FaceAuthenticator& authenticator, unsigned int match_threads);
+    ~HostModeAuthenticatorImpl() = default;
+
+    HostModeAuthenticatorImpl(const HostModeAuthenticatorImpl&) = delete;
+    HostModeAuthenticatorImpl& operator=(const HostModeAuthenticatorImpl&) = delete;
+
+    bool Open(const char* database_path);
+    void Close();
+
+    Status Enroll(EnrollmentCallback& callback, const char* user_id, char* duplicate_user_id);
+    Status Authenticate(AuthenticationCallback& callback);
+    Status AuthenticateLoop(AuthenticationCallback& callback);
+    Status AuthenticateLoop(AuthenticationCallback& callback, const AuthLoopConfig& config);
+    Status AuthenticateLoop(AuthenticationCallback& callback, unsigned int max_faces);
+    Status Authenticate(AuthenticationCallback& callback, const unsigned int* groups, size_t count);
+    Status AuthenticateLoop(AuthenticationCallback& callback, const unsigned int* groups, size_t count);
+    bool SetUserGroups(const char* user_id, const unsigned int* groups, size_t count);
+
+    bool RemoveUser(const char* user_id);
+    size_t NumberOfUsers() const;
+    void SetEnrollDedup(EnrollDedupPolicy policy);
+    void SetHotUsers(size_t capacity);
+    void SetSearchBudget(unsigned int budget_ms);
+
+    // store enrolled faceprints of the user (replacing existing ones), in the database and the gallery.
+    // a duplicate of another user (see SetEnrollDedup()) is rejected or merged into it, and the other user's id is
+    // copied to duplicate_user_id (FaceAuthenticator::MAX_USERID_LENGTH bytes, may be nullptr)
+    bool Store(const char* user_id, const Faceprints& faceprints, char* duplicate_user_id);
+
+    // match extracted faceprints to the gallery (to the members of the groups only if given) and write back the
+    // updated faceprints of the matched user. the matched user id is copied to user_id
+    // (FaceAuthenticator::MAX_USERID_LENGTH bytes)
+    bool Match(const QueryFaceprints& query, char* user_id, const std::vector<uint32_t>* groups);
+
+    // match the faces of a frame in one batch search of the gallery, as Match() each. the user id of each matched
+    // face is copied to user_ids[i], matched[i] tells if it was matched
+    void MatchBatch(const QueryFaceprints* queries, size_t count, char (*user_ids)[FaceAuthenticator::MAX_USERID_LENGTH],
+                    bool* matched);
+
+    // evidence of a sequential decision of the loop (AuthLoopConfig::sequentialFrames): the candidates of its first
+    // frame and their summed scores. kept by user id, the gallery may change between the frames
+    struct SequentialEvidence
+    {
+        struct Candidate
+        {
+            std::string user_id;
+            double score_sum = 0;
+        };
+        std::vector<Candidate> candidates;
+        unsigned int frames = 0;
+    };
+
+    // match a frame of a sequential decision: the first frame searches the gallery (the hot users first, a hit decides
+    // at once) for the candidates, each frame adds the candidates' scores to the evidence. returns true once decided
+    // (the evidence is then cleared) - matched tells if the best candidate was matched, as in Match()
+    bool MatchSequential(const QueryFaceprints& query, const AuthLoopConfig& config, SequentialEvidence& evidence,
+                         char* user_id, bool& matched);
+
+    Metrics::MatchScoreStats GetMatchScoreStats() const;
+
+    Status SetDeviceTier(size_t capacity);
+    Status AuthenticateTiered(AuthenticationCallback& callback);
+    Status SyncDeviceTier();
+
+private:
+    FaceAuthenticator& _authenticator;
+    MatcherThreadPool _pool;
+
+    // guards the database and the gallery (a copy of the database's users, packed for the parallel search and
+    // indexed for the enroll dedup search)
+    mutable std::mutex _mutex;
+    FaceprintsDatabase _database;
+    FaceprintsIvfIndex _index; // holds the gallery
+    GalleryGroups _groups;     // groups of the gallery entries, in memory only
+    HotUserCache _hot_users;   // recently matched gallery entries, searched first
+    std::chrono::milliseconds _search_budget {0}; // of Match(), 0 for the whole gallery
+    DeadlineSearch _deadline_search;              // scan time estimate of the bounded searches
+    size_t _trained_size = 0; // gallery size at the last training of the index
+    std::string _index_path;  // trained index saved alongside the database (<database path>.ivf)
+    EnrollDedupPolicy _dedup = EnrollDedupPolicy::Off;
+    Metrics::MatchScoreHistogram _match_scores; // of the Match() and MatchBatch() results
+    DeviceTier _tier;                           // of AuthenticateTiered()
+
+    bool IsOpen() const;
+
+    // count the result in the match score histograms, then take a match of the gallery search: copy the user id,
+    // move the user to the hot users (unless found there) and write back its updated faceprints. _mutex must be held
+    bool Accept(const ExtendedMatchResult& result, const Faceprints& updated, bool hot_hit, char* user_id);
+
+    // gallery index of a user other than user_id with the same person's faceprints, -1 if none
+    int FindDuplicate(const char* user_id, const Faceprints& faceprints) const;
+
+    // the gallery entry is a member of any of the groups
+    bool IsMember(size_t index, const std::vector<uint32_t>& groups) const;
+
+    // train the index of a large gallery once it doubled since the last training. the first training after Open()
+    // restores the saved index instead if it is still fresh, a new training is saved.
+    void TrainIndex();
+    void SaveIndex();
+
+    // device tier changes, the device calls are made without _mutex
+    bool PushToDevice(const std::string& user_id);
+    bool RemoveFromDevice(const std::string& user_id);
+    void ApplyDeviceTierChanges(); // removals and updates pending since the last tiered operation
+};
+} // namespace RealSenseID
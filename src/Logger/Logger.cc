@@ -10,6 +10,13 @@
 #include <cstdarg> // for va_start
 #include <cassert>
 
+#ifdef RSID_ASYNC_LOG
+#include "ThreadConfigImpl.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#endif // RSID_ASYNC_LOG
+
 
 #ifdef ANDROID
 #include "spdlog/sinks/android_sink.h"
@@ -56,6 +63,154 @@ public:
     void flush_() override {};
 };
 
+#ifdef RSID_ASYNC_LOG
+// Bounded lock free multi producer queue of log records (Vyukov's bounded queue), drained by a background thread
+// that does the pattern formatting and the sinks io. Producers only vsnprintf the message into the record and never
+// block: if the queue is full the message is dropped and counted, the count is logged by the background thread.
+// A record claimed but not yet published holds back the records after it (kept short: one vsnprintf).
+class AsyncLogQueue
+{
+public:
+#ifdef RSID_LOW_MEMORY
+    static constexpr size_t Capacity = 128; // power of 2
+#else
+    static constexpr size_t Capacity = 1024; // power of 2
+#endif
+
+    struct Record
+    {
+        std::atomic<size_t> sequence {0};
+        size_t position = 0;
+        spdlog::level::level_enum level = spdlog::level::off;
+        spdlog::log_clock::time_point time;
+        const char* tag = nullptr;
+        char message[LOG_BUFFER_SIZE];
+    };
+
+    explicit AsyncLogQueue(spdlog::logger* logger) : _logger {logger}, _records(new Record[Capacity])
+    {
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            _records[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        _thread = std::thread([this] { DrainLoop(); });
+    }
+
+    // write the queued records and stop
+    ~AsyncLogQueue()
+    {
+        _stop = true;
+        _thread.join();
+    }
+
+    AsyncLogQueue(const AsyncLogQueue&) = delete;
+    AsyncLogQueue& operator=(const AsyncLogQueue&) = delete;
+
+    // record to fill and Publish(), nullptr if the queue is full
+    Record* Claim()
+    {
+        size_t position = _enqueue_position.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Record& record = _records[position & (Capacity - 1)];
+            size_t sequence = record.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (diff == 0)
+            {
+                if (_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    record.position = position;
+                    return &record;
+                }
+            }
+            else if (diff < 0)
+            {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            else
+            {
+                position = _enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Publish(Record* record)
+    {
+        record->sequence.store(record->position + 1, std::memory_order_release);
+    }
+
+private:
+    spdlog::logger* _logger;
+    std::unique_ptr<Record[]> _records;
+    std::atomic<size_t> _enqueue_position {0};
+    size_t _dequeue_position = 0; // background thread only
+    std::atomic<size_t> _dropped {0};
+    std::atomic<bool> _stop {false};
+    std::thread _thread;
+
+    // write the next record if published. return false if none.
+    bool DrainOne()
+    {
+        Record& record = _records[_dequeue_position & (Capacity - 1)];
+        if (record.sequence.load(std::memory_order_acquire) != _dequeue_position + 1)
+        {
+            return false;
+        }
+        spdlog::memory_buf_t formatted;
+        fmt::format_to(formatted, "[{}] {}", record.tag, record.message);
+        _logger->log(record.time, spdlog::source_loc {}, record.level,
+                     spdlog::string_view_t(formatted.data(), formatted.size()));
+        record.sequence.store(_dequeue_position + Capacity, std::memory_order_release);
+        _dequeue_position++;
+        return true;
+    }
+
+    void ReportDropped()
+    {
+        auto dropped = _dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0)
+        {
+            _logger->log(spdlog::level::warn, "[Logger] {} log messages dropped (queue full)", dropped);
+        }
+    }
+
+    // wake up every 2 ms to write the queued records (the producers do not signal, to stay lock free)
+    void DrainLoop()
+    {
+        ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Logging, "log");
+        while (!_stop)
+        {
+            bool any = false;
+            while (DrainOne())
+            {
+                any = true;
+            }
+            ReportDropped();
+            if (!any)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds {2});
+            }
+        }
+        while (DrainOne())
+        {
+        }
+        ReportDropped();
+    }
+};
+#else
+class AsyncLogQueue
+{
+};
+#endif // RSID_ASYNC_LOG
+
+// outputs enabled at build time are at debug level, before the logger is even constructed
+#if defined(RSID_DEBUG_CONSOLE) || defined(RSID_DEBUG_FILE)
+std::atomic<int> Logger::_min_level {static_cast<int>(Logger::LogLevel::Debug)};
+#else
+std::atomic<int> Logger::_min_level {static_cast<int>(Logger::LogLevel::Off)};
+#endif
+
 Logger::Logger()
 {
     _logger = new spdlog::logger("");
@@ -87,10 +242,16 @@ Logger::Logger()
         printf("Failed to create log file \"%s\": %s\n", logfile.c_str(), ex.what());
     }
 #endif // RSID_DEBUG_FILE
+
+#ifdef RSID_ASYNC_LOG
+    _async = std::make_unique<AsyncLogQueue>(_logger);
+#endif // RSID_ASYNC_LOG
+    _min_level = static_cast<int>(_logger->level());
 }
 
 Logger::~Logger()
 {
+    _async.reset(); // write the queued messages first
     delete _logger;
 }
 
@@ -116,20 +277,49 @@ void Logger::SetCallback(LogCallback clbk, LogLevel level, bool do_formatting)
     {
         _logger->set_level(required_spdlog_level);
     }
+    _min_level = static_cast<int>(_logger->level());
 }
 
 
-// if log level is right, vsprintf the args to buffer and log it
+// vsprintf the args to buffer and log it, or queue it (RSID_ASYNC_LOG)
+static void LogIt(spdlog::logger* logger, AsyncLogQueue* async, spdlog::level::level_enum level, const char* tag,
+                  const char* format, va_list args)
+{
+#ifdef RSID_ASYNC_LOG
+    if (async)
+    {
+        auto* record = async->Claim();
+        if (!record)
+        {
+            return;
+        }
+        if (vsnprintf(record->message, sizeof(record->message), format, args) < 0)
+        {
+            snprintf(record->message, sizeof(record->message), "(bad printf format \"%s\")", format);
+        }
+        record->level = level;
+        record->tag = tag;
+        record->time = spdlog::log_clock::now();
+        async->Publish(record);
+        return;
+    }
+#else
+    (void)async;
+#endif // RSID_ASYNC_LOG
+    char buffer[LOG_BUFFER_SIZE];
+    auto Ok = vsnprintf(buffer, sizeof(buffer), format, args) >= 0;
+    if (!Ok)
+        snprintf(buffer, sizeof(buffer), "(bad printf format \"%s\")", format);
+    logger->log(level, "[{}] {}", tag, buffer);
+}
+
+// if log level is right, log the message
 #define LOG_IT_(LEVEL)                                                                                                 \
     va_list args;                                                                                                      \
     if (!_logger->should_log(LEVEL))                                                                                   \
         return;                                                                                                        \
     va_start(args, format);                                                                                            \
-    char buffer[LOG_BUFFER_SIZE];                                                                                      \
-    auto Ok = vsnprintf(buffer, sizeof(buffer), format, args) >= 0;                                                    \
-    if (!Ok)                                                                                                           \
-        snprintf(buffer, sizeof(buffer), "(bad printf format \"%s\")", format);                                        \
-    _logger->log(LEVEL, "[{}] {}", tag, buffer);                                                                       \
+    LogIt(_logger, _async.get(), LEVEL, tag, format, args);                                                            \
     va_end(args)
 
 
@@ -167,4 +357,32 @@ void Logger::DebugBytes(const char* tag, const char* msg, const char* buf, size_
 {
     _logger->debug("[{}] {} {} bytes {:pa}\n", tag, msg, size, spdlog::to_hex(buf, &buf[size]));
 }
+
+bool LogRateLimiter::Allow(unsigned int& suppressed)
+{
+    suppressed = 0;
+    if (_logged.load(std::memory_order_relaxed) < RSID_LOG_LIMIT_BURST &&
+        _logged.fetch_add(1, std::memory_order_relaxed) < RSID_LOG_LIMIT_BURST)
+    {
+        return true;
+    }
+
+    const long long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                              std::chrono::steady_clock::now().time_since_epoch())
+                              .count();
+    long long next = _next_ms.load(std::memory_order_relaxed);
+    if (next == 0)
+    {
+        // burst over, the first summary is due an interval from now
+        _next_ms.compare_exchange_strong(next, now + RSID_LOG_LIMIT_INTERVAL_MS, std::memory_order_relaxed);
+    }
+    else if (now >= next &&
+             _next_ms.compare_exchange_strong(next, now + RSID_LOG_LIMIT_INTERVAL_MS, std::memory_order_relaxed))
+    {
+        suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    _suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
 } // namespace RealSenseID
@@ -3,10 +3,26 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include "spdlog/fwd.h"
 
+// Log calls below RSID_MIN_LOG_LEVEL (0 trace .. 6 off, see Logger::LogLevel) are compiled out.
+// Their arguments are still compiled (never evaluated), so variables used only for logging stay used.
+#ifndef RSID_MIN_LOG_LEVEL
+#define RSID_MIN_LOG_LEVEL 0
+#endif
+
+// Rate limited log calls (LOG_*_LIMITED) log the first RSID_LOG_LIMIT_BURST messages of each call site, then at most
+// one per RSID_LOG_LIMIT_INTERVAL_MS with the number of messages suppressed in between.
+#ifndef RSID_LOG_LIMIT_BURST
+#define RSID_LOG_LIMIT_BURST 5
+#endif
+#ifndef RSID_LOG_LIMIT_INTERVAL_MS
+#define RSID_LOG_LIMIT_INTERVAL_MS 10000
+#endif
+
 
 namespace spdlog
 {
@@ -20,6 +36,10 @@ namespace RealSenseID
 // * User provided callback function.
 // * Standard output if RSID_DEBUG_CONSOLE is defined.
 // * "rsid_debug.log" file if RSID_DEBUG_FILE is defined.
+// If RSID_ASYNC_LOG is defined, the messages are queued and written to the outputs by a background thread (callers
+// never wait for the sinks, messages are dropped and counted if the queue is full). Tags must be static strings.
+class AsyncLogQueue;
+
 class Logger
 {
 public:
@@ -45,6 +65,12 @@ public:
         return instance;
     }
 
+    // cheap check before the call (no Instance() guard or spdlog lookup): if false the message would not be logged
+    static bool IsEnabled(LogLevel level)
+    {
+        return static_cast<int>(level) >= _min_level.load(std::memory_order_relaxed);
+    }
+
     // Set callback for given level. replace current callback if already exists
     void SetCallback(LogCallback callback, LogLevel level, bool do_formatting);
 
@@ -59,21 +85,67 @@ public:
 
 private:
     spdlog::logger* _logger = nullptr;
+    std::unique_ptr<AsyncLogQueue> _async; // RSID_ASYNC_LOG
+    // level of the spdlog logger (lowest level of the outputs), updated on every change
+    static std::atomic<int> _min_level;
 
     Logger();
     ~Logger();
 
     bool is_callback_set = false;
 };
+
+// State of a rate limited log call site (a function local static of the LOG_*_LIMITED macros), lock free.
+class LogRateLimiter
+{
+public:
+    constexpr LogRateLimiter() = default;
+
+    // true if the message should be logged, suppressed is then the number of messages dropped since the last one
+    bool Allow(unsigned int& suppressed);
+
+private:
+    std::atomic<unsigned int> _logged {0};
+    std::atomic<unsigned int> _suppressed {0};
+    std::atomic<long long> _next_ms {0}; // earliest time of the next message after the burst, 0 during the burst
+};
 } // namespace RealSenseID
 
-#define LOG_TRACE(...)         Logger::Instance().Trace(__VA_ARGS__)
-#define LOG_DEBUG(...)         Logger::Instance().Debug(__VA_ARGS__)
-#define LOG_INFO(...)          Logger::Instance().Info(__VA_ARGS__)
-#define LOG_WARNING(...)       Logger::Instance().Warning(__VA_ARGS__)
-#define LOG_ERROR(...)         Logger::Instance().Error(__VA_ARGS__)
-#define LOG_CRITICAL(...)      Logger::Instance().Critical(__VA_ARGS__)
-#define LOG_EXCEPTION(tag, ex) Logger::Instance().Error(tag, "%s", ex.what())
+#define RSID_LOG_IF_(MIN_LEVEL, LEVEL, FUNC, ...)                                                                      \
+    ((RSID_MIN_LOG_LEVEL <= MIN_LEVEL && Logger::IsEnabled(Logger::LogLevel::LEVEL)) ?                               \
+         Logger::Instance().FUNC(__VA_ARGS__) :                                                                        \
+         (void)0)
+
+#define LOG_TRACE(...)         RSID_LOG_IF_(0, Trace, Trace, __VA_ARGS__)
+#define LOG_DEBUG(...)         RSID_LOG_IF_(1, Debug, Debug, __VA_ARGS__)
+#define LOG_INFO(...)          RSID_LOG_IF_(2, Info, Info, __VA_ARGS__)
+#define LOG_WARNING(...)       RSID_LOG_IF_(3, Warning, Warning, __VA_ARGS__)
+#define LOG_ERROR(...)         RSID_LOG_IF_(4, Error, Error, __VA_ARGS__)
+#define LOG_CRITICAL(...)      RSID_LOG_IF_(5, Critical, Critical, __VA_ARGS__)
+#define LOG_EXCEPTION(tag, ex) RSID_LOG_IF_(4, Error, Error, tag, "%s", ex.what())
+
+// for call sites which may fail repeatedly in a hot loop (per packet, frame or gallery entry), see LogRateLimiter
+#define RSID_LOG_LIMITED_(MIN_LEVEL, LEVEL, FUNC, TAG, ...)                                                            \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (RSID_MIN_LOG_LEVEL <= MIN_LEVEL && Logger::IsEnabled(Logger::LogLevel::LEVEL))                             \
+        {                                                                                                              \
+            static LogRateLimiter rsid_log_limiter_;                                                                   \
+            unsigned int rsid_log_suppressed_ = 0;                                                                     \
+            if (rsid_log_limiter_.Allow(rsid_log_suppressed_))                                                         \
+            {                                                                                                          \
+                Logger::Instance().FUNC(TAG, __VA_ARGS__);                                                             \
+                if (rsid_log_suppressed_ > 0)                                                                          \
+                {                                                                                                      \
+                    Logger::Instance().FUNC(TAG, "%u more similar messages were suppressed", rsid_log_suppressed_);    \
+                }                                                                                                      \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+#define LOG_DEBUG_LIMITED(...)   RSID_LOG_LIMITED_(1, Debug, Debug, __VA_ARGS__)
+#define LOG_WARNING_LIMITED(...) RSID_LOG_LIMITED_(3, Warning, Warning, __VA_ARGS__)
+#define LOG_ERROR_LIMITED(...)   RSID_LOG_LIMITED_(4, Error, Error, __VA_ARGS__)
 
 
 #ifdef RSID_DEBUG_SERIAL
@@ -0,0 +1,293 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "CompactingGallery.h"
+#include "ThreadConfigImpl.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "CompactingGallery";
+
+CompactingGallery::CompactingGallery(double compact_ratio, size_t index_lists) :
+    _compact_ratio {compact_ratio}, _index_lists {index_lists}, _generation {std::make_shared<Generation>()}
+{
+    if (_compact_ratio > 0)
+    {
+        _thread = std::thread {&CompactingGallery::CompactionLoop, this};
+    }
+}
+
+CompactingGallery::~CompactingGallery()
+{
+    if (_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock {_thread_mutex};
+            _stop = true;
+        }
+        _thread_cv.notify_one();
+        _thread.join();
+    }
+}
+
+bool CompactingGallery::Add(const char* user_id, const Faceprints& faceprints)
+{
+    if (user_id == nullptr)
+    {
+        return false;
+    }
+    std::string id {user_id, ::strnlen(user_id, FaceprintsGallery::MaxUserIdLength - 1)};
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    if (!Apply(*std::atomic_load(&_generation), OpType::Add, id, &faceprints))
+    {
+        return false;
+    }
+    OnChanged(OpType::Add, id, &faceprints);
+    return true;
+}
+
+bool CompactingGallery::Update(const char* user_id, const Faceprints& faceprints)
+{
+    if (user_id == nullptr)
+    {
+        return false;
+    }
+    std::string id {user_id, ::strnlen(user_id, FaceprintsGallery::MaxUserIdLength - 1)};
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    if (!Apply(*std::atomic_load(&_generation), OpType::Update, id, &faceprints))
+    {
+        return false;
+    }
+    OnChanged(OpType::Update, id, &faceprints);
+    return true;
+}
+
+bool CompactingGallery::Remove(const char* user_id)
+{
+    if (user_id == nullptr)
+    {
+        return false;
+    }
+    std::string id {user_id, ::strnlen(user_id, FaceprintsGallery::MaxUserIdLength - 1)};
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    if (!Apply(*std::atomic_load(&_generation), OpType::Remove, id, nullptr))
+    {
+        return false;
+    }
+    OnChanged(OpType::Remove, id, nullptr);
+    return true;
+}
+
+void CompactingGallery::Clear()
+{
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    std::atomic_store(&_generation, std::make_shared<Generation>());
+    // a compaction in progress is dropped at its swap (see Compact())
+    _pending.clear();
+    _compacting = false;
+}
+
+size_t CompactingGallery::Size() const
+{
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    return std::atomic_load(&_generation)->rows.size();
+}
+
+size_t CompactingGallery::NumRemoved() const
+{
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    return std::atomic_load(&_generation)->num_removed;
+}
+
+ExtendedMatchResult CompactingGallery::Match(const Faceprints& new_faceprints, Faceprints& updated_faceprints,
+                                             std::string& matched_user_id, size_t nprobe) const
+{
+    return Read([&](const CompactingGalleryState& state) {
+        auto result = nprobe > 0 && state.index.IsTrained()
+                          ? Matcher::MatchFaceprintsToArray(new_faceprints, state.index, updated_faceprints, nprobe)
+                          : Matcher::MatchFaceprintsToArray(new_faceprints, state.index.Gallery(), updated_faceprints);
+
+        // tombstones score 0, so they are only the best row if no live user scored higher
+        if (result.userId >= 0 && state.IsRemoved(static_cast<size_t>(result.userId)))
+        {
+            result.userId = -1;
+            result.isSame = false;
+            result.isIdentical = false;
+            result.should_update = false;
+        }
+        matched_user_id = result.userId >= 0 ? state.index.Gallery().UserId(static_cast<size_t>(result.userId)) : "";
+        return result;
+    });
+}
+
+bool CompactingGallery::Apply(Generation& generation, OpType type, const std::string& user_id,
+                              const Faceprints* faceprints)
+{
+    auto it = generation.rows.find(user_id);
+    if (type == OpType::Add)
+    {
+        if (it != generation.rows.end())
+        {
+            return false;
+        }
+        size_t row = 0;
+        generation.state.Modify([&](CompactingGalleryState& state) {
+            row = state.index.Add(user_id.c_str(), *faceprints);
+            state.removed.push_back(0);
+        });
+        generation.rows.emplace(user_id, row);
+        return true;
+    }
+
+    if (it == generation.rows.end())
+    {
+        return false;
+    }
+    const size_t row = it->second;
+    if (type == OpType::Update)
+    {
+        generation.state.Modify([&](CompactingGalleryState& state) { state.index.Update(row, *faceprints); });
+        return true;
+    }
+
+    // tombstone - zero vectors keep the gallery validated (same version and descriptors) and never match
+    generation.state.Modify([&](CompactingGalleryState& state) {
+        Faceprints tombstone;
+        state.index.Gallery().GetFaceprints(row, tombstone);
+        std::fill(std::begin(tombstone.avgDescriptor), std::end(tombstone.avgDescriptor), feature_t {0});
+        std::fill(std::begin(tombstone.origDescriptor), std::end(tombstone.origDescriptor), feature_t {0});
+        state.index.Update(row, tombstone);
+        state.removed[row] = 1;
+        state.num_removed++;
+    });
+    generation.rows.erase(it);
+    generation.num_removed++;
+    return true;
+}
+
+void CompactingGallery::OnChanged(OpType type, const std::string& user_id, const Faceprints* faceprints)
+{
+    if (_compacting)
+    {
+        PendingOp op {type, user_id, {}};
+        if (faceprints != nullptr)
+        {
+            op.faceprints = *faceprints;
+        }
+        _pending.push_back(std::move(op));
+        return;
+    }
+
+    auto& generation = *std::atomic_load(&_generation);
+    const size_t rows = generation.rows.size() + generation.num_removed;
+    if (type == OpType::Remove && _compact_ratio > 0 && generation.num_removed >= _compact_ratio * rows)
+    {
+        {
+            std::lock_guard<std::mutex> lock {_thread_mutex};
+            _compact_requested = true;
+        }
+        _thread_cv.notify_one();
+    }
+}
+
+bool CompactingGallery::Compact()
+{
+    std::lock_guard<std::mutex> compact_lock {_compact_mutex};
+
+    // start recording the changes and take the rows to copy. rows below size keep their indices while copying.
+    std::shared_ptr<Generation> source;
+    std::vector<char> removed;
+    {
+        std::lock_guard<std::mutex> lock {_writer_mutex};
+        source = std::atomic_load(&_generation);
+        if (source->num_removed == 0)
+        {
+            return false;
+        }
+        removed = source->state.Read([](const CompactingGalleryState& state) { return state.removed; });
+        _pending.clear();
+        _compacting = true;
+    }
+
+    // copy the live users in chunks, so the writers are only held back by the short reads
+    CompactingGalleryState compacted;
+    compacted.index.Reserve(removed.size() - static_cast<size_t>(std::count(removed.begin(), removed.end(), 1)));
+    Faceprints faceprints;
+    for (size_t begin = 0; begin < removed.size(); begin += CompactChunkSize)
+    {
+        const size_t end = std::min(removed.size(), begin + CompactChunkSize);
+        source->state.Read([&](const CompactingGalleryState& state) {
+            auto& gallery = state.index.Gallery();
+            for (size_t row = begin; row < end; row++)
+            {
+                if (!removed[row] && gallery.GetFaceprints(row, faceprints))
+                {
+                    compacted.index.Add(gallery.UserId(row), faceprints);
+                }
+            }
+        });
+    }
+    compacted.removed.assign(compacted.index.Gallery().Size(), 0);
+    if (_index_lists > 0)
+    {
+        compacted.index.Train(_index_lists);
+    }
+
+    auto generation = std::make_shared<Generation>();
+    generation->state.Modify([&](CompactingGalleryState& state) { state = compacted; });
+    auto& gallery = compacted.index.Gallery();
+    generation->rows.reserve(gallery.Size());
+    for (size_t row = 0; row < gallery.Size(); row++)
+    {
+        generation->rows.emplace(gallery.UserId(row), row);
+    }
+
+    // replay the changes made while copying (they may or may not be in the copy), then swap
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    if (!_compacting)
+    {
+        LOG_DEBUG(LOG_TAG, "Compaction dropped, the gallery was cleared");
+        return false;
+    }
+    for (auto& op : _pending)
+    {
+        bool exists = generation->rows.count(op.user_id) != 0;
+        if (op.type == OpType::Remove)
+        {
+            Apply(*generation, OpType::Remove, op.user_id, nullptr);
+        }
+        else if (exists || op.type == OpType::Add)
+        {
+            Apply(*generation, exists ? OpType::Update : OpType::Add, op.user_id, &op.faceprints);
+        }
+    }
+    _pending.clear();
+    _compacting = false;
+    std::atomic_store(&_generation, std::move(generation));
+    _compactions.fetch_add(1);
+    LOG_DEBUG(LOG_TAG, "Compacted %zu rows into %zu users", removed.size(), gallery.Size());
+    return true;
+}
+
+void CompactingGallery::CompactionLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Matcher, "compaction");
+    std::unique_lock<std::mutex> lock {_thread_mutex};
+    while (true)
+    {
+        _thread_cv.wait(lock, [this] { return _stop || _compact_requested; });
+        if (_stop)
+        {
+            return;
+        }
+        _compact_requested = false;
+        lock.unlock();
+        Compact();
+        lock.lock();
+    }
+}
+} // namespace RealSenseID
@@ -0,0 +1,152 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsIvfIndex.h"
+#include "LeftRightGallery.h"
+#include "Matcher.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Users of one generation of a CompactingGallery, as seen by the readers.
+ * Removed users are tombstones: their rows keep their indices, with zero vectors (which never score above a match
+ * threshold) and removed[index] set, until a compaction drops them.
+ */
+struct CompactingGalleryState
+{
+    FaceprintsIvfIndex index; // the packed gallery is index.Gallery()
+    std::vector<char> removed;
+    size_t num_removed = 0;
+
+    bool IsRemoved(size_t row) const
+    {
+        return removed[row] != 0;
+    }
+};
+
+/**
+ * Gallery with O(1) user removal under concurrent matching, for long running host galleries with frequent deletes.
+ * Adds, updates and removals are applied in place (left-right, see LeftRightGallery), readers never block and
+ * removals leave tombstones, so the indices of the other users never move.
+ * Once the tombstones reach the compaction ratio of the gallery, a background thread rebuilds the packed arrays,
+ * norms and the ivf index (if enabled) of the live users into a new generation and swaps it in atomically. Readers
+ * keep the generation they started on, so a search never sees a half compacted gallery. Changes made during the
+ * compaction are replayed on the new generation before the swap.
+ * Indices are only meaningful within the generation of a Read() call, use user ids across calls.
+ */
+class CompactingGallery
+{
+public:
+    static constexpr double DefaultCompactRatio = 0.25;
+    static constexpr size_t CompactChunkSize = 4096; // users copied per read, writers run between the chunks
+
+    // compact_ratio - tombstones per gallery row that start a background compaction (0 disables it, see Compact()).
+    // index_lists - number of ivf lists trained at each compaction, 0 for no index (exact search only).
+    explicit CompactingGallery(double compact_ratio = DefaultCompactRatio, size_t index_lists = 0);
+    ~CompactingGallery();
+
+    CompactingGallery(const CompactingGallery&) = delete;
+    CompactingGallery& operator=(const CompactingGallery&) = delete;
+
+    // add user. returns false if a user with the same id already exists.
+    bool Add(const char* user_id, const Faceprints& faceprints);
+
+    // replace faceprints of existing user (e.g. after should_update). returns false if user was not found.
+    bool Update(const char* user_id, const Faceprints& faceprints);
+
+    // remove user in O(1), leaving a tombstone. returns false if user was not found.
+    bool Remove(const char* user_id);
+
+    void Clear();
+
+    // number of live users
+    size_t Size() const;
+
+    // tombstones of the current generation
+    size_t NumRemoved() const;
+
+    // rebuild the gallery without its tombstones now, on the calling thread. blocks while a background compaction
+    // runs. returns false if there was nothing to compact.
+    bool Compact();
+
+    // completed compactions
+    size_t Compactions() const
+    {
+        return _compactions.load();
+    }
+
+    // call read_func(const CompactingGalleryState&) on the current generation and return its result. wait-free with
+    // respect to writers and compactions. read_func must not call back into the gallery.
+    template <typename ReadFunc>
+    auto Read(ReadFunc&& read_func) const -> decltype(read_func(std::declval<const CompactingGalleryState&>()))
+    {
+        auto generation = std::atomic_load(&_generation);
+        return generation->state.Read(read_func);
+    }
+
+    // match against the live users (see Matcher::MatchFaceprintsToArray()), through the ivf index if it is trained and
+    // nprobe > 0. matched_user_id is set to the user of result.userId (empty if there is none).
+    ExtendedMatchResult Match(const Faceprints& new_faceprints, Faceprints& updated_faceprints,
+                              std::string& matched_user_id, size_t nprobe = 0) const;
+
+private:
+    struct Generation
+    {
+        LeftRightGallery<CompactingGalleryState> state;
+        std::unordered_map<std::string, size_t> rows; // row of each live user (writers only)
+        size_t num_removed = 0;                        // writers only
+    };
+
+    enum class OpType
+    {
+        Add,
+        Update,
+        Remove
+    };
+
+    // change made while a compaction copies the gallery
+    struct PendingOp
+    {
+        OpType type;
+        std::string user_id;
+        Faceprints faceprints;
+    };
+
+    // apply the change to the generation. writer lock must be held.
+    static bool Apply(Generation& generation, OpType type, const std::string& user_id, const Faceprints* faceprints);
+
+    // record the change for the compaction in progress and start a background compaction if needed. writer lock must
+    // be held.
+    void OnChanged(OpType type, const std::string& user_id, const Faceprints* faceprints);
+
+    void CompactionLoop();
+
+    const double _compact_ratio;
+    const size_t _index_lists;
+
+    std::shared_ptr<Generation> _generation; // accessed with std::atomic_load/std::atomic_store only
+    mutable std::mutex _writer_mutex;
+    bool _compacting = false; // a compaction is copying the gallery, changes go to _pending as well
+    std::vector<PendingOp> _pending;
+
+    std::mutex _compact_mutex; // one compaction at a time
+    std::atomic<size_t> _compactions {0};
+
+    std::mutex _thread_mutex;
+    std::condition_variable _thread_cv;
+    bool _compact_requested = false;
+    bool _stop = false;
+    std::thread _thread;
+};
+} // namespace RealSenseID
@@ -0,0 +1,111 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "DeviceFaceprintsGallery.h"
+#include "Logger.h"
+
+#ifdef RSID_MATCHER_OPENCL
+#include "OpenClMatchContext.h"
+#endif // RSID_MATCHER_OPENCL
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "DeviceFaceprintsGallery";
+
+#ifndef RSID_MATCHER_OPENCL
+// built without a device backend - the gallery always falls back to the cpu.
+class OpenClMatchContext
+{
+};
+#endif // RSID_MATCHER_OPENCL
+
+DeviceFaceprintsGallery::DeviceFaceprintsGallery(bool use_device)
+{
+#ifdef RSID_MATCHER_OPENCL
+    if (use_device)
+    {
+        _device = OpenClMatchContext::Create();
+    }
+#else
+    (void)use_device;
+#endif // RSID_MATCHER_OPENCL
+
+    if (_device == nullptr)
+    {
+        LOG_DEBUG(LOG_TAG, "No compute device, matching on the cpu");
+    }
+}
+
+DeviceFaceprintsGallery::~DeviceFaceprintsGallery() = default;
+
+size_t DeviceFaceprintsGallery::Add(const char* user_id, const Faceprints& faceprints)
+{
+    _device_dirty = true;
+    return _host.Add(user_id, faceprints);
+}
+
+size_t DeviceFaceprintsGallery::Add(const ExtendedFaceprints& extended_faceprints)
+{
+    _device_dirty = true;
+    return _host.Add(extended_faceprints);
+}
+
+bool DeviceFaceprintsGallery::Update(size_t index, const Faceprints& faceprints)
+{
+    _device_dirty = true;
+    return _host.Update(index, faceprints);
+}
+
+bool DeviceFaceprintsGallery::Remove(size_t index)
+{
+    _device_dirty = true;
+    return _host.Remove(index);
+}
+
+void DeviceFaceprintsGallery::Clear()
+{
+    _device_dirty = true;
+    _host.Clear();
+}
+
+void DeviceFaceprintsGallery::Reserve(size_t capacity)
+{
+    _host.Reserve(capacity);
+}
+
+std::string DeviceFaceprintsGallery::DeviceName() const
+{
+#ifdef RSID_MATCHER_OPENCL
+    if (_device != nullptr)
+    {
+        return _device->DeviceName();
+    }
+#endif // RSID_MATCHER_OPENCL
+    return "cpu";
+}
+
+OpenClMatchContext* DeviceFaceprintsGallery::AcquireDevice(std::unique_lock<std::mutex>& lock) const
+{
+    if (_device == nullptr)
+    {
+        return nullptr;
+    }
+
+    lock = std::unique_lock<std::mutex>(_device_mutex);
+
+#ifdef RSID_MATCHER_OPENCL
+    if (_device_dirty)
+    {
+        if (!_device->Upload(_host))
+        {
+            LOG_ERROR(LOG_TAG, "Failed to upload gallery to %s, matching on the cpu", _device->DeviceName().c_str());
+            return nullptr;
+        }
+        _device_dirty = false;
+    }
+    return _device.get();
+#else
+    return nullptr;
+#endif // RSID_MATCHER_OPENCL
+}
+} // namespace RealSenseID
@@ -0,0 +1,85 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace RealSenseID
+{
+class OpenClMatchContext;
+
+/**
+ * Packed gallery kept resident in the memory of a compute device, for server side matching of large batches against
+ * million-scale galleries.
+ * The host keeps a FaceprintsGallery (user ids, metadata, orig vectors and the cpu fallback). The avg vectors and their
+ * cached norms are mirrored to the device and re-uploaded by the first match after a change.
+ * Matching runs on the device through the OpenCL backend when the library is built with RSID_MATCHER_OPENCL and a
+ * device is found, otherwise (or if the device fails) the host gallery is matched on the cpu. Results are the same
+ * either way.
+ * Changes must not run concurrently with matching (same as FaceprintsGallery), concurrent matches are serialized on
+ * the device.
+ */
+class DeviceFaceprintsGallery
+{
+public:
+    // use_device=false always matches on the cpu.
+    explicit DeviceFaceprintsGallery(bool use_device = true);
+    ~DeviceFaceprintsGallery();
+
+    DeviceFaceprintsGallery(const DeviceFaceprintsGallery&) = delete;
+    DeviceFaceprintsGallery& operator=(const DeviceFaceprintsGallery&) = delete;
+
+    // same as the FaceprintsGallery methods
+    size_t Add(const char* user_id, const Faceprints& faceprints);
+    size_t Add(const ExtendedFaceprints& extended_faceprints);
+    bool Update(size_t index, const Faceprints& faceprints);
+    bool Remove(size_t index);
+    void Clear();
+    void Reserve(size_t capacity);
+
+    int Find(const char* user_id) const
+    {
+        return _host.Find(user_id);
+    }
+
+    size_t Size() const
+    {
+        return _host.Size();
+    }
+
+    bool Empty() const
+    {
+        return _host.Empty();
+    }
+
+    const FaceprintsGallery& Host() const
+    {
+        return _host;
+    }
+
+    // a compute device was found and initialized.
+    bool HasDevice() const
+    {
+        return _device != nullptr;
+    }
+
+    // name of the compute device or "cpu".
+    std::string DeviceName() const;
+
+    // the device with the current gallery uploaded, or nullptr if matching must fall back to the cpu.
+    // the returned lock serializes the use of the device.
+    OpenClMatchContext* AcquireDevice(std::unique_lock<std::mutex>& lock) const;
+
+private:
+    FaceprintsGallery _host;
+    std::unique_ptr<OpenClMatchContext> _device;
+
+    mutable std::mutex _device_mutex;
+    mutable bool _device_dirty = true;
+};
+} // namespace RealSenseID
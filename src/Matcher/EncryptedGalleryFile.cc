@@ -0,0 +1,349 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "EncryptedGalleryFile.h"
+
+#ifdef RSID_SECURE
+
+#include "MatcherThreadPool.h"
+#include "MbedtlsWrapper.h"
+#include "Logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "EncryptedGalleryFile";
+
+static const char s_encryptedGalleryMagic[8] = {'R', 'S', 'I', 'D', 'E', 'G', 'L', '\0'};
+
+using PacketManager::MbedtlsWrapper;
+
+namespace
+{
+static_assert(sizeof(EncryptedGalleryHeader::mac_iv) == AES_GCM_IV_SIZE_BYTES, "gallery mac iv size");
+static_assert(sizeof(EncryptedGalleryHeader::mac_tag) == AES_GCM_TAG_SIZE_BYTES, "gallery mac tag size");
+
+struct SegmentEntry
+{
+    unsigned char iv[AES_GCM_IV_SIZE_BYTES];
+    unsigned char tag[AES_GCM_TAG_SIZE_BYTES];
+    uint32_t generation; // the segment was encrypted at
+};
+
+// authenticated with each segment: its index, the layout and id of the whole file and its generation
+struct SegmentAad
+{
+    unsigned char bytes[2 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(EncryptedGalleryHeader::file_id)];
+
+    SegmentAad(uint64_t index, const EncryptedGalleryHeader& header, const SegmentEntry& entry)
+    {
+        unsigned char* out = bytes;
+        ::memcpy(out, &index, sizeof(index));
+        out += sizeof(index);
+        ::memcpy(out, &header.plain_size, sizeof(header.plain_size));
+        out += sizeof(header.plain_size);
+        ::memcpy(out, &header.segment_size, sizeof(header.segment_size));
+        out += sizeof(header.segment_size);
+        ::memcpy(out, &entry.generation, sizeof(entry.generation));
+        out += sizeof(entry.generation);
+        ::memcpy(out, header.file_id, sizeof(header.file_id));
+    }
+};
+
+// the file's MAC: the AES-GCM tag of no data, with the header (with a zero mac_tag) and the segment table as the
+// additional data
+std::vector<unsigned char> MacAad(const EncryptedGalleryHeader& header, const std::vector<SegmentEntry>& entries)
+{
+    std::vector<unsigned char> aad(sizeof(header) + entries.size() * sizeof(SegmentEntry));
+    ::memcpy(aad.data(), &header, sizeof(header));
+    ::memset(aad.data() + offsetof(EncryptedGalleryHeader, mac_tag), 0, sizeof(header.mac_tag));
+    if (!entries.empty())
+    {
+        ::memcpy(aad.data() + sizeof(header), entries.data(), entries.size() * sizeof(SegmentEntry));
+    }
+    return aad;
+}
+
+bool SignFile(const unsigned char* key, EncryptedGalleryHeader& header, const std::vector<SegmentEntry>& entries)
+{
+    const auto aad = MacAad(header, entries);
+    unsigned char no_data = 0;
+    return MbedtlsWrapper::GcmEncrypt(key, header.mac_iv, aad.data(), aad.size(), &no_data, 0, header.mac_tag);
+}
+
+bool CheckFileMac(const unsigned char* key, const EncryptedGalleryHeader& header,
+                  const std::vector<SegmentEntry>& entries)
+{
+    const auto aad = MacAad(header, entries);
+    unsigned char no_data = 0;
+    return MbedtlsWrapper::GcmDecrypt(key, header.mac_iv, aad.data(), aad.size(), &no_data, 0, header.mac_tag);
+}
+
+size_t SegmentLength(const EncryptedGalleryHeader& header, uint64_t index)
+{
+    const uint64_t offset = index * header.segment_size;
+    return static_cast<size_t>(std::min<uint64_t>(header.segment_size, header.plain_size - offset));
+}
+
+void RunTasks(MatcherThreadPool* pool, size_t num_tasks, const std::function<void(size_t)>& task)
+{
+    if (pool != nullptr)
+    {
+        pool->Run(num_tasks, task);
+        return;
+    }
+    for (size_t i = 0; i < num_tasks; i++)
+    {
+        task(i);
+    }
+}
+
+bool ReadHeader(std::ifstream& file, EncryptedGalleryHeader& header)
+{
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        return false;
+    }
+    return ::memcmp(header.magic, s_encryptedGalleryMagic, sizeof(header.magic)) == 0 &&
+           header.format_version == EncryptedGalleryHeader::CurrentFormatVersion &&
+           header.header_size == sizeof(EncryptedGalleryHeader);
+}
+
+// header and segment table of the file at path, checked against the actual file size
+bool ReadLayout(const std::string& path, EncryptedGalleryHeader& header, std::vector<SegmentEntry>& entries)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file || !ReadHeader(file, header))
+    {
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    const uint64_t file_size = static_cast<uint64_t>(file.tellg());
+    if (header.segment_size == 0 || header.file_size != file_size || header.plain_size > file_size ||
+        header.segment_count != (header.plain_size + header.segment_size - 1) / header.segment_size ||
+        header.segments_offset < sizeof(header) + header.segment_count * sizeof(SegmentEntry) ||
+        header.segments_offset + header.plain_size != file_size)
+    {
+        LOG_ERROR(LOG_TAG, "Encrypted gallery file %s layout out of range", path.c_str());
+        return false;
+    }
+    entries.resize(static_cast<size_t>(header.segment_count));
+    file.seekg(sizeof(header));
+    return entries.empty() ||
+           file.read(reinterpret_cast<char*>(entries.data()),
+                     static_cast<std::streamsize>(entries.size() * sizeof(SegmentEntry)));
+}
+} // namespace
+
+bool EncryptedGalleryFile::Save(const FaceprintsGallery& gallery, const std::string& path, const unsigned char* key,
+                                uint32_t generation, MatcherThreadPool* pool, const MappedFaceprintsGallery* previous,
+                                size_t segment_size)
+{
+    if (key == nullptr || segment_size == 0 || segment_size > UINT32_MAX)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid key or segment size");
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // encrypted in place, segment by segment
+    MappedFaceprintsGallery::Image image;
+    MappedFaceprintsGallery::BuildImage(gallery, generation, image);
+
+    EncryptedGalleryHeader header;
+    ::memset(&header, 0, sizeof(header));
+    ::memcpy(header.magic, s_encryptedGalleryMagic, sizeof(header.magic));
+    header.format_version = EncryptedGalleryHeader::CurrentFormatVersion;
+    header.header_size = sizeof(EncryptedGalleryHeader);
+    header.segment_size = static_cast<uint32_t>(segment_size);
+    header.generation = generation;
+    header.plain_size = image.size();
+    header.segment_count = (header.plain_size + segment_size - 1) / segment_size;
+    header.segments_offset =
+        MappedFaceprintsGallery::AlignOffset(sizeof(header) + header.segment_count * sizeof(SegmentEntry));
+    header.file_size = header.segments_offset + header.plain_size;
+    if (!MbedtlsWrapper::RandomBytes(header.mac_iv, sizeof(header.mac_iv)))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to generate the mac iv");
+        return false;
+    }
+
+    const size_t segment_count = static_cast<size_t>(header.segment_count);
+    std::vector<SegmentEntry> entries(segment_count);
+    std::vector<char> reused(segment_count, 0);
+
+    // keep the id and the ciphertext of the segments that did not change since the file at path was written from
+    // previous, if the file was not modified since
+    EncryptedGalleryHeader old_header;
+    std::vector<SegmentEntry> old_entries;
+    if (previous != nullptr && previous->IsOpen() && previous->DataSize() == image.size() &&
+        ReadLayout(path, old_header, old_entries) && old_header.plain_size == header.plain_size &&
+        old_header.segment_size == header.segment_size && old_header.generation == previous->Generation() &&
+        CheckFileMac(key, old_header, old_entries))
+    {
+        ::memcpy(header.file_id, old_header.file_id, sizeof(header.file_id));
+        std::ifstream old_file(path, std::ios::binary);
+        for (size_t i = 0; i < segment_count && old_file; i++)
+        {
+            const size_t offset = i * segment_size;
+            const size_t length = SegmentLength(header, i);
+            if (::memcmp(previous->Data() + offset, image.data() + offset, length) != 0)
+            {
+                continue;
+            }
+            old_file.seekg(static_cast<std::streamoff>(old_header.segments_offset + offset));
+            if (old_file.read(reinterpret_cast<char*>(image.data() + offset), static_cast<std::streamsize>(length)))
+            {
+                entries[i] = old_entries[i];
+                reused[i] = 1;
+            }
+        }
+    }
+    else if (!MbedtlsWrapper::RandomBytes(header.file_id, sizeof(header.file_id)))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to generate the file id");
+        return false;
+    }
+
+    std::atomic<bool> failed {false};
+    RunTasks(pool, segment_count, [&](size_t i) {
+        if (reused[i] || failed.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        entries[i].generation = generation;
+        SegmentAad aad {i, header, entries[i]};
+        bool ok = MbedtlsWrapper::RandomBytes(entries[i].iv, sizeof(entries[i].iv)) &&
+                  MbedtlsWrapper::GcmEncrypt(key, entries[i].iv, aad.bytes, sizeof(aad.bytes),
+                                             image.data() + i * segment_size, SegmentLength(header, i),
+                                             entries[i].tag);
+        if (!ok)
+        {
+            failed = true;
+        }
+    });
+    if (failed || !SignFile(key, header, entries))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to encrypt gallery file %s", path.c_str());
+        return false;
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to create gallery file %s", tmp_path.c_str());
+            return false;
+        }
+        bool ok = MappedFaceprintsGallery::WriteSection(file, 0, &header, sizeof(header));
+        ok = ok && MappedFaceprintsGallery::WriteSection(file, sizeof(header), entries.data(),
+                                                         entries.size() * sizeof(SegmentEntry));
+        ok = ok && MappedFaceprintsGallery::WriteSection(file, header.segments_offset, image.data(), image.size());
+        file.flush();
+        if (!ok || !file.good())
+        {
+            LOG_ERROR(LOG_TAG, "Failed to write gallery file %s", tmp_path.c_str());
+            file.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+    if (!MappedFaceprintsGallery::ReplaceFile(tmp_path, path))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to replace gallery file %s", path.c_str());
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    const auto reused_count = std::count(reused.begin(), reused.end(), 1);
+    auto elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    LOG_DEBUG(LOG_TAG, "Saved %zu users to %s, encrypted %zu of %zu segments in %lld ms", gallery.Size(),
+              path.c_str(), segment_count - static_cast<size_t>(reused_count), segment_count,
+              static_cast<long long>(elapsed));
+    return true;
+}
+
+bool EncryptedGalleryFile::Open(const std::string& path, const unsigned char* key, MappedFaceprintsGallery& gallery,
+                                MatcherThreadPool* pool)
+{
+    gallery.Close();
+    if (key == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid key");
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    EncryptedGalleryHeader header;
+    std::vector<SegmentEntry> entries;
+    if (!ReadLayout(path, header, entries))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to read encrypted gallery file %s", path.c_str());
+        return false;
+    }
+    if (!CheckFileMac(key, header, entries))
+    {
+        LOG_ERROR(LOG_TAG, "Gallery file %s failed authentication (wrong key or modified file)", path.c_str());
+        return false;
+    }
+
+    MappedFaceprintsGallery::Image image(static_cast<size_t>(header.plain_size));
+    std::atomic<bool> failed {false};
+    RunTasks(pool, entries.size(), [&](size_t i) {
+        if (failed.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        // a stream per task, so the segments are read in parallel too
+        const uint64_t offset = i * static_cast<uint64_t>(header.segment_size);
+        const size_t length = SegmentLength(header, i);
+        unsigned char* segment = image.data() + offset;
+        std::ifstream file(path, std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(header.segments_offset + offset));
+        SegmentAad aad {i, header, entries[i]};
+        bool ok = file.read(reinterpret_cast<char*>(segment), static_cast<std::streamsize>(length)) &&
+                  MbedtlsWrapper::GcmDecrypt(key, entries[i].iv, aad.bytes, sizeof(aad.bytes), segment, length,
+                                             entries[i].tag);
+        if (!ok)
+        {
+            failed = true;
+        }
+    });
+    if (failed)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to decrypt gallery file %s (wrong key or modified file)", path.c_str());
+        return false;
+    }
+
+    auto elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    LOG_DEBUG(LOG_TAG, "Decrypted %zu segments of %s in %lld ms", entries.size(), path.c_str(),
+              static_cast<long long>(elapsed));
+    return gallery.OpenImage(std::move(image), path);
+}
+
+bool EncryptedGalleryFile::ReadGeneration(const std::string& path, uint32_t& generation)
+{
+    EncryptedGalleryHeader header;
+    std::ifstream file(path, std::ios::binary);
+    if (!file || !ReadHeader(file, header))
+    {
+        return false;
+    }
+    generation = header.generation;
+    return true;
+}
+} // namespace RealSenseID
+
+#endif // RSID_SECURE
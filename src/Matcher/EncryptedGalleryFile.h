@@ -0,0 +1,77 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include "MappedFaceprintsGallery.h"
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+namespace RealSenseID
+{
+class MatcherThreadPool;
+
+/**
+ * Gallery file encrypted at rest (RSID_SECURE builds). The plain bytes are a gallery file as written by
+ * MappedFaceprintsGallery::Save(), cut into segments that are encrypted separately with AES-GCM 256 (on the
+ * MbedtlsWrapper backend, which uses AES-NI or, with RSID_SECURE_OPENSSL, the AES-NI/ARMv8 crypto instructions).
+ *
+ *   header | segment table (iv + tag + generation of each segment) | encrypted segments
+ *
+ * Each segment has its own random iv, and its index, the plain size, the file's random id and the generation the
+ * segment was encrypted at are authenticated with it, so segments can not be moved, truncated or taken from another
+ * file without failing the tag check. The header and the segment table are authenticated by the file's MAC (the
+ * AES-GCM tag of both as additional data), so a segment of an older version of the file can not be put back with its
+ * old table entry, and the header can not be changed. Only the header and the table are in the clear.
+ */
+struct EncryptedGalleryHeader
+{
+    static constexpr uint32_t CurrentFormatVersion = 2;
+
+    char magic[8];           // "RSIDEGL"
+    uint32_t format_version; // CurrentFormatVersion
+    uint32_t header_size;    // sizeof(EncryptedGalleryHeader)
+    uint32_t segment_size;   // plain bytes per segment (the last one may be shorter)
+    uint32_t generation;     // generation of the plain gallery file (readable without the key)
+    uint64_t plain_size;     // size of the plain gallery file
+    uint64_t segment_count;
+    uint64_t segments_offset; // first encrypted segment, the segments follow each other
+    uint64_t file_size;
+    unsigned char file_id[16]; // random, kept by the updates of the file that reuse its segments
+    unsigned char mac_iv[12];
+    unsigned char mac_tag[16]; // of the header (with a zero mac_tag) and the segment table
+    uint32_t reserved;
+};
+
+class EncryptedGalleryFile
+{
+public:
+    static constexpr size_t KeySize = 32; // AES-256
+    static constexpr size_t DefaultSegmentSize = 1024 * 1024;
+
+    // encrypt the gallery into path (via a temporary file that replaces path), with the given generation in the
+    // header. The segments are encrypted on the pool's threads if a pool is given.
+    // If previous is the plain image of the file currently at path (e.g. the snapshot it was opened into) and that
+    // file's MAC checks with the key, the file keeps its id and the segments whose plain bytes did not change keep
+    // their ciphertext (and the generation they were encrypted at), only the changed ones are encrypted again at the
+    // new generation, so an update of a few users in place costs a few segments. Adding or removing users moves the
+    // sections, most segments change then. Otherwise the file gets a new id and all the segments are encrypted.
+    // returns false on failure.
+    static bool Save(const FaceprintsGallery& gallery, const std::string& path, const unsigned char* key,
+                     uint32_t generation = 0, MatcherThreadPool* pool = nullptr,
+                     const MappedFaceprintsGallery* previous = nullptr, size_t segment_size = DefaultSegmentSize);
+
+    // read the file at path and decrypt it into the packed in-memory layout of gallery (see
+    // MappedFaceprintsGallery::OpenImage()). Each segment is read straight into its place in the image and decrypted
+    // in place, on the pool's threads if a pool is given. returns false if the file is missing or invalid, or if the
+    // file's MAC or a segment fails authentication (wrong key or modified file).
+    static bool Open(const std::string& path, const unsigned char* key, MappedFaceprintsGallery& gallery,
+                     MatcherThreadPool* pool = nullptr);
+
+    // read only the header of the given file for its generation, not authenticated (Open() checks it). returns false
+    // if the file is missing or is not an encrypted gallery file.
+    static bool ReadGeneration(const std::string& path, uint32_t& generation);
+};
+} // namespace RealSenseID
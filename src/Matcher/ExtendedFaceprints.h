@@ -3,6 +3,7 @@
 #pragma once
 
 #include "RealSenseID/Faceprints.h"
+#include <stdint.h>
 
 namespace RealSenseID
 {
@@ -16,4 +17,19 @@ public:
 	char user_id[31]; // user id with null char
 	Faceprints faceprints;    
 };
+
+/**
+ * Gallery entry for host side 1:N matching.
+ * Caches the norm of faceprints.avgDescriptor, so only the dot product is calculated per user during the search.
+ * Use Matcher::UpdateGalleryFaceprints() whenever the faceprints change (e.g. after result.should_update).
+ */
+class GalleryFaceprints
+{
+public:
+    ExtendedFaceprints extended_faceprints;
+    uint32_t avg_norm = 1;  // sum of squares of avgDescriptor (0 is stored as 1)
+    short avg_norm_msb = 1; // msb index of avg_norm
+    uint64_t avg_norm_recip = 0; // reciprocal of avg_norm (see Matcher::CalculateNormReciprocal())
+    bool is_valid = false;  // avgDescriptor passed range validation
+};
 } // namespace RealSenseID
\ No newline at end of file
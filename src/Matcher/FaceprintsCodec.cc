@@ -0,0 +1,563 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsCodec.h"
+#include "FaceprintsGallery.h"
+#include "Logger.h"
+#include <cstring>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FaceprintsCodec";
+
+static const char s_bulkMagic[8] = {'R', 'S', 'I', 'D', 'F', 'P', 'C', '\0'};
+static const uint32_t s_bulkFormatVersion = 1;
+static const size_t s_bulkHeaderSize = sizeof(s_bulkMagic) + 4 + 4;
+static const size_t s_bulkChecksumSize = 4;
+
+static const int32_t s_maxFeatureValue = (1 << (FaceprintsCodec::FeatureBits - 1)) - 1;
+
+// record flags
+static const uint8_t s_origSameAsAvg = 0x1;
+static const uint8_t s_origAsDelta = 0x2;
+
+static_assert(sizeof(ExtendedFaceprints::user_id) < 256, "User id length must fit in one byte");
+
+// little endian bit stream, lsb first
+class BitWriter
+{
+public:
+    explicit BitWriter(uint8_t* out) : _out {out}
+    {
+    }
+
+    void Write(uint32_t value, uint32_t bits)
+    {
+        _acc |= static_cast<uint64_t>(value & ((1u << bits) - 1)) << _acc_bits;
+        _acc_bits += bits;
+        while (_acc_bits >= 8)
+        {
+            *_out++ = static_cast<uint8_t>(_acc);
+            _acc >>= 8;
+            _acc_bits -= 8;
+        }
+    }
+
+    // pad the last byte with zeros, returns the end of the stream
+    uint8_t* Flush()
+    {
+        if (_acc_bits > 0)
+        {
+            *_out++ = static_cast<uint8_t>(_acc);
+            _acc = 0;
+            _acc_bits = 0;
+        }
+        return _out;
+    }
+
+private:
+    uint8_t* _out;
+    uint64_t _acc = 0;
+    uint32_t _acc_bits = 0;
+};
+
+class BitReader
+{
+public:
+    explicit BitReader(const uint8_t* in) : _in {in}
+    {
+    }
+
+    uint32_t Read(uint32_t bits)
+    {
+        while (_acc_bits < bits)
+        {
+            _acc |= static_cast<uint64_t>(*_in++) << _acc_bits;
+            _acc_bits += 8;
+        }
+        uint32_t value = static_cast<uint32_t>(_acc & ((1u << bits) - 1));
+        _acc >>= bits;
+        _acc_bits -= bits;
+        return value;
+    }
+
+private:
+    const uint8_t* _in;
+    uint64_t _acc = 0;
+    uint32_t _acc_bits = 0;
+};
+
+static inline uint32_t ZigZag(int32_t value)
+{
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+static inline int32_t UnZigZag(uint32_t value)
+{
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+static inline int32_t SignExtend(uint32_t value, uint32_t bits)
+{
+    const uint32_t sign_bit = 1u << (bits - 1);
+    return static_cast<int32_t>((value ^ sign_bit) - sign_bit);
+}
+
+static inline uint32_t BitWidth(uint32_t value)
+{
+    uint32_t bits = 0;
+    while (value != 0)
+    {
+        bits++;
+        value >>= 1;
+    }
+    return bits;
+}
+
+static uint8_t* WriteVarint(uint8_t* out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+// returns nullptr if the varint is truncated or longer than 5 bytes
+static const uint8_t* ReadVarint(const uint8_t* in, const uint8_t* end, uint32_t& value)
+{
+    value = 0;
+    for (uint32_t shift = 0; shift < 35 && in < end; shift += 7)
+    {
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return in;
+        }
+    }
+    return nullptr;
+}
+
+static bool IsInRange(const feature_t* vec)
+{
+    bool in_range = true;
+    for (size_t i = 0; i < FaceprintsCodec::VectorLength; i++)
+    {
+        in_range &= (vec[i] >= -s_maxFeatureValue) && (vec[i] <= s_maxFeatureValue);
+    }
+    return in_range;
+}
+
+static void WriteUint32(uint8_t* out, uint32_t value)
+{
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+    out[2] = static_cast<uint8_t>(value >> 16);
+    out[3] = static_cast<uint8_t>(value >> 24);
+}
+
+static uint32_t ReadUint32(const uint8_t* in)
+{
+    return static_cast<uint32_t>(in[0]) | (static_cast<uint32_t>(in[1]) << 8) | (static_cast<uint32_t>(in[2]) << 16) |
+           (static_cast<uint32_t>(in[3]) << 24);
+}
+
+static uint32_t Checksum(const uint8_t* data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+size_t FaceprintsCodec::Encode(const Faceprints& faceprints, uint8_t* buffer, size_t buffer_size)
+{
+    if (buffer == nullptr || buffer_size < MaxEncodedSize)
+    {
+        // encode to a scratch buffer first, the exact size is known only after encoding
+        uint8_t scratch[MaxEncodedSize];
+        size_t size = (buffer == nullptr) ? 0 : Encode(faceprints, scratch, sizeof(scratch));
+        if (size == 0 || size > buffer_size)
+        {
+            return 0;
+        }
+        ::memcpy(buffer, scratch, size);
+        return size;
+    }
+
+    const feature_t* avg = faceprints.avgDescriptor;
+    const feature_t* orig = faceprints.origDescriptor;
+    if (!IsInRange(avg) || !IsInRange(orig))
+    {
+        LOG_ERROR(LOG_TAG, "Faceprints vector out of range, can't encode");
+        return 0;
+    }
+
+    // widest zigzag delta of orig vs. avg
+    uint32_t max_delta = 0;
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        max_delta |= ZigZag(static_cast<int32_t>(orig[i]) - static_cast<int32_t>(avg[i]));
+    }
+    const uint32_t delta_bits = BitWidth(max_delta);
+
+    uint8_t flags = 0;
+    if (delta_bits == 0)
+    {
+        flags = s_origSameAsAvg;
+    }
+    else if (delta_bits < FeatureBits)
+    {
+        flags = s_origAsDelta;
+    }
+
+    uint8_t* out = buffer;
+    *out++ = flags;
+    out = WriteVarint(out, ZigZag(faceprints.version));
+    out = WriteVarint(out, ZigZag(faceprints.numberOfDescriptors));
+    out = WriteVarint(out, static_cast<uint32_t>(faceprints.featuresType));
+
+    BitWriter writer(out);
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        writer.Write(static_cast<uint32_t>(avg[i]), FeatureBits);
+    }
+    out = writer.Flush();
+
+    if (flags == s_origAsDelta)
+    {
+        *out++ = static_cast<uint8_t>(delta_bits);
+        BitWriter delta_writer(out);
+        for (size_t i = 0; i < VectorLength; i++)
+        {
+            delta_writer.Write(ZigZag(static_cast<int32_t>(orig[i]) - static_cast<int32_t>(avg[i])), delta_bits);
+        }
+        out = delta_writer.Flush();
+    }
+    else if (flags == 0)
+    {
+        BitWriter orig_writer(out);
+        for (size_t i = 0; i < VectorLength; i++)
+        {
+            orig_writer.Write(static_cast<uint32_t>(orig[i]), FeatureBits);
+        }
+        out = orig_writer.Flush();
+    }
+
+    return static_cast<size_t>(out - buffer);
+}
+
+size_t FaceprintsCodec::Decode(const uint8_t* buffer, size_t buffer_size, Faceprints& faceprints)
+{
+    if (buffer == nullptr || buffer_size < 1)
+    {
+        return 0;
+    }
+    const uint8_t* in = buffer;
+    const uint8_t* end = buffer + buffer_size;
+
+    const uint8_t flags = *in++;
+    if (flags != 0 && flags != s_origSameAsAvg && flags != s_origAsDelta)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid record flags");
+        return 0;
+    }
+
+    uint32_t version, number_of_descriptors, features_type;
+    in = ReadVarint(in, end, version);
+    in = (in == nullptr) ? nullptr : ReadVarint(in, end, number_of_descriptors);
+    in = (in == nullptr) ? nullptr : ReadVarint(in, end, features_type);
+    if (in == nullptr || static_cast<size_t>(end - in) < PackedVectorSize)
+    {
+        LOG_ERROR(LOG_TAG, "Truncated record");
+        return 0;
+    }
+
+    faceprints.version = UnZigZag(version);
+    faceprints.numberOfDescriptors = UnZigZag(number_of_descriptors);
+    faceprints.featuresType = static_cast<FaceprintsTypeEnum>(features_type);
+
+    feature_t* avg = faceprints.avgDescriptor;
+    feature_t* orig = faceprints.origDescriptor;
+
+    BitReader reader(in);
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        avg[i] = static_cast<feature_t>(SignExtend(reader.Read(FeatureBits), FeatureBits));
+    }
+    in += PackedVectorSize;
+
+    if (flags == s_origSameAsAvg)
+    {
+        ::memcpy(orig, avg, VectorLength * sizeof(feature_t));
+    }
+    else if (flags == s_origAsDelta)
+    {
+        const uint32_t delta_bits = (in < end) ? *in++ : 0;
+        const size_t delta_size = (VectorLength * delta_bits + 7) / 8;
+        if (delta_bits == 0 || delta_bits >= FeatureBits || static_cast<size_t>(end - in) < delta_size)
+        {
+            LOG_ERROR(LOG_TAG, "Truncated record");
+            return 0;
+        }
+        BitReader delta_reader(in);
+        for (size_t i = 0; i < VectorLength; i++)
+        {
+            orig[i] = static_cast<feature_t>(avg[i] + UnZigZag(delta_reader.Read(delta_bits)));
+        }
+        in += delta_size;
+    }
+    else
+    {
+        if (static_cast<size_t>(end - in) < PackedVectorSize)
+        {
+            LOG_ERROR(LOG_TAG, "Truncated record");
+            return 0;
+        }
+        BitReader orig_reader(in);
+        for (size_t i = 0; i < VectorLength; i++)
+        {
+            orig[i] = static_cast<feature_t>(SignExtend(orig_reader.Read(FeatureBits), FeatureBits));
+        }
+        in += PackedVectorSize;
+    }
+
+    // the in-memory vectors may be longer than the encoded features
+    for (size_t i = VectorLength; i < FEATURES_VECTOR_ALLOC_SIZE; i++)
+    {
+        avg[i] = 0;
+        orig[i] = 0;
+    }
+
+    if (!IsInRange(avg) || !IsInRange(orig))
+    {
+        LOG_ERROR(LOG_TAG, "Decoded faceprints vector out of range");
+        return 0;
+    }
+
+    return static_cast<size_t>(in - buffer);
+}
+
+// size of the record at in from its flags, varints and delta width, 0 if truncated or invalid
+static size_t RecordSize(const uint8_t* in, const uint8_t* end)
+{
+    const uint8_t* record = in;
+    const uint8_t flags = (in < end) ? *in++ : 0xFF;
+    if (flags != 0 && flags != s_origSameAsAvg && flags != s_origAsDelta)
+    {
+        return 0;
+    }
+    uint32_t value;
+    for (int i = 0; i < 3 && in != nullptr; i++)
+    {
+        in = ReadVarint(in, end, value);
+    }
+    if (in == nullptr)
+    {
+        return 0;
+    }
+
+    size_t size = static_cast<size_t>(in - record) + FaceprintsCodec::PackedVectorSize;
+    if (flags == s_origAsDelta)
+    {
+        const size_t width_offset = size;
+        if (width_offset >= static_cast<size_t>(end - record))
+        {
+            return 0;
+        }
+        size += 1 + (FaceprintsCodec::VectorLength * record[width_offset] + 7) / 8;
+    }
+    else if (flags == 0)
+    {
+        size += FaceprintsCodec::PackedVectorSize;
+    }
+    return size <= static_cast<size_t>(end - record) ? size : 0;
+}
+
+bool FaceprintsCodec::EncodeUsers(const std::vector<ExtendedFaceprints>& users, std::vector<uint8_t>& buffer)
+{
+    const size_t max_user_size = 1 + sizeof(ExtendedFaceprints::user_id) + MaxEncodedSize;
+    buffer.resize(s_bulkHeaderSize + users.size() * max_user_size + s_bulkChecksumSize);
+
+    uint8_t* out = buffer.data();
+    ::memcpy(out, s_bulkMagic, sizeof(s_bulkMagic));
+    WriteUint32(out + sizeof(s_bulkMagic), s_bulkFormatVersion);
+    WriteUint32(out + sizeof(s_bulkMagic) + 4, static_cast<uint32_t>(users.size()));
+    out += s_bulkHeaderSize;
+
+    for (auto& user : users)
+    {
+        const uint8_t id_length = static_cast<uint8_t>(::strnlen(user.user_id, sizeof(user.user_id) - 1));
+        *out++ = id_length;
+        ::memcpy(out, user.user_id, id_length);
+        out += id_length;
+
+        size_t size = Encode(user.faceprints, out, MaxEncodedSize);
+        if (size == 0)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to encode user");
+            buffer.clear();
+            return false;
+        }
+        out += size;
+    }
+
+    const size_t payload_size = static_cast<size_t>(out - buffer.data());
+    WriteUint32(out, Checksum(buffer.data(), payload_size));
+    buffer.resize(payload_size + s_bulkChecksumSize);
+    return true;
+}
+
+bool FaceprintsCodec::EncodeUsers(const FaceprintsGallery& gallery, std::vector<uint8_t>& buffer)
+{
+    std::vector<ExtendedFaceprints> users(gallery.Size());
+    for (size_t i = 0; i < users.size(); i++)
+    {
+        ::memset(users[i].user_id, 0, sizeof(users[i].user_id));
+        ::strncpy(users[i].user_id, gallery.UserId(i), sizeof(users[i].user_id) - 1);
+        gallery.GetFaceprints(i, users[i].faceprints);
+    }
+    return EncodeUsers(users, buffer);
+}
+
+// validate the header and checksum of a bulk buffer, returns the user count
+static bool ReadBulkHeader(const uint8_t* buffer, size_t buffer_size, uint32_t& count)
+{
+    if (buffer == nullptr || buffer_size < s_bulkHeaderSize + s_bulkChecksumSize ||
+        ::memcmp(buffer, s_bulkMagic, sizeof(s_bulkMagic)) != 0)
+    {
+        LOG_ERROR(LOG_TAG, "Not a faceprints bulk buffer");
+        return false;
+    }
+    if (ReadUint32(buffer + sizeof(s_bulkMagic)) != s_bulkFormatVersion)
+    {
+        LOG_ERROR(LOG_TAG, "Unsupported bulk format version");
+        return false;
+    }
+
+    const size_t payload_size = buffer_size - s_bulkChecksumSize;
+    if (ReadUint32(buffer + payload_size) != Checksum(buffer, payload_size))
+    {
+        LOG_ERROR(LOG_TAG, "Bulk buffer checksum mismatch");
+        return false;
+    }
+
+    // smallest user: id length byte + smallest record
+    count = ReadUint32(buffer + sizeof(s_bulkMagic) + 4);
+    if (count > (payload_size - s_bulkHeaderSize) / (1 + 4 + FaceprintsCodec::PackedVectorSize))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user count");
+        return false;
+    }
+    return true;
+}
+
+bool FaceprintsCodec::DecodeUsers(const uint8_t* buffer, size_t buffer_size, std::vector<ExtendedFaceprints>& users)
+{
+    users.clear();
+
+    uint32_t count = 0;
+    if (!ReadBulkHeader(buffer, buffer_size, count))
+    {
+        return false;
+    }
+    const uint8_t* in = buffer + s_bulkHeaderSize;
+    const uint8_t* end = buffer + buffer_size - s_bulkChecksumSize;
+    users.resize(count);
+
+    for (auto& user : users)
+    {
+        const uint8_t id_length = (in < end) ? *in++ : 0;
+        if (id_length >= sizeof(user.user_id) || static_cast<size_t>(end - in) < id_length)
+        {
+            LOG_ERROR(LOG_TAG, "Invalid user id");
+            users.clear();
+            return false;
+        }
+        ::memset(user.user_id, 0, sizeof(user.user_id));
+        ::memcpy(user.user_id, in, id_length);
+        in += id_length;
+
+        size_t size = Decode(in, static_cast<size_t>(end - in), user.faceprints);
+        if (size == 0)
+        {
+            users.clear();
+            return false;
+        }
+        in += size;
+    }
+
+    if (in != end)
+    {
+        LOG_ERROR(LOG_TAG, "Trailing data in bulk buffer");
+        users.clear();
+        return false;
+    }
+    return true;
+}
+
+bool FaceprintsCodec::IndexUsers(const uint8_t* buffer, size_t buffer_size, std::vector<size_t>& offsets)
+{
+    offsets.clear();
+
+    uint32_t count = 0;
+    if (!ReadBulkHeader(buffer, buffer_size, count))
+    {
+        return false;
+    }
+    const uint8_t* in = buffer + s_bulkHeaderSize;
+    const uint8_t* end = buffer + buffer_size - s_bulkChecksumSize;
+    offsets.resize(count);
+
+    for (auto& offset : offsets)
+    {
+        offset = static_cast<size_t>(in - buffer);
+        const uint8_t id_length = (in < end) ? *in++ : 0;
+        size_t size = 0;
+        if (id_length < sizeof(ExtendedFaceprints::user_id) && static_cast<size_t>(end - in) >= id_length)
+        {
+            in += id_length;
+            size = RecordSize(in, end);
+        }
+        if (size == 0)
+        {
+            LOG_ERROR(LOG_TAG, "Invalid user at offset %zu", offset);
+            offsets.clear();
+            return false;
+        }
+        in += size;
+    }
+
+    if (in != end)
+    {
+        LOG_ERROR(LOG_TAG, "Trailing data in bulk buffer");
+        offsets.clear();
+        return false;
+    }
+    return true;
+}
+
+bool FaceprintsCodec::DecodeUser(const uint8_t* buffer, size_t buffer_size, size_t offset, ExtendedFaceprints& user)
+{
+    const size_t end = buffer_size - s_bulkChecksumSize;
+    if (buffer == nullptr || buffer_size < s_bulkHeaderSize + s_bulkChecksumSize || offset < s_bulkHeaderSize ||
+        offset >= end)
+    {
+        return false;
+    }
+    const uint8_t id_length = buffer[offset];
+    if (id_length >= sizeof(user.user_id) || end - offset - 1 < id_length)
+    {
+        return false;
+    }
+    ::memset(user.user_id, 0, sizeof(user.user_id));
+    ::memcpy(user.user_id, buffer + offset + 1, id_length);
+    const size_t record = offset + 1 + id_length;
+    return Decode(buffer + record, end - record, user.faceprints) != 0;
+}
+} // namespace RealSenseID
@@ -0,0 +1,58 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "ExtendedFaceprints.h"
+#include "RealSenseID/Faceprints.h"
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+class FaceprintsGallery;
+
+/**
+ * Compact serialization of faceprints for bulk export/import and storage. The in-memory Faceprints are unchanged.
+ *
+ * Record (all bit fields little endian, lsb first):
+ *   flags | varint version (zigzag) | varint numberOfDescriptors | varint featuresType |
+ *   avg vector, 11 bit per feature | orig vector
+ * The orig vector is omitted if equal to the avg vector, otherwise it is stored as the zigzag delta to the avg
+ * vector with the narrowest bit width fitting all deltas (1 byte width + bits), or as 11 bit features if that is
+ * not smaller. A record is at most 718 bytes (708 for the current version) vs. 1034 bytes of raw Faceprints fields.
+ * Features must be in the valid matcher range [-1023,+1023].
+ */
+class FaceprintsCodec
+{
+public:
+    static constexpr uint32_t FeatureBits = 11;
+    static constexpr size_t VectorLength = NUMBER_OF_RECOGNITION_FACEPRINTS;
+    static constexpr size_t PackedVectorSize = (VectorLength * FeatureBits + 7) / 8;
+    // flags + varints (5 + 5 + 3 bytes at most) + avg vector + orig vector
+    static constexpr size_t MaxEncodedSize = 1 + 5 + 5 + 3 + 2 * PackedVectorSize;
+
+    // encode into buffer, returns the number of bytes written (0 if a feature is out of range or the buffer is too
+    // small - MaxEncodedSize is always enough).
+    static size_t Encode(const Faceprints& faceprints, uint8_t* buffer, size_t buffer_size);
+
+    // decode one record, returns the number of bytes consumed (0 if the record is truncated or invalid).
+    static size_t Decode(const uint8_t* buffer, size_t buffer_size, Faceprints& faceprints);
+
+    // bulk format: "RSIDFPC" header, user count, (user id, record) per user, fnv-1a checksum.
+    // returns false if any user could not be encoded (buffer is left empty).
+    static bool EncodeUsers(const std::vector<ExtendedFaceprints>& users, std::vector<uint8_t>& buffer);
+    static bool EncodeUsers(const FaceprintsGallery& gallery, std::vector<uint8_t>& buffer);
+
+    // returns false if the buffer is not a valid bulk buffer (users is left empty).
+    static bool DecodeUsers(const uint8_t* buffer, size_t buffer_size, std::vector<ExtendedFaceprints>& users);
+
+    // find the users of a bulk buffer without decoding them (parsing the record headers only), for decoding them
+    // concurrently with DecodeUser(). returns false if the buffer is not a valid bulk buffer (offsets is left empty).
+    static bool IndexUsers(const uint8_t* buffer, size_t buffer_size, std::vector<size_t>& offsets);
+
+    // decode the user at the given offset (found by IndexUsers()). returns false if the record is invalid.
+    static bool DecodeUser(const uint8_t* buffer, size_t buffer_size, size_t offset, ExtendedFaceprints& user);
+};
+} // namespace RealSenseID
@@ -0,0 +1,309 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsDatabase.h"
+#include "GalleryChangeLog.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FaceprintsDatabase";
+
+FaceprintsDatabase::~FaceprintsDatabase()
+{
+    Close();
+}
+
+bool FaceprintsDatabase::Open(const std::string& path)
+{
+    Close();
+    _path = path;
+
+    if (!std::ifstream(path, std::ios::binary) && !MappedFaceprintsGallery::Save(FaceprintsGallery {}, path))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to create gallery file %s", path.c_str());
+        return false;
+    }
+
+    if (!OpenBase())
+    {
+        return false;
+    }
+    ResetBaseMask();
+
+    // replay is idempotent on top of a compacted gallery file (e.g. crash between compaction and journal reset):
+    // enroll of an existing user is skipped, update and remove reach the same final state.
+    auto apply = [this](const FaceprintsJournal::Record& record) {
+        Apply(record.operation, record.user_id, &record.faceprints);
+    };
+    if (!_journal.Open(path + ".journal", apply))
+    {
+        Close();
+        return false;
+    }
+
+    _is_open = true;
+    LOG_DEBUG(LOG_TAG, "Opened %s: %zu users, %zu journal records", path.c_str(), Size(), _journal.NumRecords());
+    return true;
+}
+
+void FaceprintsDatabase::Close()
+{
+    _journal.Close();
+    _base.Close();
+    _delta.Clear();
+    ResetBaseMask();
+    _is_open = false;
+}
+
+bool FaceprintsDatabase::Enroll(const char* user_id, const Faceprints& faceprints)
+{
+    if (Find(user_id) >= 0)
+    {
+        return false;
+    }
+    return Journal(FaceprintsJournal::Operation::Enroll, user_id, &faceprints);
+}
+
+bool FaceprintsDatabase::Update(const char* user_id, const Faceprints& faceprints)
+{
+    if (Find(user_id) < 0)
+    {
+        return false;
+    }
+    return Journal(FaceprintsJournal::Operation::Update, user_id, &faceprints);
+}
+
+bool FaceprintsDatabase::Remove(const char* user_id)
+{
+    if (Find(user_id) < 0)
+    {
+        return false;
+    }
+    return Journal(FaceprintsJournal::Operation::Remove, user_id, nullptr);
+}
+
+bool FaceprintsDatabase::Compact()
+{
+    if (!_is_open)
+    {
+        LOG_ERROR(LOG_TAG, "Database is not open");
+        return false;
+    }
+
+    FaceprintsGallery merged;
+    merged.Reserve(Size());
+    Faceprints faceprints;
+    for (size_t index = 0; index < IndexSize(); index++)
+    {
+        if (GetFaceprints(index, faceprints))
+        {
+            merged.Add(UserId(index), faceprints);
+        }
+    }
+
+    // the gallery file can't be replaced while mapped on all platforms
+    const uint32_t generation = _base.Generation() + 1;
+    _base.Close();
+    bool saved = MappedFaceprintsGallery::Save(merged, _path, generation);
+    if (!OpenBase())
+    {
+        _is_open = false;
+        return false;
+    }
+    if (!saved)
+    {
+        // old gallery file, mask and journal are still consistent
+        return false;
+    }
+
+    ResetBaseMask();
+    _delta.Clear();
+    if (!_journal.Reset())
+    {
+        _is_open = false;
+        return false;
+    }
+
+    LOG_DEBUG(LOG_TAG, "Compacted %s: %zu users", _path.c_str(), Size());
+    return true;
+}
+
+int FaceprintsDatabase::Find(const char* user_id) const
+{
+    int index = _delta.Find(user_id);
+    if (index >= 0)
+    {
+        return static_cast<int>(_base.Size()) + index;
+    }
+    return FindBaseRow(user_id);
+}
+
+const char* FaceprintsDatabase::UserId(size_t index) const
+{
+    return index < _base.Size() ? _base.UserId(index) : _delta.UserId(index - _base.Size());
+}
+
+const FaceprintsGallery::Metadata& FaceprintsDatabase::GetMetadata(size_t index) const
+{
+    return index < _base.Size() ? _base.GetMetadata(index) : _delta.GetMetadata(index - _base.Size());
+}
+
+bool FaceprintsDatabase::GetFaceprints(size_t index, Faceprints& faceprints) const
+{
+    if (index < _base.Size())
+    {
+        return !_removed_base_rows[index] && _base.GetFaceprints(index, faceprints);
+    }
+    return _delta.GetFaceprints(index - _base.Size(), faceprints);
+}
+
+bool FaceprintsDatabase::Apply(FaceprintsJournal::Operation operation, const char* user_id,
+                               const Faceprints* faceprints)
+{
+    int delta_index = _delta.Find(user_id);
+    int base_row = delta_index < 0 ? FindBaseRow(user_id) : -1;
+
+    switch (operation)
+    {
+    case FaceprintsJournal::Operation::Enroll:
+        if (delta_index >= 0 || base_row >= 0)
+        {
+            return false;
+        }
+        _delta.Add(user_id, *faceprints);
+        return true;
+
+    case FaceprintsJournal::Operation::Update:
+        if (delta_index >= 0)
+        {
+            return _delta.Update(static_cast<size_t>(delta_index), *faceprints);
+        }
+        if (base_row < 0)
+        {
+            return false;
+        }
+        // the gallery file is read only - mask the row and keep the updated user in memory
+        RemoveBaseRow(static_cast<size_t>(base_row));
+        _delta.Add(user_id, *faceprints);
+        return true;
+
+    case FaceprintsJournal::Operation::Remove:
+        if (delta_index >= 0)
+        {
+            return _delta.Remove(static_cast<size_t>(delta_index));
+        }
+        if (base_row < 0)
+        {
+            return false;
+        }
+        RemoveBaseRow(static_cast<size_t>(base_row));
+        return true;
+    }
+    return false;
+}
+
+bool FaceprintsDatabase::Journal(FaceprintsJournal::Operation operation, const char* user_id,
+                                 const Faceprints* faceprints)
+{
+    if (!_is_open)
+    {
+        LOG_ERROR(LOG_TAG, "Database is not open");
+        return false;
+    }
+
+    // write ahead - the change is applied only once it is in the journal
+    if (!_journal.Append(operation, user_id, faceprints))
+    {
+        return false;
+    }
+    Apply(operation, user_id, faceprints);
+    if (_change_log != nullptr)
+    {
+        // a change the replicas can't be sent is logged by the change log, it is persistent here regardless
+        _change_log->Append(operation, user_id, faceprints);
+    }
+
+    if (_compaction_threshold > 0 && _journal.NumRecords() >= _compaction_threshold)
+    {
+        // a failed compaction keeps the journal, the change itself is already persistent
+        Compact();
+    }
+    return true;
+}
+
+bool FaceprintsDatabase::OpenBase()
+{
+    if (!_base.Open(_path))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to open gallery file %s", _path.c_str());
+        return false;
+    }
+    return true;
+}
+
+int FaceprintsDatabase::FindBaseRow(const char* user_id) const
+{
+    if (user_id == nullptr)
+    {
+        return -1;
+    }
+    if (UserIdIndex::IsIndexed(user_id))
+    {
+        // the masked rows are not in the index
+        return _base_index.Find(user_id, [this](size_t row) { return _base.UserId(row); });
+    }
+
+    for (size_t row = 0; row < _base.Size(); row++)
+    {
+        if (!_removed_base_rows[row] && ::strncmp(_base.UserId(row), user_id, FaceprintsGallery::MaxUserIdLength) == 0)
+        {
+            return static_cast<int>(row);
+        }
+    }
+    return -1;
+}
+
+void FaceprintsDatabase::RemoveBaseRow(size_t row)
+{
+    _base_index.Erase(row, _base.UserId(row));
+    _removed_base_rows[row] = 1;
+
+    // the live rows are listed at the first removal, then erased one by one (stays sorted)
+    if (_num_removed_base_rows++ == 0)
+    {
+        _live_base_rows.clear();
+        _live_base_rows.reserve(_base.Size());
+        for (size_t i = 0; i < _base.Size(); i++)
+        {
+            if (i != row)
+            {
+                _live_base_rows.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        return;
+    }
+    auto it = std::lower_bound(_live_base_rows.begin(), _live_base_rows.end(), static_cast<uint32_t>(row));
+    if (it != _live_base_rows.end() && *it == row)
+    {
+        _live_base_rows.erase(it);
+    }
+}
+
+void FaceprintsDatabase::ResetBaseMask()
+{
+    _removed_base_rows.assign(_base.Size(), 0);
+    _live_base_rows.clear();
+    _num_removed_base_rows = 0;
+
+    _base_index.Clear();
+    _base_index.Reserve(_base.Size());
+    for (size_t row = 0; row < _base.Size(); row++)
+    {
+        _base_index.Insert(row, _base.UserId(row));
+    }
+}
+} // namespace RealSenseID
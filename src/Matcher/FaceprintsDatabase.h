@@ -0,0 +1,150 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include "FaceprintsJournal.h"
+#include "MappedFaceprintsGallery.h"
+#include "UserIdIndex.h"
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+class GalleryChangeLog;
+
+/**
+ * Persistent host side faceprints database for large galleries.
+ * The compacted users live in a memory mapped gallery file (matching starts without parsing it), changes since the
+ * last compaction are appended to a journal (<path>.journal) and kept in a small in-memory gallery. Removed or
+ * updated users of the gallery file are masked until the next compaction, which rewrites the gallery file and
+ * resets the journal (automatically once the journal holds CompactionThreshold() records).
+ *
+ * Indices (e.g. ExtendedMatchResult::userId) are [0, Base().Size()) for the gallery file followed by the in-memory
+ * users, and change on every write. Not thread safe - wrap with external synchronization for concurrent writers.
+ */
+class FaceprintsDatabase
+{
+public:
+    static constexpr size_t DefaultCompactionThreshold = 10000;
+
+    FaceprintsDatabase() = default;
+    ~FaceprintsDatabase();
+
+    FaceprintsDatabase(const FaceprintsDatabase&) = delete;
+    FaceprintsDatabase& operator=(const FaceprintsDatabase&) = delete;
+
+    // open the gallery file and replay its journal, missing files are created. returns false on failure.
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const
+    {
+        return _is_open;
+    }
+
+    // journaled operations. return false if the user exists (Enroll), was not found (Update/Remove) or on failure.
+    bool Enroll(const char* user_id, const Faceprints& faceprints);
+    bool Update(const char* user_id, const Faceprints& faceprints);
+    bool Remove(const char* user_id);
+
+    // rewrite the gallery file with all users and reset the journal.
+    bool Compact();
+
+    // number of journal records that triggers compaction, 0 disables automatic compaction.
+    void SetCompactionThreshold(size_t journal_records)
+    {
+        _compaction_threshold = journal_records;
+    }
+
+    size_t CompactionThreshold() const
+    {
+        return _compaction_threshold;
+    }
+
+    // record the journaled operations (not the journal replay of Open()) to change_log for the replicas, nullptr to
+    // stop. change_log must outlive the database or be reset.
+    void SetChangeLog(GalleryChangeLog* change_log)
+    {
+        _change_log = change_log;
+    }
+
+    size_t NumJournalRecords() const
+    {
+        return _journal.NumRecords();
+    }
+
+    // generation of the gallery file, incremented by every compaction (files stored alongside it, such as a saved
+    // index, record it to tell how stale they are)
+    uint32_t Generation() const
+    {
+        return _base.Generation();
+    }
+
+    // number of users
+    size_t Size() const
+    {
+        return _base.Size() - _num_removed_base_rows + _delta.Size();
+    }
+
+    // size of the index space (includes masked rows of the gallery file)
+    size_t IndexSize() const
+    {
+        return _base.Size() + _delta.Size();
+    }
+
+    // index of the given user id or -1 if not found.
+    int Find(const char* user_id) const;
+
+    const char* UserId(size_t index) const;
+    const FaceprintsGallery::Metadata& GetMetadata(size_t index) const;
+
+    // copy the faceprints of the given index. returns false if index is out of range or masked.
+    bool GetFaceprints(size_t index, Faceprints& faceprints) const;
+
+    const MappedFaceprintsGallery& Base() const
+    {
+        return _base;
+    }
+
+    const FaceprintsGallery& Delta() const
+    {
+        return _delta;
+    }
+
+    bool HasRemovedBaseRows() const
+    {
+        return _num_removed_base_rows > 0;
+    }
+
+    // unmasked rows of the gallery file in ascending order (valid if HasRemovedBaseRows())
+    const std::vector<uint32_t>& LiveBaseRows() const
+    {
+        return _live_base_rows;
+    }
+
+private:
+    // apply a change to the in-memory state, also used for journal replay.
+    bool Apply(FaceprintsJournal::Operation operation, const char* user_id, const Faceprints* faceprints);
+    bool Journal(FaceprintsJournal::Operation operation, const char* user_id, const Faceprints* faceprints);
+    bool OpenBase();
+    int FindBaseRow(const char* user_id) const;
+    void RemoveBaseRow(size_t row);
+    void ResetBaseMask();
+
+    std::string _path;
+    bool _is_open = false;
+    MappedFaceprintsGallery _base;
+    FaceprintsGallery _delta;
+    FaceprintsJournal _journal;
+    std::vector<char> _removed_base_rows;
+    UserIdIndex _base_index {FaceprintsGallery::MaxUserIdLength}; // unmasked rows of the gallery file
+    std::vector<uint32_t> _live_base_rows;
+    size_t _num_removed_base_rows = 0;
+    GalleryChangeLog* _change_log = nullptr;
+    size_t _compaction_threshold = DefaultCompactionThreshold;
+};
+} // namespace RealSenseID
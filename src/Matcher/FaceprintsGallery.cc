@@ -0,0 +1,366 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsGallery.h"
+#include "Matcher.h"
+#include "MatcherThreadPool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace RealSenseID
+{
+static_assert(FaceprintsGallery::VectorLength <= FEATURES_VECTOR_ALLOC_SIZE, "Gallery vector length mismatch");
+static_assert((FaceprintsGallery::VectorLength * sizeof(feature_t)) % FaceprintsGallery::RowAlignment == 0,
+              "Gallery rows must keep the row alignment");
+static_assert(FaceprintsGallery::VectorLength % 64 == 0, "Sign code must cover the whole vector");
+static_assert(FaceprintsGallery::VectorLength % 2 == 0, "Interleaved blocks hold pairs of features");
+
+// records per task of a bulk import (whole interleaved blocks, so the tasks don't share blocks)
+static const size_t s_bulkChunkRows = 64 * FaceprintsGallery::InterleaveRows;
+
+// features of an interleaved block
+static const size_t s_interleavedBlockLength = FaceprintsGallery::InterleaveRows * FaceprintsGallery::VectorLength;
+
+static size_t InterleavedLength(size_t size)
+{
+    return (size + FaceprintsGallery::InterleaveRows - 1) / FaceprintsGallery::InterleaveRows *
+           s_interleavedBlockLength;
+}
+
+size_t FaceprintsGallery::Add(const char* user_id, const Faceprints& faceprints)
+{
+    size_t index = Size();
+
+    UserIdEntry id;
+    ::memset(id.id, 0, sizeof(id.id));
+    if (user_id != nullptr)
+    {
+        ::strncpy(id.id, user_id, sizeof(id.id) - 1);
+    }
+    Resize(index + 1);
+    _user_ids[index] = id;
+    _user_id_index.Insert(index, id.id);
+    if (_is_interleaved)
+    {
+        _interleaved_vectors.resize(InterleavedLength(index + 1));
+    }
+
+    SetEntry(index, faceprints);
+    return index;
+}
+
+size_t FaceprintsGallery::Add(const ExtendedFaceprints& extended_faceprints)
+{
+    return Add(extended_faceprints.user_id, extended_faceprints.faceprints);
+}
+
+size_t FaceprintsGallery::AddBulk(const BulkImportSource& source, MatcherThreadPool& pool, bool strict,
+                                  std::vector<BulkImportError>* errors)
+{
+    const size_t first = Size();
+    const size_t count = source.Size();
+    Resize(first + count);
+
+    // 0 if the record is added, or its BulkImportError::Reason + 1
+    std::vector<uint8_t> rejected(count, 0);
+    auto reject = [&rejected](size_t record, BulkImportError::Reason reason) {
+        rejected[record] = static_cast<uint8_t>(reason) + 1;
+    };
+
+    // the rows of the records, in parallel
+    const size_t num_chunks = (count + s_bulkChunkRows - 1) / s_bulkChunkRows;
+    pool.Run(num_chunks, [&](size_t chunk) {
+        ExtendedFaceprints user;
+        const size_t end = std::min(count, (chunk + 1) * s_bulkChunkRows);
+        for (size_t record = chunk * s_bulkChunkRows; record < end; record++)
+        {
+            if (!source.Read(record, user))
+            {
+                reject(record, BulkImportError::Reason::InvalidRecord);
+                continue;
+            }
+            UserIdEntry& id = _user_ids[first + record];
+            ::memset(id.id, 0, sizeof(id.id));
+            ::strncpy(id.id, user.user_id, sizeof(id.id) - 1);
+            SetRow(first + record, user.faceprints);
+            if (strict && !IsUsable(_metadata[first + record]))
+            {
+                reject(record, BulkImportError::Reason::InvalidFaceprints);
+            }
+        }
+    });
+
+    // ids in record order (a duplicate id in the import is found in the index), rejected rows are dropped
+    size_t size = first;
+    for (size_t record = 0; record < count; record++)
+    {
+        const size_t row = first + record;
+        if (strict && rejected[record] == 0 && UserIdIndex::IsIndexed(_user_ids[row].id) &&
+            Find(_user_ids[row].id) >= 0)
+        {
+            reject(record, BulkImportError::Reason::DuplicateUserId);
+        }
+        if (rejected[record] != 0)
+        {
+            if (errors != nullptr)
+            {
+                errors->push_back({record, static_cast<BulkImportError::Reason>(rejected[record] - 1)});
+            }
+            continue;
+        }
+        if (row != size)
+        {
+            CopyRow(row, size);
+        }
+        _user_id_index.Insert(size, _user_ids[size].id);
+        CountEntry(_metadata[size]);
+        size++;
+    }
+    Resize(size);
+
+    if (_is_interleaved)
+    {
+        _interleaved_vectors.resize(InterleavedLength(size));
+        const size_t first_block_row = first / InterleaveRows * InterleaveRows;
+        const size_t num_interleave_chunks = (size - first_block_row + s_bulkChunkRows - 1) / s_bulkChunkRows;
+        pool.Run(num_interleave_chunks, [&](size_t chunk) {
+            const size_t begin = std::max(first, first_block_row + chunk * s_bulkChunkRows);
+            const size_t end = std::min(size, first_block_row + (chunk + 1) * s_bulkChunkRows);
+            for (size_t index = begin; index < end; index++)
+            {
+                SetInterleavedRow(index);
+            }
+        });
+    }
+    return size - first;
+}
+
+bool FaceprintsGallery::Update(size_t index, const Faceprints& faceprints)
+{
+    if (index >= Size())
+    {
+        return false;
+    }
+    UncountEntry(_metadata[index]);
+    SetEntry(index, faceprints);
+    return true;
+}
+
+bool FaceprintsGallery::Remove(size_t index)
+{
+    size_t size = Size();
+    if (index >= size)
+    {
+        return false;
+    }
+
+    UncountEntry(_metadata[index]);
+
+    size_t last = size - 1;
+    _user_id_index.Erase(index, _user_ids[index].id);
+    if (index != last)
+    {
+        _user_id_index.Move(last, index, _user_ids[last].id);
+        CopyRow(last, index);
+    }
+    if (_is_interleaved)
+    {
+        // the padding of the last block stays zero
+        if (index != last)
+        {
+            SetInterleavedRow(index);
+        }
+        ::memset(&_avg_vectors[last * VectorLength], 0, VectorLength * sizeof(feature_t));
+        SetInterleavedRow(last);
+        _interleaved_vectors.resize(InterleavedLength(last));
+    }
+
+    Resize(last);
+    return true;
+}
+
+int FaceprintsGallery::Find(const char* user_id) const
+{
+    if (user_id == nullptr)
+    {
+        return -1;
+    }
+    if (UserIdIndex::IsIndexed(user_id))
+    {
+        return _user_id_index.Find(user_id, [this](size_t row) { return _user_ids[row].id; });
+    }
+
+    // empty ids (users added without an id) are not indexed
+    for (size_t i = 0; i < _user_ids.size(); i++)
+    {
+        if (::strncmp(_user_ids[i].id, user_id, sizeof(_user_ids[i].id)) == 0)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void FaceprintsGallery::Clear()
+{
+    _avg_vectors.clear();
+    _orig_vectors.clear();
+    _user_ids.clear();
+    _metadata.clear();
+    _avg_norms.clear();
+    _avg_norm_msbs.clear();
+    _avg_norm_recips.clear();
+    _sign_codes.clear();
+    _interleaved_vectors.clear();
+    _user_id_index.Clear();
+    _num_unusable = 0;
+    _version_counts.clear();
+}
+
+void FaceprintsGallery::Reserve(size_t capacity)
+{
+    _avg_vectors.reserve(capacity * VectorLength);
+    _orig_vectors.reserve(capacity * VectorLength);
+    _user_ids.reserve(capacity);
+    _metadata.reserve(capacity);
+    _avg_norms.reserve(capacity);
+    _avg_norm_msbs.reserve(capacity);
+    _avg_norm_recips.reserve(capacity);
+    _sign_codes.reserve(capacity * SignCodeWords);
+    _user_id_index.Reserve(capacity);
+    if (_is_interleaved)
+    {
+        _interleaved_vectors.reserve(InterleavedLength(capacity));
+    }
+}
+
+void FaceprintsGallery::SetInterleaved(bool interleaved)
+{
+    _is_interleaved = interleaved;
+    _interleaved_vectors.clear();
+    if (!interleaved)
+    {
+        _interleaved_vectors.shrink_to_fit();
+        return;
+    }
+    _interleaved_vectors.resize(InterleavedLength(Size()));
+    for (size_t index = 0; index < Size(); index++)
+    {
+        SetInterleavedRow(index);
+    }
+}
+
+bool FaceprintsGallery::GetFaceprints(size_t index, Faceprints& faceprints) const
+{
+    if (index >= Size())
+    {
+        return false;
+    }
+
+    auto& metadata = _metadata[index];
+    faceprints.version = metadata.version;
+    faceprints.numberOfDescriptors = metadata.numberOfDescriptors;
+    faceprints.featuresType = metadata.featuresType;
+    ::memcpy(&faceprints.avgDescriptor[0], AvgVector(index), VectorLength * sizeof(feature_t));
+    ::memcpy(&faceprints.origDescriptor[0], OrigVector(index), VectorLength * sizeof(feature_t));
+    return true;
+}
+
+void FaceprintsGallery::SetEntry(size_t index, const Faceprints& faceprints)
+{
+    SetRow(index, faceprints);
+    if (_is_interleaved)
+    {
+        SetInterleavedRow(index);
+    }
+    CountEntry(_metadata[index]);
+}
+
+void FaceprintsGallery::SetRow(size_t index, const Faceprints& faceprints)
+{
+    ::memcpy(&_avg_vectors[index * VectorLength], &faceprints.avgDescriptor[0], VectorLength * sizeof(feature_t));
+    ::memcpy(&_orig_vectors[index * VectorLength], &faceprints.origDescriptor[0], VectorLength * sizeof(feature_t));
+
+    auto& metadata = _metadata[index];
+    metadata.version = faceprints.version;
+    metadata.numberOfDescriptors = faceprints.numberOfDescriptors;
+    metadata.featuresType = faceprints.featuresType;
+    metadata.is_valid = Matcher::ValidateFaceprints(faceprints);
+
+    Matcher::CalculateNorm(&faceprints.avgDescriptor[0], _avg_norms[index], _avg_norm_msbs[index]);
+    _avg_norm_recips[index] = Matcher::CalculateNormReciprocal(_avg_norms[index]);
+    CalculateSignCode(&faceprints.avgDescriptor[0], &_sign_codes[index * SignCodeWords]);
+}
+
+void FaceprintsGallery::CopyRow(size_t from, size_t to)
+{
+    ::memcpy(&_avg_vectors[to * VectorLength], &_avg_vectors[from * VectorLength], VectorLength * sizeof(feature_t));
+    ::memcpy(&_orig_vectors[to * VectorLength], &_orig_vectors[from * VectorLength], VectorLength * sizeof(feature_t));
+    _user_ids[to] = _user_ids[from];
+    _metadata[to] = _metadata[from];
+    _avg_norms[to] = _avg_norms[from];
+    _avg_norm_msbs[to] = _avg_norm_msbs[from];
+    _avg_norm_recips[to] = _avg_norm_recips[from];
+    ::memcpy(&_sign_codes[to * SignCodeWords], &_sign_codes[from * SignCodeWords], SignCodeWords * sizeof(uint64_t));
+}
+
+void FaceprintsGallery::Resize(size_t size)
+{
+    _avg_vectors.resize(size * VectorLength);
+    _orig_vectors.resize(size * VectorLength);
+    _user_ids.resize(size);
+    _metadata.resize(size);
+    _avg_norms.resize(size, 1);
+    _avg_norm_msbs.resize(size, 1);
+    _avg_norm_recips.resize(size, 0);
+    _sign_codes.resize(size * SignCodeWords);
+}
+
+void FaceprintsGallery::SetInterleavedRow(size_t index)
+{
+    const feature_t* vec = &_avg_vectors[index * VectorLength];
+    feature_t* block = &_interleaved_vectors[index / InterleaveRows * s_interleavedBlockLength];
+    const size_t row = index % InterleaveRows;
+    for (size_t pair = 0; pair < VectorLength / 2; pair++)
+    {
+        feature_t* dst = block + pair * 2 * InterleaveRows + 2 * row;
+        dst[0] = vec[2 * pair];
+        dst[1] = vec[2 * pair + 1];
+    }
+}
+
+void FaceprintsGallery::CountEntry(const Metadata& metadata)
+{
+    if (!IsUsable(metadata))
+    {
+        _num_unusable++;
+    }
+    _version_counts[metadata.version]++;
+}
+
+void FaceprintsGallery::UncountEntry(const Metadata& metadata)
+{
+    if (!IsUsable(metadata))
+    {
+        _num_unusable--;
+    }
+    auto it = _version_counts.find(metadata.version);
+    if (--it->second == 0)
+    {
+        _version_counts.erase(it);
+    }
+}
+
+void FaceprintsGallery::CalculateSignCode(const feature_t* vec, uint64_t* code)
+{
+    for (size_t word = 0; word < SignCodeWords; word++)
+    {
+        uint64_t bits = 0;
+        for (size_t bit = 0; bit < 64; bit++)
+        {
+            bits |= static_cast<uint64_t>(vec[word * 64 + bit] > 0) << bit;
+        }
+        code[word] = bits;
+    }
+}
+} // namespace RealSenseID
@@ -0,0 +1,296 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "MatcherImplDefines.h"
+#include "ExtendedFaceprints.h"
+#include "GalleryBulkImport.h"
+#include "GalleryMemory.h"
+#include "MatcherKernels.h"
+#include "UserIdIndex.h"
+#include "MetricsRecorder.h"
+#include "RealSenseID/Allocator.h"
+#include "RealSenseID/Faceprints.h"
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+class MatcherThreadPool;
+
+// Minimal allocator returning memory aligned to the given boundary (std::allocator only guarantees
+// alignof(max_align_t) before c++17), from the SDK allocator (see RealSenseID/Allocator.h). Large blocks are huge page
+// backed (see GalleryMemory), counted as the matcher's allocations.
+template <typename T, size_t Alignment>
+class AlignedAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        if (!IsLarge(n))
+        {
+            return static_cast<T*>(SdkAllocate(Metrics::Subsystem::Matcher, n * sizeof(T), Alignment));
+        }
+        void* p = GalleryMemory::AllocateLarge(n * sizeof(T));
+        if (p == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        Metrics::CountAllocation(Metrics::Subsystem::Matcher, n * sizeof(T));
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        if (!IsLarge(n))
+        {
+            SdkFree(Metrics::Subsystem::Matcher, p, n * sizeof(T), Alignment);
+            return;
+        }
+        GalleryMemory::FreeLarge(p, n * sizeof(T));
+        Metrics::CountFree(Metrics::Subsystem::Matcher, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept
+    {
+        return false;
+    }
+
+private:
+    // decided by the size only, so deallocate() frees with the allocation's function
+    static bool IsLarge(size_t n) noexcept
+    {
+        return Alignment <= 4096 && n * sizeof(T) >= GalleryMemory::HugePageSize;
+    }
+};
+
+/**
+ * Packed gallery of faceprints for host side 1:N matching.
+ * Structure of arrays - the avg vectors are kept in a single aligned, contiguous matrix (one row per user), while the
+ * user ids, orig vectors and metadata are kept in separate arrays, so a 1:N scan streams only the data it needs.
+ * Avg vector norms (with their reciprocals) and binary sketches are cached per user and refreshed on Add()/Update().
+ * Entries are validated once on insert, IsValidated() tells the scan whether it can skip the per-entry checks.
+ * User ids are hash indexed (see UserIdIndex), so Find() and the updates and removals by id are constant time.
+ * Optionally (SetInterleaved()) the avg vectors are also kept in blocks of InterleaveRows users, feature pair by
+ * feature pair, so the scan computes the dot products of a whole block in one simd pass.
+ */
+class FaceprintsGallery
+{
+public:
+    static constexpr size_t VectorLength = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    static constexpr size_t MaxUserIdLength = sizeof(ExtendedFaceprints::user_id);
+    static constexpr size_t RowAlignment = 64; // cache line
+    static constexpr size_t SignCodeWords = VectorLength / 64; // 1 bit per feature
+    static constexpr size_t InterleaveRows = MatcherKernels::InterleaveRows;
+
+    struct Metadata
+    {
+        int version = 0;
+        int numberOfDescriptors = 0;
+        FaceprintsTypeEnum featuresType = W10;
+        bool is_valid = false; // avg vector passed range validation
+    };
+
+    // entry can be matched: at least one descriptor and a valid avg vector range
+    static bool IsUsable(const Metadata& metadata)
+    {
+        return metadata.numberOfDescriptors >= 1 && metadata.is_valid;
+    }
+
+    // add user to the gallery. returns the index of the new entry.
+    size_t Add(const char* user_id, const Faceprints& faceprints);
+    size_t Add(const ExtendedFaceprints& extended_faceprints);
+
+    // add the records of source in parallel on the pool: reading, validation, norms and sign codes of a chunk of
+    // records run on one thread, straight into the new rows. the ids are then indexed in record order. a record the
+    // source can't read is rejected; if strict, so are records failing validation or with the id of another user
+    // (otherwise they are added as Add() would). the added users keep the records' order from the gallery's previous
+    // size on, each rejected record is appended to errors (if not nullptr). returns the number of added users.
+    size_t AddBulk(const BulkImportSource& source, MatcherThreadPool& pool, bool strict,
+                   std::vector<BulkImportError>* errors = nullptr);
+
+    // replace faceprints of existing entry (e.g. after should_update) in O(1) and refresh its cached norm and sketch.
+    // returns false if index is out of range.
+    bool Update(size_t index, const Faceprints& faceprints);
+
+    // remove entry by moving the last entry into its place (O(1), the last entry's index changes to the given index).
+    // returns false if index is out of range.
+    bool Remove(size_t index);
+
+    // index of the given user id or -1 if not found (the lowest index if the id was added more than once).
+    int Find(const char* user_id) const;
+
+    void Clear();
+    void Reserve(size_t capacity);
+
+    // keep (or drop) the interleaved copy of the avg vectors, used by the scans of the matcher. costs another
+    // VectorLength features per user, the last block is zero padded.
+    void SetInterleaved(bool interleaved);
+
+    bool IsInterleaved() const
+    {
+        return _is_interleaved;
+    }
+
+    size_t Size() const
+    {
+        return _metadata.size();
+    }
+
+    bool Empty() const
+    {
+        return _metadata.empty();
+    }
+
+    // all entries are usable and have the given version (true for an empty gallery).
+    bool IsValidated(int version) const
+    {
+        return _num_unusable == 0 &&
+               (_version_counts.empty() || (_version_counts.size() == 1 && _version_counts.begin()->first == version));
+    }
+
+    // copy the faceprints of the given entry. returns false if index is out of range.
+    bool GetFaceprints(size_t index, Faceprints& faceprints) const;
+
+    const char* UserId(size_t index) const
+    {
+        return _user_ids[index].id;
+    }
+
+    const feature_t* AvgVector(size_t index) const
+    {
+        return &_avg_vectors[index * VectorLength];
+    }
+
+    const feature_t* OrigVector(size_t index) const
+    {
+        return &_orig_vectors[index * VectorLength];
+    }
+
+    const Metadata& GetMetadata(size_t index) const
+    {
+        return _metadata[index];
+    }
+
+    uint32_t AvgNorm(size_t index) const
+    {
+        return _avg_norms[index];
+    }
+
+    short AvgNormMsb(size_t index) const
+    {
+        return _avg_norm_msbs[index];
+    }
+
+    // reciprocal of the avg vector norm for the division free grade.
+    uint64_t AvgNormRecip(size_t index) const
+    {
+        return _avg_norm_recips[index];
+    }
+
+    // binary sketch of the avg vector (bit i is set if feature i is positive), used by the coarse pre-filter.
+    const uint64_t* SignCode(size_t index) const
+    {
+        return &_sign_codes[index * SignCodeWords];
+    }
+
+    // calculate the binary sketch of the given vector into code[SignCodeWords].
+    static void CalculateSignCode(const feature_t* vec, uint64_t* code);
+
+    // raw arrays for the streaming scan (Size() entries each, avg vectors are VectorLength elements per row).
+    const feature_t* AvgVectorsData() const
+    {
+        return _avg_vectors.data();
+    }
+
+    const Metadata* MetadataData() const
+    {
+        return _metadata.data();
+    }
+
+    const uint32_t* AvgNormsData() const
+    {
+        return _avg_norms.data();
+    }
+
+    const short* AvgNormMsbsData() const
+    {
+        return _avg_norm_msbs.data();
+    }
+
+    const uint64_t* AvgNormRecipsData() const
+    {
+        return _avg_norm_recips.data();
+    }
+
+    const uint64_t* SignCodesData() const
+    {
+        return _sign_codes.data();
+    }
+
+    // interleaved avg vectors (see SetInterleaved()), block b (rows b * InterleaveRows onwards) is InterleaveRows *
+    // VectorLength features at b * InterleaveRows * VectorLength. the pairs of features (2i, 2i + 1) of the block's
+    // rows follow each other: row r feature f is at (f / 2) * 2 * InterleaveRows + 2 * r + f % 2.
+    const feature_t* InterleavedData() const
+    {
+        return _interleaved_vectors.data();
+    }
+
+private:
+    struct UserIdEntry
+    {
+        char id[MaxUserIdLength];
+    };
+
+    void SetEntry(size_t index, const Faceprints& faceprints);
+    void SetRow(size_t index, const Faceprints& faceprints); // only touches the row, no counting or interleaving
+    void CopyRow(size_t from, size_t to);                    // only touches the rows, no id indexing or interleaving
+    void Resize(size_t size);                                // new rows are unset
+    void SetInterleavedRow(size_t index);
+    void CountEntry(const Metadata& metadata);
+    void UncountEntry(const Metadata& metadata);
+
+    std::vector<feature_t, AlignedAllocator<feature_t, RowAlignment>> _avg_vectors;
+    std::vector<feature_t> _orig_vectors;
+    std::vector<UserIdEntry> _user_ids;
+    std::vector<Metadata> _metadata;
+    std::vector<uint32_t> _avg_norms;
+    std::vector<short> _avg_norm_msbs;
+    std::vector<uint64_t> _avg_norm_recips;
+    std::vector<uint64_t> _sign_codes;
+    std::vector<feature_t, AlignedAllocator<feature_t, RowAlignment>> _interleaved_vectors;
+    bool _is_interleaved = false;
+    UserIdIndex _user_id_index {MaxUserIdLength};
+
+    // validation invariant, maintained on every change
+    size_t _num_unusable = 0;
+    std::map<int, size_t> _version_counts;
+};
+} // namespace RealSenseID
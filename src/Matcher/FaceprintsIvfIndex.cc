@@ -0,0 +1,541 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsIvfIndex.h"
+#include "MappedFaceprintsGallery.h"
+#include "MatcherThreadPool.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FaceprintsIvfIndex";
+
+// users per task of a bulk add
+static const size_t s_bulkChunkRows = 1024;
+
+static const char s_indexFileMagic[8] = {'R', 'S', 'I', 'D', 'I', 'V', 'F', '\0'};
+
+// section offsets of an index file with the given sizes (header fields other than the offsets are not touched)
+static void LayoutIndexFile(IvfIndexFileHeader& header)
+{
+    const uint64_t centroids_size = header.num_lists * FaceprintsGallery::VectorLength * sizeof(float);
+    header.centroids_offset = MappedFaceprintsGallery::AlignOffset(sizeof(IvfIndexFileHeader));
+    header.entry_lists_offset = MappedFaceprintsGallery::AlignOffset(header.centroids_offset + centroids_size);
+    header.entry_fingerprints_offset =
+        MappedFaceprintsGallery::AlignOffset(header.entry_lists_offset + header.count * sizeof(uint32_t));
+    header.file_size = header.entry_fingerprints_offset + header.count * sizeof(uint64_t);
+}
+
+size_t FaceprintsIvfIndex::Add(const char* user_id, const Faceprints& faceprints)
+{
+    size_t index = _gallery.Add(user_id, faceprints);
+    _entry_lists.push_back(0);
+    _entry_positions.push_back(0);
+    if (IsTrained())
+    {
+        AssignEntry(index);
+    }
+    return index;
+}
+
+size_t FaceprintsIvfIndex::Add(const ExtendedFaceprints& extended_faceprints)
+{
+    return Add(extended_faceprints.user_id, extended_faceprints.faceprints);
+}
+
+size_t FaceprintsIvfIndex::AddBulk(const BulkImportSource& source, MatcherThreadPool& pool, bool strict,
+                                   std::vector<BulkImportError>* errors)
+{
+    const size_t first = _gallery.Size();
+    const size_t added = _gallery.AddBulk(source, pool, strict, errors);
+    _entry_lists.resize(first + added);
+    _entry_positions.resize(first + added);
+    if (!IsTrained())
+    {
+        return added;
+    }
+
+    // closest lists in parallel, the lists are then appended in gallery order
+    pool.Run((added + s_bulkChunkRows - 1) / s_bulkChunkRows, [&](size_t chunk) {
+        float normalized[VectorLength];
+        const size_t end = first + std::min(added, (chunk + 1) * s_bulkChunkRows);
+        for (size_t index = first + chunk * s_bulkChunkRows; index < end; index++)
+        {
+            Normalize(_gallery.AvgVector(index), normalized);
+            _entry_lists[index] = static_cast<uint32_t>(ClosestList(normalized));
+        }
+    });
+    for (size_t index = first; index < first + added; index++)
+    {
+        auto& list = _lists[_entry_lists[index]];
+        _entry_positions[index] = static_cast<uint32_t>(list.size());
+        list.push_back(static_cast<uint32_t>(index));
+    }
+    return added;
+}
+
+bool FaceprintsIvfIndex::Update(size_t index, const Faceprints& faceprints)
+{
+    if (!_gallery.Update(index, faceprints))
+    {
+        return false;
+    }
+    if (IsTrained())
+    {
+        UnassignEntry(index);
+        AssignEntry(index);
+    }
+    return true;
+}
+
+bool FaceprintsIvfIndex::Remove(size_t index)
+{
+    size_t size = _gallery.Size();
+    if (index >= size)
+    {
+        return false;
+    }
+
+    size_t last = size - 1;
+    if (IsTrained())
+    {
+        UnassignEntry(index);
+        // the gallery moves the last entry into the removed entry's place
+        if (index != last)
+        {
+            _lists[_entry_lists[last]][_entry_positions[last]] = static_cast<uint32_t>(index);
+            _entry_lists[index] = _entry_lists[last];
+            _entry_positions[index] = _entry_positions[last];
+        }
+    }
+    _entry_lists.pop_back();
+    _entry_positions.pop_back();
+    return _gallery.Remove(index);
+}
+
+void FaceprintsIvfIndex::Clear()
+{
+    _gallery.Clear();
+    _centroids.clear();
+    _lists.clear();
+    _entry_lists.clear();
+    _entry_positions.clear();
+    _trained_size = 0;
+}
+
+void FaceprintsIvfIndex::Reserve(size_t capacity)
+{
+    _gallery.Reserve(capacity);
+    _entry_lists.reserve(capacity);
+    _entry_positions.reserve(capacity);
+}
+
+void FaceprintsIvfIndex::Train(size_t num_lists, size_t num_iterations)
+{
+    const size_t size = _gallery.Size();
+    num_lists = std::min(num_lists, size);
+
+    _centroids.clear();
+    _lists.clear();
+    _trained_size = 0;
+    if (num_lists == 0)
+    {
+        return;
+    }
+
+    // evenly strided training sample, enough for the centroids without scanning huge galleries on every iteration
+    const size_t num_samples = std::min(size, num_lists * MaxTrainSamplesPerList);
+    std::vector<float> samples(num_samples * VectorLength);
+    for (size_t i = 0; i < num_samples; i++)
+    {
+        Normalize(_gallery.AvgVector(i * size / num_samples), &samples[i * VectorLength]);
+    }
+
+    // initial centroids - evenly strided samples (deterministic)
+    _centroids.resize(num_lists * VectorLength);
+    for (size_t list = 0; list < num_lists; list++)
+    {
+        std::copy_n(&samples[(list * num_samples / num_lists) * VectorLength], VectorLength,
+                    &_centroids[list * VectorLength]);
+    }
+    _lists.resize(num_lists);
+
+    std::vector<uint32_t> sample_lists(num_samples);
+    std::vector<double> sums(num_lists * VectorLength);
+    std::vector<size_t> counts(num_lists);
+    for (size_t iteration = 0; iteration < num_iterations; iteration++)
+    {
+        bool changed = false;
+        for (size_t i = 0; i < num_samples; i++)
+        {
+            auto list = static_cast<uint32_t>(ClosestList(&samples[i * VectorLength]));
+            changed |= (iteration == 0 || list != sample_lists[i]);
+            sample_lists[i] = list;
+        }
+        if (!changed)
+        {
+            break;
+        }
+
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < num_samples; i++)
+        {
+            double* sum = &sums[sample_lists[i] * VectorLength];
+            const float* sample = &samples[i * VectorLength];
+            for (size_t j = 0; j < VectorLength; j++)
+            {
+                sum[j] += sample[j];
+            }
+            counts[sample_lists[i]]++;
+        }
+
+        // spherical k-means - the centroid is the normalized mean direction. empty lists keep their centroid.
+        for (size_t list = 0; list < num_lists; list++)
+        {
+            if (counts[list] == 0)
+            {
+                continue;
+            }
+            const double* sum = &sums[list * VectorLength];
+            double norm = 0;
+            for (size_t j = 0; j < VectorLength; j++)
+            {
+                norm += sum[j] * sum[j];
+            }
+            if (norm <= 0)
+            {
+                continue;
+            }
+            norm = std::sqrt(norm);
+            float* centroid = &_centroids[list * VectorLength];
+            for (size_t j = 0; j < VectorLength; j++)
+            {
+                centroid[j] = static_cast<float>(sum[j] / norm);
+            }
+        }
+    }
+
+    for (size_t index = 0; index < size; index++)
+    {
+        AssignEntry(index);
+    }
+    _trained_size = size;
+    LOG_DEBUG(LOG_TAG, "Trained %zu lists over %zu users (%zu samples)", num_lists, size, num_samples);
+}
+
+bool FaceprintsIvfIndex::Save(const std::string& path, uint32_t generation) const
+{
+    if (!IsTrained())
+    {
+        LOG_ERROR(LOG_TAG, "Index is not trained");
+        return false;
+    }
+
+    const size_t count = _gallery.Size();
+    IvfIndexFileHeader header;
+    ::memset(&header, 0, sizeof(header));
+    ::memcpy(header.magic, s_indexFileMagic, sizeof(header.magic));
+    header.format_version = IvfIndexFileHeader::CurrentFormatVersion;
+    header.byte_order = IvfIndexFileHeader::ByteOrderMark;
+    header.header_size = sizeof(IvfIndexFileHeader);
+    header.vector_length = VectorLength;
+    header.generation = generation;
+    header.count = count;
+    header.num_lists = NumLists();
+    header.trained_size = _trained_size;
+    LayoutIndexFile(header);
+
+    std::vector<uint64_t> fingerprints(count);
+    for (size_t index = 0; index < count; index++)
+    {
+        fingerprints[index] = EntryFingerprint(index);
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to create index file %s", tmp_path.c_str());
+            return false;
+        }
+
+        bool ok = MappedFaceprintsGallery::WriteSection(file, 0, &header, sizeof(header));
+        ok = ok && MappedFaceprintsGallery::WriteSection(file, header.centroids_offset, _centroids.data(),
+                                                         _centroids.size() * sizeof(float));
+        ok = ok && MappedFaceprintsGallery::WriteSection(file, header.entry_lists_offset, _entry_lists.data(),
+                                                         count * sizeof(uint32_t));
+        ok = ok && MappedFaceprintsGallery::WriteSection(file, header.entry_fingerprints_offset, fingerprints.data(),
+                                                         count * sizeof(uint64_t));
+        file.flush();
+        if (!ok || !file.good())
+        {
+            LOG_ERROR(LOG_TAG, "Failed to write index file %s", tmp_path.c_str());
+            file.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    if (!MappedFaceprintsGallery::ReplaceFile(tmp_path, path))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to replace index file %s", path.c_str());
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    LOG_DEBUG(LOG_TAG, "Saved %zu lists over %zu users to %s", NumLists(), count, path.c_str());
+    return true;
+}
+
+static bool ReadIndexHeader(std::ifstream& file, IvfIndexFileHeader& header)
+{
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        return false;
+    }
+    return ::memcmp(header.magic, s_indexFileMagic, sizeof(header.magic)) == 0 &&
+           header.format_version == IvfIndexFileHeader::CurrentFormatVersion &&
+           header.byte_order == IvfIndexFileHeader::ByteOrderMark &&
+           header.header_size == sizeof(IvfIndexFileHeader) &&
+           header.vector_length == FaceprintsGallery::VectorLength;
+}
+
+bool FaceprintsIvfIndex::ReadGeneration(const std::string& path, uint32_t& generation)
+{
+    IvfIndexFileHeader header;
+    std::ifstream file(path, std::ios::binary);
+    if (!ReadIndexHeader(file, header))
+    {
+        return false;
+    }
+    generation = header.generation;
+    return true;
+}
+
+bool FaceprintsIvfIndex::Load(const std::string& path, size_t* num_repaired)
+{
+    _centroids.clear();
+    _lists.clear();
+    _trained_size = 0;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        LOG_DEBUG(LOG_TAG, "No index file %s", path.c_str());
+        return false;
+    }
+
+    IvfIndexFileHeader header;
+    bool ok = ReadIndexHeader(file, header);
+    if (ok)
+    {
+        // the offsets must be the ones Save() writes for these sizes, and the file must hold all the sections
+        IvfIndexFileHeader layout = header;
+        LayoutIndexFile(layout);
+        file.seekg(0, std::ios::end);
+        ok = header.num_lists > 0 && header.num_lists <= header.count &&
+             ::memcmp(&layout, &header, sizeof(header)) == 0 &&
+             static_cast<uint64_t>(file.tellg()) >= header.file_size;
+    }
+    if (!ok)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid index file %s", path.c_str());
+        return false;
+    }
+
+    const size_t count = static_cast<size_t>(header.count);
+    const size_t num_lists = static_cast<size_t>(header.num_lists);
+    std::vector<float> centroids(num_lists * VectorLength);
+    std::vector<uint32_t> entry_lists(count);
+    std::vector<uint64_t> fingerprints(count);
+    file.seekg(static_cast<std::streamoff>(header.centroids_offset));
+    file.read(reinterpret_cast<char*>(centroids.data()),
+              static_cast<std::streamsize>(centroids.size() * sizeof(float)));
+    file.seekg(static_cast<std::streamoff>(header.entry_lists_offset));
+    file.read(reinterpret_cast<char*>(entry_lists.data()), static_cast<std::streamsize>(count * sizeof(uint32_t)));
+    file.seekg(static_cast<std::streamoff>(header.entry_fingerprints_offset));
+    file.read(reinterpret_cast<char*>(fingerprints.data()), static_cast<std::streamsize>(count * sizeof(uint64_t)));
+    if (!file || std::any_of(entry_lists.begin(), entry_lists.end(),
+                             [num_lists](uint32_t list) { return list >= num_lists; }))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid index file %s", path.c_str());
+        return false;
+    }
+
+    // entries are matched by gallery index: unchanged ones go back to their saved list, the others (changed, moved
+    // by removals, or added since the save) are reassigned like Add() does
+    _centroids = std::move(centroids);
+    _lists.resize(num_lists);
+    size_t repaired = 0;
+    for (size_t index = 0; index < _gallery.Size(); index++)
+    {
+        if (index < count && fingerprints[index] == EntryFingerprint(index))
+        {
+            uint32_t list = entry_lists[index];
+            _entry_lists[index] = list;
+            _entry_positions[index] = static_cast<uint32_t>(_lists[list].size());
+            _lists[list].push_back(static_cast<uint32_t>(index));
+        }
+        else
+        {
+            AssignEntry(index);
+            repaired++;
+        }
+    }
+    _trained_size = static_cast<size_t>(header.trained_size);
+    if (num_repaired != nullptr)
+    {
+        *num_repaired = repaired;
+    }
+
+    LOG_DEBUG(LOG_TAG, "Loaded %zu lists over %zu users from %s (generation %u), repaired %zu", num_lists,
+              _gallery.Size(), path.c_str(), header.generation, repaired);
+    return true;
+}
+
+void FaceprintsIvfIndex::GetCandidates(const feature_t* avg_vector, size_t nprobe, std::vector<uint32_t>& rows) const
+{
+    rows.clear();
+    const size_t num_lists = NumLists();
+    nprobe = std::min(nprobe, num_lists);
+    if (nprobe == 0)
+    {
+        return;
+    }
+
+    float normalized[VectorLength];
+    Normalize(avg_vector, normalized);
+
+    // closest lists first, ties to the lower list
+    std::vector<std::pair<float, uint32_t>> ranked(num_lists);
+    for (size_t list = 0; list < num_lists; list++)
+    {
+        ranked[list] = {-CentroidCorrelation(list, normalized), static_cast<uint32_t>(list)};
+    }
+    std::partial_sort(ranked.begin(), ranked.begin() + nprobe, ranked.end());
+
+    size_t num_rows = 0;
+    for (size_t i = 0; i < nprobe; i++)
+    {
+        num_rows += _lists[ranked[i].second].size();
+    }
+    rows.reserve(num_rows);
+    for (size_t i = 0; i < nprobe; i++)
+    {
+        auto& list = _lists[ranked[i].second];
+        rows.insert(rows.end(), list.begin(), list.end());
+    }
+
+    // gallery order, so the exact stage keeps the matcher's first-match semantics
+    std::sort(rows.begin(), rows.end());
+}
+
+void FaceprintsIvfIndex::RankLists(const feature_t* avg_vector, std::vector<uint32_t>& lists) const
+{
+    lists.clear();
+    const size_t num_lists = NumLists();
+    if (num_lists == 0)
+    {
+        return;
+    }
+
+    float normalized[VectorLength];
+    Normalize(avg_vector, normalized);
+
+    std::vector<std::pair<float, uint32_t>> ranked(num_lists);
+    for (size_t list = 0; list < num_lists; list++)
+    {
+        ranked[list] = {-CentroidCorrelation(list, normalized), static_cast<uint32_t>(list)};
+    }
+    std::sort(ranked.begin(), ranked.end());
+    lists.reserve(num_lists);
+    for (auto& entry : ranked)
+    {
+        lists.push_back(entry.second);
+    }
+}
+
+void FaceprintsIvfIndex::Normalize(const feature_t* vec, float* normalized)
+{
+    double norm = 0;
+    for (size_t j = 0; j < VectorLength; j++)
+    {
+        norm += static_cast<double>(vec[j]) * vec[j];
+    }
+    const float scale = norm > 0 ? static_cast<float>(1.0 / std::sqrt(norm)) : 0.0f;
+    for (size_t j = 0; j < VectorLength; j++)
+    {
+        normalized[j] = vec[j] * scale;
+    }
+}
+
+float FaceprintsIvfIndex::CentroidCorrelation(size_t list, const float* normalized) const
+{
+    const float* centroid = &_centroids[list * VectorLength];
+    float corr = 0;
+    for (size_t j = 0; j < VectorLength; j++)
+    {
+        corr += centroid[j] * normalized[j];
+    }
+    return corr;
+}
+
+size_t FaceprintsIvfIndex::ClosestList(const float* normalized) const
+{
+    size_t best_list = 0;
+    float best_corr = CentroidCorrelation(0, normalized);
+    for (size_t list = 1; list < NumLists(); list++)
+    {
+        float corr = CentroidCorrelation(list, normalized);
+        if (corr > best_corr)
+        {
+            best_corr = corr;
+            best_list = list;
+        }
+    }
+    return best_list;
+}
+
+void FaceprintsIvfIndex::AssignEntry(size_t index)
+{
+    float normalized[VectorLength];
+    Normalize(_gallery.AvgVector(index), normalized);
+    size_t list = ClosestList(normalized);
+    _entry_lists[index] = static_cast<uint32_t>(list);
+    _entry_positions[index] = static_cast<uint32_t>(_lists[list].size());
+    _lists[list].push_back(static_cast<uint32_t>(index));
+}
+
+uint64_t FaceprintsIvfIndex::EntryFingerprint(size_t index) const
+{
+    // FNV-1a over the avg vector's 64 bit words
+    static_assert(VectorLength * sizeof(feature_t) % sizeof(uint64_t) == 0, "avg vector is not whole words");
+    const feature_t* vec = _gallery.AvgVector(index);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t offset = 0; offset < VectorLength * sizeof(feature_t); offset += sizeof(uint64_t))
+    {
+        uint64_t word;
+        ::memcpy(&word, reinterpret_cast<const char*>(vec) + offset, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void FaceprintsIvfIndex::UnassignEntry(size_t index)
+{
+    auto& list = _lists[_entry_lists[index]];
+    uint32_t position = _entry_positions[index];
+    uint32_t moved = list.back();
+    list[position] = moved;
+    _entry_positions[moved] = position;
+    list.pop_back();
+}
+} // namespace RealSenseID
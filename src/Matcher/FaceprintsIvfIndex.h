@@ -0,0 +1,146 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * On-disk ivf index, stored alongside the gallery file (<gallery path>.ivf) so a restart restores the trained lists
+ * instead of rerunning k-means. Each entry keeps its list and a hash of its avg vector, so the entries that changed
+ * since the save (or moved to another gallery index) are told apart and repaired. Sections start at RowAlignment
+ * boundaries.
+ *
+ *   header | centroids | entry lists | entry fingerprints
+ */
+struct IvfIndexFileHeader
+{
+    static constexpr uint32_t CurrentFormatVersion = 1;
+    static constexpr uint32_t ByteOrderMark = 0x01020304;
+
+    char magic[8];           // "RSIDIVF"
+    uint32_t format_version; // CurrentFormatVersion
+    uint32_t byte_order;     // ByteOrderMark as written by the host
+    uint32_t header_size;    // sizeof(IvfIndexFileHeader)
+    uint32_t vector_length;  // FaceprintsGallery::VectorLength
+    uint32_t generation;     // generation of the gallery file the entries were saved with
+    uint32_t reserved;
+    uint64_t count;          // number of entries
+    uint64_t num_lists;
+    uint64_t trained_size;   // gallery size when the centroids were trained
+    uint64_t centroids_offset;
+    uint64_t entry_lists_offset;
+    uint64_t entry_fingerprints_offset;
+    uint64_t file_size;
+};
+
+/**
+ * Inverted file (IVF) index over a packed faceprints gallery for approximate 1:N matching of very large galleries.
+ * The avg vectors are clustered with spherical k-means (the matcher's normalized correlation) into lists. A search
+ * visits only the users of the nprobe lists whose centroids are closest to the query, and the exact matcher verifies
+ * them, so nprobe trades recall for latency.
+ * The index owns its gallery, so inserts and removals keep the lists in sync with the gallery indices.
+ */
+class FaceprintsIvfIndex
+{
+public:
+    static constexpr size_t VectorLength = FaceprintsGallery::VectorLength;
+    static constexpr size_t DefaultTrainIterations = 10;
+    static constexpr size_t MaxTrainSamplesPerList = 256;
+
+    // add user to the gallery and to the closest list (if trained). returns the gallery index of the new entry.
+    size_t Add(const char* user_id, const Faceprints& faceprints);
+    size_t Add(const ExtendedFaceprints& extended_faceprints);
+
+    // add the records of source (see FaceprintsGallery::AddBulk()), the closest lists of the added users (if trained)
+    // are found in parallel as well. returns the number of added users.
+    size_t AddBulk(const BulkImportSource& source, MatcherThreadPool& pool, bool strict,
+                   std::vector<BulkImportError>* errors = nullptr);
+
+    // replace faceprints of existing entry and move it to its closest list. returns false if index is out of range.
+    bool Update(size_t index, const Faceprints& faceprints);
+
+    // remove entry, same index semantics as FaceprintsGallery::Remove(). returns false if index is out of range.
+    bool Remove(size_t index);
+
+    // remove all users and the trained centroids.
+    void Clear();
+    void Reserve(size_t capacity);
+
+    // cluster the current users into num_lists lists (clamped to the gallery size) and reassign all users.
+    // users added later are assigned to the closest existing centroid, so retrain after large changes.
+    void Train(size_t num_lists, size_t num_iterations = DefaultTrainIterations);
+
+    // write the trained centroids and the list of every entry to the given path (via a temporary file, as
+    // MappedFaceprintsGallery::Save()), tagged with the generation of the gallery file. returns false on failure or
+    // if not trained.
+    bool Save(const std::string& path, uint32_t generation = 0) const;
+
+    // restore the lists saved by Save() for the current gallery, instead of Train(). entries that changed since the
+    // save or were added after it are reassigned to their closest list, their number is written to num_repaired.
+    // returns false (leaving the index untrained) if the file is missing, invalid or was written with another layout.
+    bool Load(const std::string& path, size_t* num_repaired = nullptr);
+
+    // generation in the header of the given index file. returns false if the file is missing or is not an index file.
+    static bool ReadGeneration(const std::string& path, uint32_t& generation);
+
+    // gallery size when the centroids were trained (restored by Load()), 0 if not trained
+    size_t TrainedSize() const
+    {
+        return _trained_size;
+    }
+
+    bool IsTrained() const
+    {
+        return !_lists.empty();
+    }
+
+    size_t NumLists() const
+    {
+        return _lists.size();
+    }
+
+    size_t ListSize(size_t list) const
+    {
+        return _lists[list].size();
+    }
+
+    const FaceprintsGallery& Gallery() const
+    {
+        return _gallery;
+    }
+
+    // gallery indices of the users in the nprobe lists closest to the given avg vector, in ascending order.
+    void GetCandidates(const feature_t* avg_vector, size_t nprobe, std::vector<uint32_t>& rows) const;
+
+    // all the lists, closest to the given avg vector first (ties to the lower list)
+    void RankLists(const feature_t* avg_vector, std::vector<uint32_t>& lists) const;
+
+    // gallery indices of the users in the list
+    const std::vector<uint32_t>& ListRows(size_t list) const
+    {
+        return _lists[list];
+    }
+
+private:
+    static void Normalize(const feature_t* vec, float* normalized);
+    float CentroidCorrelation(size_t list, const float* normalized) const;
+    size_t ClosestList(const float* normalized) const;
+    void AssignEntry(size_t index);
+    void UnassignEntry(size_t index);
+    uint64_t EntryFingerprint(size_t index) const;
+
+    FaceprintsGallery _gallery;
+    std::vector<float> _centroids;              // NumLists() rows of VectorLength, unit norm
+    std::vector<std::vector<uint32_t>> _lists;  // gallery indices per list
+    std::vector<uint32_t> _entry_lists;         // list of each gallery entry
+    std::vector<uint32_t> _entry_positions;     // position of each gallery entry in its list
+    size_t _trained_size = 0;
+};
+} // namespace RealSenseID
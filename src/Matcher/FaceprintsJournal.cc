@@ -0,0 +1,203 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsJournal.h"
+#include "Logger.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif // _WIN32
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FaceprintsJournal";
+
+static const uint32_t s_journalRecordMagic = 0x4C4A4452; // "RDJL"
+
+// on-disk record, fixed size
+struct JournalRecord
+{
+    uint32_t magic;
+    uint32_t operation;
+    uint32_t checksum; // fnv-1a of the record with checksum = 0
+    uint32_t reserved;
+    char user_id[32];
+    int32_t version;
+    int32_t numberOfDescriptors;
+    uint32_t featuresType;
+    uint32_t reserved2;
+    feature_t avgDescriptor[FaceprintsGallery::VectorLength];
+    feature_t origDescriptor[FaceprintsGallery::VectorLength];
+};
+
+static_assert(sizeof(JournalRecord::user_id) >= FaceprintsGallery::MaxUserIdLength, "Journal user id too short");
+
+static uint32_t Checksum(const JournalRecord& record)
+{
+    JournalRecord copy = record;
+    copy.checksum = 0;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&copy);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(copy); i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool IsValidOperation(uint32_t operation)
+{
+    return operation >= static_cast<uint32_t>(FaceprintsJournal::Operation::Enroll) &&
+           operation <= static_cast<uint32_t>(FaceprintsJournal::Operation::Remove);
+}
+
+static bool TruncateFile(const std::string& path, size_t size)
+{
+#ifdef _WIN32
+    int fd = -1;
+    if (::_sopen_s(&fd, path.c_str(), _O_RDWR | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE) != 0)
+    {
+        return false;
+    }
+    bool ok = ::_chsize_s(fd, static_cast<__int64>(size)) == 0;
+    ::_close(fd);
+    return ok;
+#else
+    return ::truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+#endif // _WIN32
+}
+
+FaceprintsJournal::~FaceprintsJournal()
+{
+    Close();
+}
+
+bool FaceprintsJournal::Open(const std::string& path, const std::function<void(const Record&)>& apply)
+{
+    Close();
+    _path = path;
+    _num_records = 0;
+
+    // replay existing records, stop at the first torn or corrupted one
+    bool has_invalid_tail = false;
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (file)
+        {
+            JournalRecord disk_record;
+            Record record;
+            while (file.read(reinterpret_cast<char*>(&disk_record), sizeof(disk_record)))
+            {
+                if (disk_record.magic != s_journalRecordMagic || !IsValidOperation(disk_record.operation) ||
+                    disk_record.checksum != Checksum(disk_record))
+                {
+                    has_invalid_tail = true;
+                    break;
+                }
+
+                record.operation = static_cast<Operation>(disk_record.operation);
+                ::memcpy(record.user_id, disk_record.user_id, sizeof(record.user_id));
+                record.user_id[sizeof(record.user_id) - 1] = '\0';
+                record.faceprints.version = disk_record.version;
+                record.faceprints.numberOfDescriptors = disk_record.numberOfDescriptors;
+                record.faceprints.featuresType = static_cast<FaceprintsTypeEnum>(disk_record.featuresType);
+                ::memcpy(record.faceprints.avgDescriptor, disk_record.avgDescriptor,
+                         sizeof(disk_record.avgDescriptor));
+                ::memcpy(record.faceprints.origDescriptor, disk_record.origDescriptor,
+                         sizeof(disk_record.origDescriptor));
+                apply(record);
+                _num_records++;
+            }
+            has_invalid_tail = has_invalid_tail || file.gcount() != 0;
+        }
+    }
+
+    if (has_invalid_tail)
+    {
+        LOG_ERROR(LOG_TAG, "Dropping invalid journal tail after %zu records", _num_records);
+        if (!TruncateFile(path, _num_records * sizeof(JournalRecord)))
+        {
+            LOG_ERROR(LOG_TAG, "Failed to truncate journal %s", path.c_str());
+            return false;
+        }
+    }
+
+    return OpenForAppend();
+}
+
+void FaceprintsJournal::Close()
+{
+    if (_file.is_open())
+    {
+        _file.close();
+    }
+}
+
+bool FaceprintsJournal::Append(Operation operation, const char* user_id, const Faceprints* faceprints)
+{
+    if (!_file.is_open())
+    {
+        LOG_ERROR(LOG_TAG, "Journal is not open");
+        return false;
+    }
+
+    JournalRecord disk_record;
+    ::memset(&disk_record, 0, sizeof(disk_record));
+    disk_record.magic = s_journalRecordMagic;
+    disk_record.operation = static_cast<uint32_t>(operation);
+    if (user_id != nullptr)
+    {
+        ::strncpy(disk_record.user_id, user_id, FaceprintsGallery::MaxUserIdLength - 1);
+    }
+    if (faceprints != nullptr && operation != Operation::Remove)
+    {
+        disk_record.version = faceprints->version;
+        disk_record.numberOfDescriptors = faceprints->numberOfDescriptors;
+        disk_record.featuresType = static_cast<uint32_t>(faceprints->featuresType);
+        ::memcpy(disk_record.avgDescriptor, faceprints->avgDescriptor, sizeof(disk_record.avgDescriptor));
+        ::memcpy(disk_record.origDescriptor, faceprints->origDescriptor, sizeof(disk_record.origDescriptor));
+    }
+    disk_record.checksum = Checksum(disk_record);
+
+    _file.write(reinterpret_cast<const char*>(&disk_record), sizeof(disk_record));
+    _file.flush();
+    if (!_file.good())
+    {
+        LOG_ERROR(LOG_TAG, "Failed to append to journal %s", _path.c_str());
+        return false;
+    }
+    _num_records++;
+    return true;
+}
+
+bool FaceprintsJournal::Reset()
+{
+    Close();
+    {
+        std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to reset journal %s", _path.c_str());
+            return false;
+        }
+    }
+    _num_records = 0;
+    return OpenForAppend();
+}
+
+bool FaceprintsJournal::OpenForAppend()
+{
+    _file.open(_path, std::ios::binary | std::ios::app);
+    if (!_file)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to open journal %s", _path.c_str());
+        return false;
+    }
+    return true;
+}
+} // namespace RealSenseID
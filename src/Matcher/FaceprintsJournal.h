@@ -0,0 +1,67 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include "RealSenseID/Faceprints.h"
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <stdint.h>
+#include <string>
+
+namespace RealSenseID
+{
+/**
+ * Append-only journal of gallery changes (enroll/update/remove) on top of a gallery file.
+ * Records are fixed size and checksummed, a record torn by a crash during append is dropped when the journal is
+ * opened again.
+ */
+class FaceprintsJournal
+{
+public:
+    enum class Operation : uint32_t
+    {
+        Enroll = 1,
+        Update = 2,
+        Remove = 3
+    };
+
+    struct Record
+    {
+        Operation operation = Operation::Enroll;
+        char user_id[FaceprintsGallery::MaxUserIdLength] = {0};
+        Faceprints faceprints; // unused for Operation::Remove
+    };
+
+    FaceprintsJournal() = default;
+    ~FaceprintsJournal();
+
+    FaceprintsJournal(const FaceprintsJournal&) = delete;
+    FaceprintsJournal& operator=(const FaceprintsJournal&) = delete;
+
+    // open (or create) the journal, call apply() for each valid record in order and prepare for appends.
+    // returns false if the journal could not be opened.
+    bool Open(const std::string& path, const std::function<void(const Record&)>& apply);
+    void Close();
+
+    // append and flush a record. faceprints is ignored for Operation::Remove. returns false on write failure.
+    bool Append(Operation operation, const char* user_id, const Faceprints* faceprints);
+
+    // drop all records (after the gallery file was compacted).
+    bool Reset();
+
+    size_t NumRecords() const
+    {
+        return _num_records;
+    }
+
+private:
+    bool OpenForAppend();
+
+    std::string _path;
+    std::ofstream _file;
+    size_t _num_records = 0;
+};
+} // namespace RealSenseID
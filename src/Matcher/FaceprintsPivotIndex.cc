@@ -0,0 +1,390 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsPivotIndex.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FaceprintsPivotIndex";
+
+size_t FaceprintsPivotIndex::Add(const char* user_id, const Faceprints& faceprints)
+{
+    size_t index = _gallery.Add(user_id, faceprints);
+    _positions.push_back(0);
+    if (IsBuilt())
+    {
+        AssignEntry(index);
+    }
+    return index;
+}
+
+size_t FaceprintsPivotIndex::Add(const ExtendedFaceprints& extended_faceprints)
+{
+    return Add(extended_faceprints.user_id, extended_faceprints.faceprints);
+}
+
+bool FaceprintsPivotIndex::Update(size_t index, const Faceprints& faceprints)
+{
+    if (!_gallery.Update(index, faceprints))
+    {
+        return false;
+    }
+    // the entry stays in its block, the bounds only grow
+    if (IsBuilt() && _positions[index] < _blocked_size)
+    {
+        Query projected;
+        Project(_gallery.AvgVector(index), projected);
+        WidenBlock(_positions[index] / BlockSize, projected);
+    }
+    return true;
+}
+
+bool FaceprintsPivotIndex::Remove(size_t index)
+{
+    size_t size = _gallery.Size();
+    if (index >= size)
+    {
+        return false;
+    }
+
+    size_t last = size - 1;
+    if (IsBuilt())
+    {
+        UnassignEntry(index);
+        // the gallery moves the last entry into the removed entry's place
+        if (index != last)
+        {
+            _order[_positions[last]] = static_cast<uint32_t>(index);
+            _positions[index] = _positions[last];
+        }
+    }
+    _positions.pop_back();
+    return _gallery.Remove(index);
+}
+
+void FaceprintsPivotIndex::Clear()
+{
+    _gallery.Clear();
+    _pivots.clear();
+    _order.clear();
+    _positions.clear();
+    _blocked_size = 0;
+    _block_mins.clear();
+    _block_maxs.clear();
+    _block_residuals.clear();
+    _block_centers.clear();
+    _block_radii.clear();
+}
+
+void FaceprintsPivotIndex::Reserve(size_t capacity)
+{
+    _gallery.Reserve(capacity);
+    _positions.reserve(capacity);
+}
+
+void FaceprintsPivotIndex::Build(size_t num_iterations)
+{
+    const size_t size = _gallery.Size();
+    _pivots.clear();
+    _order.clear();
+    _blocked_size = 0;
+    _block_mins.clear();
+    _block_maxs.clear();
+    _block_residuals.clear();
+    _block_centers.clear();
+    _block_radii.clear();
+    if (size == 0)
+    {
+        return;
+    }
+
+    // second moment of an evenly strided sample of the normalized vectors. its leading eigenvectors are the
+    // directions that spread the users the most, so the blocks get narrow projection ranges.
+    const size_t num_samples = std::min(size, MaxBuildSamples);
+    std::vector<double> moment(VectorLength * VectorLength, 0.0);
+    float normalized[VectorLength];
+    for (size_t i = 0; i < num_samples; i++)
+    {
+        Normalize(_gallery.AvgVector(i * size / num_samples), normalized);
+        for (size_t r = 0; r < VectorLength; r++)
+        {
+            double* row = &moment[r * VectorLength];
+            const double value = normalized[r];
+            for (size_t c = 0; c < VectorLength; c++)
+            {
+                row[c] += value * normalized[c];
+            }
+        }
+    }
+
+    // power iteration, each pivot kept orthogonal to the previous ones (deterministic start vectors)
+    _pivots.resize(NumPivots * VectorLength);
+    std::vector<double> pivot(VectorLength), next(VectorLength);
+    for (size_t k = 0; k < NumPivots; k++)
+    {
+        for (size_t j = 0; j < VectorLength; j++)
+        {
+            pivot[j] = 1.0 + static_cast<double>((j * (k + 1)) % 7);
+        }
+        for (size_t iteration = 0; iteration <= num_iterations; iteration++)
+        {
+            for (size_t prev = 0; prev < k; prev++)
+            {
+                const float* prev_pivot = &_pivots[prev * VectorLength];
+                double dot = 0;
+                for (size_t j = 0; j < VectorLength; j++)
+                {
+                    dot += pivot[j] * prev_pivot[j];
+                }
+                for (size_t j = 0; j < VectorLength; j++)
+                {
+                    pivot[j] -= dot * prev_pivot[j];
+                }
+            }
+            double norm = 0;
+            for (size_t j = 0; j < VectorLength; j++)
+            {
+                norm += pivot[j] * pivot[j];
+            }
+            norm = std::sqrt(norm);
+            if (norm <= 0)
+            {
+                // the sample spans fewer directions - any unit vector orthogonal to the previous pivots is fine
+                std::fill(pivot.begin(), pivot.end(), 0.0);
+                pivot[k] = 1.0;
+                continue;
+            }
+            for (size_t j = 0; j < VectorLength; j++)
+            {
+                pivot[j] /= norm;
+            }
+            if (iteration == num_iterations)
+            {
+                break;
+            }
+            for (size_t r = 0; r < VectorLength; r++)
+            {
+                const double* row = &moment[r * VectorLength];
+                double sum = 0;
+                for (size_t c = 0; c < VectorLength; c++)
+                {
+                    sum += row[c] * pivot[c];
+                }
+                next[r] = sum;
+            }
+            pivot.swap(next);
+        }
+        for (size_t j = 0; j < VectorLength; j++)
+        {
+            _pivots[k * VectorLength + j] = static_cast<float>(pivot[j]);
+        }
+    }
+
+    // order all users into blocks and take the bounds of each block
+    std::vector<float> projections(size * NumPivots);
+    Query projected;
+    for (size_t index = 0; index < size; index++)
+    {
+        Project(_gallery.AvgVector(index), projected);
+        std::copy_n(projected.projections, NumPivots, &projections[index * NumPivots]);
+    }
+    _order.resize(size);
+    for (size_t index = 0; index < size; index++)
+    {
+        _order[index] = static_cast<uint32_t>(index);
+    }
+    OrderBlocks(projections, 0, size);
+    _blocked_size = size;
+
+    const size_t num_blocks = (size + BlockSize - 1) / BlockSize;
+    _block_mins.assign(num_blocks * NumPivots, 1.0f);
+    _block_maxs.assign(num_blocks * NumPivots, -1.0f);
+    _block_residuals.assign(num_blocks, 0.0f);
+    _block_centers.assign(num_blocks * VectorLength, 0.0f);
+    _block_radii.assign(num_blocks, 1.0f);
+    std::vector<double> center(VectorLength);
+    for (size_t block = 0; block < num_blocks; block++)
+    {
+        // mean direction of the block
+        size_t count = 0;
+        const uint32_t* rows = BlockRows(block, count);
+        std::fill(center.begin(), center.end(), 0.0);
+        for (size_t i = 0; i < count; i++)
+        {
+            Normalize(_gallery.AvgVector(rows[i]), projected.normalized);
+            for (size_t j = 0; j < VectorLength; j++)
+            {
+                center[j] += projected.normalized[j];
+            }
+        }
+        double norm = 0;
+        for (size_t j = 0; j < VectorLength; j++)
+        {
+            norm += center[j] * center[j];
+        }
+        // no mean direction (e.g. only zero vectors) - a zero center gives a bound of 1
+        norm = norm > 0 ? std::sqrt(norm) : 1.0;
+        float* block_center = &_block_centers[block * VectorLength];
+        for (size_t j = 0; j < VectorLength; j++)
+        {
+            block_center[j] = static_cast<float>(center[j] / norm);
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            _positions[rows[i]] = static_cast<uint32_t>(block * BlockSize + i);
+            Project(_gallery.AvgVector(rows[i]), projected);
+            WidenBlock(block, projected);
+        }
+    }
+    LOG_DEBUG(LOG_TAG, "Built %zu blocks over %zu users (%zu samples)", num_blocks, size, num_samples);
+}
+
+const uint32_t* FaceprintsPivotIndex::BlockRows(size_t block, size_t& count) const
+{
+    const size_t begin = block * BlockSize;
+    count = std::min(BlockSize, _blocked_size - begin);
+    return _order.data() + begin;
+}
+
+const uint32_t* FaceprintsPivotIndex::TailRows(size_t& count) const
+{
+    count = _order.size() - _blocked_size;
+    return _order.data() + _blocked_size;
+}
+
+void FaceprintsPivotIndex::Project(const feature_t* avg_vector, Query& query) const
+{
+    Normalize(avg_vector, query.normalized);
+    float projected = 0;
+    for (size_t k = 0; k < NumPivots; k++)
+    {
+        const float dot = Dot(&_pivots[k * VectorLength], query.normalized);
+        query.projections[k] = dot;
+        projected += dot * dot;
+    }
+    // a zero vector (norm 0) gets residual 1, a looser bound than needed but never too tight
+    query.residual = std::sqrt(std::max(1.0f - projected, 0.0f));
+}
+
+float FaceprintsPivotIndex::BlockBound(size_t block, const Query& query) const
+{
+    // projections and residuals
+    const float* mins = &_block_mins[block * NumPivots];
+    const float* maxs = &_block_maxs[block * NumPivots];
+    float projected_bound = query.residual * _block_residuals[block];
+    for (size_t k = 0; k < NumPivots; k++)
+    {
+        projected_bound += std::max(query.projections[k] * mins[k], query.projections[k] * maxs[k]);
+    }
+
+    // angle to the center minus the radius: cos(a - r) = cos(a)cos(r) + sin(a)sin(r), 1 if the query is inside
+    const float* center = &_block_centers[block * VectorLength];
+    const float center_corr = std::min(std::max(Dot(center, query.normalized), -1.0f), 1.0f);
+    const float radius_corr = _block_radii[block];
+    float center_bound = 1.0f;
+    if (center_corr < radius_corr)
+    {
+        center_bound = center_corr * radius_corr + std::sqrt((1.0f - center_corr * center_corr) *
+                                                             (1.0f - radius_corr * radius_corr));
+    }
+    return std::min(projected_bound, center_bound);
+}
+
+void FaceprintsPivotIndex::Normalize(const feature_t* vec, float* normalized)
+{
+    double norm = 0;
+    for (size_t j = 0; j < VectorLength; j++)
+    {
+        norm += static_cast<double>(vec[j]) * vec[j];
+    }
+    const float scale = norm > 0 ? static_cast<float>(1.0 / std::sqrt(norm)) : 0.0f;
+    for (size_t j = 0; j < VectorLength; j++)
+    {
+        normalized[j] = vec[j] * scale;
+    }
+}
+
+float FaceprintsPivotIndex::Dot(const float* a, const float* b)
+{
+    float dot = 0;
+    for (size_t j = 0; j < VectorLength; j++)
+    {
+        dot += a[j] * b[j];
+    }
+    return dot;
+}
+
+void FaceprintsPivotIndex::OrderBlocks(const std::vector<float>& projections, size_t begin, size_t end)
+{
+    if (end - begin <= BlockSize)
+    {
+        return;
+    }
+
+    // split on the pivot with the widest range, at a block boundary near the median (kd-tree order)
+    size_t split_pivot = 0;
+    float widest = -1.0f;
+    for (size_t k = 0; k < NumPivots; k++)
+    {
+        float min_value = 1.0f, max_value = -1.0f;
+        for (size_t position = begin; position < end; position++)
+        {
+            const float value = projections[_order[position] * NumPivots + k];
+            min_value = std::min(min_value, value);
+            max_value = std::max(max_value, value);
+        }
+        if (max_value - min_value > widest)
+        {
+            widest = max_value - min_value;
+            split_pivot = k;
+        }
+    }
+
+    const size_t num_blocks = (end - begin + BlockSize - 1) / BlockSize;
+    const size_t middle = begin + (num_blocks / 2) * BlockSize;
+    std::nth_element(_order.begin() + begin, _order.begin() + middle, _order.begin() + end,
+                     [&](uint32_t a, uint32_t b) {
+                         return projections[a * NumPivots + split_pivot] < projections[b * NumPivots + split_pivot];
+                     });
+    OrderBlocks(projections, begin, middle);
+    OrderBlocks(projections, middle, end);
+}
+
+void FaceprintsPivotIndex::WidenBlock(size_t block, const Query& projected)
+{
+    float* mins = &_block_mins[block * NumPivots];
+    float* maxs = &_block_maxs[block * NumPivots];
+    for (size_t k = 0; k < NumPivots; k++)
+    {
+        mins[k] = std::min(mins[k], projected.projections[k]);
+        maxs[k] = std::max(maxs[k], projected.projections[k]);
+    }
+    _block_residuals[block] = std::max(_block_residuals[block], projected.residual);
+    const float* center = &_block_centers[block * VectorLength];
+    _block_radii[block] = std::min(_block_radii[block], Dot(center, projected.normalized));
+}
+
+void FaceprintsPivotIndex::AssignEntry(size_t index)
+{
+    _positions[index] = static_cast<uint32_t>(_order.size());
+    _order.push_back(static_cast<uint32_t>(index));
+}
+
+void FaceprintsPivotIndex::UnassignEntry(size_t index)
+{
+    const uint32_t position = _positions[index];
+    if (position < _blocked_size)
+    {
+        _order[position] = InvalidRow;
+        return;
+    }
+    const uint32_t moved = _order.back();
+    _order[position] = moved;
+    _positions[moved] = position;
+    _order.pop_back();
+}
+} // namespace RealSenseID
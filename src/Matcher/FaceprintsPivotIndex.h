@@ -0,0 +1,107 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Pivot index over a packed faceprints gallery for exact 1:N matching with pruning.
+ * The normalized avg vectors are projected onto NumPivots orthonormal pivots (the principal directions of the
+ * gallery) and the users are ordered into blocks of close projections. For unit vectors q and x with projections a
+ * and t and residual norms |q'| and |x'| (the part outside the pivots), Cauchy-Schwarz gives
+ *   q.x = a.t + q'.x' <= a.t + |q'||x'|
+ * so each block keeps the range of its projections and its largest residual. Each block also keeps its mean direction
+ * c and the smallest correlation of its users with it, cos(r), so q.x <= cos(max(angle(q, c) - r, 0)) as well.
+ * A search skips the blocks whose bound cannot beat the threshold or the best score found so far. The result is the
+ * same as the full scan.
+ * The index owns its gallery, so inserts and removals keep the blocks in sync with the gallery indices.
+ */
+class FaceprintsPivotIndex
+{
+public:
+    static constexpr size_t VectorLength = FaceprintsGallery::VectorLength;
+    static constexpr size_t NumPivots = 8;
+    static constexpr size_t BlockSize = 64;
+    static constexpr size_t MaxBuildSamples = 4096;
+    static constexpr size_t DefaultBuildIterations = 30;
+    static constexpr uint32_t InvalidRow = UINT32_MAX; // removed entry in a block
+
+    // normalized query with its projections (see Project())
+    struct Query
+    {
+        float normalized[VectorLength];
+        float projections[NumPivots];
+        float residual;
+    };
+
+    // add user to the gallery (and to the unblocked tail if built). returns the gallery index of the new entry.
+    size_t Add(const char* user_id, const Faceprints& faceprints);
+    size_t Add(const ExtendedFaceprints& extended_faceprints);
+
+    // replace faceprints of existing entry, widening the bounds of its block. returns false if index is out of range.
+    bool Update(size_t index, const Faceprints& faceprints);
+
+    // remove entry, same index semantics as FaceprintsGallery::Remove(). returns false if index is out of range.
+    bool Remove(size_t index);
+
+    // remove all users and the pivots.
+    void Clear();
+    void Reserve(size_t capacity);
+
+    // find the pivots of the current users and order all users into blocks.
+    // users added later go to an unblocked tail that every search scans, so rebuild after large changes.
+    void Build(size_t num_iterations = DefaultBuildIterations);
+
+    bool IsBuilt() const
+    {
+        return !_pivots.empty();
+    }
+
+    size_t NumBlocks() const
+    {
+        return _block_residuals.size();
+    }
+
+    const FaceprintsGallery& Gallery() const
+    {
+        return _gallery;
+    }
+
+    // gallery indices of the block (InvalidRow for removed entries).
+    const uint32_t* BlockRows(size_t block, size_t& count) const;
+
+    // gallery indices of the users added after Build().
+    const uint32_t* TailRows(size_t& count) const;
+
+    // normalize the avg vector and calculate its projections and residual norm.
+    void Project(const feature_t* avg_vector, Query& query) const;
+
+    // upper bound of the normalized correlation of the query with any user of the block.
+    float BlockBound(size_t block, const Query& query) const;
+
+private:
+    static void Normalize(const feature_t* vec, float* normalized);
+    static float Dot(const float* a, const float* b);
+    void OrderBlocks(const std::vector<float>& projections, size_t begin, size_t end);
+    void WidenBlock(size_t block, const Query& projected);
+    void AssignEntry(size_t index);
+    void UnassignEntry(size_t index);
+
+    FaceprintsGallery _gallery;
+    std::vector<float> _pivots;           // NumPivots rows of VectorLength, orthonormal
+    std::vector<uint32_t> _order;         // gallery indices, blocks first then the tail
+    std::vector<uint32_t> _positions;     // position of each gallery entry in _order
+    size_t _blocked_size = 0;             // entries of _order in blocks
+    std::vector<float> _block_mins;       // NumBlocks() rows of NumPivots
+    std::vector<float> _block_maxs;       // NumBlocks() rows of NumPivots
+    std::vector<float> _block_residuals;  // largest residual norm per block
+    std::vector<float> _block_centers;    // NumBlocks() rows of VectorLength, unit norm
+    std::vector<float> _block_radii;      // smallest correlation of a user with its block center
+};
+} // namespace RealSenseID
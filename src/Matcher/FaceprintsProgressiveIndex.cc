@@ -0,0 +1,184 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsProgressiveIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace RealSenseID
+{
+// squared norms of the dimensions from each block on (0 - the whole vector)
+static void SuffixNorms(const feature_t* features, uint64_t (&norms)[FaceprintsProgressiveIndex::NumBlocks])
+{
+    uint64_t sum = 0;
+    for (size_t block = FaceprintsProgressiveIndex::NumBlocks; block-- > 0;)
+    {
+        const feature_t* block_features = features + block * FaceprintsProgressiveIndex::BlockLength;
+        for (size_t i = 0; i < FaceprintsProgressiveIndex::BlockLength; i++)
+        {
+            sum += static_cast<uint64_t>(static_cast<int64_t>(block_features[i]) * block_features[i]);
+        }
+        norms[block] = sum;
+    }
+}
+
+FaceprintsProgressiveIndex::FaceprintsProgressiveIndex() : _order(VectorLength)
+{
+    std::iota(_order.begin(), _order.end(), static_cast<uint16_t>(0));
+}
+
+size_t FaceprintsProgressiveIndex::Add(const char* user_id, const Faceprints& faceprints)
+{
+    size_t index = _gallery.Add(user_id, faceprints);
+    Resize(_gallery.Size());
+    SetRow(index);
+    return index;
+}
+
+size_t FaceprintsProgressiveIndex::Add(const ExtendedFaceprints& extended_faceprints)
+{
+    return Add(extended_faceprints.user_id, extended_faceprints.faceprints);
+}
+
+bool FaceprintsProgressiveIndex::Update(size_t index, const Faceprints& faceprints)
+{
+    if (!_gallery.Update(index, faceprints))
+    {
+        return false;
+    }
+    SetRow(index);
+    return true;
+}
+
+bool FaceprintsProgressiveIndex::Remove(size_t index)
+{
+    size_t size = _gallery.Size();
+    if (index >= size)
+    {
+        return false;
+    }
+
+    // the gallery moves the last entry into the removed entry's place
+    size_t last = size - 1;
+    if (index != last)
+    {
+        MoveRow(last, index);
+    }
+    Resize(last);
+    return _gallery.Remove(index);
+}
+
+void FaceprintsProgressiveIndex::Clear()
+{
+    _gallery.Clear();
+    Resize(0);
+}
+
+void FaceprintsProgressiveIndex::Reserve(size_t capacity)
+{
+    _gallery.Reserve(capacity);
+    for (auto& block : _blocks)
+    {
+        block.reserve(capacity * BlockLength);
+    }
+    _norms.reserve(capacity);
+    _tails.reserve(capacity * (NumBlocks - 1));
+}
+
+void FaceprintsProgressiveIndex::Train()
+{
+    const size_t size = _gallery.Size();
+    if (size == 0)
+    {
+        return;
+    }
+    const size_t samples = std::min(size, MaxTrainSamples);
+    std::vector<double> sums(VectorLength, 0), squares(VectorLength, 0);
+    for (size_t s = 0; s < samples; s++)
+    {
+        const feature_t* vec = _gallery.AvgVector(s * size / samples);
+        for (size_t i = 0; i < VectorLength; i++)
+        {
+            sums[i] += vec[i];
+            squares[i] += static_cast<double>(vec[i]) * vec[i];
+        }
+    }
+    std::vector<double> variances(VectorLength);
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        const double mean = sums[i] / static_cast<double>(samples);
+        variances[i] = squares[i] / static_cast<double>(samples) - mean * mean;
+    }
+
+    std::iota(_order.begin(), _order.end(), static_cast<uint16_t>(0));
+    std::stable_sort(_order.begin(), _order.end(),
+                     [&variances](uint16_t a, uint16_t b) { return variances[a] > variances[b]; });
+    _trained = true;
+    for (size_t index = 0; index < size; index++)
+    {
+        SetRow(index);
+    }
+}
+
+void FaceprintsProgressiveIndex::Permute(const feature_t* avg_vector, Query& query) const
+{
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        query.features[i] = avg_vector[_order[i]];
+    }
+    uint64_t norms[NumBlocks];
+    SuffixNorms(query.features, norms);
+    query.norm = std::sqrt(static_cast<double>(std::max<uint64_t>(norms[0], 1)));
+    for (size_t block = 0; block + 1 < NumBlocks; block++)
+    {
+        query.tails[block] = std::sqrt(static_cast<double>(norms[block + 1]));
+    }
+    query.tails[NumBlocks - 1] = 0;
+}
+
+void FaceprintsProgressiveIndex::SetRow(size_t index)
+{
+    const feature_t* vec = _gallery.AvgVector(index);
+    alignas(RowAlignment) feature_t features[VectorLength];
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        features[i] = vec[_order[i]];
+    }
+    for (size_t block = 0; block < NumBlocks; block++)
+    {
+        std::copy_n(features + block * BlockLength, BlockLength, _blocks[block].data() + index * BlockLength);
+    }
+
+    // rounded so the float bounds still hold: the norm down (zero is 1, as CalculateNorm()), the tails up
+    uint64_t norms[NumBlocks];
+    SuffixNorms(features, norms);
+    const double norm = std::sqrt(static_cast<double>(std::max<uint64_t>(norms[0], 1)));
+    _norms[index] = std::nextafter(static_cast<float>(norm), 0.0f);
+    for (size_t block = 0; block + 1 < NumBlocks; block++)
+    {
+        _tails[index * (NumBlocks - 1) + block] =
+            std::nextafter(static_cast<float>(std::sqrt(static_cast<double>(norms[block + 1]))), HUGE_VALF);
+    }
+}
+
+void FaceprintsProgressiveIndex::MoveRow(size_t from, size_t to)
+{
+    for (auto& block : _blocks)
+    {
+        std::copy_n(block.data() + from * BlockLength, BlockLength, block.data() + to * BlockLength);
+    }
+    _norms[to] = _norms[from];
+    std::copy_n(_tails.data() + from * (NumBlocks - 1), NumBlocks - 1, _tails.data() + to * (NumBlocks - 1));
+}
+
+void FaceprintsProgressiveIndex::Resize(size_t size)
+{
+    for (auto& block : _blocks)
+    {
+        block.resize(size * BlockLength);
+    }
+    _norms.resize(size);
+    _tails.resize(size * (NumBlocks - 1));
+}
+} // namespace RealSenseID
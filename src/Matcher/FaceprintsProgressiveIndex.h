@@ -0,0 +1,117 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Copy of the avg vectors of a packed faceprints gallery in blocks of dimensions, for exact 1:N matching that rejects
+ * the users that can no longer match after the first blocks. The dimensions are ordered by decreasing variance over
+ * the gallery (see Train()), so the first blocks hold most of the energy of the vectors, and each block is stored for
+ * all the users before the next one, so a search mostly streams the first blocks.
+ * After the first b blocks the correlation of the query q with a user x is bounded by Cauchy-Schwarz:
+ *   q.x = q[..b].x[..b] + q[b..].x[b..] <= q[..b].x[..b] + |q[b..]||x[b..]|
+ * so each user keeps the norms of its dimensions after each block (rounded up) and its norm (rounded down). A user
+ * whose bound cannot pass the threshold or beat the best score found so far is rejected, the others are scored over
+ * all the blocks (the integer products add up to the same correlation in any order). The result is the same as the
+ * full scan.
+ * The index owns its gallery, so inserts and removals keep the blocks in sync with the gallery indices. Costs another
+ * VectorLength features per user.
+ */
+class FaceprintsProgressiveIndex
+{
+public:
+    static constexpr size_t VectorLength = FaceprintsGallery::VectorLength;
+    static constexpr size_t RowAlignment = FaceprintsGallery::RowAlignment;
+    static constexpr size_t BlockLength = 64;
+    static constexpr size_t NumBlocks = VectorLength / BlockLength;
+    static constexpr size_t MaxTrainSamples = 4096;
+    static_assert(VectorLength % BlockLength == 0, "Vectors must be made of whole blocks");
+
+    // query in the dimension order of the index (see Permute())
+    struct Query
+    {
+        alignas(RowAlignment) feature_t features[VectorLength];
+        double norm;             // |q|, 1 for a zero vector (as CalculateNorm())
+        double tails[NumBlocks]; // |q[b + 1..]|, the last is 0
+    };
+
+    FaceprintsProgressiveIndex();
+
+    // add user to the gallery. returns the gallery index of the new entry.
+    size_t Add(const char* user_id, const Faceprints& faceprints);
+    size_t Add(const ExtendedFaceprints& extended_faceprints);
+
+    // replace faceprints of existing entry. returns false if index is out of range.
+    bool Update(size_t index, const Faceprints& faceprints);
+
+    // remove entry, same index semantics as FaceprintsGallery::Remove(). returns false if index is out of range.
+    bool Remove(size_t index);
+
+    // remove all users, the dimension order is kept.
+    void Clear();
+    void Reserve(size_t capacity);
+
+    // order the dimensions by their variance over the current users (at most MaxTrainSamples, evenly spaced) and
+    // reorder the blocks of all the users. Until trained the dimensions are in their natural order. Users added
+    // later keep the order (the bounds hold for any order), train again after large changes.
+    void Train();
+
+    bool IsTrained() const
+    {
+        return _trained;
+    }
+
+    const FaceprintsGallery& Gallery() const
+    {
+        return _gallery;
+    }
+
+    // dimension of the avg vectors at each position of the index's order
+    const uint16_t* Order() const
+    {
+        return _order.data();
+    }
+
+    // the given block of the user's avg vector, BlockLength features
+    const feature_t* Block(size_t block, size_t index) const
+    {
+        return &_blocks[block][index * BlockLength];
+    }
+
+    // |x|, rounded down
+    float Norm(size_t index) const
+    {
+        return _norms[index];
+    }
+
+    // |x[block + 1..]|, rounded up (block < NumBlocks - 1)
+    float Tail(size_t index, size_t block) const
+    {
+        return _tails[index * (NumBlocks - 1) + block];
+    }
+
+    // the avg vector of a query in the dimension order of the index, with its norm and tail norms.
+    void Permute(const feature_t* avg_vector, Query& query) const;
+
+private:
+    using Features = std::vector<feature_t, AlignedAllocator<feature_t, RowAlignment>>;
+
+    void SetRow(size_t index);
+    void MoveRow(size_t from, size_t to);
+    void Resize(size_t size);
+
+    FaceprintsGallery _gallery;
+    std::vector<uint16_t> _order;
+    bool _trained = false;
+    std::vector<Features> _blocks = std::vector<Features>(NumBlocks); // BlockLength features per user each
+    std::vector<float> _norms;
+    std::vector<float> _tails; // NumBlocks - 1 per user
+};
+} // namespace RealSenseID
@@ -0,0 +1,150 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsQuantizedIndex.h"
+#include "MatcherThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace RealSenseID
+{
+// users per task of a bulk add
+static const size_t s_bulkChunkRows = 1024;
+
+size_t FaceprintsQuantizedIndex::Add(const char* user_id, const Faceprints& faceprints)
+{
+    size_t index = _gallery.Add(user_id, faceprints);
+    _codes.resize(_gallery.Size() * VectorLength);
+    _row_bounds.emplace_back();
+    SetRow(index);
+    return index;
+}
+
+size_t FaceprintsQuantizedIndex::Add(const ExtendedFaceprints& extended_faceprints)
+{
+    return Add(extended_faceprints.user_id, extended_faceprints.faceprints);
+}
+
+size_t FaceprintsQuantizedIndex::AddBulk(const BulkImportSource& source, MatcherThreadPool& pool, bool strict,
+                                         std::vector<BulkImportError>* errors)
+{
+    const size_t first = _gallery.Size();
+    const size_t added = _gallery.AddBulk(source, pool, strict, errors);
+    _codes.resize(_gallery.Size() * VectorLength);
+    _row_bounds.resize(_gallery.Size());
+
+    pool.Run((added + s_bulkChunkRows - 1) / s_bulkChunkRows, [&](size_t chunk) {
+        const size_t end = first + std::min(added, (chunk + 1) * s_bulkChunkRows);
+        for (size_t index = first + chunk * s_bulkChunkRows; index < end; index++)
+        {
+            SetRow(index);
+        }
+    });
+    return added;
+}
+
+bool FaceprintsQuantizedIndex::Update(size_t index, const Faceprints& faceprints)
+{
+    if (!_gallery.Update(index, faceprints))
+    {
+        return false;
+    }
+    SetRow(index);
+    return true;
+}
+
+bool FaceprintsQuantizedIndex::Remove(size_t index)
+{
+    size_t size = _gallery.Size();
+    if (index >= size)
+    {
+        return false;
+    }
+
+    // the gallery moves the last entry into the removed entry's place
+    size_t last = size - 1;
+    if (index != last)
+    {
+        std::copy(Codes(last), Codes(last) + VectorLength, &_codes[index * VectorLength]);
+        _row_bounds[index] = _row_bounds[last];
+    }
+    _codes.resize(last * VectorLength);
+    _row_bounds.pop_back();
+    return _gallery.Remove(index);
+}
+
+void FaceprintsQuantizedIndex::Clear()
+{
+    _gallery.Clear();
+    _codes.clear();
+    _row_bounds.clear();
+}
+
+void FaceprintsQuantizedIndex::Reserve(size_t capacity)
+{
+    _gallery.Reserve(capacity);
+    _codes.reserve(capacity * VectorLength);
+    _row_bounds.reserve(capacity);
+}
+
+bool FaceprintsQuantizedIndex::Quantize(const feature_t* avg_vector, Query& query)
+{
+    double scale = 0, error = 0, codes_norm = 0;
+    const double norm = QuantizeVector(avg_vector, query.codes, scale, error, codes_norm);
+    if (norm == 0)
+    {
+        return false;
+    }
+    query.scale = static_cast<float>(scale / norm);
+    query.error = static_cast<float>(error / norm);
+    return true;
+}
+
+double FaceprintsQuantizedIndex::QuantizeVector(const feature_t* vec, int8_t* codes, double& scale, double& error,
+                                                double& codes_norm)
+{
+    int max_abs = 0;
+    double norm = 0;
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        max_abs = std::max(max_abs, std::abs(static_cast<int>(vec[i])));
+        norm += static_cast<double>(vec[i]) * vec[i];
+    }
+
+    // the scale is stored as float, the error terms are of the stored scale
+    scale = static_cast<float>(max_abs > 0 ? static_cast<double>(max_abs) / MaxCode : 1.0);
+    error = 0;
+    codes_norm = 0;
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        long code = std::lround(vec[i] / scale);
+        code = std::max(-static_cast<long>(MaxCode), std::min(static_cast<long>(MaxCode), code));
+        codes[i] = static_cast<int8_t>(code);
+        const double residual = vec[i] - scale * code;
+        error += residual * residual;
+        codes_norm += static_cast<double>(code) * code;
+    }
+    error = std::sqrt(error);
+    codes_norm = scale * std::sqrt(codes_norm);
+    return std::sqrt(norm);
+}
+
+void FaceprintsQuantizedIndex::SetRow(size_t index)
+{
+    double scale = 0, error = 0, codes_norm = 0;
+    const double norm = QuantizeVector(_gallery.AvgVector(index), &_codes[index * VectorLength], scale, error,
+                                       codes_norm);
+    RowBound& row = _row_bounds[index];
+    if (norm == 0)
+    {
+        // no bound for a zero vector - always rescored
+        row = {0, 1, 0};
+        return;
+    }
+    // rounded up, so the float bound still holds
+    row.scale = static_cast<float>(scale / norm);
+    row.error = std::nextafter(static_cast<float>(error / norm), 2.0f);
+    row.codes_norm = std::nextafter(static_cast<float>(codes_norm / norm), 2.0f);
+}
+} // namespace RealSenseID
@@ -0,0 +1,97 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Int8 copy of the avg vectors of a packed faceprints gallery for exact 1:N matching at half the scan bandwidth.
+ * Each avg vector x is quantized with its own scale s to codes c in [-127, 127], x = s * c + e. For a query
+ * q = s' * c' + e' Cauchy-Schwarz bounds the error of the int8 dot product:
+ *   |q.x - s' * s * c'.c| <= |q||e| + |e'||s * c|
+ * so each entry keeps its scale, |e| and |s * c| (divided by |x|, the bounds are of the normalized correlation).
+ * A search scans the codes and rescores only the users whose bound can pass the threshold or beat the best score with
+ * the exact int16 vectors of the gallery. The result is the same as the full scan.
+ * The index owns its gallery, so inserts and removals keep the codes in sync with the gallery indices.
+ */
+class FaceprintsQuantizedIndex
+{
+public:
+    static constexpr size_t VectorLength = FaceprintsGallery::VectorLength;
+    static constexpr size_t RowAlignment = FaceprintsGallery::RowAlignment;
+    static constexpr int MaxCode = 127;
+
+    // quantized query (see Quantize())
+    struct Query
+    {
+        alignas(RowAlignment) int8_t codes[VectorLength];
+        float scale; // s' / |q|
+        float error; // |e'| / |q|
+    };
+
+    // add user to the gallery. returns the gallery index of the new entry.
+    size_t Add(const char* user_id, const Faceprints& faceprints);
+    size_t Add(const ExtendedFaceprints& extended_faceprints);
+
+    // add the records of source (see FaceprintsGallery::AddBulk()), the added users are quantized in parallel as well.
+    // returns the number of added users.
+    size_t AddBulk(const BulkImportSource& source, MatcherThreadPool& pool, bool strict,
+                   std::vector<BulkImportError>* errors = nullptr);
+
+    // replace faceprints of existing entry and requantize it. returns false if index is out of range.
+    bool Update(size_t index, const Faceprints& faceprints);
+
+    // remove entry, same index semantics as FaceprintsGallery::Remove(). returns false if index is out of range.
+    bool Remove(size_t index);
+
+    void Clear();
+    void Reserve(size_t capacity);
+
+    const FaceprintsGallery& Gallery() const
+    {
+        return _gallery;
+    }
+
+    const int8_t* Codes(size_t index) const
+    {
+        return &_codes[index * VectorLength];
+    }
+
+    // quantize the avg vector of a query. returns false for a zero vector (no bounds, the full scan decides).
+    static bool Quantize(const feature_t* avg_vector, Query& query);
+
+    // bounds of the normalized correlation of the query with the entry, from the int8 dot product of their codes.
+    void CorrBounds(size_t index, const Query& query, int32_t codes_dot, float& lower, float& upper) const
+    {
+        const RowBound& row = _row_bounds[index];
+        const float approx = query.scale * row.scale * static_cast<float>(codes_dot);
+        const float error = row.error + query.error * row.codes_norm;
+        lower = approx - error;
+        upper = approx + error;
+    }
+
+private:
+    // all divided by |x|
+    struct RowBound
+    {
+        float scale;
+        float error;
+        float codes_norm;
+    };
+
+    // codes of the vector with scale, |e| and |s * c|. returns the vector norm.
+    static double QuantizeVector(const feature_t* vec, int8_t* codes, double& scale, double& error,
+                                 double& codes_norm);
+    void SetRow(size_t index);
+
+    FaceprintsGallery _gallery;
+    std::vector<int8_t, AlignedAllocator<int8_t, RowAlignment>> _codes; // VectorLength per entry
+    std::vector<RowBound> _row_bounds;
+};
+} // namespace RealSenseID
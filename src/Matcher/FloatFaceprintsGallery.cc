@@ -0,0 +1,126 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FloatFaceprintsGallery.h"
+#include <cmath>
+#include <cstring>
+
+namespace RealSenseID
+{
+int FloatFaceprintsGallery::Add(const char* user_id, const float* features)
+{
+    float row[VectorLength];
+    if (features == nullptr || !Normalize(features, row))
+    {
+        return -1;
+    }
+
+    size_t index = Size();
+    UserIdEntry id;
+    ::memset(id.id, 0, sizeof(id.id));
+    if (user_id != nullptr)
+    {
+        ::strncpy(id.id, user_id, sizeof(id.id) - 1);
+    }
+    _user_ids.push_back(id);
+    _user_id_index.Insert(index, id.id);
+    _rows.insert(_rows.end(), row, row + VectorLength);
+    return static_cast<int>(index);
+}
+
+int FloatFaceprintsGallery::Add(const char* user_id, const Faceprints& faceprints)
+{
+    float features[VectorLength];
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        features[i] = static_cast<float>(faceprints.avgDescriptor[i]);
+    }
+    return Add(user_id, features);
+}
+
+bool FloatFaceprintsGallery::Update(size_t index, const float* features)
+{
+    if (index >= Size() || features == nullptr)
+    {
+        return false;
+    }
+    return Normalize(features, &_rows[index * VectorLength]);
+}
+
+bool FloatFaceprintsGallery::Remove(size_t index)
+{
+    size_t size = Size();
+    if (index >= size)
+    {
+        return false;
+    }
+
+    size_t last = size - 1;
+    _user_id_index.Erase(index, _user_ids[index].id);
+    if (index != last)
+    {
+        _user_id_index.Move(last, index, _user_ids[last].id);
+        _user_ids[index] = _user_ids[last];
+        ::memcpy(&_rows[index * VectorLength], &_rows[last * VectorLength], VectorLength * sizeof(float));
+    }
+    _user_ids.pop_back();
+    _rows.resize(last * VectorLength);
+    return true;
+}
+
+int FloatFaceprintsGallery::Find(const char* user_id) const
+{
+    if (user_id == nullptr)
+    {
+        return -1;
+    }
+    if (UserIdIndex::IsIndexed(user_id))
+    {
+        return _user_id_index.Find(user_id, [this](size_t row) { return _user_ids[row].id; });
+    }
+
+    // empty ids (users added without an id) are not indexed
+    for (size_t i = 0; i < _user_ids.size(); i++)
+    {
+        if (::strncmp(_user_ids[i].id, user_id, sizeof(_user_ids[i].id)) == 0)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void FloatFaceprintsGallery::Clear()
+{
+    _rows.clear();
+    _user_ids.clear();
+    _user_id_index.Clear();
+}
+
+void FloatFaceprintsGallery::Reserve(size_t capacity)
+{
+    _rows.reserve(capacity * VectorLength);
+    _user_ids.reserve(capacity);
+    _user_id_index.Reserve(capacity);
+}
+
+bool FloatFaceprintsGallery::Normalize(const float* features, float* row)
+{
+    // accumulate in double, the norm of 256 float features must not lose the small ones
+    double norm2 = 0;
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        norm2 += static_cast<double>(features[i]) * features[i];
+    }
+    if (!(norm2 > 0) || !std::isfinite(norm2))
+    {
+        return false;
+    }
+    const double scale = 1.0 / std::sqrt(norm2);
+    for (size_t i = 0; i < VectorLength; i++)
+    {
+        row[i] = static_cast<float>(features[i] * scale);
+    }
+    return true;
+}
+} // namespace RealSenseID
@@ -0,0 +1,88 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include "UserIdIndex.h"
+#include "RealSenseID/Faceprints.h"
+#include <cstddef>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Gallery of float feature vectors for server side analytics (see FloatMatcher).
+ * Rows are normalized to unit length on insert and kept in a single aligned, contiguous row major matrix, so the
+ * cosine similarities of a batch of queries against the whole gallery are one matrix product.
+ * Integer faceprints can be added too (their avg vectors are converted and normalized).
+ * Removal moves the last row into the removed one, like FaceprintsGallery.
+ */
+class FloatFaceprintsGallery
+{
+public:
+    static constexpr size_t VectorLength = FaceprintsGallery::VectorLength;
+    static constexpr size_t MaxUserIdLength = FaceprintsGallery::MaxUserIdLength;
+    static constexpr size_t RowAlignment = FaceprintsGallery::RowAlignment;
+
+    // add user with the given features (VectorLength floats). returns the index of the new entry, or -1 if the
+    // features can not be normalized (zero or not finite).
+    int Add(const char* user_id, const float* features);
+
+    // add user with the avg vector of the given faceprints. returns -1 if the vector is zero.
+    int Add(const char* user_id, const Faceprints& faceprints);
+
+    // replace the features of an existing entry. returns false if index is out of range or the features can not be
+    // normalized.
+    bool Update(size_t index, const float* features);
+
+    // remove entry by moving the last entry into its place. returns false if index is out of range.
+    bool Remove(size_t index);
+
+    // index of the given user id or -1 if not found (the lowest index if the id was added more than once).
+    int Find(const char* user_id) const;
+
+    void Clear();
+    void Reserve(size_t capacity);
+
+    size_t Size() const
+    {
+        return _user_ids.size();
+    }
+
+    bool Empty() const
+    {
+        return _user_ids.empty();
+    }
+
+    const char* UserId(size_t index) const
+    {
+        return _user_ids[index].id;
+    }
+
+    // unit length row of the given entry
+    const float* Row(size_t index) const
+    {
+        return &_rows[index * VectorLength];
+    }
+
+    // Size() rows of VectorLength floats
+    const float* RowsData() const
+    {
+        return _rows.data();
+    }
+
+    // normalize VectorLength features to unit length into row. returns false if they are zero or not finite.
+    static bool Normalize(const float* features, float* row);
+
+private:
+    struct UserIdEntry
+    {
+        char id[MaxUserIdLength];
+    };
+
+    std::vector<float, AlignedAllocator<float, RowAlignment>> _rows;
+    std::vector<UserIdEntry> _user_ids;
+    UserIdIndex _user_id_index {MaxUserIdLength};
+};
+} // namespace RealSenseID
@@ -0,0 +1,184 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FloatMatcher.h"
+#include "FloatFaceprintsGallery.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef RSID_MATCHER_BLAS
+#if defined(__APPLE__)
+#include <Accelerate/Accelerate.h>
+#elif defined(RSID_MATCHER_BLAS_MKL)
+#include <mkl_cblas.h>
+#else
+#include <cblas.h>
+#endif
+#endif // RSID_MATCHER_BLAS
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FloatMatcher";
+
+static const size_t s_vectorLength = FloatFaceprintsGallery::VectorLength;
+
+// a tile is s_queryTileRows queries x s_galleryTileRows gallery rows of similarities (1 MB)
+static const size_t s_queryTileRows = 64;
+static const size_t s_galleryTileRows = 4096;
+
+#ifndef RSID_MATCHER_BLAS
+// 8 partial sums, so the compiler can keep them in one simd register without reordering a single sum
+static float Dot(const float* a, const float* b)
+{
+    float sums[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (size_t i = 0; i < s_vectorLength; i += 8)
+    {
+        for (size_t j = 0; j < 8; j++)
+        {
+            sums[j] += a[i + j] * b[i + j];
+        }
+    }
+    return ((sums[0] + sums[1]) + (sums[2] + sums[3])) + ((sums[4] + sums[5]) + (sums[6] + sums[7]));
+}
+#endif // RSID_MATCHER_BLAS
+
+// c[i * ldc + j] = dot(a row i, b row j) for m rows of a and n rows of b (VectorLength floats each, row major)
+static void MultiplyTransposed(const float* a, size_t m, const float* b, size_t n, float* c, size_t ldc)
+{
+#ifdef RSID_MATCHER_BLAS
+    const auto k = static_cast<int>(s_vectorLength);
+    if (m == 1)
+    {
+        cblas_sgemv(CblasRowMajor, CblasNoTrans, static_cast<int>(n), k, 1.0f, b, k, a, 1, 0.0f, c, 1);
+        return;
+    }
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, static_cast<int>(m), static_cast<int>(n), k, 1.0f, a, k, b,
+                k, 0.0f, c, static_cast<int>(ldc));
+#else
+    // each row of b is read once and stays in L1 while all the rows of a (a tile of queries) are multiplied by it
+    for (size_t j = 0; j < n; j++)
+    {
+        const float* row = b + j * s_vectorLength;
+        for (size_t i = 0; i < m; i++)
+        {
+            c[i * ldc + j] = Dot(a + i * s_vectorLength, row);
+        }
+    }
+#endif // RSID_MATCHER_BLAS
+}
+
+// normalize count queries into rows. returns false (and logs) if one can not be normalized.
+static bool NormalizeQueries(const float* queries, size_t count, std::vector<float>& rows)
+{
+    rows.resize(count * s_vectorLength);
+    for (size_t q = 0; q < count; q++)
+    {
+        if (!FloatFaceprintsGallery::Normalize(queries + q * s_vectorLength, &rows[q * s_vectorLength]))
+        {
+            LOG_ERROR(LOG_TAG, "Query %zu can not be normalized (zero or not finite)", q);
+            return false;
+        }
+    }
+    return true;
+}
+
+match_calc_t FloatMatcher::ToGrade(float cosine)
+{
+    const float similarity = std::min(std::max(cosine, 0.0f), 1.0f);
+    const float grade = similarity * similarity * static_cast<float>(RSID_MAX_POSSIBLE_SCORE);
+    return static_cast<match_calc_t>(std::lround(grade));
+}
+
+bool FloatMatcher::ScoreBatch(const float* queries, size_t n_queries, const FloatFaceprintsGallery& gallery,
+                              std::vector<float>& similarities)
+{
+    similarities.clear();
+    std::vector<float> query_rows;
+    if (queries == nullptr || !NormalizeQueries(queries, n_queries, query_rows))
+    {
+        return false;
+    }
+    similarities.resize(n_queries * gallery.Size());
+    if (!similarities.empty())
+    {
+        MultiplyTransposed(query_rows.data(), n_queries, gallery.RowsData(), gallery.Size(), similarities.data(),
+                           gallery.Size());
+    }
+    return true;
+}
+
+ExtendedMatchResult FloatMatcher::Match(const float* query, const FloatFaceprintsGallery& gallery,
+                                        const MatcherConfig& config)
+{
+    return MatchBatch(query, 1, gallery, config)[0];
+}
+
+std::vector<ExtendedMatchResult> FloatMatcher::MatchBatch(const float* queries, size_t n_queries,
+                                                          const FloatFaceprintsGallery& gallery,
+                                                          const MatcherConfig& config)
+{
+    std::vector<ExtendedMatchResult> results(n_queries);
+    if (gallery.Empty())
+    {
+        LOG_ERROR(LOG_TAG, "Float gallery is empty");
+        return results;
+    }
+    std::vector<float> query_rows;
+    if (queries == nullptr || !NormalizeQueries(queries, n_queries, query_rows))
+    {
+        return results;
+    }
+
+    const size_t rows = gallery.Size();
+    std::vector<float> best(n_queries, -2.0f); // below any cosine
+    std::vector<float> tile(std::min(n_queries, s_queryTileRows) * std::min(rows, s_galleryTileRows));
+
+    for (size_t q_begin = 0; q_begin < n_queries; q_begin += s_queryTileRows)
+    {
+        const size_t q_count = std::min(s_queryTileRows, n_queries - q_begin);
+        for (size_t r_begin = 0; r_begin < rows; r_begin += s_galleryTileRows)
+        {
+            const size_t r_count = std::min(s_galleryTileRows, rows - r_begin);
+            MultiplyTransposed(&query_rows[q_begin * s_vectorLength], q_count, gallery.Row(r_begin), r_count,
+                               tile.data(), r_count);
+            for (size_t q = 0; q < q_count; q++)
+            {
+                const float* similarities = &tile[q * r_count];
+                const size_t query = q_begin + q;
+                for (size_t r = 0; r < r_count; r++)
+                {
+                    if (similarities[r] > best[query])
+                    {
+                        best[query] = similarities[r];
+                        results[query].userId = static_cast<int>(r_begin + r);
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t q = 0; q < n_queries; q++)
+    {
+        auto& result = results[q];
+        result.maxScore = ToGrade(best[q]);
+        result.isSame = result.maxScore > config.StrongThreshold();
+        result.isIdentical = result.maxScore > config.IdenticalPersonThreshold();
+        result.confidence = config.Confidence(result.maxScore);
+    }
+    return results;
+}
+
+const char* FloatMatcher::BlasName()
+{
+#if !defined(RSID_MATCHER_BLAS)
+    return "portable";
+#elif defined(__APPLE__)
+    return "accelerate";
+#elif defined(RSID_MATCHER_BLAS_MKL)
+    return "mkl";
+#else
+    return "cblas";
+#endif
+}
+} // namespace RealSenseID
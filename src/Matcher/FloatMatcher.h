@@ -0,0 +1,52 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "Matcher.h"
+#include "MatcherConfig.h"
+#include <cstddef>
+#include <vector>
+
+namespace RealSenseID
+{
+class FloatFaceprintsGallery;
+
+/**
+ * Float matching engine for server side analytics on normalized float features (see FloatFaceprintsGallery).
+ * The queries are normalized and the cosine similarities against the gallery rows are a single matrix product
+ * (SGEMM, or SGEMV for one query), through the BLAS library selected at build time with RSID_MATCHER_BLAS
+ * (OpenBLAS/MKL/Accelerate, see CMake's BLA_VENDOR), or a portable implementation without it.
+ * Similarities are mapped to the grades of the integer matcher (grade = 4096 * max(cosine, 0)^2, the integer ncc
+ * grade without its truncations), so the thresholds and confidence curves of MatcherConfig apply unchanged.
+ * Unlike the integer scans there is no early exit: the best row of the whole gallery is returned, and nothing is
+ * updated.
+ */
+class FloatMatcher
+{
+public:
+    // grade of the integer matcher for a cosine similarity, in [0, RSID_MAX_POSSIBLE_SCORE]
+    static match_calc_t ToGrade(float cosine);
+
+    // cosine similarities of n_queries queries (n_queries x VectorLength floats, normalized here) vs. all the gallery
+    // rows: similarities[q * gallery.Size() + i] for query q and row i.
+    // returns false if a query can not be normalized. An empty gallery gives no similarities.
+    static bool ScoreBatch(const float* queries, size_t n_queries, const FloatFaceprintsGallery& gallery,
+                           std::vector<float>& similarities);
+
+    // best gallery row for the query (equal similarities by ascending index), with the decision and confidence of
+    // config.
+    // result.userId is -1 if the gallery is empty or the query can not be normalized.
+    static ExtendedMatchResult Match(const float* query, const FloatFaceprintsGallery& gallery,
+                                     const MatcherConfig& config = MatcherConfig::Default());
+
+    // Match() of each of n_queries queries, scored in tiles of queries x rows (one SGEMM per tile) so the similarity
+    // matrix of the whole batch is never held.
+    static std::vector<ExtendedMatchResult> MatchBatch(const float* queries, size_t n_queries,
+                                                       const FloatFaceprintsGallery& gallery,
+                                                       const MatcherConfig& config = MatcherConfig::Default());
+
+    // name of the BLAS backend (for logging)
+    static const char* BlasName();
+};
+} // namespace RealSenseID
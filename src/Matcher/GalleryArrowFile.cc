@@ -0,0 +1,917 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "GalleryArrowFile.h"
+#include "MappedFaceprintsGallery.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "GalleryArrowFile";
+
+// Arrow IPC file format (see the Arrow columnar format spec and its Schema.fbs, Message.fbs and File.fbs):
+//   "ARROW1\0\0" | schema message | record batch messages | end of stream | footer | footer size | "ARROW1"
+// each message is 0xFFFFFFFF | metadata size | Message flatbuffer (padded) | body (the buffers)
+static const char s_arrowMagic[6] = {'A', 'R', 'R', 'O', 'W', '1'};
+static const uint32_t s_continuation = 0xFFFFFFFF;
+static const int16_t s_metadataVersionV5 = 4;
+static const int16_t s_endiannessLittle = 0;
+
+// MessageHeader union
+static const uint8_t s_headerSchema = 1;
+static const uint8_t s_headerRecordBatch = 3;
+
+// Type union
+enum ArrowType : uint8_t
+{
+    TypeNull = 1,
+    TypeInt = 2,
+    TypeFloatingPoint = 3,
+    TypeBinary = 4,
+    TypeUtf8 = 5,
+    TypeBool = 6,
+    TypeDecimal = 7,
+    TypeDate = 8,
+    TypeTime = 9,
+    TypeTimestamp = 10,
+    TypeInterval = 11,
+    TypeList = 12,
+    TypeStruct = 13,
+    TypeUnion = 14,
+    TypeFixedSizeBinary = 15,
+    TypeFixedSizeList = 16,
+    TypeMap = 17,
+    TypeDuration = 18,
+    TypeLargeBinary = 19,
+    TypeLargeUtf8 = 20,
+    TypeLargeList = 21
+};
+
+static const char* s_columnNames[ArrowBulkImportSource::NumColumns] = {
+    "user_id", "avg_descriptor", "orig_descriptor", "version", "number_of_descriptors", "features_type"};
+static const char* s_descriptorItemName = "item";
+static const char* s_formatKey = "rsid.gallery_format";
+static const char* s_formatValue = "1";
+
+// structs of the metadata, little endian as the host
+struct ArrowFieldNode
+{
+    int64_t length;
+    int64_t null_count;
+};
+
+struct ArrowBuffer
+{
+    int64_t offset; // in the message body
+    int64_t length;
+};
+
+struct ArrowBlock
+{
+    int64_t offset;           // of the message in the file
+    int32_t metadata_length;  // continuation, size and padded flatbuffer
+    int32_t padding;
+    int64_t body_length;
+};
+
+static_assert(sizeof(ArrowFieldNode) == 16 && sizeof(ArrowBuffer) == 16 && sizeof(ArrowBlock) == 24,
+              "Arrow metadata structs must be packed");
+
+namespace
+{
+// minimal flatbuffers builder for the metadata, built back to front as the flatbuffers library does: a child is
+// written before its parent, so offsets always point forward. bytes are kept reversed until Finish().
+class FlatBuilder
+{
+public:
+    using Ref = uint32_t; // object's distance from the end of the buffer
+
+    Ref String(const std::string& value)
+    {
+        Align(4, value.size() + 1);
+        const uint8_t terminator = 0;
+        Prepend(&terminator, 1);
+        Prepend(value.data(), value.size());
+        Prepend(static_cast<uint32_t>(value.size()));
+        return Size();
+    }
+
+    // vector of structs aligned to (and sized in multiples of) 8 bytes
+    Ref StructVector(const void* data, size_t count, size_t element_size)
+    {
+        Align(8, count * element_size);
+        Prepend(data, count * element_size);
+        Prepend(static_cast<uint32_t>(count));
+        return Size();
+    }
+
+    Ref RefVector(const std::vector<Ref>& refs)
+    {
+        Align(4, refs.size() * sizeof(uint32_t));
+        for (auto it = refs.rbegin(); it != refs.rend(); ++it)
+        {
+            PrependRef(*it);
+        }
+        Prepend(static_cast<uint32_t>(refs.size()));
+        return Size();
+    }
+
+    // the children of a table must be built before StartTable()
+    void StartTable()
+    {
+        _fields.clear();
+        _table_start = Size();
+    }
+
+    template <typename T>
+    void AddScalar(uint16_t id, T value)
+    {
+        Prepend(value);
+        _fields.push_back({id, Size()});
+    }
+
+    void AddRef(uint16_t id, Ref ref)
+    {
+        PrependRef(ref);
+        _fields.push_back({id, Size()});
+    }
+
+    Ref EndTable()
+    {
+        Prepend(int32_t {0}); // offset to the vtable, set below
+        const Ref table = Size();
+        uint16_t num_fields = 0;
+        for (const auto& field : _fields)
+        {
+            num_fields = std::max<uint16_t>(num_fields, static_cast<uint16_t>(field.id + 1));
+        }
+        std::vector<uint16_t> vtable(2 + num_fields, 0);
+        vtable[0] = static_cast<uint16_t>(vtable.size() * sizeof(uint16_t));
+        vtable[1] = static_cast<uint16_t>(table - _table_start);
+        for (const auto& field : _fields)
+        {
+            vtable[2 + field.id] = static_cast<uint16_t>(table - field.ref);
+        }
+        Prepend(vtable.data(), vtable.size() * sizeof(uint16_t));
+
+        // the vtable precedes the table
+        const int32_t vtable_offset = static_cast<int32_t>(Size() - table);
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&vtable_offset);
+        for (size_t i = 0; i < sizeof(vtable_offset); i++)
+        {
+            _reversed[table - 1 - i] = bytes[i];
+        }
+        return table;
+    }
+
+    // the finished flatbuffer, its size padded to a multiple of 8 bytes
+    std::vector<uint8_t> Finish(Ref root)
+    {
+        Align(8, sizeof(uint32_t));
+        PrependRef(root);
+        return std::vector<uint8_t>(_reversed.rbegin(), _reversed.rend());
+    }
+
+private:
+    struct Field
+    {
+        uint16_t id;
+        Ref ref;
+    };
+
+    std::vector<uint8_t> _reversed;
+    std::vector<Field> _fields;
+    Ref _table_start = 0;
+
+    Ref Size() const
+    {
+        return static_cast<Ref>(_reversed.size());
+    }
+
+    // pad so the next size bytes end (in the finished buffer: start) at an alignment boundary
+    void Align(size_t alignment, size_t size)
+    {
+        while ((_reversed.size() + size) % alignment != 0)
+        {
+            _reversed.push_back(0);
+        }
+    }
+
+    void Prepend(const void* data, size_t size)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = size; i > 0; i--)
+        {
+            _reversed.push_back(bytes[i - 1]);
+        }
+    }
+
+    template <typename T>
+    void Prepend(T value)
+    {
+        Align(sizeof(T), sizeof(T));
+        Prepend(&value, sizeof(T));
+    }
+
+    void PrependRef(Ref ref)
+    {
+        Align(sizeof(uint32_t), sizeof(uint32_t));
+        Prepend(static_cast<uint32_t>(Size() + sizeof(uint32_t) - ref));
+    }
+};
+
+// bounds checked flatbuffers table of a buffer
+class FlatTable
+{
+public:
+    static bool Root(const uint8_t* buffer, size_t size, FlatTable& root)
+    {
+        uint32_t offset;
+        return Read(buffer, size, 0, offset) && root.Init(buffer, size, offset);
+    }
+
+    template <typename T>
+    T Get(uint16_t id, T default_value) const
+    {
+        T value;
+        size_t field = Field(id);
+        return field != 0 && Read(_buffer, _size, field, value) ? value : default_value;
+    }
+
+    bool Has(uint16_t id) const
+    {
+        return Field(id) != 0;
+    }
+
+    bool Table(uint16_t id, FlatTable& table) const
+    {
+        size_t field = Field(id);
+        uint32_t offset;
+        return field != 0 && Read(_buffer, _size, field, offset) && table.Init(_buffer, _size, field + offset);
+    }
+
+    // position of the elements and their number
+    bool Vector(uint16_t id, size_t element_size, size_t& data, uint32_t& count) const
+    {
+        size_t field = Field(id);
+        uint32_t offset;
+        if (field == 0 || !Read(_buffer, _size, field, offset) || !Read(_buffer, _size, field + offset, count))
+        {
+            return false;
+        }
+        data = field + offset + sizeof(uint32_t);
+        return data <= _size && (_size - data) / element_size >= count;
+    }
+
+    bool VectorTable(size_t data, uint32_t index, FlatTable& table) const
+    {
+        size_t element = data + index * sizeof(uint32_t);
+        uint32_t offset;
+        return Read(_buffer, _size, element, offset) && table.Init(_buffer, _size, element + offset);
+    }
+
+    template <typename T>
+    bool VectorStruct(size_t data, uint32_t index, T& value) const
+    {
+        return Read(_buffer, _size, data + index * sizeof(T), value);
+    }
+
+    std::string String(uint16_t id) const
+    {
+        size_t data;
+        uint32_t length;
+        return Vector(id, 1, data, length) ? std::string(reinterpret_cast<const char*>(_buffer + data), length)
+                                           : std::string();
+    }
+
+private:
+    const uint8_t* _buffer = nullptr;
+    size_t _size = 0;
+    size_t _table = 0;
+    size_t _vtable = 0;
+    uint16_t _vtable_size = 0;
+
+    template <typename T>
+    static bool Read(const uint8_t* buffer, size_t size, size_t position, T& value)
+    {
+        if (position > size || size - position < sizeof(T))
+        {
+            return false;
+        }
+        ::memcpy(&value, buffer + position, sizeof(T));
+        return true;
+    }
+
+    bool Init(const uint8_t* buffer, size_t size, size_t table)
+    {
+        int32_t vtable_offset;
+        if (!Read(buffer, size, table, vtable_offset))
+        {
+            return false;
+        }
+        int64_t vtable = static_cast<int64_t>(table) - vtable_offset;
+        uint16_t vtable_size;
+        if (vtable < 0 || !Read(buffer, size, static_cast<size_t>(vtable), vtable_size) || vtable_size < 4 ||
+            static_cast<size_t>(vtable) + vtable_size > size)
+        {
+            return false;
+        }
+        _buffer = buffer;
+        _size = size;
+        _table = table;
+        _vtable = static_cast<size_t>(vtable);
+        _vtable_size = vtable_size;
+        return true;
+    }
+
+    // position of the field, 0 if absent
+    size_t Field(uint16_t id) const
+    {
+        size_t entry = 4 + id * sizeof(uint16_t);
+        uint16_t offset = 0;
+        if (entry + sizeof(uint16_t) > _vtable_size || !Read(_buffer, _size, _vtable + entry, offset) || offset == 0)
+        {
+            return 0;
+        }
+        return _table + offset;
+    }
+};
+
+// Field table: name, nullable, type_type, type, dictionary, children
+FlatBuilder::Ref BuildIntField(FlatBuilder& builder, const char* name, int32_t bit_width)
+{
+    auto name_ref = builder.String(name);
+    builder.StartTable();
+    builder.AddScalar<int32_t>(0, bit_width);
+    builder.AddScalar<uint8_t>(1, 1); // is_signed
+    auto type_ref = builder.EndTable();
+    auto children_ref = builder.RefVector({});
+    builder.StartTable();
+    builder.AddRef(0, name_ref);
+    builder.AddScalar<uint8_t>(1, 0);
+    builder.AddScalar<uint8_t>(2, TypeInt);
+    builder.AddRef(3, type_ref);
+    builder.AddRef(5, children_ref);
+    return builder.EndTable();
+}
+
+FlatBuilder::Ref BuildDescriptorField(FlatBuilder& builder, const char* name)
+{
+    auto item_ref = BuildIntField(builder, s_descriptorItemName, 16);
+    auto name_ref = builder.String(name);
+    builder.StartTable();
+    builder.AddScalar<int32_t>(0, static_cast<int32_t>(FaceprintsGallery::VectorLength)); // listSize
+    auto type_ref = builder.EndTable();
+    auto children_ref = builder.RefVector({item_ref});
+    builder.StartTable();
+    builder.AddRef(0, name_ref);
+    builder.AddScalar<uint8_t>(1, 0);
+    builder.AddScalar<uint8_t>(2, TypeFixedSizeList);
+    builder.AddRef(3, type_ref);
+    builder.AddRef(5, children_ref);
+    return builder.EndTable();
+}
+
+FlatBuilder::Ref BuildUtf8Field(FlatBuilder& builder, const char* name)
+{
+    auto name_ref = builder.String(name);
+    builder.StartTable();
+    auto type_ref = builder.EndTable();
+    auto children_ref = builder.RefVector({});
+    builder.StartTable();
+    builder.AddRef(0, name_ref);
+    builder.AddScalar<uint8_t>(1, 0);
+    builder.AddScalar<uint8_t>(2, TypeUtf8);
+    builder.AddRef(3, type_ref);
+    builder.AddRef(5, children_ref);
+    return builder.EndTable();
+}
+
+// Schema table: endianness, fields, custom_metadata
+FlatBuilder::Ref BuildSchema(FlatBuilder& builder)
+{
+    std::vector<FlatBuilder::Ref> fields;
+    fields.push_back(BuildUtf8Field(builder, s_columnNames[ArrowBulkImportSource::UserIdColumn]));
+    fields.push_back(BuildDescriptorField(builder, s_columnNames[ArrowBulkImportSource::AvgDescriptorColumn]));
+    fields.push_back(BuildDescriptorField(builder, s_columnNames[ArrowBulkImportSource::OrigDescriptorColumn]));
+    fields.push_back(BuildIntField(builder, s_columnNames[ArrowBulkImportSource::VersionColumn], 32));
+    fields.push_back(BuildIntField(builder, s_columnNames[ArrowBulkImportSource::NumberOfDescriptorsColumn], 32));
+    fields.push_back(BuildIntField(builder, s_columnNames[ArrowBulkImportSource::FeaturesTypeColumn], 32));
+    auto fields_ref = builder.RefVector(fields);
+
+    auto key_ref = builder.String(s_formatKey);
+    auto value_ref = builder.String(s_formatValue);
+    builder.StartTable();
+    builder.AddRef(0, key_ref);
+    builder.AddRef(1, value_ref);
+    auto metadata_ref = builder.RefVector({builder.EndTable()});
+
+    builder.StartTable();
+    builder.AddScalar<int16_t>(0, s_endiannessLittle);
+    builder.AddRef(1, fields_ref);
+    builder.AddRef(2, metadata_ref);
+    return builder.EndTable();
+}
+
+// Message table: version, header_type, header, bodyLength
+FlatBuilder::Ref BuildMessage(FlatBuilder& builder, uint8_t header_type, FlatBuilder::Ref header, int64_t body_length)
+{
+    builder.StartTable();
+    builder.AddScalar<int64_t>(3, body_length);
+    builder.AddRef(2, header);
+    builder.AddScalar<int16_t>(0, s_metadataVersionV5);
+    builder.AddScalar<uint8_t>(1, header_type);
+    return builder.EndTable();
+}
+
+// write the message metadata at offset, padded so the body starts at an alignment boundary of the file. returns the
+// metadata length (continuation, size and flatbuffer).
+int32_t WriteMessage(std::ofstream& file, uint64_t offset, FlatBuilder& builder, FlatBuilder::Ref message)
+{
+    std::vector<uint8_t> flatbuffer = builder.Finish(message);
+    const uint64_t body = MappedFaceprintsGallery::AlignOffset(offset + 2 * sizeof(uint32_t) + flatbuffer.size());
+    flatbuffer.resize(static_cast<size_t>(body - offset - 2 * sizeof(uint32_t)), 0);
+    const uint32_t size = static_cast<uint32_t>(flatbuffer.size());
+    file.write(reinterpret_cast<const char*>(&s_continuation), sizeof(s_continuation));
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(flatbuffer.data()), static_cast<std::streamsize>(flatbuffer.size()));
+    return static_cast<int32_t>(body - offset);
+}
+
+// number of field nodes and buffers of a field and its children in a record batch, false if unsupported
+bool CountLayout(const FlatTable& field, size_t& nodes, size_t& buffers)
+{
+    nodes++;
+    switch (field.Get<uint8_t>(2, 0))
+    {
+    case TypeNull:
+        break;
+    case TypeStruct:
+    case TypeFixedSizeList:
+        buffers += 1;
+        break;
+    case TypeInt:
+    case TypeFloatingPoint:
+    case TypeBool:
+    case TypeDecimal:
+    case TypeDate:
+    case TypeTime:
+    case TypeTimestamp:
+    case TypeInterval:
+    case TypeFixedSizeBinary:
+    case TypeDuration:
+    case TypeList:
+    case TypeLargeList:
+    case TypeMap:
+        buffers += 2;
+        break;
+    case TypeBinary:
+    case TypeUtf8:
+    case TypeLargeBinary:
+    case TypeLargeUtf8:
+        buffers += 3;
+        break;
+    default:
+        return false;
+    }
+
+    size_t children;
+    uint32_t num_children = 0;
+    if (field.Has(5) && !field.Vector(5, sizeof(uint32_t), children, num_children))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < num_children; i++)
+    {
+        FlatTable child;
+        if (!field.VectorTable(children, i, child) || !CountLayout(child, nodes, buffers))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IsIntType(const FlatTable& field, int32_t bit_width)
+{
+    FlatTable type;
+    return field.Get<uint8_t>(2, 0) == TypeInt && field.Table(3, type) && type.Get<int32_t>(0, 0) == bit_width &&
+           type.Get<uint8_t>(1, 0) != 0;
+}
+
+bool IsDescriptorType(const FlatTable& field)
+{
+    FlatTable type, item;
+    size_t children;
+    uint32_t num_children;
+    return field.Get<uint8_t>(2, 0) == TypeFixedSizeList && field.Table(3, type) &&
+           type.Get<int32_t>(0, 0) == static_cast<int32_t>(FaceprintsGallery::VectorLength) &&
+           field.Vector(5, sizeof(uint32_t), children, num_children) && num_children == 1 &&
+           field.VectorTable(children, 0, item) && IsIntType(item, 16);
+}
+
+bool IsColumnType(ArrowBulkImportSource::Column column, const FlatTable& field)
+{
+    switch (column)
+    {
+    case ArrowBulkImportSource::UserIdColumn:
+        return field.Get<uint8_t>(2, 0) == TypeUtf8;
+    case ArrowBulkImportSource::AvgDescriptorColumn:
+    case ArrowBulkImportSource::OrigDescriptorColumn:
+        return IsDescriptorType(field);
+    default:
+        return IsIntType(field, 32);
+    }
+}
+
+bool IsValidEntry(const uint8_t* validity, size_t index)
+{
+    return validity == nullptr || (validity[index / 8] & (1 << (index % 8))) != 0;
+}
+} // namespace
+
+bool GalleryArrowFile::Save(const FaceprintsGallery& gallery, const std::string& path)
+{
+    const size_t count = gallery.Size();
+    const size_t vector_size = FaceprintsGallery::VectorLength * sizeof(feature_t);
+    const std::string tmp_path = path + ".tmp";
+    std::vector<ArrowBlock> blocks;
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to create Arrow file %s", tmp_path.c_str());
+            return false;
+        }
+
+        char magic[8] = {0};
+        ::memcpy(magic, s_arrowMagic, sizeof(s_arrowMagic));
+        bool ok = MappedFaceprintsGallery::WriteSection(file, 0, magic, sizeof(magic));
+        uint64_t offset = sizeof(magic);
+        {
+            FlatBuilder builder;
+            auto schema = BuildSchema(builder);
+            offset += WriteMessage(file, offset, builder, BuildMessage(builder, s_headerSchema, schema, 0));
+        }
+
+        std::vector<int32_t> id_offsets;
+        std::vector<char> id_chars;
+        std::vector<int32_t> ints[3];
+        for (size_t first = 0; first < count && ok; first += BatchRows)
+        {
+            const size_t length = std::min(BatchRows, count - first);
+            id_offsets.assign(1, 0);
+            id_chars.clear();
+            for (auto& column : ints)
+            {
+                column.resize(length);
+            }
+            for (size_t i = 0; i < length; i++)
+            {
+                const char* user_id = gallery.UserId(first + i);
+                const size_t id_length = ::strnlen(user_id, FaceprintsGallery::MaxUserIdLength);
+                id_chars.insert(id_chars.end(), user_id, user_id + id_length);
+                id_offsets.push_back(static_cast<int32_t>(id_chars.size()));
+                const auto& metadata = gallery.GetMetadata(first + i);
+                ints[0][i] = metadata.version;
+                ints[1][i] = metadata.numberOfDescriptors;
+                ints[2][i] = static_cast<int32_t>(metadata.featuresType);
+            }
+
+            // the buffers in schema order, no validity bitmaps (no nulls)
+            const void* data[] = {nullptr,
+                                  id_offsets.data(),
+                                  id_chars.data(),
+                                  nullptr,
+                                  nullptr,
+                                  gallery.AvgVectorsData() + first * FaceprintsGallery::VectorLength,
+                                  nullptr,
+                                  nullptr,
+                                  gallery.OrigVector(first),
+                                  nullptr,
+                                  ints[0].data(),
+                                  nullptr,
+                                  ints[1].data(),
+                                  nullptr,
+                                  ints[2].data()};
+            const size_t sizes[] = {0,
+                                    id_offsets.size() * sizeof(int32_t),
+                                    id_chars.size(),
+                                    0,
+                                    0,
+                                    length * vector_size,
+                                    0,
+                                    0,
+                                    length * vector_size,
+                                    0,
+                                    length * sizeof(int32_t),
+                                    0,
+                                    length * sizeof(int32_t),
+                                    0,
+                                    length * sizeof(int32_t)};
+            const size_t num_buffers = sizeof(sizes) / sizeof(sizes[0]);
+            ArrowBuffer buffers[num_buffers];
+            int64_t body_length = 0;
+            for (size_t i = 0; i < num_buffers; i++)
+            {
+                buffers[i].offset = body_length;
+                buffers[i].length = static_cast<int64_t>(sizes[i]);
+                body_length = static_cast<int64_t>(MappedFaceprintsGallery::AlignOffset(body_length + sizes[i]));
+            }
+            const int64_t rows = static_cast<int64_t>(length);
+            const int64_t items = rows * FaceprintsGallery::VectorLength;
+            const ArrowFieldNode nodes[] = {{rows, 0}, {rows, 0}, {items, 0}, {rows, 0},
+                                            {items, 0}, {rows, 0}, {rows, 0}, {rows, 0}};
+
+            // RecordBatch table: length, nodes, buffers
+            FlatBuilder builder;
+            auto nodes_ref = builder.StructVector(nodes, sizeof(nodes) / sizeof(nodes[0]), sizeof(nodes[0]));
+            auto buffers_ref = builder.StructVector(buffers, num_buffers, sizeof(buffers[0]));
+            builder.StartTable();
+            builder.AddScalar<int64_t>(0, rows);
+            builder.AddRef(1, nodes_ref);
+            builder.AddRef(2, buffers_ref);
+            auto batch = builder.EndTable();
+
+            ArrowBlock block {};
+            block.offset = static_cast<int64_t>(offset);
+            block.metadata_length =
+                WriteMessage(file, offset, builder, BuildMessage(builder, s_headerRecordBatch, batch, body_length));
+            block.body_length = body_length;
+            blocks.push_back(block);
+
+            const uint64_t body = offset + block.metadata_length;
+            for (size_t i = 0; i < num_buffers && ok; i++)
+            {
+                ok = MappedFaceprintsGallery::WriteSection(file, body + buffers[i].offset, data[i], sizes[i]);
+            }
+            offset = body + body_length;
+            ok = ok && MappedFaceprintsGallery::WriteSection(file, offset, nullptr, 0);
+        }
+
+        // end of stream, then the footer (File.fbs Footer table: version, schema, dictionaries, recordBatches)
+        const uint32_t end_of_stream[2] = {s_continuation, 0};
+        ok = ok && MappedFaceprintsGallery::WriteSection(file, offset, end_of_stream, sizeof(end_of_stream));
+        FlatBuilder builder;
+        auto schema = BuildSchema(builder);
+        auto blocks_ref = builder.StructVector(blocks.data(), blocks.size(), sizeof(ArrowBlock));
+        builder.StartTable();
+        builder.AddRef(1, schema);
+        builder.AddRef(3, blocks_ref);
+        builder.AddScalar<int16_t>(0, s_metadataVersionV5);
+        std::vector<uint8_t> footer = builder.Finish(builder.EndTable());
+        const int32_t footer_size = static_cast<int32_t>(footer.size());
+        file.write(reinterpret_cast<const char*>(footer.data()), static_cast<std::streamsize>(footer.size()));
+        file.write(reinterpret_cast<const char*>(&footer_size), sizeof(footer_size));
+        file.write(s_arrowMagic, sizeof(s_arrowMagic));
+        file.flush();
+        if (!ok || !file.good())
+        {
+            LOG_ERROR(LOG_TAG, "Failed to write Arrow file %s", tmp_path.c_str());
+            file.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    if (!MappedFaceprintsGallery::ReplaceFile(tmp_path, path))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to replace Arrow file %s", path.c_str());
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    LOG_DEBUG(LOG_TAG, "Saved %zu users in %zu record batches to %s", count, blocks.size(), path.c_str());
+    return true;
+}
+
+ArrowBulkImportSource::ArrowBulkImportSource(const uint8_t* buffer, size_t buffer_size)
+{
+    _is_valid = Parse(buffer, buffer_size);
+    if (!_is_valid)
+    {
+        _batches.clear();
+        _size = 0;
+    }
+}
+
+bool ArrowBulkImportSource::Parse(const uint8_t* buffer, size_t buffer_size)
+{
+    // magic, footer, footer size, magic
+    const size_t trailer_size = sizeof(int32_t) + sizeof(s_arrowMagic);
+    int32_t footer_size;
+    if (buffer == nullptr || buffer_size < 8 + trailer_size || ::memcmp(buffer, s_arrowMagic, sizeof(s_arrowMagic)) ||
+        ::memcmp(buffer + buffer_size - sizeof(s_arrowMagic), s_arrowMagic, sizeof(s_arrowMagic)))
+    {
+        LOG_ERROR(LOG_TAG, "Not an Arrow file");
+        return false;
+    }
+    ::memcpy(&footer_size, buffer + buffer_size - trailer_size, sizeof(footer_size));
+    FlatTable footer, schema;
+    if (footer_size <= 0 || static_cast<size_t>(footer_size) > buffer_size - 8 - trailer_size ||
+        !FlatTable::Root(buffer + buffer_size - trailer_size - footer_size, footer_size, footer) ||
+        !footer.Table(1, schema))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid Arrow file footer");
+        return false;
+    }
+
+    // the first node and buffer of each column, in the flattened layout of the record batches
+    size_t fields;
+    uint32_t num_fields;
+    if (schema.Get<int16_t>(0, s_endiannessLittle) != s_endiannessLittle ||
+        !schema.Vector(1, sizeof(uint32_t), fields, num_fields))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid Arrow schema");
+        return false;
+    }
+    size_t column_nodes[NumColumns], column_buffers[NumColumns];
+    bool found[NumColumns] = {false};
+    size_t num_nodes = 0, num_buffers = 0;
+    for (uint32_t i = 0; i < num_fields; i++)
+    {
+        FlatTable field;
+        size_t nodes = num_nodes, buffers = num_buffers;
+        if (!schema.VectorTable(fields, i, field) || field.Has(4) || !CountLayout(field, num_nodes, num_buffers))
+        {
+            LOG_ERROR(LOG_TAG, "Unsupported field %u in Arrow schema", i);
+            return false;
+        }
+        const std::string name = field.String(0);
+        for (int column = 0; column < NumColumns; column++)
+        {
+            if (name == s_columnNames[column] && !found[column])
+            {
+                if (!IsColumnType(static_cast<Column>(column), field))
+                {
+                    LOG_ERROR(LOG_TAG, "Unexpected type of column %s", name.c_str());
+                    return false;
+                }
+                found[column] = true;
+                column_nodes[column] = nodes;
+                column_buffers[column] = buffers;
+            }
+        }
+    }
+    for (int column = 0; column < NumColumns; column++)
+    {
+        if (!found[column])
+        {
+            LOG_ERROR(LOG_TAG, "Missing column %s", s_columnNames[column]);
+            return false;
+        }
+    }
+
+    size_t blocks;
+    uint32_t num_blocks = 0;
+    if (footer.Has(3) && !footer.Vector(3, sizeof(ArrowBlock), blocks, num_blocks))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid Arrow file footer");
+        return false;
+    }
+    for (uint32_t b = 0; b < num_blocks; b++)
+    {
+        ArrowBlock block;
+        footer.VectorStruct(blocks, b, block);
+        if (block.offset < 0 || block.metadata_length < 8 || block.body_length < 0 ||
+            static_cast<uint64_t>(block.offset) + block.metadata_length + block.body_length > buffer_size)
+        {
+            LOG_ERROR(LOG_TAG, "Record batch %u out of the file", b);
+            return false;
+        }
+
+        // continuation and size (older files have no continuation)
+        const uint8_t* metadata = buffer + block.offset;
+        uint32_t prefix;
+        ::memcpy(&prefix, metadata, sizeof(prefix));
+        const size_t flatbuffer_offset = prefix == s_continuation ? 8 : 4;
+        const uint8_t* body = metadata + block.metadata_length;
+        FlatTable message, batch;
+        size_t nodes, buffers;
+        uint32_t batch_nodes, batch_buffers;
+        if (!FlatTable::Root(metadata + flatbuffer_offset, block.metadata_length - flatbuffer_offset, message) ||
+            message.Get<uint8_t>(1, 0) != s_headerRecordBatch || !message.Table(2, batch) || batch.Has(3) ||
+            !batch.Vector(1, sizeof(ArrowFieldNode), nodes, batch_nodes) ||
+            !batch.Vector(2, sizeof(ArrowBuffer), buffers, batch_buffers) || batch_nodes != num_nodes ||
+            batch_buffers != num_buffers)
+        {
+            LOG_ERROR(LOG_TAG, "Invalid or compressed record batch %u", b);
+            return false;
+        }
+
+        Batch entry;
+        entry.first = _size;
+        const int64_t length = batch.Get<int64_t>(0, 0);
+        if (length < 0)
+        {
+            return false;
+        }
+        entry.length = static_cast<size_t>(length);
+        for (int column = 0; column < NumColumns; column++)
+        {
+            ArrowFieldNode node;
+            batch.VectorStruct(nodes, static_cast<uint32_t>(column_nodes[column]), node);
+            const bool is_descriptor = column == AvgDescriptorColumn || column == OrigDescriptorColumn;
+            const bool is_user_id = column == UserIdColumn;
+            // validity, then the data (the child's validity and data of descriptors), then the user ids' chars
+            ArrowBuffer column_buffers_data[3] = {};
+            const size_t count = is_descriptor || is_user_id ? 3 : 2;
+            for (size_t i = 0; i < count; i++)
+            {
+                batch.VectorStruct(buffers, static_cast<uint32_t>(column_buffers[column] + i), column_buffers_data[i]);
+                const ArrowBuffer& data = column_buffers_data[i];
+                if (data.offset < 0 || data.length < 0 || data.offset + data.length > block.body_length)
+                {
+                    LOG_ERROR(LOG_TAG, "Buffer of column %s out of record batch %u", s_columnNames[column], b);
+                    return false;
+                }
+            }
+
+            const size_t rows = entry.length;
+            const ArrowBuffer& validity = column_buffers_data[0];
+            const ArrowBuffer& data = column_buffers_data[is_descriptor ? 2 : 1];
+            size_t data_size = rows * sizeof(int32_t);
+            if (is_user_id)
+            {
+                data_size = (rows + 1) * sizeof(int32_t);
+            }
+            else if (is_descriptor)
+            {
+                ArrowFieldNode item_node;
+                batch.VectorStruct(nodes, static_cast<uint32_t>(column_nodes[column] + 1), item_node);
+                data_size = rows * FaceprintsGallery::VectorLength * sizeof(feature_t);
+                if (item_node.null_count != 0 || column_buffers_data[1].length != 0)
+                {
+                    LOG_ERROR(LOG_TAG, "Null features in column %s of record batch %u", s_columnNames[column], b);
+                    return false;
+                }
+            }
+            if (node.length != length || static_cast<size_t>(data.length) < data_size ||
+                (node.null_count != 0 && static_cast<size_t>(validity.length) < (rows + 7) / 8))
+            {
+                LOG_ERROR(LOG_TAG, "Column %s of record batch %u is too short", s_columnNames[column], b);
+                return false;
+            }
+
+            ColumnData& column_data = entry.columns[column];
+            column_data.validity = node.null_count != 0 ? body + validity.offset : nullptr;
+            column_data.data = body + data.offset;
+            if (is_user_id)
+            {
+                column_data.chars = body + column_buffers_data[2].offset;
+                column_data.chars_size = static_cast<size_t>(column_buffers_data[2].length);
+            }
+        }
+        _size += entry.length;
+        _batches.push_back(entry);
+    }
+    return true;
+}
+
+bool ArrowBulkImportSource::Read(size_t record, ExtendedFaceprints& user) const
+{
+    auto it = std::upper_bound(_batches.begin(), _batches.end(), record,
+                               [](size_t value, const Batch& batch) { return value < batch.first; });
+    if (record >= _size || it == _batches.begin())
+    {
+        return false;
+    }
+    const Batch& batch = *(it - 1);
+    const size_t row = record - batch.first;
+    for (const auto& column : batch.columns)
+    {
+        if (!IsValidEntry(column.validity, row))
+        {
+            return false;
+        }
+    }
+
+    const ColumnData& ids = batch.columns[UserIdColumn];
+    int32_t id_range[2];
+    ::memcpy(id_range, ids.data + row * sizeof(int32_t), sizeof(id_range));
+    if (id_range[0] < 0 || id_range[1] < id_range[0] || static_cast<size_t>(id_range[1]) > ids.chars_size)
+    {
+        return false;
+    }
+    ::memset(user.user_id, 0, sizeof(user.user_id));
+    ::memcpy(user.user_id, ids.chars + id_range[0],
+             std::min(static_cast<size_t>(id_range[1] - id_range[0]), sizeof(user.user_id) - 1));
+
+    const size_t vector_size = FaceprintsGallery::VectorLength * sizeof(feature_t);
+    ::memcpy(user.faceprints.avgDescriptor, batch.columns[AvgDescriptorColumn].data + row * vector_size, vector_size);
+    ::memcpy(user.faceprints.origDescriptor, batch.columns[OrigDescriptorColumn].data + row * vector_size,
+             vector_size);
+    int32_t value;
+    ::memcpy(&value, batch.columns[VersionColumn].data + row * sizeof(value), sizeof(value));
+    user.faceprints.version = value;
+    ::memcpy(&value, batch.columns[NumberOfDescriptorsColumn].data + row * sizeof(value), sizeof(value));
+    user.faceprints.numberOfDescriptors = value;
+    ::memcpy(&value, batch.columns[FeaturesTypeColumn].data + row * sizeof(value), sizeof(value));
+    user.faceprints.featuresType = static_cast<FaceprintsTypeEnum>(value);
+    return true;
+}
+} // namespace RealSenseID
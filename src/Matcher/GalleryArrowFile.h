@@ -0,0 +1,90 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include "GalleryBulkImport.h"
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Columnar export of a gallery as an Arrow IPC file (the Arrow "Feather V2" file format), for analytics tools which
+ * memory map it and read the columns in place:
+ *   user_id: utf8 | avg_descriptor, orig_descriptor: fixed_size_list<int16>[VectorLength] |
+ *   version, number_of_descriptors, features_type: int32
+ * The descriptor columns are the gallery's packed rows as is, written straight from its arrays. Record batches hold
+ * up to BatchRows users, all buffers start at 64 byte boundaries of the file (the Arrow recommended alignment).
+ */
+class GalleryArrowFile
+{
+public:
+    static constexpr size_t BatchRows = 64 * 1024;
+
+    // write the gallery to the given path (via a temporary file that replaces path). returns false on failure.
+    static bool Save(const FaceprintsGallery& gallery, const std::string& path);
+};
+
+/**
+ * Records of an Arrow IPC file with the columns of GalleryArrowFile (in any order, other columns are ignored), e.g.
+ * as written by Save() or rewritten by an analytics tool without compression. The footer, schema and record batch
+ * metadata are validated on construction, Read() copies a record from the column buffers. Null entries of a column
+ * are invalid records. The buffer must outlive the source.
+ */
+class ArrowBulkImportSource : public BulkImportSource
+{
+public:
+    ArrowBulkImportSource(const uint8_t* buffer, size_t buffer_size);
+
+    // false if the buffer is not a valid Arrow file with the gallery columns (the source is then empty)
+    bool IsValid() const
+    {
+        return _is_valid;
+    }
+
+    size_t Size() const override
+    {
+        return _size;
+    }
+
+    bool Read(size_t record, ExtendedFaceprints& user) const override;
+
+    enum Column
+    {
+        UserIdColumn,
+        AvgDescriptorColumn,
+        OrigDescriptorColumn,
+        VersionColumn,
+        NumberOfDescriptorsColumn,
+        FeaturesTypeColumn,
+        NumColumns
+    };
+
+private:
+    // a top level column's buffers (the child's data buffer of the descriptor columns)
+    struct ColumnData
+    {
+        const uint8_t* validity = nullptr; // nullptr if the column of the batch has no nulls
+        const uint8_t* data = nullptr;     // offsets of user_id
+        const uint8_t* chars = nullptr;    // user_id
+        size_t chars_size = 0;
+    };
+
+    struct Batch
+    {
+        size_t first = 0; // record
+        size_t length = 0;
+        ColumnData columns[NumColumns];
+    };
+
+    bool Parse(const uint8_t* buffer, size_t buffer_size);
+
+    std::vector<Batch> _batches;
+    size_t _size = 0;
+    bool _is_valid = false;
+};
+} // namespace RealSenseID
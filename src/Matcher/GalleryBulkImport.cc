@@ -0,0 +1,19 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "GalleryBulkImport.h"
+#include "FaceprintsCodec.h"
+
+namespace RealSenseID
+{
+CodecBulkImportSource::CodecBulkImportSource(const uint8_t* buffer, size_t buffer_size) :
+    _buffer {buffer}, _buffer_size {buffer_size}
+{
+    _is_valid = FaceprintsCodec::IndexUsers(buffer, buffer_size, _offsets);
+}
+
+bool CodecBulkImportSource::Read(size_t record, ExtendedFaceprints& user) const
+{
+    return record < _offsets.size() && FaceprintsCodec::DecodeUser(_buffer, _buffer_size, _offsets[record], user);
+}
+} // namespace RealSenseID
@@ -0,0 +1,70 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "ExtendedFaceprints.h"
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+// rejected record of a bulk import
+struct BulkImportError
+{
+    enum class Reason
+    {
+        InvalidRecord,     // the source could not read the record
+        InvalidFaceprints, // no descriptor or avg vector out of range (see FaceprintsGallery::IsUsable())
+        DuplicateUserId    // id already in the gallery or earlier in the import
+    };
+
+    size_t record;
+    Reason reason;
+};
+
+/**
+ * Records of a bulk import (see FaceprintsGallery::AddBulk()).
+ * Read() is called once per record, concurrently by the threads of the import's pool.
+ */
+class BulkImportSource
+{
+public:
+    virtual ~BulkImportSource() = default;
+
+    virtual size_t Size() const = 0;
+
+    // read the record into user (zero padded user id). returns false if the record is invalid.
+    virtual bool Read(size_t record, ExtendedFaceprints& user) const = 0;
+};
+
+/**
+ * Records of a FaceprintsCodec bulk buffer. The buffer is validated and its records found on construction (record
+ * headers only), Read() decodes a record. The buffer must outlive the source.
+ */
+class CodecBulkImportSource : public BulkImportSource
+{
+public:
+    CodecBulkImportSource(const uint8_t* buffer, size_t buffer_size);
+
+    // false if the buffer is not a valid bulk buffer (the source is then empty)
+    bool IsValid() const
+    {
+        return _is_valid;
+    }
+
+    size_t Size() const override
+    {
+        return _offsets.size();
+    }
+
+    bool Read(size_t record, ExtendedFaceprints& user) const override;
+
+private:
+    const uint8_t* _buffer;
+    size_t _buffer_size;
+    std::vector<size_t> _offsets; // of each user in the buffer
+    bool _is_valid;
+};
+} // namespace RealSenseID
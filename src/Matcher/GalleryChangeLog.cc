@@ -0,0 +1,291 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "GalleryChangeLog.h"
+#include "FaceprintsCodec.h"
+#include "FaceprintsDatabase.h"
+#include "FaceprintsGallery.h"
+#include "Logger.h"
+#include <chrono>
+#include <cstring>
+#include <random>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "GalleryChangeLog";
+
+static const char s_batchMagic[8] = {'R', 'S', 'I', 'D', 'C', 'L', 'G', '\0'};
+static const size_t s_batchHeaderSize = sizeof(s_batchMagic) + 8 + 8 + 4;
+static const size_t s_batchChecksumSize = 4;
+
+static void WriteUint32(uint8_t* out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static void WriteUint64(uint8_t* out, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint32_t ReadUint32(const uint8_t* in)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+static uint64_t ReadUint64(const uint8_t* in)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+static uint32_t Checksum(const uint8_t* data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// differs between runs of the primary (and between primaries), 0 is never used
+static uint64_t NewEpoch()
+{
+    std::random_device random;
+    uint64_t epoch = (static_cast<uint64_t>(random()) << 32) ^ random();
+    epoch ^= static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    return epoch != 0 ? epoch : 1;
+}
+
+GalleryChangeLog::GalleryChangeLog(size_t retained_bytes) : _epoch {NewEpoch()}, _retained_bytes {retained_bytes}
+{
+}
+
+uint64_t GalleryChangeLog::NextSequence() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _next_sequence;
+}
+
+uint64_t GalleryChangeLog::FirstSequence() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _changes.empty() ? _next_sequence : _changes.front().sequence;
+}
+
+bool GalleryChangeLog::Append(Operation operation, const char* user_id, const Faceprints* faceprints)
+{
+    // encoded outside the lock, readers only wait for the push
+    const uint8_t id_length = static_cast<uint8_t>(::strnlen(user_id, FaceprintsGallery::MaxUserIdLength - 1));
+    std::vector<uint8_t> bytes(2 + id_length + FaceprintsCodec::MaxEncodedSize);
+    bytes[0] = static_cast<uint8_t>(operation);
+    bytes[1] = id_length;
+    ::memcpy(&bytes[2], user_id, id_length);
+
+    size_t size = 2 + id_length;
+    bool encoded = true;
+    if (operation != Operation::Remove)
+    {
+        const size_t record_size =
+            faceprints != nullptr ? FaceprintsCodec::Encode(*faceprints, &bytes[size], FaceprintsCodec::MaxEncodedSize)
+                                  : 0;
+        encoded = record_size > 0;
+        size += record_size;
+    }
+    bytes.resize(size);
+
+    std::lock_guard<std::mutex> lock {_mutex};
+    const uint64_t sequence = _next_sequence++;
+    if (!encoded)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to encode change %llu of user %s, replicas must be copied again",
+                  static_cast<unsigned long long>(sequence), user_id);
+        _changes.clear();
+        _num_bytes = 0;
+        return false;
+    }
+
+    _num_bytes += bytes.size();
+    _changes.push_back(Change {sequence, std::move(bytes)});
+    // the newest change is always kept, even if larger than the retained bytes
+    while (_num_bytes > _retained_bytes && _changes.size() > 1)
+    {
+        _num_bytes -= _changes.front().bytes.size();
+        _changes.pop_front();
+    }
+    return true;
+}
+
+bool GalleryChangeLog::Read(uint64_t from, size_t max_bytes, std::vector<uint8_t>& buffer) const
+{
+    buffer.clear();
+    std::lock_guard<std::mutex> lock {_mutex};
+
+    const uint64_t first = _changes.empty() ? _next_sequence : _changes.front().sequence;
+    if (from < first || from > _next_sequence)
+    {
+        LOG_ERROR(LOG_TAG, "Change %llu is not retained (%llu..%llu)", static_cast<unsigned long long>(from),
+                  static_cast<unsigned long long>(first), static_cast<unsigned long long>(_next_sequence));
+        return false;
+    }
+
+    // sequence numbers of the retained changes are consecutive
+    const size_t begin = static_cast<size_t>(from - first);
+    size_t end = begin;
+    size_t payload_size = 0;
+    while (end < _changes.size() && (end == begin || payload_size + _changes[end].bytes.size() <= max_bytes))
+    {
+        payload_size += _changes[end].bytes.size();
+        end++;
+    }
+
+    buffer.resize(s_batchHeaderSize + payload_size + s_batchChecksumSize);
+    uint8_t* out = buffer.data();
+    ::memcpy(out, s_batchMagic, sizeof(s_batchMagic));
+    WriteUint64(out + sizeof(s_batchMagic), _epoch);
+    WriteUint64(out + sizeof(s_batchMagic) + 8, from);
+    WriteUint32(out + sizeof(s_batchMagic) + 16, static_cast<uint32_t>(end - begin));
+    out += s_batchHeaderSize;
+    for (size_t i = begin; i < end; i++)
+    {
+        ::memcpy(out, _changes[i].bytes.data(), _changes[i].bytes.size());
+        out += _changes[i].bytes.size();
+    }
+    WriteUint32(out, Checksum(buffer.data(), s_batchHeaderSize + payload_size));
+    return true;
+}
+
+bool GalleryChangeLog::Decode(const uint8_t* buffer, size_t buffer_size, uint64_t& epoch, const apply_func& apply)
+{
+    if (buffer == nullptr || buffer_size < s_batchHeaderSize + s_batchChecksumSize ||
+        ::memcmp(buffer, s_batchMagic, sizeof(s_batchMagic)) != 0)
+    {
+        LOG_ERROR(LOG_TAG, "Not a gallery change batch");
+        return false;
+    }
+    const size_t payload_end = buffer_size - s_batchChecksumSize;
+    if (ReadUint32(buffer + payload_end) != Checksum(buffer, payload_end))
+    {
+        LOG_ERROR(LOG_TAG, "Change batch checksum mismatch");
+        return false;
+    }
+
+    epoch = ReadUint64(buffer + sizeof(s_batchMagic));
+    uint64_t sequence = ReadUint64(buffer + sizeof(s_batchMagic) + 8);
+    const uint32_t count = ReadUint32(buffer + sizeof(s_batchMagic) + 16);
+    const uint8_t* in = buffer + s_batchHeaderSize;
+    const uint8_t* end = buffer + payload_end;
+
+    char user_id[FaceprintsGallery::MaxUserIdLength];
+    Faceprints faceprints;
+    for (uint32_t i = 0; i < count; i++, sequence++)
+    {
+        if (end - in < 2 || *in < static_cast<uint8_t>(Operation::Enroll) ||
+            *in > static_cast<uint8_t>(Operation::Remove))
+        {
+            LOG_ERROR(LOG_TAG, "Invalid change %llu", static_cast<unsigned long long>(sequence));
+            return false;
+        }
+        const auto operation = static_cast<Operation>(*in++);
+        const uint8_t id_length = *in++;
+        if (id_length >= sizeof(user_id) || static_cast<size_t>(end - in) < id_length)
+        {
+            LOG_ERROR(LOG_TAG, "Invalid user id in change %llu", static_cast<unsigned long long>(sequence));
+            return false;
+        }
+        ::memset(user_id, 0, sizeof(user_id));
+        ::memcpy(user_id, in, id_length);
+        in += id_length;
+
+        if (operation != Operation::Remove)
+        {
+            size_t size = FaceprintsCodec::Decode(in, static_cast<size_t>(end - in), faceprints);
+            if (size == 0)
+            {
+                return false;
+            }
+            in += size;
+        }
+        if (!apply(sequence, operation, user_id, operation != Operation::Remove ? &faceprints : nullptr))
+        {
+            return false;
+        }
+    }
+
+    if (in != end)
+    {
+        LOG_ERROR(LOG_TAG, "Trailing data in change batch");
+        return false;
+    }
+    return true;
+}
+
+bool GalleryReplica::Apply(const uint8_t* buffer, size_t buffer_size)
+{
+    uint64_t epoch = 0;
+    // Decode() sets the epoch before the first change
+    auto apply = [this, &epoch](uint64_t sequence, GalleryChangeLog::Operation operation, const char* user_id,
+                                const Faceprints* faceprints) {
+        if (epoch != _epoch)
+        {
+            return false;
+        }
+        if (sequence < _next_sequence)
+        {
+            return true; // applied by an earlier batch
+        }
+        if (sequence > _next_sequence)
+        {
+            LOG_ERROR(LOG_TAG, "Replica missed changes %llu..%llu", static_cast<unsigned long long>(_next_sequence),
+                      static_cast<unsigned long long>(sequence - 1));
+            return false;
+        }
+
+        bool applied = false;
+        switch (operation)
+        {
+        case GalleryChangeLog::Operation::Enroll:
+            applied = _database.Enroll(user_id, *faceprints);
+            break;
+        case GalleryChangeLog::Operation::Update:
+            applied = _database.Update(user_id, *faceprints);
+            break;
+        case GalleryChangeLog::Operation::Remove:
+            applied = _database.Remove(user_id);
+            break;
+        }
+        if (!applied)
+        {
+            LOG_ERROR(LOG_TAG, "Replica failed to apply change %llu of user %s",
+                      static_cast<unsigned long long>(sequence), user_id);
+            return false;
+        }
+        _next_sequence++;
+        return true;
+    };
+
+    bool decoded = GalleryChangeLog::Decode(buffer, buffer_size, epoch, apply);
+    if (epoch != _epoch)
+    {
+        LOG_ERROR(LOG_TAG, "Change batch of another primary epoch, the replica must be copied again");
+        return false;
+    }
+    return decoded;
+}
+} // namespace RealSenseID
@@ -0,0 +1,124 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsJournal.h"
+#include "RealSenseID/Faceprints.h"
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+class FaceprintsDatabase;
+
+/**
+ * Replication stream of the changes of a primary's gallery (see FaceprintsDatabase::SetChangeLog()), for hot standby
+ * hosts that apply them incrementally (see GalleryReplica) instead of re-exporting the whole gallery.
+ * Each change (enroll, update, remove) gets the next sequence number and is kept encoded (user id and
+ * FaceprintsCodec packed descriptors) until the retained bytes are exceeded, the oldest changes are dropped first.
+ * Read() returns the changes from a sequence number on as a checksummed batch. The epoch is chosen at construction,
+ * so a replica can tell the sequence numbers of a restarted primary from the old ones.
+ * Thread safe: the primary appends while a replication thread reads.
+ *
+ * Batch (little endian): "RSIDCLG" | epoch u64 | first sequence u64 | count u32 |
+ *   (operation u8 | user id length u8 | user id | codec record unless remove) per change | fnv-1a u32
+ */
+class GalleryChangeLog
+{
+public:
+    using Operation = FaceprintsJournal::Operation;
+    using apply_func = std::function<bool(uint64_t sequence, Operation operation, const char* user_id,
+                                          const Faceprints* faceprints)>;
+
+    static constexpr size_t DefaultRetainedBytes = 16 * 1024 * 1024;
+
+    explicit GalleryChangeLog(size_t retained_bytes = DefaultRetainedBytes);
+
+    GalleryChangeLog(const GalleryChangeLog&) = delete;
+    GalleryChangeLog& operator=(const GalleryChangeLog&) = delete;
+
+    uint64_t Epoch() const
+    {
+        return _epoch;
+    }
+
+    // sequence number of the next change. a replica copied from the primary's gallery follows from here.
+    uint64_t NextSequence() const;
+
+    // oldest retained sequence number (NextSequence() if none is retained)
+    uint64_t FirstSequence() const;
+
+    // record a change. faceprints is ignored for Operation::Remove. returns false if the change can not be encoded
+    // (features out of range): its sequence number is skipped and the retained changes are dropped, so the replicas
+    // fail to read past it and are copied again instead of missing it.
+    bool Append(Operation operation, const char* user_id, const Faceprints* faceprints);
+
+    // encode the changes from sequence from on into buffer, at most max_bytes of changes (at least one). buffer has no
+    // changes if the replica is up to date. returns false if from was already dropped (the replica must be copied
+    // again) or is beyond NextSequence().
+    bool Read(uint64_t from, size_t max_bytes, std::vector<uint8_t>& buffer) const;
+
+    // decode a batch and call apply() for each change in order, stops if apply() returns false.
+    // returns false if the batch is invalid or apply() failed. epoch is set from the batch.
+    static bool Decode(const uint8_t* buffer, size_t buffer_size, uint64_t& epoch, const apply_func& apply);
+
+private:
+    struct Change
+    {
+        uint64_t sequence;
+        std::vector<uint8_t> bytes; // operation | user id length | user id | codec record
+    };
+
+    uint64_t _epoch;
+    size_t _retained_bytes;
+    mutable std::mutex _mutex;
+    std::deque<Change> _changes;
+    size_t _num_bytes = 0;
+    uint64_t _next_sequence = 0;
+};
+
+/**
+ * Standby side of the replication stream: applies the batches of the primary's GalleryChangeLog to a local
+ * FaceprintsDatabase, so the standby's gallery is persistent, indexed and ready to match on failover.
+ * Changes before NextSequence() are skipped (a batch can be applied again), a gap or another epoch fails.
+ */
+class GalleryReplica
+{
+public:
+    explicit GalleryReplica(FaceprintsDatabase& database) : _database {database}
+    {
+    }
+
+    // follow a primary at the given position, e.g. when the database was copied from the primary at
+    // (GalleryChangeLog::Epoch(), GalleryChangeLog::NextSequence()).
+    void Reset(uint64_t epoch, uint64_t next_sequence)
+    {
+        _epoch = epoch;
+        _next_sequence = next_sequence;
+    }
+
+    // apply a batch of GalleryChangeLog::Read(NextSequence(), ..). returns false if the batch is invalid, is of
+    // another epoch or stream position (the database must be copied again), or a change could not be applied.
+    bool Apply(const uint8_t* buffer, size_t buffer_size);
+
+    uint64_t Epoch() const
+    {
+        return _epoch;
+    }
+
+    uint64_t NextSequence() const
+    {
+        return _next_sequence;
+    }
+
+private:
+    FaceprintsDatabase& _database;
+    uint64_t _epoch = 0;
+    uint64_t _next_sequence = 0;
+};
+} // namespace RealSenseID
@@ -0,0 +1,148 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "GalleryGroups.h"
+#include <algorithm>
+#include <utility>
+
+namespace RealSenseID
+{
+void GalleryGroups::Add()
+{
+    _entry_groups.emplace_back();
+}
+
+bool GalleryGroups::Remove(size_t index)
+{
+    size_t size = _entry_groups.size();
+    if (index >= size)
+    {
+        return false;
+    }
+
+    UnassignEntry(index);
+    // the gallery moves the last entry into the removed entry's place
+    size_t last = size - 1;
+    if (index != last)
+    {
+        for (auto& membership : _entry_groups[last])
+        {
+            _members[membership.group][membership.position] = static_cast<uint32_t>(index);
+        }
+        _entry_groups[index] = std::move(_entry_groups[last]);
+    }
+    _entry_groups.pop_back();
+    return true;
+}
+
+void GalleryGroups::Clear()
+{
+    _members.clear();
+    _entry_groups.clear();
+}
+
+void GalleryGroups::Reserve(size_t capacity)
+{
+    _entry_groups.reserve(capacity);
+}
+
+bool GalleryGroups::SetGroups(size_t index, const uint32_t* groups, size_t count)
+{
+    if (index >= _entry_groups.size() || (groups == nullptr && count > 0))
+    {
+        return false;
+    }
+
+    UnassignEntry(index);
+    auto& entry_groups = _entry_groups[index];
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint32_t group = groups[i];
+        bool exists = std::any_of(entry_groups.begin(), entry_groups.end(),
+                                  [group](const Membership& membership) { return membership.group == group; });
+        if (exists)
+        {
+            continue;
+        }
+        auto& members = _members[group];
+        entry_groups.push_back({group, static_cast<uint32_t>(members.size())});
+        members.push_back(static_cast<uint32_t>(index));
+    }
+    return true;
+}
+
+void GalleryGroups::GetGroups(size_t index, std::vector<uint32_t>& groups) const
+{
+    groups.clear();
+    if (index >= _entry_groups.size())
+    {
+        return;
+    }
+    for (auto& membership : _entry_groups[index])
+    {
+        groups.push_back(membership.group);
+    }
+}
+
+size_t GalleryGroups::GroupSize(uint32_t group) const
+{
+    auto it = _members.find(group);
+    return it != _members.end() ? it->second.size() : 0;
+}
+
+void GalleryGroups::GetMembers(const uint32_t* groups, size_t count, std::vector<uint32_t>& rows) const
+{
+    rows.clear();
+    if (groups == nullptr)
+    {
+        return;
+    }
+
+    size_t num_rows = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        num_rows += GroupSize(groups[i]);
+    }
+    rows.reserve(num_rows);
+    for (size_t i = 0; i < count; i++)
+    {
+        auto it = _members.find(groups[i]);
+        if (it != _members.end())
+        {
+            rows.insert(rows.end(), it->second.begin(), it->second.end());
+        }
+    }
+
+    // gallery order, so the scoped search keeps the matcher's first-match semantics
+    std::sort(rows.begin(), rows.end());
+    if (count > 1)
+    {
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    }
+}
+
+void GalleryGroups::UnassignEntry(size_t index)
+{
+    for (auto& membership : _entry_groups[index])
+    {
+        auto it = _members.find(membership.group);
+        auto& members = it->second;
+        const uint32_t moved = members.back();
+        members[membership.position] = moved;
+        for (auto& moved_membership : _entry_groups[moved])
+        {
+            if (moved_membership.group == membership.group)
+            {
+                moved_membership.position = membership.position;
+                break;
+            }
+        }
+        members.pop_back();
+        if (members.empty())
+        {
+            _members.erase(it);
+        }
+    }
+    _entry_groups[index].clear();
+}
+} // namespace RealSenseID
@@ -0,0 +1,63 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Group membership (e.g. sites or floors with their own access lists) of the entries of a packed gallery, for searches
+ * scoped to the members of some groups (see Matcher::MatchFaceprintsToArray()). Each group keeps the gallery indices
+ * of its members, so a scoped search touches only those entries.
+ * Entries are identified by their gallery indices, the owner of the gallery keeps both in sync: Add() for each entry
+ * added to the gallery and Remove() for each removed one.
+ */
+class GalleryGroups
+{
+public:
+    // entry appended to the gallery, with no groups.
+    void Add();
+
+    // entry removed from the gallery, same index semantics as FaceprintsGallery::Remove().
+    // returns false if index is out of range.
+    bool Remove(size_t index);
+
+    void Clear();
+    void Reserve(size_t capacity);
+
+    // number of entries
+    size_t Size() const
+    {
+        return _entry_groups.size();
+    }
+
+    // replace the groups of the entry (duplicates are ignored). returns false if index is out of range.
+    bool SetGroups(size_t index, const uint32_t* groups, size_t count);
+
+    // groups of the entry, empty if index is out of range.
+    void GetGroups(size_t index, std::vector<uint32_t>& groups) const;
+
+    // number of members of the group
+    size_t GroupSize(uint32_t group) const;
+
+    // gallery indices of the members of any of the groups, in ascending order (once each).
+    void GetMembers(const uint32_t* groups, size_t count, std::vector<uint32_t>& rows) const;
+
+private:
+    struct Membership
+    {
+        uint32_t group;
+        uint32_t position; // position of the entry in the group's members
+    };
+
+    void UnassignEntry(size_t index);
+
+    std::unordered_map<uint32_t, std::vector<uint32_t>> _members; // gallery indices per group
+    std::vector<std::vector<Membership>> _entry_groups;           // groups of each gallery entry
+};
+} // namespace RealSenseID
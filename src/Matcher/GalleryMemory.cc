@@ -0,0 +1,162 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "GalleryMemory.h"
+#include "Logger.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif // __linux__
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "GalleryMemory";
+
+namespace GalleryMemory
+{
+static size_t RoundToHugePages(size_t bytes)
+{
+    return (bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+}
+
+#ifdef __linux__
+// cpu list of the kernel (e.g. "0-15,32-47")
+static bool ParseCpuList(const std::string& list, std::vector<int>& cpus)
+{
+    cpus.clear();
+    size_t pos = 0;
+    while (pos < list.size())
+    {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+        {
+            end = list.size();
+        }
+        const std::string range = list.substr(pos, end - pos);
+        int first = 0, last = 0;
+        const int fields = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (fields < 1 || first < 0)
+        {
+            return false;
+        }
+        if (fields == 1)
+        {
+            last = first;
+        }
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+        pos = end + 1;
+    }
+    return !cpus.empty();
+}
+
+static bool ReadLine(const std::string& path, std::string& line)
+{
+    std::ifstream file {path};
+    return file && std::getline(file, line);
+}
+#endif // __linux__
+
+void* AllocateLarge(size_t bytes)
+{
+#ifdef __linux__
+    const size_t length = RoundToHugePages(bytes);
+    void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+    {
+        return p;
+    }
+#endif // MAP_HUGETLB
+    // no huge page pool - regular pages, promoted to transparent huge pages by the kernel
+    p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        return nullptr;
+    }
+#ifdef MADV_HUGEPAGE
+    ::madvise(p, length, MADV_HUGEPAGE);
+#endif // MADV_HUGEPAGE
+    return p;
+#else
+    return std::malloc(bytes);
+#endif // __linux__
+}
+
+void FreeLarge(void* p, size_t bytes)
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+#ifdef __linux__
+    ::munmap(p, RoundToHugePages(bytes));
+#else
+    (void)bytes;
+    std::free(p);
+#endif // __linux__
+}
+
+size_t NumNodes()
+{
+#ifdef __linux__
+    std::string line;
+    std::vector<int> nodes;
+    if (ReadLine("/sys/devices/system/node/online", line) && ParseCpuList(line, nodes))
+    {
+        return static_cast<size_t>(nodes.back()) + 1;
+    }
+#endif // __linux__
+    return 1;
+}
+
+bool GetNodeCpus(size_t node, std::vector<int>& cpus)
+{
+    cpus.clear();
+#ifdef __linux__
+    std::string line;
+    const std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+    if (ReadLine(path, line) && ParseCpuList(line, cpus))
+    {
+        return true;
+    }
+#else
+    (void)node;
+#endif // __linux__
+    return false;
+}
+
+bool PinCurrentThread(const std::vector<int>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    if (CPU_COUNT(&set) == 0 || ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) != 0)
+    {
+        LOG_WARNING(LOG_TAG, "Failed pinning thread to %zu cpus", cpus.size());
+        return false;
+    }
+    return true;
+#else
+    (void)cpus;
+    return false;
+#endif // __linux__
+}
+} // namespace GalleryMemory
+} // namespace RealSenseID
@@ -0,0 +1,39 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Memory placement of large in-memory galleries.
+ * Huge pages: a scan over millions of avg vectors touches a new 4 KB page every 8 rows, so the TLB misses add up.
+ * Allocations of at least HugePageSize are mapped with explicit huge pages (MAP_HUGETLB) when the system has a pool
+ * of them, and with transparent huge pages (MADV_HUGEPAGE) otherwise.
+ * NUMA: memory is placed on the node of the thread that first touches it, so a shard filled and searched by threads
+ * pinned to one node (see NumaGalleryShard) stays local to that node.
+ * Linux only, the other platforms use the regular allocations and do not pin threads.
+ */
+namespace GalleryMemory
+{
+static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+// allocate bytes (page aligned), huge page backed if possible. returns nullptr on failure.
+void* AllocateLarge(size_t bytes);
+
+// free memory returned by AllocateLarge() of the same size.
+void FreeLarge(void* p, size_t bytes);
+
+// number of numa nodes (1 if unknown).
+size_t NumNodes();
+
+// cpus of the numa node. returns false if unknown.
+bool GetNodeCpus(size_t node, std::vector<int>& cpus);
+
+// pin the calling thread to the given cpus. returns false if not supported or failed.
+bool PinCurrentThread(const std::vector<int>& cpus);
+} // namespace GalleryMemory
+} // namespace RealSenseID
@@ -0,0 +1,123 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "GalleryUpdateQueue.h"
+#include "ThreadConfigImpl.h"
+#include "Matcher.h"
+#include "Logger.h"
+#include <cstring>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "GalleryUpdateQueue";
+
+GalleryUpdateQueue::GalleryUpdateQueue(FaceprintsGallery& gallery, std::mutex& gallery_mutex) :
+    _gallery {gallery}, _gallery_mutex {gallery_mutex}
+{
+    _worker = std::thread {&GalleryUpdateQueue::WorkerLoop, this};
+}
+
+GalleryUpdateQueue::~GalleryUpdateQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _should_stop = true;
+    }
+    _work_cv.notify_one();
+    _worker.join();
+}
+
+void GalleryUpdateQueue::Push(size_t index, const char* user_id, const Faceprints& new_faceprints)
+{
+    Update update;
+    update.index = index;
+    ::strncpy(update.user_id, user_id, sizeof(update.user_id) - 1);
+    update.faceprints = new_faceprints;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _pending.push_back(update);
+    }
+    _work_cv.notify_one();
+}
+
+void GalleryUpdateQueue::Flush()
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    _done_cv.wait(lock, [this] { return _pending.empty() && !_applying; });
+}
+
+size_t GalleryUpdateQueue::Pending() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _pending.size();
+}
+
+size_t GalleryUpdateQueue::Applied() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _applied;
+}
+
+size_t GalleryUpdateQueue::Dropped() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _dropped;
+}
+
+void GalleryUpdateQueue::WorkerLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Matcher, "gallery-upd");
+    std::vector<Update> updates;
+    std::unique_lock<std::mutex> lock {_mutex};
+    while (true)
+    {
+        // the pending updates are applied before stopping
+        _work_cv.wait(lock, [this] { return _should_stop || !_pending.empty(); });
+        if (_pending.empty())
+        {
+            return;
+        }
+        updates.swap(_pending);
+        _applying = true;
+        lock.unlock();
+
+        Apply(updates);
+        updates.clear();
+
+        lock.lock();
+        _applying = false;
+        _done_cv.notify_all();
+    }
+}
+
+void GalleryUpdateQueue::Apply(const std::vector<Update>& updates)
+{
+    std::vector<size_t> indices;
+    std::vector<Faceprints> faceprints;
+    indices.reserve(updates.size());
+    faceprints.reserve(updates.size());
+
+    size_t applied = 0;
+    {
+        std::lock_guard<std::mutex> gallery_lock {_gallery_mutex};
+        for (const auto& update : updates)
+        {
+            if (update.index < _gallery.Size() && ::strcmp(_gallery.UserId(update.index), update.user_id) == 0)
+            {
+                indices.push_back(update.index);
+                faceprints.push_back(update.faceprints);
+            }
+        }
+        applied = Matcher::UpdateGalleryBatch(_gallery, indices, faceprints);
+    }
+
+    const size_t dropped = updates.size() - applied;
+    if (dropped > 0)
+    {
+        LOG_DEBUG(LOG_TAG, "Dropped %zu of %zu updates", dropped, updates.size());
+    }
+    std::lock_guard<std::mutex> lock {_mutex};
+    _applied += applied;
+    _dropped += dropped;
+}
+} // namespace RealSenseID
@@ -0,0 +1,77 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include "RealSenseID/Faceprints.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Background updater of a packed gallery.
+ * The batch match with a queue (see Matcher::MatchFaceprintsBatch()) returns right after the decisions and pushes the
+ * faceprints of the users to update here, a worker thread blends them into the gallery (Matcher::UpdateGalleryBatch(),
+ * updates of the same user in push order).
+ * The worker changes the gallery with gallery_mutex locked, hold it while matching against or changing the gallery.
+ * An update is dropped if its entry was removed or given to another user in the meantime.
+ */
+class GalleryUpdateQueue
+{
+public:
+    GalleryUpdateQueue(FaceprintsGallery& gallery, std::mutex& gallery_mutex);
+
+    // applies the pending updates
+    ~GalleryUpdateQueue();
+
+    GalleryUpdateQueue(const GalleryUpdateQueue&) = delete;
+    GalleryUpdateQueue& operator=(const GalleryUpdateQueue&) = delete;
+
+    const FaceprintsGallery& Gallery() const
+    {
+        return _gallery;
+    }
+
+    // queue an update of the given entry with the new faceprints it was matched to. returns immediately.
+    void Push(size_t index, const char* user_id, const Faceprints& new_faceprints);
+
+    // block until all the updates pushed so far are applied (or dropped).
+    void Flush();
+
+    size_t Pending() const;
+
+    // updates blended into the gallery / dropped since construction
+    size_t Applied() const;
+    size_t Dropped() const;
+
+private:
+    struct Update
+    {
+        size_t index = 0;
+        char user_id[FaceprintsGallery::MaxUserIdLength] = {0};
+        Faceprints faceprints;
+    };
+
+    void WorkerLoop();
+    void Apply(const std::vector<Update>& updates);
+
+    FaceprintsGallery& _gallery;
+    std::mutex& _gallery_mutex;
+
+    mutable std::mutex _mutex; // guards all below
+    std::condition_variable _work_cv;
+    std::condition_variable _done_cv;
+    std::vector<Update> _pending;
+    bool _applying = false;
+    bool _should_stop = false;
+    size_t _applied = 0;
+    size_t _dropped = 0;
+
+    std::thread _worker;
+};
+} // namespace RealSenseID
@@ -0,0 +1,130 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "HotUserCache.h"
+
+namespace RealSenseID
+{
+void HotUserCache::SetCapacity(size_t capacity)
+{
+    _capacity = capacity;
+    while (Size() > _capacity)
+    {
+        Evict(LeastRecentlyUsed());
+    }
+    _hot.Reserve(_capacity);
+}
+
+ExtendedMatchResult HotUserCache::Match(const Faceprints& new_faceprints, Faceprints& updated_faceprints)
+{
+    if (_hot.Empty())
+    {
+        return ExtendedMatchResult {};
+    }
+    auto result = Matcher::MatchFaceprintsToArray(new_faceprints, _hot, updated_faceprints);
+    if (!result.isSame || result.userId < 0)
+    {
+        result.isSame = false;
+        return result;
+    }
+    auto position = static_cast<size_t>(result.userId);
+    _last_used[position] = ++_clock;
+    result.userId = static_cast<int>(_gallery_indices[position]);
+    return result;
+}
+
+bool HotUserCache::Insert(const FaceprintsGallery& gallery, size_t index)
+{
+    if (_capacity == 0 || index >= gallery.Size())
+    {
+        return false;
+    }
+
+    Faceprints faceprints;
+    gallery.GetFaceprints(index, faceprints);
+    int position = Position(index);
+    if (position >= 0)
+    {
+        _hot.Update(static_cast<size_t>(position), faceprints);
+        _last_used[position] = ++_clock;
+        return true;
+    }
+
+    if (Size() >= _capacity)
+    {
+        Evict(LeastRecentlyUsed());
+    }
+    _hot.Add(gallery.UserId(index), faceprints);
+    _gallery_indices.push_back(index);
+    _last_used.push_back(++_clock);
+    return true;
+}
+
+void HotUserCache::Update(size_t index, const Faceprints& faceprints)
+{
+    int position = Position(index);
+    if (position >= 0)
+    {
+        _hot.Update(static_cast<size_t>(position), faceprints);
+    }
+}
+
+void HotUserCache::Remove(size_t index, size_t last_index)
+{
+    int position = Position(index);
+    if (position >= 0)
+    {
+        Evict(static_cast<size_t>(position));
+    }
+    if (index != last_index)
+    {
+        position = Position(last_index);
+        if (position >= 0)
+        {
+            _gallery_indices[position] = index;
+        }
+    }
+}
+
+void HotUserCache::Clear()
+{
+    _hot.Clear();
+    _gallery_indices.clear();
+    _last_used.clear();
+}
+
+int HotUserCache::Position(size_t index) const
+{
+    for (size_t position = 0; position < _gallery_indices.size(); position++)
+    {
+        if (_gallery_indices[position] == index)
+        {
+            return static_cast<int>(position);
+        }
+    }
+    return -1;
+}
+
+size_t HotUserCache::LeastRecentlyUsed() const
+{
+    size_t oldest = 0;
+    for (size_t position = 1; position < _last_used.size(); position++)
+    {
+        if (_last_used[position] < _last_used[oldest])
+        {
+            oldest = position;
+        }
+    }
+    return oldest;
+}
+
+// same move of the last entry as FaceprintsGallery::Remove()
+void HotUserCache::Evict(size_t position)
+{
+    _hot.Remove(position);
+    _gallery_indices[position] = _gallery_indices.back();
+    _gallery_indices.pop_back();
+    _last_used[position] = _last_used.back();
+    _last_used.pop_back();
+}
+} // namespace RealSenseID
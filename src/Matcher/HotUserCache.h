@@ -0,0 +1,71 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include "Matcher.h"
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Small set of the most recently matched users of a packed gallery, searched before the gallery itself (the same few
+ * hundred people pass a door many times a day). The hot users are copied into a packed gallery of their own, small
+ * enough to stay cache resident, so a hit costs a scan of Capacity() users whatever the size of the full gallery.
+ * A hit is a score above the strong threshold, the same decision as the early exit of the full scan.
+ * Entries are identified by their gallery indices, the owner of the gallery keeps both in sync: Update() and Remove()
+ * for each updated or removed gallery entry, Clear() when the gallery is cleared. Least recently used entries are
+ * evicted by Insert().
+ */
+class HotUserCache
+{
+public:
+    // 0 - disabled (Match() never hits and Insert() does nothing). Entries beyond a smaller capacity are dropped.
+    void SetCapacity(size_t capacity);
+
+    size_t Capacity() const
+    {
+        return _capacity;
+    }
+
+    size_t Size() const
+    {
+        return _gallery_indices.size();
+    }
+
+    // match against the hot users (internal thresholds). on a hit, result.userId is the gallery index of the user,
+    // who becomes the most recently used. result.isSame is false on a miss.
+    ExtendedMatchResult Match(const Faceprints& new_faceprints, Faceprints& updated_faceprints);
+
+    // cache gallery entry index (e.g. matched by the full scan) as the most recently used, evicting the least
+    // recently used one if full. returns false if disabled or index is out of range.
+    bool Insert(const FaceprintsGallery& gallery, size_t index);
+
+    // gallery entry index was updated, refresh its copy if cached.
+    void Update(size_t index, const Faceprints& faceprints);
+
+    // gallery entry index was removed, same index semantics as FaceprintsGallery::Remove() (last_index is the index
+    // of the last entry before the removal, moved to index).
+    void Remove(size_t index, size_t last_index);
+
+    void Clear();
+
+private:
+    // position of gallery entry index in the cache, -1 if not cached
+    int Position(size_t index) const;
+
+    // position of the entry with the oldest hit (the cache is not empty)
+    size_t LeastRecentlyUsed() const;
+
+    void Evict(size_t position);
+
+    size_t _capacity = 0;
+    FaceprintsGallery _hot;                // copies of the hot entries
+    std::vector<size_t> _gallery_indices;  // gallery index of each hot entry
+    std::vector<uint64_t> _last_used;      // _clock of the last hit of each hot entry
+    uint64_t _clock = 0;
+};
+} // namespace RealSenseID
@@ -0,0 +1,119 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace RealSenseID
+{
+/**
+ * Wrapper for concurrent in-place updates of a gallery container (FaceprintsGallery, FaceprintsIvfIndex) while
+ * other threads match against it, using the left-right technique (RCU-style epochs without reclamation).
+ * Two identical instances are kept. Readers never block: they register in the current epoch and read the active
+ * instance. A writer modifies the inactive instance, publishes it atomically, waits for the readers of the previous
+ * epoch to leave, and then repeats the modification on the other instance. Updates stay O(1) for O(1) operations
+ * (e.g. FaceprintsGallery::Update()) at the cost of doubling the gallery memory.
+ *
+ * The write function is applied twice, once to each instance, so it must be deterministic and must not consume
+ * its captures. Indices may change between Read() and Modify() (e.g. another writer removed a user), so updates
+ * found by a match should be verified inside Modify(), e.g.:
+ *
+ *   gallery.Read([&](const FaceprintsGallery& g) { result = Matcher::MatchFaceprintsToArray(q, g, updated); });
+ *   if (result.shouldUpdate)
+ *       gallery.Modify([&](FaceprintsGallery& g) {
+ *           if (g.Find(user_id) == result.userId) g.Update(result.userId, updated); });
+ */
+template <typename Gallery>
+class LeftRightGallery
+{
+public:
+    LeftRightGallery() = default;
+    LeftRightGallery(const LeftRightGallery&) = delete;
+    LeftRightGallery& operator=(const LeftRightGallery&) = delete;
+
+    // call read_func(const Gallery&) on the active instance and return its result. wait-free with respect to
+    // writers. read_func must not call Modify() on the same gallery.
+    template <typename ReadFunc>
+    auto Read(ReadFunc&& read_func) const -> decltype(read_func(std::declval<const Gallery&>()))
+    {
+        ReaderGuard guard {*this};
+        return read_func(_instances[_active.load()]);
+    }
+
+    // call write_func(Gallery&) on both instances. concurrent writers are serialized, readers are not blocked.
+    template <typename WriteFunc>
+    void Modify(WriteFunc&& write_func)
+    {
+        std::lock_guard<std::mutex> lock {_writer_mutex};
+        const int active = _active.load();
+        write_func(_instances[1 - active]);
+        _active.store(1 - active);
+        ToggleEpochAndWait();
+        write_func(_instances[active]);
+        _modifications.fetch_add(1);
+    }
+
+    // number of completed Modify() calls, readers can use it to detect changes between two Read() calls.
+    size_t Modifications() const
+    {
+        return _modifications.load();
+    }
+
+private:
+    // pad each counter to its own cache line, readers of both epochs touch them concurrently
+    struct ReadIndicator
+    {
+        std::atomic<size_t> readers {0};
+        char padding[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    struct ReaderGuard
+    {
+        explicit ReaderGuard(const LeftRightGallery& owner) :
+            indicator {owner._read_indicators[owner._epoch.load()]}
+        {
+            indicator.readers.fetch_add(1);
+        }
+
+        ~ReaderGuard()
+        {
+            indicator.readers.fetch_sub(1);
+        }
+
+        ReaderGuard(const ReaderGuard&) = delete;
+        ReaderGuard& operator=(const ReaderGuard&) = delete;
+
+        ReadIndicator& indicator;
+    };
+
+    // after the toggle no reader can still be reading the instance that was active before the last publish
+    void ToggleEpochAndWait()
+    {
+        const int previous = _epoch.load();
+        const int next = 1 - previous;
+        WaitForReaders(next);
+        _epoch.store(next);
+        WaitForReaders(previous);
+    }
+
+    void WaitForReaders(int epoch) const
+    {
+        while (_read_indicators[epoch].readers.load() != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    Gallery _instances[2];
+    std::atomic<int> _active {0};
+    std::atomic<int> _epoch {0};
+    mutable ReadIndicator _read_indicators[2];
+    std::atomic<size_t> _modifications {0};
+    std::mutex _writer_mutex;
+};
+} // namespace RealSenseID
@@ -0,0 +1,576 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MappedFaceprintsGallery.h"
+#include "Matcher.h"
+#include "MatcherThreadPool.h"
+#include "Logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "MappedFaceprintsGallery";
+
+// pages touched per warm up task
+static const size_t s_warmUpChunkSize = 16 * 1024 * 1024;
+
+static const char s_galleryFileMagic[8] = {'R', 'S', 'I', 'D', 'G', 'A', 'L', '\0'};
+
+uint64_t MappedFaceprintsGallery::AlignOffset(uint64_t offset)
+{
+    return (offset + FaceprintsGallery::RowAlignment - 1) / FaceprintsGallery::RowAlignment *
+           FaceprintsGallery::RowAlignment;
+}
+
+// sections are written in order, the gaps are zero padded (seeking past the end would not extend the file when the
+// last sections are empty).
+bool MappedFaceprintsGallery::WriteSection(std::ofstream& file, uint64_t offset, const void* data, size_t size)
+{
+    static const char padding[FaceprintsGallery::RowAlignment] = {0};
+    uint64_t position = static_cast<uint64_t>(file.tellp());
+    if (position > offset || offset - position > sizeof(padding))
+    {
+        return false;
+    }
+    file.write(padding, static_cast<std::streamsize>(offset - position));
+    if (size > 0)
+    {
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+    return file.good();
+}
+
+bool MappedFaceprintsGallery::ReplaceFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+    return ::MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif // _WIN32
+}
+
+MappedFaceprintsGallery::~MappedFaceprintsGallery()
+{
+    Close();
+}
+
+static GalleryFileHeader MakeHeader(size_t count, uint32_t generation)
+{
+    const size_t vectors_size = count * FaceprintsGallery::VectorLength * sizeof(feature_t);
+
+    GalleryFileHeader header;
+    ::memset(&header, 0, sizeof(header));
+    ::memcpy(header.magic, s_galleryFileMagic, sizeof(header.magic));
+    header.format_version = GalleryFileHeader::CurrentFormatVersion;
+    header.byte_order = GalleryFileHeader::ByteOrderMark;
+    header.header_size = sizeof(GalleryFileHeader);
+    header.vector_length = FaceprintsGallery::VectorLength;
+    header.user_id_length = FaceprintsGallery::MaxUserIdLength;
+    header.metadata_size = sizeof(FaceprintsGallery::Metadata);
+    header.sign_code_words = FaceprintsGallery::SignCodeWords;
+    header.generation = generation;
+    header.count = count;
+    header.avg_vectors_offset = MappedFaceprintsGallery::AlignOffset(sizeof(GalleryFileHeader));
+    header.orig_vectors_offset = MappedFaceprintsGallery::AlignOffset(header.avg_vectors_offset + vectors_size);
+    header.metadata_offset = MappedFaceprintsGallery::AlignOffset(header.orig_vectors_offset + vectors_size);
+    header.avg_norms_offset =
+        MappedFaceprintsGallery::AlignOffset(header.metadata_offset + count * sizeof(FaceprintsGallery::Metadata));
+    header.avg_norm_msbs_offset =
+        MappedFaceprintsGallery::AlignOffset(header.avg_norms_offset + count * sizeof(uint32_t));
+    header.sign_codes_offset =
+        MappedFaceprintsGallery::AlignOffset(header.avg_norm_msbs_offset + count * sizeof(short));
+    header.user_ids_offset = MappedFaceprintsGallery::AlignOffset(
+        header.sign_codes_offset + count * FaceprintsGallery::SignCodeWords * sizeof(uint64_t));
+    header.file_size = header.user_ids_offset + count * FaceprintsGallery::MaxUserIdLength;
+    return header;
+}
+
+bool MappedFaceprintsGallery::Save(const FaceprintsGallery& gallery, const std::string& path, uint32_t generation)
+{
+    const size_t count = gallery.Size();
+    const size_t vectors_size = count * FaceprintsGallery::VectorLength * sizeof(feature_t);
+    const GalleryFileHeader header = MakeHeader(count, generation);
+
+    std::vector<char> user_ids(count * FaceprintsGallery::MaxUserIdLength);
+    for (size_t i = 0; i < count; i++)
+    {
+        ::memcpy(&user_ids[i * FaceprintsGallery::MaxUserIdLength], gallery.UserId(i),
+                 FaceprintsGallery::MaxUserIdLength);
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to create gallery file %s", tmp_path.c_str());
+            return false;
+        }
+
+        bool ok = WriteSection(file, 0, &header, sizeof(header));
+        ok = ok && WriteSection(file, header.avg_vectors_offset, gallery.AvgVectorsData(), vectors_size);
+        ok = ok && WriteSection(file, header.orig_vectors_offset, count ? gallery.OrigVector(0) : nullptr,
+                                vectors_size);
+        ok = ok && WriteSection(file, header.metadata_offset, gallery.MetadataData(),
+                                count * sizeof(FaceprintsGallery::Metadata));
+        ok = ok && WriteSection(file, header.avg_norms_offset, gallery.AvgNormsData(), count * sizeof(uint32_t));
+        ok = ok && WriteSection(file, header.avg_norm_msbs_offset, gallery.AvgNormMsbsData(), count * sizeof(short));
+        ok = ok && WriteSection(file, header.sign_codes_offset, gallery.SignCodesData(),
+                                count * FaceprintsGallery::SignCodeWords * sizeof(uint64_t));
+        ok = ok && WriteSection(file, header.user_ids_offset, user_ids.data(), user_ids.size());
+        file.flush();
+        if (!ok || !file.good())
+        {
+            LOG_ERROR(LOG_TAG, "Failed to write gallery file %s", tmp_path.c_str());
+            file.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    if (!ReplaceFile(tmp_path, path))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to replace gallery file %s", path.c_str());
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    LOG_DEBUG(LOG_TAG, "Saved %zu users to %s", count, path.c_str());
+    return true;
+}
+
+void MappedFaceprintsGallery::BuildImage(const FaceprintsGallery& gallery, uint32_t generation, Image& image)
+{
+    const size_t count = gallery.Size();
+    const size_t vectors_size = count * FaceprintsGallery::VectorLength * sizeof(feature_t);
+    const GalleryFileHeader header = MakeHeader(count, generation);
+
+    // the padding between the sections is zero, as in the files
+    image.assign(static_cast<size_t>(header.file_size), 0);
+    unsigned char* data = image.data();
+    ::memcpy(data, &header, sizeof(header));
+    if (count == 0)
+    {
+        return;
+    }
+    ::memcpy(data + header.avg_vectors_offset, gallery.AvgVectorsData(), vectors_size);
+    ::memcpy(data + header.orig_vectors_offset, gallery.OrigVector(0), vectors_size);
+    ::memcpy(data + header.metadata_offset, gallery.MetadataData(), count * sizeof(FaceprintsGallery::Metadata));
+    ::memcpy(data + header.avg_norms_offset, gallery.AvgNormsData(), count * sizeof(uint32_t));
+    ::memcpy(data + header.avg_norm_msbs_offset, gallery.AvgNormMsbsData(), count * sizeof(short));
+    ::memcpy(data + header.sign_codes_offset, gallery.SignCodesData(),
+             count * FaceprintsGallery::SignCodeWords * sizeof(uint64_t));
+    for (size_t i = 0; i < count; i++)
+    {
+        ::memcpy(data + header.user_ids_offset + i * FaceprintsGallery::MaxUserIdLength, gallery.UserId(i),
+                 FaceprintsGallery::MaxUserIdLength);
+    }
+}
+
+bool MappedFaceprintsGallery::ReadGeneration(const std::string& path, uint32_t& generation)
+{
+    GalleryFileHeader header;
+    std::ifstream file(path, std::ios::binary);
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        return false;
+    }
+    if (::memcmp(header.magic, s_galleryFileMagic, sizeof(header.magic)) != 0 ||
+        header.format_version != GalleryFileHeader::CurrentFormatVersion ||
+        header.header_size != sizeof(GalleryFileHeader))
+    {
+        return false;
+    }
+    generation = header.generation;
+    return true;
+}
+
+bool MappedFaceprintsGallery::Open(const std::string& path)
+{
+    Close();
+
+    if (!MapFile(path))
+    {
+        return false;
+    }
+    return Attach(path);
+}
+
+bool MappedFaceprintsGallery::OpenImage(Image image, const std::string& name)
+{
+    Close();
+
+    if (image.empty())
+    {
+        LOG_ERROR(LOG_TAG, "Gallery image %s is empty", name.c_str());
+        return false;
+    }
+    _image = std::move(image);
+    _data = _image.data();
+    _data_size = _image.size();
+    return Attach(name);
+}
+
+bool MappedFaceprintsGallery::Attach(const std::string& name)
+{
+    GalleryFileHeader header;
+    if (_data_size < sizeof(header))
+    {
+        LOG_ERROR(LOG_TAG, "Gallery file %s is too small", name.c_str());
+        Close();
+        return false;
+    }
+    ::memcpy(&header, _data, sizeof(header));
+
+    if (!ValidateHeader(header, _data_size))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid gallery file %s", name.c_str());
+        Close();
+        return false;
+    }
+
+    _size = static_cast<size_t>(header.count);
+    _avg_vectors = reinterpret_cast<const feature_t*>(_data + header.avg_vectors_offset);
+    _orig_vectors = reinterpret_cast<const feature_t*>(_data + header.orig_vectors_offset);
+    _metadata = reinterpret_cast<const FaceprintsGallery::Metadata*>(_data + header.metadata_offset);
+    _avg_norms = reinterpret_cast<const uint32_t*>(_data + header.avg_norms_offset);
+    _avg_norm_msbs = reinterpret_cast<const short*>(_data + header.avg_norm_msbs_offset);
+    _sign_codes = reinterpret_cast<const uint64_t*>(_data + header.sign_codes_offset);
+    _user_ids = reinterpret_cast<const char*>(_data + header.user_ids_offset);
+    _generation = header.generation;
+
+    // validation invariant for the scan (only the small metadata section is touched)
+    _all_usable = true;
+    _has_uniform_version = true;
+    _version = _size > 0 ? _metadata[0].version : 0;
+    for (size_t i = 0; i < _size; i++)
+    {
+        _all_usable = _all_usable && FaceprintsGallery::IsUsable(_metadata[i]);
+        _has_uniform_version = _has_uniform_version && _metadata[i].version == _version;
+    }
+
+    _avg_norm_recips.resize(_size);
+    for (size_t i = 0; i < _size; i++)
+    {
+        _avg_norm_recips[i] = Matcher::CalculateNormReciprocal(_avg_norms[i]);
+    }
+
+    LOG_DEBUG(LOG_TAG, "Mapped %zu users from %s", _size, name.c_str());
+    return true;
+}
+
+
+static size_t PageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return static_cast<size_t>(info.dwPageSize);
+#else
+    long page_size = ::sysconf(_SC_PAGESIZE);
+    return page_size > 0 ? static_cast<size_t>(page_size) : 4096;
+#endif // _WIN32
+}
+
+bool MappedFaceprintsGallery::WarmUp(MatcherThreadPool& pool, bool lock_pages)
+{
+    if (_data == nullptr)
+    {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+#ifndef _WIN32
+    // read ahead by the kernel while the threads fault in the pages
+    if (_image.empty() && ::madvise(const_cast<unsigned char*>(_data), _data_size, MADV_WILLNEED) != 0)
+    {
+        LOG_DEBUG(LOG_TAG, "madvise(MADV_WILLNEED) failed");
+    }
+#endif // _WIN32
+
+    const size_t page_size = PageSize();
+    const size_t num_chunks = (_data_size + s_warmUpChunkSize - 1) / s_warmUpChunkSize;
+    std::atomic<unsigned int> checksum {0}; // keeps the reads
+    pool.Run(num_chunks, [&](size_t chunk) {
+        const size_t begin = chunk * s_warmUpChunkSize;
+        const size_t end = std::min(begin + s_warmUpChunkSize, _data_size);
+        unsigned int sum = 0;
+        for (size_t offset = begin; offset < end; offset += page_size)
+        {
+            sum += static_cast<const volatile unsigned char*>(_data)[offset];
+        }
+        checksum.fetch_add(sum, std::memory_order_relaxed);
+    });
+
+    bool locked = true;
+    if (lock_pages && !_is_locked)
+    {
+#ifdef _WIN32
+        locked = ::VirtualLock(const_cast<unsigned char*>(_data), _data_size) != 0;
+#else
+        locked = ::mlock(_data, _data_size) == 0;
+#endif // _WIN32
+        _is_locked = locked;
+        if (!locked)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to lock %zu bytes of the gallery file in memory", _data_size);
+        }
+    }
+
+    auto elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    LOG_DEBUG(LOG_TAG, "Warmed up %zu bytes in %lld ms%s", _data_size, static_cast<long long>(elapsed),
+              _is_locked ? " (locked)" : "");
+    return locked;
+}
+
+void MappedFaceprintsGallery::Close()
+{
+    if (!_image.empty())
+    {
+#ifdef _WIN32
+        if (_is_locked)
+        {
+            ::VirtualUnlock(_image.data(), _image.size());
+        }
+#else
+        if (_is_locked)
+        {
+            ::munlock(_image.data(), _image.size());
+        }
+#endif // _WIN32
+        _image.clear();
+        _image.shrink_to_fit();
+    }
+    else if (_data != nullptr)
+    {
+#ifdef _WIN32
+        if (_is_locked)
+        {
+            ::VirtualUnlock(const_cast<unsigned char*>(_data), _data_size);
+        }
+        ::UnmapViewOfFile(_data);
+#else
+        ::munmap(const_cast<unsigned char*>(_data), _data_size);
+#endif // _WIN32
+    }
+#ifdef _WIN32
+    if (_mapping_handle != nullptr)
+    {
+        ::CloseHandle(_mapping_handle);
+    }
+    if (_file_handle != nullptr)
+    {
+        ::CloseHandle(_file_handle);
+    }
+    _mapping_handle = nullptr;
+    _file_handle = nullptr;
+#endif // _WIN32
+
+    _data = nullptr;
+    _data_size = 0;
+    _is_locked = false; // munmap() unlocks the pages
+    _size = 0;
+    _avg_vectors = nullptr;
+    _orig_vectors = nullptr;
+    _metadata = nullptr;
+    _avg_norms = nullptr;
+    _avg_norm_msbs = nullptr;
+    _sign_codes = nullptr;
+    _user_ids = nullptr;
+    _avg_norm_recips.clear();
+    _avg_norm_recips.shrink_to_fit();
+    _generation = 0;
+    _all_usable = false;
+    _has_uniform_version = false;
+    _version = 0;
+}
+
+bool MappedFaceprintsGallery::GetFaceprints(size_t index, Faceprints& faceprints) const
+{
+    if (index >= _size)
+    {
+        return false;
+    }
+
+    auto& metadata = _metadata[index];
+    faceprints.version = metadata.version;
+    faceprints.numberOfDescriptors = metadata.numberOfDescriptors;
+    faceprints.featuresType = metadata.featuresType;
+    ::memcpy(&faceprints.avgDescriptor[0], AvgVector(index), FaceprintsGallery::VectorLength * sizeof(feature_t));
+    ::memcpy(&faceprints.origDescriptor[0], OrigVector(index), FaceprintsGallery::VectorLength * sizeof(feature_t));
+    return true;
+}
+
+int MappedFaceprintsGallery::Find(const char* user_id) const
+{
+    if (user_id == nullptr)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < _size; i++)
+    {
+        if (::strncmp(UserId(i), user_id, FaceprintsGallery::MaxUserIdLength) == 0)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool MappedFaceprintsGallery::MapFile(const std::string& path)
+{
+#ifdef _WIN32
+    // FILE_SHARE_DELETE lets a writer replace the file while it is mapped (see SharedGalleryWriter)
+    HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to open gallery file %s", path.c_str());
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!::GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to get size of gallery file %s", path.c_str());
+        ::CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to map gallery file %s", path.c_str());
+        ::CloseHandle(file);
+        return false;
+    }
+
+    void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to map gallery file %s", path.c_str());
+        ::CloseHandle(mapping);
+        ::CloseHandle(file);
+        return false;
+    }
+
+    _file_handle = file;
+    _mapping_handle = mapping;
+    _data = static_cast<const unsigned char*>(data);
+    _data_size = static_cast<size_t>(file_size.QuadPart);
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to open gallery file %s", path.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to get size of gallery file %s", path.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    void* data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to map gallery file %s", path.c_str());
+        return false;
+    }
+
+    _data = static_cast<const unsigned char*>(data);
+    _data_size = static_cast<size_t>(st.st_size);
+    return true;
+#endif // _WIN32
+}
+
+bool MappedFaceprintsGallery::ValidateHeader(const GalleryFileHeader& header, size_t file_size) const
+{
+    if (::memcmp(header.magic, s_galleryFileMagic, sizeof(header.magic)) != 0)
+    {
+        LOG_ERROR(LOG_TAG, "Not a gallery file");
+        return false;
+    }
+
+    if (header.format_version != GalleryFileHeader::CurrentFormatVersion)
+    {
+        LOG_ERROR(LOG_TAG, "Unsupported gallery file format version %u", header.format_version);
+        return false;
+    }
+
+    if (header.byte_order != GalleryFileHeader::ByteOrderMark || header.header_size != sizeof(GalleryFileHeader) ||
+        header.vector_length != FaceprintsGallery::VectorLength ||
+        header.user_id_length != FaceprintsGallery::MaxUserIdLength ||
+        header.metadata_size != sizeof(FaceprintsGallery::Metadata) ||
+        header.sign_code_words != FaceprintsGallery::SignCodeWords)
+    {
+        LOG_ERROR(LOG_TAG, "Gallery file layout mismatch");
+        return false;
+    }
+
+    // each user takes more than one byte, also keeps the section sizes below from overflowing
+    const uint64_t count = header.count;
+    if (count > file_size)
+    {
+        LOG_ERROR(LOG_TAG, "Gallery file count out of range");
+        return false;
+    }
+
+    const uint64_t vectors_size = count * FaceprintsGallery::VectorLength * sizeof(feature_t);
+    struct Section
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+    const Section sections[] = {
+        {header.avg_vectors_offset, vectors_size},
+        {header.orig_vectors_offset, vectors_size},
+        {header.metadata_offset, count * sizeof(FaceprintsGallery::Metadata)},
+        {header.avg_norms_offset, count * sizeof(uint32_t)},
+        {header.avg_norm_msbs_offset, count * sizeof(short)},
+        {header.sign_codes_offset, count * FaceprintsGallery::SignCodeWords * sizeof(uint64_t)},
+        {header.user_ids_offset, count * FaceprintsGallery::MaxUserIdLength},
+    };
+
+    if (header.file_size != file_size)
+    {
+        LOG_ERROR(LOG_TAG, "Gallery file size mismatch");
+        return false;
+    }
+
+    for (auto& section : sections)
+    {
+        if (section.offset % FaceprintsGallery::RowAlignment != 0 || section.offset < sizeof(GalleryFileHeader) ||
+            section.offset > file_size || section.size > file_size - section.offset)
+        {
+            LOG_ERROR(LOG_TAG, "Gallery file section out of range");
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace RealSenseID
@@ -0,0 +1,244 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include <cstddef>
+#include <iosfwd>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+class MatcherThreadPool;
+
+/**
+ * On-disk gallery file, the sections hold the packed FaceprintsGallery arrays as is, so a mapped file is matched
+ * with zero parsing. All sections start at a RowAlignment boundary.
+ *
+ *   header | avg vectors | orig vectors | metadata | avg norms | avg norm msbs | sign codes | user ids
+ */
+struct GalleryFileHeader
+{
+    static constexpr uint32_t CurrentFormatVersion = 1;
+    static constexpr uint32_t ByteOrderMark = 0x01020304;
+
+    char magic[8];               // "RSIDGAL"
+    uint32_t format_version;     // CurrentFormatVersion
+    uint32_t byte_order;         // ByteOrderMark as written by the host
+    uint32_t header_size;        // sizeof(GalleryFileHeader)
+    uint32_t vector_length;      // FaceprintsGallery::VectorLength
+    uint32_t user_id_length;     // FaceprintsGallery::MaxUserIdLength
+    uint32_t metadata_size;      // sizeof(FaceprintsGallery::Metadata)
+    uint32_t sign_code_words;    // FaceprintsGallery::SignCodeWords
+    uint32_t generation;         // snapshot generation of a shared gallery (see SharedGalleryWriter), 0 otherwise
+    uint64_t count;              // number of users
+    uint64_t avg_vectors_offset;
+    uint64_t orig_vectors_offset;
+    uint64_t metadata_offset;
+    uint64_t avg_norms_offset;
+    uint64_t avg_norm_msbs_offset;
+    uint64_t sign_codes_offset;
+    uint64_t user_ids_offset;
+    uint64_t file_size;
+};
+
+/**
+ * Read-only, memory mapped gallery file. Provides the same read accessors as FaceprintsGallery, so it can be matched
+ * directly. Pages are loaded on demand by the OS, opening a file only validates its header.
+ */
+class MappedFaceprintsGallery
+{
+public:
+    // in-memory copy of a gallery file (e.g. decrypted, see EncryptedGalleryFile)
+    using Image = std::vector<unsigned char, AlignedAllocator<unsigned char, FaceprintsGallery::RowAlignment>>;
+
+    MappedFaceprintsGallery() = default;
+    ~MappedFaceprintsGallery();
+
+    MappedFaceprintsGallery(const MappedFaceprintsGallery&) = delete;
+    MappedFaceprintsGallery& operator=(const MappedFaceprintsGallery&) = delete;
+
+    // write the gallery to the given path (via a temporary file that replaces path, so a crash never leaves a
+    // partial file behind), with the given generation in the header. returns false on failure.
+    static bool Save(const FaceprintsGallery& gallery, const std::string& path, uint32_t generation = 0);
+
+    // the bytes Save() would write for the gallery, into image
+    static void BuildImage(const FaceprintsGallery& gallery, uint32_t generation, Image& image);
+
+    // read only the header of the given file for its generation. returns false if the file is missing or is not a
+    // gallery file.
+    static bool ReadGeneration(const std::string& path, uint32_t& generation);
+
+    // file writing helpers, shared with the files stored alongside a gallery file (see FaceprintsIvfIndex::Save()).
+    // sections start at RowAlignment boundaries and are written in order, a temporary file replaces the target.
+    static uint64_t AlignOffset(uint64_t offset);
+    static bool WriteSection(std::ofstream& file, uint64_t offset, const void* data, size_t size);
+    static bool ReplaceFile(const std::string& from, const std::string& to);
+
+    // map the given file. returns false if the file is missing, invalid or was written with another layout.
+    bool Open(const std::string& path);
+    // use the given in-memory gallery file instead of a mapping (name is for the logs). returns false if the image is
+    // invalid or was written with another layout.
+    bool OpenImage(Image image, const std::string& name);
+    void Close();
+
+    // load the whole mapping before the first match, instead of faulting in the pages of the candidates one by one
+    // (after a restart the first matches of a large file would do that for minutes). The OS is asked to read the file
+    // ahead, then one byte per page is touched by the pool's threads. With lock_pages the pages are also pinned
+    // (mlock), so the OS can not evict them under memory pressure (needs a large enough memlock limit). returns false
+    // if locking failed, the pages are loaded anyway.
+    bool WarmUp(MatcherThreadPool& pool, bool lock_pages = false);
+
+    // pinned by WarmUp(), until Close()
+    bool IsLocked() const
+    {
+        return _is_locked;
+    }
+
+    bool IsOpen() const
+    {
+        return _data != nullptr;
+    }
+
+    // the whole mapped file (or image)
+    const unsigned char* Data() const
+    {
+        return _data;
+    }
+
+    size_t DataSize() const
+    {
+        return _data_size;
+    }
+
+    size_t Size() const
+    {
+        return _size;
+    }
+
+    bool Empty() const
+    {
+        return _size == 0;
+    }
+
+    // generation in the header of the mapped file
+    uint32_t Generation() const
+    {
+        return _generation;
+    }
+
+    // all entries are usable and have the given version (checked once on Open()).
+    bool IsValidated(int version) const
+    {
+        return _size == 0 || (_all_usable && _has_uniform_version && _version == version);
+    }
+
+    bool GetFaceprints(size_t index, Faceprints& faceprints) const;
+    int Find(const char* user_id) const;
+
+    const char* UserId(size_t index) const
+    {
+        return _user_ids + index * FaceprintsGallery::MaxUserIdLength;
+    }
+
+    const feature_t* AvgVector(size_t index) const
+    {
+        return _avg_vectors + index * FaceprintsGallery::VectorLength;
+    }
+
+    const feature_t* OrigVector(size_t index) const
+    {
+        return _orig_vectors + index * FaceprintsGallery::VectorLength;
+    }
+
+    const FaceprintsGallery::Metadata& GetMetadata(size_t index) const
+    {
+        return _metadata[index];
+    }
+
+    uint32_t AvgNorm(size_t index) const
+    {
+        return _avg_norms[index];
+    }
+
+    short AvgNormMsb(size_t index) const
+    {
+        return _avg_norm_msbs[index];
+    }
+
+    uint64_t AvgNormRecip(size_t index) const
+    {
+        return _avg_norm_recips[index];
+    }
+
+    const uint64_t* SignCode(size_t index) const
+    {
+        return _sign_codes + index * FaceprintsGallery::SignCodeWords;
+    }
+
+    const feature_t* AvgVectorsData() const
+    {
+        return _avg_vectors;
+    }
+
+    const FaceprintsGallery::Metadata* MetadataData() const
+    {
+        return _metadata;
+    }
+
+    const uint32_t* AvgNormsData() const
+    {
+        return _avg_norms;
+    }
+
+    const short* AvgNormMsbsData() const
+    {
+        return _avg_norm_msbs;
+    }
+
+    const uint64_t* AvgNormRecipsData() const
+    {
+        return _avg_norm_recips.data();
+    }
+
+    const uint64_t* SignCodesData() const
+    {
+        return _sign_codes;
+    }
+
+private:
+    bool MapFile(const std::string& path);
+    // set up the accessors from the header of _data. closes and returns false if it is invalid.
+    bool Attach(const std::string& name);
+    bool ValidateHeader(const GalleryFileHeader& header, size_t file_size) const;
+
+    const unsigned char* _data = nullptr;
+    size_t _data_size = 0;
+    bool _is_locked = false;
+    Image _image; // backs _data if opened with OpenImage()
+#ifdef _WIN32
+    void* _file_handle = nullptr;
+    void* _mapping_handle = nullptr;
+#endif // _WIN32
+
+    size_t _size = 0;
+    const feature_t* _avg_vectors = nullptr;
+    const feature_t* _orig_vectors = nullptr;
+    const FaceprintsGallery::Metadata* _metadata = nullptr;
+    const uint32_t* _avg_norms = nullptr;
+    const short* _avg_norm_msbs = nullptr;
+    const uint64_t* _sign_codes = nullptr;
+    const char* _user_ids = nullptr;
+
+    // derived from the norms section at Open() (kept out of the file format)
+    std::vector<uint64_t> _avg_norm_recips;
+
+    uint32_t _generation = 0;
+    bool _all_usable = false;
+    bool _has_uniform_version = false;
+    int _version = 0;
+};
+} // namespace RealSenseID
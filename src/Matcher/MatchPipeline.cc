@@ -0,0 +1,194 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MatchPipeline.h"
+#include "ThreadConfigImpl.h"
+#include "Logger.h"
+#include <cstring>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "MatchPipeline";
+
+MatchPipeline::MatchPipeline(match_func match, MatchResultCallback& callback, unsigned int num_workers,
+                             size_t queue_capacity) :
+    _match {std::move(match)},
+    _callback {callback}, _queue_capacity {queue_capacity}
+{
+    if (num_workers == 0)
+    {
+        num_workers = std::thread::hardware_concurrency();
+    }
+    if (num_workers == 0)
+    {
+        num_workers = 1;
+    }
+    if (_queue_capacity == 0)
+    {
+        _queue_capacity = 1;
+    }
+
+    for (unsigned int i = 0; i < num_workers; i++)
+    {
+        _workers.emplace_back(&MatchPipeline::WorkerLoop, this);
+    }
+    LOG_DEBUG(LOG_TAG, "Created match pipeline with %u workers, queue capacity %zu", num_workers, _queue_capacity);
+}
+
+MatchPipeline::~MatchPipeline()
+{
+    Stop();
+}
+
+bool MatchPipeline::Enqueue(const Faceprints& faceprints, uint64_t& sequence, std::unique_lock<std::mutex>& lock)
+{
+    sequence = _next_sequence++;
+    _queue.push_back({sequence, faceprints});
+    lock.unlock();
+    _work_cv.notify_one();
+    return true;
+}
+
+bool MatchPipeline::TrySubmit(const Faceprints& faceprints, uint64_t& sequence)
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    if (_should_stop || _queue.size() >= _queue_capacity)
+    {
+        return false;
+    }
+    return Enqueue(faceprints, sequence, lock);
+}
+
+bool MatchPipeline::Submit(const Faceprints& faceprints, uint64_t& sequence)
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    _space_cv.wait(lock, [this] { return _should_stop || _queue.size() < _queue_capacity; });
+    if (_should_stop)
+    {
+        return false;
+    }
+    return Enqueue(faceprints, sequence, lock);
+}
+
+void MatchPipeline::Flush()
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    _idle_cv.wait(lock, [this] { return _queue.empty() && _in_flight == 0; });
+}
+
+void MatchPipeline::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _should_stop = true;
+    }
+    _work_cv.notify_all();
+    _space_cv.notify_all();
+    for (auto& worker : _workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+size_t MatchPipeline::Pending() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _queue.size() + _in_flight;
+}
+
+void MatchPipeline::WorkerLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Matcher, "match-pipeline");
+    MatchRequest request;
+    Faceprints updated_faceprints;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock {_mutex};
+            // the queue is drained before stopping
+            _work_cv.wait(lock, [this] { return _should_stop || !_queue.empty(); });
+            if (_queue.empty())
+            {
+                return;
+            }
+            request = _queue.front();
+            _queue.pop_front();
+            _in_flight++;
+        }
+        _space_cv.notify_one();
+
+        ExtendedMatchResult result = _match(request.faceprints, updated_faceprints);
+        _callback.OnMatchResult(request.sequence, result, updated_faceprints);
+
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock {_mutex};
+            _in_flight--;
+            idle = _queue.empty() && _in_flight == 0;
+        }
+        if (idle)
+        {
+            _idle_cv.notify_all();
+        }
+    }
+}
+
+PipelinedAuthFaceprintsCallback::PipelinedAuthFaceprintsCallback(MatchPipeline& pipeline,
+                                                                 AuthFaceprintsExtractionCallback* forward_callback) :
+    _pipeline {pipeline},
+    _forward_callback {forward_callback}
+{
+}
+
+void PipelinedAuthFaceprintsCallback::OnResult(const AuthenticateStatus status, const Faceprints* faceprints)
+{
+    if (faceprints == nullptr)
+    {
+        OnQueryResult(status, nullptr);
+        return;
+    }
+    QueryFaceprints query;
+    ToQueryFaceprints(*faceprints, query);
+    OnQueryResult(status, &query);
+}
+
+void PipelinedAuthFaceprintsCallback::OnQueryResult(const AuthenticateStatus status, const QueryFaceprints* query)
+{
+    if (status == AuthenticateStatus::Success && query != nullptr)
+    {
+        Faceprints scanned_faceprints;
+        ToFaceprints(*query, scanned_faceprints);
+
+        uint64_t sequence;
+        if (!_pipeline.TrySubmit(scanned_faceprints, sequence))
+        {
+            _num_dropped++;
+            LOG_DEBUG(LOG_TAG, "Match queue full, faceprints dropped");
+        }
+    }
+
+    if (_forward_callback != nullptr)
+    {
+        _forward_callback->OnQueryResult(status, query);
+    }
+}
+
+void PipelinedAuthFaceprintsCallback::OnHint(const AuthenticateStatus hint)
+{
+    if (_forward_callback != nullptr)
+    {
+        _forward_callback->OnHint(hint);
+    }
+}
+
+void PipelinedAuthFaceprintsCallback::OnFacesDetected(const FaceRect* faces, size_t count)
+{
+    if (_forward_callback != nullptr)
+    {
+        _forward_callback->OnFacesDetected(faces, count);
+    }
+}
+} // namespace RealSenseID
@@ -0,0 +1,133 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "Matcher.h"
+#include "RealSenseID/Faceprints.h"
+#include "RealSenseID/AuthFaceprintsExtractionCallback.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Match results of the pipeline, called on the matcher worker threads.
+ * With more than one worker the results may arrive out of submit order, use the sequence to order them.
+ */
+class MatchResultCallback
+{
+public:
+    virtual ~MatchResultCallback() = default;
+
+    // result of the faceprints submitted with the given sequence. updated_faceprints is valid if
+    // result.should_update is set (not written back to the gallery).
+    virtual void OnMatchResult(uint64_t sequence, const ExtendedMatchResult& result,
+                               const Faceprints& updated_faceprints) = 0;
+};
+
+/**
+ * Asynchronous matching of extracted faceprints.
+ * Faceprints are submitted to a bounded queue and matched by a pool of worker threads, so the caller (e.g. the
+ * extraction callback on the serial receive path) does not wait for the gallery search.
+ * The match function is called concurrently by the workers, the gallery it matches against must allow concurrent
+ * matching (e.g. a SnapshotGallery, or a FaceprintsGallery that is not changed while the pipeline runs).
+ */
+class MatchPipeline
+{
+public:
+    using match_func = std::function<ExtendedMatchResult(const Faceprints& new_faceprints,
+                                                         Faceprints& updated_faceprints)>;
+
+    // num_workers 0 means std::thread::hardware_concurrency(). queue_capacity is the max number of faceprints
+    // waiting to be matched (at least 1).
+    MatchPipeline(match_func match, MatchResultCallback& callback, unsigned int num_workers = 1,
+                  size_t queue_capacity = 4);
+
+    // stops the pipeline, faceprints already in the queue are matched first.
+    ~MatchPipeline();
+
+    MatchPipeline(const MatchPipeline&) = delete;
+    MatchPipeline& operator=(const MatchPipeline&) = delete;
+
+    // queue the faceprints if there is room, never blocks. returns false if the queue is full or the pipeline was
+    // stopped (the faceprints are dropped).
+    bool TrySubmit(const Faceprints& faceprints, uint64_t& sequence);
+
+    // queue the faceprints, waits for room in the queue. returns false if the pipeline was stopped.
+    bool Submit(const Faceprints& faceprints, uint64_t& sequence);
+
+    // wait until all submitted faceprints were matched and their results delivered.
+    void Flush();
+
+    // stop accepting faceprints, match the queued ones and join the workers.
+    void Stop();
+
+    // number of faceprints queued or being matched.
+    size_t Pending() const;
+
+    unsigned int NumWorkers() const
+    {
+        return static_cast<unsigned int>(_workers.size());
+    }
+
+private:
+    struct MatchRequest
+    {
+        uint64_t sequence;
+        Faceprints faceprints;
+    };
+
+    bool Enqueue(const Faceprints& faceprints, uint64_t& sequence, std::unique_lock<std::mutex>& lock);
+    void WorkerLoop();
+
+    match_func _match;
+    MatchResultCallback& _callback;
+    size_t _queue_capacity;
+    std::vector<std::thread> _workers;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _work_cv;  // queue not empty or stopping
+    std::condition_variable _space_cv; // room in the queue or stopping
+    std::condition_variable _idle_cv;  // nothing pending
+    std::deque<MatchRequest> _queue;
+    size_t _in_flight = 0;
+    uint64_t _next_sequence = 0;
+    bool _should_stop = false;
+};
+
+/**
+ * Extraction callback feeding a match pipeline, for ExtractFaceprintsForAuth()/ExtractFaceprintsForAuthLoop().
+ * Successfully extracted faceprints are submitted with TrySubmit(), so OnResult() returns without waiting for the
+ * match and the next frame is not delayed. Faceprints are dropped while the queue is full (see NumDropped()).
+ * All events are forwarded to the optional callback.
+ */
+class PipelinedAuthFaceprintsCallback : public AuthFaceprintsExtractionCallback
+{
+public:
+    explicit PipelinedAuthFaceprintsCallback(MatchPipeline& pipeline,
+                                             AuthFaceprintsExtractionCallback* forward_callback = nullptr);
+
+    void OnResult(const AuthenticateStatus status, const Faceprints* faceprints) override;
+    void OnQueryResult(const AuthenticateStatus status, const QueryFaceprints* query) override;
+    void OnHint(const AuthenticateStatus hint) override;
+    void OnFacesDetected(const FaceRect* faces, size_t count) override;
+
+    size_t NumDropped() const
+    {
+        return _num_dropped;
+    }
+
+private:
+    MatchPipeline& _pipeline;
+    AuthFaceprintsExtractionCallback* _forward_callback;
+    std::atomic<size_t> _num_dropped {0};
+};
+} // namespace RealSenseID
@@ -3,14 +3,43 @@
 
 #include "Matcher.h"
 #include "Logger.h"
+#include "MetricsRecorder.h"
+#include "TraceRecorder.h"
 #include "RealSenseID/Faceprints.h"
 #include "ExtendedFaceprints.h"
+#include "MatcherKernels.h"
+#include "FaceprintsGallery.h"
+#include "MatcherThreadPool.h"
+#include "FaceprintsIvfIndex.h"
+#include "FaceprintsPivotIndex.h"
+#include "FaceprintsQuantizedIndex.h"
+#include "FaceprintsProgressiveIndex.h"
+#include "GalleryGroups.h"
+#include "SnapshotGallery.h"
+#include "FaceprintsDatabase.h"
+#include "DeviceFaceprintsGallery.h"
+#include "ShardedGallery.h"
+#include "GalleryUpdateQueue.h"
+#include "MatcherConfig.h"
+#include "MultiTemplateGallery.h"
+#include "MappedFaceprintsGallery.h"
+#ifdef RSID_MATCHER_OPENCL
+#include "OpenClMatchContext.h"
+#endif // RSID_MATCHER_OPENCL
 #include <cmath>
 #include <assert.h>
 #include <cstring>
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <iterator>
+#include <type_traits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
 // #include <iostream>
 
 /*
@@ -29,31 +58,418 @@ static const char* LOG_TAG = "Matcher";
 static const match_calc_t s_maxFeatureValue = static_cast<match_calc_t>(RSID_MAX_FEATURE_VALUE);
 static const match_calc_t s_minPossibleScore = static_cast<match_calc_t>(RSID_MIN_POSSIBLE_SCORE);
 
+// the fixed length kernels must describe the vectors the matcher works with.
+using DefaultFeatureLayout = MatcherKernels::DefaultFeatureLayout;
+static_assert(DefaultFeatureLayout::NumFeatures == RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER,
+              "Default feature layout length mismatch");
+static_assert(DefaultFeatureLayout::MaxFeatureValue == RSID_MAX_FEATURE_VALUE, "Default feature layout range mismatch");
+static_assert(std::is_same<DefaultFeatureLayout::accumulator_t, int32_t>::value,
+              "Default feature layout products must fit the 32 bit kernels");
+
+static_assert(RSID_UPDATE_GALLERY_HISTORY_WEIGHT >= 1 &&
+                  RSID_UPDATE_GALLERY_HISTORY_WEIGHT <= MatcherKernels::MaxBlendHistoryWeight,
+              "History weight out of the range of the blend kernels");
+
 static const match_calc_t s_strongThreshold = static_cast<match_calc_t>(RSID_STRONG_THRESHOLD);
 static const match_calc_t s_identicalPersonThreshold = static_cast<match_calc_t>(RSID_IDENTICAL_PERSON_THRESHOLD);
 static const match_calc_t s_updateThreshold = static_cast<match_calc_t>(RSID_UPDATE_THRESHOLD);
 
-// for linear piecewise curve : score to confidence mapping.
-static const int s_linCurveMultiplier1 = RSID_LIN1_CURVE_MULTIPLIER;
-static const int s_linCurveSabtractive1 = RSID_LIN1_CURVE_SABTRACTIVE;
-static const int s_linCurveAdditive1 = RSID_LIN1_CURVE_ADDITIVE;
-static const int s_linCurveHeadroom1 = RSID_LIN1_CURVE_HR;
+// batch gallery search - number of gallery rows scored against all queries before moving to the next rows
+// (64 rows * 512 bytes fit in L1/L2).
+static const size_t s_batchTileRows = 64;
+
+// gallery scan - number of rows whose grades are calculated together
+static const size_t s_gradeBlockRows = 16;
+static_assert(s_gradeBlockRows == MatcherKernels::InterleaveRows, "Grade blocks must be the interleaved blocks");
+static_assert(s_batchTileRows % s_gradeBlockRows == 0, "Batch tiles must be made of whole interleaved blocks");
+
+// parallel gallery search
+static const size_t s_parallelMinGallerySize = 4096;
+static const size_t s_parallelMinChunkSize = 1024;
+static const size_t s_parallelChunksPerThread = 4;
+
+// deadline search - rows of a chunk of the full scan, the deadline is checked after each chunk per thread
+static const size_t s_deadlineChunkSize = 4096;
+
+// all pairs search - rows of a tile (256 rows * 512 bytes stay in L2 while the rows of the other tile are scored)
+static const size_t s_pairTileRows = 256;
+static_assert(s_pairTileRows % s_gradeBlockRows == 0, "Pair tiles must be made of whole interleaved blocks");
+
+// pivot index search - margin of the float correlation bounds, and the largest part of the blocks worth gathering
+// before the threshold is known to be out of reach (the rest is scanned in a single streaming pass instead)
+static const double s_pivotBoundMargin = 1e-3;
+static const double s_pivotMaxGatherRatio = 0.5;
+
+// per entry checks of the packed galleries, skipped when the gallery IsValidated() for the query version
+static bool CheckGalleryEntry(const FaceprintsGallery::Metadata& metadata, int version)
+{
+    if (metadata.numberOfDescriptors < 1)
+    {
+        LOG_ERROR_LIMITED(LOG_TAG, "Invalid number of descriptors in faceprints");
+        return false;
+    }
+
+    if (!metadata.is_valid)
+    {
+        LOG_ERROR_LIMITED(LOG_TAG, "Invalid faceprints vector range");
+        return false;
+    }
 
-static const int s_linCurveMultiplier2 = RSID_LIN2_CURVE_MULTIPLIER;
-static const int s_linCurveSabtractive2 = RSID_LIN2_CURVE_SABTRACTIVE;
-static const int s_linCurveAdditive2 = RSID_LIN2_CURVE_ADDITIVE;
-static const int s_linCurveHeadroom2 = RSID_LIN2_CURVE_HR;
+    if (version != metadata.version)
+    {
+        LOG_ERROR_LIMITED(LOG_TAG, "Mismatch in faceprints versions");
+        return false;
+    }
+    return true;
+}
 
 static bool IsSameVersion(const Faceprints& newFaceprints, const Faceprints& existingFaceprints)
 {
     bool versionsMatch = (newFaceprints.version == existingFaceprints.version);
     if (!versionsMatch)
     {
-        LOG_ERROR(LOG_TAG, "Faceprints versions don't match");
+        LOG_ERROR_LIMITED(LOG_TAG, "Faceprints versions don't match");
     }
     return versionsMatch;
 }
 
+// accessors used by the shared matching code for the different gallery containers.
+template <typename T>
+static size_t GallerySize(const std::vector<T>& gallery)
+{
+    return gallery.size();
+}
+
+static size_t GallerySize(const FaceprintsGallery& gallery)
+{
+    return gallery.Size();
+}
+
+static int GalleryVersion(const std::vector<ExtendedFaceprints>& gallery, size_t index)
+{
+    return gallery[index].faceprints.version;
+}
+
+static int GalleryVersion(const std::vector<GalleryFaceprints>& gallery, size_t index)
+{
+    return gallery[index].extended_faceprints.faceprints.version;
+}
+
+static int GalleryVersion(const FaceprintsGallery& gallery, size_t index)
+{
+    return gallery.GetMetadata(index).version;
+}
+
+static void CopyGalleryFaceprints(const std::vector<ExtendedFaceprints>& gallery, size_t index, Faceprints& faceprints)
+{
+    faceprints = gallery[index].faceprints;
+}
+
+static void CopyGalleryFaceprints(const std::vector<GalleryFaceprints>& gallery, size_t index, Faceprints& faceprints)
+{
+    faceprints = gallery[index].extended_faceprints.faceprints;
+}
+
+static void CopyGalleryFaceprints(const FaceprintsGallery& gallery, size_t index, Faceprints& faceprints)
+{
+    gallery.GetFaceprints(index, faceprints);
+}
+
+// interleaved avg vectors of a packed gallery (see FaceprintsGallery::SetInterleaved()), nullptr if it has none.
+template <typename PackedGallery>
+static const feature_t* InterleavedVectors(const PackedGallery&)
+{
+    return nullptr;
+}
+
+static const feature_t* InterleavedVectors(const FaceprintsGallery& gallery)
+{
+    return gallery.IsInterleaved() ? gallery.InterleavedData() : nullptr;
+}
+
+// packed gallery searched in parallel over the given pool.
+struct ParallelGallerySearch
+{
+    const FaceprintsGallery& gallery;
+    MatcherThreadPool& pool;
+};
+
+static size_t GallerySize(const ParallelGallerySearch& search)
+{
+    return search.gallery.Size();
+}
+
+static int GalleryVersion(const ParallelGallerySearch& search, size_t index)
+{
+    return GalleryVersion(search.gallery, index);
+}
+
+static void CopyGalleryFaceprints(const ParallelGallerySearch& search, size_t index, Faceprints& faceprints)
+{
+    CopyGalleryFaceprints(search.gallery, index, faceprints);
+}
+
+static size_t GallerySize(const GallerySnapshot& snapshot)
+{
+    return snapshot.Size();
+}
+
+static int GalleryVersion(const GallerySnapshot& snapshot, size_t index)
+{
+    size_t segment, segment_index;
+    snapshot.Locate(index, segment, segment_index);
+    return snapshot.Segment(segment).GetMetadata(segment_index).version;
+}
+
+static void CopyGalleryFaceprints(const GallerySnapshot& snapshot, size_t index, Faceprints& faceprints)
+{
+    snapshot.GetFaceprints(index, faceprints);
+}
+
+static size_t GallerySize(const FaceprintsDatabase& database)
+{
+    return database.IndexSize();
+}
+
+static int GalleryVersion(const FaceprintsDatabase& database, size_t index)
+{
+    return database.GetMetadata(index).version;
+}
+
+static void CopyGalleryFaceprints(const FaceprintsDatabase& database, size_t index, Faceprints& faceprints)
+{
+    database.GetFaceprints(index, faceprints);
+}
+
+// packed gallery searched in two stages - binary sketch pre-filter, then exact match of the shortlist.
+struct PrefilteredGallerySearch
+{
+    const FaceprintsGallery& gallery;
+    size_t shortlist_size;
+};
+
+static size_t GallerySize(const PrefilteredGallerySearch& search)
+{
+    return search.gallery.Size();
+}
+
+static int GalleryVersion(const PrefilteredGallerySearch& search, size_t index)
+{
+    return GalleryVersion(search.gallery, index);
+}
+
+static void CopyGalleryFaceprints(const PrefilteredGallerySearch& search, size_t index, Faceprints& faceprints)
+{
+    CopyGalleryFaceprints(search.gallery, index, faceprints);
+}
+
+// ivf index searched in its nprobe closest lists, then exact match of their users.
+struct IvfGallerySearch
+{
+    const FaceprintsIvfIndex& index;
+    size_t nprobe;
+};
+
+static size_t GallerySize(const IvfGallerySearch& search)
+{
+    return search.index.Gallery().Size();
+}
+
+static int GalleryVersion(const IvfGallerySearch& search, size_t index)
+{
+    return GalleryVersion(search.index.Gallery(), index);
+}
+
+static void CopyGalleryFaceprints(const IvfGallerySearch& search, size_t index, Faceprints& faceprints)
+{
+    CopyGalleryFaceprints(search.index.Gallery(), index, faceprints);
+}
+
+// pivot index searched exactly, skipping the blocks that cannot beat the threshold or the best score.
+struct PivotGallerySearch
+{
+    const FaceprintsPivotIndex& index;
+};
+
+static size_t GallerySize(const PivotGallerySearch& search)
+{
+    return search.index.Gallery().Size();
+}
+
+static int GalleryVersion(const PivotGallerySearch& search, size_t index)
+{
+    return GalleryVersion(search.index.Gallery(), index);
+}
+
+static void CopyGalleryFaceprints(const PivotGallerySearch& search, size_t index, Faceprints& faceprints)
+{
+    CopyGalleryFaceprints(search.index.Gallery(), index, faceprints);
+}
+
+// quantized index searched exactly, rescoring the users whose int8 bound can beat the threshold or the best score.
+struct QuantizedGallerySearch
+{
+    const FaceprintsQuantizedIndex& index;
+};
+
+static size_t GallerySize(const QuantizedGallerySearch& search)
+{
+    return search.index.Gallery().Size();
+}
+
+static int GalleryVersion(const QuantizedGallerySearch& search, size_t index)
+{
+    return GalleryVersion(search.index.Gallery(), index);
+}
+
+static void CopyGalleryFaceprints(const QuantizedGallerySearch& search, size_t index, Faceprints& faceprints)
+{
+    CopyGalleryFaceprints(search.index.Gallery(), index, faceprints);
+}
+
+// progressive index searched exactly, rejecting the users whose partial correlation bound can no longer beat the
+// threshold or the best score.
+struct ProgressiveGallerySearch
+{
+    const FaceprintsProgressiveIndex& index;
+};
+
+static size_t GallerySize(const ProgressiveGallerySearch& search)
+{
+    return search.index.Gallery().Size();
+}
+
+static int GalleryVersion(const ProgressiveGallerySearch& search, size_t index)
+{
+    return GalleryVersion(search.index.Gallery(), index);
+}
+
+static void CopyGalleryFaceprints(const ProgressiveGallerySearch& search, size_t index, Faceprints& faceprints)
+{
+    CopyGalleryFaceprints(search.index.Gallery(), index, faceprints);
+}
+
+// packed gallery searched over the members of some groups only.
+struct ScopedGallerySearch
+{
+    const FaceprintsGallery& gallery;
+    std::vector<uint32_t> rows; // ascending
+};
+
+static size_t GallerySize(const ScopedGallerySearch& search)
+{
+    return search.gallery.Size();
+}
+
+static int GalleryVersion(const ScopedGallerySearch& search, size_t index)
+{
+    return GalleryVersion(search.gallery, index);
+}
+
+static void CopyGalleryFaceprints(const ScopedGallerySearch& search, size_t index, Faceprints& faceprints)
+{
+    CopyGalleryFaceprints(search.gallery, index, faceprints);
+}
+
+// global top-1 of a sharded gallery, searched before the match. The gallery is the best candidate only.
+struct ShardedGallerySearch
+{
+    std::vector<ShardCandidate> candidates;
+    bool success;
+};
+
+static size_t GallerySize(const ShardedGallerySearch& search)
+{
+    return search.candidates.size();
+}
+
+static int GalleryVersion(const ShardedGallerySearch& search, size_t index)
+{
+    return search.candidates[index].faceprints.version;
+}
+
+static void CopyGalleryFaceprints(const ShardedGallerySearch& search, size_t index, Faceprints& faceprints)
+{
+    faceprints = search.candidates[index].faceprints;
+}
+
+// ivf index searched until a deadline, in gallery order if the full scan fits, by the closest lists first otherwise.
+struct DeadlineGallerySearch
+{
+    const FaceprintsIvfIndex& index;
+    DeadlineSearch& state;
+    MatcherThreadPool& pool;
+};
+
+static size_t GallerySize(const DeadlineGallerySearch& search)
+{
+    return search.index.Gallery().Size();
+}
+
+static int GalleryVersion(const DeadlineGallerySearch& search, size_t index)
+{
+    return GalleryVersion(search.index.Gallery(), index);
+}
+
+static void CopyGalleryFaceprints(const DeadlineGallerySearch& search, size_t index, Faceprints& faceprints)
+{
+    CopyGalleryFaceprints(search.index.Gallery(), index, faceprints);
+}
+
+static size_t GallerySize(const MappedFaceprintsGallery& gallery)
+{
+    return gallery.Size();
+}
+
+static int GalleryVersion(const MappedFaceprintsGallery& gallery, size_t index)
+{
+    return gallery.GetMetadata(index).version;
+}
+
+static void CopyGalleryFaceprints(const MappedFaceprintsGallery& gallery, size_t index, Faceprints& faceprints)
+{
+    gallery.GetFaceprints(index, faceprints);
+}
+
+// the entries of a multi-template gallery are its rows (templates), GetScores() returns the best row.
+static size_t GallerySize(const MultiTemplateGallery& gallery)
+{
+    return gallery.Rows();
+}
+
+static int GalleryVersion(const MultiTemplateGallery& gallery, size_t row)
+{
+    return gallery.MetadataData()[row].version;
+}
+
+static void CopyGalleryFaceprints(const MultiTemplateGallery& gallery, size_t row, Faceprints& faceprints)
+{
+    gallery.GetRowFaceprints(row, faceprints);
+}
+
+// fold the result of a scan of later rows (ids offset by id_offset) into result, as one scan of all the rows would: the
+// best score wins (the earlier row on ties) and the runner-up is the best of the other scores.
+static void FoldScan(TagResult& result, const TagResult& next, int id_offset)
+{
+    if (next.id < 0)
+    {
+        return;
+    }
+    if (result.id < 0 || next.score > result.score)
+    {
+        const bool previous_is_second = result.id >= 0 && (next.runnerUpId < 0 || result.score >= next.runnerUpScore);
+        result.runnerUpScore = previous_is_second ? result.score : next.runnerUpScore;
+        result.runnerUpId = previous_is_second ? result.id : (next.runnerUpId < 0 ? -1 : next.runnerUpId + id_offset);
+        result.score = next.score;
+        result.id = next.id + id_offset;
+    }
+    else if (result.runnerUpId < 0 || next.score > result.runnerUpScore)
+    {
+        result.runnerUpScore = next.score;
+        result.runnerUpId = next.id + id_offset;
+    }
+}
+
 bool Matcher::GetScores(const Faceprints& new_faceprints,
                         const std::vector<ExtendedFaceprints>& existing_faceprints_array, TagResult& result,
                         match_calc_t threshold)
@@ -61,6 +477,7 @@ bool Matcher::GetScores(const Faceprints& new_faceprints,
     // initialize.
     result.score = 0;
     result.id = -1;
+    result.runnerUpId = -1;
 
     if (existing_faceprints_array.size() == 0)
     {
@@ -73,6 +490,8 @@ bool Matcher::GetScores(const Faceprints& new_faceprints,
     match_calc_t adaptedScore = s_minPossibleScore;
     int numberOfSubjects = (int)existing_faceprints_array.size();
     int maxSubject = -1;
+    match_calc_t runnerUpScore = s_minPossibleScore;
+    int runnerUpSubject = -1;
     uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
 
     for (int subjectIndex = 0; subjectIndex < numberOfSubjects; subjectIndex++)
@@ -82,239 +501,2446 @@ bool Matcher::GetScores(const Faceprints& new_faceprints,
 
         if (existing_faceprints.faceprints.numberOfDescriptors < 1)
         {
-            LOG_ERROR(LOG_TAG, "Invalid number of descriptors in faceprints");
+            LOG_ERROR_LIMITED(LOG_TAG, "Invalid number of descriptors in faceprints");
             return false; 
         }
 
-        if (!ValidateFaceprints(existing_faceprints.faceprints))
-        {
-            LOG_ERROR(LOG_TAG, "Invalid faceprints vector range");
-            return false;
-        }
+        if (!ValidateFaceprints(existing_faceprints.faceprints))
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "Invalid faceprints vector range");
+            return false;
+        }
+
+        if (!IsSameVersion(new_faceprints, existing_faceprints.faceprints))
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "Mismatch in faceprints versions");
+            return false;
+        }
+
+        MatchTwoVectors((feature_t*)queryFea, (feature_t*)(&existing_faceprints.faceprints.avgDescriptor[0]), 
+                        &adaptedScore, vec_length);
+
+
+        if (adaptedScore > maxScore)
+        {
+            runnerUpScore = maxScore;
+            runnerUpSubject = maxSubject;
+            maxScore = adaptedScore;
+            maxSubject = static_cast<int>(subjectIndex);
+        }
+        else if (adaptedScore > runnerUpScore)
+        {
+            runnerUpScore = adaptedScore;
+            runnerUpSubject = static_cast<int>(subjectIndex);
+        }
+
+        if (adaptedScore > threshold)
+        {
+            break;
+        }
+    }
+
+    result.score = maxScore;
+    result.id = maxSubject;
+    result.runnerUpScore = runnerUpScore;
+    result.runnerUpId = runnerUpSubject;
+
+    return true;
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const std::vector<GalleryFaceprints>& gallery,
+                        TagResult& result, match_calc_t threshold)
+{
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    if (gallery.size() == 0)
+    {
+        return false;
+    }
+
+    const feature_t* queryFea = (feature_t*)(&(new_faceprints.avgDescriptor[0]));
+    uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+
+    // query norm is calculated once, gallery norms are cached - only the dot product is left per subject.
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    CalculateNorm(queryFea, query_norm, query_norm_msb, vec_length);
+    const uint64_t query_norm_recip = CalculateNormReciprocal(query_norm);
+
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+
+    match_calc_t maxScore = s_minPossibleScore;
+    match_calc_t adaptedScore = s_minPossibleScore;
+    int numberOfSubjects = (int)gallery.size();
+    int maxSubject = -1;
+    match_calc_t runnerUpScore = s_minPossibleScore;
+    int runnerUpSubject = -1;
+
+    for (int subjectIndex = 0; subjectIndex < numberOfSubjects; subjectIndex++)
+    {
+        auto& entry = gallery[subjectIndex];
+        auto& existing_faceprints = entry.extended_faceprints.faceprints;
+
+        if (existing_faceprints.numberOfDescriptors < 1)
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "Invalid number of descriptors in faceprints");
+            return false;
+        }
+
+        // validated once in UpdateGalleryFaceprints()
+        if (!entry.is_valid)
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "Invalid faceprints vector range");
+            return false;
+        }
+
+        if (!IsSameVersion(new_faceprints, existing_faceprints))
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "Mismatch in faceprints versions");
+            return false;
+        }
+
+        int32_t corr = calc_dot(queryFea, &existing_faceprints.avgDescriptor[0], vec_length);
+        adaptedScore = CalculateGrade(corr, query_norm_msb, query_norm_recip, entry.avg_norm_msb, entry.avg_norm_recip);
+
+        if (adaptedScore > maxScore)
+        {
+            runnerUpScore = maxScore;
+            runnerUpSubject = maxSubject;
+            maxScore = adaptedScore;
+            maxSubject = static_cast<int>(subjectIndex);
+        }
+        else if (adaptedScore > runnerUpScore)
+        {
+            runnerUpScore = adaptedScore;
+            runnerUpSubject = static_cast<int>(subjectIndex);
+        }
+
+        if (adaptedScore > threshold)
+        {
+            break;
+        }
+    }
+
+    result.score = maxScore;
+    result.id = maxSubject;
+    result.runnerUpScore = runnerUpScore;
+    result.runnerUpId = runnerUpSubject;
+
+    return true;
+}
+
+template <typename PackedGallery>
+bool Matcher::ScanGallery(const Faceprints& new_faceprints, uint32_t query_norm, short query_norm_msb,
+                          const PackedGallery& gallery, size_t begin, size_t end, match_calc_t threshold,
+                          std::atomic<bool>* found, TagResult& result)
+{
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    const feature_t* queryFea = (feature_t*)(&(new_faceprints.avgDescriptor[0]));
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+    static const MatcherKernels::calc_dot4_func calc_dot4 = MatcherKernels::GetCalcDot4();
+    static const MatcherKernels::calc_dot16_interleaved_func calc_dot16 = MatcherKernels::GetCalcDot16Interleaved();
+    const uint64_t query_norm_recip = CalculateNormReciprocal(query_norm);
+
+    // streaming pass over the packed arrays
+    const feature_t* avg_vectors = gallery.AvgVectorsData();
+    const feature_t* interleaved_vectors = InterleavedVectors(gallery);
+    const FaceprintsGallery::Metadata* metadata = gallery.MetadataData();
+    // entries were validated on insert - only the correlation is left per subject
+    const bool validated = gallery.IsValidated(new_faceprints.version);
+    const short* avg_norm_msbs = gallery.AvgNormMsbsData();
+    const uint64_t* avg_norm_recips = gallery.AvgNormRecipsData();
+
+    match_calc_t maxScore = s_minPossibleScore;
+    int maxSubject = -1;
+    match_calc_t runnerUpScore = s_minPossibleScore;
+    int runnerUpSubject = -1;
+
+    // the correlations and grades of a block of rows are calculated together (the grades without branches), then the
+    // rows are visited in order - the result and the early exit are the same as scoring row by row.
+    int32_t corrs[s_gradeBlockRows];
+    match_calc_t grades[s_gradeBlockRows];
+    bool done = false;
+
+    // the blocks are aligned to s_gradeBlockRows rows, so they are the blocks of an interleaved gallery
+    size_t block_end = begin;
+    for (size_t block_begin = begin; block_begin < end && !done; block_begin = block_end)
+    {
+        block_end = std::min(end, (block_begin / s_gradeBlockRows + 1) * s_gradeBlockRows);
+        const size_t block_size = block_end - block_begin;
+
+        size_t k = 0;
+        if (interleaved_vectors != nullptr && block_begin % s_gradeBlockRows == 0)
+        {
+            // one pass over the whole block (the padding rows of the last block are zero)
+            const feature_t* block = interleaved_vectors + block_begin * vec_length;
+            const feature_t* next_block = block_end < end ? block + s_gradeBlockRows * vec_length : nullptr;
+            calc_dot16(queryFea, block, next_block, vec_length, corrs);
+            k = block_size;
+        }
+        const feature_t* block_vectors = avg_vectors + block_begin * vec_length;
+        for (; k + 4 <= block_size; k += 4)
+        {
+            calc_dot4(queryFea, block_vectors + k * vec_length, vec_length, vec_length, corrs + k);
+        }
+        for (; k < block_size; k++)
+        {
+            corrs[k] = calc_dot(queryFea, block_vectors + k * vec_length, vec_length);
+        }
+        CalculateGrades(corrs, block_size, query_norm_msb, query_norm_recip, avg_norm_msbs + block_begin,
+                        avg_norm_recips + block_begin, grades);
+
+        for (k = 0; k < block_size; k++)
+        {
+            const size_t subjectIndex = block_begin + k;
+
+            // another worker already found a match above threshold
+            if (found != nullptr && found->load(std::memory_order_relaxed))
+            {
+                done = true;
+                break;
+            }
+
+            if (!validated && !CheckGalleryEntry(metadata[subjectIndex], new_faceprints.version))
+            {
+                return false;
+            }
+
+            const match_calc_t adaptedScore = grades[k];
+
+            if (adaptedScore > maxScore)
+            {
+                runnerUpScore = maxScore;
+                runnerUpSubject = maxSubject;
+                maxScore = adaptedScore;
+                maxSubject = static_cast<int>(subjectIndex);
+            }
+            else if (adaptedScore > runnerUpScore)
+            {
+                runnerUpScore = adaptedScore;
+                runnerUpSubject = static_cast<int>(subjectIndex);
+            }
+
+            if (adaptedScore > threshold)
+            {
+                if (found != nullptr)
+                {
+                    found->store(true, std::memory_order_relaxed);
+                }
+                done = true;
+                break;
+            }
+        }
+    }
+
+    result.score = maxScore;
+    result.id = maxSubject;
+    result.runnerUpScore = runnerUpScore;
+    result.runnerUpId = runnerUpSubject;
+
+    return true;
+}
+
+template <typename PackedGallery>
+bool Matcher::ScanGalleryRows(const Faceprints& new_faceprints, const PackedGallery& gallery,
+                              const std::vector<uint32_t>& rows, match_calc_t threshold, TagResult& result)
+{
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    const feature_t* queryFea = &new_faceprints.avgDescriptor[0];
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    CalculateNorm(queryFea, query_norm, query_norm_msb, vec_length);
+    const uint64_t query_norm_recip = CalculateNormReciprocal(query_norm);
+
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+
+    const feature_t* avg_vectors = gallery.AvgVectorsData();
+    const FaceprintsGallery::Metadata* metadata = gallery.MetadataData();
+    // entries were validated on insert - only the correlation is left per subject
+    const bool validated = gallery.IsValidated(new_faceprints.version);
+    const short* avg_norm_msbs = gallery.AvgNormMsbsData();
+    const uint64_t* avg_norm_recips = gallery.AvgNormRecipsData();
+
+    match_calc_t maxScore = s_minPossibleScore;
+    int maxSubject = -1;
+    match_calc_t runnerUpScore = s_minPossibleScore;
+    int runnerUpSubject = -1;
+
+    for (uint32_t subjectIndex : rows)
+    {
+        if (!validated && !CheckGalleryEntry(metadata[subjectIndex], new_faceprints.version))
+        {
+            return false;
+        }
+
+        int32_t corr = calc_dot(queryFea, avg_vectors + static_cast<size_t>(subjectIndex) * vec_length, vec_length);
+        match_calc_t adaptedScore = CalculateGrade(corr, query_norm_msb, query_norm_recip, avg_norm_msbs[subjectIndex],
+                                                   avg_norm_recips[subjectIndex]);
+
+        if (adaptedScore > maxScore)
+        {
+            runnerUpScore = maxScore;
+            runnerUpSubject = maxSubject;
+            maxScore = adaptedScore;
+            maxSubject = static_cast<int>(subjectIndex);
+        }
+        else if (adaptedScore > runnerUpScore)
+        {
+            runnerUpScore = adaptedScore;
+            runnerUpSubject = static_cast<int>(subjectIndex);
+        }
+
+        if (adaptedScore > threshold)
+        {
+            break;
+        }
+    }
+
+    result.score = maxScore;
+    result.id = maxSubject;
+    result.runnerUpScore = runnerUpScore;
+    result.runnerUpId = runnerUpSubject;
+
+    return true;
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const FaceprintsGallery& gallery, TagResult& result,
+                        match_calc_t threshold)
+{
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    if (gallery.Empty())
+    {
+        return false;
+    }
+
+    // query norm is calculated once, gallery norms are cached - only the dot product is left per subject.
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    CalculateNorm(&new_faceprints.avgDescriptor[0], query_norm, query_norm_msb);
+
+    return ScanGallery(new_faceprints, query_norm, query_norm_msb, gallery, 0, gallery.Size(), threshold, nullptr,
+                       result);
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const ParallelGallerySearch& search, TagResult& result,
+                        match_calc_t threshold)
+{
+    auto& gallery = search.gallery;
+    auto& pool = search.pool;
+    size_t gallery_size = gallery.Size();
+
+    // not worth the synchronization for small galleries
+    if (pool.NumThreads() <= 1 || gallery_size < s_parallelMinGallerySize)
+    {
+        return GetScores(new_faceprints, gallery, result, threshold);
+    }
+
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    CalculateNorm(&new_faceprints.avgDescriptor[0], query_norm, query_norm_msb);
+
+    // few chunks per thread to balance the load when some threads stop early
+    size_t num_chunks = static_cast<size_t>(pool.NumThreads()) * s_parallelChunksPerThread;
+    size_t chunk_size = std::max((gallery_size + num_chunks - 1) / num_chunks, s_parallelMinChunkSize);
+    num_chunks = (gallery_size + chunk_size - 1) / chunk_size;
+
+    struct ChunkResult
+    {
+        TagResult tag;
+        bool success = false;
+    };
+    std::vector<ChunkResult> chunk_results(num_chunks);
+
+    // early exit shared by all workers, same as the sequential break on threshold
+    std::atomic<bool> found {false};
+
+    pool.Run(num_chunks, [&](size_t chunk_index) {
+        size_t begin = chunk_index * chunk_size;
+        size_t end = std::min(begin + chunk_size, gallery_size);
+        auto& chunk_result = chunk_results[chunk_index];
+        chunk_result.success = ScanGallery(new_faceprints, query_norm, query_norm_msb, gallery, begin, end, threshold,
+                                           &found, chunk_result.tag);
+    });
+
+    // reduce to the best (score, index). on equal scores the lower index wins.
+    for (auto& chunk_result : chunk_results)
+    {
+        if (!chunk_result.success)
+        {
+            return false;
+        }
+        FoldScan(result, chunk_result.tag, 0);
+    }
+
+    return true;
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const PrefilteredGallerySearch& search, TagResult& result,
+                        match_calc_t threshold)
+{
+    auto& gallery = search.gallery;
+    const size_t gallery_size = gallery.Size();
+    const size_t shortlist_size = search.shortlist_size;
+
+    // shortlist covers the whole gallery - exact search gives the same result
+    if (shortlist_size >= gallery_size)
+    {
+        return GetScores(new_faceprints, gallery, result, threshold);
+    }
+
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    if (shortlist_size == 0)
+    {
+        return false;
+    }
+
+    // stage 1: hamming distance of the binary sketches, keep the shortlist_size closest (fixed size heap, the
+    // farthest candidate is at the front).
+    uint64_t query_code[FaceprintsGallery::SignCodeWords];
+    FaceprintsGallery::CalculateSignCode(&new_faceprints.avgDescriptor[0], query_code);
+
+    using coarse_candidate_t = std::pair<uint32_t, uint32_t>; // (distance, index)
+    std::vector<coarse_candidate_t> shortlist;
+    shortlist.reserve(shortlist_size);
+
+    const uint64_t* sign_codes = gallery.SignCodesData();
+    for (size_t subjectIndex = 0; subjectIndex < gallery_size; subjectIndex++)
+    {
+        coarse_candidate_t candidate {MatcherKernels::CalcHamming(query_code,
+                                                                  sign_codes + subjectIndex *
+                                                                                   FaceprintsGallery::SignCodeWords,
+                                                                  FaceprintsGallery::SignCodeWords),
+                                      static_cast<uint32_t>(subjectIndex)};
+        if (shortlist.size() < shortlist_size)
+        {
+            shortlist.push_back(candidate);
+            std::push_heap(shortlist.begin(), shortlist.end());
+        }
+        else if (candidate < shortlist.front())
+        {
+            std::pop_heap(shortlist.begin(), shortlist.end());
+            shortlist.back() = candidate;
+            std::push_heap(shortlist.begin(), shortlist.end());
+        }
+    }
+
+    // stage 2: exact match of the shortlist in gallery order (same decision as the full scan if the matching user
+    // is in the shortlist).
+    std::vector<uint32_t> rows;
+    rows.reserve(shortlist.size());
+    for (auto& candidate : shortlist)
+    {
+        rows.push_back(candidate.second);
+    }
+    std::sort(rows.begin(), rows.end());
+
+    return ScanGalleryRows(new_faceprints, gallery, rows, threshold, result);
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const IvfGallerySearch& search, TagResult& result,
+                        match_calc_t threshold)
+{
+    auto& index = search.index;
+
+    // untrained index or all lists probed - exact search gives the same result
+    if (!index.IsTrained() || search.nprobe >= index.NumLists())
+    {
+        return GetScores(new_faceprints, index.Gallery(), result, threshold);
+    }
+
+    std::vector<uint32_t> rows;
+    index.GetCandidates(&new_faceprints.avgDescriptor[0], search.nprobe, rows);
+    return ScanGalleryRows(new_faceprints, index.Gallery(), rows, threshold, result);
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const ScopedGallerySearch& search, TagResult& result,
+                        match_calc_t threshold)
+{
+    return ScanGalleryRows(new_faceprints, search.gallery, search.rows, threshold, result);
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const DeadlineGallerySearch& search, TagResult& result,
+                        match_calc_t threshold)
+{
+    using clock = std::chrono::steady_clock;
+    auto& index = search.index;
+    auto& gallery = index.Gallery();
+    auto& state = search.state;
+    const size_t gallery_size = gallery.Size();
+    const auto start = clock::now();
+    const size_t num_threads = std::max(1u, search.pool.NumThreads());
+
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+    state.exact = false;
+    state.indexed = false;
+    state.scanned = 0;
+
+    const double budget_us = std::chrono::duration<double, std::micro>(state.deadline - start).count();
+    if (!index.IsTrained() || state.scan_us_per_user * static_cast<double>(gallery_size) <= budget_us)
+    {
+        // waves of a chunk per thread in gallery order, so the early exit is the full scan's
+        uint32_t query_norm = 1;
+        short query_norm_msb = 1;
+        CalculateNorm(&new_faceprints.avgDescriptor[0], query_norm, query_norm_msb);
+
+        std::vector<TagResult> chunk_results(num_threads);
+        std::vector<char> chunk_success(num_threads);
+        std::atomic<bool> found {false};
+        size_t begin = 0;
+        while (begin < gallery_size && !found && (begin == 0 || clock::now() < state.deadline))
+        {
+            const size_t num_chunks =
+                std::min<size_t>(num_threads, (gallery_size - begin + s_deadlineChunkSize - 1) / s_deadlineChunkSize);
+            search.pool.Run(num_chunks, [&](size_t chunk) {
+                const size_t chunk_begin = begin + chunk * s_deadlineChunkSize;
+                const size_t chunk_end = std::min(chunk_begin + s_deadlineChunkSize, gallery_size);
+                chunk_success[chunk] = ScanGallery(new_faceprints, query_norm, query_norm_msb, gallery, chunk_begin,
+                                                   chunk_end, threshold, &found, chunk_results[chunk]);
+            });
+            for (size_t chunk = 0; chunk < num_chunks; chunk++)
+            {
+                if (!chunk_success[chunk])
+                {
+                    return false;
+                }
+                FoldScan(result, chunk_results[chunk], 0);
+            }
+            begin = std::min(begin + num_chunks * s_deadlineChunkSize, gallery_size);
+        }
+        state.scanned = begin;
+        state.exact = found || begin == gallery_size;
+        const double elapsed_us = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+        state.scan_us_per_user = elapsed_us / static_cast<double>(begin);
+        return true;
+    }
+
+    // the closest lists first, each list scored exactly, until the deadline
+    state.indexed = true;
+    std::vector<uint32_t> lists;
+    std::vector<uint32_t> rows;
+    index.RankLists(&new_faceprints.avgDescriptor[0], lists);
+    size_t probed = 0;
+    for (; probed < lists.size() && (probed == 0 || clock::now() < state.deadline); probed++)
+    {
+        rows = index.ListRows(lists[probed]);
+        if (rows.empty())
+        {
+            continue;
+        }
+        std::sort(rows.begin(), rows.end());
+        TagResult list_result;
+        if (!ScanGalleryRows(new_faceprints, gallery, rows, threshold, list_result))
+        {
+            return false;
+        }
+        FoldScan(result, list_result, 0);
+        state.scanned += rows.size();
+        if (list_result.id >= 0 && list_result.score > threshold)
+        {
+            state.exact = true;
+            break;
+        }
+    }
+    state.exact = state.exact || probed == lists.size();
+
+    // the lists are scored by one thread, the full scan by all of them: keeps the estimate following the load, so the
+    // full scan is back once it fits again
+    if (state.scanned > 0)
+    {
+        const double elapsed_us = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+        state.scan_us_per_user = elapsed_us / static_cast<double>(state.scanned * num_threads);
+    }
+    return true;
+}
+
+// upper bound of the grade for an upper bound of the normalized correlation. All the roundings of CalculateGrade() are
+// down, so a grade is at most max score * ncc^2. The margin covers the float bounds of the pivot and quantized indices.
+static match_calc_t GradeBound(float corr_bound)
+{
+    const double bound = std::min(static_cast<double>(corr_bound) + s_pivotBoundMargin, 1.0);
+    if (bound <= 0)
+    {
+        return 0;
+    }
+    return static_cast<match_calc_t>(std::ceil(RSID_MAX_POSSIBLE_SCORE * bound * bound));
+}
+
+// largest bound of the normalized correlation whose GradeBound() is at most the given grade
+static double CorrLimit(match_calc_t grade)
+{
+    return std::sqrt(static_cast<double>(std::max<match_calc_t>(grade, 0)) / RSID_MAX_POSSIBLE_SCORE) -
+           s_pivotBoundMargin;
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const PivotGallerySearch& search, TagResult& result,
+                        match_calc_t threshold)
+{
+    auto& index = search.index;
+    auto& gallery = index.Gallery();
+
+    // unbuilt index or entries that need the per entry check - the full scan decides
+    if (!index.IsBuilt() || !gallery.IsValidated(new_faceprints.version))
+    {
+        return GetScores(new_faceprints, gallery, result, threshold);
+    }
+
+    FaceprintsPivotIndex::Query query;
+    index.Project(&new_faceprints.avgDescriptor[0], query);
+
+    using block_bound_t = std::pair<match_calc_t, uint32_t>; // (grade bound, block)
+    const size_t num_blocks = index.NumBlocks();
+    std::vector<block_bound_t> bounds(num_blocks);
+    for (size_t block = 0; block < num_blocks; block++)
+    {
+        bounds[block] = {GradeBound(index.BlockBound(block, query)), static_cast<uint32_t>(block)};
+    }
+    auto later_begin = std::stable_partition(bounds.begin(), bounds.end(), [threshold](const block_bound_t& bound) {
+        return bound.first > threshold;
+    });
+
+    // too few blocks pruned to pay for the gathered rows - the streaming scan is faster
+    const size_t max_scan_blocks = static_cast<size_t>(num_blocks * s_pivotMaxGatherRatio);
+    if (static_cast<size_t>(later_begin - bounds.begin()) > max_scan_blocks)
+    {
+        return GetScores(new_faceprints, gallery, result, threshold);
+    }
+
+    std::vector<uint32_t> rows;
+    size_t count = 0;
+    const uint32_t* block_rows = index.TailRows(count);
+    rows.assign(block_rows, block_rows + count);
+    for (auto it = bounds.begin(); it != later_begin; ++it)
+    {
+        block_rows = index.BlockRows(it->second, count);
+        std::copy_if(block_rows, block_rows + count, std::back_inserter(rows),
+                     [](uint32_t row) { return row != FaceprintsPivotIndex::InvalidRow; });
+    }
+
+    // stage 1: every user that can pass the threshold, in gallery order - the first one above the threshold (the
+    // result of the full scan) is found the same way.
+    std::sort(rows.begin(), rows.end());
+    if (!ScanGalleryRows(new_faceprints, gallery, rows, threshold, result))
+    {
+        return false;
+    }
+    if (result.score > threshold)
+    {
+        return true;
+    }
+
+    // stage 2: no user passes the threshold, so the result is the best score (first index on ties). the other blocks
+    // are visited by descending bound until none can reach the best score.
+    std::sort(later_begin, bounds.end(), [](const block_bound_t& a, const block_bound_t& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    const feature_t* queryFea = &new_faceprints.avgDescriptor[0];
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    CalculateNorm(queryFea, query_norm, query_norm_msb, vec_length);
+    const uint64_t query_norm_recip = CalculateNormReciprocal(query_norm);
+
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+    const feature_t* avg_vectors = gallery.AvgVectorsData();
+    const short* avg_norm_msbs = gallery.AvgNormMsbsData();
+    const uint64_t* avg_norm_recips = gallery.AvgNormRecipsData();
+
+    for (auto it = later_begin; it != bounds.end(); ++it)
+    {
+        // a bound equal to the best score can still win on a lower index
+        if (it->first < result.score || (it->first == result.score && result.id < 0))
+        {
+            break;
+        }
+        block_rows = index.BlockRows(it->second, count);
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint32_t subjectIndex = block_rows[i];
+            if (subjectIndex == FaceprintsPivotIndex::InvalidRow)
+            {
+                continue;
+            }
+            int32_t corr = calc_dot(queryFea, avg_vectors + static_cast<size_t>(subjectIndex) * vec_length, vec_length);
+            match_calc_t adaptedScore = CalculateGrade(corr, query_norm_msb, query_norm_recip,
+                                                       avg_norm_msbs[subjectIndex], avg_norm_recips[subjectIndex]);
+            if (adaptedScore > result.score ||
+                (adaptedScore == result.score && result.id >= 0 && static_cast<int>(subjectIndex) < result.id))
+            {
+                result.score = adaptedScore;
+                result.id = static_cast<int>(subjectIndex);
+            }
+        }
+    }
+    return true;
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const QuantizedGallerySearch& search, TagResult& result,
+                        match_calc_t threshold)
+{
+    auto& index = search.index;
+    auto& gallery = index.Gallery();
+
+    // entries that need the per entry check or a zero query (no bound) - the full scan decides
+    FaceprintsQuantizedIndex::Query query;
+    if (gallery.Empty() || !gallery.IsValidated(new_faceprints.version) ||
+        !FaceprintsQuantizedIndex::Quantize(&new_faceprints.avgDescriptor[0], query))
+    {
+        return GetScores(new_faceprints, gallery, result, threshold);
+    }
+
+    result.score = 0;
+    result.id = -1;
+
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    const feature_t* queryFea = &new_faceprints.avgDescriptor[0];
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    CalculateNorm(queryFea, query_norm, query_norm_msb, vec_length);
+    const uint64_t query_norm_recip = CalculateNormReciprocal(query_norm);
+
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+    static const MatcherKernels::calc_dot_s8_func calc_dot_s8 = MatcherKernels::GetCalcDotS8();
+    const feature_t* avg_vectors = gallery.AvgVectorsData();
+    const short* avg_norm_msbs = gallery.AvgNormMsbsData();
+    const uint64_t* avg_norm_recips = gallery.AvgNormRecipsData();
+
+    auto exact_grade = [&](size_t subjectIndex) {
+        int32_t corr = calc_dot(queryFea, avg_vectors + subjectIndex * vec_length, vec_length);
+        return CalculateGrade(corr, query_norm_msb, query_norm_recip, avg_norm_msbs[subjectIndex],
+                              avg_norm_recips[subjectIndex]);
+    };
+
+    // stage 1: every user that can pass the threshold is rescored in gallery order - the first one above the threshold
+    // (the result of the full scan) is found the same way.
+    const size_t size = gallery.Size();
+    std::vector<match_calc_t> bounds(size);
+    size_t best_lower_index = 0;
+    float best_lower = -1;
+    for (size_t subjectIndex = 0; subjectIndex < size; subjectIndex++)
+    {
+        float lower = 0, upper = 0;
+        int32_t codes_dot = calc_dot_s8(query.codes, index.Codes(subjectIndex), vec_length);
+        index.CorrBounds(subjectIndex, query, codes_dot, lower, upper);
+        bounds[subjectIndex] = GradeBound(upper);
+        if (lower > best_lower)
+        {
+            best_lower = lower;
+            best_lower_index = subjectIndex;
+        }
+        if (bounds[subjectIndex] <= threshold)
+        {
+            continue;
+        }
+
+        match_calc_t adaptedScore = exact_grade(subjectIndex);
+        if (adaptedScore > result.score)
+        {
+            result.score = adaptedScore;
+            result.id = static_cast<int>(subjectIndex);
+        }
+        if (adaptedScore > threshold)
+        {
+            return true;
+        }
+    }
+
+    // stage 2: no user passes the threshold, so the result is the best score (first index on ties). the user with the
+    // best lower bound sets a high best score first, then only the users whose bound can reach it are rescored.
+    auto rescore = [&](size_t subjectIndex) {
+        match_calc_t adaptedScore = exact_grade(subjectIndex);
+        if (adaptedScore > result.score ||
+            (adaptedScore == result.score && result.id >= 0 && static_cast<int>(subjectIndex) < result.id))
+        {
+            result.score = adaptedScore;
+            result.id = static_cast<int>(subjectIndex);
+        }
+    };
+    if (bounds[best_lower_index] <= threshold)
+    {
+        rescore(best_lower_index);
+    }
+    for (size_t subjectIndex = 0; subjectIndex < size; subjectIndex++)
+    {
+        const match_calc_t bound = bounds[subjectIndex];
+        // users above the threshold bound were rescored in stage 1. a bound equal to the best score can still win on
+        // a lower index
+        if (bound > threshold || subjectIndex == best_lower_index || bound < result.score ||
+            (bound == result.score && (result.id < 0 || static_cast<int>(subjectIndex) > result.id)))
+        {
+            continue;
+        }
+        rescore(subjectIndex);
+    }
+    return true;
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const ProgressiveGallerySearch& search, TagResult& result,
+                        match_calc_t threshold)
+{
+    auto& index = search.index;
+    auto& gallery = index.Gallery();
+
+    // entries that need the per entry check - the full scan decides
+    if (gallery.Empty() || !gallery.IsValidated(new_faceprints.version))
+    {
+        return GetScores(new_faceprints, gallery, result, threshold);
+    }
+
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    CalculateNorm(&new_faceprints.avgDescriptor[0], query_norm, query_norm_msb);
+    const uint64_t query_norm_recip = CalculateNormReciprocal(query_norm);
+    FaceprintsProgressiveIndex::Query query;
+    index.Permute(&new_faceprints.avgDescriptor[0], query);
+
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+    const uint32_t block_length = static_cast<uint32_t>(FaceprintsProgressiveIndex::BlockLength);
+    const size_t num_blocks = FaceprintsProgressiveIndex::NumBlocks;
+    const short* avg_norm_msbs = gallery.AvgNormMsbsData();
+    const uint64_t* avg_norm_recips = gallery.AvgNormRecipsData();
+
+    // in gallery order, as the full scan: a user whose grade is at most both the threshold and the best score so far
+    // changes nothing (a later user wins no tie), so it is rejected once its correlation bound is at most
+    // limit * |x|. the margin of CorrLimit() covers the float roundings.
+    match_calc_t maxScore = s_minPossibleScore;
+    int maxSubject = -1;
+    double limit = CorrLimit(std::min(threshold, maxScore)) * query.norm;
+    const size_t size = gallery.Size();
+    for (size_t subjectIndex = 0; subjectIndex < size; subjectIndex++)
+    {
+        const double row_limit = limit * index.Norm(subjectIndex);
+        int32_t corr = 0;
+        size_t block = 0;
+        for (; block < num_blocks; block++)
+        {
+            corr += calc_dot(&query.features[block * block_length], index.Block(block, subjectIndex), block_length);
+            if (block + 1 < num_blocks && corr + query.tails[block] * index.Tail(subjectIndex, block) <= row_limit)
+            {
+                break;
+            }
+        }
+        if (block < num_blocks)
+        {
+            continue;
+        }
+
+        // all the blocks: the correlation of the full scan
+        match_calc_t adaptedScore = CalculateGrade(corr, query_norm_msb, query_norm_recip, avg_norm_msbs[subjectIndex],
+                                                   avg_norm_recips[subjectIndex]);
+        if (adaptedScore > maxScore)
+        {
+            maxScore = adaptedScore;
+            maxSubject = static_cast<int>(subjectIndex);
+            limit = CorrLimit(std::min(threshold, maxScore)) * query.norm;
+        }
+        if (adaptedScore > threshold)
+        {
+            break;
+        }
+    }
+
+    result.score = maxScore;
+    result.id = maxSubject;
+    return true;
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const GallerySnapshot& snapshot, TagResult& result,
+                        match_calc_t threshold)
+{
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    if (snapshot.Empty())
+    {
+        return false;
+    }
+
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    CalculateNorm(&new_faceprints.avgDescriptor[0], query_norm, query_norm_msb);
+
+    // segments in order - same decision as a scan of the concatenated gallery
+    for (size_t segment = 0; segment < snapshot.NumSegments(); segment++)
+    {
+        auto& gallery = snapshot.Segment(segment);
+        TagResult segment_result;
+        if (!ScanGallery(new_faceprints, query_norm, query_norm_msb, gallery, 0, gallery.Size(), threshold, nullptr,
+                         segment_result))
+        {
+            return false;
+        }
+
+        FoldScan(result, segment_result, static_cast<int>(snapshot.SegmentOffset(segment)));
+
+        if (segment_result.score > threshold)
+        {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const FaceprintsDatabase& database, TagResult& result,
+                        match_calc_t threshold)
+{
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    if (database.Size() == 0)
+    {
+        return false;
+    }
+
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    CalculateNorm(&new_faceprints.avgDescriptor[0], query_norm, query_norm_msb);
+
+    // mapped gallery file first, then the users changed since the last compaction (index space order)
+    auto& base = database.Base();
+    TagResult base_result;
+    bool base_success = database.HasRemovedBaseRows()
+                            ? ScanGalleryRows(new_faceprints, base, database.LiveBaseRows(), threshold, base_result)
+                            : ScanGallery(new_faceprints, query_norm, query_norm_msb, base, 0, base.Size(), threshold,
+                                          nullptr, base_result);
+    if (!base_success)
+    {
+        return false;
+    }
+
+    result = base_result;
+    if (base_result.score > threshold)
+    {
+        return true;
+    }
+
+    auto& delta = database.Delta();
+    TagResult delta_result;
+    if (!ScanGallery(new_faceprints, query_norm, query_norm_msb, delta, 0, delta.Size(), threshold, nullptr,
+                     delta_result))
+    {
+        return false;
+    }
+
+    FoldScan(result, delta_result, static_cast<int>(base.Size()));
+
+    return true;
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const MappedFaceprintsGallery& gallery, TagResult& result,
+                        match_calc_t threshold)
+{
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    if (gallery.Empty())
+    {
+        return false;
+    }
+
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    CalculateNorm(&new_faceprints.avgDescriptor[0], query_norm, query_norm_msb);
+
+    return ScanGallery(new_faceprints, query_norm, query_norm_msb, gallery, 0, gallery.Size(), threshold, nullptr,
+                       result);
+}
+
+bool Matcher::GetScores(const Faceprints& new_faceprints, const MultiTemplateGallery& gallery, TagResult& result,
+                        match_calc_t threshold)
+{
+    // initialize.
+    result.score = 0;
+    result.id = -1;
+    result.runnerUpId = -1;
+
+    if (gallery.Empty())
+    {
+        return false;
+    }
+
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    const feature_t* queryFea = &new_faceprints.avgDescriptor[0];
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    CalculateNorm(queryFea, query_norm, query_norm_msb, vec_length);
+    const uint64_t query_norm_recip = CalculateNormReciprocal(query_norm);
+
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+    static const MatcherKernels::calc_dot4_func calc_dot4 = MatcherKernels::GetCalcDot4();
+
+    // streaming pass over all the rows - the templates of a user are consecutive, so the rows are read once in
+    // order whatever the number of templates per user
+    const size_t rows = gallery.Rows();
+    const feature_t* avg_vectors = gallery.AvgVectorsData();
+    const FaceprintsGallery::Metadata* metadata = gallery.MetadataData();
+    const bool validated = gallery.IsValidated(new_faceprints.version);
+    const short* avg_norm_msbs = gallery.AvgNormMsbsData();
+    const uint64_t* avg_norm_recips = gallery.AvgNormRecipsData();
+    const uint32_t* row_users = gallery.RowUsersData();
+
+    match_calc_t maxScore = s_minPossibleScore;
+    int maxRow = -1;
+    uint32_t user = row_users[0];
+
+    int32_t corrs[s_gradeBlockRows];
+    match_calc_t grades[s_gradeBlockRows];
+    bool done = false;
+
+    for (size_t block_begin = 0; block_begin < rows && !done; block_begin += s_gradeBlockRows)
+    {
+        const size_t block_size = std::min(s_gradeBlockRows, rows - block_begin);
+        const feature_t* block_vectors = avg_vectors + block_begin * vec_length;
+        size_t k = 0;
+        for (; k + 4 <= block_size; k += 4)
+        {
+            calc_dot4(queryFea, block_vectors + k * vec_length, vec_length, vec_length, corrs + k);
+        }
+        for (; k < block_size; k++)
+        {
+            corrs[k] = calc_dot(queryFea, block_vectors + k * vec_length, vec_length);
+        }
+        CalculateGrades(corrs, block_size, query_norm_msb, query_norm_recip, avg_norm_msbs + block_begin,
+                        avg_norm_recips + block_begin, grades);
+
+        // max over the templates of each user: the early exit is decided once all the user's rows were graded, so
+        // the best template of the matched user is returned
+        for (k = 0; k < block_size; k++)
+        {
+            const size_t row = block_begin + k;
+            if (row_users[row] != user)
+            {
+                if (maxScore > threshold)
+                {
+                    done = true;
+                    break;
+                }
+                user = row_users[row];
+            }
+
+            if (!validated && !CheckGalleryEntry(metadata[row], new_faceprints.version))
+            {
+                return false;
+            }
+
+            if (grades[k] > maxScore)
+            {
+                maxScore = grades[k];
+                maxRow = static_cast<int>(row);
+            }
+        }
+    }
+
+    result.score = maxScore;
+    result.id = maxRow;
+
+    return true;
+}
+
+// the shards were searched (and their candidates scored) by the search already, only its best candidate is left
+bool Matcher::GetScores(const Faceprints&, const ShardedGallerySearch& search, TagResult& result, match_calc_t)
+{
+    result.score = 0;
+    result.id = -1;
+    if (!search.success)
+    {
+        return false;
+    }
+    if (!search.candidates.empty() && search.candidates[0].score > s_minPossibleScore)
+    {
+        result.score = search.candidates[0].score;
+        result.id = 0;
+    }
+    return true;
+}
+
+void Matcher::ScanGalleryBatch(const std::vector<Faceprints>& new_faceprints_array, const FaceprintsGallery& gallery,
+                               match_calc_t threshold, std::vector<TagResult>& results, std::vector<char>& success)
+{
+    const size_t number_of_queries = new_faceprints_array.size();
+    const size_t gallery_size = gallery.Size();
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+    static const MatcherKernels::calc_dot4_func calc_dot4 = MatcherKernels::GetCalcDot4();
+    static const MatcherKernels::calc_dot16_interleaved_func calc_dot16 = MatcherKernels::GetCalcDot16Interleaved();
+
+    struct QueryState
+    {
+        uint32_t norm = 1;
+        short norm_msb = 1;
+        uint64_t norm_recip = 0;
+        bool active = true;
+        bool validated = false; // gallery entries need no per entry checks for this query
+    };
+    std::vector<QueryState> queries(number_of_queries);
+
+    results.assign(number_of_queries, TagResult());
+    success.assign(number_of_queries, 1);
+
+    for (size_t q = 0; q < number_of_queries; q++)
+    {
+        auto& query_faceprints = new_faceprints_array[q];
+        results[q].score = s_minPossibleScore;
+        // invalid queries are rejected later by MatchFaceprintsToArrayImpl(), no need to score them
+        queries[q].active = ValidateVector(&query_faceprints.avgDescriptor[0], vec_length);
+        CalculateNorm(&query_faceprints.avgDescriptor[0], queries[q].norm, queries[q].norm_msb, vec_length);
+        queries[q].norm_recip = CalculateNormReciprocal(queries[q].norm);
+        queries[q].validated = gallery.IsValidated(query_faceprints.version);
+    }
+
+    if (gallery_size == 0)
+    {
+        success.assign(number_of_queries, 0);
+        return;
+    }
+
+    const feature_t* avg_vectors = gallery.AvgVectorsData();
+    const feature_t* interleaved_vectors = InterleavedVectors(gallery);
+    const FaceprintsGallery::Metadata* metadata = gallery.MetadataData();
+    const short* avg_norm_msbs = gallery.AvgNormMsbsData();
+    const uint64_t* avg_norm_recips = gallery.AvgNormRecipsData();
+
+    // tile over the gallery rows, each tile is loaded once and reused for all queries.
+    // per query the rows are still visited in order, so the results (including the early exit on threshold) are
+    // identical to the single query scan.
+    for (size_t tile_begin = 0; tile_begin < gallery_size; tile_begin += s_batchTileRows)
+    {
+        const size_t tile_end = std::min(tile_begin + s_batchTileRows, gallery_size);
+        bool any_active = false;
+
+        for (size_t q = 0; q < number_of_queries; q++)
+        {
+            auto& query = queries[q];
+            if (!query.active)
+            {
+                continue;
+            }
+            any_active = true;
+
+            auto& query_faceprints = new_faceprints_array[q];
+            const feature_t* queryFea = &query_faceprints.avgDescriptor[0];
+            auto& result = results[q];
+
+            size_t row = tile_begin;
+            while (row < tile_end && query.active)
+            {
+                int32_t corr[s_gradeBlockRows];
+                match_calc_t grades[s_gradeBlockRows];
+                size_t count = std::min(static_cast<size_t>(4), tile_end - row);
+                if (interleaved_vectors != nullptr)
+                {
+                    // tiles are made of whole interleaved blocks, the next one is prefetched for this query
+                    count = std::min(s_gradeBlockRows, tile_end - row);
+                    const feature_t* block = interleaved_vectors + row * vec_length;
+                    const feature_t* next_block =
+                        row + count < tile_end ? block + s_gradeBlockRows * vec_length : nullptr;
+                    calc_dot16(queryFea, block, next_block, vec_length, corr);
+                }
+                else if (count == 4)
+                {
+                    calc_dot4(queryFea, avg_vectors + row * vec_length, vec_length, vec_length, corr);
+                }
+                else
+                {
+                    for (size_t k = 0; k < count; k++)
+                    {
+                        corr[k] = calc_dot(queryFea, avg_vectors + (row + k) * vec_length, vec_length);
+                    }
+                }
+                CalculateGrades(corr, count, query.norm_msb, query.norm_recip, avg_norm_msbs + row,
+                                avg_norm_recips + row, grades);
+
+                for (size_t k = 0; k < count; k++)
+                {
+                    size_t subjectIndex = row + k;
+                    if (!query.validated && !CheckGalleryEntry(metadata[subjectIndex], query_faceprints.version))
+                    {
+                        success[q] = 0;
+                        query.active = false;
+                        break;
+                    }
+
+                    match_calc_t adaptedScore = grades[k];
+
+                    if (adaptedScore > result.score)
+                    {
+                        result.score = adaptedScore;
+                        result.id = static_cast<int>(subjectIndex);
+                    }
+
+                    if (adaptedScore > threshold)
+                    {
+                        query.active = false;
+                        break;
+                    }
+                }
+                row += count;
+            }
+        }
+
+        if (!any_active)
+        {
+            break;
+        }
+    }
+}
+
+template <typename Gallery>
+void Matcher::FaceMatch(const Faceprints& new_faceprints, const Gallery& existing_faceprints_array,
+                        ExtendedMatchResult& result, const MatcherConfig& config)
+{
+    result.isIdentical = false;
+    result.isSame = false;
+    result.maxScore = 0;
+    result.confidence = 0;
+    result.userId = -1;
+    result.should_update = false;
+
+    TagResult scoresResult;
+    match_calc_t threshold = config.StrongThreshold();
+
+    bool isScoreSuccess = GetScores(new_faceprints, existing_faceprints_array, scoresResult, threshold);
+
+    if (!isScoreSuccess)
+    {
+        LOG_ERROR_LIMITED(LOG_TAG, "Failed during GetScores() - please check.");
+        return;
+    }
+
+    result.maxScore = scoresResult.score;
+    result.isSame = scoresResult.score > threshold;
+    result.isIdentical = scoresResult.score > config.IdenticalPersonThreshold();
+    result.userId = scoresResult.id;
+    result.runnerUpId = scoresResult.runnerUpId;
+    result.runnerUpScore = scoresResult.runnerUpScore;
+    
+    result.confidence = config.Confidence(scoresResult.score);
+}
+
+static void SetToDefaultThresholds(Thresholds& thresholds)
+{
+    thresholds.strongThreshold = s_strongThreshold;
+    thresholds.identicalPersonThreshold = s_identicalPersonThreshold;
+    thresholds.updateThreshold = s_updateThreshold;
+}
+
+bool Matcher::ValidateFaceprints(const Faceprints& faceprints, bool check_orig)
+{
+    // TODO - carefull handling in MatchTwoVectors() may be required for vectors longer than 256.
+    static_assert((RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER <= 256),
+                  "Vector length is higher than 256 - may need careful test and check, due to integer arithmetics and "
+                  "overflow risk!");
+
+    static_assert((static_cast<int>(RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER) == NUMBER_OF_RECOGNITION_FACEPRINTS),
+                  "Faceprints feature vector length mismatch - please check!");
+
+    uint32_t nfeatures = static_cast<uint32_t>(RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER);
+    
+    bool is_valid = true;
+
+    if(check_orig)
+    {
+        is_valid = ValidateVector(&faceprints.origDescriptor[0], nfeatures);
+    }
+    else
+    {
+        is_valid = ValidateVector(&faceprints.avgDescriptor[0], nfeatures);
+    }
+    
+    if (!is_valid)
+    {
+        LOG_ERROR_LIMITED(LOG_TAG, "Vector (faceprint) validation failed!");
+    }
+
+    return is_valid;
+}
+
+void Matcher::RecordScores(const ExtendedMatchResult& result, Metrics::MatchScoreHistogram* local)
+{
+    // no search (invalid faceprints or empty gallery)
+    if (result.userId < 0)
+    {
+        return;
+    }
+    Metrics::MatchScoreSample sample;
+    sample.best_score = result.maxScore;
+    sample.runner_up_score = result.runnerUpId >= 0 ? result.runnerUpScore : -1;
+    sample.confidence = result.confidence;
+    sample.accepted = result.isSame;
+    sample.should_update = result.should_update;
+    Metrics::RecordMatchScores(sample, local);
+}
+
+template <typename Gallery>
+ExtendedMatchResult Matcher::MatchFaceprintsToArrayImpl(const Faceprints& new_faceprints,
+                                                        const Gallery& existing_faceprints_array,
+                                                        Faceprints& updated_faceprints,
+                                                        const MatcherConfig& config)
+{
+    Metrics::Add(Metrics::Counter::Matches);
+    Metrics::ScopedLatency match_latency {Metrics::Latency::Match};
+    Trace::Scope match_trace {"Match", "matcher"};
+    ExtendedMatchResult result;
+
+    result.userId = -1;
+    result.maxScore = 0;
+
+    if (!ValidateFaceprints(new_faceprints)) 
+	{
+        LOG_ERROR_LIMITED(LOG_TAG, "Faceprints vector failed range validation.");
+		return result;	
+	}
+    
+    if(GallerySize(existing_faceprints_array) <= 0)
+    {
+        LOG_ERROR_LIMITED(LOG_TAG, "Faceprints array size is 0.");
+        return result;	
+    }
+
+    if (new_faceprints.version != GalleryVersion(existing_faceprints_array, 0)) 
+    {
+        LOG_ERROR_LIMITED(LOG_TAG, "version mismatch between 2 vectors. Skipping this match()!");
+		return result;	
+    }
+
+    FaceMatch(new_faceprints, existing_faceprints_array, result, config);
+    result.should_update = (result.maxScore >= config.UpdateThreshold()) && result.isSame;
+   
+    bool enable_update = true;
+
+    // if should_update then we create an update vector such that:
+    // (1) the current vector is blended into the latest avg vector.
+    // (2) then we make sure that the updated avg vector is not too far from the orig. 
+    if (result.should_update && enable_update)
+    {      
+        // Init updated_faceprints to the faceprints already exists in the DB
+        //  
+        size_t user_index = (size_t)result.userId;
+
+        if((user_index < 0) || (user_index >= GallerySize(existing_faceprints_array)))
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "Invalid user_index : Skipping function.");
+            return result;
+        }
+
+        CopyGalleryFaceprints(existing_faceprints_array, user_index, updated_faceprints);
+
+        const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+
+        // update avg vector with the new vector
+        BlendAverageVector(&updated_faceprints.avgDescriptor[0], &new_faceprints.avgDescriptor[0],
+                                vec_length);
+
+        // make sure avg vector is not too far from orig vector
+        UpdateAverageVector(&updated_faceprints.avgDescriptor[0], &updated_faceprints.origDescriptor[0],
+                            vec_length);
+    }
+ 
+    return result;
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const std::vector<ExtendedFaceprints>& existing_faceprints_array,
+                                                    Faceprints& updated_faceprints)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, existing_faceprints_array, updated_faceprints,
+                                      MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const std::vector<ExtendedFaceprints>& existing_faceprints_array,
+                                                    Faceprints& updated_faceprints, Thresholds thresholds)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, existing_faceprints_array, updated_faceprints,
+                                      MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const std::vector<GalleryFaceprints>& gallery,
+                                                    Faceprints& updated_faceprints)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, gallery, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const std::vector<GalleryFaceprints>& gallery,
+                                                    Faceprints& updated_faceprints, Thresholds thresholds)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, gallery, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const FaceprintsGallery& gallery, Faceprints& updated_faceprints)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, gallery, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const FaceprintsGallery& gallery, Faceprints& updated_faceprints,
+                                                    Thresholds thresholds)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, gallery, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const FaceprintsGallery& gallery, Faceprints& updated_faceprints,
+                                                    const MatcherConfig& config)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, gallery, updated_faceprints, config);
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const FaceprintsGallery& gallery, Faceprints& updated_faceprints,
+                                                    MatcherThreadPool& pool)
+{
+    ParallelGallerySearch search {gallery, pool};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const FaceprintsGallery& gallery, Faceprints& updated_faceprints,
+                                                    Thresholds thresholds, MatcherThreadPool& pool)
+{
+    ParallelGallerySearch search {gallery, pool};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const FaceprintsGallery& gallery, Faceprints& updated_faceprints,
+                                                    const MatcherConfig& config, MatcherThreadPool& pool)
+{
+    ParallelGallerySearch search {gallery, pool};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, config);
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                               const FaceprintsGallery& gallery,
+                                                               std::vector<Faceprints>& updated_faceprints_array)
+{
+    return MatchFaceprintsBatch(new_faceprints_array, gallery, updated_faceprints_array, MatcherConfig::Default());
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                               const FaceprintsGallery& gallery,
+                                                               std::vector<Faceprints>& updated_faceprints_array,
+                                                               Thresholds thresholds)
+{
+    return MatchFaceprintsBatch(new_faceprints_array, gallery, updated_faceprints_array, MatcherConfig {thresholds});
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                               const FaceprintsGallery& gallery,
+                                                               std::vector<Faceprints>& updated_faceprints_array,
+                                                               const MatcherConfig& config)
+{
+    Metrics::ScopedLatency match_latency {Metrics::Latency::Match};
+    const size_t number_of_queries = new_faceprints_array.size();
+    Trace::Scope match_trace {"MatchBatch", "matcher"};
+    match_trace.SetValue(static_cast<int64_t>(number_of_queries));
+
+    // score all queries in one tiled pass over the gallery
+    std::vector<TagResult> scores;
+    std::vector<char> success;
+    ScanGalleryBatch(new_faceprints_array, gallery, config.StrongThreshold(), scores, success);
+
+    return FinishBatch(new_faceprints_array, gallery, scores, success, config, &updated_faceprints_array, nullptr);
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                               const FaceprintsGallery& gallery,
+                                                               GalleryUpdateQueue& updates)
+{
+    return MatchFaceprintsBatch(new_faceprints_array, gallery, updates, MatcherConfig::Default());
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                               const FaceprintsGallery& gallery,
+                                                               GalleryUpdateQueue& updates, Thresholds thresholds)
+{
+    return MatchFaceprintsBatch(new_faceprints_array, gallery, updates, MatcherConfig {thresholds});
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                               const FaceprintsGallery& gallery,
+                                                               GalleryUpdateQueue& updates, const MatcherConfig& config)
+{
+    if (&updates.Gallery() != &gallery)
+    {
+        LOG_ERROR(LOG_TAG, "Updater of another gallery : Skipping function.");
+        return std::vector<ExtendedMatchResult>(new_faceprints_array.size());
+    }
+
+    Metrics::ScopedLatency match_latency {Metrics::Latency::Match};
+    Trace::Scope match_trace {"MatchBatch", "matcher"};
+    match_trace.SetValue(static_cast<int64_t>(new_faceprints_array.size()));
+
+    std::vector<TagResult> scores;
+    std::vector<char> success;
+    ScanGalleryBatch(new_faceprints_array, gallery, config.StrongThreshold(), scores, success);
+
+    return FinishBatch(new_faceprints_array, gallery, scores, success, config, nullptr, &updates);
+}
+
+std::vector<ExtendedMatchResult> Matcher::FinishBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                      const FaceprintsGallery& gallery,
+                                                      const std::vector<TagResult>& scores,
+                                                      const std::vector<char>& success, const MatcherConfig& config,
+                                                      std::vector<Faceprints>* updated_faceprints_array,
+                                                      GalleryUpdateQueue* updates)
+{
+    const size_t number_of_queries = new_faceprints_array.size();
+    Metrics::Add(Metrics::Counter::Matches, number_of_queries);
+    std::vector<ExtendedMatchResult> results(number_of_queries);
+    if (updated_faceprints_array != nullptr)
+    {
+        updated_faceprints_array->resize(number_of_queries);
+    }
+
+    // decisions (the checks of MatchFaceprintsToArrayImpl() and FaceMatch())
+    const match_calc_t threshold = config.StrongThreshold();
+    std::vector<match_calc_t> max_scores(number_of_queries, 0);
+    for (size_t q = 0; q < number_of_queries; q++)
+    {
+        const Faceprints& new_faceprints = new_faceprints_array[q];
+        if (!ValidateFaceprints(new_faceprints))
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "Faceprints vector failed range validation.");
+            continue;
+        }
+        if (gallery.Empty())
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "Faceprints array size is 0.");
+            continue;
+        }
+        if (new_faceprints.version != GalleryVersion(gallery, 0))
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "version mismatch between 2 vectors. Skipping this match()!");
+            continue;
+        }
+        if (!success[q])
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "Failed during GetScores() - please check.");
+            continue;
+        }
+
+        auto& result = results[q];
+        result.maxScore = scores[q].score;
+        result.isSame = scores[q].score > threshold;
+        result.isIdentical = scores[q].score > config.IdenticalPersonThreshold();
+        result.userId = scores[q].id;
+        result.should_update = (result.maxScore >= config.UpdateThreshold()) && result.isSame;
+        max_scores[q] = result.maxScore;
+    }
+
+    // confidences in one pass (0 for the failed queries, as their score)
+    std::vector<match_calc_t> confidences(number_of_queries, 0);
+    config.Confidences(max_scores.data(), number_of_queries, confidences.data());
+    for (size_t q = 0; q < number_of_queries; q++)
+    {
+        results[q].confidence = confidences[q];
+    }
+
+    // updates of the matched users, blended here or deferred to the updater
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    for (size_t q = 0; q < number_of_queries; q++)
+    {
+        if (!results[q].should_update)
+        {
+            continue;
+        }
+        const size_t user_index = static_cast<size_t>(results[q].userId);
+        if (user_index >= gallery.Size())
+        {
+            LOG_ERROR_LIMITED(LOG_TAG, "Invalid user_index : Skipping function.");
+            continue;
+        }
+        if (updates != nullptr)
+        {
+            updates->Push(user_index, gallery.UserId(user_index), new_faceprints_array[q]);
+            continue;
+        }
+
+        Faceprints& updated_faceprints = (*updated_faceprints_array)[q];
+        CopyGalleryFaceprints(gallery, user_index, updated_faceprints);
+        BlendAverageVector(&updated_faceprints.avgDescriptor[0], &new_faceprints_array[q].avgDescriptor[0],
+                           vec_length);
+        UpdateAverageVector(&updated_faceprints.avgDescriptor[0], &updated_faceprints.origDescriptor[0], vec_length);
+    }
+    return results;
+}
+
+void Matcher::ScanDeviceGalleryBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                     const DeviceFaceprintsGallery& gallery, match_calc_t threshold,
+                                     std::vector<TagResult>& results, std::vector<char>& success)
+{
+    const FaceprintsGallery& host = gallery.Host();
+    const size_t number_of_queries = new_faceprints_array.size();
+    std::vector<char> on_device(number_of_queries, 0);
+
+    results.assign(number_of_queries, TagResult());
+    success.assign(number_of_queries, 0);
+
+#ifdef RSID_MATCHER_OPENCL
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    // the device scores valid queries against a gallery that needs no per entry checks for their version, the cpu
+    // scan handles (and reports) everything else.
+    std::vector<size_t> device_queries;
+    std::vector<Faceprints> device_faceprints;
+    for (size_t q = 0; q < number_of_queries && !host.Empty(); q++)
+    {
+        auto& query_faceprints = new_faceprints_array[q];
+        if (ValidateVector(&query_faceprints.avgDescriptor[0], vec_length) && host.IsValidated(query_faceprints.version))
+        {
+            device_queries.push_back(q);
+            device_faceprints.push_back(query_faceprints);
+        }
+    }
+
+    std::unique_lock<std::mutex> device_lock;
+    OpenClMatchContext* device = device_queries.empty() ? nullptr : gallery.AcquireDevice(device_lock);
+    std::vector<OpenClMatchContext::BatchMatch> matches;
+    if (device != nullptr && device->MatchBatch(device_faceprints.data(), device_faceprints.size(), threshold, matches))
+    {
+        static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+
+        for (size_t i = 0; i < device_queries.size(); i++)
+        {
+            const size_t q = device_queries[i];
+            auto& match = matches[i];
+            auto& result = results[q];
+
+            if (match.first_above >= 0)
+            {
+                // the first row above threshold ends the scan - only its score is left to calculate
+                const feature_t* queryFea = &device_faceprints[i].avgDescriptor[0];
+                const size_t row = static_cast<size_t>(match.first_above);
+                uint32_t query_norm = 1;
+                short query_norm_msb = 1;
+                CalculateNorm(queryFea, query_norm, query_norm_msb, vec_length);
+                int32_t corr = calc_dot(queryFea, host.AvgVector(row), vec_length);
+                result.id = match.first_above;
+                result.score = CalculateGrade(corr, query_norm_msb, CalculateNormReciprocal(query_norm),
+                                              host.AvgNormMsb(row), host.AvgNormRecip(row));
+            }
+            else
+            {
+                result.id = match.best_row;
+                result.score = match.best_score;
+            }
+            success[q] = 1;
+            on_device[q] = 1;
+        }
+    }
+    else if (device != nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Device match failed on %s, matching on the cpu", device->DeviceName().c_str());
+    }
+#endif // RSID_MATCHER_OPENCL
+
+    std::vector<size_t> cpu_queries;
+    std::vector<Faceprints> cpu_faceprints;
+    for (size_t q = 0; q < number_of_queries; q++)
+    {
+        if (!on_device[q])
+        {
+            cpu_queries.push_back(q);
+            cpu_faceprints.push_back(new_faceprints_array[q]);
+        }
+    }
+    if (cpu_queries.empty())
+    {
+        return;
+    }
+
+    std::vector<TagResult> cpu_results;
+    std::vector<char> cpu_success;
+    ScanGalleryBatch(cpu_faceprints, host, threshold, cpu_results, cpu_success);
+    for (size_t i = 0; i < cpu_queries.size(); i++)
+    {
+        results[cpu_queries[i]] = cpu_results[i];
+        success[cpu_queries[i]] = cpu_success[i];
+    }
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                               const DeviceFaceprintsGallery& gallery,
+                                                               std::vector<Faceprints>& updated_faceprints_array)
+{
+    Thresholds thresholds;
+    SetToDefaultThresholds(thresholds);
+    return MatchFaceprintsBatch(new_faceprints_array, gallery, updated_faceprints_array, thresholds);
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                               const DeviceFaceprintsGallery& gallery,
+                                                               std::vector<Faceprints>& updated_faceprints_array,
+                                                               Thresholds thresholds)
+{
+    Metrics::ScopedLatency match_latency {Metrics::Latency::Match};
+    const size_t number_of_queries = new_faceprints_array.size();
+    Trace::Scope match_trace {"MatchBatch", "matcher"};
+    match_trace.SetValue(static_cast<int64_t>(number_of_queries));
+
+    std::vector<TagResult> scores;
+    std::vector<char> success;
+    ScanDeviceGalleryBatch(new_faceprints_array, gallery, thresholds.strongThreshold, scores, success);
+
+    return FinishBatch(new_faceprints_array, gallery.Host(), scores, success, MatcherConfig {thresholds},
+                       &updated_faceprints_array, nullptr);
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const DeviceFaceprintsGallery& gallery,
+                                                    Faceprints& updated_faceprints)
+{
+    Thresholds thresholds;
+    SetToDefaultThresholds(thresholds);
+    return MatchFaceprintsToArray(new_faceprints, gallery, updated_faceprints, thresholds);
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                    const DeviceFaceprintsGallery& gallery,
+                                                    Faceprints& updated_faceprints, Thresholds thresholds)
+{
+    std::vector<Faceprints> updated_faceprints_array;
+    auto results = MatchFaceprintsBatch(std::vector<Faceprints> {new_faceprints}, gallery, updated_faceprints_array,
+                                        thresholds);
+    updated_faceprints = updated_faceprints_array[0];
+    return results[0];
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArrayPrefiltered(const Faceprints& new_faceprints,
+                                                               const FaceprintsGallery& gallery,
+                                                               Faceprints& updated_faceprints, size_t shortlist_size)
+{
+    PrefilteredGallerySearch search {gallery, shortlist_size};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArrayPrefiltered(const Faceprints& new_faceprints,
+                                                               const FaceprintsGallery& gallery,
+                                                               Faceprints& updated_faceprints, size_t shortlist_size,
+                                                               Thresholds thresholds)
+{
+    PrefilteredGallerySearch search {gallery, shortlist_size};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsIvfIndex& index,
+                                                   Faceprints& updated_faceprints, size_t nprobe)
+{
+    IvfGallerySearch search {index, nprobe};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsIvfIndex& index,
+                                                   Faceprints& updated_faceprints, size_t nprobe,
+                                                   Thresholds thresholds)
+{
+    IvfGallerySearch search {index, nprobe};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsIvfIndex& index,
+                                                   Faceprints& updated_faceprints, DeadlineSearch& search,
+                                                   MatcherThreadPool& pool)
+{
+    DeadlineGallerySearch deadline_search {index, search, pool};
+    return MatchFaceprintsToArrayImpl(new_faceprints, deadline_search, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsIvfIndex& index,
+                                                   Faceprints& updated_faceprints, DeadlineSearch& search,
+                                                   Thresholds thresholds, MatcherThreadPool& pool)
+{
+    DeadlineGallerySearch deadline_search {index, search, pool};
+    return MatchFaceprintsToArrayImpl(new_faceprints, deadline_search, updated_faceprints,
+                                      MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const FaceprintsPivotIndex& index, Faceprints& updated_faceprints)
+{
+    PivotGallerySearch search {index};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const FaceprintsPivotIndex& index, Faceprints& updated_faceprints,
+                                                   Thresholds thresholds)
+{
+    PivotGallerySearch search {index};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const FaceprintsQuantizedIndex& index,
+                                                   Faceprints& updated_faceprints)
+{
+    QuantizedGallerySearch search {index};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const FaceprintsQuantizedIndex& index,
+                                                   Faceprints& updated_faceprints, Thresholds thresholds)
+{
+    QuantizedGallerySearch search {index};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const FaceprintsProgressiveIndex& index,
+                                                   Faceprints& updated_faceprints)
+{
+    ProgressiveGallerySearch search {index};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const FaceprintsProgressiveIndex& index,
+                                                   Faceprints& updated_faceprints, Thresholds thresholds)
+{
+    ProgressiveGallerySearch search {index};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                   const GalleryGroups& groups, const uint32_t* allowed_groups,
+                                                   size_t num_allowed_groups, Faceprints& updated_faceprints)
+{
+    Thresholds thresholds;
+    SetToDefaultThresholds(thresholds);
+    return MatchFaceprintsToArray(new_faceprints, gallery, groups, allowed_groups, num_allowed_groups,
+                                  updated_faceprints, thresholds);
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                   const GalleryGroups& groups, const uint32_t* allowed_groups,
+                                                   size_t num_allowed_groups, Faceprints& updated_faceprints,
+                                                   Thresholds thresholds)
+{
+    if (groups.Size() != gallery.Size())
+    {
+        LOG_ERROR(LOG_TAG, "Gallery groups are out of sync with the gallery");
+        return ExtendedMatchResult {};
+    }
+    ScopedGallerySearch search {gallery, {}};
+    groups.GetMembers(allowed_groups, num_allowed_groups, search.rows);
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::VerifyFaceprints(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                             size_t index, Faceprints& updated_faceprints)
+{
+    Thresholds thresholds;
+    SetToDefaultThresholds(thresholds);
+    return VerifyFaceprints(new_faceprints, gallery, index, updated_faceprints, thresholds);
+}
+
+ExtendedMatchResult Matcher::VerifyFaceprints(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                             size_t index, Faceprints& updated_faceprints, Thresholds thresholds)
+{
+    if (index >= gallery.Size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user_index : Skipping function.");
+        return ExtendedMatchResult {};
+    }
+    // a scoped search of the one row
+    ScopedGallerySearch search {gallery, {static_cast<uint32_t>(index)}};
+    return MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints, const GallerySnapshot& snapshot,
+                                                   Faceprints& updated_faceprints)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, snapshot, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints, const GallerySnapshot& snapshot,
+                                                   Faceprints& updated_faceprints, Thresholds thresholds)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, snapshot, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const FaceprintsDatabase& database, Faceprints& updated_faceprints)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, database, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const FaceprintsDatabase& database, Faceprints& updated_faceprints,
+                                                   Thresholds thresholds)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, database, updated_faceprints, MatcherConfig {thresholds});
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const MappedFaceprintsGallery& gallery,
+                                                   Faceprints& updated_faceprints)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, gallery, updated_faceprints, MatcherConfig::Default());
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const MappedFaceprintsGallery& gallery,
+                                                   Faceprints& updated_faceprints, Thresholds thresholds)
+{
+    return MatchFaceprintsToArrayImpl(new_faceprints, gallery, updated_faceprints, MatcherConfig {thresholds});
+}
+
+// the scan works on rows, the result is translated to the user and its template
+static ExtendedMatchResult ToUserResult(const MultiTemplateGallery& gallery, ExtendedMatchResult result,
+                                        int& matched_template)
+{
+    matched_template = -1;
+    if (result.userId >= 0 && static_cast<size_t>(result.userId) < gallery.Rows())
+    {
+        auto row = static_cast<size_t>(result.userId);
+        auto user = gallery.RowUser(row);
+        matched_template = static_cast<int>(row - gallery.FirstRow(user));
+        result.userId = static_cast<int>(user);
+    }
+    return result;
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const MultiTemplateGallery& gallery, Faceprints& updated_faceprints,
+                                                   int& matched_template)
+{
+    return ToUserResult(gallery,
+                        MatchFaceprintsToArrayImpl(new_faceprints, gallery, updated_faceprints,
+                                                   MatcherConfig::Default()),
+                        matched_template);
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                   const MultiTemplateGallery& gallery, Faceprints& updated_faceprints,
+                                                   int& matched_template, Thresholds thresholds)
+{
+    return ToUserResult(gallery,
+                        MatchFaceprintsToArrayImpl(new_faceprints, gallery, updated_faceprints,
+                                                   MatcherConfig {thresholds}),
+                        matched_template);
+}
+
+bool Matcher::MatchFaceprintsTopK(const Faceprints& new_faceprints, const FaceprintsGallery& gallery, size_t k,
+                                  bool exhaustive, std::vector<MatchCandidate>& candidates)
+{
+    Thresholds thresholds;
+    SetToDefaultThresholds(thresholds);
+    return MatchFaceprintsTopK(new_faceprints, gallery, k, exhaustive, candidates, thresholds);
+}
+
+// heap order - the worst candidate is at the front (lower score, or same score and higher index).
+static bool IsBetterCandidate(const MatchCandidate& lhs, const MatchCandidate& rhs)
+{
+    return (lhs.score > rhs.score) || (lhs.score == rhs.score && lhs.userId < rhs.userId);
+}
+
+bool Matcher::MatchFaceprintsTopK(const Faceprints& new_faceprints, const FaceprintsGallery& gallery, size_t k,
+                                  bool exhaustive, std::vector<MatchCandidate>& candidates, Thresholds thresholds)
+{
+    candidates.clear();
+
+    if (k == 0)
+    {
+        return true;
+    }
+
+    if (!ValidateFaceprints(new_faceprints))
+    {
+        LOG_ERROR(LOG_TAG, "Faceprints vector failed range validation.");
+        return false;
+    }
+
+    if (gallery.Empty())
+    {
+        LOG_ERROR(LOG_TAG, "Faceprints array size is 0.");
+        return false;
+    }
+
+    const feature_t* queryFea = &new_faceprints.avgDescriptor[0];
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    const match_calc_t threshold = thresholds.strongThreshold;
+
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    CalculateNorm(queryFea, query_norm, query_norm_msb, vec_length);
+    const uint64_t query_norm_recip = CalculateNormReciprocal(query_norm);
+
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
 
-        if (!IsSameVersion(new_faceprints, existing_faceprints.faceprints))
+    const feature_t* avg_vectors = gallery.AvgVectorsData();
+    const FaceprintsGallery::Metadata* metadata = gallery.MetadataData();
+    // entries were validated on insert - only the correlation is left per subject
+    const bool validated = gallery.IsValidated(new_faceprints.version);
+    const short* avg_norm_msbs = gallery.AvgNormMsbsData();
+    const uint64_t* avg_norm_recips = gallery.AvgNormRecipsData();
+
+    candidates.reserve(k);
+    size_t gallery_size = gallery.Size();
+
+    for (size_t subjectIndex = 0; subjectIndex < gallery_size; subjectIndex++)
+    {
+        if (!validated && !CheckGalleryEntry(metadata[subjectIndex], new_faceprints.version))
         {
-            LOG_ERROR(LOG_TAG, "Mismatch in faceprints versions");
+            candidates.clear();
             return false;
         }
 
-        MatchTwoVectors((feature_t*)queryFea, (feature_t*)(&existing_faceprints.faceprints.avgDescriptor[0]), 
-                        &adaptedScore, vec_length);
+        MatchCandidate candidate;
+        candidate.userId = static_cast<int>(subjectIndex);
+        int32_t corr = calc_dot(queryFea, avg_vectors + subjectIndex * vec_length, vec_length);
+        candidate.score = CalculateGrade(corr, query_norm_msb, query_norm_recip, avg_norm_msbs[subjectIndex],
+                                         avg_norm_recips[subjectIndex]);
 
-
-        if (adaptedScore > maxScore)
+        if (candidates.size() < k)
         {
-            maxScore = adaptedScore;
-            maxSubject = static_cast<int>(subjectIndex);
+            candidates.push_back(candidate);
+            std::push_heap(candidates.begin(), candidates.end(), IsBetterCandidate);
+        }
+        else if (IsBetterCandidate(candidate, candidates.front()))
+        {
+            std::pop_heap(candidates.begin(), candidates.end(), IsBetterCandidate);
+            candidates.back() = candidate;
+            std::push_heap(candidates.begin(), candidates.end(), IsBetterCandidate);
         }
 
-        if (adaptedScore > threshold)
+        // all k candidates are above threshold - no need to look further
+        if (!exhaustive && candidates.size() == k && candidates.front().score > threshold)
         {
             break;
         }
     }
 
-    result.score = maxScore;
-    result.id = maxSubject;
+    std::sort_heap(candidates.begin(), candidates.end(), IsBetterCandidate);
+
+    ExtendedMatchResult unused_result;
+    for (auto& candidate : candidates)
+    {
+        candidate.confidence = CalculateConfidence(candidate.score, threshold, unused_result);
+    }
 
     return true;
 }
 
-void Matcher::FaceMatch(const Faceprints& new_faceprints,
-                        const std::vector<ExtendedFaceprints>& existing_faceprints_array, ExtendedMatchResult& result,
-                        Thresholds& thresholds)
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints, const ShardedGallery& gallery,
+                                                    Faceprints& updated_faceprints, std::string& matched_user_id)
 {
-    result.isIdentical = false;
-    result.isSame = false;
-    result.maxScore = 0;
-    result.confidence = 0;
-    result.userId = -1;
-    result.should_update = false;
+    Thresholds thresholds;
+    SetToDefaultThresholds(thresholds);
+    return MatchFaceprintsToArray(new_faceprints, gallery, updated_faceprints, matched_user_id, thresholds);
+}
 
-    TagResult scoresResult;
-    match_calc_t threshold = thresholds.strongThreshold;
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints, const ShardedGallery& gallery,
+                                                    Faceprints& updated_faceprints, std::string& matched_user_id,
+                                                    Thresholds thresholds)
+{
+    matched_user_id.clear();
 
-    bool isScoreSuccess = GetScores(new_faceprints, existing_faceprints_array, scoresResult, threshold);
+    ShardedGallerySearch search;
+    search.success = ValidateFaceprints(new_faceprints) && gallery.Search(new_faceprints, 1, search.candidates);
 
-    if (!isScoreSuccess)
+    ExtendedMatchResult result = MatchFaceprintsToArrayImpl(new_faceprints, search, updated_faceprints,
+                                                            MatcherConfig {thresholds});
+    if (result.userId == 0)
     {
-        LOG_ERROR(LOG_TAG, "Failed during GetScores() - please check.");
-        return;
+        matched_user_id = search.candidates[0].user_id;
     }
-
-    result.maxScore = scoresResult.score;
-    result.isSame = scoresResult.score > threshold;
-    result.isIdentical = scoresResult.score > s_identicalPersonThreshold;
-    result.userId = scoresResult.id;
-    
-    result.confidence = CalculateConfidence(scoresResult.score, threshold, result);
+    return result;
 }
 
-static void SetToDefaultThresholds(Thresholds& thresholds)
+bool Matcher::ScoreGallery(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                           std::vector<match_calc_t>& scores)
 {
-    thresholds.strongThreshold = s_strongThreshold;
-    thresholds.identicalPersonThreshold = s_identicalPersonThreshold;
-    thresholds.updateThreshold = s_updateThreshold;
-}
+    scores.clear();
 
-bool Matcher::ValidateFaceprints(const Faceprints& faceprints, bool check_orig)
-{
-    // TODO - carefull handling in MatchTwoVectors() may be required for vectors longer than 256.
-    static_assert((RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER <= 256),
-                  "Vector length is higher than 256 - may need careful test and check, due to integer arithmetics and "
-                  "overflow risk!");
+    if (!ValidateFaceprints(new_faceprints))
+    {
+        LOG_ERROR(LOG_TAG, "Faceprints vector failed range validation.");
+        return false;
+    }
 
-    static_assert((static_cast<int>(RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER) == NUMBER_OF_RECOGNITION_FACEPRINTS),
-                  "Faceprints feature vector length mismatch - please check!");
+    const feature_t* queryFea = &new_faceprints.avgDescriptor[0];
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    const size_t gallery_size = gallery.Size();
 
-    uint32_t nfeatures = static_cast<uint32_t>(RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER);
-    
-    bool is_valid = true;
+    if (!gallery.IsValidated(new_faceprints.version))
+    {
+        const FaceprintsGallery::Metadata* metadata = gallery.MetadataData();
+        for (size_t subjectIndex = 0; subjectIndex < gallery_size; subjectIndex++)
+        {
+            if (!CheckGalleryEntry(metadata[subjectIndex], new_faceprints.version))
+            {
+                return false;
+            }
+        }
+    }
 
-    if(check_orig)
+    uint32_t query_norm = 1;
+    short query_norm_msb = 1;
+    CalculateNorm(queryFea, query_norm, query_norm_msb, vec_length);
+    const uint64_t query_norm_recip = CalculateNormReciprocal(query_norm);
+
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+    static const MatcherKernels::calc_dot4_func calc_dot4 = MatcherKernels::GetCalcDot4();
+
+    const feature_t* avg_vectors = gallery.AvgVectorsData();
+    const short* avg_norm_msbs = gallery.AvgNormMsbsData();
+    const uint64_t* avg_norm_recips = gallery.AvgNormRecipsData();
+
+    scores.resize(gallery_size);
+    int32_t corrs[s_gradeBlockRows];
+
+    for (size_t block_begin = 0; block_begin < gallery_size; block_begin += s_gradeBlockRows)
     {
-        is_valid = ValidateVector(&faceprints.origDescriptor[0], nfeatures);
+        const size_t block_size = std::min(s_gradeBlockRows, gallery_size - block_begin);
+        const feature_t* block_vectors = avg_vectors + block_begin * vec_length;
+
+        size_t k = 0;
+        for (; k + 4 <= block_size; k += 4)
+        {
+            calc_dot4(queryFea, block_vectors + k * vec_length, vec_length, vec_length, corrs + k);
+        }
+        for (; k < block_size; k++)
+        {
+            corrs[k] = calc_dot(queryFea, block_vectors + k * vec_length, vec_length);
+        }
+        CalculateGrades(corrs, block_size, query_norm_msb, query_norm_recip, avg_norm_msbs + block_begin,
+                        avg_norm_recips + block_begin, &scores[block_begin]);
     }
-    else
+
+    return true;
+}
+
+bool Matcher::FindSimilarPairs(const FaceprintsGallery& gallery, match_calc_t threshold, MatcherThreadPool& pool,
+                               const std::function<bool(const SimilarPair* pairs, size_t count)>& on_pairs)
+{
+    Trace::Scope pairs_trace {"FindSimilarPairs", "matcher"};
+    const size_t gallery_size = gallery.Size();
+    if (gallery_size < 2)
     {
-        is_valid = ValidateVector(&faceprints.avgDescriptor[0], nfeatures);
+        return true;
     }
-    
-    if (!is_valid)
+
+    const FaceprintsGallery::Metadata* metadata = gallery.MetadataData();
+    const int version = metadata[0].version;
+    if (!gallery.IsValidated(version))
     {
-        LOG_ERROR(LOG_TAG, "Vector (faceprint) validation failed!");
+        for (size_t subjectIndex = 0; subjectIndex < gallery_size; subjectIndex++)
+        {
+            if (!CheckGalleryEntry(metadata[subjectIndex], version))
+            {
+                return false;
+            }
+        }
     }
 
-    return is_valid;
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+    static const MatcherKernels::calc_dot4_func calc_dot4 = MatcherKernels::GetCalcDot4();
+    static const MatcherKernels::calc_dot16_interleaved_func calc_dot16 = MatcherKernels::GetCalcDot16Interleaved();
+
+    const feature_t* avg_vectors = gallery.AvgVectorsData();
+    const feature_t* interleaved_vectors = InterleavedVectors(gallery);
+    // the gallery's cached norms are those of the entries matched as queries
+    const short* avg_norm_msbs = gallery.AvgNormMsbsData();
+    const uint64_t* avg_norm_recips = gallery.AvgNormRecipsData();
+
+    // score the rows of tile a against the later rows of tile b (a <= b)
+    auto score_tiles = [&](size_t a, size_t b, std::vector<SimilarPair>& pairs) {
+        const size_t a_end = std::min((a + 1) * s_pairTileRows, gallery_size);
+        const size_t b_end = std::min((b + 1) * s_pairTileRows, gallery_size);
+        int32_t corrs[s_gradeBlockRows];
+        match_calc_t grades[s_gradeBlockRows];
+        for (size_t row = a * s_pairTileRows; row < a_end; row++)
+        {
+            const feature_t* queryFea = avg_vectors + row * vec_length;
+            // whole blocks, the rows up to the query's of the diagonal tile are skipped after scoring
+            const size_t first = a == b ? row + 1 : b * s_pairTileRows;
+            for (size_t block_begin = first / s_gradeBlockRows * s_gradeBlockRows; block_begin < b_end;
+                 block_begin += s_gradeBlockRows)
+            {
+                const size_t block_size = std::min(s_gradeBlockRows, b_end - block_begin);
+                size_t k = 0;
+                if (interleaved_vectors != nullptr)
+                {
+                    const feature_t* block = interleaved_vectors + block_begin * vec_length;
+                    const feature_t* next_block =
+                        block_begin + s_gradeBlockRows < b_end ? block + s_gradeBlockRows * vec_length : nullptr;
+                    calc_dot16(queryFea, block, next_block, vec_length, corrs);
+                    k = block_size;
+                }
+                const feature_t* block_vectors = avg_vectors + block_begin * vec_length;
+                for (; k + 4 <= block_size; k += 4)
+                {
+                    calc_dot4(queryFea, block_vectors + k * vec_length, vec_length, vec_length, corrs + k);
+                }
+                for (; k < block_size; k++)
+                {
+                    corrs[k] = calc_dot(queryFea, block_vectors + k * vec_length, vec_length);
+                }
+                CalculateGrades(corrs, block_size, avg_norm_msbs[row], avg_norm_recips[row],
+                                avg_norm_msbs + block_begin, avg_norm_recips + block_begin, grades);
+                for (k = block_begin < first ? first - block_begin : 0; k < block_size; k++)
+                {
+                    if (grades[k] > threshold)
+                    {
+                        SimilarPair pair;
+                        pair.first = static_cast<uint32_t>(row);
+                        pair.second = static_cast<uint32_t>(block_begin + k);
+                        pair.score = grades[k];
+                        pairs.push_back(pair);
+                    }
+                }
+            }
+        }
+    };
+
+    // task t scores tile rows t and num_tiles - 1 - t of the upper triangle, num_tiles + 1 tile pairs for each task
+    const size_t num_tiles = (gallery_size + s_pairTileRows - 1) / s_pairTileRows;
+    std::mutex sink_mutex;
+    std::atomic<bool> stopped {false};
+    pool.Run((num_tiles + 1) / 2, [&](size_t task) {
+        std::vector<SimilarPair> pairs;
+        const size_t rows[2] = {task, num_tiles - 1 - task};
+        for (size_t r = 0; r < (rows[0] == rows[1] ? 1u : 2u); r++)
+        {
+            for (size_t b = rows[r]; b < num_tiles && !stopped; b++)
+            {
+                pairs.clear();
+                score_tiles(rows[r], b, pairs);
+                if (!pairs.empty())
+                {
+                    std::lock_guard<std::mutex> lock {sink_mutex};
+                    if (!stopped && !on_pairs(pairs.data(), pairs.size()))
+                    {
+                        stopped = true;
+                    }
+                }
+            }
+        }
+    });
+    return !stopped;
 }
 
-ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
-                                                    const std::vector<ExtendedFaceprints>& existing_faceprints_array,
-                                                    Faceprints& updated_faceprints)
+std::vector<char> Matcher::MatchFaceprintsTopKBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                    const DeviceFaceprintsGallery& gallery, size_t k,
+                                                    std::vector<std::vector<MatchCandidate>>& candidates)
 {
     Thresholds thresholds;
     SetToDefaultThresholds(thresholds);
-    ExtendedMatchResult result;
-    
-    result.userId = -1;
-    result.maxScore = 0;
+    return MatchFaceprintsTopKBatch(new_faceprints_array, gallery, k, candidates, thresholds);
+}
 
-    if (!ValidateFaceprints(new_faceprints)) 
-	{
-        LOG_ERROR(LOG_TAG, "Faceprints vector failed range validation.");
-		return result;	
-	}
-    
-    if(existing_faceprints_array.size() <= 0)
+std::vector<char> Matcher::MatchFaceprintsTopKBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                    const DeviceFaceprintsGallery& gallery, size_t k,
+                                                    std::vector<std::vector<MatchCandidate>>& candidates,
+                                                    Thresholds thresholds)
+{
+    const FaceprintsGallery& host = gallery.Host();
+    const size_t number_of_queries = new_faceprints_array.size();
+    std::vector<char> success(number_of_queries, 0);
+    std::vector<char> on_device(number_of_queries, 0);
+    candidates.assign(number_of_queries, std::vector<MatchCandidate>());
+
+#ifdef RSID_MATCHER_OPENCL
+    std::vector<size_t> device_queries;
+    std::vector<Faceprints> device_faceprints;
+    for (size_t q = 0; q < number_of_queries && k > 0 && k <= OpenClMatchContext::MaxTopK && !host.Empty(); q++)
     {
-        LOG_ERROR(LOG_TAG, "Faceprints array size is 0.");
-        return result;	
+        auto& query_faceprints = new_faceprints_array[q];
+        if (ValidateFaceprints(query_faceprints) && host.IsValidated(query_faceprints.version))
+        {
+            device_queries.push_back(q);
+            device_faceprints.push_back(query_faceprints);
+        }
     }
 
-    if (new_faceprints.version != existing_faceprints_array[0].faceprints.version) 
+    std::unique_lock<std::mutex> device_lock;
+    OpenClMatchContext* device = device_queries.empty() ? nullptr : gallery.AcquireDevice(device_lock);
+    std::vector<std::vector<OpenClMatchContext::Candidate>> device_candidates;
+    if (device != nullptr && device->TopKBatch(device_faceprints.data(), device_faceprints.size(), k, device_candidates))
     {
-        LOG_ERROR(LOG_TAG, "version mismatch between 2 vectors. Skipping this match()!");
-		return result;	
+        ExtendedMatchResult unused_result;
+        for (size_t i = 0; i < device_queries.size(); i++)
+        {
+            const size_t q = device_queries[i];
+            for (auto& device_candidate : device_candidates[i])
+            {
+                MatchCandidate candidate;
+                candidate.userId = device_candidate.row;
+                candidate.score = device_candidate.score;
+                candidate.confidence = CalculateConfidence(candidate.score, thresholds.strongThreshold, unused_result);
+                candidates[q].push_back(candidate);
+            }
+            success[q] = 1;
+            on_device[q] = 1;
+        }
     }
-
-    // Try to match the 2 faceprints. And raise should_update flag respecively.
-    FaceMatch(new_faceprints, existing_faceprints_array, result, thresholds);
-    result.should_update = (result.maxScore >= s_updateThreshold) && result.isSame;
-
-    bool enable_update = true;
-
-    // if should_update then we create an update vector such that:
-    // (1) the current vector is blended into the latest avg vector.
-    // (2) then we make sure that the updated avg vector is not too far from the orig. 
-    if (result.should_update && enable_update)
+    else if (device != nullptr)
     {
-        // Init updated_faceprints to the faceprints already exists in the DB
-        //  
-        size_t user_index = (size_t)result.userId;
+        LOG_ERROR(LOG_TAG, "Device top-k failed on %s, matching on the cpu", device->DeviceName().c_str());
+    }
+#endif // RSID_MATCHER_OPENCL
 
-        if((user_index < 0) || (user_index >= existing_faceprints_array.size()))
+    for (size_t q = 0; q < number_of_queries; q++)
+    {
+        if (!on_device[q])
         {
-            LOG_ERROR(LOG_TAG, "Invalid user_index : Skipping function.");
-            return result;
+            success[q] = MatchFaceprintsTopK(new_faceprints_array[q], host, k, true, candidates[q], thresholds) ? 1 : 0;
         }
+    }
+    return success;
+}
 
-        updated_faceprints = existing_faceprints_array[user_index].faceprints;
-        
-        const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+size_t Matcher::UpdateFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                      std::vector<Faceprints>& faceprints_array)
+{
+    if (new_faceprints_array.size() != faceprints_array.size())
+    {
+        LOG_ERROR(LOG_TAG, "Batch sizes don't match : Skipping function.");
+        return 0;
+    }
 
-        // blend the current avg vector with the new vector
-        BlendAverageVector(&updated_faceprints.avgDescriptor[0], &new_faceprints.avgDescriptor[0], 
-                                vec_length);
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    size_t num_updated = 0;
 
-        // make sure blended avg vector is not too far from orig vector
-        UpdateAverageVector(&updated_faceprints.avgDescriptor[0], &updated_faceprints.origDescriptor[0],
-                            vec_length);
+    for (size_t i = 0; i < faceprints_array.size(); i++)
+    {
+        const Faceprints& new_faceprints = new_faceprints_array[i];
+        Faceprints& faceprints = faceprints_array[i];
+        if (!ValidateFaceprints(new_faceprints) || !IsSameVersion(new_faceprints, faceprints))
+        {
+            continue;
+        }
+
+        BlendAverageVector(&faceprints.avgDescriptor[0], &new_faceprints.avgDescriptor[0], vec_length);
+        UpdateAverageVector(&faceprints.avgDescriptor[0], &faceprints.origDescriptor[0], vec_length);
+        num_updated++;
     }
-    
-    return result;
+
+    return num_updated;
 }
 
-ExtendedMatchResult Matcher::MatchFaceprintsToArray(const Faceprints& new_faceprints,
-                                                    const std::vector<ExtendedFaceprints>& existing_faceprints_array,
-                                                    Faceprints& updated_faceprints, Thresholds thresholds)
+size_t Matcher::UpdateGalleryBatch(FaceprintsGallery& gallery, const std::vector<size_t>& indices,
+                                   const std::vector<Faceprints>& new_faceprints_array)
 {
-    ExtendedMatchResult result;
-
-    result.userId = -1;
-    result.maxScore = 0;
-
-    if (!ValidateFaceprints(new_faceprints)) 
-	{
-        LOG_ERROR(LOG_TAG, "Faceprints vector failed range validation.");
-		return result;	
-	}
-    
-    if(existing_faceprints_array.size() <= 0)
+    if (indices.size() != new_faceprints_array.size())
     {
-        LOG_ERROR(LOG_TAG, "Faceprints array size is 0.");
-        return result;	
+        LOG_ERROR(LOG_TAG, "Batch sizes don't match : Skipping function.");
+        return 0;
     }
 
-    if (new_faceprints.version != existing_faceprints_array[0].faceprints.version) 
+    // group the updates by entry (stable - the order of the updates of an entry is kept)
+    std::vector<size_t> order(indices.size());
+    for (size_t i = 0; i < order.size(); i++)
     {
-        LOG_ERROR(LOG_TAG, "version mismatch between 2 vectors. Skipping this match()!");
-		return result;	
+        order[i] = i;
     }
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return indices[lhs] < indices[rhs]; });
 
-    FaceMatch(new_faceprints, existing_faceprints_array, result, thresholds);
-    result.should_update = (result.maxScore >= s_updateThreshold) && result.isSame;
-   
-    bool enable_update = true;
+    const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+    const size_t gallery_size = gallery.Size();
+    size_t num_updated = 0;
+    Faceprints faceprints;
 
-    // if should_update then we create an update vector such that:
-    // (1) the current vector is blended into the latest avg vector.
-    // (2) then we make sure that the updated avg vector is not too far from the orig. 
-    if (result.should_update && enable_update)
-    {      
-        // Init updated_faceprints to the faceprints already exists in the DB
-        //  
-        size_t user_index = (size_t)result.userId;
+    for (size_t begin = 0; begin < order.size();)
+    {
+        const size_t index = indices[order[begin]];
+        size_t end = begin + 1;
+        while (end < order.size() && indices[order[end]] == index)
+        {
+            end++;
+        }
 
-        if((user_index < 0) || (user_index >= existing_faceprints_array.size()))
+        if (index >= gallery_size || !gallery.GetFaceprints(index, faceprints))
         {
-            LOG_ERROR(LOG_TAG, "Invalid user_index : Skipping function.");
-            return result;
+            LOG_ERROR(LOG_TAG, "Invalid user_index : Skipping %zu updates.", end - begin);
+            begin = end;
+            continue;
         }
 
-        updated_faceprints = existing_faceprints_array[user_index].faceprints;
+        size_t entry_updates = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            const Faceprints& new_faceprints = new_faceprints_array[order[i]];
+            if (!ValidateFaceprints(new_faceprints) || !IsSameVersion(new_faceprints, faceprints))
+            {
+                continue;
+            }
+
+            BlendAverageVector(&faceprints.avgDescriptor[0], &new_faceprints.avgDescriptor[0], vec_length);
+            UpdateAverageVector(&faceprints.avgDescriptor[0], &faceprints.origDescriptor[0], vec_length);
+            entry_updates++;
+        }
 
-        const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER;
+        if (entry_updates > 0 && gallery.Update(index, faceprints))
+        {
+            num_updated += entry_updates;
+        }
+        begin = end;
+    }
 
-        // update avg vector with the new vector
-        BlendAverageVector(&updated_faceprints.avgDescriptor[0], &new_faceprints.avgDescriptor[0],
-                                vec_length);
+    return num_updated;
+}
 
-        // make sure avg vector is not too far from orig vector
-        UpdateAverageVector(&updated_faceprints.avgDescriptor[0], &updated_faceprints.origDescriptor[0],
-                            vec_length);
-    }
- 
-    return result;
+void Matcher::UpdateGalleryFaceprints(GalleryFaceprints& entry, const ExtendedFaceprints& extended_faceprints)
+{
+    entry.extended_faceprints = extended_faceprints;
+    UpdateGalleryFaceprints(entry);
+}
+
+void Matcher::UpdateGalleryFaceprints(GalleryFaceprints& entry)
+{
+    auto& faceprints = entry.extended_faceprints.faceprints;
+    entry.is_valid = ValidateFaceprints(faceprints);
+    CalculateNorm(&faceprints.avgDescriptor[0], entry.avg_norm, entry.avg_norm_msb);
+    entry.avg_norm_recip = CalculateNormReciprocal(entry.avg_norm);
 }
 
 bool Matcher::UpdateAverageVector(feature_t* updated_faceprints_vec, const feature_t* orig_faceprints_vec,
@@ -423,6 +3049,11 @@ Thresholds Matcher::GetDefaultThresholds()
 //
 bool Matcher::ValidateVector(const feature_t* vec, const uint32_t vec_length)
 {
+    if (vec_length == DefaultFeatureLayout::NumFeatures)
+    {
+        return MatcherKernels::ValidateVectorFixed<DefaultFeatureLayout>(vec);
+    }
+
     for (uint32_t i = 0; i < vec_length; i++)
     {
         feature_t curr_feature = (feature_t)vec[i];
@@ -457,75 +3088,16 @@ void Matcher::BlendAverageVector(feature_t* user_average_faceprints, const featu
         return; 
     }
 
-    int history_weight = RSID_UPDATE_GALLERY_HISTORY_WEIGHT;
-    int round_value = (history_weight + 1);
-    for (uint32_t i = 0; i < vec_length ; ++i)
-    {
-        int32_t v = static_cast<int32_t>(user_average_faceprints[i]);
-        v *= 2 * history_weight;
-        v += 2 * (int)(user_new_faceprints[i]);
-        v = (v >= 0) ? (v + round_value) : (v - round_value);
-        v /= (2 * round_value);
-
-        short feature_value = static_cast<short>(v);
-        feature_value = (feature_value > s_maxFeatureValue) ? s_maxFeatureValue : feature_value;
-        feature_value = (feature_value < -s_maxFeatureValue) ? -s_maxFeatureValue : feature_value;
-
-        user_average_faceprints[i] = static_cast<short>(v);
-    }
+    // the weighted sum is calculated by the fastest kernel supported by the cpu (bit-exact with the scalar kernel).
+    // all kernels keep the result in [-1023,+1023] for features in this range.
+    static const MatcherKernels::blend_vectors_func blend_vectors = MatcherKernels::GetBlendVectors();
+    blend_vectors(user_average_faceprints, user_new_faceprints, vec_length, RSID_UPDATE_GALLERY_HISTORY_WEIGHT);
 }
 
 match_calc_t Matcher::CalculateConfidence(match_calc_t score, match_calc_t threshold, ExtendedMatchResult& result)
 {
-    int32_t confidence = 0;
-    int32_t min_confidence = 0;
-    int32_t m, s, a;
-
-    if (score >= (match_calc_t)RSID_LIN1_SCORE_1)
-    {
-        m = s_linCurveMultiplier1;
-        s = s_linCurveSabtractive1;
-        a = s_linCurveAdditive1;
-    }
-    else if (score >= (match_calc_t)RSID_LIN2_SCORE_1)
-    {
-        m = s_linCurveMultiplier2;
-        s = s_linCurveSabtractive2;
-        a = s_linCurveAdditive2;
-    }
-    else
-    {
-        // will force confidence = 0.
-        m = 0;
-        s = 0;
-        a = 0;
-    }
-
-    // Example on the procedure below : suppose score = 840,  and in our case : m = 7, s = 970, a = 194560.
-    // so without rounding we'll get: 
-    //      confidence = m*(score-s)+a = 193650 and after shift-back (int)(193650/2048) = 94.
-    // but we want a more accurate rounded result so we apply :  
-    //      confidence = m*(score-s)+a + 1024 = 194674 and after shift-back (int)(194674/2048) = 95.
-    
-    // we apply a linear curve from score axis [score1, score2]
-    // to confidence axis [confidence1, confidenc2]
-    //
-    confidence = m * (static_cast<int32_t>(score) - s) + a;
-    // assure minimal confidence is 0
-    confidence = std::max(confidence, min_confidence);
-
-    // Apply round here so after the shift-back we'll have the rounded (integer) result.
-    // since confidence is positive here - we just add a scaled 1/2 before the shift back.
-    int32_t round_bit_offset = (0x1 << (s_linCurveHeadroom1 - 1));
-    confidence += round_bit_offset;
-        
-    // shift back
-    confidence >>= s_linCurveHeadroom1;
-        
-    // assure maximal confidence limit
-    confidence = std::min(confidence, static_cast <int32_t>(RSID_MAX_POSSIBLE_CONFIDENCE));
- 
-    return static_cast<match_calc_t>(confidence);
+    // piecewise linear score to confidence curve, see MatcherConfig
+    return MatcherConfig::Default().Confidence(score);
 }
 
 short Matcher::GetMsb(const uint32_t ux)
@@ -533,16 +3105,21 @@ short Matcher::GetMsb(const uint32_t ux)
     // we find the msb index of a positive integer (index starts from 1).
     // for example: msb of 0x10 is 2 , msb of 0x1011 is 4.
     // exception : msb of 0 returns 0.
-    // optimize - avoid while() loop, and make efficient constant time performance.
+    // the hardware count leading zeros instruction is used where available (constant time, no branches).
+#if defined(__GNUC__) || defined(__clang__)
+    return (ux == 0) ? 0 : static_cast<short>(32 - __builtin_clz(ux));
+#elif defined(_MSC_VER)
+    unsigned long index = 0;
+    return _BitScanReverse(&index, ux) ? static_cast<short>(index + 1) : 0;
+#else
     // method - we check the range of x in a binary-search manner.
-
     uint32_t x = ux;
     uint32_t shift = 0;
     uint32_t msb = 0; // will be set with the result = floor(log2(x))+1.
 
     msb = (x > 0xFFFF) << 4; x >>= msb;
     shift = (x > 0xFF) << 3; x >>= shift; msb |= shift;
-    shift = (x > 0xF) << 2; x >>= shift; msb |= shift; 
+    shift = (x > 0xF) << 2; x >>= shift; msb |= shift;
     shift = (x > 0x3) << 1; x >>= shift; msb |= shift;
                                          msb |= (x >> 1);
 
@@ -550,6 +3127,7 @@ short Matcher::GetMsb(const uint32_t ux)
     msb = (ux == 0) ? 0 : (msb + 1);
 
     return static_cast<short>(msb);
+#endif
 }
 
 void Matcher::MatchTwoVectors(const feature_t* T1, const feature_t* T2, match_calc_t* retprob, const uint32_t vec_length)
@@ -588,64 +3166,105 @@ void Matcher::MatchTwoVectors(const feature_t* T1, const feature_t* T2, match_ca
     }
 
     uint32_t nfeatures = vec_length;
-    
-    int32_t corr = 0;
-    int32_t min_corr = 0;
-    uint32_t ucorr = 0;
-    uint32_t norm1 = 0;
-    uint32_t norm2 = 0;
 
-    for (uint32_t i = 0; i < nfeatures; ++i)
-    {
-        int32_t t1 = static_cast<int32_t>(T1[i]);
-        int32_t t2 = static_cast<int32_t>(T2[i]);
+    // corr/norms are calculated by the fastest kernel supported by the cpu (bit-exact with the scalar kernel).
+    static const MatcherKernels::calc_products_func calc_products = MatcherKernels::GetCalcProducts();
+    MatcherKernels::VectorProducts products;
+    calc_products(T1, T2, nfeatures, products);
 
-        corr += t1 * t2;
-        norm1 += t1 * t1;
-        norm2 += t2 * t2;
-    }
+    // protect division by 0.
+    uint32_t norm1 = (products.norm1 == 0) ? 1 : products.norm1;
+    uint32_t norm2 = (products.norm2 == 0) ? 1 : products.norm2;
+
+    *retprob = CalculateGrade(products.corr, norm1, GetMsb(norm1), norm2, GetMsb(norm2));
+}
+
+void Matcher::CalculateNorm(const feature_t* vec, uint32_t& norm, short& norm_msb, const uint32_t vec_length)
+{
+    static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+    norm = static_cast<uint32_t>(calc_dot(vec, vec, vec_length));
 
     // protect division by 0.
-    norm1 = (norm1 == 0) ? 1 : norm1;
-    norm2 = (norm2 == 0) ? 1 : norm2;
+    norm = (norm == 0) ? 1 : norm;
+    norm_msb = GetMsb(norm);
+}
 
-    // negative correlation will be considered as 0 correlation.
-    ucorr = static_cast<uint32_t>(std::max(corr, min_corr));
+// Shifts of the fixed point ncc: corr is shifted up as much as possible (up to 16 bits above each norm) before it is
+// divided by the norms, and the product of both quotients is shifted back to the [0, 4096] range.
+// Written with min/max only, so it compiles to branch free code.
+static inline void CalculateGradeShifts(uint32_t corr_msb, int32_t norm1_msb, int32_t norm2_msb, uint32_t& shift1,
+                                        uint32_t& shift2)
+{
+    const int32_t msb = static_cast<int32_t>(corr_msb);
+    const int32_t max_corr_shift = 32 - msb;
+    const int32_t max_shift1 = 16 - std::max(msb - norm1_msb, 0);
+    const int32_t max_shift2 = 16 - std::max(msb - norm2_msb, 0);
+
+    shift1 = static_cast<uint32_t>(std::min(max_shift1, max_corr_shift));
+    shift2 = static_cast<uint32_t>(std::min(max_shift2, max_corr_shift));
+}
+
+static inline uint32_t ShiftBackGrade(uint32_t similarity, uint32_t shift1, uint32_t shift2)
+{
+    // one of the two shifts is 0
+    const int32_t shift_back = static_cast<int32_t>(shift1 + shift2) - 12;
+    return (similarity >> std::max(shift_back, 0)) << std::max(-shift_back, 0);
+}
 
-    short norm1_msb = GetMsb(norm1);
-    short norm2_msb = GetMsb(norm2);
-    short corr_msb = GetMsb(ucorr);
-    int32_t min_shift = 0;
+// floor(n / d) given the reciprocal of d (see CalculateNormReciprocal()).
+// the reciprocal is ceil(2^64 / d) - the high 64 bits of n * reciprocal are the exact quotient for any 32 bit n and d
+// (Lemire et al., "Faster remainder by direct computation"). The 96 bit product is built from two 32x32->64 bit
+// multiplications. The reciprocal of 1 does not fit in 64 bits and is stored as 0.
+static inline uint32_t DivideByReciprocal(uint32_t n, uint64_t recip)
+{
+    const uint64_t high = (recip >> 32) * n + (((recip & 0xFFFFFFFFu) * n) >> 32);
+    const uint32_t quotient = static_cast<uint32_t>(high >> 32);
+    return (recip == 0) ? n : quotient;
+}
+
+uint64_t Matcher::CalculateNormReciprocal(uint32_t norm)
+{
+    return (norm <= 1) ? 0 : (UINT64_MAX / norm + 1);
+}
 
-    short max_corr_shift = 32 - corr_msb;
-    short max_shift1 = 16 - static_cast<short>(std::max(static_cast<int32_t>(corr_msb - norm1_msb), min_shift));
-    short max_shift2 = 16 - static_cast<short>(std::max(static_cast<int32_t>(corr_msb - norm2_msb), min_shift));
+match_calc_t Matcher::CalculateGrade(int32_t corr, uint32_t norm1, short norm1_msb, uint32_t norm2, short norm2_msb)
+{
+    // norms are expected to be non zero here (see MatchTwoVectors()).
+    // negative correlation will be considered as 0 correlation.
+    const uint32_t ucorr = static_cast<uint32_t>(std::max(corr, 0));
 
-    short shift1 = static_cast<short>(std::min(static_cast<int32_t>(max_shift1), static_cast<int32_t>(max_corr_shift)));
-    short shift2 = static_cast<short>(std::min(static_cast<int32_t>(max_shift2), static_cast<int32_t>(max_corr_shift)));
-    short total_shift = shift1 + shift2;
-    short shift_back = total_shift - 12;
+    uint32_t shift1, shift2;
+    CalculateGradeShifts(static_cast<uint32_t>(GetMsb(ucorr)), norm1_msb, norm2_msb, shift1, shift2);
 
     uint32_t norm_corr1 = (ucorr << shift1) / norm1;
     uint32_t norm_corr2 = (ucorr << shift2) / norm2;
     uint32_t similarity = norm_corr1 * norm_corr2;
 
-    uint32_t grade = 0;
+    return static_cast<match_calc_t>(ShiftBackGrade(similarity, shift1, shift2));
+}
 
-    if (shift_back >= 0)
-    {
-        grade = (similarity >> shift_back);
-    }
-    else
-    {
-        grade = (similarity << (-shift_back));
-    }
+match_calc_t Matcher::CalculateGrade(int32_t corr, short norm1_msb, uint64_t norm1_recip, short norm2_msb,
+                                     uint64_t norm2_recip)
+{
+    const uint32_t ucorr = static_cast<uint32_t>(std::max(corr, 0));
 
-    // std::cout << "ncc result: -----> grade =  " << grade << std::endl;
+    uint32_t shift1, shift2;
+    CalculateGradeShifts(static_cast<uint32_t>(GetMsb(ucorr)), norm1_msb, norm2_msb, shift1, shift2);
+
+    uint32_t norm_corr1 = DivideByReciprocal(ucorr << shift1, norm1_recip);
+    uint32_t norm_corr2 = DivideByReciprocal(ucorr << shift2, norm2_recip);
+    uint32_t similarity = norm_corr1 * norm_corr2;
 
-    // LOG_DEBUG(LOG_TAG, "ncc result: -----> grade = %u", grade);
+    return static_cast<match_calc_t>(ShiftBackGrade(similarity, shift1, shift2));
+}
 
-    *retprob = static_cast<match_calc_t>(grade);
+void Matcher::CalculateGrades(const int32_t* corrs, size_t count, short query_norm_msb, uint64_t query_norm_recip,
+                              const short* norm_msbs, const uint64_t* norm_recips, match_calc_t* grades)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        grades[i] = CalculateGrade(corrs[i], query_norm_msb, query_norm_recip, norm_msbs[i], norm_recips[i]);
+    }
 }
 
 } // namespace RealSenseID
@@ -4,6 +4,10 @@
 #pragma once
 #include "MatcherImplDefines.h"
 #include "RealSenseID/Faceprints.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
 #include <vector>
 #include <stdint.h>
 
@@ -13,6 +17,36 @@ using feature_t = short;
 using match_calc_t = short;
 
 class ExtendedFaceprints;
+class GalleryFaceprints;
+class FaceprintsGallery;
+class MatcherThreadPool;
+class FaceprintsIvfIndex;
+class FaceprintsPivotIndex;
+class FaceprintsQuantizedIndex;
+class FaceprintsProgressiveIndex;
+class GalleryGroups;
+class GallerySnapshot;
+class FaceprintsDatabase;
+class DeviceFaceprintsGallery;
+class ShardedGallery;
+class GalleryUpdateQueue;
+class MatcherConfig;
+class MultiTemplateGallery;
+class MappedFaceprintsGallery;
+struct ParallelGallerySearch;
+struct PrefilteredGallerySearch;
+struct IvfGallerySearch;
+struct PivotGallerySearch;
+struct QuantizedGallerySearch;
+struct ProgressiveGallerySearch;
+struct ScopedGallerySearch;
+struct ShardedGallerySearch;
+struct DeadlineGallerySearch;
+
+namespace Metrics
+{
+class MatchScoreHistogram;
+}
 
 struct ExtendedMatchResult
 {
@@ -22,6 +56,9 @@ struct ExtendedMatchResult
     match_calc_t maxScore = 0;
     match_calc_t confidence = 0;
     bool should_update = false;
+    // second best score of the search (-1 id if the search scored no other user, see TagResult)
+    int runnerUpId = -1;
+    match_calc_t runnerUpScore = 0;
 };
 
 struct MatchResultInternal
@@ -38,6 +75,25 @@ struct TagResult
     int id = -1;
     match_calc_t score = 0;
     match_calc_t similarityScore = 0;
+    // second best of the scanned users. the scans stop at the first user above the threshold, so for a match it is the
+    // best of the users scanned before. set by the exhaustive scans, -1 id otherwise.
+    int runnerUpId = -1;
+    match_calc_t runnerUpScore = 0;
+};
+
+struct MatchCandidate
+{
+    int userId = -1; // index in the gallery
+    match_calc_t score = 0;
+    match_calc_t confidence = 0;
+};
+
+// pair of gallery entries scoring above a threshold (see FindSimilarPairs())
+struct SimilarPair
+{
+    uint32_t first = 0;  // gallery index, first < second
+    uint32_t second = 0;
+    match_calc_t score = 0; // of the first entry's avg vector matched against the second entry
 };
 
 struct Thresholds
@@ -47,6 +103,19 @@ struct Thresholds
     match_calc_t updateThreshold;
 };
 
+// deadline of a time bounded search and how it ended (see MatchFaceprintsToArray() with a DeadlineSearch). Keep it
+// across the searches of a gallery, the full scan time of each search is the estimate of the next.
+struct DeadlineSearch
+{
+    std::chrono::steady_clock::time_point deadline;
+    double scan_us_per_user = 0; // full scan time estimate, 0 until the first full scan
+
+    // set by the search
+    bool exact = false;   // final decision: a user above the threshold, or all the users were scored below it
+    bool indexed = false; // the full scan did not fit, the users were scored by their ivf lists, closest first
+    size_t scanned = 0;   // users scored before the decision or the deadline
+};
+
 class Matcher
 {
 public:
@@ -67,13 +136,364 @@ public:
                                                       const std::vector<ExtendedFaceprints>& existing_faceprints_array,
                                                       Faceprints& updated_faceprints, Thresholds thresholds);
 
-    
+    // match single vs. an array of gallery entries (with cached norms). Same results as the ExtendedFaceprints variants,
+    // but only the dot product is calculated per gallery entry.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const std::vector<GalleryFaceprints>& gallery,
+                                                      Faceprints& updated_faceprints);
+
+    // match single vs. an array of gallery entries (with cached norms).
+    // thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const std::vector<GalleryFaceprints>& gallery,
+                                                      Faceprints& updated_faceprints, Thresholds thresholds);
+
+    // match single vs. a packed gallery (see FaceprintsGallery). 1:N scan is a single streaming pass over the avg vectors.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints);
+
+    // match single vs. a packed gallery. thresholds provided by caller.
+    // note: updated_faceprints is not written back to the gallery, use FaceprintsGallery::Update(result.userId, ..).
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, Thresholds thresholds);
+
+    // match single vs. a packed gallery with a config built once (thresholds and confidence curves, see
+    // MatcherConfig).
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, const MatcherConfig& config);
+
+    // match single vs. a packed gallery, searching chunks of the gallery in parallel on the given thread pool.
+    // stops all workers once any of them finds a score above the strong threshold. if several users pass the
+    // threshold, the best one found before the stop is returned.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, MatcherThreadPool& pool);
+
+    // parallel search as above, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, Thresholds thresholds,
+                                                      MatcherThreadPool& pool);
+
+    // parallel search as above with a config built once.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, const MatcherConfig& config,
+                                                      MatcherThreadPool& pool);
+
+    // match a batch of faceprints vs. a packed gallery in one call. results[i] and updated_faceprints_array[i] are
+    // the same as calling MatchFaceprintsToArray() with new_faceprints_array[i].
+    // The gallery is scanned in tiles and each tile is scored against all the queries still searching.
+    // internal thresholds will be used.
+    static std::vector<ExtendedMatchResult> MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                                 const FaceprintsGallery& gallery,
+                                                                 std::vector<Faceprints>& updated_faceprints_array);
+
+    // batch match as above, thresholds provided by caller.
+    static std::vector<ExtendedMatchResult> MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                                 const FaceprintsGallery& gallery,
+                                                                 std::vector<Faceprints>& updated_faceprints_array,
+                                                                 Thresholds thresholds);
+
+    // batch match as above with a config built once.
+    static std::vector<ExtendedMatchResult> MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                                 const FaceprintsGallery& gallery,
+                                                                 std::vector<Faceprints>& updated_faceprints_array,
+                                                                 const MatcherConfig& config);
+
+    // batch match as above, but the updates are not blended here: the new faceprints of the results with
+    // should_update are pushed to the updater of the gallery (see GalleryUpdateQueue), which blends them into the
+    // gallery in the background. updates.Gallery() must be the given gallery.
+    // internal thresholds will be used.
+    static std::vector<ExtendedMatchResult> MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                                 const FaceprintsGallery& gallery,
+                                                                 GalleryUpdateQueue& updates);
+
+    // batch match with deferred updates as above, thresholds provided by caller.
+    static std::vector<ExtendedMatchResult> MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                                 const FaceprintsGallery& gallery,
+                                                                 GalleryUpdateQueue& updates, Thresholds thresholds);
+
+    // batch match with deferred updates as above with a config built once.
+    static std::vector<ExtendedMatchResult> MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                                 const FaceprintsGallery& gallery,
+                                                                 GalleryUpdateQueue& updates,
+                                                                 const MatcherConfig& config);
+
+    // two stage match for large packed galleries:
+    // (1) coarse - all users are ranked by the hamming distance of the binary sketches of the avg vectors (popcount).
+    // (2) fine - the shortlist_size closest users are matched exactly, in gallery order.
+    // if shortlist_size >= gallery size the result is the same as MatchFaceprintsToArray() (exact search).
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArrayPrefiltered(const Faceprints& new_faceprints,
+                                                                 const FaceprintsGallery& gallery,
+                                                                 Faceprints& updated_faceprints,
+                                                                 size_t shortlist_size);
+
+    // two stage match as above, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArrayPrefiltered(const Faceprints& new_faceprints,
+                                                                 const FaceprintsGallery& gallery,
+                                                                 Faceprints& updated_faceprints, size_t shortlist_size,
+                                                                 Thresholds thresholds);
+
+    // approximate match against an ivf index: only the users of the nprobe lists closest to the new faceprints are
+    // matched (exactly). higher nprobe - better recall, higher latency. nprobe >= index.NumLists() or an untrained
+    // index gives the same result as the exact search over index.Gallery(). the result userId is a gallery index.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsIvfIndex& index,
+                                                      Faceprints& updated_faceprints, size_t nprobe);
+
+    // approximate match against an ivf index as above, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsIvfIndex& index,
+                                                      Faceprints& updated_faceprints, size_t nprobe,
+                                                      Thresholds thresholds);
+
+    // exact match against a pivot index: blocks of users whose score bound (see FaceprintsPivotIndex) cannot beat the
+    // threshold or the best score so far are skipped. same result as the exact search over index.Gallery(), which is
+    // also used if the index is not built. the result userId is a gallery index.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const FaceprintsPivotIndex& index,
+                                                      Faceprints& updated_faceprints);
+
+    // exact match against a pivot index as above, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const FaceprintsPivotIndex& index,
+                                                      Faceprints& updated_faceprints, Thresholds thresholds);
+
+    // exact match against an int8 quantized index: the codes are scanned and only the users whose score bound (see
+    // FaceprintsQuantizedIndex) can pass the threshold or beat the best score are rescored with the int16 vectors.
+    // same result as the exact search over index.Gallery(). the result userId is a gallery index.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const FaceprintsQuantizedIndex& index,
+                                                      Faceprints& updated_faceprints);
+
+    // exact match against an int8 quantized index as above, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const FaceprintsQuantizedIndex& index,
+                                                      Faceprints& updated_faceprints, Thresholds thresholds);
+
+    // exact match against a progressive index: the correlation of each user is accumulated block of dimensions by
+    // block, and the user is rejected as soon as its bound (see FaceprintsProgressiveIndex) cannot pass the threshold
+    // or beat the best score. same result as the exact search over index.Gallery(). the result userId is a gallery
+    // index.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const FaceprintsProgressiveIndex& index,
+                                                      Faceprints& updated_faceprints);
+
+    // exact match against a progressive index as above, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const FaceprintsProgressiveIndex& index,
+                                                      Faceprints& updated_faceprints, Thresholds thresholds);
+
+    // time bounded match against an ivf index, e.g. for a decision within an SLA under load spikes. The whole gallery
+    // is scanned (in parallel, in gallery order) if the estimated scan time fits before search.deadline or the index
+    // is not trained, otherwise the users of the lists closest to the query are scored first. Either way the scan
+    // stops at the deadline with the best user so far (at least a chunk or a list is scored), and search tells if the
+    // decision is exact. A full scan that fits gives the same result as the exact search over index.Gallery(). the
+    // result userId is a gallery index.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsIvfIndex& index,
+                                                      Faceprints& updated_faceprints, DeadlineSearch& search,
+                                                      MatcherThreadPool& pool);
+
+    // time bounded match as above, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsIvfIndex& index,
+                                                      Faceprints& updated_faceprints, DeadlineSearch& search,
+                                                      Thresholds thresholds, MatcherThreadPool& pool);
+
+    // match against the members of the given groups of a packed gallery only (see GalleryGroups), in gallery order.
+    // the other users are not touched. the result userId is a gallery index.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                      const GalleryGroups& groups, const uint32_t* allowed_groups,
+                                                      size_t num_allowed_groups, Faceprints& updated_faceprints);
+
+    // scoped match as above, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                      const GalleryGroups& groups, const uint32_t* allowed_groups,
+                                                      size_t num_allowed_groups, Faceprints& updated_faceprints,
+                                                      Thresholds thresholds);
+
+    // 1:1 verification of a claimed identity: match against the user at the given index of a packed gallery only (e.g.
+    // found by its user id, see FaceprintsGallery::Find()), with its cached norm. same decision and updated
+    // faceprints as a 1:N match whose best user is that user. the result userId is the gallery index.
+    // internal thresholds will be used.
+    static ExtendedMatchResult VerifyFaceprints(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                size_t index, Faceprints& updated_faceprints);
+
+    // 1:1 verification as above, thresholds provided by caller.
+    static ExtendedMatchResult VerifyFaceprints(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                                                size_t index, Faceprints& updated_faceprints, Thresholds thresholds);
+
+    // match against a snapshot of a SnapshotGallery (concurrent readers and writers). the snapshot must be held in a
+    // shared_ptr for the duration of the call. the result userId is a global index of the given snapshot, use
+    // snapshot.UserId() to get the user id.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const GallerySnapshot& snapshot,
+                                                      Faceprints& updated_faceprints);
+
+    // match against a gallery snapshot, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const GallerySnapshot& snapshot,
+                                                      Faceprints& updated_faceprints, Thresholds thresholds);
+
+    // match against a persistent database (mapped gallery file + journaled changes). the result userId is an index of
+    // the database, use database.UserId() to get the user id.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const FaceprintsDatabase& database,
+                                                      Faceprints& updated_faceprints);
+
+    // match against a persistent database, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const FaceprintsDatabase& database,
+                                                      Faceprints& updated_faceprints, Thresholds thresholds);
+
+    // match against a mapped gallery file (e.g. the snapshot of a SharedGalleryReader). updated_faceprints can not be
+    // written back to the read-only file, the writer applies them.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const MappedFaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints);
+
+    // match against a mapped gallery file, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const MappedFaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, Thresholds thresholds);
+
+    // match against a gallery of users with several templates each (see MultiTemplateGallery), a user is scored by
+    // its best template. result.userId is the index of the user and matched_template the index of its best template
+    // (-1 if none), updated_faceprints is blended from that template: write it back with
+    // gallery.Update(result.userId, matched_template, ..).
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const MultiTemplateGallery& gallery,
+                                                      Faceprints& updated_faceprints, int& matched_template);
+
+    // match against a multi-template gallery, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const MultiTemplateGallery& gallery,
+                                                      Faceprints& updated_faceprints, int& matched_template,
+                                                      Thresholds thresholds);
+
+    // find the k best candidates in a packed gallery in a single pass (fixed size heap).
+    // candidates are sorted by descending score (equal scores by ascending index).
+    // if exhaustive is false, the scan stops once k candidates above the strong threshold were found (for k=1 this is
+    // the same early exit as MatchFaceprintsToArray), otherwise the whole gallery is scanned.
+    // returns false if the faceprints or the gallery failed validation.
+    // internal thresholds will be used.
+    static bool MatchFaceprintsTopK(const Faceprints& new_faceprints, const FaceprintsGallery& gallery, size_t k,
+                                    bool exhaustive, std::vector<MatchCandidate>& candidates);
+
+    // top-k as above, thresholds provided by caller.
+    static bool MatchFaceprintsTopK(const Faceprints& new_faceprints, const FaceprintsGallery& gallery, size_t k,
+                                    bool exhaustive, std::vector<MatchCandidate>& candidates, Thresholds thresholds);
+
+    // match a batch of faceprints vs. a gallery resident in compute device memory (see DeviceFaceprintsGallery).
+    // the queries are scored on the device if available, otherwise (or for queries the device can not score, e.g.
+    // a version mismatch) on the cpu. Results are the same as MatchFaceprintsBatch() with gallery.Host().
+    // internal thresholds will be used.
+    static std::vector<ExtendedMatchResult> MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                                 const DeviceFaceprintsGallery& gallery,
+                                                                 std::vector<Faceprints>& updated_faceprints_array);
+
+    // device batch match, thresholds provided by caller.
+    static std::vector<ExtendedMatchResult> MatchFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                                 const DeviceFaceprintsGallery& gallery,
+                                                                 std::vector<Faceprints>& updated_faceprints_array,
+                                                                 Thresholds thresholds);
+
+    // match single vs. a device gallery (a batch of one).
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const DeviceFaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints);
+
+    // match single vs. a device gallery, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints,
+                                                      const DeviceFaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, Thresholds thresholds);
+
+    // exhaustive top-k of each query vs. a device gallery, candidates[i] as returned by MatchFaceprintsTopK() for
+    // query i. Runs on the device for k <= 16. returns success per query.
+    // internal thresholds will be used.
+    static std::vector<char> MatchFaceprintsTopKBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                      const DeviceFaceprintsGallery& gallery, size_t k,
+                                                      std::vector<std::vector<MatchCandidate>>& candidates);
+
+    // device top-k, thresholds provided by caller.
+    static std::vector<char> MatchFaceprintsTopKBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                      const DeviceFaceprintsGallery& gallery, size_t k,
+                                                      std::vector<std::vector<MatchCandidate>>& candidates,
+                                                      Thresholds thresholds);
+
+    // match against a gallery sharded across processes/nodes (see ShardedGallery). The best user over all shards is
+    // found by a scatter-gather top-1, equal scores by ascending user id. result.userId is 0 for the best user and its
+    // id is returned in matched_user_id (-1 and empty if there is none).
+    // note: unlike the early exit of the single gallery scans, the best scoring user above the threshold is returned.
+    // internal thresholds will be used.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const ShardedGallery& gallery,
+                                                      Faceprints& updated_faceprints, std::string& matched_user_id);
+
+    // match against a sharded gallery, thresholds provided by caller.
+    static ExtendedMatchResult MatchFaceprintsToArray(const Faceprints& new_faceprints, const ShardedGallery& gallery,
+                                                      Faceprints& updated_faceprints, std::string& matched_user_id,
+                                                      Thresholds thresholds);
+
+    // score of every gallery entry vs. the faceprints (scores[i] for gallery entry i), no early exit.
+    // returns false if the faceprints or the gallery failed validation. An empty gallery gives no scores.
+    static bool ScoreGallery(const Faceprints& new_faceprints, const FaceprintsGallery& gallery,
+                             std::vector<match_calc_t>& scores);
+
+    // all the pairs of gallery entries scoring above the threshold (e.g. the identical person threshold, to find
+    // duplicate or mislabelled enrollments), without the N x N score matrix: the upper triangle of tile pairs is
+    // scored on the pool, each row of a tile against the cache resident rows of the other tile with the blocked
+    // kernels. on_pairs gets the pairs of each tile pair (in no particular order), one call at a time, and stops the
+    // search by returning false. returns false if the gallery failed validation or was stopped.
+    static bool FindSimilarPairs(const FaceprintsGallery& gallery, match_calc_t threshold, MatcherThreadPool& pool,
+                                 const std::function<bool(const SimilarPair* pairs, size_t count)>& on_pairs);
+
+    // update many users in one call, e.g. when replaying authentications to re-tune a gallery. For each i the avg
+    // vector of faceprints_array[i] is blended with new_faceprints_array[i] and pulled back towards its orig vector,
+    // the same update a match with result.should_update returns in updated_faceprints. Entries whose new faceprints
+    // fail validation or have another version are left unchanged. returns the number of updated entries.
+    static size_t UpdateFaceprintsBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                        std::vector<Faceprints>& faceprints_array);
+
+    // batch update of packed gallery entries: new_faceprints_array[i] is applied to gallery entry indices[i]. Updates
+    // of the same entry are applied in order, and each entry is read and written back to the gallery once.
+    // returns the number of applied updates (invalid indices and faceprints are skipped).
+    static size_t UpdateGalleryBatch(FaceprintsGallery& gallery, const std::vector<size_t>& indices,
+                                     const std::vector<Faceprints>& new_faceprints_array);
+
+    // set the gallery entry from the given faceprints and recalculate its cached norm.
+    static void UpdateGalleryFaceprints(GalleryFaceprints& entry, const ExtendedFaceprints& extended_faceprints);
+
+    // recalculate cached norm of gallery entry. Must be called whenever entry's avg faceprints change.
+    static void UpdateGalleryFaceprints(GalleryFaceprints& entry);
+
+    // calculate the norm of a vector (0 is returned as 1) and its msb.
+    static void CalculateNorm(const feature_t* vec, uint32_t& norm, short& norm_msb,
+                              const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER);
+
+    // reciprocal of a norm (as returned by CalculateNorm()) for the division free grade, see CalculateGrade().
+    static uint64_t CalculateNormReciprocal(uint32_t norm);
+
     // checks the faceprints vector coordinates are in valid range [-1023,+1023]. 
     // if check_orig=false it validates the avg faceprints, otherwise it validates the orig faceprints.
     static bool ValidateFaceprints(const Faceprints& faceprints, bool check_orig=false);
+
+    // count a match result in the process wide match score histograms, and in local if not nullptr (see
+    // Metrics::MatchScoreStats). results without a search (invalid faceprints, empty gallery) are not counted.
+    static void RecordScores(const ExtendedMatchResult& result, Metrics::MatchScoreHistogram* local = nullptr);
     
     
 private:
+    // rsid-bench measures the private building blocks too, rsid-matcher-check checks them
+    friend struct MatcherBenchmarkAccess;
+
     static void MatchTwoVectors(const feature_t* T1, const feature_t* T2, match_calc_t* retprob,
                                 const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER);
 
@@ -87,14 +507,108 @@ private:
 
     static short GetMsb(const uint32_t ux);
 
-    static void FaceMatch(const Faceprints& new_faceprints,
-                          const std::vector<ExtendedFaceprints>& existing_faceprints_array, ExtendedMatchResult& result,
-                          Thresholds& thresholds);
+    // ncc grade from the products of two vectors (norms must be non zero).
+    static match_calc_t CalculateGrade(int32_t corr, uint32_t norm1, short norm1_msb, uint32_t norm2, short norm2_msb);
+
+    // same grade without divisions (bit-exact), the norms are given by their msb and CalculateNormReciprocal().
+    static match_calc_t CalculateGrade(int32_t corr, short norm1_msb, uint64_t norm1_recip, short norm2_msb,
+                                       uint64_t norm2_recip);
+
+    // grades of count candidates against one query (norm1). Branch free, so it vectorizes across the candidates.
+    static void CalculateGrades(const int32_t* corrs, size_t count, short query_norm_msb, uint64_t query_norm_recip,
+                                const short* norm_msbs, const uint64_t* norm_recips, match_calc_t* grades);
+
+    // shared implementation for all gallery containers
+    template <typename Gallery>
+    static ExtendedMatchResult MatchFaceprintsToArrayImpl(const Faceprints& new_faceprints,
+                                                          const Gallery& existing_faceprints_array,
+                                                          Faceprints& updated_faceprints, const MatcherConfig& config);
+
+    template <typename Gallery>
+    static void FaceMatch(const Faceprints& new_faceprints, const Gallery& existing_faceprints_array,
+                          ExtendedMatchResult& result, const MatcherConfig& config);
 
     static bool GetScores(const Faceprints& new_faceprints,
                           const std::vector<ExtendedFaceprints>& existing_faceprints_array, TagResult& result,
                           match_calc_t threshold);
 
+    static bool GetScores(const Faceprints& new_faceprints, const std::vector<GalleryFaceprints>& gallery,
+                          TagResult& result, match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const FaceprintsGallery& gallery, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const ParallelGallerySearch& search, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const PrefilteredGallerySearch& search, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const IvfGallerySearch& search, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const PivotGallerySearch& search, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const QuantizedGallerySearch& search, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const ProgressiveGallerySearch& search, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const ScopedGallerySearch& search, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const DeadlineGallerySearch& search, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const GallerySnapshot& snapshot, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const FaceprintsDatabase& database, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const ShardedGallerySearch& search, TagResult& result,
+                          match_calc_t threshold);
+
+    static bool GetScores(const Faceprints& new_faceprints, const MappedFaceprintsGallery& gallery, TagResult& result,
+                          match_calc_t threshold);
+
+    // best row of a multi-template gallery, the templates of a user are max reduced before the early exit.
+    static bool GetScores(const Faceprints& new_faceprints, const MultiTemplateGallery& gallery, TagResult& result,
+                          match_calc_t threshold);
+
+    // score all queries vs. the gallery. success[i] is 0 if the gallery is invalid for query i.
+    static void ScanGalleryBatch(const std::vector<Faceprints>& new_faceprints_array, const FaceprintsGallery& gallery,
+                                 match_calc_t threshold, std::vector<TagResult>& results, std::vector<char>& success);
+
+    // same as ScanGalleryBatch() with gallery.Host(), the queries the device can score are scored on the device.
+    static void ScanDeviceGalleryBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                       const DeviceFaceprintsGallery& gallery, match_calc_t threshold,
+                                       std::vector<TagResult>& results, std::vector<char>& success);
+
+    // decision, confidence and update of each query of a batch from its scores, the same results as
+    // MatchFaceprintsToArrayImpl() per query. the updated faceprints are blended into updated_faceprints_array, or
+    // pushed to updates if given.
+    static std::vector<ExtendedMatchResult> FinishBatch(const std::vector<Faceprints>& new_faceprints_array,
+                                                        const FaceprintsGallery& gallery,
+                                                        const std::vector<TagResult>& scores,
+                                                        const std::vector<char>& success, const MatcherConfig& config,
+                                                        std::vector<Faceprints>* updated_faceprints_array,
+                                                        GalleryUpdateQueue* updates);
+
+    // score gallery entries [begin, end). if found is given, stop when it is set and set it when above threshold.
+    // PackedGallery is FaceprintsGallery or a read-only view with the same raw data accessors.
+    template <typename PackedGallery>
+    static bool ScanGallery(const Faceprints& new_faceprints, uint32_t query_norm, short query_norm_msb,
+                            const PackedGallery& gallery, size_t begin, size_t end, match_calc_t threshold,
+                            std::atomic<bool>* found, TagResult& result);
+
+    // score the given gallery rows (ascending order) exactly, same decision rule as ScanGallery().
+    template <typename PackedGallery>
+    static bool ScanGalleryRows(const Faceprints& new_faceprints, const PackedGallery& gallery,
+                                const std::vector<uint32_t>& rows, match_calc_t threshold, TagResult& result);
+
     static match_calc_t CalculateConfidence(match_calc_t score, match_calc_t threshold, ExtendedMatchResult& result);
 
     static bool ValidateVector(const feature_t* T1, const uint32_t vec_length = RSID_NUMBER_OF_RECOGNITION_FACEPRINTS_MATCHER);
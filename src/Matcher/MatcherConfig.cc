@@ -0,0 +1,109 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MatcherConfig.h"
+#include <algorithm>
+
+namespace RealSenseID
+{
+static_assert(RSID_LIN1_CURVE_HR == RSID_LIN2_CURVE_HR, "Confidence curves must share the fixed point headroom");
+
+static Thresholds DefaultThresholds()
+{
+    Thresholds thresholds;
+    thresholds.strongThreshold = static_cast<match_calc_t>(RSID_STRONG_THRESHOLD);
+    thresholds.identicalPersonThreshold = static_cast<match_calc_t>(RSID_IDENTICAL_PERSON_THRESHOLD);
+    thresholds.updateThreshold = static_cast<match_calc_t>(RSID_UPDATE_THRESHOLD);
+    return thresholds;
+}
+
+// high security preset: about 13% above the default strong and weak thresholds
+static const match_calc_t s_highStrongThreshold = static_cast<match_calc_t>(1100);
+static const match_calc_t s_highWeakThreshold = static_cast<match_calc_t>(930);
+static const match_calc_t s_highUpdateThreshold = static_cast<match_calc_t>(1850);
+
+MatcherConfig::MatcherConfig() : MatcherConfig(DefaultThresholds(), static_cast<match_calc_t>(RSID_WEAK_THRESHOLD))
+{
+}
+
+MatcherConfig::MatcherConfig(const Thresholds& thresholds) : MatcherConfig()
+{
+    _thresholds = thresholds;
+}
+
+MatcherConfig::MatcherConfig(const Thresholds& thresholds, match_calc_t weak_threshold) :
+    _thresholds {thresholds}, _weak_threshold {weak_threshold},
+    _curve1 {MakeCurve(thresholds.strongThreshold, thresholds.identicalPersonThreshold, RSID_LIN1_CONFIDENCE_1,
+                       RSID_LIN1_CONFIDENCE_2)},
+    _curve2 {MakeCurve(weak_threshold, thresholds.strongThreshold, RSID_LIN2_CONFIDENCE_1, RSID_LIN2_CONFIDENCE_2)}
+{
+}
+
+const MatcherConfig& MatcherConfig::Default()
+{
+    static const MatcherConfig config;
+    return config;
+}
+
+MatcherConfig MatcherConfig::FromSecurityLevel(DeviceConfig::SecurityLevel level)
+{
+    if (level != DeviceConfig::SecurityLevel::High)
+    {
+        return Default();
+    }
+    Thresholds thresholds = DefaultThresholds();
+    thresholds.strongThreshold = s_highStrongThreshold;
+    thresholds.updateThreshold = s_highUpdateThreshold;
+    return MatcherConfig {thresholds, s_highWeakThreshold};
+}
+
+// same arithmetic as the RSID_LIN*_CURVE_* defines
+MatcherConfig::Curve MatcherConfig::MakeCurve(int32_t score1, int32_t score2, int32_t confidence1,
+                                              int32_t confidence2)
+{
+    Curve curve;
+    curve.score = score1;
+    curve.multiplier = (score2 > score1) ? ((confidence2 - confidence1) << CurveHeadroom) / (score2 - score1) : 0;
+    curve.subtractive = score1;
+    curve.additive = confidence1 << CurveHeadroom;
+    return curve;
+}
+
+bool MatcherConfig::IsValid() const
+{
+    return _weak_threshold > RSID_MIN_POSSIBLE_SCORE && _weak_threshold <= _thresholds.strongThreshold &&
+           _thresholds.strongThreshold <= _thresholds.identicalPersonThreshold &&
+           _thresholds.identicalPersonThreshold <= RSID_MAX_POSSIBLE_SCORE &&
+           _thresholds.updateThreshold > RSID_MIN_POSSIBLE_SCORE &&
+           _thresholds.updateThreshold <= RSID_MAX_POSSIBLE_SCORE;
+}
+
+match_calc_t MatcherConfig::Confidence(match_calc_t score) const
+{
+    match_calc_t confidence = 0;
+    Confidences(&score, 1, &confidence);
+    return confidence;
+}
+
+void MatcherConfig::Confidences(const match_calc_t* scores, size_t count, match_calc_t* confidences) const
+{
+    // the curve is selected per score instead of branching
+    const int32_t round_bit_offset = (0x1 << (CurveHeadroom - 1));
+    const Curve curve1 = _curve1;
+    const Curve curve2 = _curve2;
+    for (size_t i = 0; i < count; i++)
+    {
+        const int32_t score = scores[i];
+        const bool on_curve1 = score >= curve1.score;
+        const bool on_curve2 = score >= curve2.score;
+        const int32_t m = on_curve1 ? curve1.multiplier : (on_curve2 ? curve2.multiplier : 0);
+        const int32_t s = on_curve1 ? curve1.subtractive : (on_curve2 ? curve2.subtractive : 0);
+        const int32_t a = on_curve1 ? curve1.additive : (on_curve2 ? curve2.additive : 0);
+
+        // rounded (positive) before the shift back, at most the maximal confidence
+        int32_t confidence = std::max(m * (score - s) + a, 0) + round_bit_offset;
+        confidence = std::min(confidence >> CurveHeadroom, static_cast<int32_t>(RSID_MAX_POSSIBLE_CONFIDENCE));
+        confidences[i] = static_cast<match_calc_t>(confidence);
+    }
+}
+} // namespace RealSenseID
@@ -0,0 +1,88 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "Matcher.h"
+#include "RealSenseID/DeviceConfig.h"
+#include <cstddef>
+#include <stdint.h>
+
+namespace RealSenseID
+{
+/**
+ * Decision thresholds and score to confidence curves of the matcher, built once and passed by reference to the
+ * matches (see the MatcherConfig overloads of Matcher), so a site can be tuned at runtime without per call setup.
+ * The confidence is piecewise linear in fixed point: curve 1 maps [strong, identical person] scores to
+ * [95, 99] and curve 2 maps [weak, strong] to [60, 95], lower scores have confidence 0.
+ * The default config has the thresholds and curves of MatcherImplDefines.h, its results are bit-identical to the
+ * Thresholds overloads with the default thresholds.
+ */
+class MatcherConfig
+{
+public:
+    // fixed point score to confidence line: confidence = (multiplier * (score - subtractive) + additive) >> headroom
+    struct Curve
+    {
+        int32_t score = 0; // first score on the line
+        int32_t multiplier = 0;
+        int32_t subtractive = 0;
+        int32_t additive = 0;
+    };
+
+    static constexpr int CurveHeadroom = RSID_LIN1_CURVE_HR;
+
+    // the matcher's defaults
+    MatcherConfig();
+
+    // the given thresholds with the default confidence curves
+    explicit MatcherConfig(const Thresholds& thresholds);
+
+    // the given thresholds with the confidence curves anchored on them (weak < strong < identical person)
+    MatcherConfig(const Thresholds& thresholds, match_calc_t weak_threshold);
+
+    // shared default config (no setup per call)
+    static const MatcherConfig& Default();
+
+    // host side presets of the device's security levels. High rejects more borderline scores (fewer false accepts,
+    // e.g. for access control), Medium and RecognitionOnly are the defaults.
+    static MatcherConfig FromSecurityLevel(DeviceConfig::SecurityLevel level);
+
+    const Thresholds& GetThresholds() const
+    {
+        return _thresholds;
+    }
+
+    match_calc_t StrongThreshold() const
+    {
+        return _thresholds.strongThreshold;
+    }
+
+    match_calc_t IdenticalPersonThreshold() const
+    {
+        return _thresholds.identicalPersonThreshold;
+    }
+
+    match_calc_t UpdateThreshold() const
+    {
+        return _thresholds.updateThreshold;
+    }
+
+    // the thresholds are ordered and in the score range
+    bool IsValid() const;
+
+    // confidence of a score, in [0, RSID_MAX_POSSIBLE_CONFIDENCE]
+    match_calc_t Confidence(match_calc_t score) const;
+
+    // Confidence() of count scores. Branch free, so it vectorizes across a batch.
+    void Confidences(const match_calc_t* scores, size_t count, match_calc_t* confidences) const;
+
+private:
+    static Curve MakeCurve(int32_t score1, int32_t score2, int32_t confidence1, int32_t confidence2);
+
+    Thresholds _thresholds;
+    match_calc_t _weak_threshold;
+    Curve _curve1; // [strong, identical person]
+    Curve _curve2; // [weak, strong]
+};
+} // namespace RealSenseID
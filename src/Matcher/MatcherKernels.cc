@@ -0,0 +1,1009 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MatcherKernels.h"
+#include "Logger.h"
+#include <cstring>
+
+#ifdef RSID_MATCHER_X86_KERNELS
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+#endif // RSID_MATCHER_X86_KERNELS
+
+#ifdef RSID_MATCHER_NEON_KERNELS
+#include <arm_neon.h>
+#endif // RSID_MATCHER_NEON_KERNELS
+
+// gcc/clang need the instruction set enabled per function, msvc allows intrinsics everywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define RSID_TARGET(isa) __attribute__((target(isa)))
+#else
+#define RSID_TARGET(isa)
+#endif
+
+namespace RealSenseID
+{
+namespace MatcherKernels
+{
+static const char* LOG_TAG = "MatcherKernels";
+
+// Add products of the remaining (non vectorized) elements.
+// Uses unsigned arithmetic so that the wraparound is well defined and identical to the simd lanes.
+static void AddTail(const short* T1, const short* T2, uint32_t from, uint32_t to, uint32_t& corr, uint32_t& norm1,
+                    uint32_t& norm2)
+{
+    for (uint32_t i = from; i < to; ++i)
+    {
+        int32_t t1 = static_cast<int32_t>(T1[i]);
+        int32_t t2 = static_cast<int32_t>(T2[i]);
+
+        corr += static_cast<uint32_t>(t1 * t2);
+        norm1 += static_cast<uint32_t>(t1 * t1);
+        norm2 += static_cast<uint32_t>(t2 * t2);
+    }
+}
+
+void CalcProductsScalar(const short* T1, const short* T2, uint32_t vec_length, VectorProducts& result)
+{
+    int32_t corr = 0;
+    uint32_t norm1 = 0;
+    uint32_t norm2 = 0;
+
+    for (uint32_t i = 0; i < vec_length; ++i)
+    {
+        int32_t t1 = static_cast<int32_t>(T1[i]);
+        int32_t t2 = static_cast<int32_t>(T2[i]);
+
+        corr += t1 * t2;
+        norm1 += t1 * t1;
+        norm2 += t2 * t2;
+    }
+
+    result.corr = corr;
+    result.norm1 = norm1;
+    result.norm2 = norm2;
+}
+
+int32_t CalcDotScalar(const short* T1, const short* T2, uint32_t vec_length)
+{
+    uint32_t corr = 0;
+    for (uint32_t i = 0; i < vec_length; ++i)
+    {
+        corr += static_cast<uint32_t>(static_cast<int32_t>(T1[i]) * static_cast<int32_t>(T2[i]));
+    }
+    return static_cast<int32_t>(corr);
+}
+
+void CalcDot4Scalar(const short* T1, const short* rows, size_t row_stride, uint32_t vec_length, int32_t result[4])
+{
+    for (size_t row = 0; row < 4; row++)
+    {
+        result[row] = CalcDotScalar(T1, rows + row * row_stride, vec_length);
+    }
+}
+
+void CalcDot16InterleavedScalar(const short* T1, const short* block, const short* next_block, uint32_t vec_length,
+                                int32_t result[InterleaveRows])
+{
+    (void)next_block;
+    uint32_t corrs[InterleaveRows] = {0};
+    for (uint32_t pair = 0; pair < vec_length / 2; pair++)
+    {
+        const int32_t t0 = T1[2 * pair];
+        const int32_t t1 = T1[2 * pair + 1];
+        const short* pair_rows = block + pair * 2 * InterleaveRows;
+        for (size_t row = 0; row < InterleaveRows; row++)
+        {
+            corrs[row] += static_cast<uint32_t>(t0 * pair_rows[2 * row]) +
+                          static_cast<uint32_t>(t1 * pair_rows[2 * row + 1]);
+        }
+    }
+    for (size_t row = 0; row < InterleaveRows; row++)
+    {
+        result[row] = static_cast<int32_t>(corrs[row]);
+    }
+}
+
+int32_t CalcDotS8Scalar(const int8_t* T1, const int8_t* T2, uint32_t vec_length)
+{
+    int32_t corr = 0;
+    for (uint32_t i = 0; i < vec_length; ++i)
+    {
+        corr += static_cast<int32_t>(T1[i]) * static_cast<int32_t>(T2[i]);
+    }
+    return corr;
+}
+
+void BlendVectorsScalar(short* avg, const short* new_vec, uint32_t vec_length, int history_weight)
+{
+    // v = int((2 * w * avg + 2 * new +/- (w + 1)) / (2 * (w + 1)))
+    const int32_t round_value = history_weight + 1;
+    for (uint32_t i = 0; i < vec_length; ++i)
+    {
+        int32_t v = static_cast<int32_t>(avg[i]) * 2 * history_weight + 2 * static_cast<int32_t>(new_vec[i]);
+        v = (v >= 0) ? (v + round_value) : (v - round_value);
+        avg[i] = static_cast<short>(v / (2 * round_value));
+    }
+}
+
+template <typename Layout>
+void CalcProductsFixed(const short* T1, const short* T2, FixedVectorProducts<Layout>& result)
+{
+    using acc_t = typename Layout::accumulator_t;
+    using uacc_t = typename Layout::unsigned_accumulator_t;
+
+    acc_t corr = 0;
+    uacc_t norm1 = 0;
+    uacc_t norm2 = 0;
+
+    for (uint32_t i = 0; i < Layout::NumFeatures; ++i)
+    {
+        acc_t t1 = static_cast<acc_t>(T1[i]);
+        acc_t t2 = static_cast<acc_t>(T2[i]);
+
+        corr += t1 * t2;
+        norm1 += static_cast<uacc_t>(t1 * t1);
+        norm2 += static_cast<uacc_t>(t2 * t2);
+    }
+
+    result.corr = corr;
+    result.norm1 = norm1;
+    result.norm2 = norm2;
+}
+
+template <typename Layout>
+typename Layout::accumulator_t CalcDotFixed(const short* T1, const short* T2)
+{
+    using acc_t = typename Layout::accumulator_t;
+
+    acc_t corr = 0;
+    for (uint32_t i = 0; i < Layout::NumFeatures; ++i)
+    {
+        corr += static_cast<acc_t>(T1[i]) * static_cast<acc_t>(T2[i]);
+    }
+    return corr;
+}
+
+template <typename Layout>
+bool ValidateVectorFixed(const short* vec)
+{
+    // |x| > max for any feature sets the flag, no early exit so the loop vectorizes.
+    int32_t out_of_range = 0;
+    for (uint32_t i = 0; i < Layout::NumFeatures; ++i)
+    {
+        int32_t feature = static_cast<int32_t>(vec[i]);
+        out_of_range |= static_cast<int32_t>(feature > Layout::MaxFeatureValue || feature < -Layout::MaxFeatureValue);
+    }
+    return out_of_range == 0;
+}
+
+template void CalcProductsFixed<DefaultFeatureLayout>(const short*, const short*,
+                                                      FixedVectorProducts<DefaultFeatureLayout>&);
+template DefaultFeatureLayout::accumulator_t CalcDotFixed<DefaultFeatureLayout>(const short*, const short*);
+template bool ValidateVectorFixed<DefaultFeatureLayout>(const short*);
+
+template void CalcProductsFixed<NormElementFeatureLayout>(const short*, const short*,
+                                                          FixedVectorProducts<NormElementFeatureLayout>&);
+template NormElementFeatureLayout::accumulator_t CalcDotFixed<NormElementFeatureLayout>(const short*, const short*);
+template bool ValidateVectorFixed<NormElementFeatureLayout>(const short*);
+
+// Portable kernels used when no simd kernel is available - the common 256 features length goes to the fixed
+// length kernels.
+static void CalcProductsPortable(const short* T1, const short* T2, uint32_t vec_length, VectorProducts& result)
+{
+    if (vec_length != DefaultFeatureLayout::NumFeatures)
+    {
+        CalcProductsScalar(T1, T2, vec_length, result);
+        return;
+    }
+
+    FixedVectorProducts<DefaultFeatureLayout> products;
+    CalcProductsFixed<DefaultFeatureLayout>(T1, T2, products);
+    result.corr = products.corr;
+    result.norm1 = products.norm1;
+    result.norm2 = products.norm2;
+}
+
+static int32_t CalcDotPortable(const short* T1, const short* T2, uint32_t vec_length)
+{
+    if (vec_length != DefaultFeatureLayout::NumFeatures)
+    {
+        return CalcDotScalar(T1, T2, vec_length);
+    }
+    return CalcDotFixed<DefaultFeatureLayout>(T1, T2);
+}
+
+static void CalcDot4Portable(const short* T1, const short* rows, size_t row_stride, uint32_t vec_length,
+                             int32_t result[4])
+{
+    for (size_t row = 0; row < 4; row++)
+    {
+        result[row] = CalcDotPortable(T1, rows + row * row_stride, vec_length);
+    }
+}
+
+#ifdef RSID_MATCHER_X86_KERNELS
+
+RSID_TARGET("sse2") static uint32_t HorizontalSum(__m128i x)
+{
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(x));
+}
+
+// pmaddwd: multiply 8 pairs of int16 and add adjacent int32 products.
+RSID_TARGET("sse2")
+void CalcProductsSse2(const short* T1, const short* T2, uint32_t vec_length, VectorProducts& result)
+{
+    __m128i acc_corr = _mm_setzero_si128();
+    __m128i acc_norm1 = _mm_setzero_si128();
+    __m128i acc_norm2 = _mm_setzero_si128();
+
+    const uint32_t simd_length = vec_length & ~7u;
+    for (uint32_t i = 0; i < simd_length; i += 8)
+    {
+        __m128i t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T1 + i));
+        __m128i t2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T2 + i));
+
+        acc_corr = _mm_add_epi32(acc_corr, _mm_madd_epi16(t1, t2));
+        acc_norm1 = _mm_add_epi32(acc_norm1, _mm_madd_epi16(t1, t1));
+        acc_norm2 = _mm_add_epi32(acc_norm2, _mm_madd_epi16(t2, t2));
+    }
+
+    uint32_t corr = HorizontalSum(acc_corr);
+    uint32_t norm1 = HorizontalSum(acc_norm1);
+    uint32_t norm2 = HorizontalSum(acc_norm2);
+    AddTail(T1, T2, simd_length, vec_length, corr, norm1, norm2);
+
+    result.corr = static_cast<int32_t>(corr);
+    result.norm1 = norm1;
+    result.norm2 = norm2;
+}
+
+RSID_TARGET("sse2")
+int32_t CalcDotSse2(const short* T1, const short* T2, uint32_t vec_length)
+{
+    __m128i acc_corr = _mm_setzero_si128();
+
+    const uint32_t simd_length = vec_length & ~7u;
+    for (uint32_t i = 0; i < simd_length; i += 8)
+    {
+        __m128i t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T1 + i));
+        __m128i t2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T2 + i));
+        acc_corr = _mm_add_epi32(acc_corr, _mm_madd_epi16(t1, t2));
+    }
+
+    uint32_t corr = HorizontalSum(acc_corr);
+    corr += static_cast<uint32_t>(CalcDotScalar(T1 + simd_length, T2 + simd_length, vec_length - simd_length));
+    return static_cast<int32_t>(corr);
+}
+
+RSID_TARGET("sse2")
+void CalcDot4Sse2(const short* T1, const short* rows, size_t row_stride, uint32_t vec_length, int32_t result[4])
+{
+    const short* row0 = rows;
+    const short* row1 = rows + row_stride;
+    const short* row2 = rows + 2 * row_stride;
+    const short* row3 = rows + 3 * row_stride;
+
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    __m128i acc2 = _mm_setzero_si128();
+    __m128i acc3 = _mm_setzero_si128();
+
+    const uint32_t simd_length = vec_length & ~7u;
+    for (uint32_t i = 0; i < simd_length; i += 8)
+    {
+        __m128i t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T1 + i));
+        acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(t1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i))));
+        acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(t1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i))));
+        acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(t1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row2 + i))));
+        acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(t1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row3 + i))));
+    }
+
+    const uint32_t tail_length = vec_length - simd_length;
+    result[0] = static_cast<int32_t>(
+        HorizontalSum(acc0) + static_cast<uint32_t>(CalcDotScalar(T1 + simd_length, row0 + simd_length, tail_length)));
+    result[1] = static_cast<int32_t>(
+        HorizontalSum(acc1) + static_cast<uint32_t>(CalcDotScalar(T1 + simd_length, row1 + simd_length, tail_length)));
+    result[2] = static_cast<int32_t>(
+        HorizontalSum(acc2) + static_cast<uint32_t>(CalcDotScalar(T1 + simd_length, row2 + simd_length, tail_length)));
+    result[3] = static_cast<int32_t>(
+        HorizontalSum(acc3) + static_cast<uint32_t>(CalcDotScalar(T1 + simd_length, row3 + simd_length, tail_length)));
+}
+
+RSID_TARGET("avx2") static uint32_t HorizontalSum256(__m256i x)
+{
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+}
+
+// vpmaddwd: multiply 16 pairs of int16 and add adjacent int32 products.
+RSID_TARGET("avx2")
+void CalcProductsAvx2(const short* T1, const short* T2, uint32_t vec_length, VectorProducts& result)
+{
+    __m256i acc_corr = _mm256_setzero_si256();
+    __m256i acc_norm1 = _mm256_setzero_si256();
+    __m256i acc_norm2 = _mm256_setzero_si256();
+
+    const uint32_t simd_length = vec_length & ~15u;
+    for (uint32_t i = 0; i < simd_length; i += 16)
+    {
+        __m256i t1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T1 + i));
+        __m256i t2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T2 + i));
+
+        acc_corr = _mm256_add_epi32(acc_corr, _mm256_madd_epi16(t1, t2));
+        acc_norm1 = _mm256_add_epi32(acc_norm1, _mm256_madd_epi16(t1, t1));
+        acc_norm2 = _mm256_add_epi32(acc_norm2, _mm256_madd_epi16(t2, t2));
+    }
+
+    uint32_t corr = HorizontalSum256(acc_corr);
+    uint32_t norm1 = HorizontalSum256(acc_norm1);
+    uint32_t norm2 = HorizontalSum256(acc_norm2);
+    AddTail(T1, T2, simd_length, vec_length, corr, norm1, norm2);
+
+    result.corr = static_cast<int32_t>(corr);
+    result.norm1 = norm1;
+    result.norm2 = norm2;
+}
+
+RSID_TARGET("avx2")
+int32_t CalcDotAvx2(const short* T1, const short* T2, uint32_t vec_length)
+{
+    __m256i acc_corr = _mm256_setzero_si256();
+
+    const uint32_t simd_length = vec_length & ~15u;
+    for (uint32_t i = 0; i < simd_length; i += 16)
+    {
+        __m256i t1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T1 + i));
+        __m256i t2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T2 + i));
+        acc_corr = _mm256_add_epi32(acc_corr, _mm256_madd_epi16(t1, t2));
+    }
+
+    uint32_t corr = HorizontalSum256(acc_corr);
+    corr += static_cast<uint32_t>(CalcDotScalar(T1 + simd_length, T2 + simd_length, vec_length - simd_length));
+    return static_cast<int32_t>(corr);
+}
+
+RSID_TARGET("avx2")
+void CalcDot4Avx2(const short* T1, const short* rows, size_t row_stride, uint32_t vec_length, int32_t result[4])
+{
+    const short* row0 = rows;
+    const short* row1 = rows + row_stride;
+    const short* row2 = rows + 2 * row_stride;
+    const short* row3 = rows + 3 * row_stride;
+
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256();
+    __m256i acc3 = _mm256_setzero_si256();
+
+    const uint32_t simd_length = vec_length & ~15u;
+    for (uint32_t i = 0; i < simd_length; i += 16)
+    {
+        __m256i t1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T1 + i));
+        acc0 = _mm256_add_epi32(acc0,
+                                _mm256_madd_epi16(t1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + i))));
+        acc1 = _mm256_add_epi32(acc1,
+                                _mm256_madd_epi16(t1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + i))));
+        acc2 = _mm256_add_epi32(acc2,
+                                _mm256_madd_epi16(t1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row2 + i))));
+        acc3 = _mm256_add_epi32(acc3,
+                                _mm256_madd_epi16(t1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row3 + i))));
+    }
+
+    const uint32_t tail_length = vec_length - simd_length;
+    result[0] = static_cast<int32_t>(HorizontalSum256(acc0) + static_cast<uint32_t>(CalcDotScalar(
+                                                                  T1 + simd_length, row0 + simd_length, tail_length)));
+    result[1] = static_cast<int32_t>(HorizontalSum256(acc1) + static_cast<uint32_t>(CalcDotScalar(
+                                                                  T1 + simd_length, row1 + simd_length, tail_length)));
+    result[2] = static_cast<int32_t>(HorizontalSum256(acc2) + static_cast<uint32_t>(CalcDotScalar(
+                                                                  T1 + simd_length, row2 + simd_length, tail_length)));
+    result[3] = static_cast<int32_t>(HorizontalSum256(acc3) + static_cast<uint32_t>(CalcDotScalar(
+                                                                  T1 + simd_length, row3 + simd_length, tail_length)));
+}
+
+// 2 * w * avg + 2 * new with +/- (w + 1) added away from zero, for 4 (avg, new) pairs of interleaved int16.
+RSID_TARGET("sse2") static __m128i BlendNumerators(__m128i pairs, __m128i weights, __m128i round_value)
+{
+    __m128i v = _mm_madd_epi16(pairs, weights);
+    __m128i sign = _mm_srai_epi32(v, 31);
+    return _mm_sub_epi32(_mm_add_epi32(v, _mm_xor_si128(round_value, sign)), sign);
+}
+
+// pmaddwd of the interleaved (avg, new) pairs with (2 * w, 2). The numerators are below 2^24 and the divisor below
+// 2^8 (MaxBlendHistoryWeight), so the truncated single precision quotient is the exact integer quotient.
+RSID_TARGET("sse2")
+void BlendVectorsSse2(short* avg, const short* new_vec, uint32_t vec_length, int history_weight)
+{
+    const int32_t round_value = history_weight + 1;
+    const __m128i weights = _mm_set1_epi32(static_cast<int32_t>((2u << 16) | static_cast<uint16_t>(2 * history_weight)));
+    const __m128i round = _mm_set1_epi32(round_value);
+    const __m128 divisor = _mm_set1_ps(static_cast<float>(2 * round_value));
+
+    const uint32_t simd_length = vec_length & ~7u;
+    for (uint32_t i = 0; i < simd_length; i += 8)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(avg + i));
+        __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(new_vec + i));
+
+        __m128i low = BlendNumerators(_mm_unpacklo_epi16(a, n), weights, round);
+        __m128i high = BlendNumerators(_mm_unpackhi_epi16(a, n), weights, round);
+        low = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(low), divisor));
+        high = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(high), divisor));
+
+        // the averages are in the int16 range, no saturation
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(avg + i), _mm_packs_epi32(low, high));
+    }
+
+    BlendVectorsScalar(avg + simd_length, new_vec + simd_length, vec_length - simd_length, history_weight);
+}
+
+RSID_TARGET("avx2") static __m256i BlendNumerators256(__m256i pairs, __m256i weights, __m256i round_value)
+{
+    __m256i v = _mm256_madd_epi16(pairs, weights);
+    __m256i sign = _mm256_srai_epi32(v, 31);
+    return _mm256_sub_epi32(_mm256_add_epi32(v, _mm256_xor_si256(round_value, sign)), sign);
+}
+
+// unpack and pack both work within the 128 bit lanes, so the element order is kept without a permute.
+RSID_TARGET("avx2")
+void BlendVectorsAvx2(short* avg, const short* new_vec, uint32_t vec_length, int history_weight)
+{
+    const int32_t round_value = history_weight + 1;
+    const __m256i weights =
+        _mm256_set1_epi32(static_cast<int32_t>((2u << 16) | static_cast<uint16_t>(2 * history_weight)));
+    const __m256i round = _mm256_set1_epi32(round_value);
+    const __m256 divisor = _mm256_set1_ps(static_cast<float>(2 * round_value));
+
+    const uint32_t simd_length = vec_length & ~15u;
+    for (uint32_t i = 0; i < simd_length; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(avg + i));
+        __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(new_vec + i));
+
+        __m256i low = BlendNumerators256(_mm256_unpacklo_epi16(a, n), weights, round);
+        __m256i high = BlendNumerators256(_mm256_unpackhi_epi16(a, n), weights, round);
+        low = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(low), divisor));
+        high = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(high), divisor));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(avg + i), _mm256_packs_epi32(low, high));
+    }
+
+    BlendVectorsSse2(avg + simd_length, new_vec + simd_length, vec_length - simd_length, history_weight);
+}
+
+// broadcast a feature pair of T1 as one int32 lane, vpmaddwd with the pairs of 4 rows per register.
+RSID_TARGET("sse2")
+void CalcDot16InterleavedSse2(const short* T1, const short* block, const short* next_block, uint32_t vec_length,
+                              int32_t result[InterleaveRows])
+{
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    __m128i acc2 = _mm_setzero_si128();
+    __m128i acc3 = _mm_setzero_si128();
+
+    // every pair of the block is one cache line, the same line of the next block is prefetched
+    const char* prefetch = reinterpret_cast<const char*>(next_block != nullptr ? next_block : block);
+    for (uint32_t pair = 0; pair < vec_length / 2; pair++)
+    {
+        const short* pair_rows = block + pair * 2 * InterleaveRows;
+        _mm_prefetch(prefetch + pair * 2 * InterleaveRows * sizeof(short), _MM_HINT_T0);
+
+        int32_t t;
+        ::memcpy(&t, T1 + 2 * pair, sizeof(t));
+        __m128i t1 = _mm_set1_epi32(t);
+        acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(t1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pair_rows))));
+        acc1 = _mm_add_epi32(acc1,
+                             _mm_madd_epi16(t1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pair_rows + 8))));
+        acc2 = _mm_add_epi32(acc2,
+                             _mm_madd_epi16(t1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pair_rows + 16))));
+        acc3 = _mm_add_epi32(acc3,
+                             _mm_madd_epi16(t1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pair_rows + 24))));
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(result), acc0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(result + 4), acc1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(result + 8), acc2);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(result + 12), acc3);
+}
+
+RSID_TARGET("avx2")
+void CalcDot16InterleavedAvx2(const short* T1, const short* block, const short* next_block, uint32_t vec_length,
+                              int32_t result[InterleaveRows])
+{
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+
+    const char* prefetch = reinterpret_cast<const char*>(next_block != nullptr ? next_block : block);
+    for (uint32_t pair = 0; pair < vec_length / 2; pair++)
+    {
+        const short* pair_rows = block + pair * 2 * InterleaveRows;
+        _mm_prefetch(prefetch + pair * 2 * InterleaveRows * sizeof(short), _MM_HINT_T0);
+
+        int32_t t;
+        ::memcpy(&t, T1 + 2 * pair, sizeof(t));
+        __m256i t1 = _mm256_set1_epi32(t);
+        acc0 = _mm256_add_epi32(
+            acc0, _mm256_madd_epi16(t1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pair_rows))));
+        acc1 = _mm256_add_epi32(
+            acc1, _mm256_madd_epi16(t1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pair_rows + 16))));
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(result), acc0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + 8), acc1);
+}
+
+// 16 int8 pairs are sign extended to int16 and multiplied with vpmaddwd (vpmaddubsw would saturate).
+RSID_TARGET("avx2")
+int32_t CalcDotS8Avx2(const int8_t* T1, const int8_t* T2, uint32_t vec_length)
+{
+    __m256i acc_corr = _mm256_setzero_si256();
+
+    const uint32_t simd_length = vec_length & ~15u;
+    for (uint32_t i = 0; i < simd_length; i += 16)
+    {
+        __m256i t1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(T1 + i)));
+        __m256i t2 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(T2 + i)));
+        acc_corr = _mm256_add_epi32(acc_corr, _mm256_madd_epi16(t1, t2));
+    }
+
+    return static_cast<int32_t>(HorizontalSum256(acc_corr)) +
+           CalcDotS8Scalar(T1 + simd_length, T2 + simd_length, vec_length - simd_length);
+}
+
+// vpdpbusd multiplies unsigned by signed bytes, so T1 is biased to unsigned (t1 + 128) and the bias is removed with
+// 128 * sum(t2), summed by the same instruction.
+RSID_TARGET("avx512f,avx512bw,avx512vnni")
+int32_t CalcDotS8Avx512Vnni(const int8_t* T1, const int8_t* T2, uint32_t vec_length)
+{
+    const __m512i bias = _mm512_set1_epi8(static_cast<char>(0x80));
+    __m512i acc_corr = _mm512_setzero_si512();
+    __m512i acc_bias = _mm512_setzero_si512();
+
+    const uint32_t simd_length = vec_length & ~63u;
+    for (uint32_t i = 0; i < simd_length; i += 64)
+    {
+        __m512i t1 = _mm512_loadu_si512(T1 + i);
+        __m512i t2 = _mm512_loadu_si512(T2 + i);
+        acc_corr = _mm512_dpbusd_epi32(acc_corr, _mm512_xor_si512(t1, bias), t2);
+        acc_bias = _mm512_dpbusd_epi32(acc_bias, bias, t2);
+    }
+
+    alignas(64) int32_t lanes[16];
+    _mm512_store_si512(lanes, _mm512_sub_epi32(acc_corr, acc_bias));
+    int32_t corr = 0;
+    for (int32_t lane : lanes)
+    {
+        corr += lane;
+    }
+    return corr + CalcDotS8Scalar(T1 + simd_length, T2 + simd_length, vec_length - simd_length);
+}
+
+static bool CpuSupportsSse2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool CpuSupportsAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool os_xsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!os_xsave || !avx)
+    {
+        return false;
+    }
+    // make sure the os saves the ymm registers
+    if ((_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool CpuSupportsAvx512Vnni()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0)
+    {
+        return false;
+    }
+    // make sure the os saves the zmm and opmask registers
+    if ((_xgetbv(0) & 0xe6) != 0xe6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    const bool avx512f = (info[1] & (1 << 16)) != 0;
+    const bool avx512bw = (info[1] & (1 << 30)) != 0;
+    const bool avx512vnni = (info[2] & (1 << 11)) != 0;
+    return avx512f && avx512bw && avx512vnni;
+#else
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("avx512vnni");
+#endif
+}
+
+#endif // RSID_MATCHER_X86_KERNELS
+
+#ifdef RSID_MATCHER_NEON_KERNELS
+
+static uint32_t HorizontalSumNeon(int32x4_t x)
+{
+#if defined(__aarch64__)
+    return static_cast<uint32_t>(vaddvq_s32(x));
+#else
+    int32x2_t sum = vadd_s32(vget_low_s32(x), vget_high_s32(x));
+    sum = vpadd_s32(sum, sum);
+    return static_cast<uint32_t>(vget_lane_s32(sum, 0));
+#endif
+}
+
+// vmlal_s16: multiply 4 pairs of int16 and accumulate into int32 lanes.
+void CalcProductsNeon(const short* T1, const short* T2, uint32_t vec_length, VectorProducts& result)
+{
+    int32x4_t acc_corr = vdupq_n_s32(0);
+    int32x4_t acc_norm1 = vdupq_n_s32(0);
+    int32x4_t acc_norm2 = vdupq_n_s32(0);
+
+    const uint32_t simd_length = vec_length & ~7u;
+    for (uint32_t i = 0; i < simd_length; i += 8)
+    {
+        int16x8_t t1 = vld1q_s16(T1 + i);
+        int16x8_t t2 = vld1q_s16(T2 + i);
+        int16x4_t t1_low = vget_low_s16(t1);
+        int16x4_t t1_high = vget_high_s16(t1);
+        int16x4_t t2_low = vget_low_s16(t2);
+        int16x4_t t2_high = vget_high_s16(t2);
+
+        acc_corr = vmlal_s16(acc_corr, t1_low, t2_low);
+        acc_corr = vmlal_s16(acc_corr, t1_high, t2_high);
+        acc_norm1 = vmlal_s16(acc_norm1, t1_low, t1_low);
+        acc_norm1 = vmlal_s16(acc_norm1, t1_high, t1_high);
+        acc_norm2 = vmlal_s16(acc_norm2, t2_low, t2_low);
+        acc_norm2 = vmlal_s16(acc_norm2, t2_high, t2_high);
+    }
+
+    uint32_t corr = HorizontalSumNeon(acc_corr);
+    uint32_t norm1 = HorizontalSumNeon(acc_norm1);
+    uint32_t norm2 = HorizontalSumNeon(acc_norm2);
+    AddTail(T1, T2, simd_length, vec_length, corr, norm1, norm2);
+
+    result.corr = static_cast<int32_t>(corr);
+    result.norm1 = norm1;
+    result.norm2 = norm2;
+}
+
+int32_t CalcDotNeon(const short* T1, const short* T2, uint32_t vec_length)
+{
+    int32x4_t acc_corr = vdupq_n_s32(0);
+
+    const uint32_t simd_length = vec_length & ~7u;
+    for (uint32_t i = 0; i < simd_length; i += 8)
+    {
+        int16x8_t t1 = vld1q_s16(T1 + i);
+        int16x8_t t2 = vld1q_s16(T2 + i);
+        acc_corr = vmlal_s16(acc_corr, vget_low_s16(t1), vget_low_s16(t2));
+        acc_corr = vmlal_s16(acc_corr, vget_high_s16(t1), vget_high_s16(t2));
+    }
+
+    uint32_t corr = HorizontalSumNeon(acc_corr);
+    corr += static_cast<uint32_t>(CalcDotScalar(T1 + simd_length, T2 + simd_length, vec_length - simd_length));
+    return static_cast<int32_t>(corr);
+}
+
+void CalcDot4Neon(const short* T1, const short* rows, size_t row_stride, uint32_t vec_length, int32_t result[4])
+{
+    const short* row0 = rows;
+    const short* row1 = rows + row_stride;
+    const short* row2 = rows + 2 * row_stride;
+    const short* row3 = rows + 3 * row_stride;
+
+    int32x4_t acc0 = vdupq_n_s32(0);
+    int32x4_t acc1 = vdupq_n_s32(0);
+    int32x4_t acc2 = vdupq_n_s32(0);
+    int32x4_t acc3 = vdupq_n_s32(0);
+
+    const uint32_t simd_length = vec_length & ~7u;
+    for (uint32_t i = 0; i < simd_length; i += 8)
+    {
+        int16x8_t t1 = vld1q_s16(T1 + i);
+        int16x4_t t1_low = vget_low_s16(t1);
+        int16x4_t t1_high = vget_high_s16(t1);
+        int16x8_t r0 = vld1q_s16(row0 + i);
+        int16x8_t r1 = vld1q_s16(row1 + i);
+        int16x8_t r2 = vld1q_s16(row2 + i);
+        int16x8_t r3 = vld1q_s16(row3 + i);
+
+        acc0 = vmlal_s16(vmlal_s16(acc0, t1_low, vget_low_s16(r0)), t1_high, vget_high_s16(r0));
+        acc1 = vmlal_s16(vmlal_s16(acc1, t1_low, vget_low_s16(r1)), t1_high, vget_high_s16(r1));
+        acc2 = vmlal_s16(vmlal_s16(acc2, t1_low, vget_low_s16(r2)), t1_high, vget_high_s16(r2));
+        acc3 = vmlal_s16(vmlal_s16(acc3, t1_low, vget_low_s16(r3)), t1_high, vget_high_s16(r3));
+    }
+
+    const uint32_t tail_length = vec_length - simd_length;
+    result[0] = static_cast<int32_t>(HorizontalSumNeon(acc0) + static_cast<uint32_t>(CalcDotScalar(
+                                                                   T1 + simd_length, row0 + simd_length, tail_length)));
+    result[1] = static_cast<int32_t>(HorizontalSumNeon(acc1) + static_cast<uint32_t>(CalcDotScalar(
+                                                                   T1 + simd_length, row1 + simd_length, tail_length)));
+    result[2] = static_cast<int32_t>(HorizontalSumNeon(acc2) + static_cast<uint32_t>(CalcDotScalar(
+                                                                   T1 + simd_length, row2 + simd_length, tail_length)));
+    result[3] = static_cast<int32_t>(HorizontalSumNeon(acc3) + static_cast<uint32_t>(CalcDotScalar(
+                                                                   T1 + simd_length, row3 + simd_length, tail_length)));
+}
+
+#if defined(__aarch64__)
+static int32x4_t BlendNumeratorsNeon(int16x4_t a, int16x4_t n, int16_t weight, int32x4_t round_value)
+{
+    int32x4_t v = vmlal_n_s16(vmull_n_s16(a, weight), n, 2);
+    int32x4_t sign = vshrq_n_s32(v, 31);
+    return vsubq_s32(vaddq_s32(v, veorq_s32(round_value, sign)), sign);
+}
+#endif // __aarch64__
+
+// same arithmetic as the x86 kernels. armv7 has no vector division - the scalar loop is used there.
+void BlendVectorsNeon(short* avg, const short* new_vec, uint32_t vec_length, int history_weight)
+{
+    uint32_t simd_length = 0;
+#if defined(__aarch64__)
+    const int32_t round_value = history_weight + 1;
+    const int16_t weight = static_cast<int16_t>(2 * history_weight);
+    const int32x4_t round = vdupq_n_s32(round_value);
+    const float32x4_t divisor = vdupq_n_f32(static_cast<float>(2 * round_value));
+
+    simd_length = vec_length & ~7u;
+    for (uint32_t i = 0; i < simd_length; i += 8)
+    {
+        int16x8_t a = vld1q_s16(avg + i);
+        int16x8_t n = vld1q_s16(new_vec + i);
+
+        int32x4_t low = BlendNumeratorsNeon(vget_low_s16(a), vget_low_s16(n), weight, round);
+        int32x4_t high = BlendNumeratorsNeon(vget_high_s16(a), vget_high_s16(n), weight, round);
+        low = vcvtq_s32_f32(vdivq_f32(vcvtq_f32_s32(low), divisor));
+        high = vcvtq_s32_f32(vdivq_f32(vcvtq_f32_s32(high), divisor));
+
+        vst1q_s16(avg + i, vcombine_s16(vmovn_s32(low), vmovn_s32(high)));
+    }
+#endif // __aarch64__
+
+    BlendVectorsScalar(avg + simd_length, new_vec + simd_length, vec_length - simd_length, history_weight);
+}
+
+// the products of the pairs of 2 rows are accumulated per feature (4 lanes), the lanes of a row are added at the end.
+void CalcDot16InterleavedNeon(const short* T1, const short* block, const short* next_block, uint32_t vec_length,
+                              int32_t result[InterleaveRows])
+{
+    int32x4_t acc[InterleaveRows / 2];
+    for (auto& lanes : acc)
+    {
+        lanes = vdupq_n_s32(0);
+    }
+
+    const short* prefetch = next_block != nullptr ? next_block : block;
+    for (uint32_t pair = 0; pair < vec_length / 2; pair++)
+    {
+        const short* pair_rows = block + pair * 2 * InterleaveRows;
+        __builtin_prefetch(prefetch + pair * 2 * InterleaveRows);
+
+        int32_t t;
+        ::memcpy(&t, T1 + 2 * pair, sizeof(t));
+        int16x4_t t1 = vreinterpret_s16_s32(vdup_n_s32(t));
+        for (size_t k = 0; k < InterleaveRows / 4; k++)
+        {
+            int16x8_t rows = vld1q_s16(pair_rows + 8 * k);
+            acc[2 * k] = vmlal_s16(acc[2 * k], vget_low_s16(rows), t1);
+            acc[2 * k + 1] = vmlal_s16(acc[2 * k + 1], vget_high_s16(rows), t1);
+        }
+    }
+
+    int32_t lanes[2 * InterleaveRows];
+    for (size_t k = 0; k < InterleaveRows / 2; k++)
+    {
+        vst1q_s32(lanes + 4 * k, acc[k]);
+    }
+    for (size_t row = 0; row < InterleaveRows; row++)
+    {
+        result[row] = static_cast<int32_t>(static_cast<uint32_t>(lanes[2 * row]) +
+                                           static_cast<uint32_t>(lanes[2 * row + 1]));
+    }
+}
+
+// sdot if the target has the dot product extension, otherwise int16 products of the byte pairs (|product| <=
+// 2 * 127 * 127 fits in int16) accumulated pairwise to int32.
+int32_t CalcDotS8Neon(const int8_t* T1, const int8_t* T2, uint32_t vec_length)
+{
+    int32x4_t acc_corr = vdupq_n_s32(0);
+
+    const uint32_t simd_length = vec_length & ~15u;
+    for (uint32_t i = 0; i < simd_length; i += 16)
+    {
+        int8x16_t t1 = vld1q_s8(T1 + i);
+        int8x16_t t2 = vld1q_s8(T2 + i);
+#if defined(__ARM_FEATURE_DOTPROD)
+        acc_corr = vdotq_s32(acc_corr, t1, t2);
+#else
+        int16x8_t products = vmull_s8(vget_low_s8(t1), vget_low_s8(t2));
+        products = vmlal_s8(products, vget_high_s8(t1), vget_high_s8(t2));
+        acc_corr = vpadalq_s16(acc_corr, products);
+#endif // __ARM_FEATURE_DOTPROD
+    }
+
+    return static_cast<int32_t>(HorizontalSumNeon(acc_corr)) +
+           CalcDotS8Scalar(T1 + simd_length, T2 + simd_length, vec_length - simd_length);
+}
+
+#endif // RSID_MATCHER_NEON_KERNELS
+
+static inline uint32_t PopCount64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<uint32_t>(__builtin_popcountll(x));
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<uint32_t>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+uint32_t CalcHamming(const uint64_t* code1, const uint64_t* code2, size_t n_words)
+{
+    uint32_t distance = 0;
+    for (size_t i = 0; i < n_words; i++)
+    {
+        distance += PopCount64(code1[i] ^ code2[i]);
+    }
+    return distance;
+}
+
+struct SelectedKernel
+{
+    calc_products_func products_func;
+    calc_dot_func dot_func;
+    calc_dot4_func dot4_func;
+    calc_dot16_interleaved_func dot16_func;
+    blend_vectors_func blend_func;
+    const char* name;
+};
+
+static SelectedKernel SelectKernel()
+{
+#ifdef RSID_MATCHER_X86_KERNELS
+    if (CpuSupportsAvx2())
+    {
+        return {CalcProductsAvx2, CalcDotAvx2, CalcDot4Avx2, CalcDot16InterleavedAvx2, BlendVectorsAvx2, "avx2"};
+    }
+    if (CpuSupportsSse2())
+    {
+        return {CalcProductsSse2, CalcDotSse2, CalcDot4Sse2, CalcDot16InterleavedSse2, BlendVectorsSse2, "sse2"};
+    }
+#endif // RSID_MATCHER_X86_KERNELS
+
+#ifdef RSID_MATCHER_NEON_KERNELS
+    return {CalcProductsNeon, CalcDotNeon, CalcDot4Neon, CalcDot16InterleavedNeon, BlendVectorsNeon, "neon"};
+#else
+    return {CalcProductsPortable, CalcDotPortable, CalcDot4Portable, CalcDot16InterleavedScalar, BlendVectorsScalar,
+            "scalar"};
+#endif // RSID_MATCHER_NEON_KERNELS
+}
+
+static const SelectedKernel& GetSelectedKernel()
+{
+    static const SelectedKernel selected = [] {
+        auto kernel = SelectKernel();
+        LOG_DEBUG(LOG_TAG, "Using %s matcher kernel", kernel.name);
+        return kernel;
+    }();
+    return selected;
+}
+
+calc_products_func GetCalcProducts()
+{
+    return GetSelectedKernel().products_func;
+}
+
+calc_dot_func GetCalcDot()
+{
+    return GetSelectedKernel().dot_func;
+}
+
+calc_dot4_func GetCalcDot4()
+{
+    return GetSelectedKernel().dot4_func;
+}
+
+calc_dot16_interleaved_func GetCalcDot16Interleaved()
+{
+    return GetSelectedKernel().dot16_func;
+}
+
+blend_vectors_func GetBlendVectors()
+{
+    return GetSelectedKernel().blend_func;
+}
+
+const char* GetCalcProductsName()
+{
+    return GetSelectedKernel().name;
+}
+
+struct SelectedS8Kernel
+{
+    calc_dot_s8_func dot_func;
+    const char* name;
+};
+
+static SelectedS8Kernel SelectS8Kernel()
+{
+#ifdef RSID_MATCHER_X86_KERNELS
+    if (CpuSupportsAvx512Vnni())
+    {
+        return {CalcDotS8Avx512Vnni, "avx512vnni"};
+    }
+    if (CpuSupportsAvx2())
+    {
+        return {CalcDotS8Avx2, "avx2"};
+    }
+#endif // RSID_MATCHER_X86_KERNELS
+
+#ifdef RSID_MATCHER_NEON_KERNELS
+#if defined(__ARM_FEATURE_DOTPROD)
+    return {CalcDotS8Neon, "neon sdot"};
+#else
+    return {CalcDotS8Neon, "neon"};
+#endif // __ARM_FEATURE_DOTPROD
+#else
+    return {CalcDotS8Scalar, "scalar"};
+#endif // RSID_MATCHER_NEON_KERNELS
+}
+
+static const SelectedS8Kernel& GetSelectedS8Kernel()
+{
+    static const SelectedS8Kernel selected = [] {
+        auto kernel = SelectS8Kernel();
+        LOG_DEBUG(LOG_TAG, "Using %s int8 matcher kernel", kernel.name);
+        return kernel;
+    }();
+    return selected;
+}
+
+calc_dot_s8_func GetCalcDotS8()
+{
+    return GetSelectedS8Kernel().dot_func;
+}
+
+const char* GetCalcDotS8Name()
+{
+    return GetSelectedS8Kernel().name;
+}
+} // namespace MatcherKernels
+} // namespace RealSenseID
@@ -0,0 +1,161 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <type_traits>
+
+// Select which SIMD kernels can be compiled on this target.
+// x86 kernels are compiled with per-function target attributes (gcc/clang) or unconditionally (msvc) and are only
+// called if the cpu supports them. NEON kernels are compiled only if NEON is enabled for the target.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RSID_MATCHER_X86_KERNELS
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RSID_MATCHER_NEON_KERNELS
+#endif
+
+namespace RealSenseID
+{
+namespace MatcherKernels
+{
+// Integer products of two feature vectors, as needed by the normalized cross-correlation.
+// All kernels must produce bit-identical results to CalcProductsScalar().
+struct VectorProducts
+{
+    int32_t corr = 0;   // sum(t1 * t2)
+    uint32_t norm1 = 0; // sum(t1 * t1)
+    uint32_t norm2 = 0; // sum(t2 * t2)
+};
+
+using calc_products_func = void (*)(const short* T1, const short* T2, uint32_t vec_length, VectorProducts& result);
+
+// Dot product only - used when the norms are already known (e.g. cached in the gallery).
+// The norm of a vector is the unsigned value of its dot product with itself.
+using calc_dot_func = int32_t (*)(const short* T1, const short* T2, uint32_t vec_length);
+
+// Dot products of one vector with 4 consecutive rows of a matrix (rows are row_stride elements apart).
+// Register blocked - each load of T1 is reused for 4 rows. result[i] = dot(T1, rows + i * row_stride).
+using calc_dot4_func = void (*)(const short* T1, const short* rows, size_t row_stride, uint32_t vec_length,
+                                int32_t result[4]);
+
+// Dot products of one vector with the InterleaveRows rows of an interleaved block (see
+// FaceprintsGallery::SetInterleaved()): the feature pairs (2i, 2i + 1) of all rows follow each other, so a single pass
+// over the block computes all the products. next_block (may be nullptr) is prefetched during the pass.
+// vec_length must be even. result[r] = dot(T1, row r), bit-identical to CalcDotScalar().
+static constexpr size_t InterleaveRows = 16;
+using calc_dot16_interleaved_func = void (*)(const short* T1, const short* block, const short* next_block,
+                                             uint32_t vec_length, int32_t result[InterleaveRows]);
+
+// Weighted average of two feature vectors in place, rounded half away from zero:
+// avg[i] = round((history_weight * avg[i] + new_vec[i]) / (history_weight + 1)).
+// All kernels must produce bit-identical results to BlendVectorsScalar() for history_weight in
+// [1, MaxBlendHistoryWeight] (the simd kernels divide in single precision, which is exact in this range).
+using blend_vectors_func = void (*)(short* avg, const short* new_vec, uint32_t vec_length, int history_weight);
+
+static constexpr int MaxBlendHistoryWeight = 126;
+
+// Dot product of two int8 vectors (quantized features, see FaceprintsQuantizedIndex), values in [-127, 127].
+// All kernels must produce identical results to CalcDotS8Scalar() (exact in int32).
+using calc_dot_s8_func = int32_t (*)(const int8_t* T1, const int8_t* T2, uint32_t vec_length);
+
+// Reference implementations
+void CalcProductsScalar(const short* T1, const short* T2, uint32_t vec_length, VectorProducts& result);
+int32_t CalcDotScalar(const short* T1, const short* T2, uint32_t vec_length);
+void CalcDot4Scalar(const short* T1, const short* rows, size_t row_stride, uint32_t vec_length, int32_t result[4]);
+void CalcDot16InterleavedScalar(const short* T1, const short* block, const short* next_block, uint32_t vec_length,
+                                int32_t result[InterleaveRows]);
+void BlendVectorsScalar(short* avg, const short* new_vec, uint32_t vec_length, int history_weight);
+int32_t CalcDotS8Scalar(const int8_t* T1, const int8_t* T2, uint32_t vec_length);
+
+#ifdef RSID_MATCHER_X86_KERNELS
+void CalcProductsSse2(const short* T1, const short* T2, uint32_t vec_length, VectorProducts& result);
+void CalcProductsAvx2(const short* T1, const short* T2, uint32_t vec_length, VectorProducts& result);
+int32_t CalcDotSse2(const short* T1, const short* T2, uint32_t vec_length);
+int32_t CalcDotAvx2(const short* T1, const short* T2, uint32_t vec_length);
+void CalcDot4Sse2(const short* T1, const short* rows, size_t row_stride, uint32_t vec_length, int32_t result[4]);
+void CalcDot4Avx2(const short* T1, const short* rows, size_t row_stride, uint32_t vec_length, int32_t result[4]);
+void CalcDot16InterleavedSse2(const short* T1, const short* block, const short* next_block, uint32_t vec_length,
+                              int32_t result[InterleaveRows]);
+void CalcDot16InterleavedAvx2(const short* T1, const short* block, const short* next_block, uint32_t vec_length,
+                              int32_t result[InterleaveRows]);
+void BlendVectorsSse2(short* avg, const short* new_vec, uint32_t vec_length, int history_weight);
+void BlendVectorsAvx2(short* avg, const short* new_vec, uint32_t vec_length, int history_weight);
+int32_t CalcDotS8Avx2(const int8_t* T1, const int8_t* T2, uint32_t vec_length);
+int32_t CalcDotS8Avx512Vnni(const int8_t* T1, const int8_t* T2, uint32_t vec_length);
+#endif // RSID_MATCHER_X86_KERNELS
+
+#ifdef RSID_MATCHER_NEON_KERNELS
+void CalcProductsNeon(const short* T1, const short* T2, uint32_t vec_length, VectorProducts& result);
+int32_t CalcDotNeon(const short* T1, const short* T2, uint32_t vec_length);
+void CalcDot4Neon(const short* T1, const short* rows, size_t row_stride, uint32_t vec_length, int32_t result[4]);
+void CalcDot16InterleavedNeon(const short* T1, const short* block, const short* next_block, uint32_t vec_length,
+                              int32_t result[InterleaveRows]);
+void BlendVectorsNeon(short* avg, const short* new_vec, uint32_t vec_length, int history_weight);
+int32_t CalcDotS8Neon(const int8_t* T1, const int8_t* T2, uint32_t vec_length);
+#endif // RSID_MATCHER_NEON_KERNELS
+
+// Compile-time layout of a feature vector: VecLength features of FeatureBits signed bits each (values in
+// [-MaxFeatureValue, MaxFeatureValue]), optionally followed by one norm element that is not part of the products.
+// The accumulator is the narrowest type in which the sum of VecLength products can not overflow.
+template <uint32_t VecLength, uint32_t FeatureBits, bool NormInLastElement = false>
+struct FeatureLayout
+{
+    static_assert(VecLength > 0, "Empty feature vector");
+    static_assert(FeatureBits >= 2 && FeatureBits <= 16, "Features must fit in short");
+
+    static constexpr uint32_t NumFeatures = VecLength;
+    static constexpr uint32_t AllocLength = NormInLastElement ? VecLength + 1 : VecLength;
+    static constexpr bool HasNormElement = NormInLastElement;
+    static constexpr int32_t MaxFeatureValue = (1 << (FeatureBits - 1)) - 1;
+    static constexpr uint64_t MaxProductsSum =
+        static_cast<uint64_t>(VecLength) * static_cast<uint64_t>(MaxFeatureValue) * static_cast<uint64_t>(MaxFeatureValue);
+
+    using accumulator_t = typename std::conditional<MaxProductsSum <= 0x7fffffffULL, int32_t, int64_t>::type;
+    using unsigned_accumulator_t = typename std::make_unsigned<accumulator_t>::type;
+};
+
+// 256 features in [-1023, 1023] (the current layout, see MatcherImplDefines.h).
+using DefaultFeatureLayout = FeatureLayout<256, 11>;
+// Same features with the norm saved in the last element of the vector (NOT YET enabled, see MatcherImplDefines.h).
+using NormElementFeatureLayout = FeatureLayout<256, 11, true>;
+
+template <typename Layout>
+struct FixedVectorProducts
+{
+    typename Layout::accumulator_t corr = 0;
+    typename Layout::unsigned_accumulator_t norm1 = 0;
+    typename Layout::unsigned_accumulator_t norm2 = 0;
+};
+
+// Kernels specialized for a fixed layout - the trip count is known at compile time so the compiler can fully unroll
+// and vectorize them for the target. Only the features take part, the norm element (if any) is skipped.
+// For layouts with 32 bit accumulators the results are bit-identical to the runtime length kernels.
+// Explicitly instantiated for DefaultFeatureLayout and NormElementFeatureLayout.
+template <typename Layout>
+void CalcProductsFixed(const short* T1, const short* T2, FixedVectorProducts<Layout>& result);
+
+template <typename Layout>
+typename Layout::accumulator_t CalcDotFixed(const short* T1, const short* T2);
+
+// true if all features are in [-MaxFeatureValue, MaxFeatureValue]. Branch free (no early exit).
+template <typename Layout>
+bool ValidateVectorFixed(const short* vec);
+
+// Hamming distance between two binary codes of n_words 64 bit words.
+uint32_t CalcHamming(const uint64_t* code1, const uint64_t* code2, size_t n_words);
+
+// Return the fastest kernels supported by the running cpu (detected once).
+calc_products_func GetCalcProducts();
+calc_dot_func GetCalcDot();
+calc_dot4_func GetCalcDot4();
+calc_dot16_interleaved_func GetCalcDot16Interleaved();
+blend_vectors_func GetBlendVectors();
+calc_dot_s8_func GetCalcDotS8();
+
+// Name of the kernels returned by the GetCalc*() functions (for logging).
+const char* GetCalcProductsName();
+const char* GetCalcDotS8Name();
+} // namespace MatcherKernels
+} // namespace RealSenseID
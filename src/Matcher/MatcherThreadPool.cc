@@ -0,0 +1,47 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MatcherThreadPool.h"
+#include "TaskScheduler.h"
+#include "Logger.h"
+#include <thread>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "MatcherThreadPool";
+
+MatcherThreadPool::MatcherThreadPool(unsigned int num_threads) : _num_threads {num_threads}
+{
+    if (_num_threads == 0)
+    {
+        _num_threads = std::thread::hardware_concurrency();
+    }
+    if (_num_threads == 0)
+    {
+        _num_threads = 1;
+    }
+
+    // a single thread pool runs its tasks on the calling thread only
+    if (_num_threads > 1)
+    {
+        _scheduler = TaskScheduler::Acquire();
+    }
+    LOG_DEBUG(LOG_TAG, "Created thread pool with %u threads", _num_threads);
+}
+
+MatcherThreadPool::~MatcherThreadPool() = default;
+
+void MatcherThreadPool::Run(size_t num_tasks, const std::function<void(size_t)>& task)
+{
+    // no need to wake the scheduler for a single task
+    if (num_tasks <= 1 || !_scheduler)
+    {
+        for (size_t i = 0; i < num_tasks; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+    _scheduler->ParallelFor(num_tasks, _num_threads, task);
+}
+} // namespace RealSenseID
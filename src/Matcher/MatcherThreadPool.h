@@ -0,0 +1,43 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace RealSenseID
+{
+class TaskScheduler;
+
+/**
+ * Thread pool used by the matcher for parallel 1:N gallery search (and the raw preview conversion).
+ * Run() distributes tasks over the threads of the process wide task scheduler and the calling thread, and blocks
+ * until all tasks are done.
+ */
+class MatcherThreadPool
+{
+public:
+    // num_threads is the max number of threads used by Run(), including the calling thread.
+    // 0 means std::thread::hardware_concurrency().
+    explicit MatcherThreadPool(unsigned int num_threads = 0);
+    ~MatcherThreadPool();
+
+    MatcherThreadPool(const MatcherThreadPool&) = delete;
+    MatcherThreadPool& operator=(const MatcherThreadPool&) = delete;
+
+    unsigned int NumThreads() const
+    {
+        return _num_threads;
+    }
+
+    // call task(task_index) for each task_index in [0, num_tasks). Blocks until all tasks are done.
+    // concurrent calls to Run() share the scheduler's threads.
+    void Run(size_t num_tasks, const std::function<void(size_t)>& task);
+
+private:
+    unsigned int _num_threads;
+    std::shared_ptr<TaskScheduler> _scheduler;
+};
+} // namespace RealSenseID
@@ -0,0 +1,254 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MultiTemplateGallery.h"
+#include "Matcher.h"
+#include <cstring>
+
+namespace RealSenseID
+{
+int MultiTemplateGallery::Add(const char* user_id, const std::vector<Faceprints>& templates)
+{
+    if (templates.empty() || templates.size() > MaxTemplatesPerUser)
+    {
+        return -1;
+    }
+
+    size_t user = Size();
+    UserIdEntry id;
+    ::memset(id.id, 0, sizeof(id.id));
+    if (user_id != nullptr)
+    {
+        ::strncpy(id.id, user_id, sizeof(id.id) - 1);
+    }
+    _user_ids.push_back(id);
+    _user_id_index.Insert(user, id.id);
+
+    size_t first_row = Rows();
+    _first_rows.push_back(first_row);
+    _template_counts.push_back(templates.size());
+    InsertRows(first_row, templates.size());
+    for (size_t t = 0; t < templates.size(); t++)
+    {
+        _row_users[first_row + t] = static_cast<uint32_t>(user);
+        SetRow(first_row + t, templates[t]);
+    }
+    return static_cast<int>(user);
+}
+
+bool MultiTemplateGallery::AddTemplate(size_t user, const Faceprints& faceprints)
+{
+    if (user >= Size() || _template_counts[user] >= MaxTemplatesPerUser)
+    {
+        return false;
+    }
+    size_t row = _first_rows[user] + _template_counts[user];
+    InsertRows(row, 1);
+    _template_counts[user]++;
+    _row_users[row] = static_cast<uint32_t>(user);
+    SetRow(row, faceprints);
+    return true;
+}
+
+bool MultiTemplateGallery::Update(size_t user, size_t template_index, const Faceprints& faceprints)
+{
+    if (user >= Size() || template_index >= _template_counts[user])
+    {
+        return false;
+    }
+    size_t row = _first_rows[user] + template_index;
+    UncountRow(_metadata[row]);
+    SetRow(row, faceprints);
+    return true;
+}
+
+bool MultiTemplateGallery::Remove(size_t user)
+{
+    size_t size = Size();
+    if (user >= size)
+    {
+        return false;
+    }
+
+    size_t first_row = _first_rows[user];
+    size_t count = _template_counts[user];
+    for (size_t row = first_row; row < first_row + count; row++)
+    {
+        UncountRow(_metadata[row]);
+    }
+    EraseRows(first_row, count);
+
+    size_t last = size - 1;
+    _user_id_index.Erase(user, _user_ids[user].id);
+    if (user != last)
+    {
+        _user_id_index.Move(last, user, _user_ids[last].id);
+        _user_ids[user] = _user_ids[last];
+        _first_rows[user] = _first_rows[last];
+        _template_counts[user] = _template_counts[last];
+        for (size_t row = _first_rows[user]; row < _first_rows[user] + _template_counts[user]; row++)
+        {
+            _row_users[row] = static_cast<uint32_t>(user);
+        }
+    }
+    _user_ids.pop_back();
+    _first_rows.pop_back();
+    _template_counts.pop_back();
+    return true;
+}
+
+int MultiTemplateGallery::Find(const char* user_id) const
+{
+    if (user_id == nullptr)
+    {
+        return -1;
+    }
+    if (UserIdIndex::IsIndexed(user_id))
+    {
+        return _user_id_index.Find(user_id, [this](size_t user) { return _user_ids[user].id; });
+    }
+
+    // empty ids (users added without an id) are not indexed
+    for (size_t i = 0; i < _user_ids.size(); i++)
+    {
+        if (::strncmp(_user_ids[i].id, user_id, sizeof(_user_ids[i].id)) == 0)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void MultiTemplateGallery::Clear()
+{
+    _avg_vectors.clear();
+    _orig_vectors.clear();
+    _metadata.clear();
+    _avg_norm_msbs.clear();
+    _avg_norm_recips.clear();
+    _row_users.clear();
+    _user_ids.clear();
+    _first_rows.clear();
+    _template_counts.clear();
+    _user_id_index.Clear();
+    _num_unusable = 0;
+    _version_counts.clear();
+}
+
+void MultiTemplateGallery::Reserve(size_t users, size_t rows)
+{
+    _avg_vectors.reserve(rows * VectorLength);
+    _orig_vectors.reserve(rows * VectorLength);
+    _metadata.reserve(rows);
+    _avg_norm_msbs.reserve(rows);
+    _avg_norm_recips.reserve(rows);
+    _row_users.reserve(rows);
+    _user_ids.reserve(users);
+    _first_rows.reserve(users);
+    _template_counts.reserve(users);
+    _user_id_index.Reserve(users);
+}
+
+bool MultiTemplateGallery::GetRowFaceprints(size_t row, Faceprints& faceprints) const
+{
+    if (row >= Rows())
+    {
+        return false;
+    }
+
+    auto& metadata = _metadata[row];
+    faceprints.version = metadata.version;
+    faceprints.numberOfDescriptors = metadata.numberOfDescriptors;
+    faceprints.featuresType = metadata.featuresType;
+    ::memcpy(&faceprints.avgDescriptor[0], &_avg_vectors[row * VectorLength], VectorLength * sizeof(feature_t));
+    ::memcpy(&faceprints.origDescriptor[0], &_orig_vectors[row * VectorLength], VectorLength * sizeof(feature_t));
+    return true;
+}
+
+bool MultiTemplateGallery::GetFaceprints(size_t user, size_t template_index, Faceprints& faceprints) const
+{
+    if (user >= Size() || template_index >= _template_counts[user])
+    {
+        return false;
+    }
+    return GetRowFaceprints(_first_rows[user] + template_index, faceprints);
+}
+
+void MultiTemplateGallery::InsertRows(size_t row, size_t count)
+{
+    _avg_vectors.insert(_avg_vectors.begin() + row * VectorLength, count * VectorLength, 0);
+    _orig_vectors.insert(_orig_vectors.begin() + row * VectorLength, count * VectorLength, 0);
+    _metadata.insert(_metadata.begin() + row, count, Metadata {});
+    _avg_norm_msbs.insert(_avg_norm_msbs.begin() + row, count, 1);
+    _avg_norm_recips.insert(_avg_norm_recips.begin() + row, count, 0);
+    _row_users.insert(_row_users.begin() + row, count, 0);
+    if (row + count == Rows())
+    {
+        return;
+    }
+    for (auto& first_row : _first_rows)
+    {
+        if (first_row >= row)
+        {
+            first_row += count;
+        }
+    }
+}
+
+void MultiTemplateGallery::EraseRows(size_t row, size_t count)
+{
+    _avg_vectors.erase(_avg_vectors.begin() + row * VectorLength, _avg_vectors.begin() + (row + count) * VectorLength);
+    _orig_vectors.erase(_orig_vectors.begin() + row * VectorLength,
+                        _orig_vectors.begin() + (row + count) * VectorLength);
+    _metadata.erase(_metadata.begin() + row, _metadata.begin() + row + count);
+    _avg_norm_msbs.erase(_avg_norm_msbs.begin() + row, _avg_norm_msbs.begin() + row + count);
+    _avg_norm_recips.erase(_avg_norm_recips.begin() + row, _avg_norm_recips.begin() + row + count);
+    _row_users.erase(_row_users.begin() + row, _row_users.begin() + row + count);
+    for (auto& first_row : _first_rows)
+    {
+        if (first_row > row)
+        {
+            first_row -= count;
+        }
+    }
+}
+
+void MultiTemplateGallery::SetRow(size_t row, const Faceprints& faceprints)
+{
+    ::memcpy(&_avg_vectors[row * VectorLength], &faceprints.avgDescriptor[0], VectorLength * sizeof(feature_t));
+    ::memcpy(&_orig_vectors[row * VectorLength], &faceprints.origDescriptor[0], VectorLength * sizeof(feature_t));
+
+    auto& metadata = _metadata[row];
+    metadata.version = faceprints.version;
+    metadata.numberOfDescriptors = faceprints.numberOfDescriptors;
+    metadata.featuresType = faceprints.featuresType;
+    metadata.is_valid = Matcher::ValidateFaceprints(faceprints);
+
+    uint32_t norm = 1;
+    Matcher::CalculateNorm(&faceprints.avgDescriptor[0], norm, _avg_norm_msbs[row]);
+    _avg_norm_recips[row] = Matcher::CalculateNormReciprocal(norm);
+    CountRow(metadata);
+}
+
+void MultiTemplateGallery::CountRow(const Metadata& metadata)
+{
+    if (!FaceprintsGallery::IsUsable(metadata))
+    {
+        _num_unusable++;
+    }
+    _version_counts[metadata.version]++;
+}
+
+void MultiTemplateGallery::UncountRow(const Metadata& metadata)
+{
+    if (!FaceprintsGallery::IsUsable(metadata))
+    {
+        _num_unusable--;
+    }
+    auto it = _version_counts.find(metadata.version);
+    if (--it->second == 0)
+    {
+        _version_counts.erase(it);
+    }
+}
+} // namespace RealSenseID
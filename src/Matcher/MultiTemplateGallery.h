@@ -0,0 +1,166 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include "RealSenseID/Faceprints.h"
+#include <cstddef>
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Packed gallery of users with several templates each (e.g. enrolled with and without glasses, or at different
+ * angles), for host side 1:N matching. A user is scored by its best template.
+ * The templates (avg and orig vectors, with the cached avg norms) are rows of the same structure of arrays as
+ * FaceprintsGallery, and the templates of a user are consecutive rows. The scan is a single streaming pass over all
+ * the rows, as for a gallery of single template users, and the grades of a user's rows are max reduced on the fly.
+ * Users are swapped with the last user on removal (like FaceprintsGallery); their rows are erased, so the rows after
+ * them move up and the row order is not the user order - RowUser() maps a row to its user.
+ */
+class MultiTemplateGallery
+{
+public:
+    static constexpr size_t VectorLength = FaceprintsGallery::VectorLength;
+    static constexpr size_t MaxUserIdLength = FaceprintsGallery::MaxUserIdLength;
+    static constexpr size_t RowAlignment = FaceprintsGallery::RowAlignment;
+    static constexpr size_t MaxTemplatesPerUser = 16;
+
+    using Metadata = FaceprintsGallery::Metadata;
+
+    // add user with the given templates (1 to MaxTemplatesPerUser). returns the index of the new user, or -1 if the
+    // number of templates is out of range.
+    int Add(const char* user_id, const std::vector<Faceprints>& templates);
+
+    // add a template to an existing user. moves up the rows after the user's rows (O(rows)).
+    // returns false if the user index is out of range or the user has MaxTemplatesPerUser templates.
+    bool AddTemplate(size_t user, const Faceprints& faceprints);
+
+    // replace a template of a user (e.g. after should_update) and refresh its cached norm.
+    // returns false if the user or template index is out of range.
+    bool Update(size_t user, size_t template_index, const Faceprints& faceprints);
+
+    // remove user by moving the last user into its place (the last user's index changes to the given index). the
+    // user's rows are erased (O(rows)). returns false if index is out of range.
+    bool Remove(size_t user);
+
+    // index of the given user id or -1 if not found (the lowest index if the id was added more than once).
+    int Find(const char* user_id) const;
+
+    void Clear();
+
+    // room for the given number of users and templates (rows) without growing
+    void Reserve(size_t users, size_t rows);
+
+    size_t Size() const
+    {
+        return _user_ids.size();
+    }
+
+    bool Empty() const
+    {
+        return _user_ids.empty();
+    }
+
+    // total number of templates of all users
+    size_t Rows() const
+    {
+        return _metadata.size();
+    }
+
+    size_t TemplateCount(size_t user) const
+    {
+        return _template_counts[user];
+    }
+
+    // first row of the user's templates, template t of the user is row FirstRow(user) + t.
+    size_t FirstRow(size_t user) const
+    {
+        return _first_rows[user];
+    }
+
+    size_t RowUser(size_t row) const
+    {
+        return _row_users[row];
+    }
+
+    // all templates are usable and have the given version (true for an empty gallery).
+    bool IsValidated(int version) const
+    {
+        return _num_unusable == 0 &&
+               (_version_counts.empty() || (_version_counts.size() == 1 && _version_counts.begin()->first == version));
+    }
+
+    const char* UserId(size_t user) const
+    {
+        return _user_ids[user].id;
+    }
+
+    // copy the faceprints of the given row. returns false if row is out of range.
+    bool GetRowFaceprints(size_t row, Faceprints& faceprints) const;
+
+    // copy the faceprints of template template_index of the given user. returns false if out of range.
+    bool GetFaceprints(size_t user, size_t template_index, Faceprints& faceprints) const;
+
+    // raw arrays for the streaming scan (Rows() entries each, avg vectors are VectorLength elements per row).
+    const feature_t* AvgVectorsData() const
+    {
+        return _avg_vectors.data();
+    }
+
+    const Metadata* MetadataData() const
+    {
+        return _metadata.data();
+    }
+
+    const short* AvgNormMsbsData() const
+    {
+        return _avg_norm_msbs.data();
+    }
+
+    const uint64_t* AvgNormRecipsData() const
+    {
+        return _avg_norm_recips.data();
+    }
+
+    const uint32_t* RowUsersData() const
+    {
+        return _row_users.data();
+    }
+
+private:
+    struct UserIdEntry
+    {
+        char id[MaxUserIdLength];
+    };
+
+    // insert count empty rows before row (the rows from row on move up)
+    void InsertRows(size_t row, size_t count);
+    // erase count rows from row on (the rows after them move down)
+    void EraseRows(size_t row, size_t count);
+    void SetRow(size_t row, const Faceprints& faceprints);
+    void CountRow(const Metadata& metadata);
+    void UncountRow(const Metadata& metadata);
+
+    // per row
+    std::vector<feature_t, AlignedAllocator<feature_t, RowAlignment>> _avg_vectors;
+    std::vector<feature_t> _orig_vectors;
+    std::vector<Metadata> _metadata;
+    std::vector<short> _avg_norm_msbs;
+    std::vector<uint64_t> _avg_norm_recips;
+    std::vector<uint32_t> _row_users;
+
+    // per user
+    std::vector<UserIdEntry> _user_ids;
+    std::vector<size_t> _first_rows;
+    std::vector<size_t> _template_counts;
+    UserIdIndex _user_id_index {MaxUserIdLength};
+
+    // validation invariant, maintained on every change
+    size_t _num_unusable = 0;
+    std::map<int, size_t> _version_counts;
+};
+} // namespace RealSenseID
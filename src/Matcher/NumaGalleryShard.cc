@@ -0,0 +1,107 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "NumaGalleryShard.h"
+#include "ThreadConfigImpl.h"
+#include "GalleryMemory.h"
+#include "Logger.h"
+#include <utility>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "NumaGalleryShard";
+
+NumaGalleryShard::NumaGalleryShard(size_t node) : _node {node}
+{
+    std::vector<int> cpus;
+    if (!GalleryMemory::GetNodeCpus(node, cpus))
+    {
+        LOG_WARNING(LOG_TAG, "Cpus of numa node %zu unknown, shard not pinned", node);
+    }
+    _worker = std::thread(&NumaGalleryShard::WorkerLoop, this, std::move(cpus));
+
+    // wait for the pinning, so IsPinned() is final
+    std::unique_lock<std::mutex> lock {_mutex};
+    _done_cv.wait(lock, [this] { return _is_started; });
+}
+
+NumaGalleryShard::~NumaGalleryShard()
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _should_stop = true;
+    }
+    _work_cv.notify_one();
+    _worker.join();
+}
+
+bool NumaGalleryShard::Enroll(const char* user_id, const Faceprints& faceprints)
+{
+    bool ok = false;
+    Execute([&] { ok = _shard.Enroll(user_id, faceprints); });
+    return ok;
+}
+
+bool NumaGalleryShard::Remove(const char* user_id)
+{
+    bool ok = false;
+    Execute([&] { ok = _shard.Remove(user_id); });
+    return ok;
+}
+
+size_t NumaGalleryShard::Size() const
+{
+    size_t size = 0;
+    Execute([&] { size = _shard.Size(); });
+    return size;
+}
+
+bool NumaGalleryShard::Search(const Faceprints& query, size_t k, std::vector<ShardCandidate>& candidates) const
+{
+    bool ok = false;
+    Execute([&] { ok = _shard.Search(query, k, candidates); });
+    return ok;
+}
+
+bool NumaGalleryShard::Export(std::vector<ExtendedFaceprints>& users) const
+{
+    bool ok = false;
+    Execute([&] { ok = _shard.Export(users); });
+    return ok;
+}
+
+void NumaGalleryShard::Execute(const std::function<void()>& task) const
+{
+    Call call {&task, false};
+    std::unique_lock<std::mutex> lock {_mutex};
+    _calls.push_back(&call);
+    _work_cv.notify_one();
+    _done_cv.wait(lock, [&call] { return call.is_done; });
+}
+
+void NumaGalleryShard::WorkerLoop(std::vector<int> cpus)
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Matcher, "numa-shard");
+    bool is_pinned = !cpus.empty() && GalleryMemory::PinCurrentThread(cpus);
+    std::unique_lock<std::mutex> lock {_mutex};
+    _is_pinned = is_pinned;
+    _is_started = true;
+    _done_cv.notify_all();
+
+    while (true)
+    {
+        _work_cv.wait(lock, [this] { return _should_stop || !_calls.empty(); });
+        if (_calls.empty())
+        {
+            return;
+        }
+        Call* call = _calls.front();
+        _calls.pop_front();
+        lock.unlock();
+        (*call->task)();
+        lock.lock();
+        call->is_done = true;
+        _done_cv.notify_all();
+    }
+}
+} // namespace RealSenseID
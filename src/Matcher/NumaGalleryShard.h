@@ -0,0 +1,74 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "ShardedGallery.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * In process shard placed on one NUMA node.
+ * All calls run on a worker thread pinned to the node's cpus, so the shard's gallery is first touched (and placed) on
+ * the node and every scan of it reads local memory. Large galleries are huge page backed (see GalleryMemory).
+ * Create one or more shards per node (GalleryMemory::NumNodes()) and search them through ShardedGallery with a pool of
+ * at least as many threads as shards - the pool threads only wait for the shards' workers.
+ * If the node is unknown (or not on linux) the worker is not pinned and behaves as a LocalGalleryShard.
+ */
+class NumaGalleryShard : public GalleryShard
+{
+public:
+    explicit NumaGalleryShard(size_t node);
+    ~NumaGalleryShard() override;
+
+    NumaGalleryShard(const NumaGalleryShard&) = delete;
+    NumaGalleryShard& operator=(const NumaGalleryShard&) = delete;
+
+    size_t Node() const
+    {
+        return _node;
+    }
+
+    // true if the worker is pinned to the node's cpus.
+    bool IsPinned() const
+    {
+        return _is_pinned;
+    }
+
+    bool Enroll(const char* user_id, const Faceprints& faceprints) override;
+    bool Remove(const char* user_id) override;
+    size_t Size() const override;
+    bool Search(const Faceprints& query, size_t k, std::vector<ShardCandidate>& candidates) const override;
+    bool Export(std::vector<ExtendedFaceprints>& users) const override;
+
+private:
+    struct Call
+    {
+        const std::function<void()>* task;
+        bool is_done;
+    };
+
+    // run the task on the worker and wait for it.
+    void Execute(const std::function<void()>& task) const;
+    void WorkerLoop(std::vector<int> cpus);
+
+    LocalGalleryShard _shard; // accessed by the worker only
+    size_t _node;
+    bool _is_pinned = false;
+
+    mutable std::mutex _mutex;
+    mutable std::condition_variable _work_cv;
+    mutable std::condition_variable _done_cv;
+    mutable std::deque<Call*> _calls;
+    bool _should_stop = false;
+    bool _is_started = false;
+    std::thread _worker;
+};
+} // namespace RealSenseID
@@ -0,0 +1,625 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "OpenClMatchContext.h"
+
+#ifdef RSID_MATCHER_OPENCL
+
+#include "Matcher.h"
+#include "Logger.h"
+#include <algorithm>
+#include <functional>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "OpenClMatchContext";
+
+// rows scored by each work item before more work groups are added
+static const size_t s_minRowsPerWorkItem = 16;
+// work groups per compute unit, enough to hide the memory latency
+static const size_t s_groupsPerComputeUnit = 8;
+static const size_t s_maxWorkGroupSize = 64;
+
+// Device kernels. The grade is the same fixed point ncc as Matcher::CalculateGrade() (the division free variant),
+// so the scores are bit-exact with the cpu matcher. Rows are strided over the work items, each work group reduces
+// its work items to one result (or k candidates), the host reduces the work groups.
+// Candidates are compared by a 64 bit key: the grade in the high word and the inverted row in the low word, so the
+// largest key is the best score with the lowest row.
+static const char* s_kernelSource = R"CLC(
+inline uint rsid_msb(uint x)
+{
+    return (x == 0) ? 0 : 32 - clz(x);
+}
+
+inline uint rsid_divide(uint n, ulong recip)
+{
+    ulong high = (recip >> 32) * n + (((recip & 0xFFFFFFFFUL) * n) >> 32);
+    return (recip == 0) ? n : (uint)(high >> 32);
+}
+
+inline short rsid_grade(int corr, int norm1_msb, ulong norm1_recip, int norm2_msb, ulong norm2_recip)
+{
+    uint ucorr = (uint)max(corr, 0);
+    int msb = (int)rsid_msb(ucorr);
+    int max_corr_shift = 32 - msb;
+    uint shift1 = (uint)min(16 - max(msb - norm1_msb, 0), max_corr_shift);
+    uint shift2 = (uint)min(16 - max(msb - norm2_msb, 0), max_corr_shift);
+    uint similarity = rsid_divide(ucorr << shift1, norm1_recip) * rsid_divide(ucorr << shift2, norm2_recip);
+    int shift_back = (int)(shift1 + shift2) - 12;
+    return (short)((similarity >> max(shift_back, 0)) << max(-shift_back, 0));
+}
+
+inline int rsid_dot(__global const short* a, __global const short* b)
+{
+    int8 acc = (int8)(0);
+    for (int i = 0; i < RSID_VECTOR_LENGTH; i += 8)
+    {
+        acc += convert_int8(vload8(0, a + i)) * convert_int8(vload8(0, b + i));
+    }
+    return acc.s0 + acc.s1 + acc.s2 + acc.s3 + acc.s4 + acc.s5 + acc.s6 + acc.s7;
+}
+
+inline ulong rsid_key(short grade, uint row)
+{
+    return ((ulong)(ushort)grade << 32) | (ulong)(0xFFFFFFFFu - row);
+}
+
+__kernel void rsid_match(__global const short* avg_vectors, __global const short* norm_msbs,
+                         __global const ulong* norm_recips, uint num_rows, __global const short* queries,
+                         __global const short* query_msbs, __global const ulong* query_recips, int threshold,
+                         __global uint* first_above, __global ulong* best_keys, __local ulong* scratch)
+{
+    const uint q = get_global_id(1);
+    const uint lid = get_local_id(0);
+    __global const short* query = queries + (size_t)q * RSID_VECTOR_LENGTH;
+    const int query_msb = query_msbs[q];
+    const ulong query_recip = query_recips[q];
+
+    ulong best = 0;
+    for (uint row = get_global_id(0); row < num_rows; row += get_global_size(0))
+    {
+        int corr = rsid_dot(query, avg_vectors + (size_t)row * RSID_VECTOR_LENGTH);
+        short grade = rsid_grade(corr, query_msb, query_recip, norm_msbs[row], norm_recips[row]);
+        best = max(best, rsid_key(grade, row));
+
+        // later rows of this work item can not be the first above threshold
+        if (grade > threshold)
+        {
+            atomic_min(&first_above[q], row);
+            break;
+        }
+    }
+
+    scratch[lid] = best;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (uint stride = get_local_size(0) / 2; stride > 0; stride /= 2)
+    {
+        if (lid < stride)
+        {
+            scratch[lid] = max(scratch[lid], scratch[lid + stride]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0)
+    {
+        best_keys[(size_t)q * get_num_groups(0) + get_group_id(0)] = scratch[0];
+    }
+}
+
+inline void rsid_insert(ulong* top, uint k, ulong key)
+{
+    uint i = k - 1;
+    while (i > 0 && top[i - 1] < key)
+    {
+        top[i] = top[i - 1];
+        i--;
+    }
+    top[i] = key;
+}
+
+__kernel void rsid_topk(__global const short* avg_vectors, __global const short* norm_msbs,
+                        __global const ulong* norm_recips, uint num_rows, __global const short* queries,
+                        __global const short* query_msbs, __global const ulong* query_recips, uint k,
+                        __global ulong* top_keys, __local ulong* scratch)
+{
+    const uint q = get_global_id(1);
+    const uint lid = get_local_id(0);
+    __global const short* query = queries + (size_t)q * RSID_VECTOR_LENGTH;
+    const int query_msb = query_msbs[q];
+    const ulong query_recip = query_recips[q];
+
+    // sorted descending, 0 is an empty slot
+    ulong top[RSID_MAX_TOPK];
+    for (uint i = 0; i < k; i++)
+    {
+        top[i] = 0;
+    }
+
+    for (uint row = get_global_id(0); row < num_rows; row += get_global_size(0))
+    {
+        int corr = rsid_dot(query, avg_vectors + (size_t)row * RSID_VECTOR_LENGTH);
+        ulong key = rsid_key(rsid_grade(corr, query_msb, query_recip, norm_msbs[row], norm_recips[row]), row);
+        if (key > top[k - 1])
+        {
+            rsid_insert(top, k, key);
+        }
+    }
+
+    for (uint i = 0; i < k; i++)
+    {
+        scratch[lid * k + i] = top[i];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (lid == 0)
+    {
+        for (uint other = 1; other < get_local_size(0); other++)
+        {
+            for (uint i = 0; i < k; i++)
+            {
+                ulong key = scratch[other * k + i];
+                if (key <= top[k - 1])
+                {
+                    break;
+                }
+                rsid_insert(top, k, key);
+            }
+        }
+
+        __global ulong* group_keys = top_keys + ((size_t)q * get_num_groups(0) + get_group_id(0)) * k;
+        for (uint i = 0; i < k; i++)
+        {
+            group_keys[i] = top[i];
+        }
+    }
+}
+)CLC";
+
+static bool CheckCl(cl_int err, const char* what)
+{
+    if (err != CL_SUCCESS)
+    {
+        LOG_ERROR(LOG_TAG, "%s failed: %d", what, static_cast<int>(err));
+        return false;
+    }
+    return true;
+}
+
+// device buffer released when going out of scope
+class ClBuffer
+{
+public:
+    ClBuffer() = default;
+    ~ClBuffer()
+    {
+        if (_mem != nullptr)
+        {
+            clReleaseMemObject(_mem);
+        }
+    }
+
+    ClBuffer(const ClBuffer&) = delete;
+    ClBuffer& operator=(const ClBuffer&) = delete;
+
+    bool Create(cl_context context, cl_mem_flags flags, size_t size, const void* host_data)
+    {
+        cl_int err = CL_SUCCESS;
+        _mem = clCreateBuffer(context, flags, size, const_cast<void*>(host_data), &err);
+        return CheckCl(err, "clCreateBuffer");
+    }
+
+    cl_mem& Get()
+    {
+        return _mem;
+    }
+
+private:
+    cl_mem _mem = nullptr;
+};
+
+struct OpenClMatchContext::QueryBuffers
+{
+    ClBuffer vectors;
+    ClBuffer norm_msbs;
+    ClBuffer norm_recips;
+};
+
+static int RowFromKey(cl_ulong key)
+{
+    return static_cast<int>(0xFFFFFFFFu - static_cast<uint32_t>(key & 0xFFFFFFFFu));
+}
+
+static short ScoreFromKey(cl_ulong key)
+{
+    return static_cast<short>(static_cast<uint16_t>(key >> 32));
+}
+
+std::unique_ptr<OpenClMatchContext> OpenClMatchContext::Create()
+{
+    cl_uint num_platforms = 0;
+    if (clGetPlatformIDs(0, nullptr, &num_platforms) != CL_SUCCESS || num_platforms == 0)
+    {
+        LOG_DEBUG(LOG_TAG, "No OpenCL platform found");
+        return nullptr;
+    }
+    std::vector<cl_platform_id> platforms(num_platforms);
+    if (!CheckCl(clGetPlatformIDs(num_platforms, platforms.data(), nullptr), "clGetPlatformIDs"))
+    {
+        return nullptr;
+    }
+
+    // prefer a gpu, otherwise any device (e.g. a cpu runtime)
+    const cl_device_type device_types[] = {CL_DEVICE_TYPE_GPU, CL_DEVICE_TYPE_ALL};
+    for (cl_device_type device_type : device_types)
+    {
+        for (cl_platform_id platform : platforms)
+        {
+            cl_device_id device = nullptr;
+            cl_uint num_devices = 0;
+            if (clGetDeviceIDs(platform, device_type, 1, &device, &num_devices) != CL_SUCCESS || num_devices == 0)
+            {
+                continue;
+            }
+
+            std::unique_ptr<OpenClMatchContext> context(new OpenClMatchContext());
+            if (context->Init(device))
+            {
+                LOG_DEBUG(LOG_TAG, "Using OpenCL device %s", context->DeviceName().c_str());
+                return context;
+            }
+        }
+    }
+
+    LOG_DEBUG(LOG_TAG, "No usable OpenCL device found");
+    return nullptr;
+}
+
+bool OpenClMatchContext::Init(cl_device_id device)
+{
+    _device = device;
+
+    char name[256] = {0};
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name) - 1, name, nullptr);
+    _device_name = name;
+
+    cl_uint compute_units = 1;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(compute_units), &compute_units, nullptr);
+    _compute_units = std::max<size_t>(compute_units, 1);
+
+    cl_int err = CL_SUCCESS;
+    _context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+    if (!CheckCl(err, "clCreateContext"))
+    {
+        return false;
+    }
+
+    _queue = clCreateCommandQueue(_context, device, 0, &err);
+    if (!CheckCl(err, "clCreateCommandQueue"))
+    {
+        return false;
+    }
+
+    _program = clCreateProgramWithSource(_context, 1, &s_kernelSource, nullptr, &err);
+    if (!CheckCl(err, "clCreateProgramWithSource"))
+    {
+        return false;
+    }
+
+    const std::string options = "-D RSID_VECTOR_LENGTH=" + std::to_string(FaceprintsGallery::VectorLength) +
+                                " -D RSID_MAX_TOPK=" + std::to_string(MaxTopK);
+    err = clBuildProgram(_program, 1, &device, options.c_str(), nullptr, nullptr);
+    if (err != CL_SUCCESS)
+    {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(_program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+        std::string log(log_size, '\0');
+        clGetProgramBuildInfo(_program, device, CL_PROGRAM_BUILD_LOG, log_size, &log[0], nullptr);
+        LOG_ERROR(LOG_TAG, "Failed to build matcher kernels for %s: %s", _device_name.c_str(), log.c_str());
+        return false;
+    }
+
+    _match_kernel = clCreateKernel(_program, "rsid_match", &err);
+    if (!CheckCl(err, "clCreateKernel"))
+    {
+        return false;
+    }
+    _topk_kernel = clCreateKernel(_program, "rsid_topk", &err);
+    if (!CheckCl(err, "clCreateKernel"))
+    {
+        return false;
+    }
+
+    // the work group reduction needs a power of 2 work group size
+    size_t match_group_size = 1;
+    size_t topk_group_size = 1;
+    clGetKernelWorkGroupInfo(_match_kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &match_group_size,
+                             nullptr);
+    clGetKernelWorkGroupInfo(_topk_kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &topk_group_size,
+                             nullptr);
+    const size_t max_group_size = std::min(std::min(match_group_size, topk_group_size), s_maxWorkGroupSize);
+    _work_group_size = 1;
+    while (_work_group_size * 2 <= max_group_size)
+    {
+        _work_group_size *= 2;
+    }
+    return true;
+}
+
+OpenClMatchContext::~OpenClMatchContext()
+{
+    ReleaseGallery();
+    if (_match_kernel != nullptr)
+    {
+        clReleaseKernel(_match_kernel);
+    }
+    if (_topk_kernel != nullptr)
+    {
+        clReleaseKernel(_topk_kernel);
+    }
+    if (_program != nullptr)
+    {
+        clReleaseProgram(_program);
+    }
+    if (_queue != nullptr)
+    {
+        clReleaseCommandQueue(_queue);
+    }
+    if (_context != nullptr)
+    {
+        clReleaseContext(_context);
+    }
+}
+
+void OpenClMatchContext::ReleaseGallery()
+{
+    for (cl_mem* mem : {&_avg_vectors, &_avg_norm_msbs, &_avg_norm_recips})
+    {
+        if (*mem != nullptr)
+        {
+            clReleaseMemObject(*mem);
+            *mem = nullptr;
+        }
+    }
+    _num_rows = 0;
+}
+
+bool OpenClMatchContext::Upload(const FaceprintsGallery& gallery)
+{
+    ReleaseGallery();
+
+    const size_t num_rows = gallery.Size();
+    if (num_rows == 0)
+    {
+        return true;
+    }
+    if (num_rows >= 0xFFFFFFFFu)
+    {
+        LOG_ERROR(LOG_TAG, "Gallery too large for the device: %zu", num_rows);
+        return false;
+    }
+
+    const cl_mem_flags flags = CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
+    cl_int err = CL_SUCCESS;
+    _avg_vectors = clCreateBuffer(_context, flags, num_rows * FaceprintsGallery::VectorLength * sizeof(feature_t),
+                                  const_cast<feature_t*>(gallery.AvgVectorsData()), &err);
+    if (!CheckCl(err, "clCreateBuffer"))
+    {
+        ReleaseGallery();
+        return false;
+    }
+    _avg_norm_msbs = clCreateBuffer(_context, flags, num_rows * sizeof(short),
+                                    const_cast<short*>(gallery.AvgNormMsbsData()), &err);
+    if (!CheckCl(err, "clCreateBuffer"))
+    {
+        ReleaseGallery();
+        return false;
+    }
+    _avg_norm_recips = clCreateBuffer(_context, flags, num_rows * sizeof(cl_ulong),
+                                      const_cast<uint64_t*>(gallery.AvgNormRecipsData()), &err);
+    if (!CheckCl(err, "clCreateBuffer"))
+    {
+        ReleaseGallery();
+        return false;
+    }
+
+    _num_rows = num_rows;
+    LOG_DEBUG(LOG_TAG, "Uploaded %zu users to %s", _num_rows, _device_name.c_str());
+    return true;
+}
+
+size_t OpenClMatchContext::NumGroups() const
+{
+    const size_t rows_per_group = _work_group_size * s_minRowsPerWorkItem;
+    const size_t needed_groups = (_num_rows + rows_per_group - 1) / rows_per_group;
+    return std::max<size_t>(1, std::min(needed_groups, _compute_units * s_groupsPerComputeUnit));
+}
+
+bool OpenClMatchContext::UploadQueries(const Faceprints* queries, size_t num_queries, QueryBuffers& buffers)
+{
+    const size_t vec_length = FaceprintsGallery::VectorLength;
+    std::vector<feature_t> vectors(num_queries * vec_length);
+    std::vector<short> norm_msbs(num_queries);
+    std::vector<cl_ulong> norm_recips(num_queries);
+
+    for (size_t q = 0; q < num_queries; q++)
+    {
+        const feature_t* query = &queries[q].avgDescriptor[0];
+        std::copy(query, query + vec_length, vectors.begin() + q * vec_length);
+
+        uint32_t norm = 1;
+        Matcher::CalculateNorm(query, norm, norm_msbs[q]);
+        norm_recips[q] = Matcher::CalculateNormReciprocal(norm);
+    }
+
+    const cl_mem_flags flags = CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
+    return buffers.vectors.Create(_context, flags, vectors.size() * sizeof(feature_t), vectors.data()) &&
+           buffers.norm_msbs.Create(_context, flags, norm_msbs.size() * sizeof(short), norm_msbs.data()) &&
+           buffers.norm_recips.Create(_context, flags, norm_recips.size() * sizeof(cl_ulong), norm_recips.data());
+}
+
+bool OpenClMatchContext::SetGalleryArgs(cl_kernel kernel, QueryBuffers& buffers)
+{
+    const cl_uint num_rows = static_cast<cl_uint>(_num_rows);
+
+    cl_int err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &_avg_vectors);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &_avg_norm_msbs);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &_avg_norm_recips);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_uint), &num_rows);
+    err |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &buffers.vectors.Get());
+    err |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &buffers.norm_msbs.Get());
+    err |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &buffers.norm_recips.Get());
+    return CheckCl(err, "clSetKernelArg");
+}
+
+bool OpenClMatchContext::MatchBatch(const Faceprints* queries, size_t num_queries, short threshold,
+                                    std::vector<BatchMatch>& matches)
+{
+    matches.assign(num_queries, BatchMatch());
+    if (num_queries == 0 || _num_rows == 0)
+    {
+        return true;
+    }
+
+    QueryBuffers query_buffers;
+    if (!UploadQueries(queries, num_queries, query_buffers))
+    {
+        return false;
+    }
+
+    const size_t num_groups = NumGroups();
+    std::vector<cl_uint> first_above(num_queries, 0xFFFFFFFFu);
+    std::vector<cl_ulong> best_keys(num_queries * num_groups, 0);
+
+    ClBuffer first_above_buffer;
+    ClBuffer best_keys_buffer;
+    if (!first_above_buffer.Create(_context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                                   first_above.size() * sizeof(cl_uint), first_above.data()) ||
+        !best_keys_buffer.Create(_context, CL_MEM_WRITE_ONLY, best_keys.size() * sizeof(cl_ulong), nullptr))
+    {
+        return false;
+    }
+
+    const cl_int threshold_arg = threshold;
+    if (!SetGalleryArgs(_match_kernel, query_buffers))
+    {
+        return false;
+    }
+    cl_int err = clSetKernelArg(_match_kernel, 7, sizeof(cl_int), &threshold_arg);
+    err |= clSetKernelArg(_match_kernel, 8, sizeof(cl_mem), &first_above_buffer.Get());
+    err |= clSetKernelArg(_match_kernel, 9, sizeof(cl_mem), &best_keys_buffer.Get());
+    err |= clSetKernelArg(_match_kernel, 10, _work_group_size * sizeof(cl_ulong), nullptr);
+    if (!CheckCl(err, "clSetKernelArg"))
+    {
+        return false;
+    }
+
+    const size_t global_size[2] = {num_groups * _work_group_size, num_queries};
+    const size_t local_size[2] = {_work_group_size, 1};
+    if (!CheckCl(clEnqueueNDRangeKernel(_queue, _match_kernel, 2, nullptr, global_size, local_size, 0, nullptr,
+                                        nullptr),
+                 "clEnqueueNDRangeKernel") ||
+        !CheckCl(clEnqueueReadBuffer(_queue, first_above_buffer.Get(), CL_TRUE, 0,
+                                     first_above.size() * sizeof(cl_uint), first_above.data(), 0, nullptr, nullptr),
+                 "clEnqueueReadBuffer") ||
+        !CheckCl(clEnqueueReadBuffer(_queue, best_keys_buffer.Get(), CL_TRUE, 0, best_keys.size() * sizeof(cl_ulong),
+                                     best_keys.data(), 0, nullptr, nullptr),
+                 "clEnqueueReadBuffer"))
+    {
+        return false;
+    }
+
+    for (size_t q = 0; q < num_queries; q++)
+    {
+        auto& match = matches[q];
+        if (first_above[q] != 0xFFFFFFFFu)
+        {
+            match.first_above = static_cast<int>(first_above[q]);
+        }
+
+        auto group_keys = best_keys.begin() + q * num_groups;
+        cl_ulong best = *std::max_element(group_keys, group_keys + num_groups);
+        // a score of 0 is never a match (same as the cpu scan)
+        if (ScoreFromKey(best) > 0)
+        {
+            match.best_row = RowFromKey(best);
+            match.best_score = ScoreFromKey(best);
+        }
+    }
+    return true;
+}
+
+bool OpenClMatchContext::TopKBatch(const Faceprints* queries, size_t num_queries, size_t k,
+                                   std::vector<std::vector<Candidate>>& candidates)
+{
+    candidates.assign(num_queries, std::vector<Candidate>());
+    if (num_queries == 0 || _num_rows == 0 || k == 0)
+    {
+        return true;
+    }
+    if (k > MaxTopK)
+    {
+        LOG_ERROR(LOG_TAG, "Top-k on device supports k <= %zu", MaxTopK);
+        return false;
+    }
+
+    QueryBuffers query_buffers;
+    if (!UploadQueries(queries, num_queries, query_buffers))
+    {
+        return false;
+    }
+
+    const size_t num_groups = NumGroups();
+    std::vector<cl_ulong> top_keys(num_queries * num_groups * k, 0);
+    ClBuffer top_keys_buffer;
+    if (!top_keys_buffer.Create(_context, CL_MEM_WRITE_ONLY, top_keys.size() * sizeof(cl_ulong), nullptr))
+    {
+        return false;
+    }
+
+    const cl_uint k_arg = static_cast<cl_uint>(k);
+    if (!SetGalleryArgs(_topk_kernel, query_buffers))
+    {
+        return false;
+    }
+    cl_int err = clSetKernelArg(_topk_kernel, 7, sizeof(cl_uint), &k_arg);
+    err |= clSetKernelArg(_topk_kernel, 8, sizeof(cl_mem), &top_keys_buffer.Get());
+    err |= clSetKernelArg(_topk_kernel, 9, _work_group_size * k * sizeof(cl_ulong), nullptr);
+    if (!CheckCl(err, "clSetKernelArg"))
+    {
+        return false;
+    }
+
+    const size_t global_size[2] = {num_groups * _work_group_size, num_queries};
+    const size_t local_size[2] = {_work_group_size, 1};
+    if (!CheckCl(clEnqueueNDRangeKernel(_queue, _topk_kernel, 2, nullptr, global_size, local_size, 0, nullptr,
+                                        nullptr),
+                 "clEnqueueNDRangeKernel") ||
+        !CheckCl(clEnqueueReadBuffer(_queue, top_keys_buffer.Get(), CL_TRUE, 0, top_keys.size() * sizeof(cl_ulong),
+                                     top_keys.data(), 0, nullptr, nullptr),
+                 "clEnqueueReadBuffer"))
+    {
+        return false;
+    }
+
+    // merge the k candidates of all work groups
+    for (size_t q = 0; q < num_queries; q++)
+    {
+        auto group_keys = top_keys.begin() + q * num_groups * k;
+        std::vector<cl_ulong> keys(group_keys, group_keys + num_groups * k);
+        const size_t count = std::min(k, keys.size());
+        std::partial_sort(keys.begin(), keys.begin() + count, keys.end(), std::greater<cl_ulong>());
+
+        for (size_t i = 0; i < count && keys[i] != 0; i++)
+        {
+            Candidate candidate;
+            candidate.row = RowFromKey(keys[i]);
+            candidate.score = ScoreFromKey(keys[i]);
+            candidates[q].push_back(candidate);
+        }
+    }
+    return true;
+}
+} // namespace RealSenseID
+
+#endif // RSID_MATCHER_OPENCL
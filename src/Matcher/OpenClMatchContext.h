@@ -0,0 +1,107 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+// OpenCL backend of DeviceFaceprintsGallery - only compiled with RSID_MATCHER_OPENCL.
+#ifdef RSID_MATCHER_OPENCL
+
+#include "FaceprintsGallery.h"
+#include "RealSenseID/Faceprints.h"
+#include <cstddef>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 120
+#endif
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif // __APPLE__
+
+namespace RealSenseID
+{
+/**
+ * OpenCL device holding the avg vectors and cached norms of a gallery, running batched NCC scoring and top-k on the
+ * device. Grades are calculated with the same fixed point arithmetic as the cpu matcher (bit-exact).
+ * Not thread safe - DeviceFaceprintsGallery serializes the access.
+ */
+class OpenClMatchContext
+{
+public:
+    // largest k supported by TopKBatch()
+    static constexpr size_t MaxTopK = 16;
+
+    // result of MatchBatch() for one query
+    struct BatchMatch
+    {
+        int first_above = -1; // first gallery row scoring above the threshold
+        int best_row = -1;    // row with the best score, lowest row on equal scores (-1 if all scores are 0)
+        short best_score = 0;
+    };
+
+    // device candidate of TopKBatch()
+    struct Candidate
+    {
+        int row = -1;
+        short score = 0;
+    };
+
+    // first gpu found (otherwise any OpenCL device), nullptr if none could be initialized.
+    static std::unique_ptr<OpenClMatchContext> Create();
+
+    ~OpenClMatchContext();
+
+    OpenClMatchContext(const OpenClMatchContext&) = delete;
+    OpenClMatchContext& operator=(const OpenClMatchContext&) = delete;
+
+    const std::string& DeviceName() const
+    {
+        return _device_name;
+    }
+
+    // copy the avg vectors and cached norms of the gallery to the device (replaces the previous gallery).
+    bool Upload(const FaceprintsGallery& gallery);
+
+    // score the queries against all uploaded rows. Queries must be range validated and the uploaded gallery must be
+    // validated for their version.
+    bool MatchBatch(const Faceprints* queries, size_t num_queries, short threshold, std::vector<BatchMatch>& matches);
+
+    // k best rows per query (descending score, ascending row on equal scores), k <= MaxTopK.
+    bool TopKBatch(const Faceprints* queries, size_t num_queries, size_t k,
+                   std::vector<std::vector<Candidate>>& candidates);
+
+private:
+    // queries uploaded for one call
+    struct QueryBuffers;
+
+    OpenClMatchContext() = default;
+
+    bool Init(cl_device_id device);
+    void ReleaseGallery();
+    size_t NumGroups() const;
+    bool UploadQueries(const Faceprints* queries, size_t num_queries, QueryBuffers& buffers);
+    bool SetGalleryArgs(cl_kernel kernel, QueryBuffers& buffers);
+
+    std::string _device_name;
+    cl_device_id _device = nullptr;
+    cl_context _context = nullptr;
+    cl_command_queue _queue = nullptr;
+    cl_program _program = nullptr;
+    cl_kernel _match_kernel = nullptr;
+    cl_kernel _topk_kernel = nullptr;
+    size_t _work_group_size = 1;
+    size_t _compute_units = 1;
+
+    cl_mem _avg_vectors = nullptr;
+    cl_mem _avg_norm_msbs = nullptr;
+    cl_mem _avg_norm_recips = nullptr;
+    size_t _num_rows = 0;
+};
+} // namespace RealSenseID
+
+#endif // RSID_MATCHER_OPENCL
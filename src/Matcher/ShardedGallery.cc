@@ -0,0 +1,303 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "ShardedGallery.h"
+#include "MatcherThreadPool.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "ShardedGallery";
+
+// FNV-1a, the placement must be the same on all nodes and platforms.
+static uint64_t HashString(const char* str, size_t max_length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < max_length && str[i] != '\0'; i++)
+    {
+        hash ^= static_cast<unsigned char>(str[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer - spreads the combined hash so the rendezvous weights are independent per shard.
+static uint64_t MixHash(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+bool IsBetterShardCandidate(const ShardCandidate& lhs, const ShardCandidate& rhs)
+{
+    if (lhs.score != rhs.score)
+    {
+        return lhs.score > rhs.score;
+    }
+    return ::strncmp(lhs.user_id, rhs.user_id, sizeof(lhs.user_id)) < 0;
+}
+
+bool LocalGalleryShard::Enroll(const char* user_id, const Faceprints& faceprints)
+{
+    if (user_id == nullptr)
+    {
+        return false;
+    }
+    int index = _gallery.Find(user_id);
+    if (index >= 0)
+    {
+        return _gallery.Update(static_cast<size_t>(index), faceprints);
+    }
+    _gallery.Add(user_id, faceprints);
+    return true;
+}
+
+bool LocalGalleryShard::Remove(const char* user_id)
+{
+    int index = _gallery.Find(user_id);
+    return index >= 0 && _gallery.Remove(static_cast<size_t>(index));
+}
+
+size_t LocalGalleryShard::Size() const
+{
+    return _gallery.Size();
+}
+
+bool LocalGalleryShard::Search(const Faceprints& query, size_t k, std::vector<ShardCandidate>& candidates) const
+{
+    candidates.clear();
+    if (k == 0 || _gallery.Empty())
+    {
+        return true;
+    }
+
+    std::vector<match_calc_t> scores;
+    if (!Matcher::ScoreGallery(query, _gallery, scores))
+    {
+        return false;
+    }
+
+    // select by (score, user id), the gallery order does not matter
+    std::vector<uint32_t> rows(scores.size());
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        rows[i] = static_cast<uint32_t>(i);
+    }
+    auto is_better = [&](uint32_t lhs, uint32_t rhs) {
+        if (scores[lhs] != scores[rhs])
+        {
+            return scores[lhs] > scores[rhs];
+        }
+        return ::strncmp(_gallery.UserId(lhs), _gallery.UserId(rhs), FaceprintsGallery::MaxUserIdLength) < 0;
+    };
+    const size_t count = std::min(k, rows.size());
+    std::partial_sort(rows.begin(), rows.begin() + count, rows.end(), is_better);
+
+    candidates.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& candidate = candidates[i];
+        ::strncpy(candidate.user_id, _gallery.UserId(rows[i]), sizeof(candidate.user_id) - 1);
+        candidate.score = scores[rows[i]];
+        _gallery.GetFaceprints(rows[i], candidate.faceprints);
+    }
+    return true;
+}
+
+bool LocalGalleryShard::Export(std::vector<ExtendedFaceprints>& users) const
+{
+    users.resize(_gallery.Size());
+    for (size_t i = 0; i < users.size(); i++)
+    {
+        ::memset(users[i].user_id, 0, sizeof(users[i].user_id));
+        ::strncpy(users[i].user_id, _gallery.UserId(i), sizeof(users[i].user_id) - 1);
+        _gallery.GetFaceprints(i, users[i].faceprints);
+    }
+    return true;
+}
+
+size_t ShardedGallery::OwnerOf(const char* user_id, const std::vector<ShardEntry>& shards) const
+{
+    // rendezvous hashing: the shard with the highest weight owns the user
+    const uint64_t user_hash = HashString(user_id, FaceprintsGallery::MaxUserIdLength);
+    size_t owner = shards.size();
+    uint64_t best_weight = 0;
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        uint64_t weight = MixHash(user_hash ^ shards[i].name_hash);
+        if (owner == shards.size() || weight > best_weight)
+        {
+            owner = i;
+            best_weight = weight;
+        }
+    }
+    return owner;
+}
+
+size_t ShardedGallery::ShardOf(const char* user_id) const
+{
+    return (user_id == nullptr) ? _shards.size() : OwnerOf(user_id, _shards);
+}
+
+bool ShardedGallery::AddShard(const std::string& name, std::shared_ptr<GalleryShard> shard)
+{
+    if (shard == nullptr)
+    {
+        return false;
+    }
+    for (auto& entry : _shards)
+    {
+        if (entry.name == name)
+        {
+            LOG_ERROR(LOG_TAG, "Shard %s already exists", name.c_str());
+            return false;
+        }
+    }
+
+    _shards.push_back({name, MixHash(HashString(name.c_str(), name.size())), shard});
+    const size_t new_index = _shards.size() - 1;
+
+    // only users now owned by the new shard move
+    for (size_t i = 0; i < new_index; i++)
+    {
+        std::vector<ExtendedFaceprints> users;
+        if (!_shards[i].shard->Export(users))
+        {
+            LOG_ERROR(LOG_TAG, "Failed to export shard %s", _shards[i].name.c_str());
+            return false;
+        }
+        for (auto& user : users)
+        {
+            if (OwnerOf(user.user_id, _shards) != new_index)
+            {
+                continue;
+            }
+            if (!shard->Enroll(user.user_id, user.faceprints) || !_shards[i].shard->Remove(user.user_id))
+            {
+                LOG_ERROR(LOG_TAG, "Failed to move user to shard %s", name.c_str());
+                return false;
+            }
+        }
+    }
+    LOG_DEBUG(LOG_TAG, "Added shard %s (%zu users)", name.c_str(), shard->Size());
+    return true;
+}
+
+bool ShardedGallery::RemoveShard(const std::string& name)
+{
+    auto it = std::find_if(_shards.begin(), _shards.end(), [&](const ShardEntry& entry) { return entry.name == name; });
+    if (it == _shards.end())
+    {
+        return false;
+    }
+
+    std::vector<ExtendedFaceprints> users;
+    if (!it->shard->Export(users))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to export shard %s", name.c_str());
+        return false;
+    }
+    if (!users.empty() && _shards.size() == 1)
+    {
+        LOG_ERROR(LOG_TAG, "Can't remove the last shard while it holds users");
+        return false;
+    }
+
+    std::shared_ptr<GalleryShard> removed = it->shard;
+    std::vector<ShardEntry> remaining;
+    for (auto& entry : _shards)
+    {
+        if (entry.name != name)
+        {
+            remaining.push_back(entry);
+        }
+    }
+
+    for (auto& user : users)
+    {
+        auto& owner = remaining[OwnerOf(user.user_id, remaining)];
+        if (!owner.shard->Enroll(user.user_id, user.faceprints))
+        {
+            LOG_ERROR(LOG_TAG, "Failed to move user to shard %s", owner.name.c_str());
+            return false;
+        }
+        removed->Remove(user.user_id);
+    }
+
+    _shards.swap(remaining);
+    LOG_DEBUG(LOG_TAG, "Removed shard %s (%zu users moved)", name.c_str(), users.size());
+    return true;
+}
+
+bool ShardedGallery::Enroll(const char* user_id, const Faceprints& faceprints)
+{
+    size_t owner = ShardOf(user_id);
+    if (owner >= _shards.size())
+    {
+        LOG_ERROR(LOG_TAG, "No shard for user");
+        return false;
+    }
+    return _shards[owner].shard->Enroll(user_id, faceprints);
+}
+
+bool ShardedGallery::Remove(const char* user_id)
+{
+    size_t owner = ShardOf(user_id);
+    return owner < _shards.size() && _shards[owner].shard->Remove(user_id);
+}
+
+size_t ShardedGallery::Size() const
+{
+    size_t size = 0;
+    for (auto& entry : _shards)
+    {
+        size += entry.shard->Size();
+    }
+    return size;
+}
+
+bool ShardedGallery::Search(const Faceprints& query, size_t k, std::vector<ShardCandidate>& candidates,
+                            MatcherThreadPool* pool) const
+{
+    candidates.clear();
+
+    // scatter
+    std::vector<std::vector<ShardCandidate>> shard_candidates(_shards.size());
+    std::vector<char> success(_shards.size(), 0);
+    auto search_shard = [&](size_t i) {
+        success[i] = _shards[i].shard->Search(query, k, shard_candidates[i]) ? 1 : 0;
+    };
+    if (pool != nullptr)
+    {
+        pool->Run(_shards.size(), search_shard);
+    }
+    else
+    {
+        for (size_t i = 0; i < _shards.size(); i++)
+        {
+            search_shard(i);
+        }
+    }
+
+    // gather - the top-k of the union is within the union of the per shard top-k
+    for (size_t i = 0; i < _shards.size(); i++)
+    {
+        if (!success[i])
+        {
+            LOG_ERROR(LOG_TAG, "Search failed on shard %s", _shards[i].name.c_str());
+            candidates.clear();
+            return false;
+        }
+        candidates.insert(candidates.end(), shard_candidates[i].begin(), shard_candidates[i].end());
+    }
+
+    const size_t count = std::min(k, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), IsBetterShardCandidate);
+    candidates.resize(count);
+    return true;
+}
+} // namespace RealSenseID
@@ -0,0 +1,136 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "Matcher.h"
+#include "FaceprintsGallery.h"
+#include "ExtendedFaceprints.h"
+#include "RealSenseID/Faceprints.h"
+#include <cstddef>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+class MatcherThreadPool;
+
+// search result of a shard
+struct ShardCandidate
+{
+    char user_id[FaceprintsGallery::MaxUserIdLength] = {0};
+    match_calc_t score = 0;
+    Faceprints faceprints; // stored faceprints of the user (needed for the update of a match)
+};
+
+/**
+ * One partition of a sharded gallery.
+ * LocalGalleryShard keeps the users in process. Shards on other processes/nodes implement this interface over the
+ * transport of the deployment (the call semantics are the same).
+ */
+class GalleryShard
+{
+public:
+    virtual ~GalleryShard() = default;
+
+    // add the user or replace its faceprints.
+    virtual bool Enroll(const char* user_id, const Faceprints& faceprints) = 0;
+
+    // returns false if the user is not in the shard.
+    virtual bool Remove(const char* user_id) = 0;
+
+    virtual size_t Size() const = 0;
+
+    // exhaustive top-k of the shard - descending score, ascending user id on equal scores.
+    // returns false if the query or the shard failed validation.
+    virtual bool Search(const Faceprints& query, size_t k, std::vector<ShardCandidate>& candidates) const = 0;
+
+    // all users of the shard (used for rebalancing).
+    virtual bool Export(std::vector<ExtendedFaceprints>& users) const = 0;
+};
+
+// in process shard over a packed gallery, scored with Matcher::ScoreGallery().
+class LocalGalleryShard : public GalleryShard
+{
+public:
+    bool Enroll(const char* user_id, const Faceprints& faceprints) override;
+    bool Remove(const char* user_id) override;
+    size_t Size() const override;
+    bool Search(const Faceprints& query, size_t k, std::vector<ShardCandidate>& candidates) const override;
+    bool Export(std::vector<ExtendedFaceprints>& users) const override;
+
+    const FaceprintsGallery& Gallery() const
+    {
+        return _gallery;
+    }
+
+private:
+    FaceprintsGallery _gallery;
+};
+
+/**
+ * Gallery partitioned by user id hash across shards (processes/nodes).
+ * Users are placed by rendezvous hashing of (shard name, user id), so adding or removing a shard only moves the users
+ * whose owner changes. Search() scatters the query to all shards and merges their top-k, the merged result is the
+ * same as the exhaustive top-k of a single gallery holding all users (equal scores by ascending user id).
+ * Not thread safe for changes - same as FaceprintsGallery, searches may run concurrently.
+ */
+class ShardedGallery
+{
+public:
+    // add a shard and move the users it now owns from the other shards. the name must be unique and stable, it is
+    // part of the placement hash. returns false if the name is taken or moving the users failed.
+    bool AddShard(const std::string& name, std::shared_ptr<GalleryShard> shard);
+
+    // remove a shard and move its users to the remaining shards. returns false if not found, moving failed, or it
+    // is the last shard and holds users.
+    bool RemoveShard(const std::string& name);
+
+    size_t NumShards() const
+    {
+        return _shards.size();
+    }
+
+    const std::string& ShardName(size_t index) const
+    {
+        return _shards[index].name;
+    }
+
+    const GalleryShard& Shard(size_t index) const
+    {
+        return *_shards[index].shard;
+    }
+
+    // index of the shard owning the user id (NumShards() if there are no shards).
+    size_t ShardOf(const char* user_id) const;
+
+    // add or replace the user on its shard.
+    bool Enroll(const char* user_id, const Faceprints& faceprints);
+
+    bool Remove(const char* user_id);
+
+    // total number of users.
+    size_t Size() const;
+
+    // scatter-gather top-k over all shards (in parallel on the pool if given). returns false if any shard failed.
+    bool Search(const Faceprints& query, size_t k, std::vector<ShardCandidate>& candidates,
+                MatcherThreadPool* pool = nullptr) const;
+
+private:
+    struct ShardEntry
+    {
+        std::string name;
+        uint64_t name_hash;
+        std::shared_ptr<GalleryShard> shard;
+    };
+
+    size_t OwnerOf(const char* user_id, const std::vector<ShardEntry>& shards) const;
+
+    std::vector<ShardEntry> _shards;
+};
+
+// candidate order of the sharded search: descending score, ascending user id.
+bool IsBetterShardCandidate(const ShardCandidate& lhs, const ShardCandidate& rhs);
+} // namespace RealSenseID
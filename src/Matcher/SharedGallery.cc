@@ -0,0 +1,234 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "SharedGallery.h"
+#include "Logger.h"
+#ifdef RSID_SECURE
+#include "EncryptedGalleryFile.h"
+#endif // RSID_SECURE
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "SharedGallery";
+
+SharedGalleryWriter::~SharedGalleryWriter()
+{
+    Release();
+}
+
+bool SharedGalleryWriter::Acquire(const std::string& path)
+{
+    Release();
+    const std::string lock_path = path + ".lock";
+
+#ifdef _WIN32
+    // no sharing: the open fails while another process holds the lock file
+    HANDLE lock = ::CreateFileA(lock_path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (lock == INVALID_HANDLE_VALUE)
+    {
+        LOG_ERROR(LOG_TAG, "Gallery %s has another writer", path.c_str());
+        return false;
+    }
+    _lock_handle = lock;
+#else
+    int fd = ::open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to open lock file %s", lock_path.c_str());
+        return false;
+    }
+    // released by the os if the writer dies
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        LOG_ERROR(LOG_TAG, "Gallery %s has another writer", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    _lock_fd = fd;
+#endif // _WIN32
+
+    _path = path;
+    _generation = 0;
+#ifdef RSID_SECURE
+    _published.Close();
+    if (_encrypted)
+    {
+        EncryptedGalleryFile::ReadGeneration(path, _generation);
+    }
+    else
+#endif // RSID_SECURE
+    {
+        MappedFaceprintsGallery::ReadGeneration(path, _generation);
+    }
+    LOG_DEBUG(LOG_TAG, "Writer of %s from generation %u", path.c_str(), _generation);
+    return true;
+}
+
+void SharedGalleryWriter::Release()
+{
+#ifdef _WIN32
+    if (_lock_handle != nullptr)
+    {
+        ::CloseHandle(_lock_handle);
+        _lock_handle = nullptr;
+    }
+#else
+    if (_lock_fd >= 0)
+    {
+        ::close(_lock_fd);
+        _lock_fd = -1;
+    }
+#endif // _WIN32
+    _path.clear();
+}
+
+bool SharedGalleryWriter::IsWriter() const
+{
+#ifdef _WIN32
+    return _lock_handle != nullptr;
+#else
+    return _lock_fd >= 0;
+#endif // _WIN32
+}
+
+#ifdef RSID_SECURE
+void SharedGalleryWriter::SetEncryption(const unsigned char* key, MatcherThreadPool* pool)
+{
+    static_assert(sizeof(_key) == EncryptedGalleryFile::KeySize, "gallery key size");
+    _encrypted = key != nullptr;
+    _key.fill(0);
+    if (key != nullptr)
+    {
+        std::copy(key, key + _key.size(), _key.begin());
+    }
+    _encryption_pool = pool;
+    _published.Close();
+}
+#endif // RSID_SECURE
+
+bool SharedGalleryWriter::Publish(const FaceprintsGallery& gallery)
+{
+    if (!IsWriter())
+    {
+        LOG_ERROR(LOG_TAG, "Publish without acquiring the gallery");
+        return false;
+    }
+    // generation 0 is a file that was never published
+    uint32_t generation = _generation + 1 == 0 ? 1 : _generation + 1;
+#ifdef RSID_SECURE
+    if (_encrypted)
+    {
+        if (!EncryptedGalleryFile::Save(gallery, _path, _key.data(), generation, _encryption_pool, &_published))
+        {
+            _published.Close();
+            return false;
+        }
+        MappedFaceprintsGallery::Image image;
+        MappedFaceprintsGallery::BuildImage(gallery, generation, image);
+        _published.OpenImage(std::move(image), _path);
+    }
+    else
+#endif // RSID_SECURE
+    if (!MappedFaceprintsGallery::Save(gallery, _path, generation))
+    {
+        return false;
+    }
+    _generation = generation;
+    LOG_DEBUG(LOG_TAG, "Published generation %u of %s (%zu users)", generation, _path.c_str(), gallery.Size());
+    return true;
+}
+
+void SharedGalleryReader::SetWarmUp(MatcherThreadPool* pool, bool lock_pages)
+{
+    std::lock_guard<std::mutex> lock {_refresh_mutex};
+    _warm_up_pool = pool;
+    _warm_up_lock = lock_pages;
+}
+
+#ifdef RSID_SECURE
+void SharedGalleryReader::SetEncryption(const unsigned char* key)
+{
+    std::lock_guard<std::mutex> lock {_refresh_mutex};
+    _encrypted = key != nullptr;
+    _key.fill(0);
+    if (key != nullptr)
+    {
+        std::copy(key, key + _key.size(), _key.begin());
+    }
+}
+#endif // RSID_SECURE
+
+bool SharedGalleryReader::Open(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock {_refresh_mutex};
+    _path = path;
+    return Map();
+}
+
+bool SharedGalleryReader::Refresh()
+{
+    std::lock_guard<std::mutex> lock {_refresh_mutex};
+    if (_path.empty())
+    {
+        return false;
+    }
+    uint32_t generation = 0;
+    auto current = std::atomic_load(&_snapshot);
+#ifdef RSID_SECURE
+    bool has_generation = _encrypted ? EncryptedGalleryFile::ReadGeneration(_path, generation)
+                                     : MappedFaceprintsGallery::ReadGeneration(_path, generation);
+#else
+    bool has_generation = MappedFaceprintsGallery::ReadGeneration(_path, generation);
+#endif // RSID_SECURE
+    if (!has_generation || (current != nullptr && generation == current->Generation()))
+    {
+        return false;
+    }
+    return Map();
+}
+
+SharedGalleryReader::snapshot_ptr SharedGalleryReader::Snapshot() const
+{
+    return std::atomic_load(&_snapshot);
+}
+
+uint32_t SharedGalleryReader::Generation() const
+{
+    auto snapshot = Snapshot();
+    return snapshot != nullptr ? snapshot->Generation() : 0;
+}
+
+bool SharedGalleryReader::Map()
+{
+    auto gallery = std::make_shared<MappedFaceprintsGallery>();
+#ifdef RSID_SECURE
+    bool opened = _encrypted ? EncryptedGalleryFile::Open(_path, _key.data(), *gallery, _warm_up_pool)
+                             : gallery->Open(_path);
+#else
+    bool opened = gallery->Open(_path);
+#endif // RSID_SECURE
+    if (!opened)
+    {
+        return false;
+    }
+    LOG_DEBUG(LOG_TAG, "Mapped generation %u of %s", gallery->Generation(), _path.c_str());
+    if (_warm_up_pool != nullptr)
+    {
+        // published anyway if it could not be locked
+        gallery->WarmUp(*_warm_up_pool, _warm_up_lock);
+    }
+    std::atomic_store(&_snapshot, snapshot_ptr {std::move(gallery)});
+    return true;
+}
+} // namespace RealSenseID
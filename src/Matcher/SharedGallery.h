@@ -0,0 +1,130 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include "MappedFaceprintsGallery.h"
+#include <array>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+namespace RealSenseID
+{
+/**
+ * Single writer of a gallery file shared read-only by several worker processes (see SharedGalleryReader).
+ * The writer holds an exclusive lock on path + ".lock" for as long as it is acquired, so at most one process
+ * publishes. Each Publish() writes a complete gallery file aside and renames it over path with the next generation
+ * in its header, so readers never see a partial file and the files they still map stay intact.
+ */
+class SharedGalleryWriter
+{
+public:
+    SharedGalleryWriter() = default;
+    ~SharedGalleryWriter();
+
+    SharedGalleryWriter(const SharedGalleryWriter&) = delete;
+    SharedGalleryWriter& operator=(const SharedGalleryWriter&) = delete;
+
+    // become the writer of the gallery at path. generations continue from the file's, if there is one.
+    // returns false if another process is the writer.
+    bool Acquire(const std::string& path);
+    void Release();
+
+    bool IsWriter() const;
+
+#ifdef RSID_SECURE
+    // publish encrypted gallery files (see EncryptedGalleryFile) with the given EncryptedGalleryFile::KeySize bytes
+    // key, encrypted on the pool's threads (nullptr to encrypt on the calling thread). The writer keeps the plain
+    // image of the last published file, so the next Publish() encrypts only the segments that changed. call before
+    // Acquire().
+    void SetEncryption(const unsigned char* key, MatcherThreadPool* pool = nullptr);
+#endif // RSID_SECURE
+
+    // publish the gallery as the next generation. returns false if not the writer or the file could not be written.
+    bool Publish(const FaceprintsGallery& gallery);
+
+    // generation of the last published file
+    uint32_t Generation() const
+    {
+        return _generation;
+    }
+
+private:
+    std::string _path;
+    uint32_t _generation = 0;
+#ifdef RSID_SECURE
+    bool _encrypted = false;
+    std::array<unsigned char, 32> _key {};
+    MatcherThreadPool* _encryption_pool = nullptr;
+    MappedFaceprintsGallery _published; // plain image of the last published file
+#endif // RSID_SECURE
+#ifdef _WIN32
+    void* _lock_handle = nullptr;
+#else
+    int _lock_fd = -1;
+#endif // _WIN32
+};
+
+/**
+ * Worker side of a shared gallery file. The file is mapped shared and read-only, so all the workers match against
+ * the same page cache pages and nothing is copied (only the small per-user reciprocals of the norms are derived at
+ * mapping time, see MappedFaceprintsGallery).
+ * Refresh() reads only the header of the file at path and maps the new file if the writer published another
+ * generation. Matches in flight keep the snapshot they hold, the replaced file stays mapped until its last holder
+ * drops it.
+ * With SetWarmUp() each mapped file is warmed up (see MappedFaceprintsGallery::WarmUp()) before its snapshot is
+ * published, so the matches never run on a cold snapshot and IsReady() tells a restarted worker can take traffic.
+ */
+class SharedGalleryReader
+{
+public:
+    using snapshot_ptr = std::shared_ptr<const MappedFaceprintsGallery>;
+
+    // warm up the mapped files on the pool (nullptr, the default, to publish them cold), and lock them in memory if
+    // lock_pages is set. the pool must outlive the reader. call before Open().
+    void SetWarmUp(MatcherThreadPool* pool, bool lock_pages = false);
+
+#ifdef RSID_SECURE
+    // the published files are encrypted with the given EncryptedGalleryFile::KeySize bytes key. Each snapshot is
+    // decrypted into memory (on the warm up pool's threads, if set) instead of mapped, so it is not shared with the
+    // other workers. call before Open().
+    void SetEncryption(const unsigned char* key);
+#endif // RSID_SECURE
+
+    // a snapshot was published (warmed up if SetWarmUp() was called), e.g. for the health check of a load balancer
+    // while Open() runs on another thread.
+    bool IsReady() const
+    {
+        return Snapshot() != nullptr;
+    }
+
+    // map the current file at path. returns false if there is no valid gallery file.
+    bool Open(const std::string& path);
+
+    // map the published file if its generation changed. returns true if a new snapshot was mapped.
+    bool Refresh();
+
+    // current snapshot, nullptr before Open(). one atomic shared_ptr load.
+    snapshot_ptr Snapshot() const;
+
+    // generation of the current snapshot (0 before Open())
+    uint32_t Generation() const;
+
+private:
+    // map the file at _path, replaces the snapshot on success. _refresh_mutex must be held.
+    bool Map();
+
+    std::string _path;
+    snapshot_ptr _snapshot; // accessed with std::atomic_load/std::atomic_store only
+    std::mutex _refresh_mutex;
+    MatcherThreadPool* _warm_up_pool = nullptr;
+    bool _warm_up_lock = false;
+#ifdef RSID_SECURE
+    bool _encrypted = false;
+    std::array<unsigned char, 32> _key {};
+#endif // RSID_SECURE
+};
+} // namespace RealSenseID
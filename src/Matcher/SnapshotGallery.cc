@@ -0,0 +1,180 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "SnapshotGallery.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace RealSenseID
+{
+GallerySnapshot::GallerySnapshot(std::vector<segment_ptr> segments, uint64_t version) :
+    _segments {std::move(segments)}, _version {version}
+{
+    _offsets.reserve(_segments.size());
+    for (auto& segment : _segments)
+    {
+        _offsets.push_back(_size);
+        _size += segment->Size();
+    }
+}
+
+const char* GallerySnapshot::UserId(size_t index) const
+{
+    if (index >= _size)
+    {
+        return nullptr;
+    }
+    size_t segment, segment_index;
+    Locate(index, segment, segment_index);
+    return _segments[segment]->UserId(segment_index);
+}
+
+bool GallerySnapshot::GetFaceprints(size_t index, Faceprints& faceprints) const
+{
+    if (index >= _size)
+    {
+        return false;
+    }
+    size_t segment, segment_index;
+    Locate(index, segment, segment_index);
+    return _segments[segment]->GetFaceprints(segment_index, faceprints);
+}
+
+int GallerySnapshot::Find(const char* user_id) const
+{
+    for (size_t segment = 0; segment < _segments.size(); segment++)
+    {
+        int segment_index = _segments[segment]->Find(user_id);
+        if (segment_index >= 0)
+        {
+            return static_cast<int>(_offsets[segment] + segment_index);
+        }
+    }
+    return -1;
+}
+
+void GallerySnapshot::Locate(size_t index, size_t& segment, size_t& segment_index) const
+{
+    // last segment whose offset is <= index (segments are never empty)
+    auto it = std::upper_bound(_offsets.begin(), _offsets.end(), index);
+    segment = static_cast<size_t>(it - _offsets.begin()) - 1;
+    segment_index = index - _offsets[segment];
+}
+
+SnapshotGallery::SnapshotGallery(size_t segment_capacity) :
+    _segment_capacity {std::max<size_t>(segment_capacity, 1)},
+    _snapshot {std::make_shared<const GallerySnapshot>()}
+{
+}
+
+std::shared_ptr<const GallerySnapshot> SnapshotGallery::Snapshot() const
+{
+    return std::atomic_load(&_snapshot);
+}
+
+bool SnapshotGallery::Add(const char* user_id, const Faceprints& faceprints)
+{
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    auto snapshot = std::atomic_load(&_snapshot);
+
+    size_t segment, segment_index;
+    if (FindUser(*snapshot, user_id, segment, segment_index))
+    {
+        return false;
+    }
+
+    auto segments = snapshot->Segments();
+    if (segments.empty() || segments.back()->Size() >= _segment_capacity)
+    {
+        auto new_segment = std::make_shared<FaceprintsGallery>();
+        new_segment->Reserve(_segment_capacity);
+        new_segment->Add(user_id, faceprints);
+        segments.push_back(std::move(new_segment));
+    }
+    else
+    {
+        auto new_segment = std::make_shared<FaceprintsGallery>(*segments.back());
+        new_segment->Add(user_id, faceprints);
+        segments.back() = std::move(new_segment);
+    }
+
+    Publish(std::move(segments));
+    return true;
+}
+
+bool SnapshotGallery::Update(const char* user_id, const Faceprints& faceprints)
+{
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    auto snapshot = std::atomic_load(&_snapshot);
+
+    size_t segment, segment_index;
+    if (!FindUser(*snapshot, user_id, segment, segment_index))
+    {
+        return false;
+    }
+
+    auto segments = snapshot->Segments();
+    auto new_segment = std::make_shared<FaceprintsGallery>(*segments[segment]);
+    new_segment->Update(segment_index, faceprints);
+    segments[segment] = std::move(new_segment);
+
+    Publish(std::move(segments));
+    return true;
+}
+
+bool SnapshotGallery::Remove(const char* user_id)
+{
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    auto snapshot = std::atomic_load(&_snapshot);
+
+    size_t segment, segment_index;
+    if (!FindUser(*snapshot, user_id, segment, segment_index))
+    {
+        return false;
+    }
+
+    auto segments = snapshot->Segments();
+    if (segments[segment]->Size() == 1)
+    {
+        segments.erase(segments.begin() + segment);
+    }
+    else
+    {
+        auto new_segment = std::make_shared<FaceprintsGallery>(*segments[segment]);
+        new_segment->Remove(segment_index);
+        segments[segment] = std::move(new_segment);
+    }
+
+    Publish(std::move(segments));
+    return true;
+}
+
+void SnapshotGallery::Clear()
+{
+    std::lock_guard<std::mutex> lock {_writer_mutex};
+    Publish({});
+}
+
+bool SnapshotGallery::FindUser(const GallerySnapshot& snapshot, const char* user_id, size_t& segment,
+                               size_t& segment_index) const
+{
+    for (segment = 0; segment < snapshot.NumSegments(); segment++)
+    {
+        int index = snapshot.Segment(segment).Find(user_id);
+        if (index >= 0)
+        {
+            segment_index = static_cast<size_t>(index);
+            return true;
+        }
+    }
+    return false;
+}
+
+void SnapshotGallery::Publish(std::vector<GallerySnapshot::segment_ptr> segments)
+{
+    auto version = std::atomic_load(&_snapshot)->Version() + 1;
+    std::shared_ptr<const GallerySnapshot> snapshot = std::make_shared<GallerySnapshot>(std::move(segments), version);
+    std::atomic_store(&_snapshot, std::move(snapshot));
+}
+} // namespace RealSenseID
@@ -0,0 +1,125 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Immutable, versioned view of a SnapshotGallery. Users are kept in fixed capacity FaceprintsGallery segments that
+ * are shared between snapshots, so a snapshot stays valid (and unchanged) for as long as a matcher holds it.
+ * Indices are global (segment offset + index in segment) and are only meaningful within the same snapshot.
+ */
+class GallerySnapshot
+{
+public:
+    using segment_ptr = std::shared_ptr<const FaceprintsGallery>;
+
+    GallerySnapshot() = default;
+    GallerySnapshot(std::vector<segment_ptr> segments, uint64_t version);
+
+    size_t Size() const
+    {
+        return _size;
+    }
+
+    bool Empty() const
+    {
+        return _size == 0;
+    }
+
+    // number of writes published before this snapshot
+    uint64_t Version() const
+    {
+        return _version;
+    }
+
+    size_t NumSegments() const
+    {
+        return _segments.size();
+    }
+
+    const FaceprintsGallery& Segment(size_t segment) const
+    {
+        return *_segments[segment];
+    }
+
+    // shared segments, writers copy this list and replace only the segments they modify
+    const std::vector<segment_ptr>& Segments() const
+    {
+        return _segments;
+    }
+
+    // global index of the first user of the given segment
+    size_t SegmentOffset(size_t segment) const
+    {
+        return _offsets[segment];
+    }
+
+    // user id of the given global index or nullptr if out of range.
+    const char* UserId(size_t index) const;
+
+    // copy the faceprints of the given global index. returns false if index is out of range.
+    bool GetFaceprints(size_t index, Faceprints& faceprints) const;
+
+    // global index of the given user id or -1 if not found.
+    int Find(const char* user_id) const;
+
+    // segment and index in segment of the given global index (index must be in range).
+    void Locate(size_t index, size_t& segment, size_t& segment_index) const;
+
+private:
+    std::vector<segment_ptr> _segments;
+    std::vector<size_t> _offsets;
+    size_t _size = 0;
+    uint64_t _version = 0;
+};
+
+/**
+ * Gallery for concurrent matching while users are enrolled, updated and deleted.
+ * Readers take a snapshot (one atomic shared_ptr load) and match against it without ever waiting for writers.
+ * Writers are serialized, copy only the segment they change (copy-on-write) and publish the new snapshot atomically.
+ * Old snapshots are released when their last reader drops them.
+ * Users are addressed by user id since global indices change between snapshots.
+ */
+class SnapshotGallery
+{
+public:
+    static constexpr size_t DefaultSegmentCapacity = 4096;
+
+    explicit SnapshotGallery(size_t segment_capacity = DefaultSegmentCapacity);
+
+    SnapshotGallery(const SnapshotGallery&) = delete;
+    SnapshotGallery& operator=(const SnapshotGallery&) = delete;
+
+    // current snapshot, never null.
+    std::shared_ptr<const GallerySnapshot> Snapshot() const;
+
+    // add user. returns false if a user with the same id already exists.
+    bool Add(const char* user_id, const Faceprints& faceprints);
+
+    // replace faceprints of existing user (e.g. after should_update). returns false if user was not found.
+    bool Update(const char* user_id, const Faceprints& faceprints);
+
+    // remove user. returns false if user was not found.
+    bool Remove(const char* user_id);
+
+    void Clear();
+
+private:
+    // segment and index of the given user in the current snapshot, false if not found. writer lock must be held.
+    bool FindUser(const GallerySnapshot& snapshot, const char* user_id, size_t& segment, size_t& segment_index) const;
+    void Publish(std::vector<GallerySnapshot::segment_ptr> segments);
+
+    size_t _segment_capacity;
+    std::shared_ptr<const GallerySnapshot> _snapshot; // accessed with std::atomic_load/std::atomic_store only
+    std::mutex _writer_mutex;
+};
+} // namespace RealSenseID
@@ -0,0 +1,137 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "UserIdIndex.h"
+#include <utility>
+
+namespace RealSenseID
+{
+void UserIdIndex::Insert(size_t row, const char* user_id)
+{
+    if (!IsIndexed(user_id))
+    {
+        return;
+    }
+    // load factor at most 1/2
+    if ((_count + 1) * 2 > _slots.size())
+    {
+        Rehash(_slots.empty() ? MinSlots : _slots.size() * 2);
+    }
+    const uint32_t hash = Hash(user_id);
+    size_t slot = hash & _mask;
+    while (_slots[slot].row != EmptyRow)
+    {
+        slot = (slot + 1) & _mask;
+    }
+    _slots[slot].row = static_cast<uint32_t>(row);
+    _slots[slot].hash = hash;
+    _count++;
+}
+
+bool UserIdIndex::Erase(size_t row, const char* user_id)
+{
+    if (!IsIndexed(user_id) || _count == 0)
+    {
+        return false;
+    }
+    size_t hole = FindSlot(row, Hash(user_id));
+    if (hole == _slots.size())
+    {
+        return false;
+    }
+
+    // shift back the entries of the probe sequence after the hole that may move into it
+    _slots[hole] = Slot {};
+    for (size_t slot = (hole + 1) & _mask; _slots[slot].row != EmptyRow; slot = (slot + 1) & _mask)
+    {
+        size_t home = _slots[slot].hash & _mask;
+        // the entry may fill the hole if its home is not (cyclically) in (hole, slot]
+        bool home_after_hole = hole <= slot ? (hole < home && home <= slot) : (hole < home || home <= slot);
+        if (!home_after_hole)
+        {
+            _slots[hole] = _slots[slot];
+            _slots[slot] = Slot {};
+            hole = slot;
+        }
+    }
+    _count--;
+    return true;
+}
+
+bool UserIdIndex::Move(size_t from_row, size_t to_row, const char* user_id)
+{
+    if (!IsIndexed(user_id) || _count == 0)
+    {
+        return false;
+    }
+    size_t slot = FindSlot(from_row, Hash(user_id));
+    if (slot == _slots.size())
+    {
+        return false;
+    }
+    _slots[slot].row = static_cast<uint32_t>(to_row);
+    return true;
+}
+
+void UserIdIndex::Clear()
+{
+    _slots.clear();
+    _mask = 0;
+    _count = 0;
+}
+
+void UserIdIndex::Reserve(size_t count)
+{
+    size_t slot_count = MinSlots;
+    while (slot_count < count * 2)
+    {
+        slot_count *= 2;
+    }
+    if (slot_count > _slots.size())
+    {
+        Rehash(slot_count);
+    }
+}
+
+uint32_t UserIdIndex::Hash(const char* user_id) const
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < _max_length && user_id[i] != '\0'; i++)
+    {
+        hash ^= static_cast<unsigned char>(user_id[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+size_t UserIdIndex::FindSlot(size_t row, uint32_t hash) const
+{
+    for (size_t slot = hash & _mask; _slots[slot].row != EmptyRow; slot = (slot + 1) & _mask)
+    {
+        if (_slots[slot].row == row && _slots[slot].hash == hash)
+        {
+            return slot;
+        }
+    }
+    return _slots.size();
+}
+
+void UserIdIndex::Rehash(size_t slot_count)
+{
+    std::vector<Slot> old_slots(slot_count);
+    std::swap(old_slots, _slots);
+    _mask = slot_count - 1;
+    for (const auto& entry : old_slots)
+    {
+        if (entry.row != EmptyRow)
+        {
+            size_t slot = entry.hash & _mask;
+            while (_slots[slot].row != EmptyRow)
+            {
+                slot = (slot + 1) & _mask;
+            }
+            _slots[slot] = entry;
+        }
+    }
+}
+} // namespace RealSenseID
@@ -0,0 +1,101 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+namespace RealSenseID
+{
+/**
+ * Open addressing (linear probing) hash index from user id to the rows of a gallery, for constant time lookups by
+ * user id. Slots hold the row and the hash of its id, so the table grows without reading the ids again and most
+ * probes of other ids are rejected without comparing strings. Removal shifts the following slots back (no
+ * tombstones), so lookups stay short under any mix of adds and removes.
+ * The ids themselves stay in the gallery: Find() reads them through the given user_id_of(row) function.
+ * Rows of the same id are all kept, Find() returns the lowest one (the one a linear scan would find first).
+ * Empty ids are not indexed, the owner scans for them.
+ */
+class UserIdIndex
+{
+public:
+    // ids are compared over at most max_length chars (the size of the gallery's id buffer)
+    explicit UserIdIndex(size_t max_length) : _max_length {max_length}
+    {
+    }
+
+    static bool IsIndexed(const char* user_id)
+    {
+        return user_id != nullptr && user_id[0] != '\0';
+    }
+
+    // lowest row with the given id, -1 if none. user_id_of(row) returns the id of a row.
+    template <typename UserIdOf>
+    int Find(const char* user_id, const UserIdOf& user_id_of) const
+    {
+        if (!IsIndexed(user_id) || _count == 0)
+        {
+            return -1;
+        }
+        const uint32_t hash = Hash(user_id);
+        int found = -1;
+        for (size_t slot = hash & _mask; _slots[slot].row != EmptyRow; slot = (slot + 1) & _mask)
+        {
+            const auto& entry = _slots[slot];
+            if (entry.hash == hash && (found < 0 || entry.row < static_cast<uint32_t>(found)) &&
+                ::strncmp(user_id_of(entry.row), user_id, _max_length) == 0)
+            {
+                found = static_cast<int>(entry.row);
+            }
+        }
+        return found;
+    }
+
+    // index row under user_id (ignored if not IsIndexed()).
+    void Insert(size_t row, const char* user_id);
+
+    // drop row, indexed under user_id. returns false if not found.
+    bool Erase(size_t row, const char* user_id);
+
+    // row indexed under user_id is now to_row (e.g. the last row moved into a removed one). returns false if not
+    // found.
+    bool Move(size_t from_row, size_t to_row, const char* user_id);
+
+    void Clear();
+
+    // room for count ids without growing
+    void Reserve(size_t count);
+
+    size_t Size() const
+    {
+        return _count;
+    }
+
+private:
+    static constexpr uint32_t EmptyRow = UINT32_MAX;
+    static constexpr size_t MinSlots = 16;
+
+    struct Slot
+    {
+        uint32_t row = EmptyRow;
+        uint32_t hash = 0;
+    };
+
+    // FNV-1a over the id's chars (at most _max_length)
+    uint32_t Hash(const char* user_id) const;
+
+    // slot of the row indexed under hash, or _slots.size() if not found
+    size_t FindSlot(size_t row, uint32_t hash) const;
+
+    // reinsert all the entries into slot_count slots (power of 2)
+    void Rehash(size_t slot_count);
+
+    size_t _max_length;
+    std::vector<Slot> _slots;
+    size_t _mask = 0;
+    size_t _count = 0;
+};
+} // namespace RealSenseID
@@ -0,0 +1,451 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MetricsRecorder.h"
+#include "RealSenseID/Allocator.h"
+#include "Logger.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif // _WIN32
+
+namespace RealSenseID
+{
+namespace Metrics
+{
+static const char* const COUNTER_NAMES[] = {"packets_sent",
+                                            "packets_received",
+                                            "bytes_sent",
+                                            "bytes_received",
+                                            "recv_timeouts",
+                                            "crc_errors",
+                                            "recv_errors",
+                                            "packet_retries",
+                                            "sessions_started",
+                                            "sessions_reused",
+                                            "session_failures",
+                                            "reconnects",
+                                            "matches",
+                                            "preview_frames_captured",
+                                            "preview_frames_delivered",
+                                            "preview_frames_dropped",
+                                            "callback_events_dropped",
+                                            "packet_retransmits",
+                                            "link_ping_failures",
+                                            "link_reconnects",
+                                            "prewarms",
+                                            "prewarms_used",
+                                            "device_tier_matches",
+                                            "host_tier_fallbacks",
+                                            "coalesced_messages",
+                                            "inexact_matches"};
+static_assert(sizeof(COUNTER_NAMES) / sizeof(COUNTER_NAMES[0]) == CounterCount, "missing counter names");
+
+static const char* const LATENCY_NAMES[] = {"packet_transfer_us",
+                                            "request_reply_us",
+                                            "session_setup_us",
+                                            "enroll_us",
+                                            "authenticate_us",
+                                            "extract_faceprints_us",
+                                            "match_us",
+                                            "preview_delivery_us",
+                                            "device_wait_us",
+                                            "link_ping_us",
+                                            "clock_sync_rtt_us",
+                                            "wake_us"};
+static_assert(sizeof(LATENCY_NAMES) / sizeof(LATENCY_NAMES[0]) == LatencyCount, "missing latency names");
+
+static const char* const SUBSYSTEM_NAMES[] = {"protocol", "matcher", "preview", "wrappers"};
+static_assert(sizeof(SUBSYSTEM_NAMES) / sizeof(SUBSYSTEM_NAMES[0]) == SubsystemCount, "missing subsystem names");
+
+// Log-linear histogram (as HdrHistogram with 3 significant bits): values below 8us are exact, above that each power
+// of 2 is split into 8 buckets. Values are clamped to 2^32 us (~71 minutes).
+class Histogram
+{
+public:
+    static constexpr unsigned int SubBucketBits = 3;
+    static constexpr unsigned int SubBuckets = 1 << SubBucketBits;
+    static constexpr size_t Buckets = (32 - SubBucketBits + 1) * SubBuckets;
+
+    void Record(uint64_t value)
+    {
+        value = std::min<uint64_t>(value, UINT32_MAX);
+        _buckets[BucketOf(static_cast<uint32_t>(value))].fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(value, std::memory_order_relaxed);
+
+        auto min = _min.load(std::memory_order_relaxed);
+        while (value < min && !_min.compare_exchange_weak(min, value, std::memory_order_relaxed))
+        {
+        }
+        auto max = _max.load(std::memory_order_relaxed);
+        while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    LatencyStats Stats() const
+    {
+        uint64_t counts[Buckets];
+        LatencyStats stats;
+        for (size_t i = 0; i < Buckets; i++)
+        {
+            counts[i] = _buckets[i].load(std::memory_order_relaxed);
+            stats.count += counts[i];
+        }
+        if (stats.count == 0)
+        {
+            return stats;
+        }
+        stats.sumUs = _sum.load(std::memory_order_relaxed);
+        stats.minUs = _min.load(std::memory_order_relaxed);
+        stats.maxUs = _max.load(std::memory_order_relaxed);
+        stats.p50Us = Percentile(counts, stats, 500);
+        stats.p90Us = Percentile(counts, stats, 900);
+        stats.p99Us = Percentile(counts, stats, 990);
+        return stats;
+    }
+
+    void Reset()
+    {
+        for (auto& bucket : _buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        _sum.store(0, std::memory_order_relaxed);
+        _min.store(UINT64_MAX, std::memory_order_relaxed);
+        _max.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> _buckets[Buckets] = {};
+    std::atomic<uint64_t> _sum {0};
+    std::atomic<uint64_t> _min {UINT64_MAX};
+    std::atomic<uint64_t> _max {0};
+
+    static unsigned int HighestBit(uint32_t value)
+    {
+        unsigned int bit = 0;
+        while (value >>= 1)
+        {
+            bit++;
+        }
+        return bit;
+    }
+
+    static size_t BucketOf(uint32_t value)
+    {
+        if (value < SubBuckets)
+        {
+            return value;
+        }
+        auto shift = HighestBit(value) - SubBucketBits;
+        return (shift + 1) * SubBuckets + ((value >> shift) & (SubBuckets - 1));
+    }
+
+    // highest value of the bucket
+    static uint64_t BucketMax(size_t bucket)
+    {
+        if (bucket < SubBuckets)
+        {
+            return bucket;
+        }
+        auto shift = bucket / SubBuckets - 1;
+        uint64_t lowest = (SubBuckets + bucket % SubBuckets) << shift;
+        return lowest + (uint64_t {1} << shift) - 1;
+    }
+
+    static uint64_t Percentile(const uint64_t* counts, const LatencyStats& stats, uint64_t per_mille)
+    {
+        const uint64_t rank = std::max<uint64_t>(1, (stats.count * per_mille + 999) / 1000);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < Buckets; i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                return std::min(std::max(BucketMax(i), stats.minUs), stats.maxUs);
+            }
+        }
+        return stats.maxUs;
+    }
+};
+
+struct AllocationCounters
+{
+    std::atomic<uint64_t> allocations {0};
+    std::atomic<uint64_t> frees {0};
+    std::atomic<uint64_t> bytes_allocated {0};
+    std::atomic<uint64_t> bytes_freed {0};
+};
+
+struct Registry
+{
+    std::atomic<uint64_t> counters[CounterCount] = {};
+    Histogram latencies[LatencyCount];
+    MatchScoreHistogram match_scores;
+    AllocationCounters allocations[SubsystemCount];
+    std::atomic<int64_t> live_allocations {0}; // of the SDK allocator, never reset
+
+    static Registry& Instance()
+    {
+        static Registry instance;
+        return instance;
+    }
+};
+
+void Add(Counter counter, uint64_t value)
+{
+    Registry::Instance().counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+void Record(Latency latency, std::chrono::steady_clock::duration elapsed)
+{
+    auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    RecordUs(latency, elapsed_us > 0 ? static_cast<uint64_t>(elapsed_us) : 0);
+}
+
+void RecordUs(Latency latency, uint64_t elapsed_us)
+{
+    Registry::Instance().latencies[static_cast<size_t>(latency)].Record(elapsed_us);
+}
+
+static size_t ScoreBin(int score)
+{
+    const int bin = score / MatchScoreStats::ScoreBinWidth;
+    return static_cast<size_t>(std::min(std::max(bin, 0), static_cast<int>(MatchScoreStats::ScoreBins) - 1));
+}
+
+void MatchScoreHistogram::Record(const MatchScoreSample& sample)
+{
+    _matches.fetch_add(1, std::memory_order_relaxed);
+    if (sample.accepted)
+    {
+        _accepted.fetch_add(1, std::memory_order_relaxed);
+        if (sample.should_update)
+        {
+            _should_update.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    _best_scores[ScoreBin(sample.best_score)].fetch_add(1, std::memory_order_relaxed);
+    if (sample.runner_up_score >= 0)
+    {
+        _runner_up_scores[ScoreBin(sample.runner_up_score)].fetch_add(1, std::memory_order_relaxed);
+    }
+    const int confidence =
+        std::min(std::max(sample.confidence, 0), static_cast<int>(MatchScoreStats::ConfidenceBins) - 1);
+    _confidences[confidence].fetch_add(1, std::memory_order_relaxed);
+}
+
+MatchScoreStats MatchScoreHistogram::Stats() const
+{
+    MatchScoreStats stats;
+    stats.matches = _matches.load(std::memory_order_relaxed);
+    stats.accepted = _accepted.load(std::memory_order_relaxed);
+    stats.shouldUpdate = _should_update.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < MatchScoreStats::ScoreBins; i++)
+    {
+        stats.bestScores[i] = _best_scores[i].load(std::memory_order_relaxed);
+        stats.runnerUpScores[i] = _runner_up_scores[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < MatchScoreStats::ConfidenceBins; i++)
+    {
+        stats.confidences[i] = _confidences[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void MatchScoreHistogram::Reset()
+{
+    _matches.store(0, std::memory_order_relaxed);
+    _accepted.store(0, std::memory_order_relaxed);
+    _should_update.store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < MatchScoreStats::ScoreBins; i++)
+    {
+        _best_scores[i].store(0, std::memory_order_relaxed);
+        _runner_up_scores[i].store(0, std::memory_order_relaxed);
+    }
+    for (auto& confidence : _confidences)
+    {
+        confidence.store(0, std::memory_order_relaxed);
+    }
+}
+
+void RecordMatchScores(const MatchScoreSample& sample, MatchScoreHistogram* local)
+{
+    Registry::Instance().match_scores.Record(sample);
+    if (local != nullptr)
+    {
+        local->Record(sample);
+    }
+}
+
+void CountAllocation(Subsystem subsystem, size_t size)
+{
+    auto& counters = Registry::Instance().allocations[static_cast<size_t>(subsystem)];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+}
+
+void CountFree(Subsystem subsystem, size_t size)
+{
+    auto& counters = Registry::Instance().allocations[static_cast<size_t>(subsystem)];
+    counters.frees.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes_freed.fetch_add(size, std::memory_order_relaxed);
+}
+
+Snapshot GetSnapshot()
+{
+    auto& registry = Registry::Instance();
+    Snapshot snapshot;
+    for (size_t i = 0; i < CounterCount; i++)
+    {
+        snapshot.counters[i] = registry.counters[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < LatencyCount; i++)
+    {
+        snapshot.latencies[i] = registry.latencies[i].Stats();
+    }
+    snapshot.matchScores = registry.match_scores.Stats();
+    for (size_t i = 0; i < SubsystemCount; i++)
+    {
+        auto& stats = snapshot.allocations[i];
+        stats.allocations = registry.allocations[i].allocations.load(std::memory_order_relaxed);
+        stats.frees = registry.allocations[i].frees.load(std::memory_order_relaxed);
+        stats.bytesAllocated = registry.allocations[i].bytes_allocated.load(std::memory_order_relaxed);
+        stats.bytesFreed = registry.allocations[i].bytes_freed.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+void Reset()
+{
+    auto& registry = Registry::Instance();
+    for (auto& counter : registry.counters)
+    {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (auto& histogram : registry.latencies)
+    {
+        histogram.Reset();
+    }
+    registry.match_scores.Reset();
+    for (auto& counters : registry.allocations)
+    {
+        counters.allocations.store(0, std::memory_order_relaxed);
+        counters.frees.store(0, std::memory_order_relaxed);
+        counters.bytes_allocated.store(0, std::memory_order_relaxed);
+        counters.bytes_freed.store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* Name(Counter counter)
+{
+    auto index = static_cast<size_t>(counter);
+    return index < CounterCount ? COUNTER_NAMES[index] : "";
+}
+
+const char* Name(Latency latency)
+{
+    auto index = static_cast<size_t>(latency);
+    return index < LatencyCount ? LATENCY_NAMES[index] : "";
+}
+
+const char* Name(Subsystem subsystem)
+{
+    auto index = static_cast<size_t>(subsystem);
+    return index < SubsystemCount ? SUBSYSTEM_NAMES[index] : "";
+}
+} // namespace Metrics
+
+static const char* LOG_TAG = "Allocator";
+
+// the hooks of SetAllocator(), default if not set. only replaced while no allocation is live
+static AllocatorHooks s_allocator_hooks;
+static std::atomic<bool> s_custom_allocator {false};
+
+static bool IsOverAligned(size_t alignment)
+{
+    return alignment > alignof(std::max_align_t);
+}
+
+bool SetAllocator(const AllocatorHooks* hooks)
+{
+    if (hooks != nullptr && (hooks->allocate == nullptr || hooks->deallocate == nullptr))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid allocator hooks");
+        return false;
+    }
+    const int64_t live = Metrics::Registry::Instance().live_allocations.load();
+    if (live != 0)
+    {
+        LOG_ERROR(LOG_TAG, "Can't replace the allocator while %lld SDK allocations are live",
+                  static_cast<long long>(live));
+        return false;
+    }
+    s_custom_allocator.store(false);
+    s_allocator_hooks = hooks != nullptr ? *hooks : AllocatorHooks {};
+    s_custom_allocator.store(hooks != nullptr);
+    return true;
+}
+
+void* SdkAllocate(Metrics::Subsystem subsystem, size_t size, size_t alignment)
+{
+    void* p = nullptr;
+    if (s_custom_allocator.load(std::memory_order_acquire))
+    {
+        p = s_allocator_hooks.allocate(size, alignment, subsystem, s_allocator_hooks.ctx);
+    }
+    else if (!IsOverAligned(alignment))
+    {
+        p = std::malloc(size > 0 ? size : 1);
+    }
+    else
+    {
+#ifdef _WIN32
+        p = _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+        if (posix_memalign(&p, alignment, size > 0 ? size : 1) != 0)
+        {
+            p = nullptr;
+        }
+#endif // _WIN32
+    }
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    Metrics::Registry::Instance().live_allocations.fetch_add(1, std::memory_order_relaxed);
+    Metrics::CountAllocation(subsystem, size);
+    return p;
+}
+
+void SdkFree(Metrics::Subsystem subsystem, void* ptr, size_t size, size_t alignment) noexcept
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+    if (s_custom_allocator.load(std::memory_order_acquire))
+    {
+        s_allocator_hooks.deallocate(ptr, size, alignment, subsystem, s_allocator_hooks.ctx);
+    }
+    else if (!IsOverAligned(alignment))
+    {
+        std::free(ptr);
+    }
+    else
+    {
+#ifdef _WIN32
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif // _WIN32
+    }
+    Metrics::Registry::Instance().live_allocations.fetch_sub(1, std::memory_order_relaxed);
+    Metrics::CountFree(subsystem, size);
+}
+} // namespace RealSenseID
@@ -0,0 +1,82 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/Metrics.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Recording side of RealSenseID::Metrics. Lock free (relaxed atomics), safe to call from any thread.
+namespace RealSenseID
+{
+namespace Metrics
+{
+void Add(Counter counter, uint64_t value = 1);
+
+void Record(Latency latency, std::chrono::steady_clock::duration elapsed);
+void RecordUs(Latency latency, uint64_t elapsed_us);
+
+// one host match result (see MatchScoreStats), runner_up_score < 0 if the search scored no other user
+struct MatchScoreSample
+{
+    int best_score = 0;
+    int runner_up_score = -1;
+    int confidence = 0;
+    bool accepted = false;
+    bool should_update = false;
+};
+
+// match score histograms of one gallery or authenticator, a few relaxed increments per result
+class MatchScoreHistogram
+{
+public:
+    void Record(const MatchScoreSample& sample);
+    MatchScoreStats Stats() const;
+    void Reset();
+
+private:
+    std::atomic<uint64_t> _matches {0};
+    std::atomic<uint64_t> _accepted {0};
+    std::atomic<uint64_t> _should_update {0};
+    std::atomic<uint64_t> _best_scores[MatchScoreStats::ScoreBins] = {};
+    std::atomic<uint64_t> _runner_up_scores[MatchScoreStats::ScoreBins] = {};
+    std::atomic<uint64_t> _confidences[MatchScoreStats::ConfidenceBins] = {};
+};
+
+// record a match result into the process wide histograms, and into local if not nullptr
+void RecordMatchScores(const MatchScoreSample& sample, MatchScoreHistogram* local = nullptr);
+
+// count memory of a subsystem that is not allocated with the SDK allocator (e.g. huge pages), as SdkAllocate() and
+// SdkFree() count theirs
+void CountAllocation(Subsystem subsystem, size_t size);
+void CountFree(Subsystem subsystem, size_t size);
+
+// record the time from construction to destruction (if enabled)
+class ScopedLatency
+{
+public:
+    explicit ScopedLatency(Latency latency, bool enabled = true) :
+        _latency {latency}, _enabled {enabled}, _start {std::chrono::steady_clock::now()}
+    {
+    }
+
+    ~ScopedLatency()
+    {
+        if (_enabled)
+        {
+            Record(_latency, std::chrono::steady_clock::now() - _start);
+        }
+    }
+
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+private:
+    Latency _latency;
+    bool _enabled;
+    std::chrono::steady_clock::time_point _start;
+};
+} // namespace Metrics
+} // namespace RealSenseID
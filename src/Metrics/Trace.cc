@@ -0,0 +1,453 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "TraceRecorder.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace RealSenseID
+{
+namespace Trace
+{
+namespace
+{
+struct Event
+{
+    const char* name;
+    const char* category;
+    uint64_t start_us;
+    uint64_t duration_us;
+    int64_t value;
+    uint32_t thread_id;
+    bool has_value;
+    char phase; // 'X' complete, 'i' instant, 'F' frame mark, 'C' counter
+};
+
+// small sequential ids are easier to read in the viewers than hashed std::thread::id
+uint32_t ThreadId()
+{
+    static std::atomic<uint32_t> next_id {1};
+    thread_local uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+class Recorder
+{
+public:
+    static Recorder& Instance()
+    {
+        static Recorder instance;
+        return instance;
+    }
+
+    void Start(size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _events.assign(capacity > 0 ? capacity : 1, Event {});
+        _next = 0;
+        _size = 0;
+        _origin.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        _recording.store(true, std::memory_order_release);
+    }
+
+    void Stop()
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _recording.store(false, std::memory_order_release);
+    }
+
+    bool IsRecording() const
+    {
+        return _recording.load(std::memory_order_relaxed);
+    }
+
+    // 1 at the start of the recording, 0 is for "not recording"
+    uint64_t Now() const
+    {
+        if (!_recording.load(std::memory_order_acquire))
+        {
+            return 0;
+        }
+        auto origin = std::chrono::steady_clock::duration {_origin.load(std::memory_order_relaxed)};
+        auto elapsed = std::chrono::steady_clock::now().time_since_epoch() - origin;
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()) + 1;
+    }
+
+    void Add(const Event& event)
+    {
+        if (!IsRecording())
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (!_recording.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        _events[_next] = event;
+        _events[_next].thread_id = ThreadId();
+        _next = (_next + 1) % _events.size();
+        if (_size < _events.size())
+        {
+            _size++;
+        }
+    }
+
+    std::string ToChromeJson() const
+    {
+        std::ostringstream json;
+        json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+        std::lock_guard<std::mutex> lock {_mutex};
+        const size_t first = (_next + _events.size() - _size) % (_events.empty() ? 1 : _events.size());
+        for (size_t i = 0; i < _size; i++)
+        {
+            const auto& event = _events[(first + i) % _events.size()];
+            json << (i == 0 ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+                 << "\",\"pid\":1,\"tid\":" << event.thread_id << ",\"ts\":" << event.start_us - 1;
+            switch (event.phase)
+            {
+            case 'i':
+                json << ",\"ph\":\"i\",\"s\":\"t\"";
+                break;
+            case 'F':
+                json << ",\"ph\":\"i\",\"s\":\"g\"";
+                break;
+            case 'C':
+                json << ",\"ph\":\"C\"";
+                break;
+            default:
+                json << ",\"ph\":\"X\",\"dur\":" << event.duration_us;
+                break;
+            }
+            if (event.has_value)
+            {
+                json << ",\"args\":{\"value\":" << event.value << "}";
+            }
+            json << "}";
+        }
+        json << "\n]}\n";
+        return json.str();
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::atomic<bool> _recording {false};
+    std::vector<Event> _events;
+    size_t _next = 0; // slot of the next event
+    size_t _size = 0; // recorded events (up to the capacity)
+    std::atomic<std::chrono::steady_clock::rep> _origin {0}; // steady clock time of the start
+};
+
+#ifdef RSID_TRACE_HOOKS
+std::atomic<const Hooks*> s_hooks {nullptr};
+#endif // RSID_TRACE_HOOKS
+
+std::atomic<const SpanExporter*> s_exporter {nullptr};
+
+// trace context of the thread, its span id is the current span's within the library operations
+thread_local Context t_context;
+thread_local bool t_has_context = false;
+
+uint64_t UnixNs()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count());
+}
+
+void NewSpanId(uint8_t (&span_id)[8])
+{
+    thread_local std::mt19937_64 rng {std::random_device {}() ^ (static_cast<uint64_t>(ThreadId()) << 32)};
+    uint64_t id = 0;
+    while (id == 0) // all zero is invalid
+    {
+        id = rng();
+    }
+    ::memcpy(span_id, &id, sizeof(span_id));
+}
+
+void Export(const SpanExporter* exporter, const char* name, const char* category, const uint8_t (&span_id)[8],
+            const uint8_t (&parent_span_id)[8], uint64_t start_ns, uint64_t end_ns, int64_t value, bool has_value)
+{
+    Span span;
+    span.name = name;
+    span.category = category;
+    ::memcpy(span.traceId, t_context.traceId, sizeof(span.traceId));
+    ::memcpy(span.spanId, span_id, sizeof(span.spanId));
+    ::memcpy(span.parentSpanId, parent_span_id, sizeof(span.parentSpanId));
+    span.startUnixNs = start_ns;
+    span.endUnixNs = end_ns;
+    span.value = value;
+    span.hasValue = has_value;
+    exporter->exportSpan(exporter->context, &span);
+}
+
+// the exporter of the thread's spans, nullptr if none or the thread's context is not sampled
+const SpanExporter* ActiveExporter()
+{
+    if (!t_has_context || (t_context.flags & 1) == 0)
+    {
+        return nullptr;
+    }
+    auto* exporter = s_exporter.load(std::memory_order_acquire);
+    return exporter != nullptr && exporter->exportSpan != nullptr ? exporter : nullptr;
+}
+
+int HexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    return -1; // upper case is invalid in traceparent
+}
+
+bool ParseHex(const char* text, uint8_t* bytes, size_t size)
+{
+    bool all_zero = true;
+    for (size_t i = 0; i < size; i++)
+    {
+        int high = HexValue(text[2 * i]);
+        int low = HexValue(text[2 * i + 1]);
+        if (high < 0 || low < 0)
+        {
+            return false;
+        }
+        bytes[i] = static_cast<uint8_t>(high << 4 | low);
+        all_zero = all_zero && bytes[i] == 0;
+    }
+    return !all_zero;
+}
+} // namespace
+
+void BeginSpan(SpanState& span)
+{
+    span.exporter = ActiveExporter();
+    if (span.exporter == nullptr)
+    {
+        return;
+    }
+    ::memcpy(span.parent_span_id, t_context.spanId, sizeof(span.parent_span_id));
+    NewSpanId(span.span_id);
+    ::memcpy(t_context.spanId, span.span_id, sizeof(t_context.spanId));
+    span.start_unix_ns = UnixNs();
+}
+
+void EndSpan(const SpanState& span, const char* name, const char* category, int64_t value, bool has_value)
+{
+    Export(span.exporter, name, category, span.span_id, span.parent_span_id, span.start_unix_ns, UnixNs(), value,
+           has_value);
+    ::memcpy(t_context.spanId, span.parent_span_id, sizeof(t_context.spanId));
+}
+
+uint64_t Now()
+{
+    return Recorder::Instance().Now();
+}
+
+void Complete(const char* name, const char* category, uint64_t start_us, uint64_t end_us, int64_t value,
+              bool has_value)
+{
+    if (start_us == 0 || end_us < start_us)
+    {
+        return;
+    }
+    Recorder::Instance().Add({name, category, start_us, end_us - start_us, value, 0, has_value, 'X'});
+}
+
+void Instant(const char* name, const char* category, int64_t value)
+{
+    auto* exporter = ActiveExporter();
+    if (exporter != nullptr)
+    {
+        uint8_t span_id[8];
+        NewSpanId(span_id);
+        auto now_ns = UnixNs();
+        Export(exporter, name, category, span_id, t_context.spanId, now_ns, now_ns, value, true);
+    }
+    auto now = Now();
+    if (now != 0)
+    {
+        Recorder::Instance().Add({name, category, now, 0, value, 0, true, 'i'});
+    }
+}
+
+void FrameMark(const char* name)
+{
+#ifdef RSID_TRACE_HOOKS
+    auto* hooks = CurrentHooks();
+    if (hooks != nullptr && hooks->frameMark != nullptr)
+    {
+        hooks->frameMark(hooks->context, name);
+    }
+#endif // RSID_TRACE_HOOKS
+    auto now = Now();
+    if (now != 0)
+    {
+        Recorder::Instance().Add({name, "frame", now, 0, 0, 0, false, 'F'});
+    }
+}
+
+void Counter(const char* name, int64_t value)
+{
+#ifdef RSID_TRACE_HOOKS
+    auto* hooks = CurrentHooks();
+    if (hooks != nullptr && hooks->counter != nullptr)
+    {
+        hooks->counter(hooks->context, name, value);
+    }
+#endif // RSID_TRACE_HOOKS
+    auto now = Now();
+    if (now != 0)
+    {
+        Recorder::Instance().Add({name, "counter", now, 0, value, 0, true, 'C'});
+    }
+}
+
+#ifdef RSID_TRACE_HOOKS
+const Hooks* CurrentHooks()
+{
+    return s_hooks.load(std::memory_order_acquire);
+}
+#endif // RSID_TRACE_HOOKS
+
+bool SetHooks(const Hooks* hooks)
+{
+#ifdef RSID_TRACE_HOOKS
+    // replaced hooks are never freed: zones in flight on other threads still end with them. hooks are installed a
+    // handful of times per process at most
+    static std::mutex mutex;
+    static std::vector<std::unique_ptr<Hooks>> installed;
+    std::lock_guard<std::mutex> lock {mutex};
+    const Hooks* current = nullptr;
+    if (hooks != nullptr)
+    {
+        installed.emplace_back(new Hooks {*hooks});
+        current = installed.back().get();
+    }
+    s_hooks.store(current, std::memory_order_release);
+    return true;
+#else
+    (void)hooks;
+    return false;
+#endif // RSID_TRACE_HOOKS
+}
+
+bool ParseTraceparent(const char* traceparent, Context& context)
+{
+    // version 00 only: "00-" trace id "-" span id "-" flags
+    if (traceparent == nullptr || ::strlen(traceparent) != Context::TraceparentSize - 1 ||
+        ::strncmp(traceparent, "00-", 3) != 0 || traceparent[35] != '-' || traceparent[52] != '-')
+    {
+        return false;
+    }
+    Context parsed;
+    int flags_high = HexValue(traceparent[53]);
+    int flags_low = HexValue(traceparent[54]);
+    if (!ParseHex(traceparent + 3, parsed.traceId, sizeof(parsed.traceId)) ||
+        !ParseHex(traceparent + 36, parsed.spanId, sizeof(parsed.spanId)) || flags_high < 0 || flags_low < 0)
+    {
+        return false;
+    }
+    parsed.flags = static_cast<uint8_t>(flags_high << 4 | flags_low); // may be all zero, unlike the ids
+    context = parsed;
+    return true;
+}
+
+void FormatTraceparent(const Context& context, char* buffer)
+{
+    if (buffer == nullptr)
+    {
+        return;
+    }
+    char* out = buffer + ::snprintf(buffer, Context::TraceparentSize, "00-");
+    for (auto byte : context.traceId)
+    {
+        out += ::snprintf(out, 3, "%02x", byte);
+    }
+    *out++ = '-';
+    for (auto byte : context.spanId)
+    {
+        out += ::snprintf(out, 3, "%02x", byte);
+    }
+    ::snprintf(out, 4, "-%02x", context.flags);
+}
+
+void SetContext(const Context* context)
+{
+    t_has_context = context != nullptr;
+    if (context != nullptr)
+    {
+        t_context = *context;
+    }
+}
+
+bool GetContext(Context& context)
+{
+    if (t_has_context)
+    {
+        context = t_context;
+    }
+    return t_has_context;
+}
+
+void SetSpanExporter(const SpanExporter* exporter)
+{
+    // replaced exporters are never freed, as the hooks
+    static std::mutex mutex;
+    static std::vector<std::unique_ptr<SpanExporter>> installed;
+    std::lock_guard<std::mutex> lock {mutex};
+    const SpanExporter* current = nullptr;
+    if (exporter != nullptr)
+    {
+        installed.emplace_back(new SpanExporter {*exporter});
+        current = installed.back().get();
+    }
+    s_exporter.store(current, std::memory_order_release);
+}
+
+void Start(size_t capacity)
+{
+    Recorder::Instance().Start(capacity);
+}
+
+void Stop()
+{
+    Recorder::Instance().Stop();
+}
+
+bool IsRecording()
+{
+    return Recorder::Instance().IsRecording();
+}
+
+std::string ToChromeJson()
+{
+    return Recorder::Instance().ToChromeJson();
+}
+
+bool WriteChromeJson(const char* path)
+{
+    if (path == nullptr)
+    {
+        return false;
+    }
+    std::ofstream file {path, std::ios::binary};
+    file << ToChromeJson();
+    return static_cast<bool>(file.flush());
+}
+} // namespace Trace
+} // namespace RealSenseID
@@ -0,0 +1,105 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/Trace.h"
+#include <cstdint>
+
+// Recording side of RealSenseID::Trace. Names and categories must be static strings (only the pointers are kept).
+namespace RealSenseID
+{
+namespace Trace
+{
+// microseconds of the trace clock, 0 if not recording
+uint64_t Now();
+
+// event of the given duration (microseconds of the trace clock)
+void Complete(const char* name, const char* category, uint64_t start_us, uint64_t end_us, int64_t value,
+              bool has_value);
+
+// point in time event with a value (e.g. the status of a device result)
+void Instant(const char* name, const char* category, int64_t value);
+
+// end of a frame (e.g. a delivered preview image)
+void FrameMark(const char* name);
+
+// value of a counter (e.g. bytes of a transfer)
+void Counter(const char* name, int64_t value);
+
+#ifdef RSID_TRACE_HOOKS
+// the installed profiler hooks, nullptr if none
+const Hooks* CurrentHooks();
+#endif // RSID_TRACE_HOOKS
+
+// span of a scope run under a trace context (see SetContext())
+struct SpanState
+{
+    const SpanExporter* exporter = nullptr; // nullptr if the scope has no span
+    uint8_t parent_span_id[8];
+    uint8_t span_id[8];
+    uint64_t start_unix_ns;
+};
+
+// begin the span of a scope as the thread's current span, if the thread has a sampled context and an exporter is set
+void BeginSpan(SpanState& span);
+
+// export the span and make its parent the thread's current span again
+void EndSpan(const SpanState& span, const char* name, const char* category, int64_t value, bool has_value);
+
+// event from construction to destruction, with an optional value
+class Scope
+{
+public:
+    Scope(const char* name, const char* category) : _name {name}, _category {category}, _start {Now()}
+    {
+#ifdef RSID_TRACE_HOOKS
+        _hooks = CurrentHooks();
+        if (_hooks != nullptr && _hooks->beginZone != nullptr)
+        {
+            _hooks->beginZone(_hooks->context, name, category);
+        }
+#endif // RSID_TRACE_HOOKS
+        BeginSpan(_span);
+    }
+
+    ~Scope()
+    {
+        if (_span.exporter != nullptr)
+        {
+            EndSpan(_span, _name, _category, _value, _has_value);
+        }
+        if (_start != 0)
+        {
+            Complete(_name, _category, _start, Now(), _value, _has_value);
+        }
+#ifdef RSID_TRACE_HOOKS
+        if (_hooks != nullptr && _hooks->endZone != nullptr)
+        {
+            _hooks->endZone(_hooks->context, _name, _category);
+        }
+#endif // RSID_TRACE_HOOKS
+    }
+
+    void SetValue(int64_t value)
+    {
+        _value = value;
+        _has_value = true;
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* _name;
+    const char* _category;
+    uint64_t _start;
+    int64_t _value = 0;
+    bool _has_value = false;
+    SpanState _span;
+#ifdef RSID_TRACE_HOOKS
+    const Hooks* _hooks;
+#endif // RSID_TRACE_HOOKS
+};
+} // namespace Trace
+} // namespace RealSenseID
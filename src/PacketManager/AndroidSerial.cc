@@ -2,7 +2,9 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 
 #include "AndroidSerial.h"
+#include "ThreadConfigImpl.h"
 #include "Logger.h"
+#include "SerialCapture.h"
 #include "SerialPacket.h"
 #include <string.h>
 #include <cassert>
@@ -24,6 +26,8 @@ namespace PacketManager
 {
 static const char* LOG_TAG = "AndroidSerial";
 static constexpr timeout_t recv_packet_timeout {5000};
+// how often the usb reader thread checks the stop flag while waiting for buffer space
+static constexpr timeout_t space_wait_timeout {100};
 
 static void ThrowAndroidError(std::string msg)
 {
@@ -33,6 +37,7 @@ static void ThrowAndroidError(std::string msg)
 void AndroidSerial::StartReadFromDeviceWorkingThread()
 {
     _worker_thread = std::thread([this]() {
+        ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Serial, "usb-reader");
         const size_t read_buffer_size = 4096;
         char temp_read_buffer[read_buffer_size];
         while (false == _stop_read_from_device_working_thread)
@@ -44,24 +49,21 @@ void AndroidSerial::StartReadFromDeviceWorkingThread()
             ctrl.data = (void*)temp_read_buffer;
             ctrl.timeout = 2000;
             int ioctl_result = ioctl(_file_descriptor, USBDEVFS_BULK, &ctrl);
-            if (-1 < ioctl_result)
+            if (ioctl_result <= 0)
             {
-                size_t ioctl_positive_result = ::abs(ioctl_result);
-                // LOG_DEBUG(LOG_TAG, "ioctl returned %d bytes from the device using FileDescriptor(%d) and
-                // ReadEndpointAddress(%d)", ioctlResult, m_FileDescriptor, m_ReadEndpointAddress);
-                if (ioctl_positive_result == read_buffer_size)
-                {
-                    LOG_DEBUG(LOG_TAG, "ioctl returned %d. %s", errno, strerror(errno));
-                }
-                else
+                continue;
+            }
+
+            // backpressure: wait for the reader instead of dropping bytes if the buffer is full
+            const size_t bytes_to_write = static_cast<size_t>(ioctl_result);
+            size_t bytes_written = 0;
+            while (bytes_written < bytes_to_write && false == _stop_read_from_device_working_thread)
+            {
+                bytes_written +=
+                    _read_from_device_buffer.Write(temp_read_buffer + bytes_written, bytes_to_write - bytes_written);
+                if (bytes_written < bytes_to_write && !_read_from_device_buffer.WaitForSpace(space_wait_timeout))
                 {
-                    size_t actual_bytes_writen =
-                        _read_from_device_buffer.Write(temp_read_buffer, ioctl_positive_result);
-                    if (actual_bytes_writen != ioctl_positive_result)
-                    {
-                        LOG_ERROR(LOG_TAG, "Intermediate buffer out of space!");
-                        assert(false);
-                    }
+                    LOG_DEBUG(LOG_TAG, "Intermediate buffer full, waiting for reader");
                 }
             }
         }
@@ -90,12 +92,13 @@ SerialStatus AndroidSerial::SendBytes(const char* buffer, size_t n_bytes)
         LOG_ERROR(LOG_TAG, "Error while writing to serial port");
         return SerialStatus::SendFailed;
     }
-    DEBUG_SERIAL(LOG_TAG, "[snd]", buffer, n_bytes);
+    SERIAL_SENT(LOG_TAG, buffer, n_bytes);
     return SerialStatus::Ok;
 }
 
 AndroidSerial::~AndroidSerial()
 {
+    _bulk_reader.reset();
     _stop_read_from_device_working_thread = true;
     if (_worker_thread.joinable())
     {
@@ -103,12 +106,21 @@ AndroidSerial::~AndroidSerial()
     }
 }
 
-AndroidSerial::AndroidSerial(int file_descriptor, int read_endpoint_address, int write_endpoint_address) :
-    _stop_read_from_device_working_thread(false), _file_descriptor(file_descriptor),
-    _read_endpoint_address(read_endpoint_address), _write_endpoint_address(write_endpoint_address)
+AndroidSerial::AndroidSerial(int file_descriptor, int read_endpoint_address, int write_endpoint_address,
+                             size_t read_buffer_size) :
+    _file_descriptor(file_descriptor),
+    _read_endpoint_address(read_endpoint_address), _write_endpoint_address(write_endpoint_address),
+    _stop_read_from_device_working_thread(false), _read_from_device_buffer(read_buffer_size)
 {
     _stop_read_from_device_working_thread = false;
-    StartReadFromDeviceWorkingThread();
+    _bulk_reader = std::make_unique<UsbBulkReader>(_file_descriptor, _read_endpoint_address, read_buffer_size);
+    if (!_bulk_reader->Start())
+    {
+        LOG_WARNING(LOG_TAG, "Async bulk reads not supported, using synchronous bulk transfers");
+        _bulk_reader.reset();
+        StartReadFromDeviceWorkingThread();
+    }
+    SERIAL_OPENED();
 }
 
 SerialStatus AndroidSerial::RecvBytes(char* buffer, size_t n_bytes)
@@ -120,30 +132,41 @@ SerialStatus AndroidSerial::RecvBytes(char* buffer, size_t n_bytes)
     }
 
     Timer timer {recv_packet_timeout};
-    size_t total_bytes_read = 0;
-    while (!timer.ReachedTimeout())
+    auto status = _recv_buffer.Recv(buffer, n_bytes, timer);
+    if (status == SerialStatus::RecvTimeout)
     {
-        char* buf_ptr = buffer + total_bytes_read;
-        auto last_read_result = _read_from_device_buffer.Read(buf_ptr, n_bytes - total_bytes_read);
-        if (last_read_result > 0)
-        {
-            total_bytes_read += last_read_result;
-            if (total_bytes_read >= n_bytes)
-            {
-                assert(n_bytes == total_bytes_read);
-                DEBUG_SERIAL(LOG_TAG, "[rcv]", buffer, total_bytes_read);
-                return SerialStatus::Ok;
-            }
-        }
-        else
+        LOG_DEBUG(LOG_TAG, "Timeout recv %zu bytes. Got only %zu bytes", n_bytes, _recv_buffer.Size());
+    }
+    return status;
+}
+
+SerialStatus AndroidSerial::RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout)
+{
+    n_bytes = 0;
+    if (_bulk_reader)
+    {
+        n_bytes = _bulk_reader->Read(buffer, max_bytes, timeout);
+        if (n_bytes == 0)
         {
-            // Allow time for writing to the buffer
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            return SerialStatus::RecvTimeout;
         }
+        SERIAL_RECEIVED(LOG_TAG, buffer, n_bytes);
+        return SerialStatus::Ok;
     }
-    DEBUG_SERIAL(LOG_TAG, "[rcv]", buffer, total_bytes_read);
-    LOG_DEBUG(LOG_TAG, "Timeout recv %zu bytes. Got only %zu bytes", n_bytes, total_bytes_read);
-    return SerialStatus::RecvTimeout;
+
+    // the reader thread signals the cyclic buffer when it writes to it
+    if (!_read_from_device_buffer.WaitForData(timeout))
+    {
+        return SerialStatus::RecvTimeout;
+    }
+    auto last_read_result = _read_from_device_buffer.Read(buffer, max_bytes);
+    if (last_read_result == 0)
+    {
+        return SerialStatus::RecvTimeout;
+    }
+    SERIAL_RECEIVED(LOG_TAG, buffer, last_read_result);
+    n_bytes = last_read_result;
+    return SerialStatus::Ok;
 }
 
 } // namespace PacketManager
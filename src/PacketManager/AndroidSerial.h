@@ -4,6 +4,7 @@
 #pragma once
 #include "SerialConnection.h"
 #include "CyclicBuffer.h"
+#include "UsbBulkReader.h"
 #include <memory>
 #include <functional>
 #include <thread>
@@ -17,7 +18,10 @@ namespace PacketManager
 class AndroidSerial : public SerialConnection
 {
 public:
-    explicit AndroidSerial(int file_descriptor, int read_endpoint_address, int write_endpoint_address);
+    // read_buffer_size: size of the buffer between the usb reader and the receiver. reading from the device pauses
+    // while it is full.
+    AndroidSerial(int file_descriptor, int read_endpoint_address, int write_endpoint_address,
+                  size_t read_buffer_size = CyclicBuffer::DefaultCapacity);
     ~AndroidSerial();
 
     // prevent copy or assignment
@@ -31,6 +35,10 @@ public:
     // receive all bytes and copy to the buffer
     SerialStatus RecvBytes(char* buffer, size_t n_bytes) final;
 
+    // what the usb bulk reader received (or the fallback reader thread put in the cyclic buffer), waits up to the
+    // timeout for data
+    SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) final;
+
 private:
     int _file_descriptor;
     int _read_endpoint_address;
@@ -39,6 +47,9 @@ private:
     void StartReadFromDeviceWorkingThread();
     std::atomic<bool> _stop_read_from_device_working_thread;
 
+    // async URB reader. if the device does not accept URBs, a thread doing synchronous bulk transfers into the
+    // cyclic buffer is used instead.
+    std::unique_ptr<UsbBulkReader> _bulk_reader;
     std::thread _worker_thread;
     CyclicBuffer _read_from_device_buffer;
 };
@@ -0,0 +1,28 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+
+// Clock sync pings (ClockSyncProtocolVer firmware): the data of a ping starting with its number and ClockSyncMagic is
+// echoed with the device clock (microseconds, monotonic) at the ping's receive and at the reply's send in the stamp
+// fields. Older firmware echoes the ping as is, with zero stamps.
+namespace RealSenseID
+{
+namespace PacketManager
+{
+static const uint32_t ClockSyncMagic = 0x434b4c43; // "CLKC"
+
+#pragma pack(push)
+#pragma pack(1)
+struct ClockSyncPing
+{
+    uint32_t number;
+    uint32_t magic;
+    uint64_t device_receive_us;
+    uint64_t device_send_us;
+};
+#pragma pack(pop)
+} // namespace PacketManager
+} // namespace RealSenseID
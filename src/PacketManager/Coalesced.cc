@@ -0,0 +1,128 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "Coalesced.h"
+#include "Logger.h"
+#include <cassert>
+#include <string.h>
+
+static const char* LOG_TAG = "Coalesced";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// message bytes of a packet sent alone
+static size_t MessageSize(const SerialPacket& packet)
+{
+    return packet.UsedPayloadSize() - sizeof(packet.payload.sequence_number);
+}
+
+bool CoalescedWriter::Add(const SerialPacket& packet)
+{
+    const size_t size = MessageSize(packet);
+    if (_size + sizeof(CoalescedRecord) + size > MaxCoalescedData)
+    {
+        return false;
+    }
+    CoalescedRecord record {packet.header.id, static_cast<uint16_t>(size)};
+    ::memcpy(_data + _size, &record, sizeof(record));
+    ::memcpy(_data + _size + sizeof(record), &packet.payload.message, size);
+    _size += sizeof(record) + size;
+    _count++;
+    return true;
+}
+
+size_t CoalescedWriter::Count() const
+{
+    return _count;
+}
+
+DataPacket CoalescedWriter::Packet() const
+{
+    DataPacket packet {MsgId::Coalesced};
+    packet.Reset(MsgId::Coalesced, _data, _size);
+    CoalescedHeader header {_count};
+    ::memcpy(packet.payload.message.data_msg.data, &header, sizeof(header));
+    return packet;
+}
+
+void CoalescedWriter::Clear()
+{
+    _size = sizeof(CoalescedHeader);
+    _count = 0;
+}
+
+SerialStatus CoalescedReader::Load(const SerialPacket& packet)
+{
+    Clear();
+    const size_t size = MessageSize(packet);
+    CoalescedHeader header;
+    if (size < sizeof(header))
+    {
+        LOG_ERROR(LOG_TAG, "Coalesced packet too short (%zu bytes)", size);
+        return SerialStatus::RecvUnexpectedPacket;
+    }
+    ::memcpy(&header, packet.payload.message.data_msg.data, sizeof(header));
+
+    // every record must be within the packet and fit in a packet of its own
+    size_t offset = sizeof(header);
+    for (uint16_t i = 0; i < header.count; i++)
+    {
+        CoalescedRecord record;
+        if (offset + sizeof(record) > size)
+        {
+            LOG_ERROR(LOG_TAG, "Coalesced packet truncated at message %u of %u", i, header.count);
+            return SerialStatus::RecvUnexpectedPacket;
+        }
+        ::memcpy(&record, packet.payload.message.data_msg.data + offset, sizeof(record));
+        offset += sizeof(record);
+        if (record.size > size - offset || record.size > sizeof(packet.payload.message) ||
+            record.id == MsgId::Coalesced)
+        {
+            LOG_ERROR(LOG_TAG, "Invalid coalesced message '%c' of %u bytes", record.id, record.size);
+            return SerialStatus::RecvUnexpectedPacket;
+        }
+        offset += record.size;
+    }
+    if (header.count == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Empty coalesced packet");
+        return SerialStatus::RecvUnexpectedPacket;
+    }
+
+    ::memcpy(_data, packet.payload.message.data_msg.data, offset);
+    _offset = sizeof(header);
+    _remaining = header.count;
+    _sequence_number = packet.payload.sequence_number;
+    _protocol_ver = packet.header.protocol_ver;
+    return SerialStatus::Ok;
+}
+
+bool CoalescedReader::Empty() const
+{
+    return _remaining == 0;
+}
+
+void CoalescedReader::Next(SerialPacket& packet)
+{
+    assert(!Empty());
+    CoalescedRecord record;
+    ::memcpy(&record, _data + _offset, sizeof(record));
+    packet.Reset();
+    packet.header.protocol_ver = _protocol_ver;
+    packet.header.id = record.id;
+    packet.header.payload_size = static_cast<uint16_t>(sizeof(packet.payload.sequence_number) + record.size);
+    packet.payload.sequence_number = _sequence_number;
+    ::memcpy(&packet.payload.message, _data + _offset + sizeof(record), record.size);
+    _offset += sizeof(record) + record.size;
+    _remaining--;
+}
+
+void CoalescedReader::Clear()
+{
+    _offset = 0;
+    _remaining = 0;
+}
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,79 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "SerialPacket.h"
+#include "CommonTypes.h"
+#include <cstddef>
+#include <cstdint>
+
+// Coalesced messages (CoalesceProtocolVer sessions): the device may pack a burst of small messages (e.g. the face
+// detected, result and reply of an authentication) into one data packet with MsgId::Coalesced, which is framed,
+// signed and encrypted once. The packet's data is a CoalescedHeader followed by the messages, each a CoalescedRecord
+// and the size bytes of the message as it would be sent alone (its payload after the sequence number). The messages
+// are received one by one as if sent alone, with the sequence number of the packet.
+namespace RealSenseID
+{
+namespace PacketManager
+{
+#pragma pack(push)
+#pragma pack(1)
+struct CoalescedHeader
+{
+    uint16_t count; // number of messages, at least 1
+};
+
+struct CoalescedRecord
+{
+    MsgId id;
+    uint16_t size; // bytes of the message that follow
+};
+#pragma pack(pop)
+
+static const size_t MaxCoalescedData = sizeof(DataMessage::data);
+
+// packs messages into a coalesced packet (device side, see DeviceEmulator)
+class CoalescedWriter
+{
+public:
+    // append the message of the packet. return false if it doesn't fit in the rest of the packet.
+    bool Add(const SerialPacket& packet);
+
+    size_t Count() const;
+
+    // coalesced packet of the messages added since the last Clear()
+    DataPacket Packet() const;
+
+    void Clear();
+
+private:
+    char _data[MaxCoalescedData];
+    size_t _size = sizeof(CoalescedHeader);
+    uint16_t _count = 0;
+};
+
+// unpacks the messages of a received coalesced packet
+class CoalescedReader
+{
+public:
+    // take the messages of the coalesced packet, replacing those not read yet.
+    // return Status::Ok on success, RecvUnexpectedPacket if the packet is malformed (the reader is empty then).
+    SerialStatus Load(const SerialPacket& packet);
+
+    bool Empty() const;
+
+    // fill the packet with the next message (the reader must not be empty)
+    void Next(SerialPacket& packet);
+
+    void Clear();
+
+private:
+    char _data[MaxCoalescedData];
+    size_t _offset = 0;
+    uint16_t _remaining = 0;
+    uint32_t _sequence_number = 0;
+    unsigned char _protocol_ver = 0;
+};
+} // namespace PacketManager
+} // namespace RealSenseID
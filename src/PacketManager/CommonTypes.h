@@ -40,5 +40,8 @@ enum class RSID_NO_DISCARD SerialStatus
 };
 
 using timeout_t = std::chrono::milliseconds;
+
+// baud rates of the device's serial link, highest first
+static const unsigned int SupportedBaudrates[] = {2000000, 921600, 460800, 230400, 115200};
 } // namespace PacketManager
 } // namespace RealSenseID
\ No newline at end of file
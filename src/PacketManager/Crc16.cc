@@ -28,16 +28,54 @@ static const uint16_t CRC16_LOOKUP[256] = {
 
 static const unsigned int CRC16_INITIAL_VAL = 0x1d0f;
 
+namespace
+{
+// slice-by-8 tables: table[k][b] is the crc contribution of byte b followed by k zero bytes
+struct Crc16Slices
+{
+    uint16_t table[8][256];
+
+    Crc16Slices()
+    {
+        for (unsigned int b = 0; b < 256; b++)
+        {
+            table[0][b] = CRC16_LOOKUP[b];
+        }
+        for (unsigned int k = 1; k < 8; k++)
+        {
+            for (unsigned int b = 0; b < 256; b++)
+            {
+                uint16_t prev = table[k - 1][b];
+                table[k][b] = static_cast<uint16_t>((prev << 8) ^ CRC16_LOOKUP[prev >> 8]);
+            }
+        }
+    }
+};
+} // namespace
 
 uint16_t RealSenseID::PacketManager::Crc16(uint16_t initial_crc, const char* buffer, std::size_t bufferSize)
 {
     unsigned int crc = initial_crc;
-    auto* bytePtr = buffer;
+    auto* bytePtr = reinterpret_cast<const unsigned char*>(buffer);
+    static const Crc16Slices slices;
+    const auto& t = slices.table;
+
+    // 8 bytes per step: the crc is xored into the first 2 bytes, each byte is looked up in the table of its distance
+    // from the end of the block
+    while (bufferSize >= 8)
+    {
+        unsigned int b0 = ((crc >> 8) ^ bytePtr[0]) & 0xff;
+        unsigned int b1 = (crc ^ bytePtr[1]) & 0xff;
+        crc = t[7][b0] ^ t[6][b1] ^ t[5][bytePtr[2]] ^ t[4][bytePtr[3]] ^ t[3][bytePtr[4]] ^ t[2][bytePtr[5]] ^
+              t[1][bytePtr[6]] ^ t[0][bytePtr[7]];
+        bytePtr += 8;
+        bufferSize -= 8;
+    }
 
     while (bufferSize-- > 0)
     {
         auto idx = ((crc >> 8) ^ *bytePtr) & 0xff;
-        crc = CRC16_LOOKUP[idx] ^ (crc << 8);
+        crc = (CRC16_LOOKUP[idx] ^ (crc << 8)) & 0xffff;
         ++bytePtr;
     }
     return static_cast<uint16_t>(crc);
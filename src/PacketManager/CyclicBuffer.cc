@@ -2,9 +2,9 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 
 #include "CyclicBuffer.h"
-#include <algorithm>
 #include "Logger.h"
-
+#include <algorithm>
+#include <cstring>
 
 namespace RealSenseID
 {
@@ -12,85 +12,119 @@ namespace PacketManager
 {
 static const char* LOG_TAG = "CyclicBuffer";
 
-CyclicBuffer::CyclicBuffer() : _read_index(0), _write_index(0), _buffer_full(false)
+static size_t RoundUpToPowerOf2(size_t value)
+{
+    size_t result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+CyclicBuffer::CyclicBuffer(size_t capacity) :
+    _capacity {RoundUpToPowerOf2(std::max<size_t>(capacity, 1))}, _mask {_capacity - 1},
+    _buffer {new char[_capacity]}
 {
 }
 
+size_t CyclicBuffer::Size() const
+{
+    return _write_index.load(std::memory_order_acquire) - _read_index.load(std::memory_order_acquire);
+}
+
 size_t CyclicBuffer::Read(char* destination_buffer, size_t bytes_to_read)
 {
-    if (NULL == destination_buffer)
+    if (nullptr == destination_buffer)
     {
-        LOG_ERROR(LOG_TAG, "The destinationBuffer is NULL");
+        LOG_ERROR(LOG_TAG, "The destination buffer is NULL");
         return 0;
     }
-    if (bytes_to_read == 0)
+
+    // only the consumer moves the read index
+    auto read_index = _read_index.load(std::memory_order_relaxed);
+    auto write_index = _write_index.load(std::memory_order_acquire);
+    auto actual_bytes_read = std::min(write_index - read_index, bytes_to_read);
+    if (actual_bytes_read == 0)
     {
         return 0;
     }
 
-    size_t actual_bytes_read = 0;
+    // up to the end of the buffer, then from its start
+    auto offset = read_index & _mask;
+    auto first_part = std::min(actual_bytes_read, _capacity - offset);
+    ::memcpy(destination_buffer, &_buffer[offset], first_part);
+    ::memcpy(destination_buffer + first_part, &_buffer[0], actual_bytes_read - first_part);
 
-    const std::lock_guard<std::mutex> lock(_mutex);
-    if (_write_index > _read_index)
-    {
-        actual_bytes_read = std::min(_write_index - _read_index, bytes_to_read);
-        ::memcpy(destination_buffer, &_buffer[_read_index], actual_bytes_read);
+    _read_index.store(read_index + actual_bytes_read, std::memory_order_seq_cst);
+    Notify(_writer_waiting, _space_cv);
+    return actual_bytes_read;
+}
 
-        _read_index += actual_bytes_read;
-    }
-    else if (_read_index > _write_index || _buffer_full)
+size_t CyclicBuffer::Write(const char* source_buffer, size_t bytes_to_write)
+{
+    if (nullptr == source_buffer)
     {
-        actual_bytes_read = std::min(_buffer_size - _read_index, bytes_to_read);
-        ::memcpy(destination_buffer, &_buffer[_read_index], actual_bytes_read);
-        _read_index = (_read_index + actual_bytes_read == _buffer_size) ? 0 : _read_index + actual_bytes_read;
-        if (bytes_to_read > actual_bytes_read)
-        {
-            size_t available_bytes_to_read = std::min(_write_index, bytes_to_read - actual_bytes_read);
-            ::memcpy(&destination_buffer[actual_bytes_read], _buffer, available_bytes_to_read);
+        LOG_ERROR(LOG_TAG, "The source buffer is NULL");
+        return 0;
+    }
 
-            actual_bytes_read += available_bytes_to_read;
-            _read_index += available_bytes_to_read;
-        }
+    // only the producer moves the write index
+    auto write_index = _write_index.load(std::memory_order_relaxed);
+    auto read_index = _read_index.load(std::memory_order_acquire);
+    auto actual_bytes_written = std::min(_capacity - (write_index - read_index), bytes_to_write);
+    if (actual_bytes_written == 0)
+    {
+        return 0;
     }
 
-    _buffer_full = false;
-    return actual_bytes_read;
+    auto offset = write_index & _mask;
+    auto first_part = std::min(actual_bytes_written, _capacity - offset);
+    ::memcpy(&_buffer[offset], source_buffer, first_part);
+    ::memcpy(&_buffer[0], source_buffer + first_part, actual_bytes_written - first_part);
+
+    _write_index.store(write_index + actual_bytes_written, std::memory_order_seq_cst);
+    Notify(_reader_waiting, _data_cv);
+    return actual_bytes_written;
 }
 
-size_t CyclicBuffer::Write(char* source_buffer, size_t bytes_to_write)
+// the index store before it and the waiting flag store in Wait*() are both seq_cst: either the waiter sees the new
+// index, or the notifier sees the flag and wakes it. the mutex makes sure the waiter is already asleep.
+void CyclicBuffer::Notify(std::atomic<bool>& waiting, std::condition_variable& cv)
 {
-    if (nullptr == source_buffer || _buffer_full)
+    if (waiting.load(std::memory_order_seq_cst))
     {
-        if (nullptr == source_buffer)
-            LOG_ERROR(LOG_TAG, "The destinationBuffer is NULL");
-        if (_buffer_full)
-            LOG_ERROR(LOG_TAG, "Buffer is full");
-        return 0;
+        {
+            const std::lock_guard<std::mutex> lock(_mutex);
+        }
+        cv.notify_one();
     }
+}
 
-    const std::lock_guard<std::mutex> lock(_mutex);
-    size_t actual_bytes_written = 0;
-    if (_write_index >= _read_index)
+bool CyclicBuffer::WaitForData(std::chrono::milliseconds timeout)
+{
+    if (Size() > 0)
     {
-        actual_bytes_written = std::min(_buffer_size - _write_index, bytes_to_write);
-        ::memcpy(&_buffer[_write_index], source_buffer, actual_bytes_written);
-        _write_index = (_write_index + actual_bytes_written == _buffer_size) ? 0 : _write_index + actual_bytes_written;
+        return true;
     }
-    if (bytes_to_write > actual_bytes_written)
-    {
-        size_t available_bytes_to_write = std::min(_read_index - _write_index, bytes_to_write - actual_bytes_written);
-        ::memcpy(&_buffer[_write_index], &source_buffer[actual_bytes_written], available_bytes_to_write);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _reader_waiting.store(true, std::memory_order_seq_cst);
+    auto has_data = _data_cv.wait_for(lock, timeout, [this] { return Size() > 0; });
+    _reader_waiting.store(false, std::memory_order_relaxed);
+    return has_data;
+}
 
-        actual_bytes_written += available_bytes_to_write;
-        _write_index += available_bytes_to_write;
-    }
-    if ((_write_index == _read_index) && (actual_bytes_written > 0))
+bool CyclicBuffer::WaitForSpace(std::chrono::milliseconds timeout)
+{
+    if (Size() < _capacity)
     {
-        _buffer_full = true;
+        return true;
     }
-    
-    return actual_bytes_written;
+    std::unique_lock<std::mutex> lock(_mutex);
+    _writer_waiting.store(true, std::memory_order_seq_cst);
+    auto has_space = _space_cv.wait_for(lock, timeout, [this] { return Size() < _capacity; });
+    _writer_waiting.store(false, std::memory_order_relaxed);
+    return has_space;
 }
-
 } // namespace PacketManager
-} // namespace RealSenseID
\ No newline at end of file
+} // namespace RealSenseID
@@ -3,28 +3,79 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
 #include <mutex>
 
 namespace RealSenseID
 {
 namespace PacketManager
 {
+// Single producer/single consumer lock-free ring buffer.
+// One thread writes (e.g. the usb reader thread), one thread reads. The indices only grow and are published with
+// release/acquire ordering, so Read()/Write() never lock. The mutex and condition variables are used only to sleep
+// in WaitForData()/WaitForSpace() and are touched by the other side only if someone sleeps.
+// A full buffer is not overwritten: the writer writes what fits and waits for space (backpressure).
 class CyclicBuffer
 {
 public:
-    CyclicBuffer();
+#ifdef RSID_LOW_MEMORY
+    static constexpr size_t DefaultCapacity = 16384;
+#else
+    static constexpr size_t DefaultCapacity = 65536;
+#endif
 
+    // capacity is rounded up to a power of 2
+    explicit CyclicBuffer(size_t capacity = DefaultCapacity);
+
+    CyclicBuffer(const CyclicBuffer&) = delete;
+    CyclicBuffer& operator=(const CyclicBuffer&) = delete;
+
+    // consumer: copy up to bytes_to_read bytes, returns the number of bytes copied
     size_t Read(char* destination_buffer, size_t bytes_to_read);
-    size_t Write(char* source_buffer, size_t bytes_to_write);
+
+    // producer: copy as many bytes as fit, returns the number of bytes copied
+    size_t Write(const char* source_buffer, size_t bytes_to_write);
+
+    // consumer: wait until there are bytes to read or the timeout passes, returns true if there are bytes to read
+    bool WaitForData(std::chrono::milliseconds timeout);
+
+    // producer: wait until there is room to write or the timeout passes, returns true if there is room
+    bool WaitForSpace(std::chrono::milliseconds timeout);
+
+    size_t Capacity() const
+    {
+        return _capacity;
+    }
+
+    // bytes written and not yet read
+    size_t Size() const;
 
 private:
-    static const size_t _buffer_size = 65536;
-    unsigned char _buffer[_buffer_size];
+    static constexpr size_t CacheLineSize = 64;
+
+    const size_t _capacity;
+    const size_t _mask;
+    std::unique_ptr<char[]> _buffer;
 
-    size_t _read_index;
-    size_t _write_index;
-    bool _buffer_full;
+    // each index on its own cache line, so the producer and the consumer don't share lines.
+    // padding instead of alignas: over-aligned new is not guaranteed before c++17
+    char _pad0[CacheLineSize];
+    std::atomic<size_t> _write_index {0};
+    char _pad1[CacheLineSize - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> _read_index {0};
+    char _pad2[CacheLineSize - sizeof(std::atomic<size_t>)];
+
+    std::atomic<bool> _reader_waiting {false};
+    std::atomic<bool> _writer_waiting {false};
     std::mutex _mutex;
+    std::condition_variable _data_cv;
+    std::condition_variable _space_cv;
+
+    void Notify(std::atomic<bool>& waiting, std::condition_variable& cv);
 };
 } // namespace PacketManager
-} // namespace RealSenseID
\ No newline at end of file
+} // namespace RealSenseID
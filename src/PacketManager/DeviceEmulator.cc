@@ -0,0 +1,882 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#include "DeviceEmulator.h"
+#include "ClockSyncPing.h"
+#include "Crc16.h"
+#include "MultiFace.h"
+#include "MultiFrame.h"
+#include "Timer.h"
+#include "Logger.h"
+#include "RealSenseID/AuthenticateStatus.h"
+#include "RealSenseID/EnrollStatus.h"
+#include "RealSenseID/FacePose.h"
+#include "RealSenseID/FaceRect.h"
+#include "RealSenseID/Status.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+static const char* LOG_TAG = "DeviceEmulator";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// max delay to notice a stop
+static constexpr timeout_t POLL_INTERVAL {100};
+// for the rest of a packet once its sync bytes arrived
+static constexpr timeout_t PACKET_TIMEOUT {1000};
+// results of the loop flows are at least this far apart, so a loop doesn't flood the host
+static constexpr timeout_t LOOP_INTERVAL {30};
+
+static const char* SYNC_BYTES = "@F";
+static const char* CANCEL_COMMAND = "__FACE_CANCEL__";
+static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+// valid range of the features (see the matcher)
+static const int MAX_FEATURE_VALUE = 1023;
+// of each feature of the extracted faceprints of a recognized user
+static const int FEATURE_NOISE = 100;
+static const unsigned int NOISE_SEED = 2021;
+
+// the (first) face of the FaceDetected packets
+static const FaceRect DETECTED_FACE = [] {
+    FaceRect face;
+    face.x = 480;
+    face.y = 200;
+    face.w = 320;
+    face.h = 400;
+    return face;
+}();
+
+static size_t Find(const char* data, size_t size, const char* pattern)
+{
+    const size_t pattern_size = ::strlen(pattern);
+    for (size_t offset = 0; offset + pattern_size <= size; offset++)
+    {
+        if (::memcmp(data + offset, pattern, pattern_size) == 0)
+        {
+            return offset;
+        }
+    }
+    return NOT_FOUND;
+}
+
+// same as the host's (PacketSender), which is not used here so the emulated packets don't count in the host's metrics
+static uint16_t CalcCrc(const SerialPacket& packet)
+{
+    auto* packet_ptr = reinterpret_cast<const char*>(&packet);
+    if (packet.header.protocol_ver < CompactCrcProtocolVer)
+    {
+        return Crc16(packet_ptr, sizeof(packet) - sizeof(packet.crc));
+    }
+    auto crc = Crc16(packet_ptr, sizeof(packet.header) + packet.header.payload_size);
+    return Crc16(crc, packet.hmac, sizeof(packet.hmac));
+}
+
+// the session start and the pings (sent without a session) are never asked again, nor corrupted by corrupt_every
+static bool Retransmitted(MsgId id)
+{
+    return id != MsgId::StartSession && id != MsgId::Ping && id != MsgId::Nak;
+}
+
+// the packets of the session proper, not those of the session start, pings and naks
+static bool Coalescable(MsgId id)
+{
+    return Retransmitted(id) && id != MsgId::Coalesced;
+}
+
+static const char* DataOf(const SerialPacket& packet)
+{
+    return packet.payload.message.data_msg.data;
+}
+
+DeviceEmulator::DeviceEmulator(const EmulatorConfig& config) :
+    _config {config}, _clock_start {std::chrono::steady_clock::now()}, _device_config {0, static_cast<char>(1), 0, 0},
+    _noise_rng {NOISE_SEED}
+{
+    const auto users = std::min(config.users, config.max_users);
+    for (unsigned int i = 0; i < users; i++)
+    {
+        auto user_id = "user_" + std::to_string(i);
+        _users.emplace(user_id, SyntheticFaceprints(user_id.c_str()));
+    }
+}
+
+void DeviceEmulator::Serve(SerialConnection& serial)
+{
+    Session session {serial};
+    while (!_stopped)
+    {
+        SerialPacket packet;
+        auto status = Recv(session, packet);
+        if (status == SerialStatus::RecvTimeout)
+        {
+            continue;
+        }
+        if (status == SerialStatus::RecvFailed)
+        {
+            LOG_DEBUG(LOG_TAG, "Connection closed");
+            return;
+        }
+        if (Retransmit(session, status, packet) || status != SerialStatus::Ok)
+        {
+            continue; // invalid packet, wait for the next one
+        }
+
+        status = Handle(session, packet);
+        if (status == SerialStatus::Ok)
+        {
+            status = Flush(session);
+        }
+        if (status != SerialStatus::Ok)
+        {
+            LOG_DEBUG(LOG_TAG, "Stopped serving (status %d)", static_cast<int>(status));
+            return;
+        }
+    }
+}
+
+void DeviceEmulator::Stop()
+{
+    _stopped = true;
+}
+
+// faceprints in the valid range, generated from a hash of the name
+Faceprints DeviceEmulator::SyntheticFaceprints(const char* name)
+{
+    uint32_t hash = 2166136261u; // fnv-1a
+    for (const char* p = name; *p != '\0'; p++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*p)) * 16777619u;
+    }
+    std::mt19937 rng {hash};
+    std::uniform_int_distribution<int> dist(-MAX_FEATURE_VALUE, MAX_FEATURE_VALUE);
+
+    Faceprints faceprints;
+    faceprints.numberOfDescriptors = 1;
+    for (size_t i = 0; i < NUMBER_OF_RECOGNITION_FACEPRINTS; i++)
+    {
+        faceprints.avgDescriptor[i] = static_cast<feature_t>(dist(rng));
+        faceprints.origDescriptor[i] = faceprints.avgDescriptor[i];
+    }
+    return faceprints;
+}
+
+// receive the next valid packet.
+// the bytes before its sync bytes are skipped (the __FACE_API__ command, cancel commands after the flow ended).
+SerialStatus DeviceEmulator::Recv(SerialConnection& serial, SerialPacket& packet)
+{
+    auto& buffer = serial.GetReceiveBuffer();
+    Timer sync_timer {POLL_INTERVAL};
+    while (true)
+    {
+        auto status = buffer.Fill(2, sync_timer);
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+        auto offset = Find(buffer.Data(), buffer.Size(), SYNC_BYTES);
+        if (offset != NOT_FOUND)
+        {
+            buffer.Consume(offset);
+            break;
+        }
+        buffer.Consume(buffer.Size() - 1); // the last byte may be the first sync byte
+    }
+
+    Timer packet_timer {PACKET_TIMEOUT};
+    constexpr size_t header_size = sizeof(packet.header);
+    auto status = buffer.Fill(header_size, packet_timer);
+    if (status != SerialStatus::Ok)
+    {
+        return status;
+    }
+    ::memcpy(&packet.header, buffer.Data(), header_size);
+    if (packet.header.protocol_ver < ProtocolVer || packet.header.protocol_ver > MaxProtocolVer ||
+        packet.header.payload_size > sizeof(packet.payload))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid packet header (protocol version %u, payload size %u)", packet.header.protocol_ver,
+                  packet.header.payload_size);
+        buffer.Consume(2);
+        return SerialStatus::RecvUnexpectedPacket;
+    }
+
+    const size_t payload_size = packet.header.payload_size;
+    const size_t packet_size = header_size + payload_size + sizeof(packet.hmac) + sizeof(packet.crc);
+    status = buffer.Fill(packet_size, packet_timer);
+    if (status != SerialStatus::Ok)
+    {
+        return status;
+    }
+    const char* packet_ptr = buffer.Data() + header_size;
+    ::memcpy(&packet.payload, packet_ptr, payload_size);
+    packet_ptr += payload_size;
+    ::memcpy(packet.hmac, packet_ptr, sizeof(packet.hmac));
+    packet_ptr += sizeof(packet.hmac);
+    ::memcpy(&packet.crc, packet_ptr, sizeof(packet.crc));
+    buffer.Consume(packet_size);
+
+    if (CalcCrc(packet) != packet.crc)
+    {
+        LOG_ERROR(LOG_TAG, "Got invalid crc in packet '%c'", static_cast<char>(packet.header.id));
+        return SerialStatus::CrcError;
+    }
+    return SerialStatus::Ok;
+}
+
+SerialStatus DeviceEmulator::Recv(Session& session, SerialPacket& packet)
+{
+    auto status = Recv(session.serial, packet);
+    const auto id = packet.header.id;
+    if (status == SerialStatus::Ok && _config.corrupt_every > 0 && Retransmitted(id) &&
+        ++session.received % _config.corrupt_every == 0)
+    {
+        LOG_DEBUG(LOG_TAG, "Taking packet %u as corrupted", packet.payload.sequence_number);
+        return SerialStatus::CrcError;
+    }
+    return status;
+}
+
+bool DeviceEmulator::Retransmit(Session& session, SerialStatus recv_status, const SerialPacket& packet)
+{
+    if (!session.retransmit.Enabled())
+    {
+        return false;
+    }
+    auto send = [this, &session](SerialPacket& resent) { return SendBytes(session, resent, false); };
+    if (recv_status == SerialStatus::CrcError)
+    {
+        session.retransmit.AskAgain(session.last_recv_seq, send);
+        return true;
+    }
+    if (recv_status != SerialStatus::Ok)
+    {
+        return false;
+    }
+    if (packet.header.id == MsgId::Nak)
+    {
+        session.retransmit.Resend(packet, send);
+        return true;
+    }
+    if (!Retransmitted(packet.header.id))
+    {
+        return false; // a session start resets the retransmission
+    }
+    if (session.retransmit.Drop(packet.payload.sequence_number))
+    {
+        return true;
+    }
+    session.last_recv_seq = packet.payload.sequence_number;
+    return false;
+}
+
+SerialStatus DeviceEmulator::Send(Session& session, SerialPacket& packet)
+{
+    if (session.protocol_ver >= CoalesceProtocolVer && Coalescable(packet.header.id))
+    {
+        if (session.coalesced.Add(packet))
+        {
+            if (session.coalesced.Count() == 1)
+            {
+                session.first = packet;
+            }
+            return SerialStatus::Ok;
+        }
+        // sent after the held ones, alone if too big to be coalesced
+        auto status = Flush(session);
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+        if (session.coalesced.Add(packet))
+        {
+            session.first = packet;
+            return SerialStatus::Ok;
+        }
+    }
+    return SendAlone(session, packet);
+}
+
+SerialStatus DeviceEmulator::SendAlone(Session& session, SerialPacket& packet)
+{
+    packet.header.protocol_ver = session.protocol_ver;
+    // the pings are answered outside the session, their replies don't take a sequence number of it
+    const bool ping = packet.header.id == MsgId::Ping;
+    packet.payload.sequence_number = ping ? session.last_sent_seq + 1 : ++session.last_sent_seq;
+    const bool corrupt = _config.corrupt_every > 0 && Retransmitted(packet.header.id) &&
+                         ++session.sent % _config.corrupt_every == 0;
+    auto status = SendBytes(session, packet, corrupt);
+    if (status == SerialStatus::Ok && !ping)
+    {
+        session.retransmit.Sent(packet, packet.payload.sequence_number);
+    }
+    return status;
+}
+
+SerialStatus DeviceEmulator::Flush(Session& session)
+{
+    const auto count = session.coalesced.Count();
+    if (count == 0)
+    {
+        return SerialStatus::Ok;
+    }
+    if (count == 1)
+    {
+        session.coalesced.Clear();
+        return SendAlone(session, session.first);
+    }
+    auto packet = session.coalesced.Packet();
+    session.coalesced.Clear();
+    return SendAlone(session, packet);
+}
+
+// the kept copy of a corrupted packet is resent intact
+SerialStatus DeviceEmulator::SendBytes(Session& session, const SerialPacket& packet, bool corrupt)
+{
+    auto crc = CalcCrc(packet);
+    if (corrupt)
+    {
+        LOG_DEBUG(LOG_TAG, "Corrupting packet %u", packet.payload.sequence_number);
+        crc = static_cast<uint16_t>(crc ^ 0xffff);
+    }
+    const SendBuffer buffers[] = {
+        {reinterpret_cast<const char*>(&packet), sizeof(packet.header) + packet.header.payload_size},
+        {packet.hmac, sizeof(packet.hmac)},
+        {reinterpret_cast<const char*>(&crc), sizeof(crc)}};
+    return session.serial.SendBytesv(buffers, sizeof(buffers) / sizeof(buffers[0]));
+}
+
+SerialStatus DeviceEmulator::SendFa(Session& session, MsgId id, const char* user_id, int status)
+{
+    FaPacket packet {id, user_id, static_cast<char>(status)};
+    return Send(session, packet);
+}
+
+SerialStatus DeviceEmulator::SendData(Session& session, MsgId id, const char* data, size_t size)
+{
+    DataPacket packet {id};
+    packet.Reset(id, data, size);
+    return Send(session, packet);
+}
+
+SerialStatus DeviceEmulator::Handle(Session& session, const SerialPacket& packet)
+{
+    const auto id = packet.header.id;
+    LOG_DEBUG(LOG_TAG, "Got packet '%c'", static_cast<char>(id));
+    if (_standby.exchange(false) && _config.wake_latency.count() > 0)
+    {
+        std::this_thread::sleep_for(_config.wake_latency);
+    }
+    char user_id[MaxUserIdSize + 1] = {0}; // of the fa packets
+    ::memcpy(user_id, packet.payload.message.fa_msg.user_id, MaxUserIdSize);
+    switch (id)
+    {
+    case MsgId::StartSession:
+        return StartSession(session, packet);
+    // the face flows take their own time
+    case MsgId::Authenticate:
+        return AuthenticateFlow(session, false, false);
+    case MsgId::AuthenticateLoop:
+        return AuthenticateFlow(session, false, true);
+    case MsgId::AuthenticateFaceprintsExtraction:
+        return AuthenticateFlow(session, true, false);
+    case MsgId::AuthenticateLoopFaceprintsExtraction: {
+        // the requested max faces per frame (MultiFaceProtocolVer sessions)
+        int max_faces = 1;
+        if (session.protocol_ver >= MultiFaceProtocolVer)
+        {
+            max_faces = packet.payload.message.fa_msg.fa_status - '0';
+        }
+        return AuthenticateFlow(session, true, true, static_cast<unsigned int>(std::max(max_faces, 1)));
+    }
+    case MsgId::Enroll:
+        return EnrollFlow(session, user_id, false);
+    case MsgId::EnrollFaceprintsExtraction:
+        return EnrollFlow(session, nullptr, true);
+    case MsgId::DetectSpoof:
+        return DetectSpoofFlow(session);
+    default:
+        break;
+    }
+
+    if (_config.reply_latency.count() > 0)
+    {
+        std::this_thread::sleep_for(_config.reply_latency);
+    }
+    switch (id)
+    {
+    case MsgId::RemoveUser:
+        return RemoveUser(session, user_id);
+    case MsgId::RemoveAllUsers:
+        return RemoveAllUsers(session);
+    case MsgId::GetNumberOfUsers:
+        return ReplyNumberOfUsers(session);
+    case MsgId::GetUserIds:
+        return ReplyUserIds(session, packet);
+    case MsgId::GetUserFeatures:
+        return ReplyUserFeatures(session, packet);
+    case MsgId::SetUserFeatures:
+        return SetUserFeatures(session, packet);
+    case MsgId::QueryDeviceConfig:
+        return ReplyDeviceConfig(session);
+    case MsgId::SetDeviceConfig:
+        return SetDeviceConfig(session, packet);
+    case MsgId::StandBy: {
+        auto status = SendFa(session, MsgId::Reply, nullptr, static_cast<int>(Status::Ok));
+        _standby = true;
+        return status;
+    }
+    case MsgId::Ping:
+        return ReplyPing(session, packet);
+    default:
+        LOG_WARNING(LOG_TAG, "Unsupported packet '%c'", static_cast<char>(id));
+        return SendFa(session, MsgId::Reply, nullptr, static_cast<int>(Status::Error));
+    }
+}
+
+// answer with the newest protocol version both sides support (older hosts advertise none)
+SerialStatus DeviceEmulator::StartSession(Session& session, const SerialPacket& packet)
+{
+    auto host_ver = static_cast<unsigned char>(DataOf(packet)[0]);
+    auto device_ver = std::max(ProtocolVer, std::min(_config.protocol_ver, MaxProtocolVer));
+    session.protocol_ver = host_ver < ProtocolVer ? ProtocolVer : std::min(host_ver, device_ver);
+    session.last_sent_seq = 0;
+    session.last_recv_seq = packet.payload.sequence_number;
+    session.retransmit.Reset(session.protocol_ver);
+    session.events = {AllEvents, 0};
+    session.last_face_detected = {};
+    if (session.protocol_ver >= EventMaskProtocolVer)
+    {
+        ::memcpy(&session.events, DataOf(packet) + EventSubscriptionOffset(0), sizeof(session.events));
+    }
+    LOG_DEBUG(LOG_TAG, "Session started, protocol version %u, events 0x%x", session.protocol_ver,
+              session.events.mask);
+    return SendData(session, MsgId::StartSession, nullptr, 0);
+}
+
+bool DeviceEmulator::WaitCancelled(Session& session, timeout_t duration)
+{
+    // the messages of the previous step go out before the wait (a failed send fails the next one too)
+    if (Flush(session) != SerialStatus::Ok)
+    {
+        return false;
+    }
+
+    // the host sends nothing but cancel commands (and naks of the flow's packets) while a flow runs
+    auto& buffer = session.serial.GetReceiveBuffer();
+    Timer timer {duration};
+    while (true)
+    {
+        auto offset = Find(buffer.Data(), buffer.Size(), CANCEL_COMMAND);
+        auto sync_offset = session.retransmit.Enabled() ? Find(buffer.Data(), buffer.Size(), SYNC_BYTES) : NOT_FOUND;
+        if (offset != NOT_FOUND && (sync_offset == NOT_FOUND || offset < sync_offset))
+        {
+            buffer.Consume(offset + ::strlen(CANCEL_COMMAND));
+            return true;
+        }
+        if (sync_offset != NOT_FOUND)
+        {
+            SerialPacket packet;
+            auto status = Recv(session, packet);
+            if (!Retransmit(session, status, packet) && status == SerialStatus::Ok)
+            {
+                LOG_WARNING(LOG_TAG, "Unexpected packet '%c' during a flow", static_cast<char>(packet.header.id));
+            }
+            if (status == SerialStatus::RecvFailed)
+            {
+                return false;
+            }
+            if (status != SerialStatus::RecvTimeout)
+            {
+                continue;
+            }
+        }
+        if (timer.ReachedTimeout() || _stopped || buffer.Size() == ReceiveBuffer::BufferSize)
+        {
+            return false;
+        }
+        auto status = buffer.Fill(buffer.Size() + 1, Timer::Earliest(timer, POLL_INTERVAL));
+        if (status == SerialStatus::RecvFailed)
+        {
+            return false; // the sends of the flow fail too
+        }
+    }
+}
+
+std::string DeviceEmulator::Recognize(Faceprints& faceprints)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (_users.empty())
+    {
+        faceprints = SyntheticFaceprints("unknown");
+        return {};
+    }
+    auto user = std::next(_users.begin(), static_cast<std::ptrdiff_t>(_next_recognized++ % _users.size()));
+    faceprints = user->second;
+    std::uniform_int_distribution<int> noise(-FEATURE_NOISE, FEATURE_NOISE);
+    for (auto& feature : faceprints.avgDescriptor)
+    {
+        int value = feature + noise(_noise_rng);
+        feature = static_cast<feature_t>(std::max(-MAX_FEATURE_VALUE, std::min(value, MAX_FEATURE_VALUE)));
+    }
+    return user->first;
+}
+
+// i-th face of a frame, the others queue behind the first one
+static FaceRect DetectedFace(unsigned int i)
+{
+    if (i == 0)
+    {
+        return DETECTED_FACE;
+    }
+    FaceRect face;
+    face.x = (i - 1) * 128;
+    face.y = 40;
+    face.w = 120;
+    face.h = 120;
+    return face;
+}
+
+// a count byte followed by the rect of each face
+SerialStatus DeviceEmulator::SendFaceDetected(Session& session, unsigned int faces)
+{
+    const auto now = std::chrono::steady_clock::now();
+    const std::chrono::milliseconds interval {session.events.face_detected_interval_ms};
+    if ((session.events.mask & EventFaceDetected) == 0 ||
+        (interval.count() > 0 && now - session.last_face_detected < interval))
+    {
+        return SerialStatus::Ok;
+    }
+    session.last_face_detected = now;
+    char face_detected[1 + MaxMultiFaces * sizeof(FaceRect)] = {static_cast<char>(faces)};
+    for (unsigned int i = 0; i < faces; i++)
+    {
+        auto face = DetectedFace(i);
+        ::memcpy(face_detected + 1 + i * sizeof(FaceRect), &face, sizeof(FaceRect));
+    }
+    return SendData(session, MsgId::FaceDetected, face_detected, 1 + faces * sizeof(FaceRect));
+}
+
+// the faceprints of the faces of a frame in one multi-frame message (see MultiFace.h), each face recognized as in
+// the single face flows
+SerialStatus DeviceEmulator::SendMultiFaceprints(Session& session, unsigned int faces)
+{
+    std::vector<char> message(sizeof(MultiFaceHeader) + faces * sizeof(MultiFaceRecord));
+    MultiFaceHeader header {faces};
+    ::memcpy(message.data(), &header, sizeof(header));
+    for (unsigned int i = 0; i < faces; i++)
+    {
+        Faceprints faceprints;
+        Recognize(faceprints);
+        MultiFaceRecord record;
+        record.face = DetectedFace(i);
+        record.version = faceprints.version;
+        record.features_type = static_cast<int32_t>(faceprints.featuresType);
+        ::memcpy(record.descriptor, faceprints.avgDescriptor, sizeof(record.descriptor));
+        ::memcpy(message.data() + sizeof(header) + i * sizeof(record), &record, sizeof(record));
+    }
+    for (size_t offset = 0, frame = 0; frame < FrameCount(message.size()); offset += MaxFrameData, frame++)
+    {
+        auto frame_packet = MakeFrame(MsgId::MultiFaceprints, message.data(), message.size(), offset);
+        auto status = Send(session, frame_packet);
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+    }
+    return SerialStatus::Ok;
+}
+
+SerialStatus DeviceEmulator::AuthenticateFlow(Session& session, bool extract_faceprints, bool loop,
+                                             unsigned int max_faces)
+{
+    const auto step_latency = loop ? std::max(_config.flow_latency, LOOP_INTERVAL) : _config.flow_latency;
+    const unsigned int faces = std::max(1u, std::min(_config.faces_per_frame, MaxMultiFaces));
+    do
+    {
+        if (WaitCancelled(session, step_latency))
+        {
+            LOG_DEBUG(LOG_TAG, "Authenticate cancelled");
+            break;
+        }
+        auto status = SendFaceDetected(session, faces);
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+        if (max_faces > 1)
+        {
+            status = SendFa(session, MsgId::Result, nullptr, static_cast<int>(AuthenticateStatus::Success));
+            if (status == SerialStatus::Ok)
+            {
+                status = SendMultiFaceprints(session, std::min(faces, max_faces));
+            }
+            if (status != SerialStatus::Ok)
+            {
+                return status;
+            }
+            continue;
+        }
+
+        Faceprints faceprints;
+        auto user_id = Recognize(faceprints);
+        if (extract_faceprints)
+        {
+            // the faceprints are matched by the host
+            status = SendFa(session, MsgId::Result, nullptr, static_cast<int>(AuthenticateStatus::Success));
+            if (status == SerialStatus::Ok)
+            {
+                status = SendData(session, MsgId::Faceprints, reinterpret_cast<const char*>(&faceprints),
+                                  sizeof(faceprints));
+            }
+        }
+        else
+        {
+            auto result = user_id.empty() ? AuthenticateStatus::Forbidden : AuthenticateStatus::Success;
+            status = SendFa(session, MsgId::Result, user_id.c_str(), static_cast<int>(result));
+        }
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+    } while (loop);
+    return SendFa(session, MsgId::Reply, nullptr, 0);
+}
+
+SerialStatus DeviceEmulator::EnrollFlow(Session& session, const char* user_id, bool extract_faceprints)
+{
+    if (WaitCancelled(session, _config.flow_latency))
+    {
+        LOG_DEBUG(LOG_TAG, "Enroll cancelled");
+        return SendFa(session, MsgId::Reply, nullptr, 0);
+    }
+    auto status = SendFaceDetected(session);
+    if (status == SerialStatus::Ok)
+    {
+        status = SendFa(session, MsgId::Progress, nullptr, static_cast<int>(FacePose::Center));
+    }
+    if (status != SerialStatus::Ok)
+    {
+        return status;
+    }
+
+    if (extract_faceprints)
+    {
+        std::string face_name;
+        {
+            std::lock_guard<std::mutex> lock {_mutex};
+            face_name = "face_" + std::to_string(_next_face++);
+        }
+        auto faceprints = SyntheticFaceprints(face_name.c_str());
+        status = SendFa(session, MsgId::Result, nullptr, static_cast<int>(EnrollStatus::Success));
+        if (status == SerialStatus::Ok)
+        {
+            status = SendData(session, MsgId::Faceprints, reinterpret_cast<const char*>(&faceprints),
+                              sizeof(faceprints));
+        }
+    }
+    else
+    {
+        bool enrolled = false;
+        {
+            std::lock_guard<std::mutex> lock {_mutex};
+            if (_users.size() < _config.max_users || _users.count(user_id) > 0)
+            {
+                _users[user_id] = SyntheticFaceprints(user_id);
+                enrolled = true;
+            }
+        }
+        auto result = enrolled ? EnrollStatus::Success : EnrollStatus::Failure;
+        status = SendFa(session, MsgId::Result, nullptr, static_cast<int>(result));
+    }
+    if (status != SerialStatus::Ok)
+    {
+        return status;
+    }
+    return SendFa(session, MsgId::Reply, nullptr, 0);
+}
+
+SerialStatus DeviceEmulator::DetectSpoofFlow(Session& session)
+{
+    if (!WaitCancelled(session, _config.flow_latency))
+    {
+        auto status = SendFaceDetected(session);
+        if (status == SerialStatus::Ok)
+        {
+            status = SendFa(session, MsgId::Result, nullptr, static_cast<int>(AuthenticateStatus::Success));
+        }
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+    }
+    return SendFa(session, MsgId::Reply, nullptr, 0);
+}
+
+SerialStatus DeviceEmulator::RemoveUser(Session& session, const char* user_id)
+{
+    bool removed = false;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        removed = _users.erase(user_id) > 0;
+    }
+    auto status = removed ? Status::Ok : Status::Error;
+    return SendFa(session, MsgId::Reply, nullptr, static_cast<int>(status));
+}
+
+SerialStatus DeviceEmulator::RemoveAllUsers(Session& session)
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _users.clear();
+    }
+    return SendFa(session, MsgId::Reply, nullptr, static_cast<int>(Status::Ok));
+}
+
+SerialStatus DeviceEmulator::ReplyNumberOfUsers(Session& session)
+{
+    uint32_t n_users = 0;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        n_users = static_cast<uint32_t>(_users.size());
+    }
+    return SendData(session, MsgId::GetNumberOfUsers, reinterpret_cast<const char*>(&n_users), sizeof(n_users));
+}
+
+// number of users (uint32) followed by the zero delimited user ids, from the requested offset. in one multi-frame
+// message since MultiFrameProtocolVer, in a packet of the requested chunk size before
+SerialStatus DeviceEmulator::ReplyUserIds(Session& session, const SerialPacket& packet)
+{
+    uint32_t settings[2];
+    ::memcpy(settings, DataOf(packet), sizeof(settings));
+    const bool multi_frame = session.protocol_ver >= MultiFrameProtocolVer;
+    const size_t max_size = multi_frame ? MaxMessageSize : sizeof(DataMessage::data);
+
+    std::vector<char> message(sizeof(uint32_t));
+    uint32_t n_users = 0;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        auto user = _users.begin();
+        std::advance(user, std::min(static_cast<size_t>(settings[0]), _users.size()));
+        for (; user != _users.end() && n_users < settings[1]; ++user, n_users++)
+        {
+            if (message.size() + user->first.size() + 1 > max_size)
+            {
+                break;
+            }
+            message.insert(message.end(), user->first.c_str(), user->first.c_str() + user->first.size() + 1);
+        }
+    }
+    ::memcpy(message.data(), &n_users, sizeof(n_users));
+
+    if (!multi_frame)
+    {
+        return SendData(session, MsgId::GetUserIds, message.data(), message.size());
+    }
+    for (size_t offset = 0, frame = 0; frame < FrameCount(message.size()); offset += MaxFrameData, frame++)
+    {
+        auto frame_packet = MakeFrame(MsgId::GetUserIds, message.data(), message.size(), offset);
+        auto status = Send(session, frame_packet);
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+    }
+    return SerialStatus::Ok;
+}
+
+SerialStatus DeviceEmulator::ReplyUserFeatures(Session& session, const SerialPacket& packet)
+{
+    char user_id[MaxUserIdSize + 1] = {0};
+    ::memcpy(user_id, DataOf(packet), MaxUserIdSize);
+    Faceprints faceprints;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        auto user = _users.find(user_id);
+        if (user != _users.end())
+        {
+            faceprints = user->second;
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        LOG_DEBUG(LOG_TAG, "No user %s", user_id);
+        return SendFa(session, MsgId::Reply, nullptr, static_cast<int>(Status::Error));
+    }
+    return SendData(session, MsgId::GetUserFeatures, reinterpret_cast<const char*>(&faceprints), sizeof(faceprints));
+}
+
+// zero padded user id (MaxUserIdSize + 1 bytes) followed by the faceprints
+SerialStatus DeviceEmulator::SetUserFeatures(Session& session, const SerialPacket& packet)
+{
+    char user_id[MaxUserIdSize + 1] = {0};
+    ::memcpy(user_id, DataOf(packet), MaxUserIdSize);
+    Faceprints faceprints;
+    ::memcpy(&faceprints, DataOf(packet) + MaxUserIdSize + 1, sizeof(faceprints));
+    bool stored = false;
+    if (user_id[0] != '\0')
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (_users.size() < _config.max_users || _users.count(user_id) > 0)
+        {
+            _users[user_id] = faceprints;
+            stored = true;
+        }
+    }
+    if (!stored)
+    {
+        return SendFa(session, MsgId::Reply, nullptr, static_cast<int>(Status::Error));
+    }
+    return SendData(session, MsgId::SetUserFeatures, user_id, ::strlen(user_id) + 1);
+}
+
+// camera rotation, security level, preview mode and advanced mode, one byte each
+SerialStatus DeviceEmulator::SetDeviceConfig(Session& session, const SerialPacket& packet)
+{
+    char device_config[sizeof(_device_config)];
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        ::memcpy(_device_config, DataOf(packet), sizeof(_device_config));
+        ::memcpy(device_config, _device_config, sizeof(device_config));
+    }
+    return SendData(session, MsgId::SetDeviceConfig, device_config, sizeof(device_config));
+}
+
+SerialStatus DeviceEmulator::ReplyDeviceConfig(Session& session)
+{
+    char device_config[sizeof(_device_config)];
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        ::memcpy(device_config, _device_config, sizeof(device_config));
+    }
+    return SendData(session, MsgId::QueryDeviceConfig, device_config, sizeof(device_config));
+}
+
+SerialStatus DeviceEmulator::ReplyPing(Session& session, const SerialPacket& packet)
+{
+    char data[sizeof(DataMessage::data)];
+    ::memcpy(data, DataOf(packet), sizeof(data));
+    ClockSyncPing ping;
+    ::memcpy(&ping, data, sizeof(ping));
+    if (_config.protocol_ver >= ClockSyncProtocolVer && ping.magic == ClockSyncMagic)
+    {
+        ping.device_receive_us = DeviceTimeUs();
+        ping.device_send_us = DeviceTimeUs();
+        ::memcpy(data, &ping, sizeof(ping));
+    }
+    return SendData(session, MsgId::Ping, data, sizeof(data));
+}
+
+uint64_t DeviceEmulator::DeviceTimeUs() const
+{
+    using namespace std::chrono;
+    auto elapsed = duration_cast<microseconds>(steady_clock::now() - _clock_start).count();
+    return static_cast<uint64_t>(elapsed) + static_cast<uint64_t>(elapsed) * _config.clock_drift_ppm / 1000000;
+}
+} // namespace PacketManager
+} // namespace RealSenseID
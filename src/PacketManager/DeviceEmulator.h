@@ -0,0 +1,150 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+#include "SerialConnection.h"
+#include "SerialPacket.h"
+#include "Retransmit.h"
+#include "Coalesced.h"
+#include "EventFilter.h"
+#include "RealSenseID/Faceprints.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+struct EmulatorConfig
+{
+    // time to detect and recognize a face, per result of the face flows (authenticate, enroll, extraction)
+    timeout_t flow_latency {0};
+    // time to answer the other requests (user database, device config)
+    timeout_t reply_latency {0};
+    // users enrolled when the emulator is created, "user_0" to "user_<users - 1>"
+    unsigned int users = 0;
+    // capacity of the user database
+    unsigned int max_users = 1000;
+    // newest protocol version of the emulated firmware
+    unsigned char protocol_ver = MaxProtocolVer;
+    // every nth packet sent goes out with a bad crc and every nth packet received is taken as one (0: none), to
+    // exercise the retransmission of RetransmitProtocolVer sessions. the session start and ping packets are never corrupted
+    unsigned int corrupt_every = 0;
+    // faces in each frame of the authenticate flows, of which the multi-face extraction loop (MultiFaceProtocolVer
+    // sessions) extracts up to the requested number
+    unsigned int faces_per_frame = 1;
+    // the emulated device clock (stamped on the clock sync pings of ClockSyncProtocolVer firmware) runs this many
+    // parts per million faster than the host's. it starts at 0 when the emulator is created
+    unsigned int clock_drift_ppm = 0;
+    // time to wake up from standby: the first packet received after a standby request is handled after it
+    timeout_t wake_latency {0};
+};
+
+// Emulator of the device side of the packet protocol, to measure the host side without hardware.
+// Serves non-secure sessions: session start (protocol version negotiation), the authenticate, enroll and faceprints
+// extraction flows (single, loop and multi-face loop), the user database (user ids, number of users, remove, user
+// features), the device config, standby and ping (stamped with the emulated device clock). A cancel command ends the
+// running flow. Packets with a bad crc are asked again and naks of the host answered (RetransmitProtocolVer sessions).
+// The messages sent together (those of a request, or of a flow step) go out in one coalesced packet if they fit
+// (CoalesceProtocolVer sessions).
+// Faces are synthetic: every user has faceprints generated from its user id, authenticate recognizes the enrolled
+// users in turn (and extracts their faceprints with some noise, so host side matching finds them).
+// The database is kept by the emulator, connections served one after another (or at the same time) share it.
+class DeviceEmulator
+{
+public:
+    explicit DeviceEmulator(const EmulatorConfig& config);
+
+    DeviceEmulator(const DeviceEmulator&) = delete;
+    DeviceEmulator operator=(const DeviceEmulator&) = delete;
+
+    // serve the host on the connection until the connection fails (e.g. closed by the host) or Stop() is called.
+    // the receives of the connection must be done by this call only
+    void Serve(SerialConnection& serial);
+
+    // make all Serve() calls return (within about 100ms)
+    void Stop();
+
+    // faceprints of the synthetic face of the given name (user id)
+    static Faceprints SyntheticFaceprints(const char* name);
+
+private:
+    // state of the session with the host of a connection
+    struct Session
+    {
+        explicit Session(SerialConnection& serial_conn) : serial {serial_conn}
+        {
+        }
+
+        SerialConnection& serial;
+        unsigned char protocol_ver = ProtocolVer;
+        uint32_t last_sent_seq = 0;
+        uint32_t last_recv_seq = 0;
+        Retransmitter retransmit {};
+        unsigned int sent = 0;     // packets, for EmulatorConfig::corrupt_every
+        unsigned int received = 0; // packets, for EmulatorConfig::corrupt_every
+        CoalescedWriter coalesced; // messages held until Flush() (CoalesceProtocolVer)
+        SerialPacket first;        // the first of them, sent alone if it's the only one
+        EventSubscriptionField events {AllEvents, 0}; // as subscribed at the session start (EventMaskProtocolVer)
+        std::chrono::steady_clock::time_point last_face_detected;
+    };
+
+    const EmulatorConfig _config;
+    const std::chrono::steady_clock::time_point _clock_start;
+    std::atomic<bool> _stopped {false};
+    std::atomic<bool> _standby {false}; // until the next packet, see EmulatorConfig::wake_latency
+
+    std::mutex _mutex; // of the state below
+    std::map<std::string, Faceprints> _users;
+    char _device_config[4]; // as sent by SetDeviceConfig
+    size_t _next_recognized = 0; // index of the user recognized by the next authenticate
+    unsigned int _next_face = 0; // of the faces extracted for enroll
+    std::mt19937 _noise_rng;
+
+    SerialStatus Recv(SerialConnection& serial, SerialPacket& packet);
+    // receive the next packet of the session, CrcError for the corrupt_every ones
+    SerialStatus Recv(Session& session, SerialPacket& packet);
+    // ask again a packet received with a bad crc, or resend on a nak of the host.
+    // true if the packet was one of these (or is dropped until the packet asked again arrives)
+    bool Retransmit(Session& session, SerialStatus recv_status, const SerialPacket& packet);
+    // send the packet, or hold it to be coalesced with the next ones (CoalesceProtocolVer)
+    SerialStatus Send(Session& session, SerialPacket& packet);
+    SerialStatus SendAlone(Session& session, SerialPacket& packet);
+    // send the messages held for coalescing
+    SerialStatus Flush(Session& session);
+    SerialStatus SendBytes(Session& session, const SerialPacket& packet, bool corrupt);
+    SerialStatus SendFa(Session& session, MsgId id, const char* user_id, int status);
+    SerialStatus SendData(Session& session, MsgId id, const char* data, size_t size);
+    // skipped if the session didn't subscribe to it, or sooner than its interval after the last one
+    SerialStatus SendFaceDetected(Session& session, unsigned int faces = 1);
+
+    SerialStatus Handle(Session& session, const SerialPacket& packet);
+    SerialStatus StartSession(Session& session, const SerialPacket& packet);
+    SerialStatus AuthenticateFlow(Session& session, bool extract_faceprints, bool loop, unsigned int max_faces = 1);
+    SerialStatus SendMultiFaceprints(Session& session, unsigned int faces);
+    SerialStatus EnrollFlow(Session& session, const char* user_id, bool extract_faceprints);
+    SerialStatus DetectSpoofFlow(Session& session);
+    SerialStatus RemoveUser(Session& session, const char* user_id);
+    SerialStatus RemoveAllUsers(Session& session);
+    SerialStatus ReplyNumberOfUsers(Session& session);
+    SerialStatus ReplyUserIds(Session& session, const SerialPacket& packet);
+    SerialStatus ReplyUserFeatures(Session& session, const SerialPacket& packet);
+    SerialStatus SetUserFeatures(Session& session, const SerialPacket& packet);
+    SerialStatus SetDeviceConfig(Session& session, const SerialPacket& packet);
+    SerialStatus ReplyDeviceConfig(Session& session);
+    SerialStatus ReplyPing(Session& session, const SerialPacket& packet);
+
+    // microseconds of the emulated device clock
+    uint64_t DeviceTimeUs() const;
+
+    // wait the time of a face flow step, answering the naks of the host. true if a cancel command arrived meanwhile
+    bool WaitCancelled(Session& session, timeout_t duration);
+    // the recognized user (empty if there are none) and its faceprints with noise
+    std::string Recognize(Faceprints& faceprints);
+};
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,170 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#include "EmulatorSerial.h"
+#include "Timer.h"
+#include "Logger.h"
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+static const char* LOG_TAG = "EmulatorSerial";
+static const char* EMULATOR_PREFIX = "emulator://";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+static unsigned int ParseOption(const std::string& option, const std::string& key, const std::string& value)
+{
+    char* end = nullptr;
+    auto parsed = std::strtoul(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0')
+    {
+        throw std::runtime_error("Invalid emulator option " + option + ", expected " + key + "=<number>");
+    }
+    return static_cast<unsigned int>(parsed);
+}
+
+// "<option>=<value>[&...]"
+static EmulatorConfig ParseOptions(const std::string& options)
+{
+    EmulatorConfig config;
+    size_t begin = 0;
+    while (begin < options.size())
+    {
+        auto end = options.find('&', begin);
+        if (end == std::string::npos)
+        {
+            end = options.size();
+        }
+        auto option = options.substr(begin, end - begin);
+        begin = end + 1;
+
+        auto separator = option.find('=');
+        auto key = option.substr(0, separator);
+        auto value = separator == std::string::npos ? std::string {} : option.substr(separator + 1);
+        if (key == "flow-latency-ms")
+        {
+            config.flow_latency = timeout_t {ParseOption(option, key, value)};
+        }
+        else if (key == "reply-latency-ms")
+        {
+            config.reply_latency = timeout_t {ParseOption(option, key, value)};
+        }
+        else if (key == "users")
+        {
+            config.users = ParseOption(option, key, value);
+        }
+        else if (key == "max-users")
+        {
+            config.max_users = ParseOption(option, key, value);
+        }
+        else if (key == "protocol")
+        {
+            config.protocol_ver = static_cast<unsigned char>(ParseOption(option, key, value));
+        }
+        else if (key == "corrupt-every")
+        {
+            config.corrupt_every = ParseOption(option, key, value);
+        }
+        else if (key == "faces-per-frame")
+        {
+            config.faces_per_frame = ParseOption(option, key, value);
+        }
+        else if (key == "clock-drift-ppm")
+        {
+            config.clock_drift_ppm = ParseOption(option, key, value);
+        }
+        else if (key == "wake-latency-ms")
+        {
+            config.wake_latency = timeout_t {ParseOption(option, key, value)};
+        }
+        else
+        {
+            throw std::runtime_error("Unknown emulator option " + option);
+        }
+    }
+    return config;
+}
+
+// the process' emulator of the name, created on first use
+static std::shared_ptr<DeviceEmulator> AcquireEmulator(const std::string& name, const EmulatorConfig& config)
+{
+    static std::mutex mutex;
+    static std::map<std::string, std::shared_ptr<DeviceEmulator>> emulators;
+    std::lock_guard<std::mutex> lock {mutex};
+    auto& emulator = emulators[name];
+    if (!emulator)
+    {
+        emulator = std::make_shared<DeviceEmulator>(config);
+    }
+    return emulator;
+}
+
+bool EmulatorSerial::IsEmulatorPort(const char* port)
+{
+    return port != nullptr && ::strncmp(port, EMULATOR_PREFIX, ::strlen(EMULATOR_PREFIX)) == 0;
+}
+
+EmulatorSerial::EmulatorSerial(const char* port)
+{
+    if (!IsEmulatorPort(port))
+    {
+        throw std::runtime_error(std::string("Invalid emulator port ") + (port != nullptr ? port : ""));
+    }
+    std::string target = port + ::strlen(EMULATOR_PREFIX);
+    auto separator = target.find('?');
+    auto name = target.substr(0, separator);
+    auto config = ParseOptions(separator == std::string::npos ? std::string {} : target.substr(separator + 1));
+
+    _emulator = AcquireEmulator(name, config);
+    auto ends = LoopbackSerial::CreatePair();
+    _host = std::move(ends.first);
+    _device = std::move(ends.second);
+    _thread = std::thread([this] { _emulator->Serve(*_device); });
+    LOG_DEBUG(LOG_TAG, "Connected to emulator \"%s\"", name.c_str());
+}
+
+EmulatorSerial::~EmulatorSerial()
+{
+    try
+    {
+        // the emulator stops serving once it reads the close
+        _host->Close();
+        _thread.join();
+    }
+    catch (...)
+    {
+    }
+}
+
+SerialStatus EmulatorSerial::SendBytes(const char* buffer, size_t n_bytes)
+{
+    return _host->SendBytes(buffer, n_bytes);
+}
+
+SerialStatus EmulatorSerial::SendBytesv(const SendBuffer* buffers, size_t n_buffers)
+{
+    return _host->SendBytesv(buffers, n_buffers);
+}
+
+SerialStatus EmulatorSerial::RecvBytes(char* buffer, size_t n_bytes)
+{
+    if (n_bytes == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Attempt to recv 0 bytes");
+        return SerialStatus::RecvFailed;
+    }
+    Timer timer {std::chrono::milliseconds {200 + 4 * n_bytes}};
+    return _recv_buffer.Recv(buffer, n_bytes, timer);
+}
+
+SerialStatus EmulatorSerial::RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout)
+{
+    return _host->RecvAvailable(buffer, max_bytes, n_bytes, timeout);
+}
+} // namespace PacketManager
+} // namespace RealSenseID
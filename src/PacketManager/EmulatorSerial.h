@@ -0,0 +1,46 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+#include "SerialConnection.h"
+#include "DeviceEmulator.h"
+#include "LoopbackSerial.h"
+#include <memory>
+#include <thread>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// Serial connection to a DeviceEmulator running in the process, port "emulator://<name>[?<option>=<value>[&...]]"
+// (see OpenSerialConnection()). Options (see EmulatorConfig):
+//   flow-latency-ms, reply-latency-ms, users, max-users, protocol, corrupt-every, faces-per-frame
+// e.g. "emulator://dev1?flow-latency-ms=500&users=1000". Connections to the same name share one emulated device (its
+// users and config) for the life of the process, created with the options of the first connection.
+class EmulatorSerial : public SerialConnection
+{
+public:
+    // throws on invalid options
+    explicit EmulatorSerial(const char* port);
+    ~EmulatorSerial();
+
+    EmulatorSerial(const EmulatorSerial&) = delete;
+    EmulatorSerial operator=(const EmulatorSerial&) = delete;
+
+    static bool IsEmulatorPort(const char* port);
+
+    SerialStatus SendBytes(const char* buffer, size_t n_bytes) final;
+
+    SerialStatus SendBytesv(const SendBuffer* buffers, size_t n_buffers) final;
+
+    SerialStatus RecvBytes(char* buffer, size_t n_bytes) final;
+
+    SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) final;
+
+private:
+    std::shared_ptr<DeviceEmulator> _emulator;
+    std::unique_ptr<LoopbackSerial> _host;   // end of the connection used by this
+    std::unique_ptr<LoopbackSerial> _device; // served by the emulator
+    std::thread _thread;
+};
+} // namespace PacketManager
+} // namespace RealSenseID
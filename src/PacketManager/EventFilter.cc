@@ -0,0 +1,66 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "EventFilter.h"
+#include <stdexcept>
+#include <string.h>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+bool EventFilter::Set(uint8_t mask, uint16_t face_detected_interval_ms)
+{
+    mask &= AllEvents;
+    const bool changed = mask != _field.mask || face_detected_interval_ms != _field.face_detected_interval_ms;
+    _field.mask = mask;
+    _field.face_detected_interval_ms = face_detected_interval_ms;
+    return changed;
+}
+
+void EventFilter::Advertise(DataPacket& packet, size_t data_size) const
+{
+    const size_t offset = EventSubscriptionOffset(data_size);
+    if (sizeof(packet.payload.sequence_number) + offset + sizeof(_field) > packet.header.payload_size)
+    {
+        throw std::runtime_error("EventFilter: no padding bytes for the subscription after the packet data");
+    }
+    ::memcpy(packet.payload.message.data_msg.data + offset, &_field, sizeof(_field));
+}
+
+void EventFilter::Reset(unsigned char protocol_ver)
+{
+    _device_filters = protocol_ver >= EventMaskProtocolVer;
+    _last_face_detected = {};
+}
+
+bool EventFilter::Drop(const SerialPacket& packet)
+{
+    if (_device_filters)
+    {
+        return false;
+    }
+    switch (packet.header.id)
+    {
+    case MsgId::Hint:
+        return (_field.mask & EventHints) == 0;
+    case MsgId::FaceDetected: {
+        if ((_field.mask & EventFaceDetected) == 0)
+        {
+            return true;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (_field.face_detected_interval_ms > 0 &&
+            now - _last_face_detected < std::chrono::milliseconds {_field.face_detected_interval_ms})
+        {
+            return true;
+        }
+        _last_face_detected = now;
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,62 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "SerialPacket.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Event subscription (EventMaskProtocolVer sessions): the session start packet (StartSession or HostEcdhKey) carries
+// an EventSubscriptionField right after the advertised protocol version byte, with the events of the face flows the
+// device sends. Older firmware ignores it and sends all the events, the session drops the unsubscribed ones when
+// received then, so the flows don't parse and dispatch them (the serial traffic is not reduced).
+namespace RealSenseID
+{
+namespace PacketManager
+{
+enum EventMaskBits : uint8_t
+{
+    EventHints = 1 << 0,        // MsgId::Hint
+    EventFaceDetected = 1 << 1, // MsgId::FaceDetected
+    AllEvents = EventHints | EventFaceDetected
+};
+
+#pragma pack(push)
+#pragma pack(1)
+struct EventSubscriptionField
+{
+    uint8_t mask;                       // EventMaskBits of the events to send
+    uint16_t face_detected_interval_ms; // min time between the FaceDetected messages, 0 for all
+};
+#pragma pack(pop)
+
+// offset of the field in the data of the session start packet, after data_size bytes of data
+inline size_t EventSubscriptionOffset(size_t data_size)
+{
+    return data_size + 1; // after the protocol version byte (see AdvertiseProtocolVer())
+}
+
+class EventFilter
+{
+public:
+    // return true if changed, sessions started before don't have the new subscription
+    bool Set(uint8_t mask, uint16_t face_detected_interval_ms);
+
+    // write the subscription to the session start packet with data_size bytes of data, after AdvertiseProtocolVer()
+    void Advertise(DataPacket& packet, size_t data_size) const;
+
+    // a session started with the given protocol version: the device filters from EventMaskProtocolVer on
+    void Reset(unsigned char protocol_ver);
+
+    // true if the received packet is an event the device should not have sent (older firmware)
+    bool Drop(const SerialPacket& packet);
+
+private:
+    EventSubscriptionField _field {AllEvents, 0};
+    bool _device_filters = false;
+    std::chrono::steady_clock::time_point _last_face_detected;
+};
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,243 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "IoReactor.h"
+#include "RealSenseID/IoReactor.h"
+#include "ThreadConfigImpl.h"
+#include "Logger.h"
+#include <atomic>
+#include <exception>
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif // __linux__
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+static const char* LOG_TAG = "IoReactor";
+static const int MAX_EVENTS = 16;
+
+static std::atomic<bool> s_enabled {false};
+
+void IoReactor::SetEnabled(bool enable)
+{
+    s_enabled.store(enable);
+}
+
+#ifdef __linux__
+std::shared_ptr<IoReactor> IoReactor::Acquire()
+{
+    static std::mutex instance_mutex;
+    static std::weak_ptr<IoReactor> instance;
+
+    if (!s_enabled.load())
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock {instance_mutex};
+    auto reactor = instance.lock();
+    if (!reactor)
+    {
+        reactor = std::make_shared<IoReactor>();
+        if (reactor->_epoll_fd < 0 || reactor->_wake_fd < 0)
+        {
+            return nullptr;
+        }
+        instance = reactor;
+    }
+    return reactor;
+}
+
+IoReactor::IoReactor()
+{
+    _epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    _wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_epoll_fd < 0 || _wake_fd < 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to create the epoll descriptors. errno %d", errno);
+        return;
+    }
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = _wake_fd;
+    if (::epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &event) < 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to watch the wake descriptor. errno %d", errno);
+        ::close(_wake_fd);
+        _wake_fd = -1;
+    }
+}
+
+IoReactor::~IoReactor()
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _stop = true;
+    }
+    if (_wake_fd >= 0)
+    {
+        uint64_t one = 1;
+        auto ignored = ::write(_wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+    if (_thread.joinable())
+    {
+        // released by a handler on the reactor thread
+        if (_thread.get_id() == std::this_thread::get_id())
+        {
+            _thread.detach();
+        }
+        else
+        {
+            _thread.join();
+        }
+    }
+    if (_wake_fd >= 0)
+    {
+        ::close(_wake_fd);
+    }
+    if (_epoll_fd >= 0)
+    {
+        ::close(_epoll_fd);
+    }
+}
+
+bool IoReactor::Add(int fd, Handler handler)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (::epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to watch fd %d. errno %d", fd, errno);
+        return false;
+    }
+    _handlers[fd] = std::make_shared<Handler>(std::move(handler));
+    if (!_thread.joinable())
+    {
+        _thread = std::thread(&IoReactor::ThreadLoop, this);
+    }
+    return true;
+}
+
+void IoReactor::Arm(int fd, bool armed)
+{
+    struct epoll_event event = {};
+    event.events = armed ? static_cast<uint32_t>(EPOLLIN) : 0;
+    event.data.fd = fd;
+    if (::epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to %s fd %d. errno %d", armed ? "arm" : "disarm", fd, errno);
+    }
+}
+
+void IoReactor::Remove(int fd)
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    if (_handlers.erase(fd) == 0)
+    {
+        return;
+    }
+    ::epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    if (_thread.get_id() != std::this_thread::get_id())
+    {
+        _handler_done_cv.wait(lock, [this, fd] { return _running_fd != fd; });
+    }
+}
+
+void IoReactor::ThreadLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Io, "io");
+    LOG_DEBUG(LOG_TAG, "Reactor thread started");
+
+    struct epoll_event events[MAX_EVENTS];
+    while (true)
+    {
+        int n_events = ::epoll_wait(_epoll_fd, events, MAX_EVENTS, -1);
+        if (n_events < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR(LOG_TAG, "epoll_wait failed. errno %d", errno);
+            return;
+        }
+        for (int i = 0; i < n_events; i++)
+        {
+            const int fd = events[i].data.fd;
+            std::shared_ptr<Handler> handler;
+            {
+                std::lock_guard<std::mutex> lock {_mutex};
+                if (_stop)
+                {
+                    LOG_DEBUG(LOG_TAG, "Reactor thread stopped");
+                    return;
+                }
+                auto it = _handlers.find(fd);
+                if (it == _handlers.end())
+                {
+                    continue; // removed after the wait returned
+                }
+                handler = it->second;
+                _running_fd = fd;
+            }
+            try
+            {
+                (*handler)(events[i].events);
+            }
+            catch (const std::exception& ex)
+            {
+                LOG_EXCEPTION(LOG_TAG, ex);
+            }
+            catch (...)
+            {
+                LOG_ERROR(LOG_TAG, "Unknown exception in handler of fd %d", fd);
+            }
+            {
+                std::lock_guard<std::mutex> lock {_mutex};
+                _running_fd = -1;
+            }
+            _handler_done_cv.notify_all();
+        }
+    }
+}
+#else
+std::shared_ptr<IoReactor> IoReactor::Acquire()
+{
+    return nullptr;
+}
+
+IoReactor::IoReactor() = default;
+IoReactor::~IoReactor() = default;
+
+bool IoReactor::Add(int, Handler)
+{
+    return false;
+}
+
+void IoReactor::Arm(int, bool)
+{
+}
+
+void IoReactor::Remove(int)
+{
+}
+
+void IoReactor::ThreadLoop()
+{
+}
+#endif // __linux__
+} // namespace PacketManager
+
+void SetIoReactor(bool enable)
+{
+    PacketManager::IoReactor::SetEnabled(enable);
+}
+} // namespace RealSenseID
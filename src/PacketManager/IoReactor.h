@@ -0,0 +1,61 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// Process wide epoll loop of the device descriptors, enabled by SetIoReactor() (Linux only).
+// One thread waits for all registered descriptors and calls their handler when one is readable (level triggered), so
+// the handler must consume what is available or disarm the descriptor. Shared by the connections that use it, the
+// thread stops when the last one releases it.
+class IoReactor
+{
+public:
+    // called on the reactor thread with the epoll events of the descriptor
+    using Handler = std::function<void(uint32_t events)>;
+
+    // nullptr if the reactor is disabled or not supported
+    static std::shared_ptr<IoReactor> Acquire();
+    static void SetEnabled(bool enable);
+
+    IoReactor();
+    ~IoReactor();
+
+    IoReactor(const IoReactor&) = delete;
+    IoReactor& operator=(const IoReactor&) = delete;
+
+    // watch the descriptor for input. false if epoll refused it (the caller should wait on it itself)
+    bool Add(int fd, Handler handler);
+
+    // stop (or resume) calling the descriptor's handler until rearmed, e.g. while its consumer has no room
+    void Arm(int fd, bool armed);
+
+    // stop watching the descriptor. waits for its running handler unless called from the handler
+    void Remove(int fd);
+
+private:
+    int _epoll_fd = -1;
+    int _wake_fd = -1; // eventfd waking the thread to stop
+
+    std::mutex _mutex; // guards the handlers, the running handler and the thread
+    std::condition_variable _handler_done_cv;
+    std::unordered_map<int, std::shared_ptr<Handler>> _handlers;
+    int _running_fd = -1; // descriptor whose handler is running
+    std::thread _thread;  // started with the first registration
+    bool _stop = false;
+
+    void ThreadLoop();
+};
+} // namespace PacketManager
+} // namespace RealSenseID
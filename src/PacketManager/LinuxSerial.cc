@@ -5,6 +5,7 @@
 #include "SerialPacket.h"
 #include "Timer.h"
 #include "Logger.h"
+#include "SerialCapture.h"
 #include <string>
 #include <stdexcept>
 #include <thread>
@@ -12,12 +13,24 @@
 #include <fcntl.h>
 #include <string.h>
 #include <termios.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <vector>
 #include <errno.h>
 #include <cassert>
+#include <climits>
+#include <algorithm>
 #include <cmath>
 
 static const char* LOG_TAG = "LinuxSerial";
 
+#ifdef RSID_LOW_MEMORY
+static const size_t REACTOR_INPUT_SIZE = 4096;
+#else
+static const size_t REACTOR_INPUT_SIZE = 16384;
+#endif
+
 static speed_t to_speed_t(unsigned int baudRate)
 {
     switch (baudRate)
@@ -44,6 +57,18 @@ static speed_t to_speed_t(unsigned int baudRate)
         return B57600;
     case 115200:
         return B115200;
+    case 230400:
+        return B230400;
+    case 460800:
+        return B460800;
+    case 921600:
+        return B921600;
+#ifdef B2000000
+    case 1000000:
+        return B1000000;
+    case 2000000:
+        return B2000000;
+#endif
     default:
         return -1;
     }
@@ -57,6 +82,10 @@ LinuxSerial::~LinuxSerial()
 {
     try
     {
+        if (_reactor)
+        {
+            _reactor->Remove(_handle);
+        }
         ::close(_handle);
     }
     catch (...)
@@ -97,8 +126,8 @@ LinuxSerial::LinuxSerial(const SerialConfig& config) : _config {config}
     throw_on_error(::cfsetispeed(&options, baudRate), "cfsetispeed", _handle);
     throw_on_error(::cfsetospeed(&options, baudRate), "cfsetospeed", _handle);
 
-    // return whatever bytes available after 200ms max
-    options.c_cc[VTIME] = 2;
+    // reads return whatever bytes available at once, waiting is done in poll() (see RecvAvailable)
+    options.c_cc[VTIME] = 0;
     options.c_cc[VMIN] = 0;
     options.c_cflag |= (CLOCAL | CREAD | CS8);
     options.c_iflag |= (IGNPAR | IGNBRK);
@@ -107,6 +136,21 @@ LinuxSerial::LinuxSerial(const SerialConfig& config) : _config {config}
 
     // discard any existing data in input/output buffers
     ::tcflush(_handle, TCIOFLUSH);
+
+    _reactor = IoReactor::Acquire();
+    if (_reactor)
+    {
+        _input.resize(REACTOR_INPUT_SIZE);
+        if (_reactor->Add(_handle, [this](uint32_t events) { OnReadable(events); }))
+        {
+            LOG_DEBUG(LOG_TAG, "Serial port read by the I/O reactor");
+        }
+        else
+        {
+            _reactor.reset();
+        }
+    }
+    SERIAL_OPENED();
 }
 
 SerialStatus LinuxSerial::SendBytes(const char* buffer, size_t n_bytes)
@@ -116,7 +160,7 @@ SerialStatus LinuxSerial::SendBytes(const char* buffer, size_t n_bytes)
     {
         auto* send_ptr = &buffer[bytes_sent];
         size_t n_bytes_left = n_bytes - bytes_sent;
-        DEBUG_SERIAL(LOG_TAG, "[snd]", send_ptr, n_bytes_left);
+        SERIAL_SENT(LOG_TAG, send_ptr, n_bytes_left);
         auto write_rv = ::write(_handle, send_ptr, n_bytes_left);
         if (write_rv <= 0)
         {
@@ -135,6 +179,63 @@ SerialStatus LinuxSerial::SendBytes(const char* buffer, size_t n_bytes)
     return SerialStatus::Ok;
 }
 
+SerialStatus LinuxSerial::SendBytesv(const SendBuffer* buffers, size_t n_buffers)
+{
+    std::vector<struct iovec> iov;
+    iov.reserve(n_buffers);
+    size_t n_bytes = 0;
+    for (size_t i = 0; i < n_buffers; i++)
+    {
+        if (buffers[i].n_bytes == 0)
+        {
+            continue;
+        }
+        SERIAL_SENT(LOG_TAG, buffers[i].buffer, buffers[i].n_bytes);
+        iov.push_back({const_cast<char*>(buffers[i].buffer), buffers[i].n_bytes});
+        n_bytes += buffers[i].n_bytes;
+    }
+
+    // writev may send only part of the segments - continue from the first unsent byte
+    size_t bytes_sent = 0;
+    size_t iov_index = 0;
+    while (iov_index < iov.size())
+    {
+        int iov_count = static_cast<int>(std::min<size_t>(iov.size() - iov_index, IOV_MAX));
+        auto write_rv = ::writev(_handle, &iov[iov_index], iov_count);
+        if (write_rv < 0 && errno == EINTR)
+        {
+            // interrupted by a signal before anything was written
+            continue;
+        }
+        if (write_rv <= 0)
+        {
+            LOG_ERROR(LOG_TAG, "Error while sending %zu bytes. errno=%d, sent so far: %zu, write rv=%zd", n_bytes,
+                      errno, bytes_sent, write_rv);
+            return SerialStatus::SendFailed;
+        }
+        bytes_sent += static_cast<size_t>(write_rv);
+
+        size_t written = static_cast<size_t>(write_rv);
+        while (iov_index < iov.size() && written >= iov[iov_index].iov_len)
+        {
+            written -= iov[iov_index].iov_len;
+            iov_index++;
+        }
+        if (iov_index < iov.size())
+        {
+            iov[iov_index].iov_base = static_cast<char*>(iov[iov_index].iov_base) + written;
+            iov[iov_index].iov_len -= written;
+        }
+#ifdef RSID_DEBUG_SERIAL
+        LOG_DEBUG(LOG_TAG, "[snd] Sent %zu/%zu", bytes_sent, n_bytes);
+#endif
+    }
+    ::tcdrain(_handle);
+    assert(n_bytes == bytes_sent);
+
+    return SerialStatus::Ok;
+}
+
 // receive all bytes and copy to the buffer or return error status
 SerialStatus LinuxSerial::RecvBytes(char* buffer, size_t n_bytes)
 {
@@ -146,36 +247,120 @@ SerialStatus LinuxSerial::RecvBytes(char* buffer, size_t n_bytes)
 
     // set timeout to depend on number of bytes needed
     Timer timer {std::chrono::milliseconds {200 + 4 * n_bytes}};
-    unsigned int total_bytes_read = 0;
-    while (!timer.ReachedTimeout())
+    auto status = _recv_buffer.Recv(buffer, n_bytes, timer);
+    if (status == SerialStatus::RecvTimeout && n_bytes != 1)
+    {
+        LOG_DEBUG(LOG_TAG, "Timeout recv %zu bytes. Got only %zu bytes", n_bytes, _recv_buffer.Size());
+    }
+    return status;
+}
+
+SerialStatus LinuxSerial::RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout)
+{
+    n_bytes = 0;
+    if (_reactor)
     {
-        unsigned char* buf_ptr = (unsigned char*)buffer + total_bytes_read;
-        auto last_read_result = read(_handle, (void*)buf_ptr, n_bytes - total_bytes_read);
-        if (last_read_result > 0)
+        return RecvFromReactor(buffer, max_bytes, n_bytes, timeout);
+    }
+
+    // sleep in poll() until bytes arrive or the deadline passes
+    Timer timer {timeout};
+    struct pollfd poll_fd = {_handle, POLLIN, 0};
+    while (true)
+    {
+        auto time_left = std::max(timer.TimeLeft().count(), static_cast<timeout_t::rep>(0));
+        int poll_timeout = static_cast<int>(std::min(time_left, static_cast<timeout_t::rep>(INT_MAX)));
+        int poll_rv = ::poll(&poll_fd, 1, poll_timeout);
+        if (poll_rv > 0)
+        {
+            break;
+        }
+        if (poll_rv == 0)
         {
-            DEBUG_SERIAL(LOG_TAG, "[rcv]", (const char*)buf_ptr, last_read_result);
-            total_bytes_read += last_read_result;
-
-            if (total_bytes_read >= n_bytes)
-            {
-                assert(n_bytes == total_bytes_read);
-                return SerialStatus::Ok;
-            }
+            return SerialStatus::RecvTimeout;
         }
-        else if (last_read_result < 0)
+        if (errno != EINTR)
         {
-            LOG_ERROR(LOG_TAG, "[rcv] rv=%d errorno %d", last_read_result, errno);
+            LOG_ERROR(LOG_TAG, "[rcv] poll failed. errno %d", errno);
             return SerialStatus::RecvFailed;
         }
     }
 
-    // reached here on timout
-    if (n_bytes != 1)
+    if (poll_fd.revents & (POLLERR | POLLNVAL))
     {
-        LOG_DEBUG(LOG_TAG, "Timeout recv %zu bytes. Got only %zu bytes", n_bytes, total_bytes_read);
+        LOG_ERROR(LOG_TAG, "[rcv] poll revents %d", poll_fd.revents);
+        return SerialStatus::RecvFailed;
+    }
+
+    // VMIN=0, VTIME=0: read() returns what is available without waiting
+    auto last_read_result = read(_handle, (void*)buffer, max_bytes);
+    if (last_read_result < 0)
+    {
+        LOG_ERROR(LOG_TAG, "[rcv] rv=%d errorno %d", last_read_result, errno);
+        return SerialStatus::RecvFailed;
     }
-    
-    return SerialStatus::RecvTimeout;
+    if (last_read_result == 0)
+    {
+        // hangup without data
+        return (poll_fd.revents & POLLHUP) ? SerialStatus::RecvFailed : SerialStatus::RecvTimeout;
+    }
+    SERIAL_RECEIVED(LOG_TAG, buffer, last_read_result);
+    n_bytes = static_cast<size_t>(last_read_result);
+    return SerialStatus::Ok;
+}
+
+void LinuxSerial::OnReadable(uint32_t events)
+{
+    std::lock_guard<std::mutex> lock {_input_mutex};
+    if (_input_size == _input.size())
+    {
+        // full, resumed once the reader consumed some
+        _input_armed = false;
+        _reactor->Arm(_handle, false);
+        return;
+    }
+
+    auto read_rv = ::read(_handle, _input.data() + _input_size, _input.size() - _input_size);
+    if (read_rv > 0)
+    {
+        SERIAL_RECEIVED(LOG_TAG, _input.data() + _input_size, read_rv);
+        _input_size += static_cast<size_t>(read_rv);
+        _input_cv.notify_one();
+        return;
+    }
+    const bool failed = read_rv < 0 ? (errno != EAGAIN && errno != EINTR) : (events & (EPOLLHUP | EPOLLERR)) != 0;
+    if (failed)
+    {
+        LOG_ERROR(LOG_TAG, "[rcv] rv=%zd errno %d events %u", read_rv, errno, events);
+        _input_failed = true;
+        _input_armed = false;
+        _reactor->Arm(_handle, false);
+        _input_cv.notify_one();
+    }
+}
+
+SerialStatus LinuxSerial::RecvFromReactor(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout)
+{
+    std::unique_lock<std::mutex> lock {_input_mutex};
+    if (!_input_cv.wait_for(lock, timeout, [this] { return _input_size > 0 || _input_failed; }))
+    {
+        return SerialStatus::RecvTimeout;
+    }
+    if (_input_size == 0)
+    {
+        return SerialStatus::RecvFailed;
+    }
+
+    n_bytes = std::min(max_bytes, _input_size);
+    ::memcpy(buffer, _input.data(), n_bytes);
+    _input_size -= n_bytes;
+    ::memmove(_input.data(), _input.data() + n_bytes, _input_size);
+    if (!_input_armed && !_input_failed)
+    {
+        _input_armed = true;
+        _reactor->Arm(_handle, true);
+    }
+    return SerialStatus::Ok;
 }
 } // namespace PacketManager
 } // namespace RealSenseID
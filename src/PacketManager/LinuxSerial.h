@@ -2,6 +2,12 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 #pragma once
 #include "SerialConnection.h"
+#include "IoReactor.h"
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace RealSenseID
 {
@@ -21,12 +27,30 @@ public:
     // send all bytes and return status
     SerialStatus SendBytes(const char* buffer, size_t n_bytes) final;
 
+    // send all segments with writev() and a single tcdrain()
+    SerialStatus SendBytesv(const SendBuffer* buffers, size_t n_buffers) final;
+
     // receive all bytes and copy to the buffer
     SerialStatus RecvBytes(char* buffer, size_t n_bytes) final;
 
+    // poll() up to the timeout and read() what is available, or wait for the bytes read by the I/O reactor
+    SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) final;
+
 private:
     SerialConfig _config;
     int _handle = -1;
+
+    // with SetIoReactor(): the reactor thread reads the port into _input, and stops reading while it is full
+    std::shared_ptr<IoReactor> _reactor;
+    std::mutex _input_mutex;
+    std::condition_variable _input_cv;
+    std::vector<char> _input;
+    size_t _input_size = 0;
+    bool _input_armed = true;
+    bool _input_failed = false;
+
+    void OnReadable(uint32_t events); // on the reactor thread
+    SerialStatus RecvFromReactor(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout);
 };
 } // namespace PacketManager
 } // namespace RealSenseID
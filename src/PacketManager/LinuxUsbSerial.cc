@@ -0,0 +1,308 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "LinuxUsbSerial.h"
+#include "Logger.h"
+#include "SerialCapture.h"
+#include "Timer.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+static const char* LOG_TAG = "LinuxUsbSerial";
+static const char* USB_PREFIX = "usb://";
+static const std::string SYSFS_TTY_PATH = "/sys/class/tty/";
+static constexpr timeout_t recv_packet_timeout {5000};
+static constexpr unsigned int send_timeout_ms = 1000;
+static constexpr unsigned int control_timeout_ms = 1000;
+// largest synchronous bulk-out transfer
+static constexpr size_t max_send_chunk = 16384;
+// queued bulk-in URBs, UsbBulkReader::SegmentSize each
+static constexpr size_t read_buffer_size = 8 * UsbBulkReader::SegmentSize;
+
+// cdc-acm class requests (to the control interface)
+static constexpr uint8_t CDC_REQUEST_TYPE = 0x21; // host to device, class, interface
+static constexpr uint8_t CDC_SET_LINE_CODING = 0x20;
+static constexpr uint8_t CDC_SET_CONTROL_LINE_STATE = 0x22;
+static constexpr uint16_t CDC_LINE_STATE_DTR_RTS = 0x3;
+static const char* CDC_DATA_INTERFACE_CLASS = "0a";
+
+static std::string ReadSysfsAttribute(const std::string& path)
+{
+    std::ifstream attribute_file(path);
+    std::string value;
+    std::getline(attribute_file, value);
+    return value;
+}
+
+static std::vector<std::string> ListDirectory(const std::string& path)
+{
+    std::vector<std::string> names;
+    DIR* dir = ::opendir(path.c_str());
+    if (dir == nullptr)
+        return names;
+    while (auto* entry = ::readdir(dir))
+    {
+        if (entry->d_name[0] != '.')
+            names.emplace_back(entry->d_name);
+    }
+    ::closedir(dir);
+    return names;
+}
+
+static int ParseHex(const std::string& value)
+{
+    return value.empty() ? -1 : static_cast<int>(std::strtol(value.c_str(), nullptr, 16));
+}
+
+// cdc class request to the interface, throws on failure
+static void ControlTransfer(int handle, uint8_t request, uint16_t value, int interface_number, void* data,
+                            uint16_t length)
+{
+    usbdevfs_ctrltransfer transfer;
+    ::memset(&transfer, 0, sizeof(transfer));
+    transfer.bRequestType = CDC_REQUEST_TYPE;
+    transfer.bRequest = request;
+    transfer.wValue = value;
+    transfer.wIndex = static_cast<uint16_t>(interface_number);
+    transfer.wLength = length;
+    transfer.timeout = control_timeout_ms;
+    transfer.data = data;
+    if (::ioctl(handle, USBDEVFS_CONTROL, &transfer) < 0)
+    {
+        throw std::runtime_error("Failed usb control request " + std::to_string(request) +
+                                 ". errno: " + std::to_string(errno));
+    }
+}
+
+// detach the kernel driver of the interface (if any). returns true if one was detached
+static bool DetachKernelDriver(int handle, int interface_number)
+{
+    usbdevfs_ioctl command;
+    command.ifno = interface_number;
+    command.ioctl_code = USBDEVFS_DISCONNECT;
+    command.data = nullptr;
+    return ::ioctl(handle, USBDEVFS_IOCTL, &command) == 0;
+}
+
+static void AttachKernelDriver(int handle, int interface_number)
+{
+    usbdevfs_ioctl command;
+    command.ifno = interface_number;
+    command.ioctl_code = USBDEVFS_CONNECT;
+    command.data = nullptr;
+    if (::ioctl(handle, USBDEVFS_IOCTL, &command) != 0)
+    {
+        LOG_WARNING(LOG_TAG, "Failed to reattach the kernel driver of interface %d. errno: %d", interface_number,
+                    errno);
+    }
+}
+
+bool LinuxUsbSerial::IsUsbPort(const char* port)
+{
+    return port != nullptr && ::strncmp(port, USB_PREFIX, ::strlen(USB_PREFIX)) == 0;
+}
+
+LinuxUsbSerial::LinuxUsbSerial(const SerialConfig& config)
+{
+    if (!IsUsbPort(config.port))
+    {
+        throw std::runtime_error("Invalid usb port, expected usb://<tty>");
+    }
+    std::string tty = config.port + ::strlen(USB_PREFIX);
+    auto last_slash = tty.rfind('/');
+    if (last_slash != std::string::npos)
+    {
+        tty.erase(0, last_slash + 1);
+    }
+
+    try
+    {
+        Open(tty, config.baudrate);
+    }
+    catch (...)
+    {
+        Close();
+        throw;
+    }
+    SERIAL_OPENED();
+}
+
+LinuxUsbSerial::~LinuxUsbSerial()
+{
+    Close();
+}
+
+void LinuxUsbSerial::Open(const std::string& tty, unsigned int baudrate)
+{
+    LOG_DEBUG(LOG_TAG, "Opening usb serial of %s baudrate %u", tty.c_str(), baudrate);
+
+    // the tty's device is its control interface, e.g. .../1-2/1-2:1.0, in the usb device's directory
+    char resolved[PATH_MAX];
+    if (tty.empty() || ::realpath((SYSFS_TTY_PATH + tty + "/device").c_str(), resolved) == nullptr)
+    {
+        throw std::runtime_error("Failed to find the usb device of " + tty);
+    }
+    const std::string control_path = resolved;
+    const std::string device_path = control_path.substr(0, control_path.rfind('/'));
+    _control_interface = ParseHex(ReadSysfsAttribute(control_path + "/bInterfaceNumber"));
+    const int bus = std::atoi(ReadSysfsAttribute(device_path + "/busnum").c_str());
+    const int address = std::atoi(ReadSysfsAttribute(device_path + "/devnum").c_str());
+    if (_control_interface < 0 || bus <= 0 || address <= 0)
+    {
+        throw std::runtime_error("Failed to read the usb device of " + tty);
+    }
+
+    // the data interface follows the control interface (cdc union)
+    const std::string data_path = control_path.substr(0, control_path.rfind('.') + 1) +
+                                  std::to_string(_control_interface + 1);
+    if (ReadSysfsAttribute(data_path + "/bInterfaceClass") != CDC_DATA_INTERFACE_CLASS)
+    {
+        throw std::runtime_error("No cdc data interface for " + tty);
+    }
+    const int data_interface = _control_interface + 1;
+    for (const auto& name : ListDirectory(data_path))
+    {
+        if (name.compare(0, 3, "ep_") != 0 || ReadSysfsAttribute(data_path + "/" + name + "/type") != "Bulk")
+            continue;
+        const int endpoint_address = ParseHex(ReadSysfsAttribute(data_path + "/" + name + "/bEndpointAddress"));
+        if (ReadSysfsAttribute(data_path + "/" + name + "/direction") == "in")
+            _read_endpoint_address = endpoint_address;
+        else
+            _write_endpoint_address = endpoint_address;
+    }
+    if (_read_endpoint_address < 0 || _write_endpoint_address < 0)
+    {
+        throw std::runtime_error("No bulk endpoints in the cdc data interface of " + tty);
+    }
+
+    char usbfs_path[64];
+    ::snprintf(usbfs_path, sizeof(usbfs_path), "/dev/bus/usb/%03d/%03d", bus, address);
+    _handle = ::open(usbfs_path, O_RDWR | O_CLOEXEC);
+    if (_handle < 0)
+    {
+        throw std::runtime_error(std::string("Failed to open ") + usbfs_path + ". errno: " + std::to_string(errno));
+    }
+
+    // cdc_acm holds both interfaces, detaching it from the control interface releases the data interface too
+    _detached = DetachKernelDriver(_handle, _control_interface);
+    DetachKernelDriver(_handle, data_interface);
+    _data_interface = data_interface;
+    for (int interface_number : {_control_interface, _data_interface})
+    {
+        unsigned int claimed = static_cast<unsigned int>(interface_number);
+        if (::ioctl(_handle, USBDEVFS_CLAIMINTERFACE, &claimed) != 0)
+        {
+            throw std::runtime_error("Failed to claim usb interface " + std::to_string(interface_number) +
+                                     ". errno: " + std::to_string(errno));
+        }
+    }
+
+    // as the tty does on open: line coding (8N1 at the baud rate) and DTR/RTS
+    uint8_t line_coding[7] = {static_cast<uint8_t>(baudrate), static_cast<uint8_t>(baudrate >> 8),
+                              static_cast<uint8_t>(baudrate >> 16), static_cast<uint8_t>(baudrate >> 24), 0, 0, 8};
+    ControlTransfer(_handle, CDC_SET_LINE_CODING, 0, _control_interface, line_coding, sizeof(line_coding));
+    ControlTransfer(_handle, CDC_SET_CONTROL_LINE_STATE, CDC_LINE_STATE_DTR_RTS, _control_interface, nullptr, 0);
+
+    _bulk_reader = std::make_unique<UsbBulkReader>(_handle, _read_endpoint_address, read_buffer_size);
+    if (!_bulk_reader->Start())
+    {
+        throw std::runtime_error("Failed to start the usb bulk reader");
+    }
+}
+
+void LinuxUsbSerial::Close()
+{
+    _bulk_reader.reset();
+    if (_handle < 0)
+    {
+        return;
+    }
+    // releasing an interface which was not claimed fails harmlessly
+    for (int interface_number : {_data_interface, _control_interface})
+    {
+        if (interface_number >= 0)
+        {
+            unsigned int claimed = static_cast<unsigned int>(interface_number);
+            ::ioctl(_handle, USBDEVFS_RELEASEINTERFACE, &claimed);
+        }
+    }
+    if (_detached)
+    {
+        AttachKernelDriver(_handle, _control_interface);
+    }
+    ::close(_handle);
+    _handle = -1;
+}
+
+SerialStatus LinuxUsbSerial::SendBytes(const char* buffer, size_t n_bytes)
+{
+    size_t bytes_sent = 0;
+    while (bytes_sent < n_bytes)
+    {
+        usbdevfs_bulktransfer transfer;
+        ::memset(&transfer, 0, sizeof(transfer));
+        transfer.ep = static_cast<unsigned int>(_write_endpoint_address);
+        transfer.len = static_cast<unsigned int>(std::min(n_bytes - bytes_sent, max_send_chunk));
+        transfer.timeout = send_timeout_ms;
+        transfer.data = const_cast<char*>(buffer + bytes_sent);
+        int rv = ::ioctl(_handle, USBDEVFS_BULK, &transfer);
+        if (rv < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            LOG_ERROR(LOG_TAG, "Error while sending %zu bytes. errno=%d, sent so far: %zu", n_bytes, errno,
+                      bytes_sent);
+            return SerialStatus::SendFailed;
+        }
+        bytes_sent += static_cast<size_t>(rv);
+    }
+    SERIAL_SENT(LOG_TAG, buffer, n_bytes);
+    return SerialStatus::Ok;
+}
+
+SerialStatus LinuxUsbSerial::RecvBytes(char* buffer, size_t n_bytes)
+{
+    if (n_bytes == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Attempt to recv 0 bytes");
+        return SerialStatus::RecvFailed;
+    }
+
+    Timer timer {recv_packet_timeout};
+    auto status = _recv_buffer.Recv(buffer, n_bytes, timer);
+    if (status == SerialStatus::RecvTimeout)
+    {
+        LOG_DEBUG(LOG_TAG, "Timeout recv %zu bytes. Got only %zu bytes", n_bytes, _recv_buffer.Size());
+    }
+    return status;
+}
+
+SerialStatus LinuxUsbSerial::RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout)
+{
+    n_bytes = _bulk_reader->Read(buffer, max_bytes, timeout);
+    if (n_bytes == 0)
+    {
+        return SerialStatus::RecvTimeout;
+    }
+    SERIAL_RECEIVED(LOG_TAG, buffer, n_bytes);
+    return SerialStatus::Ok;
+}
+} // namespace PacketManager
+} // namespace RealSenseID
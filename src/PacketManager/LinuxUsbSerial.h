@@ -0,0 +1,52 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+#include "SerialConnection.h"
+#include "UsbBulkReader.h"
+#include <memory>
+#include <string>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// Serial connection over the bulk endpoints of the device's CDC-ACM data interface (usbfs), bypassing the tty layer
+// (line discipline, the cdc_acm driver's buffering and VTIME polling). Reads are queued URBs (UsbBulkReader), as
+// AndroidSerial does. The cdc_acm driver is detached from the device while connected and reattached on destruction.
+class LinuxUsbSerial : public SerialConnection
+{
+public:
+    // config.port is "usb://<tty>", e.g. "usb:///dev/ttyACM0" or "usb://ttyACM0" (the tty of the device while it is
+    // not connected). The baud rate is set on the device as the tty would (SET_LINE_CODING).
+    explicit LinuxUsbSerial(const SerialConfig& config);
+    ~LinuxUsbSerial() override;
+
+    LinuxUsbSerial(const LinuxUsbSerial&) = delete;
+    LinuxUsbSerial& operator=(const LinuxUsbSerial&) = delete;
+
+    // true if the port is a "usb://" one
+    static bool IsUsbPort(const char* port);
+
+    // send all bytes with synchronous bulk transfers
+    SerialStatus SendBytes(const char* buffer, size_t n_bytes) final;
+
+    // receive all bytes and copy to the buffer
+    SerialStatus RecvBytes(char* buffer, size_t n_bytes) final;
+
+    // what the queued bulk-in URBs received, waits up to the timeout for data
+    SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) final;
+
+private:
+    int _handle = -1;
+    int _control_interface = -1;
+    int _data_interface = -1;
+    int _read_endpoint_address = -1;
+    int _write_endpoint_address = -1;
+    bool _detached = false; // cdc_acm was bound, reattach on close
+    std::unique_ptr<UsbBulkReader> _bulk_reader;
+
+    void Open(const std::string& tty, unsigned int baudrate);
+    void Close();
+};
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,112 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#include "LoopbackSerial.h"
+#include "Timer.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+
+static const char* LOG_TAG = "LoopbackSerial";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+LoopbackSerial::Pair LoopbackSerial::CreatePair()
+{
+    auto first_to_second = std::make_shared<Channel>();
+    auto second_to_first = std::make_shared<Channel>();
+    std::unique_ptr<LoopbackSerial> first {new LoopbackSerial(first_to_second, second_to_first)};
+    std::unique_ptr<LoopbackSerial> second {new LoopbackSerial(second_to_first, first_to_second)};
+    return Pair {std::move(first), std::move(second)};
+}
+
+LoopbackSerial::LoopbackSerial(std::shared_ptr<Channel> send, std::shared_ptr<Channel> recv) :
+    _send {std::move(send)}, _recv {std::move(recv)}
+{
+}
+
+LoopbackSerial::~LoopbackSerial()
+{
+    Close();
+}
+
+void LoopbackSerial::CloseChannel(Channel& channel)
+{
+    {
+        std::lock_guard<std::mutex> lock {channel.mutex};
+        channel.closed = true;
+    }
+    channel.cv.notify_all();
+}
+
+void LoopbackSerial::Close()
+{
+    CloseChannel(*_send);
+    CloseChannel(*_recv);
+}
+
+SerialStatus LoopbackSerial::SendBytes(const char* buffer, size_t n_bytes)
+{
+    SendBuffer send_buffer {buffer, n_bytes};
+    return SendBytesv(&send_buffer, 1);
+}
+
+// the segments are appended under one lock, so they arrive together
+SerialStatus LoopbackSerial::SendBytesv(const SendBuffer* buffers, size_t n_buffers)
+{
+    {
+        std::lock_guard<std::mutex> lock {_send->mutex};
+        if (_send->closed)
+        {
+            LOG_ERROR(LOG_TAG, "Failed sending, connection closed");
+            return SerialStatus::SendFailed;
+        }
+        auto& data = _send->data;
+        for (size_t i = 0; i < n_buffers; i++)
+        {
+            data.insert(data.end(), buffers[i].buffer, buffers[i].buffer + buffers[i].n_bytes);
+        }
+    }
+    _send->cv.notify_all();
+    return SerialStatus::Ok;
+}
+
+SerialStatus LoopbackSerial::RecvBytes(char* buffer, size_t n_bytes)
+{
+    if (n_bytes == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Attempt to recv 0 bytes");
+        return SerialStatus::RecvFailed;
+    }
+    Timer timer {std::chrono::milliseconds {200 + 4 * n_bytes}};
+    return _recv_buffer.Recv(buffer, n_bytes, timer);
+}
+
+SerialStatus LoopbackSerial::RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout)
+{
+    n_bytes = 0;
+    auto& channel = *_recv;
+    std::unique_lock<std::mutex> lock {channel.mutex};
+    auto has_bytes = [&channel] { return channel.begin < channel.data.size() || channel.closed; };
+    if (!channel.cv.wait_for(lock, timeout, has_bytes))
+    {
+        return SerialStatus::RecvTimeout;
+    }
+    if (channel.begin == channel.data.size())
+    {
+        return SerialStatus::RecvFailed; // closed
+    }
+
+    n_bytes = std::min(max_bytes, channel.data.size() - channel.begin);
+    ::memcpy(buffer, channel.data.data() + channel.begin, n_bytes);
+    channel.begin += n_bytes;
+    if (channel.begin == channel.data.size())
+    {
+        channel.data.clear();
+        channel.begin = 0;
+    }
+    return SerialStatus::Ok;
+}
+} // namespace PacketManager
+} // namespace RealSenseID
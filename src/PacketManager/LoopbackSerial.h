@@ -0,0 +1,61 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+#include "SerialConnection.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// In-process serial connection: the bytes sent on one end of a pair arrive at the other end. Connects the host to a
+// DeviceEmulator running in the same process (see EmulatorSerial.h).
+// Once an end is closed (or destroyed) the receives of both ends fail after the bytes sent before were read.
+class LoopbackSerial : public SerialConnection
+{
+public:
+    using Pair = std::pair<std::unique_ptr<LoopbackSerial>, std::unique_ptr<LoopbackSerial>>;
+
+    // the two ends of a new connection
+    static Pair CreatePair();
+
+    ~LoopbackSerial();
+
+    LoopbackSerial(const LoopbackSerial&) = delete;
+    LoopbackSerial operator=(const LoopbackSerial&) = delete;
+
+    SerialStatus SendBytes(const char* buffer, size_t n_bytes) final;
+
+    SerialStatus SendBytesv(const SendBuffer* buffers, size_t n_buffers) final;
+
+    SerialStatus RecvBytes(char* buffer, size_t n_bytes) final;
+
+    SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) final;
+
+    // close the connection for both ends
+    void Close();
+
+private:
+    // the bytes of one direction
+    struct Channel
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<char> data;
+        size_t begin = 0; // of the bytes not yet received
+        bool closed = false;
+    };
+
+    std::shared_ptr<Channel> _send;
+    std::shared_ptr<Channel> _recv;
+
+    LoopbackSerial(std::shared_ptr<Channel> send, std::shared_ptr<Channel> recv);
+
+    static void CloseChannel(Channel& channel);
+};
+} // namespace PacketManager
+} // namespace RealSenseID
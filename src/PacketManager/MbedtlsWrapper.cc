@@ -3,38 +3,121 @@
 
 #include "MbedtlsWrapper.h"
 #include "Logger.h"
+#include <algorithm>
+#include <mutex>
 #include <string.h>
 
 static const char* LOG_TAG = "MbedtlsWrapper";
 static const char* SALT_AES = "aes";
 static const char* SALT_HMAC = "hmac";
+static const std::chrono::seconds DEFAULT_KEY_LIFETIME {3600};
+// payload bytes encrypted (decrypted) and hashed per step of the single pass packet crypto, small enough to stay in L1
+static const unsigned int CRYPTO_CHUNK_SIZE = 256;
 
 namespace RealSenseID
 {
 namespace PacketManager
 {
+namespace
+{
+// CTR-DRBG of all the wrappers, seeded from the entropy sources on first use. mbedtls contexts are not thread safe,
+// so the generator is locked for each request.
+class SharedDrbg
+{
+public:
+    // mbedtls f_rng, p_rng unused
+    static int Random(void*, unsigned char* output, size_t length)
+    {
+        static SharedDrbg drbg;
+        return drbg.Generate(output, length);
+    }
+
+private:
+    std::mutex _mutex;
+    bool _seeded = false;
+    mbedtls_entropy_context _entropy_ctx;
+    mbedtls_ctr_drbg_context _ctr_drbg_ctx;
+
+    SharedDrbg()
+    {
+        mbedtls_entropy_init(&_entropy_ctx);
+        mbedtls_ctr_drbg_init(&_ctr_drbg_ctx);
+    }
+
+    ~SharedDrbg()
+    {
+        mbedtls_ctr_drbg_free(&_ctr_drbg_ctx);
+        mbedtls_entropy_free(&_entropy_ctx);
+    }
+
+    int Generate(unsigned char* output, size_t length)
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (!_seeded)
+        {
+            int ret = mbedtls_ctr_drbg_seed(&_ctr_drbg_ctx, mbedtls_entropy_func, &_entropy_ctx, NULL, 0);
+            if (ret != 0)
+            {
+                LOG_ERROR(LOG_TAG, "Failed! mbedtls_ctr_drbg_seed returned %d", ret);
+                return ret;
+            }
+            _seeded = true;
+        }
+        return mbedtls_ctr_drbg_random(&_ctr_drbg_ctx, output, length);
+    }
+};
+} // namespace
+
 MbedtlsWrapper::MbedtlsWrapper() :
-    _ecdh_generate_key {false}, _shared_secret {}, _aes_key {}, _hmac_key {}, _ecdh_signed_pubkey {}
+    _ecdh_generate_key {false}, _ecdh_group_loaded {false}, _packet_contexts_ready {false},
+    _signed_pubkey_valid {false}, _shared_secret_valid {false}, _key_lifetime {DEFAULT_KEY_LIFETIME},
+    _shared_secret {}, _aes_key {}, _hmac_key {}, _ecdh_signed_pubkey {}, _device_signed_pubkey {}
 {
-    mbedtls_entropy_init(&_entropy_ctx);
-    mbedtls_ctr_drbg_init(&_ctr_drbg_ctx);
+    // init only clears the contexts, nothing is allocated until the first session
     mbedtls_ecdh_init(&_edch_ctx);
     mbedtls_aes_init(&_aes_ctx);
     _md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+#ifdef RSID_SECURE_OPENSSL
+    _evp_aes_ctx = nullptr;
+    _evp_hmac_inner_ctx = nullptr;
+    _evp_hmac_outer_ctx = nullptr;
+    _evp_hmac_ctx = nullptr;
+#else
+    _ctr_offset = 0;
+    ::memset(_ctr_counter, 0, sizeof(_ctr_counter));
+    ::memset(_ctr_stream_block, 0, sizeof(_ctr_stream_block));
+    mbedtls_md_init(&_hmac_ctx);
+#endif // RSID_SECURE_OPENSSL
 }
 
 MbedtlsWrapper::~MbedtlsWrapper()
 {
-    mbedtls_entropy_free(&_entropy_ctx);
-    mbedtls_ctr_drbg_free(&_ctr_drbg_ctx);
     mbedtls_ecdh_free(&_edch_ctx);
     mbedtls_aes_free(&_aes_ctx);
+#ifdef RSID_SECURE_OPENSSL
+    // null safe
+    EVP_CIPHER_CTX_free(_evp_aes_ctx);
+    EVP_MD_CTX_free(_evp_hmac_inner_ctx);
+    EVP_MD_CTX_free(_evp_hmac_outer_ctx);
+    EVP_MD_CTX_free(_evp_hmac_ctx);
+#else
+    mbedtls_md_free(&_hmac_ctx);
+#endif // RSID_SECURE_OPENSSL
+}
+
+void MbedtlsWrapper::SetKeyLifetime(std::chrono::seconds lifetime)
+{
+    _key_lifetime = lifetime;
 }
 
-void MbedtlsWrapper::Reset()
+void MbedtlsWrapper::ClearKeyCache()
 {
+    _ecdh_generate_key = false;
+    _signed_pubkey_valid = false;
+    _shared_secret_valid = false;
     ::memset(_shared_secret, 0, sizeof(_shared_secret));
     ::memset(_ecdh_signed_pubkey, 0, sizeof(_ecdh_signed_pubkey));
+    ::memset(_device_signed_pubkey, 0, sizeof(_device_signed_pubkey));
 }
 
 bool MbedtlsWrapper::IsMaEnabled(bool& isMaEnabled)
@@ -54,7 +137,11 @@ size_t MbedtlsWrapper::GetSignedEcdhPubkeySize()
 
 unsigned char* MbedtlsWrapper::GetSignedEcdhPubkey(SignCallback sign_clbk)
 {
-    Reset();
+    // forward secrecy: replace the key pair once its lifetime is over
+    if (_ecdh_generate_key && std::chrono::steady_clock::now() - _ecdh_key_time >= _key_lifetime)
+    {
+        ClearKeyCache();
+    }
 
     if (!GenerateEcdhKey())
     {
@@ -62,6 +149,12 @@ unsigned char* MbedtlsWrapper::GetSignedEcdhPubkey(SignCallback sign_clbk)
         return nullptr;
     }
 
+    // same key pair - the signature is still valid
+    if (_signed_pubkey_valid)
+    {
+        return _ecdh_signed_pubkey;
+    }
+
     int ret = mbedtls_mpi_write_binary(&_edch_ctx.Q.X, _ecdh_signed_pubkey, ECC_P256_KEY_X_Y_Z_SIZE_BYTES);
     if (ret != 0)
     {
@@ -84,11 +177,21 @@ unsigned char* MbedtlsWrapper::GetSignedEcdhPubkey(SignCallback sign_clbk)
         return nullptr;
     }
 
+    _signed_pubkey_valid = true;
     return _ecdh_signed_pubkey;
 }
 
 bool MbedtlsWrapper::VerifyEcdhSignedKey(const unsigned char* ecdh_signed_pubkey, VerifyCallback verify_clbk)
 {
+    // same (already verified) device key and same host key - the shared secret and the derived keys are unchanged
+    if (_shared_secret_valid && _ecdh_generate_key &&
+        ::memcmp(ecdh_signed_pubkey, _device_signed_pubkey, sizeof(_device_signed_pubkey)) == 0)
+    {
+        LOG_DEBUG(LOG_TAG, "Reusing shared secret");
+        return true;
+    }
+    _shared_secret_valid = false;
+
     int ret = mbedtls_mpi_lset(&_edch_ctx.Qp.Z, 1);
     if (ret != 0)
     {
@@ -126,7 +229,7 @@ bool MbedtlsWrapper::VerifyEcdhSignedKey(const unsigned char* ecdh_signed_pubkey
     }
 
     ret = mbedtls_ecdh_compute_shared(&_edch_ctx.grp, &_edch_ctx.z, &_edch_ctx.Qp, &_edch_ctx.d,
-                                      mbedtls_ctr_drbg_random, &_ctr_drbg_ctx);
+                                      SharedDrbg::Random, nullptr);
     if (ret != 0)
     {
         LOG_ERROR(LOG_TAG, "Failed! mbedtls_ecdh_compute_shared returned %d", ret);
@@ -148,98 +251,361 @@ bool MbedtlsWrapper::VerifyEcdhSignedKey(const unsigned char* ecdh_signed_pubkey
         return false;
     }
 
-    ret = mbedtls_aes_setkey_enc(&_aes_ctx, _aes_key, AES_CTR_256_BIT_KEY_SIZE_BYTES * 8);
+    ret = mbedtls_hkdf(_md, (unsigned char*)SALT_HMAC, strlen(SALT_HMAC), _shared_secret, ECC_P256_KEY_X_Y_Z_SIZE_BYTES,
+                       0, 0, _hmac_key, ECC_P256_KEY_X_Y_Z_SIZE_BYTES);
     if (ret != 0)
     {
-        LOG_ERROR(LOG_TAG, "Failed! mbedtls_aes_setkey_enc returned %d", ret);
+        LOG_ERROR(LOG_TAG, "Failed! mbedtls_hkdf 1 returned %d", ret);
         return false;
     }
 
-    ret = mbedtls_hkdf(_md, (unsigned char*)SALT_HMAC, strlen(SALT_HMAC), _shared_secret, ECC_P256_KEY_X_Y_Z_SIZE_BYTES,
-                       0, 0, _hmac_key, ECC_P256_KEY_X_Y_Z_SIZE_BYTES);
-    if (ret != 0)
+    if (!SetupPacketKeys())
     {
-        LOG_ERROR(LOG_TAG, "Failed! mbedtls_hkdf 1 returned %d", ret);
         return false;
     }
 
+    ::memcpy(_device_signed_pubkey, ecdh_signed_pubkey, sizeof(_device_signed_pubkey));
+    _shared_secret_valid = true;
     return true;
 }
 
-bool MbedtlsWrapper::Encrypt(const unsigned char* iv, const unsigned char* input, unsigned char* output,
-                             const unsigned int length)
+bool MbedtlsWrapper::Encrypt(const unsigned char* iv, unsigned char* data, const unsigned int length)
 {
-    bool res = AesCtr256(iv, input, output, length);
-    return res;
+    return AesCtrStart(iv) && AesCtrUpdate(data, length);
 }
 
-bool MbedtlsWrapper::Decrypt(const unsigned char* iv, const unsigned char* input, unsigned char* output,
-                             const unsigned int length)
+bool MbedtlsWrapper::Decrypt(const unsigned char* iv, unsigned char* data, const unsigned int length)
 {
-    bool res = AesCtr256(iv, input, output, length);
-    return res;
+    return AesCtrStart(iv) && AesCtrUpdate(data, length);
 }
 
 bool MbedtlsWrapper::CalcHmac(const unsigned char* input, const unsigned int length, unsigned char* hmac)
 {
-    int ret = mbedtls_md_hmac(_md, _hmac_key, ECC_P256_KEY_X_Y_Z_SIZE_BYTES, input, length, hmac);
+    return HmacStart() && HmacUpdate(input, length) && HmacFinish(hmac);
+}
+
+bool MbedtlsWrapper::EncryptAndHmac(const unsigned char* iv, const unsigned char* header,
+                                    const unsigned int header_size, unsigned char* payload,
+                                    const unsigned int payload_size, unsigned char* hmac)
+{
+    if (!AesCtrStart(iv) || !HmacStart() || !HmacUpdate(header, header_size))
+    {
+        return false;
+    }
+    for (unsigned int offset = 0; offset < payload_size; offset += CRYPTO_CHUNK_SIZE)
+    {
+        const unsigned int chunk = std::min(CRYPTO_CHUNK_SIZE, payload_size - offset);
+        if (!AesCtrUpdate(payload + offset, chunk) || !HmacUpdate(payload + offset, chunk))
+        {
+            return false;
+        }
+    }
+    return HmacFinish(hmac);
+}
+
+bool MbedtlsWrapper::HmacAndDecrypt(const unsigned char* iv, const unsigned char* header,
+                                    const unsigned int header_size, unsigned char* payload,
+                                    const unsigned int payload_size, unsigned char* hmac)
+{
+    if (!AesCtrStart(iv) || !HmacStart() || !HmacUpdate(header, header_size))
+    {
+        return false;
+    }
+    for (unsigned int offset = 0; offset < payload_size; offset += CRYPTO_CHUNK_SIZE)
+    {
+        const unsigned int chunk = std::min(CRYPTO_CHUNK_SIZE, payload_size - offset);
+        if (!HmacUpdate(payload + offset, chunk) || !AesCtrUpdate(payload + offset, chunk))
+        {
+            return false;
+        }
+    }
+    return HmacFinish(hmac);
+}
+
+bool MbedtlsWrapper::GcmEncrypt(const unsigned char* key, const unsigned char* iv, const unsigned char* aad,
+                                size_t aad_size, unsigned char* data, size_t length, unsigned char* tag)
+{
+#ifdef RSID_SECURE_OPENSSL
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int out_length = 0;
+    bool ok = ctx != nullptr && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, iv) &&
+              (aad_size == 0 || EVP_EncryptUpdate(ctx, nullptr, &out_length, aad, static_cast<int>(aad_size))) &&
+              (length == 0 || EVP_EncryptUpdate(ctx, data, &out_length, data, static_cast<int>(length))) &&
+              EVP_EncryptFinal_ex(ctx, data + length, &out_length) &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AES_GCM_TAG_SIZE_BYTES, tag);
+    EVP_CIPHER_CTX_free(ctx);
+    if (!ok)
+    {
+        LOG_ERROR(LOG_TAG, "Failed! EVP aes-256-gcm encryption failed");
+    }
+    return ok;
+#else
+    mbedtls_gcm_context ctx;
+    mbedtls_gcm_init(&ctx);
+    int ret = mbedtls_gcm_setkey(&ctx, MBEDTLS_CIPHER_ID_AES, key, AES_CTR_256_BIT_KEY_SIZE_BYTES * 8);
+    if (ret == 0)
+    {
+        ret = mbedtls_gcm_crypt_and_tag(&ctx, MBEDTLS_GCM_ENCRYPT, length, iv, AES_GCM_IV_SIZE_BYTES, aad, aad_size,
+                                        data, data, AES_GCM_TAG_SIZE_BYTES, tag);
+    }
+    mbedtls_gcm_free(&ctx);
+    if (ret != 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed! mbedtls_gcm_crypt_and_tag returned %d", ret);
+    }
+    return ret == 0;
+#endif // RSID_SECURE_OPENSSL
+}
+
+bool MbedtlsWrapper::GcmDecrypt(const unsigned char* key, const unsigned char* iv, const unsigned char* aad,
+                                size_t aad_size, unsigned char* data, size_t length, const unsigned char* tag)
+{
+#ifdef RSID_SECURE_OPENSSL
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int out_length = 0;
+    bool ok = ctx != nullptr && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, iv) &&
+              (aad_size == 0 || EVP_DecryptUpdate(ctx, nullptr, &out_length, aad, static_cast<int>(aad_size))) &&
+              (length == 0 || EVP_DecryptUpdate(ctx, data, &out_length, data, static_cast<int>(length))) &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, AES_GCM_TAG_SIZE_BYTES,
+                                  const_cast<unsigned char*>(tag)) &&
+              EVP_DecryptFinal_ex(ctx, data + length, &out_length) > 0;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+#else
+    mbedtls_gcm_context ctx;
+    mbedtls_gcm_init(&ctx);
+    int ret = mbedtls_gcm_setkey(&ctx, MBEDTLS_CIPHER_ID_AES, key, AES_CTR_256_BIT_KEY_SIZE_BYTES * 8);
+    if (ret == 0)
+    {
+        // the tag is compared in constant time
+        ret = mbedtls_gcm_auth_decrypt(&ctx, length, iv, AES_GCM_IV_SIZE_BYTES, aad, aad_size, tag,
+                                       AES_GCM_TAG_SIZE_BYTES, data, data);
+    }
+    mbedtls_gcm_free(&ctx);
+    return ret == 0;
+#endif // RSID_SECURE_OPENSSL
+}
+
+bool MbedtlsWrapper::RandomBytes(unsigned char* output, size_t length)
+{
+    return SharedDrbg::Random(nullptr, output, length) == 0;
+}
+
+bool MbedtlsWrapper::InitPacketContexts()
+{
+    if (_packet_contexts_ready)
+        return true;
+
+#ifdef RSID_SECURE_OPENSSL
+    _evp_aes_ctx = EVP_CIPHER_CTX_new();
+    _evp_hmac_inner_ctx = EVP_MD_CTX_new();
+    _evp_hmac_outer_ctx = EVP_MD_CTX_new();
+    _evp_hmac_ctx = EVP_MD_CTX_new();
+    if (!_evp_aes_ctx || !_evp_hmac_inner_ctx || !_evp_hmac_outer_ctx || !_evp_hmac_ctx)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to allocate the EVP contexts");
+        return false;
+    }
+#else
+    int ret = mbedtls_md_setup(&_hmac_ctx, _md, 1);
     if (ret != 0)
     {
-        LOG_ERROR(LOG_TAG, "Failed! mbedtls_hkdf returned %d", ret);
+        LOG_ERROR(LOG_TAG, "Failed! mbedtls_md_setup returned %d", ret);
         return false;
     }
+#endif // RSID_SECURE_OPENSSL
+    _packet_contexts_ready = true;
     return true;
 }
 
-bool MbedtlsWrapper::GenerateEcdhKey()
+bool MbedtlsWrapper::SetupPacketKeys()
 {
-    if (_ecdh_generate_key)
-        return true;
+    if (!InitPacketContexts())
+    {
+        return false;
+    }
+
+#ifdef RSID_SECURE_OPENSSL
+    if (!EVP_EncryptInit_ex(_evp_aes_ctx, EVP_aes_256_ctr(), nullptr, _aes_key, nullptr))
+    {
+        LOG_ERROR(LOG_TAG, "Failed! EVP_EncryptInit_ex aes-256-ctr failed");
+        return false;
+    }
 
-    int ret = mbedtls_ctr_drbg_seed(&_ctr_drbg_ctx, mbedtls_entropy_func, &_entropy_ctx, NULL, 0);
+    // hmac key is shorter than the sha256 block, pad it with zeros (RFC 2104)
+    static const size_t sha256_block_size = 64;
+    static_assert(sizeof(_hmac_key) <= sha256_block_size, "HMAC key must fit in one block");
+    unsigned char inner_pad[sha256_block_size];
+    unsigned char outer_pad[sha256_block_size];
+    ::memset(inner_pad, 0x36, sizeof(inner_pad));
+    ::memset(outer_pad, 0x5c, sizeof(outer_pad));
+    for (size_t i = 0; i < sizeof(_hmac_key); i++)
+    {
+        inner_pad[i] ^= _hmac_key[i];
+        outer_pad[i] ^= _hmac_key[i];
+    }
+    bool ok = EVP_DigestInit_ex(_evp_hmac_inner_ctx, EVP_sha256(), nullptr) &&
+              EVP_DigestUpdate(_evp_hmac_inner_ctx, inner_pad, sizeof(inner_pad)) &&
+              EVP_DigestInit_ex(_evp_hmac_outer_ctx, EVP_sha256(), nullptr) &&
+              EVP_DigestUpdate(_evp_hmac_outer_ctx, outer_pad, sizeof(outer_pad));
+    ::memset(inner_pad, 0, sizeof(inner_pad));
+    ::memset(outer_pad, 0, sizeof(outer_pad));
+    if (!ok)
+    {
+        LOG_ERROR(LOG_TAG, "Failed! HMAC-SHA256 key setup failed");
+        return false;
+    }
+    return true;
+#else
+    int ret = mbedtls_aes_setkey_enc(&_aes_ctx, _aes_key, AES_CTR_256_BIT_KEY_SIZE_BYTES * 8);
     if (ret != 0)
     {
-        LOG_ERROR(LOG_TAG, "Failed! mbedtls_ctr_drbg_seed returned %d", ret);
+        LOG_ERROR(LOG_TAG, "Failed! mbedtls_aes_setkey_enc returned %d", ret);
         return false;
     }
 
-    ret = mbedtls_ecp_group_load(&_edch_ctx.grp, MBEDTLS_ECP_DP_SECP256R1);
+    ret = mbedtls_md_hmac_starts(&_hmac_ctx, _hmac_key, ECC_P256_KEY_X_Y_Z_SIZE_BYTES);
     if (ret != 0)
     {
-        LOG_ERROR(LOG_TAG, "Failed! mbedtls_ecp_group_load returned %d", ret);
+        LOG_ERROR(LOG_TAG, "Failed! mbedtls_md_hmac_starts returned %d", ret);
         return false;
     }
+    return true;
+#endif // RSID_SECURE_OPENSSL
+}
+
+bool MbedtlsWrapper::GenerateEcdhKey()
+{
+    if (_ecdh_generate_key)
+        return true;
+
+    int ret = 0;
+    if (!_ecdh_group_loaded)
+    {
+        ret = mbedtls_ecp_group_load(&_edch_ctx.grp, MBEDTLS_ECP_DP_SECP256R1);
+        if (ret != 0)
+        {
+            LOG_ERROR(LOG_TAG, "Failed! mbedtls_ecp_group_load returned %d", ret);
+            return false;
+        }
+        _ecdh_group_loaded = true;
+    }
 
-    ret = mbedtls_ecdh_gen_public(&_edch_ctx.grp, &_edch_ctx.d, &_edch_ctx.Q, mbedtls_ctr_drbg_random, &_ctr_drbg_ctx);
+    ret = mbedtls_ecdh_gen_public(&_edch_ctx.grp, &_edch_ctx.d, &_edch_ctx.Q, SharedDrbg::Random, nullptr);
     if (ret != 0)
     {
         LOG_ERROR(LOG_TAG, "Failed! mbedtls_ecdh_gen_public returned %d", ret);
         return false;
     }
 
+    _ecdh_key_time = std::chrono::steady_clock::now();
     _ecdh_generate_key = true;
     return true;
 }
 
-bool MbedtlsWrapper::AesCtr256(const unsigned char* iv, const unsigned char* input, unsigned char* output,
-                               const unsigned int length)
+bool MbedtlsWrapper::AesCtrStart(const unsigned char* iv)
 {
-    size_t nc_off = 0;
+#ifdef RSID_SECURE_OPENSSL
+    // new iv (counter block) only, the key schedule is kept
+    if (!EVP_EncryptInit_ex(_evp_aes_ctx, nullptr, nullptr, nullptr, iv))
+    {
+        LOG_ERROR(LOG_TAG, "Failed! EVP_EncryptInit_ex aes-256-ctr failed");
+        return false;
+    }
+#else
+    _ctr_offset = 0;
+    ::memcpy(_ctr_counter, iv, AES_CTR_IV_SIZE_BYTES);
+    ::memset(_ctr_stream_block, 0, AES_CTR_IV_SIZE_BYTES);
+#endif // RSID_SECURE_OPENSSL
+    return true;
+}
 
-    unsigned char ivBuf[AES_CTR_IV_SIZE_BYTES];
-    ::memcpy(ivBuf, iv, AES_CTR_IV_SIZE_BYTES);
+// ctr mode only xors the keystream into the data, so input and output may be the same buffer
+bool MbedtlsWrapper::AesCtrUpdate(unsigned char* data, const unsigned int length)
+{
+#ifdef RSID_SECURE_OPENSSL
+    int out_length = 0;
+    if (!EVP_EncryptUpdate(_evp_aes_ctx, data, &out_length, data, static_cast<int>(length)))
+    {
+        LOG_ERROR(LOG_TAG, "Failed! EVP_EncryptUpdate aes-256-ctr failed");
+        return false;
+    }
+    return true;
+#else
+    auto ret = mbedtls_aes_crypt_ctr(&_aes_ctx, length, &_ctr_offset, _ctr_counter, _ctr_stream_block, data, data);
+    if (ret != 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed! mbedtls_aes_crypt_ctr returned %d", ret);
+        return false;
+    }
+    return true;
+#endif // RSID_SECURE_OPENSSL
+}
 
-    unsigned char stream_block[AES_CTR_IV_SIZE_BYTES];
-    ::memset(stream_block, 0, AES_CTR_IV_SIZE_BYTES);
+bool MbedtlsWrapper::HmacStart()
+{
+#ifdef RSID_SECURE_OPENSSL
+    // inner hash continues from the precomputed key block
+    if (!EVP_MD_CTX_copy_ex(_evp_hmac_ctx, _evp_hmac_inner_ctx))
+    {
+        LOG_ERROR(LOG_TAG, "Failed! HMAC-SHA256 digest failed");
+        return false;
+    }
+    return true;
+#else
+    int ret = mbedtls_md_hmac_reset(&_hmac_ctx);
+    if (ret != 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed! mbedtls_md_hmac_reset returned %d", ret);
+        return false;
+    }
+    return true;
+#endif // RSID_SECURE_OPENSSL
+}
 
-    auto ret = mbedtls_aes_crypt_ctr(&_aes_ctx, length, &nc_off, ivBuf, stream_block, input, output);
+bool MbedtlsWrapper::HmacUpdate(const unsigned char* input, const unsigned int length)
+{
+#ifdef RSID_SECURE_OPENSSL
+    if (!EVP_DigestUpdate(_evp_hmac_ctx, input, length))
+    {
+        LOG_ERROR(LOG_TAG, "Failed! HMAC-SHA256 digest failed");
+        return false;
+    }
+    return true;
+#else
+    int ret = mbedtls_md_hmac_update(&_hmac_ctx, input, length);
     if (ret != 0)
     {
-        LOG_ERROR(LOG_TAG, "Failed! mbedtls_aes_crypt_ctr returned %d", ret);
+        LOG_ERROR(LOG_TAG, "Failed! mbedtls_md_hmac_update returned %d", ret);
         return false;
     }
+    return true;
+#endif // RSID_SECURE_OPENSSL
+}
 
+bool MbedtlsWrapper::HmacFinish(unsigned char* hmac)
+{
+#ifdef RSID_SECURE_OPENSSL
+    // outer hash over the inner digest
+    unsigned char inner_digest[HMAC_256_SIZE_BYTES];
+    if (!EVP_DigestFinal_ex(_evp_hmac_ctx, inner_digest, nullptr) ||
+        !EVP_MD_CTX_copy_ex(_evp_hmac_ctx, _evp_hmac_outer_ctx) ||
+        !EVP_DigestUpdate(_evp_hmac_ctx, inner_digest, sizeof(inner_digest)) ||
+        !EVP_DigestFinal_ex(_evp_hmac_ctx, hmac, nullptr))
+    {
+        LOG_ERROR(LOG_TAG, "Failed! HMAC-SHA256 digest failed");
+        return false;
+    }
+    return true;
+#else
+    int ret = mbedtls_md_hmac_finish(&_hmac_ctx, hmac);
+    if (ret != 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed! mbedtls_md_hmac_finish returned %d", ret);
+        return false;
+    }
     return true;
+#endif // RSID_SECURE_OPENSSL
 }
 } // namespace PacketManager
 } // namespace RealSenseID
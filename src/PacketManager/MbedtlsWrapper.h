@@ -6,8 +6,14 @@
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/ecdh.h"
 #include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
 #include "mbedtls/hkdf.h"
 
+#ifdef RSID_SECURE_OPENSSL
+#include <openssl/evp.h>
+#endif // RSID_SECURE_OPENSSL
+
+#include <chrono>
 #include <functional>
 
 #define ECC_P256_KEY_SIZE_BYTES        64
@@ -16,6 +22,8 @@
 #define AES_CTR_256_BIT_KEY_SIZE_BYTES 32
 #define AES_CTR_IV_SIZE_BYTES          16
 #define HMAC_256_SIZE_BYTES            32
+#define AES_GCM_IV_SIZE_BYTES          12
+#define AES_GCM_TAG_SIZE_BYTES         16
 #define DATA_PACKET_CONTENT_SIZE       ECC_P256_KEY_SIZE_BYTES + ECC_P256_SIG_SIZE_BYTES
 #define SIGNED_PUBKEY_SIZE             ECC_P256_KEY_SIZE_BYTES * 2
 
@@ -23,6 +31,12 @@ namespace RealSenseID
 {
 namespace PacketManager
 {
+// ECDH key exchange and packet crypto of the secure session.
+// The packet crypto (AES-CTR 256 and HMAC-SHA256) runs on mbedtls (AES-NI on x86-64 if available), or, if built
+// with RSID_SECURE_OPENSSL, on OpenSSL libcrypto, which uses the cpu's AES and SHA instructions (AES-NI, SHA-NI,
+// ARMv8 crypto extensions).
+// Construction is cheap: the ECDH group and the packet crypto contexts are set up on first use (the first secure
+// session), and the random numbers come from one CTR-DRBG shared by all the wrappers of the process, seeded once.
 class MbedtlsWrapper
 {
 public:
@@ -36,30 +50,81 @@ public:
     MbedtlsWrapper(const MbedtlsWrapper&) = delete;
     MbedtlsWrapper& operator=(const MbedtlsWrapper&) = delete;
 
+    // Host ECDH key lifetime. The key pair and its signature are reused by the sessions started within the lifetime
+    // (no key generation and no sign callback), after that a new key pair is generated. 0 - new key every session.
+    void SetKeyLifetime(std::chrono::seconds lifetime);
+
+    // Drop the host key, its signature and the cached shared secret (e.g. after pairing)
+    void ClearKeyCache();
+
     bool IsMaEnabled(bool& isMaEnabled);
     size_t GetSignedEcdhPubkeySize();
     unsigned char* GetSignedEcdhPubkey(SignCallback signCallback);
     bool VerifyEcdhSignedKey(const unsigned char* ecdhSignedPubKey, VerifyCallback verifyCallback);
-    bool Encrypt(const unsigned char* iv, const unsigned char* input, unsigned char* output, const unsigned int length);
-    bool Decrypt(const unsigned char* iv, const unsigned char* input, unsigned char* output, const unsigned int length);
+    // AES-CTR 256 in place
+    bool Encrypt(const unsigned char* iv, unsigned char* data, const unsigned int length);
+    bool Decrypt(const unsigned char* iv, unsigned char* data, const unsigned int length);
     bool CalcHmac(const unsigned char* input, const unsigned int length, unsigned char* hmac);
 
+    // Encrypt-then-MAC of a packet in one pass: the payload is encrypted in place chunk by chunk and each encrypted
+    // chunk is added to the hmac of header + payload while still in cache.
+    bool EncryptAndHmac(const unsigned char* iv, const unsigned char* header, const unsigned int header_size,
+                        unsigned char* payload, const unsigned int payload_size, unsigned char* hmac);
+    // Receive side of the above: each chunk is added to the hmac, then decrypted in place. The caller must compare
+    // the hmac and discard the payload on mismatch.
+    bool HmacAndDecrypt(const unsigned char* iv, const unsigned char* header, const unsigned int header_size,
+                        unsigned char* payload, const unsigned int payload_size, unsigned char* hmac);
+
+    // AES-GCM 256 of a standalone buffer in place, with the given key (e.g. the segments of an encrypted gallery file,
+    // see EncryptedGalleryFile). Stateless and thread safe, each call sets up its own context, so buffers can be
+    // processed in parallel. GcmDecrypt() returns false if the tag does not match, the data is garbage then.
+    static bool GcmEncrypt(const unsigned char* key, const unsigned char* iv, const unsigned char* aad, size_t aad_size,
+                           unsigned char* data, size_t length, unsigned char* tag);
+    static bool GcmDecrypt(const unsigned char* key, const unsigned char* iv, const unsigned char* aad, size_t aad_size,
+                           unsigned char* data, size_t length, const unsigned char* tag);
+
+    // random bytes of the shared CTR-DRBG (e.g. for keys and ivs)
+    static bool RandomBytes(unsigned char* output, size_t length);
+
 private:
-    void Reset();
     bool GenerateEcdhKey();
-    bool AesCtr256(const unsigned char* iv, const unsigned char* input, unsigned char* output,
-                   const unsigned int length);
+    bool InitPacketContexts(); // allocate the aes/hmac contexts, once
+    bool SetupPacketKeys();    // prepare the aes/hmac contexts for the derived _aes_key/_hmac_key
+    bool AesCtrStart(const unsigned char* iv);
+    bool AesCtrUpdate(unsigned char* data, const unsigned int length);
+    bool HmacStart();
+    bool HmacUpdate(const unsigned char* input, const unsigned int length);
+    bool HmacFinish(unsigned char* hmac);
 
     bool _ecdh_generate_key;
-    mbedtls_entropy_context _entropy_ctx;
-    mbedtls_ctr_drbg_context _ctr_drbg_ctx;
+    bool _ecdh_group_loaded;
+    bool _packet_contexts_ready;
+    bool _signed_pubkey_valid;
+    bool _shared_secret_valid;
+    std::chrono::seconds _key_lifetime;
+    std::chrono::steady_clock::time_point _ecdh_key_time;
     mbedtls_ecdh_context _edch_ctx;
     mbedtls_aes_context _aes_ctx;
+#ifdef RSID_SECURE_OPENSSL
+    EVP_CIPHER_CTX* _evp_aes_ctx;
+    // sha256 states after the hmac key's inner/outer pad block, copied for each packet
+    EVP_MD_CTX* _evp_hmac_inner_ctx;
+    EVP_MD_CTX* _evp_hmac_outer_ctx;
+    EVP_MD_CTX* _evp_hmac_ctx;
+#else
+    mbedtls_md_context_t _hmac_ctx;
+    // counter state of the running aes-ctr
+    size_t _ctr_offset;
+    unsigned char _ctr_counter[AES_CTR_IV_SIZE_BYTES];
+    unsigned char _ctr_stream_block[AES_CTR_IV_SIZE_BYTES];
+#endif // RSID_SECURE_OPENSSL
     const mbedtls_md_info_t* _md;
     unsigned char _shared_secret[ECC_P256_KEY_X_Y_Z_SIZE_BYTES];
     unsigned char _aes_key[ECC_P256_KEY_X_Y_Z_SIZE_BYTES];
     unsigned char _hmac_key[ECC_P256_KEY_X_Y_Z_SIZE_BYTES];
     unsigned char _ecdh_signed_pubkey[SIGNED_PUBKEY_SIZE];
+    // device key the shared secret was computed with
+    unsigned char _device_signed_pubkey[SIGNED_PUBKEY_SIZE];
 };
 } // namespace PacketManager
 } // namespace RealSenseID
@@ -0,0 +1,37 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/FaceRect.h"
+#include "RealSenseID/Faceprints.h"
+#include <cstdint>
+
+// Multi-face extraction (MultiFaceProtocolVer sessions): the fa_status of the authentication loop faceprints
+// extraction request is the max number of faces per frame ('0' + n, 0 or 1 for the single face flow). With more than
+// one, a successful result is followed by a MultiFaceprints message (frames, see MultiFrame.h) instead of the
+// Faceprints packet: a MultiFaceHeader followed by count MultiFaceRecords, in the order of the faces of the frame's
+// FaceDetected packet (the first one is the face the single face flow extracts).
+namespace RealSenseID
+{
+namespace PacketManager
+{
+static const unsigned int MaxMultiFaces = 10;
+
+#pragma pack(push)
+#pragma pack(1)
+struct MultiFaceHeader
+{
+    uint32_t count;
+};
+
+struct MultiFaceRecord
+{
+    FaceRect face;
+    int32_t version;
+    int32_t features_type;
+    feature_t descriptor[FEATURES_VECTOR_ALLOC_SIZE];
+};
+#pragma pack(pop)
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,90 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MultiFrame.h"
+#include "Logger.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+static const char* LOG_TAG = "MultiFrame";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+size_t FrameCount(size_t message_size)
+{
+    return message_size == 0 ? 1 : (message_size + MaxFrameData - 1) / MaxFrameData;
+}
+
+DataPacket MakeFrame(MsgId id, const char* message, size_t message_size, size_t offset)
+{
+    if (message_size > MaxMessageSize || offset > message_size || offset % MaxFrameData != 0)
+    {
+        throw std::runtime_error("MakeFrame: invalid message size or offset");
+    }
+
+    char frame_data[sizeof(DataMessage::data)];
+    FrameHeader frame_header {static_cast<uint32_t>(message_size), static_cast<uint32_t>(offset)};
+    ::memcpy(frame_data, &frame_header, sizeof(frame_header));
+    auto chunk_size = std::min(MaxFrameData, message_size - offset);
+    if (chunk_size > 0)
+    {
+        ::memcpy(frame_data + sizeof(frame_header), message + offset, chunk_size);
+    }
+    return DataPacket {id, frame_data, sizeof(frame_header) + chunk_size};
+}
+
+FrameAssembler::FrameAssembler(MsgId id, std::vector<char>& message) : _id {id}, _message {message}
+{
+    _message.clear();
+}
+
+SerialStatus FrameAssembler::Add(const DataPacket& frame)
+{
+    if (frame.header.id != _id || Complete())
+    {
+        LOG_ERROR(LOG_TAG, "Unexpected frame '%c'", frame.header.id);
+        return SerialStatus::RecvUnexpectedPacket;
+    }
+
+    FrameHeader frame_header;
+    ::memcpy(&frame_header, frame.Data().data, sizeof(frame_header));
+    if (!_started)
+    {
+        if (frame_header.message_size > MaxMessageSize)
+        {
+            LOG_ERROR(LOG_TAG, "Message size %u exceeds max size", frame_header.message_size);
+            return SerialStatus::RecvFailed;
+        }
+        _message_size = frame_header.message_size;
+        _message.reserve(_message_size);
+        _started = true;
+    }
+
+    if (frame_header.message_size != _message_size || frame_header.offset != _received)
+    {
+        LOG_ERROR(LOG_TAG, "Frame out of order. Expected offset %zu of %zu, got %u of %u", _received, _message_size,
+                  frame_header.offset, frame_header.message_size);
+        return SerialStatus::RecvUnexpectedPacket;
+    }
+
+    auto chunk_size = std::min(MaxFrameData, _message_size - _received);
+    if (sizeof(frame.payload.sequence_number) + sizeof(frame_header) + chunk_size > frame.header.payload_size)
+    {
+        LOG_ERROR(LOG_TAG, "Frame payload too short (%u bytes)", frame.header.payload_size);
+        return SerialStatus::RecvFailed;
+    }
+    const char* chunk = frame.Data().data + sizeof(frame_header);
+    _message.insert(_message.end(), chunk, chunk + chunk_size);
+    _received += chunk_size;
+    return SerialStatus::Ok;
+}
+
+bool FrameAssembler::Complete() const
+{
+    return _started && _received == _message_size;
+}
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,57 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "SerialPacket.h"
+#include "CommonTypes.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Multi-frame messages (MultiFrameProtocolVer sessions): a message bigger than one data packet is sent as consecutive
+// data packets with the same msg id (frames). Each frame's data starts with a FrameHeader, followed by up to
+// MaxFrameData bytes of the message.
+namespace RealSenseID
+{
+namespace PacketManager
+{
+#pragma pack(push)
+#pragma pack(1)
+struct FrameHeader
+{
+    uint32_t message_size; // size of the whole message
+    uint32_t offset;       // offset of this frame's data in the message
+};
+#pragma pack(pop)
+
+static const size_t MaxFrameData = sizeof(DataMessage::data) - sizeof(FrameHeader);
+static const size_t MaxMessageSize = 1024 * 1024;
+
+// number of frames of a message of the given size (empty message is sent as one frame)
+size_t FrameCount(size_t message_size);
+
+// frame of the message starting at offset (offset must be a multiple of MaxFrameData)
+DataPacket MakeFrame(MsgId id, const char* message, size_t message_size, size_t offset);
+
+// reassemble a message from its frames, in order
+class FrameAssembler
+{
+public:
+    FrameAssembler(MsgId id, std::vector<char>& message);
+
+    // add the next frame.
+    // return Status::Ok on success, RecvUnexpectedPacket if the frame doesn't continue the message.
+    SerialStatus Add(const DataPacket& frame);
+
+    bool Complete() const;
+
+private:
+    MsgId _id;
+    std::vector<char>& _message;
+    size_t _message_size = 0;
+    size_t _received = 0;
+    bool _started = false;
+};
+} // namespace PacketManager
+} // namespace RealSenseID
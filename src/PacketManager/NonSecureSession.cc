@@ -3,7 +3,10 @@
 
 #include "NonSecureSession.h"
 #include "PacketSender.h"
+#include "MultiFrame.h"
 #include "Logger.h"
+#include "MetricsRecorder.h"
+#include "TraceRecorder.h"
 #include <stdexcept>
 #include <string.h>
 #include <cassert>
@@ -11,6 +14,10 @@
 static const char* LOG_TAG = "NonSecureSession";
 static const int MAX_SEQ_NUMBER_DELTA = 20;
 
+// replies of pending requests must still pass the sequence number validation
+static_assert(RealSenseID::PacketManager::NonSecureSession::MaxPendingRequests <= MAX_SEQ_NUMBER_DELTA,
+              "too many pending requests for MAX_SEQ_NUMBER_DELTA");
+
 namespace RealSenseID
 {
 namespace PacketManager
@@ -29,6 +36,15 @@ NonSecureSession::~NonSecureSession()
 }
 
 SerialStatus NonSecureSession::Start(SerialConnection* serial_conn)
+{
+    Metrics::ScopedLatency setup_latency {Metrics::Latency::SessionSetup};
+    Trace::Scope start_trace {"SessionStart", "session"};
+    auto status = StartImpl(serial_conn);
+    Metrics::Add(status == SerialStatus::Ok ? Metrics::Counter::SessionsStarted : Metrics::Counter::SessionFailures);
+    return status;
+}
+
+SerialStatus NonSecureSession::StartImpl(SerialConnection* serial_conn)
 {
     LOG_DEBUG(LOG_TAG, "Start session");
 
@@ -42,8 +58,16 @@ SerialStatus NonSecureSession::Start(SerialConnection* serial_conn)
     _serial = serial_conn;
     _last_sent_seq_number = 0;
     _last_recv_seq_number = 0;
+    _pending_requests.clear();
+    _coalesced.Clear();
+    _event_filter.Reset(ProtocolVer);
+    _protocol_ver = ProtocolVer;
+    _retransmitter.Reset(ProtocolVer);
+    _request_sent = {};
 
     DataPacket packet {MsgId::StartSession};
+    AdvertiseProtocolVer(packet, 0);
+    _event_filter.Advertise(packet, 0);
     PacketSender sender {_serial};
     auto status = sender.SendBinary(packet);
     if (status != SerialStatus::Ok)
@@ -53,12 +77,83 @@ SerialStatus NonSecureSession::Start(SerialConnection* serial_conn)
     }
 
     status = sender.Recv(packet);
-    if (status != SerialStatus::Ok || packet.header.id != MsgId::StartSession)
+    if (status != SerialStatus::Ok)
+    {
         LOG_ERROR(LOG_TAG, "Failed to recv device start session response");
+        return status;
+    }
+    if (packet.header.id != MsgId::StartSession)
+    {
+        LOG_ERROR(LOG_TAG, "Unexpected reply '%c' to start session", packet.header.id);
+        return SerialStatus::RecvUnexpectedPacket;
+    }
 
+    // the device answers with the newest protocol version both sides support
+    _protocol_ver = packet.header.protocol_ver;
+    _retransmitter.Reset(_protocol_ver);
+    _event_filter.Reset(_protocol_ver);
+    if (_retransmitter.Enabled())
+    {
+        // the answer is the first packet of the device in the session, the packets asked again follow it
+        _last_recv_seq_number = packet.payload.sequence_number;
+    }
+    _is_open = true;
+    _last_activity = std::chrono::steady_clock::now();
     return status;
 }
 
+SerialStatus NonSecureSession::Resume(SerialConnection* serial_conn)
+{
+    const auto now = std::chrono::steady_clock::now();
+    const bool held = now < _held_until;
+    _held_until = {};
+    if (_is_open && serial_conn == _serial && _pending_requests.empty() && _coalesced.Empty() &&
+        (held || (_reuse_timeout.count() > 0 && now - _last_activity < _reuse_timeout)))
+    {
+        LOG_DEBUG(LOG_TAG, held ? "Reuse prewarmed session" : "Reuse session");
+        Metrics::Add(Metrics::Counter::SessionsReused);
+        if (held)
+        {
+            Metrics::Add(Metrics::Counter::PrewarmsUsed);
+        }
+        _cancel_required = false;
+        return SerialStatus::Ok;
+    }
+    return Start(serial_conn);
+}
+
+void NonSecureSession::SetReuseTimeout(timeout_t timeout)
+{
+    _reuse_timeout = timeout;
+}
+
+void NonSecureSession::HoldForNextResume(timeout_t timeout)
+{
+    _held_until = std::chrono::steady_clock::now() + timeout;
+}
+
+void NonSecureSession::SetEventSubscription(uint8_t mask, uint16_t face_detected_interval_ms)
+{
+    if (_event_filter.Set(mask, face_detected_interval_ms))
+    {
+        _is_open = false; // the device filters as subscribed at the session start
+    }
+}
+
+void NonSecureSession::Close()
+{
+    _is_open = false;
+    _held_until = {};
+    _pending_requests.clear();
+    _coalesced.Clear();
+
+    // the connection may be destroyed once closed, send the pending cancel now and forget it
+    std::lock_guard<std::mutex> lock {_cancel_mutex};
+    auto ignored = HandleCancelFlag();
+    (void)ignored;
+    _serial = nullptr;
+}
+
 bool NonSecureSession::IsOpen()
 {
     return _is_open;
@@ -66,17 +161,17 @@ bool NonSecureSession::IsOpen()
 
 SerialStatus NonSecureSession::SendPacket(SerialPacket& packet)
 {
-    return SendPacketImpl(packet);
+    return UpdateActivity(SendPacketImpl(packet));
 }
 
-SerialStatus NonSecureSession::RecvPacket(SerialPacket& packet)
+SerialStatus NonSecureSession::RecvPacket(SerialPacket& packet, const Timer* deadline)
 {
-    return RecvPacketImpl(packet);
+    return UpdateActivity(RecvPacketImpl(packet, deadline));
 }
 
-SerialStatus NonSecureSession::RecvFaPacket(FaPacket& packet)
+SerialStatus NonSecureSession::RecvFaPacket(FaPacket& packet, const Timer* deadline)
 {
-    auto status = RecvPacketImpl(packet);
+    auto status = UpdateActivity(RecvPacketImpl(packet, deadline));
     if (status != SerialStatus::Ok)
     {
         return status;
@@ -84,9 +179,9 @@ SerialStatus NonSecureSession::RecvFaPacket(FaPacket& packet)
     return IsFaPacket(packet) ? SerialStatus::Ok : SerialStatus::RecvUnexpectedPacket;
 }
 
-SerialStatus NonSecureSession::RecvDataPacket(DataPacket& packet)
+SerialStatus NonSecureSession::RecvDataPacket(DataPacket& packet, const Timer* deadline)
 {
-    auto status = RecvPacketImpl(packet);
+    auto status = UpdateActivity(RecvPacketImpl(packet, deadline));
     if (status != SerialStatus::Ok)
     {
         return status;
@@ -94,13 +189,135 @@ SerialStatus NonSecureSession::RecvDataPacket(DataPacket& packet)
     return IsDataPacket(packet) ? SerialStatus::Ok : SerialStatus::RecvUnexpectedPacket;
 }
 
+SerialStatus NonSecureSession::SendRequest(SerialPacket& packet)
+{
+    if (_pending_requests.size() >= MaxPendingRequests)
+    {
+        LOG_ERROR(LOG_TAG, "Too many pending requests (%zu)", _pending_requests.size());
+        return SerialStatus::SendFailed;
+    }
+    auto status = UpdateActivity(SendPacketImpl(packet));
+    if (status != SerialStatus::Ok)
+    {
+        return status;
+    }
+    _pending_requests.push_back({_last_sent_seq_number, packet.header.id});
+    return SerialStatus::Ok;
+}
+
+SerialStatus NonSecureSession::RecvReply(DataPacket& packet, uint32_t& request_seq, const Timer* deadline)
+{
+    if (_pending_requests.empty())
+    {
+        LOG_ERROR(LOG_TAG, "No pending request");
+        return SerialStatus::RecvUnexpectedPacket;
+    }
+    auto request = _pending_requests.front();
+    _pending_requests.pop_front();
+    request_seq = request.sequence_number;
+
+    auto status = RecvDataPacket(packet, deadline);
+    if (status != SerialStatus::Ok)
+    {
+        return status;
+    }
+    if (packet.header.id != request.id)
+    {
+        LOG_ERROR(LOG_TAG, "Unexpected reply '%c' to request %u ('%c')", packet.header.id, request.sequence_number,
+                  request.id);
+        return SerialStatus::RecvUnexpectedPacket;
+    }
+    return SerialStatus::Ok;
+}
+
+SerialStatus NonSecureSession::RecvReply(FaPacket& packet, uint32_t& request_seq, const Timer* deadline)
+{
+    if (_pending_requests.empty())
+    {
+        LOG_ERROR(LOG_TAG, "No pending request");
+        return SerialStatus::RecvUnexpectedPacket;
+    }
+    request_seq = _pending_requests.front().sequence_number;
+    _pending_requests.pop_front();
+    return RecvFaPacket(packet, deadline);
+}
+
+size_t NonSecureSession::PendingRequests() const
+{
+    return _pending_requests.size();
+}
+
+bool NonSecureSession::SupportsMultiFrame() const
+{
+    return _protocol_ver >= MultiFrameProtocolVer;
+}
+
+bool NonSecureSession::SupportsMultiFace() const
+{
+    return _protocol_ver >= MultiFaceProtocolVer;
+}
+
+SerialStatus NonSecureSession::SendMessage(MsgId id, const char* message, size_t message_size)
+{
+    if (!SupportsMultiFrame() || message_size > MaxMessageSize)
+    {
+        LOG_ERROR(LOG_TAG, "Cannot send message of %zu bytes (protocol version %u)", message_size, _protocol_ver);
+        return SerialStatus::SendFailed;
+    }
+    for (size_t offset = 0, frame = 0; frame < FrameCount(message_size); offset += MaxFrameData, frame++)
+    {
+        auto packet = MakeFrame(id, message, message_size, offset);
+        auto status = SendPacket(packet);
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+    }
+    return SerialStatus::Ok;
+}
+
+SerialStatus NonSecureSession::RecvMessage(MsgId id, std::vector<char>& message, const Timer* deadline)
+{
+    FrameAssembler assembler {id, message};
+    while (!assembler.Complete())
+    {
+        auto packet = _packet_pool.AcquireData(id);
+        auto status = RecvDataPacket(*packet, deadline);
+        if (status == SerialStatus::Ok)
+        {
+            status = assembler.Add(*packet);
+        }
+        if (status != SerialStatus::Ok)
+        {
+            _is_open = false; // rest of the message may still arrive
+            return status;
+        }
+    }
+    return SerialStatus::Ok;
+}
+
+PacketPool& NonSecureSession::Packets()
+{
+    return _packet_pool;
+}
+
 SerialStatus NonSecureSession::SendPacketImpl(SerialPacket& packet)
 {
     // increment and set sequence number in the packet
     packet.payload.sequence_number = ++_last_sent_seq_number;
+    packet.header.protocol_ver = _protocol_ver;
     assert(_serial != nullptr);
     PacketSender sender {_serial};
-    return sender.SendBinary(packet);
+    auto status = sender.SendBinary(packet);
+    if (status == SerialStatus::Ok)
+    {
+        _retransmitter.Sent(packet, packet.payload.sequence_number);
+    }
+    if (status == SerialStatus::Ok && _request_sent == std::chrono::steady_clock::time_point {})
+    {
+        _request_sent = std::chrono::steady_clock::now();
+    }
+    return status;
 }
 
 // new sequence number should advance by max of MAX_SEQ_NUMBER_DELTA from last number
@@ -109,38 +326,154 @@ static bool ValidateSeqNumber(uint32_t last_recv_number, uint32_t seq_number)
     return (last_recv_number < seq_number && seq_number <= last_recv_number + MAX_SEQ_NUMBER_DELTA);
 }
 
-SerialStatus NonSecureSession::RecvPacketImpl(SerialPacket& packet)
+SerialStatus NonSecureSession::RecvPacketImpl(SerialPacket& packet, const Timer* deadline)
+{
+    SerialStatus status;
+    do
+    {
+        status = RecvNextPacket(packet, deadline);
+    } while (status == SerialStatus::Ok && _event_filter.Drop(packet));
+    return status;
+}
+
+SerialStatus NonSecureSession::RecvNextPacket(SerialPacket& packet, const Timer* deadline)
 {
     assert(_serial != nullptr);
+
+    // the rest of a coalesced packet was received with it
+    if (!_coalesced.Empty())
+    {
+        _coalesced.Next(packet);
+        Metrics::Add(Metrics::Counter::CoalescedMessages);
+        return SerialStatus::Ok;
+    }
     PacketSender sender {_serial};
 
     // Handle cancel flag
-    auto status = HandleCancelFlag(); 
+    SerialStatus status;
+    {
+        std::lock_guard<std::mutex> lock {_cancel_mutex};
+        status = HandleCancelFlag();
+        _receiving = status == SerialStatus::Ok;
+    }
     if (status != SerialStatus::Ok)
-    {        
+    {
         return status;
     }
 
-    status = sender.Recv(packet);
+    status = RecvRetransmitted(sender, packet, deadline);
+    {
+        std::lock_guard<std::mutex> lock {_cancel_mutex};
+        _receiving = false;
+        if (_cancel_sent)
+        {
+            // the canceled operation may leave replies behind, don't reuse the session
+            _cancel_sent = false;
+            _is_open = false;
+        }
+    }
     if (status != SerialStatus::Ok)
     {
         return status;
     }
+    if (_request_sent != std::chrono::steady_clock::time_point {})
+    {
+        Metrics::Record(Metrics::Latency::RequestReply, std::chrono::steady_clock::now() - _request_sent);
+        _request_sent = {};
+    }
 
     // validate sequence number
     auto current_seq = packet.payload.sequence_number;
+    if (_retransmitter.Drop(current_seq))
+    {
+        return RecvNextPacket(packet, deadline); // sent after a packet asked again, resent after it
+    }
     if (!ValidateSeqNumber(_last_recv_seq_number, current_seq))
     {
         LOG_ERROR(LOG_TAG, "Invalid sequence number. Last: %zu, Current: %zu", _last_recv_seq_number, current_seq);
         return SerialStatus::SecurityError;
     }
     _last_recv_seq_number = current_seq;
+
+    if (packet.header.id == MsgId::Coalesced && _protocol_ver >= CoalesceProtocolVer)
+    {
+        status = _coalesced.Load(packet);
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+        _coalesced.Next(packet);
+        Metrics::Add(Metrics::Counter::CoalescedMessages);
+    }
     return SerialStatus::Ok;
 }
 
+SerialStatus NonSecureSession::RecvRetransmitted(PacketSender& sender, SerialPacket& packet, const Timer* deadline)
+{
+    auto send = [&sender](SerialPacket& resent) {
+        Metrics::Add(Metrics::Counter::PacketRetransmits);
+        return sender.Send(resent);
+    };
+    while (true)
+    {
+        auto status = sender.Recv(packet, deadline);
+        if (!_retransmitter.Enabled())
+        {
+            return status;
+        }
+        // the sends are serialized with a cancel sent during the receive
+        if (status == SerialStatus::CrcError)
+        {
+            std::lock_guard<std::mutex> lock {_cancel_mutex};
+            status = _retransmitter.AskAgain(_last_recv_seq_number, send);
+        }
+        else if (status == SerialStatus::Ok && packet.header.id == MsgId::Nak)
+        {
+            std::lock_guard<std::mutex> lock {_cancel_mutex};
+            status = _retransmitter.Resend(packet, send);
+        }
+        else
+        {
+            return status;
+        }
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+    }
+}
+
+SerialStatus NonSecureSession::UpdateActivity(SerialStatus status)
+{
+    if (status == SerialStatus::Ok)
+    {
+        _last_activity = std::chrono::steady_clock::now();
+    }
+    else
+    {
+        // the device may be out of sync with us (lost packets, sequence numbers). start over on next Resume()
+        _is_open = false;
+    }
+    return status;
+}
+
 void NonSecureSession::Cancel()
 {
     LOG_DEBUG(LOG_TAG, "Cancel requested.");
+    std::lock_guard<std::mutex> lock {_cancel_mutex};
+    if (_receiving)
+    {
+        // the operation waits for the device, send the cancel now instead of after its receive returns.
+        // the connection is kept by the receiving thread, and sends don't block its reads
+        LOG_DEBUG(LOG_TAG, "Sending cancel..");
+        auto status = _serial->SendBytes(Commands::face_cancel, ::strlen(Commands::face_cancel));
+        if (status == SerialStatus::Ok)
+        {
+            _cancel_sent = true;
+            return;
+        }
+        LOG_WARNING(LOG_TAG, "Failed sending cancel (status %d), retrying before the next recv", (int)status);
+    }
     _cancel_required = true;
 }
 
@@ -157,6 +490,8 @@ SerialStatus NonSecureSession::HandleCancelFlag()
         return SerialStatus::SendFailed;
     }
 
+    // the canceled operation may leave replies behind, don't reuse the session
+    _is_open = false;
     LOG_DEBUG(LOG_TAG, "Sending cancel..");
     return _serial->SendBytes(Commands::face_cancel, ::strlen(Commands::face_cancel));
 }
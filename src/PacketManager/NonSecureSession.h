@@ -5,9 +5,17 @@
 
 #include "SerialConnection.h"
 #include "SerialPacket.h"
+#include "PacketPool.h"
+#include "Retransmit.h"
+#include "Coalesced.h"
+#include "EventFilter.h"
 #include "CommonTypes.h"
 #include "Timer.h"
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <vector>
 
 // Thread safe, non secure session manager. sends/receive packets without any encryption or signing
 // Session starts on Start(serial_connection*) and ends in destruction.
@@ -17,6 +25,8 @@ namespace RealSenseID
 {
 namespace PacketManager
 {
+class PacketSender;
+
 class NonSecureSession
 {
 public:
@@ -30,6 +40,28 @@ public:
     // return Status::Ok on success, or error Status otherwise.
     SerialStatus Start(SerialConnection* serial_conn);
 
+    // Reuse the session if it is still open on the given connection, has no pending requests and was active within
+    // the reuse timeout. Otherwise start a new session (see Start()).
+    // return Status::Ok on success, or error Status otherwise.
+    SerialStatus Resume(SerialConnection* serial_conn);
+
+    // Max idle time of a reused session (keep-alive window). Each successful send/recv extends it.
+    // Default 0: every Resume() starts a new session.
+    void SetReuseTimeout(timeout_t timeout);
+
+    // Keep the open session for the next Resume() within timeout, even if it would not be reused otherwise (a session
+    // started ahead of the request, see FaceAuthenticator::Prewarm()).
+    void HoldForNextResume(timeout_t timeout);
+
+    // Events of the face flows to receive (EventMaskBits), FaceDetected at most once per face_detected_interval_ms
+    // (0 for all). Sent with the next session start: a changed subscription makes the next Resume() start a new
+    // session. Older devices send all the events, they are dropped when received then.
+    void SetEventSubscription(uint8_t mask, uint16_t face_detected_interval_ms);
+
+    // Close the session. The next Resume() starts a new session.
+    // Must be called if the connection is replaced.
+    void Close();
+
     // return true if session is open
     bool IsOpen();
 
@@ -37,39 +69,113 @@ public:
     // return Status::Ok on success, or error status otherwise.
     SerialStatus SendPacket(SerialPacket& packet);
 
-    // Wait for any packet until timeout.
+    // Wait for any packet until the deadline (or the default packet timeout if no deadline is given).
     // Fill the given packet with the received packet.
     // return Status::Ok on success, or error status otherwise.
-    SerialStatus RecvPacket(SerialPacket& packet);
+    SerialStatus RecvPacket(SerialPacket& packet, const Timer* deadline = nullptr);
 
     // Wait for fa packet until timeout.
     // Fill the given packet with the received fa packet.
     // If no fa packet available, return timeout status.
     // If the wrong packet type arrives, return RecvUnexpectedPacket status.
     // return Status::Ok on success, or error status otherwise.
-    SerialStatus RecvFaPacket(FaPacket& packet);
+    SerialStatus RecvFaPacket(FaPacket& packet, const Timer* deadline = nullptr);
 
     // Wait for data packet until timeout.
     // Fill the given packet with the received data packet.
     // If no data packet available, return timeout status.
     // If the wrong packet type arrives, return RecvUnexpectedPacket status.
     // return Status::Ok on success, or error status otherwise.
-    SerialStatus RecvDataPacket(DataPacket& packet);
+    SerialStatus RecvDataPacket(DataPacket& packet, const Timer* deadline = nullptr);
+
+    // Pipelined data requests: up to MaxPendingRequests requests are sent before their replies are received, so bulk
+    // operations don't wait a full round trip per packet. The device replies in request order, each reply is matched
+    // to the oldest pending request by its sequence number.
+    static constexpr size_t MaxPendingRequests = 20;
+
+    // Send data (or fa) request without waiting for its reply.
+    // return Status::Ok on success, Status::SendFailed if MaxPendingRequests are already pending, or error status
+    // otherwise.
+    SerialStatus SendRequest(SerialPacket& packet);
+
+    // Wait for the reply of the oldest pending request until timeout.
+    // request_seq is set to the sequence number the request was sent with.
+    // If no request is pending, or the reply is not a data packet with the request's msg id, return
+    // RecvUnexpectedPacket status.
+    // return Status::Ok on success, or error status otherwise.
+    SerialStatus RecvReply(DataPacket& packet, uint32_t& request_seq, const Timer* deadline = nullptr);
 
-    // async cancel. set the _cancel_required flag and send cancel before next recv
+    // Same for fa requests (e.g. RemoveUser), which are replied with any fa packet.
+    SerialStatus RecvReply(FaPacket& packet, uint32_t& request_seq, const Timer* deadline = nullptr);
+
+    // number of requests sent and not yet replied
+    size_t PendingRequests() const;
+
+    // true if the device answered the session start with MultiFrameProtocolVer or newer, so messages bigger than one
+    // packet can be sent as consecutive frames (see MultiFrame.h)
+    bool SupportsMultiFrame() const;
+
+    // true if the device answered the session start with MultiFaceProtocolVer or newer, so the authentication loop
+    // can extract several faces per frame (see MultiFace.h)
+    bool SupportsMultiFace() const;
+
+    // Send message of up to MaxMessageSize bytes as consecutive frames with the given msg id.
+    // return Status::Ok on success, or error status otherwise.
+    SerialStatus SendMessage(MsgId id, const char* message, size_t message_size);
+
+    // Wait for all the frames of a message with the given msg id, each until the deadline (or the default packet
+    // timeout if no deadline is given), and reassemble it into message.
+    // return Status::Ok on success, RecvUnexpectedPacket if a frame is missing or out of order, or error status
+    // otherwise.
+    SerialStatus RecvMessage(MsgId id, std::vector<char>& message, const Timer* deadline = nullptr);
+
+    // async cancel. send cancel now if a receive is in progress, otherwise set the _cancel_required flag and
+    // send it before the next recv
     void Cancel();
 
+    // reusable packets for the flows of this session (see PacketPool.h)
+    PacketPool& Packets();
+
 private:
     SerialConnection* _serial = nullptr;
     uint32_t _last_sent_seq_number = 0;
     uint32_t _last_recv_seq_number = 0;
-    bool _is_open = false;    
+    unsigned char _protocol_ver = ProtocolVer; // protocol version of the sent packets, as answered by the device
+
+    struct PendingRequest
+    {
+        uint32_t sequence_number;
+        MsgId id;
+    };
+    std::deque<PendingRequest> _pending_requests;
+    bool _is_open = false;
+    timeout_t _reuse_timeout {0};
+    std::chrono::steady_clock::time_point _last_activity;    
+    std::chrono::steady_clock::time_point _held_until; // HoldForNextResume()
+    // first packet sent since the last received one, for the request-reply latency (zero if none)
+    std::chrono::steady_clock::time_point _request_sent;
+    PacketPool _packet_pool;
+    Retransmitter _retransmitter; // RetransmitProtocolVer sessions
+    CoalescedReader _coalesced;   // messages of the last coalesced packet not received yet (CoalesceProtocolVer)
+    EventFilter _event_filter;
 
     // cancel may be called from different threads
     std::atomic<bool> _cancel_required {false}; 
 
+    // a cancel requested while the operation waits for the device is sent right away by the cancelling thread.
+    // guards _receiving and _cancel_sent
+    std::mutex _cancel_mutex;
+    bool _receiving = false;   // the operation's thread is in a receive
+    bool _cancel_sent = false; // cancel was sent during the receive, the session can't be reused
+
+    SerialStatus StartImpl(SerialConnection* serial_conn);
     SerialStatus SendPacketImpl(SerialPacket& packet);
-    SerialStatus RecvPacketImpl(SerialPacket& packet);
+    // receive the next packet the flows subscribed to (see SetEventSubscription())
+    SerialStatus RecvPacketImpl(SerialPacket& packet, const Timer* deadline);
+    SerialStatus RecvNextPacket(SerialPacket& packet, const Timer* deadline);
+    // receive the next packet, asking the packets with a bad crc again and resending on the device's naks
+    SerialStatus RecvRetransmitted(PacketSender& sender, SerialPacket& packet, const Timer* deadline);
+    SerialStatus UpdateActivity(SerialStatus status); // extend the reuse window on success, close the session on error
     SerialStatus HandleCancelFlag(); // if _cancel_required, send cancel. otherwise do nothing
 };
 } // namespace PacketManager
@@ -0,0 +1,87 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "PacketPool.h"
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+PacketPool::Lease<FaPacket> PacketPool::AcquireFa(MsgId id, const char* user_id, char status)
+{
+    Packet<FaPacket> packet;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (!_fa_packets.empty())
+        {
+            packet = std::move(_fa_packets.back());
+            _fa_packets.pop_back();
+        }
+        else
+        {
+            _allocated++;
+        }
+    }
+    if (packet)
+    {
+        packet->Reset(id, user_id, status);
+    }
+    else
+    {
+        packet.reset(SdkNew<FaPacket, Metrics::Subsystem::Protocol>(id, user_id, status));
+    }
+    return Lease<FaPacket> {this, std::move(packet)};
+}
+
+PacketPool::Lease<DataPacket> PacketPool::AcquireData(MsgId id, const char* data, size_t data_size)
+{
+    Packet<DataPacket> packet;
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (!_data_packets.empty())
+        {
+            packet = std::move(_data_packets.back());
+            _data_packets.pop_back();
+        }
+        else
+        {
+            _allocated++;
+        }
+    }
+    if (packet)
+    {
+        packet->Reset(id, data, data_size);
+    }
+    else
+    {
+        packet.reset(SdkNew<DataPacket, Metrics::Subsystem::Protocol>(id));
+        packet->Reset(id, data, data_size);
+    }
+    return Lease<DataPacket> {this, std::move(packet)};
+}
+
+size_t PacketPool::Allocated() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _allocated;
+}
+
+void PacketPool::Release(Packet<FaPacket> packet)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (_fa_packets.size() < MaxFreePackets)
+    {
+        _fa_packets.push_back(std::move(packet));
+    }
+}
+
+void PacketPool::Release(Packet<DataPacket> packet)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (_data_packets.size() < MaxFreePackets)
+    {
+        _data_packets.push_back(std::move(packet));
+    }
+}
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,93 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "SerialPacket.h"
+#include "RealSenseID/Allocator.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Reusable packets of a session. Constructing a packet zeros all ~2KB of it, a pooled packet is reset instead (see
+// SerialPacket::Reset()), which clears only the header and the payload bytes of its previous message. The packets are
+// allocated on first use (with the SDK allocator, counted as the protocol's allocations) and kept for the session's
+// lifetime, so steady state flows send and receive without allocations and without clearing whole packets.
+namespace RealSenseID
+{
+namespace PacketManager
+{
+class PacketPool
+{
+public:
+    template <typename T>
+    using Packet = SdkUniquePtr<T, Metrics::Subsystem::Protocol>;
+
+    // packet handed out by the pool, returned to it on destruction. must not outlive the pool
+    template <typename T>
+    class Lease
+    {
+    public:
+        Lease(PacketPool* pool, Packet<T> packet) : _pool {pool}, _packet {std::move(packet)}
+        {
+        }
+
+        ~Lease()
+        {
+            if (_packet)
+            {
+                _pool->Release(std::move(_packet));
+            }
+        }
+
+        Lease(Lease&& other) = default;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        T& operator*() const
+        {
+            return *_packet;
+        }
+
+        T* operator->() const
+        {
+            return _packet.get();
+        }
+
+    private:
+        PacketPool* _pool;
+        Packet<T> _packet;
+    };
+
+    PacketPool() = default;
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    // same as FaPacket {id, user_id, status}
+    Lease<FaPacket> AcquireFa(MsgId id, const char* user_id = nullptr, char status = 0);
+
+    // same as DataPacket {id, data, data_size}
+    Lease<DataPacket> AcquireData(MsgId id, const char* data = nullptr, size_t data_size = 0);
+
+    // number of packets allocated by the pool so far
+    size_t Allocated() const;
+
+private:
+    // more free packets than that are freed on release (a flow rarely holds more than a few)
+#ifdef RSID_LOW_MEMORY
+    static constexpr size_t MaxFreePackets = 2;
+#else
+    static constexpr size_t MaxFreePackets = 8;
+#endif
+
+    mutable std::mutex _mutex;
+    SdkVector<Packet<FaPacket>, Metrics::Subsystem::Protocol> _fa_packets;
+    SdkVector<Packet<DataPacket>, Metrics::Subsystem::Protocol> _data_packets;
+    size_t _allocated = 0;
+
+    void Release(Packet<FaPacket> packet);
+    void Release(Packet<DataPacket> packet);
+};
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -6,7 +6,10 @@
 #include "Timer.h"
 #include "Logger.h"
 #include "Crc16.h"
+#include "MetricsRecorder.h"
+#include "TraceRecorder.h"
 #include <string.h>
+#include <chrono>
 #include <cstdint>
 #include <stdexcept>
 #include <cassert>
@@ -23,6 +26,12 @@ static constexpr timeout_t recv_packet_timeout {20000};
 static constexpr timeout_t recv_packet_timeout {5000};
 #endif
 
+// per part of the packet: 200ms for the 1st byte and 5ms for each byte, bounded by the packet's deadline
+static Timer PartTimer(const Timer& packet_timer, size_t n_bytes)
+{
+    return Timer::Earliest(packet_timer, std::chrono::milliseconds {200 + 5 * n_bytes});
+}
+
 PacketSender::PacketSender(SerialConnection* serial_iface) : _serial {serial_iface}
 {
     if (serial_iface == nullptr)
@@ -32,53 +41,88 @@ PacketSender::PacketSender(SerialConnection* serial_iface) : _serial {serial_ifa
 }
 
 SerialStatus PacketSender::Send(SerialPacket& packet)
+{
+    return SendPacket(packet, nullptr, 0);
+}
+
+// headers + payload, hmac and crc (optionally preceded by a command) leave in one gather write
+SerialStatus PacketSender::SendPacket(SerialPacket& packet, const char* prefix, size_t prefix_size)
 {
     LOG_DEBUG(LOG_TAG, "Sending packet '%c'", packet.header.id);
+    Trace::Scope send_trace {"Send", "serial"};
+    send_trace.SetValue(static_cast<int64_t>(packet.header.id));
 
-    // send the headers + payload
+    auto crc = CalcCrc(packet);
     auto* packet_ptr = reinterpret_cast<const char*>(&packet);
     auto packet_size = sizeof(packet.header) + packet.header.payload_size;
-    auto status = _serial->SendBytes(packet_ptr, packet_size);
-    if (status != SerialStatus::Ok)
-    {
-        return status;
-    }
 
-    // send the hmac
-    status = _serial->SendBytes(packet.hmac, sizeof(packet.hmac));
-    if (status != SerialStatus::Ok)
+    const SendBuffer buffers[] = {{prefix, prefix_size},
+                                  {packet_ptr, packet_size},
+                                  {packet.hmac, sizeof(packet.hmac)},
+                                  {reinterpret_cast<const char*>(&crc), sizeof(crc)}};
+    auto status = _serial->SendBytesv(buffers, sizeof(buffers) / sizeof(buffers[0]));
+    if (status == SerialStatus::Ok)
     {
-        return status;
+        Metrics::Add(Metrics::Counter::PacketsSent);
+        Metrics::Add(Metrics::Counter::BytesSent, prefix_size + packet_size + sizeof(packet.hmac) + sizeof(crc));
     }
-
-    // send crc
-    auto crc = CalcCrc(packet);
-    status = _serial->SendBytes(reinterpret_cast<const char*>(&crc), sizeof(crc));
     return status;
 }
 
 SerialStatus PacketSender::SendBinary(SerialPacket& packet)
 {
-    // send __FACE_API__ command
+    // the device is already in binary mode for the whole session
+    if (packet.header.protocol_ver >= BinaryModeProtocolVer)
+    {
+        return SendPacket(packet, nullptr, 0);
+    }
+
+    // send __FACE_API__ command together with the packet
     auto face_api_len = ::strlen(Commands::face_api);
-    auto status = _serial->SendBytes(Commands::face_api, face_api_len);
+    auto status = SendPacket(packet, Commands::face_api, face_api_len);
     if (status != SerialStatus::Ok)
     {
-        LOG_ERROR(LOG_TAG, "Failed sending face entry command");
-        return status;
+        LOG_ERROR(LOG_TAG, "Failed sending face entry command and packet");
     }
+    return status;
+}
 
-    return Send(packet);
+SerialStatus PacketSender::Recv(SerialPacket& target, const Timer* deadline)
+{
+    Trace::Scope recv_trace {"Recv", "serial"};
+    Metrics::ScopedLatency wait_latency {Metrics::Latency::DeviceWait};
+    auto status = RecvPacket(target, deadline);
+    switch (status)
+    {
+    case SerialStatus::Ok:
+        recv_trace.SetValue(static_cast<int64_t>(target.header.id));
+        Metrics::Add(Metrics::Counter::PacketsReceived);
+        Metrics::Add(Metrics::Counter::BytesReceived, sizeof(target.header) + target.header.payload_size +
+                                                          sizeof(target.hmac) + sizeof(target.crc));
+        break;
+    case SerialStatus::RecvTimeout:
+        Metrics::Add(Metrics::Counter::RecvTimeouts);
+        break;
+    case SerialStatus::CrcError:
+        Metrics::Add(Metrics::Counter::CrcErrors);
+        break;
+    default:
+        Metrics::Add(Metrics::Counter::RecvErrors);
+        break;
+    }
+    return status;
 }
 
-// keep trying getting the packet until timeout
-SerialStatus PacketSender::Recv(SerialPacket& target)
+// keep trying getting the packet until timeout.
+// the packet is parsed in place in the connection's receive buffer and copied once to the target.
+// only the payload bytes the target used before are cleared (see SerialPacket::UsedPayloadSize()).
+SerialStatus PacketSender::RecvPacket(SerialPacket& target, const Timer* deadline)
 {
     LOG_DEBUG(LOG_TAG, "Waiting packet..");
+    // payload bytes of the target's previous message, the rest is already zero
+    const size_t previous_payload_size = target.UsedPayloadSize();
 
-    Timer timer {recv_packet_timeout};
-    // reset the target packet with zeros
-    ::memset(reinterpret_cast<char*>(&target), 0, sizeof(target));
+    Timer timer = deadline ? Timer::Earliest(*deadline, recv_packet_timeout) : Timer {recv_packet_timeout};
 
     // wait for sync bytes up to timeout
     auto status = WaitSyncBytes(target, &timer);
@@ -86,99 +130,140 @@ SerialStatus PacketSender::Recv(SerialPacket& target)
     {
         return status;
     }
+    const auto transfer_start = std::chrono::steady_clock::now();
+
+    auto& buffer = _serial->GetReceiveBuffer();
 
     // validate protocol version
-    status = _serial->RecvBytes((char*)&target.header.protocol_ver, 1);
+    status = buffer.Fill(1, PartTimer(timer, 1));
     if (status != SerialStatus::Ok)
     {
         LOG_ERROR(LOG_TAG, "Failed to recv protocol version byte");
         return status;
     }
-    if (target.header.protocol_ver != ProtocolVer)
+    target.header.protocol_ver = static_cast<unsigned char>(buffer.Data()[0]);
+    if (target.header.protocol_ver < ProtocolVer || target.header.protocol_ver > MaxProtocolVer)
     {
-        LOG_ERROR(LOG_TAG, "Protocol version doesn't match. Expected: %u, Received: %u", ProtocolVer,
-                  target.header.protocol_ver);
+        buffer.Consume(1);
+        LOG_ERROR_LIMITED(LOG_TAG, "Protocol version doesn't match. Expected: %u to %u, Received: %u",
+                          ProtocolVer, MaxProtocolVer, target.header.protocol_ver);
         return SerialStatus::VersionMismatch;
     }
 
-    // recv rest of packet header (without the sync bytes and protocol version which we already read)
-    auto bytes_to_read = sizeof(target.header) - 3;
-    auto* target_ptr = reinterpret_cast<char*>(&target) + 3;
-    status = _serial->RecvBytes(target_ptr, bytes_to_read);
+    // rest of packet header (without the sync bytes which we already consumed)
+    constexpr size_t header_size = sizeof(target.header) - 2;
+    status = buffer.Fill(header_size, PartTimer(timer, header_size));
     if (status != SerialStatus::Ok)
     {
-        LOG_ERROR(LOG_TAG, "Failed to recv rest of packet header (%zu bytes)", bytes_to_read);
+        LOG_ERROR(LOG_TAG, "Failed to recv rest of packet header (%zu bytes)", header_size - 1);
         return status;
     }
 
-    if (target.header.payload_size > sizeof(SerialPacket::payload))
+    uint16_t payload_size;
+    ::memcpy(&payload_size, buffer.Data() + header_size - sizeof(payload_size), sizeof(payload_size));
+    static_assert(sizeof(payload_size) == sizeof(target.header.payload_size), "payload_size size mismatch");
+    if (payload_size > sizeof(SerialPacket::payload))
     {
-        LOG_ERROR(LOG_TAG, "Packet size is bigger than payload max size");
+        buffer.Consume(header_size);
+        LOG_ERROR_LIMITED(LOG_TAG, "Packet size is bigger than payload max size");
         return SerialStatus::RecvFailed;
     }
 
-    // recv packet payload
-    target_ptr = reinterpret_cast<char*>(&target.payload);
-    status = _serial->RecvBytes(target_ptr, target.header.payload_size);
+    // payload, hmac and crc
+    const size_t packet_size = header_size + payload_size + sizeof(target.hmac) + sizeof(target.crc);
+    status = buffer.Fill(packet_size, PartTimer(timer, packet_size - header_size));
     if (status != SerialStatus::Ok)
     {
-        LOG_ERROR(LOG_TAG, "Failed to recv packet payload (%zu bytes)", target.header.payload_size);
+        LOG_ERROR(LOG_TAG, "Failed to recv packet payload, hmac and crc (%zu bytes)", packet_size - header_size);
         return status;
     }
 
-    // recv packet hmac
-    status = _serial->RecvBytes(target.hmac, sizeof(target.hmac));
-    if (status != SerialStatus::Ok)
+    const char* packet_ptr = buffer.Data();
+    ::memcpy(reinterpret_cast<char*>(&target) + 2, packet_ptr, header_size);
+    packet_ptr += header_size;
+    ::memcpy(&target.payload, packet_ptr, payload_size);
+    // the rest of the payload is zero, as on the sender's side
+    if (previous_payload_size > payload_size)
     {
-        LOG_ERROR(LOG_TAG, "Failed to recv packet hmac (%zu bytes)", sizeof(target.hmac));
-        return status;
-    }
-
-    // recv packet crc
-    status = _serial->RecvBytes(reinterpret_cast<char*>(&target.crc), sizeof(target.crc));
-    if (status != SerialStatus::Ok)
-    {
-        LOG_ERROR(LOG_TAG, "Failed to recv packet crc (%zu bytes)", sizeof(target.crc));
-        return status;
+        ::memset(reinterpret_cast<char*>(&target.payload) + payload_size, 0, previous_payload_size - payload_size);
     }
+    packet_ptr += payload_size;
+    ::memcpy(target.hmac, packet_ptr, sizeof(target.hmac));
+    packet_ptr += sizeof(target.hmac);
+    ::memcpy(&target.crc, packet_ptr, sizeof(target.crc));
+    buffer.Consume(packet_size);
 
     // validate crc
     auto expected_crc = CalcCrc(target);
     if (expected_crc != target.crc)
     {
-        LOG_ERROR(LOG_TAG, "Got invalid crc. Expected: %u. Actual: %u", expected_crc, target.crc);
+        LOG_ERROR_LIMITED(LOG_TAG, "Got invalid crc. Expected: %u. Actual: %u", expected_crc, target.crc);
         return SerialStatus::CrcError;
     }
 
+    Metrics::Record(Metrics::Latency::PacketTransfer, std::chrono::steady_clock::now() - transfer_start);
     LOG_DEBUG(LOG_TAG, "Received packet '%c' after %zu millis", target.header.id, timer.Elapsed());
     return SerialStatus::Ok;
 }
 
-// wait for sync bytes and place them into target
+// wait for sync bytes and place them into target.
+// scans the buffered bytes for the sync bytes, bytes before them are dropped.
 SerialStatus PacketSender::WaitSyncBytes(SerialPacket& target, Timer* timer)
 {
+    Trace::Scope wait_trace {"WaitSyncBytes", "serial"};
+    auto& buffer = _serial->GetReceiveBuffer();
+    const char sync1 = static_cast<char>(SyncByte::Sync1);
+    const char sync2 = static_cast<char>(SyncByte::Sync2);
+
     while (!timer->ReachedTimeout())
     {
-        auto status = _serial->RecvBytes(reinterpret_cast<char*>(&target.header.sync1), 1);
-        if (status == SerialStatus::Ok && target.header.sync1 == SyncByte::Sync1)
+        auto status = buffer.Fill(2, *timer);
+        if (status != SerialStatus::Ok)
+        {
+            continue;
+        }
+
+        const char* data = buffer.Data();
+        const size_t size = buffer.Size();
+        const char* end = data + size;
+        for (const char* p = data; (p = static_cast<const char*>(::memchr(p, sync1, end - p))) != nullptr; p++)
         {
-            // wait for sync2
-            status = _serial->RecvBytes(reinterpret_cast<char*>(&target.header.sync2), 1);
-            if (status == SerialStatus::Ok && target.header.sync2 == SyncByte::Sync2)
+            if (p + 1 == end)
+            {
+                // sync1 is the last buffered byte, keep it and wait for sync2
+                buffer.Consume(size - 1);
+                break;
+            }
+            if (p[1] == sync2)
             {
+                buffer.Consume(p - data + 2);
+                target.header.sync1 = SyncByte::Sync1;
+                target.header.sync2 = SyncByte::Sync2;
                 return SerialStatus::Ok;
             }
         }
+        if (buffer.Size() == size)
+        {
+            buffer.Consume(size);
+        }
     }
     return SerialStatus::RecvTimeout;
 }
 
+// crc of the whole packet (unused payload bytes are zero on both sides), or of the sent bytes only since
+// CompactCrcProtocolVer
 uint16_t PacketSender::CalcCrc(const SerialPacket& packet)
 {
     auto* packet_ptr = reinterpret_cast<const char*>(&packet);
-    auto crc = Crc16(packet_ptr, sizeof(packet) - sizeof(packet.crc));
-    static_assert(sizeof(packet.crc) == sizeof(crc), "packet.crc and crc size mismatch");
-    return crc;
+    static_assert(sizeof(packet.crc) == sizeof(Crc16(packet_ptr, 0)), "packet.crc and crc size mismatch");
+    if (packet.header.protocol_ver < CompactCrcProtocolVer)
+    {
+        return Crc16(packet_ptr, sizeof(packet) - sizeof(packet.crc));
+    }
+
+    assert(packet.header.payload_size <= sizeof(packet.payload));
+    auto crc = Crc16(packet_ptr, sizeof(packet.header) + packet.header.payload_size);
+    return Crc16(crc, packet.hmac, sizeof(packet.hmac));
 }
 } // namespace PacketManager
 } // namespace RealSenseID
@@ -5,6 +5,7 @@
 
 #include "SerialPacket.h"
 #include "CommonTypes.h"
+#include <cstddef>
 
 // packet sender for sending/receiving complete serial packets over the serial interface
 namespace RealSenseID
@@ -21,17 +22,19 @@ public:
     // send packet and return Status::ok on success
     SerialStatus Send(SerialPacket& packet);
 
-    // switch to binary mode
+    // switch to binary mode (unless the packet's protocol version keeps the device in binary mode for the session)
     // send the packet
     // return Status::ok if both sends were successfull
     SerialStatus SendBinary(SerialPacket& packet);
 
     // receive complete and valid packet (with valid crc)
+    // waits up to the default packet timeout, and never past the deadline if one is given. each part of the packet
+    // must arrive within a time relative to its size, also bounded by the deadline.
     // return:
     // Status::Ok on success,
     // Status::RecvTimeout on timeout
     // Status::RecvFailed on other failures
-    SerialStatus Recv(SerialPacket& target);
+    SerialStatus Recv(SerialPacket& target, const Timer* deadline = nullptr);
 
     // Wait for sync bytes
     // return:
@@ -43,6 +46,12 @@ public:
 private:
     static uint16_t CalcCrc(const SerialPacket& packet);
 
+    // Recv() without the metrics
+    SerialStatus RecvPacket(SerialPacket& target, const Timer* deadline);
+
+    // send the prefix (if any) and the complete packet with a single gather write
+    SerialStatus SendPacket(SerialPacket& packet, const char* prefix, size_t prefix_size);
+
     SerialConnection* _serial;
 };
 } // namespace PacketManager
@@ -0,0 +1,95 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "ReceiveBuffer.h"
+#include "SerialConnection.h"
+#include "Timer.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+static const char* LOG_TAG = "ReceiveBuffer";
+
+constexpr size_t ReceiveBuffer::BufferSize;
+
+ReceiveBuffer::ReceiveBuffer(SerialConnection& source) : _source {&source}
+{
+}
+
+SerialStatus ReceiveBuffer::Fill(size_t n_bytes, const Timer& timer)
+{
+    if (n_bytes > BufferSize)
+    {
+        LOG_ERROR(LOG_TAG, "Attempt to buffer %zu bytes (max %zu)", n_bytes, BufferSize);
+        return SerialStatus::RecvFailed;
+    }
+    if (Size() >= n_bytes)
+    {
+        return SerialStatus::Ok;
+    }
+
+    // make room at the end for the missing bytes
+    if (BufferSize - _begin < n_bytes)
+    {
+        ::memmove(_buffer, _buffer + _begin, Size());
+        _end -= _begin;
+        _begin = 0;
+    }
+
+    while (Size() < n_bytes)
+    {
+        if (timer.ReachedTimeout())
+        {
+            return SerialStatus::RecvTimeout;
+        }
+
+        // wait for the os to signal the bytes, up to the deadline
+        size_t n_read = 0;
+        auto status = _source->RecvAvailable(_buffer + _end, BufferSize - _end, n_read, timer.TimeLeft());
+        if (status == SerialStatus::Ok)
+        {
+            assert(n_read <= BufferSize - _end);
+            _end += n_read;
+        }
+        else if (status != SerialStatus::RecvTimeout)
+        {
+            return status;
+        }
+    }
+    return SerialStatus::Ok;
+}
+
+void ReceiveBuffer::Consume(size_t n_bytes)
+{
+    assert(n_bytes <= Size());
+    _begin += std::min(n_bytes, Size());
+    if (_begin == _end)
+    {
+        _begin = _end = 0;
+    }
+}
+
+SerialStatus ReceiveBuffer::Recv(char* destination, size_t n_bytes, const Timer& timer)
+{
+    while (n_bytes > 0)
+    {
+        auto status = Fill(std::min(n_bytes, BufferSize), timer);
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+        size_t chunk_size = std::min(n_bytes, Size());
+        ::memcpy(destination, Data(), chunk_size);
+        Consume(chunk_size);
+        destination += chunk_size;
+        n_bytes -= chunk_size;
+    }
+    return SerialStatus::Ok;
+}
+} // namespace PacketManager
+} // namespace RealSenseID
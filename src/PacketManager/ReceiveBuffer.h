@@ -0,0 +1,67 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "CommonTypes.h"
+#include <cstddef>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+class SerialConnection;
+class Timer;
+
+// Receive buffer of a serial connection.
+// Reads whatever the os has available in large chunks (SerialConnection::RecvAvailable) and lets the reader parse
+// packets in place: Fill() until enough bytes are buffered, look at them with Data()/Size() and Consume() them.
+// All reads from the connection go through the buffer, so no bytes are lost between readers.
+// Not thread safe (same as the connection).
+class ReceiveBuffer
+{
+public:
+#ifdef RSID_LOW_MEMORY
+    // at least 2 complete serial packets
+    static constexpr size_t BufferSize = 4096;
+#else
+    // at least 8 complete serial packets
+    static constexpr size_t BufferSize = 16384;
+#endif
+
+    explicit ReceiveBuffer(SerialConnection& source);
+
+    ReceiveBuffer(const ReceiveBuffer&) = delete;
+    ReceiveBuffer& operator=(const ReceiveBuffer&) = delete;
+
+    // read from the connection until at least n_bytes (up to BufferSize) are buffered.
+    // return Status::Ok if enough bytes are buffered (without reading if they already are), Status::RecvTimeout on
+    // timeout, Status::RecvFailed on other failures.
+    SerialStatus Fill(size_t n_bytes, const Timer& timer);
+
+    // view of the buffered bytes, valid until the next Fill()/Consume()/Recv()
+    const char* Data() const
+    {
+        return _buffer + _begin;
+    }
+
+    size_t Size() const
+    {
+        return _end - _begin;
+    }
+
+    // drop n_bytes (up to Size()) from the front of the buffer
+    void Consume(size_t n_bytes);
+
+    // receive exactly n_bytes and copy them to the destination.
+    // bytes received before a timeout stay in the buffer if n_bytes <= BufferSize.
+    SerialStatus Recv(char* destination, size_t n_bytes, const Timer& timer);
+
+private:
+    SerialConnection* _source;
+    size_t _begin = 0;
+    size_t _end = 0;
+    char _buffer[BufferSize];
+};
+} // namespace PacketManager
+} // namespace RealSenseID
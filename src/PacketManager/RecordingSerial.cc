@@ -0,0 +1,119 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#include "RecordingSerial.h"
+#include "Timer.h"
+#include "Logger.h"
+#include <cstring>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+static const char* LOG_TAG = "RecordingSerial";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// true the first time the process records to the file
+static bool IsNewRecording(const char* path)
+{
+    static std::mutex mutex;
+    static std::set<std::string> paths;
+    std::lock_guard<std::mutex> lock {mutex};
+    return paths.insert(path).second;
+}
+
+RecordingSerial::RecordingSerial(std::unique_ptr<SerialConnection> connection, const char* path) :
+    _connection {std::move(connection)}, _start {std::chrono::steady_clock::now()}
+{
+    const bool new_recording = IsNewRecording(path);
+    _file = ::fopen(path, new_recording ? "wb" : "ab");
+    if (_file == nullptr)
+    {
+        throw std::runtime_error(std::string("Failed to create serial recording ") + path);
+    }
+    if (new_recording)
+    {
+        Recording::RecordingHeader header;
+        ::memset(&header, 0, sizeof(header));
+        ::memcpy(header.magic, Recording::FILE_MAGIC, sizeof(header.magic));
+        header.version = Recording::VERSION;
+        ::fwrite(&header, sizeof(header), 1, _file);
+    }
+    Record(Recording::Opened, nullptr, 0);
+    LOG_DEBUG(LOG_TAG, "Recording to %s", path);
+}
+
+RecordingSerial::~RecordingSerial()
+{
+    try
+    {
+        ::fclose(_file);
+    }
+    catch (...)
+    {
+    }
+}
+
+void RecordingSerial::Record(uint8_t direction, const SendBuffer* buffers, size_t n_buffers)
+{
+    auto time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start);
+    Recording::RecordHeader header;
+    ::memset(&header, 0, sizeof(header));
+    header.direction = direction;
+    header.time_us = static_cast<uint64_t>(time_us.count());
+    size_t size = 0;
+    for (size_t i = 0; i < n_buffers; i++)
+    {
+        size += buffers[i].n_bytes;
+    }
+    header.size = static_cast<uint32_t>(size);
+
+    std::lock_guard<std::mutex> lock {_file_mutex};
+    bool ok = ::fwrite(&header, sizeof(header), 1, _file) == 1;
+    for (size_t i = 0; i < n_buffers && ok; i++)
+    {
+        ok = buffers[i].n_bytes == 0 || ::fwrite(buffers[i].buffer, buffers[i].n_bytes, 1, _file) == 1;
+    }
+    if (!ok)
+    {
+        LOG_ERROR(LOG_TAG, "Failed writing %zu bytes record", size);
+    }
+}
+
+SerialStatus RecordingSerial::SendBytes(const char* buffer, size_t n_bytes)
+{
+    SendBuffer send_buffer {buffer, n_bytes};
+    Record(Recording::Sent, &send_buffer, 1);
+    return _connection->SendBytes(buffer, n_bytes);
+}
+
+SerialStatus RecordingSerial::SendBytesv(const SendBuffer* buffers, size_t n_buffers)
+{
+    Record(Recording::Sent, buffers, n_buffers);
+    return _connection->SendBytesv(buffers, n_buffers);
+}
+
+SerialStatus RecordingSerial::RecvBytes(char* buffer, size_t n_bytes)
+{
+    if (n_bytes == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Attempt to recv 0 bytes");
+        return SerialStatus::RecvFailed;
+    }
+    Timer timer {std::chrono::milliseconds {200 + 4 * n_bytes}};
+    return _recv_buffer.Recv(buffer, n_bytes, timer);
+}
+
+SerialStatus RecordingSerial::RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout)
+{
+    auto status = _connection->RecvAvailable(buffer, max_bytes, n_bytes, timeout);
+    if (status == SerialStatus::Ok)
+    {
+        SendBuffer received {buffer, n_bytes};
+        Record(Recording::Received, &received, 1);
+    }
+    return status;
+}
+} // namespace PacketManager
+} // namespace RealSenseID
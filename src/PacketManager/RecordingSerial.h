@@ -0,0 +1,82 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+#include "SerialConnection.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// Serial recording file (RecordingSerial, ReplaySerial), host byte order:
+//   RecordingHeader
+//   for each connection opened by the recording process:
+//     RecordHeader (Opened, no data)
+//     RecordHeader, record data (RecordHeader::size bytes)   for each send and receive, in the order they happened
+namespace Recording
+{
+static const char FILE_MAGIC[8] = {'R', 'S', 'I', 'D', 'S', 'R', 'E', 'C'};
+static const uint32_t VERSION = 1;
+
+// RecordHeader::direction
+static const uint8_t Sent = 0;
+static const uint8_t Received = 1;
+static const uint8_t Opened = 2;
+
+#pragma pack(push, 1)
+struct RecordingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct RecordHeader
+{
+    uint8_t direction;
+    uint8_t reserved[3];
+    uint32_t size;
+    uint64_t time_us; // since the connection was opened. before the send, after the receive
+};
+#pragma pack(pop)
+
+static_assert(sizeof(RecordingHeader) == 16, "RecordingHeader size");
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader size");
+} // namespace Recording
+
+// Serial connection decorator recording the bytes sent and received through it, with their times, to a file to be
+// replayed by ReplaySerial. Port "record://<file>@<port>" (see OpenSerialConnection()).
+// The first connection of the process to record to the file truncates it, the next ones (reconnects) are appended.
+class RecordingSerial : public SerialConnection
+{
+public:
+    // throws if the file could not be created
+    RecordingSerial(std::unique_ptr<SerialConnection> connection, const char* path);
+    ~RecordingSerial() override;
+
+    RecordingSerial(const RecordingSerial&) = delete;
+    RecordingSerial operator=(const RecordingSerial&) = delete;
+
+    SerialStatus SendBytes(const char* buffer, size_t n_bytes) final;
+
+    // one record of all the segments
+    SerialStatus SendBytesv(const SendBuffer* buffers, size_t n_buffers) final;
+
+    SerialStatus RecvBytes(char* buffer, size_t n_bytes) final;
+
+    SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) final;
+
+private:
+    std::unique_ptr<SerialConnection> _connection;
+    FILE* _file = nullptr;
+    std::mutex _file_mutex; // cancels are sent while another thread receives
+    std::chrono::steady_clock::time_point _start;
+
+    void Record(uint8_t direction, const SendBuffer* buffers, size_t n_buffers);
+};
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,187 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#include "ReplaySerial.h"
+#include "RecordingSerial.h"
+#include "Timer.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+static const char* LOG_TAG = "ReplaySerial";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// connections of the process to the file so far
+static unsigned int NextConnection(const char* path)
+{
+    static std::mutex mutex;
+    static std::map<std::string, unsigned int> connections;
+    std::lock_guard<std::mutex> lock {mutex};
+    return connections[path]++;
+}
+
+ReplaySerial::ReplaySerial(const char* path, bool fast) : _fast {fast}, _anchor_time {clock::now()}
+{
+    Load(path, NextConnection(path));
+    LOG_DEBUG(LOG_TAG, "Replaying %s: %zu sent and %zu received records%s", path, _sends.size(), _receives.size(),
+              fast ? " (fast)" : "");
+}
+
+void ReplaySerial::Load(const char* path, unsigned int connection_index)
+{
+    FILE* file = ::fopen(path, "rb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error(std::string("Failed to open serial recording ") + path);
+    }
+    Recording::RecordingHeader header;
+    if (::fread(&header, sizeof(header), 1, file) != 1 ||
+        ::memcmp(header.magic, Recording::FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != Recording::VERSION)
+    {
+        ::fclose(file);
+        throw std::runtime_error(std::string("Not a serial recording ") + path);
+    }
+
+    // offsets of the connections' first records
+    std::vector<long> connections;
+    Recording::RecordHeader record;
+    while (::fread(&record, sizeof(record), 1, file) == 1)
+    {
+        if (record.direction == Recording::Opened)
+        {
+            connections.push_back(::ftell(file));
+        }
+        if (record.size > 0 && ::fseek(file, record.size, SEEK_CUR) != 0)
+        {
+            break;
+        }
+    }
+    if (connections.empty())
+    {
+        ::fclose(file);
+        throw std::runtime_error(std::string("No connection recorded in ") + path);
+    }
+    ::fseek(file, connections[connection_index % connections.size()], SEEK_SET);
+
+    while (::fread(&record, sizeof(record), 1, file) == 1 && record.direction != Recording::Opened)
+    {
+        size_t offset = _data.size();
+        _data.resize(offset + record.size);
+        if (record.size > 0 && ::fread(_data.data() + offset, record.size, 1, file) != 1)
+        {
+            LOG_WARNING(LOG_TAG, "Truncated record at the end of %s", path);
+            _data.resize(offset);
+            break;
+        }
+        if (record.size == 0)
+        {
+            continue;
+        }
+        bool sent = record.direction == Recording::Sent;
+        (sent ? _sends : _receives).push_back(_records.size());
+        _records.push_back({sent, std::chrono::microseconds {record.time_us}, offset, record.size,
+                            _sends.size() - (sent ? 1 : 0)});
+    }
+    ::fclose(file);
+}
+
+SerialStatus ReplaySerial::SendBytes(const char* buffer, size_t n_bytes)
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    size_t matched = 0;
+    while (matched < n_bytes && _send_index < _sends.size())
+    {
+        const auto& record = _records[_sends[_send_index]];
+        size_t count = std::min(n_bytes - matched, record.size - _send_offset);
+        if (::memcmp(buffer + matched, _data.data() + record.offset + _send_offset, count) != 0)
+        {
+            if (_mismatches++ == 0)
+            {
+                LOG_WARNING(LOG_TAG, "Sent bytes differ from the recording (sent record %zu)", _send_index);
+            }
+        }
+        matched += count;
+        _send_offset += count;
+        if (_send_offset == record.size)
+        {
+            _send_index++;
+            _send_offset = 0;
+            _anchor_time = clock::now();
+            _anchor_record_time = record.time;
+        }
+    }
+    if (matched < n_bytes && _mismatches++ == 0)
+    {
+        LOG_WARNING(LOG_TAG, "Sent %zu bytes past the end of the recording", n_bytes - matched);
+    }
+    _sent_cv.notify_all();
+    return SerialStatus::Ok;
+}
+
+SerialStatus ReplaySerial::RecvBytes(char* buffer, size_t n_bytes)
+{
+    if (n_bytes == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Attempt to recv 0 bytes");
+        return SerialStatus::RecvFailed;
+    }
+    Timer timer {std::chrono::milliseconds {200 + 4 * n_bytes}};
+    return _recv_buffer.Recv(buffer, n_bytes, timer);
+}
+
+SerialStatus ReplaySerial::RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout)
+{
+    n_bytes = 0;
+    const auto deadline = clock::now() + timeout;
+    std::unique_lock<std::mutex> lock {_mutex};
+
+    // the device replies once the bytes sent before were sent again. past the end of the recording it is silent
+    auto is_sent_before = [this] {
+        return _recv_index < _receives.size() && _send_index >= _records[_receives[_recv_index]].sends_before;
+    };
+    if (!_sent_cv.wait_until(lock, deadline, is_sent_before))
+    {
+        return SerialStatus::RecvTimeout;
+    }
+    const auto& record = _records[_receives[_recv_index]];
+    if (!_fast && _recv_offset == 0)
+    {
+        auto delay = std::max(record.time - _anchor_record_time, std::chrono::microseconds {0});
+        auto due = _anchor_time + delay;
+        if (due > deadline)
+        {
+            lock.unlock();
+            std::this_thread::sleep_until(deadline);
+            return SerialStatus::RecvTimeout;
+        }
+        lock.unlock();
+        std::this_thread::sleep_until(due);
+        lock.lock();
+    }
+
+    n_bytes = std::min(max_bytes, record.size - _recv_offset);
+    ::memcpy(buffer, _data.data() + record.offset + _recv_offset, n_bytes);
+    _recv_offset += n_bytes;
+    if (_recv_offset == record.size)
+    {
+        _recv_index++;
+        _recv_offset = 0;
+    }
+    return SerialStatus::Ok;
+}
+
+size_t ReplaySerial::Mismatches() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _mismatches;
+}
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,72 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+#include "SerialConnection.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// Serial connection replaying a RecordingSerial recording in place of the device: the recorded received bytes are
+// returned once the bytes sent before them were sent again, at the recorded pace (after the same delay since the
+// last send) or as fast as possible. The sent bytes are compared to the recorded ones, differences are logged.
+// Ports "replay://<file>" (recorded pace) and "replay-fast://<file>" (see OpenSerialConnection()).
+// Each connection of the process to the file replays the next recorded connection, after the last one the first.
+// Replays only flows of non-secure sessions (secure sessions use new keys on each run).
+class ReplaySerial : public SerialConnection
+{
+public:
+    // throws if the file could not be read
+    ReplaySerial(const char* path, bool fast);
+
+    ReplaySerial(const ReplaySerial&) = delete;
+    ReplaySerial operator=(const ReplaySerial&) = delete;
+
+    SerialStatus SendBytes(const char* buffer, size_t n_bytes) final;
+
+    SerialStatus RecvBytes(char* buffer, size_t n_bytes) final;
+
+    SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) final;
+
+    // sent bytes that differed from the recording
+    size_t Mismatches() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Record
+    {
+        bool sent;
+        std::chrono::microseconds time;
+        size_t offset; // of the data
+        size_t size;
+        size_t sends_before; // sent records before it
+    };
+
+    std::vector<char> _data;
+    std::vector<Record> _records;
+    std::vector<size_t> _sends;    // indices of the sent records
+    std::vector<size_t> _receives; // indices of the received records
+    const bool _fast;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _sent_cv;
+    size_t _send_index = 0;   // next sent record to match
+    size_t _send_offset = 0;  // bytes of it already matched
+    size_t _recv_index = 0;   // next received record to return
+    size_t _recv_offset = 0;  // bytes of it already returned
+    size_t _mismatches = 0;
+    // last matched send, the received records are returned at the recorded delay after it
+    clock::time_point _anchor_time;
+    std::chrono::microseconds _anchor_record_time {0};
+
+    // load the records of the connection_index-th recorded connection (modulo their count)
+    void Load(const char* path, unsigned int connection_index);
+};
+} // namespace PacketManager
+} // namespace RealSenseID
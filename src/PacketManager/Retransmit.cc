@@ -0,0 +1,117 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "Retransmit.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+
+static const char* LOG_TAG = "Retransmit";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+void Retransmitter::Reset(unsigned char protocol_ver)
+{
+    _enabled = protocol_ver >= RetransmitProtocolVer;
+    _protocol_ver = protocol_ver;
+    if (_enabled && _kept.empty())
+    {
+        _kept.resize(Window);
+        _kept_seq.resize(Window);
+    }
+    std::fill(_kept_seq.begin(), _kept_seq.end(), 0);
+    _last_sent_seq = 0;
+    _asked_seq = 0;
+    _naks = 0;
+}
+
+bool Retransmitter::Enabled() const
+{
+    return _enabled;
+}
+
+void Retransmitter::Sent(const SerialPacket& packet, uint32_t sequence_number)
+{
+    if (!_enabled)
+    {
+        return;
+    }
+    // only the sent bytes, the rest of the kept packet is never sent
+    auto& kept = _kept[sequence_number % Window];
+    ::memcpy(&kept, &packet, sizeof(packet.header) + packet.header.payload_size);
+    ::memcpy(kept.hmac, packet.hmac, sizeof(packet.hmac));
+    _kept_seq[sequence_number % Window] = sequence_number;
+    _last_sent_seq = sequence_number;
+}
+
+SerialStatus Retransmitter::AskAgain(uint32_t last_recv_seq, const SendFunc& send)
+{
+    if (!_enabled)
+    {
+        return SerialStatus::CrcError;
+    }
+    const uint32_t expected_seq = last_recv_seq + 1;
+    if (_asked_seq != expected_seq)
+    {
+        _asked_seq = expected_seq;
+        _naks = 0;
+    }
+    if (_naks >= MaxNaks)
+    {
+        LOG_ERROR(LOG_TAG, "Packet %u asked %u times, giving up", expected_seq, _naks);
+        return SerialStatus::CrcError;
+    }
+    _naks++;
+
+    LOG_DEBUG(LOG_TAG, "Asking packet %u again", expected_seq);
+    DataPacket nak {MsgId::Nak};
+    nak.header.protocol_ver = _protocol_ver;
+    nak.payload.sequence_number = expected_seq;
+    return send(nak);
+}
+
+SerialStatus Retransmitter::Resend(const SerialPacket& nak, const SendFunc& send)
+{
+    const uint32_t from_seq = nak.payload.sequence_number;
+    if (!_enabled || from_seq == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Unexpected nak of packet %u", from_seq);
+        return SerialStatus::SendFailed;
+    }
+    LOG_DEBUG(LOG_TAG, "Resending packets %u to %u", from_seq, _last_sent_seq);
+    for (uint32_t seq = from_seq; seq <= _last_sent_seq; seq++)
+    {
+        auto& kept = _kept[seq % Window];
+        if (_kept_seq[seq % Window] != seq)
+        {
+            LOG_ERROR(LOG_TAG, "Packet %u is no longer kept (last sent %u)", seq, _last_sent_seq);
+            return SerialStatus::SendFailed;
+        }
+        auto status = send(kept);
+        if (status != SerialStatus::Ok)
+        {
+            return status;
+        }
+    }
+    return SerialStatus::Ok;
+}
+
+bool Retransmitter::Drop(uint32_t sequence_number)
+{
+    if (_asked_seq == 0 || sequence_number < _asked_seq)
+    {
+        return false;
+    }
+    if (sequence_number == _asked_seq)
+    {
+        _asked_seq = 0;
+        _naks = 0;
+        return false;
+    }
+    LOG_DEBUG(LOG_TAG, "Dropping packet %u, waiting for packet %u", sequence_number, _asked_seq);
+    return true;
+}
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,64 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "SerialPacket.h"
+#include "CommonTypes.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Retransmission of packets received with a bad crc (RetransmitProtocolVer sessions), go back n:
+// the receiver answers the bad packet with a Nak packet carrying the sequence number it expects next (the bad one's),
+// and drops the packets after it. The sender resends its packets from that sequence number on, in order.
+// Nak packets are plain data packets (never encrypted) and don't take a sequence number of the sender's. Both sides
+// keep the last Window packets they sent, a nak of an older packet (or MaxNaks naks of the same one) fails the
+// receive as before.
+namespace RealSenseID
+{
+namespace PacketManager
+{
+class Retransmitter
+{
+public:
+    // the normal build keeps as many as the sessions pipeline (MaxPendingRequests)
+#ifdef RSID_LOW_MEMORY
+    static constexpr size_t Window = 4;
+#else
+    static constexpr size_t Window = 20;
+#endif
+    static constexpr unsigned int MaxNaks = 3; // per packet
+
+    using SendFunc = std::function<SerialStatus(SerialPacket&)>;
+
+    // on session start. enabled if the session's protocol version is RetransmitProtocolVer or newer
+    void Reset(unsigned char protocol_ver);
+    bool Enabled() const;
+
+    // keep a copy of the packet as sent (e.g. encrypted), with its sequence number
+    void Sent(const SerialPacket& packet, uint32_t sequence_number);
+
+    // a packet arrived with a bad crc after the one of last_recv_seq: send a nak of the next one.
+    // return Status::Ok if the nak was sent, CrcError if disabled or the packet was asked MaxNaks times already.
+    SerialStatus AskAgain(uint32_t last_recv_seq, const SendFunc& send);
+
+    // the peer sent a nak: resend the kept packets from its sequence number on (none if not sent yet).
+    // return Status::Ok on success, SendFailed if the first of them is no longer kept
+    SerialStatus Resend(const SerialPacket& nak, const SendFunc& send);
+
+    // true if the received packet is to be dropped: sent after the packet asked again, which is resent before it
+    bool Drop(uint32_t sequence_number);
+
+private:
+    bool _enabled = false;
+    unsigned char _protocol_ver = ProtocolVer;
+    std::vector<SerialPacket> _kept; // ring of Window packets, by sequence number (allocated once enabled)
+    std::vector<uint32_t> _kept_seq;
+    uint32_t _last_sent_seq = 0;
+    uint32_t _asked_seq = 0; // asked again and not received yet, 0 if none
+    unsigned int _naks = 0;  // of _asked_seq
+};
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,221 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#include "SerialCapture.h"
+#include "ThreadConfigImpl.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+static const char* LOG_TAG = "SerialCapture";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+namespace SerialCapture
+{
+static const char* CAPTURE_FILE = "rsid_serial.rec";
+
+// Bounded lock free multi producer queue of chunks (Vyukov's bounded queue, as the async log queue), drained by a
+// background thread that does the file io. Producers only copy the bytes into the chunk and never block.
+class CaptureQueue
+{
+public:
+#ifdef RSID_LOW_MEMORY
+    static constexpr size_t Capacity = 128; // power of 2
+#else
+    static constexpr size_t Capacity = 1024; // power of 2
+#endif
+
+    struct Chunk
+    {
+        std::atomic<size_t> sequence {0};
+        size_t position = 0;
+        Recording::RecordHeader header;
+        char data[ChunkSize];
+    };
+
+    CaptureQueue() : _chunks(new Chunk[Capacity]), _start {std::chrono::steady_clock::now()}
+    {
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            _chunks[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        _file = ::fopen(CAPTURE_FILE, "wb");
+        if (_file == nullptr)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to create %s", CAPTURE_FILE);
+        }
+        else
+        {
+            Recording::RecordingHeader header;
+            ::memset(&header, 0, sizeof(header));
+            ::memcpy(header.magic, Recording::FILE_MAGIC, sizeof(header.magic));
+            header.version = Recording::VERSION;
+            ::fwrite(&header, sizeof(header), 1, _file);
+        }
+        _thread = std::thread([this] { DrainLoop(); });
+    }
+
+    // write the queued chunks and close the file
+    ~CaptureQueue()
+    {
+        _stop = true;
+        _thread.join();
+        if (_file != nullptr)
+        {
+            ::fclose(_file);
+        }
+    }
+
+    CaptureQueue(const CaptureQueue&) = delete;
+    CaptureQueue& operator=(const CaptureQueue&) = delete;
+
+    void Push(uint8_t direction, const char* buffer, size_t size)
+    {
+        using namespace std::chrono;
+        auto time_us = duration_cast<microseconds>(steady_clock::now() - _start);
+        do
+        {
+            auto chunk_size = std::min(size, ChunkSize);
+            Chunk* chunk = Claim();
+            if (chunk == nullptr)
+            {
+                return;
+            }
+            ::memset(&chunk->header, 0, sizeof(chunk->header));
+            chunk->header.direction = direction;
+            chunk->header.size = static_cast<uint32_t>(chunk_size);
+            chunk->header.time_us = static_cast<uint64_t>(time_us.count());
+            if (chunk_size > 0)
+            {
+                ::memcpy(chunk->data, buffer, chunk_size);
+            }
+            chunk->sequence.store(chunk->position + 1, std::memory_order_release);
+            buffer += chunk_size;
+            size -= chunk_size;
+        } while (size > 0);
+    }
+
+private:
+    std::unique_ptr<Chunk[]> _chunks;
+    std::chrono::steady_clock::time_point _start;
+    std::atomic<size_t> _enqueue_position {0};
+    size_t _dequeue_position = 0; // background thread only
+    std::atomic<size_t> _dropped {0};
+    std::atomic<bool> _stop {false};
+    FILE* _file = nullptr;
+    std::thread _thread;
+
+    // chunk to fill and publish, nullptr if the queue is full
+    Chunk* Claim()
+    {
+        size_t position = _enqueue_position.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Chunk& chunk = _chunks[position & (Capacity - 1)];
+            size_t sequence = chunk.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (diff == 0)
+            {
+                if (_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    chunk.position = position;
+                    return &chunk;
+                }
+            }
+            else if (diff < 0)
+            {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            else
+            {
+                position = _enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // write the next chunk if published. return false if none.
+    bool DrainOne()
+    {
+        Chunk& chunk = _chunks[_dequeue_position & (Capacity - 1)];
+        if (chunk.sequence.load(std::memory_order_acquire) != _dequeue_position + 1)
+        {
+            return false;
+        }
+        if (_file != nullptr)
+        {
+            ::fwrite(&chunk.header, sizeof(chunk.header), 1, _file);
+            if (chunk.header.size > 0)
+            {
+                ::fwrite(chunk.data, chunk.header.size, 1, _file);
+            }
+        }
+        chunk.sequence.store(_dequeue_position + Capacity, std::memory_order_release);
+        _dequeue_position++;
+        return true;
+    }
+
+    void ReportDropped()
+    {
+        auto dropped = _dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0)
+        {
+            LOG_WARNING(LOG_TAG, "%zu serial capture chunks dropped (queue full)", dropped);
+        }
+    }
+
+    // wake up every 2 ms to write the queued chunks (the producers do not signal, to stay lock free), flush when idle
+    void DrainLoop()
+    {
+        ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Logging, "serial-capture");
+        while (!_stop)
+        {
+            bool any = false;
+            while (DrainOne())
+            {
+                any = true;
+            }
+            ReportDropped();
+            if (!any)
+            {
+                if (_file != nullptr)
+                {
+                    ::fflush(_file);
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds {2});
+            }
+        }
+        while (DrainOne())
+        {
+        }
+        ReportDropped();
+    }
+};
+
+static CaptureQueue& Queue()
+{
+    static CaptureQueue queue;
+    return queue;
+}
+
+void Opened()
+{
+    Queue().Push(Recording::Opened, nullptr, 0);
+}
+
+void Append(uint8_t direction, const char* buffer, size_t size)
+{
+    if (size > 0)
+    {
+        Queue().Push(direction, buffer, size);
+    }
+}
+} // namespace SerialCapture
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,39 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+#include "RecordingSerial.h"
+#include "Logger.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// Binary capture of the serial communication of the process (RSID_SERIAL_CAPTURE builds), in place of the hex logging
+// of RSID_DEBUG_SERIAL: the connections append the bytes they send and receive with their times to a lock free queue,
+// and a background thread writes them to rsid_serial.rec, a serial recording (see RecordingSerial.h) to decode with
+// rsid-serial-decode or replay with ReplaySerial. Chunks are split into records of up to ChunkSize bytes. When the
+// queue is full they are dropped and counted, the count is logged by the background thread.
+namespace SerialCapture
+{
+static const size_t ChunkSize = 480;
+
+// a connection was opened (starts a recorded connection)
+void Opened();
+
+// bytes sent or received (Recording::Sent, Recording::Received)
+void Append(uint8_t direction, const char* buffer, size_t size);
+} // namespace SerialCapture
+} // namespace PacketManager
+} // namespace RealSenseID
+
+#if defined(RSID_SERIAL_CAPTURE)
+#define SERIAL_OPENED()                 SerialCapture::Opened()
+#define SERIAL_SENT(tag, buf, size)     SerialCapture::Append(Recording::Sent, buf, size)
+#define SERIAL_RECEIVED(tag, buf, size) SerialCapture::Append(Recording::Received, buf, size)
+#else
+#define SERIAL_OPENED() (void)0
+#define SERIAL_SENT(tag, buf, size)     DEBUG_SERIAL(tag, "[snd]", buf, size)
+#define SERIAL_RECEIVED(tag, buf, size) DEBUG_SERIAL(tag, "[rcv]", buf, size)
+#endif // RSID_SERIAL_CAPTURE
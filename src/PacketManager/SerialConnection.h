@@ -4,24 +4,77 @@
 #pragma once
 
 #include "CommonTypes.h"
+#include "ReceiveBuffer.h"
+#include <cstddef>
+#include <cstring>
+#include <vector>
 
 namespace RealSenseID
 {
 namespace PacketManager
 {
+// one segment of a gather send
+struct SendBuffer
+{
+    const char* buffer;
+    size_t n_bytes;
+};
+
 // Represents an open serial connection (raii over the os serial connection).
 // Should open new connection on construction and close it on destruction.
 // Should throw if connection could not be established on construction.
 class SerialConnection
 {
 public:
+    SerialConnection() : _recv_buffer {*this}
+    {
+    }
+
     virtual ~SerialConnection() = default;
 
     // send all bytes and return status
     virtual SerialStatus SendBytes(const char* buffer, size_t n_bytes) = 0;
 
-    // receive all bytes and copy to the buffer
+    // send all segments in order as one write.
+    // default (for connections without a native gather write): the segments are copied to one buffer and sent with a
+    // single SendBytes() call.
+    virtual SerialStatus SendBytesv(const SendBuffer* buffers, size_t n_buffers)
+    {
+        size_t total_bytes = 0;
+        for (size_t i = 0; i < n_buffers; i++)
+        {
+            total_bytes += buffers[i].n_bytes;
+        }
+
+        std::vector<char> send_buffer(total_bytes);
+        size_t offset = 0;
+        for (size_t i = 0; i < n_buffers; i++)
+        {
+            if (buffers[i].n_bytes > 0)
+            {
+                ::memcpy(send_buffer.data() + offset, buffers[i].buffer, buffers[i].n_bytes);
+                offset += buffers[i].n_bytes;
+            }
+        }
+        return SendBytes(send_buffer.data(), total_bytes);
+    }
+
+    // receive all bytes and copy to the buffer (through the receive buffer)
     virtual SerialStatus RecvBytes(char* buffer, size_t n_bytes) = 0;
+
+    // receive whatever the os has available, at least 1 and at most max_bytes.
+    // waits up to timeout for the first byte and returns as soon as it arrives. returns Status::RecvTimeout if
+    // none arrived. used by the receive buffer, readers should use RecvBytes() or the receive buffer.
+    virtual SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) = 0;
+
+    // bytes received from the os but not yet consumed
+    ReceiveBuffer& GetReceiveBuffer()
+    {
+        return _recv_buffer;
+    }
+
+protected:
+    ReceiveBuffer _recv_buffer;
 };
 } // namespace PacketManager
 } // namespace RealSenseID
@@ -0,0 +1,85 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#include "SerialFactory.h"
+#include "TcpSerial.h"
+#include "RecordingSerial.h"
+#include "ReplaySerial.h"
+#include "EmulatorSerial.h"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include "WindowsSerial.h"
+#elif LINUX
+#include "LinuxSerial.h"
+#include "LinuxUsbSerial.h"
+#endif
+
+static const char* RECORD_PREFIX = "record://";
+static const char* REPLAY_PREFIX = "replay://";
+static const char* REPLAY_FAST_PREFIX = "replay-fast://";
+static const char* USB_PREFIX = "usb://";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+static bool HasPrefix(const char* port, const char* prefix)
+{
+    return ::strncmp(port, prefix, ::strlen(prefix)) == 0;
+}
+
+std::unique_ptr<SerialConnection> OpenSerialConnection(const SerialConfig& config)
+{
+    const char* port = config.port != nullptr ? config.port : "";
+    if (TcpSerial::IsTcpPort(port))
+    {
+        return std::make_unique<TcpSerial>(config);
+    }
+    if (HasPrefix(port, REPLAY_PREFIX))
+    {
+        return std::make_unique<ReplaySerial>(port + ::strlen(REPLAY_PREFIX), false);
+    }
+    if (HasPrefix(port, REPLAY_FAST_PREFIX))
+    {
+        return std::make_unique<ReplaySerial>(port + ::strlen(REPLAY_FAST_PREFIX), true);
+    }
+    if (EmulatorSerial::IsEmulatorPort(port))
+    {
+        return std::make_unique<EmulatorSerial>(port);
+    }
+    if (HasPrefix(port, USB_PREFIX))
+    {
+#if LINUX
+        return std::make_unique<LinuxUsbSerial>(config);
+#else
+        throw std::runtime_error(std::string("Invalid port ") + port + ", usb:// ports are supported on Linux only");
+#endif
+    }
+    if (HasPrefix(port, RECORD_PREFIX))
+    {
+        // the file name ends at the last '@', the recorded port may be any of the above
+        std::string target = port + ::strlen(RECORD_PREFIX);
+        auto separator = target.rfind('@');
+        if (separator == std::string::npos || separator == 0 || separator + 1 == target.size())
+        {
+            throw std::runtime_error(std::string("Invalid port ") + port + ", expected record://<file>@<port>");
+        }
+        std::string path = target.substr(0, separator);
+        std::string recorded_port = target.substr(separator + 1);
+        SerialConfig recorded_config = config;
+        recorded_config.port = recorded_port.c_str();
+        return std::make_unique<RecordingSerial>(OpenSerialConnection(recorded_config), path.c_str());
+    }
+
+#ifdef _WIN32
+    return std::make_unique<WindowsSerial>(config);
+#elif LINUX
+    return std::make_unique<LinuxSerial>(config);
+#else
+    throw std::runtime_error("Serial connection method not supported for OS");
+#endif
+}
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -0,0 +1,21 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+#include "SerialConnection.h"
+#include <memory>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// Open the connection of the config's port:
+//   tcp://<host>:<port>                             TcpSerial (device behind rsid-proxy)
+//   record://<file>@<port>                          RecordingSerial of the connection of the port
+//   replay://<file>, replay-fast://<file>           ReplaySerial at the recorded pace or as fast as possible
+//   emulator://<name>[?<options>]                   EmulatorSerial, a DeviceEmulator in the process
+//   usb://<tty>                                     LinuxUsbSerial, the bulk endpoints of the tty's device (Linux)
+//   any other port                                  the os serial port (WindowsSerial, LinuxSerial)
+// Throws if the connection could not be opened.
+std::unique_ptr<SerialConnection> OpenSerialConnection(const SerialConfig& config);
+} // namespace PacketManager
+} // namespace RealSenseID
@@ -24,6 +24,28 @@ SerialPacket::SerialPacket()
     header.payload_size = 0;
 }
 
+size_t SerialPacket::UsedPayloadSize() const
+{
+    // the sequence number is written even if a packet is sent without payload
+    size_t size = header.payload_size > sizeof(payload.sequence_number) ? header.payload_size
+                                                                           : sizeof(payload.sequence_number);
+    return size < sizeof(payload) ? size : sizeof(payload);
+}
+
+void SerialPacket::Reset()
+{
+    ::memset(&payload, 0, UsedPayloadSize());
+    ::memset(&header, 0, sizeof(header));
+    ::memset(hmac, 0, sizeof(hmac));
+    crc = 0;
+
+    header.sync1 = SyncByte::Sync1;
+    header.sync2 = SyncByte::Sync2;
+    header.protocol_ver = ProtocolVer;
+    header.id = MsgId::None;
+    header.payload_size = 0;
+}
+
 static int AlignTo32Bytes(int size)
 {
     int mod = size % 32;
@@ -37,6 +59,12 @@ static int AlignTo32Bytes(int size)
 //
 FaPacket::FaPacket(MsgId id, const char* user_id, char status)
 {
+    Reset(id, user_id, status);
+}
+
+void FaPacket::Reset(MsgId id, const char* user_id, char status)
+{
+    SerialPacket::Reset();
     header.id = id;
     header.payload_size = static_cast<uint16_t>(AlignTo32Bytes(sizeof(payload.sequence_number) + sizeof(FaMessage)));
     auto& fa_msg = payload.message.fa_msg;
@@ -74,13 +102,19 @@ char FaPacket::GetStatusCode()
 //
 DataPacket::DataPacket(MsgId id, char* data, size_t data_size)
 {
-    header.id = id;
-    header.payload_size = static_cast<uint16_t>(AlignTo32Bytes(sizeof(payload.sequence_number) + (int)data_size));
+    Reset(id, data, data_size);
+}
+
+void DataPacket::Reset(MsgId id, const char* data, size_t data_size)
+{
     uint32_t target_size = sizeof(payload.sequence_number) + sizeof(payload.message.data_msg.data);
-    if (header.payload_size > target_size)
+    if (AlignTo32Bytes(sizeof(payload.sequence_number) + (int)data_size) > static_cast<int>(target_size))
     {
         throw std::runtime_error("DataPacket ctor: given size exceeds max allowed");
     }
+    SerialPacket::Reset();
+    header.id = id;
+    header.payload_size = static_cast<uint16_t>(AlignTo32Bytes(sizeof(payload.sequence_number) + (int)data_size));
     auto* target_ptr = payload.message.data_msg.data;
     if (data != nullptr)
     {
@@ -98,6 +132,15 @@ const DataMessage& DataPacket::Data() const
     return payload.message.data_msg;
 }
 
+void AdvertiseProtocolVer(DataPacket& packet, size_t data_size)
+{
+    if (sizeof(packet.payload.sequence_number) + data_size >= packet.header.payload_size)
+    {
+        throw std::runtime_error("AdvertiseProtocolVer: no padding byte after the packet data");
+    }
+    packet.payload.message.data_msg.data[data_size] = static_cast<char>(MaxProtocolVer);
+}
+
 bool IsFaPacket(const SerialPacket& packet)
 {
     return packet.header.id >= MsgId::MinFa && packet.header.id <= MsgId::MaxFa;
@@ -18,6 +18,30 @@ namespace RealSenseID
     namespace PacketManager
     {
         static const unsigned char ProtocolVer = 2;
+        // from this version on the crc covers only the sent bytes (header, payload_size bytes of payload, hmac)
+        // instead of the whole packet. sessions switch to it only if the device answers the session start with it.
+        static const unsigned char CompactCrcProtocolVer = 3;
+        // from this version on the device stays in binary mode from the session start until the next session start
+        // (text commands such as __FACE_CANCEL__ are still recognized between packets), so the packets of the session are
+        // sent without the __FACE_API__ command. the session start itself is always preceded by it.
+        static const unsigned char BinaryModeProtocolVer = 4;
+        // from this version on messages bigger than one packet can be sent as consecutive frames (see MultiFrame.h)
+        static const unsigned char MultiFrameProtocolVer = 5;
+        // from this version on a packet received with a bad crc is asked again with a Nak packet instead of failing the
+        // operation, and the sender resends it (see Retransmit.h)
+        static const unsigned char RetransmitProtocolVer = 6;
+        // from this version on the authentication loop can extract the faceprints of several faces per frame (see
+        // MultiFace.h)
+        static const unsigned char MultiFaceProtocolVer = 7;
+        // from this version on the device stamps the clock sync pings with its clock (see ClockSyncPing.h)
+        static const unsigned char ClockSyncProtocolVer = 8;
+        // from this version on the device may pack a burst of small messages into one packet (see Coalesced.h)
+        static const unsigned char CoalesceProtocolVer = 9;
+        // from this version on the device sends only the flow events the session start subscribes to (see
+        // EventFilter.h)
+        static const unsigned char EventMaskProtocolVer = 10;
+        // newest protocol version supported by the host
+        static const unsigned char MaxProtocolVer = EventMaskProtocolVer;
         static const size_t MaxUserIdSize = 30;
 
         struct FaMessage
@@ -61,8 +85,10 @@ enum class MsgId : char
     DeviceEcdsaKey = 'b',
     HostEcdhKey = 'c',
     DeviceEcdhKey = 'd',    
+    Nak = 'e', // resend from the packet's sequence number (RetransmitProtocolVer)
     Faceprints = 'f',
     FaceDetected = 'g',
+    MultiFaceprints = 'h',
     GetNumberOfUsers = 'n',
     StartSession = 'o',
     Ping = 'p',
@@ -70,6 +96,7 @@ enum class MsgId : char
     SetDeviceConfig = 's',
     StandBy = 't',
     GetUserIds = 'u',    
+    Coalesced = 'w', // several messages in one packet (CoalesceProtocolVer)
     SecureFaceprintsBeginSecureSession = 'i',
     SecureFaceprintsEndSecureSession = 'j',
     SecureFaceprintsOnSecureSessionReady = 'k',
@@ -104,6 +131,13 @@ enum class MsgId : char
             char hmac[32]; // if security is enabled it will store hmac calculation
             uint16_t crc;
             SerialPacket();
+
+            // the payload bytes after the first UsedPayloadSize() bytes are always zero (zeroed on construction, only
+            // payload_size bytes are written, sent or received), so reusing a packet needs to clear only those
+            size_t UsedPayloadSize() const;
+
+            // reset to a newly constructed packet, clearing only the used part of the payload
+            void Reset();
         };
 
         //
@@ -113,6 +147,8 @@ enum class MsgId : char
         {
             FaPacket(MsgId id, const char* user_id, char status);
             FaPacket(MsgId id);
+            // reuse the packet as if constructed with the given args (see SerialPacket::Reset())
+            void Reset(MsgId id, const char* user_id = nullptr, char status = 0);
             const char* GetUserId() const;
             char GetStatusCode();
         };
@@ -123,9 +159,16 @@ enum class MsgId : char
             // copy data to packet. pad with zeros if data_size is smaller than actual reserved data size
             DataPacket(MsgId id, char* data, size_t data_size);
             DataPacket(MsgId id);
+            // reuse the packet as if constructed with the given args (see SerialPacket::Reset())
+            void Reset(MsgId id, const char* data = nullptr, size_t data_size = 0);
             const DataMessage& Data() const;
         };
 
+        // advertise the newest protocol version the host supports in the session start packet (StartSession or
+        // HostEcdhKey), in the first padding byte after its data_size bytes of data. older hosts leave it zero, older
+        // firmware ignores it. the device answers with the newest version both sides support.
+        void AdvertiseProtocolVer(DataPacket& packet, size_t data_size);
+
         bool IsFaPacket(const SerialPacket& packet);   // if MsgId in the 'A'..'Z' range
         bool IsDataPacket(const SerialPacket& packet); // if MsgId in the 'a'..'z' range
 
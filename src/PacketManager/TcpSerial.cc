@@ -0,0 +1,428 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include "TcpSerial.h"
+#include "Timer.h"
+#include "Logger.h"
+#include "SerialCapture.h"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static const char* LOG_TAG = "TcpSerial";
+static const char* TCP_PREFIX = "tcp://";
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+#ifdef _WIN32
+static const socket_handle_t INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+using pollfd_t = WSAPOLLFD;
+
+// WSAStartup() once per process
+static void InitSockets()
+{
+    struct WinSockInit
+    {
+        WinSockInit()
+        {
+            WSADATA wsa_data;
+            ::WSAStartup(MAKEWORD(2, 2), &wsa_data);
+        }
+    };
+    static WinSockInit init;
+}
+
+static int LastSocketError()
+{
+    return ::WSAGetLastError();
+}
+
+static void CloseSocket(socket_handle_t socket)
+{
+    ::closesocket(socket);
+}
+
+static int PollSocket(pollfd_t& poll_fd, int timeout_ms)
+{
+    return ::WSAPoll(&poll_fd, 1, timeout_ms);
+}
+
+static bool Interrupted()
+{
+    return false;
+}
+#else
+static const socket_handle_t INVALID_SOCKET_HANDLE = -1;
+using pollfd_t = struct pollfd;
+
+static void InitSockets()
+{
+}
+
+static int LastSocketError()
+{
+    return errno;
+}
+
+static void CloseSocket(socket_handle_t socket)
+{
+    ::close(socket);
+}
+
+static int PollSocket(pollfd_t& poll_fd, int timeout_ms)
+{
+    return ::poll(&poll_fd, 1, timeout_ms);
+}
+
+static bool Interrupted()
+{
+    return errno == EINTR;
+}
+#endif // _WIN32
+
+static void ThrowSocketError(const std::string& msg)
+{
+    throw std::runtime_error(msg + ". socket error " + std::to_string(LastSocketError()));
+}
+
+// "tcp://<host>:<port>", the host may be a bracketed ipv6 address
+static void ParsePort(const char* port, std::string& host, std::string& service)
+{
+    std::string address = port + ::strlen(TCP_PREFIX);
+    auto colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == address.size())
+    {
+        throw std::runtime_error(std::string("Invalid tcp port ") + port + ", expected tcp://<host>:<port>");
+    }
+    host = address.substr(0, colon);
+    service = address.substr(colon + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+    {
+        host = host.substr(1, host.size() - 2);
+    }
+}
+
+// packets should leave at once, and dead peers (e.g. a rebooted edge box) should be noticed
+static void ConfigureSocket(socket_handle_t socket)
+{
+    int enable = 1;
+    if (::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable)) != 0)
+    {
+        LOG_WARNING(LOG_TAG, "Failed to disable Nagle. socket error %d", LastSocketError());
+    }
+    ::setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, reinterpret_cast<const char*>(&enable), sizeof(enable));
+}
+
+bool TcpSerial::IsTcpPort(const char* port)
+{
+    return port != nullptr && ::strncmp(port, TCP_PREFIX, ::strlen(TCP_PREFIX)) == 0;
+}
+
+TcpSerial::TcpSerial(const SerialConfig& config) : _socket {INVALID_SOCKET_HANDLE}
+{
+    if (!IsTcpPort(config.port))
+    {
+        throw std::runtime_error("Not a tcp port");
+    }
+    std::string host, service;
+    ParsePort(config.port, host, service);
+    LOG_DEBUG(LOG_TAG, "Connecting to %s port %s", host.c_str(), service.c_str());
+
+    InitSockets();
+    struct addrinfo hints;
+    ::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    struct addrinfo* addresses = nullptr;
+    int rv = ::getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses);
+    if (rv != 0)
+    {
+        throw std::runtime_error("Failed to resolve " + host + ". getaddrinfo error " + std::to_string(rv));
+    }
+    for (auto* address = addresses; address != nullptr; address = address->ai_next)
+    {
+        _socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (_socket == INVALID_SOCKET_HANDLE)
+        {
+            continue;
+        }
+        if (::connect(_socket, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0)
+        {
+            break;
+        }
+        CloseSocket(_socket);
+        _socket = INVALID_SOCKET_HANDLE;
+    }
+    ::freeaddrinfo(addresses);
+    if (_socket == INVALID_SOCKET_HANDLE)
+    {
+        ThrowSocketError("Failed to connect to " + host + ":" + service);
+    }
+    ConfigureSocket(_socket);
+    SERIAL_OPENED();
+}
+
+TcpSerial::TcpSerial(socket_handle_t socket) : _socket {socket}
+{
+    ConfigureSocket(_socket);
+    SERIAL_OPENED();
+}
+
+TcpSerial::~TcpSerial()
+{
+    try
+    {
+        CloseSocket(_socket);
+    }
+    catch (...)
+    {
+    }
+}
+
+SerialStatus TcpSerial::SendBytes(const char* buffer, size_t n_bytes)
+{
+    SendBuffer send_buffer {buffer, n_bytes};
+    return SendBytesv(&send_buffer, 1);
+}
+
+#ifdef _WIN32
+SerialStatus TcpSerial::SendBytesv(const SendBuffer* buffers, size_t n_buffers)
+{
+    std::vector<WSABUF> wsa_buffers;
+    wsa_buffers.reserve(n_buffers);
+    size_t n_bytes = 0;
+    for (size_t i = 0; i < n_buffers; i++)
+    {
+        if (buffers[i].n_bytes == 0)
+        {
+            continue;
+        }
+        SERIAL_SENT(LOG_TAG, buffers[i].buffer, buffers[i].n_bytes);
+        wsa_buffers.push_back({static_cast<ULONG>(buffers[i].n_bytes), const_cast<char*>(buffers[i].buffer)});
+        n_bytes += buffers[i].n_bytes;
+    }
+
+    // blocking sockets complete the whole send
+    DWORD bytes_sent = 0;
+    if (::WSASend(_socket, wsa_buffers.data(), static_cast<DWORD>(wsa_buffers.size()), &bytes_sent, 0, nullptr,
+                  nullptr) != 0 ||
+        bytes_sent != n_bytes)
+    {
+        LOG_ERROR(LOG_TAG, "Error while sending %zu bytes. socket error %d, sent: %lu", n_bytes, LastSocketError(),
+                  bytes_sent);
+        return SerialStatus::SendFailed;
+    }
+    return SerialStatus::Ok;
+}
+#else
+SerialStatus TcpSerial::SendBytesv(const SendBuffer* buffers, size_t n_buffers)
+{
+    std::vector<struct iovec> iov;
+    iov.reserve(n_buffers);
+    size_t n_bytes = 0;
+    for (size_t i = 0; i < n_buffers; i++)
+    {
+        if (buffers[i].n_bytes == 0)
+        {
+            continue;
+        }
+        SERIAL_SENT(LOG_TAG, buffers[i].buffer, buffers[i].n_bytes);
+        iov.push_back({const_cast<char*>(buffers[i].buffer), buffers[i].n_bytes});
+        n_bytes += buffers[i].n_bytes;
+    }
+
+    // sendmsg may send only part of the segments - continue from the first unsent byte
+    size_t bytes_sent = 0;
+    size_t iov_index = 0;
+    while (iov_index < iov.size())
+    {
+        struct msghdr message;
+        ::memset(&message, 0, sizeof(message));
+        message.msg_iov = &iov[iov_index];
+        message.msg_iovlen = std::min<size_t>(iov.size() - iov_index, IOV_MAX);
+        // a closed peer fails the send instead of raising SIGPIPE
+        auto send_rv = ::sendmsg(_socket, &message, MSG_NOSIGNAL);
+        if (send_rv < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (send_rv <= 0)
+        {
+            LOG_ERROR(LOG_TAG, "Error while sending %zu bytes. errno=%d, sent so far: %zu", n_bytes, errno,
+                      bytes_sent);
+            return SerialStatus::SendFailed;
+        }
+        bytes_sent += static_cast<size_t>(send_rv);
+
+        size_t written = static_cast<size_t>(send_rv);
+        while (iov_index < iov.size() && written >= iov[iov_index].iov_len)
+        {
+            written -= iov[iov_index].iov_len;
+            iov_index++;
+        }
+        if (iov_index < iov.size())
+        {
+            iov[iov_index].iov_base = static_cast<char*>(iov[iov_index].iov_base) + written;
+            iov[iov_index].iov_len -= written;
+        }
+    }
+    assert(n_bytes == bytes_sent);
+    return SerialStatus::Ok;
+}
+#endif // _WIN32
+
+SerialStatus TcpSerial::RecvBytes(char* buffer, size_t n_bytes)
+{
+    if (n_bytes == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Attempt to recv 0 bytes");
+        return SerialStatus::RecvFailed;
+    }
+
+    // same timeouts as the serial ports, the proxy adds little latency
+    Timer timer {std::chrono::milliseconds {200 + 4 * n_bytes}};
+    auto status = _recv_buffer.Recv(buffer, n_bytes, timer);
+    if (status == SerialStatus::RecvTimeout && n_bytes != 1)
+    {
+        LOG_DEBUG(LOG_TAG, "Timeout recv %zu bytes. Got only %zu bytes", n_bytes, _recv_buffer.Size());
+    }
+    return status;
+}
+
+SerialStatus TcpSerial::RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout)
+{
+    n_bytes = 0;
+
+    Timer timer {timeout};
+    pollfd_t poll_fd;
+    ::memset(&poll_fd, 0, sizeof(poll_fd));
+    poll_fd.fd = _socket;
+    poll_fd.events = POLLIN;
+    while (true)
+    {
+        auto time_left = std::max(timer.TimeLeft().count(), static_cast<timeout_t::rep>(0));
+        int poll_timeout = static_cast<int>(std::min(time_left, static_cast<timeout_t::rep>(INT_MAX)));
+        int poll_rv = PollSocket(poll_fd, poll_timeout);
+        if (poll_rv > 0)
+        {
+            break;
+        }
+        if (poll_rv == 0)
+        {
+            return SerialStatus::RecvTimeout;
+        }
+        if (!Interrupted())
+        {
+            LOG_ERROR(LOG_TAG, "[rcv] poll failed. socket error %d", LastSocketError());
+            return SerialStatus::RecvFailed;
+        }
+    }
+
+    if (poll_fd.revents & (POLLERR | POLLNVAL))
+    {
+        LOG_ERROR(LOG_TAG, "[rcv] poll revents %d", poll_fd.revents);
+        return SerialStatus::RecvFailed;
+    }
+
+    int max_recv = static_cast<int>(std::min(max_bytes, static_cast<size_t>(INT_MAX)));
+    auto recv_rv = ::recv(_socket, buffer, max_recv, 0);
+    if (recv_rv < 0)
+    {
+        LOG_ERROR(LOG_TAG, "[rcv] recv failed. socket error %d", LastSocketError());
+        return SerialStatus::RecvFailed;
+    }
+    if (recv_rv == 0)
+    {
+        LOG_DEBUG(LOG_TAG, "[rcv] Connection closed by peer");
+        return SerialStatus::RecvFailed;
+    }
+    SERIAL_RECEIVED(LOG_TAG, buffer, recv_rv);
+    n_bytes = static_cast<size_t>(recv_rv);
+    return SerialStatus::Ok;
+}
+
+TcpListener::TcpListener(unsigned short port, const std::string& address) : _socket {INVALID_SOCKET_HANDLE}
+{
+    InitSockets();
+    struct sockaddr_in bind_address;
+    ::memset(&bind_address, 0, sizeof(bind_address));
+    bind_address.sin_family = AF_INET;
+    bind_address.sin_port = htons(port);
+    if (::inet_pton(AF_INET, address.c_str(), &bind_address.sin_addr) != 1)
+    {
+        throw std::runtime_error("Invalid listen address " + address);
+    }
+    _socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (_socket == INVALID_SOCKET_HANDLE)
+    {
+        ThrowSocketError("Failed to create socket");
+    }
+#ifndef _WIN32
+    // restart without waiting for the previous connections to time out
+    int enable = 1;
+    ::setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+#endif
+    if (::bind(_socket, reinterpret_cast<struct sockaddr*>(&bind_address), sizeof(bind_address)) != 0 ||
+        ::listen(_socket, 1) != 0)
+    {
+        int error = LastSocketError();
+        CloseSocket(_socket);
+        throw std::runtime_error("Failed to listen on " + address + " port " + std::to_string(port) +
+                                 ". socket error " + std::to_string(error));
+    }
+    LOG_DEBUG(LOG_TAG, "Listening on %s port %u", address.c_str(), port);
+}
+
+TcpListener::~TcpListener()
+{
+    try
+    {
+        CloseSocket(_socket);
+    }
+    catch (...)
+    {
+    }
+}
+
+std::unique_ptr<TcpSerial> TcpListener::Accept(timeout_t timeout)
+{
+    pollfd_t poll_fd;
+    ::memset(&poll_fd, 0, sizeof(poll_fd));
+    poll_fd.fd = _socket;
+    poll_fd.events = POLLIN;
+    if (PollSocket(poll_fd, static_cast<int>(timeout.count())) <= 0)
+    {
+        return nullptr;
+    }
+    socket_handle_t client = ::accept(_socket, nullptr, nullptr);
+    if (client == INVALID_SOCKET_HANDLE)
+    {
+        LOG_ERROR(LOG_TAG, "Accept failed. socket error %d", LastSocketError());
+        return nullptr;
+    }
+    return std::make_unique<TcpSerial>(client);
+}
+} // namespace PacketManager
+} // namespace RealSenseID
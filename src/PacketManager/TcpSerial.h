@@ -0,0 +1,73 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+#include "SerialConnection.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+#ifdef _WIN32
+using socket_handle_t = uintptr_t; // SOCKET
+#else
+using socket_handle_t = int;
+#endif
+
+// Serial connection tunneled over TCP to a device attached to another machine (rsid-proxy, see SerialProxy).
+// Nagle is off, so each send goes out at once. Gather sends are a single write, so a packet is one segment.
+class TcpSerial : public SerialConnection
+{
+public:
+    // config.port is "tcp://<host>:<port>", the baud rate is the proxy's
+    explicit TcpSerial(const SerialConfig& config);
+
+    // connection of an accepted socket, closed on destruction (see TcpListener)
+    explicit TcpSerial(socket_handle_t socket);
+
+    ~TcpSerial() override;
+
+    TcpSerial(const TcpSerial&) = delete;
+    TcpSerial operator=(const TcpSerial&) = delete;
+
+    // true if the port is a "tcp://" one
+    static bool IsTcpPort(const char* port);
+
+    // send all bytes and return status
+    SerialStatus SendBytes(const char* buffer, size_t n_bytes) final;
+
+    // send all segments with a single gather write
+    SerialStatus SendBytesv(const SendBuffer* buffers, size_t n_buffers) final;
+
+    // receive all bytes and copy to the buffer
+    SerialStatus RecvBytes(char* buffer, size_t n_bytes) final;
+
+    // poll() up to the timeout and recv() what is available
+    SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) final;
+
+private:
+    socket_handle_t _socket;
+};
+
+// Listening socket of the proxy
+class TcpListener
+{
+public:
+    // listen on the interface of the ipv4 address, loopback only by default ("0.0.0.0" for all interfaces).
+    // throws on errors
+    explicit TcpListener(unsigned short port, const std::string& address = "127.0.0.1");
+    ~TcpListener();
+
+    TcpListener(const TcpListener&) = delete;
+    TcpListener operator=(const TcpListener&) = delete;
+
+    // wait up to the timeout for a connection. nullptr if none
+    std::unique_ptr<TcpSerial> Accept(timeout_t timeout);
+
+private:
+    socket_handle_t _socket;
+};
+} // namespace PacketManager
+} // namespace RealSenseID
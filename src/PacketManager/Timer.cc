@@ -35,5 +35,11 @@ void Timer::Reset()
 {
     _start_tp = clock ::now();
 }
+
+Timer Timer::Earliest(const Timer& deadline, timeout_t timeout)
+{
+    auto time_left = deadline.TimeLeft();
+    return Timer {time_left < timeout ? time_left : timeout};
+}
 } // namespace PacketManager
 } // namespace RealSenseID
@@ -26,6 +26,9 @@ public:
     bool ReachedTimeout() const;
     void Reset();
 
+    // timer which expires after the given timeout, or with the deadline if that expires first
+    static Timer Earliest(const Timer& deadline, timeout_t timeout);
+
 private:
     timeout_t _timeout;
     std::chrono::time_point<clock> _start_tp;
@@ -0,0 +1,222 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "UsbBulkReader.h"
+#include "ThreadConfigImpl.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+static const char* LOG_TAG = "UsbBulkReader";
+// how often the reaper thread checks the stop flag while all segments wait for the consumer
+static constexpr std::chrono::milliseconds space_wait_timeout {100};
+
+UsbBulkReader::UsbBulkReader(int file_descriptor, int endpoint_address, size_t buffer_size) :
+    _file_descriptor {file_descriptor}, _endpoint_address {endpoint_address},
+    _segments(std::max(MinSegments, buffer_size / SegmentSize))
+{
+    for (auto& segment : _segments)
+    {
+        segment.urb.reset(new usbdevfs_urb());
+        // usbfs memory lets the host controller write directly to the segment (linux 4.6+), otherwise the kernel
+        // copies from its own transfer buffer
+        void* memory = ::mmap(nullptr, SegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, _file_descriptor, 0);
+        if (memory != MAP_FAILED)
+        {
+            segment.data = static_cast<char*>(memory);
+            segment.mapped = true;
+        }
+        else
+        {
+            segment.data = new char[SegmentSize];
+        }
+    }
+}
+
+UsbBulkReader::~UsbBulkReader()
+{
+    Stop();
+    for (auto& segment : _segments)
+    {
+        if (segment.mapped)
+        {
+            ::munmap(segment.data, SegmentSize);
+        }
+        else
+        {
+            delete[] segment.data;
+        }
+    }
+}
+
+bool UsbBulkReader::Start()
+{
+    if (!SubmitFree() && _submitted == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to submit bulk URB. errno: %d", errno);
+        return false;
+    }
+    _reaper_thread = std::thread(&UsbBulkReader::ReaperLoop, this);
+    return true;
+}
+
+bool UsbBulkReader::Submit(Segment& segment)
+{
+    auto* urb = segment.urb.get();
+    ::memset(urb, 0, sizeof(*urb));
+    urb->type = USBDEVFS_URB_TYPE_BULK;
+    urb->endpoint = static_cast<unsigned char>(_endpoint_address);
+    urb->buffer = segment.data;
+    urb->buffer_length = static_cast<int>(SegmentSize);
+    urb->usercontext = &segment;
+    segment.length = 0;
+    segment.offset = 0;
+    return ::ioctl(_file_descriptor, USBDEVFS_SUBMITURB, urb) == 0;
+}
+
+bool UsbBulkReader::SubmitFree()
+{
+    // under the lock: no new URBs once Stop() discarded the ones in flight
+    const std::lock_guard<std::mutex> lock(_mutex);
+    auto submitted = _submitted.load(std::memory_order_relaxed);
+    while (!_stop && submitted - _consumed.load(std::memory_order_acquire) < _segments.size())
+    {
+        if (!Submit(_segments[submitted % _segments.size()]))
+        {
+            return false;
+        }
+        _submitted.store(++submitted, std::memory_order_release);
+    }
+    return true;
+}
+
+void UsbBulkReader::ReaperLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Serial, "usb-reaper");
+    while (true)
+    {
+        bool submit_ok = SubmitFree();
+        if (_reaped.load(std::memory_order_relaxed) == _submitted.load(std::memory_order_relaxed))
+        {
+            if (_stop)
+            {
+                break;
+            }
+            // nothing in flight: all segments wait for the consumer (or submitting failed, retry later)
+            std::unique_lock<std::mutex> lock(_mutex);
+            _reaper_waiting.store(true, std::memory_order_seq_cst);
+            _space_cv.wait_for(lock, space_wait_timeout, [this, submit_ok] {
+                return _stop || (submit_ok && _submitted.load(std::memory_order_relaxed) -
+                                                      _consumed.load(std::memory_order_acquire) <
+                                                  _segments.size());
+            });
+            _reaper_waiting.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        usbdevfs_urb* urb = nullptr;
+        if (::ioctl(_file_descriptor, USBDEVFS_REAPURB, &urb) != 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR(LOG_TAG, "Failed to reap bulk URB. errno: %d", errno);
+            break;
+        }
+
+        // bulk URBs of an endpoint complete in submission order
+        auto reaped = _reaped.load(std::memory_order_relaxed);
+        auto* segment = static_cast<Segment*>(urb->usercontext);
+        assert(segment == &_segments[reaped % _segments.size()]);
+        if (urb->status != 0 && !_stop)
+        {
+            LOG_DEBUG(LOG_TAG, "Bulk URB completed with status %d", urb->status);
+        }
+        segment->length = urb->actual_length > 0 ? static_cast<size_t>(urb->actual_length) : 0;
+        _reaped.store(reaped + 1, std::memory_order_seq_cst);
+        Notify(_consumer_waiting, _data_cv);
+    }
+}
+
+size_t UsbBulkReader::Read(char* destination, size_t max_bytes, std::chrono::milliseconds timeout)
+{
+    auto has_data = [this] {
+        return _consumed.load(std::memory_order_relaxed) != _reaped.load(std::memory_order_acquire);
+    };
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    size_t bytes_read = 0;
+    // empty segments (zero length transfers) are skipped, keep waiting until there are bytes or the deadline passes
+    while (bytes_read == 0)
+    {
+        if (!has_data())
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _consumer_waiting.store(true, std::memory_order_seq_cst);
+            bool got_data = _data_cv.wait_until(lock, deadline, has_data);
+            _consumer_waiting.store(false, std::memory_order_relaxed);
+            if (!got_data)
+            {
+                return 0;
+            }
+        }
+
+        auto consumed = _consumed.load(std::memory_order_relaxed);
+        auto reaped = _reaped.load(std::memory_order_acquire);
+        while (bytes_read < max_bytes && consumed != reaped)
+        {
+            auto& segment = _segments[consumed % _segments.size()];
+            auto n_bytes = std::min(max_bytes - bytes_read, segment.length - segment.offset);
+            ::memcpy(destination + bytes_read, segment.data + segment.offset, n_bytes);
+            segment.offset += n_bytes;
+            bytes_read += n_bytes;
+            if (segment.offset == segment.length)
+            {
+                // segment done, the reaper may resubmit it
+                _consumed.store(++consumed, std::memory_order_seq_cst);
+                Notify(_reaper_waiting, _space_cv);
+            }
+        }
+    }
+    return bytes_read;
+}
+
+// same scheme as CyclicBuffer: seq_cst index store before, seq_cst waiting flag store in the waiter
+void UsbBulkReader::Notify(std::atomic<bool>& waiting, std::condition_variable& cv)
+{
+    if (waiting.load(std::memory_order_seq_cst))
+    {
+        {
+            const std::lock_guard<std::mutex> lock(_mutex);
+        }
+        cv.notify_one();
+    }
+}
+
+void UsbBulkReader::Stop()
+{
+    {
+        const std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        // discarded URBs complete with -ENOENT, which ends the reaper's blocking REAPURB
+        for (auto seq = _reaped.load(); seq < _submitted.load(); seq++)
+        {
+            ::ioctl(_file_descriptor, USBDEVFS_DISCARDURB, _segments[seq % _segments.size()].urb.get());
+        }
+    }
+    _space_cv.notify_all();
+    if (_reaper_thread.joinable())
+    {
+        _reaper_thread.join();
+    }
+}
+} // namespace PacketManager
+} // namespace RealSenseID
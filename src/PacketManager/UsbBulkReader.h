@@ -0,0 +1,87 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <linux/usbdevice_fs.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// Async usb bulk-in reader (usbfs URBs).
+// The receive buffer is split into segments, one URB per segment, and all free segments are kept submitted, so the
+// endpoint always has a transfer to complete into. The kernel completes the URBs directly into the segments
+// (usbfs mmap'ed memory if the kernel supports it, so not even the kernel copies) and the consumer reads each
+// segment in place, in completion (= submission) order.
+// Single consumer. Completed segments are not resubmitted until consumed (backpressure).
+class UsbBulkReader
+{
+public:
+#ifdef RSID_LOW_MEMORY
+    static constexpr size_t SegmentSize = 4096;
+#else
+    static constexpr size_t SegmentSize = 16384;
+#endif
+    static constexpr size_t MinSegments = 4;
+
+    // buffer_size is split into max(MinSegments, buffer_size / SegmentSize) segments
+    UsbBulkReader(int file_descriptor, int endpoint_address, size_t buffer_size);
+    ~UsbBulkReader();
+
+    UsbBulkReader(const UsbBulkReader&) = delete;
+    UsbBulkReader& operator=(const UsbBulkReader&) = delete;
+
+    // submit the URBs and start the reaper thread.
+    // returns false if the device does not accept URBs (caller should fall back to synchronous bulk transfers).
+    bool Start();
+
+    // copy up to max_bytes of received bytes, waiting up to timeout for the next segment.
+    // returns the number of bytes copied (0 on timeout).
+    size_t Read(char* destination, size_t max_bytes, std::chrono::milliseconds timeout);
+
+private:
+    struct Segment
+    {
+        std::unique_ptr<usbdevfs_urb> urb; // own allocation, usbdevfs_urb ends with a flexible array
+        char* data = nullptr;
+        bool mapped = false;
+        size_t length = 0; // bytes completed into the segment
+        size_t offset = 0; // bytes already read by the consumer
+    };
+
+    int _file_descriptor;
+    int _endpoint_address;
+    std::vector<Segment> _segments;
+
+    // segment sequence numbers (segment = seq % count): [_consumed, _reaped) complete, [_reaped, _submitted) in
+    // flight
+    std::atomic<size_t> _submitted {0};
+    std::atomic<size_t> _reaped {0};
+    std::atomic<size_t> _consumed {0};
+
+    std::atomic<bool> _stop {false};
+    std::atomic<bool> _consumer_waiting {false};
+    std::atomic<bool> _reaper_waiting {false};
+    std::mutex _mutex; // wait/notify, and submit vs. discard on stop
+    std::condition_variable _data_cv;
+    std::condition_variable _space_cv;
+    std::thread _reaper_thread;
+
+    bool Submit(Segment& segment);
+    // submit all free segments. false if submitting failed
+    bool SubmitFree();
+    void ReaperLoop();
+    void Stop();
+    void Notify(std::atomic<bool>& waiting, std::condition_variable& cv);
+};
+} // namespace PacketManager
+} // namespace RealSenseID
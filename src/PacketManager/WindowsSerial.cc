@@ -5,6 +5,8 @@
 #include "SerialPacket.h"
 #include "CommonTypes.h"
 #include "Logger.h"
+#include "SerialCapture.h"
+#include "Timer.h"
 
 #include <string>
 #include <stdexcept>
@@ -25,7 +27,9 @@ WindowsSerial::WindowsSerial(const SerialConfig& config) : _config {config}
     DCB dcbSerialParams = {0};
     std::string port = std::string("\\\\.\\") + _config.port;
     LOG_DEBUG(LOG_TAG, "Opening serial port %s", config.port);
-    _handle = ::CreateFileA(port.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    // overlapped handle - reads wait on an event with the caller's deadline (see RecvAvailable)
+    _handle = ::CreateFileA(port.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, 0);
 
     if (_handle == INVALID_HANDLE_VALUE)
     {
@@ -51,9 +55,11 @@ WindowsSerial::WindowsSerial(const SerialConfig& config) : _config {config}
 
     COMMTIMEOUTS timeouts = {0};
 
-    // waits 200ms for 1st byte and then proceeds adding 5ms for each bytes received
-    timeouts.ReadTotalTimeoutConstant = 200;
-    timeouts.ReadTotalTimeoutMultiplier = 5;
+    // reads return the bytes available at once, or complete when the 1st byte arrives.
+    // the wait itself is bounded by the caller's deadline (see RecvAvailable)
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = MAXDWORD - 1;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
     timeouts.WriteTotalTimeoutConstant = 200;
     timeouts.WriteTotalTimeoutMultiplier = 5;
 
@@ -62,6 +68,35 @@ WindowsSerial::WindowsSerial(const SerialConfig& config) : _config {config}
         ::CloseHandle(_handle);
         ThrowWinError("Failed to open serial port");
     }
+
+    // manual reset events signaled on completion of the overlapped read/write
+    _read_event = ::CreateEventA(NULL, TRUE, FALSE, NULL);
+    _write_event = ::CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (_read_event == NULL || _write_event == NULL)
+    {
+        CloseHandles();
+        ThrowWinError("Failed to create serial port events");
+    }
+    SERIAL_OPENED();
+}
+
+void WindowsSerial::CloseHandles()
+{
+    if (_read_event != NULL)
+    {
+        ::CloseHandle(_read_event);
+        _read_event = NULL;
+    }
+    if (_write_event != NULL)
+    {
+        ::CloseHandle(_write_event);
+        _write_event = NULL;
+    }
+    if (_handle != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(_handle);
+        _handle = INVALID_HANDLE_VALUE;
+    }
 }
 
 WindowsSerial::~WindowsSerial()
@@ -69,11 +104,7 @@ WindowsSerial::~WindowsSerial()
     try
     {
 	    LOG_DEBUG(LOG_TAG, "Closing serial port");
-        if (_handle == INVALID_HANDLE_VALUE)
-        {
-            return;
-        }
-        ::CloseHandle(_handle);
+        CloseHandles();
     }
     catch (...)
     {
@@ -85,9 +116,18 @@ SerialStatus WindowsSerial::SendBytes(const char* buffer, size_t n_bytes)
     DWORD bytes_to_write = static_cast<DWORD>(n_bytes);
     DWORD bytes_written = 0;
 
-    DEBUG_SERIAL(LOG_TAG, "[snd]", buffer, n_bytes);
+    SERIAL_SENT(LOG_TAG, buffer, n_bytes);
 
-    if (!::WriteFile(_handle, buffer, bytes_to_write, &bytes_written, NULL) || bytes_written != bytes_to_write)
+    OVERLAPPED overlapped = {0};
+    overlapped.hEvent = _write_event;
+    BOOL write_ok = ::WriteFile(_handle, buffer, bytes_to_write, NULL, &overlapped);
+    if (!write_ok && ::GetLastError() == ERROR_IO_PENDING)
+    {
+        // bounded by the comm write timeouts
+        write_ok = TRUE;
+    }
+    if (!write_ok || !::GetOverlappedResult(_handle, &overlapped, &bytes_written, TRUE) ||
+        bytes_written != bytes_to_write)
     {
         LOG_ERROR(LOG_TAG, "Error while writing to serial port");
         return SerialStatus::SendFailed;
@@ -100,29 +140,63 @@ SerialStatus WindowsSerial::SendBytes(const char* buffer, size_t n_bytes)
 
 SerialStatus WindowsSerial::RecvBytes(char* buffer, size_t n_bytes)
 {
-    DWORD bytes_to_read = static_cast<DWORD>(n_bytes);
+    // waits 200ms for 1st byte and then proceeds adding 5ms for each bytes received
+    Timer timer {std::chrono::milliseconds {200 + 5 * n_bytes}};
+    auto status = _recv_buffer.Recv(buffer, n_bytes, timer);
+    if (status == SerialStatus::RecvTimeout && n_bytes != 1)
+    {
+        // log only if not waiting for sync bytes, where it is expected to timeout sometimes
+        LOG_DEBUG(LOG_TAG, "Timeout reading %zu bytes. Got only %zu", n_bytes, _recv_buffer.Size());
+    }
+    return status;
+}
+
+SerialStatus WindowsSerial::RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout)
+{
+    DWORD bytes_to_read = static_cast<DWORD>(max_bytes);
     DWORD bytes_actual_read = 0;
+    n_bytes = 0;
 
-    if (!::ReadFile(_handle, (LPVOID)buffer, bytes_to_read, &bytes_actual_read, NULL))
+    OVERLAPPED overlapped = {0};
+    overlapped.hEvent = _read_event;
+    if (!::ReadFile(_handle, (LPVOID)buffer, bytes_to_read, NULL, &overlapped))
     {
-        LOG_ERROR(LOG_TAG, "Error while reading from serial port. Last error: %x", ::GetLastError());
-        return SerialStatus::RecvFailed;
+        if (::GetLastError() != ERROR_IO_PENDING)
+        {
+            LOG_ERROR(LOG_TAG, "Error while reading from serial port. Last error: %x", ::GetLastError());
+            return SerialStatus::RecvFailed;
+        }
+
+        // sleep until the read completes or the deadline passes
+        DWORD wait_ms = MAXDWORD - 1;
+        if (timeout.count() < static_cast<timeout_t::rep>(wait_ms))
+        {
+            wait_ms = timeout.count() > 0 ? static_cast<DWORD>(timeout.count()) : 0;
+        }
+        if (::WaitForSingleObject(_read_event, wait_ms) != WAIT_OBJECT_0)
+        {
+            // bytes may still have arrived before the cancel, they are collected below
+            ::CancelIo(_handle);
+        }
     }
 
-    if (bytes_actual_read != bytes_to_read)
+    if (!::GetOverlappedResult(_handle, &overlapped, &bytes_actual_read, TRUE))
     {
-        if (bytes_to_read != 1)
+        if (::GetLastError() == ERROR_OPERATION_ABORTED)
         {
-            // log only if not waiting for sync bytes, where it is expected to timeout sometimes
-            LOG_DEBUG(LOG_TAG, "Timeout reading %d bytes. Got only %d", bytes_to_read, bytes_actual_read);
+            return SerialStatus::RecvTimeout;
         }
-        return SerialStatus::RecvTimeout;
+        LOG_ERROR(LOG_TAG, "Error while reading from serial port. Last error: %x", ::GetLastError());
+        return SerialStatus::RecvFailed;
     }
-    else
+
+    if (bytes_actual_read == 0)
     {
-        DEBUG_SERIAL(LOG_TAG, "[rcv]", buffer, bytes_actual_read);
-        return SerialStatus::Ok;
+        return SerialStatus::RecvTimeout;
     }
+    SERIAL_RECEIVED(LOG_TAG, buffer, bytes_actual_read);
+    n_bytes = bytes_actual_read;
+    return SerialStatus::Ok;
 }
 } // namespace PacketManager
 } // namespace RealSenseID
@@ -27,9 +27,16 @@ public:
     // receive all bytes and copy to the buffer
     SerialStatus RecvBytes(char* buffer, size_t n_bytes) final;
 
+    // overlapped ReadFile() of what is available, waits for its completion up to the timeout
+    SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) final;
+
 private:
+    void CloseHandles();
+
     SerialConfig _config;
     HANDLE _handle = INVALID_HANDLE_VALUE;
+    HANDLE _read_event = NULL;
+    HANDLE _write_event = NULL;
 };
 } // namespace PacketManager
 } // namespace RealSenseID
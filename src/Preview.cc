@@ -26,6 +26,16 @@ bool Preview::StartPreview(PreviewImageReadyCallback& callback)
     return _impl->StartPreview(callback);
 }
 
+bool Preview::StartPreview(PreviewFrameReadyCallback& callback, unsigned int pool_size)
+{
+    return _impl->StartPreview(callback, pool_size);
+}
+
+bool Preview::StartEncodedPreview(PreviewPacketCallback& callback, const PreviewEncoderConfig& config)
+{
+    return _impl->StartEncodedPreview(callback, config);
+}
+
 bool Preview::PausePreview()
 {
     return _impl->PausePreview();
@@ -36,8 +46,38 @@ bool Preview::ResumePreview()
     return _impl->ResumePreview();
 }
 
+void Preview::NotifyActivity()
+{
+    _impl->NotifyActivity();
+}
+
+void Preview::SetPrewarm(FaceAuthenticator* authenticator, unsigned int hold_ms)
+{
+    _impl->SetPrewarm(authenticator, hold_ms);
+}
+
 bool Preview::StopPreview()
 {
     return _impl->StopPreview();
 }
+
+bool Preview::StartRecording(const char* path)
+{
+    return _impl->StartRecording(path);
+}
+
+bool Preview::StopRecording()
+{
+    return _impl->StopRecording();
+}
+
+PreviewStatistics Preview::GetStatistics() const
+{
+    return _impl->GetStatistics();
+}
+
+PreviewLatency Preview::GetLatency() const
+{
+    return _impl->GetLatency();
+}
 } // namespace RealSenseID
@@ -0,0 +1,473 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/PreviewBroadcast.h"
+#include "SharedMemory.h"
+#include "StreamConverter.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+
+static const char* LOG_TAG = "PreviewBroadcast";
+
+// Shared ring layout: RingHeader, slot_count RingSlot descriptors, then the slots' image data (page aligned).
+// A slot's sequence is 0 while it's empty or being written. Each subscriber has an entry of the header's reader
+// table, with the slot it holds. The broker marks a slot before checking no reader holds it, a subscriber holds the
+// slot before checking its sequence, so either the broker skips the slot or the subscriber sees it change.
+// The entries of subscribers that exited without closing the ring are reclaimed, so their slots are reused.
+namespace RealSenseID
+{
+static const char RING_MAGIC[8] = {'R', 'S', 'I', 'D', 'R', 'I', 'N', 'G'};
+static const uint32_t RING_VERSION = 2;
+static const unsigned int RING_MAX_READERS = 64;
+static const uint32_t READER_RECLAIMING = UINT32_MAX; // pid of an entry being reclaimed
+static const size_t RING_ALIGNMENT = 4096;
+static const auto READ_POLL_INTERVAL = std::chrono::milliseconds {1};
+
+struct RingReader
+{
+    std::atomic<uint32_t> pid;  // of the subscriber, 0 while free
+    std::atomic<uint32_t> slot; // index + 1 of the held slot, 0 if none
+};
+
+struct RingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t slot_size; // bytes of image data per slot
+    uint64_t data_offset;
+    std::atomic<uint64_t> published; // sequence of the latest image
+    std::atomic<uint32_t> active;    // 1 while the broker publishes
+    uint32_t broker_pid;
+    RingReader readers[RING_MAX_READERS];
+};
+
+struct RingSlot
+{
+    std::atomic<uint64_t> sequence;
+    Image image; // buffer is not shared, the data is at the slot's offset
+};
+
+// free the entry if its subscriber exited. false if it's alive (or the entry was freed meanwhile)
+static bool ReclaimIfDead(RingReader& reader)
+{
+    uint32_t pid = reader.pid.load();
+    if (pid == 0 || pid == READER_RECLAIMING || SharedMemory::IsProcessAlive(pid))
+        return false;
+    if (!reader.pid.compare_exchange_strong(pid, READER_RECLAIMING))
+        return false;
+    reader.slot.store(0);
+    reader.pid.store(0);
+    LOG_DEBUG(LOG_TAG, "Reclaimed the ring entry of exited process %u", pid);
+    return true;
+}
+
+static size_t AlignUp(size_t size)
+{
+    return (size + RING_ALIGNMENT - 1) / RING_ALIGNMENT * RING_ALIGNMENT;
+}
+
+static RingSlot* SlotsOf(unsigned char* base)
+{
+    return reinterpret_cast<RingSlot*>(base + AlignUp(sizeof(RingHeader)));
+}
+
+// max image size of the config, see StreamConverter::InitStream()
+static size_t MaxImageSize(const PreviewConfig& config)
+{
+    using namespace Capture;
+    if (config.metadataOnly && config.previewMode != PreviewMode::VGA)
+        return 0;
+    switch (config.previewMode)
+    {
+    case PreviewMode::Dump:
+        return RAW_WIDTH * RAW_HEIGHT / 4 * 5;
+    case PreviewMode::FHD_Rect:
+        return RAW_WIDTH * RAW_HEIGHT * RGBA_PIXEL_SIZE;
+    default:
+        return VGA_WIDTH * VGA_HEIGHT * RGBA_PIXEL_SIZE;
+    }
+}
+
+class PreviewBrokerImpl : public PreviewImageReadyCallback
+{
+public:
+    PreviewBrokerImpl(const PreviewConfig& config, const char* name, unsigned int slots, bool group_access) :
+        _preview {config}, _name {name ? name : ""}, _slot_count {std::max(slots, 2u)},
+        _slot_size {AlignUp(std::max<size_t>(MaxImageSize(config), 1))}, _mode {group_access ? 0660u : 0600u}
+    {
+    }
+
+    ~PreviewBrokerImpl()
+    {
+        Stop();
+    }
+
+    bool Start()
+    {
+        if (_header != nullptr || _name.empty())
+            return false;
+        if (!RemoveStaleRing())
+            return false;
+        const size_t data_offset = AlignUp(AlignUp(sizeof(RingHeader)) + _slot_count * sizeof(RingSlot));
+        if (!_memory.Create(_name.c_str(), data_offset + _slot_count * _slot_size, _mode))
+            return false;
+
+        unsigned char* base = _memory.Data();
+        _header = new (base) RingHeader {};
+        _slots = SlotsOf(base);
+        for (unsigned int i = 0; i < _slot_count; i++)
+            new (&_slots[i]) RingSlot {};
+        _data = base + data_offset;
+        ::memcpy(_header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+        _header->version = RING_VERSION;
+        _header->slot_count = _slot_count;
+        _header->slot_size = _slot_size;
+        _header->data_offset = data_offset;
+        _header->broker_pid = SharedMemory::ProcessId();
+        _header->active = 1;
+        _sequence = 0;
+        _next_slot = 0;
+        _dropped = 0;
+
+        if (!_preview.StartPreview(*this))
+        {
+            Stop();
+            return false;
+        }
+        LOG_DEBUG(LOG_TAG, "Publishing to %s, %u slots of %zu bytes", _name.c_str(), _slot_count, _slot_size);
+        return true;
+    }
+
+    bool Stop()
+    {
+        if (_header == nullptr)
+            return false;
+        _preview.StopPreview();
+        _header->active = 0;
+        _header = nullptr;
+        _slots = nullptr;
+        _data = nullptr;
+        _memory.Close();
+        return true;
+    }
+
+    PreviewStatistics GetStatistics() const
+    {
+        return _preview.GetStatistics();
+    }
+
+    unsigned int GetDropped() const
+    {
+        return _dropped;
+    }
+
+    void OnPreviewImageReady(const Image image) override
+    {
+        Trace::Scope publish_trace {"Publish", "preview"};
+        if (image.size > _slot_size)
+        {
+            LOG_ERROR(LOG_TAG, "Image of %u bytes doesn't fit the ring's slots", image.size);
+            _dropped++;
+            return;
+        }
+        const uint64_t sequence = _sequence + 1;
+        for (unsigned int tries = 0; tries < _slot_count; tries++)
+        {
+            const unsigned int index = (_next_slot + tries) % _slot_count;
+            RingSlot& slot = _slots[index];
+            const uint64_t previous = slot.sequence.exchange(0);
+            if (IsHeld(index))
+            {
+                slot.sequence.store(previous); // being read, untouched
+                continue;
+            }
+            unsigned char* data = _data + index * _slot_size;
+            if (image.size > 0)
+                ::memcpy(data, image.buffer, image.size);
+            slot.image = image;
+            slot.image.buffer = nullptr;
+            slot.image.dmaBufFd = -1;
+            slot.sequence.store(sequence);
+            _header->published.store(sequence);
+            _sequence = sequence;
+            _next_slot = (index + 1) % _slot_count;
+            return;
+        }
+        _dropped++;
+    }
+
+private:
+    Preview _preview;
+    std::string _name;
+    const unsigned int _slot_count;
+    const size_t _slot_size;
+    const unsigned int _mode;
+    SharedMemory _memory;
+    RingHeader* _header = nullptr;
+    RingSlot* _slots = nullptr;
+    unsigned char* _data = nullptr;
+    uint64_t _sequence = 0;
+    unsigned int _next_slot = 0;
+    std::atomic<unsigned int> _dropped {0};
+
+    // remove the ring of the name left by a broker that didn't stop. false if a running broker publishes to it
+    bool RemoveStaleRing()
+    {
+        SharedMemory existing;
+        if (!existing.Open(_name.c_str()))
+            return true;
+        const auto* header = reinterpret_cast<const RingHeader*>(existing.Data());
+        if (existing.Size() >= sizeof(RingHeader) && ::memcmp(header->magic, RING_MAGIC, sizeof(RING_MAGIC)) == 0 &&
+            header->version == RING_VERSION && header->active.load() != 0 &&
+            SharedMemory::IsProcessAlive(header->broker_pid))
+        {
+            LOG_ERROR(LOG_TAG, "%s is published by running process %u", _name.c_str(), header->broker_pid);
+            return false;
+        }
+        existing.Close();
+        SharedMemory::Remove(_name.c_str());
+        return true;
+    }
+
+    // true if a subscriber holds the slot. entries of exited subscribers are freed
+    bool IsHeld(unsigned int index)
+    {
+        bool held = false;
+        for (auto& reader : _header->readers)
+        {
+            if (reader.slot.load() == index + 1 && !ReclaimIfDead(reader))
+                held = true;
+        }
+        return held;
+    }
+};
+
+class PreviewSubscriberImpl
+{
+public:
+    ~PreviewSubscriberImpl()
+    {
+        Close();
+    }
+
+    bool Open(const char* name)
+    {
+        Close();
+        if (name == nullptr || !_memory.Open(name))
+            return false;
+        unsigned char* base = _memory.Data();
+        _header = reinterpret_cast<RingHeader*>(base);
+        if (_memory.Size() < sizeof(RingHeader) || ::memcmp(_header->magic, RING_MAGIC, sizeof(RING_MAGIC)) != 0 ||
+            _header->version != RING_VERSION ||
+            _header->data_offset + _header->slot_count * _header->slot_size > _memory.Size())
+        {
+            LOG_ERROR(LOG_TAG, "%s is not a preview ring", name);
+            Close();
+            return false;
+        }
+        _slots = SlotsOf(base);
+        _reader = Register();
+        if (_reader == nullptr)
+        {
+            LOG_ERROR(LOG_TAG, "%s has no free reader entry", name);
+            Close();
+            return false;
+        }
+        // the latest image is the first one read
+        const uint64_t published = _header->published.load();
+        _cursor = published > 0 ? published - 1 : 0;
+        _missed = 0;
+        return true;
+    }
+
+    void Close()
+    {
+        Release();
+        if (_reader != nullptr)
+        {
+            _reader->pid.store(0);
+            _reader = nullptr;
+        }
+        _header = nullptr;
+        _slots = nullptr;
+        _memory.Close();
+    }
+
+    bool Read(Image& image, unsigned int timeout_ms, uint64_t* sequence)
+    {
+        Release();
+        if (_header == nullptr)
+            return false;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds {timeout_ms};
+        while (true)
+        {
+            unsigned int index = 0;
+            const uint64_t next = NextSequence(index);
+            if (next != 0)
+            {
+                RingSlot& slot = _slots[index];
+                _reader->slot.store(index + 1);
+                if (slot.sequence.load() != next)
+                {
+                    _reader->slot.store(0); // overwritten meanwhile
+                    continue;
+                }
+                _held = true;
+                _missed += next - _cursor - 1;
+                _cursor = next;
+                image = slot.image;
+                image.buffer = _memory.Data() + _header->data_offset + index * _header->slot_size;
+                if (sequence)
+                    *sequence = next;
+                return true;
+            }
+            if (_header->active.load() == 0 || std::chrono::steady_clock::now() >= deadline)
+                return false;
+            std::this_thread::sleep_for(READ_POLL_INTERVAL);
+        }
+    }
+
+    void Release()
+    {
+        if (_held)
+        {
+            _reader->slot.store(0);
+            _held = false;
+        }
+    }
+
+    uint64_t GetMissed() const
+    {
+        return _missed;
+    }
+
+private:
+    SharedMemory _memory;
+    RingHeader* _header = nullptr;
+    RingSlot* _slots = nullptr;
+    RingReader* _reader = nullptr;
+    bool _held = false;
+    uint64_t _cursor = 0; // sequence of the last read image
+    uint64_t _missed = 0;
+
+    // claim a free reader entry, reclaiming those of exited subscribers if none. nullptr if all are taken
+    RingReader* Register()
+    {
+        const uint32_t pid = SharedMemory::ProcessId();
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (auto& reader : _header->readers)
+            {
+                uint32_t free_pid = 0;
+                if (reader.pid.compare_exchange_strong(free_pid, pid))
+                    return &reader;
+            }
+            for (auto& reader : _header->readers)
+                ReclaimIfDead(reader);
+        }
+        return nullptr;
+    }
+
+    // oldest image after the cursor, 0 if none
+    uint64_t NextSequence(unsigned int& index) const
+    {
+        uint64_t next = 0;
+        for (unsigned int i = 0; i < _header->slot_count; i++)
+        {
+            const uint64_t sequence = _slots[i].sequence.load();
+            if (sequence > _cursor && (next == 0 || sequence < next))
+            {
+                next = sequence;
+                index = i;
+            }
+        }
+        return next;
+    }
+};
+
+PreviewBroker::PreviewBroker(const PreviewConfig& config, const char* name, unsigned int slots, bool groupAccess) :
+    _impl {new PreviewBrokerImpl {config, name, slots, groupAccess}}
+{
+}
+
+PreviewBroker::~PreviewBroker()
+{
+    try
+    {
+        delete _impl;
+    }
+    catch (...)
+    {
+    }
+}
+
+bool PreviewBroker::Start()
+{
+    return _impl->Start();
+}
+
+bool PreviewBroker::Stop()
+{
+    return _impl->Stop();
+}
+
+PreviewStatistics PreviewBroker::GetStatistics() const
+{
+    return _impl->GetStatistics();
+}
+
+unsigned int PreviewBroker::GetDropped() const
+{
+    return _impl->GetDropped();
+}
+
+PreviewSubscriber::PreviewSubscriber() : _impl {new PreviewSubscriberImpl}
+{
+}
+
+PreviewSubscriber::~PreviewSubscriber()
+{
+    try
+    {
+        delete _impl;
+    }
+    catch (...)
+    {
+    }
+}
+
+bool PreviewSubscriber::Open(const char* name)
+{
+    return _impl->Open(name);
+}
+
+void PreviewSubscriber::Close()
+{
+    _impl->Close();
+}
+
+bool PreviewSubscriber::Read(Image& image, unsigned int timeout_ms, uint64_t* sequence)
+{
+    return _impl->Read(image, timeout_ms, sequence);
+}
+
+void PreviewSubscriber::Release()
+{
+    _impl->Release();
+}
+
+uint64_t PreviewSubscriber::GetMissed() const
+{
+    return _impl->GetMissed();
+}
+} // namespace RealSenseID
@@ -0,0 +1,63 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/PreviewGpuConverter.h"
+#include "PreviewGpuConverterImpl.h"
+
+namespace RealSenseID
+{
+PreviewGpuConverter::PreviewGpuConverter() : _impl {new PreviewGpuConverterImpl}
+{
+}
+
+PreviewGpuConverter::~PreviewGpuConverter()
+{
+    try
+    {
+        delete _impl;
+    }
+    catch (...)
+    {
+    }
+}
+
+bool PreviewGpuConverter::Init()
+{
+    return _impl->Init();
+}
+
+bool PreviewGpuConverter::ConvertYuyv(const Image& image)
+{
+    return _impl->ConvertYuyv(image);
+}
+
+bool PreviewGpuConverter::ConvertRaw10(const Image& image)
+{
+    return _impl->ConvertRaw10(image);
+}
+
+unsigned int PreviewGpuConverter::Texture() const
+{
+    return _impl->Texture();
+}
+
+unsigned int PreviewGpuConverter::Width() const
+{
+    return _impl->Width();
+}
+
+unsigned int PreviewGpuConverter::Height() const
+{
+    return _impl->Height();
+}
+
+bool PreviewGpuConverter::ReadPixels(unsigned char* rgba) const
+{
+    return _impl->ReadPixels(rgba);
+}
+
+void PreviewGpuConverter::Release()
+{
+    _impl->Release();
+}
+} // namespace RealSenseID
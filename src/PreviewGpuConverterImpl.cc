@@ -0,0 +1,313 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "PreviewGpuConverterImpl.h"
+#include "Logger.h"
+
+#ifdef RSID_PREVIEW_GPU
+#include <GLES3/gl31.h>
+#include <vector>
+#endif
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "PreviewGpuConverter";
+
+#ifdef RSID_PREVIEW_GPU
+
+static const GLuint s_groupSize = 16;
+
+// source bytes of the storage buffer, packed in 32 bit words (little endian)
+#define RSID_SHADER_COMMON                                                                                             \
+    "#version 310 es\n"                                                                                                \
+    "layout(local_size_x = 16, local_size_y = 16) in;\n"                                                               \
+    "layout(std430, binding = 0) readonly buffer Source { uint words[]; };\n"                                          \
+    "layout(rgba8, binding = 0) writeonly uniform highp image2D dst;\n"                                                \
+    "uniform uint width;\n"                                                                                            \
+    "uniform uint height;\n"                                                                                           \
+    "uniform uint line;\n"                                                                                             \
+    "uint ByteAt(uint i) { return (words[i >> 2] >> ((i & 3u) * 8u)) & 0xffu; }\n"                                     \
+    "void Store(ivec2 p, uvec3 rgb) { imageStore(dst, p, vec4(vec3(rgb) / 255.0, 1.0)); }\n"
+
+// YuyvToRgbScalar(): values in 1/128 units, high halves of the products with the 16 bit BT.601 multipliers
+static const char* s_yuyvSource = RSID_SHADER_COMMON R"GLSL(
+int MulHi(int x, int k)
+{
+    return (x * k) >> 16;
+}
+
+uint ToByte(int x)
+{
+    return uint(clamp(clamp(x, -32768, 32767) >> 7, 0, 255));
+}
+
+void main()
+{
+    uvec2 p = gl_GlobalInvocationID.xy;
+    if (p.x >= width || p.y >= height)
+        return;
+    uint pair = p.y * line + (p.x & ~1u) * 2u;
+    int du = (int(ByteAt(pair + 1u)) - 128) * 128;
+    int dv = (int(ByteAt(pair + 3u)) - 128) * 128;
+    int r_term = dv + MulHi(dv, 26640);
+    int g_term = MulHi(du, 22643) + dv - MulHi(dv, 18553);
+    int b_term = 2 * du - MulHi(du, 14484);
+    int y = int(ByteAt(pair + (p.x & 1u) * 2u)) * 128;
+    Store(ivec2(p), uvec3(ToByte(y + r_term), ToByte(y - g_term), ToByte(y + b_term)));
+}
+)GLSL";
+
+// RotatedRaw2Rgb(): the 8 high bits of each pixel, rows and columns mirrored at the borders, bilinear demosaic of the
+// bggr pattern. width x height is the source image, source pixel (x, y) is pixel (height - 1 - y, width - 1 - x) of
+// the texture.
+static const char* s_raw10Source = RSID_SHADER_COMMON R"GLSL(
+uint Raw(int x, int y)
+{
+    if (y < 0)
+        y = 1;
+    else if (y >= int(height))
+        y = int(height) - 2;
+    if (x < 0)
+        x = 1;
+    else if (x >= int(width))
+        x = int(width) - 2;
+    return ByteAt(uint(y) * line + uint(x) / 4u * 5u + uint(x) % 4u);
+}
+
+void main()
+{
+    uvec2 p = gl_GlobalInvocationID.xy;
+    if (p.x >= height || p.y >= width)
+        return;
+    int x = int(width - 1u - p.y);
+    int y = int(height - 1u - p.x);
+    uint hn = (Raw(x - 1, y) + Raw(x + 1, y)) >> 1;
+    uint vn = (Raw(x, y - 1) + Raw(x, y + 1)) >> 1;
+    uint value = Raw(x, y);
+    bool odd_row = (y & 1) != 0;
+    uvec3 rgb;
+    if (((x + y) & 1) != 0)
+    {
+        rgb = odd_row ? uvec3(hn, value, vn) : uvec3(vn, value, hn);
+    }
+    else
+    {
+        uint di = (Raw(x - 1, y - 1) + Raw(x + 1, y - 1) + Raw(x - 1, y + 1) + Raw(x + 1, y + 1)) >> 2;
+        uint g = (vn + hn) >> 1;
+        rgb = odd_row ? uvec3(value, g, di) : uvec3(di, g, value);
+    }
+    Store(ivec2(p), rgb);
+}
+)GLSL";
+
+static GLuint BuildProgram(const char* source, const char* name)
+{
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (ok != GL_TRUE)
+    {
+        GLint length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> log(static_cast<size_t>(length) + 1, '\0');
+        glGetShaderInfoLog(shader, length, nullptr, log.data());
+        LOG_ERROR(LOG_TAG, "Failed to compile the %s shader: %s", name, log.data());
+        glDeleteShader(shader);
+        return 0;
+    }
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (ok != GL_TRUE)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to link the %s shader", name);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+static bool CheckError(const char* what)
+{
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR)
+    {
+        LOG_ERROR(LOG_TAG, "%s failed: 0x%x", what, static_cast<unsigned int>(err));
+        return false;
+    }
+    return true;
+}
+
+PreviewGpuConverterImpl::~PreviewGpuConverterImpl()
+{
+    Release();
+}
+
+bool PreviewGpuConverterImpl::Init()
+{
+    Release();
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major < 3 || (major == 3 && minor < 1))
+    {
+        LOG_ERROR(LOG_TAG, "OpenGL ES 3.1 context required, current is %d.%d", major, minor);
+        return false;
+    }
+    _yuyv_program = BuildProgram(s_yuyvSource, "yuyv");
+    _raw10_program = BuildProgram(s_raw10Source, "raw10");
+    if (_yuyv_program == 0 || _raw10_program == 0)
+    {
+        Release();
+        return false;
+    }
+    glGenBuffers(1, &_buffer);
+    LOG_DEBUG(LOG_TAG, "Initialized on %s", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    return CheckError("Init");
+}
+
+void PreviewGpuConverterImpl::Release()
+{
+    if (_yuyv_program != 0)
+        glDeleteProgram(_yuyv_program);
+    if (_raw10_program != 0)
+        glDeleteProgram(_raw10_program);
+    if (_buffer != 0)
+        glDeleteBuffers(1, &_buffer);
+    if (_texture != 0)
+        glDeleteTextures(1, &_texture);
+    _yuyv_program = _raw10_program = _buffer = _texture = 0;
+    _buffer_size = 0;
+    _width = _height = 0;
+}
+
+bool PreviewGpuConverterImpl::Upload(const unsigned char* data, size_t size)
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _buffer);
+    // whole words for the shaders, the store is only reallocated to grow
+    const size_t padded = (size + 3) & ~size_t(3);
+    if (padded > _buffer_size)
+    {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(padded), nullptr, GL_STREAM_DRAW);
+        _buffer_size = padded;
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(size), data);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _buffer);
+    return CheckError("Upload");
+}
+
+bool PreviewGpuConverterImpl::PrepareTexture(unsigned int width, unsigned int height)
+{
+    if (_texture != 0 && width == _width && height == _height)
+        return true;
+    // immutable storage, required by imageStore
+    if (_texture != 0)
+        glDeleteTextures(1, &_texture);
+    glGenTextures(1, &_texture);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, static_cast<GLsizei>(width), static_cast<GLsizei>(height));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    _width = width;
+    _height = height;
+    return CheckError("Texture allocation");
+}
+
+bool PreviewGpuConverterImpl::Dispatch(unsigned int program)
+{
+    glUseProgram(program);
+    glBindImageTexture(0, _texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    glDispatchCompute((_width + s_groupSize - 1) / s_groupSize, (_height + s_groupSize - 1) / s_groupSize, 1);
+    // the texture is sampled or read back next
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+    return CheckError("Dispatch");
+}
+
+bool PreviewGpuConverterImpl::ConvertYuyv(const Image& image)
+{
+    const unsigned int line = image.stride != 0 ? image.stride : image.width * 2;
+    if (_yuyv_program == 0 || image.buffer == nullptr || image.width == 0 || image.width % 2 != 0 ||
+        image.height == 0 || line < image.width * 2 || image.size < static_cast<size_t>(line) * image.height)
+    {
+        LOG_ERROR(LOG_TAG, "Not initialized or invalid YUYV image");
+        return false;
+    }
+    glUseProgram(_yuyv_program);
+    glUniform1ui(glGetUniformLocation(_yuyv_program, "width"), image.width);
+    glUniform1ui(glGetUniformLocation(_yuyv_program, "height"), image.height);
+    glUniform1ui(glGetUniformLocation(_yuyv_program, "line"), line);
+    return Upload(image.buffer, static_cast<size_t>(line) * image.height) &&
+           PrepareTexture(image.width, image.height) && Dispatch(_yuyv_program);
+}
+
+bool PreviewGpuConverterImpl::ConvertRaw10(const Image& image)
+{
+    // same checks as RotatedRaw2Rgb()
+    if (_raw10_program == 0 || image.buffer == nullptr || image.width < 4 || image.width % 4 != 0 ||
+        image.height < 2 || image.size != image.width * image.height / 4 * 5)
+    {
+        LOG_ERROR(LOG_TAG, "Not initialized or invalid RAW10 image");
+        return false;
+    }
+    glUseProgram(_raw10_program);
+    glUniform1ui(glGetUniformLocation(_raw10_program, "width"), image.width);
+    glUniform1ui(glGetUniformLocation(_raw10_program, "height"), image.height);
+    glUniform1ui(glGetUniformLocation(_raw10_program, "line"), image.size / image.height);
+    return Upload(image.buffer, image.size) && PrepareTexture(image.height, image.width) &&
+           Dispatch(_raw10_program);
+}
+
+bool PreviewGpuConverterImpl::ReadPixels(unsigned char* rgba) const
+{
+    if (_texture == 0 || rgba == nullptr)
+        return false;
+    GLint previous = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _texture, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, static_cast<GLsizei>(_width), static_cast<GLsizei>(_height), GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previous));
+    glDeleteFramebuffers(1, &framebuffer);
+    return CheckError("ReadPixels");
+}
+
+#else // RSID_PREVIEW_GPU
+
+PreviewGpuConverterImpl::~PreviewGpuConverterImpl() = default;
+
+bool PreviewGpuConverterImpl::Init()
+{
+    LOG_ERROR(LOG_TAG, "Built without RSID_PREVIEW_GPU");
+    return false;
+}
+
+bool PreviewGpuConverterImpl::ConvertYuyv(const Image&)
+{
+    return false;
+}
+
+bool PreviewGpuConverterImpl::ConvertRaw10(const Image&)
+{
+    return false;
+}
+
+bool PreviewGpuConverterImpl::ReadPixels(unsigned char*) const
+{
+    return false;
+}
+
+void PreviewGpuConverterImpl::Release()
+{
+}
+
+#endif // RSID_PREVIEW_GPU
+} // namespace RealSenseID
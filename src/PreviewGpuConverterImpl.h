@@ -0,0 +1,59 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/Preview.h"
+#include <cstddef>
+
+namespace RealSenseID
+{
+// OpenGL ES 3.1 compute shader conversions of PreviewGpuConverter. The raw image is uploaded as is into a shader
+// storage buffer (read as 32 bit words by the shaders), and each invocation writes one pixel of the RGBA8 texture
+// with the integer math of the cpu conversions (YuyvToRgbScalar(), RotatedRaw2Rgb()), so the results are bit-exact.
+// Without RSID_PREVIEW_GPU, Init() fails and nothing else is done.
+class PreviewGpuConverterImpl
+{
+public:
+    PreviewGpuConverterImpl() = default;
+    ~PreviewGpuConverterImpl();
+
+    PreviewGpuConverterImpl(const PreviewGpuConverterImpl&) = delete;
+    PreviewGpuConverterImpl& operator=(const PreviewGpuConverterImpl&) = delete;
+
+    bool Init();
+    bool ConvertYuyv(const Image& image);
+    bool ConvertRaw10(const Image& image);
+    bool ReadPixels(unsigned char* rgba) const;
+    void Release();
+
+    unsigned int Texture() const
+    {
+        return _texture;
+    }
+
+    unsigned int Width() const
+    {
+        return _width;
+    }
+
+    unsigned int Height() const
+    {
+        return _height;
+    }
+
+private:
+    bool Upload(const unsigned char* data, size_t size);
+    bool PrepareTexture(unsigned int width, unsigned int height);
+    bool Dispatch(unsigned int program);
+
+    // GL object names
+    unsigned int _yuyv_program = 0;
+    unsigned int _raw10_program = 0;
+    unsigned int _buffer = 0;
+    unsigned int _texture = 0;
+    size_t _buffer_size = 0;
+    unsigned int _width = 0;
+    unsigned int _height = 0;
+};
+} // namespace RealSenseID
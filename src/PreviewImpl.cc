@@ -2,17 +2,37 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 
 #include "PreviewImpl.h"
+#include "ThreadConfigImpl.h"
 #include "Logger.h"
+#include "MetricsRecorder.h"
+#include "TraceRecorder.h"
+#include "TransferCoordinatorImpl.h"
 #include "RealSenseID/DiscoverDevices.h"
+#include "RealSenseID/FaceAuthenticator.h"
+#include <algorithm>
 #include <chrono>
+#include <stdexcept>
 
 static const char* LOG_TAG = "Preview";
 
 namespace RealSenseID
 {
-PreviewImpl::PreviewImpl(const PreviewConfig& config) : _config(config)
+// images that can be recorded (and played back, PreviewConfig::playbackPath): the raw images of the Dump mode and the
+// YUYV camera images of the VGA mode
+static bool IsRecordable(const PreviewConfig& config)
 {
-    if (config.cameraNumber == -1)
+    if (config.previewMode == PreviewMode::VGA)
+    {
+        return Capture::ResolvePreviewFormat(config.previewFormat) == PreviewFormat::YUYV &&
+               !Capture::HasPreviewRegion(config);
+    }
+    return config.previewMode == PreviewMode::Dump && !config.metadataOnly;
+}
+
+PreviewImpl::PreviewImpl(const PreviewConfig& config) :
+    _config(config), _recorder {IsRecordable(config) ? config.recordQueueSize : 0}
+{
+    if (config.cameraNumber == -1 && config.playbackPath == nullptr)
     {
         std::vector<int> camera_numbers;
         try
@@ -24,6 +44,7 @@ PreviewImpl::PreviewImpl(const PreviewConfig& config) : _config(config)
         }
         _config.cameraNumber = (camera_numbers.size() > 0) ? camera_numbers[0] : 0;
     }
+    _user_config = _config;
 };
 
 PreviewImpl::~PreviewImpl()
@@ -39,83 +60,557 @@ PreviewImpl::~PreviewImpl()
 
 bool PreviewImpl::StartPreview(PreviewImageReadyCallback& callback)
 {
+    if (_worker_thread.joinable())
+    {
+        return false;
+    }
     _callback = &callback;
+    _frame_callback = nullptr;
+    _packet_callback = nullptr;
+    _config = _user_config;
+    return StartWorker();
+}
 
-    _paused = false;
-    _canceled = false;
+bool PreviewImpl::StartPreview(PreviewFrameReadyCallback& callback, unsigned int pool_size)
+{
+    if (_worker_thread.joinable())
+    {
+        return false;
+    }
+    _callback = nullptr;
+    _frame_callback = &callback;
+    _packet_callback = nullptr;
+    _config = _user_config;
+    _pool_size = pool_size;
+    return StartWorker();
+}
 
+bool PreviewImpl::StartEncodedPreview(PreviewPacketCallback& callback, const PreviewEncoderConfig& config)
+{
     if (_worker_thread.joinable())
     {
         return false;
     }
+    if (_user_config.previewMode != PreviewMode::VGA)
+    {
+        LOG_ERROR(LOG_TAG, "Encoded preview requires the VGA preview mode");
+        return false;
+    }
+    _callback = nullptr;
+    _frame_callback = nullptr;
+    _packet_callback = &callback;
+    _encoder_config = config;
+    _encoder.reset();
+    // the encoders take NV12: passthrough if the camera streams it, converted from YUYV otherwise
+    _config = _user_config;
+    _config.previewFormat = PreviewFormat::NV12;
+    return StartWorker();
+}
 
-    _worker_thread = std::thread([&]() {
-        try
+bool PreviewImpl::StartWorker()
+{
+    _paused = false;
+    _canceled = false;
+    _captured = 0;
+    _delivered = 0;
+    _dropped = 0;
+    _skipped = 0;
+    _active_until = 0;
+    _next_idle_image = 0;
+    _transfer_rate = false;
+    _queue.clear();
+    {
+        std::lock_guard<std::mutex> lock {_latency_mutex};
+        _latencies.clear();
+        _latency_next = 0;
+    }
+    switch (_config.queuePolicy)
+    {
+    case PreviewQueuePolicy::Inline:
+        _queue_capacity = 0;
+        break;
+    case PreviewQueuePolicy::LatestOnly:
+        _queue_capacity = 1;
+        break;
+    default:
+        _queue_capacity = std::max(_config.queueSize, 1u);
+        break;
+    }
+
+    _worker_thread = std::thread([this]() { CaptureLoop(); });
+    if (_queue_capacity > 0)
+    {
+        _delivery_thread = std::thread([this]() { DeliveryLoop(); });
+    }
+    return true;
+}
+
+void PreviewImpl::CaptureLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Preview, "preview");
+    try
+    {
+        _capture = Capture::OpenCaptureSource(_config);
+        // images are captured directly into the leased frames. queued images need their own frames: the queued ones,
+        // the one being delivered and the one being captured. dumped images are recorded from their frames, the
+        // recorder's queue and the image being written take frames too.
+        const unsigned int record_frames =
+            (IsRecordable(_config) && _config.recordQueueSize > 0) ? _config.recordQueueSize + 1 : 0;
+        if (_frame_callback)
+        {
+            _pool = FramePool::Create(_pool_size + record_frames, _capture->ImageSize());
+        }
+        else if (_queue_capacity > 0)
+        {
+            _pool = FramePool::Create(static_cast<unsigned int>(_queue_capacity) + 2 + record_frames,
+                                      _capture->ImageSize());
+        }
+        else if (record_frames > 0)
         {
-            _capture = std::make_unique<Capture::CaptureHandle>(_config);
-            unsigned int frameNumber = 0;
-            LOG_DEBUG(LOG_TAG, "Preview started!");
-            while (!_canceled)
+            _pool = FramePool::Create(record_frames + 1, _capture->ImageSize());
+        }
+        else
+        {
+            _pool = nullptr;
+        }
+        unsigned int frameNumber = 0;
+        LOG_DEBUG(LOG_TAG, "Preview started!");
+        while (!_canceled)
+        {
+            if (_paused)
             {
-                if (_paused)
-                {
-                    std::this_thread::sleep_for(std::chrono::milliseconds {100});
-                    continue;
-                }
-                RealSenseID::Image container;
-                bool res = _capture->Read(&container);
+                // closing the capture stops the camera stream
+                _capture.reset();
+                ReportFullRate(false);
+                std::unique_lock<std::mutex> lock {_queue_mutex};
+                _queue_cv.wait(lock, [this] { return _canceled || !_paused; });
+                continue;
+            }
+            if (FollowTransfers())
+            {
+                continue;
+            }
+            if (!_capture)
+            {
+                _capture = Capture::OpenCaptureSource(_config, _transfer_rate ? _config.transferFps : 0);
+            }
+            ReportFullRate(!_transfer_rate);
+            if (SkipIdleImage())
+            {
+                continue;
+            }
+            RealSenseID::Image container;
+            PreviewFrameImpl* frame = _pool ? _pool->Acquire() : nullptr;
+            bool res;
+            {
+                Trace::Scope read_trace {"Read", "preview"};
+                res = _capture->Read(&container, frame ? frame->buffer.data() : nullptr);
+            }
+            // back to the pool at the end of the iteration unless queued or kept by the callback
+            PreviewFrame lease = frame ? PreviewFrameImpl::Adopt(frame) : PreviewFrame();
+            if (_canceled)
+            {
+                break;
+            }
+            if (_paused || !res)
+            {
+                continue;
+            }
+
+            container.number = frameNumber++;
+            _captured++;
+            PrewarmOnFace(container.metadata);
+            Metrics::Add(Metrics::Counter::PreviewFramesCaptured);
+            if (_pool && !frame)
+            {
+                _dropped++;
+                Metrics::Add(Metrics::Counter::PreviewFramesDropped);
+                LOG_DEBUG_LIMITED(LOG_TAG, "All preview frames are leased, frame %u dropped", container.number);
+                continue;
+            }
+            if (frame)
+            {
+                frame->image = container;
+            }
+            if (frame && _recorder.IsRecording())
+            {
+                _recorder.Push(lease);
+            }
+
+            if (_queue_capacity > 0)
+            {
+                Enqueue(std::move(lease));
+            }
+            else if (_callback || _packet_callback)
+            {
+                Trace::Scope deliver_trace {"Deliver", "preview"};
+                RecordDelivery(container.timing);
+                DeliverImage(container);
+                _delivered++;
+                Metrics::Add(Metrics::Counter::PreviewFramesDelivered);
+                Trace::FrameMark("Preview");
+            }
+            else
+            {
+                Deliver(lease);
+            }
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        LOG_ERROR(LOG_TAG, "Streaming ERROR : %s", ex.what());
+        Abort();
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Streaming unknonwn exception");
+        Abort();
+    }
+    ReportFullRate(false);
+}
+
+void PreviewImpl::Enqueue(PreviewFrame frame)
+{
+    std::unique_lock<std::mutex> lock {_queue_mutex};
+    if (_config.queuePolicy == PreviewQueuePolicy::Block)
+    {
+        _queue_cv.wait(lock, [this] { return _canceled || _queue.size() < _queue_capacity; });
+        if (_canceled)
+        {
+            return;
+        }
+    }
+    else if (_queue.size() >= _queue_capacity)
+    {
+        // frame goes back to the pool with the lease
+        _queue.pop_front();
+        _dropped++;
+        Metrics::Add(Metrics::Counter::PreviewFramesDropped);
+    }
+    _queue.push_back(std::move(frame));
+    lock.unlock();
+    _queue_cv.notify_all();
+}
+
+void PreviewImpl::DeliveryLoop()
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Preview, "preview-cb");
+    try
+    {
+        while (true)
+        {
+            PreviewFrame frame;
+            {
+                std::unique_lock<std::mutex> lock {_queue_mutex};
+                _queue_cv.wait(lock, [this] { return _canceled || !_queue.empty(); });
                 if (_canceled)
                 {
                     break;
                 }
-                if (_paused)
-                {
-                    continue;
-                }
-                if (res)
-                {
-                    container.number = frameNumber++;
-                    _callback->OnPreviewImageReady(container);
-                }
-                else
-                {
-                    continue;
-                }
+                frame = std::move(_queue.front());
+                _queue.pop_front();
+            }
+            // room for the next image (Block policy)
+            _queue_cv.notify_all();
+
+            if (_paused)
+            {
+                _dropped++;
+                Metrics::Add(Metrics::Counter::PreviewFramesDropped);
+                continue;
             }
+            Deliver(frame);
         }
-        catch (const std::exception& ex)
+    }
+    catch (const std::exception& ex)
+    {
+        LOG_ERROR(LOG_TAG, "Preview callback ERROR : %s", ex.what());
+        Abort();
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Preview callback unknonwn exception");
+        Abort();
+    }
+}
+
+void PreviewImpl::Deliver(const PreviewFrame& frame)
+{
+    Trace::Scope deliver_trace {"Deliver", "preview"};
+    RecordDelivery(PreviewFrameImpl::ImageOf(frame)->timing);
+    if (_frame_callback)
+    {
+        _frame_callback->OnPreviewFrameReady(frame);
+    }
+    else
+    {
+        DeliverImage(frame.GetImage());
+    }
+    _delivered++;
+    Metrics::Add(Metrics::Counter::PreviewFramesDelivered);
+    Trace::FrameMark("Preview");
+}
+
+void PreviewImpl::DeliverImage(const Image& image)
+{
+    if (_callback)
+    {
+        _callback->OnPreviewImageReady(image);
+        return;
+    }
+    if (!_encoder)
+    {
+        auto* callback = _packet_callback;
+        _encoder = Capture::PreviewEncoder::Create(_encoder_config, image.width, image.height,
+                                                   [callback](const PreviewPacket& packet) {
+                                                       callback->OnPreviewPacket(packet);
+                                                   });
+    }
+    if (!_encoder->Encode(image))
+    {
+        throw std::runtime_error("preview encoding failed");
+    }
+}
+
+void PreviewImpl::RecordDelivery(ImageTiming& timing)
+{
+    timing.deliveredTime = Capture::HostTimeUs();
+    uint64_t start =
+        (timing.captureOnHostClock && timing.captureTimestamp != 0) ? timing.captureTimestamp : timing.dequeueTime;
+    if (timing.deviceCaptureTime != 0)
+    {
+        start = timing.deviceCaptureTime;
+    }
+    if (start == 0 || timing.deliveredTime < start)
+    {
+        return;
+    }
+    const uint64_t latency = std::min<uint64_t>(timing.deliveredTime - start, UINT32_MAX);
+    Metrics::RecordUs(Metrics::Latency::PreviewDelivery, latency);
+    if (_config.latencyWindow == 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock {_latency_mutex};
+    if (_latencies.size() < _config.latencyWindow)
+    {
+        _latencies.push_back(static_cast<unsigned int>(latency));
+    }
+    else
+    {
+        _latencies[_latency_next] = static_cast<unsigned int>(latency);
+        _latency_next = (_latency_next + 1) % _latencies.size();
+    }
+}
+
+PreviewLatency PreviewImpl::GetLatency() const
+{
+    std::vector<unsigned int> latencies;
+    {
+        std::lock_guard<std::mutex> lock {_latency_mutex};
+        latencies = _latencies;
+    }
+
+    PreviewLatency result;
+    if (latencies.empty())
+    {
+        return result;
+    }
+    for (auto latency : latencies)
+    {
+        unsigned int bucket = 0;
+        for (unsigned int ms = latency / 1000; ms > 0 && bucket < PreviewLatency::Buckets - 1; ms >>= 1)
         {
-            LOG_ERROR(LOG_TAG, "Streaming ERROR : %s", ex.what());
-            _canceled = true;
+            bucket++;
         }
-        catch (...)
+        result.histogram[bucket]++;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    result.frames = static_cast<unsigned int>(latencies.size());
+    result.medianUs = latencies[latencies.size() / 2];
+    result.p99Us = latencies[(latencies.size() * 99) / 100];
+    result.maxUs = latencies.back();
+    return result;
+}
+
+// receive the image without converting it if idle and the idle frame rate was reached
+bool PreviewImpl::SkipIdleImage()
+{
+    if (_config.idleFps == 0)
+    {
+        return false;
+    }
+    auto now = Capture::HostTimeUs();
+    if (now < _active_until || now >= _next_idle_image)
+    {
+        _next_idle_image = now + 1000000 / _config.idleFps;
+        return false;
+    }
+    if (_capture->Skip())
+    {
+        _skipped++;
+    }
+    return true;
+}
+
+// follow the transfers of the coordinator: close the camera at the start and the end of a transfer, to reopen it at
+// the new frame rate. returns true while the camera stays closed for a transfer (transferFps 0)
+bool PreviewImpl::FollowTransfers()
+{
+    auto* coordinator = _config.transferCoordinator;
+    if (coordinator == nullptr || _config.playbackPath != nullptr)
+    {
+        return false;
+    }
+    const bool transfer = coordinator->IsTransferActive();
+    if (transfer != _transfer_rate)
+    {
+        _transfer_rate = transfer;
+        _capture.reset();
+        if (transfer)
+        {
+            LOG_DEBUG(LOG_TAG, "Transfer started, streaming at %u fps", _config.transferFps);
+        }
+        else
         {
-            LOG_ERROR(LOG_TAG, "Streaming unknonwn exception");
-            _canceled = true;
+            LOG_DEBUG(LOG_TAG, "Transfers done, streaming at the full frame rate");
         }
-    });
+    }
+    if (!_transfer_rate || _config.transferFps > 0)
+    {
+        return false;
+    }
+    ReportFullRate(false);
+    // short waits, to see a stop or pause
+    coordinator->_impl->WaitTransfersDone(std::chrono::milliseconds {100});
     return true;
 }
 
+void PreviewImpl::ReportFullRate(bool full_rate)
+{
+    auto* coordinator = _config.transferCoordinator;
+    if (coordinator == nullptr || _config.playbackPath != nullptr || full_rate == _full_rate)
+    {
+        return;
+    }
+    _full_rate = full_rate;
+    coordinator->_impl->SetFullRate(full_rate);
+}
+
+void PreviewImpl::SetPrewarm(FaceAuthenticator* authenticator, unsigned int hold_ms)
+{
+    std::lock_guard<std::mutex> lock {_prewarm_mutex};
+    _prewarm_authenticator = authenticator;
+    _prewarm_hold_ms = hold_ms;
+    _next_prewarm = 0;
+}
+
+void PreviewImpl::PrewarmOnFace(const ImageMetadata& metadata)
+{
+    if (metadata.face_rect.width == 0 || metadata.face_rect.height == 0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock {_prewarm_mutex};
+    auto now = Capture::HostTimeUs();
+    if (_prewarm_authenticator == nullptr || now < _next_prewarm)
+    {
+        return;
+    }
+    _next_prewarm = now + static_cast<uint64_t>(_prewarm_hold_ms) * 1000;
+    LOG_DEBUG(LOG_TAG, "Face in frame, prewarming the authenticator");
+    _prewarm_authenticator->PrewarmAsync(_prewarm_hold_ms);
+}
+
+void PreviewImpl::Abort()
+{
+    {
+        std::lock_guard<std::mutex> lock {_queue_mutex};
+        _canceled = true;
+    }
+    _queue_cv.notify_all();
+}
+
 bool PreviewImpl::PausePreview()
 {
-    _paused = true;
+    {
+        std::lock_guard<std::mutex> lock {_queue_mutex};
+        _paused = true;
+    }
+    _queue_cv.notify_all();
     return true;
 }
 
 bool PreviewImpl::ResumePreview()
 {
-    _paused = false;
+    {
+        std::lock_guard<std::mutex> lock {_queue_mutex};
+        _paused = false;
+    }
+    _queue_cv.notify_all();
     return true;
 }
 
+void PreviewImpl::NotifyActivity()
+{
+    _active_until = Capture::HostTimeUs() + static_cast<uint64_t>(_config.activeHoldMs) * 1000;
+}
+
 bool PreviewImpl::StopPreview()
 {
-    _canceled = true;
+    Abort();
     if (_worker_thread.joinable())
     {
         _worker_thread.join();
     }
+    _recorder.Stop();
+    if (_delivery_thread.joinable())
+    {
+        _delivery_thread.join();
+    }
+    if (_encoder)
+    {
+        // packets of the images in the encoder
+        try
+        {
+            _encoder->Flush();
+        }
+        catch (const std::exception& ex)
+        {
+            LOG_ERROR(LOG_TAG, "Encoder flush ERROR : %s", ex.what());
+        }
+        _encoder.reset();
+    }
+    // return the undelivered frames to the pool
+    _queue.clear();
     return true;
 }
+
+bool PreviewImpl::StartRecording(const char* path)
+{
+    if (!IsRecordable(_config))
+    {
+        LOG_ERROR(LOG_TAG, "Recording requires the Dump preview mode with images, or YUYV images of the VGA mode");
+        return false;
+    }
+    return _recorder.Start(path);
+}
+
+bool PreviewImpl::StopRecording()
+{
+    return _recorder.Stop();
+}
+
+PreviewStatistics PreviewImpl::GetStatistics() const
+{
+    PreviewStatistics statistics;
+    statistics.captured = _captured;
+    statistics.delivered = _delivered;
+    statistics.dropped = _dropped;
+    statistics.skipped = _skipped;
+    statistics.recorded = _recorder.Recorded();
+    statistics.recordDropped = _recorder.Dropped();
+    return statistics;
+}
 } // namespace RealSenseID
@@ -4,17 +4,20 @@
 #pragma once
 
 #include "RealSenseID/Preview.h"
+#include "DumpRecorder.h"
+#include "FramePool.h"
+#include "PreviewEncoder.h"
 
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
 
-#ifdef ANDROID
-#include "AndroidCapture.h"
-#elif LINUX
-#include "LinuxCapture.h"
-#elif _WIN32
-#include "MSMFCapture.h"
-#endif
+#include "CaptureSource.h"
+#include "StreamConverter.h"
 
 namespace RealSenseID
 {
@@ -24,16 +27,76 @@ public:
     ~PreviewImpl();
     explicit PreviewImpl(const PreviewConfig& config);
     bool StartPreview(PreviewImageReadyCallback& callback);
+    bool StartPreview(PreviewFrameReadyCallback& callback, unsigned int pool_size);
+    bool StartEncodedPreview(PreviewPacketCallback& callback, const PreviewEncoderConfig& config);
     bool PausePreview();
     bool ResumePreview();
+    void NotifyActivity();
+    void SetPrewarm(FaceAuthenticator* authenticator, unsigned int hold_ms);
     bool StopPreview();
+    bool StartRecording(const char* path);
+    bool StopRecording();
+    PreviewStatistics GetStatistics() const;
+    PreviewLatency GetLatency() const;
 
 private:
     PreviewConfig _config;
-    std::thread _worker_thread;
+    std::thread _worker_thread;   // capture
+    std::thread _delivery_thread; // callbacks, unless PreviewQueuePolicy::Inline
     std::atomic_bool _canceled {false};
     std::atomic_bool _paused {false};
     PreviewImageReadyCallback* _callback = nullptr;
-    std::unique_ptr<Capture::CaptureHandle> _capture;
+    PreviewFrameReadyCallback* _frame_callback = nullptr;
+    PreviewPacketCallback* _packet_callback = nullptr;
+    PreviewConfig _user_config;             // _config as given, before an encoded preview's changes
+    PreviewEncoderConfig _encoder_config;
+    std::unique_ptr<Capture::PreviewEncoder> _encoder; // created with the first image, used on the delivery thread
+    unsigned int _pool_size = 0;
+    std::shared_ptr<FramePool> _pool; // frames of _frame_callback, or of the queue
+    std::unique_ptr<Capture::CaptureSource> _capture; // the camera, or a recording (PreviewConfig::playbackPath)
+    DumpRecorder _recorder; // of the dumped images, from their frames of _pool
+
+    // captured images waiting for delivery. also signaled on pause, resume and stop.
+    std::mutex _queue_mutex;
+    std::condition_variable _queue_cv;
+    std::deque<PreviewFrame> _queue;
+    std::size_t _queue_capacity = 0;
+
+    std::atomic<unsigned int> _captured {0};
+    std::atomic<unsigned int> _delivered {0};
+    std::atomic<unsigned int> _dropped {0};
+    std::atomic<unsigned int> _skipped {0};
+
+    // adaptive frame rate (host times in microseconds)
+    std::atomic<uint64_t> _active_until {0};
+    uint64_t _next_idle_image = 0;
+
+    // prewarm on faces (SetPrewarm)
+    std::mutex _prewarm_mutex;
+    FaceAuthenticator* _prewarm_authenticator = nullptr;
+    unsigned int _prewarm_hold_ms = 0;
+    uint64_t _next_prewarm = 0; // host time in microseconds
+
+    // coordinated bandwidth (PreviewConfig::transferCoordinator), of the capture thread
+    bool _transfer_rate = false; // the camera streams at the transfer frame rate, or not at all
+    bool _full_rate = false;     // counted by the coordinator as streaming at the full frame rate
+
+    // latencies of the last _config.latencyWindow images (ring buffer)
+    mutable std::mutex _latency_mutex;
+    std::vector<unsigned int> _latencies;
+    std::size_t _latency_next = 0;
+
+    bool StartWorker();
+    void CaptureLoop();
+    bool SkipIdleImage();
+    bool FollowTransfers();
+    void ReportFullRate(bool full_rate);
+    void PrewarmOnFace(const ImageMetadata& metadata);
+    void DeliveryLoop();
+    void Enqueue(PreviewFrame frame);
+    void Deliver(const PreviewFrame& frame);
+    void DeliverImage(const Image& image); // to the image callback, or to the encoder
+    void RecordDelivery(ImageTiming& timing);
+    void Abort(); // stop both threads on error
 };
 } // namespace RealSenseID
@@ -0,0 +1,216 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "SharedMemory.h"
+#include "Logger.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char* LOG_TAG = "SharedMemory";
+
+namespace RealSenseID
+{
+// platform name of the memory
+static std::string ObjectName(const char* name)
+{
+#ifdef _WIN32
+    return std::string("Local\\rsid_") + name;
+#else
+    return std::string("/rsid_") + name;
+#endif
+}
+
+SharedMemory::~SharedMemory()
+{
+    Close();
+}
+
+#ifdef _WIN32
+bool SharedMemory::Create(const char* name, size_t size, unsigned int)
+{
+    Close();
+    _name = ObjectName(name);
+    const auto size64 = static_cast<unsigned long long>(size);
+    _mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32),
+                                    static_cast<DWORD>(size64 & 0xFFFFFFFF), _name.c_str());
+    if (_mapping == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to create %s, error %lu", _name.c_str(), ::GetLastError());
+        return false;
+    }
+    _data = static_cast<unsigned char*>(::MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+    if (_data == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to map %s, error %lu", _name.c_str(), ::GetLastError());
+        Close();
+        return false;
+    }
+    ::memset(_data, 0, size); // an existing mapping of the name is reused
+    _size = size;
+    _owner = true;
+    return true;
+}
+
+bool SharedMemory::Open(const char* name)
+{
+    Close();
+    _name = ObjectName(name);
+    _mapping = ::OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, _name.c_str());
+    if (_mapping == nullptr)
+    {
+        const DWORD error = ::GetLastError();
+        if (error == ERROR_FILE_NOT_FOUND)
+            LOG_DEBUG(LOG_TAG, "No %s", _name.c_str());
+        else
+            LOG_ERROR(LOG_TAG, "Failed to open %s, error %lu", _name.c_str(), error);
+        return false;
+    }
+    _data = static_cast<unsigned char*>(::MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    MEMORY_BASIC_INFORMATION info;
+    if (_data == nullptr || ::VirtualQuery(_data, &info, sizeof(info)) == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to map %s, error %lu", _name.c_str(), ::GetLastError());
+        Close();
+        return false;
+    }
+    _size = info.RegionSize;
+    return true;
+}
+
+void SharedMemory::Close()
+{
+    if (_data != nullptr)
+    {
+        ::UnmapViewOfFile(_data);
+        _data = nullptr;
+    }
+    if (_mapping != nullptr)
+    {
+        ::CloseHandle(_mapping); // the mapping is gone with its last handle
+        _mapping = nullptr;
+    }
+    _size = 0;
+    _owner = false;
+}
+
+void SharedMemory::Remove(const char*)
+{
+    // the mapping is gone with its last handle
+}
+
+uint32_t SharedMemory::ProcessId()
+{
+    return static_cast<uint32_t>(::GetCurrentProcessId());
+}
+
+bool SharedMemory::IsProcessAlive(uint32_t pid)
+{
+    HANDLE process = ::OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+    if (process == nullptr)
+        return ::GetLastError() == ERROR_ACCESS_DENIED; // of another user
+    const bool alive = ::WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    ::CloseHandle(process);
+    return alive;
+}
+#else
+bool SharedMemory::Create(const char* name, size_t size, unsigned int mode)
+{
+    Close();
+    _name = ObjectName(name);
+    int fd = ::shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to create %s, errno %d", _name.c_str(), errno);
+        return false;
+    }
+    _owner = true;
+    // new objects are zeroed. the mode is set after creation, not masked by the umask
+    void* data = MAP_FAILED;
+    if (::fchmod(fd, static_cast<mode_t>(mode)) == 0 && ::ftruncate(fd, static_cast<off_t>(size)) == 0)
+    {
+        data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to map %s", _name.c_str());
+        Close();
+        return false;
+    }
+    _data = static_cast<unsigned char*>(data);
+    _size = size;
+    return true;
+}
+
+bool SharedMemory::Open(const char* name)
+{
+    Close();
+    _name = ObjectName(name);
+    int fd = ::shm_open(_name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        if (errno == ENOENT)
+            LOG_DEBUG(LOG_TAG, "No %s", _name.c_str());
+        else
+            LOG_ERROR(LOG_TAG, "Failed to open %s, errno %d", _name.c_str(), errno);
+        return false;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to map %s", _name.c_str());
+        return false;
+    }
+    _data = static_cast<unsigned char*>(data);
+    _size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void SharedMemory::Close()
+{
+    if (_data != nullptr)
+    {
+        ::munmap(_data, _size);
+        _data = nullptr;
+    }
+    if (_owner)
+    {
+        // mapped by the subscribers until they close it
+        ::shm_unlink(_name.c_str());
+        _owner = false;
+    }
+    _size = 0;
+}
+
+void SharedMemory::Remove(const char* name)
+{
+    ::shm_unlink(ObjectName(name).c_str());
+}
+
+uint32_t SharedMemory::ProcessId()
+{
+    return static_cast<uint32_t>(::getpid());
+}
+
+bool SharedMemory::IsProcessAlive(uint32_t pid)
+{
+    return ::kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH; // EPERM: of another user
+}
+#endif
+} // namespace RealSenseID
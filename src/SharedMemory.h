@@ -0,0 +1,56 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace RealSenseID
+{
+// Named shared memory mapping: POSIX shared memory object on Linux, file mapping on Windows.
+class SharedMemory
+{
+public:
+    SharedMemory() = default;
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    // create the named memory of size zeroed bytes, fails if the name exists (on Linux, reused on Windows).
+    // mode is the permissions of the object on Linux. the creator removes the name on close
+    bool Create(const char* name, size_t size, unsigned int mode = 0600);
+    // map existing named memory
+    bool Open(const char* name);
+    void Close();
+
+    // remove the name of memory left by a process that didn't close it (nothing to do on Windows)
+    static void Remove(const char* name);
+
+    // id of this process, to tell the others sharing the memory
+    static uint32_t ProcessId();
+    // false once the process of the id exited
+    static bool IsProcessAlive(uint32_t pid);
+
+    unsigned char* Data() const
+    {
+        return _data;
+    }
+
+    size_t Size() const
+    {
+        return _size;
+    }
+
+private:
+    unsigned char* _data = nullptr;
+    size_t _size = 0;
+    bool _owner = false;
+    std::string _name;
+#ifdef _WIN32
+    void* _mapping = nullptr;
+#endif
+};
+} // namespace RealSenseID
@@ -0,0 +1,354 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "TaskScheduler.h"
+#include "ThreadConfigImpl.h"
+#include "Logger.h"
+#include <algorithm>
+#include <exception>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "TaskScheduler";
+
+std::atomic<unsigned int> TaskScheduler::_num_threads {0};
+
+static std::mutex s_executor_mutex;
+static std::shared_ptr<TaskExecutor> s_executor;
+
+// scheduler and queue of the calling thread, if it is a scheduler thread
+static thread_local const TaskScheduler* t_scheduler = nullptr;
+static thread_local size_t t_queue = 0;
+
+void SetTaskThreads(unsigned int threads)
+{
+    TaskScheduler::SetThreads(threads);
+}
+
+void SetTaskExecutor(std::shared_ptr<TaskExecutor> executor)
+{
+    TaskScheduler::SetExecutor(std::move(executor));
+}
+
+static void RunTask(const TaskScheduler::Task& task)
+{
+    try
+    {
+        task();
+    }
+    catch (const std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Unknown exception in task");
+    }
+}
+
+std::shared_ptr<TaskScheduler> TaskScheduler::Acquire()
+{
+    static std::mutex instance_mutex;
+    static std::weak_ptr<TaskScheduler> instance;
+
+    std::lock_guard<std::mutex> lock {instance_mutex};
+    auto scheduler = instance.lock();
+    if (!scheduler)
+    {
+        scheduler = std::make_shared<TaskScheduler>();
+        instance = scheduler;
+    }
+    return scheduler;
+}
+
+void TaskScheduler::SetThreads(unsigned int threads)
+{
+    _num_threads.store(threads);
+}
+
+void TaskScheduler::SetExecutor(std::shared_ptr<TaskExecutor> executor)
+{
+    std::lock_guard<std::mutex> lock {s_executor_mutex};
+    s_executor = std::move(executor);
+}
+
+TaskScheduler::TaskScheduler()
+{
+    unsigned int num_threads = _num_threads.load();
+    if (num_threads == 0)
+    {
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    for (unsigned int i = 0; i < num_threads; i++)
+    {
+        _queues.emplace_back(new Queue);
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        _stop = true;
+    }
+    _work_cv.notify_all();
+    for (auto& thread : _threads)
+    {
+        // released by the last task of one of its own threads
+        if (thread.get_id() == std::this_thread::get_id())
+        {
+            thread.detach();
+            continue;
+        }
+        thread.join();
+    }
+}
+
+void TaskScheduler::StartThreads()
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    if (!_threads.empty() || _stop)
+    {
+        return;
+    }
+    for (size_t i = 0; i < _queues.size(); i++)
+    {
+        _threads.emplace_back(&TaskScheduler::ThreadLoop, this, i);
+    }
+    LOG_DEBUG(LOG_TAG, "Started %zu task threads", _threads.size());
+}
+
+void TaskScheduler::Submit(Task task)
+{
+    std::shared_ptr<TaskExecutor> executor;
+    {
+        std::lock_guard<std::mutex> lock {s_executor_mutex};
+        executor = s_executor;
+    }
+    if (executor)
+    {
+        executor->Execute([task = std::move(task)]() { RunTask(task); });
+        return;
+    }
+
+    StartThreads();
+    const size_t index = t_scheduler == this ? t_queue : _next_queue.fetch_add(1) % _queues.size();
+    {
+        auto& queue = *_queues[index];
+        std::lock_guard<std::mutex> lock {queue.mutex};
+        queue.tasks.push_back(std::move(task));
+        _pending++;
+    }
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+    }
+    _work_cv.notify_one();
+}
+
+bool TaskScheduler::TakeTask(size_t index, Task& task)
+{
+    {
+        auto& own = *_queues[index];
+        std::lock_guard<std::mutex> lock {own.mutex};
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            _pending--;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < _queues.size(); i++)
+    {
+        auto& other = *_queues[(index + i) % _queues.size()];
+        std::lock_guard<std::mutex> lock {other.mutex};
+        if (!other.tasks.empty())
+        {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            _pending--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::ThreadLoop(size_t index)
+{
+    ThreadConfigImpl::ApplyToCurrentThread(ThreadRole::Tasks, "tasks");
+    t_scheduler = this;
+    t_queue = index;
+
+    Task task;
+    while (true)
+    {
+        if (TakeTask(index, task))
+        {
+            RunTask(task);
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock {_mutex};
+        _work_cv.wait(lock, [this] { return _stop || _pending > 0; });
+        if (_stop && _pending == 0)
+        {
+            return; // stopped and drained
+        }
+    }
+}
+
+// state of a ParallelFor(), kept by the tasks which start after the loop is done
+struct ParallelLoop
+{
+    const std::function<void(size_t)>* task = nullptr;
+    size_t num_tasks = 0;
+    std::atomic<size_t> next {0};
+    std::atomic<size_t> done {0};
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    std::exception_ptr error; // first exception of the tasks, rethrown by the calling thread
+
+    void RunTasks()
+    {
+        size_t ran = 0;
+        size_t task_index;
+        while ((task_index = next.fetch_add(1)) < num_tasks)
+        {
+            try
+            {
+                (*task)(task_index);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock {mutex};
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+            ran++;
+        }
+        if (ran > 0 && done.fetch_add(ran) + ran == num_tasks)
+        {
+            std::lock_guard<std::mutex> lock {mutex};
+            done_cv.notify_all();
+        }
+    }
+};
+
+void TaskScheduler::ParallelFor(size_t num_tasks, size_t max_parallel, const std::function<void(size_t)>& task)
+{
+    if (num_tasks == 0)
+    {
+        return;
+    }
+    const size_t helpers = std::min({max_parallel, num_tasks, _queues.size() + 1}) - 1;
+    if (max_parallel == 0 || helpers == 0)
+    {
+        for (size_t i = 0; i < num_tasks; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    auto loop = std::make_shared<ParallelLoop>();
+    loop->task = &task;
+    loop->num_tasks = num_tasks;
+    for (size_t i = 0; i < helpers; i++)
+    {
+        Submit([loop]() { loop->RunTasks(); });
+    }
+    loop->RunTasks();
+
+    // the task object is used until the last index is done
+    std::unique_lock<std::mutex> lock {loop->mutex};
+    loop->done_cv.wait(lock, [&loop] { return loop->done.load() == loop->num_tasks; });
+    if (loop->error)
+    {
+        std::rethrow_exception(loop->error);
+    }
+}
+
+TaskGroup::TaskGroup(std::shared_ptr<TaskScheduler> scheduler) :
+    _scheduler {std::move(scheduler)}, _state {std::make_shared<State>()}
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    try
+    {
+        Wait();
+    }
+    catch (const std::exception& ex)
+    {
+        LOG_EXCEPTION(LOG_TAG, ex);
+    }
+    catch (...)
+    {
+        LOG_ERROR(LOG_TAG, "Unknown exception in task");
+    }
+}
+
+void TaskGroup::Run(TaskScheduler::Task task)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->task = std::move(task);
+    _entries.push_back(entry);
+
+    auto state = _state;
+    _scheduler->Submit([entry, state]() {
+        {
+            std::lock_guard<std::mutex> lock {state->mutex};
+            if (entry->claimed)
+            {
+                return; // run by Wait()
+            }
+            entry->claimed = true;
+            state->running++;
+        }
+        RunTask(entry->task);
+        std::lock_guard<std::mutex> lock {state->mutex};
+        state->running--;
+        state->done_cv.notify_all();
+    });
+}
+
+void TaskGroup::Wait()
+{
+    auto entries = std::move(_entries);
+    _entries.clear();
+
+    std::exception_ptr error;
+    for (auto& entry : entries)
+    {
+        {
+            std::lock_guard<std::mutex> lock {_state->mutex};
+            if (entry->claimed)
+            {
+                continue;
+            }
+            entry->claimed = true;
+        }
+        try
+        {
+            entry->task();
+        }
+        catch (...)
+        {
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    std::unique_lock<std::mutex> lock {_state->mutex};
+    _state->done_cv.wait(lock, [this] { return _state->running == 0; });
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+} // namespace RealSenseID
@@ -0,0 +1,108 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/TaskExecutor.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RealSenseID
+{
+// Process wide work stealing scheduler of the library's short parallel tasks (see TaskExecutor.h).
+// Each thread has its own deque: tasks submitted by a scheduler thread are pushed to its deque and popped back in
+// lifo order (cache warm), tasks from other threads are spread over the deques, and idle threads steal the oldest
+// task of the others. The tasks go to the application's TaskExecutor instead if one is set.
+// Shared by the objects that use it, the threads stop when the last one releases it.
+class TaskScheduler
+{
+public:
+    using Task = std::function<void()>;
+
+    static std::shared_ptr<TaskScheduler> Acquire();
+    static void SetThreads(unsigned int threads);
+    static void SetExecutor(std::shared_ptr<TaskExecutor> executor);
+
+    TaskScheduler();
+    ~TaskScheduler(); // runs the queued tasks
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // run the task once on a scheduler thread (or the executor), exceptions are logged
+    void Submit(Task task);
+
+    // call task(task_index) for each task_index in [0, num_tasks) on up to max_parallel threads, including the
+    // calling thread which runs the indices not taken by the others. Blocks until all tasks are done, may be called
+    // from a task (nested loops run on the calling thread if all others are busy).
+    void ParallelFor(size_t num_tasks, size_t max_parallel, const std::function<void(size_t)>& task);
+
+    // threads of the scheduler (parallelism of ParallelFor() with the calling thread)
+    unsigned int NumThreads() const
+    {
+        return static_cast<unsigned int>(_queues.size());
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    static std::atomic<unsigned int> _num_threads;
+
+    std::vector<std::unique_ptr<Queue>> _queues; // one per thread
+    std::atomic<size_t> _next_queue {0};         // queue of the next task of a non scheduler thread
+    std::atomic<size_t> _pending {0};            // queued tasks
+
+    std::mutex _mutex; // guards the threads and the sleep of idle threads
+    std::condition_variable _work_cv;
+    std::vector<std::thread> _threads; // started with the first task
+    bool _stop = false;
+
+    void StartThreads();
+    bool TakeTask(size_t index, Task& task); // own deque's newest, or steal the oldest of another
+    void ThreadLoop(size_t index);
+};
+
+// Tasks waited for together, e.g. work done ahead on the scheduler.
+// Wait() runs the tasks not started yet on the calling thread, so it never depends on a free scheduler thread.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(std::shared_ptr<TaskScheduler> scheduler);
+    ~TaskGroup(); // waits for the tasks
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void Run(TaskScheduler::Task task);
+    void Wait();
+
+private:
+    struct Entry
+    {
+        TaskScheduler::Task task;
+        bool claimed = false; // guarded by the state's mutex
+    };
+    struct State
+    {
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        size_t running = 0; // claimed by a scheduler thread and not done
+    };
+
+    std::shared_ptr<TaskScheduler> _scheduler;
+    std::shared_ptr<State> _state;
+    std::vector<std::shared_ptr<Entry>> _entries;
+};
+} // namespace RealSenseID
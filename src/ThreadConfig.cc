@@ -0,0 +1,154 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "ThreadConfigImpl.h"
+#include "Logger.h"
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "ThreadConfig";
+static const size_t MAX_THREAD_NAME = 15; // linux limit, without the null
+
+static const size_t ROLE_COUNT = static_cast<size_t>(ThreadRole::Io) + 1;
+static std::mutex s_configs_mutex;
+static ThreadConfig s_configs[ROLE_COUNT];
+
+void SetThreadConfig(ThreadRole role, const ThreadConfig& config)
+{
+    auto index = static_cast<size_t>(role);
+    if (index >= ROLE_COUNT)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid thread role %zu", index);
+        return;
+    }
+    std::lock_guard<std::mutex> lock {s_configs_mutex};
+    s_configs[index] = config;
+}
+
+ThreadConfig GetThreadConfig(ThreadRole role)
+{
+    auto index = static_cast<size_t>(role);
+    if (index >= ROLE_COUNT)
+    {
+        return ThreadConfig {};
+    }
+    std::lock_guard<std::mutex> lock {s_configs_mutex};
+    return s_configs[index];
+}
+
+namespace ThreadConfigImpl
+{
+#ifdef _WIN32
+static void SetName(const std::string& name)
+{
+    // SetThreadDescription is available from windows 10 1607
+    using SetThreadDescriptionFn = HRESULT(WINAPI*)(HANDLE, PCWSTR);
+    static auto set_description = reinterpret_cast<SetThreadDescriptionFn>(
+        ::GetProcAddress(::GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription"));
+    if (set_description != nullptr)
+    {
+        std::wstring wide_name(name.begin(), name.end());
+        set_description(::GetCurrentThread(), wide_name.c_str());
+    }
+}
+
+static bool SetAffinity(unsigned long long mask)
+{
+    auto cpus = static_cast<DWORD_PTR>(mask);
+    return cpus != 0 && ::SetThreadAffinityMask(::GetCurrentThread(), cpus) != 0;
+}
+
+static bool SetRealtime(int)
+{
+    return ::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+}
+
+static bool SetNiceness(int niceness)
+{
+    int priority = THREAD_PRIORITY_NORMAL;
+    if (niceness <= -10)
+        priority = THREAD_PRIORITY_HIGHEST;
+    else if (niceness < 0)
+        priority = THREAD_PRIORITY_ABOVE_NORMAL;
+    else if (niceness >= 10)
+        priority = THREAD_PRIORITY_LOWEST;
+    else if (niceness > 0)
+        priority = THREAD_PRIORITY_BELOW_NORMAL;
+    return ::SetThreadPriority(::GetCurrentThread(), priority) != 0;
+}
+#else
+static void SetName(const std::string& name)
+{
+    ::pthread_setname_np(::pthread_self(), name.c_str());
+}
+
+static bool SetAffinity(unsigned long long mask)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; cpu++)
+    {
+        if (mask & (1ULL << cpu))
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    // pid 0 - the calling thread (also on android, which has no pthread_setaffinity_np)
+    return CPU_COUNT(&set) != 0 && ::sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+static bool SetRealtime(int priority)
+{
+    sched_param param {};
+    param.sched_priority = priority;
+    return ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+static bool SetNiceness(int niceness)
+{
+    // the nice value of a linux thread is set through its tid
+    auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+    return ::setpriority(PRIO_PROCESS, tid, niceness) == 0;
+}
+#endif // _WIN32
+
+void ApplyToCurrentThread(ThreadRole role, const char* name)
+{
+    auto config = GetThreadConfig(role);
+    std::string thread_name = std::string("rsid-") + name;
+    if (config.setNames)
+    {
+        SetName(thread_name.substr(0, MAX_THREAD_NAME));
+    }
+    if (config.affinityMask != 0 && !SetAffinity(config.affinityMask))
+    {
+        LOG_WARNING(LOG_TAG, "Failed setting the cpu affinity of %s to 0x%llx", thread_name.c_str(),
+                    config.affinityMask);
+    }
+    if (config.realtimePriority > 0)
+    {
+        if (!SetRealtime(config.realtimePriority))
+        {
+            LOG_WARNING(LOG_TAG, "Failed setting realtime priority %d of %s", config.realtimePriority,
+                        thread_name.c_str());
+        }
+    }
+    else if (config.niceness != 0 && !SetNiceness(config.niceness))
+    {
+        LOG_WARNING(LOG_TAG, "Failed setting niceness %d of %s", config.niceness, thread_name.c_str());
+    }
+}
+} // namespace ThreadConfigImpl
+} // namespace RealSenseID
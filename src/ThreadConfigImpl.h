@@ -0,0 +1,16 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/ThreadConfig.h"
+
+namespace RealSenseID
+{
+namespace ThreadConfigImpl
+{
+// Apply the role's ThreadConfig (see SetThreadConfig()) to the calling thread, named "rsid-<name>" (truncated to the
+// 15 characters linux allows). Called first thing by each thread the library starts.
+void ApplyToCurrentThread(ThreadRole role, const char* name);
+} // namespace ThreadConfigImpl
+} // namespace RealSenseID
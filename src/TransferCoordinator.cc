@@ -0,0 +1,112 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/TransferCoordinator.h"
+#include "TransferCoordinatorImpl.h"
+#include "Logger.h"
+
+static const char* LOG_TAG = "TransferCoordinator";
+
+namespace RealSenseID
+{
+TransferCoordinatorImpl::TransferCoordinatorImpl(unsigned int settle_ms) : _settle {settle_ms}
+{
+}
+
+void TransferCoordinatorImpl::BeginTransfer()
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    if (_transfers++ > 0)
+    {
+        return;
+    }
+    _cv.notify_all();
+    // the previews reduce their frame rate once they see the transfer (at their next image)
+    if (!_cv.wait_for(lock, _settle, [this] { return _full_rate_previews == 0; }))
+    {
+        LOG_DEBUG(LOG_TAG, "%u previews still at full frame rate, starting the transfer", _full_rate_previews);
+    }
+}
+
+void TransferCoordinatorImpl::EndTransfer()
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (_transfers == 0)
+        {
+            LOG_ERROR(LOG_TAG, "EndTransfer without BeginTransfer");
+            return;
+        }
+        _transfers--;
+    }
+    _cv.notify_all();
+}
+
+bool TransferCoordinatorImpl::IsTransferActive() const
+{
+    std::lock_guard<std::mutex> lock {_mutex};
+    return _transfers > 0;
+}
+
+void TransferCoordinatorImpl::SetFullRate(bool full_rate)
+{
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (full_rate)
+        {
+            _full_rate_previews++;
+        }
+        else if (_full_rate_previews > 0)
+        {
+            _full_rate_previews--;
+        }
+    }
+    _cv.notify_all();
+}
+
+bool TransferCoordinatorImpl::WaitTransfersDone(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock {_mutex};
+    return _cv.wait_for(lock, timeout, [this] { return _transfers == 0; });
+}
+
+TransferCoordinator::TransferCoordinator(unsigned int settle_ms) : _impl {new TransferCoordinatorImpl(settle_ms)}
+{
+}
+
+TransferCoordinator::~TransferCoordinator()
+{
+    delete _impl;
+}
+
+void TransferCoordinator::BeginTransfer()
+{
+    _impl->BeginTransfer();
+}
+
+void TransferCoordinator::EndTransfer()
+{
+    _impl->EndTransfer();
+}
+
+bool TransferCoordinator::IsTransferActive() const
+{
+    return _impl->IsTransferActive();
+}
+
+TransferCoordinator::Scope::Scope(TransferCoordinator* coordinator) : _coordinator {coordinator}
+{
+    if (_coordinator != nullptr)
+    {
+        _coordinator->BeginTransfer();
+    }
+}
+
+TransferCoordinator::Scope::~Scope()
+{
+    if (_coordinator != nullptr)
+    {
+        _coordinator->EndTransfer();
+    }
+}
+} // namespace RealSenseID
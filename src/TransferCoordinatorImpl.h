@@ -0,0 +1,35 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace RealSenseID
+{
+// State of a TransferCoordinator: the active transfers, and the previews streaming at their full frame rate which a
+// starting transfer waits for.
+class TransferCoordinatorImpl
+{
+public:
+    explicit TransferCoordinatorImpl(unsigned int settle_ms);
+
+    void BeginTransfer();
+    void EndTransfer();
+    bool IsTransferActive() const;
+
+    // a preview started (true) or stopped (false) streaming at its full frame rate
+    void SetFullRate(bool full_rate);
+    // wait up to the timeout for the active transfers to end. returns true if none is active
+    bool WaitTransfersDone(std::chrono::milliseconds timeout);
+
+private:
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::chrono::milliseconds _settle;
+    unsigned int _transfers = 0;
+    unsigned int _full_rate_previews = 0;
+};
+} // namespace RealSenseID
@@ -0,0 +1,40 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/UserDigest.h"
+#include "RealSenseID/Faceprints.h"
+
+namespace RealSenseID
+{
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// little endian bytes of the value, so the hash does not depend on the host's byte order
+template <typename T>
+static void HashValue(uint64_t& hash, T value)
+{
+    auto bits = static_cast<uint64_t>(value);
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+        hash ^= (bits >> (8 * i)) & 0xff;
+        hash *= FNV_PRIME;
+    }
+}
+
+uint64_t FeaturesHash(const Faceprints& faceprints)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    HashValue(hash, static_cast<int32_t>(faceprints.version));
+    HashValue(hash, static_cast<int32_t>(faceprints.numberOfDescriptors));
+    HashValue(hash, static_cast<uint16_t>(faceprints.featuresType));
+    for (feature_t feature : faceprints.avgDescriptor)
+    {
+        HashValue(hash, static_cast<uint16_t>(feature));
+    }
+    for (feature_t feature : faceprints.origDescriptor)
+    {
+        HashValue(hash, static_cast<uint16_t>(feature));
+    }
+    return hash;
+}
+} // namespace RealSenseID
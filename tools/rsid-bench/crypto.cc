@@ -0,0 +1,141 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Secure session packet crypto benchmarks: AES-CTR 256 + HMAC-SHA256 of one packet payload, as done per sent and
+// received packet. BM_PacketCrypto runs the session's single pass in place crypto on the library's backend (mbedtls,
+// or OpenSSL if built with RSID_SECURE_OPENSSL), BM_PacketCryptoReference the plain mbedtls one-shot calls for
+// comparison, and BM_PacketAes and BM_PacketHmac its two passes apart (the cpu time per packet by component, see
+// protocol.cc).
+// e.g. rsid-bench --benchmark_filter=PacketCrypto
+
+#include "MbedtlsWrapper.h"
+#include "mbedtls/md.h"
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using RealSenseID::PacketManager::MbedtlsWrapper;
+
+// payload sizes: small fa packet, full data packet
+static const int s_smallPayload = 64;
+static const int s_fullPayload = 1988;
+
+static bool FakeSign(const unsigned char*, const unsigned int, unsigned char* out_sig)
+{
+    ::memset(out_sig, 0x5a, ECC_P256_SIG_SIZE_BYTES);
+    return true;
+}
+
+static bool FakeVerify(const unsigned char*, const unsigned int, const unsigned char*, const unsigned int)
+{
+    return true;
+}
+
+static std::vector<unsigned char> RandomBytes(size_t size)
+{
+    std::mt19937 rng(2021);
+    std::vector<unsigned char> bytes(size);
+    for (auto& b : bytes)
+    {
+        b = static_cast<unsigned char>(rng());
+    }
+    return bytes;
+}
+
+static void BM_PacketCrypto(benchmark::State& state)
+{
+    // key exchange between two wrappers (host and "device") to get real session keys
+    MbedtlsWrapper host, device;
+    std::vector<unsigned char> host_key(SIGNED_PUBKEY_SIZE), device_key(SIGNED_PUBKEY_SIZE);
+    ::memcpy(host_key.data(), host.GetSignedEcdhPubkey(FakeSign), SIGNED_PUBKEY_SIZE);
+    ::memcpy(device_key.data(), device.GetSignedEcdhPubkey(FakeSign), SIGNED_PUBKEY_SIZE);
+    if (!host.VerifyEcdhSignedKey(device_key.data(), FakeVerify))
+    {
+        state.SkipWithError("key exchange failed");
+        return;
+    }
+
+    const auto size = static_cast<unsigned int>(state.range(0));
+    auto input = RandomBytes(size);
+    unsigned char header[22] = {0}; // SerialPacket header
+    unsigned char iv[AES_CTR_IV_SIZE_BYTES] = {1};
+    unsigned char hmac[HMAC_256_SIZE_BYTES];
+    for (auto _ : state)
+    {
+        // encrypted in place, as the session does with the packet payload
+        host.EncryptAndHmac(iv, header, sizeof(header), input.data(), size, hmac);
+        benchmark::DoNotOptimize(hmac);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+}
+BENCHMARK(BM_PacketCrypto)->Arg(s_smallPayload)->Arg(s_fullPayload);
+
+static void BM_PacketCryptoReference(benchmark::State& state)
+{
+    unsigned char key[AES_CTR_256_BIT_KEY_SIZE_BYTES];
+    ::memset(key, 0x11, sizeof(key));
+    mbedtls_aes_context aes_ctx;
+    mbedtls_aes_init(&aes_ctx);
+    mbedtls_aes_setkey_enc(&aes_ctx, key, AES_CTR_256_BIT_KEY_SIZE_BYTES * 8);
+    const auto* md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+
+    const auto size = static_cast<unsigned int>(state.range(0));
+    auto input = RandomBytes(size);
+    std::vector<unsigned char> output(size);
+    unsigned char hmac[HMAC_256_SIZE_BYTES];
+    for (auto _ : state)
+    {
+        size_t nc_off = 0;
+        unsigned char iv[AES_CTR_IV_SIZE_BYTES] = {1};
+        unsigned char stream_block[AES_CTR_IV_SIZE_BYTES] = {0};
+        mbedtls_aes_crypt_ctr(&aes_ctx, size, &nc_off, iv, stream_block, input.data(), output.data());
+        mbedtls_md_hmac(md, key, sizeof(key), output.data(), size, hmac);
+        benchmark::DoNotOptimize(hmac);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+    mbedtls_aes_free(&aes_ctx);
+}
+BENCHMARK(BM_PacketCryptoReference)->Arg(s_smallPayload)->Arg(s_fullPayload);
+
+static void BM_PacketAes(benchmark::State& state)
+{
+    unsigned char key[AES_CTR_256_BIT_KEY_SIZE_BYTES];
+    ::memset(key, 0x11, sizeof(key));
+    mbedtls_aes_context aes_ctx;
+    mbedtls_aes_init(&aes_ctx);
+    mbedtls_aes_setkey_enc(&aes_ctx, key, AES_CTR_256_BIT_KEY_SIZE_BYTES * 8);
+
+    const auto size = static_cast<unsigned int>(state.range(0));
+    auto input = RandomBytes(size);
+    for (auto _ : state)
+    {
+        size_t nc_off = 0;
+        unsigned char iv[AES_CTR_IV_SIZE_BYTES] = {1};
+        unsigned char stream_block[AES_CTR_IV_SIZE_BYTES] = {0};
+        mbedtls_aes_crypt_ctr(&aes_ctx, size, &nc_off, iv, stream_block, input.data(), input.data());
+        benchmark::DoNotOptimize(input.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+    mbedtls_aes_free(&aes_ctx);
+}
+BENCHMARK(BM_PacketAes)->Arg(s_smallPayload)->Arg(s_fullPayload);
+
+static void BM_PacketHmac(benchmark::State& state)
+{
+    unsigned char key[HMAC_256_SIZE_BYTES];
+    ::memset(key, 0x22, sizeof(key));
+    const auto* md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+
+    // the packet header and the encrypted payload
+    const auto size = static_cast<unsigned int>(state.range(0));
+    auto input = RandomBytes(22 + size);
+    unsigned char hmac[HMAC_256_SIZE_BYTES];
+    for (auto _ : state)
+    {
+        mbedtls_md_hmac(md, key, sizeof(key), input.data(), input.size(), hmac);
+        benchmark::DoNotOptimize(hmac);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+}
+BENCHMARK(BM_PacketHmac)->Arg(s_smallPayload)->Arg(s_fullPayload);
@@ -0,0 +1,233 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Host mode matcher benchmarks on synthetic faceprints.
+// Usage: rsid-bench [google benchmark flags]. Results are printed as json unless --benchmark_format is given,
+// e.g. rsid-bench --benchmark_out=matcher.json --benchmark_filter=ToArray
+
+#include "Matcher.h"
+#include "ExtendedFaceprints.h"
+#include "FaceprintsGallery.h"
+#include "RealSenseID/Faceprints.h"
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+// access to the private matcher building blocks (friend of Matcher)
+struct MatcherBenchmarkAccess
+{
+    static void MatchTwoVectors(const feature_t* T1, const feature_t* T2, match_calc_t* retprob)
+    {
+        Matcher::MatchTwoVectors(T1, T2, retprob);
+    }
+
+    static bool UpdateAverageVector(feature_t* updated_faceprints_vec, const feature_t* orig_faceprints_vec)
+    {
+        return Matcher::UpdateAverageVector(updated_faceprints_vec, orig_faceprints_vec);
+    }
+};
+} // namespace RealSenseID
+
+using namespace RealSenseID;
+
+static const int s_maxFeatureValue = 1023;
+static const unsigned s_seed = 2021;
+
+// uniform features in the valid range [-1023,1023]. unrelated random vectors score far below the thresholds, so
+// the 1:N searches scan the whole gallery (worst case).
+static Faceprints RandomFaceprints(std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> dist(-s_maxFeatureValue, s_maxFeatureValue);
+    Faceprints faceprints;
+    faceprints.numberOfDescriptors = 1;
+    for (size_t i = 0; i < FEATURES_VECTOR_ALLOC_SIZE; i++)
+    {
+        faceprints.avgDescriptor[i] = static_cast<feature_t>(dist(rng));
+        faceprints.origDescriptor[i] = faceprints.avgDescriptor[i];
+    }
+    return faceprints;
+}
+
+// same person: the given faceprints with small noise
+static Faceprints NoisyFaceprints(const Faceprints& faceprints, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> noise(-100, 100);
+    Faceprints result = faceprints;
+    for (size_t i = 0; i < FEATURES_VECTOR_ALLOC_SIZE; i++)
+    {
+        int value = faceprints.avgDescriptor[i] + noise(rng);
+        value = value > s_maxFeatureValue ? s_maxFeatureValue : (value < -s_maxFeatureValue ? -s_maxFeatureValue : value);
+        result.avgDescriptor[i] = static_cast<feature_t>(value);
+    }
+    return result;
+}
+
+static void AddToGallery(std::vector<ExtendedFaceprints>& gallery, size_t index, const Faceprints& faceprints)
+{
+    ExtendedFaceprints extended;
+    extended.faceprints = faceprints;
+    ::snprintf(extended.user_id, sizeof(extended.user_id), "user%zu", index);
+    gallery.push_back(extended);
+}
+
+static void AddToGallery(FaceprintsGallery& gallery, size_t index, const Faceprints& faceprints)
+{
+    std::string user_id = "user" + std::to_string(index);
+    gallery.Add(user_id.c_str(), faceprints);
+}
+
+// galleries are built once per size and only the last one is kept (1M users take ~1GB per container)
+template <typename Gallery>
+static const Gallery& GetGallery(size_t size)
+{
+    static std::unique_ptr<Gallery> s_gallery;
+    static size_t s_size = 0;
+    if (!s_gallery || s_size != size)
+    {
+        s_gallery.reset();
+        s_gallery.reset(new Gallery());
+        s_size = size;
+        std::mt19937 rng(s_seed);
+        for (size_t i = 0; i < size; i++)
+        {
+            AddToGallery(*s_gallery, i, RandomFaceprints(rng));
+        }
+    }
+    return *s_gallery;
+}
+
+static void BM_MatchTwoVectors(benchmark::State& state)
+{
+    std::mt19937 rng(s_seed);
+    Faceprints faceprints1 = RandomFaceprints(rng);
+    Faceprints faceprints2 = NoisyFaceprints(faceprints1, rng);
+    match_calc_t score = 0;
+    for (auto _ : state)
+    {
+        MatcherBenchmarkAccess::MatchTwoVectors(faceprints1.avgDescriptor, faceprints2.avgDescriptor, &score);
+        benchmark::DoNotOptimize(score);
+    }
+}
+BENCHMARK(BM_MatchTwoVectors);
+
+static void BM_MatchFaceprints(benchmark::State& state)
+{
+    std::mt19937 rng(s_seed);
+    Faceprints existing = RandomFaceprints(rng);
+    Faceprints probe = NoisyFaceprints(existing, rng);
+    Faceprints updated;
+    for (auto _ : state)
+    {
+        auto result = Matcher::MatchFaceprints(probe, existing, updated);
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_MatchFaceprints);
+
+template <typename Gallery>
+static void BM_MatchFaceprintsToArray(benchmark::State& state)
+{
+    const size_t size = static_cast<size_t>(state.range(0));
+    const Gallery& gallery = GetGallery<Gallery>(size);
+    std::mt19937 rng(s_seed + 1);
+    Faceprints probe = RandomFaceprints(rng);
+    Faceprints updated;
+    for (auto _ : state)
+    {
+        auto result = Matcher::MatchFaceprintsToArray(probe, gallery, updated);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(size));
+}
+BENCHMARK_TEMPLATE(BM_MatchFaceprintsToArray, std::vector<ExtendedFaceprints>)
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_MatchFaceprintsToArray, FaceprintsGallery)
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_ValidateFaceprints(benchmark::State& state)
+{
+    std::mt19937 rng(s_seed);
+    Faceprints faceprints = RandomFaceprints(rng);
+    for (auto _ : state)
+    {
+        bool is_valid = Matcher::ValidateFaceprints(faceprints);
+        benchmark::DoNotOptimize(is_valid);
+    }
+}
+BENCHMARK(BM_ValidateFaceprints);
+
+static void BM_UpdateAverageVector(benchmark::State& state)
+{
+    std::mt19937 rng(s_seed);
+    Faceprints orig = RandomFaceprints(rng);
+    Faceprints avg = NoisyFaceprints(orig, rng);
+    feature_t updated[FEATURES_VECTOR_ALLOC_SIZE];
+    for (auto _ : state)
+    {
+        // the update is in place, restart from the same vector every iteration
+        ::memcpy(updated, avg.avgDescriptor, sizeof(updated));
+        bool result = MatcherBenchmarkAccess::UpdateAverageVector(updated, orig.avgDescriptor);
+        benchmark::DoNotOptimize(result);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_UpdateAverageVector);
+
+// replay of state.range(0) authentications (one per user) into a gallery
+static void BM_UpdateGalleryBatch(benchmark::State& state)
+{
+    const size_t num_users = static_cast<size_t>(state.range(0));
+    std::mt19937 rng(s_seed);
+    FaceprintsGallery gallery;
+    std::vector<size_t> indices(num_users);
+    std::vector<Faceprints> new_faceprints_array(num_users);
+    for (size_t i = 0; i < num_users; i++)
+    {
+        Faceprints faceprints = RandomFaceprints(rng);
+        gallery.Add(std::to_string(i).c_str(), faceprints);
+        indices[i] = i;
+        new_faceprints_array[i] = NoisyFaceprints(faceprints, rng);
+    }
+    for (auto _ : state)
+    {
+        size_t num_updated = Matcher::UpdateGalleryBatch(gallery, indices, new_faceprints_array);
+        benchmark::DoNotOptimize(num_updated);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(num_users));
+}
+BENCHMARK(BM_UpdateGalleryBatch)->Arg(1000)->Arg(10000);
+
+int main(int argc, char** argv)
+{
+    // json by default, so results can be collected by dashboards
+    std::vector<char*> args(argv, argv + argc);
+    bool has_format = false;
+    for (int i = 1; i < argc; i++)
+    {
+        has_format = has_format || ::strncmp(argv[i], "--benchmark_format", 18) == 0;
+    }
+    char json_format[] = "--benchmark_format=json";
+    if (!has_format)
+    {
+        args.push_back(json_format);
+    }
+
+    int args_count = static_cast<int>(args.size());
+    benchmark::Initialize(&args_count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(args_count, args.data()))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
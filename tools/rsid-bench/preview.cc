@@ -0,0 +1,138 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Preview conversion benchmarks on random frames, per kernel (ISA) and per StreamConverter conversion:
+// YUYV to RGB of a 704x1280 frame, RAW10 unpack and rotated demosaic of a 1920x1080 frame, metadata extraction.
+// Throughput is reported as MPix/s. e.g. rsid-bench --benchmark_filter=YuyvToRgb
+// The correctness of the same conversions is checked by rsid-preview-check.
+
+#include "YuvKernels.h"
+#include "StreamConverter.h"
+#include "MatcherThreadPool.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace RealSenseID::Capture;
+using RealSenseID::Image;
+using RealSenseID::MatcherThreadPool;
+
+static const size_t s_framePixels = 704 * 1280;
+static const size_t s_rawPixels = static_cast<size_t>(RAW_WIDTH) * RAW_HEIGHT;
+
+static std::vector<unsigned char> RandomBytes(size_t size)
+{
+    std::mt19937 rng(2021);
+    std::vector<unsigned char> bytes(size);
+    for (auto& b : bytes)
+    {
+        b = static_cast<unsigned char>(rng());
+    }
+    return bytes;
+}
+
+static void SetPixelRate(benchmark::State& state, size_t pixels)
+{
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * pixels);
+    state.counters["MPix"] = benchmark::Counter(static_cast<double>(state.iterations()) * pixels / 1e6,
+                                                  benchmark::Counter::kIsRate);
+}
+// benchmark args: output layouts
+static const int s_rgb = static_cast<int>(YuvKernels::RgbLayout::Rgb);
+static const int s_rgba = static_cast<int>(YuvKernels::RgbLayout::Rgba);
+
+template <YuvKernels::yuyv_to_rgb_func Kernel>
+static void BM_YuyvToRgb(benchmark::State& state)
+{
+    const auto layout = static_cast<YuvKernels::RgbLayout>(state.range(0));
+    const auto pixel_size = YuvKernels::PixelSize(layout);
+    auto yuyv = RandomBytes(2 * s_framePixels);
+    std::vector<unsigned char> rgb(pixel_size * s_framePixels);
+    for (auto _ : state)
+    {
+        Kernel(yuyv.data(), rgb.data(), s_framePixels, layout);
+        benchmark::DoNotOptimize(rgb.data());
+    }
+    SetPixelRate(state, s_framePixels);
+}
+BENCHMARK_TEMPLATE(BM_YuyvToRgb, YuvKernels::YuyvToRgbScalar)->Arg(s_rgb)->Arg(s_rgba);
+#ifdef RSID_CAPTURE_X86_KERNELS
+BENCHMARK_TEMPLATE(BM_YuyvToRgb, YuvKernels::YuyvToRgbSse2)->Arg(s_rgb)->Arg(s_rgba);
+BENCHMARK_TEMPLATE(BM_YuyvToRgb, YuvKernels::YuyvToRgbAvx2)->Arg(s_rgb)->Arg(s_rgba);
+#endif // RSID_CAPTURE_X86_KERNELS
+#ifdef RSID_CAPTURE_NEON_KERNELS
+BENCHMARK_TEMPLATE(BM_YuyvToRgb, YuvKernels::YuyvToRgbNeon)->Arg(s_rgb)->Arg(s_rgba);
+#endif // RSID_CAPTURE_NEON_KERNELS
+
+template <YuvKernels::raw10_to_raw8_func Kernel>
+static void BM_Raw10ToRaw8(benchmark::State& state)
+{
+    auto raw10 = RandomBytes(s_rawPixels / 4 * 5);
+    std::vector<unsigned char> raw8(s_rawPixels + 16); // simd kernels may write up to 16 bytes past the end
+    for (auto _ : state)
+    {
+        Kernel(raw10.data(), raw8.data(), s_rawPixels);
+        benchmark::DoNotOptimize(raw8.data());
+    }
+    SetPixelRate(state, s_rawPixels);
+}
+BENCHMARK_TEMPLATE(BM_Raw10ToRaw8, YuvKernels::Raw10ToRaw8Scalar);
+#ifdef RSID_CAPTURE_X86_KERNELS
+BENCHMARK_TEMPLATE(BM_Raw10ToRaw8, YuvKernels::Raw10ToRaw8Ssse3);
+#endif // RSID_CAPTURE_X86_KERNELS
+#if defined(RSID_CAPTURE_NEON_KERNELS) && defined(__aarch64__)
+BENCHMARK_TEMPLATE(BM_Raw10ToRaw8, YuvKernels::Raw10ToRaw8Neon);
+#endif
+
+// StreamConverter's VGA conversion with the kernel of the running cpu
+static void BM_Yuv2Rgb(benchmark::State& state)
+{
+    const auto layout = static_cast<YuvKernels::RgbLayout>(state.range(0));
+    auto yuyv = RandomBytes(2 * s_framePixels);
+    std::vector<unsigned char> rgb(YuvKernels::PixelSize(layout) * s_framePixels);
+    Image image;
+    image.buffer = rgb.data();
+    image.size = static_cast<unsigned int>(rgb.size());
+    for (auto _ : state)
+    {
+        Yuv2Rgb(&image, yuyv.data(), static_cast<unsigned int>(yuyv.size()), layout);
+        benchmark::DoNotOptimize(rgb.data());
+    }
+    SetPixelRate(state, s_framePixels);
+}
+BENCHMARK(BM_Yuv2Rgb)->Arg(s_rgb)->Arg(s_rgba);
+
+// StreamConverter's FHD_Rect conversion, arg: threads (0 converts on the calling thread)
+static void BM_RotatedRaw2Rgb(benchmark::State& state)
+{
+    auto raw10 = RandomBytes(s_rawPixels / 4 * 5);
+    std::vector<unsigned char> rgb(s_rawPixels * VGA_PIXEL_SIZE);
+    std::unique_ptr<MatcherThreadPool> pool;
+    if (state.range(0) > 0)
+    {
+        pool.reset(new MatcherThreadPool(static_cast<unsigned int>(state.range(0))));
+    }
+    for (auto _ : state)
+    {
+        Image image;
+        image.buffer = rgb.data();
+        image.width = RAW_WIDTH;
+        image.height = RAW_HEIGHT;
+        RotatedRaw2Rgb(&image, raw10.data(), static_cast<unsigned int>(raw10.size()), pool.get());
+        benchmark::DoNotOptimize(rgb.data());
+    }
+    SetPixelRate(state, s_rawPixels);
+}
+BENCHMARK(BM_RotatedRaw2Rgb)->Arg(0)->Arg(2)->Arg(4)->UseRealTime();
+
+static void BM_ExtractMetadata(benchmark::State& state)
+{
+    auto header = RandomBytes(64);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ExtractMetadata(header.data(), static_cast<unsigned int>(header.size())));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_ExtractMetadata);
@@ -0,0 +1,282 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Protocol stack benchmarks without a device, over an in-process LoopbackSerial pair. Each benchmark argument is the
+// data size of the packets (payload of 64, 544 and 1952 bytes), the newest protocol version is used (compact crc,
+// binary mode for the session). Items are packets, so the time per packet is the time per item.
+//   BM_PacketTransfer        - PacketSender::Send() on one end and PacketSender::Recv() on the other
+//   BM_NonSecureRoundTrip    - NonSecureSession::SendPacket() of a request and RecvPacket() of its reply
+//   BM_SecureRoundTrip       - same for SecureSession (RSID_SECURE)
+// The replies are sent by the device end outside the timed loop, so the round trips measure the host side only.
+// The host cpu time per packet by component, to compare with the above:
+//   BM_PacketCrc             - crc of the sent bytes, done by both Send() and Recv()
+//   BM_PacketCopy            - the bytes through the loopback connection (gather write and read, no framing)
+//   BM_PacketAes, BM_PacketHmac (crypto.cc) - the session's packet crypto one pass at a time
+// e.g. rsid-bench --benchmark_filter="Packet|RoundTrip"
+
+#include "LoopbackSerial.h"
+#include "NonSecureSession.h"
+#include "PacketSender.h"
+#include "SerialPacket.h"
+#include "Crc16.h"
+#ifdef RSID_SECURE
+#include "SecureSession.h"
+#include "MbedtlsWrapper.h"
+#endif
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace RealSenseID::PacketManager;
+
+// replies sent ahead per pause of the timed loop
+static const int s_replyBatch = 1024;
+
+static void PacketSizes(benchmark::internal::Benchmark* bench)
+{
+    bench->Arg(32)->Arg(512)->Arg(static_cast<int>(sizeof(DataMessage::data)));
+}
+
+static std::vector<char> PacketData(size_t size)
+{
+    std::vector<char> data(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = static_cast<char>(i * 7 + 1);
+    }
+    return data;
+}
+
+static void SetPacketsProcessed(benchmark::State& state, int64_t packets_per_iteration, const SerialPacket& packet)
+{
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * packets_per_iteration);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * packets_per_iteration *
+                            packet.header.payload_size);
+}
+
+// device end of a loopback connection: answers the session start and sends the replies of the requests ahead
+class EchoDevice
+{
+public:
+    EchoDevice() : _serial {LoopbackSerial::CreatePair()}, _sender {_serial.second.get()}
+    {
+    }
+
+    SerialConnection* Host()
+    {
+        return _serial.first.get();
+    }
+
+    // start the host's session, answering on a thread while start blocks for the answer
+    template <typename Session>
+    bool StartSession(Session& session)
+    {
+        bool answered = false;
+        std::thread device {[this, &answered] { answered = AnswerStart(); }};
+        auto status = session.Start(Host());
+        device.join();
+        return answered && status == SerialStatus::Ok;
+    }
+
+    // drop the requests received so far and send the next count replies of data_size bytes
+    bool SendReplies(int count, const std::vector<char>& data)
+    {
+        char scratch[4096];
+        size_t n_bytes = 0;
+        while (_serial.second->RecvAvailable(scratch, sizeof(scratch), n_bytes, timeout_t {0}) == SerialStatus::Ok &&
+               n_bytes > 0)
+        {
+        }
+
+        DataPacket reply {MsgId::Ping};
+        for (int i = 0; i < count; i++)
+        {
+            reply.Reset(MsgId::Ping, data.data(), data.size());
+            reply.header.protocol_ver = MaxProtocolVer;
+            reply.payload.sequence_number = ++_last_sent_seq;
+#ifdef RSID_SECURE
+            if (_secure)
+            {
+                ::memcpy(reply.header.iv, &_last_sent_seq, sizeof(_last_sent_seq));
+                _crypto.EncryptAndHmac(reply.header.iv, (const unsigned char*)&reply.header, sizeof(reply.header),
+                                       (unsigned char*)&reply.payload, reply.header.payload_size,
+                                       (unsigned char*)reply.hmac);
+            }
+#endif
+            if (_sender.Send(reply) != SerialStatus::Ok)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    LoopbackSerial::Pair _serial;
+    PacketSender _sender;
+    uint32_t _last_sent_seq = 0;
+#ifdef RSID_SECURE
+    MbedtlsWrapper _crypto;
+    bool _secure = false;
+#endif
+
+    bool AnswerStart()
+    {
+        DataPacket packet {MsgId::None};
+        if (_sender.Recv(packet) != SerialStatus::Ok)
+        {
+            return false;
+        }
+        if (packet.header.id == MsgId::StartSession)
+        {
+            DataPacket answer {MsgId::StartSession};
+            answer.header.protocol_ver = MaxProtocolVer;
+            return _sender.Send(answer) == SerialStatus::Ok;
+        }
+#ifdef RSID_SECURE
+        if (packet.header.id == MsgId::HostEcdhKey)
+        {
+            auto sign = [](const unsigned char*, const unsigned int, unsigned char* out_sig) {
+                ::memset(out_sig, 0x5a, ECC_P256_SIG_SIZE_BYTES);
+                return true;
+            };
+            auto verify = [](const unsigned char*, const unsigned int, const unsigned char*, const unsigned int) {
+                return true;
+            };
+            unsigned char* key = _crypto.GetSignedEcdhPubkey(sign);
+            if (key == nullptr ||
+                !_crypto.VerifyEcdhSignedKey(reinterpret_cast<const unsigned char*>(packet.Data().data), verify))
+            {
+                return false;
+            }
+            DataPacket answer {MsgId::DeviceEcdhKey, reinterpret_cast<char*>(key), _crypto.GetSignedEcdhPubkeySize()};
+            answer.header.protocol_ver = MaxProtocolVer;
+            _secure = true;
+            return _sender.Send(answer) == SerialStatus::Ok;
+        }
+#endif
+        return false;
+    }
+};
+
+static void BM_PacketTransfer(benchmark::State& state)
+{
+    auto serial = LoopbackSerial::CreatePair();
+    PacketSender host {serial.first.get()}, device {serial.second.get()};
+    auto data = PacketData(static_cast<size_t>(state.range(0)));
+    DataPacket packet {MsgId::Ping, data.data(), data.size()};
+    packet.header.protocol_ver = MaxProtocolVer;
+    DataPacket received {MsgId::None};
+    for (auto _ : state)
+    {
+        if (host.Send(packet) != SerialStatus::Ok || device.Recv(received) != SerialStatus::Ok)
+        {
+            state.SkipWithError("transfer failed");
+            break;
+        }
+        benchmark::DoNotOptimize(received.payload);
+    }
+    SetPacketsProcessed(state, 1, packet);
+}
+BENCHMARK(BM_PacketTransfer)->Apply(PacketSizes);
+
+template <typename Session>
+static void SessionRoundTrip(benchmark::State& state, Session& session, EchoDevice& device)
+{
+    if (!device.StartSession(session))
+    {
+        state.SkipWithError("session start failed");
+        return;
+    }
+    auto data = PacketData(static_cast<size_t>(state.range(0)));
+    DataPacket request {MsgId::Ping, data.data(), data.size()};
+    DataPacket reply {MsgId::None};
+    int replies = 0;
+    for (auto _ : state)
+    {
+        if (replies == 0)
+        {
+            state.PauseTiming();
+            replies = device.SendReplies(s_replyBatch, data) ? s_replyBatch : 0;
+            state.ResumeTiming();
+        }
+        // encrypted in place by the secure session, the data needs no refill to measure the same work
+        if (replies == 0 || session.SendPacket(request) != SerialStatus::Ok ||
+            session.RecvPacket(reply) != SerialStatus::Ok)
+        {
+            state.SkipWithError("round trip failed");
+            break;
+        }
+        replies--;
+        benchmark::DoNotOptimize(reply.payload);
+    }
+    SetPacketsProcessed(state, 2, request);
+}
+
+static void BM_NonSecureRoundTrip(benchmark::State& state)
+{
+    EchoDevice device;
+    NonSecureSession session;
+    SessionRoundTrip(state, session, device);
+}
+BENCHMARK(BM_NonSecureRoundTrip)->Apply(PacketSizes);
+
+#ifdef RSID_SECURE
+static void BM_SecureRoundTrip(benchmark::State& state)
+{
+    EchoDevice device;
+    SecureSession session {[](const unsigned char*, const unsigned int, unsigned char* out_sig) {
+                               ::memset(out_sig, 0x5a, ECC_P256_SIG_SIZE_BYTES);
+                               return true;
+                           },
+                           [](const unsigned char*, const unsigned int, const unsigned char*, const unsigned int) {
+                               return true;
+                           }};
+    SessionRoundTrip(state, session, device);
+}
+BENCHMARK(BM_SecureRoundTrip)->Apply(PacketSizes);
+#endif // RSID_SECURE
+
+static void BM_PacketCrc(benchmark::State& state)
+{
+    auto data = PacketData(static_cast<size_t>(state.range(0)));
+    DataPacket packet {MsgId::Ping, data.data(), data.size()};
+    // the crc of the compact crc protocol versions (as PacketSender::CalcCrc())
+    for (auto _ : state)
+    {
+        auto crc = Crc16(reinterpret_cast<const char*>(&packet), sizeof(packet.header) + packet.header.payload_size);
+        crc = Crc16(crc, packet.hmac, sizeof(packet.hmac));
+        benchmark::DoNotOptimize(crc);
+    }
+    SetPacketsProcessed(state, 1, packet);
+}
+BENCHMARK(BM_PacketCrc)->Apply(PacketSizes);
+
+static void BM_PacketCopy(benchmark::State& state)
+{
+    auto serial = LoopbackSerial::CreatePair();
+    auto data = PacketData(static_cast<size_t>(state.range(0)));
+    DataPacket packet {MsgId::Ping, data.data(), data.size()};
+    DataPacket received {MsgId::None};
+    const size_t packet_size = sizeof(packet.header) + packet.header.payload_size;
+    // the segments of PacketSender's gather write, received as its Recv() does
+    const SendBuffer buffers[] = {{reinterpret_cast<const char*>(&packet), packet_size},
+                                  {packet.hmac, sizeof(packet.hmac)},
+                                  {reinterpret_cast<const char*>(&packet.crc), sizeof(packet.crc)}};
+    for (auto _ : state)
+    {
+        auto* target = reinterpret_cast<char*>(&received);
+        if (serial.first->SendBytesv(buffers, 3) != SerialStatus::Ok ||
+            serial.second->RecvBytes(target, packet_size) != SerialStatus::Ok ||
+            serial.second->RecvBytes(received.hmac, sizeof(received.hmac)) != SerialStatus::Ok ||
+            serial.second->RecvBytes(reinterpret_cast<char*>(&received.crc), sizeof(received.crc)) != SerialStatus::Ok)
+        {
+            state.SkipWithError("copy failed");
+            break;
+        }
+        benchmark::DoNotOptimize(received.payload);
+    }
+    SetPacketsProcessed(state, 1, packet);
+}
+BENCHMARK(BM_PacketCopy)->Apply(PacketSizes);
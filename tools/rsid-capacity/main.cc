@@ -0,0 +1,646 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// End-to-end capacity benchmark of host mode authentication: N devices authenticating concurrently against one host
+// gallery of M users, for the sustainable authentications per second of a server.
+// Usage: rsid-capacity [options]
+//   --devices <list>          comma separated numbers of devices of the cases (default 1,2,4,8)
+//   --users <list>            comma separated gallery sizes of the cases (default 1000,10000,100000)
+//   --seconds <n>             measured duration of each case (default 10)
+//   --warmup-seconds <n>      unmeasured run before each case (default 1)
+//   --device-users <n>        users of each emulated device (default 100). the devices recognize them in turn, and
+//                             they are the first users of the gallery, so each authentication is a hit. 0 makes each
+//                             authentication a miss (a search of the whole gallery)
+//   --flow-latency-ms <n>     capture and extraction time of the emulated devices per authentication (default 0, host
+//                             bound: the devices answer as fast as the host asks)
+//   --ports <list>            comma separated ports of the devices instead of emulated ones (e.g. replay-fast://<file>
+//                             or the tcp:// ports of rsid-emulator), at least as many as the most devices of the cases
+//   --executor-threads <n>    executor threads of the async operations (default the most devices of the cases)
+//   --format csv|json         report format (default csv)
+//   --output <file>           write the report to the file instead of stdout
+//
+// Each device runs the async extraction pipeline back to back (FaceAuthenticator::ExtractFaceprintsForAuthAsync(),
+// all driven from the main thread), and each extracted query is matched against the shared gallery on the executor
+// thread that received it. A case reports the sustained authentications per second, the latency percentiles from the
+// request to the match result, the mean match time and the process CPU time per authentication. The emulated devices
+// run in the process, their CPU time is included (use --ports with rsid-emulator to leave it out).
+// Non-secure builds only.
+//
+// Returns 0 if all the authentications succeeded, 1 on invalid arguments or if a device or the report failed, 2 if
+// any authentication failed.
+
+#include "RealSenseID/FaceAuthenticator.h"
+#include "RealSenseID/AsyncOperation.h"
+#include "RealSenseID/HostFaceprintsGallery.h"
+#include "RealSenseID/Logging.h"
+#include "percentile.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+using RealSenseID::Tools::percentile;
+
+struct CapacityOptions
+{
+    std::vector<unsigned int> devices = {1, 2, 4, 8};
+    std::vector<unsigned int> users = {1000, 10000, 100000};
+    unsigned int seconds = 10;
+    unsigned int warmup_seconds = 1;
+    unsigned int device_users = 100;
+    unsigned int flow_latency_ms = 0;
+    std::vector<std::string> ports;
+    unsigned int executor_threads = 0;
+    bool json = false;
+    std::string output_path;
+
+    unsigned int MaxDevices() const
+    {
+        return *std::max_element(devices.begin(), devices.end());
+    }
+};
+
+struct CaseResult
+{
+    unsigned int devices = 0;
+    size_t users = 0;
+    std::vector<double> latencies_ms; // of the measured authentications
+    unsigned int errors = 0;          // status other than Ok
+    unsigned int misses = 0;          // extraction failed or not matched
+    double elapsed_ms = 0;
+    double match_ms = 0; // mean gallery search per authentication
+    double cpu_ms = 0;   // process CPU time of the measured period
+};
+
+void print_usage()
+{
+    std::cout << "Usage: rsid-capacity [--devices <list>] [--users <list>] [--seconds <n>] [--warmup-seconds <n>]"
+                 " [--device-users <n>] [--flow-latency-ms <n>] [--ports <list>] [--executor-threads <n>]"
+                 " [--format csv|json] [--output <file>]"
+              << std::endl;
+}
+
+bool parse_number(const char* token, unsigned int& value)
+{
+    char* end = nullptr;
+    auto parsed = std::strtoul(token, &end, 10);
+    if (*token == '\0' || *end != '\0')
+    {
+        return false;
+    }
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream tokens {list};
+    std::string item;
+    while (std::getline(tokens, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool parse_numbers(const char* list, std::vector<unsigned int>& numbers)
+{
+    numbers.clear();
+    for (const auto& item : split_list(list))
+    {
+        unsigned int number = 0;
+        if (!parse_number(item.c_str(), number) || number == 0)
+        {
+            return false;
+        }
+        numbers.push_back(number);
+    }
+    return !numbers.empty();
+}
+
+bool options_from_argv(int argc, char* argv[], CapacityOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const char* name = argv[i];
+        const char* value = argv[++i];
+        unsigned int number = 0;
+        if (::strcmp(name, "--devices") == 0)
+        {
+            if (!parse_numbers(value, options.devices))
+            {
+                return false;
+            }
+        }
+        else if (::strcmp(name, "--users") == 0)
+        {
+            if (!parse_numbers(value, options.users))
+            {
+                return false;
+            }
+        }
+        else if (::strcmp(name, "--seconds") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.seconds = number;
+        }
+        else if (::strcmp(name, "--warmup-seconds") == 0 && parse_number(value, number))
+        {
+            options.warmup_seconds = number;
+        }
+        else if (::strcmp(name, "--device-users") == 0 && parse_number(value, number))
+        {
+            options.device_users = number;
+        }
+        else if (::strcmp(name, "--flow-latency-ms") == 0 && parse_number(value, number))
+        {
+            options.flow_latency_ms = number;
+        }
+        else if (::strcmp(name, "--ports") == 0)
+        {
+            options.ports = split_list(value);
+        }
+        else if (::strcmp(name, "--executor-threads") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.executor_threads = number;
+        }
+        else if (::strcmp(name, "--format") == 0 && (::strcmp(value, "csv") == 0 || ::strcmp(value, "json") == 0))
+        {
+            options.json = ::strcmp(value, "json") == 0;
+        }
+        else if (::strcmp(name, "--output") == 0)
+        {
+            options.output_path = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (!options.ports.empty() && options.ports.size() < options.MaxDevices())
+    {
+        std::cerr << "Fewer ports than devices" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+double elapsed_ms_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+// user and kernel CPU time of the process
+double process_cpu_ms()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!::GetProcessTimes(::GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        return 0;
+    }
+    auto to_100ns = [](const FILETIME& time) {
+        return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return (to_100ns(kernel) + to_100ns(user)) / 10000.0;
+#else
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+    auto to_ms = [](const struct timeval& time) { return time.tv_sec * 1000.0 + time.tv_usec / 1000.0; };
+    return to_ms(usage.ru_utime) + to_ms(usage.ru_stime);
+#endif
+}
+
+RealSenseID::Faceprints synthetic_faceprints(std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> dist(-1023, 1023);
+    RealSenseID::Faceprints faceprints;
+    faceprints.numberOfDescriptors = 1;
+    for (size_t i = 0; i < RealSenseID::FEATURES_VECTOR_ALLOC_SIZE; i++)
+    {
+        faceprints.avgDescriptor[i] = static_cast<RealSenseID::feature_t>(dist(rng));
+        faceprints.origDescriptor[i] = faceprints.avgDescriptor[i];
+    }
+    return faceprints;
+}
+
+class UserIdsCollector : public RealSenseID::UserIdsCallback
+{
+public:
+    std::vector<std::string> user_ids;
+
+    void OnUserId(const char* user_id) override
+    {
+        user_ids.emplace_back(user_id);
+    }
+};
+
+// the device's pending authentication, completed on an executor thread. The operations of a device run one at a
+// time, the fields are only touched by the main thread between them.
+class Device : public RealSenseID::AuthFaceprintsExtractionCallback
+{
+public:
+    explicit Device(const RealSenseID::HostFaceprintsGallery& gallery) : _gallery {gallery}
+    {
+    }
+
+    RealSenseID::FaceAuthenticator authenticator;
+
+    clock_type::time_point start;
+    bool measured = false;       // started in the measured period of the case
+    clock_type::time_point end;  // of the measured period
+    std::vector<double> latencies_ms;
+    unsigned int errors = 0;
+    unsigned int misses = 0;
+    double match_ms = 0;
+
+    void OnResult(const RealSenseID::AuthenticateStatus, const RealSenseID::Faceprints*) override
+    {
+    }
+
+    void OnHint(const RealSenseID::AuthenticateStatus) override
+    {
+    }
+
+    void OnQueryResult(const RealSenseID::AuthenticateStatus status, const RealSenseID::QueryFaceprints* query) override
+    {
+        _matched = false;
+        if (status != RealSenseID::AuthenticateStatus::Success || query == nullptr)
+        {
+            return;
+        }
+        auto match_start = clock_type::now();
+        RealSenseID::Faceprints updated;
+        _matched = _gallery.Match(*query, updated).success;
+        if (measured)
+        {
+            match_ms += elapsed_ms_since(match_start);
+        }
+    }
+
+    void Completed(RealSenseID::Status status)
+    {
+        if (!measured || clock_type::now() > end)
+        {
+            return;
+        }
+        latencies_ms.push_back(elapsed_ms_since(start));
+        if (status != RealSenseID::Status::Ok)
+        {
+            errors++;
+        }
+        else if (!_matched)
+        {
+            misses++;
+        }
+    }
+
+private:
+    const RealSenseID::HostFaceprintsGallery& _gallery;
+    bool _matched = false;
+};
+
+// completions of the devices' operations, restarted by the main thread
+class CompletionQueue
+{
+public:
+    void Push(size_t device)
+    {
+        {
+            std::lock_guard<std::mutex> lock {_mutex};
+            _completed.push_back(device);
+        }
+        _cv.notify_one();
+    }
+
+    // false on timeout
+    bool Pop(size_t& device, clock_type::time_point deadline)
+    {
+        std::unique_lock<std::mutex> lock {_mutex};
+        if (!_cv.wait_until(lock, deadline, [this] { return !_completed.empty(); }))
+        {
+            return false;
+        }
+        device = _completed.front();
+        _completed.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<size_t> _completed;
+};
+
+void start_authentication(std::vector<std::unique_ptr<Device>>& devices, size_t index, CompletionQueue& queue,
+                          clock_type::time_point measure_start)
+{
+    auto& device = *devices[index];
+    device.start = clock_type::now();
+    device.measured = device.start >= measure_start;
+    device.authenticator.ExtractFaceprintsForAuthAsync(device, [&device, index, &queue](RealSenseID::Status status) {
+        device.Completed(status);
+        queue.Push(index);
+    });
+}
+
+CaseResult run_case(std::vector<std::unique_ptr<Device>>& devices, unsigned int num_devices, size_t users,
+                    const CapacityOptions& options)
+{
+    std::cerr << "devices=" << num_devices << " users=" << users << std::endl;
+    CaseResult result;
+    result.devices = num_devices;
+    result.users = users;
+
+    auto measure_start = clock_type::now() + std::chrono::seconds(options.warmup_seconds);
+    auto measure_end = measure_start + std::chrono::seconds(options.seconds);
+    for (unsigned int i = 0; i < num_devices; i++)
+    {
+        auto& device = *devices[i];
+        device.end = measure_end;
+        device.latencies_ms.clear();
+        device.errors = 0;
+        device.misses = 0;
+        device.match_ms = 0;
+    }
+
+    CompletionQueue queue;
+    for (unsigned int i = 0; i < num_devices; i++)
+    {
+        start_authentication(devices, i, queue, measure_start);
+    }
+
+    // restart each device as it completes, until the end of the case. wakes up at the start and the end of the
+    // measured period for the CPU time
+    double cpu_start = 0;
+    bool cpu_started = false;
+    bool cpu_done = false;
+    unsigned int in_flight = num_devices;
+    while (in_flight > 0)
+    {
+        auto now = clock_type::now();
+        if (!cpu_started && now >= measure_start)
+        {
+            cpu_start = process_cpu_ms();
+            cpu_started = true;
+        }
+        if (cpu_started && !cpu_done && now >= measure_end)
+        {
+            result.cpu_ms = process_cpu_ms() - cpu_start;
+            cpu_done = true;
+        }
+        auto deadline = !cpu_started ? measure_start : !cpu_done ? measure_end : now + std::chrono::seconds(60);
+        size_t index = 0;
+        if (!queue.Pop(index, deadline))
+        {
+            continue;
+        }
+        if (clock_type::now() < measure_end)
+        {
+            start_authentication(devices, index, queue, measure_start);
+            continue;
+        }
+        in_flight--;
+    }
+    if (!cpu_done)
+    {
+        result.cpu_ms = process_cpu_ms() - cpu_start;
+    }
+
+    result.elapsed_ms = options.seconds * 1000.0;
+    for (unsigned int i = 0; i < num_devices; i++)
+    {
+        auto& device = *devices[i];
+        result.latencies_ms.insert(result.latencies_ms.end(), device.latencies_ms.begin(), device.latencies_ms.end());
+        result.errors += device.errors;
+        result.misses += device.misses;
+        result.match_ms += device.match_ms;
+    }
+    if (!result.latencies_ms.empty())
+    {
+        result.match_ms /= result.latencies_ms.size();
+    }
+    return result;
+}
+
+// the users of the device (the emulated devices all have the same), with their faceprints
+bool device_users(RealSenseID::FaceAuthenticator& authenticator, std::vector<std::string>& user_ids,
+                  std::vector<RealSenseID::Faceprints>& faceprints)
+{
+    UserIdsCollector collector;
+    if (authenticator.QueryUserIds(collector, true) != RealSenseID::Status::Ok)
+    {
+        return false;
+    }
+    user_ids = collector.user_ids;
+    faceprints.resize(user_ids.size());
+    for (size_t i = 0; i < user_ids.size(); i++)
+    {
+        if (authenticator.GetUserFeatures(user_ids[i].c_str(), faceprints[i]) != RealSenseID::Status::Ok)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// fill the gallery up to size: the devices' users first, then synthetic users never recognized
+void grow_gallery(RealSenseID::HostFaceprintsGallery& gallery, size_t size, const std::vector<std::string>& user_ids,
+                  const std::vector<RealSenseID::Faceprints>& faceprints, std::mt19937& rng)
+{
+    gallery.Reserve(size);
+    while (gallery.Size() < size)
+    {
+        auto index = gallery.Size();
+        if (index < user_ids.size())
+        {
+            gallery.Add(user_ids[index].c_str(), faceprints[index]);
+        }
+        else
+        {
+            auto user_id = "rsid-capacity-" + std::to_string(index);
+            gallery.Add(user_id.c_str(), synthetic_faceprints(rng));
+        }
+    }
+}
+
+struct ReportRow
+{
+    const CaseResult* result = nullptr;
+    double throughput = 0; // authentications per second
+    double p50_ms = 0;
+    double p99_ms = 0;
+    double p999_ms = 0;
+    double max_ms = 0;
+    double cpu_ms_per_auth = 0;
+};
+
+ReportRow make_row(const CaseResult& result)
+{
+    ReportRow row;
+    row.result = &result;
+    if (result.latencies_ms.empty())
+    {
+        return row;
+    }
+    auto sorted = result.latencies_ms;
+    std::sort(sorted.begin(), sorted.end());
+    row.throughput = sorted.size() * 1000.0 / result.elapsed_ms;
+    row.p50_ms = percentile(sorted, 50);
+    row.p99_ms = percentile(sorted, 99);
+    row.p999_ms = percentile(sorted, 99.9);
+    row.max_ms = sorted.back();
+    row.cpu_ms_per_auth = result.cpu_ms / sorted.size();
+    return row;
+}
+
+void write_csv(std::ostream& out, const std::vector<ReportRow>& rows)
+{
+    out << "devices,users,count,errors,misses,throughput_aps,p50_ms,p99_ms,p999_ms,max_ms,match_ms,cpu_ms_per_auth\n";
+    for (const auto& row : rows)
+    {
+        const auto& result = *row.result;
+        out << result.devices << ',' << result.users << ',' << result.latencies_ms.size() << ',' << result.errors
+            << ',' << result.misses << ',' << row.throughput << ',' << row.p50_ms << ',' << row.p99_ms << ','
+            << row.p999_ms << ',' << row.max_ms << ',' << result.match_ms << ',' << row.cpu_ms_per_auth << '\n';
+    }
+}
+
+void write_json(std::ostream& out, const std::vector<ReportRow>& rows, const CapacityOptions& options)
+{
+    out << "{\n  \"seconds\": " << options.seconds << ",\n  \"device_users\": " << options.device_users
+        << ",\n  \"flow_latency_ms\": " << options.flow_latency_ms << ",\n  \"emulated\": "
+        << (options.ports.empty() ? "true" : "false") << ",\n  \"cases\": [";
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const auto& row = rows[i];
+        const auto& result = *row.result;
+        out << (i == 0 ? "\n" : ",\n") << "    {\"devices\": " << result.devices << ", \"users\": " << result.users
+            << ", \"count\": " << result.latencies_ms.size() << ", \"errors\": " << result.errors
+            << ", \"misses\": " << result.misses << ", \"throughput_aps\": " << row.throughput
+            << ", \"p50_ms\": " << row.p50_ms << ", \"p99_ms\": " << row.p99_ms << ", \"p999_ms\": " << row.p999_ms
+            << ", \"max_ms\": " << row.max_ms << ", \"match_ms\": " << result.match_ms
+            << ", \"cpu_ms_per_auth\": " << row.cpu_ms_per_auth << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    CapacityOptions options;
+    if (!options_from_argv(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+
+    // keep the report on stdout clean, library warnings and errors go to stderr
+    RealSenseID::SetLogCallback([](RealSenseID::LogLevel, const char* msg) { std::cerr << msg << std::endl; },
+                                RealSenseID::LogLevel::Warning, true);
+
+    const unsigned int max_devices = options.MaxDevices();
+    RealSenseID::AsyncOperation::SetExecutorThreads(options.executor_threads > 0 ? options.executor_threads
+                                                                                 : max_devices);
+
+    RealSenseID::HostFaceprintsGallery gallery;
+    std::vector<std::unique_ptr<Device>> devices;
+    for (unsigned int i = 0; i < max_devices; i++)
+    {
+        std::string port = !options.ports.empty() ? options.ports[i]
+                                                  : "emulator://rsid-capacity-" + std::to_string(i) +
+                                                        "?users=" + std::to_string(options.device_users) +
+                                                        "&max-users=" + std::to_string(options.device_users) +
+                                                        "&flow-latency-ms=" + std::to_string(options.flow_latency_ms);
+        devices.emplace_back(new Device {gallery});
+        RealSenseID::SerialConfig config {port.c_str()};
+        auto status = devices.back()->authenticator.Connect(config);
+        if (status != RealSenseID::Status::Ok)
+        {
+            std::cerr << "Failed connecting to port " << port << " status:" << status << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::string> user_ids;
+    std::vector<RealSenseID::Faceprints> faceprints;
+    if (!device_users(devices.front()->authenticator, user_ids, faceprints))
+    {
+        std::cerr << "Failed reading the users of the device" << std::endl;
+        return 1;
+    }
+
+    // the gallery only grows, from the smallest size to the largest
+    auto sizes = options.users;
+    std::sort(sizes.begin(), sizes.end());
+    std::mt19937 rng {2021};
+    std::vector<CaseResult> results;
+    for (auto size : sizes)
+    {
+        grow_gallery(gallery, size, user_ids, faceprints, rng);
+        for (auto num_devices : options.devices)
+        {
+            results.push_back(run_case(devices, num_devices, size, options));
+        }
+    }
+
+    std::vector<ReportRow> rows;
+    unsigned int all_errors = 0;
+    for (const auto& result : results)
+    {
+        rows.push_back(make_row(result));
+        all_errors += result.errors;
+    }
+
+    std::ofstream file;
+    if (!options.output_path.empty())
+    {
+        file.open(options.output_path);
+        if (!file)
+        {
+            std::cerr << "Failed opening report " << options.output_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.output_path.empty() ? std::cout : file;
+    if (options.json)
+    {
+        write_json(out, rows, options);
+    }
+    else
+    {
+        write_csv(out, rows);
+    }
+    return all_errors > 0 ? 2 : 0;
+}
@@ -0,0 +1,457 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "batch_mode.h"
+#include "percentile.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+using RealSenseID::Tools::percentile;
+
+// latencies and outcome of an operation type
+struct OpStats
+{
+    std::string name;
+    std::vector<double> latencies_ms;
+    unsigned int errors = 0;   // status other than Ok
+    unsigned int failures = 0; // completed with an unsuccessful result (e.g. no face, forbidden)
+    double busy_ms = 0;
+};
+
+class BatchAuthClbk : public RealSenseID::AuthenticationCallback
+{
+public:
+    RealSenseID::AuthenticateStatus result = RealSenseID::AuthenticateStatus::Failure;
+
+    void OnResult(const RealSenseID::AuthenticateStatus status, const char*) override
+    {
+        result = status;
+    }
+
+    void OnHint(const RealSenseID::AuthenticateStatus) override
+    {
+    }
+};
+
+class BatchEnrollClbk : public RealSenseID::EnrollmentCallback
+{
+public:
+    RealSenseID::EnrollStatus result = RealSenseID::EnrollStatus::Failure;
+
+    void OnResult(const RealSenseID::EnrollStatus status) override
+    {
+        result = status;
+    }
+
+    void OnProgress(const RealSenseID::FacePose) override
+    {
+    }
+
+    void OnHint(const RealSenseID::EnrollStatus) override
+    {
+    }
+};
+
+class BatchExtractClbk : public RealSenseID::AuthFaceprintsExtractionCallback
+{
+public:
+    RealSenseID::AuthenticateStatus result = RealSenseID::AuthenticateStatus::Failure;
+
+    void OnResult(const RealSenseID::AuthenticateStatus status, const RealSenseID::Faceprints*) override
+    {
+        result = status;
+    }
+
+    void OnHint(const RealSenseID::AuthenticateStatus) override
+    {
+    }
+};
+
+class BatchExportClbk : public RealSenseID::FeaturesExportCallback
+{
+public:
+    void OnUserFeatures(const char*, const RealSenseID::Faceprints&) override
+    {
+    }
+};
+
+// operations of a command which take a count and no user id
+bool is_counted_op(const std::string& name)
+{
+    return name == "authenticate" || name == "detect-spoof" || name == "extract-auth" || name == "export-features" ||
+           name == "query-users";
+}
+
+bool parse_count(const std::string& token, unsigned int& count)
+{
+    char* end = nullptr;
+    auto value = std::strtoul(token.c_str(), &end, 10);
+    if (token.empty() || *end != '\0' || value == 0)
+    {
+        return false;
+    }
+    count = static_cast<unsigned int>(value);
+    return true;
+}
+
+bool parse_script(std::istream& input, BatchScript& commands)
+{
+    std::string line;
+    int line_number = 0;
+    while (std::getline(input, line))
+    {
+        line_number++;
+        auto comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        std::istringstream tokens {line};
+        std::vector<std::string> args;
+        std::string token;
+        while (tokens >> token)
+        {
+            args.push_back(token);
+        }
+        if (args.empty())
+        {
+            continue;
+        }
+
+        BatchCommand command;
+        command.name = args[0];
+        command.line = line_number;
+        bool valid = false;
+        if (is_counted_op(command.name) || command.name == "sleep")
+        {
+            valid = args.size() == 2 && parse_count(args[1], command.count);
+        }
+        else if (command.name == "enroll")
+        {
+            valid = (args.size() == 2 || (args.size() == 3 && parse_count(args[2], command.count)));
+        }
+        else if (command.name == "enroll-remove")
+        {
+            valid = args.size() == 3 && parse_count(args[2], command.count);
+        }
+        else if (command.name == "remove")
+        {
+            valid = args.size() == 2;
+        }
+        else if (command.name == "remove-all")
+        {
+            valid = args.size() == 1;
+        }
+
+        if (!valid)
+        {
+            std::cerr << "Invalid command at line " << line_number << ": " << line << std::endl;
+            return false;
+        }
+        bool has_user_id = command.name == "enroll" || command.name == "enroll-remove" || command.name == "remove";
+        if (has_user_id)
+        {
+            command.user_id = args[1];
+        }
+        commands.push_back(command);
+    }
+    return true;
+}
+
+class BatchRunner
+{
+public:
+    explicit BatchRunner(RealSenseID::FaceAuthenticator& authenticator) : _authenticator {authenticator}
+    {
+    }
+
+    void Run(const BatchCommand& command)
+    {
+        for (unsigned int i = 0; i < (command.name == "sleep" ? 1 : command.count); i++)
+        {
+            if (command.name == "authenticate")
+            {
+                Authenticate();
+            }
+            else if (command.name == "detect-spoof")
+            {
+                DetectSpoof();
+            }
+            else if (command.name == "enroll")
+            {
+                Enroll(command.user_id);
+            }
+            else if (command.name == "enroll-remove")
+            {
+                Enroll(command.user_id);
+                Remove(command.user_id);
+            }
+            else if (command.name == "remove")
+            {
+                Remove(command.user_id);
+            }
+            else if (command.name == "remove-all")
+            {
+                Measure("remove-all", [this] { return _authenticator.RemoveAll(); });
+            }
+            else if (command.name == "extract-auth")
+            {
+                ExtractAuth();
+            }
+            else if (command.name == "export-features")
+            {
+                BatchExportClbk callback;
+                Measure("export-features", [&] { return _authenticator.ExportAllFeatures(callback); });
+            }
+            else if (command.name == "query-users")
+            {
+                unsigned int number_of_users = 0;
+                Measure("query-users", [&] { return _authenticator.QueryNumberOfUsers(number_of_users, true); });
+            }
+            else if (command.name == "sleep")
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds {command.count});
+            }
+        }
+    }
+
+    const std::vector<OpStats>& Stats() const
+    {
+        return _stats;
+    }
+
+private:
+    RealSenseID::FaceAuthenticator& _authenticator;
+    std::vector<OpStats> _stats; // in order of first use
+
+    OpStats& StatsOf(const char* name)
+    {
+        auto it =
+            std::find_if(_stats.begin(), _stats.end(), [name](const OpStats& stats) { return stats.name == name; });
+        if (it != _stats.end())
+        {
+            return *it;
+        }
+        _stats.push_back(OpStats {});
+        _stats.back().name = name;
+        return _stats.back();
+    }
+
+    // run the operation, record its latency and status. the operation's result is checked by the caller.
+    template <typename Operation>
+    OpStats& Measure(const char* name, Operation operation, RealSenseID::Status* out_status = nullptr)
+    {
+        auto start = clock_type::now();
+        auto status = operation();
+        auto elapsed_ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+
+        auto& stats = StatsOf(name);
+        stats.latencies_ms.push_back(elapsed_ms);
+        stats.busy_ms += elapsed_ms;
+        if (status != RealSenseID::Status::Ok)
+        {
+            stats.errors++;
+        }
+        if (out_status != nullptr)
+        {
+            *out_status = status;
+        }
+        return stats;
+    }
+
+    void Authenticate()
+    {
+        BatchAuthClbk callback;
+        auto status = RealSenseID::Status::Ok;
+        auto& stats = Measure("authenticate", [&] { return _authenticator.Authenticate(callback); }, &status);
+        if (status == RealSenseID::Status::Ok && callback.result != RealSenseID::AuthenticateStatus::Success)
+        {
+            stats.failures++;
+        }
+    }
+
+    void DetectSpoof()
+    {
+        BatchAuthClbk callback;
+        auto status = RealSenseID::Status::Ok;
+        auto& stats = Measure("detect-spoof", [&] { return _authenticator.DetectSpoof(callback); }, &status);
+        if (status == RealSenseID::Status::Ok && callback.result != RealSenseID::AuthenticateStatus::Success)
+        {
+            stats.failures++;
+        }
+    }
+
+    void Enroll(const std::string& user_id)
+    {
+        BatchEnrollClbk callback;
+        auto status = RealSenseID::Status::Ok;
+        auto& stats = Measure("enroll", [&] { return _authenticator.Enroll(callback, user_id.c_str()); }, &status);
+        if (status == RealSenseID::Status::Ok && callback.result != RealSenseID::EnrollStatus::Success)
+        {
+            stats.failures++;
+        }
+    }
+
+    void Remove(const std::string& user_id)
+    {
+        Measure("remove", [&] { return _authenticator.RemoveUser(user_id.c_str()); });
+    }
+
+    void ExtractAuth()
+    {
+        BatchExtractClbk callback;
+        auto status = RealSenseID::Status::Ok;
+        auto& stats =
+            Measure("extract-auth", [&] { return _authenticator.ExtractFaceprintsForAuth(callback); }, &status);
+        if (status == RealSenseID::Status::Ok && callback.result != RealSenseID::AuthenticateStatus::Success)
+        {
+            stats.failures++;
+        }
+    }
+};
+
+struct ReportRow
+{
+    std::string name;
+    size_t count = 0;
+    unsigned int errors = 0;
+    unsigned int failures = 0;
+    double error_rate = 0;
+    double throughput = 0; // ops per second of the time spent in the operation
+    double mean_ms = 0;
+    double p50_ms = 0;
+    double p90_ms = 0;
+    double p99_ms = 0;
+    double max_ms = 0;
+};
+
+ReportRow make_row(const std::string& name, std::vector<double> latencies_ms, unsigned int errors,
+                   unsigned int failures, double elapsed_ms)
+{
+    ReportRow row;
+    row.name = name;
+    row.count = latencies_ms.size();
+    row.errors = errors;
+    row.failures = failures;
+    if (row.count == 0)
+    {
+        return row;
+    }
+
+    std::sort(latencies_ms.begin(), latencies_ms.end());
+    double total_ms = 0;
+    for (auto latency : latencies_ms)
+    {
+        total_ms += latency;
+    }
+    row.error_rate = static_cast<double>(errors + failures) / row.count;
+    row.throughput = elapsed_ms > 0 ? row.count * 1000.0 / elapsed_ms : 0;
+    row.mean_ms = total_ms / row.count;
+    row.p50_ms = percentile(latencies_ms, 50);
+    row.p90_ms = percentile(latencies_ms, 90);
+    row.p99_ms = percentile(latencies_ms, 99);
+    row.max_ms = latencies_ms.back();
+    return row;
+}
+
+void write_csv(std::ostream& out, const std::vector<ReportRow>& rows)
+{
+    out << "op,count,errors,failures,error_rate,throughput_ops,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n";
+    for (const auto& row : rows)
+    {
+        out << row.name << ',' << row.count << ',' << row.errors << ',' << row.failures << ',' << row.error_rate << ','
+            << row.throughput << ',' << row.mean_ms << ',' << row.p50_ms << ',' << row.p90_ms << ',' << row.p99_ms
+            << ',' << row.max_ms << '\n';
+    }
+}
+
+void write_json(std::ostream& out, const std::vector<ReportRow>& rows, double elapsed_ms)
+{
+    out << "{\n  \"elapsed_ms\": " << elapsed_ms << ",\n  \"ops\": [";
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const auto& row = rows[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"op\": \"" << row.name << "\", \"count\": " << row.count
+            << ", \"errors\": " << row.errors << ", \"failures\": " << row.failures
+            << ", \"error_rate\": " << row.error_rate << ", \"throughput_ops\": " << row.throughput
+            << ", \"mean_ms\": " << row.mean_ms << ", \"p50_ms\": " << row.p50_ms << ", \"p90_ms\": " << row.p90_ms
+            << ", \"p99_ms\": " << row.p99_ms << ", \"max_ms\": " << row.max_ms << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+} // namespace
+
+bool load_batch_script(const BatchOptions& options, BatchScript& commands)
+{
+    if (options.script_path == "-")
+    {
+        return parse_script(std::cin, commands);
+    }
+
+    std::ifstream script {options.script_path};
+    if (!script)
+    {
+        std::cerr << "Failed opening script " << options.script_path << std::endl;
+        return false;
+    }
+    return parse_script(script, commands);
+}
+
+int run_batch(RealSenseID::FaceAuthenticator& authenticator, const BatchScript& commands, const BatchOptions& options)
+{
+    BatchRunner runner {authenticator};
+    auto start = clock_type::now();
+    for (const auto& command : commands)
+    {
+        std::cerr << "line " << command.line << ": " << command.name << std::endl;
+        runner.Run(command);
+    }
+    auto elapsed_ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+
+    // one row per operation, then all the operations (throughput of the whole run, sleeps included)
+    std::vector<ReportRow> rows;
+    std::vector<double> all_latencies;
+    unsigned int all_errors = 0, all_failures = 0;
+    for (const auto& stats : runner.Stats())
+    {
+        rows.push_back(make_row(stats.name, stats.latencies_ms, stats.errors, stats.failures, stats.busy_ms));
+        all_latencies.insert(all_latencies.end(), stats.latencies_ms.begin(), stats.latencies_ms.end());
+        all_errors += stats.errors;
+        all_failures += stats.failures;
+    }
+    rows.push_back(make_row("all", std::move(all_latencies), all_errors, all_failures, elapsed_ms));
+
+    std::ofstream file;
+    if (!options.output_path.empty())
+    {
+        file.open(options.output_path);
+        if (!file)
+        {
+            std::cerr << "Failed opening report " << options.output_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.output_path.empty() ? std::cout : file;
+    if (options.format == BatchReportFormat::Json)
+    {
+        write_json(out, rows, elapsed_ms);
+    }
+    else
+    {
+        write_csv(out, rows);
+    }
+    return (all_errors + all_failures) > 0 ? 2 : 0;
+}
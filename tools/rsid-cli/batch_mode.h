@@ -0,0 +1,53 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Non interactive mode of rsid-cli: runs a script of operations and reports their latency percentiles, throughput and
+// error rates.
+//
+// Script - one command per line, '#' starts a comment:
+//   authenticate <count>              authenticate count times
+//   detect-spoof <count>              detect spoof count times
+//   enroll <user_id> [count]          enroll the user count times
+//   enroll-remove <user_id> <count>   enroll and remove the user count times
+//   remove <user_id>                  remove the user
+//   remove-all                        remove all the users
+//   extract-auth <count>              extract faceprints for authentication count times
+//   export-features <count>           export the features of all the users count times
+//   query-users <count>               query the number of users from the device count times
+//   sleep <ms>                        wait (not measured)
+
+#pragma once
+
+#include "RealSenseID/FaceAuthenticator.h"
+#include <string>
+#include <vector>
+
+enum class BatchReportFormat
+{
+    Csv,
+    Json
+};
+
+struct BatchOptions
+{
+    std::string script_path;   // "-" to read the script from stdin
+    std::string output_path;   // empty to write the report to stdout
+    BatchReportFormat format = BatchReportFormat::Csv;
+};
+
+struct BatchCommand
+{
+    std::string name;
+    std::string user_id;
+    unsigned int count = 1;
+    int line = 0;
+};
+
+using BatchScript = std::vector<BatchCommand>;
+
+// read and validate the script. returns false (and prints the invalid line) if it is invalid.
+bool load_batch_script(const BatchOptions& options, BatchScript& commands);
+
+// run the script on the connected authenticator and write the report.
+// returns 0 if all the operations succeeded, 1 if the report could not be written, 2 if any operation failed.
+int run_batch(RealSenseID::FaceAuthenticator& authenticator, const BatchScript& commands, const BatchOptions& options);
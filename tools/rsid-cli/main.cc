@@ -2,7 +2,7 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 
 // Command line interface to RealSenseID device.
-// Usage: rsid-cli <port> <usb/uart>.
+// Usage: rsid-cli <port> [baudrate|auto] [--batch <script> [--format csv|json] [--output <file>]].
 
 #include "RealSenseID/FaceAuthenticator.h"
 #include "RealSenseID/Preview.h"
@@ -10,7 +10,9 @@
 #include "RealSenseID/SignatureCallback.h"
 #include "RealSenseID/Version.h"
 #include "RealSenseID/Logging.h"
+#include "RealSenseID/Trace.h"
 #include "RealSenseID/Faceprints.h"
+#include "batch_mode.h"
 #include <chrono>
 #include <string>
 #include <iostream>
@@ -46,7 +48,8 @@ static bool s_advanced_mode = false;
 
 // Create FaceAuthenticator (after successfully connecting it to the device).
 // If failed to connect, exit(1)
-std::unique_ptr<RealSenseID::FaceAuthenticator> CreateAuthenticator(const RealSenseID::SerialConfig& serial_config)
+std::unique_ptr<RealSenseID::FaceAuthenticator> CreateAuthenticator(const RealSenseID::SerialConfig& serial_config,
+                                                                    std::ostream& out = std::cout)
 {
 #ifdef RSID_SECURE
     auto authenticator = std::make_unique<RealSenseID::FaceAuthenticator>(&s_signer);
@@ -56,10 +59,10 @@ std::unique_ptr<RealSenseID::FaceAuthenticator> CreateAuthenticator(const RealSe
     auto connect_status = authenticator->Connect(serial_config);
     if (connect_status != RealSenseID::Status::Ok)
     {
-        std::cout << "Failed connecting to port " << serial_config.port << " status:" << connect_status << std::endl;
+        out << "Failed connecting to port " << serial_config.port << " status:" << connect_status << std::endl;
         std::exit(1);
     }
-    std::cout << "Connected to device" << std::endl;
+    out << "Connected to device" << std::endl;
     return authenticator;
 }
 
@@ -550,9 +553,43 @@ void authenticate_faceprints(const RealSenseID::SerialConfig& serial_config)
         std::cout << "Status: " << status << std::endl << std::endl;
 }
 
+// chrome://tracing or https://ui.perfetto.dev can open the saved trace
+static const char* TRACE_FILE = "rsid_trace.json";
+
+void toggle_trace()
+{
+    if (!RealSenseID::Trace::IsRecording())
+    {
+        RealSenseID::Trace::Start();
+        std::cout << "Tracing started" << std::endl;
+        return;
+    }
+    RealSenseID::Trace::Stop();
+    if (RealSenseID::Trace::WriteChromeJson(TRACE_FILE))
+        std::cout << "Trace saved to " << TRACE_FILE << std::endl;
+    else
+        std::cout << "Failed saving trace to " << TRACE_FILE << std::endl;
+}
+
 void print_usage()
 {
-    std::cout << "Usage: rsid-cli <port>" << std::endl;
+    std::cout << "Usage: rsid-cli <port> [baudrate|auto] [--batch <script> [--format csv|json] [--output <file>]]"
+              << std::endl;
+    std::cout << "  auto - select the fastest baudrate of the link" << std::endl;
+    std::cout << "  --batch - run the script's operations (- for stdin) and report their latencies (see batch_mode.h)"
+              << std::endl;
+    std::cout << "  --format - report format (default csv)" << std::endl;
+    std::cout << "  --output - report file (default stdout)" << std::endl;
+}
+
+// select the fastest baudrate of the link, keep the default if none works
+static void tune_baudrate(RealSenseID::SerialConfig& config)
+{
+    RealSenseID::DeviceController deviceController;
+    unsigned int baudrate = config.baudrate;
+    auto status = deviceController.TuneBaudrate(config, baudrate);
+    std::cout << "Baudrate " << baudrate << " (" << status << ")" << std::endl;
+    config.baudrate = baudrate;
 }
 
 RealSenseID::SerialConfig config_from_argv(int argc, char* argv[])
@@ -564,7 +601,24 @@ RealSenseID::SerialConfig config_from_argv(int argc, char* argv[])
         std::exit(1);
     }
     config.port = argv[1];
-    
+
+    if (argc > 2 && ::strncmp(argv[2], "--", 2) != 0)
+    {
+        if (::strcmp(argv[2], "auto") == 0)
+        {
+            tune_baudrate(config);
+        }
+        else
+        {
+            auto baudrate = std::strtoul(argv[2], nullptr, 10);
+            if (baudrate == 0)
+            {
+                print_usage();
+                std::exit(1);
+            }
+            config.baudrate = static_cast<unsigned int>(baudrate);
+        }
+    }
     return config;
 }
 
@@ -595,6 +649,8 @@ void print_menu()
     print_menu_opt("'b' to save device's database before standby.");
     print_menu_opt("'v' to view additional information.");
     print_menu_opt("'x' to ping the device.");
+    print_menu_opt(RealSenseID::Trace::IsRecording() ? "'t' to stop tracing and save the trace." :
+                                                       "'t' to start tracing operations.");
     print_menu_opt("'q' to quit.");
 
     // server mode opts
@@ -727,6 +783,9 @@ void sample_loop(const RealSenseID::SerialConfig& serial_config)
             ping_device(serial_config, iters);
             break;
         }
+        case 't':
+            toggle_trace();
+            break;
         case 'q':
             is_running = false;
             break;
@@ -760,9 +819,67 @@ void sample_loop(const RealSenseID::SerialConfig& serial_config)
     }
 }
 
+// parse the batch mode options. returns false if batch mode was not requested
+bool batch_options_from_argv(int argc, char* argv[], BatchOptions& options)
+{
+    bool batch = false;
+    for (int i = 2; i < argc; i++)
+    {
+        if (::strncmp(argv[i], "--", 2) != 0)
+        {
+            continue; // baudrate
+        }
+        if (i + 1 >= argc)
+        {
+            print_usage();
+            std::exit(1);
+        }
+        if (::strcmp(argv[i], "--batch") == 0)
+        {
+            options.script_path = argv[++i];
+            batch = true;
+        }
+        else if (::strcmp(argv[i], "--output") == 0)
+        {
+            options.output_path = argv[++i];
+        }
+        else if (::strcmp(argv[i], "--format") == 0 && ::strcmp(argv[i + 1], "csv") == 0)
+        {
+            options.format = BatchReportFormat::Csv;
+            i++;
+        }
+        else if (::strcmp(argv[i], "--format") == 0 && ::strcmp(argv[i + 1], "json") == 0)
+        {
+            options.format = BatchReportFormat::Json;
+            i++;
+        }
+        else
+        {
+            print_usage();
+            std::exit(1);
+        }
+    }
+    return batch;
+}
+
 int main(int argc, char* argv[])
 {
     auto config = config_from_argv(argc, argv);
+    BatchOptions batch_options;
+    if (batch_options_from_argv(argc, argv, batch_options))
+    {
+        BatchScript script;
+        if (!load_batch_script(batch_options, script))
+        {
+            return 1;
+        }
+        // keep the report on stdout clean, library warnings and errors go to stderr
+        RealSenseID::SetLogCallback([](RealSenseID::LogLevel, const char* msg) { std::cerr << msg << std::endl; },
+                                    RealSenseID::LogLevel::Warning, true);
+        // one connection for the whole run, so the latencies are of the operations only
+        auto authenticator = CreateAuthenticator(config, std::cerr);
+        return run_batch(*authenticator, script, batch_options);
+    }
     sample_loop(config);
     return 0;
 }
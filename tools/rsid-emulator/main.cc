@@ -0,0 +1,338 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Emulated devices, to measure the host side without hardware (see src/PacketManager/DeviceEmulator.h).
+// Usage: rsid-emulator [options]
+//   --listen <port>             serve the devices on consecutive tcp ports of 127.0.0.1 from <port> (default 7301),
+//                               for hosts connecting with the "tcp://localhost:<port>" port
+//   --pty                       serve the devices on pseudo terminals instead (not on windows), their names are printed
+//   --devices <n>               number of emulated devices (default 1), each with its own users
+//   --flow-latency-ms <n>       time to detect and recognize a face in the face flows (default 0)
+//   --reply-latency-ms <n>      time to answer the other requests (default 0)
+//   --users <n>                 users enrolled on start, "user_0" to "user_<n-1>" (default 0)
+//   --max-users <n>             capacity of the user database (default 1000)
+//   --protocol <n>              newest protocol version of the emulated firmware (default the newest of the host)
+//   --corrupt-every <n>         every nth packet sent and received has a bad crc, to exercise the retransmission
+//                               (default 0, none)
+//   --faces-per-frame <n>       faces in each authenticate frame, for the multi-face extraction loop (default 1)
+//   --clock-drift-ppm <n>       the device clock stamped on the clock sync pings runs n ppm fast (default 0)
+//   --wake-latency-ms <n>       time to wake up from standby, taken by the first packet after it (default 0)
+//
+// Each device serves one host at a time. Only non-secure sessions are supported.
+// In the host's process the "emulator://<name>[?<options>]" port runs the same emulator without this tool.
+// Stops on Ctrl-C. Returns 0 on Ctrl-C, 1 on invalid arguments or if a port could not be opened.
+
+#include "DeviceEmulator.h"
+#include "TcpSerial.h"
+#include "Timer.h"
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+using RealSenseID::PacketManager::DeviceEmulator;
+using RealSenseID::PacketManager::EmulatorConfig;
+using RealSenseID::PacketManager::SerialConnection;
+using RealSenseID::PacketManager::SerialStatus;
+using RealSenseID::PacketManager::timeout_t;
+
+namespace
+{
+const unsigned short DEFAULT_TCP_PORT = 7301;
+const timeout_t POLL_TIMEOUT {100}; // max delay to notice a stop
+
+std::atomic<bool> s_stop {false};
+
+struct EmulatorOptions
+{
+    unsigned short tcp_port = DEFAULT_TCP_PORT;
+    bool pty = false;
+    unsigned int devices = 1;
+    EmulatorConfig config;
+};
+
+void print_usage()
+{
+    std::cout << "Usage: rsid-emulator [--listen <port> | --pty] [--devices <n>] [--flow-latency-ms <n>] "
+                 "[--reply-latency-ms <n>] [--users <n>] [--max-users <n>] [--protocol <n>] "
+                 "[--corrupt-every <n>] [--faces-per-frame <n>] [--clock-drift-ppm <n>] [--wake-latency-ms <n>]"
+              << std::endl;
+}
+
+bool parse_number(const char* token, unsigned int& value)
+{
+    char* end = nullptr;
+    auto parsed = std::strtoul(token, &end, 10);
+    if (*token == '\0' || *end != '\0')
+    {
+        return false;
+    }
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+bool options_from_argv(int argc, char* argv[], EmulatorOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* name = argv[i];
+        if (::strcmp(name, "--pty") == 0)
+        {
+#ifdef _WIN32
+            return false;
+#else
+            options.pty = true;
+            continue;
+#endif
+        }
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const char* value = argv[++i];
+        unsigned int number = 0;
+        if (!parse_number(value, number))
+        {
+            return false;
+        }
+        if (::strcmp(name, "--listen") == 0 && number > 0 && number <= 65535)
+        {
+            options.tcp_port = static_cast<unsigned short>(number);
+        }
+        else if (::strcmp(name, "--devices") == 0 && number > 0)
+        {
+            options.devices = number;
+        }
+        else if (::strcmp(name, "--flow-latency-ms") == 0)
+        {
+            options.config.flow_latency = timeout_t {number};
+        }
+        else if (::strcmp(name, "--reply-latency-ms") == 0)
+        {
+            options.config.reply_latency = timeout_t {number};
+        }
+        else if (::strcmp(name, "--users") == 0)
+        {
+            options.config.users = number;
+        }
+        else if (::strcmp(name, "--max-users") == 0)
+        {
+            options.config.max_users = number;
+        }
+        else if (::strcmp(name, "--protocol") == 0 && number <= 255)
+        {
+            options.config.protocol_ver = static_cast<unsigned char>(number);
+        }
+        else if (::strcmp(name, "--corrupt-every") == 0)
+        {
+            options.config.corrupt_every = number;
+        }
+        else if (::strcmp(name, "--faces-per-frame") == 0)
+        {
+            options.config.faces_per_frame = number;
+        }
+        else if (::strcmp(name, "--clock-drift-ppm") == 0)
+        {
+            options.config.clock_drift_ppm = number;
+        }
+        else if (::strcmp(name, "--wake-latency-ms") == 0)
+        {
+            options.config.wake_latency = timeout_t {number};
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options.pty || options.tcp_port + options.devices - 1 <= 65535;
+}
+
+#ifndef _WIN32
+// master side of a pseudo terminal, the host opens its slave as a serial port.
+// while no host has the slave open the receives time out, so the emulator keeps serving.
+class PtySerial : public SerialConnection
+{
+public:
+    PtySerial()
+    {
+        _fd = ::posix_openpt(O_RDWR | O_NOCTTY);
+        if (_fd < 0 || ::grantpt(_fd) != 0 || ::unlockpt(_fd) != 0)
+        {
+            Close();
+            throw std::runtime_error("Failed to create a pseudo terminal");
+        }
+        // raw until the host configures the port
+        struct termios tty;
+        if (::tcgetattr(_fd, &tty) == 0)
+        {
+            ::cfmakeraw(&tty);
+            ::tcsetattr(_fd, TCSANOW, &tty);
+        }
+        _name = ::ptsname(_fd);
+    }
+
+    ~PtySerial()
+    {
+        Close();
+    }
+
+    PtySerial(const PtySerial&) = delete;
+    PtySerial operator=(const PtySerial&) = delete;
+
+    const std::string& Name() const
+    {
+        return _name;
+    }
+
+    SerialStatus SendBytes(const char* buffer, size_t n_bytes) override
+    {
+        while (n_bytes > 0)
+        {
+            auto written = ::write(_fd, buffer, n_bytes);
+            if (written <= 0)
+            {
+                return SerialStatus::SendFailed;
+            }
+            buffer += written;
+            n_bytes -= static_cast<size_t>(written);
+        }
+        return SerialStatus::Ok;
+    }
+
+    SerialStatus RecvBytes(char* buffer, size_t n_bytes) override
+    {
+        RealSenseID::PacketManager::Timer timer {timeout_t {200 + 4 * n_bytes}};
+        return _recv_buffer.Recv(buffer, n_bytes, timer);
+    }
+
+    SerialStatus RecvAvailable(char* buffer, size_t max_bytes, size_t& n_bytes, timeout_t timeout) override
+    {
+        n_bytes = 0;
+        struct pollfd pfd = {_fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, static_cast<int>(timeout.count()));
+        if (ready > 0 && (pfd.revents & POLLIN))
+        {
+            auto n_read = ::read(_fd, buffer, max_bytes);
+            if (n_read > 0)
+            {
+                n_bytes = static_cast<size_t>(n_read);
+                return SerialStatus::Ok;
+            }
+        }
+        if (ready > 0)
+        {
+            // no host has the slave open (hangup), wait for one
+            std::this_thread::sleep_for(timeout);
+        }
+        return SerialStatus::RecvTimeout;
+    }
+
+private:
+    int _fd = -1;
+    std::string _name;
+
+    void Close()
+    {
+        if (_fd >= 0)
+        {
+            ::close(_fd);
+            _fd = -1;
+        }
+    }
+};
+#endif
+
+// serve the devices' hosts until stopped
+void serve_tcp(DeviceEmulator& emulator, RealSenseID::PacketManager::TcpListener& listener)
+{
+    while (!s_stop)
+    {
+        auto host = listener.Accept(POLL_TIMEOUT);
+        if (host)
+        {
+            emulator.Serve(*host);
+        }
+    }
+}
+
+void on_signal(int)
+{
+    s_stop = true;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    EmulatorOptions options;
+    if (!options_from_argv(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    std::vector<std::unique_ptr<DeviceEmulator>> emulators;
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<RealSenseID::PacketManager::TcpListener>> listeners;
+#ifndef _WIN32
+    std::vector<std::unique_ptr<PtySerial>> ptys;
+#endif
+    int rv = 0;
+    try
+    {
+        for (unsigned int i = 0; i < options.devices; i++)
+        {
+            emulators.push_back(std::make_unique<DeviceEmulator>(options.config));
+            auto& emulator = *emulators.back();
+#ifndef _WIN32
+            if (options.pty)
+            {
+                ptys.push_back(std::make_unique<PtySerial>());
+                auto& pty = *ptys.back();
+                std::cout << pty.Name() << std::endl;
+                threads.emplace_back([&emulator, &pty] { emulator.Serve(pty); });
+                continue;
+            }
+#endif
+            auto tcp_port = static_cast<unsigned short>(options.tcp_port + i);
+            listeners.push_back(std::make_unique<RealSenseID::PacketManager::TcpListener>(tcp_port));
+            auto& listener = *listeners.back();
+            std::cout << "tcp://localhost:" << tcp_port << std::endl;
+            threads.emplace_back([&emulator, &listener] { serve_tcp(emulator, listener); });
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        s_stop = true;
+        rv = 1;
+    }
+
+    while (!s_stop)
+    {
+        std::this_thread::sleep_for(POLL_TIMEOUT);
+    }
+    for (auto& emulator : emulators)
+    {
+        emulator->Stop();
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    return rv;
+}
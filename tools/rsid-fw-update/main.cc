@@ -4,6 +4,8 @@
 #include "RealSenseID/DeviceController.h"
 #include "RealSenseID/DiscoverDevices.h"
 #include "RealSenseID/Version.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <memory>
@@ -114,6 +116,13 @@ struct CommandLineArgs
     bool force_version = false;   // force non-compatible versions
     bool force_full = false;      // force update of all modules even if already exist in the fw
     bool is_interactive = false;  // ask user for approval
+    bool update_all = false;      // update all the detected devices concurrently
+    unsigned int max_concurrent = RealSenseID::FwUpdater::FleetSettings::DefaultMaxConcurrent;
+    unsigned int max_failures = 0; // stop starting updates after this many failed devices (--all)
+    unsigned int block_size = 0;   // transfer block size in KB, 0 for the default
+    bool compress = false;         // lz4 compressed transfer if supported by the device
+    bool stage = false;            // transfer without rebooting into the new firmware
+    bool activate = false;         // reboot into a staged update
     std::string fw_file = "";     // path to firmware update binary
     std::string serial_port = ""; // serial port
 };
@@ -125,7 +134,11 @@ static CommandLineArgs ParseCommandLineArgs(int argc, char* argv[])
     if (argc < 2)
     {
         std::cout << "usage: " << argv[0]
-                  << " --file <bin path> [--port <COM#>] [--force-version] [--force-full] [--interactive]\n";
+                  << " --file <bin path> [--port <COM#>] [--force-version] [--force-full] [--interactive] "
+                     "[--block-size <KB>] [--compress] [--stage | --activate]\n"
+                  << "       " << argv[0]
+                  << " --file <bin path> --all [--max-concurrent <n>] [--max-failures <n>] [--force-version] "
+                     "[--force-full] [--interactive] [--block-size <KB>] [--compress] [--stage]\n";
         return args;
     }
 
@@ -153,10 +166,42 @@ static CommandLineArgs ParseCommandLineArgs(int argc, char* argv[])
         {
             args.is_interactive = true;
         }
+        else if (strcmp(argv[i], "--all") == 0)
+        {
+            args.update_all = true;
+        }
+        else if (strcmp(argv[i], "--max-concurrent") == 0)
+        {
+            if (i + 1 < argc)
+                args.max_concurrent = static_cast<unsigned int>(std::max(std::atoi(argv[++i]), 1));
+        }
+        else if (strcmp(argv[i], "--compress") == 0)
+        {
+            args.compress = true;
+        }
+        else if (strcmp(argv[i], "--stage") == 0)
+        {
+            args.stage = true;
+        }
+        else if (strcmp(argv[i], "--activate") == 0)
+        {
+            args.activate = true;
+        }
+        else if (strcmp(argv[i], "--block-size") == 0)
+        {
+            if (i + 1 < argc)
+                args.block_size = static_cast<unsigned int>(std::max(std::atoi(argv[++i]), 0));
+        }
+        else if (strcmp(argv[i], "--max-failures") == 0)
+        {
+            if (i + 1 < argc)
+                args.max_failures = static_cast<unsigned int>(std::max(std::atoi(argv[++i]), 0));
+        }
     }
 
     // Make sure all required options are available.
-    if (!args.fw_file.empty())
+    if (!args.fw_file.empty() && !(args.update_all && !args.serial_port.empty()) && !(args.stage && args.activate) &&
+        !(args.update_all && args.activate))
         args.is_valid = true;
 
     return args;
@@ -205,6 +250,126 @@ struct FwUpdaterCliEventHandler : public RealSenseID::FwUpdater::EventHandler
     }
 };
 
+// prints a line per device every 10%
+struct FwUpdaterFleetEventHandler : public RealSenseID::FwUpdater::FleetEventHandler
+{
+    explicit FwUpdaterFleetEventHandler(const std::vector<FullDeviceInfo>& devices) :
+        _devices {devices}, _last_reported(devices.size(), -1)
+    {
+    }
+
+    void OnProgress(size_t device_index, float progress) override
+    {
+        int percent = static_cast<int>(progress * 100) / 10 * 10;
+        if (percent == _last_reported[device_index])
+            return;
+        _last_reported[device_index] = percent;
+        std::cout << " [" << _devices[device_index].config->serialPort << "] " << percent << " %\n";
+    }
+
+    void OnDone(size_t device_index, RealSenseID::Status status) override
+    {
+        std::cout << " [" << _devices[device_index].config->serialPort << "] "
+                  << (status == RealSenseID::Status::Ok ? "done" : "FAILED") << "\n";
+    }
+
+private:
+    const std::vector<FullDeviceInfo>& _devices;
+    std::vector<int> _last_reported;
+};
+
+// update all the detected devices concurrently
+static int UpdateAll(const CommandLineArgs& args)
+{
+    std::cout << "Using device auto detection...\n\n";
+
+    std::vector<FullDeviceInfo> devices_info;
+    for (const auto& detected_device : RealSenseID::DiscoverDevices())
+    {
+        auto metadata = QueryDeviceMetadata(RealSenseID::SerialConfig {detected_device.serialPort});
+        devices_info.push_back({std::make_unique<DeviceMetadata>(metadata),
+                                std::make_unique<RealSenseID::DeviceInfo>(detected_device)});
+    }
+
+    if (devices_info.empty())
+    {
+        std::cout << "No devices found!\n";
+        return FAILURE_MAIN;
+    }
+
+    RealSenseID::FwUpdater fw_updater;
+    std::string new_fw_version;
+    std::string new_recognition_version;
+    if (!fw_updater.ExtractFwVersion(args.fw_file.c_str(), new_fw_version, new_recognition_version))
+    {
+        std::cout << "Invalid firmware file !\n";
+        return FAILURE_MAIN;
+    }
+
+    const auto new_compatible = RealSenseID::IsFwCompatibleWithHost(new_fw_version);
+    bool is_database_compatible = true;
+
+    std::cout << "Summary:\n";
+    std::cout << " * New firmware: OPFW: " << new_fw_version << ", RECOG: " << new_recognition_version << " ("
+              << (new_compatible ? "compatible" : "incompatible") << " with host)\n";
+    std::cout << " * " << devices_info.size() << " devices, up to " << args.max_concurrent << " at a time:\n";
+    for (const auto& device : devices_info)
+    {
+        std::cout << "     * S/N: " << device.metadata->serial_number << " Port: " << device.config->serialPort
+                  << " OPFW: " << device.metadata->fw_version << " RECOG: " << device.metadata->recognition_version
+                  << "\n";
+        if (device.metadata->recognition_version != new_recognition_version)
+            is_database_compatible = false;
+    }
+    std::cout << "\n";
+
+    if (args.is_interactive)
+    {
+        std::cout << "Proceed with update? (y/n)\n";
+        if (!UserApproval())
+            return FAILURE_MAIN;
+        std::cout << "\n";
+    }
+
+    if (!new_compatible && !args.force_version)
+    {
+        std::cout << "Version is incompatible with the current host version!\n";
+        std::cout << "Use --force-version to force the update.\n ";
+        return FAILURE_MAIN;
+    }
+
+    bool exclude_recognition = false;
+    if (!is_database_compatible)
+    {
+        std::cout << "Preserve faceprints database without updating the recognition module? (y/n)\n";
+        exclude_recognition = UserApproval();
+        std::cout << "\n";
+    }
+
+    std::vector<RealSenseID::FwUpdater::Settings> settings(devices_info.size());
+    for (size_t i = 0; i < devices_info.size(); ++i)
+    {
+        settings[i].port = devices_info[i].config->serialPort;
+        settings[i].force_full = args.force_full;
+        settings[i].block_size = args.block_size * 1024;
+        settings[i].compress = args.compress;
+        settings[i].stage_only = args.stage;
+    }
+
+    RealSenseID::FwUpdater::FleetSettings fleet_settings;
+    fleet_settings.max_concurrent = args.max_concurrent;
+    fleet_settings.max_failures = args.max_failures;
+
+    FwUpdaterFleetEventHandler event_handler(devices_info);
+    auto statuses =
+        fw_updater.UpdateFleet(&event_handler, settings, args.fw_file.c_str(), exclude_recognition, fleet_settings);
+
+    auto n_succeeded = std::count(statuses.begin(), statuses.end(), RealSenseID::Status::Ok);
+    std::cout << "\n";
+    std::cout << "Firmware update finished: " << n_succeeded << "/" << statuses.size() << " devices updated\n";
+    return n_succeeded == static_cast<long>(statuses.size()) ? SUCCESS_MAIN : FAILURE_MAIN;
+}
+
 int main(int argc, char* argv[])
 {
     // parse cli args
@@ -212,6 +377,9 @@ int main(int argc, char* argv[])
     if (!args.is_valid)
         return FAILURE_MAIN;
 
+    if (args.update_all)
+        return UpdateAll(args);
+
     // populate device list
     std::vector<FullDeviceInfo> devices_info;
     bool auto_detect = args.serial_port.empty();
@@ -321,13 +489,29 @@ int main(int argc, char* argv[])
     RealSenseID::FwUpdater::Settings settings;
     settings.port = selected_device.config->serialPort;
     settings.force_full = args.force_full;
+    settings.block_size = args.block_size * 1024;
+    settings.compress = args.compress;
+    settings.stage_only = args.stage;
+
+    if (args.activate)
+    {
+        auto success = fw_updater.Activate(settings, args.fw_file.c_str(), exclude_recognition) ==
+                       RealSenseID::Status::Ok;
+        std::cout << "Firmware activation" << (success ? " finished successfully " : " failed ") << "\n";
+        return success ? SUCCESS_MAIN : FAILURE_MAIN;
+    }
 
     // attempt firmware update and return succcess/failure according to result
     auto success = fw_updater.Update(event_handler.get(), settings, args.fw_file.c_str(), exclude_recognition) ==
                    RealSenseID::Status::Ok;
 
     std::cout << "\n\n";
-    std::cout << "Firmware update" << (success ? " finished successfully " : " failed ") << "\n";
+    std::cout << "Firmware " << (args.stage ? "staging" : "update")
+              << (success ? " finished successfully " : " failed ") << "\n";
+    if (success && args.stage)
+    {
+        std::cout << "Run again with --activate instead of --stage to reboot into the new firmware\n";
+    }
 
     return success ? SUCCESS_MAIN : FAILURE_MAIN;
 }
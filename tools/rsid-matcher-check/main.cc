@@ -0,0 +1,846 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Accuracy and performance regression check of the host mode matcher engines on a recorded corpus (no device needed).
+// Usage:
+//   rsid-matcher-check synthetic <corpus> [--users <n>] [--queries <n>] [--pairs <n>] [--seed <n>]
+//   rsid-matcher-check import <database> <corpus> [--queries <n>] [--pairs <n>] [--seed <n>]
+//   rsid-matcher-check run <corpus> [options]
+//     --engines <list>          comma separated engines to check (default all, see ALL_ENGINES)
+//     --threshold <n>           strong threshold of the 1:N engines (default the matcher's)
+//     --repeat <n>              timed passes over the queries per engine (default 1)
+//     --nprobe <n>              lists probed by the ivf engine (default 8, trained with sqrt(users) lists)
+//     --shortlist <n>           users rescored by the prefiltered engine (default 256)
+//     --deadline-us <n>         time budget of each search of the deadline-tight engine (default 200)
+//     --max-decision-diff <f>   tolerated rate of changed decisions of the approximate engines (default 0.05)
+//     --format csv|json         report format (default csv)
+//     --output <file>           write the report to the file instead of stdout
+//
+// The reference is a plain scalar implementation of the matcher's arithmetic (CalcProductsScalar() + CalculateGrade(),
+// the same as MatchTwoVectors() with the scalar kernel), scanned in gallery order with the early exit on the threshold.
+// Each engine is checked against it per query (userId, maxScore, isSame, isIdentical) or per pair (score / products):
+//   exact       - every result must be identical
+//   decision    - the decisions must be identical, the matched user and its score may differ between users that both
+//                 pass the threshold (the parallel search returns the first match found by any worker)
+//   approximate - the rate of changed isSame decisions must not exceed --max-decision-diff
+// Throughput is reported per engine along with its speedup over the upstream array search ("array").
+//
+// Returns 0 if all the engines passed, 1 on invalid arguments or if the corpus or the report could not be read or
+// written, 2 if any engine regressed.
+
+#include "matcher_corpus.h"
+#include "Matcher.h"
+#include "MatcherKernels.h"
+#include "FaceprintsGallery.h"
+#include "FaceprintsIvfIndex.h"
+#include "FaceprintsPivotIndex.h"
+#include "FaceprintsQuantizedIndex.h"
+#include "FaceprintsProgressiveIndex.h"
+#include "MatcherThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+// access to the private matcher building blocks (friend of Matcher)
+struct MatcherBenchmarkAccess
+{
+    static void MatchTwoVectors(const feature_t* T1, const feature_t* T2, match_calc_t* retprob)
+    {
+        Matcher::MatchTwoVectors(T1, T2, retprob);
+    }
+
+    static Thresholds GetDefaultThresholds()
+    {
+        return Matcher::GetDefaultThresholds();
+    }
+
+    // the matcher's grade of plain scalar products, norms of 0 protected as in MatchTwoVectors()
+    static match_calc_t ScalarGrade(const feature_t* T1, const feature_t* T2)
+    {
+        MatcherKernels::VectorProducts products;
+        MatcherKernels::CalcProductsScalar(T1, T2, FaceprintsGallery::VectorLength, products);
+        const uint32_t norm1 = (products.norm1 == 0) ? 1 : products.norm1;
+        const uint32_t norm2 = (products.norm2 == 0) ? 1 : products.norm2;
+        return Matcher::CalculateGrade(products.corr, norm1, Matcher::GetMsb(norm1), norm2, Matcher::GetMsb(norm2));
+    }
+};
+} // namespace RealSenseID
+
+using RealSenseID::ExtendedFaceprints;
+using RealSenseID::ExtendedMatchResult;
+using RealSenseID::Faceprints;
+using RealSenseID::FaceprintsGallery;
+using RealSenseID::Matcher;
+using RealSenseID::MatcherBenchmarkAccess;
+using RealSenseID::MatcherCheck::MatcherCorpus;
+using RealSenseID::Thresholds;
+using RealSenseID::feature_t;
+using RealSenseID::match_calc_t;
+namespace MatcherKernels = RealSenseID::MatcherKernels;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+const char* const ALL_ENGINES[] = {"array",          "gallery-vector", "gallery",        "gallery-interleaved",
+                                   "batch",          "pivot",          "quantized",      "progressive",
+                                   "parallel",       "ivf",            "prefiltered",    "deadline",
+                                   "deadline-tight", "pair-vectors",   "pair-faceprints", "pair-dot",
+                                   "pair-dot4",      "pair-dot16"};
+
+enum class CheckKind
+{
+    Exact,
+    Decision,
+    Approximate
+};
+
+const char* kind_name(CheckKind kind)
+{
+    switch (kind)
+    {
+    case CheckKind::Exact:
+        return "exact";
+    case CheckKind::Decision:
+        return "decision";
+    default:
+        return "approximate";
+    }
+}
+
+struct CheckOptions
+{
+    std::string command;
+    std::string corpus_path;
+    std::string database_path;
+    std::vector<std::string> engines;
+    unsigned int users = 10000;
+    unsigned int queries = 1000;
+    unsigned int pairs = 1000;
+    unsigned int seed = 2021;
+    unsigned int threshold = 0; // 0 - the matcher's default
+    unsigned int repeat = 1;
+    unsigned int nprobe = 8;
+    unsigned int shortlist = 256;
+    unsigned int deadline_us = 200;
+    double max_decision_diff = 0.05;
+    bool json = false;
+    std::string output_path;
+};
+
+// result of one query (or pair) as compared between the engines
+struct CheckResult
+{
+    int user_id = -1;
+    match_calc_t score = 0;
+    bool is_same = false;
+    bool is_identical = false;
+    int32_t corr = 0;  // products of the kernel engines
+    uint32_t norm = 0; // norm of the second vector of the pair
+};
+
+struct Engine
+{
+    std::string name;
+    CheckKind kind;
+    bool pairs; // matches the pairs 1:1 instead of the queries 1:N
+    std::function<void(std::vector<CheckResult>&)> run;
+};
+
+struct EngineReport
+{
+    std::string name;
+    CheckKind kind;
+    size_t count = 0;
+    size_t mismatches = 0;       // results differing from the reference as checked by the kind
+    size_t decision_diffs = 0;   // changed isSame decisions
+    double elapsed_ms = 0;       // mean time of a pass
+    double throughput = 0;       // queries (or pairs) per second
+    double speedup = 0;          // throughput over the array engine's (0 for the pair engines)
+    bool passed = false;
+};
+
+void print_usage()
+{
+    std::cout << "Usage: rsid-matcher-check synthetic <corpus> [--users <n>] [--queries <n>] [--pairs <n>]"
+                 " [--seed <n>]\n"
+                 "       rsid-matcher-check import <database> <corpus> [--queries <n>] [--pairs <n>] [--seed <n>]\n"
+                 "       rsid-matcher-check run <corpus> [--engines <list>] [--threshold <n>] [--repeat <n>]"
+                 " [--nprobe <n>] [--shortlist <n>] [--deadline-us <n>] [--max-decision-diff <f>] [--format csv|json]"
+                 " [--output <file>]"
+              << std::endl;
+}
+
+bool parse_number(const char* token, unsigned int& value)
+{
+    char* end = nullptr;
+    auto parsed = std::strtoul(token, &end, 10);
+    if (*token == '\0' || *end != '\0')
+    {
+        return false;
+    }
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream tokens {list};
+    std::string item;
+    while (std::getline(tokens, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool options_from_argv(int argc, char* argv[], CheckOptions& options)
+{
+    if (argc < 3)
+    {
+        return false;
+    }
+    options.command = argv[1];
+    int first_option = 3;
+    if (options.command == "import")
+    {
+        if (argc < 4)
+        {
+            return false;
+        }
+        options.database_path = argv[2];
+        options.corpus_path = argv[3];
+        first_option = 4;
+    }
+    else if (options.command == "synthetic" || options.command == "run")
+    {
+        options.corpus_path = argv[2];
+    }
+    else
+    {
+        return false;
+    }
+    options.engines.assign(std::begin(ALL_ENGINES), std::end(ALL_ENGINES));
+
+    for (int i = first_option; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const char* name = argv[i];
+        const char* value = argv[++i];
+        unsigned int number = 0;
+        if (::strcmp(name, "--users") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.users = number;
+        }
+        else if (::strcmp(name, "--queries") == 0 && parse_number(value, number))
+        {
+            options.queries = number;
+        }
+        else if (::strcmp(name, "--pairs") == 0 && parse_number(value, number))
+        {
+            options.pairs = number;
+        }
+        else if (::strcmp(name, "--seed") == 0 && parse_number(value, number))
+        {
+            options.seed = number;
+        }
+        else if (::strcmp(name, "--engines") == 0)
+        {
+            options.engines = split_list(value);
+            for (const auto& engine : options.engines)
+            {
+                if (std::find(std::begin(ALL_ENGINES), std::end(ALL_ENGINES), engine) == std::end(ALL_ENGINES))
+                {
+                    std::cerr << "Unknown engine " << engine << std::endl;
+                    return false;
+                }
+            }
+        }
+        else if (::strcmp(name, "--threshold") == 0 && parse_number(value, number) && number > 0 && number < 4096)
+        {
+            options.threshold = number;
+        }
+        else if (::strcmp(name, "--repeat") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.repeat = number;
+        }
+        else if (::strcmp(name, "--nprobe") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.nprobe = number;
+        }
+        else if (::strcmp(name, "--shortlist") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.shortlist = number;
+        }
+        else if (::strcmp(name, "--deadline-us") == 0 && parse_number(value, number))
+        {
+            options.deadline_us = number;
+        }
+        else if (::strcmp(name, "--max-decision-diff") == 0)
+        {
+            char* end = nullptr;
+            options.max_decision_diff = std::strtod(value, &end);
+            if (*end != '\0' || options.max_decision_diff < 0 || options.max_decision_diff > 1)
+            {
+                return false;
+            }
+        }
+        else if (::strcmp(name, "--format") == 0 && (::strcmp(value, "csv") == 0 || ::strcmp(value, "json") == 0))
+        {
+            options.json = ::strcmp(value, "json") == 0;
+        }
+        else if (::strcmp(name, "--output") == 0)
+        {
+            options.output_path = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !options.engines.empty();
+}
+
+CheckResult to_check_result(const ExtendedMatchResult& result)
+{
+    CheckResult check;
+    check.user_id = result.userId;
+    check.score = result.maxScore;
+    check.is_same = result.isSame;
+    check.is_identical = result.isIdentical;
+    return check;
+}
+
+// the reference 1:N search: scalar grades in gallery order, the first user above the threshold or the best user
+// (first of equal scores), no user if all the scores are 0
+std::vector<CheckResult> reference_queries(const MatcherCorpus& corpus, const Thresholds& thresholds)
+{
+    const auto defaults = MatcherBenchmarkAccess::GetDefaultThresholds();
+    std::vector<CheckResult> results(corpus.queries.size());
+    for (size_t q = 0; q < corpus.queries.size(); q++)
+    {
+        auto& result = results[q];
+        for (size_t i = 0; i < corpus.gallery.size(); i++)
+        {
+            const auto score = MatcherBenchmarkAccess::ScalarGrade(corpus.queries[q].faceprints.avgDescriptor,
+                                                                   corpus.gallery[i].faceprints.avgDescriptor);
+            if (score > result.score)
+            {
+                result.score = score;
+                result.user_id = static_cast<int>(i);
+            }
+            if (score > thresholds.strongThreshold)
+            {
+                break;
+            }
+        }
+        result.is_same = result.score > thresholds.strongThreshold;
+        result.is_identical = result.score > defaults.identicalPersonThreshold;
+    }
+    return results;
+}
+
+std::vector<CheckResult> reference_pairs(const MatcherCorpus& corpus)
+{
+    std::vector<CheckResult> results(corpus.pairs.size() / 2);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        results[i].score = MatcherBenchmarkAccess::ScalarGrade(corpus.pairs[2 * i].faceprints.avgDescriptor,
+                                                               corpus.pairs[2 * i + 1].faceprints.avgDescriptor);
+    }
+    return results;
+}
+
+// the 1:1 kernel engines are compared against the scalar kernel's products of the same vectors
+CheckResult products_result(int32_t corr, uint32_t norm2)
+{
+    CheckResult result;
+    result.corr = corr;
+    result.norm = norm2;
+    return result;
+}
+
+std::vector<CheckResult> reference_products(const MatcherCorpus& corpus)
+{
+    std::vector<CheckResult> results(corpus.pairs.size() / 2);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        MatcherKernels::VectorProducts products;
+        MatcherKernels::CalcProductsScalar(corpus.pairs[2 * i].faceprints.avgDescriptor,
+                                           corpus.pairs[2 * i + 1].faceprints.avgDescriptor,
+                                           FaceprintsGallery::VectorLength, products);
+        results[i] = products_result(products.corr, products.norm2);
+    }
+    return results;
+}
+
+bool is_kernel_engine(const std::string& name)
+{
+    return name == "pair-dot" || name == "pair-dot4" || name == "pair-dot16";
+}
+
+// the search structures of the engines, built once before the timed passes
+struct Galleries
+{
+    std::vector<ExtendedFaceprints> array;
+    std::vector<RealSenseID::GalleryFaceprints> vector;
+    FaceprintsGallery gallery;
+    FaceprintsGallery interleaved;
+    RealSenseID::FaceprintsPivotIndex pivot;
+    RealSenseID::FaceprintsQuantizedIndex quantized;
+    RealSenseID::FaceprintsProgressiveIndex progressive;
+    RealSenseID::FaceprintsIvfIndex ivf;
+    RealSenseID::MatcherThreadPool pool;
+    std::vector<Faceprints> queries;
+};
+
+void build_galleries(const MatcherCorpus& corpus, const std::vector<std::string>& engines, Galleries& galleries)
+{
+    auto uses = [&engines](const char* name) {
+        return std::find(engines.begin(), engines.end(), name) != engines.end();
+    };
+    galleries.array = corpus.gallery;
+    for (const auto& user : corpus.gallery)
+    {
+        if (uses("gallery-vector"))
+        {
+            galleries.vector.emplace_back();
+            Matcher::UpdateGalleryFaceprints(galleries.vector.back(), user);
+        }
+        if (uses("gallery") || uses("batch") || uses("parallel") || uses("prefiltered"))
+        {
+            galleries.gallery.Add(user);
+        }
+        if (uses("gallery-interleaved"))
+        {
+            galleries.interleaved.Add(user);
+        }
+        if (uses("pivot"))
+        {
+            galleries.pivot.Add(user);
+        }
+        if (uses("quantized"))
+        {
+            galleries.quantized.Add(user);
+        }
+        if (uses("progressive"))
+        {
+            galleries.progressive.Add(user);
+        }
+        if (uses("ivf") || uses("deadline") || uses("deadline-tight"))
+        {
+            galleries.ivf.Add(user);
+        }
+    }
+    galleries.interleaved.SetInterleaved(true);
+    if (uses("pivot"))
+    {
+        galleries.pivot.Build();
+    }
+    if (uses("progressive"))
+    {
+        galleries.progressive.Train();
+    }
+    if ((uses("ivf") || uses("deadline") || uses("deadline-tight")) && !corpus.gallery.empty())
+    {
+        galleries.ivf.Train(std::max<size_t>(1, static_cast<size_t>(std::sqrt(corpus.gallery.size()))));
+    }
+    for (const auto& query : corpus.queries)
+    {
+        galleries.queries.push_back(query.faceprints);
+    }
+}
+
+// 1:N engine running a single query search per query
+Engine query_engine(const char* name, CheckKind kind, const Galleries& galleries,
+                    std::function<ExtendedMatchResult(const Faceprints&, Faceprints&)> match)
+{
+    return {name, kind, false, [&galleries, match](std::vector<CheckResult>& results) {
+                Faceprints updated;
+                results.resize(galleries.queries.size());
+                for (size_t q = 0; q < galleries.queries.size(); q++)
+                {
+                    results[q] = to_check_result(match(galleries.queries[q], updated));
+                }
+            }};
+}
+
+// 1:1 engine running per pair
+Engine pair_engine(const char* name, const MatcherCorpus& corpus, std::function<CheckResult(size_t)> match)
+{
+    return {name, CheckKind::Exact, true, [&corpus, match](std::vector<CheckResult>& results) {
+                results.resize(corpus.pairs.size() / 2);
+                for (size_t i = 0; i < results.size(); i++)
+                {
+                    results[i] = match(i);
+                }
+            }};
+}
+
+std::vector<Engine> make_engines(const MatcherCorpus& corpus, Galleries& galleries, const Thresholds& thresholds,
+                                 const CheckOptions& options)
+{
+    const size_t nprobe = options.nprobe;
+    const size_t shortlist = options.shortlist;
+    std::vector<Engine> engines;
+    engines.push_back(query_engine("array", CheckKind::Exact, galleries, [&](const Faceprints& q, Faceprints& u) {
+        return Matcher::MatchFaceprintsToArray(q, galleries.array, u, thresholds);
+    }));
+    engines.push_back(query_engine("gallery-vector", CheckKind::Exact, galleries,
+                                   [&](const Faceprints& q, Faceprints& u) {
+                                       return Matcher::MatchFaceprintsToArray(q, galleries.vector, u, thresholds);
+                                   }));
+    engines.push_back(query_engine("gallery", CheckKind::Exact, galleries, [&](const Faceprints& q, Faceprints& u) {
+        return Matcher::MatchFaceprintsToArray(q, galleries.gallery, u, thresholds);
+    }));
+    engines.push_back(query_engine("gallery-interleaved", CheckKind::Exact, galleries,
+                                   [&](const Faceprints& q, Faceprints& u) {
+                                       return Matcher::MatchFaceprintsToArray(q, galleries.interleaved, u, thresholds);
+                                   }));
+    engines.push_back({"batch", CheckKind::Exact, false, [&](std::vector<CheckResult>& results) {
+                           std::vector<Faceprints> updated;
+                           auto batch = Matcher::MatchFaceprintsBatch(galleries.queries, galleries.gallery, updated,
+                                                                      thresholds);
+                           results.clear();
+                           for (const auto& result : batch)
+                           {
+                               results.push_back(to_check_result(result));
+                           }
+                       }});
+    engines.push_back(query_engine("pivot", CheckKind::Exact, galleries, [&](const Faceprints& q, Faceprints& u) {
+        return Matcher::MatchFaceprintsToArray(q, galleries.pivot, u, thresholds);
+    }));
+    engines.push_back(query_engine("quantized", CheckKind::Exact, galleries, [&](const Faceprints& q, Faceprints& u) {
+        return Matcher::MatchFaceprintsToArray(q, galleries.quantized, u, thresholds);
+    }));
+    engines.push_back(query_engine("progressive", CheckKind::Exact, galleries, [&](const Faceprints& q, Faceprints& u) {
+        return Matcher::MatchFaceprintsToArray(q, galleries.progressive, u, thresholds);
+    }));
+    engines.push_back(query_engine("parallel", CheckKind::Decision, galleries, [&](const Faceprints& q, Faceprints& u) {
+        return Matcher::MatchFaceprintsToArray(q, galleries.gallery, u, thresholds, galleries.pool);
+    }));
+    engines.push_back(query_engine("ivf", CheckKind::Approximate, galleries,
+                                   [&, nprobe](const Faceprints& q, Faceprints& u) {
+                                       return Matcher::MatchFaceprintsToArray(q, galleries.ivf, u, nprobe, thresholds);
+                                   }));
+    engines.push_back(query_engine("prefiltered", CheckKind::Approximate, galleries,
+                                   [&, shortlist](const Faceprints& q, Faceprints& u) {
+                                       return Matcher::MatchFaceprintsToArrayPrefiltered(q, galleries.gallery, u,
+                                                                                         shortlist, thresholds);
+                                   }));
+    // without a deadline the full parallel scan, with a tight one the closest lists once the full scan doesn't fit
+    auto unbounded = std::make_shared<RealSenseID::DeadlineSearch>();
+    engines.push_back(query_engine("deadline", CheckKind::Decision, galleries,
+                                   [&, unbounded](const Faceprints& q, Faceprints& u) {
+                                       unbounded->deadline = std::chrono::steady_clock::time_point::max();
+                                       return Matcher::MatchFaceprintsToArray(q, galleries.ivf, u, *unbounded,
+                                                                              thresholds, galleries.pool);
+                                   }));
+    auto tight = std::make_shared<RealSenseID::DeadlineSearch>();
+    const std::chrono::microseconds budget {options.deadline_us};
+    engines.push_back(query_engine("deadline-tight", CheckKind::Approximate, galleries,
+                                   [&, tight, budget](const Faceprints& q, Faceprints& u) {
+                                       tight->deadline = std::chrono::steady_clock::now() + budget;
+                                       return Matcher::MatchFaceprintsToArray(q, galleries.ivf, u, *tight, thresholds,
+                                                                              galleries.pool);
+                                   }));
+
+    // 1:1 grades
+    engines.push_back(pair_engine("pair-vectors", corpus, [&corpus](size_t i) {
+        CheckResult result;
+        MatcherBenchmarkAccess::MatchTwoVectors(corpus.pairs[2 * i].faceprints.avgDescriptor,
+                                                corpus.pairs[2 * i + 1].faceprints.avgDescriptor, &result.score);
+        return result;
+    }));
+    engines.push_back(pair_engine("pair-faceprints", corpus, [&corpus](size_t i) {
+        Faceprints updated;
+        CheckResult result;
+        result.score = Matcher::MatchFaceprints(corpus.pairs[2 * i + 1].faceprints, corpus.pairs[2 * i].faceprints,
+                                                updated)
+                           .score;
+        return result;
+    }));
+
+    // dispatched kernels (see MatcherKernels::GetCalcProductsName()) against the scalar products
+    const uint32_t length = FaceprintsGallery::VectorLength;
+    engines.push_back(pair_engine("pair-dot", corpus, [&corpus, length](size_t i) {
+        static const MatcherKernels::calc_dot_func calc_dot = MatcherKernels::GetCalcDot();
+        const feature_t* second = corpus.pairs[2 * i + 1].faceprints.avgDescriptor;
+        return products_result(calc_dot(corpus.pairs[2 * i].faceprints.avgDescriptor, second, length),
+                               static_cast<uint32_t>(calc_dot(second, second, length)));
+    }));
+    // rows of 4 consecutive second vectors, the pair's row checked against its first vector
+    auto rows = std::make_shared<std::vector<feature_t>>();
+    for (size_t i = 0; i + 1 < corpus.pairs.size(); i += 2)
+    {
+        const feature_t* second = corpus.pairs[i + 1].faceprints.avgDescriptor;
+        rows->insert(rows->end(), second, second + length);
+    }
+    rows->resize((rows->size() / length + 3) / 4 * 4 * length, 0);
+    engines.push_back(pair_engine("pair-dot4", corpus, [&corpus, rows, length](size_t i) {
+        static const MatcherKernels::calc_dot4_func calc_dot4 = MatcherKernels::GetCalcDot4();
+        const feature_t* block = rows->data() + (i / 4) * 4 * length;
+        int32_t corrs[4];
+        int32_t norms[4];
+        calc_dot4(corpus.pairs[2 * i].faceprints.avgDescriptor, block, length, length, corrs);
+        calc_dot4(corpus.pairs[2 * i + 1].faceprints.avgDescriptor, block, length, length, norms);
+        return products_result(corrs[i % 4], static_cast<uint32_t>(norms[i % 4]));
+    }));
+
+    // blocks of InterleaveRows second vectors, the pair's row checked against its first vector
+    auto blocks = std::make_shared<FaceprintsGallery>();
+    blocks->SetInterleaved(true);
+    for (size_t i = 0; i + 1 < corpus.pairs.size(); i += 2)
+    {
+        blocks->Add(corpus.pairs[i + 1]);
+    }
+    engines.push_back(pair_engine("pair-dot16", corpus, [&corpus, blocks, length](size_t i) {
+        static const MatcherKernels::calc_dot16_interleaved_func calc_dot16 =
+            MatcherKernels::GetCalcDot16Interleaved();
+        const size_t rows = FaceprintsGallery::InterleaveRows;
+        const feature_t* block = blocks->InterleavedData() + (i / rows) * rows * length;
+        int32_t corrs[FaceprintsGallery::InterleaveRows];
+        int32_t norms[FaceprintsGallery::InterleaveRows];
+        calc_dot16(corpus.pairs[2 * i].faceprints.avgDescriptor, block, nullptr, length, corrs);
+        calc_dot16(corpus.pairs[2 * i + 1].faceprints.avgDescriptor, block, nullptr, length, norms);
+        return products_result(corrs[i % rows], static_cast<uint32_t>(norms[i % rows]));
+    }));
+
+    std::vector<Engine> selected;
+    for (const auto& name : options.engines)
+    {
+        for (const auto& engine : engines)
+        {
+            if (engine.name == name)
+            {
+                selected.push_back(engine);
+            }
+        }
+    }
+    return selected;
+}
+
+void compare_results(const std::vector<CheckResult>& reference, const std::vector<CheckResult>& results,
+                     EngineReport& report)
+{
+    report.count = reference.size();
+    if (results.size() != reference.size())
+    {
+        report.mismatches = reference.size();
+        report.decision_diffs = reference.size();
+        return;
+    }
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        const auto& expected = reference[i];
+        const auto& actual = results[i];
+        const bool same_decision = expected.is_same == actual.is_same && expected.is_identical == actual.is_identical;
+        const bool same_result = same_decision && expected.user_id == actual.user_id &&
+                                 expected.score == actual.score && expected.corr == actual.corr &&
+                                 expected.norm == actual.norm;
+        if (expected.is_same != actual.is_same)
+        {
+            report.decision_diffs++;
+        }
+        switch (report.kind)
+        {
+        case CheckKind::Exact:
+            report.mismatches += same_result ? 0 : 1;
+            break;
+        case CheckKind::Decision:
+            report.mismatches += (same_result || (same_decision && expected.is_same)) ? 0 : 1;
+            break;
+        default:
+            report.mismatches += same_decision ? 0 : 1;
+            break;
+        }
+    }
+}
+
+EngineReport check_engine(const Engine& engine, const std::vector<CheckResult>& reference, unsigned int repeat,
+                          double max_decision_diff)
+{
+    EngineReport report;
+    report.name = engine.name;
+    report.kind = engine.kind;
+
+    std::vector<CheckResult> results;
+    double total_ms = 0;
+    for (unsigned int pass = 0; pass < repeat; pass++)
+    {
+        std::vector<CheckResult> pass_results;
+        auto start = clock_type::now();
+        engine.run(pass_results);
+        total_ms += std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+        if (pass == 0)
+        {
+            results.swap(pass_results);
+        }
+    }
+    compare_results(reference, results, report);
+    report.elapsed_ms = total_ms / repeat;
+    report.throughput = report.elapsed_ms > 0 ? report.count * 1000.0 / report.elapsed_ms : 0;
+    if (engine.kind == CheckKind::Approximate)
+    {
+        report.passed = report.count == 0 || report.decision_diffs <= max_decision_diff * report.count;
+    }
+    else
+    {
+        report.passed = report.mismatches == 0;
+    }
+    return report;
+}
+
+void write_csv(std::ostream& out, const std::vector<EngineReport>& reports)
+{
+    out << "engine,check,count,mismatches,decision_diffs,passed,mean_ms,throughput,speedup\n";
+    for (const auto& report : reports)
+    {
+        out << report.name << ',' << kind_name(report.kind) << ',' << report.count << ',' << report.mismatches << ','
+            << report.decision_diffs << ',' << (report.passed ? "true" : "false") << ',' << report.elapsed_ms << ','
+            << report.throughput << ',' << report.speedup << '\n';
+    }
+}
+
+void write_json(std::ostream& out, const std::vector<EngineReport>& reports, const MatcherCorpus& corpus,
+                const Thresholds& thresholds)
+{
+    out << "{\n  \"users\": " << corpus.gallery.size() << ",\n  \"queries\": " << corpus.queries.size()
+        << ",\n  \"pairs\": " << corpus.pairs.size() / 2 << ",\n  \"threshold\": " << thresholds.strongThreshold
+        << ",\n  \"kernel\": \"" << MatcherKernels::GetCalcProductsName() << "\",\n  \"engines\": [";
+    for (size_t i = 0; i < reports.size(); i++)
+    {
+        const auto& report = reports[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"engine\": \"" << report.name << "\", \"check\": \""
+            << kind_name(report.kind) << "\", \"count\": " << report.count << ", \"mismatches\": " << report.mismatches
+            << ", \"decision_diffs\": " << report.decision_diffs
+            << ", \"passed\": " << (report.passed ? "true" : "false") << ", \"mean_ms\": " << report.elapsed_ms
+            << ", \"throughput\": " << report.throughput << ", \"speedup\": " << report.speedup << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int run_check(const CheckOptions& options)
+{
+    MatcherCorpus corpus;
+    if (!RealSenseID::MatcherCheck::load_corpus(options.corpus_path, corpus))
+    {
+        return 1;
+    }
+
+    Thresholds thresholds = MatcherBenchmarkAccess::GetDefaultThresholds();
+    if (options.threshold > 0)
+    {
+        thresholds.strongThreshold = static_cast<match_calc_t>(options.threshold);
+    }
+
+    std::cerr << "Corpus: " << corpus.gallery.size() << " users, " << corpus.queries.size() << " queries, "
+              << corpus.pairs.size() / 2 << " pairs. Kernel: " << MatcherKernels::GetCalcProductsName() << std::endl;
+    const auto query_reference = reference_queries(corpus, thresholds);
+    const auto pair_reference = reference_pairs(corpus);
+    const auto products_reference = reference_products(corpus);
+
+    Galleries galleries;
+    build_galleries(corpus, options.engines, galleries);
+    auto engines = make_engines(corpus, galleries, thresholds, options);
+
+    std::vector<EngineReport> reports;
+    for (const auto& engine : engines)
+    {
+        const auto& reference =
+            is_kernel_engine(engine.name) ? products_reference : (engine.pairs ? pair_reference : query_reference);
+        reports.push_back(check_engine(engine, reference, options.repeat, options.max_decision_diff));
+    }
+
+    // speedup of the 1:N engines over the array search (if it ran)
+    auto baseline = std::find_if(reports.begin(), reports.end(),
+                                 [](const EngineReport& report) { return report.name == "array"; });
+    if (baseline != reports.end() && baseline->throughput > 0)
+    {
+        const double baseline_throughput = baseline->throughput;
+        for (size_t i = 0; i < reports.size(); i++)
+        {
+            if (!engines[i].pairs)
+            {
+                reports[i].speedup = reports[i].throughput / baseline_throughput;
+            }
+        }
+    }
+
+    std::ofstream file;
+    if (!options.output_path.empty())
+    {
+        file.open(options.output_path);
+        if (!file)
+        {
+            std::cerr << "Failed creating " << options.output_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.output_path.empty() ? std::cout : file;
+    if (options.json)
+    {
+        write_json(out, reports, corpus, thresholds);
+    }
+    else
+    {
+        write_csv(out, reports);
+    }
+
+    int result = 0;
+    for (const auto& report : reports)
+    {
+        if (!report.passed)
+        {
+            std::cerr << report.name << ": " << report.mismatches << " mismatches, " << report.decision_diffs
+                      << " changed decisions of " << report.count << std::endl;
+            result = 2;
+        }
+    }
+    return result;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    CheckOptions options;
+    if (!options_from_argv(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+
+    MatcherCorpus corpus;
+    if (options.command == "synthetic")
+    {
+        RealSenseID::MatcherCheck::make_synthetic_corpus(options.users, options.queries, options.pairs, options.seed,
+                                                         corpus);
+        return RealSenseID::MatcherCheck::save_corpus(options.corpus_path, corpus) ? 0 : 1;
+    }
+    if (options.command == "import")
+    {
+        return RealSenseID::MatcherCheck::import_database(options.database_path, options.queries, options.pairs,
+                                                          options.seed, corpus) &&
+                       RealSenseID::MatcherCheck::save_corpus(options.corpus_path, corpus)
+                   ? 0
+                   : 1;
+    }
+    return run_check(options);
+}
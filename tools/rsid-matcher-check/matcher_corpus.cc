@@ -0,0 +1,227 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "matcher_corpus.h"
+#include "FaceprintsCodec.h"
+#include "FaceprintsDatabase.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdint.h>
+
+namespace RealSenseID
+{
+namespace MatcherCheck
+{
+static const char CORPUS_MAGIC[8] = {'R', 'S', 'I', 'D', 'M', 'C', 'O', 'R'};
+static const uint32_t CORPUS_VERSION = 1;
+static const int MAX_FEATURE_VALUE = 1023;
+static const double FEATURE_STDDEV = 250;
+
+static void write_uint(std::ostream& out, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        out.put(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+static bool read_uint(std::istream& in, uint64_t& value, size_t size)
+{
+    value = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        int byte = in.get();
+        if (byte == EOF)
+        {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0xff) << (8 * i);
+    }
+    return true;
+}
+
+bool save_corpus(const std::string& path, const MatcherCorpus& corpus)
+{
+    std::ofstream out {path, std::ios::binary};
+    if (!out)
+    {
+        std::cerr << "Failed creating " << path << std::endl;
+        return false;
+    }
+    out.write(CORPUS_MAGIC, sizeof(CORPUS_MAGIC));
+    write_uint(out, CORPUS_VERSION, 4);
+    for (auto* section : {&corpus.gallery, &corpus.queries, &corpus.pairs})
+    {
+        std::vector<uint8_t> buffer;
+        if (!FaceprintsCodec::EncodeUsers(*section, buffer))
+        {
+            std::cerr << "Failed encoding the corpus (features out of range?)" << std::endl;
+            return false;
+        }
+        write_uint(out, buffer.size(), 8);
+        out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+    }
+    return static_cast<bool>(out);
+}
+
+bool load_corpus(const std::string& path, MatcherCorpus& corpus)
+{
+    std::ifstream in {path, std::ios::binary};
+    char magic[sizeof(CORPUS_MAGIC)] = {0};
+    uint64_t version = 0;
+    if (!in || !in.read(magic, sizeof(magic)) || ::memcmp(magic, CORPUS_MAGIC, sizeof(magic)) != 0 ||
+        !read_uint(in, version, 4) || version != CORPUS_VERSION)
+    {
+        std::cerr << path << " is not a matcher corpus" << std::endl;
+        return false;
+    }
+    for (auto* section : {&corpus.gallery, &corpus.queries, &corpus.pairs})
+    {
+        uint64_t size = 0;
+        if (!read_uint(in, size, 8))
+        {
+            std::cerr << "Truncated corpus " << path << std::endl;
+            return false;
+        }
+        std::vector<uint8_t> buffer(static_cast<size_t>(size));
+        if (!in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(size)) ||
+            !FaceprintsCodec::DecodeUsers(buffer.data(), buffer.size(), *section))
+        {
+            std::cerr << "Corrupted corpus " << path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static feature_t clamp_feature(double value)
+{
+    long rounded = std::lround(value);
+    return static_cast<feature_t>(std::max(-static_cast<long>(MAX_FEATURE_VALUE),
+                                           std::min(static_cast<long>(MAX_FEATURE_VALUE), rounded)));
+}
+
+static Faceprints random_faceprints(std::mt19937& rng)
+{
+    std::normal_distribution<double> feature(0, FEATURE_STDDEV);
+    Faceprints faceprints;
+    faceprints.numberOfDescriptors = 1;
+    for (size_t i = 0; i < FEATURES_VECTOR_ALLOC_SIZE; i++)
+    {
+        faceprints.avgDescriptor[i] = clamp_feature(feature(rng));
+        faceprints.origDescriptor[i] = faceprints.avgDescriptor[i];
+    }
+    return faceprints;
+}
+
+// features + gaussian noise with the given deviation, in the orig vector as well
+static Faceprints noisy_faceprints(const Faceprints& faceprints, double noise, std::mt19937& rng)
+{
+    std::normal_distribution<double> delta(0, noise);
+    Faceprints result = faceprints;
+    for (size_t i = 0; i < FEATURES_VECTOR_ALLOC_SIZE; i++)
+    {
+        result.avgDescriptor[i] = clamp_feature(faceprints.avgDescriptor[i] + delta(rng));
+        result.origDescriptor[i] = result.avgDescriptor[i];
+    }
+    return result;
+}
+
+static ExtendedFaceprints make_entry(const char* prefix, size_t index, const Faceprints& faceprints)
+{
+    ExtendedFaceprints entry;
+    entry.faceprints = faceprints;
+    ::snprintf(entry.user_id, sizeof(entry.user_id), "%s%zu", prefix, index);
+    return entry;
+}
+
+// a quarter unrelated, the rest noisy copies of gallery users with noise up to about the feature deviation (scores
+// from near identical to far below the thresholds)
+static Faceprints make_probe(const std::vector<ExtendedFaceprints>& gallery, std::mt19937& rng)
+{
+    if (gallery.empty() || rng() % 4 == 0)
+    {
+        return random_faceprints(rng);
+    }
+    std::uniform_real_distribution<double> noise(10, FEATURE_STDDEV);
+    const auto& user = gallery[rng() % gallery.size()].faceprints;
+    Faceprints probe = noisy_faceprints(user, noise(rng), rng);
+    probe.version = user.version;
+    probe.featuresType = user.featuresType;
+    return probe;
+}
+
+static void add_probes(size_t queries, size_t pairs, std::mt19937& rng, MatcherCorpus& corpus)
+{
+    corpus.queries.clear();
+    corpus.pairs.clear();
+    for (size_t i = 0; i < queries; i++)
+    {
+        corpus.queries.push_back(make_entry("query", i, make_probe(corpus.gallery, rng)));
+    }
+    for (size_t i = 0; i < pairs; i++)
+    {
+        Faceprints first = corpus.gallery.empty() ? random_faceprints(rng)
+                                                  : corpus.gallery[rng() % corpus.gallery.size()].faceprints;
+        std::vector<ExtendedFaceprints> single {make_entry("", 0, first)};
+        corpus.pairs.push_back(make_entry("pair", 2 * i, first));
+        corpus.pairs.push_back(make_entry("pair", 2 * i + 1, make_probe(single, rng)));
+    }
+}
+
+void make_synthetic_corpus(size_t users, size_t queries, size_t pairs, unsigned int seed, MatcherCorpus& corpus)
+{
+    std::mt19937 rng {seed};
+    corpus.gallery.clear();
+    for (size_t i = 0; i < users; i++)
+    {
+        // enrolled (orig) vector close to the adapted avg vector
+        Faceprints faceprints = random_faceprints(rng);
+        Faceprints orig = noisy_faceprints(faceprints, 30, rng);
+        std::copy(std::begin(orig.avgDescriptor), std::end(orig.avgDescriptor), faceprints.origDescriptor);
+        corpus.gallery.push_back(make_entry("user", i, faceprints));
+    }
+    add_probes(queries, pairs, rng, corpus);
+}
+
+bool import_database(const std::string& database_path, size_t queries, size_t pairs, unsigned int seed,
+                     MatcherCorpus& corpus)
+{
+    // Open() creates missing files
+    if (!std::ifstream {database_path, std::ios::binary})
+    {
+        std::cerr << "No database at " << database_path << std::endl;
+        return false;
+    }
+    FaceprintsDatabase database;
+    if (!database.Open(database_path))
+    {
+        std::cerr << "Failed opening database " << database_path << std::endl;
+        return false;
+    }
+
+    corpus.gallery.clear();
+    for (size_t index = 0; index < database.IndexSize(); index++)
+    {
+        ExtendedFaceprints entry;
+        if (!database.GetFaceprints(index, entry.faceprints))
+        {
+            continue; // masked row
+        }
+        ::strncpy(entry.user_id, database.UserId(index), sizeof(entry.user_id) - 1);
+        entry.user_id[sizeof(entry.user_id) - 1] = '\0';
+        corpus.gallery.push_back(entry);
+    }
+    database.Close();
+
+    std::mt19937 rng {seed};
+    add_probes(queries, pairs, rng, corpus);
+    return true;
+}
+} // namespace MatcherCheck
+} // namespace RealSenseID
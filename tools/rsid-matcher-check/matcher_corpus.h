@@ -0,0 +1,40 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "ExtendedFaceprints.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace RealSenseID
+{
+namespace MatcherCheck
+{
+// Recorded matcher corpus: the gallery users, the queries matched against the gallery and the faceprints pairs matched
+// 1:1 (pair i is entries 2i and 2i + 1).
+//
+// File format (little endian):
+//   "RSIDMCOR" | uint32 format version (1) |
+//   3 sections (gallery, queries, pairs), each uint64 size followed by a FaceprintsCodec::EncodeUsers() buffer
+// The codec buffers keep the user ids, versions and both vectors losslessly and carry their own checksum.
+struct MatcherCorpus
+{
+    std::vector<ExtendedFaceprints> gallery;
+    std::vector<ExtendedFaceprints> queries;
+    std::vector<ExtendedFaceprints> pairs;
+};
+
+bool save_corpus(const std::string& path, const MatcherCorpus& corpus);
+bool load_corpus(const std::string& path, MatcherCorpus& corpus);
+
+// synthetic users (gaussian features) and queries/pairs spread over the whole score range: noisy copies of the users
+// from near identical to far below the thresholds, and unrelated faceprints.
+void make_synthetic_corpus(size_t users, size_t queries, size_t pairs, unsigned int seed, MatcherCorpus& corpus);
+
+// gallery of the users of a host mode database (see FaceprintsDatabase), queries and pairs made from them as above.
+bool import_database(const std::string& database_path, size_t queries, size_t pairs, unsigned int seed,
+                     MatcherCorpus& corpus);
+} // namespace MatcherCheck
+} // namespace RealSenseID
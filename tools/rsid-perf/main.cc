@@ -0,0 +1,776 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Latency benchmarks of the device operations (hardware in the loop).
+// Usage: rsid-perf <port> [options]
+//   --suites <list>         comma separated suites to run (default all): ping,session,users,features,auth,preview
+//   --iterations <n>        operations per case (default 20)
+//   --baudrates <list>      comma separated baud rates of the ping suite (default 115200)
+//   --users <n>             synthetic users stored (and removed at the end) by the users and features suites. 0
+//                           (default) leaves the device's database as is and measures the enrolled users only
+//   --preview-seconds <n>   duration of the preview suite (default 5, needs a build with RSID_PREVIEW)
+//   --camera <n>            camera number of the preview suite (default auto detect)
+//   --preview-mode <mode>   preview mode of the preview suite: vga (default), fhd-rect or dump
+//   --playback <file>       preview suite on a preview recording instead of the camera (no device needed)
+//   --playback-pace <pace>  recorded (default) or fast, the recording as fast as the pipeline takes it
+//   --format csv|json       report format (default csv)
+//   --output <file>         write the report to the file instead of stdout
+//   --trace <file>          record the library's trace of the whole run to the file (Chrome Trace Event JSON)
+//   --events <list>         comma separated flow events the device sends (default all): hints,faces, or none
+//   --face-interval <ms>    min time between the face detected events (default 0, all of them)
+//
+// Each case reports the wall clock latencies of its operations and splits their mean into the time spent waiting for
+// the device (Metrics::Latency::DeviceWait: serial transfer, device processing and timeouts) and the host time (the
+// rest: sending, session crypto, callbacks). The wire and session setup times are reported as well.
+// The session suite measures the session mode of the build (secure or not), compare the reports of both builds.
+// Secure builds must be paired with the device first (e.g. with rsid-cli).
+//
+// Returns 0 if all the operations succeeded, 1 on invalid arguments or if the report could not be written, 2 if any
+// operation failed.
+
+#include "RealSenseID/FaceAuthenticator.h"
+#include "RealSenseID/DeviceController.h"
+#include "RealSenseID/Faceprints.h"
+#include "RealSenseID/Logging.h"
+#include "RealSenseID/Metrics.h"
+#include "RealSenseID/Trace.h"
+#include "percentile.h"
+#ifdef RSID_PREVIEW
+#include "RealSenseID/Preview.h"
+#endif // RSID_PREVIEW
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef RSID_SECURE
+#include "secure_mode_helper.h"
+static RealSenseID::Examples::SignHelper s_signer;
+#endif // RSID_SECURE
+
+using clock_type = std::chrono::steady_clock;
+using RealSenseID::Metrics::Latency;
+
+namespace
+{
+using RealSenseID::Tools::percentile;
+
+const char* const ALL_SUITES[] = {"ping", "session", "users", "features", "auth", "preview"};
+const char* const SYNTHETIC_USER_PREFIX = "rsid-perf-";
+
+struct PerfOptions
+{
+    std::string port;
+    std::vector<std::string> suites;
+    unsigned int iterations = 20;
+    std::vector<unsigned int> baudrates = {115200};
+    unsigned int users = 0;
+    unsigned int preview_seconds = 5;
+    int camera = -1;
+    std::string preview_mode = "vga";
+    std::string playback_path;
+    bool playback_realtime = true;
+    bool json = false;
+    std::string output_path;
+    std::string trace_path;
+    RealSenseID::EventSubscription events;
+
+    bool Runs(const char* suite) const
+    {
+        return std::find(suites.begin(), suites.end(), suite) != suites.end();
+    }
+};
+
+// latencies of a benchmark case and the split of their mean
+struct CaseResult
+{
+    std::string suite;
+    std::string name;
+    std::string param;
+    std::vector<double> latencies_ms;
+    unsigned int errors = 0;   // status other than Ok
+    unsigned int failures = 0; // completed with an unsuccessful result (e.g. no face, dropped preview frame)
+    double elapsed_ms = 0;     // wall time of the whole case
+
+    bool has_split = false;
+    double device_ms = 0;  // mean device wait per operation
+    double wire_ms = 0;    // mean packet receive time per operation (part of the device wait)
+    double session_ms = 0; // mean session setup time per operation
+    double host_ms = 0;    // mean latency minus the device wait
+};
+
+void print_usage()
+{
+    std::cout << "Usage: rsid-perf <port> [--suites ping,session,users,features,auth,preview] [--iterations <n>]"
+                 " [--baudrates <list>] [--users <n>] [--preview-seconds <n>] [--camera <n>]"
+                 " [--preview-mode vga|fhd-rect|dump] [--playback <file>] [--playback-pace recorded|fast]"
+                 " [--format csv|json] [--output <file>] [--trace <file>] [--events hints,faces|none]"
+                 " [--face-interval <ms>]"
+              << std::endl;
+}
+
+bool parse_number(const char* token, unsigned int& value)
+{
+    char* end = nullptr;
+    auto parsed = std::strtoul(token, &end, 10);
+    if (*token == '\0' || *end != '\0')
+    {
+        return false;
+    }
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream tokens {list};
+    std::string item;
+    while (std::getline(tokens, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool options_from_argv(int argc, char* argv[], PerfOptions& options)
+{
+    if (argc < 2 || ::strncmp(argv[1], "--", 2) == 0)
+    {
+        return false;
+    }
+    options.port = argv[1];
+    options.suites.assign(std::begin(ALL_SUITES), std::end(ALL_SUITES));
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const char* name = argv[i];
+        const char* value = argv[++i];
+        unsigned int number = 0;
+        if (::strcmp(name, "--suites") == 0)
+        {
+            options.suites = split_list(value);
+            for (const auto& suite : options.suites)
+            {
+                if (std::find(std::begin(ALL_SUITES), std::end(ALL_SUITES), suite) == std::end(ALL_SUITES))
+                {
+                    std::cerr << "Unknown suite " << suite << std::endl;
+                    return false;
+                }
+            }
+        }
+        else if (::strcmp(name, "--iterations") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.iterations = number;
+        }
+        else if (::strcmp(name, "--baudrates") == 0)
+        {
+            options.baudrates.clear();
+            for (const auto& item : split_list(value))
+            {
+                if (!parse_number(item.c_str(), number) || number == 0)
+                {
+                    return false;
+                }
+                options.baudrates.push_back(number);
+            }
+        }
+        else if (::strcmp(name, "--users") == 0 && parse_number(value, number))
+        {
+            options.users = number;
+        }
+        else if (::strcmp(name, "--preview-seconds") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.preview_seconds = number;
+        }
+        else if (::strcmp(name, "--camera") == 0 && parse_number(value, number))
+        {
+            options.camera = static_cast<int>(number);
+        }
+        else if (::strcmp(name, "--preview-mode") == 0 &&
+                 (::strcmp(value, "vga") == 0 || ::strcmp(value, "fhd-rect") == 0 || ::strcmp(value, "dump") == 0))
+        {
+            options.preview_mode = value;
+        }
+        else if (::strcmp(name, "--playback") == 0)
+        {
+            options.playback_path = value;
+        }
+        else if (::strcmp(name, "--playback-pace") == 0 &&
+                 (::strcmp(value, "recorded") == 0 || ::strcmp(value, "fast") == 0))
+        {
+            options.playback_realtime = ::strcmp(value, "recorded") == 0;
+        }
+        else if (::strcmp(name, "--format") == 0 && (::strcmp(value, "csv") == 0 || ::strcmp(value, "json") == 0))
+        {
+            options.json = ::strcmp(value, "json") == 0;
+        }
+        else if (::strcmp(name, "--output") == 0)
+        {
+            options.output_path = value;
+        }
+        else if (::strcmp(name, "--trace") == 0)
+        {
+            options.trace_path = value;
+        }
+        else if (::strcmp(name, "--events") == 0)
+        {
+            options.events.hints = false;
+            options.events.facesDetected = false;
+            for (const auto& item : split_list(value))
+            {
+                if (item == "hints")
+                {
+                    options.events.hints = true;
+                }
+                else if (item == "faces")
+                {
+                    options.events.facesDetected = true;
+                }
+                else if (item != "none")
+                {
+                    return false;
+                }
+            }
+        }
+        else if (::strcmp(name, "--face-interval") == 0 && parse_number(value, number) && number <= 65535)
+        {
+            options.events.faceDetectedIntervalMs = number;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !options.suites.empty() && !options.baudrates.empty();
+}
+
+double elapsed_ms_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+double mean(const std::vector<double>& values)
+{
+    double total = 0;
+    for (auto value : values)
+    {
+        total += value;
+    }
+    return values.empty() ? 0 : total / values.size();
+}
+
+// split the mean latency of the case by the metrics recorded since the last Metrics::Reset()
+void set_split(CaseResult& result, const RealSenseID::Metrics::Snapshot& snapshot)
+{
+    if (result.latencies_ms.empty())
+    {
+        return;
+    }
+    auto ops = static_cast<double>(result.latencies_ms.size());
+    result.has_split = true;
+    result.device_ms = snapshot.Get(Latency::DeviceWait).sumUs / 1000.0 / ops;
+    result.wire_ms = snapshot.Get(Latency::PacketTransfer).sumUs / 1000.0 / ops;
+    result.session_ms = snapshot.Get(Latency::SessionSetup).sumUs / 1000.0 / ops;
+    result.host_ms = std::max(0.0, mean(result.latencies_ms) - result.device_ms);
+}
+
+// run the case's operations between a metrics reset and snapshot. body(result) records the operations.
+template <typename Body>
+CaseResult run_case(const char* suite, const char* name, const std::string& param, Body body)
+{
+    std::cerr << suite << ": " << name << (param.empty() ? "" : " ") << param << std::endl;
+    CaseResult result;
+    result.suite = suite;
+    result.name = name;
+    result.param = param;
+
+    RealSenseID::Metrics::Reset();
+    auto start = clock_type::now();
+    body(result);
+    result.elapsed_ms = elapsed_ms_since(start);
+    set_split(result, RealSenseID::Metrics::GetSnapshot());
+    return result;
+}
+
+// run the operation and record its latency and status
+template <typename Operation>
+RealSenseID::Status measure(CaseResult& result, Operation operation)
+{
+    auto start = clock_type::now();
+    auto status = operation();
+    result.latencies_ms.push_back(elapsed_ms_since(start));
+    if (status != RealSenseID::Status::Ok)
+    {
+        result.errors++;
+    }
+    return status;
+}
+
+RealSenseID::Faceprints synthetic_faceprints(std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> dist(-1023, 1023);
+    RealSenseID::Faceprints faceprints;
+    faceprints.numberOfDescriptors = 1;
+    for (size_t i = 0; i < RealSenseID::FEATURES_VECTOR_ALLOC_SIZE; i++)
+    {
+        faceprints.avgDescriptor[i] = static_cast<RealSenseID::feature_t>(dist(rng));
+        faceprints.origDescriptor[i] = faceprints.avgDescriptor[i];
+    }
+    return faceprints;
+}
+
+class UserIdsCollector : public RealSenseID::UserIdsCallback
+{
+public:
+    std::vector<std::string> user_ids;
+
+    void OnUserId(const char* user_id) override
+    {
+        user_ids.emplace_back(user_id);
+    }
+};
+
+// time to the first hint and to the result of an authentication
+class PerfAuthClbk : public RealSenseID::AuthenticationCallback
+{
+public:
+    explicit PerfAuthClbk(clock_type::time_point start) : _start {start}
+    {
+    }
+
+    RealSenseID::AuthenticateStatus result = RealSenseID::AuthenticateStatus::Failure;
+    double first_hint_ms = -1;
+
+    void OnResult(const RealSenseID::AuthenticateStatus status, const char*) override
+    {
+        result = status;
+    }
+
+    void OnHint(const RealSenseID::AuthenticateStatus) override
+    {
+        if (first_hint_ms < 0)
+        {
+            first_hint_ms = elapsed_ms_since(_start);
+        }
+    }
+
+private:
+    clock_type::time_point _start;
+};
+
+void ping_suite(const PerfOptions& options, std::vector<CaseResult>& results)
+{
+    for (auto baudrate : options.baudrates)
+    {
+        results.push_back(run_case("ping", "ping", "baudrate=" + std::to_string(baudrate), [&](CaseResult& result) {
+            RealSenseID::DeviceController device_controller;
+            RealSenseID::SerialConfig config {options.port.c_str(), baudrate};
+            if (device_controller.Connect(config) != RealSenseID::Status::Ok)
+            {
+                result.errors = options.iterations;
+                return;
+            }
+            for (unsigned int i = 0; i < options.iterations; i++)
+            {
+                measure(result, [&] { return device_controller.Ping(); });
+            }
+        }));
+    }
+}
+
+void session_suite(RealSenseID::FaceAuthenticator& authenticator, const PerfOptions& options,
+                   std::vector<CaseResult>& results)
+{
+#ifdef RSID_SECURE
+    const std::string mode = "mode=secure";
+#else
+    const std::string mode = "mode=non-secure";
+#endif // RSID_SECURE
+
+    // the smallest device operation, once with a new session each and once reusing an open session
+    auto query = [&](CaseResult& result) {
+        unsigned int number_of_users = 0;
+        for (unsigned int i = 0; i < options.iterations; i++)
+        {
+            measure(result, [&] { return authenticator.QueryNumberOfUsers(number_of_users, true); });
+        }
+    };
+    authenticator.SetSessionReuseTimeout(0);
+    results.push_back(run_case("session", "new-session", mode, query));
+    authenticator.SetSessionReuseTimeout(60 * 1000);
+    results.push_back(run_case("session", "reused-session", mode, query));
+    authenticator.SetSessionReuseTimeout(0);
+}
+
+// users and features suites. stores the synthetic users first and removes them at the end.
+void users_suites(RealSenseID::FaceAuthenticator& authenticator, const PerfOptions& options,
+                  std::vector<CaseResult>& results)
+{
+    std::vector<std::string> synthetic_ids;
+    for (unsigned int i = 0; i < options.users; i++)
+    {
+        synthetic_ids.push_back(SYNTHETIC_USER_PREFIX + std::to_string(i));
+    }
+
+    if (!synthetic_ids.empty())
+    {
+        std::mt19937 rng {2021};
+        auto result = run_case("features", "set-user-features", "users=" + std::to_string(synthetic_ids.size()),
+                               [&](CaseResult& result) {
+                                   for (const auto& user_id : synthetic_ids)
+                                   {
+                                       auto faceprints = synthetic_faceprints(rng);
+                                       measure(result, [&] {
+                                           return authenticator.SetUserFeatures(user_id.c_str(), faceprints);
+                                       });
+                                   }
+                               });
+        if (options.Runs("features"))
+        {
+            results.push_back(result);
+        }
+    }
+
+    UserIdsCollector enrolled;
+    if (authenticator.QueryUserIds(enrolled, true) != RealSenseID::Status::Ok)
+    {
+        std::cerr << "Failed querying the user ids" << std::endl;
+    }
+    const auto users_param = "users=" + std::to_string(enrolled.user_ids.size());
+
+    if (options.Runs("users"))
+    {
+        results.push_back(run_case("users", "query-user-ids", users_param, [&](CaseResult& result) {
+            for (unsigned int i = 0; i < options.iterations; i++)
+            {
+                UserIdsCollector collector;
+                measure(result, [&] { return authenticator.QueryUserIds(collector, true); });
+            }
+        }));
+        results.push_back(run_case("users", "query-number-of-users", users_param, [&](CaseResult& result) {
+            unsigned int number_of_users = 0;
+            for (unsigned int i = 0; i < options.iterations; i++)
+            {
+                measure(result, [&] { return authenticator.QueryNumberOfUsers(number_of_users, true); });
+            }
+        }));
+    }
+
+    if (options.Runs("features") && !enrolled.user_ids.empty())
+    {
+        results.push_back(run_case("features", "get-user-features", users_param, [&](CaseResult& result) {
+            RealSenseID::Faceprints faceprints;
+            for (const auto& user_id : enrolled.user_ids)
+            {
+                measure(result, [&] { return authenticator.GetUserFeatures(user_id.c_str(), faceprints); });
+            }
+        }));
+    }
+
+    for (const auto& user_id : synthetic_ids)
+    {
+        authenticator.RemoveUser(user_id.c_str());
+    }
+}
+
+void auth_suite(RealSenseID::FaceAuthenticator& authenticator, const PerfOptions& options,
+                std::vector<CaseResult>& results)
+{
+    std::cerr << "auth: look at the camera" << std::endl;
+    CaseResult first_hint;
+    auto result = run_case("auth", "time-to-result", "", [&](CaseResult& result) {
+        for (unsigned int i = 0; i < options.iterations; i++)
+        {
+            PerfAuthClbk callback {clock_type::now()};
+            auto status = measure(result, [&] { return authenticator.Authenticate(callback); });
+            if (status == RealSenseID::Status::Ok && callback.result != RealSenseID::AuthenticateStatus::Success)
+            {
+                result.failures++;
+            }
+            if (callback.first_hint_ms >= 0)
+            {
+                first_hint.latencies_ms.push_back(callback.first_hint_ms);
+            }
+        }
+    });
+
+    // the hints arrive within the measured authentications, so their time only has the result's split
+    first_hint.suite = "auth";
+    first_hint.name = "time-to-first-hint";
+    first_hint.elapsed_ms = result.elapsed_ms;
+    results.push_back(first_hint);
+    results.push_back(result);
+}
+
+#ifdef RSID_PREVIEW
+// capture to delivery latency of the preview images, split at the dequeue from the camera driver
+class PerfPreviewClbk : public RealSenseID::PreviewImageReadyCallback
+{
+public:
+    void OnPreviewImageReady(const RealSenseID::Image image) override
+    {
+        const auto& timing = image.timing;
+        auto start = timing.captureOnHostClock ? timing.captureTimestamp : timing.dequeueTime;
+        std::lock_guard<std::mutex> lock {_mutex};
+        latencies_ms.push_back((timing.deliveredTime - start) / 1000.0);
+        host_ms.push_back((timing.deliveredTime - timing.dequeueTime) / 1000.0);
+        if (timing.captureOnHostClock)
+        {
+            camera_ms.push_back((timing.dequeueTime - timing.captureTimestamp) / 1000.0);
+        }
+    }
+
+    std::vector<double> latencies_ms;
+    std::vector<double> host_ms;
+    std::vector<double> camera_ms;
+
+private:
+    std::mutex _mutex;
+};
+
+void preview_suite(const PerfOptions& options, std::vector<CaseResult>& results)
+{
+    std::cerr << "preview: " << options.preview_seconds << " seconds" << std::endl;
+    RealSenseID::PreviewConfig config;
+    config.cameraNumber = options.camera;
+    if (options.preview_mode == "fhd-rect")
+        config.previewMode = RealSenseID::PreviewMode::FHD_Rect;
+    else if (options.preview_mode == "dump")
+        config.previewMode = RealSenseID::PreviewMode::Dump;
+    if (!options.playback_path.empty())
+    {
+        config.playbackPath = options.playback_path.c_str();
+        config.playbackRealtime = options.playback_realtime;
+    }
+    RealSenseID::Preview preview {config};
+    PerfPreviewClbk callback;
+
+    CaseResult result;
+    result.suite = "preview";
+    result.name = "capture-to-delivery";
+    auto start = clock_type::now();
+    if (!preview.StartPreview(callback))
+    {
+        result.errors = 1;
+        results.push_back(result);
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::seconds {options.preview_seconds});
+    preview.StopPreview();
+    result.elapsed_ms = elapsed_ms_since(start);
+
+    // the camera's share is the capture to dequeue time, known only for drivers with host clock timestamps
+    auto statistics = preview.GetStatistics();
+    result.failures = statistics.dropped;
+    result.latencies_ms = std::move(callback.latencies_ms);
+    result.param = "frames=" + std::to_string(statistics.delivered);
+    result.has_split = !result.latencies_ms.empty();
+    result.device_ms = mean(callback.camera_ms);
+    result.host_ms = mean(callback.host_ms);
+    results.push_back(result);
+}
+#endif // RSID_PREVIEW
+
+struct ReportRow
+{
+    const CaseResult* result = nullptr;
+    double throughput = 0; // ops (preview: frames) per second of the case
+    double mean_ms = 0;
+    double p50_ms = 0;
+    double p90_ms = 0;
+    double p99_ms = 0;
+    double max_ms = 0;
+};
+
+ReportRow make_row(const CaseResult& result)
+{
+    ReportRow row;
+    row.result = &result;
+    if (result.latencies_ms.empty())
+    {
+        return row;
+    }
+    auto sorted = result.latencies_ms;
+    std::sort(sorted.begin(), sorted.end());
+    row.throughput = result.elapsed_ms > 0 ? sorted.size() * 1000.0 / result.elapsed_ms : 0;
+    row.mean_ms = mean(sorted);
+    row.p50_ms = percentile(sorted, 50);
+    row.p90_ms = percentile(sorted, 90);
+    row.p99_ms = percentile(sorted, 99);
+    row.max_ms = sorted.back();
+    return row;
+}
+
+void write_csv(std::ostream& out, const std::vector<ReportRow>& rows)
+{
+    out << "suite,case,param,count,errors,failures,throughput_ops,mean_ms,p50_ms,p90_ms,p99_ms,max_ms,device_ms,wire_ms,"
+           "session_ms,host_ms\n";
+    for (const auto& row : rows)
+    {
+        const auto& result = *row.result;
+        out << result.suite << ',' << result.name << ',' << result.param << ',' << result.latencies_ms.size() << ','
+            << result.errors << ',' << result.failures << ',' << row.throughput << ',' << row.mean_ms << ','
+            << row.p50_ms << ',' << row.p90_ms << ',' << row.p99_ms << ',' << row.max_ms;
+        if (result.has_split)
+        {
+            out << ',' << result.device_ms << ',' << result.wire_ms << ',' << result.session_ms << ','
+                << result.host_ms << '\n';
+        }
+        else
+        {
+            out << ",,,,\n";
+        }
+    }
+}
+
+void write_json(std::ostream& out, const std::vector<ReportRow>& rows, const PerfOptions& options, double elapsed_ms)
+{
+#ifdef RSID_SECURE
+    const bool secure = true;
+#else
+    const bool secure = false;
+#endif // RSID_SECURE
+    out << "{\n  \"secure\": " << (secure ? "true" : "false") << ",\n  \"iterations\": " << options.iterations
+        << ",\n  \"elapsed_ms\": " << elapsed_ms << ",\n  \"cases\": [";
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const auto& row = rows[i];
+        const auto& result = *row.result;
+        out << (i == 0 ? "\n" : ",\n") << "    {\"suite\": \"" << result.suite << "\", \"case\": \"" << result.name
+            << "\", \"param\": \"" << result.param << "\", \"count\": " << result.latencies_ms.size()
+            << ", \"errors\": " << result.errors << ", \"failures\": " << result.failures
+            << ", \"throughput_ops\": " << row.throughput << ", \"mean_ms\": " << row.mean_ms
+            << ", \"p50_ms\": " << row.p50_ms << ", \"p90_ms\": " << row.p90_ms << ", \"p99_ms\": " << row.p99_ms
+            << ", \"max_ms\": " << row.max_ms;
+        if (result.has_split)
+        {
+            out << ", \"device_ms\": " << result.device_ms << ", \"wire_ms\": " << result.wire_ms
+                << ", \"session_ms\": " << result.session_ms << ", \"host_ms\": " << result.host_ms;
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    PerfOptions options;
+    if (!options_from_argv(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+
+    // keep the report on stdout clean, library warnings and errors go to stderr
+    RealSenseID::SetLogCallback([](RealSenseID::LogLevel, const char* msg) { std::cerr << msg << std::endl; },
+                                RealSenseID::LogLevel::Warning, true);
+    if (!options.trace_path.empty())
+    {
+        RealSenseID::Trace::Start();
+    }
+
+    std::vector<CaseResult> results;
+    auto start = clock_type::now();
+
+    // the ping suite has its own connections, before the authenticator's
+    if (options.Runs("ping"))
+    {
+        ping_suite(options, results);
+    }
+
+    if (options.Runs("session") || options.Runs("users") || options.Runs("features") || options.Runs("auth"))
+    {
+#ifdef RSID_SECURE
+        RealSenseID::FaceAuthenticator authenticator {&s_signer};
+#else
+        RealSenseID::FaceAuthenticator authenticator;
+#endif // RSID_SECURE
+        RealSenseID::SerialConfig config {options.port.c_str()};
+        auto connect_status = authenticator.Connect(config);
+        if (connect_status != RealSenseID::Status::Ok)
+        {
+            std::cerr << "Failed connecting to port " << options.port << " status:" << connect_status << std::endl;
+            return 1;
+        }
+        authenticator.SetEventSubscription(options.events);
+        if (options.Runs("session"))
+        {
+            session_suite(authenticator, options, results);
+        }
+        if (options.Runs("users") || options.Runs("features"))
+        {
+            users_suites(authenticator, options, results);
+        }
+        if (options.Runs("auth"))
+        {
+            auth_suite(authenticator, options, results);
+        }
+    }
+
+    if (options.Runs("preview"))
+    {
+#ifdef RSID_PREVIEW
+        preview_suite(options, results);
+#else
+        std::cerr << "preview: skipped, rsid-perf was built without RSID_PREVIEW" << std::endl;
+#endif // RSID_PREVIEW
+    }
+    auto elapsed_ms = elapsed_ms_since(start);
+
+    if (!options.trace_path.empty())
+    {
+        RealSenseID::Trace::Stop();
+        if (!RealSenseID::Trace::WriteChromeJson(options.trace_path.c_str()))
+        {
+            std::cerr << "Failed writing trace " << options.trace_path << std::endl;
+        }
+    }
+
+    std::vector<ReportRow> rows;
+    unsigned int all_errors = 0;
+    for (const auto& result : results)
+    {
+        rows.push_back(make_row(result));
+        all_errors += result.errors + result.failures;
+    }
+
+    std::ofstream file;
+    if (!options.output_path.empty())
+    {
+        file.open(options.output_path);
+        if (!file)
+        {
+            std::cerr << "Failed opening report " << options.output_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.output_path.empty() ? std::cout : file;
+    if (options.json)
+    {
+        write_json(out, rows, options, elapsed_ms);
+    }
+    else
+    {
+        write_csv(out, rows);
+    }
+    return all_errors > 0 ? 2 : 0;
+}
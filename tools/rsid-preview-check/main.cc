@@ -0,0 +1,828 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Correctness check of the preview conversions (StreamConverter) on sample frames, to validate ports and
+// optimizations of the conversion kernels without a camera. Throughput is measured by rsid-bench.
+// Usage:
+//   rsid-preview-check record <dir>
+//   rsid-preview-check run [<dir>] [--min-psnr <db>]
+//
+// Sample frames: vga.yuyv (704x1280 YUYV, VGA mode) and fhd.raw10 (1920x1080 RAW10 with its metadata header,
+// FHD_Rect mode), raw bytes as delivered by the camera. Without a dir, or for frames missing in it, built-in synthetic
+// frames are used (gradients, edges, saturating colors and noise of a fixed seed).
+// record writes the frames missing in dir (recorded frames placed there are kept) and the outputs of this build as the
+// golden outputs: vga_rgb.golden, vga_rgba.golden, vga_bgra.golden, fhd_rgb.golden (VGA_PIXEL_SIZE bytes per pixel)
+// and fhd_metadata.golden (text).
+// run checks:
+//   kernel   - every yuyv to rgb (per layout) and raw10 unpack kernel the cpu supports, bit-exact to the scalar one
+//   reference - the conversions vs. the original (pre-kernels) StreamConverter, reimplemented here: every yuyv to rgb
+//              kernel on all the yuv values and Yuv2Rgb per layout on the vga frame within YUV_REFERENCE_BOUND per
+//              channel of the original's double precision formula, RotatedRaw2Rgb's colors bit-exact to the
+//              original's demosaic
+//   golden   - Yuv2Rgb per layout, RotatedRaw2Rgb on the calling thread and on a thread pool and ExtractMetadata vs.
+//              the golden outputs of dir (bit-exact, or a PSNR of at least --min-psnr if given), or vs. the built-in
+//              hashes of the outputs of the built-in frames
+//   gpu      - with RSID_PREVIEW_GPU, the PreviewGpuConverter textures of both frames bit-exact to Yuv2Rgb (rgba) and
+//              RotatedRaw2Rgb, on a surfaceless EGL context (skip if none can be created)
+// The report is csv: check,name,isa,result (pass, FAIL or skip),detail.
+//
+// Returns 0 if all the checks passed, 1 on invalid arguments or if a file could not be read or written, 2 if any
+// check failed.
+
+#include "StreamConverter.h"
+#include "YuvKernels.h"
+#include "MatcherThreadPool.h"
+#ifdef RSID_PREVIEW_GPU
+#include "PreviewGpuConverterImpl.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using RealSenseID::Image;
+using RealSenseID::ImageMetadata;
+using RealSenseID::MatcherThreadPool;
+using namespace RealSenseID::Capture;
+using bytes = std::vector<unsigned char>;
+
+namespace
+{
+const size_t VGA_PIXELS = static_cast<size_t>(VGA_WIDTH) * VGA_HEIGHT;
+const size_t RAW_PIXELS = static_cast<size_t>(RAW_WIDTH) * RAW_HEIGHT;
+const size_t VGA_FRAME_SIZE = VGA_PIXELS * YUV_PIXEL_SIZE;
+const size_t RAW_FRAME_SIZE = RAW_PIXELS / 4 * 5;
+const unsigned int RAW_POOL_THREADS = 4;
+
+// metadata header of the built-in raw frame (the face rect is stored at half resolution)
+const int32_t SAMPLE_TIMESTAMP = 123456;
+const unsigned char SAMPLE_STATUS = 1;
+const unsigned char SAMPLE_FLAGS = 0x5; // sensor 1, led off, projector on
+const int32_t SAMPLE_FACE[4] = {200, 300, 150, 180};
+
+const YuvKernels::RgbLayout LAYOUTS[] = {YuvKernels::RgbLayout::Rgb, YuvKernels::RgbLayout::Rgba,
+                                         YuvKernels::RgbLayout::Bgra};
+const char* const LAYOUT_NAMES[] = {"rgb", "rgba", "bgra"};
+
+// fnv-1a of the outputs of the built-in frames, as printed by record. A change of the output of any conversion must
+// update them (and explain why in its commit). They are the outputs of this build, tied to the original conversions
+// by the reference checks. The raw conversion's hash is of the 3 bytes per pixel platforms, with
+// 4 bytes per pixel (Android) it is checked against recorded golden outputs only.
+const uint64_t BUILTIN_VGA_HASHES[] = {0xd1cc28887fc6c29aull, 0x2a22e97a6f9a49a2ull, 0xac4aaa16c0e955ceull};
+const uint64_t BUILTIN_FHD_HASH = VGA_PIXEL_SIZE == RGB_PIXEL_SIZE ? 0x9184a1899eac7014ull : 0;
+
+// max difference per channel of the fixed point yuyv conversion to the original double precision one: the
+// coefficients are rounded to 1/65536 and the terms to 1/128, which may round a value across an integer
+const int YUV_REFERENCE_BOUND = 1;
+
+struct CheckOptions
+{
+    std::string command;
+    std::string dir;
+    double min_psnr = 0; // 0 - bit-exact
+};
+
+struct Frames
+{
+    bytes vga;
+    bytes fhd;
+    bool builtin_vga = true;
+    bool builtin_fhd = true;
+};
+
+struct Report
+{
+    int failed = 0;
+
+    void Add(const char* check, const std::string& name, const char* isa, bool passed, const std::string& detail)
+    {
+        std::cout << check << "," << name << "," << isa << "," << (passed ? "pass" : "FAIL") << "," << detail
+                  << std::endl;
+        if (!passed)
+        {
+            failed++;
+        }
+    }
+};
+
+void print_usage()
+{
+    std::cout << "Usage: rsid-preview-check record <dir>\n"
+                 "       rsid-preview-check run [<dir>] [--min-psnr <db>]"
+              << std::endl;
+}
+
+bool options_from_argv(int argc, char* argv[], CheckOptions& options)
+{
+    if (argc < 2)
+    {
+        return false;
+    }
+    options.command = argv[1];
+    int i = 2;
+    if (i < argc && ::strncmp(argv[i], "--", 2) != 0)
+    {
+        options.dir = argv[i++];
+    }
+    if (options.command == "record")
+    {
+        return !options.dir.empty() && i == argc;
+    }
+    if (options.command != "run")
+    {
+        return false;
+    }
+    for (; i < argc; i++)
+    {
+        if (::strcmp(argv[i], "--min-psnr") == 0 && i + 1 < argc)
+        {
+            char* end = nullptr;
+            options.min_psnr = std::strtod(argv[++i], &end);
+            if (*end != '\0' || options.min_psnr <= 0)
+            {
+                return false;
+            }
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+uint64_t fnv1a(const bytes& data)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (auto b : data)
+    {
+        hash = (hash ^ b) * 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string hex(uint64_t value)
+{
+    std::ostringstream text;
+    text << "0x" << std::hex << value;
+    return text.str();
+}
+
+bool read_file(const std::string& path, bytes& data)
+{
+    std::ifstream file {path, std::ios::binary};
+    if (!file)
+    {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool write_file(const std::string& path, const bytes& data)
+{
+    std::ofstream file {path, std::ios::binary};
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file.flush())
+    {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string path_of(const std::string& dir, const char* name)
+{
+    return dir + "/" + name;
+}
+
+unsigned char clamp_byte(int value)
+{
+    return static_cast<unsigned char>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// face-like scene: a horizontal luma gradient, colored vertical bands with hard edges, a block of saturating chroma
+// and noise
+bytes make_vga_frame()
+{
+    std::mt19937 rng(2021);
+    bytes frame(VGA_FRAME_SIZE);
+    for (unsigned int y = 0; y < VGA_HEIGHT; y++)
+    {
+        for (unsigned int x = 0; x < VGA_WIDTH; x += 2)
+        {
+            unsigned char* pair = &frame[(static_cast<size_t>(y) * VGA_WIDTH + x) * YUV_PIXEL_SIZE];
+            const int band = static_cast<int>(x / 88);
+            const int noise = static_cast<int>(rng() % 17) - 8;
+            pair[0] = clamp_byte(static_cast<int>(x * 255 / VGA_WIDTH) + noise);
+            pair[2] = clamp_byte(static_cast<int>((x + 1) * 255 / VGA_WIDTH) - noise);
+            pair[1] = clamp_byte(128 + (band - 4) * 30 + static_cast<int>(y % 64) - 32);
+            pair[3] = clamp_byte(128 - (band - 4) * 30);
+            if (y >= 1000 && y < 1100)
+            {
+                // saturating chroma and luma
+                pair[1] = (x / 8) % 2 ? 0 : 255;
+                pair[3] = (x / 16) % 2 ? 255 : 0;
+                pair[0] = (y % 2) ? 0 : 255;
+            }
+        }
+    }
+    return frame;
+}
+
+// bayer image of a smooth scene with noise and 10 bit lsbs, with the metadata header over its first bytes
+bytes make_fhd_frame()
+{
+    std::mt19937 rng(2022);
+    bytes frame(RAW_FRAME_SIZE);
+    const size_t line = RAW_WIDTH / 4 * 5;
+    for (unsigned int y = 0; y < RAW_HEIGHT; y++)
+    {
+        for (unsigned int x = 0; x < RAW_WIDTH; x += 4)
+        {
+            unsigned char* group = &frame[y * line + x / 4 * 5];
+            for (unsigned int k = 0; k < 4; k++)
+            {
+                const int channel = static_cast<int>(((x + k) & 1) + (y & 1));
+                const int scene = static_cast<int>((x + k) * 200 / RAW_WIDTH + y * 55 / RAW_HEIGHT);
+                const int value = scene * (channel + 1) / 2 + static_cast<int>(rng() % 9) - 4;
+                group[k] = clamp_byte(value);
+            }
+            group[4] = static_cast<unsigned char>(rng());
+        }
+    }
+
+    unsigned char* header = frame.data();
+    ::memcpy(header, &SAMPLE_TIMESTAMP, 4);
+    header[4] = SAMPLE_STATUS;
+    header[5] = SAMPLE_FLAGS;
+    header[6] = 1;
+    ::memcpy(header + 7, SAMPLE_FACE, sizeof(SAMPLE_FACE));
+    return frame;
+}
+
+bool load_frames(const std::string& dir, Frames& frames)
+{
+    frames.builtin_vga = dir.empty() || !read_file(path_of(dir, "vga.yuyv"), frames.vga);
+    frames.builtin_fhd = dir.empty() || !read_file(path_of(dir, "fhd.raw10"), frames.fhd);
+    if (frames.builtin_vga)
+    {
+        frames.vga = make_vga_frame();
+    }
+    if (frames.builtin_fhd)
+    {
+        frames.fhd = make_fhd_frame();
+    }
+    if (frames.vga.size() != VGA_FRAME_SIZE || frames.fhd.size() != RAW_FRAME_SIZE)
+    {
+        std::cerr << "Sample frames must be " << VGA_FRAME_SIZE << " bytes (vga.yuyv) and " << RAW_FRAME_SIZE
+                  << " bytes (fhd.raw10)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// the original StreamConverter's Yuv2Rgb: BT.601 in double precision, clamped and truncated to bytes
+unsigned char reference_channel(double value)
+{
+    return static_cast<unsigned char>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+void reference_yuyv_to_rgb(const unsigned char* yuyv, unsigned char* rgb, size_t n_pixels, YuvKernels::RgbLayout layout)
+{
+    const unsigned int pixel_size = YuvKernels::PixelSize(layout);
+    const int r_pos = layout == YuvKernels::RgbLayout::Bgra ? 2 : 0;
+    for (size_t i = 0; i < n_pixels; i++, rgb += pixel_size)
+    {
+        const unsigned char* pair = yuyv + i / 2 * 4;
+        const int y = pair[i % 2 * 2];
+        const int cb = pair[1];
+        const int cr = pair[3];
+        rgb[r_pos] = reference_channel(y + (1.4065 * (cr - 128)));
+        rgb[1] = reference_channel(y - (0.3455 * (cb - 128)) - (0.7169 * (cr - 128)));
+        rgb[2 - r_pos] = reference_channel(y + (1.7790 * (cb - 128)));
+        if (pixel_size == 4)
+        {
+            rgb[3] = 255;
+        }
+    }
+}
+
+// the original StreamConverter's RotatedRaw2Rgb: bilinear demosaic of the raw8 bytes (the 10 bit lsbs dropped),
+// rotated 90 degrees clockwise, in VGA_PIXEL_SIZE bytes per pixel (the alpha is left unset)
+bytes reference_raw10_to_rgb(const bytes& raw10)
+{
+    bytes rgb(RAW_PIXELS * VGA_PIXEL_SIZE);
+    const unsigned int src_height = RAW_HEIGHT, src_width = RAW_WIDTH;
+    const unsigned int dst_height = src_width, dst_width = src_height;
+    const int line = static_cast<int>(raw10.size() / src_height);
+    const unsigned char* src = raw10.data();
+    unsigned int src_x = 0, src_y = 0;
+    unsigned int dst_x = dst_width - 1, dst_y = dst_height - 1;
+    for (int i = 0; i < static_cast<int>(raw10.size()); i++)
+    {
+        int hnext = 1, hprev = 1;
+        switch (i % 5)
+        {
+        case 0:
+            hprev = 2;
+            break;
+        case 3:
+            hnext = 2;
+            break;
+        case 4:
+            continue;
+        }
+        int p[8] = {i - line - hprev, i - line, i - line + hnext, i - hprev,
+                    i + hnext,        i + line - hprev, i + line, i + line + hnext};
+        if (src_y == 0)
+        {
+            p[0] = p[5];
+            p[1] = p[6];
+            p[2] = p[7];
+        }
+        else if (src_y == src_height - 1)
+        {
+            p[5] = p[0];
+            p[6] = p[1];
+            p[7] = p[2];
+        }
+        if (src_x == 0)
+        {
+            p[0] = p[2];
+            p[3] = p[4];
+            p[5] = p[7];
+        }
+        else if (src_x == src_width - 1)
+        {
+            p[2] = p[0];
+            p[4] = p[3];
+            p[7] = p[5];
+        }
+
+        const unsigned char hn = static_cast<unsigned char>((src[p[3]] + src[p[4]]) / 2);
+        const unsigned char vn = static_cast<unsigned char>((src[p[1]] + src[p[6]]) / 2);
+        const unsigned char di = static_cast<unsigned char>((src[p[0]] + src[p[2]] + src[p[5]] + src[p[7]]) / 4);
+        unsigned char br0, br1, g;
+        if ((src_x + src_y) & 1)
+        {
+            g = src[i];
+            br1 = (src_y & 1) ? hn : vn;
+            br0 = (src_y & 1) ? vn : hn;
+        }
+        else if (src_y & 1)
+        {
+            br1 = src[i];
+            g = static_cast<unsigned char>((vn + hn) / 2);
+            br0 = di;
+        }
+        else
+        {
+            br0 = src[i];
+            g = static_cast<unsigned char>((vn + hn) / 2);
+            br1 = di;
+        }
+        unsigned char* pixel = &rgb[VGA_PIXEL_SIZE * (static_cast<size_t>(dst_y) * dst_width + dst_x)];
+        pixel[0] = br1;
+        pixel[1] = g;
+        pixel[2] = br0;
+
+        dst_y--;
+        if (++src_x == src_width)
+        {
+            src_x = 0;
+            src_y++;
+            dst_y = dst_height - 1;
+            dst_x--;
+        }
+    }
+    return rgb;
+}
+
+// every yuv value: the pairs (y, u, 255 - y, v) for y up to 127
+bytes make_yuv_sweep()
+{
+    bytes yuyv(128 * 256 * 256 * 4);
+    unsigned char* pair = yuyv.data();
+    for (int y = 0; y < 128; y++)
+    {
+        for (int u = 0; u < 256; u++)
+        {
+            for (int v = 0; v < 256; v++, pair += 4)
+            {
+                pair[0] = static_cast<unsigned char>(y);
+                pair[1] = static_cast<unsigned char>(u);
+                pair[2] = static_cast<unsigned char>(255 - y);
+                pair[3] = static_cast<unsigned char>(v);
+            }
+        }
+    }
+    return yuyv;
+}
+
+// max difference of the channels of a and b, of pixel_size bytes per pixel, of which the first channels are compared
+int max_channel_error(const bytes& a, const bytes& b, unsigned int pixel_size, unsigned int channels)
+{
+    int max_error = 0;
+    for (size_t i = 0; i < a.size(); i += pixel_size)
+    {
+        for (unsigned int c = 0; c < channels; c++)
+        {
+            max_error = std::max(max_error, std::abs(static_cast<int>(a[i + c]) - b[i + c]));
+        }
+    }
+    return max_error;
+}
+
+bytes convert_vga(bytes yuyv, YuvKernels::RgbLayout layout)
+{
+    bytes rgb(VGA_PIXELS * YuvKernels::PixelSize(layout));
+    Image image;
+    image.buffer = rgb.data();
+    image.size = static_cast<unsigned int>(rgb.size());
+    Yuv2Rgb(&image, yuyv.data(), static_cast<unsigned int>(yuyv.size()), layout);
+    return rgb;
+}
+
+bytes convert_fhd(bytes raw10, MatcherThreadPool* pool)
+{
+    bytes rgb(RAW_PIXELS * VGA_PIXEL_SIZE);
+    Image image;
+    image.buffer = rgb.data();
+    image.width = RAW_WIDTH;
+    image.height = RAW_HEIGHT;
+    RotatedRaw2Rgb(&image, raw10.data(), static_cast<unsigned int>(raw10.size()), pool);
+    return rgb;
+}
+
+std::string metadata_text(const ImageMetadata& md)
+{
+    std::ostringstream text;
+    text << md.timestamp << " " << md.status << " " << md.sensor_id << " " << md.led << " " << md.projector << " "
+         << md.face_rect.x << " " << md.face_rect.y << " " << md.face_rect.width << " " << md.face_rect.height;
+    return text.str();
+}
+
+double psnr(const bytes& a, const bytes& b)
+{
+    double squared = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        const double diff = static_cast<double>(a[i]) - b[i];
+        squared += diff * diff;
+    }
+    if (squared == 0)
+    {
+        return INFINITY;
+    }
+    return 10 * std::log10(255.0 * 255.0 * a.size() / squared);
+}
+
+// output vs. its golden image (bit-exact or psnr bound) or the built-in hash (0 - none)
+void check_golden(Report& report, const std::string& name, const bytes& output, const bytes* golden,
+                  uint64_t builtin_hash, double min_psnr)
+{
+    if (golden == nullptr && builtin_hash == 0)
+    {
+        std::cout << "golden," << name << ",best,skip,no built-in hash for " << VGA_PIXEL_SIZE << " bytes per pixel"
+                  << std::endl;
+        return;
+    }
+    if (golden == nullptr)
+    {
+        const uint64_t hash = fnv1a(output);
+        report.Add("golden", name, "best", hash == builtin_hash,
+                   "hash " + hex(hash) + " expected " + hex(builtin_hash));
+        return;
+    }
+    if (golden->size() != output.size())
+    {
+        report.Add("golden", name, "best", false, "golden size " + std::to_string(golden->size()));
+        return;
+    }
+    const double value = psnr(output, *golden);
+    std::ostringstream detail;
+    detail << "psnr " << value << " dB";
+    report.Add("golden", name, "best", min_psnr > 0 ? value >= min_psnr : std::isinf(value), detail.str());
+}
+
+void check_kernels(Report& report, const Frames& frames)
+{
+    for (size_t l = 0; l < 3; l++)
+    {
+        const auto layout = LAYOUTS[l];
+        bytes reference(VGA_PIXELS * YuvKernels::PixelSize(layout));
+        YuvKernels::YuyvToRgbScalar(frames.vga.data(), reference.data(), VGA_PIXELS, layout);
+        for (const auto& kernel : YuvKernels::SupportedYuyvToRgbKernels())
+        {
+            bytes rgb(reference.size());
+            kernel.func(frames.vga.data(), rgb.data(), VGA_PIXELS, layout);
+            report.Add("kernel", std::string("yuyv_to_") + LAYOUT_NAMES[l], kernel.isa, rgb == reference,
+                       rgb == reference ? "bit-exact" : "differs from scalar");
+        }
+    }
+
+    bytes reference(RAW_PIXELS + 16); // simd kernels may write up to 16 bytes past the end
+    YuvKernels::Raw10ToRaw8Scalar(frames.fhd.data(), reference.data(), RAW_PIXELS);
+    for (const auto& kernel : YuvKernels::SupportedRaw10ToRaw8Kernels())
+    {
+        bytes raw8(reference.size());
+        kernel.func(frames.fhd.data(), raw8.data(), RAW_PIXELS);
+        const bool same = ::memcmp(raw8.data(), reference.data(), RAW_PIXELS) == 0;
+        report.Add("kernel", "raw10_to_raw8", kernel.isa, same, same ? "bit-exact" : "differs from scalar");
+    }
+}
+
+#ifdef RSID_PREVIEW_GPU
+// OpenGL ES 3.1 context without a surface, current on the calling thread while alive
+class GpuContext
+{
+public:
+    GpuContext()
+    {
+        auto get_platform_display =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (get_platform_display != nullptr)
+        {
+            _display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        if (_display == EGL_NO_DISPLAY)
+        {
+            _display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+        EGLint major = 0, minor = 0;
+        if (_display == EGL_NO_DISPLAY || !eglInitialize(_display, &major, &minor) || !eglBindAPI(EGL_OPENGL_ES_API))
+        {
+            _display = EGL_NO_DISPLAY;
+            return;
+        }
+        const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT, EGL_NONE};
+        EGLConfig config = nullptr;
+        EGLint configs = 0;
+        eglChooseConfig(_display, config_attributes, &config, 1, &configs);
+        const EGLint context_attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 1, EGL_NONE};
+        _context = eglCreateContext(_display, configs > 0 ? config : nullptr, EGL_NO_CONTEXT, context_attributes);
+        if (_context != EGL_NO_CONTEXT && !eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, _context))
+        {
+            eglDestroyContext(_display, _context);
+            _context = EGL_NO_CONTEXT;
+        }
+    }
+
+    ~GpuContext()
+    {
+        if (_context != EGL_NO_CONTEXT)
+        {
+            eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(_display, _context);
+        }
+        if (_display != EGL_NO_DISPLAY)
+        {
+            eglTerminate(_display);
+        }
+    }
+
+    GpuContext(const GpuContext&) = delete;
+    GpuContext& operator=(const GpuContext&) = delete;
+
+    bool Valid() const
+    {
+        return _context != EGL_NO_CONTEXT;
+    }
+
+private:
+    EGLDisplay _display = EGL_NO_DISPLAY;
+    EGLContext _context = EGL_NO_CONTEXT;
+};
+
+// texture of the converter vs. the cpu output of pixel_size bytes per pixel (rgb order), alpha 255
+void check_texture(Report& report, const std::string& name, const RealSenseID::PreviewGpuConverterImpl& converter,
+                   bool converted, const bytes& expected, unsigned int pixel_size)
+{
+    const size_t pixels = expected.size() / pixel_size;
+    if (!converted || static_cast<size_t>(converter.Width()) * converter.Height() != pixels)
+    {
+        report.Add("gpu", name, "gles31", false, "conversion failed");
+        return;
+    }
+    bytes rgba(pixels * RGBA_PIXEL_SIZE);
+    if (!converter.ReadPixels(rgba.data()))
+    {
+        report.Add("gpu", name, "gles31", false, "read back failed");
+        return;
+    }
+    size_t differences = 0;
+    for (size_t i = 0; i < pixels; i++)
+    {
+        const unsigned char* a = &rgba[i * RGBA_PIXEL_SIZE];
+        const unsigned char* b = &expected[i * pixel_size];
+        if (a[0] != b[0] || a[1] != b[1] || a[2] != b[2] || a[3] != 255)
+        {
+            differences++;
+        }
+    }
+    report.Add("gpu", name, "gles31", differences == 0,
+               differences == 0 ? "bit-exact" : std::to_string(differences) + " pixels differ from the cpu");
+}
+
+void check_gpu(Report& report, const Frames& frames)
+{
+    GpuContext context;
+    RealSenseID::PreviewGpuConverterImpl converter;
+    if (!context.Valid() || !converter.Init())
+    {
+        std::cout << "gpu,PreviewGpuConverter,gles31,skip,no OpenGL ES 3.1 context" << std::endl;
+        return;
+    }
+
+    bytes vga = frames.vga;
+    Image yuyv;
+    yuyv.buffer = vga.data();
+    yuyv.size = static_cast<unsigned int>(vga.size());
+    yuyv.width = VGA_WIDTH;
+    yuyv.height = VGA_HEIGHT;
+    const bool yuyv_converted = converter.ConvertYuyv(yuyv);
+    check_texture(report, "ConvertYuyv", converter, yuyv_converted,
+                  convert_vga(frames.vga, YuvKernels::RgbLayout::Rgba), RGBA_PIXEL_SIZE);
+
+    bytes fhd = frames.fhd;
+    Image raw10;
+    raw10.buffer = fhd.data();
+    raw10.size = static_cast<unsigned int>(fhd.size());
+    raw10.width = RAW_WIDTH;
+    raw10.height = RAW_HEIGHT;
+    const bool raw10_converted = converter.ConvertRaw10(raw10);
+    check_texture(report, "ConvertRaw10", converter, raw10_converted, convert_fhd(frames.fhd, nullptr),
+                  VGA_PIXEL_SIZE);
+    converter.Release();
+}
+#endif // RSID_PREVIEW_GPU
+
+int record(const CheckOptions& options)
+{
+    Frames frames;
+    if (!load_frames(options.dir, frames))
+    {
+        return 1;
+    }
+    bool written = (!frames.builtin_vga || write_file(path_of(options.dir, "vga.yuyv"), frames.vga)) &&
+                   (!frames.builtin_fhd || write_file(path_of(options.dir, "fhd.raw10"), frames.fhd));
+    const char* const golden_names[] = {"vga_rgb.golden", "vga_rgba.golden", "vga_bgra.golden"};
+    for (size_t l = 0; l < 3 && written; l++)
+    {
+        written = write_file(path_of(options.dir, golden_names[l]), convert_vga(frames.vga, LAYOUTS[l]));
+    }
+    if (written)
+    {
+        const auto fhd = convert_fhd(frames.fhd, nullptr);
+        const auto text = metadata_text(ExtractMetadata(frames.fhd.data(), static_cast<unsigned int>(RAW_FRAME_SIZE)));
+        written = write_file(path_of(options.dir, "fhd_rgb.golden"), fhd) &&
+                  write_file(path_of(options.dir, "fhd_metadata.golden"), bytes(text.begin(), text.end()));
+        if (written && frames.builtin_vga && frames.builtin_fhd)
+        {
+            // the built-in hashes, for updating the tool
+            for (size_t l = 0; l < 3; l++)
+            {
+                std::cout << "vga " << LAYOUT_NAMES[l] << " " << hex(fnv1a(convert_vga(frames.vga, LAYOUTS[l])))
+                          << std::endl;
+            }
+            std::cout << "fhd " << VGA_PIXEL_SIZE << " bytes per pixel " << hex(fnv1a(fhd)) << std::endl;
+        }
+    }
+    return written ? 0 : 1;
+}
+
+void check_reference(Report& report, const Frames& frames)
+{
+    const bytes sweep = make_yuv_sweep();
+    const size_t sweep_pixels = sweep.size() / YUV_PIXEL_SIZE;
+    for (size_t l = 0; l < 3; l++)
+    {
+        const auto layout = LAYOUTS[l];
+        const unsigned int pixel_size = YuvKernels::PixelSize(layout);
+        bytes reference(sweep_pixels * pixel_size);
+        reference_yuyv_to_rgb(sweep.data(), reference.data(), sweep_pixels, layout);
+        for (const auto& kernel : YuvKernels::SupportedYuyvToRgbKernels())
+        {
+            bytes rgb(reference.size());
+            kernel.func(sweep.data(), rgb.data(), sweep_pixels, layout);
+            const int error = max_channel_error(rgb, reference, pixel_size, pixel_size);
+            report.Add("reference", std::string("yuyv_to_") + LAYOUT_NAMES[l], kernel.isa,
+                       error <= YUV_REFERENCE_BOUND, "max error " + std::to_string(error) + " on all yuv values");
+        }
+
+        bytes frame_reference(VGA_PIXELS * pixel_size);
+        reference_yuyv_to_rgb(frames.vga.data(), frame_reference.data(), VGA_PIXELS, layout);
+        const int error = max_channel_error(convert_vga(frames.vga, layout), frame_reference, pixel_size, pixel_size);
+        report.Add("reference", std::string("Yuv2Rgb_") + LAYOUT_NAMES[l], "best", error <= YUV_REFERENCE_BOUND,
+                   "max error " + std::to_string(error));
+    }
+
+    const int error = max_channel_error(convert_fhd(frames.fhd, nullptr), reference_raw10_to_rgb(frames.fhd),
+                                        VGA_PIXEL_SIZE, 3);
+    report.Add("reference", "RotatedRaw2Rgb", "best", error == 0,
+               error == 0 ? "bit-exact" : "max error " + std::to_string(error));
+}
+
+int run(const CheckOptions& options)
+{
+    Frames frames;
+    if (!load_frames(options.dir, frames))
+    {
+        return 1;
+    }
+    Report report;
+    std::cout << "check,name,isa,result,detail" << std::endl;
+    check_kernels(report, frames);
+    check_reference(report, frames);
+
+    // golden images of dir, the built-in hashes for built-in frames without them
+    auto golden_of = [&options](const char* name, bool builtin_frame, bytes& golden) {
+        if (!options.dir.empty() && read_file(path_of(options.dir, name), golden))
+        {
+            return true;
+        }
+        if (!builtin_frame)
+        {
+            std::cerr << "Missing golden output " << name << " of a recorded frame" << std::endl;
+        }
+        return false;
+    };
+
+    const char* const golden_names[] = {"vga_rgb.golden", "vga_rgba.golden", "vga_bgra.golden"};
+    bytes golden;
+    for (size_t l = 0; l < 3; l++)
+    {
+        const bool has_golden = golden_of(golden_names[l], frames.builtin_vga, golden);
+        if (!has_golden && !frames.builtin_vga)
+        {
+            return 1;
+        }
+        check_golden(report, std::string("Yuv2Rgb_") + LAYOUT_NAMES[l], convert_vga(frames.vga, LAYOUTS[l]),
+                     has_golden ? &golden : nullptr, BUILTIN_VGA_HASHES[l], options.min_psnr);
+    }
+
+    const bool has_fhd_golden = golden_of("fhd_rgb.golden", frames.builtin_fhd, golden);
+    if (!has_fhd_golden && !frames.builtin_fhd)
+    {
+        return 1;
+    }
+    MatcherThreadPool pool {RAW_POOL_THREADS};
+    const bytes* fhd_golden = has_fhd_golden ? &golden : nullptr;
+    check_golden(report, "RotatedRaw2Rgb", convert_fhd(frames.fhd, nullptr), fhd_golden, BUILTIN_FHD_HASH,
+                 options.min_psnr);
+    check_golden(report, "RotatedRaw2Rgb_pool", convert_fhd(frames.fhd, &pool), fhd_golden, BUILTIN_FHD_HASH,
+                 options.min_psnr);
+
+    const auto metadata = metadata_text(ExtractMetadata(frames.fhd.data(), static_cast<unsigned int>(RAW_FRAME_SIZE)));
+    std::string expected;
+    bytes metadata_golden;
+    if (golden_of("fhd_metadata.golden", frames.builtin_fhd, metadata_golden))
+    {
+        expected.assign(metadata_golden.begin(), metadata_golden.end());
+    }
+    else if (frames.builtin_fhd)
+    {
+        ImageMetadata md;
+        md.timestamp = SAMPLE_TIMESTAMP;
+        md.status = SAMPLE_STATUS;
+        md.sensor_id = SAMPLE_FLAGS & 1;
+        md.led = (SAMPLE_FLAGS & 2) != 0;
+        md.projector = (SAMPLE_FLAGS & 4) != 0;
+        md.face_rect.x = SAMPLE_FACE[0] * 2;
+        md.face_rect.y = SAMPLE_FACE[1] * 2;
+        md.face_rect.width = SAMPLE_FACE[2] * 2;
+        md.face_rect.height = SAMPLE_FACE[3] * 2;
+        expected = metadata_text(md);
+    }
+    else
+    {
+        return 1;
+    }
+    report.Add("golden", "ExtractMetadata", "scalar", metadata == expected, metadata);
+
+#ifdef RSID_PREVIEW_GPU
+    check_gpu(report, frames);
+#endif
+
+    return report.failed > 0 ? 2 : 0;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    CheckOptions options;
+    if (!options_from_argv(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+    return options.command == "record" ? record(options) : run(options);
+}
@@ -0,0 +1,850 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Glass to callback latency of the preview: from the exposure of an image to its OnPreviewImageReady() call, across
+// preview modes, image formats, converter backends and queue policies.
+// Usage: rsid-preview-latency [options]
+//   --modes <list>          comma separated preview modes: vga (default), fhd-rect, dump
+//   --formats <list>        comma separated image formats of the vga mode: rgb (default), rgba, bgra, yuyv, nv12
+//   --converters <list>     comma separated converter backends: cpu (default, the preview's conversion), gpu (the
+//                           yuyv and dump images converted to a texture by PreviewGpuConverter in the callback, needs
+//                           a build with RSID_PREVIEW_GPU)
+//   --policies <list>       comma separated queue policies: drop-oldest (default), block, latest-only, inline
+//   --seconds <n>           duration of each case (default 5)
+//   --camera <n>            camera number (default auto detect)
+//   --playback <file>       play a preview recording instead of the camera (its mode must match --modes)
+//   --playback-pace <pace>  recorded (default) or fast, the recording as fast as the pipeline takes it
+//   --port <port>           sync the device clock first (FaceAuthenticator::SyncClock()), so the device's capture
+//                           timestamp of the fhd-rect and dump images marks their exposure on the host clock
+//   --flash-threshold <n>   rise of the mean luma (0-255) of an image over the previous one taken as an on-screen
+//                           flash (default 32, 0 to disable)
+//   --format csv|json       report format (default csv)
+//   --output <file>         write the report to the file instead of stdout
+//
+// Each case (mode, format, converter, policy) runs the preview for --seconds and reports the distribution of:
+//   exposure-to-callback    exposure of the image to the callback (to the converted texture with the gpu converter)
+//   exposure-to-dequeue     in the camera and its driver (images with a device or driver exposure time only)
+//   dequeue-to-converted    conversion of the preview
+//   converted-to-delivered  queue of the preview (PreviewConfig::queuePolicy)
+//   delivered-to-callback   dispatch to the callback
+//   callback-to-texture     gpu converter only: upload and conversion of the image, until the gpu is done
+//   led-on, projector-on    exposure to callback of the images whose ImageMetadata led / projector flag turned on
+//   flash                   exposure to callback of the images with an on-screen flash (a light or display flashing
+//                           in front of the camera), detected by their mean luma
+// The exposure is the device's capture timestamp when the device clock is synced (ImageTiming::deviceCaptureTime),
+// else the driver's capture timestamp when it is a host time, else the dequeue time. The case's clock column is the
+// least precise of these its images used: device, driver or dequeue (the latencies then miss the camera's share).
+// Flash and flag events have the timing of a single image, point a blinking light at the camera (e.g. a display
+// flashing white once a second) to collect them.
+//
+// Returns 0 if all the cases delivered images, 1 on invalid arguments or if the report could not be written, 2 if a
+// case could not be started or delivered no images.
+
+#include "RealSenseID/Preview.h"
+#include "RealSenseID/FaceAuthenticator.h"
+#include "RealSenseID/Logging.h"
+#include "percentile.h"
+#ifdef RSID_PREVIEW_GPU
+#include "RealSenseID/PreviewGpuConverter.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl31.h>
+#endif // RSID_PREVIEW_GPU
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef RSID_SECURE
+#include "secure_mode_helper.h"
+static RealSenseID::Examples::SignHelper s_signer;
+#endif // RSID_SECURE
+
+namespace
+{
+using RealSenseID::Tools::percentile;
+
+const char* const ALL_MODES[] = {"vga", "fhd-rect", "dump"};
+const char* const ALL_FORMATS[] = {"rgb", "rgba", "bgra", "yuyv", "nv12"};
+const char* const ALL_CONVERTERS[] = {"cpu", "gpu"};
+const char* const ALL_POLICIES[] = {"drop-oldest", "block", "latest-only", "inline"};
+
+// luma samples per image row and column (every LumaStep-th pixel)
+constexpr unsigned int LumaStep = 8;
+
+struct LatencyOptions
+{
+    std::vector<std::string> modes = {"vga"};
+    std::vector<std::string> formats = {"rgb"};
+    std::vector<std::string> converters = {"cpu"};
+    std::vector<std::string> policies = {"drop-oldest"};
+    unsigned int seconds = 5;
+    int camera = -1;
+    std::string playback_path;
+    bool playback_realtime = true;
+    std::string port;
+    unsigned int flash_threshold = 32;
+    bool json = false;
+    std::string output_path;
+};
+
+enum Metric
+{
+    ExposureToCallback,
+    ExposureToDequeue,
+    DequeueToConverted,
+    ConvertedToDelivered,
+    DeliveredToCallback,
+    CallbackToTexture,
+    LedOn,
+    ProjectorOn,
+    Flash,
+    MetricCount
+};
+
+const char* const METRIC_NAMES[] = {"exposure-to-callback",   "exposure-to-dequeue",   "dequeue-to-converted",
+                                    "converted-to-delivered", "delivered-to-callback", "callback-to-texture",
+                                    "led-on",                 "projector-on",          "flash"};
+static_assert(sizeof(METRIC_NAMES) / sizeof(METRIC_NAMES[0]) == MetricCount, "missing metric names");
+
+// source of the exposure time of an image, from the most to the least precise
+enum class ExposureClock
+{
+    Device,
+    Driver,
+    Dequeue
+};
+
+const char* clock_name(ExposureClock clock)
+{
+    switch (clock)
+    {
+    case ExposureClock::Device:
+        return "device";
+    case ExposureClock::Driver:
+        return "driver";
+    default:
+        return "dequeue";
+    }
+}
+
+// pixel layout of the delivered images, for the luma samples and the gpu converter
+enum class Layout
+{
+    Rgb,
+    Rgba, // rgba and bgra, the green byte is second in both
+    Yuyv,
+    Nv12,
+    Raw10
+};
+
+struct CaseConfig
+{
+    std::string mode;
+    std::string format; // of the delivered images
+    std::string converter;
+    std::string policy;
+    Layout layout = Layout::Rgb;
+    RealSenseID::PreviewConfig preview;
+};
+
+struct CaseResult
+{
+    CaseConfig config;
+    std::vector<double> latencies_ms[MetricCount];
+    ExposureClock clock = ExposureClock::Device;
+    unsigned int frames = 0;
+    unsigned int dropped = 0;
+    bool failed = false;
+};
+
+void print_usage()
+{
+    std::cout << "Usage: rsid-preview-latency [--modes vga,fhd-rect,dump] [--formats rgb,rgba,bgra,yuyv,nv12]"
+                 " [--converters cpu,gpu] [--policies drop-oldest,block,latest-only,inline] [--seconds <n>]"
+                 " [--camera <n>] [--playback <file>] [--playback-pace recorded|fast] [--port <port>]"
+                 " [--flash-threshold <n>] [--format csv|json] [--output <file>]"
+              << std::endl;
+}
+
+bool parse_number(const char* token, unsigned int& value)
+{
+    char* end = nullptr;
+    auto parsed = std::strtoul(token, &end, 10);
+    if (*token == '\0' || *end != '\0')
+    {
+        return false;
+    }
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+// comma separated items of the list, each one of the known values
+template <size_t N>
+bool parse_list(const std::string& list, const char* const (&known)[N], std::vector<std::string>& items)
+{
+    items.clear();
+    std::istringstream tokens {list};
+    std::string item;
+    while (std::getline(tokens, item, ','))
+    {
+        if (item.empty())
+        {
+            continue;
+        }
+        if (std::find(std::begin(known), std::end(known), item) == std::end(known))
+        {
+            std::cerr << "Unknown value " << item << std::endl;
+            return false;
+        }
+        items.push_back(item);
+    }
+    return !items.empty();
+}
+
+bool options_from_argv(int argc, char* argv[], LatencyOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const char* name = argv[i];
+        const char* value = argv[++i];
+        unsigned int number = 0;
+        if (::strcmp(name, "--modes") == 0)
+        {
+            if (!parse_list(value, ALL_MODES, options.modes))
+                return false;
+        }
+        else if (::strcmp(name, "--formats") == 0)
+        {
+            if (!parse_list(value, ALL_FORMATS, options.formats))
+                return false;
+        }
+        else if (::strcmp(name, "--converters") == 0)
+        {
+            if (!parse_list(value, ALL_CONVERTERS, options.converters))
+                return false;
+        }
+        else if (::strcmp(name, "--policies") == 0)
+        {
+            if (!parse_list(value, ALL_POLICIES, options.policies))
+                return false;
+        }
+        else if (::strcmp(name, "--seconds") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.seconds = number;
+        }
+        else if (::strcmp(name, "--camera") == 0 && parse_number(value, number))
+        {
+            options.camera = static_cast<int>(number);
+        }
+        else if (::strcmp(name, "--playback") == 0)
+        {
+            options.playback_path = value;
+        }
+        else if (::strcmp(name, "--playback-pace") == 0 &&
+                 (::strcmp(value, "recorded") == 0 || ::strcmp(value, "fast") == 0))
+        {
+            options.playback_realtime = ::strcmp(value, "recorded") == 0;
+        }
+        else if (::strcmp(name, "--port") == 0)
+        {
+            options.port = value;
+        }
+        else if (::strcmp(name, "--flash-threshold") == 0 && parse_number(value, number) && number <= 255)
+        {
+            options.flash_threshold = number;
+        }
+        else if (::strcmp(name, "--format") == 0 && (::strcmp(value, "csv") == 0 || ::strcmp(value, "json") == 0))
+        {
+            options.json = ::strcmp(value, "json") == 0;
+        }
+        else if (::strcmp(name, "--output") == 0)
+        {
+            options.output_path = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+#ifndef RSID_PREVIEW_GPU
+    if (std::find(options.converters.begin(), options.converters.end(), "gpu") != options.converters.end())
+    {
+        std::cerr << "The gpu converter needs a build with RSID_PREVIEW_GPU" << std::endl;
+        return false;
+    }
+#endif // RSID_PREVIEW_GPU
+    return true;
+}
+
+// the cases of all the combinations of the options, the vga formats apply to the vga mode only
+std::vector<CaseConfig> make_cases(const LatencyOptions& options)
+{
+    std::vector<CaseConfig> cases;
+    for (const auto& mode : options.modes)
+    {
+        std::vector<std::string> formats = options.formats;
+        if (mode != "vga")
+        {
+            formats = {mode == "dump" ? "raw10" : "rgb"};
+        }
+        for (const auto& format : formats)
+        {
+            for (const auto& converter : options.converters)
+            {
+                for (const auto& policy : options.policies)
+                {
+                    CaseConfig config;
+                    config.mode = mode;
+                    config.format = format;
+                    config.converter = converter;
+                    config.policy = policy;
+
+                    auto& preview = config.preview;
+                    preview.cameraNumber = options.camera;
+                    if (!options.playback_path.empty())
+                    {
+                        preview.playbackPath = options.playback_path.c_str();
+                        preview.playbackRealtime = options.playback_realtime;
+                    }
+                    if (mode == "fhd-rect")
+                        preview.previewMode = RealSenseID::PreviewMode::FHD_Rect;
+                    else if (mode == "dump")
+                        preview.previewMode = RealSenseID::PreviewMode::Dump;
+
+                    if (format == "rgba" || format == "bgra")
+                        config.layout = Layout::Rgba;
+                    else if (format == "yuyv")
+                        config.layout = Layout::Yuyv;
+                    else if (format == "nv12")
+                        config.layout = Layout::Nv12;
+                    else if (format == "raw10")
+                        config.layout = Layout::Raw10;
+                    if (format == "rgb")
+                        preview.previewFormat = RealSenseID::PreviewFormat::RGB;
+                    else if (format == "rgba")
+                        preview.previewFormat = RealSenseID::PreviewFormat::RGBA;
+                    else if (format == "bgra")
+                        preview.previewFormat = RealSenseID::PreviewFormat::BGRA;
+                    else if (format == "yuyv")
+                        preview.previewFormat = RealSenseID::PreviewFormat::YUYV;
+                    else if (format == "nv12")
+                        preview.previewFormat = RealSenseID::PreviewFormat::NV12;
+
+                    if (policy == "block")
+                        preview.queuePolicy = RealSenseID::PreviewQueuePolicy::Block;
+                    else if (policy == "latest-only")
+                        preview.queuePolicy = RealSenseID::PreviewQueuePolicy::LatestOnly;
+                    else if (policy == "inline")
+                        preview.queuePolicy = RealSenseID::PreviewQueuePolicy::Inline;
+
+                    // the gpu converter takes the raw images only
+                    if (converter == "gpu" && config.layout != Layout::Yuyv && config.layout != Layout::Raw10)
+                    {
+                        std::cerr << "Skipping " << mode << " " << format
+                                  << " on the gpu converter, it converts yuyv and dump images only" << std::endl;
+                        continue;
+                    }
+                    cases.push_back(config);
+                }
+            }
+        }
+    }
+    return cases;
+}
+
+// host steady clock in microseconds, the clock of ImageTiming
+uint64_t now_us()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+double ms_between(uint64_t from_us, uint64_t to_us)
+{
+    return to_us >= from_us ? (to_us - from_us) / 1000.0 : -((from_us - to_us) / 1000.0);
+}
+
+// mean luma of a grid of samples of the image, false if the image has no pixels (or is too small for its layout)
+bool mean_luma(const RealSenseID::Image& image, Layout layout, double& luma)
+{
+    if (image.buffer == nullptr || image.width == 0 || image.height == 0 || image.stride == 0)
+    {
+        return false;
+    }
+    uint64_t sum = 0;
+    uint64_t samples = 0;
+    for (unsigned int y = LumaStep / 2; y < image.height; y += LumaStep)
+    {
+        const size_t row = size_t {y} * image.stride;
+        for (unsigned int x = LumaStep / 2; x < image.width; x += LumaStep)
+        {
+            size_t offset = row;
+            switch (layout)
+            {
+            case Layout::Rgb:
+                offset += x * 3 + 1;
+                break;
+            case Layout::Rgba:
+                offset += x * 4 + 1;
+                break;
+            case Layout::Yuyv:
+                offset += x * 2;
+                break;
+            case Layout::Nv12:
+                offset += x;
+                break;
+            case Layout::Raw10:
+                // 4 pixels' high 8 bits, then a byte of their low 2 bits
+                offset += (x / 4) * 5 + x % 4;
+                break;
+            }
+            if (offset >= image.size)
+            {
+                return false;
+            }
+            sum += image.buffer[offset];
+            samples++;
+        }
+    }
+    if (samples == 0)
+    {
+        return false;
+    }
+    luma = static_cast<double>(sum) / samples;
+    return true;
+}
+
+#ifdef RSID_PREVIEW_GPU
+// PreviewGpuConverter on a surfaceless OpenGL ES 3.1 context. The context is made current on the callback's thread
+// for each image and released after it, so that it can be set up and torn down on the main thread.
+class GpuConverter
+{
+public:
+    GpuConverter()
+    {
+        auto get_platform_display =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (get_platform_display != nullptr)
+        {
+            _display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        if (_display == EGL_NO_DISPLAY)
+        {
+            _display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+        EGLint major = 0, minor = 0;
+        if (_display == EGL_NO_DISPLAY || !eglInitialize(_display, &major, &minor) || !eglBindAPI(EGL_OPENGL_ES_API))
+        {
+            _display = EGL_NO_DISPLAY;
+            return;
+        }
+        const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT, EGL_NONE};
+        EGLConfig config = nullptr;
+        EGLint configs = 0;
+        eglChooseConfig(_display, config_attributes, &config, 1, &configs);
+        const EGLint context_attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 1, EGL_NONE};
+        _context = eglCreateContext(_display, configs > 0 ? config : nullptr, EGL_NO_CONTEXT, context_attributes);
+        if (_context == EGL_NO_CONTEXT || !MakeCurrent())
+        {
+            return;
+        }
+        _valid = _converter.Init();
+        ReleaseCurrent();
+    }
+
+    ~GpuConverter()
+    {
+        if (_context != EGL_NO_CONTEXT)
+        {
+            if (MakeCurrent())
+            {
+                _converter.Release();
+                ReleaseCurrent();
+            }
+            eglDestroyContext(_display, _context);
+        }
+        if (_display != EGL_NO_DISPLAY)
+        {
+            eglTerminate(_display);
+        }
+    }
+
+    GpuConverter(const GpuConverter&) = delete;
+    GpuConverter& operator=(const GpuConverter&) = delete;
+
+    bool Valid() const
+    {
+        return _valid;
+    }
+
+    // convert the image to the texture and wait for the gpu to finish it
+    bool Convert(const RealSenseID::Image& image, Layout layout)
+    {
+        if (!_valid || !MakeCurrent())
+        {
+            return false;
+        }
+        const bool converted = layout == Layout::Raw10 ? _converter.ConvertRaw10(image) : _converter.ConvertYuyv(image);
+        glFinish();
+        ReleaseCurrent();
+        return converted;
+    }
+
+private:
+    bool MakeCurrent()
+    {
+        return eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, _context) == EGL_TRUE;
+    }
+
+    void ReleaseCurrent()
+    {
+        eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+
+    EGLDisplay _display = EGL_NO_DISPLAY;
+    EGLContext _context = EGL_NO_CONTEXT;
+    RealSenseID::PreviewGpuConverter _converter;
+    bool _valid = false;
+};
+#endif // RSID_PREVIEW_GPU
+
+// stage latencies of each image, and the flag and flash events
+class LatencyClbk : public RealSenseID::PreviewImageReadyCallback
+{
+public:
+    LatencyClbk(CaseResult& result, unsigned int flash_threshold) : _result {result}, _flash_threshold {flash_threshold}
+    {
+    }
+
+#ifdef RSID_PREVIEW_GPU
+    void SetGpuConverter(GpuConverter* converter)
+    {
+        _gpu = converter;
+    }
+#endif // RSID_PREVIEW_GPU
+
+    void OnPreviewImageReady(const RealSenseID::Image image) override
+    {
+        const uint64_t callback_time = now_us();
+        uint64_t done_time = callback_time;
+        bool converted = true;
+#ifdef RSID_PREVIEW_GPU
+        if (_gpu != nullptr)
+        {
+            converted = _gpu->Convert(image, _result.config.layout);
+            done_time = now_us();
+        }
+#endif // RSID_PREVIEW_GPU
+
+        const auto& timing = image.timing;
+        ExposureClock clock = ExposureClock::Dequeue;
+        uint64_t exposure = timing.dequeueTime;
+        if (timing.deviceCaptureTime != 0)
+        {
+            clock = ExposureClock::Device;
+            exposure = timing.deviceCaptureTime;
+        }
+        else if (timing.captureOnHostClock && timing.captureTimestamp != 0)
+        {
+            clock = ExposureClock::Driver;
+            exposure = timing.captureTimestamp;
+        }
+
+        std::lock_guard<std::mutex> lock {_mutex};
+        auto& latencies = _result.latencies_ms;
+        if (!converted)
+        {
+            _result.failed = true;
+            return;
+        }
+        _result.frames++;
+        _result.clock = std::max(_result.clock, clock);
+        const double total_ms = ms_between(exposure, done_time);
+        latencies[ExposureToCallback].push_back(total_ms);
+        if (clock != ExposureClock::Dequeue)
+        {
+            latencies[ExposureToDequeue].push_back(ms_between(exposure, timing.dequeueTime));
+        }
+        if (timing.convertedTime != 0)
+        {
+            latencies[DequeueToConverted].push_back(ms_between(timing.dequeueTime, timing.convertedTime));
+            latencies[ConvertedToDelivered].push_back(ms_between(timing.convertedTime, timing.deliveredTime));
+        }
+        latencies[DeliveredToCallback].push_back(ms_between(timing.deliveredTime, callback_time));
+#ifdef RSID_PREVIEW_GPU
+        if (_gpu != nullptr)
+        {
+            latencies[CallbackToTexture].push_back(ms_between(callback_time, done_time));
+        }
+#endif // RSID_PREVIEW_GPU
+
+        // rising edges of the flags, from the second image on
+        const auto& metadata = image.metadata;
+        if (_has_previous && metadata.led && !_previous_led)
+        {
+            latencies[LedOn].push_back(total_ms);
+        }
+        if (_has_previous && metadata.projector && !_previous_projector)
+        {
+            latencies[ProjectorOn].push_back(total_ms);
+        }
+        _previous_led = metadata.led;
+        _previous_projector = metadata.projector;
+        _has_previous = true;
+
+        // a flash is a rise of the luma by the threshold, the next one once the luma is back below half the rise
+        double luma = 0;
+        if (_flash_threshold > 0 && mean_luma(image, _result.config.layout, luma))
+        {
+            if (_has_luma && _flash_armed && luma >= _previous_luma + _flash_threshold)
+            {
+                latencies[Flash].push_back(total_ms);
+                _flash_armed = false;
+                _flash_base = _previous_luma;
+            }
+            else if (!_flash_armed && luma <= _flash_base + _flash_threshold / 2.0)
+            {
+                _flash_armed = true;
+            }
+            _previous_luma = luma;
+            _has_luma = true;
+        }
+    }
+
+private:
+    CaseResult& _result;
+    unsigned int _flash_threshold;
+    std::mutex _mutex;
+    bool _has_previous = false;
+    bool _previous_led = false;
+    bool _previous_projector = false;
+    bool _has_luma = false;
+    bool _flash_armed = true;
+    double _previous_luma = 0;
+    double _flash_base = 0;
+#ifdef RSID_PREVIEW_GPU
+    GpuConverter* _gpu = nullptr;
+#endif // RSID_PREVIEW_GPU
+};
+
+CaseResult run_case(const CaseConfig& config, const LatencyOptions& options)
+{
+    std::cerr << "case: mode=" << config.mode << " format=" << config.format << " converter=" << config.converter
+              << " policy=" << config.policy << std::endl;
+    CaseResult result;
+    result.config = config;
+    LatencyClbk callback {result, options.flash_threshold};
+#ifdef RSID_PREVIEW_GPU
+    std::unique_ptr<GpuConverter> gpu;
+    if (config.converter == "gpu")
+    {
+        gpu = std::make_unique<GpuConverter>();
+        if (!gpu->Valid())
+        {
+            std::cerr << "Failed creating the gpu converter (OpenGL ES 3.1 context)" << std::endl;
+            result.failed = true;
+            return result;
+        }
+        callback.SetGpuConverter(gpu.get());
+    }
+#endif // RSID_PREVIEW_GPU
+
+    try
+    {
+        RealSenseID::Preview preview {config.preview};
+        if (!preview.StartPreview(callback))
+        {
+            std::cerr << "Failed starting the preview" << std::endl;
+            result.failed = true;
+            return result;
+        }
+        std::this_thread::sleep_for(std::chrono::seconds {options.seconds});
+        preview.StopPreview();
+        result.dropped = preview.GetStatistics().dropped;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Failed running the preview: " << ex.what() << std::endl;
+        result.failed = true;
+    }
+    if (result.frames == 0)
+    {
+        result.failed = true;
+    }
+    return result;
+}
+
+struct MetricRow
+{
+    const char* name = nullptr;
+    size_t count = 0;
+    double mean_ms = 0;
+    double p50_ms = 0;
+    double p90_ms = 0;
+    double p99_ms = 0;
+    double max_ms = 0;
+};
+
+// rows of the metrics with samples, exposure-to-callback always
+std::vector<MetricRow> make_rows(const CaseResult& result)
+{
+    std::vector<MetricRow> rows;
+    for (size_t i = 0; i < MetricCount; i++)
+    {
+        const auto& latencies = result.latencies_ms[i];
+        if (latencies.empty() && i != ExposureToCallback)
+        {
+            continue;
+        }
+        MetricRow row;
+        row.name = METRIC_NAMES[i];
+        row.count = latencies.size();
+        if (!latencies.empty())
+        {
+            auto sorted = latencies;
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0;
+            for (auto value : sorted)
+            {
+                total += value;
+            }
+            row.mean_ms = total / sorted.size();
+            row.p50_ms = percentile(sorted, 50);
+            row.p90_ms = percentile(sorted, 90);
+            row.p99_ms = percentile(sorted, 99);
+            row.max_ms = sorted.back();
+        }
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+void write_csv(std::ostream& out, const std::vector<CaseResult>& results)
+{
+    out << "mode,format,converter,policy,clock,frames,dropped,metric,count,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n";
+    for (const auto& result : results)
+    {
+        const auto& config = result.config;
+        for (const auto& row : make_rows(result))
+        {
+            out << config.mode << ',' << config.format << ',' << config.converter << ',' << config.policy << ','
+                << clock_name(result.clock) << ',' << result.frames << ',' << result.dropped << ',' << row.name << ','
+                << row.count << ',' << row.mean_ms << ',' << row.p50_ms << ',' << row.p90_ms << ',' << row.p99_ms
+                << ',' << row.max_ms << '\n';
+        }
+    }
+}
+
+void write_json(std::ostream& out, const std::vector<CaseResult>& results, const LatencyOptions& options)
+{
+    out << "{\n  \"seconds\": " << options.seconds << ",\n  \"flash_threshold\": " << options.flash_threshold
+        << ",\n  \"cases\": [";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const auto& result = results[i];
+        const auto& config = result.config;
+        out << (i == 0 ? "\n" : ",\n") << "    {\"mode\": \"" << config.mode << "\", \"format\": \"" << config.format
+            << "\", \"converter\": \"" << config.converter << "\", \"policy\": \"" << config.policy
+            << "\", \"clock\": \"" << clock_name(result.clock) << "\", \"frames\": " << result.frames
+            << ", \"dropped\": " << result.dropped << ", \"failed\": " << (result.failed ? "true" : "false")
+            << ", \"metrics\": {";
+        const auto rows = make_rows(result);
+        for (size_t j = 0; j < rows.size(); j++)
+        {
+            const auto& row = rows[j];
+            out << (j == 0 ? "\n" : ",\n") << "      \"" << row.name << "\": {\"count\": " << row.count
+                << ", \"mean_ms\": " << row.mean_ms << ", \"p50_ms\": " << row.p50_ms << ", \"p90_ms\": " << row.p90_ms
+                << ", \"p99_ms\": " << row.p99_ms << ", \"max_ms\": " << row.max_ms << "}";
+        }
+        out << "\n    }}";
+    }
+    out << "\n  ]\n}\n";
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    LatencyOptions options;
+    if (!options_from_argv(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+
+    // keep the report on stdout clean, library warnings and errors go to stderr
+    RealSenseID::SetLogCallback([](RealSenseID::LogLevel, const char* msg) { std::cerr << msg << std::endl; },
+                                RealSenseID::LogLevel::Warning, true);
+
+    const auto cases = make_cases(options);
+    if (cases.empty())
+    {
+        std::cerr << "No cases to run" << std::endl;
+        return 1;
+    }
+
+    // the device clock estimate is process wide, the preview maps the device timestamps with it while the
+    // authenticator is alive
+#ifdef RSID_SECURE
+    RealSenseID::FaceAuthenticator authenticator {&s_signer};
+#else
+    RealSenseID::FaceAuthenticator authenticator;
+#endif // RSID_SECURE
+    if (!options.port.empty())
+    {
+        RealSenseID::SerialConfig config {options.port.c_str()};
+        auto status = authenticator.Connect(config);
+        if (status == RealSenseID::Status::Ok)
+        {
+            status = authenticator.SyncClock();
+        }
+        if (status != RealSenseID::Status::Ok)
+        {
+            std::cerr << "Failed syncing the device clock on port " << options.port << " status:" << status
+                      << ", measuring from the host's clocks" << std::endl;
+        }
+    }
+
+    std::vector<CaseResult> results;
+    bool failed = false;
+    for (const auto& config : cases)
+    {
+        results.push_back(run_case(config, options));
+        failed = failed || results.back().failed;
+    }
+
+    std::ofstream file;
+    if (!options.output_path.empty())
+    {
+        file.open(options.output_path);
+        if (!file)
+        {
+            std::cerr << "Failed opening report " << options.output_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.output_path.empty() ? std::cout : file;
+    if (options.json)
+    {
+        write_json(out, results, options);
+    }
+    else
+    {
+        write_csv(out, results);
+    }
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,234 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Bridge of a device's serial port to TCP, for hosts connecting to it with the "tcp://<host>:<port>" port.
+// Usage: rsid-proxy <serial port> [options]
+//   --listen <port>      tcp port to listen on (default 7300)
+//   --bind <address>     ipv4 address of the interface to listen on (default 127.0.0.1, this machine only).
+//                        0.0.0.0 listens on all interfaces
+//   --baudrate <n>       baud rate of the serial port (default 115200)
+//   --linger-ms <n>      time to wait for more bytes of the device before forwarding them (default 1), so a packet
+//                        travels in few tcp segments even at low baud rates. 0 forwards each read at once
+//
+// One host at a time: the serial port is opened when a host connects and closed when it disconnects. The bytes are
+// forwarded as is, the session (secure or not) is between the host and the device. The proxy doesn't authenticate
+// its hosts: whoever connects controls the device (enroll, delete users, authenticate), so hosts on other machines
+// should use a secure build, which pairs the host with the device and signs every packet.
+// Stops on Ctrl-C. Returns 0 on Ctrl-C, 1 on invalid arguments or if the tcp port could not be listened on.
+
+#include "TcpSerial.h"
+#ifdef _WIN32
+#include "WindowsSerial.h"
+#else
+#include "LinuxSerial.h"
+#endif
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using RealSenseID::PacketManager::SerialConnection;
+using RealSenseID::PacketManager::SerialStatus;
+using RealSenseID::PacketManager::timeout_t;
+
+namespace
+{
+const unsigned short DEFAULT_TCP_PORT = 7300;
+const char* const DEFAULT_BIND_ADDRESS = "127.0.0.1";
+const size_t FORWARD_BUFFER_SIZE = 64 * 1024;
+const timeout_t POLL_TIMEOUT {100}; // max delay to notice a stop
+
+std::atomic<bool> s_stop {false};
+
+struct ProxyOptions
+{
+    std::string serial_port;
+    unsigned int baudrate = 115200;
+    unsigned short tcp_port = DEFAULT_TCP_PORT;
+    std::string bind_address = DEFAULT_BIND_ADDRESS;
+    timeout_t linger {1};
+};
+
+void print_usage()
+{
+    std::cout << "Usage: rsid-proxy <serial port> [--listen <port>] [--bind <address>] [--baudrate <n>]"
+                 " [--linger-ms <n>]"
+              << std::endl;
+}
+
+bool parse_number(const char* token, unsigned int& value)
+{
+    char* end = nullptr;
+    auto parsed = std::strtoul(token, &end, 10);
+    if (*token == '\0' || *end != '\0')
+    {
+        return false;
+    }
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+bool options_from_argv(int argc, char* argv[], ProxyOptions& options)
+{
+    if (argc < 2)
+    {
+        return false;
+    }
+    options.serial_port = argv[1];
+    for (int i = 2; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const char* name = argv[i];
+        const char* value = argv[++i];
+        unsigned int number = 0;
+        if (::strcmp(name, "--listen") == 0 && parse_number(value, number) && number > 0 && number <= 65535)
+        {
+            options.tcp_port = static_cast<unsigned short>(number);
+        }
+        else if (::strcmp(name, "--bind") == 0)
+        {
+            options.bind_address = value;
+        }
+        else if (::strcmp(name, "--baudrate") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.baudrate = number;
+        }
+        else if (::strcmp(name, "--linger-ms") == 0 && parse_number(value, number))
+        {
+            options.linger = timeout_t {number};
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<SerialConnection> open_device(const ProxyOptions& options)
+{
+    RealSenseID::PacketManager::SerialConfig config;
+    config.port = options.serial_port.c_str();
+    config.baudrate = options.baudrate;
+#ifdef _WIN32
+    return std::make_unique<RealSenseID::PacketManager::WindowsSerial>(config);
+#else
+    return std::make_unique<RealSenseID::PacketManager::LinuxSerial>(config);
+#endif
+}
+
+// forward what arrived from one side to the other with a single write. false if either side failed
+bool forward(SerialConnection& from, SerialConnection& to, std::vector<char>& buffer, timeout_t linger)
+{
+    size_t n_bytes = 0;
+    auto status = from.RecvAvailable(buffer.data(), buffer.size(), n_bytes, POLL_TIMEOUT);
+    if (status == SerialStatus::RecvTimeout)
+    {
+        return true;
+    }
+    if (status != SerialStatus::Ok)
+    {
+        return false;
+    }
+    // coalesce the rest of the burst
+    while (linger.count() > 0 && n_bytes < buffer.size())
+    {
+        size_t more_bytes = 0;
+        status = from.RecvAvailable(buffer.data() + n_bytes, buffer.size() - n_bytes, more_bytes, linger);
+        if (status != SerialStatus::Ok)
+        {
+            break;
+        }
+        n_bytes += more_bytes;
+    }
+    return to.SendBytes(buffer.data(), n_bytes) == SerialStatus::Ok;
+}
+
+// forward both directions until either side disconnects or the proxy is stopped
+void bridge(SerialConnection& host, SerialConnection& device, timeout_t linger)
+{
+    std::atomic<bool> connected {true};
+    std::thread device_to_host([&] {
+        std::vector<char> buffer(FORWARD_BUFFER_SIZE);
+        while (connected && !s_stop)
+        {
+            if (!forward(device, host, buffer, linger))
+            {
+                connected = false;
+            }
+        }
+    });
+
+    // the host sends whole packets, nothing to coalesce
+    std::vector<char> buffer(FORWARD_BUFFER_SIZE);
+    while (connected && !s_stop)
+    {
+        if (!forward(host, device, buffer, timeout_t {0}))
+        {
+            connected = false;
+        }
+    }
+    device_to_host.join();
+}
+
+void on_signal(int)
+{
+    s_stop = true;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    ProxyOptions options;
+    if (!options_from_argv(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    std::unique_ptr<RealSenseID::PacketManager::TcpListener> listener;
+    try
+    {
+        listener = std::make_unique<RealSenseID::PacketManager::TcpListener>(options.tcp_port, options.bind_address);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    std::cerr << "Forwarding " << options.serial_port << " on " << options.bind_address << " tcp port "
+              << options.tcp_port << std::endl;
+
+    while (!s_stop)
+    {
+        auto host = listener->Accept(POLL_TIMEOUT);
+        if (!host)
+        {
+            continue;
+        }
+        std::cerr << "Host connected" << std::endl;
+        try
+        {
+            auto device = open_device(options);
+            bridge(*host, *device, options.linger);
+        }
+        catch (const std::exception& ex)
+        {
+            std::cerr << ex.what() << std::endl;
+        }
+        std::cerr << "Host disconnected" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,391 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Decodes a serial recording into the packets sent and received, one line each: the files of the
+// "record://<file>@<port>" ports and the rsid_serial.rec capture of RSID_SERIAL_CAPTURE builds (see
+// src/PacketManager/RecordingSerial.h for the format).
+// Usage: rsid-serial-decode <file> [--hex]
+//   --hex    also print the used payload bytes of each packet in hex
+//
+// Each line has the time of the packet's first bytes (ms, since the connection was opened for recordings and since
+// the capture started for captures), the direction ('>' sent, '<' received), the msg id, protocol version, sequence
+// number, payload size and crc check, and the user id and status of fa packets. The messages of coalesced packets
+// follow on indented lines with their msg id and size. Bytes outside of packets (the text commands, e.g.
+// __FACE_API__) are printed as text. The payloads of secure sessions are encrypted, only their headers are
+// meaningful.
+// Returns 0 on success, 1 on invalid arguments or if the file is not a serial recording.
+
+#include "RecordingSerial.h"
+#include "SerialPacket.h"
+#include "Coalesced.h"
+#include "Crc16.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace RealSenseID::PacketManager;
+
+namespace
+{
+const size_t HEADER_SIZE = sizeof(SerialPacket::header);
+
+const char* MsgName(MsgId id)
+{
+    switch (id)
+    {
+    case MsgId::Authenticate:
+        return "Authenticate";
+    case MsgId::DetectSpoof:
+        return "DetectSpoof";
+    case MsgId::RemoveAllUsers:
+        return "RemoveAllUsers";
+    case MsgId::RemoveUser:
+        return "RemoveUser";
+    case MsgId::Enroll:
+        return "Enroll";
+    case MsgId::Hint:
+        return "Hint";
+    case MsgId::AuthenticateLoopFaceprintsExtraction:
+        return "AuthenticateLoopFaceprintsExtraction";
+    case MsgId::SecureFaceprintsEnroll:
+        return "SecureFaceprintsEnroll";
+    case MsgId::AuthenticateLoop:
+        return "AuthenticateLoop";
+    case MsgId::SecureFaceprintsAuthenticate:
+        return "SecureFaceprintsAuthenticate";
+    case MsgId::Progress:
+        return "Progress";
+    case MsgId::Result:
+        return "Result";
+    case MsgId::EnrollFaceprintsExtraction:
+        return "EnrollFaceprintsExtraction";
+    case MsgId::AuthenticateFaceprintsExtraction:
+        return "AuthenticateFaceprintsExtraction";
+    case MsgId::Reply:
+        return "Reply";
+    case MsgId::HostEcdsaKey:
+        return "HostEcdsaKey";
+    case MsgId::DeviceEcdsaKey:
+        return "DeviceEcdsaKey";
+    case MsgId::HostEcdhKey:
+        return "HostEcdhKey";
+    case MsgId::DeviceEcdhKey:
+        return "DeviceEcdhKey";
+    case MsgId::Nak:
+        return "Nak";
+    case MsgId::Faceprints:
+        return "Faceprints";
+    case MsgId::FaceDetected:
+        return "FaceDetected";
+    case MsgId::MultiFaceprints:
+        return "MultiFaceprints";
+    case MsgId::GetNumberOfUsers:
+        return "GetNumberOfUsers";
+    case MsgId::StartSession:
+        return "StartSession";
+    case MsgId::Ping:
+        return "Ping";
+    case MsgId::QueryDeviceConfig:
+        return "QueryDeviceConfig";
+    case MsgId::SetDeviceConfig:
+        return "SetDeviceConfig";
+    case MsgId::StandBy:
+        return "StandBy";
+    case MsgId::GetUserIds:
+        return "GetUserIds";
+    case MsgId::SecureFaceprintsBeginSecureSession:
+        return "SecureFaceprintsBeginSecureSession";
+    case MsgId::SecureFaceprintsEndSecureSession:
+        return "SecureFaceprintsEndSecureSession";
+    case MsgId::SecureFaceprintsOnSecureSessionReady:
+        return "SecureFaceprintsOnSecureSessionReady";
+    case MsgId::SecureFaceprintsOnSecureSessionCmd:
+        return "SecureFaceprintsOnSecureSessionCmd";
+    case MsgId::SecureFaceprintsOnSecureSessionCmdResp:
+        return "SecureFaceprintsOnSecureSessionCmdResp";
+    case MsgId::SecureFaceprintsFaceprintsReady:
+        return "SecureFaceprintsFaceprintsReady";
+    case MsgId::SetUserFeatures:
+        return "SetUserFeatures";
+    case MsgId::GetUserFeatures:
+        return "GetUserFeatures";
+    case MsgId::Coalesced:
+        return "Coalesced";
+    default:
+        return "?";
+    }
+}
+
+// as PacketSender::CalcCrc()
+uint16_t CalcCrc(const SerialPacket& packet)
+{
+    auto* packet_ptr = reinterpret_cast<const char*>(&packet);
+    if (packet.header.protocol_ver < CompactCrcProtocolVer)
+    {
+        return Crc16(packet_ptr, sizeof(packet) - sizeof(packet.crc));
+    }
+    auto crc = Crc16(packet_ptr, HEADER_SIZE + packet.header.payload_size);
+    return Crc16(crc, packet.hmac, sizeof(packet.hmac));
+}
+
+void PrintText(double time_ms, char direction, const char* bytes, size_t size)
+{
+    std::string text;
+    for (size_t i = 0; i < size; i++)
+    {
+        char c = bytes[i];
+        if (c == '\r' || c == '\n')
+        {
+            continue;
+        }
+        if (c >= 32 && c < 127)
+        {
+            text += c;
+        }
+        else
+        {
+            char escaped[8];
+            ::snprintf(escaped, sizeof(escaped), "\\x%02x", static_cast<unsigned char>(c));
+            text += escaped;
+        }
+    }
+    if (!text.empty())
+    {
+        std::printf("%12.3f %c text \"%s\"\n", time_ms, direction, text.c_str());
+    }
+}
+
+void PrintHex(const char* bytes, size_t size)
+{
+    for (size_t i = 0; i < size; i += 32)
+    {
+        std::printf("%12s  ", "");
+        for (size_t j = i; j < size && j < i + 32; j++)
+        {
+            std::printf("%02x", static_cast<unsigned char>(bytes[j]));
+        }
+        std::printf("\n");
+    }
+}
+
+// the bytes of one direction of a connection, parsed into packets as they arrive
+class Stream
+{
+public:
+    Stream(char direction, bool hex) : _direction {direction}, _hex {hex}
+    {
+    }
+
+    void Add(const char* bytes, size_t size, uint64_t time_us)
+    {
+        if (_bytes.empty())
+        {
+            _time_us = time_us;
+        }
+        _bytes.insert(_bytes.end(), bytes, bytes + size);
+        while (ParseOne())
+        {
+            _time_us = time_us;
+        }
+    }
+
+    // print what is left as text (end of the connection)
+    void Flush()
+    {
+        if (!_bytes.empty())
+        {
+            PrintText(_time_us / 1000.0, _direction, _bytes.data(), _bytes.size());
+            _bytes.clear();
+        }
+    }
+
+private:
+    char _direction;
+    bool _hex;
+    std::vector<char> _bytes;
+    uint64_t _time_us = 0; // of the first byte in _bytes
+
+    // print the text before the next packet, or the packet at the start. false if more bytes are needed
+    bool ParseOne()
+    {
+        const char sync[2] = {static_cast<char>(SyncByte::Sync1), static_cast<char>(SyncByte::Sync2)};
+        size_t start = 0;
+        while (start + 1 < _bytes.size() && (_bytes[start] != sync[0] || _bytes[start + 1] != sync[1]))
+        {
+            start++;
+        }
+        if (start > 0)
+        {
+            if (start + 1 >= _bytes.size())
+            {
+                return false; // the text may go on, or the last byte start a packet
+            }
+            PrintText(_time_us / 1000.0, _direction, _bytes.data(), start);
+            Consume(start);
+            return true;
+        }
+        if (_bytes.size() < HEADER_SIZE)
+        {
+            return false;
+        }
+
+        SerialPacket packet;
+        ::memcpy(&packet.header, _bytes.data(), HEADER_SIZE);
+        if (packet.header.payload_size > sizeof(packet.payload))
+        {
+            // not a packet header, the sync bytes were part of the text
+            PrintText(_time_us / 1000.0, _direction, _bytes.data(), 2);
+            Consume(2);
+            return true;
+        }
+        const size_t payload_size = packet.header.payload_size;
+        const size_t packet_size = HEADER_SIZE + payload_size + sizeof(packet.hmac) + sizeof(packet.crc);
+        if (_bytes.size() < packet_size)
+        {
+            return false;
+        }
+        const char* ptr = _bytes.data() + HEADER_SIZE;
+        ::memcpy(&packet.payload, ptr, payload_size);
+        ::memcpy(packet.hmac, ptr + payload_size, sizeof(packet.hmac));
+        ::memcpy(&packet.crc, ptr + payload_size + sizeof(packet.hmac), sizeof(packet.crc));
+        Print(packet);
+        Consume(packet_size);
+        return true;
+    }
+
+    void Print(const SerialPacket& packet)
+    {
+        const bool crc_ok = CalcCrc(packet) == packet.crc;
+        std::printf("%12.3f %c '%c' %-38s ver %u seq %-6u payload %-4u crc %s", _time_us / 1000.0, _direction,
+                    static_cast<char>(packet.header.id), MsgName(packet.header.id), packet.header.protocol_ver,
+                    packet.payload.sequence_number, packet.header.payload_size, crc_ok ? "ok" : "BAD");
+        if (IsFaPacket(packet))
+        {
+            const auto& fa = packet.payload.message.fa_msg;
+            std::string user_id(fa.user_id, ::strnlen(fa.user_id, sizeof(fa.user_id)));
+            std::printf(" user \"%s\" status %d", user_id.c_str(), fa.fa_status - '0');
+        }
+        std::printf("\n");
+        if (packet.header.id == MsgId::Coalesced)
+        {
+            PrintCoalesced(packet);
+        }
+        if (_hex)
+        {
+            PrintHex(reinterpret_cast<const char*>(&packet.payload), packet.header.payload_size);
+        }
+    }
+
+    // the records of a coalesced packet (see Coalesced.h), up to the first one out of the payload
+    void PrintCoalesced(const SerialPacket& packet)
+    {
+        const char* data = packet.payload.message.data_msg.data;
+        const size_t size = packet.UsedPayloadSize() - sizeof(packet.payload.sequence_number);
+        CoalescedHeader header {0};
+        if (size >= sizeof(header))
+        {
+            ::memcpy(&header, data, sizeof(header));
+        }
+        size_t offset = sizeof(header);
+        for (unsigned int i = 0; i < header.count; i++)
+        {
+            CoalescedRecord record;
+            if (offset + sizeof(record) > size)
+            {
+                break;
+            }
+            ::memcpy(&record, data + offset, sizeof(record));
+            offset += sizeof(record);
+            std::printf("%14s '%c' %-38s size %u\n", "", static_cast<char>(record.id), MsgName(record.id),
+                        record.size);
+            offset += record.size;
+        }
+    }
+
+    void Consume(size_t size)
+    {
+        _bytes.erase(_bytes.begin(), _bytes.begin() + size);
+    }
+};
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const char* path = nullptr;
+    bool hex = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (::strcmp(argv[i], "--hex") == 0)
+        {
+            hex = true;
+        }
+        else if (path == nullptr)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            path = nullptr;
+            break;
+        }
+    }
+    if (path == nullptr)
+    {
+        std::printf("Usage: rsid-serial-decode <file> [--hex]\n");
+        return 1;
+    }
+
+    FILE* file = ::fopen(path, "rb");
+    if (file == nullptr)
+    {
+        std::printf("Failed to open %s\n", path);
+        return 1;
+    }
+    Recording::RecordingHeader header;
+    if (::fread(&header, sizeof(header), 1, file) != 1 ||
+        ::memcmp(header.magic, Recording::FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != Recording::VERSION)
+    {
+        std::printf("Not a serial recording %s\n", path);
+        ::fclose(file);
+        return 1;
+    }
+
+    Stream sent {'>', hex};
+    Stream received {'<', hex};
+    unsigned int connections = 0;
+    Recording::RecordHeader record;
+    std::vector<char> data;
+    while (::fread(&record, sizeof(record), 1, file) == 1)
+    {
+        data.resize(record.size);
+        if (record.size > 0 && ::fread(data.data(), record.size, 1, file) != 1)
+        {
+            std::printf("Truncated record at the end of the file\n");
+            break;
+        }
+        switch (record.direction)
+        {
+        case Recording::Opened:
+            sent.Flush();
+            received.Flush();
+            std::printf("--- connection %u\n", connections++);
+            break;
+        case Recording::Sent:
+            sent.Add(data.data(), data.size(), record.time_us);
+            break;
+        case Recording::Received:
+            received.Add(data.data(), data.size(), record.time_us);
+            break;
+        default:
+            std::printf("Unknown record direction %u\n", record.direction);
+            break;
+        }
+    }
+    sent.Flush();
+    received.Flush();
+    ::fclose(file);
+    return 0;
+}
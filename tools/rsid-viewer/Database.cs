@@ -49,6 +49,7 @@ namespace rsid_wrapper_csharp
             else
             {
                 faceprintsArray.Add((faceprints, userId));                
+                gallery.Add(userId, ref faceprints);
                 return true;
             }
             
@@ -62,12 +63,17 @@ namespace rsid_wrapper_csharp
         public bool Remove(string userId)
         {
             int removedItems = faceprintsArray.RemoveAll(r => r.Item2 == userId);
+            if (removedItems > 0)
+            {
+                RebuildGallery();
+            }
             return (removedItems > 0);
         }
 
         public bool RemoveAll()
         {
             faceprintsArray.Clear();
+            gallery.Clear();
             return (faceprintsArray.Count == 0);
         }
 
@@ -92,6 +98,7 @@ namespace rsid_wrapper_csharp
                 // update by remove and then re-insert (found no other way to do that properly).
                 faceprintsArray.RemoveAt(userIndex);
                 faceprintsArray.Insert(userIndex, (updatedFaceprints, userIdStr));
+                gallery.Update(userIndex, ref updatedFaceprints);
             }
             else
             {
@@ -180,6 +187,7 @@ namespace rsid_wrapper_csharp
                 dbVersion = (int)bf.Deserialize(inStr); 
                 // then read the faceprints array.
                 faceprintsArray = bf.Deserialize(inStr) as List<(rsid.Faceprints, string)>;
+                RebuildGallery();
 
                 if(faceprintsArray.Count > 0)
                 {
@@ -203,12 +211,32 @@ namespace rsid_wrapper_csharp
             return returnValue;
         }
 
+        // match against all the users in a single native call, the result index is the user's index in faceprintsArray.
+        public rsid.MatchArrayResult Match(ref rsid.Faceprints faceprints, ref rsid.Faceprints updatedFaceprints)
+        {
+            return gallery.Match(ref faceprints, ref updatedFaceprints);
+        }
+
+        // the native gallery mirrors faceprintsArray (same order)
+        private void RebuildGallery()
+        {
+            gallery.Clear();
+            gallery.Reserve(faceprintsArray.Count);
+            foreach (var (faceprints, userId) in faceprintsArray)
+            {
+                var userFaceprints = faceprints;
+                gallery.Add(userId, ref userFaceprints);
+            }
+        }
+
         public int GetVersion()
         {
             return dbVersion;
         }
 
         public List<(rsid.Faceprints, string)> faceprintsArray;    
+        // native copy of the faceprints, used for matching.
+        private rsid.FaceprintsGallery gallery = new rsid.FaceprintsGallery();
         
         // db will be saved to file along with its version number.
         public int dbVersion;
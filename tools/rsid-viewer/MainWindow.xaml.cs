@@ -40,10 +40,9 @@ namespace rsid_wrapper_csharp
         private FlowMode _flowMode;
         private rsid.Preview _preview;
         private WriteableBitmap _previewBitmap;
-        private byte[] _previewBuffer = new byte[0]; // store latest frame from the preview callback
+        private rsid.PreviewFrame _pendingFrame; // latest preview frame not yet rendered (older ones are dropped)
         // detected faces in current session. bool is where operation succeeded (e.g. authenticated or not)
         private List<(rsid.FaceRect, bool?)> _detectedFaces = new List<(rsid.FaceRect, bool?)>();
-        private object _previewMutex = new object();
 
         private string[] _userList = new string[0]; // latest user list that was queried from the device
 
@@ -445,7 +444,7 @@ namespace rsid_wrapper_csharp
             LabelPlayStop.Visibility = LabelPlayStop.Visibility == Visibility.Visible ? Visibility.Hidden : Visibility.Visible;
             if (LabelPlayStop.Visibility == Visibility.Hidden)
             {
-                _preview.Start(OnPreview);
+                _preview.StartFrames(OnPreviewFrame);
                 TogglePreviewOpacity(true);
             }
             else
@@ -812,40 +811,29 @@ namespace rsid_wrapper_csharp
                     return ;
                 }
 
-                foreach (var (faceprintsDb, userIdDb) in _db.faceprintsArray)
+                // match against the whole database in a single native call.
+                // note we must send an initialized vector as the updated one, the matched user's updated faceprints
+                // are written into it.
+                var updatedFaceprints = faceprintsToMatch;
+                var matchResult = _db.Match(ref faceprintsToMatch, ref updatedFaceprints);
+                if (matchResult.success == 1)
                 {
-                    // note we must send initialized vectors to MatchFaceprintsToFaceprints().
-                    // so here we init the updated vector to the existing DB vector before calling MatchFaceprintsToFaceprints()
-                    rsid.MatchArgs matchArgs = new rsid.MatchArgs
-                    {
-                        newFaceprints = faceprintsToMatch,
-                        existingFaceprints = faceprintsDb,
-                        updatedFaceprints = faceprintsDb // init updated to existing vector.
-                    };
+                    var userIndex = matchResult.index;
+                    var userIdDb = _db.faceprintsArray[userIndex].Item2;
+                    VerifyResult(true, $"\"{userIdDb}\"", string.Empty);
 
-                    var matchResult = _authenticator.MatchFaceprintsToFaceprints(ref matchArgs);
-                    var userIndex = 0;
-                    if (matchResult.success == 1)
+                    // update the DB with the updated faceprints.
+                    if (matchResult.shouldUpdate > 0)
                     {
-                        VerifyResult(true, $"\"{userIdDb}\"", string.Empty);
-                        
-                        // update the DB with the updated faceprints.
-                        if (matchResult.shouldUpdate > 0)
-                        {
-                            // take the updated vector from the matchArgs that were sent by reference and updated 
-                            // during call to MatchFaceprintsToFaceprints() .
-
-                            bool update_success = UpdateUser(userIndex, userIdDb, ref matchArgs.updatedFaceprints);
+                        bool update_success = UpdateUser(userIndex, userIdDb, ref updatedFaceprints);
 
-                            ShowLog($"Adaptive DB Update success status for user-id [\"{userIdDb}\"] is : {update_success} ");
-                        }
-                        else
-                        {
-                            ShowLog($"Macth succeeded for user [\"{userIdDb}\"]. However adaptive update condition not passed, so no DB update applied.");
-                        }
-                        return;
+                        ShowLog($"Adaptive DB Update success status for user-id [\"{userIdDb}\"] is : {update_success} ");
+                    }
+                    else
+                    {
+                        ShowLog($"Macth succeeded for user [\"{userIdDb}\"]. However adaptive update condition not passed, so no DB update applied.");
                     }
-                    userIndex++;
+                    return;
                 }
 
                 VerifyResult(false, string.Empty, "No match found");
@@ -963,61 +951,87 @@ namespace rsid_wrapper_csharp
             }
         }
 
-        private void UIHandlePreview(int width, int height, int stride)
-        {
-            var targetWidth = (int)PreviewImage.Width;
-            var targetHeight = (int)PreviewImage.Height;
-
-            //create writable bitmap if not exists or if image size changed
-            if (_previewBitmap == null || targetWidth != width || targetHeight != height)
-            {
-                PreviewImage.Width = width;
-                PreviewImage.Height = height;
-                Console.WriteLine($"Creating new WriteableBitmap preview buffer {width}x{height}");
-                _previewBitmap = new WriteableBitmap(width, height, 96, 96, PixelFormats.Rgb24, null);
-                PreviewImage.Source = _previewBitmap;
-            }
-            Int32Rect sourceRect = new Int32Rect(0, 0, width, height);
-            lock (_previewMutex)
-            {
-                _previewBitmap.WritePixels(sourceRect, _previewBuffer, stride, 0);
-            }
-            RenderDetectedFaces(width, height);
-        }
+        [DllImport("kernel32.dll", EntryPoint = "RtlMoveMemory")]
+        private static extern void CopyMemory(IntPtr destination, IntPtr source, UIntPtr length);
 
-        // Handle preview callback.         
-        private void OnPreview(rsid.PreviewImage image, IntPtr ctx)
+        // Render the latest preview frame straight from the native frame into the bitmap's back buffer
+        private void UIRenderPreviewFrame()
         {
-            lock (_previewMutex)
+            using (var frame = Interlocked.Exchange(ref _pendingFrame, null))
             {
-                // If in dump frame mode, save the raw image to disk instead of displaying
-                if (_deviceState.PreviewConfig.previewMode == rsid.PreviewMode.Dump)
-                {
-                    HandleRawImage(image);
+                if (frame == null)
                     return;
+                var image = frame.Image;
+                var width = image.width;
+                var height = image.height;
+                var targetWidth = (int)PreviewImage.Width;
+                var targetHeight = (int)PreviewImage.Height;
+
+                //create writable bitmap if not exists or if image size changed
+                if (_previewBitmap == null || targetWidth != width || targetHeight != height)
+                {
+                    PreviewImage.Width = width;
+                    PreviewImage.Height = height;
+                    Console.WriteLine($"Creating new WriteableBitmap preview buffer {width}x{height}");
+                    _previewBitmap = new WriteableBitmap(width, height, 96, 96, PixelFormats.Rgb24, null);
+                    PreviewImage.Source = _previewBitmap;
                 }
 
-
-                // nothing to show if not vga
-                if (_deviceState.PreviewConfig.previewMode != rsid.PreviewMode.VGA || image.height < 2)
+                _previewBitmap.Lock();
+                try
                 {
-                    return;
+                    var backBuffer = _previewBitmap.BackBuffer;
+                    var backStride = _previewBitmap.BackBufferStride;
+                    var rowBytes = Math.Min(width * 3, Math.Min(image.stride, backStride));
+                    if (backStride == image.stride)
+                    {
+                        CopyMemory(backBuffer, image.buffer, (UIntPtr)(uint)Math.Min(image.size, backStride * height));
+                    }
+                    else
+                    {
+                        for (int row = 0; row < height; row++)
+                        {
+                            CopyMemory(backBuffer + row * backStride, image.buffer + row * image.stride, (UIntPtr)(uint)rowBytes);
+                        }
+                    }
+                    _previewBitmap.AddDirtyRect(new Int32Rect(0, 0, width, height));
                 }
-
-
-                // Copy frame to managed buffer and display it
-                if (_previewBuffer.Length != image.size)
+                finally
                 {
-                    Console.WriteLine("Creating preview buffer");
-                    _previewBuffer = new byte[image.size];
+                    _previewBitmap.Unlock();
                 }
-                Marshal.Copy(image.buffer, _previewBuffer, 0, image.size);
-                //if (_deviceState.PreviewConfig.previewMode == rsid.PreviewMode.FHD_Rect)
-                //{
-                //    _faceRect = image.metadata.face_rect; // Since faceRect is a struct this will copy by value                    
-                //}
+                RenderDetectedFaces(width, height);
+            }
+        }
+
+        // Handle preview frame callback.
+        // Frames are coalesced: if the UI did not render the previous frame yet, it is dropped and only the latest one
+        // is rendered, so a slow UI thread never backs up the preview.
+        private void OnPreviewFrame(rsid.PreviewFrame frame)
+        {
+            // If in dump frame mode, save the raw image to disk instead of displaying
+            if (_deviceState.PreviewConfig.previewMode == rsid.PreviewMode.Dump)
+            {
+                using (frame)
+                    HandleRawImage(frame.Image);
+                return;
+            }
+
+            // nothing to show if not vga
+            if (_deviceState.PreviewConfig.previewMode != rsid.PreviewMode.VGA || frame.Image.height < 2)
+            {
+                frame.Dispose();
+                return;
+            }
+
+            var previous = Interlocked.Exchange(ref _pendingFrame, frame);
+            if (previous != null)
+            {
+                // a render is already dispatched and takes the new frame
+                previous.Dispose();
+                return;
             }
-            RenderDispatch(() => UIHandlePreview(image.width, image.height, image.stride));
+            RenderDispatch(UIRenderPreviewFrame);
         }
 
         private void ResetDetectedFaces()
@@ -1546,7 +1560,7 @@ namespace rsid_wrapper_csharp
                     _preview = new rsid.Preview(_deviceState.PreviewConfig);
                 else
                     _preview.UpdateConfig(_deviceState.PreviewConfig);
-                _preview.Start(OnPreview);
+                _preview.StartFrames(OnPreviewFrame);
                 if (_flowMode == FlowMode.Server)
                     RefreshUserListServer();
                 else
@@ -1982,7 +1996,7 @@ namespace rsid_wrapper_csharp
                             _preview.Stop();
                             _deviceState.PreviewConfig = new rsid.PreviewConfig { cameraNumber = Settings.Default.CameraNumber, previewMode = (rsid.PreviewMode)deviceConfig.previewMode };
                             _preview.UpdateConfig(_deviceState.PreviewConfig);
-                            _preview.Start(OnPreview);
+                            _preview.StartFrames(OnPreviewFrame);
                             if (_deviceState.PreviewConfig.previewMode == rsid.PreviewMode.VGA)
                             {
                                 Thread.Sleep(750);
@@ -0,0 +1,735 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Daemon owning the devices, for several local processes to use them without opening the serial ports themselves.
+// Usage: rsidd <port>[,<port>...] [options]
+//   --socket <path>            unix domain socket to listen on (default /tmp/rsidd.sock)
+//   --baudrate <n>             baud rate of the devices (default 115200)
+//   --workers <n>              threads running the devices' operations (default 4)
+//   --session-reuse-ms <n>     idle time the device sessions are kept open (default 60000)
+//   --reconnect-ms <n>         time to wait for a device dropping off its port to come back (default 5000)
+//   --link-monitor-ms <n>      max ping interval of the idle devices' link monitor, reconnecting degraded links
+//                              (default 0, off)
+//   --database <path>          host mode users database, for the gallery commands (one device only)
+//   --preview <name>           publish the preview to the shared memory ring of the name (needs RSID_PREVIEW), for
+//                              the processes of the user and its group, like the socket
+//   --camera <n>               camera number of the preview (default auto detect)
+//
+// Protocol: text lines. Each request is "<id> <command> [arguments]", the id is chosen by the client and tags the
+// replies of the request, "<id> <event> [fields]", the last one being "<id> done <Status>". Clients may send requests
+// without waiting for the previous replies: the operations of a device run one at a time (on the daemon's persistent
+// session with it), queued authenticate and match requests first, then enrollments, then user queries and removals,
+// each in the order received. Operations of different devices run concurrently, and cancel, devices, metrics, link
+// and preview are answered at once.
+//   devices                          device <index> <Status>                  per device
+//   authenticate <device>            hint <AuthenticateStatus>, result <AuthenticateStatus> [<user id>]
+//   enroll <device> <user id>        hint <EnrollStatus>, progress <FacePose>, result <EnrollStatus>
+//   users <device>                   user <user id>                           per user
+//   remove-user <device> <user id>
+//   remove-all <device>
+//   cancel <device>                  cancels the running operation of the device
+//   match <device>                   authenticate against the host mode gallery (--database), replies as authenticate
+//   gallery-enroll <device> <user id>  enroll to the host mode gallery, replies as enroll
+//   gallery-remove <device> <user id>
+//   metrics                          counter <name> <value>, latency <name> <count> <p50> <p90> <p99> <max> (us)
+//   link <device>                    link <pings> <failed pings> <p50> <p90> (us) <reconnects> <baud rate>
+//   preview                          preview <name>                           the PreviewSubscriber ring to open
+// Invalid requests are replied with "<id> done Error" ("- done Error" if the line has no id).
+//
+// Stops on Ctrl-C. Returns 0 on Ctrl-C, 1 on invalid arguments or if the devices, the database, the preview or the
+// socket could not be opened.
+
+#include "RealSenseID/DeviceManager.h"
+#include "RealSenseID/FaceAuthenticator.h"
+#include "RealSenseID/HostModeAuthenticator.h"
+#include "RealSenseID/Metrics.h"
+#include "RealSenseID/UserIdsCallback.h"
+#ifdef RSID_PREVIEW
+#include "RealSenseID/PreviewBroadcast.h"
+#endif // RSID_PREVIEW
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef RSID_SECURE
+#include "secure_mode_helper.h"
+static RealSenseID::Examples::SignHelper s_signer;
+#endif // RSID_SECURE
+
+using RealSenseID::Status;
+using Priority = RealSenseID::DeviceManager::Priority;
+
+namespace
+{
+const int POLL_TIMEOUT_MS = 200; // max delay to notice a stop
+const size_t MAX_REQUEST_LENGTH = 4096;
+
+std::atomic<bool> s_stop {false};
+
+struct DaemonOptions
+{
+    std::vector<std::string> ports;
+    std::string socket_path = "/tmp/rsidd.sock";
+    unsigned int baudrate = 115200;
+    unsigned int workers = RealSenseID::DeviceManager::DefaultWorkers;
+    unsigned int session_reuse_ms = 60000;
+    unsigned int reconnect_ms = 5000;
+    unsigned int link_monitor_ms = 0;
+    std::string database_path;
+    std::string preview_name;
+    int camera_number = -1;
+};
+
+// connection of a client. replies may be sent from any thread, closing it makes the later ones no-ops
+class Client
+{
+public:
+    explicit Client(int fd) : _fd {fd}
+    {
+    }
+
+    ~Client()
+    {
+        Close();
+    }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    int Fd() const
+    {
+        return _fd;
+    }
+
+    std::string& Input()
+    {
+        return _input;
+    }
+
+    void Reply(const std::string& id, const std::string& event)
+    {
+        std::string line = id + " " + event + "\n";
+        std::lock_guard<std::mutex> lock {_mutex};
+        size_t sent = 0;
+        while (_fd >= 0 && sent < line.size())
+        {
+            auto rv = ::send(_fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+            if (rv <= 0)
+            {
+                if (rv < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                // gone, the poll loop closes it
+                break;
+            }
+            sent += static_cast<size_t>(rv);
+        }
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock {_mutex};
+        if (_fd >= 0)
+        {
+            ::close(_fd);
+            _fd = -1;
+        }
+    }
+
+private:
+    int _fd;
+    std::string _input; // partial request line, poll thread only
+    std::mutex _mutex;
+};
+
+using ClientPtr = std::shared_ptr<Client>;
+
+// status strings as single tokens
+std::string token(const char* description)
+{
+    std::string text = description;
+    std::replace(text.begin(), text.end(), ' ', '_');
+    return text;
+}
+
+class AuthReply : public RealSenseID::AuthenticationCallback
+{
+public:
+    AuthReply(ClientPtr client, std::string id) : _client {std::move(client)}, _id {std::move(id)}
+    {
+    }
+
+    void OnResult(const RealSenseID::AuthenticateStatus status, const char* user_id) override
+    {
+        std::string event = "result " + token(RealSenseID::Description(status));
+        if (status == RealSenseID::AuthenticateStatus::Success && user_id != nullptr)
+        {
+            event += std::string(" ") + user_id;
+        }
+        _client->Reply(_id, event);
+    }
+
+    void OnHint(const RealSenseID::AuthenticateStatus hint) override
+    {
+        _client->Reply(_id, "hint " + token(RealSenseID::Description(hint)));
+    }
+
+private:
+    ClientPtr _client;
+    std::string _id;
+};
+
+class EnrollReply : public RealSenseID::EnrollmentCallback
+{
+public:
+    EnrollReply(ClientPtr client, std::string id) : _client {std::move(client)}, _id {std::move(id)}
+    {
+    }
+
+    void OnResult(const RealSenseID::EnrollStatus status) override
+    {
+        _client->Reply(_id, "result " + token(RealSenseID::Description(status)));
+    }
+
+    void OnProgress(const RealSenseID::FacePose pose) override
+    {
+        _client->Reply(_id, "progress " + token(RealSenseID::Description(pose)));
+    }
+
+    void OnHint(const RealSenseID::EnrollStatus hint) override
+    {
+        _client->Reply(_id, "hint " + token(RealSenseID::Description(hint)));
+    }
+
+private:
+    ClientPtr _client;
+    std::string _id;
+};
+
+class UsersReply : public RealSenseID::UserIdsCallback
+{
+public:
+    UsersReply(ClientPtr client, std::string id) : _client {std::move(client)}, _id {std::move(id)}
+    {
+    }
+
+    void OnUserId(const char* user_id) override
+    {
+        _client->Reply(_id, std::string("user ") + user_id);
+    }
+
+private:
+    ClientPtr _client;
+    std::string _id;
+};
+
+class Daemon
+{
+public:
+    explicit Daemon(const DaemonOptions& options) :
+#ifdef RSID_SECURE
+        _manager {&s_signer, options.workers},
+#else
+        _manager {options.workers},
+#endif
+        _options {options}
+    {
+    }
+
+    ~Daemon()
+    {
+        _manager.CancelAll();
+        _manager.Disconnect();
+        _gallery.reset();
+    }
+
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+
+    bool Open()
+    {
+        std::vector<RealSenseID::SerialConfig> configs(_options.ports.size());
+        for (size_t i = 0; i < configs.size(); i++)
+        {
+            configs[i].port = _options.ports[i].c_str();
+            configs[i].baudrate = _options.baudrate;
+        }
+        if (_manager.Connect(configs) != Status::Ok)
+        {
+            std::cerr << "Failed connecting to the devices" << std::endl;
+            return false;
+        }
+
+        // keep the sessions between the clients' operations
+        const unsigned int session_reuse_ms = _options.session_reuse_ms;
+        const unsigned int reconnect_ms = _options.reconnect_ms;
+        _manager.SubmitAll([session_reuse_ms, reconnect_ms](RealSenseID::FaceAuthenticator& authenticator, size_t) {
+            authenticator.SetSessionReuseTimeout(session_reuse_ms);
+            authenticator.SetAutoReconnect(reconnect_ms);
+        });
+        RealSenseID::LinkMonitorConfig link_monitor;
+        link_monitor.maxIntervalMs = _options.link_monitor_ms;
+        _manager.SetLinkMonitor(link_monitor);
+
+        if (!_options.database_path.empty())
+        {
+            bool opened = false;
+            const std::string database_path = _options.database_path;
+            _manager.Submit(0, [this, &opened, database_path](RealSenseID::FaceAuthenticator& authenticator, size_t) {
+                _gallery.reset(new RealSenseID::HostModeAuthenticator(authenticator));
+                opened = _gallery->Open(database_path.c_str());
+            });
+            _manager.WaitIdle();
+            if (!opened)
+            {
+                std::cerr << "Failed opening " << database_path << std::endl;
+                return false;
+            }
+        }
+        _manager.WaitIdle();
+
+#ifdef RSID_PREVIEW
+        if (!_options.preview_name.empty())
+        {
+            RealSenseID::PreviewConfig config;
+            config.cameraNumber = _options.camera_number;
+            _preview.reset(new RealSenseID::PreviewBroker(config, _options.preview_name.c_str(),
+                                                          RealSenseID::PreviewBroker::DefaultSlots, true));
+            if (!_preview->Start())
+            {
+                std::cerr << "Failed starting the preview" << std::endl;
+                return false;
+            }
+        }
+#endif // RSID_PREVIEW
+        return true;
+    }
+
+    void HandleRequest(const ClientPtr& client, const std::string& line)
+    {
+        std::istringstream tokens {line};
+        std::string id, command;
+        if (!(tokens >> id))
+        {
+            return; // empty line
+        }
+        if (!(tokens >> command) || !Dispatch(client, id, command, tokens))
+        {
+            client->Reply(id, "done Error");
+        }
+    }
+
+private:
+    RealSenseID::DeviceManager _manager;
+    DaemonOptions _options;
+    std::unique_ptr<RealSenseID::HostModeAuthenticator> _gallery; // of device 0, used on its operations only
+#ifdef RSID_PREVIEW
+    std::unique_ptr<RealSenseID::PreviewBroker> _preview;
+#endif // RSID_PREVIEW
+
+    // run the operation on the device, the request is done when it returns
+    bool Submit(const ClientPtr& client, const std::string& id, size_t device, Priority priority,
+                std::function<Status(RealSenseID::FaceAuthenticator&)> operation)
+    {
+        auto status = _manager.Submit(
+            device,
+            [client, id, operation](RealSenseID::FaceAuthenticator& authenticator, size_t) {
+                auto operation_status = operation(authenticator);
+                client->Reply(id, "done " + token(RealSenseID::Description(operation_status)));
+            },
+            priority);
+        return status == Status::Ok;
+    }
+
+    // false on invalid requests
+    bool Dispatch(const ClientPtr& client, const std::string& id, const std::string& command,
+                  std::istringstream& arguments)
+    {
+        if (command == "devices")
+        {
+            for (size_t i = 0; i < _manager.DeviceCount(); i++)
+            {
+                client->Reply(id, "device " + std::to_string(i) + " " +
+                                      token(RealSenseID::Description(_manager.DeviceStatus(i))));
+            }
+            client->Reply(id, "done Ok");
+            return true;
+        }
+        if (command == "metrics")
+        {
+            ReplyMetrics(*client, id);
+            return true;
+        }
+        if (command == "preview")
+        {
+            if (PreviewName().empty())
+            {
+                return false;
+            }
+            client->Reply(id, "preview " + PreviewName());
+            client->Reply(id, "done Ok");
+            return true;
+        }
+
+        size_t device = 0;
+        if (!(arguments >> device) || device >= _manager.DeviceCount())
+        {
+            return false;
+        }
+        std::string user_id;
+        std::getline(arguments >> std::ws, user_id);
+        if (user_id.size() >= RealSenseID::FaceAuthenticator::MAX_USERID_LENGTH)
+        {
+            return false;
+        }
+        const bool has_user = !user_id.empty();
+
+        if (command == "link")
+        {
+            RealSenseID::LinkQuality quality;
+            _manager.GetLinkQuality(device, quality);
+            client->Reply(id, "link " + std::to_string(quality.pings) + " " + std::to_string(quality.failedPings) +
+                                  " " + std::to_string(quality.rttP50Us) + " " + std::to_string(quality.rttP90Us) +
+                                  " " + std::to_string(quality.reconnects) + " " + std::to_string(quality.baudrate));
+            client->Reply(id, "done Ok");
+            return true;
+        }
+        if (command == "cancel")
+        {
+            client->Reply(id, "done " + token(RealSenseID::Description(_manager.Cancel(device))));
+            return true;
+        }
+        if (command == "authenticate")
+        {
+            return Submit(client, id, device, Priority::High, [client, id](RealSenseID::FaceAuthenticator& authenticator) {
+                AuthReply callback {client, id};
+                return authenticator.Authenticate(callback);
+            });
+        }
+        if (command == "enroll" && has_user)
+        {
+            return Submit(client, id, device, Priority::Normal, [client, id, user_id](RealSenseID::FaceAuthenticator& authenticator) {
+                EnrollReply callback {client, id};
+                return authenticator.Enroll(callback, user_id.c_str());
+            });
+        }
+        if (command == "users")
+        {
+            return Submit(client, id, device, Priority::Low, [client, id](RealSenseID::FaceAuthenticator& authenticator) {
+                UsersReply callback {client, id};
+                return authenticator.QueryUserIds(callback);
+            });
+        }
+        if (command == "remove-user" && has_user)
+        {
+            return Submit(client, id, device, Priority::Low, [user_id](RealSenseID::FaceAuthenticator& authenticator) {
+                return authenticator.RemoveUser(user_id.c_str());
+            });
+        }
+        if (command == "remove-all")
+        {
+            return Submit(client, id, device, Priority::Low,
+                          [](RealSenseID::FaceAuthenticator& authenticator) { return authenticator.RemoveAll(); });
+        }
+
+        // host mode gallery of device 0
+        auto* gallery = _gallery.get();
+        if (gallery == nullptr || device != 0)
+        {
+            return false;
+        }
+        if (command == "match")
+        {
+            return Submit(client, id, device, Priority::High, [client, id, gallery](RealSenseID::FaceAuthenticator&) {
+                AuthReply callback {client, id};
+                return gallery->Authenticate(callback);
+            });
+        }
+        if (command == "gallery-enroll" && has_user)
+        {
+            return Submit(client, id, device, Priority::Normal, [client, id, gallery, user_id](RealSenseID::FaceAuthenticator&) {
+                EnrollReply callback {client, id};
+                return gallery->Enroll(callback, user_id.c_str());
+            });
+        }
+        if (command == "gallery-remove" && has_user)
+        {
+            return Submit(client, id, device, Priority::Low, [gallery, user_id](RealSenseID::FaceAuthenticator&) {
+                return gallery->RemoveUser(user_id.c_str()) ? Status::Ok : Status::Error;
+            });
+        }
+        return false;
+    }
+
+    std::string PreviewName() const
+    {
+#ifdef RSID_PREVIEW
+        if (_preview)
+        {
+            return _options.preview_name;
+        }
+#endif // RSID_PREVIEW
+        return std::string();
+    }
+
+    static void ReplyMetrics(Client& client, const std::string& id)
+    {
+        using namespace RealSenseID::Metrics;
+        auto snapshot = GetSnapshot();
+        for (size_t i = 0; i < CounterCount; i++)
+        {
+            auto counter = static_cast<Counter>(i);
+            client.Reply(id, std::string("counter ") + Name(counter) + " " + std::to_string(snapshot.Get(counter)));
+        }
+        for (size_t i = 0; i < LatencyCount; i++)
+        {
+            auto latency = static_cast<Latency>(i);
+            const auto& stats = snapshot.Get(latency);
+            client.Reply(id, std::string("latency ") + Name(latency) + " " + std::to_string(stats.count) + " " +
+                                 std::to_string(stats.p50Us) + " " + std::to_string(stats.p90Us) + " " +
+                                 std::to_string(stats.p99Us) + " " + std::to_string(stats.maxUs));
+        }
+        client.Reply(id, "done Ok");
+    }
+};
+
+void print_usage()
+{
+    std::cout << "Usage: rsidd <port>[,<port>...] [--socket <path>] [--baudrate <n>] [--workers <n>]"
+                 " [--session-reuse-ms <n>] [--reconnect-ms <n>] [--link-monitor-ms <n>] [--database <path>]"
+                 " [--preview <name>] [--camera <n>]"
+              << std::endl;
+}
+
+bool parse_number(const char* token, unsigned int& value)
+{
+    char* end = nullptr;
+    auto parsed = std::strtoul(token, &end, 10);
+    if (*token == '\0' || *end != '\0')
+    {
+        return false;
+    }
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream tokens {list};
+    std::string item;
+    while (std::getline(tokens, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool options_from_argv(int argc, char* argv[], DaemonOptions& options)
+{
+    if (argc < 2)
+    {
+        return false;
+    }
+    options.ports = split_list(argv[1]);
+    for (int i = 2; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const char* name = argv[i];
+        const char* value = argv[++i];
+        unsigned int number = 0;
+        if (::strcmp(name, "--socket") == 0 && ::strlen(value) < sizeof(sockaddr_un::sun_path))
+        {
+            options.socket_path = value;
+        }
+        else if (::strcmp(name, "--baudrate") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.baudrate = number;
+        }
+        else if (::strcmp(name, "--workers") == 0 && parse_number(value, number) && number > 0)
+        {
+            options.workers = number;
+        }
+        else if (::strcmp(name, "--session-reuse-ms") == 0 && parse_number(value, number))
+        {
+            options.session_reuse_ms = number;
+        }
+        else if (::strcmp(name, "--reconnect-ms") == 0 && parse_number(value, number))
+        {
+            options.reconnect_ms = number;
+        }
+        else if (::strcmp(name, "--link-monitor-ms") == 0 && parse_number(value, number))
+        {
+            options.link_monitor_ms = number;
+        }
+        else if (::strcmp(name, "--database") == 0)
+        {
+            options.database_path = value;
+        }
+#ifdef RSID_PREVIEW
+        else if (::strcmp(name, "--preview") == 0)
+        {
+            options.preview_name = value;
+        }
+        else if (::strcmp(name, "--camera") == 0 && parse_number(value, number))
+        {
+            options.camera_number = static_cast<int>(number);
+        }
+#endif // RSID_PREVIEW
+        else
+        {
+            return false;
+        }
+    }
+    // the gallery's database file can't be shared by several devices
+    return !options.ports.empty() && (options.database_path.empty() || options.ports.size() == 1);
+}
+
+int listen_socket(const std::string& path)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    struct sockaddr_un address;
+    ::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    ::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    ::unlink(path.c_str()); // of a daemon that didn't stop
+    if (::bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 16) != 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    // the clients of the user and its group
+    ::chmod(path.c_str(), 0660);
+    return fd;
+}
+
+// read what the client sent and handle its complete lines. false when the client is gone
+bool read_requests(Daemon& daemon, const ClientPtr& client)
+{
+    char buffer[4096];
+    auto rv = ::recv(client->Fd(), buffer, sizeof(buffer), 0);
+    if (rv <= 0)
+    {
+        return rv < 0 && errno == EINTR;
+    }
+    auto& input = client->Input();
+    input.append(buffer, static_cast<size_t>(rv));
+    size_t start = 0;
+    size_t end = 0;
+    while ((end = input.find('\n', start)) != std::string::npos)
+    {
+        daemon.HandleRequest(client, input.substr(start, end - start));
+        start = end + 1;
+    }
+    input.erase(0, start);
+    if (input.size() > MAX_REQUEST_LENGTH)
+    {
+        client->Reply("-", "done Error");
+        return false;
+    }
+    return true;
+}
+
+void on_signal(int)
+{
+    s_stop = true;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    DaemonOptions options;
+    if (!options_from_argv(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    Daemon daemon {options};
+    if (!daemon.Open())
+    {
+        return 1;
+    }
+    int listener = listen_socket(options.socket_path);
+    if (listener < 0)
+    {
+        std::cerr << "Failed listening on " << options.socket_path << ". errno " << errno << std::endl;
+        return 1;
+    }
+    std::cerr << "Serving " << options.ports.size() << " devices on " << options.socket_path << std::endl;
+
+    std::vector<ClientPtr> clients;
+    while (!s_stop)
+    {
+        std::vector<struct pollfd> poll_fds {{listener, POLLIN, 0}};
+        for (const auto& client : clients)
+        {
+            poll_fds.push_back({client->Fd(), POLLIN, 0});
+        }
+        int poll_rv = ::poll(poll_fds.data(), poll_fds.size(), POLL_TIMEOUT_MS);
+        if (poll_rv <= 0)
+        {
+            continue;
+        }
+
+        // clients are handled in the order of poll_fds, new ones are appended after
+        std::vector<ClientPtr> open_clients;
+        for (size_t i = 0; i < clients.size(); i++)
+        {
+            const auto revents = poll_fds[i + 1].revents;
+            if (revents != 0 && !read_requests(daemon, clients[i]))
+            {
+                clients[i]->Close(); // its pending operations still run, their replies are dropped
+                continue;
+            }
+            open_clients.push_back(clients[i]);
+        }
+        clients.swap(open_clients);
+
+        if (poll_fds[0].revents & POLLIN)
+        {
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                clients.push_back(std::make_shared<Client>(fd));
+            }
+        }
+    }
+
+    for (auto& client : clients)
+    {
+        client->Close();
+    }
+    ::close(listener);
+    ::unlink(options.socket_path.c_str());
+    return 0;
+}
@@ -12,6 +12,7 @@
 #define RSID_NUMBER_OF_RECOGNITION_FACEPRINTS 256
 #define RSID_FEATURES_VECTOR_ALLOC_SIZE 256
 #define RSID_MAX_FACES                        10 // max number of detected faces in single frame
+#define RSID_MAX_USERID_LENGTH                31 // user id chunk of the user ids buffers, including the '\0'
 
 #ifdef __cplusplus
 extern "C"
@@ -144,6 +145,34 @@ extern "C"
         rsid_faceprints updated_faceprints;
     } rsid_match_args;
 
+    /* rsid_match_faceprints_to_array() result */
+    typedef struct rsid_match_array_result
+    {
+        int success;
+        int should_update;
+        int index; /* index of the matched faceprints in the array, -1 if none */
+        int score;
+        int confidence;
+    } rsid_match_array_result;
+
+    /* rsid_match_faceprints_top_k() candidate */
+    typedef struct rsid_match_candidate
+    {
+        int index; /* index of the candidate's faceprints in the array */
+        int score;
+        int confidence;
+    } rsid_match_candidate;
+
+    /* user id callback (of streaming user ids query) */
+    typedef void (*rsid_user_id_clbk)(const char* user_id, void* ctx);
+
+    /* user ids of a query, in one allocation (see rsid_query_user_ids_arena) */
+    typedef struct
+    {
+        unsigned int number_of_users;
+        char* user_ids; /* number_of_users consecutive '\0' terminated chunks of RSID_MAX_USERID_LENGTH chars */
+    } rsid_user_ids;
+
     /* log callback */
     typedef void (*rsid_log_clbk)(rsid_log_level log_level, const char* msg);
 
@@ -207,6 +236,11 @@ RSID_C_API rsid_authenticator* rsid_create_authenticator();
     /* remove given user the the device */
     RSID_C_API rsid_status rsid_remove_user(rsid_authenticator* authenticator, const char* user_id);
 
+    /* remove given users from the device, pipelined over one session. returns the status of the first user that
+     * failed to be removed (the others are still removed) */
+    RSID_C_API rsid_status rsid_remove_users(rsid_authenticator* authenticator, const char** user_ids,
+                                             unsigned int number_of_users);
+
     /* remove all users from the device */
     RSID_C_API rsid_status rsid_remove_all_users(rsid_authenticator* authenticator);
 
@@ -237,11 +271,31 @@ RSID_C_API rsid_authenticator* rsid_create_authenticator();
      * On successfull operation, the result copied into the result_buf and number_of_users is updated accordingly.
      * The result buf will contain all user ids (31 byte chunks).
      * Note: result_buf must be allocted with size of at least (number_of_users * 31)
+     *       The ids are written to result_buf as they arrive, without intermediate allocations. Users beyond
+     *       number_of_users are not copied.
      */
 
     RSID_C_API rsid_status rsid_query_user_ids_to_buf(rsid_authenticator* authenticator, char* result_buf,
                                                       unsigned int* number_of_users);
 
+    /*
+     * Query ids of all enrolled users from device, without allocating a user ids array in advance.
+     * clbk is called for each user id as it arrives (the user id is valid only during the call).
+     * Note: clbk must not call other rsid_* functions of this authenticator.
+     */
+    RSID_C_API rsid_status rsid_query_user_ids_clbk(rsid_authenticator* authenticator, rsid_user_id_clbk clbk,
+                                                    void* ctx);
+
+    /*
+     * Query ids of all enrolled users from device into a single buffer allocated by the library, without querying
+     * the number of users first.
+     * On successfull operation, user_ids holds the ids (free them with rsid_free_user_ids), on failure it is empty.
+     */
+    RSID_C_API rsid_status rsid_query_user_ids_arena(rsid_authenticator* authenticator, rsid_user_ids* user_ids);
+
+    /* free the buffer of rsid_query_user_ids_arena and empty user_ids */
+    RSID_C_API void rsid_free_user_ids(rsid_user_ids* user_ids);
+
     /*
      * Get number of enrolled users from device.
      * On successfull operation, the result is placed in number_of_users.
@@ -265,6 +319,48 @@ RSID_C_API rsid_authenticator* rsid_create_authenticator();
     /* Prepare device to standby */
     RSID_C_API rsid_status rsid_standby(rsid_authenticator* authenticator);
 
+    /* wake the device and start the session ahead of the next request, kept for it within hold_ms (see
+     * FaceAuthenticator::Prewarm) */
+    RSID_C_API rsid_status rsid_prewarm(rsid_authenticator* authenticator, unsigned int hold_ms);
+
+    /*
+     * async flows (see FaceAuthenticator's *Async methods). each returns at once with a handle of the operation, which
+     * runs on the SDK's executor threads. the args' callbacks are called on the executor thread and must stay valid
+     * until done_clbk is called. done_clbk is called once with the flow's status when the operation is done, on the
+     * executor thread or, for an operation canceled before it started, on the thread which canceled it (possibly
+     * before the handle is returned). returns null on failure (done_clbk is not called).
+     */
+    typedef struct rsid_async_operation rsid_async_operation;
+    typedef void (*rsid_async_done_clbk)(rsid_status status, void* ctx);
+
+    RSID_C_API rsid_async_operation* rsid_enroll_async(rsid_authenticator* authenticator, const rsid_enroll_args* args,
+                                                       rsid_async_done_clbk done_clbk, void* done_ctx);
+
+    RSID_C_API rsid_async_operation* rsid_authenticate_async(rsid_authenticator* authenticator,
+                                                             const rsid_auth_args* args, rsid_async_done_clbk done_clbk,
+                                                             void* done_ctx);
+
+    /* cancel the operation to stop the loop */
+    RSID_C_API rsid_async_operation* rsid_authenticate_loop_async(rsid_authenticator* authenticator,
+                                                                  const rsid_auth_args* args,
+                                                                  rsid_async_done_clbk done_clbk, void* done_ctx);
+
+    RSID_C_API rsid_async_operation* rsid_extract_faceprints_for_enroll_async(rsid_authenticator* authenticator,
+                                                                              const rsid_enroll_ext_args* args,
+                                                                              rsid_async_done_clbk done_clbk,
+                                                                              void* done_ctx);
+
+    RSID_C_API rsid_async_operation* rsid_extract_faceprints_for_auth_async(rsid_authenticator* authenticator,
+                                                                            const rsid_faceprints_ext_args* args,
+                                                                            rsid_async_done_clbk done_clbk,
+                                                                            void* done_ctx);
+
+    /* cancel the operation. one that has not started yet is done at once, a running one once the device replies */
+    RSID_C_API void rsid_async_cancel(rsid_async_operation* operation);
+
+    /* release the handle. does not cancel the operation */
+    RSID_C_API void rsid_async_destroy(rsid_async_operation* operation);
+
     /*
      * device controller functions
      */
@@ -316,6 +412,19 @@ RSID_C_API rsid_authenticator* rsid_create_authenticator();
 
     RSID_C_API rsid_match_result rsid_match_faceprints(rsid_authenticator* authenticator, rsid_match_args* args);
 
+    /* match faceprints against an array of faceprints (1:N). updated_faceprints is written if should_update is set */
+    RSID_C_API rsid_match_array_result rsid_match_faceprints_to_array(rsid_authenticator* authenticator,
+                                                                      const rsid_faceprints* new_faceprints,
+                                                                      const rsid_faceprints* existing_faceprints_array,
+                                                                      size_t count,
+                                                                      rsid_faceprints* updated_faceprints);
+
+    /* find the k most similar faceprints of an array. candidates must hold k elements. returns the number written */
+    RSID_C_API size_t rsid_match_faceprints_top_k(rsid_authenticator* authenticator,
+                                                  const rsid_faceprints* new_faceprints,
+                                                  const rsid_faceprints* existing_faceprints_array, size_t count,
+                                                  size_t k, rsid_match_candidate* candidates);
+
 #ifdef __cplusplus
 }
 #endif //__cplusplus
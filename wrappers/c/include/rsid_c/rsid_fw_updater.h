@@ -55,6 +55,12 @@ extern "C"
                                                 rsid_fw_update_settings settings, const char* bin_path,
                                                 int exclude_recognition);
 
+    /* performs a firmware update from a firmware binary package in memory (e.g. downloaded), without a file */
+    RSID_C_API rsid_status rsid_update_firmware_from_buffer(rsid_fw_updater* handle,
+                                                            const rsid_fw_update_event_handler* event_handler,
+                                                            rsid_fw_update_settings settings, const void* image,
+                                                            size_t image_size, int exclude_recognition);
+
 #ifdef __cplusplus
 }
 #endif //__cplusplus
@@ -0,0 +1,131 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "rsid_client.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif //__cplusplus
+
+    /* native gallery of users' faceprints for host mode matching (RealSenseID::HostFaceprintsGallery).
+     * not thread safe */
+    typedef struct
+    {
+        void* _impl;
+    } rsid_faceprints_gallery;
+
+    /* reason a record of a bulk import was rejected */
+    typedef enum
+    {
+        RSID_Import_InvalidRecord,     /* the record could not be decoded */
+        RSID_Import_InvalidFaceprints, /* no descriptor or features out of the valid range */
+        RSID_Import_DuplicateUserId    /* id of a user already in the gallery or earlier in the import */
+    } rsid_import_record_error;
+
+    /* rejected record of a bulk import */
+    typedef struct
+    {
+        size_t record; /* index of the record in the import */
+        rsid_import_record_error error;
+    } rsid_import_error;
+
+    /* pair of similar users, first < second are their indices in the gallery */
+    typedef struct
+    {
+        int first;
+        int second;
+        int score;
+    } rsid_similar_pair;
+
+    /* receives the next similar pairs found. return 0 to stop the search */
+    typedef int (*rsid_similar_pairs_clbk)(const rsid_similar_pair* pairs, size_t n_pairs, void* ctx);
+
+    /* returned by the functions returning a user's index if they failed (e.g. out of memory). no function throws,
+     * the others return their failure value on errors (0, NULL or an unsuccessful match result) */
+#define RSID_GALLERY_ERROR ((size_t)-1)
+
+    /* NULL on failure */
+    RSID_C_API rsid_faceprints_gallery* rsid_create_faceprints_gallery();
+    RSID_C_API void rsid_destroy_faceprints_gallery(rsid_faceprints_gallery* gallery);
+
+    /* add a user. return the user's index, RSID_GALLERY_ERROR on failure */
+    RSID_C_API size_t rsid_gallery_add(rsid_faceprints_gallery* gallery, const char* user_id,
+                                       const rsid_faceprints* faceprints);
+
+    /* add count users from contiguous arrays of count * RSID_FEATURES_VECTOR_ALLOC_SIZE features (one row per user).
+     * user_ids and orig_descriptors may be NULL (no ids, orig vectors same as the avg vectors).
+     * return the index of the first added user, RSID_GALLERY_ERROR on failure */
+    RSID_C_API size_t rsid_gallery_add_bulk(rsid_faceprints_gallery* gallery, const char* const* user_ids,
+                                            const short* avg_descriptors, const short* orig_descriptors,
+                                            size_t count, int version, int number_of_descriptors);
+
+    /* import users from a faceprints bulk file (written by rsid_gallery_export_file), in parallel. rejected records
+     * (undecodable, invalid or with the id of another user) are skipped, the first max_errors of them are written to
+     * errors and their number to num_errors (both may be NULL). return the number of imported users */
+    RSID_C_API size_t rsid_gallery_import_file(rsid_faceprints_gallery* gallery, const char* path,
+                                               rsid_import_error* errors, size_t max_errors, size_t* num_errors);
+
+    /* write all the users to a faceprints bulk file. return 1 on success, 0 on failure */
+    RSID_C_API int rsid_gallery_export_file(rsid_faceprints_gallery* gallery, const char* path);
+
+    /* write all the users to an Arrow IPC file (columns user_id, avg_descriptor, orig_descriptor, version,
+     * number_of_descriptors, features_type) for analytics tools. return 1 on success */
+    RSID_C_API int rsid_gallery_export_arrow_file(rsid_faceprints_gallery* gallery, const char* path);
+
+    /* import users from an Arrow IPC file with the columns of rsid_gallery_export_arrow_file, as
+     * rsid_gallery_import_file */
+    RSID_C_API size_t rsid_gallery_import_arrow_file(rsid_faceprints_gallery* gallery, const char* path,
+                                                     rsid_import_error* errors, size_t max_errors, size_t* num_errors);
+
+    /* replace the faceprints of a user. return 1 on success, 0 if index is out of range */
+    RSID_C_API int rsid_gallery_update(rsid_faceprints_gallery* gallery, size_t index,
+                                       const rsid_faceprints* faceprints);
+
+    /* remove a user, the last user is moved to its index. return 1 on success, 0 if index is out of range */
+    RSID_C_API int rsid_gallery_remove(rsid_faceprints_gallery* gallery, size_t index);
+
+    /* index of the user, -1 if not found */
+    RSID_C_API int rsid_gallery_find(rsid_faceprints_gallery* gallery, const char* user_id);
+
+    /* user id at the given index, NULL if index is out of range */
+    RSID_C_API const char* rsid_gallery_user_id(rsid_faceprints_gallery* gallery, size_t index);
+
+    /* copy the faceprints of a user. return 1 on success, 0 if index is out of range */
+    RSID_C_API int rsid_gallery_get_faceprints(rsid_faceprints_gallery* gallery, size_t index,
+                                               rsid_faceprints* faceprints);
+
+    RSID_C_API void rsid_gallery_clear(rsid_faceprints_gallery* gallery);
+    /* the capacity is unchanged if it can't be allocated */
+    RSID_C_API void rsid_gallery_reserve(rsid_faceprints_gallery* gallery, size_t capacity);
+    RSID_C_API size_t rsid_gallery_size(rsid_faceprints_gallery* gallery);
+
+    /* match faceprints against the gallery (1:N). updated_faceprints is written if should_update is set, the gallery
+     * is not changed (use rsid_gallery_update) */
+    RSID_C_API rsid_match_array_result rsid_gallery_match(rsid_faceprints_gallery* gallery,
+                                                          const rsid_faceprints* new_faceprints,
+                                                          rsid_faceprints* updated_faceprints);
+
+    /* verify faceprints against the claimed user (1:1, found by its id). updated_faceprints is written if should_update
+     * is set, the gallery is not changed (use rsid_gallery_update) */
+    RSID_C_API rsid_match_array_result rsid_gallery_verify(rsid_faceprints_gallery* gallery,
+                                                           const rsid_faceprints* new_faceprints, const char* user_id,
+                                                           rsid_faceprints* updated_faceprints);
+
+    /* find the k most similar users. candidates must hold k elements. return the number written */
+    RSID_C_API size_t rsid_gallery_match_top_k(rsid_faceprints_gallery* gallery, const rsid_faceprints* new_faceprints,
+                                               size_t k, rsid_match_candidate* candidates);
+
+    /* find all the pairs of users scoring above the threshold against each other (the identical person threshold if
+     * negative), passed to the callback as they are found, on num_threads threads (number of cores if 0). return 0 if
+     * the gallery failed validation or the search was stopped */
+    RSID_C_API int rsid_gallery_find_similar_pairs(rsid_faceprints_gallery* gallery, int threshold,
+                                                   unsigned int num_threads, rsid_similar_pairs_clbk callback,
+                                                   void* ctx);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
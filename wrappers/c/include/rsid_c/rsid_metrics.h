@@ -0,0 +1,144 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "rsid_export.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif //__cplusplus
+
+    /* counters (same order as RealSenseID::Metrics::Counter) */
+    typedef enum
+    {
+        RSID_Counter_PacketsSent,
+        RSID_Counter_PacketsReceived,
+        RSID_Counter_BytesSent,
+        RSID_Counter_BytesReceived,
+        RSID_Counter_RecvTimeouts,
+        RSID_Counter_CrcErrors,
+        RSID_Counter_RecvErrors,
+        RSID_Counter_PacketRetries,
+        RSID_Counter_SessionsStarted,
+        RSID_Counter_SessionsReused,
+        RSID_Counter_SessionFailures,
+        RSID_Counter_Reconnects,
+        RSID_Counter_Matches,
+        RSID_Counter_PreviewFramesCaptured,
+        RSID_Counter_PreviewFramesDelivered,
+        RSID_Counter_PreviewFramesDropped,
+        RSID_Counter_CallbackEventsDropped,
+        RSID_Counter_PacketRetransmits,
+        RSID_Counter_LinkPingFailures,
+        RSID_Counter_LinkReconnects,
+        RSID_Counter_Prewarms,
+        RSID_Counter_PrewarmsUsed,
+        RSID_Counter_DeviceTierMatches,
+        RSID_Counter_HostTierFallbacks,
+        RSID_Counter_CoalescedMessages,
+        RSID_Counter_InexactMatches,
+        RSID_Counter_Count
+    } rsid_metrics_counter;
+
+    /* latency histograms (same order as RealSenseID::Metrics::Latency) */
+    typedef enum
+    {
+        RSID_Latency_PacketTransfer,
+        RSID_Latency_RequestReply,
+        RSID_Latency_SessionSetup,
+        RSID_Latency_Enroll,
+        RSID_Latency_Authenticate,
+        RSID_Latency_ExtractFaceprints,
+        RSID_Latency_Match,
+        RSID_Latency_PreviewDelivery,
+        RSID_Latency_DeviceWait,
+        RSID_Latency_LinkPing,
+        RSID_Latency_ClockSync,
+        RSID_Latency_Wake,
+        RSID_Latency_Count
+    } rsid_metrics_latency;
+
+    /* latency summary in microseconds */
+    typedef struct
+    {
+        unsigned long long count;
+        unsigned long long sum_us;
+        unsigned long long min_us;
+        unsigned long long max_us;
+        unsigned long long p50_us;
+        unsigned long long p90_us;
+        unsigned long long p99_us;
+    } rsid_latency_stats;
+
+    typedef struct
+    {
+        unsigned long long counters[RSID_Counter_Count];
+        rsid_latency_stats latencies[RSID_Latency_Count];
+    } rsid_metrics_snapshot;
+
+    /* subsystems of the SDK allocator's allocations (same order as RealSenseID::Metrics::Subsystem) */
+    typedef enum
+    {
+        RSID_Subsystem_Protocol,
+        RSID_Subsystem_Matcher,
+        RSID_Subsystem_Preview,
+        RSID_Subsystem_Wrappers,
+        RSID_Subsystem_Count
+    } rsid_metrics_subsystem;
+
+    /* allocations and frees of a subsystem since the last reset (see RealSenseID::Metrics::AllocationStats) */
+    typedef struct
+    {
+        unsigned long long allocations;
+        unsigned long long frees;
+        unsigned long long bytes_allocated;
+        unsigned long long bytes_freed;
+    } rsid_allocation_stats;
+
+    /* allocator of the SDK internal allocations (see RealSenseID::AllocatorHooks), called from the SDK threads */
+    typedef void* (*rsid_allocate_clbk)(size_t size, size_t alignment, rsid_metrics_subsystem subsystem, void* ctx);
+    typedef void (*rsid_deallocate_clbk)(void* ptr, size_t size, size_t alignment, rsid_metrics_subsystem subsystem,
+                                         void* ctx);
+
+#define RSID_MATCH_SCORE_BINS      64  /* best and runner-up score bins, RSID_MATCH_SCORE_BIN_WIDTH scores each */
+#define RSID_MATCH_SCORE_BIN_WIDTH 64
+#define RSID_MATCH_CONFIDENCE_BINS 101 /* one bin per confidence 0-100 */
+
+    /* match score histograms of the host matcher (see RealSenseID::Metrics::MatchScoreStats) */
+    typedef struct
+    {
+        unsigned long long matches;
+        unsigned long long accepted;
+        unsigned long long should_update;
+        unsigned long long best_scores[RSID_MATCH_SCORE_BINS];
+        unsigned long long runner_up_scores[RSID_MATCH_SCORE_BINS];
+        unsigned long long confidences[RSID_MATCH_CONFIDENCE_BINS];
+    } rsid_match_score_stats;
+
+    /* fill the snapshot with the current values of all metrics */
+    RSID_C_API void rsid_get_metrics(rsid_metrics_snapshot* snapshot);
+
+    /* fill stats with the process wide match score histograms */
+    RSID_C_API void rsid_get_match_score_stats(rsid_match_score_stats* stats);
+
+    /* fill stats (an array of RSID_Subsystem_Count) with the allocations of each subsystem */
+    RSID_C_API void rsid_get_allocation_stats(rsid_allocation_stats* stats);
+
+    /* route the SDK allocations through the callbacks (both NULL restores the default allocator). only possible while
+     * no SDK allocation is live, i.e. at startup. returns 1 on success, 0 otherwise */
+    RSID_C_API int rsid_set_allocator(rsid_allocate_clbk allocate, rsid_deallocate_clbk deallocate, void* ctx);
+
+    /* zero all metrics */
+    RSID_C_API void rsid_reset_metrics();
+
+    /* metric names for exporters (e.g. "packets_sent", "request_reply_us"), empty string if out of range */
+    RSID_C_API const char* rsid_metrics_counter_name(rsid_metrics_counter counter);
+    RSID_C_API const char* rsid_metrics_latency_name(rsid_metrics_latency latency);
+    RSID_C_API const char* rsid_metrics_subsystem_name(rsid_metrics_subsystem subsystem);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
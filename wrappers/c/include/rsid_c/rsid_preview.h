@@ -17,6 +17,16 @@ extern "C"
         RSID_Dump
     } rsid_preview_mode;
 
+    typedef enum
+    {
+        RSID_PREVIEW_DEFAULT,
+        RSID_PREVIEW_RGB,
+        RSID_PREVIEW_RGBA,
+        RSID_PREVIEW_BGRA,
+        RSID_PREVIEW_YUYV,
+        RSID_PREVIEW_NV12
+    } rsid_preview_format;
+
     typedef struct
     {
         void* _impl;
@@ -26,6 +36,7 @@ extern "C"
     {
         int camera_number;
         rsid_preview_mode preview_mode;
+        rsid_preview_format preview_format; /* VGA mode only */
     } rsid_preview_config;
 
     typedef struct
@@ -59,6 +70,12 @@ extern "C"
 
     typedef void (*rsid_preview_clbk)(rsid_image image, void* ctx);
 
+    /* lease on a frame of the preview's frame pool, image.buffer stays valid until the lease is released */
+    typedef struct rsid_preview_frame rsid_preview_frame;
+
+    /* the callee owns the frame lease and must release it (on any thread) with rsid_release_preview_frame */
+    typedef void (*rsid_preview_frame_clbk)(rsid_preview_frame* frame, rsid_image image, void* ctx);
+
     /* return new device handle (or null on failure) */
     RSID_C_API rsid_preview* rsid_create_preview(const rsid_preview_config* preview_config);
 
@@ -68,6 +85,14 @@ extern "C"
     /* start streaming of images. return 0 on error, 1 on sucess */
     RSID_C_API int rsid_start_preview(rsid_preview* preview_handle, rsid_preview_clbk clbk, void* ctx);
 
+    /* start streaming of images captured into a pool of pool_size frames, leased to the callback without copying.
+     * images are dropped while all the frames are leased. return 0 on error, 1 on sucess */
+    RSID_C_API int rsid_start_preview_frames(rsid_preview* preview_handle, rsid_preview_frame_clbk clbk,
+                                             unsigned int pool_size, void* ctx);
+
+    /* release a frame lease given to rsid_preview_frame_clbk. the frame goes back to the preview's pool */
+    RSID_C_API void rsid_release_preview_frame(rsid_preview_frame* frame);
+
     /* pause streaming of images. return 0 on error, 1 on sucess */
     RSID_C_API int rsid_pause_preview(rsid_preview* preview_handle);
 
@@ -0,0 +1,56 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "rsid_export.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif //__cplusplus
+
+    /* start recording a timeline of the library operations in a ring buffer of capacity events (0 for the default).
+     * previous events are cleared */
+    RSID_C_API void rsid_trace_start(size_t capacity);
+
+    /* stop recording, the events are kept until the next start */
+    RSID_C_API void rsid_trace_stop();
+
+    /* write the recorded events as Chrome Trace Event JSON (chrome://tracing, ui.perfetto.dev).
+     * return 1 on success, 0 on failure */
+    RSID_C_API int rsid_trace_write(const char* path);
+
+    /* w3c trace context of the calling thread, e.g. of the caller's OpenTelemetry span: the library operations called
+     * on this thread are exported as its child spans (see rsid_trace_set_span_exporter). traceparent is a version 00
+     * traceparent header ("00-<32 hex trace id>-<16 hex span id>-<2 hex flags>"), NULL clears the context.
+     * return 1 on success, 0 if traceparent is invalid (the context is left unchanged) */
+    RSID_C_API int rsid_trace_set_context(const char* traceparent);
+
+    /* a finished span of a library operation run under a trace context. ids are lower case hex, times are nanoseconds
+     * since the unix epoch (end equals start for point in time events). valid during the exporter call only */
+    typedef struct
+    {
+        const char* name;
+        const char* category;
+        char trace_id[33];
+        char span_id[17];
+        char parent_span_id[17];
+        unsigned long long start_unix_ns;
+        unsigned long long end_unix_ns;
+        long long value;
+        int has_value;
+    } rsid_span;
+
+    /* called from the library threads, concurrently, as each span ends */
+    typedef void (*rsid_span_exporter_clbk)(const rsid_span* span, void* ctx);
+
+    /* install the span exporter, or remove it with NULL. ctx must stay valid after the exporter is replaced, spans in
+     * flight are exported with the exporter they began with */
+    RSID_C_API void rsid_trace_set_span_exporter(rsid_span_exporter_clbk exporter, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
@@ -9,12 +9,17 @@
 #include "RealSenseID/Version.h"
 #include "RealSenseID/Logging.h"
 #include "RealSenseID/Faceprints.h"
+#include "RealSenseID/AsyncOperation.h"
 #include "RealSenseID/AuthFaceprintsExtractionCallback.h"
 #include "RealSenseID/EnrollFaceprintsExtractionCallback.h"
+#include "RealSenseID/Allocator.h"
 #include "rsid_c/rsid_client.h"
 #include <memory>
+#include <stdlib.h>
 #include <string.h>
 #include <stdexcept>
+#include <vector>
+#include <algorithm>
 
 #ifdef WIN32
 #pragma warning(push)
@@ -29,10 +34,10 @@ static const std::string LOG_TAG = "rsid_c_client";
 
 
 // copy FaceRects to give c array of rsid_face_rects and return number the faces copied
-size_t to_c_faces(const std::vector<RealSenseID::FaceRect>& faces, rsid_face_rect target[], size_t target_size)
+size_t to_c_faces(const RealSenseID::FaceRect* faces, size_t count, rsid_face_rect target[], size_t target_size)
 {
     size_t i;
-    for (i = 0; i < faces.size() && i < target_size; i++)
+    for (i = 0; i < count && i < target_size; i++)
     {
         auto& face = faces[i];
         target[i] = {face.x, face.y, face.w, face.h};
@@ -40,14 +45,14 @@ size_t to_c_faces(const std::vector<RealSenseID::FaceRect>& faces, rsid_face_rec
     return i;
 }
 
-// helper to convert the face vector to c array of rsid_face_rect structs and call the c callbeck
-static void handle_face_detected_clbk(rsid_face_detected_clbk user_clbk,
-                                      const std::vector<RealSenseID::FaceRect>& faces, void* ctx)
+// helper to convert the faces to c array of rsid_face_rect structs and call the c callbeck
+static void handle_face_detected_clbk(rsid_face_detected_clbk user_clbk, const RealSenseID::FaceRect* faces,
+                                      size_t count, void* ctx)
 {
-    if (user_clbk != nullptr && !faces.empty())
+    if (user_clbk != nullptr && count > 0)
     {
         rsid_face_rect c_faces[RSID_MAX_FACES];
-        auto n_faces = to_c_faces(faces, c_faces, RSID_MAX_FACES);
+        auto n_faces = to_c_faces(faces, count, c_faces, RSID_MAX_FACES);
         user_clbk(c_faces, n_faces, ctx);
     }
 }
@@ -79,9 +84,9 @@ public:
             _enroll_args.hint_clbk(static_cast<rsid_enroll_status>(hint), _enroll_args.ctx);
     }
 
-    void OnFaceDetected(const std::vector<RealSenseID::FaceRect>& faces) override
+    void OnFacesDetected(const RealSenseID::FaceRect* faces, size_t count) override
     {
-        handle_face_detected_clbk(_enroll_args.face_detected_clbk, faces, _enroll_args.ctx);
+        handle_face_detected_clbk(_enroll_args.face_detected_clbk, faces, count, _enroll_args.ctx);
     }
 };
 
@@ -106,9 +111,9 @@ public:
             _auth_args.hint_clbk(static_cast<rsid_auth_status>(hint), _auth_args.ctx);
     }
 
-    void OnFaceDetected(const std::vector<RealSenseID::FaceRect>& faces) override
+    void OnFacesDetected(const RealSenseID::FaceRect* faces, size_t count) override
     {
-        handle_face_detected_clbk(_auth_args.face_detected_clbk, faces, _auth_args.ctx);
+        handle_face_detected_clbk(_auth_args.face_detected_clbk, faces, count, _auth_args.ctx);
     }
 };
 
@@ -125,6 +130,17 @@ static void copy_to_c_faceprints(const RealSenseID::Faceprints& faceprints, rsid
     ::memcpy(c_faceprints->orig_descriptor, faceprints.origDescriptor, sizeof(faceprints.origDescriptor));
 }
 
+// auth queries have the avg descriptor only, orig_descriptor is left unset
+static void copy_query_to_c_faceprints(const RealSenseID::QueryFaceprints& query, rsid_faceprints* c_faceprints)
+{
+    c_faceprints->number_of_descriptors = query.numberOfDescriptors;
+    c_faceprints->version = query.version;
+    c_faceprints->featuresType = (FaceprintsTypeEnum)query.featuresType;
+
+    static_assert(sizeof(c_faceprints->avg_descriptor) == sizeof(query.descriptor), "faceprints avg sizes does not match");
+    ::memcpy(c_faceprints->avg_descriptor, query.descriptor, sizeof(query.descriptor));
+}
+
 static void copy_to_cpp_faceprints(const rsid_faceprints* c_faceprints, RealSenseID::Faceprints& faceprints)
 {
     faceprints.numberOfDescriptors = c_faceprints->number_of_descriptors;
@@ -145,14 +161,27 @@ public:
     }
 
     void OnResult(const RealSenseID::AuthenticateStatus status, const Faceprints* faceprints) override
+    {
+        if (faceprints == nullptr)
+        {
+            OnQueryResult(status, nullptr);
+            return;
+        }
+        RealSenseID::QueryFaceprints query;
+        RealSenseID::ToQueryFaceprints(*faceprints, query);
+        OnQueryResult(status, &query);
+    }
+
+    void OnQueryResult(const RealSenseID::AuthenticateStatus status,
+                       const RealSenseID::QueryFaceprints* query) override
     {
         if (_faceprints_ext_args.result_clbk)
         {
             rsid_faceprints c_faceprints;
 
-            if (status == RealSenseID::AuthenticateStatus::Success)
+            if (status == RealSenseID::AuthenticateStatus::Success && query != nullptr)
             {
-                copy_to_c_faceprints(*faceprints, &c_faceprints);
+                copy_query_to_c_faceprints(*query, &c_faceprints);
                 _faceprints_ext_args.result_clbk(static_cast<rsid_auth_status>(status), &c_faceprints,
                                                  _faceprints_ext_args.ctx);
             }
@@ -168,9 +197,9 @@ public:
             _faceprints_ext_args.hint_clbk(static_cast<rsid_auth_status>(hint), _faceprints_ext_args.ctx);
     }
 
-    void OnFaceDetected(const std::vector<RealSenseID::FaceRect>& faces) override
+    void OnFacesDetected(const RealSenseID::FaceRect* faces, size_t count) override
     {
-        handle_face_detected_clbk(_faceprints_ext_args.face_detected_clbk, faces, _faceprints_ext_args.ctx);
+        handle_face_detected_clbk(_faceprints_ext_args.face_detected_clbk, faces, count, _faceprints_ext_args.ctx);
     }
 };
 
@@ -185,14 +214,27 @@ public:
     }
 
     void OnResult(const RealSenseID::AuthenticateStatus status, const Faceprints* faceprints) override
+    {
+        if (faceprints == nullptr)
+        {
+            OnQueryResult(status, nullptr);
+            return;
+        }
+        RealSenseID::QueryFaceprints query;
+        RealSenseID::ToQueryFaceprints(*faceprints, query);
+        OnQueryResult(status, &query);
+    }
+
+    void OnQueryResult(const RealSenseID::AuthenticateStatus status,
+                       const RealSenseID::QueryFaceprints* query) override
     {
         if (_faceprints_ext_args.result_clbk)
         {
             rsid_faceprints c_faceprints;
 
-            if (status == RealSenseID::AuthenticateStatus::Success)
+            if (status == RealSenseID::AuthenticateStatus::Success && query != nullptr)
             {
-                copy_to_c_faceprints(*faceprints, &c_faceprints);
+                copy_query_to_c_faceprints(*query, &c_faceprints);
                 _faceprints_ext_args.result_clbk(static_cast<rsid_auth_status>(status), &c_faceprints,
                                                  _faceprints_ext_args.ctx);
             }
@@ -208,9 +250,9 @@ public:
             _faceprints_ext_args.hint_clbk(static_cast<rsid_auth_status>(hint), _faceprints_ext_args.ctx);
     }
 
-    void OnFaceDetected(const std::vector<RealSenseID::FaceRect>& faces) override
+    void OnFacesDetected(const RealSenseID::FaceRect* faces, size_t count) override
     {
-        handle_face_detected_clbk(_faceprints_ext_args.face_detected_clbk, faces, _faceprints_ext_args.ctx);
+        handle_face_detected_clbk(_faceprints_ext_args.face_detected_clbk, faces, count, _faceprints_ext_args.ctx);
     }
 };
 
@@ -252,9 +294,9 @@ public:
             _enroll_ext_args.hint_clbk(static_cast<rsid_enroll_status>(hint), _enroll_ext_args.ctx);
     }
 
-    void OnFaceDetected(const std::vector<RealSenseID::FaceRect>& faces) override
+    void OnFacesDetected(const RealSenseID::FaceRect* faces, size_t count) override
     {
-        handle_face_detected_clbk(_enroll_ext_args.face_detected_clbk, faces, _enroll_ext_args.ctx);
+        handle_face_detected_clbk(_enroll_ext_args.face_detected_clbk, faces, count, _enroll_ext_args.ctx);
     }
 };
 
@@ -595,6 +637,74 @@ rsid_match_result rsid_match_faceprints(rsid_authenticator* authenticator, rsid_
     return match_result;
 }
 
+static std::vector<Faceprints> to_cpp_faceprints_array(const rsid_faceprints* c_faceprints_array, size_t count)
+{
+    std::vector<Faceprints> faceprints_array(c_faceprints_array != nullptr ? count : 0);
+    for (size_t i = 0; i < faceprints_array.size(); i++)
+    {
+        copy_to_cpp_faceprints(&c_faceprints_array[i], faceprints_array[i]);
+    }
+    return faceprints_array;
+}
+
+rsid_match_array_result rsid_match_faceprints_to_array(rsid_authenticator* authenticator,
+                                                       const rsid_faceprints* new_faceprints,
+                                                       const rsid_faceprints* existing_faceprints_array, size_t count,
+                                                       rsid_faceprints* updated_faceprints)
+{
+    rsid_match_array_result match_result {0, 0, -1, 0, 0};
+    if (new_faceprints == nullptr || updated_faceprints == nullptr)
+    {
+        return match_result;
+    }
+
+    auto* auth_impl = get_auth_impl(authenticator);
+    Faceprints cpp_new_faceprints, cpp_updated_faceprints;
+    copy_to_cpp_faceprints(new_faceprints, cpp_new_faceprints);
+    auto faceprints_array = to_cpp_faceprints_array(existing_faceprints_array, count);
+
+    auto result = auth_impl->MatchFaceprintsToArray(cpp_new_faceprints, faceprints_array.data(),
+                                                    faceprints_array.size(), cpp_updated_faceprints);
+    match_result.success = result.success;
+    match_result.should_update = result.should_update;
+    match_result.index = result.index;
+    match_result.score = (int)result.score;
+    match_result.confidence = (int)result.confidence;
+
+    if (result.success && result.should_update)
+    {
+        copy_to_c_faceprints(cpp_updated_faceprints, updated_faceprints);
+    }
+    return match_result;
+}
+
+size_t rsid_match_faceprints_top_k(rsid_authenticator* authenticator, const rsid_faceprints* new_faceprints,
+                                   const rsid_faceprints* existing_faceprints_array, size_t count, size_t k,
+                                   rsid_match_candidate* candidates)
+{
+    if (new_faceprints == nullptr || candidates == nullptr)
+    {
+        return 0;
+    }
+
+    auto* auth_impl = get_auth_impl(authenticator);
+    Faceprints cpp_new_faceprints;
+    copy_to_cpp_faceprints(new_faceprints, cpp_new_faceprints);
+    auto faceprints_array = to_cpp_faceprints_array(existing_faceprints_array, count);
+
+    std::vector<RealSenseID::MatchCandidateHost> cpp_candidates(std::min(k, faceprints_array.size()));
+    auto n_candidates = auth_impl->MatchFaceprintsTopK(cpp_new_faceprints, faceprints_array.data(),
+                                                       faceprints_array.size(), cpp_candidates.size(),
+                                                       cpp_candidates.data());
+    for (size_t i = 0; i < n_candidates; i++)
+    {
+        candidates[i].index = cpp_candidates[i].index;
+        candidates[i].score = (int)cpp_candidates[i].score;
+        candidates[i].confidence = (int)cpp_candidates[i].confidence;
+    }
+    return n_candidates;
+}
+
 rsid_status rsid_authenticate_loop(rsid_authenticator* authenticator, const rsid_auth_args* args)
 {
     auto* auth_impl = get_auth_impl(authenticator);
@@ -616,6 +726,12 @@ rsid_status rsid_remove_user(rsid_authenticator* authenticator, const char* user
     return static_cast<rsid_status>(auth_impl->RemoveUser(user_id));
 }
 
+rsid_status rsid_remove_users(rsid_authenticator* authenticator, const char** user_ids, unsigned int number_of_users)
+{
+    auto* auth_impl = get_auth_impl(authenticator);
+    return static_cast<rsid_status>(auth_impl->RemoveUsers(user_ids, number_of_users));
+}
+
 rsid_status rsid_remove_all_users(rsid_authenticator* authenticator)
 {
     auto* auth_impl = get_auth_impl(authenticator);
@@ -685,47 +801,126 @@ rsid_status rsid_query_user_ids(rsid_authenticator* authenticator, char** user_i
     return static_cast<rsid_status>(auth_impl->QueryUserIds(user_ids, *number_of_users));
 }
 
-// concat user ids to single buffer for easier usage from managed languages
+class UserIdsClbk : public RealSenseID::UserIdsCallback
+{
+    rsid_user_id_clbk _clbk;
+    void* _ctx;
+
+public:
+    UserIdsClbk(rsid_user_id_clbk clbk, void* ctx) : _clbk {clbk}, _ctx {ctx}
+    {
+    }
+
+    void OnUserId(const char* user_id) override
+    {
+        if (_clbk)
+            _clbk(user_id, _ctx);
+    }
+};
+
+rsid_status rsid_query_user_ids_clbk(rsid_authenticator* authenticator, rsid_user_id_clbk clbk, void* ctx)
+{
+    auto* auth_impl = get_auth_impl(authenticator);
+    UserIdsClbk user_ids_clbk {clbk, ctx};
+    return static_cast<rsid_status>(auth_impl->QueryUserIds(user_ids_clbk));
+}
+
+static_assert(RSID_MAX_USERID_LENGTH == RealSenseID::FaceAuthenticator::MAX_USERID_LENGTH, "user id length mismatch");
+
+// copy a user id to its chunk of a user ids buffer
+static void copy_user_id(const char* user_id, char* chunk)
+{
+    ::strncpy(chunk, user_id, RSID_MAX_USERID_LENGTH - 1);
+    chunk[RSID_MAX_USERID_LENGTH - 1] = '\0';
+}
+
+// concat user ids to single buffer for easier usage from managed languages, as they arrive
 // result buf size must be number_of_users * 31
 rsid_status rsid_query_user_ids_to_buf(rsid_authenticator* authenticator, char* result_buf,
                                        unsigned int* number_of_users)
 {
     auto* auth_impl = get_auth_impl(authenticator);
-
-    // allocate needed array of user ids
-    char** user_ids = new char*[*number_of_users];
-    for (unsigned i = 0; i < *number_of_users; i++)
+    struct BufferCtx
     {
-        user_ids[i] = new char[RealSenseID::FaceAuthenticator::MAX_USERID_LENGTH];
-    }
-    unsigned int nusers_in_out = *number_of_users;
-    auto status = auth_impl->QueryUserIds(user_ids, nusers_in_out);
-    if (status != RealSenseID::Status::Ok)
+        char* buffer;
+        unsigned int capacity;
+        unsigned int count;
+    } buffer_ctx {result_buf, *number_of_users, 0};
+    auto copy_clbk = [](const char* user_id, void* ctx) {
+        auto* target = static_cast<BufferCtx*>(ctx);
+        if (target->count < target->capacity)
+        {
+            copy_user_id(user_id, &target->buffer[target->count++ * RSID_MAX_USERID_LENGTH]);
+        }
+    };
+    UserIdsClbk user_ids_clbk {copy_clbk, &buffer_ctx};
+    auto status = auth_impl->QueryUserIds(user_ids_clbk);
+    *number_of_users = status == RealSenseID::Status::Ok ? buffer_ctx.count : 0;
+    return static_cast<rsid_status>(status);
+}
+
+// the buffer grows by doubling as the ids arrive, then is shrunk to fit (one live allocation)
+rsid_status rsid_query_user_ids_arena(rsid_authenticator* authenticator, rsid_user_ids* user_ids)
+{
+    auto* auth_impl = get_auth_impl(authenticator);
+    struct ArenaCtx
     {
-        // free allocated memory and return on error
-        for (unsigned int i = 0; i < *number_of_users; i++)
+        rsid_user_ids* arena;
+        unsigned int capacity;
+        bool failed;
+    } arena_ctx {user_ids, 0, false};
+    user_ids->number_of_users = 0;
+    user_ids->user_ids = nullptr;
+    auto append_clbk = [](const char* user_id, void* ctx) {
+        auto* target = static_cast<ArenaCtx*>(ctx);
+        auto* arena = target->arena;
+        if (target->failed)
+        {
+            return;
+        }
+        if (arena->number_of_users == target->capacity)
         {
-            delete user_ids[i];
+            unsigned int capacity = target->capacity == 0 ? 64 : target->capacity * 2;
+            auto* grown = static_cast<char*>(::realloc(arena->user_ids, size_t {capacity} * RSID_MAX_USERID_LENGTH));
+            if (grown == nullptr)
+            {
+                target->failed = true;
+                return;
+            }
+            arena->user_ids = grown;
+            target->capacity = capacity;
         }
-        delete[] user_ids;
-        *number_of_users = 0;
-        return static_cast<rsid_status>(status);
+        copy_user_id(user_id, &arena->user_ids[arena->number_of_users++ * RSID_MAX_USERID_LENGTH]);
+    };
+    UserIdsClbk user_ids_clbk {append_clbk, &arena_ctx};
+    auto status = static_cast<rsid_status>(auth_impl->QueryUserIds(user_ids_clbk));
+    if (status == RSID_Ok && arena_ctx.failed)
+    {
+        status = RSID_Error;
+    }
+    if (status != RSID_Ok || user_ids->number_of_users == 0)
+    {
+        rsid_free_user_ids(user_ids);
+        return status;
     }
-    // concat to the output buffer
-    for (unsigned int i = 0; i < nusers_in_out; i++)
+    auto* fitted = static_cast<char*>(
+        ::realloc(user_ids->user_ids, size_t {user_ids->number_of_users} * RSID_MAX_USERID_LENGTH));
+    if (fitted != nullptr)
     {
-        ::memcpy((char*)&result_buf[i * RealSenseID::FaceAuthenticator::MAX_USERID_LENGTH], user_ids[i],
-                 RealSenseID::FaceAuthenticator::MAX_USERID_LENGTH);
+        user_ids->user_ids = fitted;
     }
+    return status;
+}
 
-    // free allocated memory
-    for (unsigned int i = 0; i < *number_of_users; i++)
+void rsid_free_user_ids(rsid_user_ids* user_ids)
+{
+    if (user_ids == nullptr)
     {
-        delete user_ids[i];
+        return;
     }
-    delete[] user_ids;
-    *number_of_users = nusers_in_out;
-    return rsid_status::RSID_Ok;
+    ::free(user_ids->user_ids);
+    user_ids->user_ids = nullptr;
+    user_ids->number_of_users = 0;
 }
 
 
@@ -760,6 +955,105 @@ rsid_status rsid_standby(rsid_authenticator* authenticator)
     return static_cast<rsid_status>(auth_impl->Standby());
 }
 
+rsid_status rsid_prewarm(rsid_authenticator* authenticator, unsigned int hold_ms)
+{
+    auto* auth_impl = get_auth_impl(authenticator);
+    return static_cast<rsid_status>(auth_impl->Prewarm(hold_ms));
+}
+
+struct rsid_async_operation
+{
+    RealSenseID::AsyncOperation operation;
+};
+
+static constexpr auto WrappersSubsystem = RealSenseID::Metrics::Subsystem::Wrappers;
+
+// start an async flow with a heap copy of the c callbacks, freed once the operation is done
+template <typename Clbk, typename Args, typename Start>
+static rsid_async_operation* start_async(const Args* args, Start start, rsid_async_done_clbk done_clbk, void* done_ctx)
+{
+    auto* callback = RealSenseID::SdkNew<Clbk, WrappersSubsystem>(*args);
+    auto operation = start(*callback, [callback, done_clbk, done_ctx](RealSenseID::Status status) {
+        RealSenseID::SdkDelete<Clbk, WrappersSubsystem>()(callback);
+        if (done_clbk)
+            done_clbk(static_cast<rsid_status>(status), done_ctx);
+    });
+    return RealSenseID::SdkNew<rsid_async_operation, WrappersSubsystem>(std::move(operation));
+}
+
+rsid_async_operation* rsid_enroll_async(rsid_authenticator* authenticator, const rsid_enroll_args* args,
+                                        rsid_async_done_clbk done_clbk, void* done_ctx)
+{
+    auto* auth_impl = get_auth_impl(authenticator);
+    return start_async<EnrollClbk>(
+        args,
+        [auth_impl, args](EnrollClbk& callback, RealSenseID::AsyncOperation::Completion completion) {
+            return auth_impl->EnrollAsync(callback, args->user_id, std::move(completion));
+        },
+        done_clbk, done_ctx);
+}
+
+rsid_async_operation* rsid_authenticate_async(rsid_authenticator* authenticator, const rsid_auth_args* args,
+                                              rsid_async_done_clbk done_clbk, void* done_ctx)
+{
+    auto* auth_impl = get_auth_impl(authenticator);
+    return start_async<AuthClbk>(
+        args,
+        [auth_impl](AuthClbk& callback, RealSenseID::AsyncOperation::Completion completion) {
+            return auth_impl->AuthenticateAsync(callback, std::move(completion));
+        },
+        done_clbk, done_ctx);
+}
+
+rsid_async_operation* rsid_authenticate_loop_async(rsid_authenticator* authenticator, const rsid_auth_args* args,
+                                                   rsid_async_done_clbk done_clbk, void* done_ctx)
+{
+    auto* auth_impl = get_auth_impl(authenticator);
+    return start_async<AuthClbk>(
+        args,
+        [auth_impl](AuthClbk& callback, RealSenseID::AsyncOperation::Completion completion) {
+            return auth_impl->AuthenticateLoopAsync(callback, std::move(completion));
+        },
+        done_clbk, done_ctx);
+}
+
+rsid_async_operation* rsid_extract_faceprints_for_enroll_async(rsid_authenticator* authenticator,
+                                                               const rsid_enroll_ext_args* args,
+                                                               rsid_async_done_clbk done_clbk, void* done_ctx)
+{
+    auto* auth_impl = get_auth_impl(authenticator);
+    return start_async<EnrollFaceprintsExtClbk>(
+        args,
+        [auth_impl](EnrollFaceprintsExtClbk& callback, RealSenseID::AsyncOperation::Completion completion) {
+            return auth_impl->ExtractFaceprintsForEnrollAsync(callback, std::move(completion));
+        },
+        done_clbk, done_ctx);
+}
+
+rsid_async_operation* rsid_extract_faceprints_for_auth_async(rsid_authenticator* authenticator,
+                                                             const rsid_faceprints_ext_args* args,
+                                                             rsid_async_done_clbk done_clbk, void* done_ctx)
+{
+    auto* auth_impl = get_auth_impl(authenticator);
+    return start_async<AuthFaceprintsExtClbk>(
+        args,
+        [auth_impl](AuthFaceprintsExtClbk& callback, RealSenseID::AsyncOperation::Completion completion) {
+            return auth_impl->ExtractFaceprintsForAuthAsync(callback, std::move(completion));
+        },
+        done_clbk, done_ctx);
+}
+
+void rsid_async_cancel(rsid_async_operation* operation)
+{
+    if (operation)
+        operation->operation.Cancel();
+}
+
+void rsid_async_destroy(rsid_async_operation* operation)
+{
+    RealSenseID::SdkDelete<rsid_async_operation, WrappersSubsystem>()(operation);
+}
+
 #ifdef _WIN32
 #pragma warning(pop)
 #endif
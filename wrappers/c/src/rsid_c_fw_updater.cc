@@ -87,3 +87,18 @@ rsid_status rsid_update_firmware(rsid_fw_updater* handle, const rsid_fw_update_e
 
     return static_cast<rsid_status>(fw_updater_impl->Update(&eh, fw_updater_settings, bin_path, exclude_recognition));
 }
+
+rsid_status rsid_update_firmware_from_buffer(rsid_fw_updater* handle, const rsid_fw_update_event_handler* event_handler,
+                                             rsid_fw_update_settings settings, const void* image, size_t image_size,
+                                             int exclude_recognition)
+{
+    auto* fw_updater_impl = static_cast<RealSenseID::FwUpdater*>(handle->_impl);
+
+    RealSenseID::FwUpdater::Settings fw_updater_settings;
+    fw_updater_settings.port = settings.port;
+    fw_updater_settings.force_full = settings.force_full;
+    FwUpdaterEventHandler eh(event_handler);
+
+    auto fw_image = RealSenseID::FwImage::FromBuffer(image, image_size);
+    return static_cast<rsid_status>(fw_updater_impl->Update(&eh, fw_updater_settings, fw_image, exclude_recognition));
+}
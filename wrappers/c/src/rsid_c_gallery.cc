@@ -0,0 +1,377 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/HostFaceprintsGallery.h"
+#include "rsid_c/rsid_gallery.h"
+#include <string.h>
+#include <vector>
+
+namespace
+{
+using RealSenseID::Faceprints;
+using RealSenseID::HostFaceprintsGallery;
+using RealSenseID::ImportErrorHost;
+
+HostFaceprintsGallery* get_gallery_impl(rsid_faceprints_gallery* gallery)
+{
+    return static_cast<HostFaceprintsGallery*>(gallery->_impl);
+}
+
+void copy_to_c_faceprints(const Faceprints& faceprints, rsid_faceprints* c_faceprints)
+{
+    c_faceprints->number_of_descriptors = faceprints.numberOfDescriptors;
+    c_faceprints->version = faceprints.version;
+    c_faceprints->featuresType = (unsigned short)faceprints.featuresType;
+    static_assert(sizeof(c_faceprints->avg_descriptor) == sizeof(faceprints.avgDescriptor),
+                  "faceprints sizes does not match");
+    ::memcpy(c_faceprints->avg_descriptor, faceprints.avgDescriptor, sizeof(faceprints.avgDescriptor));
+    ::memcpy(c_faceprints->orig_descriptor, faceprints.origDescriptor, sizeof(faceprints.origDescriptor));
+}
+
+void copy_to_cpp_faceprints(const rsid_faceprints* c_faceprints, Faceprints& faceprints)
+{
+    faceprints.numberOfDescriptors = c_faceprints->number_of_descriptors;
+    faceprints.version = c_faceprints->version;
+    faceprints.featuresType = (RealSenseID::FaceprintsTypeEnum)c_faceprints->featuresType;
+    static_assert(sizeof(c_faceprints->avg_descriptor) == sizeof(faceprints.avgDescriptor),
+                  "faceprints sizes does not match");
+    ::memcpy(faceprints.avgDescriptor, c_faceprints->avg_descriptor, sizeof(c_faceprints->avg_descriptor));
+    ::memcpy(faceprints.origDescriptor, c_faceprints->orig_descriptor, sizeof(c_faceprints->orig_descriptor));
+}
+
+// import with a HostFaceprintsGallery file import method, converting the errors
+size_t import_file(rsid_faceprints_gallery* gallery,
+                   size_t (HostFaceprintsGallery::*import)(const char*, ImportErrorHost*, size_t, size_t*),
+                   const char* path, rsid_import_error* errors, size_t max_errors, size_t* num_errors)
+{
+    if (num_errors != nullptr)
+    {
+        *num_errors = 0;
+    }
+    std::vector<ImportErrorHost> cpp_errors(errors != nullptr ? max_errors : 0);
+    size_t cpp_num_errors = 0;
+    size_t imported = (get_gallery_impl(gallery)->*import)(path, cpp_errors.data(), cpp_errors.size(), &cpp_num_errors);
+    for (size_t i = 0; i < cpp_errors.size() && i < cpp_num_errors; i++)
+    {
+        errors[i].record = cpp_errors[i].record;
+        errors[i].error = static_cast<rsid_import_record_error>(cpp_errors[i].error);
+    }
+    if (num_errors != nullptr)
+    {
+        *num_errors = cpp_num_errors;
+    }
+    return imported;
+}
+} // namespace
+
+rsid_faceprints_gallery* rsid_create_faceprints_gallery()
+{
+    HostFaceprintsGallery* gallery_impl = nullptr;
+    try
+    {
+        gallery_impl = new HostFaceprintsGallery();
+        auto* gallery = new rsid_faceprints_gallery();
+        gallery->_impl = gallery_impl;
+        return gallery;
+    }
+    catch (...)
+    {
+        try
+        {
+            delete gallery_impl;
+        }
+        catch (...)
+        {
+        }
+        return nullptr;
+    }
+}
+
+void rsid_destroy_faceprints_gallery(rsid_faceprints_gallery* gallery)
+{
+    if (gallery == nullptr)
+    {
+        return;
+    }
+
+    try
+    {
+        delete get_gallery_impl(gallery);
+    }
+    catch (...)
+    {
+    }
+    delete gallery;
+}
+
+size_t rsid_gallery_add(rsid_faceprints_gallery* gallery, const char* user_id, const rsid_faceprints* faceprints)
+{
+    try
+    {
+        Faceprints cpp_faceprints;
+        copy_to_cpp_faceprints(faceprints, cpp_faceprints);
+        return get_gallery_impl(gallery)->Add(user_id, cpp_faceprints);
+    }
+    catch (...)
+    {
+        return RSID_GALLERY_ERROR;
+    }
+}
+
+size_t rsid_gallery_add_bulk(rsid_faceprints_gallery* gallery, const char* const* user_ids,
+                             const short* avg_descriptors, const short* orig_descriptors, size_t count, int version,
+                             int number_of_descriptors)
+{
+    try
+    {
+        return get_gallery_impl(gallery)->AddBulk(user_ids, avg_descriptors, orig_descriptors, count, version,
+                                                  number_of_descriptors);
+    }
+    catch (...)
+    {
+        return RSID_GALLERY_ERROR;
+    }
+}
+
+size_t rsid_gallery_import_file(rsid_faceprints_gallery* gallery, const char* path, rsid_import_error* errors,
+                                size_t max_errors, size_t* num_errors)
+{
+    try
+    {
+        return import_file(gallery, &HostFaceprintsGallery::ImportFile, path, errors, max_errors, num_errors);
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+int rsid_gallery_export_file(rsid_faceprints_gallery* gallery, const char* path)
+{
+    try
+    {
+        return get_gallery_impl(gallery)->ExportFile(path) ? 1 : 0;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+size_t rsid_gallery_import_arrow_file(rsid_faceprints_gallery* gallery, const char* path, rsid_import_error* errors,
+                                      size_t max_errors, size_t* num_errors)
+{
+    try
+    {
+        return import_file(gallery, &HostFaceprintsGallery::ImportArrowFile, path, errors, max_errors, num_errors);
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+int rsid_gallery_export_arrow_file(rsid_faceprints_gallery* gallery, const char* path)
+{
+    try
+    {
+        return get_gallery_impl(gallery)->ExportArrowFile(path) ? 1 : 0;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+int rsid_gallery_update(rsid_faceprints_gallery* gallery, size_t index, const rsid_faceprints* faceprints)
+{
+    Faceprints cpp_faceprints;
+    copy_to_cpp_faceprints(faceprints, cpp_faceprints);
+    return get_gallery_impl(gallery)->Update(index, cpp_faceprints) ? 1 : 0;
+}
+
+int rsid_gallery_remove(rsid_faceprints_gallery* gallery, size_t index)
+{
+    return get_gallery_impl(gallery)->Remove(index) ? 1 : 0;
+}
+
+int rsid_gallery_find(rsid_faceprints_gallery* gallery, const char* user_id)
+{
+    return get_gallery_impl(gallery)->Find(user_id);
+}
+
+const char* rsid_gallery_user_id(rsid_faceprints_gallery* gallery, size_t index)
+{
+    return get_gallery_impl(gallery)->UserId(index);
+}
+
+int rsid_gallery_get_faceprints(rsid_faceprints_gallery* gallery, size_t index, rsid_faceprints* faceprints)
+{
+    Faceprints cpp_faceprints;
+    if (!get_gallery_impl(gallery)->GetFaceprints(index, cpp_faceprints))
+    {
+        return 0;
+    }
+    copy_to_c_faceprints(cpp_faceprints, faceprints);
+    return 1;
+}
+
+void rsid_gallery_clear(rsid_faceprints_gallery* gallery)
+{
+    get_gallery_impl(gallery)->Clear();
+}
+
+void rsid_gallery_reserve(rsid_faceprints_gallery* gallery, size_t capacity)
+{
+    try
+    {
+        get_gallery_impl(gallery)->Reserve(capacity);
+    }
+    catch (...)
+    {
+    }
+}
+
+size_t rsid_gallery_size(rsid_faceprints_gallery* gallery)
+{
+    return get_gallery_impl(gallery)->Size();
+}
+
+rsid_match_array_result rsid_gallery_match(rsid_faceprints_gallery* gallery, const rsid_faceprints* new_faceprints,
+                                           rsid_faceprints* updated_faceprints)
+{
+    rsid_match_array_result match_result {0, 0, -1, 0, 0};
+    if (new_faceprints == nullptr || updated_faceprints == nullptr)
+    {
+        return match_result;
+    }
+
+    try
+    {
+        Faceprints cpp_new_faceprints, cpp_updated_faceprints;
+        copy_to_cpp_faceprints(new_faceprints, cpp_new_faceprints);
+        auto result = get_gallery_impl(gallery)->Match(cpp_new_faceprints, cpp_updated_faceprints);
+        match_result.success = result.success;
+        match_result.should_update = result.should_update;
+        match_result.index = result.index;
+        match_result.score = (int)result.score;
+        match_result.confidence = (int)result.confidence;
+
+        if (result.should_update)
+        {
+            copy_to_c_faceprints(cpp_updated_faceprints, updated_faceprints);
+        }
+    }
+    catch (...)
+    {
+        match_result = {0, 0, -1, 0, 0};
+    }
+    return match_result;
+}
+
+rsid_match_array_result rsid_gallery_verify(rsid_faceprints_gallery* gallery, const rsid_faceprints* new_faceprints,
+                                            const char* user_id, rsid_faceprints* updated_faceprints)
+{
+    rsid_match_array_result match_result {0, 0, -1, 0, 0};
+    if (new_faceprints == nullptr || user_id == nullptr || updated_faceprints == nullptr)
+    {
+        return match_result;
+    }
+
+    try
+    {
+        Faceprints cpp_new_faceprints, cpp_updated_faceprints;
+        copy_to_cpp_faceprints(new_faceprints, cpp_new_faceprints);
+        auto result = get_gallery_impl(gallery)->Verify(cpp_new_faceprints, user_id, cpp_updated_faceprints);
+        match_result.success = result.success;
+        match_result.should_update = result.should_update;
+        match_result.index = result.index;
+        match_result.score = (int)result.score;
+        match_result.confidence = (int)result.confidence;
+
+        if (result.should_update)
+        {
+            copy_to_c_faceprints(cpp_updated_faceprints, updated_faceprints);
+        }
+    }
+    catch (...)
+    {
+        match_result = {0, 0, -1, 0, 0};
+    }
+    return match_result;
+}
+
+size_t rsid_gallery_match_top_k(rsid_faceprints_gallery* gallery, const rsid_faceprints* new_faceprints, size_t k,
+                                rsid_match_candidate* candidates)
+{
+    if (new_faceprints == nullptr || candidates == nullptr)
+    {
+        return 0;
+    }
+
+    try
+    {
+        Faceprints cpp_new_faceprints;
+        copy_to_cpp_faceprints(new_faceprints, cpp_new_faceprints);
+        auto* gallery_impl = get_gallery_impl(gallery);
+        std::vector<RealSenseID::MatchCandidateHost> cpp_candidates(k < gallery_impl->Size() ? k
+                                                                                             : gallery_impl->Size());
+        auto n_candidates = gallery_impl->MatchTopK(cpp_new_faceprints, cpp_candidates.size(), cpp_candidates.data());
+        for (size_t i = 0; i < n_candidates; i++)
+        {
+            candidates[i].index = cpp_candidates[i].index;
+            candidates[i].score = (int)cpp_candidates[i].score;
+            candidates[i].confidence = (int)cpp_candidates[i].confidence;
+        }
+        return n_candidates;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+int rsid_gallery_find_similar_pairs(rsid_faceprints_gallery* gallery, int threshold, unsigned int num_threads,
+                                    rsid_similar_pairs_clbk callback, void* ctx)
+{
+    if (callback == nullptr)
+    {
+        return 0;
+    }
+
+    class PairsCallback : public RealSenseID::SimilarPairsCallback
+    {
+    public:
+        PairsCallback(rsid_similar_pairs_clbk callback, void* ctx) : _callback {callback}, _ctx {ctx}
+        {
+        }
+
+        bool OnPairs(const RealSenseID::SimilarPairHost* pairs, size_t count) override
+        {
+            _c_pairs.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                _c_pairs[i].first = pairs[i].first;
+                _c_pairs[i].second = pairs[i].second;
+                _c_pairs[i].score = (int)pairs[i].score;
+            }
+            return _callback(_c_pairs.data(), count, _ctx) != 0;
+        }
+
+    private:
+        rsid_similar_pairs_clbk _callback;
+        void* _ctx;
+        std::vector<rsid_similar_pair> _c_pairs;
+    };
+
+    try
+    {
+        PairsCallback pairs_callback {callback, ctx};
+        auto cpp_threshold = static_cast<RealSenseID::match_calc_t>(threshold < 0 ? -1 : threshold);
+        return get_gallery_impl(gallery)->FindSimilarPairs(pairs_callback, cpp_threshold, num_threads) ? 1 : 0;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
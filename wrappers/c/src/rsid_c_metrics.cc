@@ -0,0 +1,143 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/Metrics.h"
+#include "RealSenseID/Allocator.h"
+#include "rsid_c/rsid_metrics.h"
+
+static_assert(RSID_Counter_Count == RealSenseID::Metrics::CounterCount, "rsid_metrics_counter mismatch");
+static_assert(RSID_Latency_Count == RealSenseID::Metrics::LatencyCount, "rsid_metrics_latency mismatch");
+static_assert(RSID_Subsystem_Count == RealSenseID::Metrics::SubsystemCount, "rsid_metrics_subsystem mismatch");
+static_assert(RSID_MATCH_SCORE_BINS == RealSenseID::Metrics::MatchScoreStats::ScoreBins, "score bins mismatch");
+static_assert(RSID_MATCH_SCORE_BIN_WIDTH == RealSenseID::Metrics::MatchScoreStats::ScoreBinWidth,
+              "score bin width mismatch");
+static_assert(RSID_MATCH_CONFIDENCE_BINS == RealSenseID::Metrics::MatchScoreStats::ConfidenceBins,
+              "confidence bins mismatch");
+
+void rsid_get_metrics(rsid_metrics_snapshot* snapshot)
+{
+    if (snapshot == nullptr)
+    {
+        return;
+    }
+    auto metrics = RealSenseID::Metrics::GetSnapshot();
+    for (size_t i = 0; i < RSID_Counter_Count; i++)
+    {
+        snapshot->counters[i] = metrics.counters[i];
+    }
+    for (size_t i = 0; i < RSID_Latency_Count; i++)
+    {
+        const auto& stats = metrics.latencies[i];
+        auto& c_stats = snapshot->latencies[i];
+        c_stats.count = stats.count;
+        c_stats.sum_us = stats.sumUs;
+        c_stats.min_us = stats.minUs;
+        c_stats.max_us = stats.maxUs;
+        c_stats.p50_us = stats.p50Us;
+        c_stats.p90_us = stats.p90Us;
+        c_stats.p99_us = stats.p99Us;
+    }
+}
+
+void rsid_get_match_score_stats(rsid_match_score_stats* stats)
+{
+    if (stats == nullptr)
+    {
+        return;
+    }
+    const auto& scores = RealSenseID::Metrics::GetSnapshot().matchScores;
+    stats->matches = scores.matches;
+    stats->accepted = scores.accepted;
+    stats->should_update = scores.shouldUpdate;
+    for (size_t i = 0; i < RSID_MATCH_SCORE_BINS; i++)
+    {
+        stats->best_scores[i] = scores.bestScores[i];
+        stats->runner_up_scores[i] = scores.runnerUpScores[i];
+    }
+    for (size_t i = 0; i < RSID_MATCH_CONFIDENCE_BINS; i++)
+    {
+        stats->confidences[i] = scores.confidences[i];
+    }
+}
+
+void rsid_get_allocation_stats(rsid_allocation_stats* stats)
+{
+    if (stats == nullptr)
+    {
+        return;
+    }
+    auto metrics = RealSenseID::Metrics::GetSnapshot();
+    for (size_t i = 0; i < RSID_Subsystem_Count; i++)
+    {
+        const auto& allocations = metrics.allocations[i];
+        stats[i].allocations = allocations.allocations;
+        stats[i].frees = allocations.frees;
+        stats[i].bytes_allocated = allocations.bytesAllocated;
+        stats[i].bytes_freed = allocations.bytesFreed;
+    }
+}
+
+namespace
+{
+struct c_allocator
+{
+    rsid_allocate_clbk allocate;
+    rsid_deallocate_clbk deallocate;
+    void* ctx;
+};
+
+// set while no allocation is live, read by the hooks below
+c_allocator s_c_allocator;
+
+void* allocate_hook(size_t size, size_t alignment, RealSenseID::Metrics::Subsystem subsystem, void*)
+{
+    return s_c_allocator.allocate(size, alignment, static_cast<rsid_metrics_subsystem>(subsystem), s_c_allocator.ctx);
+}
+
+void deallocate_hook(void* ptr, size_t size, size_t alignment, RealSenseID::Metrics::Subsystem subsystem, void*)
+{
+    s_c_allocator.deallocate(ptr, size, alignment, static_cast<rsid_metrics_subsystem>(subsystem), s_c_allocator.ctx);
+}
+} // namespace
+
+int rsid_set_allocator(rsid_allocate_clbk allocate, rsid_deallocate_clbk deallocate, void* ctx)
+{
+    if (allocate == nullptr && deallocate == nullptr)
+    {
+        return RealSenseID::SetAllocator(nullptr) ? 1 : 0;
+    }
+    if (allocate == nullptr || deallocate == nullptr)
+    {
+        return 0;
+    }
+    // route through the default allocator first, which fails (and keeps the current callbacks) if allocations are live
+    if (!RealSenseID::SetAllocator(nullptr))
+    {
+        return 0;
+    }
+    s_c_allocator = c_allocator {allocate, deallocate, ctx};
+    RealSenseID::AllocatorHooks hooks;
+    hooks.allocate = allocate_hook;
+    hooks.deallocate = deallocate_hook;
+    return RealSenseID::SetAllocator(&hooks) ? 1 : 0;
+}
+
+void rsid_reset_metrics()
+{
+    RealSenseID::Metrics::Reset();
+}
+
+const char* rsid_metrics_counter_name(rsid_metrics_counter counter)
+{
+    return RealSenseID::Metrics::Name(static_cast<RealSenseID::Metrics::Counter>(counter));
+}
+
+const char* rsid_metrics_latency_name(rsid_metrics_latency latency)
+{
+    return RealSenseID::Metrics::Name(static_cast<RealSenseID::Metrics::Latency>(latency));
+}
+
+const char* rsid_metrics_subsystem_name(rsid_metrics_subsystem subsystem)
+{
+    return RealSenseID::Metrics::Name(static_cast<RealSenseID::Metrics::Subsystem>(subsystem));
+}
@@ -2,11 +2,40 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 
 #include "RealSenseID/Preview.h"
+#include "RealSenseID/Allocator.h"
 #include "rsid_c/rsid_preview.h"
 #include <memory>
 
+struct rsid_preview_frame
+{
+    RealSenseID::PreviewFrame frame;
+};
+
+using FrameDelete = RealSenseID::SdkDelete<rsid_preview_frame, RealSenseID::Metrics::Subsystem::Wrappers>;
+
 namespace
 {
+rsid_image ToCImage(const RealSenseID::Image& image)
+{
+    rsid_image c_img;
+    c_img.buffer = image.buffer;
+    c_img.size = image.size;
+    c_img.width = image.width;
+    c_img.height = image.height;
+    c_img.stride = image.stride;
+    c_img.number = image.number;
+    c_img.metadata.led = image.metadata.led;
+    c_img.metadata.projector = image.metadata.projector;
+    c_img.metadata.sensor_id = image.metadata.sensor_id;
+    c_img.metadata.status = image.metadata.status;
+    c_img.metadata.timestamp = image.metadata.timestamp;
+    c_img.metadata.face_rect.x = image.metadata.face_rect.x;
+    c_img.metadata.face_rect.y = image.metadata.face_rect.y;
+    c_img.metadata.face_rect.width = image.metadata.face_rect.width;
+    c_img.metadata.face_rect.height = image.metadata.face_rect.height;
+    return c_img;
+}
+
 class PreviewClbk : public RealSenseID::PreviewImageReadyCallback
 {
 public:
@@ -18,23 +47,7 @@ public:
     {
         if (m_callback)
         {
-            rsid_image c_img;
-            c_img.buffer = image.buffer;
-            c_img.size = image.size;
-            c_img.width = image.width;
-            c_img.height = image.height;
-            c_img.stride = image.stride;
-            c_img.number = image.number;
-            c_img.metadata.led = image.metadata.led;
-            c_img.metadata.projector = image.metadata.projector;
-            c_img.metadata.sensor_id = image.metadata.sensor_id;
-            c_img.metadata.status = image.metadata.status;
-            c_img.metadata.timestamp = image.metadata.timestamp;
-            c_img.metadata.face_rect.x = image.metadata.face_rect.x;
-            c_img.metadata.face_rect.y = image.metadata.face_rect.y;
-            c_img.metadata.face_rect.width = image.metadata.face_rect.width;
-            c_img.metadata.face_rect.height = image.metadata.face_rect.height;
-            m_callback(c_img, m_ctx);
+            m_callback(ToCImage(image), m_ctx);
         }
     }
 
@@ -42,15 +55,39 @@ private:
     rsid_preview_clbk m_callback;
     void* m_ctx;
 };
+
+class PreviewFrameClbk : public RealSenseID::PreviewFrameReadyCallback
+{
+public:
+    explicit PreviewFrameClbk(rsid_preview_frame_clbk c_clbk, void* ctx) : m_callback {c_clbk}, m_ctx {ctx}
+    {
+    }
+
+    void OnPreviewFrameReady(const RealSenseID::PreviewFrame& frame) override
+    {
+        if (m_callback)
+        {
+            // the lease is handed over to the callee, released by rsid_release_preview_frame()
+            auto* c_frame = RealSenseID::SdkNew<rsid_preview_frame, RealSenseID::Metrics::Subsystem::Wrappers>(frame);
+            m_callback(c_frame, ToCImage(frame.GetImage()), m_ctx);
+        }
+    }
+
+private:
+    rsid_preview_frame_clbk m_callback;
+    void* m_ctx;
+};
 } // namespace
 
 static std::unique_ptr<PreviewClbk> s_preview_clbk;
+static std::unique_ptr<PreviewFrameClbk> s_preview_frame_clbk;
 
 rsid_preview* rsid_create_preview(const rsid_preview_config* preview_config)
 {
     RealSenseID::PreviewConfig config;
     config.cameraNumber = preview_config->camera_number;
     config.previewMode = static_cast<RealSenseID::PreviewMode>(preview_config->preview_mode);
+    config.previewFormat = static_cast<RealSenseID::PreviewFormat>(preview_config->preview_format);
     auto* preview_impl = new RealSenseID::Preview(config);
 
     if (preview_impl == nullptr)
@@ -73,6 +110,7 @@ void rsid_destroy_preview(rsid_preview* preview_handle)
         auto* preview_impl = static_cast<RealSenseID::Preview*>(preview_handle->_impl);
         delete preview_impl;
         s_preview_clbk.reset();
+        s_preview_frame_clbk.reset();
     }
     catch (...)
     {
@@ -101,6 +139,38 @@ int rsid_start_preview(rsid_preview* preview_handle, rsid_preview_clbk clbk, voi
     }
 }
 
+int rsid_start_preview_frames(rsid_preview* preview_handle, rsid_preview_frame_clbk clbk, unsigned int pool_size,
+                              void* ctx)
+{
+    if (!preview_handle)
+        return 0;
+
+    if (!preview_handle->_impl)
+        return 0;
+
+    try
+    {
+        auto* preview_impl = static_cast<RealSenseID::Preview*>(preview_handle->_impl);
+        s_preview_frame_clbk = std::make_unique<PreviewFrameClbk>(clbk, ctx);
+        bool ok = preview_impl->StartPreview(*s_preview_frame_clbk, pool_size);
+        return static_cast<int>(ok);
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+void rsid_release_preview_frame(rsid_preview_frame* frame)
+{
+    try
+    {
+        FrameDelete()(frame);
+    }
+    catch (...)
+    {
+    }
+}
 
 int rsid_pause_preview(rsid_preview* preview_handle)
 {
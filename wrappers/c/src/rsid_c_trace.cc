@@ -0,0 +1,86 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/Trace.h"
+#include "rsid_c/rsid_trace.h"
+#include <cstdio>
+
+void rsid_trace_start(size_t capacity)
+{
+    RealSenseID::Trace::Start(capacity > 0 ? capacity : RealSenseID::Trace::DefaultCapacity);
+}
+
+void rsid_trace_stop()
+{
+    RealSenseID::Trace::Stop();
+}
+
+int rsid_trace_write(const char* path)
+{
+    return RealSenseID::Trace::WriteChromeJson(path) ? 1 : 0;
+}
+
+int rsid_trace_set_context(const char* traceparent)
+{
+    if (traceparent == nullptr)
+    {
+        RealSenseID::Trace::SetContext(nullptr);
+        return 1;
+    }
+    RealSenseID::Trace::Context context;
+    if (!RealSenseID::Trace::ParseTraceparent(traceparent, context))
+    {
+        return 0;
+    }
+    RealSenseID::Trace::SetContext(&context);
+    return 1;
+}
+
+namespace
+{
+struct CExporter
+{
+    rsid_span_exporter_clbk clbk;
+    void* ctx;
+};
+
+template <size_t N>
+void ToHex(const uint8_t (&bytes)[N], char (&hex)[2 * N + 1])
+{
+    for (size_t i = 0; i < N; i++)
+    {
+        ::snprintf(hex + 2 * i, 3, "%02x", bytes[i]);
+    }
+}
+
+void ExportSpan(void* context, const RealSenseID::Trace::Span* span)
+{
+    auto* exporter = static_cast<const CExporter*>(context);
+    rsid_span c_span;
+    c_span.name = span->name;
+    c_span.category = span->category;
+    ToHex(span->traceId, c_span.trace_id);
+    ToHex(span->spanId, c_span.span_id);
+    ToHex(span->parentSpanId, c_span.parent_span_id);
+    c_span.start_unix_ns = span->startUnixNs;
+    c_span.end_unix_ns = span->endUnixNs;
+    c_span.value = span->value;
+    c_span.has_value = span->hasValue ? 1 : 0;
+    exporter->clbk(&c_span, exporter->ctx);
+}
+} // namespace
+
+void rsid_trace_set_span_exporter(rsid_span_exporter_clbk exporter, void* ctx)
+{
+    if (exporter == nullptr)
+    {
+        RealSenseID::Trace::SetSpanExporter(nullptr);
+        return;
+    }
+    // never freed, as the library's copies of the replaced exporters (spans in flight may still use them)
+    auto* c_exporter = new CExporter {exporter, ctx};
+    RealSenseID::Trace::SpanExporter span_exporter;
+    span_exporter.exportSpan = ExportSpan;
+    span_exporter.context = c_exporter;
+    RealSenseID::Trace::SetSpanExporter(&span_exporter);
+}
@@ -5,6 +5,8 @@ using System;
 using System.Text;
 using System.Runtime.InteropServices;
 using System.Collections.Generic;
+using System.Threading;
+using System.Threading.Tasks;
 
 namespace rsid
 {
@@ -213,6 +215,32 @@ namespace rsid
         public int confidence;
     }
 
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MatchArrayResult
+    {
+        [MarshalAs(UnmanagedType.I4, SizeConst = 1)]
+        public int success;
+        [MarshalAs(UnmanagedType.I4, SizeConst = 1)]
+        public int shouldUpdate;
+        [MarshalAs(UnmanagedType.I4, SizeConst = 1)]
+        public int index; // index of the matched faceprints in the array, -1 if none
+        [MarshalAs(UnmanagedType.I4, SizeConst = 1)]
+        public int score;
+        [MarshalAs(UnmanagedType.I4, SizeConst = 1)]
+        public int confidence;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MatchCandidate
+    {
+        [MarshalAs(UnmanagedType.I4, SizeConst = 1)]
+        public int index; // index of the candidate's faceprints in the array
+        [MarshalAs(UnmanagedType.I4, SizeConst = 1)]
+        public int score;
+        [MarshalAs(UnmanagedType.I4, SizeConst = 1)]
+        public int confidence;
+    }
+
     public delegate void AuthResultCallback(AuthStatus status, string userId, IntPtr ctx);
     public delegate void AuthlHintCallback(AuthStatus status, IntPtr ctx);
     public delegate void FaceDetecedCallback(IntPtr faces, int count, IntPtr ctx);
@@ -236,6 +264,14 @@ namespace rsid
         public IntPtr ctx;
     }
 
+    // rsid_user_ids of the c api
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct UserIdsArena
+    {
+        public int numberOfUsers;
+        public IntPtr userIds;
+    }
+
     public class Authenticator : IDisposable
     {
         public const int MaxUserIdSize = 30;
@@ -350,6 +386,11 @@ namespace rsid
             return rsid_remove_user(_handle, userId);
         }
 
+        public Status RemoveUsers(string[] userIds)
+        {
+            return rsid_remove_users(_handle, userIds, (uint)userIds.Length);
+        }
+
 
         public Status QueryNumberOfUsers(out int numberOfUsers)
         {
@@ -358,32 +399,20 @@ namespace rsid
 
         public Status QueryUserIds(out string[] userIds)
         {
-
-            int userCount;
-            userIds = new string[0];
-
-            // Query user count first
-            var status = QueryNumberOfUsers(out userCount);
-            if (status != rsid.Status.Ok || userCount == 0)
-            {
-                return status;
-            }
-
-            // Allocate buffer to hold the results (31 bytes for each user)
-            var chunkSize = MaxUserIdSize + 1;
-            var buf = new byte[chunkSize * userCount];
-            status = rsid_query_user_ids_to_buf(_handle, buf, ref userCount);
-
-            if (status != rsid.Status.Ok || userCount <= 0)
+            // one native query into a single buffer of 31 byte chunks, freed once
+            var arena = new UserIdsArena();
+            var status = rsid_query_user_ids_arena(_handle, ref arena);
+            try
             {
-                return status;
+                userIds = new string[status == rsid.Status.Ok ? arena.numberOfUsers : 0];
+                for (var i = 0; i < userIds.Length; i++)
+                {
+                    userIds[i] = Marshal.PtrToStringAnsi(IntPtr.Add(arena.userIds, i * (MaxUserIdSize + 1)));
+                }
             }
-
-            // translate to string array. 
-            userIds = new string[userCount];
-            for (var i = 0; i < userCount; i++)
+            finally
             {
-                userIds[i] = Encoding.ASCII.GetString(buf, i * chunkSize, chunkSize).TrimEnd('\0'); ;
+                rsid_free_user_ids(ref arena);
             }
             return status;
         }
@@ -394,6 +423,12 @@ namespace rsid
             return rsid_standby(_handle);
         }
 
+        // Wake the device and start the session ahead of the next request, kept for it within holdMs
+        public Status Prewarm(uint holdMs = 5000)
+        {
+            return rsid_prewarm(_handle, holdMs);
+        }
+
         protected virtual void Dispose(bool disposing)
         {
             if (!_disposed)
@@ -422,6 +457,40 @@ namespace rsid
             return rsid_extract_faceprints_for_auth_loop(_handle, ref args);
         }
 
+        // Async flows: the tasks complete from the native completion callbacks, no thread is blocked while the flow
+        // runs. The args' callbacks are called on the SDK's executor threads. Canceling the token cancels the
+        // operation (a pending one completes at once with Status.Error, a running one once the device replies).
+        public Task<Status> EnrollAsync(EnrollArgs args, CancellationToken cancellationToken = default(CancellationToken))
+        {
+            return StartAsync(args, cancellationToken,
+                ctx => rsid_enroll_async(_handle, ref args, _asyncDoneClbk, ctx));
+        }
+
+        public Task<Status> AuthenticateAsync(AuthArgs args, CancellationToken cancellationToken = default(CancellationToken))
+        {
+            return StartAsync(args, cancellationToken,
+                ctx => rsid_authenticate_async(_handle, ref args, _asyncDoneClbk, ctx));
+        }
+
+        // Cancel the token to stop the loop
+        public Task<Status> AuthenticateLoopAsync(AuthArgs args, CancellationToken cancellationToken)
+        {
+            return StartAsync(args, cancellationToken,
+                ctx => rsid_authenticate_loop_async(_handle, ref args, _asyncDoneClbk, ctx));
+        }
+
+        public Task<Status> EnrollExtractFaceprintsAsync(EnrollExtractArgs args, CancellationToken cancellationToken = default(CancellationToken))
+        {
+            return StartAsync(args, cancellationToken,
+                ctx => rsid_extract_faceprints_for_enroll_async(_handle, ref args, _asyncDoneClbk, ctx));
+        }
+
+        public Task<Status> AuthenticateExtractFaceprintsAsync(AuthExtractArgs args, CancellationToken cancellationToken = default(CancellationToken))
+        {
+            return StartAsync(args, cancellationToken,
+                ctx => rsid_extract_faceprints_for_auth_async(_handle, ref args, _asyncDoneClbk, ctx));
+        }
+
         public MatchResult MatchFaceprintsToFaceprints(ref MatchArgs args)
         {
             _matchArgs = args;
@@ -431,6 +500,22 @@ namespace rsid
             return result;
         }
 
+        // match against all the given faceprints in a single native call.
+        // updatedFaceprints holds the matched user's updated faceprints if result.shouldUpdate is set.
+        public MatchArrayResult MatchFaceprintsToArray(ref Faceprints newFaceprints, Faceprints[] existingFaceprints, ref Faceprints updatedFaceprints)
+        {
+            return rsid_match_faceprints_to_array(_handle, ref newFaceprints, existingFaceprints, (UIntPtr)existingFaceprints.Length, ref updatedFaceprints);
+        }
+
+        // the k most similar of the given faceprints (sorted by descending score) in a single native call.
+        public MatchCandidate[] MatchFaceprintsTopK(ref Faceprints newFaceprints, Faceprints[] existingFaceprints, int k)
+        {
+            var candidates = new MatchCandidate[Math.Max(k, 0)];
+            var count = (int)rsid_match_faceprints_top_k(_handle, ref newFaceprints, existingFaceprints, (UIntPtr)existingFaceprints.Length, (UIntPtr)candidates.Length, candidates);
+            Array.Resize(ref candidates, count);
+            return candidates;
+        }
+
         // Helper to get FaceRect from IntPtr to faces array passed in the callbacks
         public static FaceRect[] MarshalFaces(IntPtr facesArr, int faceCount)
         {
@@ -475,6 +560,123 @@ namespace rsid
             return (status == Status.Ok);
         }
 
+        private delegate void AsyncDoneCallback(Status status, IntPtr ctx);
+
+        // A started async flow. Keeps the flow's delegates alive until the native completion, which may come before
+        // the native handle is attached (an operation canceled before it started completes on the canceling thread).
+        private sealed class PendingOperation
+        {
+            public PendingOperation(object args)
+            {
+                _args = args;
+            }
+
+            public Task<Status> Task
+            {
+                get { return _completion.Task; }
+            }
+
+            public void Attach(IntPtr operation, CancellationToken cancellationToken)
+            {
+                lock (_lock)
+                {
+                    _operation = operation;
+                    ReleaseIfDone();
+                }
+                var registration = cancellationToken.Register(Cancel);
+                lock (_lock)
+                {
+                    if (!_done)
+                    {
+                        _registration = registration;
+                        return;
+                    }
+                }
+                registration.Dispose();
+            }
+
+            public void Complete(Status status)
+            {
+                CancellationTokenRegistration registration;
+                lock (_lock)
+                {
+                    _done = true;
+                    _args = null;
+                    registration = _registration;
+                    _registration = default(CancellationTokenRegistration);
+                    ReleaseIfDone();
+                }
+                registration.Dispose();
+                _completion.TrySetResult(status);
+            }
+
+            private void Cancel()
+            {
+                IntPtr operation;
+                lock (_lock)
+                {
+                    if (_done || _operation == IntPtr.Zero)
+                        return;
+                    operation = _operation;
+                    _canceling = true;
+                }
+                // may complete the operation on this thread, the handle is released once the cancel returns
+                rsid_async_cancel(operation);
+                lock (_lock)
+                {
+                    _canceling = false;
+                    ReleaseIfDone();
+                }
+            }
+
+            // call under the lock
+            private void ReleaseIfDone()
+            {
+                if (_done && !_canceling && _operation != IntPtr.Zero)
+                {
+                    rsid_async_destroy(_operation);
+                    _operation = IntPtr.Zero;
+                }
+            }
+
+            private readonly object _lock = new object();
+            private readonly TaskCompletionSource<Status> _completion =
+                new TaskCompletionSource<Status>(TaskCreationOptions.RunContinuationsAsynchronously);
+            private object _args;
+            private IntPtr _operation = IntPtr.Zero;
+            private bool _done = false;
+            private bool _canceling = false;
+            private CancellationTokenRegistration _registration;
+        }
+
+        private static Task<Status> StartAsync(object args, CancellationToken cancellationToken, Func<IntPtr, IntPtr> start)
+        {
+            if (cancellationToken.IsCancellationRequested)
+                return System.Threading.Tasks.Task.FromResult(Status.Error);
+
+            var pending = new PendingOperation(args);
+            var handle = GCHandle.Alloc(pending);
+            var operation = start(GCHandle.ToIntPtr(handle));
+            if (operation == IntPtr.Zero)
+            {
+                handle.Free();
+                return System.Threading.Tasks.Task.FromResult(Status.Error);
+            }
+            pending.Attach(operation, cancellationToken);
+            return pending.Task;
+        }
+
+        private static void OnAsyncDone(Status status, IntPtr ctx)
+        {
+            var handle = GCHandle.FromIntPtr(ctx);
+            var pending = (PendingOperation)handle.Target;
+            handle.Free();
+            pending.Complete(status);
+        }
+
+        // static so it outlives all the pending operations
+        private static readonly AsyncDoneCallback _asyncDoneClbk = OnAsyncDone;
+
         private IntPtr _handle;
         private bool _disposed = false;
 
@@ -534,6 +736,9 @@ namespace rsid
         [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         static extern Status rsid_remove_user(IntPtr rsid_authenticator, string userId);
 
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern Status rsid_remove_users(IntPtr rsid_authenticator, string[] userIds, uint numberOfUsers);
+
         [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         static extern IntPtr rsid_version();
 
@@ -556,9 +761,18 @@ namespace rsid
         [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         static extern Status rsid_query_user_ids_to_buf(IntPtr rsid_device_controller, [Out, MarshalAs(UnmanagedType.LPArray)] byte[] output, ref int n_users);
 
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern Status rsid_query_user_ids_arena(IntPtr rsid_authenticator, ref UserIdsArena user_ids);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_free_user_ids(ref UserIdsArena user_ids);
+
         [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         static extern Status rsid_standby(IntPtr rsid_authenticator);
 
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern Status rsid_prewarm(IntPtr rsid_authenticator, uint holdMs);
+
         [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         static extern Status rsid_extract_faceprints_for_enroll(IntPtr rsid_authenticator, ref EnrollExtractArgs enrollExtractArgs);
 
@@ -572,11 +786,38 @@ namespace rsid
 
         static extern MatchResult rsid_match_faceprints(IntPtr rsid_authenticator, ref MatchArgs matchArgs);
 
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern MatchArrayResult rsid_match_faceprints_to_array(IntPtr rsid_authenticator, ref Faceprints newFaceprints, [In] Faceprints[] existingFaceprints, UIntPtr count, ref Faceprints updatedFaceprints);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern UIntPtr rsid_match_faceprints_top_k(IntPtr rsid_authenticator, ref Faceprints newFaceprints, [In] Faceprints[] existingFaceprints, UIntPtr count, UIntPtr k, [Out] MatchCandidate[] candidates);
+
         [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         static extern Status rsid_get_user_features(IntPtr rsid_authenticator, string userId, out rsid.Faceprints userFeatures);
 
         [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         static extern Status rsid_set_user_features(IntPtr rsid_authenticator, string userId, ref rsid.Faceprints userFeatures);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern IntPtr rsid_enroll_async(IntPtr rsid_authenticator, ref EnrollArgs enrollArgs, AsyncDoneCallback doneClbk, IntPtr doneCtx);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern IntPtr rsid_authenticate_async(IntPtr rsid_authenticator, ref AuthArgs authArgs, AsyncDoneCallback doneClbk, IntPtr doneCtx);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern IntPtr rsid_authenticate_loop_async(IntPtr rsid_authenticator, ref AuthArgs authArgs, AsyncDoneCallback doneClbk, IntPtr doneCtx);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern IntPtr rsid_extract_faceprints_for_enroll_async(IntPtr rsid_authenticator, ref EnrollExtractArgs enrollExtractArgs, AsyncDoneCallback doneClbk, IntPtr doneCtx);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern IntPtr rsid_extract_faceprints_for_auth_async(IntPtr rsid_authenticator, ref AuthExtractArgs authExtractArgs, AsyncDoneCallback doneClbk, IntPtr doneCtx);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_async_cancel(IntPtr rsid_async_operation);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_async_destroy(IntPtr rsid_async_operation);
     }
 
 }
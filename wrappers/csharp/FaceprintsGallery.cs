@@ -0,0 +1,276 @@
+﻿// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+using System;
+using System.Runtime.InteropServices;
+
+// Native gallery of users' faceprints for host mode matching (see rsid_gallery.h).
+// The faceprints are kept native side, so matching a scanned user never marshals the users' faceprints.
+namespace rsid
+{
+    public enum ImportRecordError
+    {
+        InvalidRecord,     // the record could not be decoded
+        InvalidFaceprints, // no descriptor or features out of the valid range
+        DuplicateUserId    // id of a user already in the gallery or earlier in the import
+    }
+
+    // rejected record of a bulk import
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ImportError
+    {
+        public UIntPtr record; // index of the record in the import
+        public ImportRecordError error;
+    }
+
+    // pair of similar users, first < second are their indices in the gallery
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SimilarPair
+    {
+        public int first;
+        public int second;
+        public int score;
+    }
+
+    public class FaceprintsGallery : IDisposable
+    {
+        public FaceprintsGallery()
+        {
+            _handle = rsid_create_faceprints_gallery();
+        }
+
+        ~FaceprintsGallery()
+        {
+            Dispose(false);
+        }
+
+        public void Dispose()
+        {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        // returns the index of the user, -1 on failure (e.g. out of memory)
+        public int Add(string userId, ref Faceprints faceprints)
+        {
+            return ToIndex(rsid_gallery_add(_handle, userId, ref faceprints));
+        }
+
+        // bulk load of count users from flat arrays of count * RSID_FEATURES_VECTOR_ALLOC_SIZE features (one row per
+        // user). the arrays are pinned for the duration of the call and copied once. userIds and origDescriptors may
+        // be null. returns the index of the first added user, -1 on failure.
+        public int AddBulk(string[] userIds, short[] avgDescriptors, short[] origDescriptors, int version, int numberOfDescriptors = 1)
+        {
+            var count = avgDescriptors.Length / FaceprintsConsts.RSID_FEATURES_VECTOR_ALLOC_SIZE;
+            return ToIndex(rsid_gallery_add_bulk(_handle, userIds, avgDescriptors, origDescriptors, (UIntPtr)count, version, numberOfDescriptors));
+        }
+
+        // bulk load from native or caller pinned memory (e.g. a fixed Span<short>). origDescriptors may be IntPtr.Zero
+        public int AddBulk(string[] userIds, IntPtr avgDescriptors, IntPtr origDescriptors, int count, int version, int numberOfDescriptors = 1)
+        {
+            return ToIndex(rsid_gallery_add_bulk_ptr(_handle, userIds, avgDescriptors, origDescriptors, (UIntPtr)count, version, numberOfDescriptors));
+        }
+
+        // import users from a faceprints bulk file (written by ExportFile()) in parallel. rejected records (undecodable,
+        // invalid or with the id of another user) are skipped and returned in errors (up to maxErrors of them).
+        // returns the number of imported users.
+        public int ImportFile(string path, out ImportError[] errors, int maxErrors = 1000)
+        {
+            errors = new ImportError[Math.Max(maxErrors, 0)];
+            var imported = (int)rsid_gallery_import_file(_handle, path, errors, (UIntPtr)errors.Length, out var numErrors);
+            Array.Resize(ref errors, (int)Math.Min((ulong)numErrors, (ulong)errors.Length));
+            return imported;
+        }
+
+        public bool ExportFile(string path)
+        {
+            return rsid_gallery_export_file(_handle, path) != 0;
+        }
+
+        // import users from an Arrow IPC file with the columns of ExportArrowFile(), as ImportFile()
+        public int ImportArrowFile(string path, out ImportError[] errors, int maxErrors = 1000)
+        {
+            errors = new ImportError[Math.Max(maxErrors, 0)];
+            var imported = (int)rsid_gallery_import_arrow_file(_handle, path, errors, (UIntPtr)errors.Length, out var numErrors);
+            Array.Resize(ref errors, (int)Math.Min((ulong)numErrors, (ulong)errors.Length));
+            return imported;
+        }
+
+        // write all the users to an Arrow IPC file (user_id, avg_descriptor, orig_descriptor, version,
+        // number_of_descriptors, features_type columns), to be memory mapped by analytics tools instead of exporting
+        // the users one by one
+        public bool ExportArrowFile(string path)
+        {
+            return rsid_gallery_export_arrow_file(_handle, path) != 0;
+        }
+
+        public bool Update(int index, ref Faceprints faceprints)
+        {
+            return rsid_gallery_update(_handle, (UIntPtr)index, ref faceprints) != 0;
+        }
+
+        // the last user is moved to the removed user's index
+        public bool Remove(int index)
+        {
+            return rsid_gallery_remove(_handle, (UIntPtr)index) != 0;
+        }
+
+        public int Find(string userId)
+        {
+            return rsid_gallery_find(_handle, userId);
+        }
+
+        public string UserId(int index)
+        {
+            return Marshal.PtrToStringAnsi(rsid_gallery_user_id(_handle, (UIntPtr)index));
+        }
+
+        public bool GetFaceprints(int index, out Faceprints faceprints)
+        {
+            return rsid_gallery_get_faceprints(_handle, (UIntPtr)index, out faceprints) != 0;
+        }
+
+        public void Clear()
+        {
+            rsid_gallery_clear(_handle);
+        }
+
+        public void Reserve(int capacity)
+        {
+            rsid_gallery_reserve(_handle, (UIntPtr)capacity);
+        }
+
+        public int Size
+        {
+            get { return (int)rsid_gallery_size(_handle); }
+        }
+
+        // match against all the users in a single native call.
+        // updatedFaceprints holds the matched user's updated faceprints if result.shouldUpdate is set, use Update() to
+        // store them.
+        public MatchArrayResult Match(ref Faceprints newFaceprints, ref Faceprints updatedFaceprints)
+        {
+            return rsid_gallery_match(_handle, ref newFaceprints, ref updatedFaceprints);
+        }
+
+        // verify against the claimed user only (1:1, found by its id).
+        // updatedFaceprints holds the user's updated faceprints if result.shouldUpdate is set, use Update() to store them.
+        public MatchArrayResult Verify(ref Faceprints newFaceprints, string userId, ref Faceprints updatedFaceprints)
+        {
+            return rsid_gallery_verify(_handle, ref newFaceprints, userId, ref updatedFaceprints);
+        }
+
+        // the k most similar users (sorted by descending score)
+        public MatchCandidate[] MatchTopK(ref Faceprints newFaceprints, int k)
+        {
+            var candidates = new MatchCandidate[Math.Max(k, 0)];
+            var count = (int)rsid_gallery_match_top_k(_handle, ref newFaceprints, (UIntPtr)candidates.Length, candidates);
+            Array.Resize(ref candidates, count);
+            return candidates;
+        }
+
+        // all the pairs of users scoring above the threshold against each other (the identical person threshold if
+        // negative), passed to onPairs as they are found (from the search threads, one call at a time). onPairs
+        // returns false to stop. returns false if the gallery failed validation or the search was stopped
+        public bool FindSimilarPairs(Func<SimilarPair[], bool> onPairs, int threshold = -1, uint numThreads = 0)
+        {
+            SimilarPairsCallback callback = (pairs, count, ctx) =>
+            {
+                var managedPairs = new SimilarPair[(int)count];
+                var size = Marshal.SizeOf(typeof(SimilarPair));
+                for (var i = 0; i < managedPairs.Length; i++)
+                {
+                    managedPairs[i] = Marshal.PtrToStructure<SimilarPair>(pairs + i * size);
+                }
+                return onPairs(managedPairs) ? 1 : 0;
+            };
+            var completed = rsid_gallery_find_similar_pairs(_handle, threshold, numThreads, callback, IntPtr.Zero) != 0;
+            GC.KeepAlive(callback);
+            return completed;
+        }
+
+        private IntPtr _handle;
+
+        // index returned by the native gallery, -1 for RSID_GALLERY_ERROR
+        private static int ToIndex(UIntPtr index)
+        {
+            ulong value = index.ToUInt64();
+            return value == (UIntPtr.Size == 8 ? ulong.MaxValue : uint.MaxValue) ? -1 : (int)value;
+        }
+
+        protected virtual void Dispose(bool disposing)
+        {
+            if (_handle != IntPtr.Zero)
+            {
+                rsid_destroy_faceprints_gallery(_handle);
+                _handle = IntPtr.Zero;
+            }
+        }
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern IntPtr rsid_create_faceprints_gallery();
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_destroy_faceprints_gallery(IntPtr gallery);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern UIntPtr rsid_gallery_add(IntPtr gallery, string userId, ref Faceprints faceprints);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern UIntPtr rsid_gallery_add_bulk(IntPtr gallery, string[] userIds, short[] avgDescriptors, short[] origDescriptors, UIntPtr count, int version, int numberOfDescriptors);
+
+        [DllImport(Shared.DllName, EntryPoint = "rsid_gallery_add_bulk", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern UIntPtr rsid_gallery_add_bulk_ptr(IntPtr gallery, string[] userIds, IntPtr avgDescriptors, IntPtr origDescriptors, UIntPtr count, int version, int numberOfDescriptors);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern UIntPtr rsid_gallery_import_file(IntPtr gallery, string path, [Out] ImportError[] errors, UIntPtr maxErrors, out UIntPtr numErrors);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern int rsid_gallery_export_file(IntPtr gallery, string path);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern UIntPtr rsid_gallery_import_arrow_file(IntPtr gallery, string path, [Out] ImportError[] errors, UIntPtr maxErrors, out UIntPtr numErrors);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern int rsid_gallery_export_arrow_file(IntPtr gallery, string path);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern int rsid_gallery_update(IntPtr gallery, UIntPtr index, ref Faceprints faceprints);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern int rsid_gallery_remove(IntPtr gallery, UIntPtr index);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern int rsid_gallery_find(IntPtr gallery, string userId);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern IntPtr rsid_gallery_user_id(IntPtr gallery, UIntPtr index);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern int rsid_gallery_get_faceprints(IntPtr gallery, UIntPtr index, out Faceprints faceprints);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_gallery_clear(IntPtr gallery);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_gallery_reserve(IntPtr gallery, UIntPtr capacity);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern UIntPtr rsid_gallery_size(IntPtr gallery);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern MatchArrayResult rsid_gallery_match(IntPtr gallery, ref Faceprints newFaceprints, ref Faceprints updatedFaceprints);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern MatchArrayResult rsid_gallery_verify(IntPtr gallery, ref Faceprints newFaceprints, string userId, ref Faceprints updatedFaceprints);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern UIntPtr rsid_gallery_match_top_k(IntPtr gallery, ref Faceprints newFaceprints, UIntPtr k, [Out] MatchCandidate[] candidates);
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        delegate int SimilarPairsCallback(IntPtr pairs, UIntPtr count, IntPtr ctx);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern int rsid_gallery_find_similar_pairs(IntPtr gallery, int threshold, uint numThreads, SimilarPairsCallback callback, IntPtr ctx);
+    }
+}
@@ -0,0 +1,166 @@
+﻿// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+using System;
+using System.Runtime.InteropServices;
+
+// Performance counters and latency histograms of the rsid library (see rsid_metrics.h)
+namespace rsid
+{
+    public class Metrics
+    {
+        public enum Counter
+        {
+            PacketsSent,
+            PacketsReceived,
+            BytesSent,
+            BytesReceived,
+            RecvTimeouts,
+            CrcErrors,
+            RecvErrors,
+            PacketRetries,
+            SessionsStarted,
+            SessionsReused,
+            SessionFailures,
+            Reconnects,
+            Matches,
+            PreviewFramesCaptured,
+            PreviewFramesDelivered,
+            PreviewFramesDropped,
+            CallbackEventsDropped,
+            PacketRetransmits,
+            LinkPingFailures,
+            LinkReconnects,
+            Prewarms,
+            PrewarmsUsed,
+            DeviceTierMatches,
+            HostTierFallbacks,
+            CoalescedMessages,
+            InexactMatches,
+            Count
+        }
+
+        public enum Latency
+        {
+            PacketTransfer,
+            RequestReply,
+            SessionSetup,
+            Enroll,
+            Authenticate,
+            ExtractFaceprints,
+            Match,
+            PreviewDelivery,
+            DeviceWait,
+            LinkPing,
+            ClockSync,
+            Wake,
+            Count
+        }
+
+        // subsystems of the SDK allocator's allocations
+        public enum Subsystem
+        {
+            Protocol,
+            Matcher,
+            Preview,
+            Wrappers,
+            Count
+        }
+
+        // allocations and frees of a subsystem since the last reset
+        [StructLayout(LayoutKind.Sequential)]
+        public struct AllocationStats
+        {
+            public UInt64 allocations;
+            public UInt64 frees;
+            public UInt64 bytesAllocated;
+            public UInt64 bytesFreed;
+        }
+
+        // latency summary in microseconds
+        [StructLayout(LayoutKind.Sequential)]
+        public struct LatencyStats
+        {
+            public UInt64 count;
+            public UInt64 sumUs;
+            public UInt64 minUs;
+            public UInt64 maxUs;
+            public UInt64 p50Us;
+            public UInt64 p90Us;
+            public UInt64 p99Us;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct Snapshot
+        {
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = (int)Counter.Count)]
+            public UInt64[] counters;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = (int)Latency.Count)]
+            public LatencyStats[] latencies;
+
+            public UInt64 Get(Counter counter)
+            {
+                return counters[(int)counter];
+            }
+
+            public LatencyStats Get(Latency latency)
+            {
+                return latencies[(int)latency];
+            }
+        }
+
+        public static Snapshot GetSnapshot()
+        {
+            Snapshot snapshot;
+            rsid_get_metrics(out snapshot);
+            return snapshot;
+        }
+
+        // allocations of each subsystem, indexed by Subsystem
+        public static AllocationStats[] GetAllocationStats()
+        {
+            var stats = new AllocationStats[(int)Subsystem.Count];
+            rsid_get_allocation_stats(stats);
+            return stats;
+        }
+
+        public static void Reset()
+        {
+            rsid_reset_metrics();
+        }
+
+        // metric names for exporters (e.g. "packets_sent", "request_reply_us")
+        public static string Name(Counter counter)
+        {
+            return Marshal.PtrToStringAnsi(rsid_metrics_counter_name((int)counter));
+        }
+
+        public static string Name(Latency latency)
+        {
+            return Marshal.PtrToStringAnsi(rsid_metrics_latency_name((int)latency));
+        }
+
+        public static string Name(Subsystem subsystem)
+        {
+            return Marshal.PtrToStringAnsi(rsid_metrics_subsystem_name((int)subsystem));
+        }
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_get_metrics(out Snapshot snapshot);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_get_allocation_stats([Out] AllocationStats[] stats);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_reset_metrics();
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern IntPtr rsid_metrics_counter_name(int counter);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern IntPtr rsid_metrics_latency_name(int latency);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern IntPtr rsid_metrics_subsystem_name(int subsystem);
+    }
+}
@@ -16,11 +16,22 @@ namespace rsid
         Dump = 2       // dump all frames
     };
 
+    public enum PreviewFormat
+    {
+        Default = 0,   // RGB
+        RGB = 1,
+        RGBA = 2,
+        BGRA = 3,
+        YUYV = 4,      // no conversion
+        NV12 = 5
+    };
+
     [StructLayout(LayoutKind.Sequential)]
     public struct PreviewConfig
     {
         public int cameraNumber;
         public PreviewMode previewMode;
+        public PreviewFormat previewFormat;
     }
 
     [StructLayout(LayoutKind.Sequential)]
@@ -70,9 +81,56 @@ namespace rsid
 
     public delegate void PreviewCallback(PreviewImage image, IntPtr ctx);
 
+    public delegate void PreviewFrameCallback(PreviewFrame frame);
+
+    // Lease on a frame of the native preview's frame pool. Image.buffer points into native memory, which the GC never
+    // moves, and stays valid until the frame is disposed, on any thread. Dispose frames promptly: images are dropped
+    // while all the frames of the pool are leased.
+    public sealed class PreviewFrame : IDisposable
+    {
+        private IntPtr _handle;
+
+        internal PreviewFrame(IntPtr handle, PreviewImage image)
+        {
+            _handle = handle;
+            Image = image;
+        }
+
+        ~PreviewFrame()
+        {
+            Release();
+        }
+
+        public PreviewImage Image { get; }
+
+        public IntPtr Buffer => Image.buffer;
+
+        public int Size => Image.size;
+
+        public void Dispose()
+        {
+            Release();
+            GC.SuppressFinalize(this);
+        }
+
+        private void Release()
+        {
+            var handle = System.Threading.Interlocked.Exchange(ref _handle, IntPtr.Zero);
+            if (handle != IntPtr.Zero)
+                rsid_release_preview_frame(handle);
+        }
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_release_preview_frame(IntPtr frame);
+    }
+
     public class Preview : IDisposable
     {
+        public const uint DefaultFramePoolSize = 4;
+
         PreviewCallback _clbkDelegate;
+        PreviewFrameNativeCallback _frameClbkDelegate;
+        PreviewFrameCallback _frameClbk;
         PreviewConfig _config;
 
         public Preview(PreviewConfig config)
@@ -109,6 +167,29 @@ namespace rsid
             return rv;
         }
 
+        // Start preview with leased frames, captured into a pool of poolSize frames and handed to the callback without
+        // copying them. The callback owns each frame and must dispose it.
+        public bool StartFrames(PreviewFrameCallback clbk, uint poolSize = DefaultFramePoolSize)
+        {
+            if (_handle == IntPtr.Zero)
+                return false;
+
+            _frameClbk = clbk;
+            _frameClbkDelegate = OnNativeFrame; //save it to prevent from the delegate garbage collected
+            return rsid_start_preview_frames(_handle, _frameClbkDelegate, poolSize, IntPtr.Zero) != 0;
+        }
+
+        private void OnNativeFrame(IntPtr frame, PreviewImage image, IntPtr ctx)
+        {
+            var leased = new PreviewFrame(frame, image);
+            var clbk = _frameClbk;
+            if (clbk == null)
+            {
+                leased.Dispose();
+                return;
+            }
+            clbk(leased);
+        }
 
         public bool Pause()
         {
@@ -162,6 +243,11 @@ namespace rsid
         [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         static extern int rsid_start_preview(IntPtr rsid_preview, PreviewCallback clbk, IntPtr ctx);
 
+        delegate void PreviewFrameNativeCallback(IntPtr frame, PreviewImage image, IntPtr ctx);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern int rsid_start_preview_frames(IntPtr rsid_preview, PreviewFrameNativeCallback clbk, uint poolSize, IntPtr ctx);
+
         [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         static extern int rsid_pause_preview(IntPtr rsid_preview);
 
@@ -0,0 +1,90 @@
+﻿// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+// Timeline of the rsid library operations, written as Chrome Trace Event JSON (see rsid_trace.h)
+namespace rsid
+{
+    public class Trace
+    {
+        // capacity 0 for the default
+        public static void Start(int capacity = 0)
+        {
+            rsid_trace_start((UIntPtr)capacity);
+        }
+
+        public static void Stop()
+        {
+            rsid_trace_stop();
+        }
+
+        public static bool Write(string path)
+        {
+            return rsid_trace_write(path) != 0;
+        }
+
+        // w3c traceparent of the caller's span (e.g. Activity.Current.Id of an OpenTelemetry activity): the library
+        // operations called on this thread are exported as its child spans. null clears the context.
+        public static bool SetContext(string traceparent)
+        {
+            return rsid_trace_set_context(traceparent) != 0;
+        }
+
+        [StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
+        public struct Span
+        {
+            public IntPtr name;
+            public IntPtr category;
+            [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 33)]
+            public string traceId;
+            [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 17)]
+            public string spanId;
+            [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 17)]
+            public string parentSpanId;
+            public ulong startUnixNs;
+            public ulong endUnixNs;
+            public long value;
+            public int hasValue;
+
+            public string Name => Marshal.PtrToStringAnsi(name);
+            public string Category => Marshal.PtrToStringAnsi(category);
+        }
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void SpanExporterCallback(ref Span span, IntPtr ctx);
+
+        // never collected, spans in flight may still be exported with a replaced exporter
+        private static readonly List<SpanExporterCallback> _spanExporters = new List<SpanExporterCallback>();
+
+        // called from the library threads as each span ends, null removes the exporter
+        public static void SetSpanExporter(SpanExporterCallback exporter)
+        {
+            if (exporter != null)
+            {
+                lock (_spanExporters)
+                {
+                    _spanExporters.Add(exporter);
+                }
+            }
+            rsid_trace_set_span_exporter(exporter, IntPtr.Zero);
+        }
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_trace_start(UIntPtr capacity);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_trace_stop();
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern int rsid_trace_write(string path);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern int rsid_trace_set_context(string traceparent);
+
+        [DllImport(Shared.DllName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        static extern void rsid_trace_set_span_exporter(SpanExporterCallback exporter, IntPtr ctx);
+    }
+}
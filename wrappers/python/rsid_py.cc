@@ -0,0 +1,459 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// rsid_py - python bindings of the host side matcher.
+// Galleries are exposed as read only numpy views of the matcher's own arrays (no copies), the searches run the
+// matcher's code (the same decisions and scores as the device and the host gallery) with the GIL released.
+
+#include "Matcher/FaceprintsGallery.h"
+#include "Matcher/GalleryBulkImport.h"
+#include "Matcher/Matcher.h"
+#include "Matcher/MatcherConfig.h"
+#include "Matcher/MatcherThreadPool.h"
+#include "RealSenseID/Faceprints.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace py = pybind11;
+using namespace RealSenseID;
+
+namespace
+{
+using FeatureArray = py::array_t<feature_t, py::array::c_style | py::array::forcecast>;
+
+constexpr size_t s_vectorLength = FEATURES_VECTOR_ALLOC_SIZE;
+
+// shared by the batch searches and the bulk imports of the module
+MatcherThreadPool& Pool()
+{
+    static MatcherThreadPool s_pool;
+    return s_pool;
+}
+
+// rows of a (n, 256) or (256,) feature array. throws ValueError on other shapes.
+size_t NumRows(const FeatureArray& vectors, const char* name)
+{
+    if (vectors.ndim() == 1 && static_cast<size_t>(vectors.shape(0)) == s_vectorLength)
+    {
+        return 1;
+    }
+    if (vectors.ndim() == 2 && static_cast<size_t>(vectors.shape(1)) == s_vectorLength)
+    {
+        return static_cast<size_t>(vectors.shape(0));
+    }
+    throw py::value_error(std::string(name) + " must have shape (256,) or (n, 256)");
+}
+
+// read only view of rows x cols elements at data (cols 0 for a 1d view), kept alive by owner
+template <typename T>
+py::array View(const T* data, size_t rows, size_t cols, py::handle owner)
+{
+    std::vector<py::ssize_t> shape {static_cast<py::ssize_t>(rows)};
+    std::vector<py::ssize_t> strides {static_cast<py::ssize_t>(sizeof(T))};
+    if (cols > 0)
+    {
+        shape.push_back(static_cast<py::ssize_t>(cols));
+        strides = {static_cast<py::ssize_t>(cols * sizeof(T)), static_cast<py::ssize_t>(sizeof(T))};
+    }
+    py::array_t<T> view(shape, strides, data, owner);
+    py::detail::array_proxy(view.ptr())->flags &= ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+    return std::move(view);
+}
+
+// query faceprints of an authentication (see ToFaceprints())
+std::vector<Faceprints> ToQueries(const FeatureArray& descriptors, int version)
+{
+    size_t count = NumRows(descriptors, "descriptors");
+    std::vector<Faceprints> queries(count);
+    QueryFaceprints query;
+    query.version = version;
+    for (size_t i = 0; i < count; i++)
+    {
+        ::memcpy(query.descriptor, descriptors.data() + i * s_vectorLength, sizeof(query.descriptor));
+        ToFaceprints(query, queries[i]);
+    }
+    return queries;
+}
+
+Thresholds ToThresholds(const py::object& thresholds_object)
+{
+    auto thresholds = thresholds_object.cast<py::tuple>();
+    if (thresholds.size() != 3)
+    {
+        throw py::value_error("thresholds must be (identical_person, strong, update)");
+    }
+    return Thresholds {thresholds[0].cast<match_calc_t>(), thresholds[1].cast<match_calc_t>(),
+                       thresholds[2].cast<match_calc_t>()};
+}
+
+// records of add_bulk()'s arrays
+class ArraySource : public BulkImportSource
+{
+public:
+    ArraySource(const std::vector<std::string>& user_ids, const feature_t* avg, const feature_t* orig, int version,
+                int number_of_descriptors) :
+        _user_ids {user_ids}, _avg {avg}, _orig {orig}, _version {version},
+        _number_of_descriptors {number_of_descriptors}
+    {
+    }
+
+    size_t Size() const override
+    {
+        return _user_ids.size();
+    }
+
+    bool Read(size_t record, ExtendedFaceprints& user) const override
+    {
+        ::memset(user.user_id, 0, sizeof(user.user_id));
+        ::strncpy(user.user_id, _user_ids[record].c_str(), sizeof(user.user_id) - 1);
+        user.faceprints.version = _version;
+        user.faceprints.numberOfDescriptors = _number_of_descriptors;
+        ::memcpy(user.faceprints.avgDescriptor, _avg + record * s_vectorLength, sizeof(user.faceprints.avgDescriptor));
+        ::memcpy(user.faceprints.origDescriptor, (_orig != nullptr ? _orig : _avg) + record * s_vectorLength,
+                 sizeof(user.faceprints.origDescriptor));
+        return true;
+    }
+
+private:
+    const std::vector<std::string>& _user_ids;
+    const feature_t* _avg;
+    const feature_t* _orig;
+    int _version;
+    int _number_of_descriptors;
+};
+
+const char* ReasonName(BulkImportError::Reason reason)
+{
+    switch (reason)
+    {
+    case BulkImportError::Reason::InvalidRecord:
+        return "invalid_record";
+    case BulkImportError::Reason::InvalidFaceprints:
+        return "invalid_faceprints";
+    case BulkImportError::Reason::DuplicateUserId:
+        return "duplicate_user_id";
+    default:
+        return "unknown";
+    }
+}
+
+py::list ToErrorList(const std::vector<BulkImportError>& errors)
+{
+    py::list result;
+    for (const auto& error : errors)
+    {
+        result.append(py::make_tuple(error.record, ReasonName(error.reason)));
+    }
+    return result;
+}
+
+py::dict ToDict(const ExtendedMatchResult& result, const Faceprints& updated)
+{
+    py::dict dict;
+    dict["success"] = result.isSame;
+    dict["is_identical"] = result.isIdentical;
+    dict["index"] = result.userId;
+    dict["score"] = result.maxScore;
+    dict["confidence"] = result.confidence;
+    dict["should_update"] = result.should_update;
+    if (result.should_update)
+    {
+        dict["updated_avg"] = FeatureArray(s_vectorLength, updated.avgDescriptor);
+    }
+    return dict;
+}
+} // namespace
+
+PYBIND11_MODULE(rsid_py, m)
+{
+    m.doc() = "RealSenseID host side matcher: faceprints galleries as numpy arrays, 1:N and top-k search";
+    m.attr("VECTOR_LENGTH") = s_vectorLength;
+    m.attr("FACEPRINTS_VERSION") = FACE_FACEPRINTS_VERSION;
+
+    m.def(
+        "default_thresholds",
+        []() {
+            const Thresholds& thresholds = MatcherConfig::Default().GetThresholds();
+            return py::make_tuple(thresholds.identicalPersonThreshold, thresholds.strongThreshold,
+                                  thresholds.updateThreshold);
+        },
+        "(identical_person, strong, update) thresholds of the matcher");
+
+    m.def(
+        "match_faceprints",
+        [](FeatureArray new_avg, FeatureArray existing_avg, py::object existing_orig, int version) {
+            if (NumRows(new_avg, "new_avg") != 1 || NumRows(existing_avg, "existing_avg") != 1)
+            {
+                throw py::value_error("1:1 match takes single vectors");
+            }
+            Faceprints new_faceprints = ToQueries(new_avg, version)[0];
+            Faceprints existing, updated;
+            existing.version = version;
+            existing.numberOfDescriptors = 1;
+            ::memcpy(existing.avgDescriptor, existing_avg.data(), sizeof(existing.avgDescriptor));
+            FeatureArray orig = existing_orig.is_none() ? existing_avg : existing_orig.cast<FeatureArray>();
+            if (NumRows(orig, "existing_orig") != 1)
+            {
+                throw py::value_error("1:1 match takes single vectors");
+            }
+            ::memcpy(existing.origDescriptor, orig.data(), sizeof(existing.origDescriptor));
+            MatchResultInternal result;
+            {
+                py::gil_scoped_release release;
+                result = Matcher::MatchFaceprints(new_faceprints, existing, updated);
+            }
+            py::dict dict;
+            dict["success"] = result.success;
+            dict["score"] = result.score;
+            dict["confidence"] = result.confidence;
+            dict["should_update"] = result.should_update;
+            if (result.should_update)
+            {
+                dict["updated_avg"] = FeatureArray(s_vectorLength, updated.avgDescriptor);
+            }
+            return dict;
+        },
+        py::arg("new_avg"), py::arg("existing_avg"), py::arg("existing_orig") = py::none(),
+        py::arg("version") = FACE_FACEPRINTS_VERSION, "1:1 match of a query vs. a user's faceprints");
+
+    py::class_<FaceprintsGallery>(m, "Gallery",
+                                  "Packed faceprints gallery. The array views are invalidated by adding users.")
+        .def(py::init([](bool interleaved) {
+                 auto gallery = new FaceprintsGallery;
+                 gallery->SetInterleaved(interleaved);
+                 return gallery;
+             }),
+             py::arg("interleaved") = true)
+        .def("__len__", &FaceprintsGallery::Size)
+        .def("reserve", &FaceprintsGallery::Reserve, py::arg("capacity"))
+        .def("clear", &FaceprintsGallery::Clear)
+        .def(
+            "user_id", [](const FaceprintsGallery& self, size_t index) {
+                if (index >= self.Size())
+                {
+                    throw py::index_error();
+                }
+                return std::string(self.UserId(index));
+            },
+            py::arg("index"))
+        .def(
+            "find",
+            [](const FaceprintsGallery& self, const std::string& user_id) { return self.Find(user_id.c_str()); },
+            py::arg("user_id"), "index of the user or -1")
+        .def(
+            "add",
+            [](FaceprintsGallery& self, const std::string& user_id, FeatureArray avg, py::object orig, int version,
+               int number_of_descriptors) {
+                FeatureArray orig_array = orig.is_none() ? avg : orig.cast<FeatureArray>();
+                if (NumRows(avg, "avg") != 1 || NumRows(orig_array, "orig") != 1)
+                {
+                    throw py::value_error("add takes single vectors, see add_bulk");
+                }
+                const std::vector<std::string> user_ids {user_id};
+                ExtendedFaceprints user;
+                ArraySource(user_ids, avg.data(), orig_array.data(), version, number_of_descriptors).Read(0, user);
+                return self.Add(user);
+            },
+            py::arg("user_id"), py::arg("avg"), py::arg("orig") = py::none(),
+            py::arg("version") = FACE_FACEPRINTS_VERSION, py::arg("number_of_descriptors") = 1,
+            "add a user, returns its index")
+        .def(
+            "add_bulk",
+            [](FaceprintsGallery& self, const std::vector<std::string>& user_ids, FeatureArray avg, py::object orig,
+               int version, int number_of_descriptors, bool strict) {
+                size_t count = NumRows(avg, "avg");
+                FeatureArray orig_array;
+                if (!orig.is_none())
+                {
+                    orig_array = orig.cast<FeatureArray>();
+                    if (NumRows(orig_array, "orig") != count)
+                    {
+                        throw py::value_error("avg and orig must have the same number of rows");
+                    }
+                }
+                if (user_ids.size() != count)
+                {
+                    throw py::value_error("one user id per row expected");
+                }
+                ArraySource source(user_ids, avg.data(), orig.is_none() ? nullptr : orig_array.data(), version,
+                                   number_of_descriptors);
+                std::vector<BulkImportError> errors;
+                size_t added;
+                {
+                    py::gil_scoped_release release;
+                    added = self.AddBulk(source, Pool(), strict, &errors);
+                }
+                return py::make_tuple(added, ToErrorList(errors));
+            },
+            py::arg("user_ids"), py::arg("avg"), py::arg("orig") = py::none(),
+            py::arg("version") = FACE_FACEPRINTS_VERSION, py::arg("number_of_descriptors") = 1,
+            py::arg("strict") = true, "add users in parallel, returns (added, [(row, reason)])")
+        .def(
+            "import_file",
+            [](FaceprintsGallery& self, const std::string& path) {
+                std::ifstream file(path, std::ios::binary);
+                if (!file)
+                {
+                    throw py::value_error("failed to open " + path);
+                }
+                std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                CodecBulkImportSource source(buffer.data(), buffer.size());
+                if (!source.IsValid())
+                {
+                    throw py::value_error("not a faceprints bulk file: " + path);
+                }
+                std::vector<BulkImportError> errors;
+                size_t added;
+                {
+                    py::gil_scoped_release release;
+                    added = self.AddBulk(source, Pool(), true, &errors);
+                }
+                return py::make_tuple(added, ToErrorList(errors));
+            },
+            py::arg("path"), "import an exported bulk file, returns (added, [(record, reason)])")
+        .def_property_readonly(
+            "avg_vectors",
+            [](py::object self) {
+                const auto& gallery = self.cast<const FaceprintsGallery&>();
+                return View(gallery.AvgVectorsData(), gallery.Size(), s_vectorLength, self);
+            },
+            "(n, 256) int16 view of the avg vectors")
+        .def_property_readonly(
+            "orig_vectors",
+            [](py::object self) {
+                const auto& gallery = self.cast<const FaceprintsGallery&>();
+                return View(gallery.Size() > 0 ? gallery.OrigVector(0) : nullptr, gallery.Size(), s_vectorLength, self);
+            },
+            "(n, 256) int16 view of the orig vectors")
+        .def_property_readonly(
+            "avg_norms",
+            [](py::object self) {
+                const auto& gallery = self.cast<const FaceprintsGallery&>();
+                return View(gallery.AvgNormsData(), gallery.Size(), 0, self);
+            },
+            "(n,) uint32 view of the cached avg vector norms")
+        .def(
+            "match",
+            [](const FaceprintsGallery& self, FeatureArray descriptor, int version, py::object thresholds) {
+                auto queries = ToQueries(descriptor, version);
+                if (queries.size() != 1)
+                {
+                    throw py::value_error("match takes a single vector, see match_batch");
+                }
+                bool has_thresholds = !thresholds.is_none();
+                Thresholds match_thresholds = has_thresholds ? ToThresholds(thresholds) : Thresholds {};
+                Faceprints updated;
+                ExtendedMatchResult result;
+                {
+                    py::gil_scoped_release release;
+                    result = has_thresholds ?
+                                 Matcher::MatchFaceprintsToArray(queries[0], self, updated, match_thresholds) :
+                                 Matcher::MatchFaceprintsToArray(queries[0], self, updated);
+                }
+                return ToDict(result, updated);
+            },
+            py::arg("descriptor"), py::arg("version") = FACE_FACEPRINTS_VERSION, py::arg("thresholds") = py::none(),
+            "1:N match of an authentication's descriptor")
+        .def(
+            "match_batch",
+            [](const FaceprintsGallery& self, FeatureArray descriptors, int version, py::object thresholds) {
+                auto queries = ToQueries(descriptors, version);
+                const py::ssize_t count = static_cast<py::ssize_t>(queries.size());
+                py::array_t<bool> success(count), identical(count), should_update(count);
+                py::array_t<int32_t> index(count);
+                py::array_t<match_calc_t> score(count), confidence(count);
+                std::vector<Faceprints> updated;
+                bool has_thresholds = !thresholds.is_none();
+                Thresholds batch_thresholds = has_thresholds ? ToThresholds(thresholds) : Thresholds {};
+                std::vector<ExtendedMatchResult> results;
+                {
+                    py::gil_scoped_release release;
+                    results = has_thresholds ? Matcher::MatchFaceprintsBatch(queries, self, updated, batch_thresholds) :
+                                               Matcher::MatchFaceprintsBatch(queries, self, updated);
+                }
+                for (size_t i = 0; i < results.size(); i++)
+                {
+                    success.mutable_data()[i] = results[i].isSame;
+                    identical.mutable_data()[i] = results[i].isIdentical;
+                    should_update.mutable_data()[i] = results[i].should_update;
+                    index.mutable_data()[i] = results[i].userId;
+                    score.mutable_data()[i] = results[i].maxScore;
+                    confidence.mutable_data()[i] = results[i].confidence;
+                }
+                py::dict dict;
+                dict["success"] = success;
+                dict["is_identical"] = identical;
+                dict["index"] = index;
+                dict["score"] = score;
+                dict["confidence"] = confidence;
+                dict["should_update"] = should_update;
+                return dict;
+            },
+            py::arg("descriptors"), py::arg("version") = FACE_FACEPRINTS_VERSION, py::arg("thresholds") = py::none(),
+            "1:N match of (m, 256) descriptors, dict of (m,) arrays")
+        .def(
+            "top_k",
+            [](const FaceprintsGallery& self, FeatureArray descriptors, size_t k, int version) {
+                auto queries = ToQueries(descriptors, version);
+                const py::ssize_t count = static_cast<py::ssize_t>(queries.size());
+                const py::ssize_t width = static_cast<py::ssize_t>(k);
+                // missing candidates (k > gallery size or invalid query) are index -1, score 0
+                py::array_t<int32_t> index({count, width});
+                py::array_t<match_calc_t> score({count, width}), confidence({count, width});
+                int32_t* index_data = index.mutable_data();
+                match_calc_t* score_data = score.mutable_data();
+                match_calc_t* confidence_data = confidence.mutable_data();
+                std::fill_n(index_data, count * width, -1);
+                std::fill_n(score_data, count * width, match_calc_t {0});
+                std::fill_n(confidence_data, count * width, match_calc_t {0});
+                {
+                    py::gil_scoped_release release;
+                    Pool().Run(queries.size(), [&](size_t query) {
+                        std::vector<MatchCandidate> candidates;
+                        Matcher::MatchFaceprintsTopK(queries[query], self, k, true, candidates);
+                        for (size_t i = 0; i < candidates.size(); i++)
+                        {
+                            index_data[query * k + i] = candidates[i].userId;
+                            score_data[query * k + i] = candidates[i].score;
+                            confidence_data[query * k + i] = candidates[i].confidence;
+                        }
+                    });
+                }
+                return py::make_tuple(index, score, confidence);
+            },
+            py::arg("descriptors"), py::arg("k"), py::arg("version") = FACE_FACEPRINTS_VERSION,
+            "exhaustive top-k of (m, 256) descriptors, (index, score, confidence) arrays of shape (m, k)")
+        .def(
+            "scores",
+            [](const FaceprintsGallery& self, FeatureArray descriptors, int version) {
+                auto queries = ToQueries(descriptors, version);
+                const py::ssize_t count = static_cast<py::ssize_t>(queries.size());
+                const size_t size = self.Size();
+                py::array_t<match_calc_t> scores({count, static_cast<py::ssize_t>(size)});
+                match_calc_t* data = scores.mutable_data();
+                std::fill_n(data, count * size, match_calc_t {0});
+                {
+                    py::gil_scoped_release release;
+                    Pool().Run(queries.size(), [&](size_t query) {
+                        std::vector<match_calc_t> row;
+                        if (Matcher::ScoreGallery(queries[query], self, row))
+                        {
+                            std::copy(row.begin(), row.end(), data + query * size);
+                        }
+                    });
+                }
+                return scores;
+            },
+            py::arg("descriptors"), py::arg("version") = FACE_FACEPRINTS_VERSION,
+            "score of every user vs. (m, 256) descriptors, (m, n) array");
+}